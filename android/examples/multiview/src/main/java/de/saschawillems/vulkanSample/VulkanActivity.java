@@ -8,8 +8,11 @@ package de.saschawillems.vulkanSample;
 import android.app.AlertDialog;
 import android.app.NativeActivity;
 import android.content.DialogInterface;
+import android.content.Context;
 import android.content.pm.ApplicationInfo;
+import android.os.Build;
 import android.os.Bundle;
+import android.os.PowerManager;
 
 import java.util.concurrent.Semaphore;
 
@@ -55,4 +58,25 @@ public class VulkanActivity extends NativeActivity {
         }
         catch (InterruptedException e) { }
     }
+
+    // Returns false if the device doesn't support a sustained performance level (requires Android 7.0)
+    public boolean setSustainedPerformanceMode(final boolean enable)
+    {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.N) {
+            return false;
+        }
+        PowerManager powerManager = (PowerManager)getSystemService(Context.POWER_SERVICE);
+        if (powerManager == null || !powerManager.isSustainedPerformanceModeSupported()) {
+            return false;
+        }
+
+        final VulkanActivity activity = this;
+
+        this.runOnUiThread(new Runnable() {
+           public void run() {
+               activity.getWindow().setSustainedPerformanceMode(enable);
+           }
+        });
+        return true;
+    }
 }
@@ -12,6 +12,7 @@
 	#include <android/log.h>
 	#include <dlfcn.h>
 	#include <android/native_window_jni.h>
+	#include <limits>
 
 android_app* androidApp;
 
@@ -68,10 +69,12 @@ PFN_vkDestroySemaphore vkDestroySemaphore;
 PFN_vkCreateFence vkCreateFence;
 PFN_vkDestroyFence vkDestroyFence;
 PFN_vkWaitForFences vkWaitForFences;
+PFN_vkGetFenceStatus vkGetFenceStatus;
 PFN_vkResetFences vkResetFences;
 PFN_vkResetDescriptorPool vkResetDescriptorPool;
 PFN_vkCreateCommandPool vkCreateCommandPool;
 PFN_vkDestroyCommandPool vkDestroyCommandPool;
+PFN_vkResetCommandPool vkResetCommandPool;
 PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers;
 PFN_vkBeginCommandBuffer vkBeginCommandBuffer;
 PFN_vkEndCommandBuffer vkEndCommandBuffer;
@@ -120,6 +123,7 @@ PFN_vkCmdBeginQuery vkCmdBeginQuery;
 PFN_vkCmdEndQuery vkCmdEndQuery;
 PFN_vkCmdResetQueryPool vkCmdResetQueryPool;
 PFN_vkCmdCopyQueryPoolResults vkCmdCopyQueryPoolResults;
+PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp;
 
 PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
 PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR;
@@ -217,11 +221,13 @@ namespace vks
 			vkCreateFence = reinterpret_cast<PFN_vkCreateFence>(vkGetInstanceProcAddr(instance, "vkCreateFence"));
 			vkDestroyFence = reinterpret_cast<PFN_vkDestroyFence>(vkGetInstanceProcAddr(instance, "vkDestroyFence"));
 			vkWaitForFences = reinterpret_cast<PFN_vkWaitForFences>(vkGetInstanceProcAddr(instance, "vkWaitForFences"));
+			vkGetFenceStatus = reinterpret_cast<PFN_vkGetFenceStatus>(vkGetInstanceProcAddr(instance, "vkGetFenceStatus"));
 			vkResetFences = reinterpret_cast<PFN_vkResetFences>(vkGetInstanceProcAddr(instance, "vkResetFences"));;
 	        vkResetDescriptorPool = reinterpret_cast<PFN_vkResetDescriptorPool>(vkGetInstanceProcAddr(instance, "vkResetDescriptorPool"));
 
 			vkCreateCommandPool = reinterpret_cast<PFN_vkCreateCommandPool>(vkGetInstanceProcAddr(instance, "vkCreateCommandPool"));
 			vkDestroyCommandPool = reinterpret_cast<PFN_vkDestroyCommandPool>(vkGetInstanceProcAddr(instance, "vkDestroyCommandPool"));;
+			vkResetCommandPool = reinterpret_cast<PFN_vkResetCommandPool>(vkGetInstanceProcAddr(instance, "vkResetCommandPool"));
 
 			vkAllocateCommandBuffers = reinterpret_cast<PFN_vkAllocateCommandBuffers>(vkGetInstanceProcAddr(instance, "vkAllocateCommandBuffers"));
 			vkBeginCommandBuffer = reinterpret_cast<PFN_vkBeginCommandBuffer>(vkGetInstanceProcAddr(instance, "vkBeginCommandBuffer"));
@@ -283,6 +289,7 @@ namespace vks
 			vkCmdEndQuery = reinterpret_cast<PFN_vkCmdEndQuery>(vkGetInstanceProcAddr(instance, "vkCmdEndQuery"));
 			vkCmdResetQueryPool = reinterpret_cast<PFN_vkCmdResetQueryPool>(vkGetInstanceProcAddr(instance, "vkCmdResetQueryPool"));
 			vkCmdCopyQueryPoolResults = reinterpret_cast<PFN_vkCmdCopyQueryPoolResults>(vkGetInstanceProcAddr(instance, "vkCmdCopyQueryPoolResults"));
+			vkCmdWriteTimestamp = reinterpret_cast<PFN_vkCmdWriteTimestamp>(vkGetInstanceProcAddr(instance, "vkCmdWriteTimestamp"));
 
 			vkCreateAndroidSurfaceKHR = reinterpret_cast<PFN_vkCreateAndroidSurfaceKHR>(vkGetInstanceProcAddr(instance, "vkCreateAndroidSurfaceKHR"));
 			vkDestroySurfaceKHR = reinterpret_cast<PFN_vkDestroySurfaceKHR>(vkGetInstanceProcAddr(instance, "vkDestroySurfaceKHR"));
@@ -318,6 +325,88 @@ namespace vks
 			androidApp->activity->vm->DetachCurrentThread();
 			return;
 		}
+
+		/**
+		* Ask the system to keep clocks at a level the device can sustain for a long time (using JNI), so performance doesn't drop once it heats up
+		*
+		* @return True if the device supports the sustained performance mode (Android 7.0 and up)
+		*/
+		bool setSustainedPerformanceMode(bool enable)
+		{
+			JNIEnv* jni;
+			androidApp->activity->vm->AttachCurrentThread(&jni, NULL);
+
+			jclass clazz = jni->GetObjectClass(androidApp->activity->clazz);
+			// Signature has to match java implementation (arguments)
+			jmethodID methodID = jni->GetMethodID(clazz, "setSustainedPerformanceMode", "(Z)Z");
+			jboolean supported = jni->CallBooleanMethod(androidApp->activity->clazz, methodID, enable ? JNI_TRUE : JNI_FALSE);
+
+			androidApp->activity->vm->DetachCurrentThread();
+			return supported == JNI_TRUE;
+		}
+
+		// The thermal API has been added with Android 11 (headroom with Android 12), so it's loaded at runtime to keep older devices supported
+		namespace
+		{
+			struct ThermalManager
+			{
+				typedef void* (*PFN_AThermal_acquireManager)();
+				typedef int32_t (*PFN_AThermal_getCurrentThermalStatus)(void* manager);
+				typedef float (*PFN_AThermal_getThermalHeadroom)(void* manager, int32_t forecastSeconds);
+				PFN_AThermal_getCurrentThermalStatus getCurrentThermalStatus = nullptr;
+				PFN_AThermal_getThermalHeadroom getThermalHeadroom = nullptr;
+				void* manager = nullptr;
+
+				ThermalManager()
+				{
+					void* libAndroid = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+					if (!libAndroid) {
+						return;
+					}
+					PFN_AThermal_acquireManager acquireManager = reinterpret_cast<PFN_AThermal_acquireManager>(dlsym(libAndroid, "AThermal_acquireManager"));
+					getCurrentThermalStatus = reinterpret_cast<PFN_AThermal_getCurrentThermalStatus>(dlsym(libAndroid, "AThermal_getCurrentThermalStatus"));
+					getThermalHeadroom = reinterpret_cast<PFN_AThermal_getThermalHeadroom>(dlsym(libAndroid, "AThermal_getThermalHeadroom"));
+					if (acquireManager) {
+						manager = acquireManager();
+					}
+				}
+			};
+
+			ThermalManager& getThermalManager()
+			{
+				static ThermalManager thermalManager;
+				return thermalManager;
+			}
+		}
+
+		/**
+		* Get the current thermal status of the device
+		*
+		* @return Status from 0 (none) over 1 (light), 2 (moderate), 3 (severe) and 4 (critical) up to 6 (shutdown), -1 if the thermal API isn't available (before Android 11)
+		*/
+		int32_t getThermalStatus()
+		{
+			ThermalManager& thermalManager = getThermalManager();
+			if (!thermalManager.manager || !thermalManager.getCurrentThermalStatus) {
+				return -1;
+			}
+			return thermalManager.getCurrentThermalStatus(thermalManager.manager);
+		}
+
+		/**
+		* Get the thermal headroom of the device, where 1.0 is the point at which it starts to throttle heavily
+		*
+		* @param forecastSeconds Seconds into the future to forecast the headroom for, assuming the current workload
+		* @return Headroom, NaN if not available (before Android 12) or if called more often than once per second
+		*/
+		float getThermalHeadroom(int32_t forecastSeconds)
+		{
+			ThermalManager& thermalManager = getThermalManager();
+			if (!thermalManager.manager || !thermalManager.getThermalHeadroom) {
+				return std::numeric_limits<float>::quiet_NaN();
+			}
+			return thermalManager.getThermalHeadroom(thermalManager.manager, forecastSeconds);
+		}
 	}
 }
 
@@ -101,10 +101,12 @@ extern PFN_vkDestroySemaphore vkDestroySemaphore;
 extern PFN_vkCreateFence vkCreateFence;
 extern PFN_vkDestroyFence vkDestroyFence;
 extern PFN_vkWaitForFences vkWaitForFences;
+extern PFN_vkGetFenceStatus vkGetFenceStatus;
 extern PFN_vkResetFences vkResetFences;
 extern PFN_vkResetDescriptorPool vkResetDescriptorPool;
 extern PFN_vkCreateCommandPool vkCreateCommandPool;
 extern PFN_vkDestroyCommandPool vkDestroyCommandPool;
+extern PFN_vkResetCommandPool vkResetCommandPool;
 extern PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers;
 extern PFN_vkBeginCommandBuffer vkBeginCommandBuffer;
 extern PFN_vkEndCommandBuffer vkEndCommandBuffer;
@@ -153,6 +155,7 @@ extern PFN_vkCmdBeginQuery vkCmdBeginQuery;
 extern PFN_vkCmdEndQuery vkCmdEndQuery;
 extern PFN_vkCmdResetQueryPool vkCmdResetQueryPool;
 extern PFN_vkCmdCopyQueryPoolResults vkCmdCopyQueryPoolResults;
+extern PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp;
 
 extern PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
 extern PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR;
@@ -175,6 +178,9 @@ namespace vks
 		void freeVulkanLibrary();
 		void getDeviceConfig();
 		void showAlert(const char* message);
+		bool setSustainedPerformanceMode(bool enable);
+		int32_t getThermalStatus();
+		float getThermalHeadroom(int32_t forecastSeconds);
 	}
 }
 
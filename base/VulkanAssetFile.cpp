@@ -0,0 +1,137 @@
+/*
+* Vulkan asset file
+*
+* Read only view of an asset file that is memory mapped on desktop platforms and taken from the apk via the asset manager on Android
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanAssetFile.h"
+
+#if defined(__ANDROID__)
+#include "VulkanAndroid.h"
+#elif !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	AssetFile::AssetFile(const std::string& filename)
+	{
+		open(filename);
+	}
+
+	AssetFile::~AssetFile()
+	{
+		close();
+	}
+
+	/**
+	* Open an asset file, closes the file that is currently open
+	*
+	* @param filename Path of the file, relative to the apk's assets on Android
+	*
+	* @return True if the file could be opened and is not empty
+	*/
+	bool AssetFile::open(const std::string& filename)
+	{
+#if defined(__ANDROID__)
+		return open(androidApp->activity->assetManager, filename);
+#else
+		close();
+#if defined(_WIN32)
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0)) {
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping) {
+				mappedData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				mappedSize = mappedData ? static_cast<size_t>(fileSize.QuadPart) : 0;
+			}
+		}
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		if ((fstat(fd, &fileStat) == 0) && (fileStat.st_size > 0)) {
+			const size_t size = static_cast<size_t>(fileStat.st_size);
+			void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED) {
+				mappedData = static_cast<const uint8_t*>(mapped);
+				mappedSize = size;
+			}
+		}
+		// The mapping stays valid after closing the descriptor
+		::close(fd);
+#endif
+		if (!mappedData) {
+			close();
+		}
+		return valid();
+#endif
+	}
+
+#if defined(__ANDROID__)
+	/**
+	* Open an asset from the apk
+	*
+	* @param assetManager Asset manager to open the asset with
+	* @param filename Path of the asset
+	*
+	* @return True if the asset could be opened and is not empty
+	*/
+	bool AssetFile::open(AAssetManager* assetManager, const std::string& filename)
+	{
+		close();
+		asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+		if (!asset) {
+			return false;
+		}
+		mappedData = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+		mappedSize = mappedData ? static_cast<size_t>(AAsset_getLength(asset)) : 0;
+		if (!mappedData || (mappedSize == 0)) {
+			close();
+		}
+		return valid();
+	}
+#endif
+
+	/** @brief Release the view of the file, pointers returned by data() become invalid */
+	void AssetFile::close()
+	{
+#if defined(__ANDROID__)
+		if (asset) {
+			AAsset_close(asset);
+			asset = nullptr;
+		}
+#elif defined(_WIN32)
+		if (mappedData) {
+			UnmapViewOfFile(mappedData);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+			mapping = NULL;
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+			file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (mappedData) {
+			munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+		}
+#endif
+		mappedData = nullptr;
+		mappedSize = 0;
+	}
+}
@@ -0,0 +1,64 @@
+/*
+* Vulkan asset file
+*
+* Read only view of an asset file that is memory mapped on desktop platforms and taken from the apk via the asset manager on Android
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vks
+{
+	/**
+	* @brief Read only view of the contents of an asset file
+	*
+	* Loaders consume the file's data in place instead of reading it into intermediate buffers. On desktop the file is memory mapped,
+	* so pages are only brought in from the OS file cache as they are read. On Android the asset is opened in buffer mode, which
+	* maps uncompressed assets directly from the apk and decompresses compressed assets once.
+	*
+	* @note The data is only valid as long as the file is open, it is not guaranteed to be aligned beyond 1 byte on Android
+	*/
+	class AssetFile
+	{
+	private:
+		const uint8_t* mappedData = nullptr;
+		size_t mappedSize = 0;
+#if defined(__ANDROID__)
+		AAsset* asset = nullptr;
+#elif defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+	public:
+		AssetFile() = default;
+		explicit AssetFile(const std::string& filename);
+		~AssetFile();
+		AssetFile(const AssetFile&) = delete;
+		AssetFile& operator=(const AssetFile&) = delete;
+
+		bool open(const std::string& filename);
+#if defined(__ANDROID__)
+		bool open(AAssetManager* assetManager, const std::string& filename);
+#endif
+		void close();
+
+		/** @brief Returns true if a non-empty file is open */
+		bool valid() const { return mappedData != nullptr; }
+		const uint8_t* data() const { return mappedData; }
+		size_t size() const { return mappedSize; }
+	};
+}
@@ -22,6 +22,16 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// Sub-allocated buffers live in persistently mapped memory blocks
+		if (allocation.valid())
+		{
+			if (!allocation.mapped)
+			{
+				return VK_ERROR_MEMORY_MAP_FAILED;
+			}
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +44,10 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocation.valid())
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +61,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -78,6 +91,21 @@ namespace vks
 		memcpy(mapped, data, size);
 	}
 
+	/**
+	* Get the memory range for flushing or invalidating a part of the buffer
+	*
+	* @note For sub-allocated buffers the range is relative to the buffer's allocation, so neighbouring allocations in the same block are not touched
+	*/
+	VkMappedMemoryRange Buffer::getMappedRange(VkDeviceSize size, VkDeviceSize offset)
+	{
+		VkMappedMemoryRange mappedRange = {};
+		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		mappedRange.memory = memory;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = (allocation.valid() && (size == VK_WHOLE_SIZE)) ? allocation.size - offset : size;
+		return mappedRange;
+	}
+
 	/** 
 	* Flush a memory range of the buffer to make it visible to the device
 	*
@@ -90,11 +118,7 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
@@ -110,14 +134,23 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
+	/**
+	* Set the debug name the buffer is listed with in the memory report (see vks::MemoryReport), only for buffers sub-allocated by the memory allocator
+	*
+	* @param name Debug name of the buffer
+	*/
+	void Buffer::setName(const std::string& name)
+	{
+		if (allocation.valid())
+		{
+			allocation.allocator->tag(allocation, MemoryReport::bufferCategory(usageFlags), name);
+		}
+	}
+
 	/** 
 	* Release all Vulkan resources held by this buffer
 	*/
@@ -127,7 +160,13 @@ namespace vks
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
+		if (allocation.valid())
+		{
+			allocation.allocator->free(allocation);
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 		}
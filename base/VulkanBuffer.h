@@ -11,9 +11,11 @@
 #pragma once
 
 #include <vector>
+#include <string>
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
 
 namespace vks
 {	
@@ -26,6 +28,8 @@ namespace vks
 		VkDevice device;
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VkDeviceMemory memory = VK_NULL_HANDLE;
+		/** @brief Memory range of the buffer if it has been sub-allocated from a larger memory block (memory is the block's memory then) */
+		vks::Allocation allocation;
 		VkDescriptorBufferInfo descriptor;
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
@@ -39,8 +43,10 @@ namespace vks
 		VkResult bind(VkDeviceSize offset = 0);
 		void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void copyTo(void* data, VkDeviceSize size);
+		VkMappedMemoryRange getMappedRange(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		void setName(const std::string& name);
 		void destroy();
 	};
 }
\ No newline at end of file
@@ -257,5 +257,81 @@ namespace vks
 			setObjectName(device, (uint64_t)_event, VK_DEBUG_REPORT_OBJECT_TYPE_EVENT_EXT, name);
 		}
 	};
-}
 
+#if VKS_DEBUG_LABELS
+	namespace debugutils
+	{
+		bool active = false;
+
+		PFN_vkCmdBeginDebugUtilsLabelEXT pfnCmdBeginDebugUtilsLabel = VK_NULL_HANDLE;
+		PFN_vkCmdEndDebugUtilsLabelEXT pfnCmdEndDebugUtilsLabel = VK_NULL_HANDLE;
+		PFN_vkCmdInsertDebugUtilsLabelEXT pfnCmdInsertDebugUtilsLabel = VK_NULL_HANDLE;
+		PFN_vkQueueBeginDebugUtilsLabelEXT pfnQueueBeginDebugUtilsLabel = VK_NULL_HANDLE;
+		PFN_vkQueueEndDebugUtilsLabelEXT pfnQueueEndDebugUtilsLabel = VK_NULL_HANDLE;
+
+		void setup(VkInstance instance)
+		{
+			pfnCmdBeginDebugUtilsLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+			pfnCmdEndDebugUtilsLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+			pfnCmdInsertDebugUtilsLabel = reinterpret_cast<PFN_vkCmdInsertDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT"));
+			pfnQueueBeginDebugUtilsLabel = reinterpret_cast<PFN_vkQueueBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkQueueBeginDebugUtilsLabelEXT"));
+			pfnQueueEndDebugUtilsLabel = reinterpret_cast<PFN_vkQueueEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkQueueEndDebugUtilsLabelEXT"));
+
+			// Begin and end always need to be present together, so regions stay balanced
+			active = (pfnCmdBeginDebugUtilsLabel != VK_NULL_HANDLE) && (pfnCmdEndDebugUtilsLabel != VK_NULL_HANDLE);
+		}
+
+		static VkDebugUtilsLabelEXT labelInfo(const char* labelName, glm::vec4 color)
+		{
+			VkDebugUtilsLabelEXT label{};
+			label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			label.pLabelName = labelName;
+			memcpy(label.color, &color[0], sizeof(float) * 4);
+			return label;
+		}
+
+		void cmdBeginLabel(VkCommandBuffer cmdbuffer, const char* labelName, glm::vec4 color)
+		{
+			if (active)
+			{
+				VkDebugUtilsLabelEXT label = labelInfo(labelName, color);
+				pfnCmdBeginDebugUtilsLabel(cmdbuffer, &label);
+			}
+		}
+
+		void cmdInsertLabel(VkCommandBuffer cmdbuffer, const char* labelName, glm::vec4 color)
+		{
+			if (pfnCmdInsertDebugUtilsLabel)
+			{
+				VkDebugUtilsLabelEXT label = labelInfo(labelName, color);
+				pfnCmdInsertDebugUtilsLabel(cmdbuffer, &label);
+			}
+		}
+
+		void cmdEndLabel(VkCommandBuffer cmdbuffer)
+		{
+			if (active)
+			{
+				pfnCmdEndDebugUtilsLabel(cmdbuffer);
+			}
+		}
+
+		void queueBeginLabel(VkQueue queue, const char* labelName, glm::vec4 color)
+		{
+			if (pfnQueueBeginDebugUtilsLabel && pfnQueueEndDebugUtilsLabel)
+			{
+				VkDebugUtilsLabelEXT label = labelInfo(labelName, color);
+				pfnQueueBeginDebugUtilsLabel(queue, &label);
+			}
+		}
+
+		void queueEndLabel(VkQueue queue)
+		{
+			if (pfnQueueBeginDebugUtilsLabel && pfnQueueEndDebugUtilsLabel)
+			{
+				pfnQueueEndDebugUtilsLabel(queue);
+			}
+		}
+	}
+#endif
+}
@@ -22,6 +22,11 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+// Command buffer and queue labels (VK_EXT_debug_utils) for the GPU profiler scopes, define as 0 (or configure with USE_DEBUG_LABELS=OFF) to compile them out
+#ifndef VKS_DEBUG_LABELS
+#define VKS_DEBUG_LABELS 1
+#endif
+
 namespace vks
 {
 	namespace debug
@@ -99,4 +104,42 @@ namespace vks
 		void setFenceName(VkDevice device, VkFence fence, const char * name);
 		void setEventName(VkDevice device, VkEvent _event, const char * name);
 	};
+
+	// Command buffer and queue labels of the VK_EXT_debug_utils extension
+	// Capture and profiling tools (e.g. RenderDoc, RGP or Nsight) show labeled regions as a breakdown of the frame
+	// The GPU profiler labels its scopes and the example base labels each frame's queue work, so tools show the same breakdown as the in-app profiler
+	// The instance extension is enabled by the example base if it's available, all functions do nothing otherwise
+	namespace debugutils
+	{
+#if VKS_DEBUG_LABELS
+		// Set to true if the function pointers for the labels are available
+		extern bool active;
+
+		// Get function pointers for the labels from the instance
+		void setup(VkInstance instance);
+
+		// Start a labeled region of a command buffer
+		void cmdBeginLabel(VkCommandBuffer cmdbuffer, const char* labelName, glm::vec4 color = glm::vec4(0.0f));
+
+		// Insert a single label into a command buffer
+		void cmdInsertLabel(VkCommandBuffer cmdbuffer, const char* labelName, glm::vec4 color = glm::vec4(0.0f));
+
+		// End the current labeled region of a command buffer
+		void cmdEndLabel(VkCommandBuffer cmdbuffer);
+
+		// Start a labeled region of the work submitted to a queue
+		void queueBeginLabel(VkQueue queue, const char* labelName, glm::vec4 color = glm::vec4(0.0f));
+
+		// End the current labeled region of a queue
+		void queueEndLabel(VkQueue queue);
+#else
+		const bool active = false;
+		inline void setup(VkInstance) {}
+		inline void cmdBeginLabel(VkCommandBuffer, const char*, glm::vec4 = glm::vec4(0.0f)) {}
+		inline void cmdInsertLabel(VkCommandBuffer, const char*, glm::vec4 = glm::vec4(0.0f)) {}
+		inline void cmdEndLabel(VkCommandBuffer) {}
+		inline void queueBeginLabel(VkQueue, const char*, glm::vec4 = glm::vec4(0.0f)) {}
+		inline void queueEndLabel(VkQueue) {}
+#endif
+	}
 }
@@ -0,0 +1,170 @@
+/*
+* Vulkan deletion queue
+*
+* Defers the destruction of replaced resources until the GPU has finished all work that may still use them
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDeletionQueue.h"
+
+#include <vector>
+#include <cassert>
+
+namespace vks
+{
+	DeletionQueue::~DeletionQueue()
+	{
+		flush();
+	}
+
+	/** @brief Set the device the typed helpers destroy their handles on */
+	void DeletionQueue::setup(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	/** @brief Call destroy once the frame currently being recorded (and all frames before it) have finished on the GPU */
+	void DeletionQueue::push(std::function<void()> destroy)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.push_back({ recordingSerial, destroy });
+	}
+
+	/**
+	* Call destroy once the given serial has been reached
+	*
+	* @param serial Frame serial (see currentSerial) or a value of the owner's timeline the queue is collected with
+	* @param destroy Function destroying the resource
+	*/
+	void DeletionQueue::pushAfter(uint64_t serial, std::function<void()> destroy)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Keep the entries sorted, so collect can stop at the first entry that's still in use
+		auto it = entries.end();
+		while ((it != entries.begin()) && ((it - 1)->serial > serial)) {
+			--it;
+		}
+		entries.insert(it, { serial, destroy });
+	}
+
+	void DeletionQueue::buffer(VkBuffer buffer)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, buffer]() { vkDestroyBuffer(device, buffer, nullptr); });
+	}
+
+	/** @brief Take over the buffer and its memory (unmapping it if required), the passed buffer is reset so it can be recreated right away */
+	void DeletionQueue::buffer(vks::Buffer& buffer)
+	{
+		vks::Buffer retired = buffer;
+		push([retired]() mutable {
+			retired.unmap();
+			retired.destroy();
+		});
+		buffer.buffer = VK_NULL_HANDLE;
+		buffer.memory = VK_NULL_HANDLE;
+		buffer.allocation = vks::Allocation();
+		buffer.mapped = nullptr;
+		buffer.size = 0;
+	}
+
+	void DeletionQueue::image(VkImage image)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, image]() { vkDestroyImage(device, image, nullptr); });
+	}
+
+	void DeletionQueue::imageView(VkImageView imageView)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, imageView]() { vkDestroyImageView(device, imageView, nullptr); });
+	}
+
+	void DeletionQueue::sampler(VkSampler sampler)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, sampler]() { vkDestroySampler(device, sampler, nullptr); });
+	}
+
+	void DeletionQueue::framebuffer(VkFramebuffer framebuffer)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, framebuffer]() { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+	}
+
+	void DeletionQueue::pipeline(VkPipeline pipeline)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+	}
+
+	/** @note Destroying the pool frees all descriptor sets allocated from it */
+	void DeletionQueue::descriptorPool(VkDescriptorPool descriptorPool)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, descriptorPool]() { vkDestroyDescriptorPool(device, descriptorPool, nullptr); });
+	}
+
+	/** @note For memory that isn't sub-allocated, sub-allocations are freed with a custom function calling vks::MemoryAllocator::free */
+	void DeletionQueue::memory(VkDeviceMemory memory)
+	{
+		assert(device != VK_NULL_HANDLE);
+		VkDevice device = this->device;
+		push([device, memory]() { vkFreeMemory(device, memory, nullptr); });
+	}
+
+	/** @brief Serial of the frame currently being recorded, i.e. of the next frame submission */
+	uint64_t DeletionQueue::currentSerial()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return recordingSerial;
+	}
+
+	/** @brief Advance to the next frame once the current one has been submitted, returns the serial of the submitted frame */
+	uint64_t DeletionQueue::frameSubmitted()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return recordingSerial++;
+	}
+
+	/** @brief Destroy all resources keyed to serials up to (and including) completedSerial, i.e. the GPU has finished the work up to that point */
+	void DeletionQueue::collect(uint64_t completedSerial)
+	{
+		std::vector<std::function<void()>> completed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (!entries.empty() && (entries.front().serial <= completedSerial)) {
+				completed.push_back(std::move(entries.front().destroy));
+				entries.pop_front();
+			}
+		}
+		// Destroyed outside of the lock, so the functions may retire other resources
+		for (auto& destroy : completed) {
+			destroy();
+		}
+	}
+
+	/** @brief Destroy all resources right away, the device must be idle */
+	void DeletionQueue::flush()
+	{
+		while (size() > 0) {
+			collect(UINT64_MAX);
+		}
+	}
+
+	size_t DeletionQueue::size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+}
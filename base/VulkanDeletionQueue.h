@@ -0,0 +1,67 @@
+/*
+* Vulkan deletion queue
+*
+* Defers the destruction of replaced resources until the GPU has finished all work that may still use them
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	/**
+	* @brief Queue of resources that are destroyed once the GPU has passed a given point
+	*
+	* Each entry is keyed to a serial, which is the serial of the frame being recorded when the entry is pushed (see frameSubmitted), or a value chosen by the caller (pushAfter),
+	* e.g. the value a timeline semaphore is signaled with by the last submission using the resource. Entries are destroyed by collect once the owner of the queue
+	* (the example base class) knows that all work up to that serial has finished, so resources can be replaced at runtime without waiting for the device to become idle.
+	*
+	* Any frame that used a resource has been submitted before the resource was pushed, or is the frame being recorded, so keying it to the current serial is always safe.
+	* Pushing is thread safe, the resources are destroyed by the thread calling collect.
+	*/
+	class DeletionQueue
+	{
+	private:
+		struct Entry
+		{
+			uint64_t serial;
+			std::function<void()> destroy;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		std::mutex mutex;
+		// Sorted by serial, as serials only increase
+		std::deque<Entry> entries;
+		uint64_t recordingSerial = 1;
+
+	public:
+		~DeletionQueue();
+		void setup(VkDevice device);
+		void push(std::function<void()> destroy);
+		void pushAfter(uint64_t serial, std::function<void()> destroy);
+		void buffer(VkBuffer buffer);
+		void buffer(vks::Buffer& buffer);
+		void image(VkImage image);
+		void imageView(VkImageView imageView);
+		void sampler(VkSampler sampler);
+		void framebuffer(VkFramebuffer framebuffer);
+		void pipeline(VkPipeline pipeline);
+		void descriptorPool(VkDescriptorPool descriptorPool);
+		void memory(VkDeviceMemory memory);
+		uint64_t currentSerial();
+		uint64_t frameSubmitted();
+		void collect(uint64_t completedSerial);
+		void flush();
+		size_t size();
+	};
+}
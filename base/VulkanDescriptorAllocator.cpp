@@ -0,0 +1,243 @@
+/*
+* Vulkan descriptor allocator
+*
+* Descriptor set allocation from growing chains of descriptor pools and a cache for descriptor set layouts
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanHitchDetector.h"
+#include "VulkanPipelineManifest.h"
+#include <algorithm>
+#include <cmath>
+
+namespace vks
+{
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the allocator, pools are created on the first allocation
+	*
+	* @param device Logical device to create the descriptor pools on
+	* @param (Optional) frameCount Number of frames whose sets are released separately by beginFrame (Defaults to one for a persistent allocator)
+	*/
+	void DescriptorAllocator::setup(VkDevice device, uint32_t frameCount)
+	{
+		this->device = device;
+		frames.resize(std::max(frameCount, 1u));
+		currentFrame = 0;
+		setsPerPool = initialSetsPerPool;
+	}
+
+	void DescriptorAllocator::nextPool(Frame& frame)
+	{
+		if (frame.currentPool != VK_NULL_HANDLE) {
+			frame.usedPools.push_back(frame.currentPool);
+		}
+		frame.allocatedSets = 0;
+		// Reuse a pool that has been released by a reset
+		if (!freePools.empty())
+		{
+			frame.currentPool = freePools.back().handle;
+			frame.maxSets = freePools.back().maxSets;
+			freePools.pop_back();
+			return;
+		}
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (auto& poolSizeRatio : poolSizeRatios) {
+			poolSizes.push_back(vks::initializers::descriptorPoolSize(poolSizeRatio.type, static_cast<uint32_t>(std::ceil(poolSizeRatio.ratio * setsPerPool))));
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, setsPerPool);
+		VkDescriptorPool pool;
+		// Allocating sets from existing pools is cheap, growing the chain in the middle of a frame isn't
+		HitchDetector::recordVulkanCall("vkCreateDescriptorPool");
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &pool));
+		pools.push_back({ pool, setsPerPool });
+		frame.currentPool = pool;
+		frame.maxSets = setsPerPool;
+		setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+	}
+
+	/**
+	* Allocate a descriptor set from the current frame's pools
+	*
+	* @param layout Layout of the descriptor set
+	* @param (Optional) pNext Extension structures for the allocation (e.g. variable descriptor counts)
+	*
+	* @return The allocated descriptor set, valid until the frame's pools are reset
+	*/
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* pNext)
+	{
+		assert(device != VK_NULL_HANDLE);
+		Frame& frame = frames[currentFrame];
+		if ((frame.currentPool == VK_NULL_HANDLE) || (frame.allocatedSets >= frame.maxSets)) {
+			nextPool(frame);
+		}
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(frame.currentPool, &layout, 1);
+		allocInfo.pNext = pNext;
+		VkDescriptorSet descriptorSet;
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+		if (result != VK_SUCCESS)
+		{
+			// The pool ran out of descriptors of one of the layout's types (VK_ERROR_OUT_OF_POOL_MEMORY, or an out of memory error on Vulkan 1.0), so chain a new pool and try again
+			nextPool(frame);
+			allocInfo.descriptorPool = frame.currentPool;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		}
+		frame.allocatedSets++;
+		return descriptorSet;
+	}
+
+	/** @brief Release all sets allocated for the current frame, its pools are reset and reused by later allocations */
+	void DescriptorAllocator::reset()
+	{
+		Frame& frame = frames[currentFrame];
+		if (frame.currentPool != VK_NULL_HANDLE) {
+			frame.usedPools.push_back(frame.currentPool);
+			frame.currentPool = VK_NULL_HANDLE;
+		}
+		for (auto pool : frame.usedPools)
+		{
+			VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0));
+			auto it = std::find_if(pools.begin(), pools.end(), [pool](const Pool& p) { return p.handle == pool; });
+			freePools.push_back(*it);
+		}
+		frame.usedPools.clear();
+		frame.allocatedSets = 0;
+		frame.maxSets = 0;
+	}
+
+	/**
+	* Start allocating for a frame in flight
+	*
+	* @param frameIndex Index of the frame in flight, the sets allocated the last time this frame was recorded are released
+	*
+	* @note Must only be called once the fence of the frame in flight has been waited on
+	*/
+	void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+	{
+		currentFrame = frameIndex % static_cast<uint32_t>(frames.size());
+		reset();
+	}
+
+	/** @brief Destroy all pools, which releases all sets allocated from them */
+	void DescriptorAllocator::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& pool : pools) {
+			vkDestroyDescriptorPool(device, pool.handle, nullptr);
+		}
+		pools.clear();
+		freePools.clear();
+		frames.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	bool DescriptorLayoutCache::Binding::operator==(const Binding& other) const
+	{
+		return (binding == other.binding) && (type == other.type) && (count == other.count) && (stages == other.stages) && (immutableSamplers == other.immutableSamplers);
+	}
+
+	bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+	{
+		return (flags == other.flags) && (bindings == other.bindings);
+	}
+
+	size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+	{
+		size_t hash = std::hash<uint32_t>()(key.flags);
+		auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+		for (auto& binding : key.bindings)
+		{
+			combine(binding.binding);
+			combine(static_cast<size_t>(binding.type));
+			combine(binding.count);
+			combine(binding.stages);
+			for (auto sampler : binding.immutableSamplers) {
+				combine(std::hash<VkSampler>()(sampler));
+			}
+		}
+		return hash;
+	}
+
+	DescriptorLayoutCache::~DescriptorLayoutCache()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the layout cache
+	*
+	* @param device Logical device to create the layouts on
+	*/
+	void DescriptorLayoutCache::setup(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	/**
+	* Get a descriptor set layout for the given bindings, the layout is only created if no identical one has been requested before
+	*
+	* @param bindings Bindings of the layout, their order doesn't matter
+	* @param (Optional) flags Create flags of the layout
+	*
+	* @return Descriptor set layout owned by the cache
+	*/
+	VkDescriptorSetLayout DescriptorLayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags)
+	{
+		LayoutKey key{};
+		key.flags = flags;
+		for (auto& binding : bindings)
+		{
+			Binding keyBinding{ binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, {} };
+			if (binding.pImmutableSamplers) {
+				keyBinding.immutableSamplers.assign(binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount);
+			}
+			key.bindings.push_back(keyBinding);
+		}
+		std::sort(key.bindings.begin(), key.bindings.end(), [](const Binding& a, const Binding& b) { return a.binding < b.binding; });
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = layouts.find(key);
+		if (it != layouts.end())
+		{
+			hits++;
+			return it->second;
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(bindings);
+		descriptorLayoutCI.flags = flags;
+		VkDescriptorSetLayout layout;
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &layout));
+		layouts[key] = layout;
+		return layout;
+	}
+
+	/** @brief Returns the number of layouts created by the cache */
+	uint32_t DescriptorLayoutCache::layoutCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<uint32_t>(layouts.size());
+	}
+
+	/** @brief Destroy all cached layouts */
+	void DescriptorLayoutCache::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& layout : layouts) {
+			vkDestroyDescriptorSetLayout(device, layout.second, nullptr);
+		}
+		layouts.clear();
+		device = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,143 @@
+/*
+* Vulkan descriptor allocator
+*
+* Descriptor set allocation from growing chains of descriptor pools and a cache for descriptor set layouts
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Descriptor set allocator that grows by chaining pools
+	*
+	* Sets are allocated from the current pool of the current frame, once that runs out of sets or descriptors, a new pool is chained
+	* (taken from the pools released by earlier resets if possible, otherwise created with twice the size of the previous one).
+	* Pools are sized from the ratios in poolSizeRatios, so no exact descriptor counts are required up front.
+	* Sets can't be freed individually, instead all sets of a frame are released at once by resetting its pools, which avoids fragmentation.
+	*
+	* With a frame count of one, the allocator is a persistent, growing replacement for a hand sized pool.
+	* With one frame per frame in flight, beginFrame releases the sets of the frame whose fence has just been waited on, so sets allocated
+	* while recording a frame (e.g. for dynamic objects) are transient and don't have to be tracked.
+	*
+	* @note Sets with more descriptors of a type than a whole pool provides (e.g. large texture arrays) need a dedicated pool
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Number of descriptors of a type per set in a pool */
+		struct PoolSizeRatio
+		{
+			VkDescriptorType type;
+			float ratio;
+		};
+
+	private:
+		struct Frame
+		{
+			std::vector<VkDescriptorPool> usedPools;
+			VkDescriptorPool currentPool = VK_NULL_HANDLE;
+			uint32_t allocatedSets = 0;
+			uint32_t maxSets = 0;
+		};
+		struct Pool
+		{
+			VkDescriptorPool handle;
+			uint32_t maxSets;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+		std::vector<Pool> freePools;
+		std::vector<Pool> pools;
+		uint32_t setsPerPool = 0;
+
+		void nextPool(Frame& frame);
+
+	public:
+		/** @brief Descriptors per set for each descriptor type in new pools, must be set before setup */
+		std::vector<PoolSizeRatio> poolSizeRatios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f },
+		};
+		/** @brief Number of sets in the first pool, each new pool doubles this up to maxSetsPerPool */
+		uint32_t initialSetsPerPool = 32;
+		uint32_t maxSetsPerPool = 4096;
+
+		~DescriptorAllocator();
+		void setup(VkDevice device, uint32_t frameCount = 1);
+		void destroy();
+		/** @brief Returns true if setup has been called */
+		bool isReady() const { return device != VK_NULL_HANDLE; }
+		void beginFrame(uint32_t frameIndex);
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* pNext = nullptr);
+		void reset();
+		/** @brief Number of descriptor pools created so far */
+		uint32_t getPoolCount() const { return static_cast<uint32_t>(pools.size()); }
+	};
+
+	/**
+	* @brief Cache for descriptor set layouts
+	*
+	* Layouts are looked up by their bindings (including immutable samplers) and flags, so identical layouts requested by different
+	* users (e.g. several model loaders) are only created once. The cache owns the layouts, they must not be destroyed by the users.
+	*
+	* @note Layouts with a pNext chain (e.g. binding flags) are not cached and have to be created directly
+	*/
+	class DescriptorLayoutCache
+	{
+	private:
+		struct Binding
+		{
+			uint32_t binding;
+			VkDescriptorType type;
+			uint32_t count;
+			VkShaderStageFlags stages;
+			std::vector<VkSampler> immutableSamplers;
+			bool operator==(const Binding& other) const;
+		};
+		struct LayoutKey
+		{
+			VkDescriptorSetLayoutCreateFlags flags;
+			std::vector<Binding> bindings;
+			bool operator==(const LayoutKey& other) const;
+		};
+		struct LayoutKeyHash
+		{
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		std::mutex mutex;
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+
+	public:
+		/** @brief Number of requests that were served from the cache */
+		uint32_t hits = 0;
+
+		~DescriptorLayoutCache();
+		void setup(VkDevice device);
+		VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+		uint32_t layoutCount();
+		void destroy();
+	};
+}
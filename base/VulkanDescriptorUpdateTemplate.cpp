@@ -0,0 +1,161 @@
+/*
+* Vulkan descriptor update template
+*
+* Descriptor set updates and push descriptors from packed structs of descriptor infos with a single call
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorUpdateTemplate.h"
+
+namespace vks
+{
+	DescriptorUpdateTemplate::~DescriptorUpdateTemplate()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the template and load the extension functions
+	*
+	* @param device Logical device with VK_KHR_descriptor_update_template enabled
+	*/
+	void DescriptorUpdateTemplate::setup(VkDevice device)
+	{
+		this->device = device;
+		vkCreateDescriptorUpdateTemplateKHR = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkCreateDescriptorUpdateTemplateKHR"));
+		vkDestroyDescriptorUpdateTemplateKHR = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(vkGetDeviceProcAddr(device, "vkDestroyDescriptorUpdateTemplateKHR"));
+		vkUpdateDescriptorSetWithTemplateKHR = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkUpdateDescriptorSetWithTemplateKHR"));
+		// Only available with VK_KHR_push_descriptor
+		vkCmdPushDescriptorSetWithTemplateKHR = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+		if (!vkCreateDescriptorUpdateTemplateKHR || !vkDestroyDescriptorUpdateTemplateKHR || !vkUpdateDescriptorSetWithTemplateKHR) {
+			vks::tools::exitFatal("Could not get valid function pointers for descriptor update templates", -1);
+		}
+		entries.clear();
+	}
+
+	/**
+	* Add a binding to the template, must be called before the template is created
+	*
+	* @param binding Binding in the descriptor set layout
+	* @param type Type of the descriptors
+	* @param offset Offset of the (first) descriptor info in the data passed to update or push
+	* @param (Optional) descriptorCount Number of consecutive array elements written from the data (Defaults to 1)
+	* @param (Optional) stride Distance in bytes between the infos of consecutive array elements (Defaults to the size of the type's info)
+	* @param (Optional) arrayElement First array element of the binding to write (Defaults to 0)
+	*/
+	void DescriptorUpdateTemplate::addEntry(uint32_t binding, VkDescriptorType type, size_t offset, uint32_t descriptorCount, size_t stride, uint32_t arrayElement)
+	{
+		assert(updateTemplate == VK_NULL_HANDLE);
+		if (stride == 0) {
+			switch (type) {
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+				stride = sizeof(VkDescriptorBufferInfo);
+				break;
+			case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+				stride = sizeof(VkBufferView);
+				break;
+			default:
+				stride = sizeof(VkDescriptorImageInfo);
+			}
+		}
+		VkDescriptorUpdateTemplateEntryKHR entry{};
+		entry.dstBinding = binding;
+		entry.dstArrayElement = arrayElement;
+		entry.descriptorCount = descriptorCount;
+		entry.descriptorType = type;
+		entry.offset = offset;
+		entry.stride = stride;
+		entries.push_back(entry);
+	}
+
+	void DescriptorUpdateTemplate::create(const VkDescriptorUpdateTemplateCreateInfoKHR& createInfo)
+	{
+		assert(device != VK_NULL_HANDLE);
+		assert(!entries.empty());
+		VK_CHECK_RESULT(vkCreateDescriptorUpdateTemplateKHR(device, &createInfo, nullptr, &updateTemplate));
+	}
+
+	/**
+	* Create a template for updating descriptor sets (see update)
+	*
+	* @param descriptorSetLayout Layout of the descriptor sets that will be updated with this template
+	*/
+	void DescriptorUpdateTemplate::create(VkDescriptorSetLayout descriptorSetLayout)
+	{
+		VkDescriptorUpdateTemplateCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		createInfo.pDescriptorUpdateEntries = entries.data();
+		createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+		createInfo.descriptorSetLayout = descriptorSetLayout;
+		create(createInfo);
+	}
+
+	/**
+	* Create a template for pushing descriptors inside a command buffer (see push)
+	*
+	* @param descriptorSetLayout Layout of the pushed set, created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR
+	* @param pipelineLayout Pipeline layout the descriptors will be pushed with
+	* @param bindPoint Pipeline bind point the descriptors will be pushed for
+	* @param set Set number of the push descriptor set in the pipeline layout
+	*/
+	void DescriptorUpdateTemplate::createForPushDescriptors(VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint, uint32_t set)
+	{
+		if (!vkCmdPushDescriptorSetWithTemplateKHR) {
+			vks::tools::exitFatal("Could not get a valid function pointer for vkCmdPushDescriptorSetWithTemplateKHR", -1);
+		}
+		VkDescriptorUpdateTemplateCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		createInfo.pDescriptorUpdateEntries = entries.data();
+		createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+		// Ignored for push descriptors, but still needs to be a layout compatible with the pushed set
+		createInfo.descriptorSetLayout = descriptorSetLayout;
+		createInfo.pipelineBindPoint = bindPoint;
+		createInfo.pipelineLayout = pipelineLayout;
+		createInfo.set = set;
+		create(createInfo);
+	}
+
+	/**
+	* Write all bindings of a descriptor set
+	*
+	* @param descriptorSet Descriptor set to update
+	* @param data Pointer to the descriptor infos, laid out as specified by the entries
+	*/
+	void DescriptorUpdateTemplate::update(VkDescriptorSet descriptorSet, const void* data) const
+	{
+		assert(updateTemplate != VK_NULL_HANDLE);
+		vkUpdateDescriptorSetWithTemplateKHR(device, descriptorSet, updateTemplate, data);
+	}
+
+	/**
+	* Push all bindings of the push descriptor set
+	*
+	* @param commandBuffer Command buffer to record the push into
+	* @param pipelineLayout Pipeline layout compatible with the one the template was created for
+	* @param set Set number of the push descriptor set
+	* @param data Pointer to the descriptor infos, laid out as specified by the entries (only read during this call)
+	*/
+	void DescriptorUpdateTemplate::push(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, const void* data) const
+	{
+		assert(updateTemplate != VK_NULL_HANDLE);
+		vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, updateTemplate, pipelineLayout, set, data);
+	}
+
+	void DescriptorUpdateTemplate::destroy()
+	{
+		if (updateTemplate != VK_NULL_HANDLE) {
+			vkDestroyDescriptorUpdateTemplateKHR(device, updateTemplate, nullptr);
+			updateTemplate = VK_NULL_HANDLE;
+		}
+		entries.clear();
+	}
+}
@@ -0,0 +1,57 @@
+/*
+* Vulkan descriptor update template
+*
+* Descriptor set updates and push descriptors from packed structs of descriptor infos with a single call
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Wrapper for a descriptor update template
+	*
+	* Each entry maps a binding of the set layout to the offset of its descriptor info (VkDescriptorBufferInfo, VkDescriptorImageInfo
+	* or VkBufferView) in a user defined struct, e.g.:
+	*	struct Descriptors { VkDescriptorBufferInfo matrices; VkDescriptorImageInfo texture; };
+	*	updateTemplate.addEntry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(Descriptors, matrices));
+	*	updateTemplate.addEntry(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof(Descriptors, texture));
+	* All bindings of a set are then written from such a struct with one call, without building VkWriteDescriptorSet arrays.
+	*
+	* @note Requires VK_KHR_descriptor_update_template (or Vulkan 1.1), pushing also requires VK_KHR_push_descriptor
+	*/
+	class DescriptorUpdateTemplate
+	{
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkDescriptorUpdateTemplateKHR updateTemplate = VK_NULL_HANDLE;
+		std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+		PFN_vkCreateDescriptorUpdateTemplateKHR vkCreateDescriptorUpdateTemplateKHR = nullptr;
+		PFN_vkDestroyDescriptorUpdateTemplateKHR vkDestroyDescriptorUpdateTemplateKHR = nullptr;
+		PFN_vkUpdateDescriptorSetWithTemplateKHR vkUpdateDescriptorSetWithTemplateKHR = nullptr;
+		PFN_vkCmdPushDescriptorSetWithTemplateKHR vkCmdPushDescriptorSetWithTemplateKHR = nullptr;
+
+		void create(const VkDescriptorUpdateTemplateCreateInfoKHR& createInfo);
+
+	public:
+		~DescriptorUpdateTemplate();
+		void setup(VkDevice device);
+		void addEntry(uint32_t binding, VkDescriptorType type, size_t offset, uint32_t descriptorCount = 1, size_t stride = 0, uint32_t arrayElement = 0);
+		void create(VkDescriptorSetLayout descriptorSetLayout);
+		void createForPushDescriptors(VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint, uint32_t set);
+		void update(VkDescriptorSet descriptorSet, const void* data) const;
+		void push(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, const void* data) const;
+		void destroy();
+		/** @brief Returns true if the template has been created */
+		bool isReady() const { return updateTemplate != VK_NULL_HANDLE; }
+	};
+}
@@ -9,6 +9,7 @@
 */
 
 #include <VulkanDevice.h>
+#include "VulkanHitchDetector.h"
 #include <unordered_set>
 
 namespace vks
@@ -30,6 +31,7 @@ namespace vks
 		vkGetPhysicalDeviceFeatures(physicalDevice, &features);
 		// Memory properties are used regularly for creating all kinds of buffers
 		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		memoryTypeLookup.setup(memoryProperties);
 		// Queue family properties, used for setting up requested queues upon device creation
 		uint32_t queueFamilyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -51,6 +53,28 @@ namespace vks
 				}
 			}
 		}
+
+		// Check if device local memory can be written by the host directly
+		// Discrete devices without resizable BAR only expose a small (usually 256 MByte) host visible window into device local memory, that should be left to the driver
+		// getMemoryType returns the first matching type, so that's the one that needs to live in a heap as large as the largest device local heap
+		VkDeviceSize deviceLocalHeapSize = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				deviceLocalHeapSize = std::max(deviceLocalHeapSize, memoryProperties.memoryHeaps[i].size);
+			}
+		}
+		const VkMemoryPropertyFlags directUploadFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((memoryProperties.memoryTypes[i].propertyFlags & directUploadFlags) == directUploadFlags)
+			{
+				directUpload.unifiedMemory = (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU);
+				directUpload.supported = directUpload.unifiedMemory || (memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size >= deviceLocalHeapSize);
+				break;
+			}
+		}
 	}
 
 	/** 
@@ -60,12 +84,28 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		if (logicalDevice)
+		{
+			updateAsyncUploads(true);
+			submitContext.destroy();
+			// Before the allocator and caches, as retired resources may return memory or samplers to them
+			deletionQueue.flush();
+		}
+		if (transferCommandPool && (transferCommandPool != commandPool))
+		{
+			vkDestroyCommandPool(logicalDevice, transferCommandPool, nullptr);
+		}
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 		}
 		if (logicalDevice)
 		{
+			stagingRing.destroy();
+			resourceCache.destroy();
+			descriptorAllocator.destroy();
+			descriptorLayoutCache.destroy();
+			memoryAllocator.destroy();
 			vkDestroyDevice(logicalDevice, nullptr);
 		}
 	}
@@ -83,31 +123,18 @@ namespace vks
 	*/
 	uint32_t VulkanDevice::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound) const
 	{
-		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-		{
-			if ((typeBits & 1) == 1)
-			{
-				if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-				{
-					if (memTypeFound)
-					{
-						*memTypeFound = true;
-					}
-					return i;
-				}
-			}
-			typeBits >>= 1;
-		}
-
+		uint32_t memoryTypeIndex = 0;
+		const bool found = memoryTypeLookup.find(typeBits, properties, &memoryTypeIndex);
 		if (memTypeFound)
 		{
-			*memTypeFound = false;
-			return 0;
+			*memTypeFound = found;
+			return memoryTypeIndex;
 		}
-		else
+		if (!found)
 		{
 			throw std::runtime_error("Could not find a matching memory type");
 		}
+		return memoryTypeIndex;
 	}
 
 	/**
@@ -271,6 +298,39 @@ namespace vks
 			enableDebugMarkers = true;
 		}
 
+		// Heap budgets are reported through the extended memory properties
+		if (getPhysicalDeviceMemoryProperties2 && extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+		{
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			memoryBudgetSupported = true;
+		}
+
+		// Render targets get a dedicated allocation if the implementation prefers it (see allocateRenderTargetMemory)
+		if (extensionSupported(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME) && extensionSupported(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME))
+		{
+			for (const char* extension : { VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME })
+			{
+				if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [extension](const char* enabled) { return strcmp(enabled, extension) == 0; }) == deviceExtensions.end()) {
+					deviceExtensions.push_back(extension);
+				}
+			}
+			dedicatedAllocationSupported = true;
+		}
+
+		// Used to place GPU timestamps on the host timeline of traces
+		if (extensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+		{
+			deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			calibratedTimestampsSupported = true;
+		}
+
+		// Used to tell pipeline cache hits from misses when measuring pipeline creation
+		if (extensionSupported(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME))
+		{
+			deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+			pipelineCreationFeedbackSupported = true;
+		}
+
 		if (deviceExtensions.size() > 0)
 		{
 			for (const char* enabledExtension : deviceExtensions)
@@ -292,9 +352,34 @@ namespace vks
 			return result;
 		}
 
+		if (dedicatedAllocationSupported)
+		{
+			getImageMemoryRequirements2 = reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetImageMemoryRequirements2KHR"));
+			dedicatedAllocationSupported = (getImageMemoryRequirements2 != nullptr);
+		}
+
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		// Asynchronous uploads are recorded for the transfer queue family, which can be the graphics family on devices without a separate transfer family
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndices.transfer, 0, &transferQueue);
+		transferCommandPool = (queueFamilyIndices.transfer != queueFamilyIndices.graphics) ? createCommandPool(queueFamilyIndices.transfer) : commandPool;
+
+		// One-shot command buffers from the device's own pools are recycled instead of being freed after each submission
+		submitContext.setup(logicalDevice);
+		submitContext.manage(commandPool);
+		submitContext.manage(transferCommandPool);
+
+		memoryAllocator.setup(logicalDevice, physicalDevice);
+		stagingRing.setup(logicalDevice, &memoryAllocator);
+		// If the staging ring runs full during an upload batch, the uploads recorded so far are submitted to free up its space
+		stagingRing.flushPending = [this]() { return flushUploadBatch(); };
+		resourceCache.setup(logicalDevice, &memoryAllocator);
+		descriptorLayoutCache.setup(logicalDevice);
+		descriptorAllocator.setup(logicalDevice);
+		deletionQueue.setup(logicalDevice);
+		updateMemoryBudget();
+
 		return result;
 	}
 
@@ -331,6 +416,7 @@ namespace vks
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
 			memAlloc.pNext = &allocFlagsInfo;
 		}
+		HitchDetector::recordVulkanCall("vkAllocateMemory");
 		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
 			
 		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
@@ -367,6 +453,8 @@ namespace vks
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*
+	* @note The memory is sub-allocated from memoryAllocator and must be released with vks::Buffer::destroy
 	*/
 	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
 	{
@@ -376,21 +464,13 @@ namespace vks
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle from one of the allocator's memory blocks and bind it
+		// Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set are placed in blocks allocated with the appropriate flag
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		VK_CHECK_RESULT(memoryAllocator.allocateBufferMemory(buffer->buffer, memoryPropertyFlags, (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0, &buffer->allocation));
+		memoryAllocator.tag(buffer->allocation, MemoryReport::bufferCategory(usageFlags));
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -411,8 +491,133 @@ namespace vks
 		// Initialize a default descriptor that covers the whole buffer size
 		buffer->setupDescriptor();
 
-		// Attach the memory to the buffer object
-		return buffer->bind();
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Allocate and bind memory of its own for a render target (attachment, G-Buffer, offscreen target, etc.)
+	*
+	* The allocation is made dedicated if the implementation prefers or requires that for the image (VK_KHR_dedicated_allocation) and gets renderTargetMemoryPriority
+	* if VK_EXT_memory_priority has been enabled, so render targets are the last to be moved out of device local memory when it's oversubscribed
+	*
+	* @param image Image to allocate the memory for
+	* @param memory Pointer to the memory handle that receives the allocation
+	* @param transient (Optional) Prefer lazily allocated memory, for attachments that are only used within a render pass (Defaults to false)
+	* @param size (Optional) Receives the size of the allocation, zero if lazily allocated memory has been used (which may never be committed)
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound to the image
+	*/
+	VkResult VulkanDevice::allocateRenderTargetMemory(VkImage image, VkDeviceMemory *memory, bool transient, VkDeviceSize *size)
+	{
+		VkMemoryRequirements memReqs;
+		VkMemoryDedicatedRequirementsKHR dedicatedRequirements{};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+		if (dedicatedAllocationSupported)
+		{
+			VkImageMemoryRequirementsInfo2KHR requirementsInfo{};
+			requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+			requirementsInfo.image = image;
+			VkMemoryRequirements2KHR memReqs2{};
+			memReqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+			memReqs2.pNext = &dedicatedRequirements;
+			getImageMemoryRequirements2(logicalDevice, &requirementsInfo, &memReqs2);
+			memReqs = memReqs2.memoryRequirements;
+		}
+		else
+		{
+			vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		}
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		VkBool32 lazyMemTypePresent = VK_FALSE;
+		if (transient)
+		{
+			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemTypePresent);
+		}
+		if (!lazyMemTypePresent)
+		{
+			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+
+		const void **pNext = &memAlloc.pNext;
+		VkMemoryDedicatedAllocateInfoKHR dedicatedAllocateInfo{};
+		if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation)
+		{
+			dedicatedAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+			dedicatedAllocateInfo.image = image;
+			*pNext = &dedicatedAllocateInfo;
+			pNext = &dedicatedAllocateInfo.pNext;
+		}
+		VkMemoryPriorityAllocateInfoEXT priorityAllocateInfo{};
+		if (memoryPrioritySupported)
+		{
+			priorityAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT;
+			priorityAllocateInfo.priority = renderTargetMemoryPriority;
+			*pNext = &priorityAllocateInfo;
+		}
+
+		HitchDetector::recordVulkanCall("vkAllocateMemory");
+		VkResult result = vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		if (size)
+		{
+			*size = lazyMemTypePresent ? 0 : memReqs.size;
+		}
+		return vkBindImageMemory(logicalDevice, image, *memory, 0);
+	}
+
+	/**
+	* Check if uploads to device local buffers can write directly to host visible device local memory instead of going through the staging ring
+	*/
+	bool VulkanDevice::directUploadAvailable() const
+	{
+		return directUpload.supported && directUpload.enabled;
+	}
+
+	/**
+	* Create a device local buffer and upload data to it
+	*
+	* With unified memory or resizable BAR (see directUpload) the data is written directly to the mapped buffer, saving the staging copy and the transfer
+	* Otherwise the data is copied from the staging ring, which requires no extra usage flags from the caller as transfer destination usage is added here
+	*
+	* @param usageFlags Usage flag bit mask for the buffer (i.e. index, vertex, storage buffer)
+	* @param buffer Pointer to a vk::Vulkan buffer object
+	* @param size Size of the buffer in bytes
+	* @param data Pointer to the data that should be uploaded to the buffer (optional)
+	* @param queue Queue used for the staged copy
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been uploaded
+	*/
+	VkResult VulkanDevice::createDeviceLocalBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, const void *data, VkQueue queue)
+	{
+		if (directUploadAvailable())
+		{
+			VK_CHECK_RESULT(createBuffer(usageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, size, const_cast<void*>(data)));
+			if (data != nullptr)
+			{
+				directUpload.bytesWritten += size;
+			}
+			return VK_SUCCESS;
+		}
+
+		VK_CHECK_RESULT(createBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, size));
+		if (data != nullptr)
+		{
+			vks::StagingRing::Allocation staging = stagingRing.allocate(size);
+			memcpy(staging.data, data, size);
+			VkCommandBuffer copyCmd = beginUpload();
+			VkBufferCopy copyRegion = {};
+			copyRegion.srcOffset = staging.offset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(copyCmd, staging.buffer, buffer->buffer, 1, &copyRegion);
+			finishBufferUpload(copyCmd, buffer->buffer);
+			endUpload(copyCmd, queue);
+		}
+		return VK_SUCCESS;
 	}
 
 	/**
@@ -424,12 +629,13 @@ namespace vks
 	* @param copyRegion (Optional) Pointer to a copy region, if NULL, the whole buffer is copied
 	*
 	* @note Source and destination pointers must have the appropriate transfer usage flags set (TRANSFER_SRC / TRANSFER_DST)
+	* @note Inside an (asynchronous) upload batch the copy is recorded into the batch
 	*/
 	void VulkanDevice::copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion)
 	{
 		assert(dst->size <= src->size);
 		assert(src->buffer);
-		VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = beginUpload();
 		VkBufferCopy bufferCopy{};
 		if (copyRegion == nullptr)
 		{
@@ -441,8 +647,9 @@ namespace vks
 		}
 
 		vkCmdCopyBuffer(copyCmd, src->buffer, dst->buffer, 1, &bufferCopy);
+		finishBufferUpload(copyCmd, dst->buffer, bufferCopy.dstOffset, bufferCopy.size);
 
-		flushCommandBuffer(copyCmd, queue);
+		endUpload(copyCmd, queue);
 	}
 
 	/** 
@@ -477,6 +684,11 @@ namespace vks
 	*/
 	VkCommandBuffer VulkanDevice::createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin)
 	{
+		// Primary command buffers come from the submit context, which hands out recycled ones for the device's own pools
+		if (level == VK_COMMAND_BUFFER_LEVEL_PRIMARY)
+		{
+			return submitContext.allocate(pool, begin);
+		}
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(pool, level, 1);
 		VkCommandBuffer cmdBuffer;
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
@@ -503,7 +715,7 @@ namespace vks
 	* @param free (Optional) Free the command buffer once it has been submitted (Defaults to true)
 	*
 	* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
-	* @note Uses a fence to ensure command buffer has finished executing
+	* @note Waits for the command buffer to finish executing, use submitContext directly to get a ticket instead of blocking
 	*/
 	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)
 	{
@@ -514,27 +726,329 @@ namespace vks
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
+		// The fence comes from the submit context and the command buffer is returned to it (or freed, if the pool isn't managed by the device) once it has finished executing
+		const uint64_t ticket = submitContext.submit(queue, commandBuffer, free ? pool : VK_NULL_HANDLE);
+		submitContext.wait(ticket);
+	}
+
+	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free)
+	{
+		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
+	}
+
+	/**
+	* Get a command buffer to record upload commands (e.g. copies from the staging ring) to
+	*
+	* @return The command buffer of the current upload batch if one is active, otherwise a new command buffer that's ready for recording
+	*
+	* @note Must be followed by a call to endUpload
+	*/
+	VkCommandBuffer VulkanDevice::beginUpload()
+	{
+		if (asyncUploadBatch.active)
+		{
+			return asyncUploadBatch.commandBuffer;
+		}
+		if (uploadBatch.depth > 0)
+		{
+			return uploadBatch.commandBuffer;
+		}
+		return createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	}
+
+	/**
+	* Finish recording upload commands
+	*
+	* @param commandBuffer Command buffer returned by beginUpload
+	* @param queue Queue to submit the command buffer to
+	*
+	* @note Outside of an upload batch the command buffer is submitted and waited on, inside a batch the commands are submitted with the batch
+	*/
+	void VulkanDevice::endUpload(VkCommandBuffer commandBuffer, VkQueue queue)
+	{
+		if (asyncUploadBatch.active)
+		{
+			assert(commandBuffer == asyncUploadBatch.commandBuffer);
+			return;
+		}
+		if (uploadBatch.depth > 0)
+		{
+			assert(commandBuffer == uploadBatch.commandBuffer);
+			return;
+		}
+		flushCommandBuffer(commandBuffer, queue);
+		// The copies have finished, so the staging memory used by them can be reused right away
+		stagingRing.submit(VK_NULL_HANDLE);
+	}
+
+	/**
+	* Start a batch of uploads, all uploads until the matching endUploadBatch are recorded into a single command buffer and submitted at once
+	*
+	* @param queue Queue to submit the batch to
+	*
+	* @note Batches can be nested, only the outermost batch is submitted
+	* @note Resources uploaded within a batch must not be used by the device before the batch has ended
+	* @note Can't be used while an asynchronous upload batch is being recorded
+	*/
+	void VulkanDevice::beginUploadBatch(VkQueue queue)
+	{
+		assert(!asyncUploadBatch.active);
+		if (uploadBatch.depth++ == 0)
+		{
+			uploadBatch.commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			uploadBatch.queue = queue;
+		}
+	}
+
+	/** @brief End an upload batch, the outermost batch submits all recorded uploads and waits for them to finish */
+	void VulkanDevice::endUploadBatch()
+	{
+		assert(uploadBatch.depth > 0);
+		if (--uploadBatch.depth == 0)
+		{
+			flushCommandBuffer(uploadBatch.commandBuffer, uploadBatch.queue);
+			stagingRing.submit(VK_NULL_HANDLE);
+			uploadBatch.commandBuffer = VK_NULL_HANDLE;
+			uploadBatch.queue = VK_NULL_HANDLE;
+		}
+	}
+
+	/**
+	* Submit the uploads recorded so far in the current batch and continue recording in the same command buffer
+	*
+	* @return True if an upload batch was active and has been flushed
+	*/
+	bool VulkanDevice::flushUploadBatch()
+	{
+		if (uploadBatch.depth == 0)
+		{
+			return false;
+		}
+		flushCommandBuffer(uploadBatch.commandBuffer, uploadBatch.queue, false);
+		stagingRing.submit(VK_NULL_HANDLE);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(uploadBatch.commandBuffer, &cmdBufInfo));
+		return true;
+	}
+
+	/**
+	* Transition an image that has been uploaded to its final layout
+	*
+	* @param commandBuffer Command buffer returned by beginUpload
+	* @param image Image that has been uploaded
+	* @param oldLayout Layout of the image during the upload
+	* @param newLayout Layout the image will be used in
+	* @param subresourceRange Range of the image that has been uploaded
+	*
+	* @note Inside an asynchronous upload batch on a separate transfer queue family this records the release half of a queue family ownership transfer
+	* to the graphics family, the matching acquire is submitted to the graphics queue once the transfer has finished
+	*/
+	void VulkanDevice::finishImageUpload(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageSubresourceRange subresourceRange)
+	{
+		if (!asyncUploadBatch.active || (queueFamilyIndices.transfer == queueFamilyIndices.graphics))
+		{
+			vks::tools::setImageLayout(commandBuffer, image, oldLayout, newLayout, subresourceRange);
+			return;
+		}
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.oldLayout = oldLayout;
+		imageMemoryBarrier.newLayout = newLayout;
+		imageMemoryBarrier.srcQueueFamilyIndex = queueFamilyIndices.transfer;
+		imageMemoryBarrier.dstQueueFamilyIndex = queueFamilyIndices.graphics;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		// Release: Only the source access needs to be specified, the destination access is ignored for the releasing queue family
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		// Acquire: Recorded on the graphics queue with the same layouts and queue family indices
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) ? VK_ACCESS_SHADER_READ_BIT : (VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+		asyncUploadBatch.imageBarriers.push_back(imageMemoryBarrier);
+	}
+
+	/**
+	* Finish the upload of a buffer (range)
+	*
+	* @param commandBuffer Command buffer returned by beginUpload
+	* @param buffer Buffer that has been uploaded to
+	* @param offset (Optional) Start of the range that has been uploaded
+	* @param size (Optional) Size of the range that has been uploaded
+	*
+	* @note Only records something inside an asynchronous upload batch on a separate transfer queue family (see finishImageUpload)
+	*/
+	void VulkanDevice::finishBufferUpload(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (!asyncUploadBatch.active || (queueFamilyIndices.transfer == queueFamilyIndices.graphics))
+		{
+			return;
+		}
+		VkBufferMemoryBarrier bufferMemoryBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferMemoryBarrier.srcQueueFamilyIndex = queueFamilyIndices.transfer;
+		bufferMemoryBarrier.dstQueueFamilyIndex = queueFamilyIndices.graphics;
+		bufferMemoryBarrier.buffer = buffer;
+		bufferMemoryBarrier.offset = offset;
+		bufferMemoryBarrier.size = size;
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+		bufferMemoryBarrier.srcAccessMask = 0;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		asyncUploadBatch.bufferBarriers.push_back(bufferMemoryBarrier);
+	}
+
+	/**
+	* Start recording an asynchronous upload batch, all uploads until endAsyncUploadBatch are recorded for the transfer queue
+	*
+	* @note Uploads recorded in an asynchronous batch must only use transfer commands and finishImageUpload/finishBufferUpload for their final transitions (no blits for mip generation)
+	*/
+	void VulkanDevice::beginAsyncUploadBatch()
+	{
+		assert(!asyncUploadBatch.active && (uploadBatch.depth == 0));
+		asyncUploadBatch.commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool, true);
+		asyncUploadBatch.active = true;
+	}
+
+	/**
+	* Submit the current asynchronous upload batch to the transfer queue without waiting for it
+	*
+	* @param queue Graphics queue that will use the uploaded resources
+	*
+	* @return Id of the upload, pass it to asyncUploadComplete to check if the resources can be used
+	*
+	* @note The transfer signals a semaphore that the graphics queue waits on, together with the ownership acquire this is submitted by updateAsyncUploads once the transfer has finished.
+	* So rendering never waits for the transfer, call updateAsyncUploads regularly (e.g. once per frame)
+	*/
+	uint64_t VulkanDevice::endAsyncUploadBatch(VkQueue queue)
+	{
+		assert(asyncUploadBatch.active);
+		VK_CHECK_RESULT(vkEndCommandBuffer(asyncUploadBatch.commandBuffer));
+
+		AsyncUpload upload{};
+		upload.id = ++asyncUploadSubmitted;
+		upload.queue = queue;
+		upload.transferCommandBuffer = asyncUploadBatch.commandBuffer;
+		upload.imageBarriers = std::move(asyncUploadBatch.imageBarriers);
+		upload.bufferBarriers = std::move(asyncUploadBatch.bufferBarriers);
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		VK_CHECK_RESULT(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &upload.semaphore));
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+		VkFence transferFence;
+		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceCreateInfo, nullptr, &transferFence));
+		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceCreateInfo, nullptr, &upload.acquireFence));
+
 		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		// Create fence to ensure that the command buffer has finished executing
-		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-		VkFence fence;
-		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
-		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-		// Wait for the fence to signal that command buffer has finished executing
-		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-		vkDestroyFence(logicalDevice, fence, nullptr);
-		if (free)
+		submitInfo.pCommandBuffers = &upload.transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &upload.semaphore;
+		VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, transferFence));
+		// The staging memory used by the batch is released by the ring once the transfer fence has been signaled
+		upload.transferSerial = stagingRing.submit(transferFence);
+		asyncUploads.push_back(std::move(upload));
+
+		asyncUploadBatch.commandBuffer = VK_NULL_HANDLE;
+		asyncUploadBatch.imageBarriers.clear();
+		asyncUploadBatch.bufferBarriers.clear();
+		asyncUploadBatch.active = false;
+		return asyncUploadSubmitted;
+	}
+
+	/**
+	* Make finished asynchronous uploads available to the graphics queue and release the resources of uploads the device is done with
+	*
+	* @param wait (Optional) Wait for all submitted uploads to finish (Defaults to false)
+	*/
+	void VulkanDevice::updateAsyncUploads(bool wait)
+	{
+		for (auto& upload : asyncUploads)
 		{
-			vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer);
+			if (upload.acquired)
+			{
+				continue;
+			}
+			if (wait)
+			{
+				stagingRing.wait(upload.transferSerial);
+			}
+			else if (!stagingRing.complete(upload.transferSerial))
+			{
+				break;
+			}
+			// The transfer has finished, so the graphics queue's wait on the semaphore won't stall rendering
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &upload.semaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			if (!upload.imageBarriers.empty() || !upload.bufferBarriers.empty())
+			{
+				upload.acquireCommandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				vkCmdPipelineBarrier(
+					upload.acquireCommandBuffer,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					0,
+					0, nullptr,
+					static_cast<uint32_t>(upload.bufferBarriers.size()), upload.bufferBarriers.data(),
+					static_cast<uint32_t>(upload.imageBarriers.size()), upload.imageBarriers.data());
+				VK_CHECK_RESULT(vkEndCommandBuffer(upload.acquireCommandBuffer));
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &upload.acquireCommandBuffer;
+			}
+			VK_CHECK_RESULT(vkQueueSubmit(upload.queue, 1, &submitInfo, upload.acquireFence));
+			upload.acquired = true;
+			asyncUploadCompleted = upload.id;
+		}
+		while (!asyncUploads.empty() && asyncUploads.front().acquired)
+		{
+			AsyncUpload& upload = asyncUploads.front();
+			if (wait)
+			{
+				VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &upload.acquireFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			}
+			else if (vkGetFenceStatus(logicalDevice, upload.acquireFence) != VK_SUCCESS)
+			{
+				break;
+			}
+			vkFreeCommandBuffers(logicalDevice, transferCommandPool, 1, &upload.transferCommandBuffer);
+			if (upload.acquireCommandBuffer)
+			{
+				vkFreeCommandBuffers(logicalDevice, commandPool, 1, &upload.acquireCommandBuffer);
+			}
+			vkDestroySemaphore(logicalDevice, upload.semaphore, nullptr);
+			vkDestroyFence(logicalDevice, upload.acquireFence, nullptr);
+			asyncUploads.pop_front();
 		}
 	}
 
-	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free)
+	/**
+	* Check if the resources of an asynchronous upload can be used
+	*
+	* @param id Id returned by endAsyncUploadBatch
+	*
+	* @return True if the upload has been made available to the graphics queue, work submitted to that queue afterwards can use its resources
+	*/
+	bool VulkanDevice::asyncUploadComplete(uint64_t id)
 	{
-		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
+		updateAsyncUploads();
+		return asyncUploadCompleted >= id;
+	}
+
+	/** @brief Block until the asynchronous upload with the given id (and all uploads submitted before it) can be used */
+	void VulkanDevice::waitAsyncUpload(uint64_t id)
+	{
+		while (!asyncUploadComplete(id))
+		{
+			for (auto& upload : asyncUploads)
+			{
+				if (!upload.acquired)
+				{
+					stagingRing.wait(upload.transferSerial);
+					break;
+				}
+			}
+		}
 	}
 
 	/**
@@ -549,6 +1063,41 @@ namespace vks
 		return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
 	}
 
+	/**
+	* Check if compute shaders support the given subgroup operations (GL_KHR_shader_subgroup / wave intrinsics)
+	*
+	* @param operations Subgroup operations used by the shaders, e.g. VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT
+	*
+	* @return The smallest subgroup size compute shaders may run with, for sizing shared memory per subgroup, or 0 if the operations aren't supported
+	*
+	* @note Subgroup operations require Vulkan 1.1, so the instance needs to have been created with an api version of 1.1 or later
+	*/
+	uint32_t VulkanDevice::getComputeSubgroupSize(VkSubgroupFeatureFlags operations)
+	{
+		if (properties.apiVersion < VK_API_VERSION_1_1) {
+			return 0;
+		}
+		VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		// Devices with subgroup size control may run compute shaders with smaller subgroups than the reported default
+		VkPhysicalDeviceSubgroupSizeControlPropertiesEXT subgroupSizeControlProperties{};
+		subgroupSizeControlProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES_EXT;
+		if (extensionSupported(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME)) {
+			subgroupProperties.pNext = &subgroupSizeControlProperties;
+		}
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+		if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || ((subgroupProperties.supportedOperations & operations) != operations)) {
+			return 0;
+		}
+		if (subgroupSizeControlProperties.minSubgroupSize > 0) {
+			return std::min(subgroupProperties.subgroupSize, subgroupSizeControlProperties.minSubgroupSize);
+		}
+		return subgroupProperties.subgroupSize;
+	}
+
 	/**
 	* Select the best-fit depth format for this device from a list of possible depth (and stencil) formats
 	*
@@ -580,4 +1129,156 @@ namespace vks
 		throw std::runtime_error("Could not find a matching depth format");
 	}
 
+	/**
+	* Get the budget and usage of all memory heaps
+	*
+	* @param budgets Budget and usage of each heap
+	*
+	* @note With VK_EXT_memory_budget, the values cover all allocations of the process and account for other processes using the device.
+	* Without it, the budget is the size of the heap and the usage only covers the blocks of the memory allocator.
+	*/
+	void VulkanDevice::queryMemoryBudget(std::vector<HeapBudget>& budgets)
+	{
+		budgets.resize(memoryProperties.memoryHeapCount);
+		if (memoryBudgetSupported)
+		{
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memoryProperties2.pNext = &budgetProperties;
+			getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+				budgets[i] = { budgetProperties.heapBudget[i], budgetProperties.heapUsage[i] };
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+				budgets[i] = { memoryProperties.memoryHeaps[i].size, memoryAllocator.getHeapUsage(i) };
+			}
+		}
+	}
+
+	/** @brief Update the budget and usage of all memory heaps (see heapBudgets), e.g. once per frame for display */
+	void VulkanDevice::updateMemoryBudget()
+	{
+		queryMemoryBudget(heapBudgets);
+	}
+
+	/**
+	* Get the memory pressure of the most used heap with the given flags
+	*
+	* @param (Optional) heapFlags Flags of the heaps to check (Defaults to device local heaps)
+	*
+	* @return Usage divided by budget of the most used matching heap, values close to or above 1.0 mean that allocations are likely to fail
+	*
+	* @note Queries the current budget, but doesn't touch heapBudgets, so it can be called by loaders running on other threads
+	*/
+	float VulkanDevice::getMemoryPressure(VkMemoryHeapFlags heapFlags)
+	{
+		std::vector<HeapBudget> budgets;
+		queryMemoryBudget(budgets);
+		float pressure = 0.0f;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			if (((memoryProperties.memoryHeaps[i].flags & heapFlags) == heapFlags) && (budgets[i].budget > 0)) {
+				pressure = std::max(pressure, static_cast<float>(static_cast<double>(budgets[i].usage) / static_cast<double>(budgets[i].budget)));
+			}
+		}
+		return pressure;
+	}
+
+	/**
+	* Allow defragmentation to move a device local buffer (see defragment)
+	*
+	* A moved buffer is replaced by a new buffer with the same size and usage, the old one is retired through the deletion queue
+	*
+	* @param buffer Buffer created by createBuffer or createDeviceLocalBuffer, must stay at the same address until it's destroyed
+	* @param moved (Optional) Called after each move with the updated buffer, so the owner can update descriptors and command buffers referencing the old handle
+	*/
+	void VulkanDevice::setMovable(vks::Buffer *buffer, std::function<void(vks::Buffer &)> moved)
+	{
+		memoryAllocator.setMovable(buffer->allocation, [this, buffer, moved](const vks::Allocation &destination, VkCommandBuffer commandBuffer) {
+			// The buffer may not have been created with transfer usage, so the contents are copied through transfer only buffers aliasing the old and the new memory
+			VkBufferCreateInfo transferBufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer->size);
+			VkBuffer source, target;
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &transferBufferInfo, nullptr, &source));
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &transferBufferInfo, nullptr, &target));
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(logicalDevice, source, &memReqs);
+			// Transfer only buffers don't have stricter requirements than buffers with any other usage
+			assert((buffer->allocation.offset % memReqs.alignment == 0) && (destination.offset % memReqs.alignment == 0) && (memReqs.size <= destination.size));
+			VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, source, buffer->allocation.memory, buffer->allocation.offset));
+			VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, target, destination.memory, destination.offset));
+			VkBufferCopy copyRegion = { 0, 0, buffer->size };
+			vkCmdCopyBuffer(commandBuffer, source, target, 1, &copyRegion);
+
+			// Same create info as the old buffer, so the memory requirements the destination has been planned with apply
+			VkBuffer newBuffer;
+			VkBufferCreateInfo bufferInfo = vks::initializers::bufferCreateInfo(buffer->usageFlags, buffer->size);
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &newBuffer));
+			VK_CHECK_RESULT(vkBindBufferMemory(logicalDevice, newBuffer, destination.memory, destination.offset));
+
+			// Frames in flight and the copy still use the old memory
+			vks::Buffer retired = *buffer;
+			VkDevice device = logicalDevice;
+			deletionQueue.push([device, retired, source, target]() mutable {
+				vkDestroyBuffer(device, source, nullptr);
+				vkDestroyBuffer(device, target, nullptr);
+				retired.destroy();
+			});
+
+			buffer->buffer = newBuffer;
+			buffer->memory = destination.memory;
+			buffer->allocation = destination;
+			buffer->descriptor.buffer = newBuffer;
+			memoryAllocator.tag(destination, MemoryReport::bufferCategory(buffer->usageFlags));
+			setMovable(buffer, moved);
+			if (moved) {
+				moved(*buffer);
+			}
+		});
+	}
+
+	/**
+	* Run an incremental defragmentation step, that moves up to maxBytes of movable allocations (see setMovable) out of the least used memory blocks
+	*
+	* The copies are submitted to the queue without waiting, so the step should be run after the fence of the current frame has been waited on and before
+	* its command buffers are submitted. The moved resources are retired through the deletion queue, so the emptied blocks are released a few frames later.
+	*
+	* @param queue Queue to submit the copies to, must be the queue the resources are used on
+	* @param maxBytes Number of bytes that may be copied by this step
+	*
+	* @return Number of bytes moved
+	*/
+	VkDeviceSize VulkanDevice::defragment(VkQueue queue, VkDeviceSize maxBytes)
+	{
+		std::vector<MemoryAllocator::Move> moves = memoryAllocator.planDefragmentation(maxBytes);
+		if (moves.empty())
+		{
+			return 0;
+		}
+		VkCommandBuffer commandBuffer = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Writes of earlier submissions to the moved resources need to be done before they are copied
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VkDeviceSize bytesMoved = 0;
+		for (auto &move : moves)
+		{
+			move.move(move.destination, commandBuffer);
+			bytesMoved += move.destination.size;
+		}
+		// The copies need to be done before following submissions use the new resources
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		// Not waited on, the command buffer is recycled by the submit context once it has finished
+		submitContext.update();
+		submitContext.submit(queue, commandBuffer, commandPool);
+		return bytesMoved;
+	}
 };
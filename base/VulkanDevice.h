@@ -11,11 +11,19 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanStagingRing.h"
+#include "VulkanSubmitContext.h"
+#include "VulkanResourceCache.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDeletionQueue.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <exception>
+#include <vector>
 
 namespace vks
 {
@@ -33,12 +41,105 @@ struct VulkanDevice
 	VkPhysicalDeviceFeatures enabledFeatures;
 	/** @brief Memory types and heaps of the physical device */
 	VkPhysicalDeviceMemoryProperties memoryProperties;
+	/** @brief Memory types matching each combination of property flags, used by getMemoryType */
+	vks::MemoryTypeLookup memoryTypeLookup;
 	/** @brief Queue family properties of the physical device */
 	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 	/** @brief List of extensions supported by the device */
 	std::vector<std::string> supportedExtensions;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Queue of the transfer queue family (a dedicated one if the device has it), used for asynchronous uploads */
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	/** @brief Command pool for the transfer queue family index (same as commandPool if there is no separate transfer family) */
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	/** @brief Sub-allocator used for the memory of vks::Buffer objects and textures */
+	vks::MemoryAllocator memoryAllocator;
+	/** @brief Persistently mapped staging memory shared by all upload paths */
+	vks::StagingRing stagingRing;
+	/** @brief Recycles the command buffers and fences of one-shot submissions (see createCommandBuffer and flushCommandBuffer) */
+	vks::SubmitContext submitContext;
+	/** @brief Images and samplers shared between all loaders (e.g. the textures of several glTF models) */
+	vks::ResourceCache resourceCache;
+	/** @brief Descriptor set layouts shared between all users of the device (e.g. the layouts of all glTF models) */
+	vks::DescriptorLayoutCache descriptorLayoutCache;
+	/** @brief Growing descriptor allocator for sets that live as long as the device */
+	vks::DescriptorAllocator descriptorAllocator;
+	/** @brief Resources replaced at runtime, destroyed once the frames that may still use them have finished (collected by the example base class) */
+	vks::DeletionQueue deletionQueue;
+	/** @brief Command buffer and queue of the current upload batch (if any) */
+	struct
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t depth = 0;
+	} uploadBatch;
+	/** @brief Transfer command buffer and the queue family ownership acquire barriers of the asynchronous upload batch being recorded (if any) */
+	struct
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		bool active = false;
+	} asyncUploadBatch;
+	/** @brief An asynchronous upload batch that has been submitted to the transfer queue */
+	struct AsyncUpload
+	{
+		uint64_t id;
+		VkQueue queue;
+		VkCommandBuffer transferCommandBuffer;
+		VkCommandBuffer acquireCommandBuffer;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		VkSemaphore semaphore;
+		/** @brief Serial of the staging ring region, which is tracked by the fence the transfer was submitted with */
+		uint64_t transferSerial;
+		VkFence acquireFence;
+		bool acquired;
+	};
+	std::deque<AsyncUpload> asyncUploads;
+	/** @brief Id of the last asynchronous upload batch submitted / made available to the graphics queue, ids increase monotonically like a timeline */
+	uint64_t asyncUploadSubmitted = 0;
+	uint64_t asyncUploadCompleted = 0;
+	/** @brief Budget and usage of a memory heap in bytes */
+	struct HeapBudget
+	{
+		VkDeviceSize budget;
+		VkDeviceSize usage;
+	};
+	/** @brief Budget and usage of each memory heap as of the last call to updateMemoryBudget */
+	std::vector<HeapBudget> heapBudgets;
+	/** @brief Set to true if VK_EXT_memory_budget has been enabled, otherwise heap budgets are the heap sizes and usage only covers the memory allocator */
+	bool memoryBudgetSupported = false;
+	/** @brief Needs to be set before createLogicalDevice for the memory budget to be queried (requires VK_KHR_get_physical_device_properties2 or Vulkan 1.1) */
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+	/** @brief Set to true if VK_KHR_dedicated_allocation has been enabled, used for render targets the implementation prefers dedicated allocations for */
+	bool dedicatedAllocationSupported = false;
+	PFN_vkGetImageMemoryRequirements2KHR getImageMemoryRequirements2 = nullptr;
+	/** @brief Set to true if VK_EXT_memory_priority and its feature have been enabled (by the example base class, as the feature needs to be queried first) */
+	bool memoryPrioritySupported = false;
+	/** @brief Priority of render target allocations (see allocateRenderTargetMemory), other allocations keep the default priority of 0.5 */
+	float renderTargetMemoryPriority = 1.0f;
+	/** @brief Set to true if VK_EXT_calibrated_timestamps has been enabled, so device timestamps can be related to host clocks */
+	bool calibratedTimestampsSupported = false;
+	/** @brief Set to true if VK_EXT_pipeline_creation_feedback has been enabled, so pipeline cache hits can be reported */
+	bool pipelineCreationFeedbackSupported = false;
+	/** @brief Set to true if VK_EXT_texture_compression_astc_hdr and its feature have been enabled (see VulkanExampleBase::enableCompressedHDRTextures) */
+	bool textureCompressionASTCHDRSupported = false;
+	/** @brief Host visible device local memory that can be written to directly instead of staging uploads (see createDeviceLocalBuffer) */
+	struct
+	{
+		/** @brief Set if the first host visible and coherent device local memory type covers the largest device local heap (unified memory or resizable BAR) */
+		bool supported = false;
+		/** @brief Set for integrated devices, where all memory is shared with the host */
+		bool unifiedMemory = false;
+		/** @brief Can be cleared to compare against staged uploads */
+		bool enabled = true;
+		/** @brief Number of bytes written directly into device local memory */
+		VkDeviceSize bytesWritten = 0;
+	} directUpload;
+	/** @brief Memory pressure (see getMemoryPressure) above which loaders should save memory, e.g. by skipping the largest mip levels */
+	float memoryPressureThreshold = 0.9f;
 	/** @brief Set to true when the debug marker extension is detected */
 	bool enableDebugMarkers = false;
 	/** @brief Contains queue family indices */
@@ -56,16 +157,37 @@ struct VulkanDevice
 	~VulkanDevice();
 	uint32_t        getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr) const;
 	uint32_t        getQueueFamilyIndex(VkQueueFlagBits queueFlags) const;
-	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createDeviceLocalBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, const void *data, VkQueue queue);
+	VkResult        allocateRenderTargetMemory(VkImage image, VkDeviceMemory *memory, bool transient = false, VkDeviceSize *size = nullptr);
+	bool            directUploadAvailable() const;
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
+	VkCommandBuffer beginUpload();
+	void            endUpload(VkCommandBuffer commandBuffer, VkQueue queue);
+	void            beginUploadBatch(VkQueue queue);
+	void            endUploadBatch();
+	bool            flushUploadBatch();
+	void            finishImageUpload(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageSubresourceRange subresourceRange);
+	void            finishBufferUpload(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void            beginAsyncUploadBatch();
+	uint64_t        endAsyncUploadBatch(VkQueue queue);
+	void            updateAsyncUploads(bool wait = false);
+	bool            asyncUploadComplete(uint64_t id);
+	void            waitAsyncUpload(uint64_t id);
 	bool            extensionSupported(std::string extension);
+	uint32_t        getComputeSubgroupSize(VkSubgroupFeatureFlags operations);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
+	void            queryMemoryBudget(std::vector<HeapBudget>& budgets);
+	void            updateMemoryBudget();
+	float           getMemoryPressure(VkMemoryHeapFlags heapFlags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+	void            setMovable(vks::Buffer *buffer, std::function<void(vks::Buffer &)> moved = nullptr);
+	VkDeviceSize    defragment(VkQueue queue, VkDeviceSize maxBytes);
 };
 }        // namespace vks
@@ -0,0 +1,56 @@
+/*
+* Vulkan dynamic rendering
+*
+* Render pass instances that are begun with the attachments' image views instead of render pass and framebuffer objects (VK_KHR_dynamic_rendering)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDynamicRendering.h"
+
+#include <cassert>
+
+namespace vks
+{
+	namespace dynamicrendering
+	{
+		bool active = false;
+
+		PFN_vkCmdBeginRenderingKHR pfnCmdBeginRendering = VK_NULL_HANDLE;
+		PFN_vkCmdEndRenderingKHR pfnCmdEndRendering = VK_NULL_HANDLE;
+
+		void setup(VkDevice device)
+		{
+			pfnCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+			pfnCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+			active = (pfnCmdBeginRendering != VK_NULL_HANDLE) && (pfnCmdEndRendering != VK_NULL_HANDLE);
+		}
+
+		void beginRendering(VkCommandBuffer cmdbuffer, const VkRenderingInfoKHR& renderingInfo)
+		{
+			assert(active);
+			pfnCmdBeginRendering(cmdbuffer, &renderingInfo);
+		}
+
+		void endRendering(VkCommandBuffer cmdbuffer)
+		{
+			assert(active);
+			pfnCmdEndRendering(cmdbuffer);
+		}
+
+		VkRenderingAttachmentInfoKHR attachmentInfo(VkImageView imageView, VkImageLayout imageLayout, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, VkClearValue clearValue)
+		{
+			VkRenderingAttachmentInfoKHR attachment{};
+			attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			attachment.imageView = imageView;
+			attachment.imageLayout = imageLayout;
+			attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			attachment.loadOp = loadOp;
+			attachment.storeOp = storeOp;
+			attachment.clearValue = clearValue;
+			return attachment;
+		}
+	}
+}
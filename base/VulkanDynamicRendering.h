@@ -0,0 +1,113 @@
+/*
+* Vulkan dynamic rendering
+*
+* Render pass instances that are begun with the attachments' image views instead of render pass and framebuffer objects (VK_KHR_dynamic_rendering)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+// The extension has been released after the Vulkan headers in external/vulkan, so its definitions are provided here until they're updated
+#ifndef VK_KHR_dynamic_rendering
+#define VK_KHR_dynamic_rendering 1
+#define VK_KHR_DYNAMIC_RENDERING_SPEC_VERSION 1
+#define VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME "VK_KHR_dynamic_rendering"
+#define VK_STRUCTURE_TYPE_RENDERING_INFO_KHR static_cast<VkStructureType>(1000044000)
+#define VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR static_cast<VkStructureType>(1000044001)
+#define VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR static_cast<VkStructureType>(1000044002)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR static_cast<VkStructureType>(1000044003)
+#define VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR static_cast<VkStructureType>(1000044004)
+
+typedef enum VkRenderingFlagBitsKHR {
+	VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR = 0x00000001,
+	VK_RENDERING_SUSPENDING_BIT_KHR = 0x00000002,
+	VK_RENDERING_RESUMING_BIT_KHR = 0x00000004,
+	VK_RENDERING_FLAG_BITS_MAX_ENUM_KHR = 0x7FFFFFFF
+} VkRenderingFlagBitsKHR;
+typedef VkFlags VkRenderingFlagsKHR;
+
+typedef struct VkRenderingAttachmentInfoKHR {
+	VkStructureType sType;
+	const void* pNext;
+	VkImageView imageView;
+	VkImageLayout imageLayout;
+	VkResolveModeFlagBits resolveMode;
+	VkImageView resolveImageView;
+	VkImageLayout resolveImageLayout;
+	VkAttachmentLoadOp loadOp;
+	VkAttachmentStoreOp storeOp;
+	VkClearValue clearValue;
+} VkRenderingAttachmentInfoKHR;
+
+typedef struct VkRenderingInfoKHR {
+	VkStructureType sType;
+	const void* pNext;
+	VkRenderingFlagsKHR flags;
+	VkRect2D renderArea;
+	uint32_t layerCount;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkRenderingAttachmentInfoKHR* pColorAttachments;
+	const VkRenderingAttachmentInfoKHR* pDepthAttachment;
+	const VkRenderingAttachmentInfoKHR* pStencilAttachment;
+} VkRenderingInfoKHR;
+
+typedef struct VkPipelineRenderingCreateInfoKHR {
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkFormat* pColorAttachmentFormats;
+	VkFormat depthAttachmentFormat;
+	VkFormat stencilAttachmentFormat;
+} VkPipelineRenderingCreateInfoKHR;
+
+typedef struct VkPhysicalDeviceDynamicRenderingFeaturesKHR {
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 dynamicRendering;
+} VkPhysicalDeviceDynamicRenderingFeaturesKHR;
+
+typedef struct VkCommandBufferInheritanceRenderingInfoKHR {
+	VkStructureType sType;
+	const void* pNext;
+	VkRenderingFlagsKHR flags;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+	const VkFormat* pColorAttachmentFormats;
+	VkFormat depthAttachmentFormat;
+	VkFormat stencilAttachmentFormat;
+	VkSampleCountFlagBits rasterizationSamples;
+} VkCommandBufferInheritanceRenderingInfoKHR;
+
+typedef void (VKAPI_PTR *PFN_vkCmdBeginRenderingKHR)(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR* pRenderingInfo);
+typedef void (VKAPI_PTR *PFN_vkCmdEndRenderingKHR)(VkCommandBuffer commandBuffer);
+#endif
+
+namespace vks
+{
+	// Setup and functions for VK_KHR_dynamic_rendering
+	// The check for extension support and enabling it on the device is done in the example base class (see VulkanExampleBase::dynamicRendering)
+	namespace dynamicrendering
+	{
+		// Set to true if the function pointers for dynamic rendering are available
+		extern bool active;
+
+		// Get the function pointers for dynamic rendering from the device
+		void setup(VkDevice device);
+
+		// Begin a render pass instance rendering to the image views of renderingInfo's attachments
+		void beginRendering(VkCommandBuffer cmdbuffer, const VkRenderingInfoKHR& renderingInfo);
+
+		// End the current render pass instance
+		void endRendering(VkCommandBuffer cmdbuffer);
+
+		// Attachment of a render pass instance without a resolve
+		VkRenderingAttachmentInfoKHR attachmentInfo(VkImageView imageView, VkImageLayout imageLayout, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, VkClearValue clearValue = {});
+	}
+}
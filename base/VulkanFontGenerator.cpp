@@ -0,0 +1,531 @@
+/*
+* Vulkan font generator
+*
+* Generates multi-channel signed distance field glyph atlases from TrueType outlines with a compute shader
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFontGenerator.h"
+#include "VulkanAssetFile.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+// The outlines are read with the TrueType parser that comes with ImGui, its functions are local to this file
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+namespace vks
+{
+	namespace
+	{
+		const uint32_t edgeLine = 0;
+		const uint32_t edgeQuadratic = 1;
+
+		// Channel masks of the edge colors, white edges contribute to all channels
+		const uint32_t colorWhite = 7;
+		const uint32_t colorCycle[3] = { 6 /* cyan */, 5 /* magenta */, 3 /* yellow */ };
+
+		// Edges meeting at an angle above ~3 degrees (or turning back) are treated as a corner
+		const float cornerCrossThreshold = 0.05f;
+
+		struct OutlineEdge
+		{
+			// Start, control and end point, the control point of lines is their center
+			glm::vec2 p[3];
+			uint32_t type;
+			uint32_t color;
+
+			glm::vec2 point(float t) const
+			{
+				if (type == edgeLine) {
+					return glm::mix(p[0], p[2], t);
+				}
+				return (1.0f - t) * (1.0f - t) * p[0] + 2.0f * (1.0f - t) * t * p[1] + t * t * p[2];
+			}
+			glm::vec2 derivative(float t) const
+			{
+				if (type == edgeLine) {
+					return p[2] - p[0];
+				}
+				return 2.0f * ((1.0f - t) * (p[1] - p[0]) + t * (p[2] - p[1]));
+			}
+			glm::vec2 startDirection() const
+			{
+				return ((type == edgeQuadratic) && (p[1] != p[0])) ? p[1] - p[0] : p[2] - p[0];
+			}
+			glm::vec2 endDirection() const
+			{
+				return ((type == edgeQuadratic) && (p[2] != p[1])) ? p[2] - p[1] : p[2] - p[0];
+			}
+			// Part of the edge between two parameters, the control point of a quadratic sub curve lies on the tangent at its start
+			OutlineEdge segment(float t0, float t1) const
+			{
+				OutlineEdge result = *this;
+				result.p[0] = point(t0);
+				result.p[2] = point(t1);
+				result.p[1] = (type == edgeLine) ? (result.p[0] + result.p[2]) * 0.5f : result.p[0] + derivative(t0) * ((t1 - t0) * 0.5f);
+				return result;
+			}
+		};
+
+		typedef std::vector<OutlineEdge> Contour;
+
+		float cross(glm::vec2 a, glm::vec2 b)
+		{
+			return a.x * b.y - a.y * b.x;
+		}
+
+		void addEdge(Contour& contour, glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, uint32_t type)
+		{
+			// Degenerate edges have no direction
+			if ((p0 == p2) && ((type == edgeLine) || (p0 == p1))) {
+				return;
+			}
+			OutlineEdge edge;
+			edge.p[0] = p0;
+			edge.p[1] = (type == edgeLine) ? (p0 + p2) * 0.5f : p1;
+			edge.p[2] = p2;
+			edge.type = type;
+			edge.color = colorWhite;
+			contour.push_back(edge);
+		}
+
+		// Splits the outline of a glyph into contours of line and quadratic edges, cubic curves (OpenType) are approximated with quadratic ones
+		std::vector<Contour> readContours(const stbtt_fontinfo& fontInfo, int glyphIndex)
+		{
+			std::vector<Contour> contours;
+			stbtt_vertex* vertices = nullptr;
+			const int vertexCount = stbtt_GetGlyphShape(&fontInfo, glyphIndex, &vertices);
+			glm::vec2 pen(0.0f);
+			for (int i = 0; i < vertexCount; i++) {
+				const stbtt_vertex& vertex = vertices[i];
+				const glm::vec2 end(vertex.x, vertex.y);
+				switch (vertex.type) {
+				case STBTT_vmove:
+					contours.push_back(Contour());
+					break;
+				case STBTT_vline:
+					addEdge(contours.back(), pen, pen, end, edgeLine);
+					break;
+				case STBTT_vcurve:
+					addEdge(contours.back(), pen, glm::vec2(vertex.cx, vertex.cy), end, edgeQuadratic);
+					break;
+				case STBTT_vcubic: {
+					const glm::vec2 c0(vertex.cx, vertex.cy);
+					const glm::vec2 c1(vertex.cx1, vertex.cy1);
+					// Each quarter of the cubic is replaced by the quadratic through its end points with the averaged control point
+					auto cubicPoint = [&](float t) {
+						const float s = 1.0f - t;
+						return s * s * s * pen + 3.0f * s * s * t * c0 + 3.0f * s * t * t * c1 + t * t * t * end;
+					};
+					auto cubicDerivative = [&](float t) {
+						const float s = 1.0f - t;
+						return 3.0f * s * s * (c0 - pen) + 6.0f * s * t * (c1 - c0) + 3.0f * t * t * (end - c1);
+					};
+					for (uint32_t part = 0; part < 4; part++) {
+						const float t0 = part * 0.25f;
+						const float t1 = t0 + 0.25f;
+						const glm::vec2 q0 = cubicPoint(t0);
+						const glm::vec2 q3 = cubicPoint(t1);
+						const glm::vec2 q1 = q0 + cubicDerivative(t0) * (0.25f / 3.0f);
+						const glm::vec2 q2 = q3 - cubicDerivative(t1) * (0.25f / 3.0f);
+						addEdge(contours.back(), q0, (3.0f * (q1 + q2) - q0 - q3) * 0.25f, q3, edgeQuadratic);
+					}
+					break;
+				}
+				}
+				pen = end;
+			}
+			stbtt_FreeShape(&fontInfo, vertices);
+			contours.erase(std::remove_if(contours.begin(), contours.end(), [](const Contour& contour) { return contour.empty(); }), contours.end());
+			return contours;
+		}
+
+		// Maps the position of an edge in a contour with a single corner to -1, 0 or 1 for the first, middle and last third
+		int symmetricalTrichotomy(int position, int count)
+		{
+			return static_cast<int>(3.0f + 2.875f * position / (count - 1) - 1.4375f + 0.5f) - 3;
+		}
+
+		/*
+			Assigns the color channels to the edges of a contour, so that edges meeting at a corner never share two channels:
+			Smooth contours are white (all channels, i.e. a regular distance field), the splines between corners cycle through cyan, magenta and yellow.
+			A contour with a single corner (e.g. a teardrop) is split into thirds, with the middle one being white.
+		*/
+		void colorEdges(Contour& contour)
+		{
+			std::vector<size_t> corners;
+			for (size_t i = 0; i < contour.size(); i++) {
+				const glm::vec2 a = glm::normalize(contour[(i + contour.size() - 1) % contour.size()].endDirection());
+				const glm::vec2 b = glm::normalize(contour[i].startDirection());
+				if ((glm::dot(a, b) <= 0.0f) || (std::fabs(cross(a, b)) > cornerCrossThreshold)) {
+					corners.push_back(i);
+				}
+			}
+
+			if (corners.empty()) {
+				return;
+			}
+
+			if (corners.size() == 1) {
+				size_t corner = corners[0];
+				if (contour.size() < 3) {
+					Contour split;
+					for (auto& edge : contour) {
+						split.push_back(edge.segment(0.0f, 1.0f / 3.0f));
+						split.push_back(edge.segment(1.0f / 3.0f, 2.0f / 3.0f));
+						split.push_back(edge.segment(2.0f / 3.0f, 1.0f));
+					}
+					contour = split;
+					corner *= 3;
+				}
+				const uint32_t colors[3] = { colorCycle[0], colorWhite, colorCycle[1] };
+				const int count = static_cast<int>(contour.size());
+				for (int i = 0; i < count; i++) {
+					contour[(corner + i) % count].color = colors[1 + symmetricalTrichotomy(i, count)];
+				}
+				return;
+			}
+
+			const size_t splineCount = corners.size();
+			size_t spline = 0;
+			for (size_t i = 0; i < contour.size(); i++) {
+				const size_t index = (corners[0] + i) % contour.size();
+				if ((spline + 1 < splineCount) && (corners[spline + 1] == index)) {
+					spline++;
+				}
+				uint32_t color = colorCycle[spline % 3];
+				// The last spline also meets the first one, which is always cyan
+				if ((spline == splineCount - 1) && (spline % 3 == 0)) {
+					color = colorCycle[1];
+				}
+				contour[index].color = color;
+			}
+		}
+
+		// Signed area of the contour's control polygon, positive for counter clockwise contours (font units have y pointing up)
+		float contourArea(const Contour& contour)
+		{
+			float area = 0.0f;
+			for (auto& edge : contour) {
+				area += cross(edge.p[0], edge.p[1]) + cross(edge.p[1], edge.p[2]);
+			}
+			return area * 0.5f;
+		}
+	}
+
+	FontGenerator::~FontGenerator()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the compute pipeline
+	*
+	* @param device Device to generate font atlases on
+	* @param shaderStage Stage for the atlas generation compute shader (base/msdfgen.comp)
+	* @param pipelineCache Pipeline cache to use for creating the pipeline
+	*/
+	void FontGenerator::prepare(vks::VulkanDevice* device, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+	{
+		assert(pipeline == VK_NULL_HANDLE);
+		this->device = device;
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Atlas
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Edges
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Glyphs
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = shaderStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	/** @brief Release the pipeline, generated fonts are owned by the caller */
+	void FontGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		pipeline = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/**
+	* Generate the glyph atlas and metrics of a font from a TrueType or OpenType font file
+	*
+	* @param font Font to generate, must not have been loaded before
+	* @param fontFile TrueType (.ttf) or OpenType (.otf) font file
+	* @param size Size of the font's em square in atlas texels, glyph metrics are in pixels of this size
+	* @param distanceRange Width of the distance field's transition around the outlines in atlas texels, glyphs are padded by half of it
+	* @param queue Queue used for the generation (must support compute)
+	* @param (Optional) firstCharacter First character code to generate a glyph for (Defaults to space)
+	* @param (Optional) lastCharacter Last character code to generate a glyph for (Defaults to the end of the latin 1 range)
+	*
+	* @return False if the font file could not be read
+	*
+	* @note The atlas is a multi-channel distance field in RGB with the true distance in alpha (see Font::multiChannel), the call waits for the generation to finish
+	*/
+	bool FontGenerator::generate(Font& font, const std::string& fontFile, float size, float distanceRange, VkQueue queue, uint32_t firstCharacter, uint32_t lastCharacter)
+	{
+		assert(pipeline != VK_NULL_HANDLE);
+		const auto tStart = std::chrono::high_resolution_clock::now();
+
+		vks::AssetFile file(fontFile);
+		stbtt_fontinfo fontInfo;
+		if (!file.valid() || !stbtt_InitFont(&fontInfo, file.data(), stbtt_GetFontOffsetForIndex(file.data(), 0))) {
+			std::cerr << "Could not read font file \"" << fontFile << "\"\n";
+			return false;
+		}
+
+		const float scale = stbtt_ScaleForMappingEmToPixels(&fontInfo, size);
+		int ascent, descent, lineGap;
+		stbtt_GetFontVMetrics(&fontInfo, &ascent, &descent, &lineGap);
+		font.glyphs.fill(Font::Glyph{});
+		font.size = size;
+		font.lineHeight = (ascent - descent + lineGap) * scale;
+		font.distanceRange = distanceRange;
+		font.multiChannel = true;
+		const int padding = static_cast<int>(std::ceil(distanceRange * 0.5f));
+
+		// Outlines and texel bounds of all glyphs with an image
+		std::vector<Edge> edges;
+		std::vector<GlyphRegion> regions;
+		std::vector<uint32_t> characters;
+		lastCharacter = std::min(lastCharacter, static_cast<uint32_t>(font.glyphs.size() - 1));
+		for (uint32_t character = firstCharacter; character <= lastCharacter; character++) {
+			const int glyphIndex = stbtt_FindGlyphIndex(&fontInfo, character);
+			if (glyphIndex == 0) {
+				continue;
+			}
+			int advance, leftSideBearing;
+			stbtt_GetGlyphHMetrics(&fontInfo, glyphIndex, &advance, &leftSideBearing);
+			Font::Glyph& glyph = font.glyphs[character];
+			glyph.valid = true;
+			glyph.xadvance = advance * scale;
+
+			int x0, y0, x1, y1;
+			std::vector<Contour> contours = readContours(fontInfo, glyphIndex);
+			if (contours.empty() || !stbtt_GetGlyphBox(&fontInfo, glyphIndex, &x0, &y0, &x1, &y1)) {
+				// Glyphs without an outline (e.g. spaces) only advance the pen
+				continue;
+			}
+
+			// Texel bounds of the outline (y pointing up) including the padding for the distance range
+			const int left = static_cast<int>(std::floor(x0 * scale)) - padding;
+			const int right = static_cast<int>(std::ceil(x1 * scale)) + padding;
+			const int bottom = static_cast<int>(std::floor(y0 * scale)) - padding;
+			const int top = static_cast<int>(std::ceil(y1 * scale)) + padding;
+			glyph.width = static_cast<float>(right - left);
+			glyph.height = static_cast<float>(top - bottom);
+			glyph.xoffset = static_cast<float>(left);
+			glyph.yoffset = ascent * scale - top;
+
+			GlyphRegion region{};
+			region.rect[2] = right - left;
+			region.rect[3] = top - bottom;
+			region.firstEdge = static_cast<uint32_t>(edges.size());
+			region.origin[0] = left / scale;
+			region.origin[1] = top / scale;
+			region.texelSize[0] = 1.0f / scale;
+			region.texelSize[1] = -1.0f / scale;
+			// Distances are positive inside of clockwise contours, the largest contour is an outer one, so its orientation is the font's
+			float largestArea = 0.0f;
+			for (auto& contour : contours) {
+				colorEdges(contour);
+				const float area = contourArea(contour);
+				if (std::fabs(area) > std::fabs(largestArea)) {
+					largestArea = area;
+				}
+				for (auto& outlineEdge : contour) {
+					Edge edge;
+					for (uint32_t i = 0; i < 2; i++) {
+						edge.p0[i] = outlineEdge.p[0][i];
+						edge.p1[i] = outlineEdge.p[1][i];
+						edge.p2[i] = outlineEdge.p[2][i];
+					}
+					edge.type = outlineEdge.type;
+					edge.color = outlineEdge.color;
+					edges.push_back(edge);
+				}
+			}
+			region.edgeCount = static_cast<uint32_t>(edges.size()) - region.firstEdge;
+			region.flipSign = (largestArea > 0.0f) ? 1 : 0;
+			regions.push_back(region);
+			characters.push_back(character);
+		}
+		if (regions.empty()) {
+			std::cerr << "Font file \"" << fontFile << "\" doesn't contain any glyph outlines\n";
+			return false;
+		}
+
+		// Pack the glyphs into rows sorted by height, growing the atlas in powers of two until they fit
+		std::vector<uint32_t> order(regions.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(order.size()); i++) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&regions](uint32_t a, uint32_t b) { return regions[a].rect[3] > regions[b].rect[3]; });
+		const uint32_t maxDimension = device->properties.limits.maxImageDimension2D;
+		uint32_t atlasWidth = 64;
+		uint32_t atlasHeight = 64;
+		while (true) {
+			int x = 0, y = 0, rowHeight = 0;
+			bool fits = true;
+			for (uint32_t index : order) {
+				GlyphRegion& region = regions[index];
+				if (x + region.rect[2] > static_cast<int>(atlasWidth)) {
+					x = 0;
+					y += rowHeight;
+					rowHeight = 0;
+				}
+				if ((region.rect[2] > static_cast<int>(atlasWidth)) || (y + region.rect[3] > static_cast<int>(atlasHeight))) {
+					fits = false;
+					break;
+				}
+				region.rect[0] = x;
+				region.rect[1] = y;
+				x += region.rect[2];
+				rowHeight = std::max(rowHeight, region.rect[3]);
+			}
+			if (fits) {
+				break;
+			}
+			if ((atlasWidth >= maxDimension) && (atlasHeight >= maxDimension)) {
+				std::cerr << "Glyphs of font file \"" << fontFile << "\" don't fit into an atlas of the maximum image size\n";
+				return false;
+			}
+			if (atlasWidth <= atlasHeight) {
+				atlasWidth *= 2;
+			} else {
+				atlasHeight *= 2;
+			}
+		}
+		int maxGlyphWidth = 0, maxGlyphHeight = 0;
+		for (size_t i = 0; i < regions.size(); i++) {
+			Font::Glyph& glyph = font.glyphs[characters[i]];
+			glyph.x = static_cast<float>(regions[i].rect[0]);
+			glyph.y = static_cast<float>(regions[i].rect[1]);
+			maxGlyphWidth = std::max(maxGlyphWidth, regions[i].rect[2]);
+			maxGlyphHeight = std::max(maxGlyphHeight, regions[i].rect[3]);
+		}
+
+		// Atlas image, written by the compute shader and sampled by the text shaders
+		vks::Texture2D& texture = font.texture;
+		texture.device = device;
+		texture.width = atlasWidth;
+		texture.height = atlasHeight;
+		texture.mipLevels = 1;
+		texture.layerCount = 1;
+		texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = texture.format;
+		imageCI.extent = { atlasWidth, atlasHeight, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &texture.image));
+		VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &texture.allocation));
+		device->memoryAllocator.tag(texture.allocation, vks::MemoryCategory::Texture, "Font atlas");
+		texture.deviceMemory = texture.allocation.memory;
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.image = texture.image;
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = texture.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texture.view));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxAnisotropy = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		texture.sampler = device->resourceCache.acquireSampler(samplerCI);
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		texture.updateDescriptor();
+
+		// Outlines and glyphs are only read once, so they stay in host visible memory
+		vks::Buffer edgeBuffer, glyphBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &edgeBuffer, edges.size() * sizeof(Edge), edges.data()));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &glyphBuffer, regions.size() * sizeof(GlyphRegion), regions.data()));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VkDescriptorPool descriptorPool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+		VkDescriptorImageInfo atlasDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &atlasDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &edgeBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &glyphBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Texels not covered by a glyph are cleared to outside
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		PushConstants pushConstants;
+		pushConstants.distanceRange = distanceRange / scale;
+		pushConstants.glyphCount = static_cast<uint32_t>(regions.size());
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		// One layer of 8x8 workgroups covering the largest glyph per glyph
+		vkCmdDispatch(commandBuffer, (maxGlyphWidth + 7) / 8, (maxGlyphHeight + 7) / 8, pushConstants.glyphCount);
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		edgeBuffer.destroy();
+		glyphBuffer.destroy();
+
+		generationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		return true;
+	}
+}
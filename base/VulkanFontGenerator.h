@@ -0,0 +1,82 @@
+/*
+* Vulkan font generator
+*
+* Generates multi-channel signed distance field glyph atlases from TrueType outlines with a compute shader
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTextRenderer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Compute shader based multi-channel signed distance field (MSDF) font atlas generation
+	*
+	* Glyph outlines are read from a TrueType (or OpenType) font file and split into line and quadratic edges.
+	* Edges meeting at a corner are assigned different color channels, so each channel stores the distance to a different subset of the edges.
+	* The median of the three channels then reconstructs sharp corners that a single channel distance field rounds off, which allows for smaller atlases.
+	* The alpha channel stores the true signed distance, so generated fonts can also be drawn with single channel shaders (e.g. by the TextRenderer).
+	*
+	* Glyphs are packed into the atlas on the CPU and a single dispatch computes the distances of all texels, with one workgroup layer per glyph.
+	*/
+	class FontGenerator
+	{
+	private:
+		// Matches the layout of the edge and glyph buffers in base/msdfgen.comp
+		struct Edge
+		{
+			// Start, control and end point in font units, lines only use start and end
+			float p0[2];
+			float p1[2];
+			float p2[2];
+			uint32_t type;
+			// Channels (R = 1, G = 2, B = 4) the edge contributes to
+			uint32_t color;
+		};
+		struct GlyphRegion
+		{
+			// Rectangle of the glyph in the atlas in texels
+			int32_t rect[4];
+			uint32_t firstEdge;
+			uint32_t edgeCount;
+			// Set to flip the sign of the distances of glyphs whose outer contours are oriented counter clockwise
+			uint32_t flipSign;
+			uint32_t pad;
+			// Position of the rectangle's top left corner in font units and size of a texel in font units
+			float origin[2];
+			float texelSize[2];
+		};
+		struct PushConstants
+		{
+			float distanceRange;
+			uint32_t glyphCount;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+
+	public:
+		/** @brief Time taken by the last generate call (outline processing, upload and GPU generation) in ms */
+		double generationTime = 0.0;
+
+		~FontGenerator();
+		void prepare(vks::VulkanDevice* device, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache);
+		void destroy();
+		bool generate(Font& font, const std::string& fontFile, float size, float distanceRange, VkQueue queue, uint32_t firstCharacter = 32, uint32_t lastCharacter = 255);
+	};
+}
@@ -14,6 +14,8 @@
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "VulkanTools.h"
+#include "VulkanDynamicRendering.h"
+#include "VulkanPipelineManifest.h"
 
 namespace vks
 {
@@ -81,6 +83,15 @@ namespace vks
 		VkFormat format;
 		VkImageUsageFlags usage;
 		VkSampleCountFlagBits imageSampleCount = VK_SAMPLE_COUNT_1_BIT;
+		/**
+		* Transient attachments are only used within the render pass and never stored (e.g. depth or G-Buffer attachments read as input attachments)
+		* They're created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT and lazily allocated memory (if available), so on tile based GPUs they
+		* can stay in tile memory without ever being backed by device memory
+		*/
+		bool transient = false;
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		/** @brief VK_ATTACHMENT_STORE_OP_MAX_ENUM selects the store op from the usage: Sampled attachments are stored, all others are discarded */
+		VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_MAX_ENUM;
 	};
 
 	/**
@@ -92,10 +103,17 @@ namespace vks
 		vks::VulkanDevice *vulkanDevice;
 	public:
 		uint32_t width, height;
-		VkFramebuffer framebuffer;
-		VkRenderPass renderPass;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
 		VkSampler sampler;
 		std::vector<vks::FramebufferAttachment> attachments;
+		/**
+		* @brief Render to the attachments with VK_KHR_dynamic_rendering (must be set before calling createRenderPass and requires vks::dynamicrendering to be active)
+		* No render pass and framebuffer objects are created, render with beginRendering and endRendering and chain pipelineRenderingCreateInfo to the pipelines
+		*/
+		bool dynamicRendering = false;
+		// Color attachment formats (in attachment order) referenced by pipelineRenderingCreateInfo
+		std::vector<VkFormat> colorFormats;
 
 		/**
 		* Default constructor
@@ -118,6 +136,7 @@ namespace vks
 			{
 				vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
 				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
+				vulkanDevice->memoryAllocator.report.untrack(attachment.memory);
 				vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
 			}
 			vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
@@ -163,6 +182,14 @@ namespace vks
 
 			assert(aspectMask > 0);
 
+			VkImageUsageFlags usage = createinfo.usage;
+			if (createinfo.transient)
+			{
+				// Transient attachments can't be used outside of the render pass (e.g. sampled or copied)
+				assert(!(usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)));
+				usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+
 			VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 			image.imageType = VK_IMAGE_TYPE_2D;
 			image.format = createinfo.format;
@@ -173,18 +200,18 @@ namespace vks
 			image.arrayLayers = createinfo.layerCount;
 			image.samples = createinfo.imageSampleCount;
 			image.tiling = VK_IMAGE_TILING_OPTIMAL;
-			image.usage = createinfo.usage;
-
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
+			image.usage = usage;
 
 			// Create image for this attachment
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, nullptr, &attachment.image));
-			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &attachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, attachment.image, attachment.memory, 0));
+			// Transient attachments prefer lazily allocated memory, which may never be committed if the attachment stays in tile memory
+			VkDeviceSize memorySize = 0;
+			VK_CHECK_RESULT(vulkanDevice->allocateRenderTargetMemory(attachment.image, &attachment.memory, createinfo.transient, &memorySize));
+			// Lazily allocated memory may never be committed, so it's not added to the memory report
+			if (memorySize > 0)
+			{
+				vulkanDevice->memoryAllocator.report.track(attachment.memory, 0, memorySize, vks::MemoryCategory::RenderTarget, "Framebuffer attachment");
+			}
 
 			attachment.subresourceRange = {};
 			attachment.subresourceRange.aspectMask = aspectMask;
@@ -203,8 +230,17 @@ namespace vks
 			// Fill attachment description
 			attachment.description = {};
 			attachment.description.samples = createinfo.imageSampleCount;
-			attachment.description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachment.description.storeOp = (createinfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.description.loadOp = createinfo.loadOp;
+			if (createinfo.storeOp != VK_ATTACHMENT_STORE_OP_MAX_ENUM)
+			{
+				attachment.description.storeOp = createinfo.storeOp;
+			}
+			else
+			{
+				attachment.description.storeOp = (createinfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			}
+			// The contents of transient attachments can't be loaded or stored
+			assert(!createinfo.transient || ((attachment.description.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) && (attachment.description.storeOp != VK_ATTACHMENT_STORE_OP_STORE)));
 			attachment.description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			attachment.description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 			attachment.description.format = createinfo.format;
@@ -219,6 +255,12 @@ namespace vks
 			{
 				attachment.description.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			}
+			// Loaded attachments keep their contents across render passes, so they start in the layout the previous pass left them in
+			// The image has to be transitioned to that layout once before it's used in the first pass
+			if (attachment.description.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+			{
+				attachment.description.initialLayout = attachment.description.finalLayout;
+			}
 
 			attachments.push_back(attachment);
 
@@ -259,6 +301,19 @@ namespace vks
 		*/
 		VkResult createRenderPass()
 		{
+			colorFormats.clear();
+			for (auto& attachment : attachments)
+			{
+				if (!attachment.isDepthStencil())
+				{
+					colorFormats.push_back(attachment.format);
+				}
+			}
+			if (dynamicRendering)
+			{
+				return VK_SUCCESS;
+			}
+
 			std::vector<VkAttachmentDescription> attachmentDescriptions;
 			for (auto& attachment : attachments)
 			{
@@ -332,7 +387,7 @@ namespace vks
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
 
 			std::vector<VkImageView> attachmentViews;
 			for (auto attachment : attachments)
@@ -362,5 +417,119 @@ namespace vks
 
 			return VK_SUCCESS;
 		}
+
+		/**
+		* Attachment formats for pipelines rendering to the framebuffer with dynamic rendering
+		*
+		* @return Create info to be chained to VkGraphicsPipelineCreateInfo::pNext (references colorFormats)
+		*/
+		VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo()
+		{
+			VkPipelineRenderingCreateInfoKHR pipelineRenderingCI{};
+			pipelineRenderingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+			pipelineRenderingCI.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+			pipelineRenderingCI.pColorAttachmentFormats = colorFormats.data();
+			pipelineRenderingCI.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+			pipelineRenderingCI.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+			for (auto& attachment : attachments)
+			{
+				if (attachment.hasDepth())
+				{
+					pipelineRenderingCI.depthAttachmentFormat = attachment.format;
+				}
+				if (attachment.hasStencil())
+				{
+					pipelineRenderingCI.stencilAttachmentFormat = attachment.format;
+				}
+			}
+			return pipelineRenderingCI;
+		}
+
+		/**
+		* Transition the attachments from the initial layout of their descriptions and begin rendering to them with dynamic rendering
+		* The attachments' load and store ops are taken from their descriptions, like for the render pass created by createRenderPass
+		*
+		* @param commandBuffer Command buffer to record to
+		* @param clearValues Clear values in attachment order
+		*/
+		void beginRendering(VkCommandBuffer commandBuffer, const std::vector<VkClearValue>& clearValues)
+		{
+			assert(dynamicRendering);
+			std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+			VkRenderingAttachmentInfoKHR depthAttachment{};
+			VkRenderingAttachmentInfoKHR stencilAttachment{};
+			bool hasDepth = false;
+			bool hasStencil = false;
+			uint32_t maxLayers = 0;
+			for (size_t i = 0; i < attachments.size(); i++)
+			{
+				FramebufferAttachment& attachment = attachments[i];
+				const VkClearValue clearValue = (i < clearValues.size()) ? clearValues[i] : VkClearValue{};
+				maxLayers = std::max(maxLayers, attachment.subresourceRange.layerCount);
+				if (attachment.isDepthStencil())
+				{
+					// Previous writes are made available and sampling of the previous contents has finished before the transition
+					vks::tools::insertImageMemoryBarrier(commandBuffer, attachment.image,
+						VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+						attachment.description.initialLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+						attachment.subresourceRange);
+					depthAttachment = vks::dynamicrendering::attachmentInfo(attachment.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, attachment.description.loadOp, attachment.description.storeOp, clearValue);
+					stencilAttachment = vks::dynamicrendering::attachmentInfo(attachment.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, attachment.description.stencilLoadOp, attachment.description.stencilStoreOp, clearValue);
+					hasDepth = attachment.hasDepth();
+					hasStencil = attachment.hasStencil();
+				}
+				else
+				{
+					vks::tools::insertImageMemoryBarrier(commandBuffer, attachment.image,
+						VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+						attachment.description.initialLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+						attachment.subresourceRange);
+					colorAttachments.push_back(vks::dynamicrendering::attachmentInfo(attachment.view, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, attachment.description.loadOp, attachment.description.storeOp, clearValue));
+				}
+			}
+
+			VkRenderingInfoKHR renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+			renderingInfo.renderArea.extent.width = width;
+			renderingInfo.renderArea.extent.height = height;
+			renderingInfo.layerCount = maxLayers;
+			renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+			renderingInfo.pColorAttachments = colorAttachments.data();
+			renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+			renderingInfo.pStencilAttachment = hasStencil ? &stencilAttachment : nullptr;
+			vks::dynamicrendering::beginRendering(commandBuffer, renderingInfo);
+		}
+
+		/**
+		* End rendering to the attachments and transition them to the final layout of their descriptions, which makes them visible to fragment shaders
+		*
+		* @param commandBuffer Command buffer to record to
+		*/
+		void endRendering(VkCommandBuffer commandBuffer)
+		{
+			assert(dynamicRendering);
+			vks::dynamicrendering::endRendering(commandBuffer);
+			for (auto& attachment : attachments)
+			{
+				if (attachment.isDepthStencil())
+				{
+					vks::tools::insertImageMemoryBarrier(commandBuffer, attachment.image,
+						VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, attachment.description.finalLayout,
+						VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+						attachment.subresourceRange);
+				}
+				else
+				{
+					vks::tools::insertImageMemoryBarrier(commandBuffer, attachment.image,
+						VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, attachment.description.finalLayout,
+						VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+						attachment.subresourceRange);
+				}
+			}
+		}
 	};
 }
\ No newline at end of file
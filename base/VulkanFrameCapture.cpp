@@ -0,0 +1,350 @@
+/*
+* Vulkan frame capture
+*
+* Copies rendered images to a ring of host visible readback buffers inside the frame's command buffer and writes them to disk on a worker thread
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameCapture.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace vks
+{
+	namespace
+	{
+		std::vector<uint32_t> createCrcTable()
+		{
+			std::vector<uint32_t> table(256);
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (uint32_t k = 0; k < 8; k++) {
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				table[i] = c;
+			}
+			return table;
+		}
+
+		uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+		{
+			static const std::vector<uint32_t> table = createCrcTable();
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++) {
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+
+		void appendBigEndian(std::vector<uint8_t>& data, uint32_t value)
+		{
+			data.push_back(static_cast<uint8_t>(value >> 24));
+			data.push_back(static_cast<uint8_t>(value >> 16));
+			data.push_back(static_cast<uint8_t>(value >> 8));
+			data.push_back(static_cast<uint8_t>(value));
+		}
+
+		void writePngChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+		{
+			std::vector<uint8_t> header;
+			appendBigEndian(header, static_cast<uint32_t>(data.size()));
+			header.insert(header.end(), type, type + 4);
+			uint32_t crc = crc32(0, &header[4], 4);
+			crc = crc32(crc, data.data(), data.size());
+			std::vector<uint8_t> footer;
+			appendBigEndian(footer, crc);
+			file.write(reinterpret_cast<const char*>(header.data()), header.size());
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+		}
+
+		/**
+		* Write an 8 bit RGB image as PNG
+		* The image data is stored without compression (deflate "stored" blocks), which keeps encoding as cheap as writing a raw image
+		*/
+		void writePng(const std::string& fileName, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height)
+		{
+			std::ofstream file(fileName, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				std::cerr << "Could not write " << fileName << "\n";
+				return;
+			}
+			const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+			std::vector<uint8_t> ihdr;
+			appendBigEndian(ihdr, width);
+			appendBigEndian(ihdr, height);
+			// 8 bit RGB, deflate, adaptive filtering, no interlacing
+			const uint8_t format[5] = { 8, 2, 0, 0, 0 };
+			ihdr.insert(ihdr.end(), format, format + 5);
+			writePngChunk(file, "IHDR", ihdr);
+
+			// Each row starts with its filter type (none)
+			const size_t rowSize = static_cast<size_t>(width) * 3;
+			std::vector<uint8_t> scanlines;
+			scanlines.reserve((rowSize + 1) * height);
+			for (uint32_t y = 0; y < height; y++) {
+				scanlines.push_back(0);
+				scanlines.insert(scanlines.end(), rgb.begin() + y * rowSize, rgb.begin() + (y + 1) * rowSize);
+			}
+
+			// zlib stream of stored blocks (at most 65535 bytes each) followed by the Adler-32 checksum
+			std::vector<uint8_t> idat;
+			idat.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+			idat.push_back(0x78);
+			idat.push_back(0x01);
+			size_t offset = 0;
+			do {
+				const uint16_t blockSize = static_cast<uint16_t>(std::min(scanlines.size() - offset, static_cast<size_t>(65535)));
+				const bool lastBlock = (offset + blockSize == scanlines.size());
+				idat.push_back(lastBlock ? 1 : 0);
+				idat.push_back(static_cast<uint8_t>(blockSize));
+				idat.push_back(static_cast<uint8_t>(blockSize >> 8));
+				const uint16_t inverseBlockSize = static_cast<uint16_t>(~blockSize);
+				idat.push_back(static_cast<uint8_t>(inverseBlockSize));
+				idat.push_back(static_cast<uint8_t>(inverseBlockSize >> 8));
+				idat.insert(idat.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+				offset += blockSize;
+			} while (offset < scanlines.size());
+			uint32_t a = 1, b = 0;
+			for (uint8_t value : scanlines) {
+				a = (a + value) % 65521;
+				b = (b + a) % 65521;
+			}
+			appendBigEndian(idat, (b << 16) | a);
+			writePngChunk(file, "IDAT", idat);
+
+			writePngChunk(file, "IEND", std::vector<uint8_t>());
+		}
+
+		void writePpm(const std::string& fileName, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height)
+		{
+			std::ofstream file(fileName, std::ios::out | std::ios::binary);
+			if (!file.is_open()) {
+				std::cerr << "Could not write " << fileName << "\n";
+				return;
+			}
+			file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+			file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+		}
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the capture ring, the readback buffers are created on first use (and recreated for larger images)
+	*
+	* @param device Device to create the buffers on
+	* @param slotCount Number of readback buffers, i.e. captures that can be in flight or encoded at the same time
+	* @param frameCount Number of frames in flight
+	*/
+	void FrameCapture::setup(vks::VulkanDevice* device, uint32_t slotCount, uint32_t frameCount)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->frameCount = frameCount;
+		// Cached memory is a lot faster to read from on the host, but may not be coherent
+		memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		for (uint32_t i = 0; i < device->memoryProperties.memoryTypeCount; i++) {
+			const VkMemoryPropertyFlags flags = device->memoryProperties.memoryTypes[i].propertyFlags;
+			if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+				memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+				break;
+			}
+		}
+		slots.clear();
+		for (uint32_t i = 0; i < slotCount; i++) {
+			slots.push_back(std::unique_ptr<Slot>(new Slot()));
+		}
+		worker.reset(new vks::Thread());
+	}
+
+	/** @brief Write all pending captures and release the buffers, the device must be idle */
+	void FrameCapture::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		// All copies have finished, so the remaining ones can be written
+		for (auto& slot : slots) {
+			if (slot->state == SlotCopying) {
+				slot->buffer.invalidate();
+				slot->state = SlotEncoding;
+				Slot* pending = slot.get();
+				worker->addJob([this, pending] { encode(pending); });
+				capturedFrames++;
+			}
+		}
+		worker->wait();
+		worker.reset();
+		for (auto& slot : slots) {
+			if (slot->buffer.buffer != VK_NULL_HANDLE) {
+				slot->buffer.destroy();
+			}
+		}
+		slots.clear();
+		device = nullptr;
+	}
+
+	bool FrameCapture::formatSupported(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/**
+	* Hand the captures recorded by a frame in flight to the worker thread, the GPU must have finished the frame (i.e. its fence has been waited on)
+	*
+	* @param frameIndex Index of the frame in flight (0..frameCount-1)
+	*/
+	void FrameCapture::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frameCount);
+		currentFrame = frameIndex;
+		for (auto& slot : slots) {
+			if ((slot->state == SlotCopying) && (slot->frameIndex == frameIndex)) {
+				if (!(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+					VK_CHECK_RESULT(slot->buffer.invalidate());
+				}
+				slot->state = SlotEncoding;
+				Slot* pending = slot.get();
+				worker->addJob([this, pending] { encode(pending); });
+				capturedFrames++;
+			}
+		}
+	}
+
+	/**
+	* Record the copy of an image to a free readback buffer into the command buffer of the current frame
+	*
+	* @param commandBuffer Command buffer of the current frame, recorded after the image has been rendered
+	* @param image Image to capture
+	* @param format Format of the image, see formatSupported
+	* @param extent Size of the image
+	* @param layout Layout of the image, it's transitioned back to this layout after the copy
+	* @param fileName Name of the file to write the image to, without extension (".ppm" or ".png" is added depending on the encoding)
+	*
+	* @return False if the frame has been dropped because all readback buffers are in use or the format isn't supported
+	*/
+	bool FrameCapture::record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, const std::string& fileName)
+	{
+		assert(device);
+		if (!formatSupported(format)) {
+			return false;
+		}
+		Slot* slot = nullptr;
+		for (auto& candidate : slots) {
+			if (candidate->state == SlotFree) {
+				slot = candidate.get();
+				break;
+			}
+		}
+		if (!slot) {
+			droppedFrames++;
+			return false;
+		}
+
+		const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+		if (slot->buffer.size < size) {
+			// Not used by the GPU or the worker thread in the free state
+			if (slot->buffer.buffer != VK_NULL_HANDLE) {
+				slot->buffer.destroy();
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot->buffer, size));
+			VK_CHECK_RESULT(slot->buffer.map());
+		}
+		slot->extent = extent;
+		slot->bgra = (format == VK_FORMAT_B8G8R8A8_UNORM) || (format == VK_FORMAT_B8G8R8A8_SRGB);
+		slot->encoding = encoding;
+		slot->fileName = fileName + (encoding == Encoding::PNG ? ".png" : ".ppm");
+		slot->frameIndex = currentFrame;
+		slot->state = SlotCopying;
+
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// Wait for the rendering (or a blit) to the image to finish
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			layout,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			subresourceRange);
+
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { extent.width, extent.height, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &region);
+
+		// Presentation (or whatever comes next) is ordered after the frame's commands by the semaphore it waits on
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			image,
+			VK_ACCESS_TRANSFER_READ_BIT,
+			0,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			layout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			subresourceRange);
+
+		// Make the copy available to the host once the frame's fence has been signaled
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = slot->buffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		return true;
+	}
+
+	// Runs on the worker thread
+	void FrameCapture::encode(Slot* slot)
+	{
+		const uint32_t width = slot->extent.width;
+		const uint32_t height = slot->extent.height;
+		const Encoding encoding = slot->encoding;
+		const std::string fileName = slot->fileName;
+		const uint8_t* pixels = static_cast<const uint8_t*>(slot->buffer.mapped);
+		std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		for (size_t i = 0; i < pixelCount; i++) {
+			rgb[i * 3 + 0] = slot->bgra ? pixels[i * 4 + 2] : pixels[i * 4 + 0];
+			rgb[i * 3 + 1] = pixels[i * 4 + 1];
+			rgb[i * 3 + 2] = slot->bgra ? pixels[i * 4 + 0] : pixels[i * 4 + 2];
+		}
+		// The readback buffer isn't needed anymore, the slot may be reused by the next capture from here on
+		slot->state = SlotFree;
+		writeImage(fileName, rgb, width, height, encoding);
+		writtenFrames++;
+	}
+
+	/** @brief Write tightly packed 8 bit RGB pixels to disk, can be called from any thread (e.g. by other readback paths encoding on their own workers) */
+	void FrameCapture::writeImage(const std::string& fileName, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height, Encoding encoding)
+	{
+		if (encoding == Encoding::PNG) {
+			writePng(fileName, rgb, width, height);
+		} else {
+			writePpm(fileName, rgb, width, height);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*
+* Vulkan frame capture
+*
+* Copies rendered images to a ring of host visible readback buffers inside the frame's command buffer and writes them to disk on a worker thread
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Non-blocking capture of rendered images
+	*
+	* record() adds a copy of the image into a free readback buffer to the command buffer of the current frame, so capturing doesn't add any
+	* submissions or waits. The buffers are read once the frame's fence has been waited on (see beginFrame), i.e. frames in flight later,
+	* and the encoding and file output run on a worker thread that releases the buffer when it's done.
+	* If all buffers are still in use, the frame is dropped instead of stalling the frame loop, so capturing doesn't distort frame times.
+	*
+	* @note Only 8 bit RGBA and BGRA formats (e.g. swap chain images) are supported
+	* @note The copies are baked into the command buffers, so this is meant for command buffers recorded each frame (see VulkanExampleBase::dynamicCommandBuffers)
+	*/
+	class FrameCapture
+	{
+	public:
+		enum class Encoding { PPM, PNG };
+
+	private:
+		enum SlotState : uint32_t { SlotFree = 0, SlotCopying = 1, SlotEncoding = 2 };
+
+		struct Slot
+		{
+			vks::Buffer buffer;
+			VkExtent2D extent = { 0, 0 };
+			bool bgra = false;
+			Encoding encoding = Encoding::PPM;
+			std::string fileName;
+			// Frame in flight the copy has been recorded in
+			uint32_t frameIndex = 0;
+			// Written by the worker thread once the file has been written
+			std::atomic<uint32_t> state{ SlotFree };
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		uint32_t frameCount = 0;
+		uint32_t currentFrame = 0;
+		VkMemoryPropertyFlags memoryPropertyFlags = 0;
+		std::vector<std::unique_ptr<Slot>> slots;
+		std::unique_ptr<vks::Thread> worker;
+
+		void encode(Slot* slot);
+
+	public:
+		/** @brief File format of the captured images, applies to images recorded after changing it */
+		Encoding encoding = Encoding::PPM;
+		/** @brief Number of captures handed to the worker thread */
+		uint32_t capturedFrames = 0;
+		/** @brief Number of captures skipped because all readback buffers were in use */
+		uint32_t droppedFrames = 0;
+		/** @brief Number of images written to disk by the worker thread */
+		std::atomic<uint32_t> writtenFrames{ 0 };
+
+		~FrameCapture();
+		void setup(vks::VulkanDevice* device, uint32_t slotCount, uint32_t frameCount);
+		void destroy();
+		/** @brief Returns true if setup has been called */
+		bool isReady() const { return device != nullptr; }
+		static bool formatSupported(VkFormat format);
+		static void writeImage(const std::string& fileName, const std::vector<uint8_t>& rgb, uint32_t width, uint32_t height, Encoding encoding);
+		void beginFrame(uint32_t frameIndex);
+		bool record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout, const std::string& fileName);
+	};
+}
@@ -0,0 +1,160 @@
+/*
+* Vulkan frame submitter
+*
+* Submits the frames' command buffers and presents the swap chain images on a dedicated thread, so the main thread can continue with the next frame
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameSubmitter.h"
+
+#include <chrono>
+#include <cassert>
+
+#include "VulkanDebug.h"
+#include "VulkanTraceRecorder.h"
+
+namespace vks
+{
+	FrameSubmitter::~FrameSubmitter()
+	{
+		stop();
+	}
+
+	/**
+	* Start the submitter thread
+	*
+	* @param queue Graphics queue the frames are submitted to and presented from
+	* @param swapChain Swap chain the images are presented to
+	*/
+	void FrameSubmitter::start(VkQueue queue, VulkanSwapChain* swapChain)
+	{
+		assert(!worker.joinable());
+		this->queue = queue;
+		this->swapChain = swapChain;
+		stopping = false;
+		worker = std::thread(&FrameSubmitter::run, this);
+	}
+
+	/** @brief Submit and present all frames that have been handed over and stop the thread */
+	void FrameSubmitter::stop()
+	{
+		if (!worker.joinable()) {
+			return;
+		}
+		wait();
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopping = true;
+		}
+		wakeCondition.notify_one();
+		worker.join();
+	}
+
+	/** @brief Hand a recorded frame over to the submitter thread, only blocks if the submitter is a full queue of frames behind */
+	void FrameSubmitter::push(const Frame& frame)
+	{
+		assert(worker.joinable());
+		while (!frames.push(frame)) {
+			std::this_thread::yield();
+		}
+		pushed.fetch_add(1, std::memory_order_relaxed);
+		// Taking the lock orders the push before the submitter's check for new frames, so the wakeup can't get lost
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+		}
+		wakeCondition.notify_one();
+	}
+
+	/** @brief Wait until all frames handed over have been submitted and presented, e.g. before the swap chain is recreated */
+	void FrameSubmitter::wait()
+	{
+		if (!worker.joinable()) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		idleCondition.wait(lock, [this] { return presented.load() == pushed.load(); });
+	}
+
+	/** @brief Returns true (once) if a present has reported the swap chain as out of date since the last call */
+	bool FrameSubmitter::presentOutOfDate()
+	{
+		return outOfDate.exchange(false);
+	}
+
+	bool FrameSubmitter::isRunning() const
+	{
+		return worker.joinable();
+	}
+
+	void FrameSubmitter::submit(const Frame& frame)
+	{
+		vks::TraceZone zone("Submit frame");
+		std::lock_guard<std::mutex> lock(queueMutex);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		// Everything submitted for this frame up to the present is labeled as one region of the queue
+		vks::debugutils::queueBeginLabel(queue, "Frame");
+		if (frame.commandBuffer != VK_NULL_HANDLE) {
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &frame.waitSemaphore;
+			submitInfo.pWaitDstStageMask = &frame.waitStageMask;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &frame.signalSemaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+		// The fence (and frame clock) is signaled with an empty submission, like the base class does without the submitter
+		if (frame.timelineSemaphore != VK_NULL_HANDLE) {
+			VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &frame.timelineValue;
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &frame.timelineSemaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+		} else {
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frame.fence));
+		}
+		auto tSubmitted = std::chrono::high_resolution_clock::now();
+		VkResult result = swapChain->queuePresent(queue, frame.imageIndex, frame.signalSemaphore);
+		vks::debugutils::queueEndLabel(queue);
+		auto tPresented = std::chrono::high_resolution_clock::now();
+		submitTime.store(static_cast<float>(std::chrono::duration<double, std::milli>(tSubmitted - tStart).count()));
+		presentTime.store(static_cast<float>(std::chrono::duration<double, std::milli>(tPresented - tSubmitted).count()));
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// The main thread recreates the swap chain, which waits for the remaining frames
+			outOfDate.store(true);
+		} else if (result != VK_SUBOPTIMAL_KHR) {
+			VK_CHECK_RESULT(result);
+		}
+	}
+
+	void FrameSubmitter::run()
+	{
+		while (true) {
+			Frame frame;
+			if (frames.pop(frame)) {
+				submit(frame);
+				{
+					std::lock_guard<std::mutex> lock(wakeMutex);
+					presented.fetch_add(1);
+				}
+				idleCondition.notify_all();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wakeCondition.wait(lock, [this] { return stopping || !frames.empty(); });
+			if (stopping && frames.empty()) {
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,131 @@
+/*
+* Vulkan frame submitter
+*
+* Submits the frames' command buffers and presents the swap chain images on a dedicated thread, so the main thread can continue with the next frame
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanSwapChain.h"
+
+namespace vks
+{
+	/**
+	* @brief Lock-free queue with a single producer and a single consumer thread
+	*
+	* Elements are copied into a fixed ring of Capacity slots (a power of two), so pushing and popping never allocate. The producer only writes the tail
+	* and the consumer only writes the head, each publishing its slot with a release store the other side picks up with an acquire load.
+	*/
+	template<typename T, uint32_t Capacity>
+	class SpscQueue
+	{
+	private:
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+		std::array<T, Capacity> slots;
+		std::atomic<uint32_t> head{ 0 };
+		std::atomic<uint32_t> tail{ 0 };
+	public:
+		/** @brief Append an element (producer thread only), returns false if the queue is full */
+		bool push(const T& element)
+		{
+			const uint32_t currentTail = tail.load(std::memory_order_relaxed);
+			if (currentTail - head.load(std::memory_order_acquire) == Capacity) {
+				return false;
+			}
+			slots[currentTail & (Capacity - 1)] = element;
+			tail.store(currentTail + 1, std::memory_order_release);
+			return true;
+		}
+		/** @brief Take the oldest element (consumer thread only), returns false if the queue is empty */
+		bool pop(T& element)
+		{
+			const uint32_t currentHead = head.load(std::memory_order_relaxed);
+			if (currentHead == tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+			element = slots[currentHead & (Capacity - 1)];
+			head.store(currentHead + 1, std::memory_order_release);
+			return true;
+		}
+		bool empty() const
+		{
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+	};
+
+	/**
+	* @brief Dedicated thread that owns the graphics queue's frame submissions and presentation
+	*
+	* The main thread records a frame and hands it over with push, which returns right away. The submitter thread then submits the frame's command buffer
+	* (waiting on the acquire semaphore and signaling the render complete semaphore), signals the frame's fence (and frame clock) and presents the image,
+	* so a present blocking on the presentation engine only stalls this thread while the main thread updates and records the next frame.
+	* Frames are handed over through a lock-free queue, the thread only sleeps on a condition variable if there is nothing to submit.
+	*
+	* Vulkan queues must be externally synchronized, so the submitter holds queueMutex while it uses the queue. Any other use of the queue
+	* while frames are running (e.g. uploads or the acquire of a headless swap chain) has to hold it too (see lockQueue).
+	* The main thread waits on the frames' fences as before, a fence that has been handed over but not yet submitted is simply waited on until it is.
+	*
+	* @note Results of the presents are picked up by the main thread with presentOutOfDate, the swap chain must only be recreated after wait
+	*/
+	class FrameSubmitter
+	{
+	public:
+		struct Frame
+		{
+			// Optional, frames of examples that submit their own command buffers only signal the fence and present
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+			VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			// Optional timeline semaphore signaled with the fence, e.g. the frame clock
+			VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+			uint64_t timelineValue = 0;
+			uint32_t imageIndex = 0;
+		};
+
+	private:
+		VkQueue queue = VK_NULL_HANDLE;
+		VulkanSwapChain* swapChain = nullptr;
+		std::thread worker;
+		// Twice the frames in flight the base class supports, the fences keep the main thread from getting further ahead
+		SpscQueue<Frame, 8> frames;
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable idleCondition;
+		bool stopping = false;
+		// Frames handed over (main thread) and frames presented (submitter thread)
+		std::atomic<uint64_t> pushed{ 0 };
+		std::atomic<uint64_t> presented{ 0 };
+		std::atomic<bool> outOfDate{ false };
+		void run();
+		void submit(const Frame& frame);
+
+	public:
+		/** @brief Held while the queue is in use by the submitter thread */
+		std::mutex queueMutex;
+		/** @brief CPU time of the last frame's submissions and present on the submitter thread in milliseconds */
+		std::atomic<float> submitTime{ 0.0f };
+		std::atomic<float> presentTime{ 0.0f };
+
+		~FrameSubmitter();
+		void start(VkQueue queue, VulkanSwapChain* swapChain);
+		void stop();
+		void push(const Frame& frame);
+		void wait();
+		bool presentOutOfDate();
+		bool isRunning() const;
+	};
+}
@@ -1,17 +1,25 @@
 /*
 * Heightmap terrain generator
 *
+* Heights are either kept in full (16 bit per sample) or read on demand from a tiled, per tile quantized file (see HeightMap::writeTiles)
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <glm/glm.hpp>
-#include <glm/glm.hpp>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "VulkanBuffer.h"
+#include "VulkanAssetFile.h"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -19,10 +27,36 @@ namespace vks
 {
 	class HeightMap
 	{
+	public:
+		/*
+			Tiled height map file layout:
+			TileFileHeader, followed by one TileInfo per tile (row major), followed by the quantized samples of all tiles
+			A tile stores its samples as offsets to its minimum height with 0 (flat tile, no samples stored), 8 (quantized to 256 steps between min and max) or 16 (exact) bits
+		*/
+		static const uint32_t tileFileMagic = 0x48544C54; // "TLTH"
+		struct TileFileHeader {
+			uint32_t magic;
+			uint32_t dim;
+			uint32_t tileSize;
+			uint32_t tilesPerRow;
+		};
+		struct TileInfo {
+			uint64_t offset;
+			uint16_t minHeight;
+			uint16_t maxHeight;
+			uint32_t bits;
+		};
+
 	private:
-		uint16_t *heightdata;
-		uint32_t dim;
-		uint32_t scale;
+		uint16_t *heightdata = nullptr;
+		uint32_t dim = 0;
+		uint32_t scale = 1;
+
+		// Tiled storage, samples are read from the mapped file only when they're accessed, so the OS only pages in used tiles
+		vks::AssetFile tileFile;
+		uint32_t tileSize = 0;
+		uint32_t tilesPerRow = 0;
+		std::vector<TileInfo> tiles;
 
 		vks::VulkanDevice *device = nullptr;
 		VkQueue copyQueue = VK_NULL_HANDLE;
@@ -58,47 +92,166 @@ namespace vks
 			delete[] heightdata;
 		}
 
+		/** @brief Returns the 16 bit height sample at the given position of the height map, from either storage */
+		uint16_t getSample(uint32_t x, uint32_t y) const
+		{
+			if (heightdata) {
+				return heightdata[x + y * dim];
+			}
+			const TileInfo& tile = tiles[(y / tileSize) * tilesPerRow + (x / tileSize)];
+			const size_t index = (y % tileSize) * tileSize + (x % tileSize);
+			switch (tile.bits) {
+			case 8: {
+				const float step = (tile.maxHeight - tile.minHeight) / 255.0f;
+				return static_cast<uint16_t>(tile.minHeight + std::lround(tileFile.data()[tile.offset + index] * step));
+			}
+			case 16: {
+				// The mapped data is not guaranteed to be aligned on all platforms
+				uint16_t offset;
+				memcpy(&offset, tileFile.data() + tile.offset + index * sizeof(uint16_t), sizeof(uint16_t));
+				return static_cast<uint16_t>(tile.minHeight + offset);
+			}
+			default:
+				return tile.minHeight;
+			}
+		}
+
 		float getHeight(uint32_t x, uint32_t y)
 		{
 			glm::ivec2 rpos = glm::ivec2(x, y) * glm::ivec2(scale);
 			rpos.x = std::max(0, std::min(rpos.x, (int)dim - 1));
 			rpos.y = std::max(0, std::min(rpos.y, (int)dim - 1));
 			rpos /= glm::ivec2(scale);
-			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f * heightScale;
+			return getSample(rpos.x * scale, rpos.y * scale) / 65535.0f * heightScale;
 		}
 
-#if defined(__ANDROID__)
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
-#else
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
-#endif
+		/**
+		* Convert a 16 bit KTX height map into the tiled format, which can be loaded with loadFromFile
+		*
+		* @param filename KTX file with a single channel 16 bit height map
+		* @param tileFilename File the tiled height map is written to
+		* @param tileSize (Optional) Width and height of a tile in samples (Defaults to 64)
+		* @param maxError (Optional) Largest error (in 16 bit height units) allowed for storing a tile with 8 bit samples, tiles exceeding it are stored exact with 16 bit (Defaults to 64)
+		*
+		* @return True if the file was written
+		*/
+		static bool writeTiles(const std::string& filename, const std::string& tileFilename, uint32_t tileSize = 64, uint32_t maxError = 64)
 		{
-			assert(device);
-			assert(copyQueue != VK_NULL_HANDLE);
+			vks::AssetFile file(filename);
+			if (!file.valid()) {
+				return false;
+			}
+			ktxTexture* ktxTexture;
+			if (ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS) {
+				return false;
+			}
+			file.close();
+			const uint32_t dim = ktxTexture->baseWidth;
+			const uint16_t* heights = reinterpret_cast<const uint16_t*>(ktxTexture_GetData(ktxTexture));
+
+			TileFileHeader header;
+			header.magic = tileFileMagic;
+			header.dim = dim;
+			header.tileSize = tileSize;
+			header.tilesPerRow = (dim + tileSize - 1) / tileSize;
+			std::vector<TileInfo> tiles(header.tilesPerRow * header.tilesPerRow);
+			std::vector<uint8_t> samples;
+			uint64_t offset = sizeof(TileFileHeader) + tiles.size() * sizeof(TileInfo);
+			for (uint32_t ty = 0; ty < header.tilesPerRow; ty++) {
+				for (uint32_t tx = 0; tx < header.tilesPerRow; tx++) {
+					// Tiles at the border are padded by repeating the last row and column
+					auto sample = [&](uint32_t x, uint32_t y) {
+						return heights[std::min(tx * tileSize + x, dim - 1) + std::min(ty * tileSize + y, dim - 1) * dim];
+					};
+					TileInfo& tile = tiles[ty * header.tilesPerRow + tx];
+					tile.minHeight = 0xFFFF;
+					tile.maxHeight = 0;
+					for (uint32_t y = 0; y < tileSize; y++) {
+						for (uint32_t x = 0; x < tileSize; x++) {
+							tile.minHeight = std::min(tile.minHeight, sample(x, y));
+							tile.maxHeight = std::max(tile.maxHeight, sample(x, y));
+						}
+					}
+					const uint32_t range = tile.maxHeight - tile.minHeight;
+					// 8 bit samples have an error of at most half a quantization step
+					tile.bits = (range == 0) ? 0 : ((range / 510 <= maxError) ? 8 : 16);
+					tile.offset = offset;
+					for (uint32_t y = 0; (tile.bits > 0) && (y < tileSize); y++) {
+						for (uint32_t x = 0; x < tileSize; x++) {
+							const uint32_t value = sample(x, y) - tile.minHeight;
+							if (tile.bits == 8) {
+								samples.push_back(static_cast<uint8_t>(std::lround(value * 255.0f / range)));
+							} else {
+								samples.push_back(static_cast<uint8_t>(value & 0xFF));
+								samples.push_back(static_cast<uint8_t>(value >> 8));
+							}
+						}
+					}
+					offset = sizeof(TileFileHeader) + tiles.size() * sizeof(TileInfo) + samples.size();
+				}
+			}
+			ktxTexture_Destroy(ktxTexture);
+
+			std::ofstream out(tileFilename, std::ios::binary);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(tiles.data()), tiles.size() * sizeof(TileInfo));
+			out.write(reinterpret_cast<const char*>(samples.data()), samples.size());
+			return out.good();
+		}
+
+		/**
+		* Load the heights from a KTX file (kept in memory in full) or a tiled height map (read through the mapped file on demand)
+		*
+		* @param filename KTX height map or tiled height map written by writeTiles (.tiles extension)
+		*/
+		void loadHeights(const std::string& filename)
+		{
+			delete[] heightdata;
+			heightdata = nullptr;
+			tiles.clear();
+			tileFile.close();
+
+			const bool tiled = (filename.size() > 6) && (filename.compare(filename.size() - 6, 6, ".tiles") == 0);
+			if (tiled) {
+				const bool opened = tileFile.open(filename);
+				assert(opened && (tileFile.size() >= sizeof(TileFileHeader)));
+				TileFileHeader header;
+				memcpy(&header, tileFile.data(), sizeof(header));
+				assert(header.magic == tileFileMagic);
+				dim = header.dim;
+				tileSize = header.tileSize;
+				tilesPerRow = header.tilesPerRow;
+				// Only the (small) tile table is copied, samples stay in the mapped file
+				tiles.resize(tilesPerRow * tilesPerRow);
+				memcpy(tiles.data(), tileFile.data() + sizeof(header), tiles.size() * sizeof(TileInfo));
+				return;
+			}
 
-			ktxResult result;
 			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-			free(textureData);
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
+			vks::AssetFile file(filename);
+			assert(file.valid());
+			ktxResult result = ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+			file.close();
 			assert(result == KTX_SUCCESS);
 			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
 			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
 			dim = ktxTexture->baseWidth;
 			heightdata = new uint16_t[dim * dim];
 			memcpy(heightdata, ktxImage, ktxSize);
-			this->scale = dim / patchsize;
 			ktxTexture_Destroy(ktxTexture);
+		}
+
+#if defined(__ANDROID__)
+		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
+#else
+		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
+#endif
+		{
+			assert(device);
+			assert(copyQueue != VK_NULL_HANDLE);
+
+			loadHeights(filename);
+			this->scale = dim / patchsize;
 
 			// Generate vertices
 			Vertex * vertices = new Vertex[patchsize * patchsize * 4];
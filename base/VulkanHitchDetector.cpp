@@ -0,0 +1,235 @@
+/*
+* Vulkan hitch detector
+*
+* Counts heap allocations and expensive Vulkan object creation (pipelines, device memory, descriptor sets) per frame, so frame time spikes can be traced back to them
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanHitchDetector.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <algorithm>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif (defined(__linux__) && !defined(__ANDROID__)) || defined(__APPLE__)
+#include <execinfo.h>
+#define VKS_HAS_EXECINFO 1
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// The state is used by the operator new replacement, which may be called before any constructor has run, so it must be constant initialized
+		struct ThreadCounters
+		{
+			std::atomic<uint64_t> allocations;
+			std::atomic<uint64_t> bytes;
+		};
+		struct StackSample
+		{
+			std::atomic<bool> ready;
+			const char* call;
+			uint32_t depth;
+			void* frames[HitchDetector::MaxStackDepth];
+		};
+
+		std::atomic<bool> enabled{ false };
+		std::atomic<uint64_t> budget{ 0 };
+		std::atomic<uint32_t> threadCount{ 0 };
+		ThreadCounters threads[HitchDetector::MaxThreads];
+		std::atomic<uint64_t> frameAllocations{ 0 };
+		std::atomic<uint32_t> frameVulkanCalls{ 0 };
+		std::atomic<uint32_t> stackCount{ 0 };
+		StackSample stacks[HitchDetector::MaxStacks];
+
+		// Guards against counting the allocations of the detector itself (and of stack capturing)
+		thread_local bool ignoring = false;
+		thread_local uint32_t threadIndex = UINT32_MAX;
+
+		uint32_t getThreadIndex()
+		{
+			if (threadIndex == UINT32_MAX) {
+				// Threads beyond the limit share the last slot
+				const uint32_t index = threadCount.fetch_add(1, std::memory_order_relaxed);
+				threadIndex = (index < HitchDetector::MaxThreads) ? index : HitchDetector::MaxThreads - 1;
+			}
+			return threadIndex;
+		}
+
+		void captureStack(const char* call)
+		{
+			const uint32_t slot = stackCount.fetch_add(1, std::memory_order_relaxed);
+			if (slot >= HitchDetector::MaxStacks) {
+				return;
+			}
+			StackSample& sample = stacks[slot];
+			sample.call = call;
+#if defined(_WIN32)
+			sample.depth = CaptureStackBackTrace(2, HitchDetector::MaxStackDepth, sample.frames, nullptr);
+#elif defined(VKS_HAS_EXECINFO)
+			sample.depth = static_cast<uint32_t>(backtrace(sample.frames, static_cast<int>(HitchDetector::MaxStackDepth)));
+#else
+			// No stack capturing on this platform, only the call is reported
+			sample.depth = 0;
+#endif
+			sample.ready.store(true, std::memory_order_release);
+		}
+
+		std::string resolveStack(const StackSample& sample)
+		{
+			std::stringstream stack;
+			stack << sample.call;
+#if defined(VKS_HAS_EXECINFO)
+			char** symbols = backtrace_symbols(sample.frames, static_cast<int>(sample.depth));
+			if (symbols != nullptr) {
+				// The first two frames are the capture functions of the detector
+				for (uint32_t i = 2; i < sample.depth; i++) {
+					stack << " <- " << symbols[i];
+				}
+				free(symbols);
+				return stack.str();
+			}
+#endif
+			// Raw return addresses, can be resolved with the symbols of the build (e.g. with addr2line)
+			for (uint32_t i = 0; i < sample.depth; i++) {
+				stack << " <- " << sample.frames[i];
+			}
+			return stack.str();
+		}
+	}
+
+	const uint32_t HitchDetector::MaxThreads;
+	const uint32_t HitchDetector::MaxStacks;
+	const uint32_t HitchDetector::MaxStackDepth;
+
+	HitchDetector::Ignore::Ignore() : previous(ignoring)
+	{
+		ignoring = true;
+	}
+
+	HitchDetector::Ignore::~Ignore()
+	{
+		ignoring = previous;
+	}
+
+	/** @brief True if heap allocations can be counted (the build replaces the global operator new), otherwise only Vulkan calls are counted */
+	bool HitchDetector::hooksAvailable()
+	{
+#if defined(VKS_ALLOCATION_HOOKS) && VKS_ALLOCATION_HOOKS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/** @brief Start counting, frames making more heap allocations than allocationBudget are over budget */
+	void HitchDetector::start(uint64_t allocationBudget)
+	{
+		budget.store(allocationBudget, std::memory_order_relaxed);
+		for (auto& counters : threads) {
+			counters.allocations.store(0, std::memory_order_relaxed);
+			counters.bytes.store(0, std::memory_order_relaxed);
+		}
+		frameAllocations.store(0, std::memory_order_relaxed);
+		frameVulkanCalls.store(0, std::memory_order_relaxed);
+		stackCount.store(0, std::memory_order_relaxed);
+		enabled.store(true, std::memory_order_release);
+	}
+
+	bool HitchDetector::active()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/** @brief Collect and reset the counters of the frame that ended, should be called once per frame by the thread driving the frames */
+	HitchDetector::FrameStats HitchDetector::endFrame()
+	{
+		Ignore ignore;
+		FrameStats stats;
+		stats.threadCount = std::min(threadCount.load(std::memory_order_relaxed), MaxThreads);
+		for (uint32_t i = 0; i < stats.threadCount; i++) {
+			stats.threads[i].allocations = threads[i].allocations.exchange(0, std::memory_order_relaxed);
+			stats.threads[i].bytes = threads[i].bytes.exchange(0, std::memory_order_relaxed);
+			stats.allocations += stats.threads[i].allocations;
+			stats.bytes += stats.threads[i].bytes;
+		}
+		frameAllocations.store(0, std::memory_order_relaxed);
+		stats.vulkanCalls = frameVulkanCalls.exchange(0, std::memory_order_relaxed);
+		stats.overBudget = (stats.allocations > budget.load(std::memory_order_relaxed)) || (stats.vulkanCalls > 0);
+		const uint32_t captured = std::min(stackCount.load(std::memory_order_relaxed), MaxStacks);
+		for (uint32_t i = 0; i < captured; i++) {
+			if (stacks[i].ready.load(std::memory_order_acquire)) {
+				if (stats.overBudget) {
+					stats.stacks.push_back(resolveStack(stacks[i]));
+				}
+				stacks[i].ready.store(false, std::memory_order_relaxed);
+			}
+		}
+		stackCount.store(0, std::memory_order_relaxed);
+		return stats;
+	}
+
+	void HitchDetector::recordAllocation(size_t size)
+	{
+		if (!enabled.load(std::memory_order_relaxed) || ignoring) {
+			return;
+		}
+		ignoring = true;
+		ThreadCounters& counters = threads[getThreadIndex()];
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.bytes.fetch_add(size, std::memory_order_relaxed);
+		if (frameAllocations.fetch_add(1, std::memory_order_relaxed) >= budget.load(std::memory_order_relaxed)) {
+			captureStack("operator new");
+		}
+		ignoring = false;
+	}
+
+	/** @brief Count a pipeline creation, memory or descriptor set allocation call, name should be the Vulkan function */
+	void HitchDetector::recordVulkanCall(const char* name)
+	{
+		if (!enabled.load(std::memory_order_relaxed) || ignoring) {
+			return;
+		}
+		ignoring = true;
+		frameVulkanCalls.fetch_add(1, std::memory_order_relaxed);
+		captureStack(name);
+		ignoring = false;
+	}
+}
+
+#if defined(VKS_ALLOCATION_HOOKS) && VKS_ALLOCATION_HOOKS
+// Replacements of the global allocation functions, the nothrow and array variants forward to these by default
+void* operator new(std::size_t size)
+{
+	vks::HitchDetector::recordAllocation(size);
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+#endif
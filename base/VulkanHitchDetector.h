@@ -0,0 +1,77 @@
+/*
+* Vulkan hitch detector
+*
+* Counts heap allocations and expensive Vulkan object creation (pipelines, device memory, descriptor sets) per frame, so frame time spikes can be traced back to them
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace vks
+{
+	/**
+	* @brief Per frame counters of heap allocations and Vulkan calls that shouldn't happen in steady state frames
+	*
+	* Heap allocations are counted by a replacement of the global operator new, which is only compiled in with VKS_ALLOCATION_HOOKS (see hooksAvailable).
+	* Pipeline creation, device memory and descriptor set allocations are counted by the helpers of the base framework that make them
+	* (vks::createGraphicsPipelines, vks::createComputePipelines, vks::MemoryAllocator, vks::VulkanDevice::createBuffer and vks::DescriptorAllocator).
+	*
+	* Nothing is counted until start() is called, the hooks only cost a check of an atomic flag then. The counters of a frame are collected by endFrame,
+	* a frame is over budget if it made more heap allocations than the budget or any of the Vulkan calls above. The call stacks of the first allocations over
+	* the budget and of the Vulkan calls are captured without allocating and resolved to strings once the frame is collected.
+	*
+	* @note There is one detector per process, its state is shared by all threads. Allocations of worker threads are attributed to the frame that's collected next.
+	*/
+	class HitchDetector
+	{
+	public:
+		static const uint32_t MaxThreads = 32;
+		static const uint32_t MaxStacks = 8;
+		static const uint32_t MaxStackDepth = 24;
+
+		struct ThreadStats
+		{
+			uint64_t allocations = 0;
+			uint64_t bytes = 0;
+		};
+		struct FrameStats
+		{
+			/** @brief Heap allocations by thread, in the order threads first allocated (the threads that allocated before start() included) */
+			std::array<ThreadStats, MaxThreads> threads;
+			uint32_t threadCount = 0;
+			uint64_t allocations = 0;
+			uint64_t bytes = 0;
+			/** @brief Pipeline creation, memory and descriptor set allocation calls */
+			uint32_t vulkanCalls = 0;
+			bool overBudget = false;
+			/** @brief Call stacks of the offending calls, only resolved for frames over budget */
+			std::vector<std::string> stacks;
+		};
+
+		/** @brief Allocations made by the current thread while an object of this is alive aren't counted (e.g. for bookkeeping of the frame statistics) */
+		class Ignore
+		{
+		private:
+			bool previous;
+		public:
+			Ignore();
+			~Ignore();
+		};
+
+		static bool hooksAvailable();
+		static void start(uint64_t allocationBudget);
+		static bool active();
+		static FrameStats endFrame();
+		static void recordAllocation(size_t size);
+		static void recordVulkanCall(const char* name);
+	};
+}
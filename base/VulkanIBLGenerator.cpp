@@ -0,0 +1,503 @@
+/*
+* Vulkan image based lighting generator
+*
+* Generates the BRDF look-up table, irradiance (cube or spherical harmonics) and pre-filtered environment cube for image based lighting with compute shaders and caches them as KTX files
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanIBLGenerator.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+#include "VulkanAssetFile.h"
+#include "VulkanResourceCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace vks
+{
+	// Each workgroup writes 8x8 texels of one face
+	static const uint32_t workGroupSize = 8;
+	// Part of the cache key, needs to be increased whenever the shaders change their results
+	static const uint32_t cacheVersion = 1;
+
+	static uint32_t texelSize(VkFormat format)
+	{
+		return (format == VK_FORMAT_R32G32B32A32_SFLOAT) ? 16 : 8;
+	}
+
+	static uint32_t levelSize(uint32_t dim, uint32_t level)
+	{
+		return std::max(dim >> level, 1u);
+	}
+
+	IBLGenerator::~IBLGenerator()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the compute pipelines
+	*
+	* @param device Device to generate the maps on
+	* @param queue Queue (supporting compute and transfer) used for generating and uploading the maps
+	* @param brdfLutStage Stage for the BRDF look-up table compute shader (base/iblbrdflut.comp)
+	* @param irradianceStage Stage for the irradiance cube compute shader (base/iblirradiance.comp)
+	* @param prefilterStage Stage for the pre-filtered environment cube compute shader (base/iblprefilter.comp)
+	* @param shStage Stage for the spherical harmonics projection compute shader (base/iblsh.comp)
+	* @param pipelineCache Pipeline cache to use for creating the pipelines
+	*/
+	void IBLGenerator::prepare(vks::VulkanDevice* device, VkQueue queue, VkPipelineShaderStageCreateInfo brdfLutStage, VkPipelineShaderStageCreateInfo irradianceStage, VkPipelineShaderStageCreateInfo prefilterStage, VkPipelineShaderStageCreateInfo shStage, VkPipelineCache pipelineCache)
+	{
+		assert(pipelineLayout == VK_NULL_HANDLE);
+		this->device = device;
+		this->queue = queue;
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Environment cube
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Faces of the target level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Spherical harmonics coefficients
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = brdfLutStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &brdfLutPipeline));
+		pipelineCI.stage = irradianceStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &irradiancePipeline));
+		pipelineCI.stage = prefilterStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &prefilterPipeline));
+		pipelineCI.stage = shStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &shPipeline));
+	}
+
+	/** @brief Release the pipelines, the generated maps are owned by the textures passed to generate */
+	void IBLGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, brdfLutPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, irradiancePipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, prefilterPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, shPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		pipelineLayout = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/** @brief Shortens a cache key to a 64 bit FNV-1a hash that can be used in file names */
+	std::string IBLGenerator::cacheName(const std::string& key)
+	{
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (char c : key) {
+			hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+		}
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+		return name;
+	}
+
+	void IBLGenerator::createTarget(const Target& target)
+	{
+		vks::Texture* texture = target.texture;
+		texture->device = device;
+		texture->format = target.format;
+		texture->width = target.dim;
+		texture->height = target.dim;
+		texture->mipLevels = target.mipLevels;
+		texture->layerCount = target.faceCount;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = target.format;
+		imageCI.extent = { target.dim, target.dim, 1 };
+		imageCI.mipLevels = target.mipLevels;
+		imageCI.arrayLayers = target.faceCount;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Storage for generating, transfer source for caching and transfer destination for loading from the cache
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.flags = (target.faceCount == 6) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &texture->image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, texture->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &texture->deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texture->image, texture->deviceMemory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = (target.faceCount == 6) ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = target.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.faceCount };
+		viewCI.image = texture->image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texture->view));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(target.mipLevels);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &texture->sampler));
+
+		texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		texture->updateDescriptor();
+	}
+
+	/** @brief Create the target from a cache file, returns false if the file doesn't exist or doesn't match the target */
+	bool IBLGenerator::loadTarget(const Target& target)
+	{
+		vks::AssetFile file;
+		if (target.filename.empty() || !file.open(target.filename)) {
+			return false;
+		}
+		ktxTexture* ktx = nullptr;
+		if (ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx) != KTX_SUCCESS) {
+			return false;
+		}
+		const VkDeviceSize baseLevelSize = static_cast<VkDeviceSize>(target.dim) * target.dim * texelSize(target.format);
+		if ((ktx->baseWidth != target.dim) || (ktx->baseHeight != target.dim) || (ktx->numLevels != target.mipLevels) || (ktx->numFaces != target.faceCount) || (ktxTexture_GetImageSize(ktx, 0) != baseLevelSize)) {
+			std::cout << "Ignoring IBL cache file " << target.filename << " that doesn't match the generation parameters" << std::endl;
+			ktxTexture_Destroy(ktx);
+			return false;
+		}
+
+		createTarget(target);
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, ktxTexture_GetSize(ktx), ktxTexture_GetData(ktx)));
+		std::vector<VkBufferImageCopy> copyRegions;
+		for (uint32_t level = 0; level < target.mipLevels; level++) {
+			for (uint32_t face = 0; face < target.faceCount; face++) {
+				ktx_size_t offset;
+				KTX_error_code result = ktxTexture_GetImageOffset(ktx, level, 0, face, &offset);
+				assert(result == KTX_SUCCESS);
+				VkBufferImageCopy copyRegion = {};
+				copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, face, 1 };
+				copyRegion.imageExtent = { levelSize(target.dim, level), levelSize(target.dim, level), 1 };
+				copyRegion.bufferOffset = offset;
+				copyRegions.push_back(copyRegion);
+			}
+		}
+		ktxTexture_Destroy(ktx);
+
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.faceCount };
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, target.texture->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, target.texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		vks::tools::setImageLayout(copyCmd, target.texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		device->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+		return true;
+	}
+
+	/**
+	* Write the levels of a target to a KTX (version 1) file
+	*
+	* @param data Tightly packed images of all levels and faces, ordered by level first
+	*/
+	void IBLGenerator::saveTarget(const Target& target, const uint8_t* data) const
+	{
+		// KTX stores OpenGL format enums
+		const uint32_t glHalfFloat = 0x140B, glFloat = 0x1406, glRGBA = 0x1908, glRGBA16F = 0x881A, glRGBA32F = 0x8814;
+		const bool fullFloat = (target.format == VK_FORMAT_R32G32B32A32_SFLOAT);
+		const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+		const uint32_t header[13] = {
+			0x04030201,
+			fullFloat ? glFloat : glHalfFloat,
+			fullFloat ? 4u : 2u,
+			glRGBA,
+			fullFloat ? glRGBA32F : glRGBA16F,
+			glRGBA,
+			target.dim,
+			target.dim,
+			0,
+			0,
+			target.faceCount,
+			target.mipLevels,
+			0
+		};
+
+		std::ofstream file(target.filename, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "Could not write IBL cache file " << target.filename << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(identifier), sizeof(identifier));
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		// Rows and images of the supported formats are multiples of four bytes, so no padding is required
+		for (uint32_t level = 0; level < target.mipLevels; level++) {
+			const uint32_t faceSize = levelSize(target.dim, level) * levelSize(target.dim, level) * texelSize(target.format);
+			file.write(reinterpret_cast<const char*>(&faceSize), sizeof(faceSize));
+			file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(faceSize) * target.faceCount);
+			data += static_cast<size_t>(faceSize) * target.faceCount;
+		}
+	}
+
+	void IBLGenerator::dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, const Target& target, VkDescriptorImageInfo environment, PushConstants pushConstants, VkDescriptorPool descriptorPool, std::vector<VkImageView>& views)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		for (uint32_t level = 0; level < target.mipLevels; level++) {
+			// All faces of a level are written by a single dispatch through an array view
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.image = target.texture->image;
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			viewCI.format = target.format;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, target.faceCount };
+			VkImageView view;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+			views.push_back(view);
+
+			VkDescriptorSet descriptorSet;
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+			VkDescriptorImageInfo targetDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &environment),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &targetDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			// Roughness increases linearly with the mip level of the pre-filtered cube
+			pushConstants.dim = levelSize(target.dim, level);
+			pushConstants.roughness = (target.mipLevels > 1) ? static_cast<float>(level) / static_cast<float>(target.mipLevels - 1) : 0.0f;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			const uint32_t groupCount = (pushConstants.dim + workGroupSize - 1) / workGroupSize;
+			vkCmdDispatch(commandBuffer, groupCount, groupCount, target.faceCount);
+		}
+	}
+
+	/** @brief Load spherical harmonics coefficients from a cache file, returns false if the file doesn't exist or has the wrong size */
+	static bool loadSH(const std::string& filename, IBLGenerator::SHIrradiance& irradianceSH)
+	{
+		vks::AssetFile file;
+		if (filename.empty() || !file.open(filename) || (file.size() != sizeof(IBLGenerator::SHIrradiance))) {
+			return false;
+		}
+		memcpy(&irradianceSH, file.data(), sizeof(IBLGenerator::SHIrradiance));
+		return true;
+	}
+
+	static void saveSH(const std::string& filename, const IBLGenerator::SHIrradiance& irradianceSH)
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "Could not write IBL cache file " << filename << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&irradianceSH), sizeof(IBLGenerator::SHIrradiance));
+	}
+
+	/**
+	* Load the maps for an environment from the cache or generate (and cache) them
+	*
+	* @param environment Environment cube map, should have a full mip chain
+	* @param environmentFile File the environment has been loaded from, the cache files are stored next to it and named after a hash of its content
+	* @param brdfLut Target for the BRDF look-up table (NdotV along u, roughness along v)
+	* @param irradianceCube Target for the diffuse irradiance cube
+	* @param prefilteredCube Target for the pre-filtered specular cube, roughness increases linearly with the mip level
+	* @param (Optional) irradianceSH Target for the diffuse irradiance as spherical harmonics
+	*/
+	void IBLGenerator::generate(vks::TextureCubeMap& environment, const std::string& environmentFile, vks::Texture2D& brdfLut, vks::TextureCubeMap& irradianceCube, vks::TextureCubeMap& prefilteredCube, SHIrradiance* irradianceSH)
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE);
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		std::vector<Target> targets = {
+			{ "", &brdfLut, brdfLutFormat, brdfLutDim, 1, 1, brdfLutPipeline, brdfLutSamples },
+			{ "", &irradianceCube, irradianceFormat, irradianceDim, static_cast<uint32_t>(floor(log2(irradianceDim))) + 1, 6, irradiancePipeline, irradianceSamples },
+			{ "", &prefilteredCube, prefilteredFormat, prefilteredDim, static_cast<uint32_t>(floor(log2(prefilteredDim))) + 1, 6, prefilterPipeline, prefilteredSamples },
+		};
+		std::string shFilename;
+
+		vks::AssetFile environmentData;
+		if (cacheEnabled && environmentData.open(environmentFile)) {
+			// The BRDF look-up table only depends on its own parameters
+			const std::string directory = environmentFile.substr(0, environmentFile.find_last_of("/\\") + 1);
+			const std::string version = std::to_string(cacheVersion);
+			targets[0].filename = directory + "brdflut_" + cacheName(version + ":" + std::to_string(brdfLutDim) + ":" + std::to_string(brdfLutSamples) + ":" + std::to_string(brdfLutFormat)) + ".ktx";
+			// The other maps depend on the environment's content and all parameters
+			std::string key = vks::ResourceCache::hashKey(environmentData.data(), environmentData.size()) + ":" + version;
+			key += ":" + std::to_string(irradianceDim) + ":" + std::to_string(irradianceSamples) + ":" + std::to_string(irradianceFormat);
+			key += ":" + std::to_string(prefilteredDim) + ":" + std::to_string(prefilteredSamples) + ":" + std::to_string(prefilteredFormat);
+			key += ":" + std::to_string(shDim);
+			const std::string baseName = environmentFile.substr(0, environmentFile.find_last_of('.')) + "_" + cacheName(key) + "_";
+			targets[1].filename = baseName + "irradiance.ktx";
+			targets[2].filename = baseName + "prefiltered.ktx";
+			shFilename = baseName + "sh.bin";
+			environmentData.close();
+		}
+
+		// Maps found in the cache are uploaded right away, the others are generated
+		std::vector<Target> pending;
+		for (auto& target : targets) {
+			if (loadTarget(target)) {
+				continue;
+			}
+			createTarget(target);
+			pending.push_back(target);
+		}
+		const bool generateSH = (irradianceSH != nullptr) && !loadSH(shFilename, *irradianceSH);
+		loadedFromCache = pending.empty() && !generateSH;
+		if (loadedFromCache) {
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Loading IBL maps from cache took " << tDiff << " ms" << std::endl;
+			return;
+		}
+
+		uint32_t setCount = generateSH ? 1 : 0;
+		for (auto& target : pending) {
+			setCount += target.mipLevels;
+		}
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+		VkDescriptorPool descriptorPool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		std::vector<VkImageView> views;
+
+		PushConstants pushConstants{};
+		pushConstants.sourceDim = static_cast<float>(environment.width);
+		pushConstants.sourceLevels = static_cast<float>(environment.mipLevels);
+
+		// All maps are generated with a single submission, the dispatches don't depend on each other
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& target : pending) {
+			const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.faceCount };
+			vks::tools::insertImageMemoryBarrier(commandBuffer, target.texture->image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+			pushConstants.sampleCount = target.sampleCount;
+			dispatch(commandBuffer, target.pipeline, target, environment.descriptor, pushConstants, descriptorPool, views);
+		}
+
+		// The spherical harmonics are projected by a single workgroup into a host visible buffer
+		vks::Buffer shBuffer;
+		if (generateSH) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &shBuffer, sizeof(SHIrradiance)));
+			VkDescriptorSet descriptorSet;
+			VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+			VkDescriptorImageInfo environmentDescriptor = environment.descriptor;
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &environmentDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &shBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shPipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			pushConstants.dim = shDim;
+			pushConstants.sampleCount = 0;
+			pushConstants.roughness = 0.0f;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		// Copy the generated maps to a host visible buffer for writing the cache files
+		vks::Buffer readbackBuffer;
+		std::vector<VkDeviceSize> readbackOffsets;
+		VkDeviceSize readbackSize = 0;
+		for (auto& target : pending) {
+			readbackOffsets.push_back(readbackSize);
+			if (target.filename.empty()) {
+				continue;
+			}
+			for (uint32_t level = 0; level < target.mipLevels; level++) {
+				readbackSize += static_cast<VkDeviceSize>(levelSize(target.dim, level)) * levelSize(target.dim, level) * texelSize(target.format) * target.faceCount;
+			}
+		}
+		if (readbackSize > 0) {
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readbackBuffer, readbackSize));
+		}
+		for (size_t i = 0; i < pending.size(); i++) {
+			const Target& target = pending[i];
+			const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.faceCount };
+			if (target.filename.empty()) {
+				vks::tools::insertImageMemoryBarrier(commandBuffer, target.texture->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange);
+				continue;
+			}
+			vks::tools::insertImageMemoryBarrier(commandBuffer, target.texture->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+			std::vector<VkBufferImageCopy> copyRegions;
+			VkDeviceSize offset = readbackOffsets[i];
+			for (uint32_t level = 0; level < target.mipLevels; level++) {
+				for (uint32_t face = 0; face < target.faceCount; face++) {
+					VkBufferImageCopy copyRegion = {};
+					copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, face, 1 };
+					copyRegion.imageExtent = { levelSize(target.dim, level), levelSize(target.dim, level), 1 };
+					copyRegion.bufferOffset = offset;
+					copyRegions.push_back(copyRegion);
+					offset += static_cast<VkDeviceSize>(levelSize(target.dim, level)) * levelSize(target.dim, level) * texelSize(target.format);
+				}
+			}
+			vkCmdCopyImageToBuffer(commandBuffer, target.texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+			vks::tools::insertImageMemoryBarrier(commandBuffer, target.texture->image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange);
+		}
+		if (readbackSize > 0) {
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		device->flushCommandBuffer(commandBuffer, queue, true);
+
+		for (auto view : views) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+
+		auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "Generating " << pending.size() << " IBL map(s)" << (generateSH ? " and spherical harmonics" : "") << " with compute shaders took " << tDiff << " ms" << std::endl;
+
+		if (generateSH) {
+			VK_CHECK_RESULT(shBuffer.map());
+			memcpy(irradianceSH, shBuffer.mapped, sizeof(SHIrradiance));
+			shBuffer.destroy();
+			if (!shFilename.empty()) {
+				saveSH(shFilename, *irradianceSH);
+			}
+		}
+		if (readbackSize > 0) {
+			VK_CHECK_RESULT(readbackBuffer.map());
+			for (size_t i = 0; i < pending.size(); i++) {
+				if (!pending[i].filename.empty()) {
+					saveTarget(pending[i], static_cast<const uint8_t*>(readbackBuffer.mapped) + readbackOffsets[i]);
+				}
+			}
+			readbackBuffer.destroy();
+		}
+	}
+}
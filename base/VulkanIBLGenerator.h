@@ -0,0 +1,113 @@
+/*
+* Vulkan image based lighting generator
+*
+* Generates the BRDF look-up table, irradiance (cube or spherical harmonics) and pre-filtered environment cube for image based lighting with compute shaders and caches them as KTX files
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Compute shader based precomputation of the maps used for image based lighting
+	*
+	* All maps are generated with a single submission, one dispatch per target level (with a workgroup per 8x8 texels of all six faces).
+	* The irradiance and pre-filtered cubes importance sample the environment (cosine and GGX distributed) and read each sample from the
+	* environment's mip level whose texel footprint matches the sample's solid angle, so few samples are needed without aliasing.
+	*
+	* Results are written to KTX files next to the environment map, named after a hash of the environment's content and the generation parameters.
+	* Later runs load these files instead, changing the environment or any parameter results in a different name and a new file.
+	* The BRDF look-up table doesn't depend on the environment, so its file is shared by all environments (and samples) in the same directory.
+	*
+	* @note The environment map should come with a full mip chain for the filtered lookups
+	*/
+	class IBLGenerator
+	{
+	public:
+		/**
+		* @brief Diffuse irradiance as L2 spherical harmonics (rgb, w unused), a cheaper alternative to the irradiance cube
+		*
+		* The coefficients are convolved with the cosine lobe and divided by PI, so evaluating them for a normal returns the same value
+		* as sampling the irradiance cube. Order: L00, L1-1, L10, L11, L2-2, L2-1, L20, L21, L22.
+		*/
+		struct SHIrradiance
+		{
+			float coefficients[9][4];
+		};
+
+	private:
+		struct PushConstants
+		{
+			uint32_t dim;
+			uint32_t sampleCount;
+			float roughness;
+			float sourceDim;
+			float sourceLevels;
+		};
+		struct Target
+		{
+			std::string filename;
+			vks::Texture* texture;
+			VkFormat format;
+			uint32_t dim;
+			uint32_t mipLevels;
+			uint32_t faceCount;
+			VkPipeline pipeline;
+			uint32_t sampleCount;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkPipeline brdfLutPipeline = VK_NULL_HANDLE;
+		VkPipeline irradiancePipeline = VK_NULL_HANDLE;
+		VkPipeline prefilterPipeline = VK_NULL_HANDLE;
+		VkPipeline shPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+
+		static std::string cacheName(const std::string& key);
+		void createTarget(const Target& target);
+		bool loadTarget(const Target& target);
+		void saveTarget(const Target& target, const uint8_t* data) const;
+		void dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, const Target& target, VkDescriptorImageInfo environment, PushConstants pushConstants, VkDescriptorPool descriptorPool, std::vector<VkImageView>& views);
+
+	public:
+		/** @brief Format of the BRDF look-up table, red and green are used (RG16F storage images aren't guaranteed to be supported) */
+		static const VkFormat brdfLutFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		static const VkFormat irradianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		static const VkFormat prefilteredFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		/** @brief Generation parameters, these are part of the cache file names */
+		uint32_t brdfLutDim = 512;
+		uint32_t brdfLutSamples = 1024;
+		uint32_t irradianceDim = 64;
+		uint32_t irradianceSamples = 256;
+		uint32_t prefilteredDim = 512;
+		uint32_t prefilteredSamples = 64;
+		/** @brief Number of texels per face and dimension the environment is projected to spherical harmonics from */
+		uint32_t shDim = 64;
+		/** @brief Load and save generated maps from/to KTX files next to the environment map */
+		bool cacheEnabled = true;
+		/** @brief True if the last generate call loaded all maps from the cache */
+		bool loadedFromCache = false;
+
+		~IBLGenerator();
+		void prepare(vks::VulkanDevice* device, VkQueue queue, VkPipelineShaderStageCreateInfo brdfLutStage, VkPipelineShaderStageCreateInfo irradianceStage, VkPipelineShaderStageCreateInfo prefilterStage, VkPipelineShaderStageCreateInfo shStage, VkPipelineCache pipelineCache);
+		void destroy();
+		void generate(vks::TextureCubeMap& environment, const std::string& environmentFile, vks::Texture2D& brdfLut, vks::TextureCubeMap& irradianceCube, vks::TextureCubeMap& prefilteredCube, SHIrradiance* irradianceSH = nullptr);
+	};
+}
@@ -0,0 +1,583 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from larger device memory blocks to keep the number of vkAllocateMemory calls low
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryAllocator.h"
+#include "VulkanHitchDetector.h"
+#include <algorithm>
+
+namespace vks
+{
+	namespace
+	{
+		VkDeviceSize getUsedBytes(const MemoryBlock& block)
+		{
+			if (block.strategy == AllocationStrategy::Linear) {
+				return block.linearOffset;
+			}
+			VkDeviceSize freeBytes = 0;
+			for (auto& range : block.freeRanges) {
+				freeBytes += range.size;
+			}
+			return block.size - freeBytes;
+		}
+
+		VkDeviceSize getLargestFreeRange(const MemoryBlock& block)
+		{
+			if (block.strategy == AllocationStrategy::Linear) {
+				return block.size - block.linearOffset;
+			}
+			VkDeviceSize largest = 0;
+			for (auto& range : block.freeRanges) {
+				largest = std::max(largest, range.size);
+			}
+			return largest;
+		}
+	}
+
+	/**
+	* Build the lookup table for the memory types of a physical device
+	*
+	* @param memoryProperties Memory properties of the physical device
+	*/
+	void MemoryTypeLookup::setup(const VkPhysicalDeviceMemoryProperties& memoryProperties)
+	{
+		typeCount = memoryProperties.memoryTypeCount;
+		for (uint32_t i = 0; i < typeCount; i++) {
+			typeFlags[i] = memoryProperties.memoryTypes[i].propertyFlags;
+		}
+		for (uint32_t flags = 0; flags < flagCombinations; flags++)
+		{
+			typeMasks[flags] = 0;
+			for (uint32_t i = 0; i < typeCount; i++) {
+				if ((typeFlags[i] & flags) == flags) {
+					typeMasks[flags] |= (1u << i);
+				}
+			}
+		}
+	}
+
+	/**
+	* Find the first memory type that is allowed for a resource and has all the requested property flags
+	*
+	* @param typeBits Bit mask of the memory types supported by the resource (from VkMemoryRequirements)
+	* @param properties Property flags the memory type needs to have
+	* @param memoryTypeIndex Index of the matching memory type
+	*
+	* @return True if a matching memory type has been found
+	*/
+	bool MemoryTypeLookup::find(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t* memoryTypeIndex) const
+	{
+		uint32_t mask = 0;
+		if (properties < flagCombinations)
+		{
+			mask = typeMasks[properties];
+		}
+		else
+		{
+			for (uint32_t i = 0; i < typeCount; i++) {
+				if ((typeFlags[i] & properties) == properties) {
+					mask |= (1u << i);
+				}
+			}
+		}
+		mask &= typeBits;
+		if (mask == 0) {
+			return false;
+		}
+		uint32_t index = 0;
+		while (!(mask & 1u)) {
+			mask >>= 1;
+			index++;
+		}
+		*memoryTypeIndex = index;
+		return true;
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the allocator for a logical device
+	*
+	* @param device Logical device to allocate memory from
+	* @param physicalDevice Physical device used to get memory properties and limits
+	*/
+	void MemoryAllocator::setup(VkDevice device, VkPhysicalDevice physicalDevice)
+	{
+		this->device = device;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		memoryTypeLookup.setup(memoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		bufferImageGranularity = std::max(properties.limits.bufferImageGranularity, (VkDeviceSize)1);
+		nonCoherentAtomSize = std::max(properties.limits.nonCoherentAtomSize, (VkDeviceSize)1);
+	}
+
+	uint32_t MemoryAllocator::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+	{
+		uint32_t memoryTypeIndex;
+		if (!memoryTypeLookup.find(typeBits, properties, &memoryTypeIndex)) {
+			throw std::runtime_error("Could not find a matching memory type");
+		}
+		return memoryTypeIndex;
+	}
+
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		// Don't let a single block take up a large part of small heaps (e.g. the host visible device local heap on some discrete GPUs)
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		return std::min(defaultBlockSize, heapSize / 8);
+	}
+
+	VkResult MemoryAllocator::createBlock(const PoolKey& key, VkDeviceSize size, bool dedicated, MemoryBlock** block)
+	{
+		std::unique_ptr<MemoryBlock> newBlock(new MemoryBlock());
+		newBlock->size = size;
+		newBlock->memoryTypeIndex = key.memoryTypeIndex;
+		newBlock->resourceType = key.resourceType;
+		newBlock->strategy = key.strategy;
+		newBlock->dedicated = dedicated;
+		newBlock->freeRanges.push_back({ 0, size });
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = key.memoryTypeIndex;
+		// Blocks for buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set need to be allocated with the appropriate flag
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (key.resourceType == ResourceTypeDeviceAddress) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		HitchDetector::recordVulkanCall("vkAllocateMemory");
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &newBlock->memory);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+
+		// Host visible blocks are mapped persistently, as a memory object can only be mapped once
+		if (memoryProperties.memoryTypes[key.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			VK_CHECK_RESULT(vkMapMemory(device, newBlock->memory, 0, VK_WHOLE_SIZE, 0, &newBlock->mapped));
+		}
+
+		heapUsage[memoryProperties.memoryTypes[key.memoryTypeIndex].heapIndex] += size;
+		*block = newBlock.get();
+		pools[key].push_back(std::move(newBlock));
+		return VK_SUCCESS;
+	}
+
+	bool MemoryAllocator::allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+	{
+		if (block->strategy == AllocationStrategy::Linear)
+		{
+			const VkDeviceSize alignedOffset = vks::tools::alignedVkSize(block->linearOffset, alignment);
+			if (alignedOffset + size > block->size) {
+				return false;
+			}
+			block->linearOffset = alignedOffset + size;
+			*offset = alignedOffset;
+			return true;
+		}
+
+		// Find the smallest free range that fits the aligned allocation
+		auto bestFit = block->freeRanges.end();
+		for (auto range = block->freeRanges.begin(); range != block->freeRanges.end(); range++)
+		{
+			const VkDeviceSize alignedOffset = vks::tools::alignedVkSize(range->offset, alignment);
+			if ((alignedOffset + size <= range->offset + range->size) && ((bestFit == block->freeRanges.end()) || (range->size < bestFit->size))) {
+				bestFit = range;
+			}
+		}
+		if (bestFit == block->freeRanges.end()) {
+			return false;
+		}
+
+		// Split the range, padding in front of the allocation and any remaining space stay in the free list
+		const MemoryBlock::Range range = *bestFit;
+		const VkDeviceSize alignedOffset = vks::tools::alignedVkSize(range.offset, alignment);
+		const VkDeviceSize rangeEnd = range.offset + range.size;
+		auto it = block->freeRanges.erase(bestFit);
+		if (alignedOffset + size < rangeEnd) {
+			it = block->freeRanges.insert(it, { alignedOffset + size, rangeEnd - (alignedOffset + size) });
+		}
+		if (alignedOffset > range.offset) {
+			block->freeRanges.insert(it, { range.offset, alignedOffset - range.offset });
+		}
+		*offset = alignedOffset;
+		return true;
+	}
+
+	void MemoryAllocator::freeBlock(MemoryBlock* block)
+	{
+		PoolKey key{ block->memoryTypeIndex, block->resourceType, block->strategy };
+		std::vector<std::unique_ptr<MemoryBlock>>& blocks = pools[key];
+		if (block->mapped) {
+			vkUnmapMemory(device, block->memory);
+		}
+		vkFreeMemory(device, block->memory, nullptr);
+		heapUsage[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex] -= block->size;
+		blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; }), blocks.end());
+	}
+
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, AllocationStrategy strategy, Allocation* allocation)
+	{
+		assert(device != VK_NULL_HANDLE);
+		std::lock_guard<std::mutex> lock(mutex);
+
+		VkDeviceSize size = memoryRequirements.size;
+		VkDeviceSize alignment = std::max(memoryRequirements.alignment, (VkDeviceSize)1);
+		// Offsets and sizes of allocations in non-coherent memory need to be multiples of nonCoherentAtomSize, so ranges can be flushed without touching neighbouring allocations
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = vks::tools::alignedVkSize(size, nonCoherentAtomSize);
+		}
+
+		const PoolKey key{ memoryTypeIndex, resourceType, strategy };
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+
+		MemoryBlock* block = nullptr;
+		VkDeviceSize offset = 0;
+		if (size > blockSize / 2)
+		{
+			// Large resources get a block of their own
+			VkResult result = createBlock(key, size, true, &block);
+			if (result != VK_SUCCESS) {
+				return result;
+			}
+			allocateFromBlock(block, size, alignment, &offset);
+		}
+		else
+		{
+			for (auto& poolBlock : pools[key])
+			{
+				if (!poolBlock->dedicated && allocateFromBlock(poolBlock.get(), size, alignment, &offset)) {
+					block = poolBlock.get();
+					break;
+				}
+			}
+			if (!block)
+			{
+				VkResult result = createBlock(key, blockSize, false, &block);
+				if (result != VK_SUCCESS) {
+					return result;
+				}
+				allocateFromBlock(block, size, alignment, &offset);
+			}
+		}
+
+		block->allocationCount++;
+		allocation->memory = block->memory;
+		allocation->offset = offset;
+		allocation->size = size;
+		allocation->alignment = alignment;
+		allocation->mapped = block->mapped ? (static_cast<uint8_t*>(block->mapped) + offset) : nullptr;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->allocator = this;
+		allocation->block = block;
+		report.track(allocation->memory, allocation->offset, allocation->size, MemoryCategory::Other);
+		return VK_SUCCESS;
+	}
+
+	/**
+	* Allocate memory for a buffer and bind it
+	*
+	* @param buffer Buffer to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for the buffer (i.e. device local, host visible, coherent)
+	* @param deviceAddress Set to true if the buffer has been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	* @param allocation Pointer to the allocation that receives the memory range
+	* @param strategy (Optional) Strategy for placing the allocation inside a memory block (Defaults to AllocationStrategy::FreeList)
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound to the buffer
+	*/
+	VkResult MemoryAllocator::allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, bool deviceAddress, Allocation* allocation, AllocationStrategy strategy)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+		VkResult result = allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), deviceAddress ? ResourceTypeDeviceAddress : ResourceTypeLinear, strategy, allocation);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Allocate memory for an image and bind it
+	*
+	* @param image Image to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for the image (usually device local)
+	* @param linearTiling Set to true if the image has been created with VK_IMAGE_TILING_LINEAR
+	* @param allocation Pointer to the allocation that receives the memory range
+	* @param strategy (Optional) Strategy for placing the allocation inside a memory block (Defaults to AllocationStrategy::FreeList)
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound to the image
+	*/
+	VkResult MemoryAllocator::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, bool linearTiling, Allocation* allocation, AllocationStrategy strategy)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, image, &memReqs);
+		// Optimal tiled images only need to be kept apart from linear resources if the implementation has a granularity larger than one byte
+		const ResourceType resourceType = (linearTiling || bufferImageGranularity <= 1) ? ResourceTypeLinear : ResourceTypeOptimal;
+		VkResult result = allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), resourceType, strategy, allocation);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+		return vkBindImageMemory(device, image, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Return an allocation to its memory block
+	*
+	* @param allocation Allocation to free, is reset afterwards
+	*/
+	void MemoryAllocator::free(Allocation& allocation)
+	{
+		if (!allocation.valid()) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+
+		report.untrack(allocation.memory, allocation.offset);
+		MemoryBlock* block = allocation.block;
+		assert(block->allocationCount > 0);
+		block->allocationCount--;
+		block->movable.erase(allocation.offset);
+		if (block->strategy == AllocationStrategy::Linear)
+		{
+			if (block->allocationCount == 0) {
+				block->linearOffset = 0;
+			}
+		}
+		else
+		{
+			// Insert the range back into the sorted free list and merge it with adjacent free ranges
+			std::vector<MemoryBlock::Range>& ranges = block->freeRanges;
+			auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const MemoryBlock::Range& range, VkDeviceSize offset) { return range.offset < offset; });
+			auto it = ranges.insert(next, { allocation.offset, allocation.size });
+			auto following = it + 1;
+			if ((following != ranges.end()) && (it->offset + it->size == following->offset)) {
+				it->size += following->size;
+				ranges.erase(following);
+			}
+			if (it != ranges.begin()) {
+				auto previous = it - 1;
+				if (previous->offset + previous->size == it->offset) {
+					previous->size += it->size;
+					ranges.erase(it);
+				}
+			}
+		}
+
+		// Keep at least one empty block per pool around for reuse, dedicated blocks are released right away
+		if (block->allocationCount == 0) {
+			PoolKey key{ block->memoryTypeIndex, block->resourceType, block->strategy };
+			if (block->dedicated || (pools[key].size() > 1)) {
+				freeBlock(block);
+			}
+		}
+
+		allocation = Allocation();
+	}
+
+	/** @brief Release all memory blocks */
+	void MemoryAllocator::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.second)
+			{
+				if (block->mapped) {
+					vkUnmapMemory(device, block->memory);
+				}
+				vkFreeMemory(device, block->memory, nullptr);
+			}
+		}
+		pools.clear();
+		heapUsage.fill(0);
+	}
+
+	/**
+	* Set the category and debug name of an allocation in the memory report
+	*
+	* @param allocation Allocation handed out by this allocator
+	* @param category What the resource bound to the allocation is used for
+	* @param name (Optional) Debug name of the resource
+	*/
+	void MemoryAllocator::tag(const Allocation& allocation, MemoryCategory category, const std::string& name)
+	{
+		if (allocation.valid()) {
+			report.tag(allocation.memory, allocation.offset, category, name);
+		}
+	}
+
+	/** @brief Returns the number of device memory allocations made by the allocator */
+	uint32_t MemoryAllocator::getBlockCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t count = 0;
+		for (auto& pool : pools) {
+			count += static_cast<uint32_t>(pool.second.size());
+		}
+		return count;
+	}
+
+	/** @brief Returns the number of allocations handed out by the allocator */
+	uint32_t MemoryAllocator::getAllocationCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t count = 0;
+		for (auto& pool : pools) {
+			for (auto& block : pool.second) {
+				count += block->allocationCount;
+			}
+		}
+		return count;
+	}
+
+	/** @brief Returns the size of the device memory allocated by the allocator from the given heap */
+	VkDeviceSize MemoryAllocator::getHeapUsage(uint32_t heapIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return heapUsage[heapIndex];
+	}
+
+	/**
+	* Allow defragmentation to move an allocation to another block, the registration is removed once the allocation is freed or has been moved
+	*
+	* @param allocation Allocation handed out by this allocator
+	* @param move Function that moves the resource bound to the allocation (see MoveFunction), called from VulkanDevice::defragment
+	*
+	* @note Only device local allocations in shared free list blocks are moved, host visible memory may be written by the CPU at any time
+	*/
+	void MemoryAllocator::setMovable(const Allocation& allocation, MoveFunction move)
+	{
+		if (!allocation.valid()) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryBlock* block = allocation.block;
+		if (block->dedicated || (block->strategy != AllocationStrategy::FreeList) || (block->mapped != nullptr)) {
+			return;
+		}
+		block->movable[allocation.offset] = { allocation.size, allocation.alignment, move };
+	}
+
+	/**
+	* Plan a defragmentation step, that moves allocations out of the least used block of a pool into the fuller blocks of the same pool
+	*
+	* Blocks that have been emptied are released once the moved resources have been retired, so the number of blocks goes down over time
+	* instead of growing with each reload of a resource. Moves never create new blocks.
+	*
+	* @param maxBytes Number of bytes that may be moved by this step
+	*
+	* @return Moves to be executed by the caller, the destinations have been allocated and the allocations have been removed from the movable ones
+	*/
+	std::vector<MemoryAllocator::Move> MemoryAllocator::planDefragmentation(VkDeviceSize maxBytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Move> moves;
+		VkDeviceSize plannedBytes = 0;
+		for (auto& pool : pools)
+		{
+			if ((pool.first.strategy != AllocationStrategy::FreeList) || (plannedBytes >= maxBytes)) {
+				continue;
+			}
+			// Source is the least used shared block that has anything to move, destinations are the other shared blocks from the fullest to the emptiest
+			MemoryBlock* source = nullptr;
+			VkDeviceSize sourceUsed = 0;
+			for (auto& block : pool.second)
+			{
+				if (block->dedicated || block->movable.empty()) {
+					continue;
+				}
+				const VkDeviceSize used = getUsedBytes(*block);
+				if ((source == nullptr) || (used < sourceUsed)) {
+					source = block.get();
+					sourceUsed = used;
+				}
+			}
+			// Nothing is allocated for pools without movable allocations, so enabling defragmentation doesn't add per frame allocations
+			if ((source == nullptr) || (pool.second.size() < 2)) {
+				continue;
+			}
+			std::vector<std::pair<VkDeviceSize, MemoryBlock*>>& blocks = defragmentationBlocks;
+			blocks.clear();
+			for (auto& block : pool.second)
+			{
+				if (!block->dedicated && (block.get() != source)) {
+					blocks.push_back({ getUsedBytes(*block), block.get() });
+				}
+			}
+			std::sort(blocks.begin(), blocks.end(), [](const std::pair<VkDeviceSize, MemoryBlock*>& a, const std::pair<VkDeviceSize, MemoryBlock*>& b) { return a.first > b.first; });
+			for (auto it = source->movable.begin(); (it != source->movable.end()) && (plannedBytes < maxBytes);)
+			{
+				const MemoryBlock::Movable& movable = it->second;
+				MemoryBlock* destination = nullptr;
+				VkDeviceSize offset = 0;
+				for (auto& block : blocks)
+				{
+					// Moving into a block that's emptier than the source would only shift the fragmentation around
+					if ((block.first >= sourceUsed) && allocateFromBlock(block.second, movable.size, movable.alignment, &offset)) {
+						destination = block.second;
+						break;
+					}
+				}
+				if (destination == nullptr) {
+					++it;
+					continue;
+				}
+				destination->allocationCount++;
+				Move move;
+				move.destination.memory = destination->memory;
+				move.destination.offset = offset;
+				move.destination.size = movable.size;
+				move.destination.alignment = movable.alignment;
+				move.destination.memoryTypeIndex = destination->memoryTypeIndex;
+				move.destination.allocator = this;
+				move.destination.block = destination;
+				move.move = movable.move;
+				report.track(move.destination.memory, move.destination.offset, move.destination.size, MemoryCategory::Other);
+				moves.push_back(move);
+				plannedBytes += movable.size;
+				bytesMoved += movable.size;
+				allocationsMoved++;
+				it = source->movable.erase(it);
+			}
+		}
+		return moves;
+	}
+
+	/** @brief Returns the number of blocks, how much of the shared blocks is in use and how fragmented their free memory is */
+	FragmentationStats MemoryAllocator::getFragmentationStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		FragmentationStats stats;
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.second)
+			{
+				stats.blockCount++;
+				stats.allocationCount += block->allocationCount;
+				stats.movableCount += static_cast<uint32_t>(block->movable.size());
+				if (!block->dedicated) {
+					stats.sharedBlockBytes += block->size;
+					stats.usedBytes += getUsedBytes(*block);
+					stats.largestFreeRange = std::max(stats.largestFreeRange, getLargestFreeRange(*block));
+				}
+			}
+		}
+		stats.bytesMoved = bytesMoved;
+		stats.allocationsMoved = allocationsMoved;
+		return stats;
+	}
+}
@@ -0,0 +1,212 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from larger device memory blocks to keep the number of vkAllocateMemory calls low
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryReport.h"
+
+namespace vks
+{
+	class MemoryAllocator;
+	struct MemoryBlock;
+
+	/** @brief Strategy used to place allocations inside a memory block */
+	enum class AllocationStrategy
+	{
+		/** @brief Best fit search over a list of free ranges, freed ranges are merged with their neighbours and can be reused */
+		FreeList,
+		/** @brief Allocations are placed one after another, memory is only reclaimed once all allocations of a block have been freed */
+		Linear
+	};
+
+	/**
+	* @brief Precomputed memory type lookup
+	*
+	* Stores a bit mask of the matching memory types for every combination of the property flags known to the headers, so finding a memory type
+	* for a resource is a bit mask test instead of a scan over all memory types. Flags outside of the table fall back to a scan.
+	*/
+	struct MemoryTypeLookup
+	{
+		static const uint32_t flagCombinations = 256;
+		uint32_t typeMasks[flagCombinations] = {};
+		VkMemoryPropertyFlags typeFlags[VK_MAX_MEMORY_TYPES] = {};
+		uint32_t typeCount = 0;
+
+		void setup(const VkPhysicalDeviceMemoryProperties& memoryProperties);
+		bool find(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t* memoryTypeIndex) const;
+	};
+
+	/**
+	* @brief A range of device memory handed out by the memory allocator
+	* @note memory and offset must be used when binding, mapped (if not null) points to the start of the allocation
+	*/
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Alignment the allocation has been placed with, also used when it's moved by defragmentation */
+		VkDeviceSize alignment = 1;
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		MemoryAllocator* allocator = nullptr;
+		MemoryBlock* block = nullptr;
+		/** @brief Returns true if this allocation has been handed out by a memory allocator (and not been freed yet) */
+		bool valid() const { return block != nullptr; }
+	};
+
+	/**
+	* @brief Moves the resource bound to an allocation to a new allocation (see MemoryAllocator::setMovable)
+	*
+	* Called with the destination allocation and a command buffer, the function must create a new resource bound to the destination, record the copy of the
+	* contents into the command buffer, retire the old resource (which frees the old allocation) and update all references to it (descriptors, command buffers)
+	*/
+	typedef std::function<void(const Allocation& destination, VkCommandBuffer commandBuffer)> MoveFunction;
+
+	/** @brief A single device memory allocation that is split up into multiple allocations */
+	struct MemoryBlock
+	{
+		struct Range
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		uint32_t resourceType = 0;
+		AllocationStrategy strategy = AllocationStrategy::FreeList;
+		/** @brief Blocks created for a single large resource are released as soon as that resource is freed */
+		bool dedicated = false;
+		uint32_t allocationCount = 0;
+		/** @brief Free ranges sorted by offset (free list strategy) */
+		std::vector<Range> freeRanges;
+		/** @brief Offset of the next allocation (linear strategy) */
+		VkDeviceSize linearOffset = 0;
+		struct Movable
+		{
+			VkDeviceSize size;
+			VkDeviceSize alignment;
+			MoveFunction move;
+		};
+		/** @brief Allocations whose owners can move them to another block, by offset */
+		std::map<VkDeviceSize, Movable> movable;
+	};
+
+	/** @brief Block usage and fragmentation of the memory allocator */
+	struct FragmentationStats
+	{
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t movableCount = 0;
+		/** @brief Size of all blocks shared by multiple allocations (dedicated blocks are always fully used) */
+		VkDeviceSize sharedBlockBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+		/** @brief Totals of all defragmentation steps so far */
+		VkDeviceSize bytesMoved = 0;
+		uint32_t allocationsMoved = 0;
+		/** @brief Share of the free memory that's not part of the largest free range (0 = not fragmented, towards 1 = free memory is split into many small ranges) */
+		float fragmentation() const
+		{
+			const VkDeviceSize freeBytes = sharedBlockBytes - usedBytes;
+			return (freeBytes > 0) ? 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes) : 0.0f;
+		}
+	};
+
+	/**
+	* @brief Block based device memory sub-allocator
+	*
+	* Keeps a list of memory blocks for each memory type. Buffers that need a device address and (if bufferImageGranularity requires it)
+	* optimally tiled images are placed in separate blocks, so linear and non-linear resources never share a granularity page.
+	*/
+	class MemoryAllocator
+	{
+	private:
+		/** @brief Key for a list of blocks that allocations can share */
+		struct PoolKey
+		{
+			uint32_t memoryTypeIndex;
+			uint32_t resourceType;
+			AllocationStrategy strategy;
+			bool operator<(const PoolKey& other) const
+			{
+				if (memoryTypeIndex != other.memoryTypeIndex) return memoryTypeIndex < other.memoryTypeIndex;
+				if (resourceType != other.resourceType) return resourceType < other.resourceType;
+				return strategy < other.strategy;
+			}
+		};
+		enum ResourceType : uint32_t
+		{
+			ResourceTypeLinear = 0,
+			ResourceTypeOptimal = 1,
+			ResourceTypeDeviceAddress = 2
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		MemoryTypeLookup memoryTypeLookup;
+		// Size of the blocks allocated from each heap
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapUsage{};
+		VkDeviceSize bufferImageGranularity = 1;
+		VkDeviceSize nonCoherentAtomSize = 1;
+		std::map<PoolKey, std::vector<std::unique_ptr<MemoryBlock>>> pools;
+		VkDeviceSize bytesMoved = 0;
+		uint32_t allocationsMoved = 0;
+		// Destination candidates of a defragmentation step (used bytes and block), kept to not allocate on each step
+		std::vector<std::pair<VkDeviceSize, MemoryBlock*>> defragmentationBlocks;
+		// Allocations can be requested from multiple threads (e.g. while loading assets in the background)
+		std::mutex mutex;
+
+		uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		VkResult createBlock(const PoolKey& key, VkDeviceSize size, bool dedicated, MemoryBlock** block);
+		bool allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+		void freeBlock(MemoryBlock* block);
+		VkResult allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, AllocationStrategy strategy, Allocation* allocation);
+
+	public:
+		/** @brief Default size of the memory blocks allocated from device local heaps (smaller heaps use smaller blocks) */
+		VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+		/** @brief Memory footprint by category, covers all allocations of the allocator and resources with memory of their own that have been added by their owners */
+		MemoryReport report;
+
+		~MemoryAllocator();
+		void setup(VkDevice device, VkPhysicalDevice physicalDevice);
+		VkResult allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags memoryPropertyFlags, bool deviceAddress, Allocation* allocation, AllocationStrategy strategy = AllocationStrategy::FreeList);
+		VkResult allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, bool linearTiling, Allocation* allocation, AllocationStrategy strategy = AllocationStrategy::FreeList);
+		void free(Allocation& allocation);
+		void tag(const Allocation& allocation, MemoryCategory category, const std::string& name = "");
+		void destroy();
+		uint32_t getBlockCount();
+		uint32_t getAllocationCount();
+		VkDeviceSize getHeapUsage(uint32_t heapIndex);
+
+		/** @brief A planned move of a movable allocation, the destination has already been allocated */
+		struct Move
+		{
+			Allocation destination;
+			MoveFunction move;
+		};
+		void setMovable(const Allocation& allocation, MoveFunction move);
+		std::vector<Move> planDefragmentation(VkDeviceSize maxBytes);
+		FragmentationStats getFragmentationStats();
+	};
+}
@@ -0,0 +1,146 @@
+/*
+* Vulkan device memory report
+*
+* Tracks the device memory taken up by resources, grouped into categories (textures, geometry, render targets, ...)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryReport.h"
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Add a resource to the report
+	*
+	* @param memory Memory the resource is bound to
+	* @param offset Offset of the resource in memory
+	* @param size Size of the memory taken up by the resource
+	* @param category What the resource is used for
+	* @param name (Optional) Debug name shown in the report
+	*/
+	void MemoryReport::track(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, MemoryCategory category, const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry& entry = entries[std::make_pair(memory, offset)];
+		if (entry.size > 0) {
+			current[static_cast<size_t>(entry.category)] -= entry.size;
+		}
+		entry = { category, size, name };
+		const size_t index = static_cast<size_t>(category);
+		current[index] += size;
+		peak[index] = std::max(peak[index], current[index]);
+	}
+
+	/** @brief Remove a resource from the report, resources that haven't been tracked are ignored */
+	void MemoryReport::untrack(VkDeviceMemory memory, VkDeviceSize offset)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(std::make_pair(memory, offset));
+		if (entry != entries.end()) {
+			current[static_cast<size_t>(entry->second.category)] -= entry->second.size;
+			entries.erase(entry);
+		}
+	}
+
+	/** @brief Change the category and name of a tracked resource (e.g. an allocation of the memory allocator) */
+	void MemoryReport::tag(VkDeviceMemory memory, VkDeviceSize offset, MemoryCategory category, const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(std::make_pair(memory, offset));
+		if (entry == entries.end()) {
+			return;
+		}
+		current[static_cast<size_t>(entry->second.category)] -= entry->second.size;
+		entry->second.category = category;
+		if (!name.empty()) {
+			entry->second.name = name;
+		}
+		const size_t index = static_cast<size_t>(category);
+		current[index] += entry->second.size;
+		peak[index] = std::max(peak[index], current[index]);
+	}
+
+	VkDeviceSize MemoryReport::getUsage(MemoryCategory category)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return current[static_cast<size_t>(category)];
+	}
+
+	/** @brief Highest usage of the category since the device has been created */
+	VkDeviceSize MemoryReport::getPeakUsage(MemoryCategory category)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return peak[static_cast<size_t>(category)];
+	}
+
+	VkDeviceSize MemoryReport::getTotalUsage()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		VkDeviceSize total = 0;
+		for (VkDeviceSize usage : current) {
+			total += usage;
+		}
+		return total;
+	}
+
+	/** @brief Returns the largest tracked resources, largest first */
+	std::vector<MemoryReport::Entry> MemoryReport::getLargestEntries(uint32_t count)
+	{
+		std::vector<Entry> largest;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			largest.reserve(entries.size());
+			for (auto& entry : entries) {
+				largest.push_back(entry.second);
+			}
+		}
+		const size_t resultCount = std::min(static_cast<size_t>(count), largest.size());
+		std::partial_sort(largest.begin(), largest.begin() + resultCount, largest.end(), [](const Entry& a, const Entry& b) { return a.size > b.size; });
+		largest.resize(resultCount);
+		return largest;
+	}
+
+	const char* MemoryReport::categoryName(MemoryCategory category)
+	{
+		switch (category) {
+		case MemoryCategory::Texture: return "texture";
+		case MemoryCategory::Geometry: return "geometry";
+		case MemoryCategory::RayTracing: return "raytracing";
+		case MemoryCategory::RenderTarget: return "rendertarget";
+		case MemoryCategory::Staging: return "staging";
+		case MemoryCategory::Uniform: return "uniform";
+		default: return "other";
+		}
+	}
+
+	/** @brief Derive the category of a buffer from its usage flags */
+	MemoryCategory MemoryReport::bufferCategory(VkBufferUsageFlags usageFlags)
+	{
+		if (usageFlags & (VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR)) {
+			return MemoryCategory::RayTracing;
+		}
+		if (usageFlags & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+			return MemoryCategory::Geometry;
+		}
+		if (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+			return MemoryCategory::Uniform;
+		}
+		if (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+			return MemoryCategory::Staging;
+		}
+		return MemoryCategory::Other;
+	}
+
+	/** @brief Derive the category of an image from its usage flags, attachments and storage images are render targets */
+	MemoryCategory MemoryReport::imageCategory(VkImageUsageFlags usageFlags)
+	{
+		if (usageFlags & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT)) {
+			return MemoryCategory::RenderTarget;
+		}
+		return MemoryCategory::Texture;
+	}
+}
@@ -0,0 +1,71 @@
+/*
+* Vulkan device memory report
+*
+* Tracks the device memory taken up by resources, grouped into categories (textures, geometry, render targets, ...)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/** @brief What a resource's memory is used for */
+	enum class MemoryCategory : uint32_t
+	{
+		Texture = 0,
+		Geometry,
+		RayTracing,
+		RenderTarget,
+		Staging,
+		Uniform,
+		Other,
+		Count
+	};
+
+	/**
+	* @brief Memory footprint of the resources of a device by category
+	*
+	* Resources are identified by their memory and the offset into it. Allocations of the memory allocator are tracked (as "other") and untracked automatically,
+	* owners tag them with their category and a debug name. Resources with memory of their own need to be tracked and untracked by their owners.
+	*/
+	class MemoryReport
+	{
+	public:
+		struct Entry
+		{
+			MemoryCategory category;
+			VkDeviceSize size;
+			std::string name;
+		};
+
+	private:
+		std::mutex mutex;
+		std::map<std::pair<VkDeviceMemory, VkDeviceSize>, Entry> entries;
+		std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> current{};
+		std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::Count)> peak{};
+
+	public:
+		void track(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, MemoryCategory category, const std::string& name = "");
+		void untrack(VkDeviceMemory memory, VkDeviceSize offset = 0);
+		void tag(VkDeviceMemory memory, VkDeviceSize offset, MemoryCategory category, const std::string& name = "");
+		VkDeviceSize getUsage(MemoryCategory category);
+		VkDeviceSize getPeakUsage(MemoryCategory category);
+		VkDeviceSize getTotalUsage();
+		std::vector<Entry> getLargestEntries(uint32_t count);
+
+		static const char* categoryName(MemoryCategory category);
+		static MemoryCategory bufferCategory(VkBufferUsageFlags usageFlags);
+		static MemoryCategory imageCategory(VkImageUsageFlags usageFlags);
+	};
+}
@@ -0,0 +1,393 @@
+/*
+* Vulkan metrics exporter
+*
+* Serves the latest frame metrics (CPU and GPU timings, memory budgets, pipeline statistics and the present mode) as Prometheus text on a local port,
+* so unattended runs can be monitored while they are running
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#if defined(_WIN32)
+// Needs to be included before windows.h (pulled in by the Vulkan headers), which would include the older winsock.h otherwise
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "VulkanMetricsExporter.h"
+#include "VulkanTools.h"
+
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace vks
+{
+	namespace
+	{
+#if defined(_WIN32)
+		typedef SOCKET Socket;
+		bool validSocket(Socket socket) { return socket != INVALID_SOCKET; }
+		void closeSocket(Socket socket) { closesocket(socket); }
+#else
+		typedef int Socket;
+		bool validSocket(Socket socket) { return socket >= 0; }
+		void closeSocket(Socket socket) { close(socket); }
+#endif
+
+		// Writing to a connection the consumer has already closed must not raise SIGPIPE, which would terminate the process
+#if defined(MSG_NOSIGNAL)
+		const int sendFlags = MSG_NOSIGNAL;
+#else
+		const int sendFlags = 0;
+#endif
+
+		// Wait up to timeout milliseconds for the socket to become readable (or for a connection to arrive at a listening socket)
+		bool waitReadable(Socket socket, uint32_t timeout)
+		{
+			fd_set readSet;
+			FD_ZERO(&readSet);
+			FD_SET(socket, &readSet);
+			timeval time;
+			time.tv_sec = static_cast<long>(timeout / 1000);
+			time.tv_usec = static_cast<long>((timeout % 1000) * 1000);
+			return select(static_cast<int>(socket) + 1, &readSet, nullptr, nullptr, &time) > 0;
+		}
+
+		bool sendAll(Socket socket, const std::string& data)
+		{
+			size_t offset = 0;
+			while (offset < data.size()) {
+				const int sent = send(socket, data.data() + offset, static_cast<int>(data.size() - offset), sendFlags);
+				if (sent <= 0) {
+					return false;
+				}
+				offset += static_cast<size_t>(sent);
+			}
+			return true;
+		}
+
+		// Label values are quoted, so backslashes, quotes and line breaks need to be escaped
+		std::string label(const std::string& value)
+		{
+			std::string escaped;
+			escaped.reserve(value.size());
+			for (const char c : value) {
+				switch (c) {
+				case '\\': escaped += "\\\\"; break;
+				case '"': escaped += "\\\""; break;
+				case '\n': escaped += "\\n"; break;
+				default: escaped += c;
+				}
+			}
+			return escaped;
+		}
+
+		void header(std::ostringstream& out, const char* name, const char* type, const char* help)
+		{
+			out << "# HELP " << name << " " << help << "\n";
+			out << "# TYPE " << name << " " << type << "\n";
+		}
+	}
+
+	const uint32_t MetricsExporter::MaxScopes;
+	const uint32_t MetricsExporter::MaxNameLength;
+	const double MetricsExporter::frameTimeBuckets[FrameTimeBucketCount] = { 4.0, 8.0, 16.7, 33.3, 50.0, 100.0, 250.0, std::numeric_limits<double>::infinity() };
+
+	MetricsExporter::~MetricsExporter()
+	{
+		stop();
+	}
+
+	/**
+	* Start listening for metrics requests on a worker thread
+	*
+	* @param port Local TCP port the metrics are served on (at "/metrics" and "/")
+	* @param exampleName Name of the example, exported as a label of the vks_info metric
+	* @param deviceName Name of the physical device, exported as a label of the vks_info metric
+	*
+	* @return True if the port could be bound
+	*/
+	bool MetricsExporter::start(uint16_t port, const std::string& exampleName, const std::string& deviceName)
+	{
+		if (running()) {
+			return false;
+		}
+#if defined(_WIN32)
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			return false;
+		}
+#endif
+		Socket socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		bool listening = validSocket(socket);
+		if (listening) {
+			// Allows restarting right away while connections of the previous run are still in TIME_WAIT
+			int reuse = 1;
+			setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_port = htons(port);
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			listening = (bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) && (listen(socket, 4) == 0);
+			if (!listening) {
+				closeSocket(socket);
+			}
+		}
+		if (!listening) {
+#if defined(_WIN32)
+			WSACleanup();
+#endif
+			return false;
+		}
+		this->exampleName = exampleName;
+		this->deviceName = deviceName;
+		listenSocket = static_cast<intptr_t>(socket);
+		stopping = false;
+		attached = false;
+		worker = std::thread(&MetricsExporter::run, this);
+		return true;
+	}
+
+	void MetricsExporter::stop()
+	{
+		if (!running()) {
+			return;
+		}
+		stopping = true;
+		worker.join();
+		closeSocket(static_cast<Socket>(listenSocket));
+		listenSocket = -1;
+		attached = false;
+#if defined(_WIN32)
+		WSACleanup();
+#endif
+	}
+
+	bool MetricsExporter::running() const
+	{
+		return listenSocket != -1;
+	}
+
+	bool MetricsExporter::consumerAttached() const
+	{
+		return attached.load(std::memory_order_relaxed);
+	}
+
+	/** @brief Count a frame and its time in milliseconds, cheap enough to be called every frame even while no consumer is attached */
+	void MetricsExporter::addFrame(double frameTime)
+	{
+		frames++;
+		frameTimeSum += frameTime;
+		lastFrameTime = frameTime;
+		uint32_t bucket = 0;
+		while ((bucket < FrameTimeBucketCount - 1) && (frameTime > frameTimeBuckets[bucket])) {
+			bucket++;
+		}
+		frameTimeCounts[bucket]++;
+	}
+
+	/** @brief Snapshot the render thread fills in, it's owned by the render thread until publish is called */
+	MetricsExporter::Snapshot& MetricsExporter::beginSnapshot()
+	{
+		return snapshots[back];
+	}
+
+	/** @brief Hand the snapshot over to the server thread without waiting, a snapshot that hasn't been picked up yet is replaced */
+	void MetricsExporter::publish()
+	{
+		Snapshot& snapshot = snapshots[back];
+		snapshot.frames = frames;
+		snapshot.frameTimeSum = frameTimeSum;
+		snapshot.lastFrameTime = lastFrameTime;
+		snapshot.frameTimeCounts = frameTimeCounts;
+		back = shared.exchange(back | freshBit, std::memory_order_acq_rel) & ~freshBit;
+	}
+
+	// Swap the latest published snapshot in as the server thread's front snapshot, returns false if nothing has been published since the last call
+	bool MetricsExporter::takeSnapshot()
+	{
+		if ((shared.load(std::memory_order_acquire) & freshBit) == 0) {
+			return false;
+		}
+		front = shared.exchange(front, std::memory_order_acq_rel) & ~freshBit;
+		return true;
+	}
+
+	void MetricsExporter::run()
+	{
+		const Socket socket = static_cast<Socket>(listenSocket);
+		std::chrono::steady_clock::time_point lastRequest;
+		while (!stopping) {
+			// Wakes up regularly to notice a pending stop and a consumer that went away
+			if (waitReadable(socket, 100)) {
+				const Socket client = accept(socket, nullptr, nullptr);
+				if (validSocket(client)) {
+					lastRequest = std::chrono::steady_clock::now();
+					serve(static_cast<intptr_t>(client));
+					closeSocket(client);
+				}
+			}
+			if (attached && (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastRequest).count() > static_cast<long long>(attachTimeout))) {
+				attached = false;
+			}
+		}
+	}
+
+	// Answer a single HTTP request, connections are closed after each response
+	void MetricsExporter::serve(intptr_t clientSocket)
+	{
+		const Socket client = static_cast<Socket>(clientSocket);
+		// Only the request line matters, headers are ignored
+		char request[1024];
+		size_t size = 0;
+		while ((size < sizeof(request) - 1) && waitReadable(client, 1000)) {
+			const int received = recv(client, request + size, static_cast<int>(sizeof(request) - 1 - size), 0);
+			if (received <= 0) {
+				break;
+			}
+			size += static_cast<size_t>(received);
+			if (memchr(request, '\n', size) != nullptr) {
+				break;
+			}
+		}
+		request[size] = '\0';
+		const std::string requestLine(request, strcspn(request, "\r\n"));
+
+		std::string status = "200 OK";
+		std::string body;
+		if (requestLine.compare(0, 4, "GET ") != 0) {
+			status = "405 Method Not Allowed";
+		} else {
+			const std::string path = requestLine.substr(4, requestLine.find(' ', 4) - 4);
+			if ((path != "/metrics") && (path != "/")) {
+				status = "404 Not Found";
+			}
+		}
+		if (status[0] != '2') {
+			body = status + "\n";
+		} else {
+			if (!attached) {
+				// Snapshots are only filled in while a consumer is attached, so the first request after a pause drops the stale one and waits for a fresh snapshot
+				takeSnapshot();
+				attached = true;
+				const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+				while (!takeSnapshot() && !stopping && (std::chrono::steady_clock::now() - waitStart < std::chrono::milliseconds(500))) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			} else {
+				takeSnapshot();
+			}
+			body = format(snapshots[front]);
+		}
+
+		std::ostringstream response;
+		response << "HTTP/1.1 " << status << "\r\n";
+		response << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+		response << "Content-Length: " << body.size() << "\r\n";
+		response << "Connection: close\r\n\r\n";
+		response << body;
+		sendAll(client, response.str());
+	}
+
+	// Format a snapshot as Prometheus text, times are converted to seconds as per the Prometheus naming conventions
+	std::string MetricsExporter::format(const Snapshot& snapshot) const
+	{
+		std::ostringstream out;
+		out.precision(9);
+
+		header(out, "vks_info", "gauge", "Example and device the metrics are exported from");
+		out << "vks_info{example=\"" << label(exampleName) << "\",device=\"" << label(deviceName) << "\"} 1\n";
+
+		header(out, "vks_frames_total", "counter", "Frames rendered since the exporter was started");
+		out << "vks_frames_total " << snapshot.frames << "\n";
+		header(out, "vks_frame_time_seconds", "histogram", "CPU time from the start of a frame to the start of the next one");
+		uint64_t cumulative = 0;
+		for (uint32_t i = 0; i < FrameTimeBucketCount; i++) {
+			cumulative += snapshot.frameTimeCounts[i];
+			out << "vks_frame_time_seconds_bucket{le=\"";
+			if (i < FrameTimeBucketCount - 1) {
+				out << frameTimeBuckets[i] / 1000.0;
+			} else {
+				out << "+Inf";
+			}
+			out << "\"} " << cumulative << "\n";
+		}
+		out << "vks_frame_time_seconds_sum " << snapshot.frameTimeSum / 1000.0 << "\n";
+		out << "vks_frame_time_seconds_count " << snapshot.frames << "\n";
+		header(out, "vks_last_frame_time_seconds", "gauge", "Time of the latest frame");
+		out << "vks_last_frame_time_seconds " << snapshot.lastFrameTime / 1000.0 << "\n";
+
+		header(out, "vks_cpu_phase_seconds", "gauge", "CPU time of the phases of the latest frame");
+		for (uint32_t i = 0; i < CpuFrameProfiler::PhaseCount; i++) {
+			out << "vks_cpu_phase_seconds{phase=\"" << CpuFrameProfiler::phaseName(static_cast<CpuFrameProfiler::Phase>(i)) << "\"} " << snapshot.cpuLast[i] / 1000.0 << "\n";
+		}
+		header(out, "vks_cpu_phase_average_seconds", "gauge", "CPU time of the frame phases averaged over the latest frames");
+		for (uint32_t i = 0; i < CpuFrameProfiler::PhaseCount; i++) {
+			out << "vks_cpu_phase_average_seconds{phase=\"" << CpuFrameProfiler::phaseName(static_cast<CpuFrameProfiler::Phase>(i)) << "\"} " << snapshot.cpuAverage[i] / 1000.0 << "\n";
+		}
+
+		// Scopes recorded more than once per frame (e.g. per shadow cascade) are summed up, as a series must only be reported once
+		std::vector<Scope> scopes;
+		for (uint32_t i = 0; i < snapshot.scopeCount; i++) {
+			const Scope& scope = snapshot.scopes[i];
+			bool merged = false;
+			for (auto& existing : scopes) {
+				if ((existing.depth == scope.depth) && (strcmp(existing.name, scope.name) == 0)) {
+					existing.ms += scope.ms;
+					for (uint32_t j = 0; j < GpuProfiler::PipelineStatisticCount; j++) {
+						existing.statistics[j] += scope.statistics[j];
+					}
+					existing.hasStatistics = existing.hasStatistics || scope.hasStatistics;
+					merged = true;
+					break;
+				}
+			}
+			if (!merged) {
+				scopes.push_back(scope);
+			}
+		}
+		header(out, "vks_gpu_scope_seconds", "gauge", "GPU time of the profiler scopes of the latest collected frame");
+		for (auto& scope : scopes) {
+			out << "vks_gpu_scope_seconds{scope=\"" << label(scope.name) << "\",depth=\"" << scope.depth << "\"} " << scope.ms / 1000.0 << "\n";
+		}
+		header(out, "vks_gpu_scope_pipeline_statistic", "gauge", "Pipeline statistics of the top level profiler scopes of the latest collected frame");
+		for (auto& scope : scopes) {
+			if (scope.hasStatistics) {
+				for (uint32_t j = 0; j < GpuProfiler::PipelineStatisticCount; j++) {
+					out << "vks_gpu_scope_pipeline_statistic{scope=\"" << label(scope.name) << "\",statistic=\"" << GpuProfiler::pipelineStatisticName(static_cast<GpuProfiler::PipelineStatistic>(j)) << "\"} " << scope.statistics[j] << "\n";
+				}
+			}
+		}
+
+		header(out, "vks_memory_heap_budget_bytes", "gauge", "Memory budget of the heap (its size without VK_EXT_memory_budget)");
+		for (uint32_t i = 0; i < snapshot.heapCount; i++) {
+			out << "vks_memory_heap_budget_bytes{heap=\"" << i << "\",device_local=\"" << (snapshot.heaps[i].deviceLocal ? "true" : "false") << "\"} " << snapshot.heaps[i].budget << "\n";
+		}
+		header(out, "vks_memory_heap_usage_bytes", "gauge", "Memory usage of the heap (only the example's allocations without VK_EXT_memory_budget)");
+		for (uint32_t i = 0; i < snapshot.heapCount; i++) {
+			out << "vks_memory_heap_usage_bytes{heap=\"" << i << "\",device_local=\"" << (snapshot.heaps[i].deviceLocal ? "true" : "false") << "\"} " << snapshot.heaps[i].usage << "\n";
+		}
+
+		header(out, "vks_present_mode", "gauge", "Present mode of the swap chain");
+		out << "vks_present_mode{mode=\"" << vks::tools::presentModeString(snapshot.presentMode) << "\"} 1\n";
+		header(out, "vks_swapchain_images", "gauge", "Number of swap chain images");
+		out << "vks_swapchain_images " << snapshot.swapChainImages << "\n";
+		header(out, "vks_swapchain_width_pixels", "gauge", "Width of the swap chain images");
+		out << "vks_swapchain_width_pixels " << snapshot.width << "\n";
+		header(out, "vks_swapchain_height_pixels", "gauge", "Height of the swap chain images");
+		out << "vks_swapchain_height_pixels " << snapshot.height << "\n";
+		return out.str();
+	}
+}
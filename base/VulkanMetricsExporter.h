@@ -0,0 +1,123 @@
+/*
+* Vulkan metrics exporter
+*
+* Serves the latest frame metrics (CPU and GPU timings, memory budgets, pipeline statistics and the present mode) as Prometheus text on a local port,
+* so unattended runs can be monitored while they are running
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanProfiler.h"
+
+namespace vks
+{
+	/**
+	* @brief Exports frame metrics over HTTP in the Prometheus text format (e.g. for a Prometheus server, or a StatsD / OpenTelemetry agent scraping it)
+	*
+	* The render thread fills in a snapshot of the frame's metrics with fixed size storage and publishes it through a lock-free triple buffer: publishing swaps the
+	* written snapshot with the shared one and never waits, the server thread swaps the shared one with its own when it formats a response. No locks or allocations
+	* are added to the frame loop, and if the render thread publishes faster than the metrics are scraped the snapshots in between are simply overwritten.
+	*
+	* A consumer counts as attached while requests keep arriving (see attachTimeout). While no consumer is attached the render thread only counts frames and
+	* their times (see addFrame) and skips filling in the snapshot, so an idle exporter costs an atomic load per frame. The first request after a pause waits
+	* for the render thread to publish a fresh snapshot.
+	*
+	* @note Only listens on the loopback interface, remote collection is left to an agent on the machine
+	*/
+	class MetricsExporter
+	{
+	public:
+		/** @brief Scopes of the GPU profiler included in a snapshot at most, further scopes are left out */
+		static const uint32_t MaxScopes = 32;
+		static const uint32_t MaxNameLength = 48;
+		/** @brief Upper bounds of the frame time histogram buckets in milliseconds (the last bucket counts all frames) */
+		static const uint32_t FrameTimeBucketCount = 8;
+		static const double frameTimeBuckets[FrameTimeBucketCount];
+		/** @brief A consumer is no longer attached if no request has arrived for this many milliseconds */
+		uint32_t attachTimeout = 60000;
+
+		struct Scope
+		{
+			char name[MaxNameLength];
+			uint32_t depth;
+			double ms;
+			bool hasStatistics;
+			std::array<uint64_t, GpuProfiler::PipelineStatisticCount> statistics;
+		};
+		struct Heap
+		{
+			VkDeviceSize budget;
+			VkDeviceSize usage;
+			bool deviceLocal;
+		};
+		/** @brief Metrics of a single frame, filled in by the render thread between beginSnapshot and publish */
+		struct Snapshot
+		{
+			std::array<double, CpuFrameProfiler::PhaseCount> cpuLast;
+			std::array<double, CpuFrameProfiler::PhaseCount> cpuAverage;
+			uint32_t scopeCount;
+			std::array<Scope, MaxScopes> scopes;
+			uint32_t heapCount;
+			std::array<Heap, VK_MAX_MEMORY_HEAPS> heaps;
+			VkPresentModeKHR presentMode;
+			uint32_t swapChainImages;
+			uint32_t width;
+			uint32_t height;
+			// Counters of all frames since the exporter was started, set by publish
+			uint64_t frames;
+			double frameTimeSum;
+			double lastFrameTime;
+			std::array<uint64_t, FrameTimeBucketCount> frameTimeCounts;
+		};
+
+	private:
+		// Index of the shared snapshot, with freshBit set if it has been published since the server thread took it
+		static const uint32_t freshBit = 4;
+		std::array<Snapshot, 3> snapshots{};
+		std::atomic<uint32_t> shared{ 1 };
+		// Only used by the render thread
+		uint32_t back = 0;
+		uint64_t frames = 0;
+		double frameTimeSum = 0.0;
+		double lastFrameTime = 0.0;
+		std::array<uint64_t, FrameTimeBucketCount> frameTimeCounts{};
+		// Only used by the server thread
+		uint32_t front = 2;
+
+		std::string exampleName;
+		std::string deviceName;
+		// Socket handle (SOCKET on Windows), -1 if not listening
+		intptr_t listenSocket = -1;
+		std::thread worker;
+		std::atomic<bool> stopping{ false };
+		std::atomic<bool> attached{ false };
+
+		void run();
+		bool takeSnapshot();
+		void serve(intptr_t clientSocket);
+		std::string format(const Snapshot& snapshot) const;
+
+	public:
+		~MetricsExporter();
+		/** @brief Start listening on the given local port, the names are exported as labels of an info metric */
+		bool start(uint16_t port, const std::string& exampleName, const std::string& deviceName);
+		void stop();
+		bool running() const;
+		/** @brief Set while a consumer is requesting metrics, the render thread only needs to fill in snapshots then */
+		bool consumerAttached() const;
+		void addFrame(double frameTime);
+		Snapshot& beginSnapshot();
+		void publish();
+	};
+}
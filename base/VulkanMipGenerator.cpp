@@ -0,0 +1,290 @@
+/*
+* Vulkan compute mip generator
+*
+* Generates the mip chain of an image with a single pass compute downsampler instead of a chain of image blits
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMipGenerator.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	// Each workgroup reduces a tile of 64x64 texels, the last workgroup can read back at most 64x64 results
+	static const uint32_t tileSize = 64;
+	static const uint32_t maxTilesPerDimension = 64;
+	// Number of descriptor sets per descriptor pool, a dispatch uses one set
+	static const uint32_t descriptorSetsPerPool = 32;
+
+	MipGenerator::~MipGenerator()
+	{
+		destroy();
+	}
+
+	const uint32_t MipGenerator::maxLevelsPerPass;
+
+	/**
+	* Create the compute pipeline and the buffer shared by all dispatches
+	*
+	* @param device Device to generate mip chains on, needs to have shaderStorageImageWriteWithoutFormat enabled
+	* @param shaderStage Stage for the mip generation compute shader (base/mipgen.comp)
+	* @param pipelineCache Pipeline cache to use for creating the pipeline
+	*/
+	void MipGenerator::prepare(vks::VulkanDevice* device, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+	{
+		assert(pipeline == VK_NULL_HANDLE);
+		this->device = device;
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &levelBuffer, 4 * sizeof(uint32_t) + maxTilesPerDimension * maxTilesPerDimension * 4 * sizeof(float)));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Source level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Destination levels
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, maxLevelsPerPass),
+			// Binding 2: Workgroup counter and 6th level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = shaderStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	/** @brief Release all Vulkan resources, command buffers with generate calls must have finished executing */
+	void MipGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		releaseResources();
+		for (auto descriptorPool : descriptorPools) {
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		descriptorPools.clear();
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		levelBuffer.destroy();
+		pipeline = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/**
+	* Check if mip chains for images of the given format can be generated
+	*
+	* @param format Format of the image
+	*
+	* @return True if the storage format supports sampling and storage writes and the image can be created with storage usage
+	*/
+	bool MipGenerator::supported(VkFormat format) const
+	{
+		if (!device || !device->enabledFeatures.shaderStorageImageWriteWithoutFormat) {
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, storageFormat(format), &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+			return false;
+		}
+		// Without VK_KHR_maintenance2 the image's own format has to allow storage usage too, which e.g. sRGB formats often don't
+		VkImageFormatProperties imageFormatProperties;
+		VkResult result = vkGetPhysicalDeviceImageFormatProperties(device->physicalDevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageCreateFlags(format), &imageFormatProperties);
+		return result == VK_SUCCESS;
+	}
+
+	/** @brief Returns the format the levels are accessed with, sRGB images are written through a UNORM view and encoded in the shader */
+	VkFormat MipGenerator::storageFormat(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return VK_FORMAT_B8G8R8A8_UNORM;
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			return VK_FORMAT_A8B8G8R8_UNORM_PACK32;
+		default:
+			return format;
+		}
+	}
+
+	/** @brief Returns the flags images of the given format need to be created with to generate their mip chain */
+	VkImageCreateFlags MipGenerator::imageCreateFlags(VkFormat format)
+	{
+		return (storageFormat(format) != format) ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0;
+	}
+
+	VkDescriptorSet MipGenerator::allocateDescriptorSet()
+	{
+		if (descriptorPools.empty() || (descriptorPoolSetCount == descriptorSetsPerPool)) {
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptorSetsPerPool),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptorSetsPerPool * maxLevelsPerPass),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptorSetsPerPool),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, descriptorSetsPerPool);
+			VkDescriptorPool descriptorPool;
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+			descriptorPools.push_back(descriptorPool);
+			descriptorPoolSetCount = 0;
+		}
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPools.back(), &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+		descriptorPoolSetCount++;
+		return descriptorSet;
+	}
+
+	VkImageView MipGenerator::createView(VkImage image, VkFormat format, uint32_t mipLevel)
+	{
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.image = image;
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = storageFormat(format);
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 1, 0, 1 };
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+		imageViews.push_back(view);
+		return view;
+	}
+
+	/**
+	* Record the generation of an image's mip chain from its first level
+	*
+	* @param commandBuffer Command buffer to record to (must support compute)
+	* @param image Image with the first level filled
+	* @param format Format the image has been created with
+	* @param width Width of the first level
+	* @param height Height of the first level
+	* @param mipLevels Number of levels of the image
+	* @param oldLayout Layout of the first level, the other levels are treated as undefined
+	* @param newLayout Layout all levels are transitioned to after generation
+	* @param filter (Optional) Reduction filter (Defaults to averaging, which results in a box filter)
+	*
+	* @note Descriptors and views used by the recorded commands are kept until releaseResources is called
+	*/
+	void MipGenerator::generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout, Filter filter)
+	{
+		assert(pipeline != VK_NULL_HANDLE);
+		if (mipLevels <= 1) {
+			return;
+		}
+
+		// All levels are read and written in the general layout
+		vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, oldLayout, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		vks::tools::insertImageMemoryBarrier(commandBuffer, image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1 });
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		const bool srgb = (storageFormat(format) != format);
+		uint32_t baseLevel = 0;
+		while (baseLevel + 1 < mipLevels) {
+			const uint32_t srcWidth = std::max(width >> baseLevel, 1u);
+			const uint32_t srcHeight = std::max(height >> baseLevel, 1u);
+			const uint32_t groupCountX = (srcWidth + tileSize - 1) / tileSize;
+			const uint32_t groupCountY = (srcHeight + tileSize - 1) / tileSize;
+			uint32_t levelCount = std::min(mipLevels - 1 - baseLevel, maxLevelsPerPass);
+			// The last workgroup can't read back the results of more than 64x64 workgroups, so larger levels only get the first 6 levels per pass
+			if ((groupCountX > maxTilesPerDimension) || (groupCountY > maxTilesPerDimension)) {
+				levelCount = std::min(levelCount, maxLevelsPerPass / 2);
+			}
+
+			// Reset the workgroup counter, previous dispatches may still be reading it
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdFillBuffer(commandBuffer, levelBuffer.buffer, 0, sizeof(uint32_t), 0);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			VkDescriptorSet descriptorSet = allocateDescriptorSet();
+			VkDescriptorImageInfo srcDescriptor = vks::initializers::descriptorImageInfo(sampler, createView(image, format, baseLevel), VK_IMAGE_LAYOUT_GENERAL);
+			// Unused array elements still need valid descriptors, these are never written by the shader
+			std::vector<VkDescriptorImageInfo> dstDescriptors(maxLevelsPerPass);
+			for (uint32_t i = 0; i < maxLevelsPerPass; i++) {
+				dstDescriptors[i] = (i < levelCount) ? vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, createView(image, format, baseLevel + 1 + i), VK_IMAGE_LAYOUT_GENERAL) : dstDescriptors[levelCount - 1];
+			}
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, dstDescriptors.data(), maxLevelsPerPass),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &levelBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			PushConstants pushConstants{};
+			pushConstants.srcSize[0] = static_cast<int32_t>(srcWidth);
+			pushConstants.srcSize[1] = static_cast<int32_t>(srcHeight);
+			pushConstants.levelCount = levelCount;
+			pushConstants.workGroupCount = groupCountX * groupCountY;
+			pushConstants.filter = static_cast<uint32_t>(filter);
+			pushConstants.srgb = srgb ? 1 : 0;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+			baseLevel += levelCount;
+			// The last level written is the source of the next pass
+			if (baseLevel + 1 < mipLevels) {
+				vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, 1, 0, 1 });
+			}
+		}
+
+		vks::tools::insertImageMemoryBarrier(commandBuffer, image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, newLayout,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 });
+	}
+
+	/** @brief Free the descriptors and views of all recorded generate calls, the command buffers they were recorded to must have finished executing */
+	void MipGenerator::releaseResources()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto view : imageViews) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		imageViews.clear();
+		for (auto descriptorPool : descriptorPools) {
+			VK_CHECK_RESULT(vkResetDescriptorPool(device->logicalDevice, descriptorPool, 0));
+		}
+		if (!descriptorPools.empty()) {
+			// Keep the first pool only, later ones were needed for bursts of uploads
+			for (size_t i = 1; i < descriptorPools.size(); i++) {
+				vkDestroyDescriptorPool(device->logicalDevice, descriptorPools[i], nullptr);
+			}
+			descriptorPools.resize(1);
+		}
+		descriptorPoolSetCount = 0;
+	}
+}
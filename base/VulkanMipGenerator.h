@@ -0,0 +1,75 @@
+/*
+* Vulkan compute mip generator
+*
+* Generates the mip chain of an image with a single pass compute downsampler instead of a chain of image blits
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Compute shader based mip chain generation
+	*
+	* A single dispatch generates up to 12 levels: Each workgroup reduces a 64x64 tile to the next 6 levels in shared memory and the last
+	* workgroup to finish (determined with an atomic counter) reduces the results of all workgroups to the remaining 6 levels.
+	* Compared to blits this works for formats without blit support, filters sRGB images in linear space and supports min/max reductions (e.g. for depth pyramids).
+	*
+	* @note Requires the shaderStorageImageWriteWithoutFormat feature, images need to be created with VK_IMAGE_USAGE_STORAGE_BIT and the flags returned by imageCreateFlags
+	*/
+	class MipGenerator
+	{
+	public:
+		enum Filter { FILTER_AVERAGE = 0, FILTER_MIN = 1, FILTER_MAX = 2 };
+
+	private:
+		struct PushConstants
+		{
+			int32_t srcSize[2];
+			uint32_t levelCount;
+			uint32_t workGroupCount;
+			uint32_t filter;
+			uint32_t srgb;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		/** @brief Workgroup counter and the 6th level of all workgroups, read back by the last workgroup */
+		vks::Buffer levelBuffer;
+		std::vector<VkDescriptorPool> descriptorPools;
+		uint32_t descriptorPoolSetCount = 0;
+		/** @brief Image views referenced by recorded dispatches, destroyed in releaseResources */
+		std::vector<VkImageView> imageViews;
+
+		VkDescriptorSet allocateDescriptorSet();
+		VkImageView createView(VkImage image, VkFormat format, uint32_t mipLevel);
+
+	public:
+		/** @brief Maximum number of levels generated by a single dispatch */
+		static const uint32_t maxLevelsPerPass = 12;
+
+		~MipGenerator();
+		void prepare(vks::VulkanDevice* device, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache);
+		void destroy();
+		bool supported(VkFormat format) const;
+		static VkFormat storageFormat(VkFormat format);
+		static VkImageCreateFlags imageCreateFlags(VkFormat format);
+		void generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout, Filter filter = FILTER_AVERAGE);
+		void releaseResources();
+	};
+}
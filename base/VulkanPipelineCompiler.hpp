@@ -0,0 +1,173 @@
+/*
+* Vulkan pipeline compiler that creates batches of pipelines in parallel on worker threads
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <future>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+#include "VulkanStartupProfiler.h"
+
+namespace vks
+{
+	/**
+	* Compiles pipelines on the worker threads of a vks::ThreadPool, all sharing the same pipeline cache
+	*
+	* Pipelines can either be created as a blocking batch (createGraphicsPipelines/createComputePipelines),
+	* or queued asynchronously (addGraphicsPipeline/addComputePipeline) so compilation overlaps with other work like asset loading.
+	*
+	* @note For asynchronous compilation, all state referenced by the create info (shader stages, specialization info, fixed function state, etc.)
+	* must stay valid until the returned future is ready or wait() has been called
+	*/
+	class PipelineCompiler
+	{
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		ThreadPool threadPool;
+		uint32_t threadCount = 0;
+		uint32_t nextThread = 0;
+
+		// Worker threads are only spawned once the first pipeline is queued
+		Thread* getNextThread()
+		{
+			if (threadPool.threads.empty()) {
+				threadPool.setThreadCount(threadCount);
+			}
+			Thread* thread = threadPool.threads[nextThread].get();
+			nextThread = (nextThread + 1) % static_cast<uint32_t>(threadPool.threads.size());
+			return thread;
+		}
+
+	public:
+		/**
+		* Set the device and pipeline cache to be used for pipeline creation
+		*
+		* @param device Logical device to create the pipelines on
+		* @param pipelineCache Pipeline cache shared by all compile jobs
+		* @param threadCount (Optional) Number of worker threads, defaults to the number of hardware threads
+		*/
+		void setup(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount = 0)
+		{
+			this->device = device;
+			this->pipelineCache = pipelineCache;
+			this->threadCount = (threadCount > 0) ? threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		/**
+		* Queue a graphics pipeline for compilation on a worker thread
+		*
+		* @param createInfo Create info of the pipeline (copied, but the state it points to must stay valid until compilation has finished)
+		* @param pipeline (Optional) Pointer to the handle that will receive the pipeline once it has been compiled
+		*
+		* @return Future that becomes ready with the pipeline handle once it has been compiled
+		*/
+		std::shared_future<VkPipeline> addGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline = nullptr)
+		{
+			assert(device != VK_NULL_HANDLE);
+			VkDevice device = this->device;
+			VkPipelineCache pipelineCache = this->pipelineCache;
+			return addJob([=] {
+				VkPipeline handle;
+				VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, &handle));
+				if (pipeline) {
+					*pipeline = handle;
+				}
+				return handle;
+			});
+		}
+
+		/**
+		* Queue a compute pipeline for compilation on a worker thread
+		*
+		* @param createInfo Create info of the pipeline (copied, but the state it points to must stay valid until compilation has finished)
+		* @param pipeline (Optional) Pointer to the handle that will receive the pipeline once it has been compiled
+		*
+		* @return Future that becomes ready with the pipeline handle once it has been compiled
+		*/
+		std::shared_future<VkPipeline> addComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline = nullptr)
+		{
+			assert(device != VK_NULL_HANDLE);
+			VkDevice device = this->device;
+			VkPipelineCache pipelineCache = this->pipelineCache;
+			return addJob([=] {
+				VkPipeline handle;
+				VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &createInfo, nullptr, &handle));
+				if (pipeline) {
+					*pipeline = handle;
+				}
+				return handle;
+			});
+		}
+
+		/**
+		* Queue a job that creates a pipeline on a worker thread, for pipelines whose state is set up by the job itself (e.g. see vks::PipelineManifest)
+		*
+		* @param job Function that creates the pipeline and returns its handle (or VK_NULL_HANDLE if it couldn't be created)
+		*
+		* @return Future that becomes ready with the pipeline handle once the job has finished
+		*/
+		std::shared_future<VkPipeline> addJob(std::function<VkPipeline()> job)
+		{
+			std::shared_ptr<std::promise<VkPipeline>> promise = std::make_shared<std::promise<VkPipeline>>();
+			getNextThread()->addJob([=] {
+				promise->set_value(job());
+			});
+			return promise->get_future().share();
+		}
+
+		/**
+		* Compile a batch of graphics pipelines in parallel and wait for all of them to finish
+		*
+		* @param createInfos Create infos of the pipelines to compile
+		* @param pipelines Pointers to the handles receiving the pipelines (one per create info)
+		*/
+		void createGraphicsPipelines(const std::vector<VkGraphicsPipelineCreateInfo>& createInfos, const std::vector<VkPipeline*>& pipelines)
+		{
+			assert(createInfos.size() == pipelines.size());
+			std::vector<std::shared_future<VkPipeline>> futures;
+			for (size_t i = 0; i < createInfos.size(); i++) {
+				futures.push_back(addGraphicsPipeline(createInfos[i], pipelines[i]));
+			}
+			for (auto& future : futures) {
+				future.wait();
+			}
+		}
+
+		/**
+		* Compile a batch of compute pipelines in parallel and wait for all of them to finish
+		*
+		* @param createInfos Create infos of the pipelines to compile
+		* @param pipelines Pointers to the handles receiving the pipelines (one per create info)
+		*/
+		void createComputePipelines(const std::vector<VkComputePipelineCreateInfo>& createInfos, const std::vector<VkPipeline*>& pipelines)
+		{
+			assert(createInfos.size() == pipelines.size());
+			std::vector<std::shared_future<VkPipeline>> futures;
+			for (size_t i = 0; i < createInfos.size(); i++) {
+				futures.push_back(addComputePipeline(createInfos[i], pipelines[i]));
+			}
+			for (auto& future : futures) {
+				future.wait();
+			}
+		}
+
+		/** @brief Wait until all queued pipelines have been compiled */
+		void wait()
+		{
+			threadPool.wait();
+		}
+	};
+}
@@ -0,0 +1,1285 @@
+/*
+* Vulkan pipeline manifest
+*
+* Records the state of all pipelines created in a session to a file and compiles them on worker threads while the next session is loading,
+* so pipelines created later on (e.g. when toggling settings) don't stall the frame they're created in
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineManifest.h"
+#include "VulkanPipelineCompiler.hpp"
+#include "VulkanDynamicRendering.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanTraceRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		const uint32_t manifestFileMagic = 0x4d504b56; // "VKPM"
+		const uint32_t manifestFileVersion = 1;
+
+		// Non-dispatchable handles are pointers or 64 bit integers depending on the platform
+		template<typename T>
+		uint64_t handleKey(T handle)
+		{
+			uint64_t key = 0;
+			memcpy(&key, &handle, sizeof(handle));
+			return key;
+		}
+
+		// Descriptions are written value by value, so padding bytes of the Vulkan structures don't end up in the hashed data
+		void put(std::vector<uint8_t>& data, uint32_t value)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+			data.insert(data.end(), bytes, bytes + sizeof(value));
+		}
+
+		void put(std::vector<uint8_t>& data, float value)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+			data.insert(data.end(), bytes, bytes + sizeof(value));
+		}
+
+		void put(std::vector<uint8_t>& data, const void* bytes, size_t size)
+		{
+			put(data, static_cast<uint32_t>(size));
+			if (size > 0) {
+				data.insert(data.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+			}
+		}
+
+		void put(std::vector<uint8_t>& data, const char* string)
+		{
+			put(data, string, strlen(string));
+		}
+
+		// Reads a description in the order it was written, any read past its end invalidates the reader
+		class Reader
+		{
+		private:
+			const std::vector<uint8_t>& data;
+			size_t offset = 0;
+
+		public:
+			bool valid = true;
+
+			explicit Reader(const std::vector<uint8_t>& data) : data(data) {}
+
+			uint32_t u32()
+			{
+				uint32_t value = 0;
+				bytes(&value, sizeof(value));
+				return value;
+			}
+
+			float f32()
+			{
+				float value = 0.0f;
+				bytes(&value, sizeof(value));
+				return value;
+			}
+
+			void bytes(void* dst, size_t size)
+			{
+				if (!valid || (offset + size > data.size())) {
+					valid = false;
+					return;
+				}
+				memcpy(dst, data.data() + offset, size);
+				offset += size;
+			}
+
+			std::vector<uint8_t> array()
+			{
+				std::vector<uint8_t> values(u32());
+				if (valid && (values.size() <= data.size() - offset)) {
+					bytes(values.data(), values.size());
+				} else {
+					valid = false;
+					values.clear();
+				}
+				return values;
+			}
+
+			std::string string()
+			{
+				std::vector<uint8_t> chars = array();
+				return std::string(chars.begin(), chars.end());
+			}
+
+			// Element count of a following array, bounded by the remaining data so corrupt files can't trigger huge allocations
+			uint32_t count()
+			{
+				uint32_t value = u32();
+				if (value > data.size() - std::min(offset, data.size())) {
+					valid = false;
+					return 0;
+				}
+				return value;
+			}
+		};
+
+		void putAttachmentReference(std::vector<uint8_t>& data, const VkAttachmentReference& reference)
+		{
+			put(data, reference.attachment);
+			put(data, static_cast<uint32_t>(reference.layout));
+		}
+
+		VkAttachmentReference getAttachmentReference(Reader& reader)
+		{
+			VkAttachmentReference reference;
+			reference.attachment = reader.u32();
+			reference.layout = static_cast<VkImageLayout>(reader.u32());
+			return reference;
+		}
+
+		void putStencilOpState(std::vector<uint8_t>& data, const VkStencilOpState& state)
+		{
+			put(data, static_cast<uint32_t>(state.failOp));
+			put(data, static_cast<uint32_t>(state.passOp));
+			put(data, static_cast<uint32_t>(state.depthFailOp));
+			put(data, static_cast<uint32_t>(state.compareOp));
+			put(data, state.compareMask);
+			put(data, state.writeMask);
+			put(data, state.reference);
+		}
+
+		VkStencilOpState getStencilOpState(Reader& reader)
+		{
+			VkStencilOpState state;
+			state.failOp = static_cast<VkStencilOp>(reader.u32());
+			state.passOp = static_cast<VkStencilOp>(reader.u32());
+			state.depthFailOp = static_cast<VkStencilOp>(reader.u32());
+			state.compareOp = static_cast<VkCompareOp>(reader.u32());
+			state.compareMask = reader.u32();
+			state.writeMask = reader.u32();
+			state.reference = reader.u32();
+			return state;
+		}
+
+		// Objects recreated from their descriptions for a precompiled pipeline
+		struct ReplayObjects
+		{
+			VkDevice device;
+			std::vector<VkShaderModule> shaderModules;
+			std::vector<VkDescriptorSetLayout> setLayouts;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+		};
+
+		VkDescriptorSetLayout replaySetLayout(Reader& reader, VkDevice device)
+		{
+			VkDescriptorSetLayoutCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			createInfo.flags = reader.u32();
+			std::vector<VkDescriptorSetLayoutBinding> bindings(reader.count());
+			for (auto& binding : bindings) {
+				binding.binding = reader.u32();
+				binding.descriptorType = static_cast<VkDescriptorType>(reader.u32());
+				binding.descriptorCount = reader.u32();
+				binding.stageFlags = reader.u32();
+				binding.pImmutableSamplers = nullptr;
+			}
+			createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+			createInfo.pBindings = bindings.data();
+			VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+			std::vector<VkDescriptorBindingFlags> bindingFlags;
+			if (reader.u32() != 0) {
+				bindingFlags.resize(reader.count());
+				for (auto& flags : bindingFlags) {
+					flags = reader.u32();
+				}
+				bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+				bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+				bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+				createInfo.pNext = &bindingFlagsInfo;
+			}
+			VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+			if (reader.valid && (vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &setLayout) != VK_SUCCESS)) {
+				setLayout = VK_NULL_HANDLE;
+			}
+			return setLayout;
+		}
+
+		bool replayPipelineLayout(Reader& reader, ReplayObjects& objects)
+		{
+			VkPipelineLayoutCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			createInfo.flags = reader.u32();
+			const uint32_t setLayoutCount = reader.count();
+			const size_t firstSetLayout = objects.setLayouts.size();
+			for (uint32_t i = 0; i < setLayoutCount; i++) {
+				VkDescriptorSetLayout setLayout = replaySetLayout(reader, objects.device);
+				if (setLayout == VK_NULL_HANDLE) {
+					return false;
+				}
+				objects.setLayouts.push_back(setLayout);
+			}
+			std::vector<VkPushConstantRange> pushConstantRanges(reader.count());
+			for (auto& range : pushConstantRanges) {
+				range.stageFlags = reader.u32();
+				range.offset = reader.u32();
+				range.size = reader.u32();
+			}
+			createInfo.setLayoutCount = setLayoutCount;
+			createInfo.pSetLayouts = objects.setLayouts.data() + firstSetLayout;
+			createInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+			createInfo.pPushConstantRanges = pushConstantRanges.data();
+			return reader.valid && (vkCreatePipelineLayout(objects.device, &createInfo, nullptr, &objects.pipelineLayout) == VK_SUCCESS);
+		}
+
+		bool replayRenderPass(Reader& reader, ReplayObjects& objects)
+		{
+			struct Subpass
+			{
+				std::vector<VkAttachmentReference> inputAttachments;
+				std::vector<VkAttachmentReference> colorAttachments;
+				std::vector<VkAttachmentReference> resolveAttachments;
+				VkAttachmentReference depthStencilAttachment;
+				bool depthStencil = false;
+				std::vector<uint32_t> preserveAttachments;
+			};
+
+			VkRenderPassCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			createInfo.flags = reader.u32();
+			std::vector<VkAttachmentDescription> attachments(reader.count());
+			for (auto& attachment : attachments) {
+				attachment.flags = reader.u32();
+				attachment.format = static_cast<VkFormat>(reader.u32());
+				attachment.samples = static_cast<VkSampleCountFlagBits>(reader.u32());
+				attachment.loadOp = static_cast<VkAttachmentLoadOp>(reader.u32());
+				attachment.storeOp = static_cast<VkAttachmentStoreOp>(reader.u32());
+				attachment.stencilLoadOp = static_cast<VkAttachmentLoadOp>(reader.u32());
+				attachment.stencilStoreOp = static_cast<VkAttachmentStoreOp>(reader.u32());
+				attachment.initialLayout = static_cast<VkImageLayout>(reader.u32());
+				attachment.finalLayout = static_cast<VkImageLayout>(reader.u32());
+			}
+			std::vector<Subpass> subpasses(reader.count());
+			std::vector<VkSubpassDescription> subpassDescriptions(subpasses.size());
+			for (size_t i = 0; i < subpasses.size(); i++) {
+				Subpass& subpass = subpasses[i];
+				VkSubpassDescription& description = subpassDescriptions[i];
+				description.flags = reader.u32();
+				description.pipelineBindPoint = static_cast<VkPipelineBindPoint>(reader.u32());
+				subpass.inputAttachments.resize(reader.count());
+				for (auto& reference : subpass.inputAttachments) {
+					reference = getAttachmentReference(reader);
+				}
+				subpass.colorAttachments.resize(reader.count());
+				for (auto& reference : subpass.colorAttachments) {
+					reference = getAttachmentReference(reader);
+				}
+				if (reader.u32() != 0) {
+					subpass.resolveAttachments.resize(subpass.colorAttachments.size());
+					for (auto& reference : subpass.resolveAttachments) {
+						reference = getAttachmentReference(reader);
+					}
+				}
+				subpass.depthStencil = (reader.u32() != 0);
+				if (subpass.depthStencil) {
+					subpass.depthStencilAttachment = getAttachmentReference(reader);
+				}
+				subpass.preserveAttachments.resize(reader.count());
+				for (auto& attachment : subpass.preserveAttachments) {
+					attachment = reader.u32();
+				}
+				description.inputAttachmentCount = static_cast<uint32_t>(subpass.inputAttachments.size());
+				description.pInputAttachments = subpass.inputAttachments.data();
+				description.colorAttachmentCount = static_cast<uint32_t>(subpass.colorAttachments.size());
+				description.pColorAttachments = subpass.colorAttachments.data();
+				description.pResolveAttachments = subpass.resolveAttachments.empty() ? nullptr : subpass.resolveAttachments.data();
+				description.pDepthStencilAttachment = subpass.depthStencil ? &subpass.depthStencilAttachment : nullptr;
+				description.preserveAttachmentCount = static_cast<uint32_t>(subpass.preserveAttachments.size());
+				description.pPreserveAttachments = subpass.preserveAttachments.data();
+			}
+			std::vector<VkSubpassDependency> dependencies(reader.count());
+			for (auto& dependency : dependencies) {
+				dependency.srcSubpass = reader.u32();
+				dependency.dstSubpass = reader.u32();
+				dependency.srcStageMask = reader.u32();
+				dependency.dstStageMask = reader.u32();
+				dependency.srcAccessMask = reader.u32();
+				dependency.dstAccessMask = reader.u32();
+				dependency.dependencyFlags = reader.u32();
+			}
+			createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			createInfo.pAttachments = attachments.data();
+			createInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+			createInfo.pSubpasses = subpassDescriptions.data();
+			createInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			createInfo.pDependencies = dependencies.data();
+			return reader.valid && (vkCreateRenderPass(objects.device, &createInfo, nullptr, &objects.renderPass) == VK_SUCCESS);
+		}
+
+		// Shader stage with the specialization data it points to
+		struct ReplayStage
+		{
+			VkPipelineShaderStageCreateInfo createInfo{};
+			std::string name;
+			std::vector<VkSpecializationMapEntry> mapEntries;
+			std::vector<uint8_t> specializationData;
+			VkSpecializationInfo specializationInfo{};
+		};
+
+		bool replayStage(Reader& reader, ReplayStage& stage, ReplayObjects& objects, const PipelineManifest::ShaderLoader& shaderLoader)
+		{
+			stage.createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stage.createInfo.flags = reader.u32();
+			stage.createInfo.stage = static_cast<VkShaderStageFlagBits>(reader.u32());
+			const std::string fileName = reader.string();
+			stage.name = reader.string();
+			if (reader.u32() != 0) {
+				stage.mapEntries.resize(reader.count());
+				for (auto& mapEntry : stage.mapEntries) {
+					mapEntry.constantID = reader.u32();
+					mapEntry.offset = reader.u32();
+					mapEntry.size = reader.u32();
+				}
+				stage.specializationData = reader.array();
+				stage.specializationInfo.mapEntryCount = static_cast<uint32_t>(stage.mapEntries.size());
+				stage.specializationInfo.pMapEntries = stage.mapEntries.data();
+				stage.specializationInfo.dataSize = stage.specializationData.size();
+				stage.specializationInfo.pData = stage.specializationData.data();
+				stage.createInfo.pSpecializationInfo = &stage.specializationInfo;
+			}
+			if (!reader.valid) {
+				return false;
+			}
+			stage.createInfo.module = shaderLoader(fileName);
+			if (stage.createInfo.module == VK_NULL_HANDLE) {
+				return false;
+			}
+			objects.shaderModules.push_back(stage.createInfo.module);
+			stage.createInfo.pName = stage.name.c_str();
+			return true;
+		}
+	}
+
+	const uint32_t PipelineManifest::MaxCopies;
+
+	PipelineManifest& PipelineManifest::get()
+	{
+		static PipelineManifest manifest;
+		return manifest;
+	}
+
+	/** @brief 64 bit FNV-1a hash of a description */
+	uint64_t PipelineManifest::hash(const Description& description)
+	{
+		uint64_t value = 14695981039346656037ull;
+		for (uint8_t byte : description) {
+			value = (value ^ byte) * 1099511628211ull;
+		}
+		return value;
+	}
+
+	void PipelineManifest::setActive(bool active)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isActive = active;
+	}
+
+	bool PipelineManifest::active() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return isActive;
+	}
+
+	/** @brief Load the entries of a manifest written by a previous session, returns false if there is no (valid) manifest */
+	bool PipelineManifest::load(const std::string& fileName)
+	{
+		std::ifstream is(fileName, std::ios::binary | std::ios::in);
+		if (!is.is_open()) {
+			return false;
+		}
+		uint32_t header[3] = {};
+		is.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!is.good() || (header[0] != manifestFileMagic) || (header[1] != manifestFileVersion)) {
+			std::cout << "Discarding invalid pipeline manifest \"" << fileName << "\"\n";
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < header[2]; i++) {
+			uint32_t entryHeader[2] = {};
+			is.read(reinterpret_cast<char*>(entryHeader), sizeof(entryHeader));
+			Description state(is.good() ? entryHeader[1] : 0);
+			is.read(reinterpret_cast<char*>(state.data()), state.size());
+			if (!is.good() || state.empty()) {
+				std::cout << "Pipeline manifest \"" << fileName << "\" is truncated\n";
+				break;
+			}
+			Entry& entry = entries[hash(state)];
+			entry.state = std::move(state);
+			entry.loadedCount = std::min(std::max(entry.loadedCount, entryHeader[0]), MaxCopies);
+		}
+		statistics.entries = static_cast<uint32_t>(entries.size());
+		return !entries.empty();
+	}
+
+	/** @brief Write the pipelines of the loaded manifest and this session, with the number of times they've been created in either of them */
+	bool PipelineManifest::save(const std::string& fileName) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::ofstream os(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!os.is_open()) {
+			std::cerr << "Could not write pipeline manifest to \"" << fileName << "\"\n";
+			return false;
+		}
+		const uint32_t header[3] = { manifestFileMagic, manifestFileVersion, static_cast<uint32_t>(entries.size()) };
+		os.write(reinterpret_cast<const char*>(header), sizeof(header));
+		for (auto& entry : entries) {
+			const uint32_t entryHeader[2] = { std::min(std::max(entry.second.loadedCount, entry.second.sessionCount), MaxCopies), static_cast<uint32_t>(entry.second.state.size()) };
+			os.write(reinterpret_cast<const char*>(entryHeader), sizeof(entryHeader));
+			os.write(reinterpret_cast<const char*>(entry.second.state.data()), entry.second.state.size());
+		}
+		std::cout << "Pipeline manifest: " << statistics.used << " of " << statistics.precompiled << " precompiled pipelines used, " << statistics.compiled << " pipelines compiled on creation\n";
+		return os.good();
+	}
+
+	/**
+	* Queue the pipelines of the loaded manifest for compilation on the pipeline compiler's worker threads
+	*
+	* @param device Logical device to create the pipelines on
+	* @param compiler Pipeline compiler whose worker threads compile the pipelines
+	* @param pipelineCache Pipeline cache used for compilation
+	* @param shaderLoader Creates a shader module from a file name recorded for a shader module (see addShaderModule)
+	*
+	* @note Needs to be called before any other pipelines are queued on the compiler, so pipeline creation on its worker threads never waits for a compile job queued after it
+	*/
+	void PipelineManifest::precompile(VkDevice device, vks::PipelineCompiler& compiler, VkPipelineCache pipelineCache, const ShaderLoader& shaderLoader)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->device = device;
+		for (auto& entry : entries) {
+			Precompiled& pipelines = precompiled[entry.first];
+			pipelines.state = entry.second.state;
+			for (uint32_t i = 0; i < entry.second.loadedCount; i++) {
+				const Description& state = pipelines.state;
+				pipelines.pipelines.push_back(compiler.addJob([this, &state, shaderLoader, pipelineCache] {
+					return compile(state, shaderLoader, pipelineCache);
+				}));
+				statistics.precompiled++;
+			}
+		}
+	}
+
+	/** @brief Destroy the precompiled pipelines that haven't been used and the objects created for precompilation, all compile jobs need to have finished */
+	void PipelineManifest::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : precompiled) {
+			for (auto& pipeline : entry.second.pipelines) {
+				if (pipeline.get() != VK_NULL_HANDLE) {
+					vkDestroyPipeline(device, pipeline.get(), nullptr);
+				}
+			}
+		}
+		precompiled.clear();
+		for (auto& setLayout : replaySetLayouts) {
+			vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		}
+		for (auto& pipelineLayout : replayPipelineLayouts) {
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		}
+		for (auto& renderPass : replayRenderPasses) {
+			vkDestroyRenderPass(device, renderPass, nullptr);
+		}
+		replaySetLayouts.clear();
+		replayPipelineLayouts.clear();
+		replayRenderPasses.clear();
+	}
+
+	PipelineManifest::Statistics PipelineManifest::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return statistics;
+	}
+
+	/** @brief Set the file a shader module has been created from */
+	void PipelineManifest::addShaderModule(VkShaderModule shaderModule, const std::string& fileName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (isActive) {
+			shaderModules[handleKey(shaderModule)] = fileName;
+		}
+	}
+
+	void PipelineManifest::addDescriptorSetLayout(VkDescriptorSetLayout setLayout, const VkDescriptorSetLayoutCreateInfo& createInfo)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!isActive) {
+			return;
+		}
+		Description& description = setLayouts[handleKey(setLayout)];
+		description.clear();
+		const VkDescriptorSetLayoutBindingFlagsCreateInfo* bindingFlagsInfo = nullptr;
+		for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+			if (next->sType != VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO) {
+				return;
+			}
+			bindingFlagsInfo = reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+		}
+		put(description, createInfo.flags);
+		put(description, createInfo.bindingCount);
+		for (uint32_t i = 0; i < createInfo.bindingCount; i++) {
+			const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+			// Immutable samplers would have to be the same objects for the layouts to be identically defined
+			const bool samplerType = (binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER) || (binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			if (samplerType && (binding.pImmutableSamplers != nullptr)) {
+				description.clear();
+				return;
+			}
+			put(description, binding.binding);
+			put(description, static_cast<uint32_t>(binding.descriptorType));
+			put(description, binding.descriptorCount);
+			put(description, binding.stageFlags);
+		}
+		put(description, static_cast<uint32_t>(bindingFlagsInfo != nullptr));
+		if (bindingFlagsInfo) {
+			put(description, bindingFlagsInfo->bindingCount);
+			for (uint32_t i = 0; i < bindingFlagsInfo->bindingCount; i++) {
+				put(description, bindingFlagsInfo->pBindingFlags[i]);
+			}
+		}
+	}
+
+	void PipelineManifest::addPipelineLayout(VkPipelineLayout pipelineLayout, const VkPipelineLayoutCreateInfo& createInfo)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!isActive) {
+			return;
+		}
+		Description& description = pipelineLayouts[handleKey(pipelineLayout)];
+		description.clear();
+		if (createInfo.pNext != nullptr) {
+			return;
+		}
+		put(description, createInfo.flags);
+		put(description, createInfo.setLayoutCount);
+		for (uint32_t i = 0; i < createInfo.setLayoutCount; i++) {
+			auto setLayout = setLayouts.find(handleKey(createInfo.pSetLayouts[i]));
+			if ((setLayout == setLayouts.end()) || setLayout->second.empty()) {
+				description.clear();
+				return;
+			}
+			description.insert(description.end(), setLayout->second.begin(), setLayout->second.end());
+		}
+		put(description, createInfo.pushConstantRangeCount);
+		for (uint32_t i = 0; i < createInfo.pushConstantRangeCount; i++) {
+			put(description, createInfo.pPushConstantRanges[i].stageFlags);
+			put(description, createInfo.pPushConstantRanges[i].offset);
+			put(description, createInfo.pPushConstantRanges[i].size);
+		}
+	}
+
+	void PipelineManifest::addRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!isActive) {
+			return;
+		}
+		Description& description = renderPasses[handleKey(renderPass)];
+		description.clear();
+		if (createInfo.pNext != nullptr) {
+			return;
+		}
+		put(description, createInfo.flags);
+		put(description, createInfo.attachmentCount);
+		for (uint32_t i = 0; i < createInfo.attachmentCount; i++) {
+			const VkAttachmentDescription& attachment = createInfo.pAttachments[i];
+			put(description, attachment.flags);
+			put(description, static_cast<uint32_t>(attachment.format));
+			put(description, static_cast<uint32_t>(attachment.samples));
+			put(description, static_cast<uint32_t>(attachment.loadOp));
+			put(description, static_cast<uint32_t>(attachment.storeOp));
+			put(description, static_cast<uint32_t>(attachment.stencilLoadOp));
+			put(description, static_cast<uint32_t>(attachment.stencilStoreOp));
+			put(description, static_cast<uint32_t>(attachment.initialLayout));
+			put(description, static_cast<uint32_t>(attachment.finalLayout));
+		}
+		put(description, createInfo.subpassCount);
+		for (uint32_t i = 0; i < createInfo.subpassCount; i++) {
+			const VkSubpassDescription& subpass = createInfo.pSubpasses[i];
+			put(description, subpass.flags);
+			put(description, static_cast<uint32_t>(subpass.pipelineBindPoint));
+			put(description, subpass.inputAttachmentCount);
+			for (uint32_t j = 0; j < subpass.inputAttachmentCount; j++) {
+				putAttachmentReference(description, subpass.pInputAttachments[j]);
+			}
+			put(description, subpass.colorAttachmentCount);
+			for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+				putAttachmentReference(description, subpass.pColorAttachments[j]);
+			}
+			put(description, static_cast<uint32_t>(subpass.pResolveAttachments != nullptr));
+			if (subpass.pResolveAttachments) {
+				for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+					putAttachmentReference(description, subpass.pResolveAttachments[j]);
+				}
+			}
+			put(description, static_cast<uint32_t>(subpass.pDepthStencilAttachment != nullptr));
+			if (subpass.pDepthStencilAttachment) {
+				putAttachmentReference(description, *subpass.pDepthStencilAttachment);
+			}
+			put(description, subpass.preserveAttachmentCount);
+			for (uint32_t j = 0; j < subpass.preserveAttachmentCount; j++) {
+				put(description, subpass.pPreserveAttachments[j]);
+			}
+		}
+		put(description, createInfo.dependencyCount);
+		for (uint32_t i = 0; i < createInfo.dependencyCount; i++) {
+			const VkSubpassDependency& dependency = createInfo.pDependencies[i];
+			put(description, dependency.srcSubpass);
+			put(description, dependency.dstSubpass);
+			put(description, dependency.srcStageMask);
+			put(description, dependency.dstStageMask);
+			put(description, dependency.srcAccessMask);
+			put(description, dependency.dstAccessMask);
+			put(description, dependency.dependencyFlags);
+		}
+	}
+
+	bool PipelineManifest::describeStage(Description& description, const VkPipelineShaderStageCreateInfo& stage) const
+	{
+		auto shaderModule = shaderModules.find(handleKey(stage.module));
+		if ((stage.pNext != nullptr) || (shaderModule == shaderModules.end())) {
+			return false;
+		}
+		put(description, stage.flags);
+		put(description, static_cast<uint32_t>(stage.stage));
+		put(description, shaderModule->second.c_str());
+		put(description, stage.pName);
+		put(description, static_cast<uint32_t>(stage.pSpecializationInfo != nullptr));
+		if (stage.pSpecializationInfo) {
+			const VkSpecializationInfo& specializationInfo = *stage.pSpecializationInfo;
+			put(description, specializationInfo.mapEntryCount);
+			for (uint32_t i = 0; i < specializationInfo.mapEntryCount; i++) {
+				put(description, specializationInfo.pMapEntries[i].constantID);
+				put(description, specializationInfo.pMapEntries[i].offset);
+				put(description, static_cast<uint32_t>(specializationInfo.pMapEntries[i].size));
+			}
+			put(description, specializationInfo.pData, specializationInfo.dataSize);
+		}
+		return true;
+	}
+
+	bool PipelineManifest::describeLayout(Description& description, VkPipelineLayout layout) const
+	{
+		auto pipelineLayout = pipelineLayouts.find(handleKey(layout));
+		if ((pipelineLayout == pipelineLayouts.end()) || pipelineLayout->second.empty()) {
+			return false;
+		}
+		description.insert(description.end(), pipelineLayout->second.begin(), pipelineLayout->second.end());
+		return true;
+	}
+
+	bool PipelineManifest::describe(Description& description, const VkGraphicsPipelineCreateInfo& createInfo) const
+	{
+		const VkPipelineRenderingCreateInfoKHR* renderingInfo = nullptr;
+		for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+			if (next->sType != VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR) {
+				return false;
+			}
+			renderingInfo = reinterpret_cast<const VkPipelineRenderingCreateInfoKHR*>(next);
+		}
+		if ((createInfo.flags & VK_PIPELINE_CREATE_LIBRARY_BIT_KHR) || (createInfo.basePipelineHandle != VK_NULL_HANDLE)) {
+			return false;
+		}
+
+		put(description, static_cast<uint32_t>(Graphics));
+		put(description, createInfo.flags);
+		put(description, createInfo.stageCount);
+		for (uint32_t i = 0; i < createInfo.stageCount; i++) {
+			if (!describeStage(description, createInfo.pStages[i])) {
+				return false;
+			}
+		}
+
+		// Dynamic viewports and scissors ignore the values in the viewport state
+		bool dynamicViewport = false;
+		bool dynamicScissor = false;
+		if (createInfo.pDynamicState) {
+			for (uint32_t i = 0; i < createInfo.pDynamicState->dynamicStateCount; i++) {
+				dynamicViewport |= (createInfo.pDynamicState->pDynamicStates[i] == VK_DYNAMIC_STATE_VIEWPORT);
+				dynamicScissor |= (createInfo.pDynamicState->pDynamicStates[i] == VK_DYNAMIC_STATE_SCISSOR);
+			}
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pVertexInputState != nullptr));
+		if (const VkPipelineVertexInputStateCreateInfo* state = createInfo.pVertexInputState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, state->vertexBindingDescriptionCount);
+			for (uint32_t i = 0; i < state->vertexBindingDescriptionCount; i++) {
+				put(description, state->pVertexBindingDescriptions[i].binding);
+				put(description, state->pVertexBindingDescriptions[i].stride);
+				put(description, static_cast<uint32_t>(state->pVertexBindingDescriptions[i].inputRate));
+			}
+			put(description, state->vertexAttributeDescriptionCount);
+			for (uint32_t i = 0; i < state->vertexAttributeDescriptionCount; i++) {
+				put(description, state->pVertexAttributeDescriptions[i].location);
+				put(description, state->pVertexAttributeDescriptions[i].binding);
+				put(description, static_cast<uint32_t>(state->pVertexAttributeDescriptions[i].format));
+				put(description, state->pVertexAttributeDescriptions[i].offset);
+			}
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pInputAssemblyState != nullptr));
+		if (const VkPipelineInputAssemblyStateCreateInfo* state = createInfo.pInputAssemblyState) {
+			put(description, state->flags);
+			put(description, static_cast<uint32_t>(state->topology));
+			put(description, state->primitiveRestartEnable);
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pTessellationState != nullptr));
+		if (const VkPipelineTessellationStateCreateInfo* state = createInfo.pTessellationState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, state->patchControlPoints);
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pViewportState != nullptr));
+		if (const VkPipelineViewportStateCreateInfo* state = createInfo.pViewportState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, state->viewportCount);
+			const bool viewports = !dynamicViewport && (state->pViewports != nullptr);
+			put(description, static_cast<uint32_t>(viewports));
+			for (uint32_t i = 0; viewports && (i < state->viewportCount); i++) {
+				put(description, state->pViewports[i].x);
+				put(description, state->pViewports[i].y);
+				put(description, state->pViewports[i].width);
+				put(description, state->pViewports[i].height);
+				put(description, state->pViewports[i].minDepth);
+				put(description, state->pViewports[i].maxDepth);
+			}
+			put(description, state->scissorCount);
+			const bool scissors = !dynamicScissor && (state->pScissors != nullptr);
+			put(description, static_cast<uint32_t>(scissors));
+			for (uint32_t i = 0; scissors && (i < state->scissorCount); i++) {
+				put(description, static_cast<uint32_t>(state->pScissors[i].offset.x));
+				put(description, static_cast<uint32_t>(state->pScissors[i].offset.y));
+				put(description, state->pScissors[i].extent.width);
+				put(description, state->pScissors[i].extent.height);
+			}
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pRasterizationState != nullptr));
+		if (const VkPipelineRasterizationStateCreateInfo* state = createInfo.pRasterizationState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, state->depthClampEnable);
+			put(description, state->rasterizerDiscardEnable);
+			put(description, static_cast<uint32_t>(state->polygonMode));
+			put(description, state->cullMode);
+			put(description, static_cast<uint32_t>(state->frontFace));
+			put(description, state->depthBiasEnable);
+			put(description, state->depthBiasConstantFactor);
+			put(description, state->depthBiasClamp);
+			put(description, state->depthBiasSlopeFactor);
+			put(description, state->lineWidth);
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pMultisampleState != nullptr));
+		if (const VkPipelineMultisampleStateCreateInfo* state = createInfo.pMultisampleState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, static_cast<uint32_t>(state->rasterizationSamples));
+			put(description, state->sampleShadingEnable);
+			put(description, state->minSampleShading);
+			put(description, static_cast<uint32_t>(state->pSampleMask != nullptr));
+			if (state->pSampleMask) {
+				for (uint32_t i = 0; i < (static_cast<uint32_t>(state->rasterizationSamples) + 31) / 32; i++) {
+					put(description, state->pSampleMask[i]);
+				}
+			}
+			put(description, state->alphaToCoverageEnable);
+			put(description, state->alphaToOneEnable);
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pDepthStencilState != nullptr));
+		if (const VkPipelineDepthStencilStateCreateInfo* state = createInfo.pDepthStencilState) {
+			put(description, state->flags);
+			put(description, state->depthTestEnable);
+			put(description, state->depthWriteEnable);
+			put(description, static_cast<uint32_t>(state->depthCompareOp));
+			put(description, state->depthBoundsTestEnable);
+			put(description, state->stencilTestEnable);
+			putStencilOpState(description, state->front);
+			putStencilOpState(description, state->back);
+			put(description, state->minDepthBounds);
+			put(description, state->maxDepthBounds);
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pColorBlendState != nullptr));
+		if (const VkPipelineColorBlendStateCreateInfo* state = createInfo.pColorBlendState) {
+			if (state->pNext != nullptr) {
+				return false;
+			}
+			put(description, state->flags);
+			put(description, state->logicOpEnable);
+			put(description, static_cast<uint32_t>(state->logicOp));
+			put(description, state->attachmentCount);
+			for (uint32_t i = 0; i < state->attachmentCount; i++) {
+				const VkPipelineColorBlendAttachmentState& attachment = state->pAttachments[i];
+				put(description, attachment.blendEnable);
+				put(description, static_cast<uint32_t>(attachment.srcColorBlendFactor));
+				put(description, static_cast<uint32_t>(attachment.dstColorBlendFactor));
+				put(description, static_cast<uint32_t>(attachment.colorBlendOp));
+				put(description, static_cast<uint32_t>(attachment.srcAlphaBlendFactor));
+				put(description, static_cast<uint32_t>(attachment.dstAlphaBlendFactor));
+				put(description, static_cast<uint32_t>(attachment.alphaBlendOp));
+				put(description, attachment.colorWriteMask);
+			}
+			for (uint32_t i = 0; i < 4; i++) {
+				put(description, state->blendConstants[i]);
+			}
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.pDynamicState != nullptr));
+		if (const VkPipelineDynamicStateCreateInfo* state = createInfo.pDynamicState) {
+			put(description, state->flags);
+			put(description, state->dynamicStateCount);
+			for (uint32_t i = 0; i < state->dynamicStateCount; i++) {
+				put(description, static_cast<uint32_t>(state->pDynamicStates[i]));
+			}
+		}
+
+		if (!describeLayout(description, createInfo.layout)) {
+			return false;
+		}
+
+		put(description, static_cast<uint32_t>(createInfo.renderPass != VK_NULL_HANDLE));
+		if (createInfo.renderPass != VK_NULL_HANDLE) {
+			auto renderPass = renderPasses.find(handleKey(createInfo.renderPass));
+			if ((renderPass == renderPasses.end()) || renderPass->second.empty()) {
+				return false;
+			}
+			description.insert(description.end(), renderPass->second.begin(), renderPass->second.end());
+			put(description, createInfo.subpass);
+		}
+		// The attachment formats of dynamic rendering are only used without a render pass
+		const bool rendering = (createInfo.renderPass == VK_NULL_HANDLE) && (renderingInfo != nullptr);
+		put(description, static_cast<uint32_t>(rendering));
+		if (rendering) {
+			put(description, renderingInfo->viewMask);
+			put(description, renderingInfo->colorAttachmentCount);
+			for (uint32_t i = 0; i < renderingInfo->colorAttachmentCount; i++) {
+				put(description, static_cast<uint32_t>(renderingInfo->pColorAttachmentFormats[i]));
+			}
+			put(description, static_cast<uint32_t>(renderingInfo->depthAttachmentFormat));
+			put(description, static_cast<uint32_t>(renderingInfo->stencilAttachmentFormat));
+		}
+		return true;
+	}
+
+	bool PipelineManifest::describe(Description& description, const VkComputePipelineCreateInfo& createInfo) const
+	{
+		if ((createInfo.pNext != nullptr) || (createInfo.basePipelineHandle != VK_NULL_HANDLE)) {
+			return false;
+		}
+		put(description, static_cast<uint32_t>(Compute));
+		put(description, createInfo.flags);
+		return describeStage(description, createInfo.stage) && describeLayout(description, createInfo.layout);
+	}
+
+	void PipelineManifest::record(uint64_t key, const Description& state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry& entry = entries[key];
+		if (entry.state.empty()) {
+			entry.state = state;
+		}
+		entry.sessionCount++;
+	}
+
+	/** @brief Hand out one of the precompiled pipelines for the given state, waits for it if it's still being compiled */
+	VkPipeline PipelineManifest::take(uint64_t key, const Description& state)
+	{
+		std::shared_future<VkPipeline> future;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto entry = precompiled.find(key);
+			if ((entry == precompiled.end()) || entry->second.pipelines.empty() || (entry->second.state != state)) {
+				return VK_NULL_HANDLE;
+			}
+			future = entry->second.pipelines.back();
+			entry->second.pipelines.pop_back();
+		}
+		const VkPipeline pipeline = future.get();
+		if (pipeline != VK_NULL_HANDLE) {
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.used++;
+		}
+		return pipeline;
+	}
+
+	/** @brief Recreate the objects a recorded pipeline references and compile it, returns VK_NULL_HANDLE if that fails (e.g. as a shader file is missing) */
+	VkPipeline PipelineManifest::compile(const Description& state, const ShaderLoader& shaderLoader, VkPipelineCache pipelineCache)
+	{
+		TraceZone zone("Precompile pipeline");
+		Reader reader(state);
+		ReplayObjects objects;
+		objects.device = device;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::vector<ReplayStage> stages;
+		bool valid = true;
+
+		const uint32_t type = reader.u32();
+		const uint32_t flags = reader.u32();
+		if (type == Compute) {
+			stages.resize(1);
+			valid = replayStage(reader, stages[0], objects, shaderLoader) && replayPipelineLayout(reader, objects);
+			if (valid) {
+				VkComputePipelineCreateInfo createInfo{};
+				createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				createInfo.flags = flags;
+				createInfo.stage = stages[0].createInfo;
+				createInfo.layout = objects.pipelineLayout;
+				createInfo.basePipelineIndex = -1;
+				const StartupProfiler::Clock::time_point begin = StartupProfiler::Clock::now();
+				valid = (vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline) == VK_SUCCESS);
+				StartupProfiler::get().addPipelines(1, 0, 0, StartupProfiler::elapsed(begin, StartupProfiler::Clock::now()));
+			}
+		} else if (type == Graphics) {
+			VkGraphicsPipelineCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			createInfo.flags = flags;
+			createInfo.basePipelineIndex = -1;
+
+			stages.resize(reader.count());
+			for (auto& stage : stages) {
+				valid = valid && replayStage(reader, stage, objects, shaderLoader);
+			}
+			std::vector<VkPipelineShaderStageCreateInfo> stageCreateInfos;
+			for (auto& stage : stages) {
+				stageCreateInfos.push_back(stage.createInfo);
+			}
+			createInfo.stageCount = static_cast<uint32_t>(stageCreateInfos.size());
+			createInfo.pStages = stageCreateInfos.data();
+
+			VkPipelineVertexInputStateCreateInfo vertexInputState{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+			std::vector<VkVertexInputBindingDescription> vertexBindings;
+			std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+			if (reader.u32() != 0) {
+				vertexInputState.flags = reader.u32();
+				vertexBindings.resize(reader.count());
+				for (auto& binding : vertexBindings) {
+					binding.binding = reader.u32();
+					binding.stride = reader.u32();
+					binding.inputRate = static_cast<VkVertexInputRate>(reader.u32());
+				}
+				vertexAttributes.resize(reader.count());
+				for (auto& attribute : vertexAttributes) {
+					attribute.location = reader.u32();
+					attribute.binding = reader.u32();
+					attribute.format = static_cast<VkFormat>(reader.u32());
+					attribute.offset = reader.u32();
+				}
+				vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+				vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+				vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+				vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+				createInfo.pVertexInputState = &vertexInputState;
+			}
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+			if (reader.u32() != 0) {
+				inputAssemblyState.flags = reader.u32();
+				inputAssemblyState.topology = static_cast<VkPrimitiveTopology>(reader.u32());
+				inputAssemblyState.primitiveRestartEnable = reader.u32();
+				createInfo.pInputAssemblyState = &inputAssemblyState;
+			}
+
+			VkPipelineTessellationStateCreateInfo tessellationState{ VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO };
+			if (reader.u32() != 0) {
+				tessellationState.flags = reader.u32();
+				tessellationState.patchControlPoints = reader.u32();
+				createInfo.pTessellationState = &tessellationState;
+			}
+
+			VkPipelineViewportStateCreateInfo viewportState{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+			std::vector<VkViewport> viewports;
+			std::vector<VkRect2D> scissors;
+			if (reader.u32() != 0) {
+				viewportState.flags = reader.u32();
+				viewportState.viewportCount = reader.count();
+				if (reader.u32() != 0) {
+					viewports.resize(viewportState.viewportCount);
+					for (auto& viewport : viewports) {
+						viewport.x = reader.f32();
+						viewport.y = reader.f32();
+						viewport.width = reader.f32();
+						viewport.height = reader.f32();
+						viewport.minDepth = reader.f32();
+						viewport.maxDepth = reader.f32();
+					}
+					viewportState.pViewports = viewports.data();
+				}
+				viewportState.scissorCount = reader.count();
+				if (reader.u32() != 0) {
+					scissors.resize(viewportState.scissorCount);
+					for (auto& scissor : scissors) {
+						scissor.offset.x = static_cast<int32_t>(reader.u32());
+						scissor.offset.y = static_cast<int32_t>(reader.u32());
+						scissor.extent.width = reader.u32();
+						scissor.extent.height = reader.u32();
+					}
+					viewportState.pScissors = scissors.data();
+				}
+				createInfo.pViewportState = &viewportState;
+			}
+
+			VkPipelineRasterizationStateCreateInfo rasterizationState{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+			if (reader.u32() != 0) {
+				rasterizationState.flags = reader.u32();
+				rasterizationState.depthClampEnable = reader.u32();
+				rasterizationState.rasterizerDiscardEnable = reader.u32();
+				rasterizationState.polygonMode = static_cast<VkPolygonMode>(reader.u32());
+				rasterizationState.cullMode = reader.u32();
+				rasterizationState.frontFace = static_cast<VkFrontFace>(reader.u32());
+				rasterizationState.depthBiasEnable = reader.u32();
+				rasterizationState.depthBiasConstantFactor = reader.f32();
+				rasterizationState.depthBiasClamp = reader.f32();
+				rasterizationState.depthBiasSlopeFactor = reader.f32();
+				rasterizationState.lineWidth = reader.f32();
+				createInfo.pRasterizationState = &rasterizationState;
+			}
+
+			VkPipelineMultisampleStateCreateInfo multisampleState{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+			std::vector<VkSampleMask> sampleMask;
+			if (reader.u32() != 0) {
+				multisampleState.flags = reader.u32();
+				multisampleState.rasterizationSamples = static_cast<VkSampleCountFlagBits>(reader.u32());
+				multisampleState.sampleShadingEnable = reader.u32();
+				multisampleState.minSampleShading = reader.f32();
+				if (reader.u32() != 0) {
+					sampleMask.resize((static_cast<uint32_t>(multisampleState.rasterizationSamples) + 31) / 32);
+					for (auto& mask : sampleMask) {
+						mask = reader.u32();
+					}
+					multisampleState.pSampleMask = sampleMask.data();
+				}
+				multisampleState.alphaToCoverageEnable = reader.u32();
+				multisampleState.alphaToOneEnable = reader.u32();
+				createInfo.pMultisampleState = &multisampleState;
+			}
+
+			VkPipelineDepthStencilStateCreateInfo depthStencilState{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+			if (reader.u32() != 0) {
+				depthStencilState.flags = reader.u32();
+				depthStencilState.depthTestEnable = reader.u32();
+				depthStencilState.depthWriteEnable = reader.u32();
+				depthStencilState.depthCompareOp = static_cast<VkCompareOp>(reader.u32());
+				depthStencilState.depthBoundsTestEnable = reader.u32();
+				depthStencilState.stencilTestEnable = reader.u32();
+				depthStencilState.front = getStencilOpState(reader);
+				depthStencilState.back = getStencilOpState(reader);
+				depthStencilState.minDepthBounds = reader.f32();
+				depthStencilState.maxDepthBounds = reader.f32();
+				createInfo.pDepthStencilState = &depthStencilState;
+			}
+
+			VkPipelineColorBlendStateCreateInfo colorBlendState{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+			std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+			if (reader.u32() != 0) {
+				colorBlendState.flags = reader.u32();
+				colorBlendState.logicOpEnable = reader.u32();
+				colorBlendState.logicOp = static_cast<VkLogicOp>(reader.u32());
+				blendAttachments.resize(reader.count());
+				for (auto& attachment : blendAttachments) {
+					attachment.blendEnable = reader.u32();
+					attachment.srcColorBlendFactor = static_cast<VkBlendFactor>(reader.u32());
+					attachment.dstColorBlendFactor = static_cast<VkBlendFactor>(reader.u32());
+					attachment.colorBlendOp = static_cast<VkBlendOp>(reader.u32());
+					attachment.srcAlphaBlendFactor = static_cast<VkBlendFactor>(reader.u32());
+					attachment.dstAlphaBlendFactor = static_cast<VkBlendFactor>(reader.u32());
+					attachment.alphaBlendOp = static_cast<VkBlendOp>(reader.u32());
+					attachment.colorWriteMask = reader.u32();
+				}
+				for (uint32_t i = 0; i < 4; i++) {
+					colorBlendState.blendConstants[i] = reader.f32();
+				}
+				colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+				colorBlendState.pAttachments = blendAttachments.data();
+				createInfo.pColorBlendState = &colorBlendState;
+			}
+
+			VkPipelineDynamicStateCreateInfo dynamicState{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+			std::vector<VkDynamicState> dynamicStates;
+			if (reader.u32() != 0) {
+				dynamicState.flags = reader.u32();
+				dynamicStates.resize(reader.count());
+				for (auto& dynamicStateValue : dynamicStates) {
+					dynamicStateValue = static_cast<VkDynamicState>(reader.u32());
+				}
+				dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+				dynamicState.pDynamicStates = dynamicStates.data();
+				createInfo.pDynamicState = &dynamicState;
+			}
+
+			valid = valid && reader.valid && replayPipelineLayout(reader, objects);
+			createInfo.layout = objects.pipelineLayout;
+
+			if (valid && (reader.u32() != 0)) {
+				valid = replayRenderPass(reader, objects);
+				createInfo.renderPass = objects.renderPass;
+				createInfo.subpass = reader.u32();
+			}
+
+			VkPipelineRenderingCreateInfoKHR renderingInfo{};
+			std::vector<VkFormat> colorFormats;
+			if (valid && (reader.u32() != 0)) {
+				renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+				renderingInfo.viewMask = reader.u32();
+				colorFormats.resize(reader.count());
+				for (auto& format : colorFormats) {
+					format = static_cast<VkFormat>(reader.u32());
+				}
+				renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+				renderingInfo.pColorAttachmentFormats = colorFormats.data();
+				renderingInfo.depthAttachmentFormat = static_cast<VkFormat>(reader.u32());
+				renderingInfo.stencilAttachmentFormat = static_cast<VkFormat>(reader.u32());
+				createInfo.pNext = &renderingInfo;
+			}
+
+			if (valid && reader.valid) {
+				const StartupProfiler::Clock::time_point begin = StartupProfiler::Clock::now();
+				valid = (vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline) == VK_SUCCESS);
+				StartupProfiler::get().addPipelines(1, 0, 0, StartupProfiler::elapsed(begin, StartupProfiler::Clock::now()));
+			}
+		}
+		if (!valid || !reader.valid) {
+			pipeline = VK_NULL_HANDLE;
+		}
+
+		// Shader modules aren't needed once the pipeline has been created, the other objects are kept until the manifest is destroyed
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& shaderModule : objects.shaderModules) {
+			// The handle may be reused for a module that's not created from a file, so it mustn't keep the file name of this module
+			shaderModules.erase(handleKey(shaderModule));
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}
+		replaySetLayouts.insert(replaySetLayouts.end(), objects.setLayouts.begin(), objects.setLayouts.end());
+		if (objects.pipelineLayout != VK_NULL_HANDLE) {
+			replayPipelineLayouts.push_back(objects.pipelineLayout);
+		}
+		if (objects.renderPass != VK_NULL_HANDLE) {
+			replayRenderPasses.push_back(objects.renderPass);
+		}
+		return pipeline;
+	}
+
+	// Hands out precompiled pipelines for the create infos with a recorded state and creates the others with the given function
+	template<typename CreateInfo, typename CreateFunction>
+	VkResult PipelineManifest::createPipelines(uint32_t createInfoCount, const CreateInfo* pCreateInfos, VkPipeline* pPipelines, const CreateFunction& create)
+	{
+		if (!active()) {
+			return create(createInfoCount, pCreateInfos, pPipelines);
+		}
+		// Derivatives of a pipeline in the same batch are created along with it
+		bool batchDerivatives = false;
+		for (uint32_t i = 0; i < createInfoCount; i++) {
+			batchDerivatives |= (pCreateInfos[i].flags & VK_PIPELINE_CREATE_DERIVATIVE_BIT) && (pCreateInfos[i].basePipelineIndex >= 0);
+		}
+		std::vector<uint32_t> compileIndices;
+		for (uint32_t i = 0; i < createInfoCount; i++) {
+			pPipelines[i] = VK_NULL_HANDLE;
+			Description state;
+			bool described = false;
+			if (!batchDerivatives) {
+				std::lock_guard<std::mutex> lock(mutex);
+				described = describe(state, pCreateInfos[i]);
+				if (!described) {
+					statistics.unrecorded++;
+				}
+			}
+			if (described) {
+				const uint64_t key = hash(state);
+				record(key, state);
+				pPipelines[i] = take(key, state);
+			}
+			if (pPipelines[i] == VK_NULL_HANDLE) {
+				compileIndices.push_back(i);
+			}
+		}
+		if (compileIndices.empty()) {
+			return VK_SUCCESS;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.compiled += static_cast<uint32_t>(compileIndices.size());
+		}
+		if (compileIndices.size() == createInfoCount) {
+			return create(createInfoCount, pCreateInfos, pPipelines);
+		}
+		std::vector<CreateInfo> createInfos;
+		for (auto index : compileIndices) {
+			createInfos.push_back(pCreateInfos[index]);
+		}
+		std::vector<VkPipeline> pipelines(createInfos.size());
+		VkResult result = create(static_cast<uint32_t>(createInfos.size()), createInfos.data(), pipelines.data());
+		for (size_t i = 0; i < compileIndices.size(); i++) {
+			pPipelines[compileIndices[i]] = pipelines[i];
+		}
+		return result;
+	}
+
+	/** @brief Create graphics pipelines with the given function, unless a precompiled pipeline with the same state is available */
+	VkResult PipelineManifest::createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines, const GraphicsPipelineFunction& create)
+	{
+		return createPipelines(createInfoCount, pCreateInfos, pPipelines, create);
+	}
+
+	/** @brief Create compute pipelines with the given function, unless a precompiled pipeline with the same state is available */
+	VkResult PipelineManifest::createComputePipelines(uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines, const ComputePipelineFunction& create)
+	{
+		return createPipelines(createInfoCount, pCreateInfos, pPipelines, create);
+	}
+
+	VkResult createDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout)
+	{
+		VkResult result = vkCreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
+		if (result == VK_SUCCESS) {
+			PipelineManifest::get().addDescriptorSetLayout(*pSetLayout, *pCreateInfo);
+		}
+		return result;
+	}
+
+	VkResult createPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout)
+	{
+		VkResult result = vkCreatePipelineLayout(device, pCreateInfo, pAllocator, pPipelineLayout);
+		if (result == VK_SUCCESS) {
+			PipelineManifest::get().addPipelineLayout(*pPipelineLayout, *pCreateInfo);
+		}
+		return result;
+	}
+
+	VkResult createRenderPass(VkDevice device, const VkRenderPassCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkRenderPass* pRenderPass)
+	{
+		VkResult result = vkCreateRenderPass(device, pCreateInfo, pAllocator, pRenderPass);
+		if (result == VK_SUCCESS) {
+			PipelineManifest::get().addRenderPass(*pRenderPass, *pCreateInfo);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,143 @@
+/*
+* Vulkan pipeline manifest
+*
+* Records the state of all pipelines created in a session to a file and compiles them on worker threads while the next session is loading,
+* so pipelines created later on (e.g. when toggling settings) don't stall the frame they're created in
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	class PipelineCompiler;
+
+	/**
+	* @brief Captures the pipelines used in a session and precompiles them at the start of the next one
+	*
+	* A pipeline create info references objects that only exist in the session that created it (shader modules, pipeline layouts and render passes),
+	* so the manifest keeps a description of these objects as they are created: the file name of shader modules loaded with vks::tools::loadShader and
+	* the create infos of descriptor set layouts, pipeline layouts and render passes created with the drop-in replacements below.
+	* The pipeline creation functions (vks::createGraphicsPipelines, vks::createComputePipelines) serialize each create info along with the descriptions
+	* of the objects it references and record how often it was created.
+	*
+	* At the next start precompile() recreates equivalent objects on the worker threads of the pipeline compiler and compiles each recorded pipeline as many
+	* times as it was created in the recorded session. Once the example creates a pipeline with matching state, one of the precompiled pipelines is handed out
+	* instead of compiling it on the calling thread (waiting for it if it's still being compiled). This is valid, as pipelines only require the pipeline layout and
+	* render pass used for binding and drawing to be compatible with (i.e. identically defined as) the ones they've been created with.
+	*
+	* Pipelines that reference objects the manifest can't describe are created as usual and not recorded:
+	* shader modules not loaded from a file, immutable samplers, pipeline derivatives, pipeline libraries and extension structures other than dynamic rendering
+	* (VkPipelineRenderingCreateInfoKHR) and descriptor binding flags.
+	*
+	* @note The manifest only records and hands out pipelines while it's active (see setActive), there is one manifest per process, shared by all threads
+	*/
+	class PipelineManifest
+	{
+	public:
+		/** @brief Pipelines of an entry that are precompiled at most, even if it has been created more often in the recorded session */
+		static const uint32_t MaxCopies = 4;
+
+		struct Statistics
+		{
+			/** @brief Entries of the manifest loaded at startup */
+			uint32_t entries = 0;
+			/** @brief Pipelines queued for precompilation */
+			uint32_t precompiled = 0;
+			/** @brief Precompiled pipelines handed out to the example */
+			uint32_t used = 0;
+			/** @brief Pipelines that had to be compiled when they were created (not in the manifest or all of its precompiled copies already in use) */
+			uint32_t compiled = 0;
+			/** @brief Pipelines that couldn't be recorded, as they reference objects the manifest can't describe */
+			uint32_t unrecorded = 0;
+		};
+
+		typedef std::function<VkShaderModule(const std::string& fileName)> ShaderLoader;
+		typedef std::function<VkResult(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines)> GraphicsPipelineFunction;
+		typedef std::function<VkResult(uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines)> ComputePipelineFunction;
+
+	private:
+		enum PipelineType : uint32_t { Graphics = 0, Compute = 1 };
+
+		// Serialized description of an object a pipeline references, empty if it can't be described
+		typedef std::vector<uint8_t> Description;
+
+		struct Entry
+		{
+			Description state;
+			// Number of creations in the loaded manifest and in this session
+			uint32_t loadedCount = 0;
+			uint32_t sessionCount = 0;
+		};
+		struct Precompiled
+		{
+			Description state;
+			std::vector<std::shared_future<VkPipeline>> pipelines;
+		};
+
+		mutable std::mutex mutex;
+		bool isActive = false;
+		VkDevice device = VK_NULL_HANDLE;
+		std::unordered_map<uint64_t, std::string> shaderModules;
+		std::unordered_map<uint64_t, Description> setLayouts;
+		std::unordered_map<uint64_t, Description> pipelineLayouts;
+		std::unordered_map<uint64_t, Description> renderPasses;
+		std::unordered_map<uint64_t, Entry> entries;
+		std::unordered_map<uint64_t, Precompiled> precompiled;
+		// Objects created for the precompiled pipelines, destroyed with the manifest as pipelines may require them to stay alive while they are in use
+		std::vector<VkDescriptorSetLayout> replaySetLayouts;
+		std::vector<VkPipelineLayout> replayPipelineLayouts;
+		std::vector<VkRenderPass> replayRenderPasses;
+		Statistics statistics;
+
+		static uint64_t hash(const Description& description);
+		bool describeStage(Description& description, const VkPipelineShaderStageCreateInfo& stage) const;
+		bool describeLayout(Description& description, VkPipelineLayout layout) const;
+		bool describe(Description& description, const VkGraphicsPipelineCreateInfo& createInfo) const;
+		bool describe(Description& description, const VkComputePipelineCreateInfo& createInfo) const;
+		void record(uint64_t key, const Description& state);
+		VkPipeline take(uint64_t key, const Description& state);
+		VkPipeline compile(const Description& state, const ShaderLoader& shaderLoader, VkPipelineCache pipelineCache);
+		template<typename CreateInfo, typename CreateFunction>
+		VkResult createPipelines(uint32_t createInfoCount, const CreateInfo* pCreateInfos, VkPipeline* pPipelines, const CreateFunction& create);
+
+	public:
+		static PipelineManifest& get();
+
+		/** @brief Start (or stop) recording object descriptions and pipelines, objects created while inactive can't be described */
+		void setActive(bool active);
+		bool active() const;
+
+		bool load(const std::string& fileName);
+		bool save(const std::string& fileName) const;
+		void precompile(VkDevice device, vks::PipelineCompiler& compiler, VkPipelineCache pipelineCache, const ShaderLoader& shaderLoader);
+		void destroy();
+		Statistics getStatistics() const;
+
+		void addShaderModule(VkShaderModule shaderModule, const std::string& fileName);
+		void addDescriptorSetLayout(VkDescriptorSetLayout setLayout, const VkDescriptorSetLayoutCreateInfo& createInfo);
+		void addPipelineLayout(VkPipelineLayout pipelineLayout, const VkPipelineLayoutCreateInfo& createInfo);
+		void addRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo);
+
+		VkResult createGraphicsPipelines(uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines, const GraphicsPipelineFunction& create);
+		VkResult createComputePipelines(uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, VkPipeline* pPipelines, const ComputePipelineFunction& create);
+	};
+
+	// Drop-in replacements for vkCreateDescriptorSetLayout, vkCreatePipelineLayout and vkCreateRenderPass that let the pipeline manifest describe the created objects
+	VkResult createDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout);
+	VkResult createPipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout);
+	VkResult createRenderPass(VkDevice device, const VkRenderPassCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkRenderPass* pRenderPass);
+}
@@ -0,0 +1,267 @@
+/*
+* Vulkan pipeline permutations
+*
+* Specializations of an uber shader pipeline keyed by a feature bitmask that are compiled lazily on the pipeline compiler's worker threads
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelinePermutations.h"
+#include "VulkanStartupProfiler.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace vks
+{
+	PipelinePermutations::~PipelinePermutations()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the permutations
+	*
+	* @param device Logical device to create the pipelines on
+	* @param compiler Pipeline compiler the specialized pipelines are queued on
+	* @param pipelineCache Pipeline cache for the generic pipeline (should be the one used by the compiler)
+	* @param specializedConstantID Constant ID of the boolean that's true for specialized pipelines
+	* @param firstFeatureConstantID Constant ID of the boolean for the first feature bit, the following bits use consecutive IDs
+	* @param featureCount Number of feature bits
+	*/
+	void PipelinePermutations::setup(VkDevice device, vks::PipelineCompiler* compiler, VkPipelineCache pipelineCache, uint32_t specializedConstantID, uint32_t firstFeatureConstantID, uint32_t featureCount)
+	{
+		assert(compiler);
+		assert((featureCount > 0) && (featureCount <= 32));
+		this->device = device;
+		this->compiler = compiler;
+		this->pipelineCache = pipelineCache;
+		this->specializedConstantID = specializedConstantID;
+		this->firstFeatureConstantID = firstFeatureConstantID;
+		this->featureCount = featureCount;
+	}
+
+	void PipelinePermutations::copyState(const VkGraphicsPipelineCreateInfo& createInfo)
+	{
+		state.reset(new PipelineState());
+		PipelineState& s = *state;
+		s.createInfo = createInfo;
+
+		// Shader stages, including the specialization constants they already set
+		s.stages.assign(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+		s.specializationInfos.resize(s.stages.size());
+		s.mapEntries.resize(s.stages.size());
+		s.specializationData.resize(s.stages.size());
+		for (size_t i = 0; i < s.stages.size(); i++) {
+			const VkSpecializationInfo* info = s.stages[i].pSpecializationInfo;
+			if (!info) {
+				continue;
+			}
+			s.mapEntries[i].assign(info->pMapEntries, info->pMapEntries + info->mapEntryCount);
+			const uint8_t* data = static_cast<const uint8_t*>(info->pData);
+			s.specializationData[i].assign(data, data + info->dataSize);
+			s.specializationInfos[i] = *info;
+			s.specializationInfos[i].pMapEntries = s.mapEntries[i].data();
+			s.specializationInfos[i].pData = s.specializationData[i].data();
+			s.stages[i].pSpecializationInfo = &s.specializationInfos[i];
+		}
+		s.createInfo.pStages = s.stages.data();
+
+		if (createInfo.pVertexInputState) {
+			s.vertexInputState = *createInfo.pVertexInputState;
+			const VkPipelineVertexInputStateCreateInfo& vertexInput = *createInfo.pVertexInputState;
+			s.vertexBindings.assign(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+			s.vertexAttributes.assign(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+			s.vertexInputState.pVertexBindingDescriptions = s.vertexBindings.data();
+			s.vertexInputState.pVertexAttributeDescriptions = s.vertexAttributes.data();
+			s.createInfo.pVertexInputState = &s.vertexInputState;
+		}
+		if (createInfo.pInputAssemblyState) {
+			s.inputAssemblyState = *createInfo.pInputAssemblyState;
+			s.createInfo.pInputAssemblyState = &s.inputAssemblyState;
+		}
+		if (createInfo.pTessellationState) {
+			s.tessellationState = *createInfo.pTessellationState;
+			s.createInfo.pTessellationState = &s.tessellationState;
+		}
+		if (createInfo.pViewportState) {
+			s.viewportState = *createInfo.pViewportState;
+			const VkPipelineViewportStateCreateInfo& viewport = *createInfo.pViewportState;
+			// Viewports and scissors are usually dynamic, in which case the arrays are ignored
+			if (viewport.pViewports) {
+				s.viewports.assign(viewport.pViewports, viewport.pViewports + viewport.viewportCount);
+				s.viewportState.pViewports = s.viewports.data();
+			}
+			if (viewport.pScissors) {
+				s.scissors.assign(viewport.pScissors, viewport.pScissors + viewport.scissorCount);
+				s.viewportState.pScissors = s.scissors.data();
+			}
+			s.createInfo.pViewportState = &s.viewportState;
+		}
+		if (createInfo.pRasterizationState) {
+			s.rasterizationState = *createInfo.pRasterizationState;
+			s.createInfo.pRasterizationState = &s.rasterizationState;
+		}
+		if (createInfo.pMultisampleState) {
+			// The sample mask is not copied
+			assert(createInfo.pMultisampleState->pSampleMask == nullptr);
+			s.multisampleState = *createInfo.pMultisampleState;
+			s.createInfo.pMultisampleState = &s.multisampleState;
+		}
+		if (createInfo.pDepthStencilState) {
+			s.depthStencilState = *createInfo.pDepthStencilState;
+			s.createInfo.pDepthStencilState = &s.depthStencilState;
+		}
+		if (createInfo.pColorBlendState) {
+			s.colorBlendState = *createInfo.pColorBlendState;
+			const VkPipelineColorBlendStateCreateInfo& colorBlend = *createInfo.pColorBlendState;
+			s.blendAttachments.assign(colorBlend.pAttachments, colorBlend.pAttachments + colorBlend.attachmentCount);
+			s.colorBlendState.pAttachments = s.blendAttachments.data();
+			s.createInfo.pColorBlendState = &s.colorBlendState;
+		}
+		if (createInfo.pDynamicState) {
+			s.dynamicState = *createInfo.pDynamicState;
+			const VkPipelineDynamicStateCreateInfo& dynamic = *createInfo.pDynamicState;
+			s.dynamicStates.assign(dynamic.pDynamicStates, dynamic.pDynamicStates + dynamic.dynamicStateCount);
+			s.dynamicState.pDynamicStates = s.dynamicStates.data();
+			s.createInfo.pDynamicState = &s.dynamicState;
+		}
+	}
+
+	/**
+	* Create the generic pipeline and keep a copy of the pipeline state for the specialized permutations
+	*
+	* @param createInfo Create info of the generic pipeline, the state it points to only needs to be valid during this call
+	* @param specializedStages Shader stages that get the feature specialization constants
+	*
+	* @note Extension structures chained to the create info (pNext) are not copied and must stay valid until destroy
+	*/
+	void PipelinePermutations::prepare(const VkGraphicsPipelineCreateInfo& createInfo, VkShaderStageFlags specializedStages)
+	{
+		assert(compiler);
+		assert(genericPipeline == VK_NULL_HANDLE);
+		this->specializedStages = specializedStages;
+		copyState(createInfo);
+		// Created right away, as it's the fallback for all permutations that have not been compiled yet
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &state->createInfo, nullptr, &genericPipeline));
+	}
+
+	/** @brief Wait for queued compilations and destroy all pipelines */
+	void PipelinePermutations::destroy()
+	{
+		for (auto& permutation : permutations) {
+			VkPipeline pipeline = permutation.second->future.get();
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		permutations.clear();
+		if (genericPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, genericPipeline, nullptr);
+			genericPipeline = VK_NULL_HANDLE;
+		}
+		state.reset();
+	}
+
+	void PipelinePermutations::queuePermutation(uint32_t features)
+	{
+		std::unique_ptr<Permutation> permutation(new Permutation());
+		Permutation& p = *permutation;
+		const size_t stageCount = state->stages.size();
+		p.stages = state->stages;
+		p.specializationInfos.resize(stageCount);
+		p.mapEntries.resize(stageCount);
+		p.specializationData.resize(stageCount);
+		for (size_t i = 0; i < stageCount; i++) {
+			if ((p.stages[i].stage & specializedStages) == 0) {
+				continue;
+			}
+			// The feature constants are appended to the stage's own constants
+			const VkDeviceSize baseOffset = vks::tools::alignedVkSize(state->specializationData[i].size(), sizeof(VkBool32));
+			p.mapEntries[i] = state->mapEntries[i];
+			p.specializationData[i] = state->specializationData[i];
+			p.specializationData[i].resize(static_cast<size_t>(baseOffset) + (featureCount + 1) * sizeof(VkBool32));
+			for (uint32_t j = 0; j <= featureCount; j++) {
+				// The first constant marks the pipeline as specialized, followed by one constant per feature
+				const VkBool32 value = (j == 0) ? VK_TRUE : (((features >> (j - 1)) & 1) ? VK_TRUE : VK_FALSE);
+				VkSpecializationMapEntry mapEntry{};
+				mapEntry.constantID = (j == 0) ? specializedConstantID : firstFeatureConstantID + j - 1;
+				mapEntry.offset = static_cast<uint32_t>(baseOffset + j * sizeof(VkBool32));
+				mapEntry.size = sizeof(VkBool32);
+				memcpy(&p.specializationData[i][mapEntry.offset], &value, sizeof(VkBool32));
+				p.mapEntries[i].push_back(mapEntry);
+			}
+			p.specializationInfos[i].mapEntryCount = static_cast<uint32_t>(p.mapEntries[i].size());
+			p.specializationInfos[i].pMapEntries = p.mapEntries[i].data();
+			p.specializationInfos[i].dataSize = p.specializationData[i].size();
+			p.specializationInfos[i].pData = p.specializationData[i].data();
+			p.stages[i].pSpecializationInfo = &p.specializationInfos[i];
+		}
+		p.createInfo = state->createInfo;
+		p.createInfo.pStages = p.stages.data();
+		p.future = compiler->addGraphicsPipeline(p.createInfo);
+		permutations[features] = std::move(permutation);
+	}
+
+	/**
+	* Get the pipeline for a feature combination
+	*
+	* @param features Bitmask of the enabled features
+	*
+	* @return The specialized pipeline if it has been compiled, the generic pipeline otherwise
+	*
+	* @note Queues the specialized pipeline for compilation the first time a combination is requested
+	*/
+	VkPipeline PipelinePermutations::get(uint32_t features)
+	{
+		assert(genericPipeline != VK_NULL_HANDLE);
+		assert((featureCount == 32) || (features < (1u << featureCount)));
+		auto it = permutations.find(features);
+		if (it == permutations.end()) {
+			queuePermutation(features);
+			return genericPipeline;
+		}
+		return (it->second->pipeline != VK_NULL_HANDLE) ? it->second->pipeline : genericPipeline;
+	}
+
+	/** @brief Returns true if the specialized pipeline for a feature combination is used by get */
+	bool PipelinePermutations::isSpecialized(uint32_t features) const
+	{
+		auto it = permutations.find(features);
+		return (it != permutations.end()) && (it->second->pipeline != VK_NULL_HANDLE);
+	}
+
+	/**
+	* Pick up specialized pipelines that have finished compiling
+	*
+	* @return True if get returns a different pipeline for any feature combination, i.e. command buffers need to be recorded again
+	*/
+	bool PipelinePermutations::update()
+	{
+		bool changed = false;
+		for (auto& permutation : permutations) {
+			Permutation& p = *permutation.second;
+			if ((p.pipeline == VK_NULL_HANDLE) && (p.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+				p.pipeline = p.future.get();
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	uint32_t PipelinePermutations::specializedCount() const
+	{
+		uint32_t count = 0;
+		for (auto& permutation : permutations) {
+			if (permutation.second->pipeline != VK_NULL_HANDLE) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	uint32_t PipelinePermutations::pendingCount() const
+	{
+		return static_cast<uint32_t>(permutations.size()) - specializedCount();
+	}
+}
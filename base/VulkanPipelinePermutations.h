@@ -0,0 +1,109 @@
+/*
+* Vulkan pipeline permutations
+*
+* Specializations of an uber shader pipeline keyed by a feature bitmask that are compiled lazily on the pipeline compiler's worker threads
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanPipelineCompiler.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Lazily compiled feature permutations of an uber shader pipeline
+	*
+	* The generic pipeline is created up front without the feature specialization constants, so its shaders take the features
+	* from a runtime value (e.g. a push constant) and branch on them. The first time a feature combination is requested, a pipeline
+	* specialized for it is queued on the pipeline compiler (sharing its pipeline cache) and the generic pipeline is used until it's ready.
+	*
+	* Specialized pipelines set the "specialized" constant to true and the constant of each feature (firstFeatureConstantID + bit) to
+	* whether its bit is set, so the shader compiler can drop the runtime branches along with the code of disabled features:
+	*	layout (constant_id = 2) const bool SPECIALIZED = false;
+	*	layout (constant_id = 3) const bool FEATURE_SPECULAR = false;
+	*	bool specular = SPECIALIZED ? FEATURE_SPECULAR : ((pushConsts.features & 1) != 0);
+	*
+	* Specialization constants the create info's shader stages already set (e.g. a lighting model) are kept for all permutations.
+	*
+	* @note Pipelines change once compilation has finished (see update), so pre-recorded command buffers need to be recorded again
+	*/
+	class PipelinePermutations
+	{
+	private:
+		// Copy of the pipeline state, so the permutations can be compiled after the caller's create info went out of scope
+		struct PipelineState
+		{
+			std::vector<VkPipelineShaderStageCreateInfo> stages;
+			std::vector<VkSpecializationInfo> specializationInfos;
+			std::vector<std::vector<VkSpecializationMapEntry>> mapEntries;
+			std::vector<std::vector<uint8_t>> specializationData;
+			VkPipelineVertexInputStateCreateInfo vertexInputState{};
+			std::vector<VkVertexInputBindingDescription> vertexBindings;
+			std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+			VkPipelineTessellationStateCreateInfo tessellationState{};
+			VkPipelineViewportStateCreateInfo viewportState{};
+			std::vector<VkViewport> viewports;
+			std::vector<VkRect2D> scissors;
+			VkPipelineRasterizationStateCreateInfo rasterizationState{};
+			VkPipelineMultisampleStateCreateInfo multisampleState{};
+			VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+			VkPipelineColorBlendStateCreateInfo colorBlendState{};
+			std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+			VkPipelineDynamicStateCreateInfo dynamicState{};
+			std::vector<VkDynamicState> dynamicStates;
+			VkGraphicsPipelineCreateInfo createInfo{};
+		};
+
+		struct Permutation
+		{
+			std::vector<VkPipelineShaderStageCreateInfo> stages;
+			std::vector<VkSpecializationInfo> specializationInfos;
+			std::vector<std::vector<VkSpecializationMapEntry>> mapEntries;
+			std::vector<std::vector<uint8_t>> specializationData;
+			VkGraphicsPipelineCreateInfo createInfo{};
+			std::shared_future<VkPipeline> future;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		vks::PipelineCompiler* compiler = nullptr;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		uint32_t specializedConstantID = 0;
+		uint32_t firstFeatureConstantID = 0;
+		uint32_t featureCount = 0;
+		VkShaderStageFlags specializedStages = 0;
+		std::unique_ptr<PipelineState> state;
+		std::unordered_map<uint32_t, std::unique_ptr<Permutation>> permutations;
+		VkPipeline genericPipeline = VK_NULL_HANDLE;
+
+		void copyState(const VkGraphicsPipelineCreateInfo& createInfo);
+		void queuePermutation(uint32_t features);
+
+	public:
+		~PipelinePermutations();
+		void setup(VkDevice device, vks::PipelineCompiler* compiler, VkPipelineCache pipelineCache, uint32_t specializedConstantID, uint32_t firstFeatureConstantID, uint32_t featureCount);
+		void prepare(const VkGraphicsPipelineCreateInfo& createInfo, VkShaderStageFlags specializedStages);
+		void destroy();
+		VkPipeline get(uint32_t features);
+		bool isSpecialized(uint32_t features) const;
+		bool update();
+		/** @brief Pipeline without feature specialization, branches on the features at runtime */
+		VkPipeline generic() const { return genericPipeline; }
+		/** @brief Number of specialized pipelines that have finished compiling */
+		uint32_t specializedCount() const;
+		/** @brief Number of specialized pipelines still being compiled */
+		uint32_t pendingCount() const;
+	};
+}
@@ -0,0 +1,383 @@
+/*
+* Vulkan GPU and CPU frame profilers
+*
+* Measures the GPU time of named scopes inside command buffers using timestamp queries, and the CPU time of the phases of the frame loop
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanProfiler.h"
+#include "VulkanDebug.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	GpuProfiler::~GpuProfiler()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the profiler for a device, query pools are created once a slot is used for the first time
+	*
+	* @param device Device to profile
+	* @param maxScopes (Optional) Maximum number of scopes per slot (Defaults to 32)
+	*/
+	void GpuProfiler::setup(vks::VulkanDevice* device, uint32_t maxScopes)
+	{
+		this->device = device;
+		this->maxScopes = maxScopes;
+		// Timestamps are only supported if the queue family reports valid bits for them
+		const uint32_t validBits = device->queueFamilyProperties[device->queueFamilyIndices.graphics].timestampValidBits;
+		timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+		if (!device->properties.limits.timestampComputeAndGraphics) {
+			timestampMask = 0;
+		}
+		timestampPeriod = device->properties.limits.timestampPeriod;
+		pipelineStatistics = false;
+	}
+
+	/** @brief Release all query pools */
+	void GpuProfiler::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto& entry : commandBuffers) {
+			vkDestroyQueryPool(device->logicalDevice, entry.second.queryPool, nullptr);
+			if (entry.second.statisticsPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, entry.second.statisticsPool, nullptr);
+			}
+		}
+		commandBuffers.clear();
+		timings.clear();
+		device = nullptr;
+	}
+
+	/** @brief Returns true if the device supports timestamp queries on the graphics queue */
+	bool GpuProfiler::supported() const
+	{
+		return (device != nullptr) && (timestampMask != 0);
+	}
+
+	/**
+	* Count the vertices, primitives and shader invocations of top level scopes with pipeline statistics queries
+	*
+	* @return True if the pipelineStatisticsQuery feature has been enabled on the device (and timestamps are supported)
+	*
+	* @note Pipeline statistics queries can't be nested, so nested scopes aren't counted and the command buffer must not have other pipeline statistics queries active while a top level scope is open
+	*/
+	bool GpuProfiler::enablePipelineStatistics()
+	{
+		pipelineStatistics = supported() && device->enabledFeatures.pipelineStatisticsQuery;
+		return pipelineStatistics;
+	}
+
+	bool GpuProfiler::pipelineStatisticsEnabled() const
+	{
+		return pipelineStatistics;
+	}
+
+	const char* GpuProfiler::pipelineStatisticName(PipelineStatistic statistic)
+	{
+		static const char* names[PipelineStatisticCount] = { "vertices", "primitives", "vertexinvocations", "clippedprimitives", "fragmentinvocations", "computeinvocations" };
+		return (statistic < PipelineStatisticCount) ? names[statistic] : "";
+	}
+
+	GpuProfiler::CommandBufferQueries* GpuProfiler::getQueries(VkCommandBuffer commandBuffer)
+	{
+		auto entry = commandBuffers.find(commandBuffer);
+		return (entry != commandBuffers.end()) ? &entry->second : nullptr;
+	}
+
+	/**
+	* Start profiling a command buffer, must be recorded outside of a render pass before any scopes (e.g. right after vkBeginCommandBuffer)
+	*
+	* @param commandBuffer Command buffer being recorded
+	*/
+	void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer)
+	{
+		if (!supported()) {
+			return;
+		}
+		CommandBufferQueries& queries = commandBuffers[commandBuffer];
+		if (queries.queryPool == VK_NULL_HANDLE) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = maxScopes * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queries.queryPool));
+		}
+		if (pipelineStatistics && (queries.statisticsPool == VK_NULL_HANDLE)) {
+			// The results are returned in the order of the flag bits, which matches PipelineStatistic
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.pipelineStatistics =
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+				VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+			queryPoolInfo.queryCount = maxScopes;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queries.statisticsPool));
+		}
+		queries.scopes.clear();
+		queries.openScopes.clear();
+		queries.submitted = false;
+		vkCmdResetQueryPool(commandBuffer, queries.queryPool, 0, maxScopes * 2);
+		if (queries.statisticsPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, queries.statisticsPool, 0, maxScopes);
+		}
+	}
+
+	/**
+	* Open a named scope, scopes can be nested
+	*
+	* @param commandBuffer Command buffer passed to beginFrame
+	* @param name Name the timing of the scope is reported with
+	* @param stage (Optional) Pipeline stage the start timestamp is written at (Defaults to VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+	*/
+	void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name, VkPipelineStageFlagBits stage)
+	{
+		// Labeled even if the scope can't be timed, so capture tools see every scope
+		vks::debugutils::cmdBeginLabel(commandBuffer, name.c_str());
+		CommandBufferQueries* queries = getQueries(commandBuffer);
+		if (!queries || (queries->scopes.size() >= maxScopes)) {
+			return;
+		}
+		const uint32_t index = static_cast<uint32_t>(queries->scopes.size());
+		const bool statistics = pipelineStatistics && queries->openScopes.empty() && (queries->statisticsPool != VK_NULL_HANDLE);
+		queries->scopes.push_back({ name, static_cast<uint32_t>(queries->openScopes.size()), statistics });
+		queries->openScopes.push_back(index);
+		vkCmdWriteTimestamp(commandBuffer, stage, queries->queryPool, index * 2);
+		if (statistics) {
+			vkCmdBeginQuery(commandBuffer, queries->statisticsPool, index, 0);
+		}
+	}
+
+	/**
+	* Close the most recently opened scope
+	*
+	* @param commandBuffer Command buffer passed to beginFrame
+	* @param stage (Optional) Pipeline stage the end timestamp is written at (Defaults to VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+	*/
+	void GpuProfiler::endScope(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage)
+	{
+		vks::debugutils::cmdEndLabel(commandBuffer);
+		CommandBufferQueries* queries = getQueries(commandBuffer);
+		if (!queries || queries->openScopes.empty()) {
+			return;
+		}
+		const uint32_t index = queries->openScopes.back();
+		queries->openScopes.pop_back();
+		if (queries->scopes[index].statistics) {
+			vkCmdEndQuery(commandBuffer, queries->statisticsPool, index);
+		}
+		vkCmdWriteTimestamp(commandBuffer, stage, queries->queryPool, index * 2 + 1);
+	}
+
+	/** @brief Mark a profiled command buffer as submitted, so its results can be collected once it has finished executing */
+	void GpuProfiler::frameSubmitted(VkCommandBuffer commandBuffer)
+	{
+		CommandBufferQueries* queries = getQueries(commandBuffer);
+		if (queries) {
+			queries->submitted = true;
+			queries->submitTime = TraceRecorder::Clock::now();
+		}
+	}
+
+	/**
+	* Read back the results of a command buffer's last submission without waiting
+	*
+	* @param commandBuffer Profiled command buffer
+	*
+	* @return True if the results were available and the timings have been updated
+	*
+	* @note Should be called once the command buffer has finished executing and before it is submitted again
+	*/
+	bool GpuProfiler::collect(VkCommandBuffer commandBuffer)
+	{
+		CommandBufferQueries* queries = getQueries(commandBuffer);
+		if (!queries || !queries->submitted || queries->scopes.empty()) {
+			return false;
+		}
+		const uint32_t queryCount = static_cast<uint32_t>(queries->scopes.size()) * 2;
+		// Each query returns the timestamp followed by its availability
+		std::vector<uint64_t> results(queryCount * 2);
+		VkResult result = vkGetQueryPoolResults(device->logicalDevice, queries->queryPool, 0, queryCount, results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+			VK_CHECK_RESULT(result);
+		}
+		// Pipeline statistics of all scopes (only top level scopes have them), each followed by its availability
+		const uint32_t statisticsStride = PipelineStatisticCount + 1;
+		std::vector<uint64_t> statistics;
+		if (queries->statisticsPool != VK_NULL_HANDLE) {
+			const uint32_t scopeCount = static_cast<uint32_t>(queries->scopes.size());
+			statistics.resize(scopeCount * statisticsStride);
+			result = vkGetQueryPoolResults(device->logicalDevice, queries->statisticsPool, 0, scopeCount, statistics.size() * sizeof(uint64_t), statistics.data(), statisticsStride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+				VK_CHECK_RESULT(result);
+			}
+		}
+		bool updated = false;
+		TraceRecorder& traceRecorder = TraceRecorder::get();
+		for (size_t i = 0; i < queries->scopes.size(); i++) {
+			const uint64_t* begin = &results[i * 4];
+			const uint64_t* end = &results[i * 4 + 2];
+			// Skip scopes that haven't been closed or whose results aren't available (yet)
+			if ((begin[1] == 0) || (end[1] == 0)) {
+				continue;
+			}
+			const uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+			const uint64_t* scopeStatistics = nullptr;
+			if (queries->scopes[i].statistics && (statistics[i * statisticsStride + PipelineStatisticCount] != 0)) {
+				scopeStatistics = &statistics[i * statisticsStride];
+			}
+			setTiming(queries->scopes[i].name, queries->scopes[i].depth, static_cast<double>(ticks) * timestampPeriod / 1000000.0, scopeStatistics, begin[0] & timestampMask, end[0] & timestampMask);
+			if (traceRecorder.active()) {
+				traceRecorder.addGpuScope(queries->scopes[i].name, queries->scopes[i].depth, begin[0] & timestampMask, end[0] & timestampMask, queries->submitTime);
+			}
+			updated = true;
+		}
+		queries->submitted = false;
+		return updated;
+	}
+
+	/** @brief Release the queries of a command buffer that is about to be freed */
+	void GpuProfiler::release(VkCommandBuffer commandBuffer)
+	{
+		if (!device) {
+			return;
+		}
+		CommandBufferQueries* queries = getQueries(commandBuffer);
+		if (queries) {
+			vkDestroyQueryPool(device->logicalDevice, queries->queryPool, nullptr);
+			if (queries->statisticsPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device->logicalDevice, queries->statisticsPool, nullptr);
+			}
+			commandBuffers.erase(commandBuffer);
+		}
+	}
+
+	/**
+	* Report the time two scopes (e.g. recorded into command buffers submitted to different queues) have been executing at the same time as a timing of its own
+	*
+	* @param name Name the overlap is reported with
+	* @param a Name of the first scope
+	* @param b Name of the second scope
+	*
+	* @return Overlap of the latest timings of both scopes in milliseconds, 0 if they don't overlap or haven't been timed yet
+	*
+	* @note Both scopes should have been collected for the same frame, timestamps of all queues of a device are taken from the same clock
+	*/
+	double GpuProfiler::measureOverlap(const std::string& name, const std::string& a, const std::string& b)
+	{
+		const Timing* timingA = nullptr;
+		const Timing* timingB = nullptr;
+		for (auto& timing : timings) {
+			if (timing.name == a) {
+				timingA = &timing;
+			}
+			if (timing.name == b) {
+				timingB = &timing;
+			}
+		}
+		if (!timingA || !timingB) {
+			return 0.0;
+		}
+		const uint64_t begin = std::max(timingA->begin, timingB->begin);
+		const uint64_t end = std::min(timingA->end, timingB->end);
+		const double ms = (end > begin) ? static_cast<double>(end - begin) * timestampPeriod / 1000000.0 : 0.0;
+		setTiming(name, 0, ms, nullptr, 0, 0);
+		return ms;
+	}
+
+	void GpuProfiler::setTiming(const std::string& name, uint32_t depth, double ms, const uint64_t* statistics, uint64_t begin, uint64_t end)
+	{
+		Timing* timing = nullptr;
+		for (auto& existing : timings) {
+			if (existing.name == name) {
+				timing = &existing;
+				break;
+			}
+		}
+		if (!timing) {
+			timings.push_back({ name, depth, ms, false, {}, 0, 0 });
+			timing = &timings.back();
+		}
+		timing->depth = depth;
+		timing->ms = ms;
+		timing->hasStatistics = (statistics != nullptr);
+		timing->begin = begin;
+		timing->end = end;
+		if (statistics) {
+			std::copy(statistics, statistics + PipelineStatisticCount, timing->statistics.begin());
+		}
+	}
+
+	const char* CpuFrameProfiler::phaseName(Phase phase)
+	{
+		static const char* names[PhaseCount] = { "Update", "Fence wait", "Acquire", "Record", "Submit", "Present", "UI" };
+		return (phase < PhaseCount) ? names[phase] : "";
+	}
+
+	/** @brief Complete the current frame (if any) and start a new one, time since the last lap is counted as an update */
+	void CpuFrameProfiler::beginFrame()
+	{
+		if (running) {
+			lap(Update);
+			// Replace the oldest frame of the ring
+			for (uint32_t i = 0; i < PhaseCount; i++) {
+				sums[i] += current[i] - frames[head][i];
+			}
+			frames[head] = current;
+			head = (head + 1) % ringSize;
+			frameCount = (frameCount < ringSize) ? frameCount + 1 : ringSize;
+		}
+		current.fill(0.0);
+		lastLap = Clock::now();
+		running = true;
+	}
+
+	/** @brief Add the time since the previous lap to a phase of the current frame */
+	void CpuFrameProfiler::lap(Phase phase)
+	{
+		if (!running) {
+			return;
+		}
+		const Clock::time_point now = Clock::now();
+		current[phase] += std::chrono::duration<double, std::milli>(now - lastLap).count();
+		TraceRecorder& traceRecorder = TraceRecorder::get();
+		if (traceRecorder.active()) {
+			traceRecorder.addCpuZone(phaseName(phase), lastLap, now);
+		}
+		lastLap = now;
+	}
+
+	/** @brief Average time (in ms) of a phase over the frames in the ring */
+	double CpuFrameProfiler::average(Phase phase) const
+	{
+		return (frameCount > 0) ? sums[phase] / static_cast<double>(frameCount) : 0.0;
+	}
+
+	/** @brief Average CPU time (in ms) of a frame over the frames in the ring */
+	double CpuFrameProfiler::averageTotal() const
+	{
+		double total = 0.0;
+		for (uint32_t i = 0; i < PhaseCount; i++) {
+			total += average(static_cast<Phase>(i));
+		}
+		return total;
+	}
+
+	/** @brief Time (in ms) of a phase in the last completed frame */
+	double CpuFrameProfiler::last(Phase phase) const
+	{
+		return (frameCount > 0) ? frames[(head + ringSize - 1) % ringSize][phase] : 0.0;
+	}
+}
@@ -0,0 +1,160 @@
+/*
+* Vulkan GPU and CPU frame profilers
+*
+* Measures the GPU time of named scopes inside command buffers using timestamp queries, and the CPU time of the phases of the frame loop
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <chrono>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanTraceRecorder.h"
+
+namespace vks
+{
+	/**
+	* @brief GPU profiler based on timestamp queries
+	*
+	* Each command buffer that is profiled gets its own query pool, so pre-recorded command buffers (e.g. one per swap chain image) can be resubmitted as is.
+	* A command buffer's results are read back without waiting once it has finished executing, so timings lag a few frames behind.
+	*
+	* Scopes are also labeled with VK_EXT_debug_utils (see vks::debugutils), so capture tools show the same breakdown
+	* Optionally top level scopes also count the work done on the GPU with pipeline statistics queries (see enablePipelineStatistics)
+	*
+	* @note Timing functions are no-ops if the device doesn't support timestamps on the graphics queue
+	*/
+	class GpuProfiler
+	{
+	public:
+		/** @brief Pipeline statistics counted for top level scopes, in the order of their query results */
+		enum PipelineStatistic
+		{
+			InputAssemblyVertices = 0,
+			InputAssemblyPrimitives,
+			VertexShaderInvocations,
+			ClippingPrimitives,
+			FragmentShaderInvocations,
+			ComputeShaderInvocations,
+			PipelineStatisticCount
+		};
+
+		/** @brief GPU time of a named scope in milliseconds */
+		struct Timing
+		{
+			std::string name;
+			/** @brief Nesting level of the scope */
+			uint32_t depth;
+			double ms;
+			/** @brief Set if the pipeline statistics of the scope have been counted */
+			bool hasStatistics;
+			std::array<uint64_t, PipelineStatisticCount> statistics;
+			/** @brief Device timestamps of the start and end of the scope, comparable between the graphics and compute queues (0 for derived timings) */
+			uint64_t begin;
+			uint64_t end;
+		};
+
+	private:
+		struct Scope
+		{
+			std::string name;
+			uint32_t depth;
+			bool statistics;
+		};
+		struct CommandBufferQueries
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			VkQueryPool statisticsPool = VK_NULL_HANDLE;
+			std::vector<Scope> scopes;
+			std::vector<uint32_t> openScopes;
+			bool submitted = false;
+			/** @brief Host time of the last submission, used to place the scopes on the trace timeline if timestamps aren't calibrated */
+			TraceRecorder::Clock::time_point submitTime;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		uint32_t maxScopes = 0;
+		uint64_t timestampMask = 0;
+		double timestampPeriod = 0.0;
+		bool pipelineStatistics = false;
+		std::unordered_map<VkCommandBuffer, CommandBufferQueries> commandBuffers;
+
+		CommandBufferQueries* getQueries(VkCommandBuffer commandBuffer);
+		void setTiming(const std::string& name, uint32_t depth, double ms, const uint64_t* statistics, uint64_t begin, uint64_t end);
+
+	public:
+		/** @brief Latest timings of all scopes, in the order they have been recorded */
+		std::vector<Timing> timings;
+
+		~GpuProfiler();
+		void setup(vks::VulkanDevice* device, uint32_t maxScopes = 32);
+		void destroy();
+		bool supported() const;
+		bool enablePipelineStatistics();
+		bool pipelineStatisticsEnabled() const;
+		static const char* pipelineStatisticName(PipelineStatistic statistic);
+		void beginFrame(VkCommandBuffer commandBuffer);
+		void beginScope(VkCommandBuffer commandBuffer, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void endScope(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		void frameSubmitted(VkCommandBuffer commandBuffer);
+		bool collect(VkCommandBuffer commandBuffer);
+		void release(VkCommandBuffer commandBuffer);
+		double measureOverlap(const std::string& name, const std::string& a, const std::string& b);
+	};
+
+	/**
+	* @brief CPU time breakdown of the frame loop
+	*
+	* The time since the previous call to lap() is added to the given phase, so all CPU time spent in the frame loop ends up in one of the phases.
+	* Completed frames are stored in a fixed size ring without any allocations or locks per frame, averages are kept up to date as frames are added.
+	*/
+	class CpuFrameProfiler
+	{
+	public:
+		enum Phase
+		{
+			/** @brief Application updates (e.g. uniform buffers) outside of the other phases */
+			Update = 0,
+			/** @brief Waiting for the frame's fences, including frame pacing delays */
+			FenceWait,
+			Acquire,
+			/** @brief Command buffer recording, examples submitting their own command buffers are counted here as well */
+			Record,
+			Submit,
+			Present,
+			UI,
+			PhaseCount
+		};
+		/** @brief Number of frames the averages are taken over */
+		static const uint32_t ringSize = 64;
+
+	private:
+		// Same clock as the trace recorder, so laps can be recorded as trace zones
+		typedef TraceRecorder::Clock Clock;
+		Clock::time_point lastLap;
+		bool running = false;
+		std::array<double, PhaseCount> current{};
+		std::array<std::array<double, PhaseCount>, ringSize> frames{};
+		std::array<double, PhaseCount> sums{};
+		uint32_t head = 0;
+		uint32_t frameCount = 0;
+
+	public:
+		static const char* phaseName(Phase phase);
+		void beginFrame();
+		void lap(Phase phase);
+		double average(Phase phase) const;
+		double averageTotal() const;
+		double last(Phase phase) const;
+	};
+}
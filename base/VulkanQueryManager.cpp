@@ -0,0 +1,197 @@
+/*
+* Vulkan query manager
+*
+* Occlusion and pipeline statistics queries whose results are copied to host visible buffers on the GPU and read back frames later without waiting
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanQueryManager.h"
+
+#include <cstring>
+
+namespace vks
+{
+	QueryManager::~QueryManager()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the query manager, the queries and result buffer of a slot are created once the slot is used for the first time
+	*
+	* @param device Device to create the query pools and buffers on
+	* @param queryType Type of the queries (VK_QUERY_TYPE_OCCLUSION or VK_QUERY_TYPE_PIPELINE_STATISTICS)
+	* @param queryCount Number of queries per slot
+	* @param (Optional) pipelineStatistics Statistics returned by pipeline statistics queries
+	* @param (Optional) resultUsage Additional usage flags for the result buffers if they are consumed on the GPU (e.g. VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT)
+	*/
+	void QueryManager::setup(vks::VulkanDevice* device, VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics, VkBufferUsageFlags resultUsage)
+	{
+		assert(queryCount > 0);
+		this->device = device;
+		this->queryType = queryType;
+		this->queryCount = queryCount;
+		this->pipelineStatistics = pipelineStatistics;
+		this->resultUsage = resultUsage;
+		valueCount = 1;
+		if (queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+		{
+			// Each enabled statistic is written as a separate value
+			valueCount = 0;
+			for (VkQueryPipelineStatisticFlags flags = pipelineStatistics; flags != 0; flags &= flags - 1) {
+				valueCount++;
+			}
+			assert(valueCount > 0);
+		}
+	}
+
+	/** @brief Release the query pools and result buffers of all slots */
+	void QueryManager::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto& slot : slots)
+		{
+			vkDestroyQueryPool(device->logicalDevice, slot.queryPool, nullptr);
+			slot.results.destroy();
+		}
+		slots.clear();
+		device = nullptr;
+	}
+
+	QueryManager::Slot& QueryManager::getSlot(uint32_t slot)
+	{
+		assert(device);
+		if (slot >= slots.size()) {
+			slots.resize(slot + 1);
+		}
+		Slot& querySlot = slots[slot];
+		if (querySlot.queryPool == VK_NULL_HANDLE)
+		{
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = queryType;
+			queryPoolInfo.queryCount = queryCount;
+			queryPoolInfo.pipelineStatistics = pipelineStatistics;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &querySlot.queryPool));
+			const VkDeviceSize size = resultStride() * queryCount;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | resultUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &querySlot.results, size));
+			VK_CHECK_RESULT(querySlot.results.map());
+			// Results read before the first copy has executed are reported as unavailable
+			memset(querySlot.results.mapped, 0, static_cast<size_t>(size));
+		}
+		return querySlot;
+	}
+
+	/**
+	* Reset the queries of a slot, must be recorded outside of a render pass before the slot's queries are used
+	*
+	* @param commandBuffer Command buffer being recorded
+	* @param slot Slot of the command buffer
+	*/
+	void QueryManager::reset(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		vkCmdResetQueryPool(commandBuffer, getSlot(slot).queryPool, 0, queryCount);
+	}
+
+	/** @brief Begin a query of a slot */
+	void QueryManager::beginQuery(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkQueryControlFlags flags)
+	{
+		assert(query < queryCount);
+		vkCmdBeginQuery(commandBuffer, getSlot(slot).queryPool, query, flags);
+	}
+
+	/** @brief End a query of a slot */
+	void QueryManager::endQuery(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query)
+	{
+		assert(query < queryCount);
+		vkCmdEndQuery(commandBuffer, getSlot(slot).queryPool, query);
+	}
+
+	/**
+	* Copy the results of a slot's queries to its result buffer, must be recorded outside of a render pass after all queries have ended
+	*
+	* @param commandBuffer Command buffer being recorded
+	* @param slot Slot of the command buffer
+	* @param (Optional) dstStageMask Stages that consume the results (Defaults to host reads by collect)
+	* @param (Optional) dstAccessMask Accesses that consume the results
+	*/
+	void QueryManager::copyResults(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		Slot& querySlot = getSlot(slot);
+		copyResults(commandBuffer, slot, querySlot.results.buffer, 0, resultStride(), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT, dstStageMask, dstAccessMask);
+	}
+
+	/**
+	* Copy the results of a slot's queries to a buffer of the caller, must be recorded outside of a render pass after all queries have ended
+	*
+	* @param commandBuffer Command buffer being recorded
+	* @param slot Slot of the command buffer
+	* @param dstBuffer Buffer to copy to, needs to be created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	* @param dstOffset Offset of the first query's results
+	* @param stride Distance between the results of two queries
+	* @param flags Result flags (e.g. no flags for 32 bit values that can be used as conditional rendering predicates)
+	* @param dstStageMask Stages that consume the results
+	* @param dstAccessMask Accesses that consume the results
+	*/
+	void QueryManager::copyResults(VkCommandBuffer commandBuffer, uint32_t slot, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize stride, VkQueryResultFlags flags, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		// The wait is done on the device, so the copy sees the results of the queries ended earlier in the command buffer
+		vkCmdCopyQueryPoolResults(commandBuffer, getSlot(slot).queryPool, 0, queryCount, dstBuffer, dstOffset, stride, flags | VK_QUERY_RESULT_WAIT_BIT);
+		VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	/**
+	* Read the results copied by a slot's last submission
+	*
+	* @param slot Slot to read
+	* @param results Receives valuesPerQuery() values for each query of the slot, only written if all queries are available
+	*
+	* @return True if the results of all queries were available
+	*
+	* @note Must only be called once the fence of the slot's last submission has been waited on and before the slot's command buffer is submitted again
+	*/
+	bool QueryManager::collect(uint32_t slot, uint64_t* results)
+	{
+		if ((slot >= slots.size()) || (slots[slot].queryPool == VK_NULL_HANDLE)) {
+			return false;
+		}
+		const uint64_t* data = static_cast<const uint64_t*>(slots[slot].results.mapped);
+		for (uint32_t i = 0; i < queryCount; i++) {
+			if (data[i * (valueCount + 1) + valueCount] == 0) {
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < queryCount; i++) {
+			memcpy(&results[i * valueCount], &data[i * (valueCount + 1)], valueCount * sizeof(uint64_t));
+		}
+		return true;
+	}
+
+	/**
+	* Get the location of a query's results for GPU side consumers
+	*
+	* @param slot Slot of the command buffer
+	* @param query Index of the query
+	*
+	* @return Buffer range of the query's values followed by its availability
+	*
+	* @note Conditional rendering reads the 32 bit value at the offset, i.e. the lower half of the first result (non-zero if any samples passed for an occlusion query)
+	*/
+	VkDescriptorBufferInfo QueryManager::resultDescriptor(uint32_t slot, uint32_t query)
+	{
+		assert(query < queryCount);
+		Slot& querySlot = getSlot(slot);
+		return { querySlot.results.buffer, resultStride() * query, resultStride() };
+	}
+}
@@ -0,0 +1,75 @@
+/*
+* Vulkan query manager
+*
+* Occlusion and pipeline statistics queries whose results are copied to host visible buffers on the GPU and read back frames later without waiting
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Query slots with asynchronous readback
+	*
+	* Each slot has its own queries and result buffer, so every command buffer that may be in flight at the same time needs its own slot
+	* (the swap chain image index for pre-recorded command buffers, the frame in flight for dynamic command buffers).
+	* copyResults records vkCmdCopyQueryPoolResults into the command buffer, so the results (including their availability) end up in the
+	* slot's host visible buffer as part of the frame. collect reads that buffer the next time the slot is used, i.e. once the fence of the
+	* slot's last submission has been waited on, so reading never stalls and never returns results of a frame that is still in flight.
+	*
+	* The result buffer can also be consumed on the GPU (e.g. as the predicate of conditional rendering, see resultDescriptor), or the results
+	* can be copied to a buffer of the caller that's shared by all slots, so the next frame on the queue uses them regardless of its slot.
+	*
+	* @note Results lag behind by the number of slots in use
+	* @note All queries of a slot must be used between reset and copy, as the copy waits for them on the device
+	*/
+	class QueryManager
+	{
+	private:
+		struct Slot
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			vks::Buffer results;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkQueryType queryType = VK_QUERY_TYPE_OCCLUSION;
+		VkQueryPipelineStatisticFlags pipelineStatistics = 0;
+		VkBufferUsageFlags resultUsage = 0;
+		uint32_t queryCount = 0;
+		uint32_t valueCount = 1;
+		std::vector<Slot> slots;
+
+		Slot& getSlot(uint32_t slot);
+
+	public:
+		~QueryManager();
+		void setup(vks::VulkanDevice* device, VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0, VkBufferUsageFlags resultUsage = 0);
+		void destroy();
+		/** @brief Returns true if setup has been called */
+		bool isReady() const { return device != nullptr; }
+		/** @brief Number of 64 bit values each query returns (one per enabled statistic for pipeline statistics queries) */
+		uint32_t valuesPerQuery() const { return valueCount; }
+		/** @brief Size of a query's results in the result buffer, the values are followed by the query's availability */
+		VkDeviceSize resultStride() const { return (valueCount + 1) * sizeof(uint64_t); }
+		void reset(VkCommandBuffer commandBuffer, uint32_t slot);
+		void beginQuery(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkQueryControlFlags flags = 0);
+		void endQuery(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query);
+		void copyResults(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_HOST_BIT, VkAccessFlags dstAccessMask = VK_ACCESS_HOST_READ_BIT);
+		void copyResults(VkCommandBuffer commandBuffer, uint32_t slot, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize stride, VkQueryResultFlags flags, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+		bool collect(uint32_t slot, uint64_t* results);
+		VkDescriptorBufferInfo resultDescriptor(uint32_t slot, uint32_t query);
+	};
+}
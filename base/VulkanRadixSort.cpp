@@ -0,0 +1,174 @@
+/*
+* Vulkan GPU radix sort
+*
+* Sorts key/value pairs on the GPU with a least significant digit radix sort, ranking the keys of a block with subgroup ballots
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRadixSort.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+#include <vector>
+
+namespace vks
+{
+	// Number of distinct values of a digit, i.e. sorting by 8 bits per pass
+	static const uint32_t radix = 256;
+
+	RadixSort::~RadixSort()
+	{
+		destroy();
+	}
+
+	/** @brief Returns true if the device supports the subgroup operations used by the sort in compute shaders */
+	bool RadixSort::supported(vks::VulkanDevice* device)
+	{
+		// The shaders size their shared memory for subgroups of at least 4 invocations
+		return device->getComputeSubgroupSize(VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) >= 4;
+	}
+
+	/**
+	* Create the pipelines and the internal buffers for sorting the given buffers
+	*
+	* @param device Device to sort on, the instance needs to have been created for Vulkan 1.1 or later
+	* @param maxCount Maximum number of keys to sort
+	* @param keys Storage buffer with the keys (at least maxCount uints), contains the sorted keys after the sort
+	* @param values Storage buffer with the values (at least maxCount uints), contains the values in the order of the sorted keys after the sort
+	* @param countBuffer Storage buffer the number of keys is read from when the sort is executed (see record)
+	* @param shaderStages Stages for the count, scan and scatter compute shaders (base/radixsort_count.comp, base/radixsort_scan.comp and base/radixsort_scatter.comp)
+	* @param pipelineCache Pipeline cache to use for creating the pipelines
+	*/
+	void RadixSort::prepare(vks::VulkanDevice* device, uint32_t maxCount, vks::Buffer& keys, vks::Buffer& values, vks::Buffer& countBuffer, const std::array<VkPipelineShaderStageCreateInfo, 3>& shaderStages, VkPipelineCache pipelineCache)
+	{
+		assert(countPipeline == VK_NULL_HANDLE);
+		this->device = device;
+		this->maxCount = maxCount;
+		groupCount = (maxCount + blockSize - 1) / blockSize;
+
+		const VkDeviceSize pairSize = static_cast<VkDeviceSize>(maxCount) * sizeof(uint32_t);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tempKeys, pairSize));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tempValues, pairSize));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &histogram, static_cast<VkDeviceSize>(groupCount) * radix * sizeof(uint32_t)));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Keys read by a pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Values read by a pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Keys written by a pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Values written by a pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Digit counts and offsets per block
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Number of keys
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = { vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12) };
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		const std::array<vks::Buffer*, 2> keyBuffers = { &keys, &tempKeys };
+		const std::array<vks::Buffer*, 2> valueBuffers = { &values, &tempValues };
+		for (uint32_t i = 0; i < 2; i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSets[i]));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &keyBuffers[i]->descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &valueBuffers[i]->descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &keyBuffers[1 - i]->descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &valueBuffers[1 - i]->descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &histogram.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &countBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = shaderStages[0];
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &countPipeline));
+		pipelineCI.stage = shaderStages[1];
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &scanPipeline));
+		pipelineCI.stage = shaderStages[2];
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &scatterPipeline));
+	}
+
+	/** @brief Release all Vulkan resources, command buffers with recorded sorts must have finished executing */
+	void RadixSort::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, countPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, scanPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, scatterPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		tempKeys.destroy();
+		tempValues.destroy();
+		histogram.destroy();
+		countPipeline = VK_NULL_HANDLE;
+		scanPipeline = VK_NULL_HANDLE;
+		scatterPipeline = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/**
+	* Record the sort of the keys and values into a command buffer (outside of a render pass)
+	*
+	* @param commandBuffer Command buffer to record the dispatches to, writes to the keys, values and the count have to be made visible to compute shader reads before
+	* @param countOffset Offset of the number of keys in the count buffer in uints, the count is clamped to the maximum number of keys
+	* @param keyBits (Optional) Number of low bits of the keys to sort by, 16 or 32 (Defaults to 32), keys with fewer significant bits need half the passes
+	*
+	* @note The caller has to add a barrier between the last scatter (compute shader writes) and any use of the sorted keys and values
+	*/
+	void RadixSort::record(VkCommandBuffer commandBuffer, uint32_t countOffset, uint32_t keyBits)
+	{
+		assert((keyBits == 16) || (keyBits == 32));
+		const uint32_t passCount = keyBits / 8;
+
+		PushConstants pushConstants;
+		pushConstants.groupCount = groupCount;
+		pushConstants.countOffset = countOffset;
+		pushConstants.maxCount = maxCount;
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		for (uint32_t pass = 0; pass < passCount; pass++) {
+			pushConstants.shift = pass * 8;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[pass % 2], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, countPipeline);
+			vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scanPipeline);
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scatterPipeline);
+			vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+			// The next pass reads the scattered pairs and overwrites the digit counts
+			if (pass < passCount - 1) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+	}
+}
@@ -0,0 +1,73 @@
+/*
+* Vulkan GPU radix sort
+*
+* Sorts key/value pairs on the GPU with a least significant digit radix sort, ranking the keys of a block with subgroup ballots
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Compute shader radix sort of 32 bit keys with 32 bit values (e.g. indices)
+	*
+	* Each pass sorts by 8 bits of the keys with three dispatches: Every workgroup counts the digits of its block of keys (count), a single workgroup turns the counts
+	* into the offsets each block writes its digits to (scan) and every workgroup then scatters its keys and values to these offsets (scatter). Keys are ranked within
+	* their block with subgroup ballots instead of shared memory atomics, which keeps the sort stable as required for the passes to build on each other.
+	* The number of keys is read from a buffer when the sort is executed, so it can be the output of an earlier dispatch (e.g. the alive count of a particle system)
+	* and is never read back, the dispatches are sized for the maximum number of keys and blocks beyond the actual count only write empty counts.
+	*
+	* Passes ping-pong between the passed buffers and internal ones, an even number of passes (16 or 32 key bits) leaves the sorted pairs in the passed buffers.
+	*
+	* @note Requires Vulkan 1.1 with basic, ballot and arithmetic subgroup operations in compute shaders (see supported)
+	*/
+	class RadixSort
+	{
+	private:
+		struct PushConstants
+		{
+			uint32_t shift;
+			uint32_t groupCount;
+			uint32_t countOffset;
+			uint32_t maxCount;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkPipeline countPipeline = VK_NULL_HANDLE;
+		VkPipeline scanPipeline = VK_NULL_HANDLE;
+		VkPipeline scatterPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		// Set 0 sorts from the passed buffers into the internal ones, set 1 back
+		std::array<VkDescriptorSet, 2> descriptorSets{};
+		vks::Buffer tempKeys;
+		vks::Buffer tempValues;
+		// Digit counts and offsets per block
+		vks::Buffer histogram;
+		uint32_t maxCount = 0;
+		uint32_t groupCount = 0;
+
+	public:
+		/** @brief Number of keys sorted by a workgroup */
+		static const uint32_t blockSize = 1024;
+
+		~RadixSort();
+		static bool supported(vks::VulkanDevice* device);
+		void prepare(vks::VulkanDevice* device, uint32_t maxCount, vks::Buffer& keys, vks::Buffer& values, vks::Buffer& countBuffer, const std::array<VkPipelineShaderStageCreateInfo, 3>& shaderStages, VkPipelineCache pipelineCache);
+		void destroy();
+		void record(VkCommandBuffer commandBuffer, uint32_t countOffset, uint32_t keyBits = 32);
+	};
+}
@@ -0,0 +1,262 @@
+/*
+* Vulkan ray query shadows
+*
+* Acceleration structures for tracing shadow rays with ray queries from the lighting pass of rasterized glTF scenes
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRayQueryShadows.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	RayQueryShadows::~RayQueryShadows()
+	{
+		destroy();
+	}
+
+	VkDeviceAddress RayQueryShadows::getBufferDeviceAddress(VkBuffer buffer)
+	{
+		VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+		bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		bufferDeviceAddressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddressKHR(device->logicalDevice, &bufferDeviceAddressInfo);
+	}
+
+	/**
+	* Get the build sizes for the given geometries and create an acceleration structure large enough to hold them
+	*
+	* @param scratchSize Set to the scratch size required to build the acceleration structure
+	*/
+	void RayQueryShadows::createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const uint32_t* maxPrimitiveCounts, VkDeviceSize& scratchSize)
+	{
+		VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device->logicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, maxPrimitiveCounts, &buildSizesInfo);
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&accelerationStructure.buffer,
+			buildSizesInfo.accelerationStructureSize));
+
+		VkAccelerationStructureCreateInfoKHR accelerationStructureCI{};
+		accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		accelerationStructureCI.buffer = accelerationStructure.buffer.buffer;
+		accelerationStructureCI.size = buildSizesInfo.accelerationStructureSize;
+		accelerationStructureCI.type = type;
+		VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device->logicalDevice, &accelerationStructureCI, nullptr, &accelerationStructure.handle));
+
+		VkAccelerationStructureDeviceAddressInfoKHR accelerationStructureDeviceAddressInfo{};
+		accelerationStructureDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		accelerationStructureDeviceAddressInfo.accelerationStructure = accelerationStructure.handle;
+		accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device->logicalDevice, &accelerationStructureDeviceAddressInfo);
+
+		buildInfo.dstAccelerationStructure = accelerationStructure.handle;
+		scratchSize = buildSizesInfo.buildScratchSize;
+	}
+
+	void RayQueryShadows::destroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+	{
+		if (accelerationStructure.handle != VK_NULL_HANDLE) {
+			vkDestroyAccelerationStructureKHR(device->logicalDevice, accelerationStructure.handle, nullptr);
+			accelerationStructure.handle = VK_NULL_HANDLE;
+		}
+		accelerationStructure.buffer.destroy();
+		accelerationStructure.buffer = vks::Buffer();
+		accelerationStructure.deviceAddress = 0;
+	}
+
+	/**
+	* Build an acceleration structure on the device with a temporary scratch buffer and wait for the build to finish
+	*/
+	void RayQueryShadows::build(VkQueue queue, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const VkAccelerationStructureBuildRangeInfoKHR* buildRanges, VkDeviceSize scratchSize)
+	{
+		// The buffer's device address may not be aligned to the scratch offset alignment, so the start is moved up if required
+		vks::Buffer scratchBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scratchBuffer, scratchSize + scratchAlignment));
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildInfo.scratchData.deviceAddress = (getBufferDeviceAddress(scratchBuffer.buffer) + scratchAlignment - 1) & ~(scratchAlignment - 1);
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &buildRanges);
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		scratchBuffer.destroy();
+	}
+
+	/**
+	* Build the acceleration structures for a model
+	*
+	* @param device Device created with ray queries enabled (see VulkanExampleBase::rayQueriesSupported)
+	* @param queue Queue used for building the acceleration structures, the function waits for the builds to finish
+	* @param model Model with world space vertices, loaded with bufferUsageFlags added to vkglTF::memoryPropertyFlags
+	* @param transforms World space transforms of the model's instances in the scene
+	*/
+	void RayQueryShadows::create(vks::VulkanDevice* device, VkQueue queue, vkglTF::Model& model, const std::vector<glm::mat4>& transforms)
+	{
+		assert(vkglTF::memoryPropertyFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+		destroy();
+		this->device = device;
+
+		vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetBufferDeviceAddressKHR"));
+		vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCreateAccelerationStructureKHR"));
+		vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkDestroyAccelerationStructureKHR"));
+		vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureBuildSizesKHR"));
+		vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureDeviceAddressKHR"));
+		vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdBuildAccelerationStructuresKHR"));
+
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+		accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &accelerationStructureProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+		scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+		/*
+			Bottom level acceleration structure with one opaque geometry per primitive
+			Only full detail indices are used, shadow rays should hit the same surfaces regardless of the level of detail drawn
+		*/
+		VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+		VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+		VkDeviceSize positionOffset = 0;
+		VkFormat positionFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		if (model.vertexLayout.compact) {
+			// Quantized positions need to be in a format supported for acceleration structure builds (VK_FORMAT_FEATURE_ACCELERATION_STRUCTURE_VERTEX_BUFFER_BIT_KHR)
+			positionOffset = model.vertexLayout.offsets[static_cast<uint32_t>(vkglTF::VertexComponent::Position)];
+			positionFormat = model.vertexLayout.formats[static_cast<uint32_t>(vkglTF::VertexComponent::Position)];
+		}
+		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.vertices.buffer) + positionOffset;
+		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.indices.buffer);
+
+		std::vector<VkAccelerationStructureGeometryKHR> geometries;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+		std::vector<uint32_t> maxPrimitiveCounts;
+		for (vkglTF::Node* node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+				geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+				geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+				geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+				geometry.geometry.triangles.vertexFormat = positionFormat;
+				geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+				geometry.geometry.triangles.vertexStride = model.vertexLayout.stride;
+				// Indices are relative to the start of the model's vertex buffer
+				geometry.geometry.triangles.maxVertex = primitive->firstVertex + primitive->vertexCount - 1;
+				geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+				geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+				geometries.push_back(geometry);
+
+				VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+				buildRange.primitiveCount = primitive->indexCount / 3;
+				buildRange.primitiveOffset = primitive->firstIndex * sizeof(uint32_t);
+				buildRanges.push_back(buildRange);
+				maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+			}
+		}
+		if (geometries.empty() || transforms.empty()) {
+			return;
+		}
+
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		buildInfo.geometryCount = static_cast<uint32_t>(geometries.size());
+		buildInfo.pGeometries = geometries.data();
+		VkDeviceSize scratchSize = 0;
+		createAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildInfo, maxPrimitiveCounts.data(), scratchSize);
+		build(queue, buildInfo, buildRanges.data(), scratchSize);
+
+		/*
+			Top level acceleration structure with one instance per transform
+		*/
+		std::vector<VkAccelerationStructureInstanceKHR> instances(transforms.size());
+		for (size_t i = 0; i < transforms.size(); i++) {
+			VkAccelerationStructureInstanceKHR& instance = instances[i];
+			// The instance transform is a row major 3x4 matrix
+			for (uint32_t row = 0; row < 3; row++) {
+				for (uint32_t column = 0; column < 4; column++) {
+					instance.transform.matrix[row][column] = transforms[i][column][row];
+				}
+			}
+			instance.instanceCustomIndex = static_cast<uint32_t>(i);
+			instance.mask = 0xFF;
+			// Shadow rays only need to know if anything is hit, so both sides of the triangles block the light
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
+		}
+		vks::Buffer instancesBuffer;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instancesBuffer,
+			instances.size() * sizeof(VkAccelerationStructureInstanceKHR),
+			instances.data()));
+
+		VkAccelerationStructureGeometryKHR instancesGeometry = vks::initializers::accelerationStructureGeometryKHR();
+		instancesGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		instancesGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		instancesGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		instancesGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		instancesGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+		buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries = &instancesGeometry;
+		const uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+		createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildInfo, &instanceCount, scratchSize);
+		VkAccelerationStructureBuildRangeInfoKHR instancesBuildRange{};
+		instancesBuildRange.primitiveCount = instanceCount;
+		build(queue, buildInfo, &instancesBuildRange, scratchSize);
+
+		instancesBuffer.destroy();
+	}
+
+	void RayQueryShadows::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyAccelerationStructure(topLevelAS);
+		destroyAccelerationStructure(bottomLevelAS);
+	}
+
+	/**
+	* Returns a descriptor write for the top level acceleration structure
+	*
+	* @note The returned structure points to a member of this object, so the descriptor set needs to be updated before this is called again
+	*/
+	VkWriteDescriptorSet RayQueryShadows::writeDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding)
+	{
+		descriptor = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
+		descriptor.accelerationStructureCount = 1;
+		descriptor.pAccelerationStructures = &topLevelAS.handle;
+
+		VkWriteDescriptorSet writeDescriptorSet{};
+		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		// The specialized acceleration structure descriptor has to be chained
+		writeDescriptorSet.pNext = &descriptor;
+		writeDescriptorSet.dstSet = descriptorSet;
+		writeDescriptorSet.dstBinding = binding;
+		writeDescriptorSet.descriptorCount = 1;
+		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		return writeDescriptorSet;
+	}
+
+	VkDeviceSize RayQueryShadows::memorySize() const
+	{
+		return bottomLevelAS.buffer.size + topLevelAS.buffer.size;
+	}
+}
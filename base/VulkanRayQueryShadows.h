@@ -0,0 +1,84 @@
+/*
+* Vulkan ray query shadows
+*
+* Acceleration structures for tracing shadow rays with ray queries from the lighting pass of rasterized glTF scenes
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "VulkanglTFModel.h"
+
+namespace vks
+{
+	/**
+	* @brief Acceleration structures of a rasterized glTF scene for ray traced (hybrid) shadows
+	*
+	* Builds a single bottom level acceleration structure with one geometry per primitive from the model's vertex and index buffers
+	* and a top level acceleration structure with one instance of it per transform. The lighting pass then traces shadow rays with
+	* rayQueryEXT, either for every pixel or only for pixels in the penumbra of a low resolution shadow map (see Mode).
+	*
+	* @note Requires a device created with VulkanExampleBase::enableRayQueries, the model's buffers need to be created with bufferUsageFlags
+	* (added to vkglTF::memoryPropertyFlags before loading) and its vertices need to be in world space (FileLoadingFlags::PreTransformVertices)
+	*/
+	class RayQueryShadows
+	{
+	public:
+		/** @brief How shadows are resolved in the lighting pass */
+		enum Mode {
+			// Filtered shadow map only
+			MODE_SHADOW_MAP = 0,
+			// One shadow ray per pixel, no shadow map is rendered
+			MODE_RAY_QUERY = 1,
+			// Shadow rays are only traced for pixels the filtered low resolution shadow map reports as partially lit
+			MODE_HYBRID = 2
+		};
+
+		/** @brief Buffer usage flags required for building acceleration structures from a model's vertex and index buffers */
+		static const VkBufferUsageFlags bufferUsageFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+	private:
+		struct AccelerationStructure {
+			VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+			VkDeviceAddress deviceAddress = 0;
+			vks::Buffer buffer;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR = nullptr;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR = nullptr;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+		VkDeviceSize scratchAlignment = 1;
+
+		AccelerationStructure bottomLevelAS;
+		AccelerationStructure topLevelAS;
+		/** @brief Chained into the descriptor write returned by writeDescriptorSet, needs to stay valid until the descriptor set has been updated */
+		VkWriteDescriptorSetAccelerationStructureKHR descriptor{};
+
+		VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer);
+		void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const uint32_t* maxPrimitiveCounts, VkDeviceSize& scratchSize);
+		void destroyAccelerationStructure(AccelerationStructure& accelerationStructure);
+		void build(VkQueue queue, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const VkAccelerationStructureBuildRangeInfoKHR* buildRanges, VkDeviceSize scratchSize);
+
+	public:
+		~RayQueryShadows();
+		void create(vks::VulkanDevice* device, VkQueue queue, vkglTF::Model& model, const std::vector<glm::mat4>& transforms = { glm::mat4(1.0f) });
+		void destroy();
+		VkWriteDescriptorSet writeDescriptorSet(VkDescriptorSet descriptorSet, uint32_t binding);
+		/** @brief Device memory used by the acceleration structures */
+		VkDeviceSize memorySize() const;
+	};
+}
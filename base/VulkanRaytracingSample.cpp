@@ -7,6 +7,7 @@
 */
 
 #include "VulkanRaytracingSample.h"
+#include "threadpool.hpp"
 
 void VulkanRaytracingSample::enableExtensions()
 {
@@ -27,6 +28,31 @@ void VulkanRaytracingSample::enableExtensions()
 
 	// Required by VK_KHR_spirv_1_4
 	enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+
+	hostAccelerationStructureBuilds.requested = commandLineParser.isSet("hostasbuilds");
+}
+
+/*
+	Enables building acceleration structures on the host if requested and supported by the selected device
+	Needs to be called from getEnabledFeatures after setting up enabledAccelerationStructureFeatures
+*/
+void VulkanRaytracingSample::enableHostAccelerationStructureBuilds()
+{
+	if (!hostAccelerationStructureBuilds.requested) {
+		return;
+	}
+	VkPhysicalDeviceAccelerationStructureFeaturesKHR supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+	VkPhysicalDeviceFeatures2 deviceFeatures2{};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &supportedFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+	hostAccelerationStructureBuilds.supported = supportedFeatures.accelerationStructureHostCommands;
+	if (hostAccelerationStructureBuilds.supported) {
+		enabledAccelerationStructureFeatures.accelerationStructureHostCommands = VK_TRUE;
+	} else {
+		std::cout << "Host acceleration structure builds are not supported by the selected device, building on the device instead\n";
+	}
 }
 
 VulkanRaytracingSample::ScratchBuffer VulkanRaytracingSample::createScratchBuffer(VkDeviceSize size)
@@ -50,6 +76,7 @@ VulkanRaytracingSample::ScratchBuffer VulkanRaytracingSample::createScratchBuffe
 	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &scratchBuffer.memory));
 	VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, scratchBuffer.handle, scratchBuffer.memory, 0));
+	vulkanDevice->memoryAllocator.report.track(scratchBuffer.memory, 0, memoryRequirements.size, vks::MemoryCategory::RayTracing, "AS scratch buffer");
 	// Buffer device address
 	VkBufferDeviceAddressInfoKHR bufferDeviceAddresInfo{};
 	bufferDeviceAddresInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
@@ -61,6 +88,7 @@ VulkanRaytracingSample::ScratchBuffer VulkanRaytracingSample::createScratchBuffe
 void VulkanRaytracingSample::deleteScratchBuffer(ScratchBuffer& scratchBuffer)
 {
 	if (scratchBuffer.memory != VK_NULL_HANDLE) {
+		vulkanDevice->memoryAllocator.report.untrack(scratchBuffer.memory);
 		vkFreeMemory(vulkanDevice->logicalDevice, scratchBuffer.memory, nullptr);
 	}
 	if (scratchBuffer.handle != VK_NULL_HANDLE) {
@@ -68,7 +96,10 @@ void VulkanRaytracingSample::deleteScratchBuffer(ScratchBuffer& scratchBuffer)
 	}
 }
 
-void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo)
+/*
+	Structures built on the host need to be stored in host visible memory, pass VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT in memoryPropertyFlags for these
+*/
+void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo, VkMemoryPropertyFlags memoryPropertyFlags)
 {
 	// Buffer and memory
 	VkBufferCreateInfo bufferCreateInfo{};
@@ -85,9 +116,10 @@ void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure&
 	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
 	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
 	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
 	VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, accelerationStructure.buffer, accelerationStructure.memory, 0));
+	vulkanDevice->memoryAllocator.report.track(accelerationStructure.memory, 0, memoryRequirements.size, vks::MemoryCategory::RayTracing, (type == VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR) ? "TLAS" : "BLAS");
 	// Acceleration structure
 	VkAccelerationStructureCreateInfoKHR accelerationStructureCreate_info{};
 	accelerationStructureCreate_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
@@ -100,15 +132,434 @@ void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure&
 	accelerationDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
 	accelerationDeviceAddressInfo.accelerationStructure = accelerationStructure.handle;
 	accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(vulkanDevice->logicalDevice, &accelerationDeviceAddressInfo);
+	accelerationStructure.size = buildSizeInfo.accelerationStructureSize;
+	accelerationStructureMemory.allocated += accelerationStructure.size;
+	benchmark.setAccelerationStructureMemory(static_cast<double>(accelerationStructureMemory.allocated));
 }
 
 void VulkanRaytracingSample::deleteAccelerationStructure(AccelerationStructure& accelerationStructure)
 {
+	accelerationStructureMemory.allocated -= std::min(accelerationStructure.size, accelerationStructureMemory.allocated);
+	benchmark.setAccelerationStructureMemory(static_cast<double>(accelerationStructureMemory.allocated));
+	vulkanDevice->memoryAllocator.report.untrack(accelerationStructure.memory);
 	vkFreeMemory(device, accelerationStructure.memory, nullptr);
 	vkDestroyBuffer(device, accelerationStructure.buffer, nullptr);
 	vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
 }
 
+/*
+	Submits a command buffer with acceleration structure builds and waits for them to finish
+	The time this takes is added to the acceleration structure build time reported by the benchmark
+*/
+void VulkanRaytracingSample::flushAccelerationStructureBuild(VkCommandBuffer commandBuffer)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	benchmark.addAccelerationStructureBuildTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+}
+
+/*
+	Replaces an acceleration structure with a compacted copy that only takes up the memory actually used by the built structure
+	The acceleration structure must have been built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR
+	Note: As the compacted size can only be read back after the build has finished, this waits for the device twice
+*/
+void VulkanRaytracingSample::compactAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type)
+{
+	// Query the compacted size of the built acceleration structure
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+	queryPoolInfo.queryCount = 1;
+	VkQueryPool queryPool;
+	VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+
+	VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	// Make sure the build has finished writing the acceleration structure
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+	vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, 1, &accelerationStructure.handle, VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+
+	VkDeviceSize compactedSize = 0;
+	VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(VkDeviceSize), &compactedSize, sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+	vkDestroyQueryPool(device, queryPool, nullptr);
+
+	// Copy into a new acceleration structure of the compacted size
+	VkAccelerationStructureBuildSizesInfoKHR compactedSizeInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+	compactedSizeInfo.accelerationStructureSize = compactedSize;
+	AccelerationStructure compactedAccelerationStructure{};
+	createAccelerationStructure(compactedAccelerationStructure, type, compactedSizeInfo);
+
+	VkCopyAccelerationStructureInfoKHR copyInfo{};
+	copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+	copyInfo.src = accelerationStructure.handle;
+	copyInfo.dst = compactedAccelerationStructure.handle;
+	copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+	commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+
+	accelerationStructureMemory.uncompacted += accelerationStructure.size;
+	accelerationStructureMemory.compacted += compactedAccelerationStructure.size;
+	benchmark.addMetric("asmemorykb", static_cast<double>(accelerationStructureMemory.compacted) / 1024.0);
+
+	// Release the original, uncompacted acceleration structure
+	deleteAccelerationStructure(accelerationStructure);
+	accelerationStructure = compactedAccelerationStructure;
+}
+
+/*
+	Builds acceleration structures on the host with a single deferred operation that's joined by multiple worker threads
+	The geometry data and scratch memory of the build infos need to be host addresses, and the structures need to be stored in host visible memory
+*/
+void VulkanRaytracingSample::buildAccelerationStructuresOnHost(const std::vector<VkAccelerationStructureBuildGeometryInfoKHR>& buildInfos, const std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>& buildRangeInfos)
+{
+	VkDeferredOperationKHR deferredOperation;
+	VK_CHECK_RESULT(vkCreateDeferredOperationKHR(device, nullptr, &deferredOperation));
+	VkResult result = vkBuildAccelerationStructuresKHR(device, deferredOperation, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), buildRangeInfos.data());
+	if (result == VK_OPERATION_DEFERRED_KHR) {
+		// The implementation reports how many threads can be put to use, which may be less than the available cores
+		const uint32_t maxConcurrency = std::max(vkGetDeferredOperationMaxConcurrencyKHR(device, deferredOperation), 1u);
+		const uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), maxConcurrency);
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (auto& thread : threadPool.threads) {
+			thread->addJob([&] {
+				// Idle means there's no work left for this thread right now, but the operation hasn't finished yet and more may become available
+				while (vkDeferredOperationJoinKHR(device, deferredOperation) == VK_THREAD_IDLE_KHR) {
+					std::this_thread::yield();
+				}
+			});
+		}
+		threadPool.wait();
+		result = vkGetDeferredOperationResultKHR(device, deferredOperation);
+	} else if (result == VK_OPERATION_NOT_DEFERRED_KHR) {
+		// The implementation finished the build on the calling thread
+		result = VK_SUCCESS;
+	}
+	VK_CHECK_RESULT(result);
+	vkDestroyDeferredOperationKHR(device, deferredOperation, nullptr);
+}
+
+/*
+	Creates one bottom level acceleration structure per mesh of a glTF model with one geometry per primitive
+	All structures are built with a single batched build command, using one scratch buffer that's split up between them
+	The first index of each geometry is stored in meshGeometries, so the shaders can look up the indices of a hit triangle
+	via the instance's custom index (firstGeometry) plus the geometry index
+	Alpha masked primitives aren't flagged opaque, so they need an any-hit shader running the alpha test (see MeshGeometry::alphaTested)
+	If the model has been loaded with FileLoadingFlags::ClassifyAlphaMaskedTriangles, they're split into an opaque geometry for their fully opaque
+	triangles and an alpha tested one for the partially covered triangles only, fully transparent triangles are left out
+	This does at triangle granularity what opacity micromaps (VK_EXT_opacity_micromap) do per micro triangle, without requiring the extension
+	With host builds enabled (see hostAccelerationStructureBuilds), the structures are built from the model's host data on worker threads instead,
+	leaving the device free during loading. Compaction then also moves them from host visible to device local memory
+	Note: The model must not use the compact vertex layout, as the positions are read as 32 bit floats with the full vertex stride
+*/
+void VulkanRaytracingSample::createMeshAccelerationStructures(vkglTF::Model& model, std::vector<MeshAccelerationStructure>& meshAccelerationStructures, std::vector<MeshGeometry>& meshGeometries, VkBuildAccelerationStructureFlagsKHR flags)
+{
+	assert(!model.vertexLayout.compact);
+
+	bool hostBuild = hostAccelerationStructureBuilds.supported;
+	if (hostBuild && model.hostData.vertices.empty()) {
+		std::cout << "Model has been loaded without host data, building acceleration structures on the device instead\n";
+		hostBuild = false;
+	}
+
+	VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+	VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+	uint32_t vertexStride = model.vertexLayout.stride;
+	if (hostBuild) {
+		vertexBufferDeviceAddress.hostAddress = model.hostData.vertices.data();
+		indexBufferDeviceAddress.hostAddress = model.hostData.indices.data();
+		vertexStride = sizeof(vkglTF::Vertex);
+	} else {
+		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.vertices.buffer);
+		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.indices.buffer);
+	}
+
+	meshAccelerationStructures.clear();
+	meshGeometries.clear();
+
+	// Geometries and build ranges per mesh, these need to stay alive until the build has been recorded
+	std::vector<std::vector<VkAccelerationStructureGeometryKHR>> geometries;
+	std::vector<std::vector<VkAccelerationStructureBuildRangeInfoKHR>> buildRanges;
+	for (vkglTF::Node* node : model.linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		const uint32_t firstGeometry = static_cast<uint32_t>(meshGeometries.size());
+		std::vector<VkAccelerationStructureGeometryKHR> buildGeometries;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> meshBuildRanges;
+		for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+			auto addGeometry = [&](uint32_t firstIndex, uint32_t indexCount, bool alphaTested) {
+				if (indexCount == 0) {
+					return;
+				}
+				VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+				// Triangles of alpha tested geometries are reported to the any-hit shader once, as it may be expensive
+				geometry.flags = alphaTested ? VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR : VK_GEOMETRY_OPAQUE_BIT_KHR;
+				geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+				geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+				geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+				geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+				geometry.geometry.triangles.vertexStride = vertexStride;
+				// Indices are relative to the start of the model's vertex buffer
+				geometry.geometry.triangles.maxVertex = primitive->firstVertex + primitive->vertexCount - 1;
+				geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+				geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+				buildGeometries.push_back(geometry);
+
+				VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+				buildRange.primitiveCount = indexCount / 3;
+				buildRange.primitiveOffset = firstIndex * sizeof(uint32_t);
+				meshBuildRanges.push_back(buildRange);
+
+				MeshGeometry meshGeometry;
+				meshGeometry.firstIndex = firstIndex;
+				meshGeometry.material = &primitive->material;
+				meshGeometry.alphaTested = alphaTested;
+				meshGeometries.push_back(meshGeometry);
+			};
+			const vkglTF::Primitive::AlphaCoverage& coverage = primitive->alphaCoverage;
+			if (primitive->material.alphaMode != vkglTF::Material::ALPHAMODE_MASK) {
+				addGeometry(primitive->firstIndex, primitive->indexCount, false);
+			} else if (coverage.classified) {
+				// The triangles are sorted into opaque, partially covered and transparent ones
+				addGeometry(primitive->firstIndex, coverage.opaqueIndexCount, false);
+				addGeometry(primitive->firstIndex + coverage.opaqueIndexCount, coverage.partialIndexCount, true);
+			} else {
+				addGeometry(primitive->firstIndex, primitive->indexCount, true);
+			}
+		}
+		if (buildGeometries.empty()) {
+			continue;
+		}
+		MeshAccelerationStructure meshAccelerationStructure{};
+		meshAccelerationStructure.node = node;
+		meshAccelerationStructure.firstGeometry = firstGeometry;
+		meshAccelerationStructures.push_back(meshAccelerationStructure);
+		geometries.push_back(buildGeometries);
+		buildRanges.push_back(meshBuildRanges);
+	}
+
+	if (meshAccelerationStructures.empty()) {
+		return;
+	}
+
+	// Get the sizes of all structures and distribute the shared scratch buffer, each build needs its own aligned scratch range
+	const VkDeviceSize scratchAlignment = accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment;
+	std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(meshAccelerationStructures.size());
+	std::vector<VkDeviceSize> scratchOffsets(meshAccelerationStructures.size());
+	VkDeviceSize scratchSize = 0;
+	for (size_t i = 0; i < meshAccelerationStructures.size(); i++) {
+		buildInfos[i] = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfos[i].type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		buildInfos[i].flags = flags;
+		buildInfos[i].mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildInfos[i].geometryCount = static_cast<uint32_t>(geometries[i].size());
+		buildInfos[i].pGeometries = geometries[i].data();
+
+		std::vector<uint32_t> maxPrimitiveCounts;
+		for (auto& buildRange : buildRanges[i]) {
+			maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+		}
+		VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device, hostBuild ? VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR : VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfos[i], maxPrimitiveCounts.data(), &buildSizesInfo);
+
+		const VkMemoryPropertyFlags memoryPropertyFlags = hostBuild ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		createAccelerationStructure(meshAccelerationStructures[i].accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildSizesInfo, memoryPropertyFlags);
+		buildInfos[i].dstAccelerationStructure = meshAccelerationStructures[i].accelerationStructure.handle;
+
+		scratchOffsets[i] = scratchSize;
+		scratchSize += (buildSizesInfo.buildScratchSize + scratchAlignment - 1) & ~(scratchAlignment - 1);
+	}
+
+	std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos(meshAccelerationStructures.size());
+	for (size_t i = 0; i < meshAccelerationStructures.size(); i++) {
+		buildRangeInfos[i] = buildRanges[i].data();
+	}
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+	if (hostBuild) {
+		// Host builds use regular host memory for scratch, aligned the same way as on the device
+		std::vector<uint8_t> scratchMemory(scratchSize + scratchAlignment);
+		const uintptr_t scratchAddress = (reinterpret_cast<uintptr_t>(scratchMemory.data()) + scratchAlignment - 1) & ~(scratchAlignment - 1);
+		for (size_t i = 0; i < meshAccelerationStructures.size(); i++) {
+			buildInfos[i].scratchData.hostAddress = reinterpret_cast<void*>(scratchAddress + scratchOffsets[i]);
+		}
+		buildAccelerationStructuresOnHost(buildInfos, buildRangeInfos);
+	} else {
+		// The buffer's device address itself may not be aligned to the scratch offset alignment, so the start is moved up if required
+		ScratchBuffer scratchBuffer = createScratchBuffer(scratchSize + scratchAlignment);
+		const VkDeviceAddress scratchAddress = (scratchBuffer.deviceAddress + scratchAlignment - 1) & ~(scratchAlignment - 1);
+		for (size_t i = 0; i < meshAccelerationStructures.size(); i++) {
+			buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+		}
+
+		// All structures use separate scratch ranges, so they can be built with a single command without barriers in between
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBuildAccelerationStructuresKHR(
+			commandBuffer,
+			static_cast<uint32_t>(buildInfos.size()),
+			buildInfos.data(),
+			buildRangeInfos.data());
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+
+		deleteScratchBuffer(scratchBuffer);
+	}
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	const double buildTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	benchmark.addSetupTime(hostBuild ? "blasbuildhost" : "blasbuild", buildTime);
+	benchmark.addAccelerationStructureBuildTime(buildTime);
+
+	if (flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) {
+		for (auto& meshAccelerationStructure : meshAccelerationStructures) {
+			compactAccelerationStructure(meshAccelerationStructure.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR);
+		}
+	}
+}
+
+/*
+	Returns the top level acceleration structure instances for the mesh acceleration structures, transformed by their node's matrix
+	If the model was loaded with FileLoadingFlags::FlipY, the vertices have been flipped in the mesh's local space, so the node matrix is flipped along with them
+	Pass geometryHitRecords if the shader binding table contains one hit record per geometry
+*/
+std::vector<VkAccelerationStructureInstanceKHR> VulkanRaytracingSample::getMeshInstances(const std::vector<MeshAccelerationStructure>& meshAccelerationStructures, bool flipY, bool geometryHitRecords)
+{
+	const glm::mat4 flipMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, flipY ? -1.0f : 1.0f, 1.0f));
+	std::vector<VkAccelerationStructureInstanceKHR> instances;
+	for (auto& meshAccelerationStructure : meshAccelerationStructures) {
+		const glm::mat4 matrix = flipMatrix * meshAccelerationStructure.node->getMatrix() * flipMatrix;
+		VkAccelerationStructureInstanceKHR instance{};
+		// The instance transform is a row major 3x4 matrix
+		for (uint32_t row = 0; row < 3; row++) {
+			for (uint32_t column = 0; column < 4; column++) {
+				instance.transform.matrix[row][column] = matrix[column][row];
+			}
+		}
+		instance.instanceCustomIndex = meshAccelerationStructure.firstGeometry;
+		instance.mask = 0xFF;
+		// With one hit record per geometry, an instance's records start at the record of its first geometry (requires a geometry stride of 1 in traceRayEXT)
+		instance.instanceShaderBindingTableRecordOffset = geometryHitRecords ? meshAccelerationStructure.firstGeometry : 0;
+		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+		instance.accelerationStructureReference = meshAccelerationStructure.accelerationStructure.deviceAddress;
+		instances.push_back(instance);
+	}
+	return instances;
+}
+
+/*
+	Creates a top level acceleration structure for up to instanceCount instances that is built on the device each frame
+	Pass VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR in flags to be able to refit it instead of doing a full build
+*/
+void VulkanRaytracingSample::createDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& topLevelAS, uint32_t instanceCount, VkBuildAccelerationStructureFlagsKHR flags)
+{
+	topLevelAS.instanceCount = instanceCount;
+	topLevelAS.flags = flags;
+	topLevelAS.built = false;
+
+	// The host writes the instances of the current frame while the device may still build from the previous frame's ones
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&topLevelAS.instancesBuffer,
+		maxFramesInFlight * instanceCount * sizeof(VkAccelerationStructureInstanceKHR)));
+	VK_CHECK_RESULT(topLevelAS.instancesBuffer.map());
+
+	VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
+	accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+	accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+
+	VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	accelerationStructureBuildGeometryInfo.flags = flags;
+	accelerationStructureBuildGeometryInfo.geometryCount = 1;
+	accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+
+	VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+	vkGetAccelerationStructureBuildSizesKHR(
+		device,
+		VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+		&accelerationStructureBuildGeometryInfo,
+		&instanceCount,
+		&accelerationStructureBuildSizesInfo);
+
+	createAccelerationStructure(topLevelAS.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, accelerationStructureBuildSizesInfo);
+	topLevelAS.scratchBuffer = createScratchBuffer(std::max(accelerationStructureBuildSizesInfo.buildScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize));
+}
+
+/*
+	Records a build of the top level acceleration structure from the given instances into the command buffer
+	The instances are written to the current frame's range of the instance buffer, which is no longer in use once its frame's fence has been waited on
+	If refit is set (and the structure allows updates), the previous build is updated in place, which is faster but degrades the quality if instances move a lot
+*/
+void VulkanRaytracingSample::buildDynamicTopLevelAccelerationStructure(VkCommandBuffer commandBuffer, DynamicTopLevelAccelerationStructure& topLevelAS, const std::vector<VkAccelerationStructureInstanceKHR>& instances, bool refit)
+{
+	assert(instances.size() <= topLevelAS.instanceCount);
+	const VkDeviceSize instancesOffset = currentFrame * topLevelAS.instanceCount * sizeof(VkAccelerationStructureInstanceKHR);
+	memcpy(static_cast<uint8_t*>(topLevelAS.instancesBuffer.mapped) + instancesOffset, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+
+	// An update needs to use the same instance count as the build it updates
+	const bool update = refit && topLevelAS.built && (topLevelAS.builtInstanceCount == instances.size()) && (topLevelAS.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+	VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
+	accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+	accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+	accelerationStructureGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(topLevelAS.instancesBuffer.buffer) + instancesOffset;
+
+	VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	accelerationBuildGeometryInfo.flags = topLevelAS.flags;
+	accelerationBuildGeometryInfo.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+	accelerationBuildGeometryInfo.srcAccelerationStructure = update ? topLevelAS.accelerationStructure.handle : VK_NULL_HANDLE;
+	accelerationBuildGeometryInfo.dstAccelerationStructure = topLevelAS.accelerationStructure.handle;
+	accelerationBuildGeometryInfo.geometryCount = 1;
+	accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+	accelerationBuildGeometryInfo.scratchData.deviceAddress = topLevelAS.scratchBuffer.deviceAddress;
+
+	VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+	accelerationStructureBuildRangeInfo.primitiveCount = static_cast<uint32_t>(instances.size());
+	const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfo = &accelerationStructureBuildRangeInfo;
+
+	// The previous frame's ray tracing needs to be done reading the structure, and its build done with the shared scratch buffer
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &accelerationBuildGeometryInfo, &accelerationBuildStructureRangeInfo);
+
+	// Make the build visible to the ray tracing shaders
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	topLevelAS.built = true;
+	topLevelAS.builtInstanceCount = static_cast<uint32_t>(instances.size());
+}
+
+void VulkanRaytracingSample::deleteDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& topLevelAS)
+{
+	deleteAccelerationStructure(topLevelAS.accelerationStructure);
+	deleteScratchBuffer(topLevelAS.scratchBuffer);
+	topLevelAS.instancesBuffer.destroy();
+}
+
+/*
+	Registers the rays traced by a ray tracing dispatch of width * height ray generation shader invocations with the benchmark
+	Needs to be called for each frame that's submitted, e.g. from render or recordCommandBuffer
+*/
+void VulkanRaytracingSample::addTracedRays(uint32_t width, uint32_t height, const RayCounts& rayCounts)
+{
+	benchmark.addRays(static_cast<double>(width) * static_cast<double>(height) * static_cast<double>(rayCounts.perInvocation()));
+}
+
 uint64_t VulkanRaytracingSample::getBufferDeviceAddress(VkBuffer buffer)
 {
 	VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
@@ -123,6 +574,7 @@ void VulkanRaytracingSample::createStorageImage(VkFormat format, VkExtent3D exte
 	if (storageImage.image != VK_NULL_HANDLE) {
 		vkDestroyImageView(device, storageImage.view, nullptr);
 		vkDestroyImage(device, storageImage.image, nullptr);
+		vulkanDevice->memoryAllocator.report.untrack(storageImage.memory);
 		vkFreeMemory(device, storageImage.memory, nullptr);
 		storageImage = {};
 	}
@@ -146,6 +598,7 @@ void VulkanRaytracingSample::createStorageImage(VkFormat format, VkExtent3D exte
 	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &storageImage.memory));
 	VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, storageImage.image, storageImage.memory, 0));
+	vulkanDevice->memoryAllocator.report.track(storageImage.memory, 0, memReqs.size, vks::MemoryCategory::RenderTarget, "Ray tracing storage image");
 
 	VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
 	colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -171,6 +624,7 @@ void VulkanRaytracingSample::deleteStorageImage()
 {
 	vkDestroyImageView(vulkanDevice->logicalDevice, storageImage.view, nullptr);
 	vkDestroyImage(vulkanDevice->logicalDevice, storageImage.image, nullptr);
+	vulkanDevice->memoryAllocator.report.untrack(storageImage.memory);
 	vkFreeMemory(vulkanDevice->logicalDevice, storageImage.memory, nullptr);
 }
 
@@ -179,6 +633,8 @@ void VulkanRaytracingSample::prepare()
 	VulkanExampleBase::prepare();
 	// Get properties and features
 	rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+	accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+	rayTracingPipelineProperties.pNext = &accelerationStructureProperties;
 	VkPhysicalDeviceProperties2 deviceProperties2{};
 	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
 	deviceProperties2.pNext = &rayTracingPipelineProperties;
@@ -199,6 +655,13 @@ void VulkanRaytracingSample::prepare()
 	vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR"));
 	vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR"));
 	vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesKHR"));
+	vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+	vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
+	vkCreateDeferredOperationKHR = reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(vkGetDeviceProcAddr(device, "vkCreateDeferredOperationKHR"));
+	vkDestroyDeferredOperationKHR = reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(vkGetDeviceProcAddr(device, "vkDestroyDeferredOperationKHR"));
+	vkGetDeferredOperationMaxConcurrencyKHR = reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(vkGetDeviceProcAddr(device, "vkGetDeferredOperationMaxConcurrencyKHR"));
+	vkGetDeferredOperationResultKHR = reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(vkGetDeviceProcAddr(device, "vkGetDeferredOperationResultKHR"));
+	vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(vkGetDeviceProcAddr(device, "vkDeferredOperationJoinKHR"));
 }
 
 VkStridedDeviceAddressRegionKHR VulkanRaytracingSample::getSbtEntryStridedDeviceAddressRegion(VkBuffer buffer, uint32_t handleCount)
@@ -224,3 +687,80 @@ void VulkanRaytracingSample::createShaderBindingTable(ShaderBindingTable& shader
 	// Map persistent 
 	shaderBindingTable.map();
 }
+
+/*
+	Creates a single buffer containing all regions of a packed shader binding table and fills it with the handles and inline data of the records
+	The strides of a region fit its largest record and are aligned to shaderGroupHandleAlignment, regions start at multiples of shaderGroupBaseAlignment
+*/
+void VulkanRaytracingSample::createShaderBindingTable(PackedShaderBindingTable& shaderBindingTable, VkPipeline pipeline, uint32_t groupCount)
+{
+	const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
+	const VkDeviceSize baseAlignment = rayTracingPipelineProperties.shaderGroupBaseAlignment;
+
+	std::vector<uint8_t> shaderHandleStorage(groupCount * handleSize);
+	VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, shaderHandleStorage.size(), shaderHandleStorage.data()));
+
+	std::array<VkDeviceSize, 4> regionOffsets{};
+	VkDeviceSize sbtSize = 0;
+	for (size_t i = 0; i < shaderBindingTable.records.size(); i++) {
+		const auto& records = shaderBindingTable.records[i];
+		shaderBindingTable.regions[i] = {};
+		if (records.empty()) {
+			continue;
+		}
+		size_t maxDataSize = 0;
+		for (const auto& record : records) {
+			assert(record.groupIndex < groupCount);
+			maxDataSize = std::max(maxDataSize, record.data.size());
+		}
+		uint32_t stride = vks::tools::alignedSize(handleSize + static_cast<uint32_t>(maxDataSize), rayTracingPipelineProperties.shaderGroupHandleAlignment);
+		// Each raygen record is dispatched as a region of its own, so all of them have to start at the base alignment
+		if (i == PackedShaderBindingTable::Raygen) {
+			stride = vks::tools::alignedSize(stride, rayTracingPipelineProperties.shaderGroupBaseAlignment);
+		}
+		assert(stride <= rayTracingPipelineProperties.maxShaderGroupStride);
+		regionOffsets[i] = vks::tools::alignedVkSize(sbtSize, baseAlignment);
+		shaderBindingTable.regions[i].stride = stride;
+		shaderBindingTable.regions[i].size = stride * records.size();
+		sbtSize = regionOffsets[i] + shaderBindingTable.regions[i].size;
+	}
+
+	// The buffer's own device address is not guaranteed to meet the base alignment, so leave room for shifting the regions
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&shaderBindingTable.buffer,
+		sbtSize + baseAlignment));
+	VK_CHECK_RESULT(shaderBindingTable.buffer.map());
+	memset(shaderBindingTable.buffer.mapped, 0, sbtSize + baseAlignment);
+
+	const uint64_t bufferAddress = getBufferDeviceAddress(shaderBindingTable.buffer.buffer);
+	const VkDeviceSize alignmentOffset = vks::tools::alignedVkSize(bufferAddress, baseAlignment) - bufferAddress;
+	uint8_t* data = static_cast<uint8_t*>(shaderBindingTable.buffer.mapped) + alignmentOffset;
+	for (size_t i = 0; i < shaderBindingTable.records.size(); i++) {
+		const auto& records = shaderBindingTable.records[i];
+		if (records.empty()) {
+			continue;
+		}
+		shaderBindingTable.regions[i].deviceAddress = bufferAddress + alignmentOffset + regionOffsets[i];
+		for (size_t j = 0; j < records.size(); j++) {
+			uint8_t* recordData = data + regionOffsets[i] + j * shaderBindingTable.regions[i].stride;
+			memcpy(recordData, shaderHandleStorage.data() + records[j].groupIndex * handleSize, handleSize);
+			if (!records[j].data.empty()) {
+				memcpy(recordData + handleSize, records[j].data.data(), records[j].data.size());
+			}
+		}
+	}
+	// Host coherent, so the records are visible to the device without flushing
+	shaderBindingTable.buffer.unmap();
+
+	// The size of a ray generation region must be equal to its stride
+	VkStridedDeviceAddressRegionKHR& raygenRegion = shaderBindingTable.regions[PackedShaderBindingTable::Raygen];
+	shaderBindingTable.raygenRegions.clear();
+	for (size_t i = 0; i < shaderBindingTable.records[PackedShaderBindingTable::Raygen].size(); i++) {
+		shaderBindingTable.raygenRegions.push_back({ raygenRegion.deviceAddress + i * raygenRegion.stride, raygenRegion.stride, raygenRegion.stride });
+	}
+	if (!shaderBindingTable.raygenRegions.empty()) {
+		raygenRegion = shaderBindingTable.raygenRegions[0];
+	}
+}
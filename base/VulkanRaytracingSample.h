@@ -12,6 +12,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanTools.h"
 #include "VulkanDevice.h"
+#include "VulkanglTFModel.h"
 
 class VulkanRaytracingSample : public VulkanExampleBase
 {
@@ -27,16 +28,34 @@ public:
 	PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
 	PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
 	PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+	PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+	PFN_vkCreateDeferredOperationKHR vkCreateDeferredOperationKHR;
+	PFN_vkDestroyDeferredOperationKHR vkDestroyDeferredOperationKHR;
+	PFN_vkGetDeferredOperationMaxConcurrencyKHR vkGetDeferredOperationMaxConcurrencyKHR;
+	PFN_vkGetDeferredOperationResultKHR vkGetDeferredOperationResultKHR;
+	PFN_vkDeferredOperationJoinKHR vkDeferredOperationJoinKHR;
 
 	// Available features and properties
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR  rayTracingPipelineProperties{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
 
 	// Enabled features and properties
 	VkPhysicalDeviceBufferDeviceAddressFeatures enabledBufferDeviceAddresFeatures{};
 	VkPhysicalDeviceRayTracingPipelineFeaturesKHR enabledRayTracingPipelineFeatures{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR enabledAccelerationStructureFeatures{};
 
+	/*
+		Optional host side builds of the bottom level acceleration structures, requested with the --hostasbuilds command line argument
+		Samples that support it call enableHostAccelerationStructureBuilds from getEnabledFeatures and load their models with vkglTF::FileLoadingFlags::KeepHostData
+		If the device doesn't support accelerationStructureHostCommands, the structures are built on the device instead
+	*/
+	struct {
+		bool requested = false;
+		bool supported = false;
+	} hostAccelerationStructureBuilds;
+
 	// Holds information for a ray tracing scratch buffer that is used as a temporary storage
 	struct ScratchBuffer
 	{
@@ -51,6 +70,70 @@ public:
 		uint64_t deviceAddress = 0;
 		VkDeviceMemory memory;
 		VkBuffer buffer;
+		VkDeviceSize size = 0;
+	};
+
+	// Bottom level acceleration structure of a single glTF mesh with one geometry per primitive
+	struct MeshAccelerationStructure {
+		AccelerationStructure accelerationStructure{};
+		vkglTF::Node* node = nullptr;
+		// Index of the mesh's first geometry in the list of all geometries, passed to the shaders as the instance's custom index
+		uint32_t firstGeometry = 0;
+	};
+
+	// Geometry of a mesh acceleration structure, listed in the same order as the hit records with one record per geometry
+	struct MeshGeometry {
+		// First index of the geometry's triangles in the model's index buffer
+		uint32_t firstIndex = 0;
+		vkglTF::Material* material = nullptr;
+		// The geometry isn't flagged opaque, so its hit record needs an any-hit shader running the material's alpha test
+		bool alphaTested = false;
+	};
+
+	// Top level acceleration structure that's rebuilt or refit each frame from instances written by the host
+	struct DynamicTopLevelAccelerationStructure {
+		AccelerationStructure accelerationStructure{};
+		// Persistently mapped instance data, with a separate range for each frame in flight
+		vks::Buffer instancesBuffer;
+		uint32_t instanceCount = 0;
+		// Large enough for both a full build and a refit
+		ScratchBuffer scratchBuffer{};
+		VkBuildAccelerationStructureFlagsKHR flags = 0;
+		// A refit needs a previous build with the same number of instances to update from
+		bool built = false;
+		uint32_t builtInstanceCount = 0;
+	};
+
+	// Acceleration structure memory before and after compaction, summed up over all compacted acceleration structures
+	// allocated is the memory of all acceleration structures that currently exist, reported by the benchmark
+	struct {
+		VkDeviceSize uncompacted = 0;
+		VkDeviceSize compacted = 0;
+		VkDeviceSize allocated = 0;
+	} accelerationStructureMemory;
+
+	/*
+		Rays traced per ray generation shader invocation, used to report the ray throughput in benchmark mode (see addTracedRays)
+		Each primary ray and each reflection ray can spawn further reflection rays until recursionDepth (which includes the primary ray) is reached,
+		and every one of these rays traces shadow rays at its hit
+		This assumes that all rays hit something, so it's an upper bound for scenes where rays leave the scene early
+	*/
+	struct RayCounts {
+		uint32_t primary = 1;
+		uint32_t shadow = 0;
+		uint32_t reflection = 0;
+		uint32_t recursionDepth = 1;
+
+		uint64_t perInvocation() const
+		{
+			uint64_t rays = 0;
+			uint64_t raysAtDepth = primary;
+			for (uint32_t depth = 0; depth < recursionDepth; depth++) {
+				rays += raysAtDepth;
+				raysAtDepth *= reflection;
+			}
+			return rays * (1 + shadow);
+		}
 	};
 
 	// Holds information for a storage image that the ray tracing shaders output to
@@ -67,16 +150,72 @@ public:
 		VkStridedDeviceAddressRegionKHR stridedDeviceAddressRegion{};
 	};
 
+	// Shader binding table with the raygen, miss, hit and callable regions packed into a single buffer
+	// Each record holds a shader group handle, optionally followed by inline data that's accessible as shaderRecordEXT in the shaders
+	struct PackedShaderBindingTable {
+		enum Region { Raygen = 0, Miss = 1, Hit = 2, Callable = 3 };
+		struct Record {
+			uint32_t groupIndex;
+			std::vector<uint8_t> data;
+		};
+		std::array<std::vector<Record>, 4> records;
+		// Regions passed to vkCmdTraceRaysKHR, empty for regions without records
+		// The ray generation region covers the first raygen record, the others are selected with getRaygenRegion
+		std::array<VkStridedDeviceAddressRegionKHR, 4> regions{};
+		std::vector<VkStridedDeviceAddressRegionKHR> raygenRegions;
+		vks::Buffer buffer;
+
+		// Records are stored in the order they are added, e.g. the n-th hit record is selected with a hit group index of n
+		void addRecord(Region region, uint32_t groupIndex, const void* data = nullptr, size_t dataSize = 0)
+		{
+			Record record{ groupIndex, {} };
+			if (data) {
+				record.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + dataSize);
+			}
+			records[region].push_back(record);
+		}
+		template <typename T>
+		void addRecord(Region region, uint32_t groupIndex, const T& data)
+		{
+			addRecord(region, groupIndex, &data, sizeof(T));
+		}
+		const VkStridedDeviceAddressRegionKHR* getRegion(Region region) const
+		{
+			return &regions[region];
+		}
+		// Ray generation region containing only the n-th raygen record, as a dispatch always starts at the first record of the region
+		const VkStridedDeviceAddressRegionKHR* getRaygenRegion(uint32_t index) const
+		{
+			assert(index < raygenRegions.size());
+			return &raygenRegions[index];
+		}
+		void destroy()
+		{
+			buffer.destroy();
+		}
+	};
+
 	void enableExtensions();
 	ScratchBuffer createScratchBuffer(VkDeviceSize size);
 	void deleteScratchBuffer(ScratchBuffer& scratchBuffer);
-	void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
+	void enableHostAccelerationStructureBuilds();
+	void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo, VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	void deleteAccelerationStructure(AccelerationStructure& accelerationStructure);
+	void flushAccelerationStructureBuild(VkCommandBuffer commandBuffer);
+	void compactAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type);
+	void buildAccelerationStructuresOnHost(const std::vector<VkAccelerationStructureBuildGeometryInfoKHR>& buildInfos, const std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>& buildRangeInfos);
+	void createMeshAccelerationStructures(vkglTF::Model& model, std::vector<MeshAccelerationStructure>& meshAccelerationStructures, std::vector<MeshGeometry>& meshGeometries, VkBuildAccelerationStructureFlagsKHR flags);
+	std::vector<VkAccelerationStructureInstanceKHR> getMeshInstances(const std::vector<MeshAccelerationStructure>& meshAccelerationStructures, bool flipY = false, bool geometryHitRecords = false);
+	void createDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& topLevelAS, uint32_t instanceCount, VkBuildAccelerationStructureFlagsKHR flags);
+	void buildDynamicTopLevelAccelerationStructure(VkCommandBuffer commandBuffer, DynamicTopLevelAccelerationStructure& topLevelAS, const std::vector<VkAccelerationStructureInstanceKHR>& instances, bool refit);
+	void deleteDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& topLevelAS);
 	uint64_t getBufferDeviceAddress(VkBuffer buffer);
+	void addTracedRays(uint32_t width, uint32_t height, const RayCounts& rayCounts);
 	void createStorageImage(VkFormat format, VkExtent3D extent);
 	void deleteStorageImage();
 	VkStridedDeviceAddressRegionKHR getSbtEntryStridedDeviceAddressRegion(VkBuffer buffer, uint32_t handleCount);
 	void createShaderBindingTable(ShaderBindingTable& shaderBindingTable, uint32_t handleCount);
+	void createShaderBindingTable(PackedShaderBindingTable& shaderBindingTable, VkPipeline pipeline, uint32_t groupCount);
 
 	virtual void prepare();
 };
@@ -0,0 +1,862 @@
+/*
+* Vulkan render graph
+*
+* Offscreen render passes declared by the images they write and sample, with derived barriers, pass culling, aliasing of transient attachments
+* and scheduling of compute passes on the async compute queue
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderGraph.h"
+#include "VulkanPipelineManifest.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	RenderGraph::~RenderGraph()
+	{
+		destroy();
+	}
+
+	void RenderGraph::getAccessInfo(AccessType type, VkImageLayout& layout, VkPipelineStageFlags& stageMask, VkAccessFlags& accessMask)
+	{
+		switch (type) {
+		case ACCESS_COLOR_ATTACHMENT:
+			layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			accessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			break;
+		case ACCESS_DEPTH_STENCIL_ATTACHMENT:
+			layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			stageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			accessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			break;
+		case ACCESS_SAMPLED:
+			layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			accessMask = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case ACCESS_COMPUTE_SAMPLED:
+			layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			accessMask = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case ACCESS_STORAGE:
+			layout = VK_IMAGE_LAYOUT_GENERAL;
+			stageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			accessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			break;
+		}
+	}
+
+	bool RenderGraph::isWrite(AccessType type)
+	{
+		return (type == ACCESS_COLOR_ATTACHMENT) || (type == ACCESS_DEPTH_STENCIL_ATTACHMENT) || (type == ACCESS_STORAGE);
+	}
+
+	RenderGraph::ImageHandle RenderGraph::addImage(const std::string& name, const ImageDesc& desc)
+	{
+		Image image{};
+		image.name = name;
+		image.desc = desc;
+		images.push_back(image);
+		return static_cast<ImageHandle>(images.size() - 1);
+	}
+
+	void RenderGraph::setOutput(ImageHandle image)
+	{
+		images[image].output = true;
+	}
+
+	RenderGraph::PassHandle RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> record)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.record = record;
+		passes.push_back(pass);
+		return static_cast<PassHandle>(passes.size() - 1);
+	}
+
+	RenderGraph::PassHandle RenderGraph::addComputePass(const std::string& name, std::function<void(VkCommandBuffer)> record, bool async)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.record = record;
+		pass.compute = true;
+		pass.async = async;
+		passes.push_back(pass);
+		return static_cast<PassHandle>(passes.size() - 1);
+	}
+
+	void RenderGraph::addColorAttachment(PassHandle pass, ImageHandle image, const VkClearValue* clearValue)
+	{
+		assert(!passes[pass].compute);
+		Access access{};
+		access.image = image;
+		access.type = ACCESS_COLOR_ATTACHMENT;
+		if (clearValue) {
+			access.clear = true;
+			access.clearValue = *clearValue;
+		}
+		passes[pass].accesses.push_back(access);
+	}
+
+	void RenderGraph::setDepthStencilAttachment(PassHandle pass, ImageHandle image, const VkClearValue* clearValue)
+	{
+		// Only one depth stencil attachment per pass
+		assert(!passes[pass].compute && std::none_of(passes[pass].accesses.begin(), passes[pass].accesses.end(), [](const Access& access) { return access.type == ACCESS_DEPTH_STENCIL_ATTACHMENT; }));
+		Access access{};
+		access.image = image;
+		access.type = ACCESS_DEPTH_STENCIL_ATTACHMENT;
+		if (clearValue) {
+			access.clear = true;
+			access.clearValue = *clearValue;
+		}
+		passes[pass].accesses.push_back(access);
+	}
+
+	void RenderGraph::addSampledImage(PassHandle pass, ImageHandle image)
+	{
+		Access access{};
+		access.image = image;
+		access.type = passes[pass].compute ? ACCESS_COMPUTE_SAMPLED : ACCESS_SAMPLED;
+		passes[pass].accesses.push_back(access);
+	}
+
+	void RenderGraph::addStorageImage(PassHandle pass, ImageHandle image)
+	{
+		assert(passes[pass].compute);
+		Access access{};
+		access.image = image;
+		access.type = ACCESS_STORAGE;
+		passes[pass].accesses.push_back(access);
+	}
+
+	/**
+	* Walk the passes from last to first and only keep those that write an image whose contents are needed by a later pass or an output
+	* An attachment that's cleared doesn't need the contents written by earlier passes, so these can be culled if nothing else reads them
+	*/
+	void RenderGraph::cullPasses()
+	{
+		std::vector<bool> needed(images.size(), false);
+		for (size_t i = 0; i < images.size(); i++) {
+			needed[i] = images[i].output;
+		}
+		for (size_t i = passes.size(); i-- > 0;) {
+			Pass& pass = passes[i];
+			pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(), [&needed](const Access& access) { return isWrite(access.type) && needed[access.image]; });
+			if (pass.culled) {
+				continue;
+			}
+			for (auto& access : pass.accesses) {
+				if (isWrite(access.type) && access.clear) {
+					needed[access.image] = false;
+				}
+			}
+			for (auto& access : pass.accesses) {
+				if (!isWrite(access.type) || !access.clear) {
+					needed[access.image] = true;
+				}
+			}
+		}
+
+		executionOrder.clear();
+		for (size_t i = 0; i < passes.size(); i++) {
+			if (!passes[i].culled) {
+				executionOrder.push_back(static_cast<PassHandle>(i));
+			}
+		}
+	}
+
+	bool RenderGraph::sharesImage(const Pass& a, const Pass& b) const
+	{
+		return std::any_of(a.accesses.begin(), a.accesses.end(), [&b](const Access& access) {
+			return std::any_of(b.accesses.begin(), b.accesses.end(), [&access](const Access& other) { return other.image == access.image; });
+		});
+	}
+
+	/**
+	* Assign the remaining passes to the submissions they're recorded into and order them by submission, without async compute all passes are recorded by execute
+	* Any image shared with an async compute pass is a dependency (even between reads, as the compute queue may transition its layout). Passes declared before
+	* an async compute pass that it (indirectly) depends on are submitted before the compute work, passes declared after one that depend on it are submitted after it
+	*/
+	void RenderGraph::scheduleAsyncCompute()
+	{
+		for (auto handle : executionOrder) {
+			passes[handle].segment = SEGMENT_GRAPHICS;
+		}
+		asyncComputeActive = asyncCompute && (device->queueFamilyIndices.compute != device->queueFamilyIndices.graphics) &&
+			std::any_of(executionOrder.begin(), executionOrder.end(), [this](PassHandle handle) { return passes[handle].async; });
+		if (!asyncComputeActive) {
+			return;
+		}
+
+		const size_t count = executionOrder.size();
+		for (size_t i = count; i-- > 0;) {
+			Pass& pass = passes[executionOrder[i]];
+			if (pass.async) {
+				pass.segment = SEGMENT_ASYNC_COMPUTE;
+				continue;
+			}
+			for (size_t j = i + 1; j < count; j++) {
+				const Pass& later = passes[executionOrder[j]];
+				if (((later.segment == SEGMENT_ASYNC_COMPUTE) || (later.segment == SEGMENT_BEFORE_ASYNC_COMPUTE)) && sharesImage(pass, later)) {
+					pass.segment = SEGMENT_BEFORE_ASYNC_COMPUTE;
+					break;
+				}
+			}
+		}
+
+		bool valid = true;
+		for (size_t i = 0; i < count; i++) {
+			Pass& pass = passes[executionOrder[i]];
+			bool afterAsyncCompute = false;
+			bool afterGraphics = false;
+			for (size_t j = 0; j < i; j++) {
+				const Pass& earlier = passes[executionOrder[j]];
+				if (sharesImage(pass, earlier)) {
+					afterAsyncCompute |= (earlier.segment == SEGMENT_ASYNC_COMPUTE);
+					afterGraphics |= (earlier.segment == SEGMENT_GRAPHICS);
+				}
+			}
+			if (pass.segment == SEGMENT_ASYNC_COMPUTE) {
+				valid &= !afterGraphics;
+			} else if (pass.segment == SEGMENT_BEFORE_ASYNC_COMPUTE) {
+				valid &= !afterAsyncCompute && !afterGraphics;
+			} else if (!afterAsyncCompute && !afterGraphics) {
+				pass.segment = SEGMENT_OVERLAPPING_ASYNC_COMPUTE;
+			}
+		}
+		// Async compute passes depending on each other through graphics passes can't be submitted at once, so all passes are run on the graphics queue instead
+		if (!valid) {
+			for (auto handle : executionOrder) {
+				passes[handle].segment = SEGMENT_GRAPHICS;
+			}
+			asyncComputeActive = false;
+			return;
+		}
+		std::stable_sort(executionOrder.begin(), executionOrder.end(), [this](PassHandle a, PassHandle b) { return passes[a].segment < passes[b].segment; });
+	}
+
+	/** @brief Get the first and last pass (in execution order) using each image */
+	void RenderGraph::computeLifetimes()
+	{
+		for (uint32_t order = 0; order < static_cast<uint32_t>(executionOrder.size()); order++) {
+			for (auto& access : passes[executionOrder[order]].accesses) {
+				Image& image = images[access.image];
+				image.firstUse = std::min(image.firstUse, order);
+				image.lastUse = std::max(image.lastUse, order);
+				image.shared |= (passes[executionOrder[order]].segment == SEGMENT_ASYNC_COMPUTE);
+			}
+		}
+		for (auto& image : images) {
+			if (image.output) {
+				// An output that no pass writes to can't be read after the graph
+				assert(image.firstUse != UINT32_MAX);
+				image.lastUse = UINT32_MAX;
+			}
+		}
+	}
+
+	/**
+	* Create the images used by the remaining passes and place them in device memory
+	* The largest images are placed first, each image then goes into the first memory block with a compatible memory type whose images
+	* are all used either before or after it (non-overlapping lifetimes), and the block grows to the largest image placed in it
+	* Images shared with async compute passes are in use while the concurrent passes are executed, so they always get a block of their own
+	*/
+	void RenderGraph::createImages()
+	{
+		std::vector<ImageHandle> createdImages;
+		for (size_t i = 0; i < images.size(); i++) {
+			Image& image = images[i];
+			if (image.firstUse == UINT32_MAX) {
+				continue;
+			}
+			image.usage = image.output ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+			for (auto handle : executionOrder) {
+				for (auto& access : passes[handle].accesses) {
+					if (access.image != i) {
+						continue;
+					}
+					switch (access.type) {
+					case ACCESS_COLOR_ATTACHMENT:
+						image.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+						break;
+					case ACCESS_DEPTH_STENCIL_ATTACHMENT:
+						image.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+						break;
+					case ACCESS_SAMPLED:
+					case ACCESS_COMPUTE_SAMPLED:
+						image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+						break;
+					case ACCESS_STORAGE:
+						image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+						break;
+					}
+				}
+			}
+			if (image.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+				image.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+				if (image.desc.format >= VK_FORMAT_D16_UNORM_S8_UINT) {
+					image.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+				}
+			} else {
+				image.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = image.desc.format;
+			imageCI.extent = { image.desc.width, image.desc.height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = image.usage;
+			// Shared images are used by both queue families without ownership transfers
+			const uint32_t queueFamilyIndices[2] = { device->queueFamilyIndices.graphics, device->queueFamilyIndices.compute };
+			if (image.shared) {
+				imageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+				imageCI.queueFamilyIndexCount = 2;
+				imageCI.pQueueFamilyIndices = queueFamilyIndices;
+			}
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image.image));
+			vkGetImageMemoryRequirements(device->logicalDevice, image.image, &image.memoryRequirements);
+			createdImages.push_back(static_cast<ImageHandle>(i));
+		}
+
+		std::sort(createdImages.begin(), createdImages.end(), [this](ImageHandle a, ImageHandle b) { return images[a].memoryRequirements.size > images[b].memoryRequirements.size; });
+		for (auto handle : createdImages) {
+			Image& image = images[handle];
+			uint32_t blockIndex = UINT32_MAX;
+			for (uint32_t i = 0; aliasing && !image.shared && (i < static_cast<uint32_t>(memoryBlocks.size())); i++) {
+				MemoryBlock& block = memoryBlocks[i];
+				VkBool32 memoryTypeFound = VK_FALSE;
+				device->getMemoryType(block.memoryTypeBits & image.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryTypeFound);
+				if (!memoryTypeFound) {
+					continue;
+				}
+				const bool overlaps = std::any_of(block.images.begin(), block.images.end(), [this, &image](ImageHandle other) {
+					return images[other].shared || !((image.lastUse < images[other].firstUse) || (images[other].lastUse < image.firstUse));
+				});
+				if (!overlaps) {
+					blockIndex = i;
+					break;
+				}
+			}
+			if (blockIndex == UINT32_MAX) {
+				MemoryBlock block{};
+				block.memoryTypeBits = image.memoryRequirements.memoryTypeBits;
+				memoryBlocks.push_back(block);
+				blockIndex = static_cast<uint32_t>(memoryBlocks.size() - 1);
+			}
+			MemoryBlock& block = memoryBlocks[blockIndex];
+			block.size = std::max(block.size, image.memoryRequirements.size);
+			block.memoryTypeBits &= image.memoryRequirements.memoryTypeBits;
+			block.images.push_back(handle);
+			image.memoryBlock = blockIndex;
+		}
+
+		for (auto& block : memoryBlocks) {
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = block.size;
+			memAlloc.memoryTypeIndex = device->getMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &block.memory));
+			device->memoryAllocator.report.track(block.memory, 0, block.size, vks::MemoryCategory::RenderTarget, "Render graph transient images");
+			// All images of a block start at the beginning of its memory, which satisfies any alignment
+			for (auto handle : block.images) {
+				Image& image = images[handle];
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image.image, block.memory, 0));
+				VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+				imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				imageViewCI.format = image.desc.format;
+				// Views of depth stencil images only select the depth aspect, so they can also be sampled
+				imageViewCI.subresourceRange = { (image.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT : image.aspectMask, 0, 1, 0, 1 };
+				imageViewCI.image = image.image;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &imageViewCI, nullptr, &image.view));
+			}
+		}
+	}
+
+	/**
+	* Create a render pass with a single subpass and a framebuffer for each remaining pass that isn't a compute pass
+	* Attachments are loaded if an earlier pass wrote them (unless they're cleared) and stored if a later pass or the consumer of an output reads them
+	*/
+	void RenderGraph::createRenderPasses()
+	{
+		for (uint32_t order = 0; order < static_cast<uint32_t>(executionOrder.size()); order++) {
+			Pass& pass = passes[executionOrder[order]];
+			if (pass.compute) {
+				continue;
+			}
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference{};
+			bool hasDepth = false;
+			std::vector<VkImageView> attachmentViews;
+			pass.clearValues.clear();
+
+			for (auto& access : pass.accesses) {
+				if (!isWrite(access.type)) {
+					continue;
+				}
+				const Image& image = images[access.image];
+				if (attachmentViews.empty()) {
+					pass.width = image.desc.width;
+					pass.height = image.desc.height;
+				}
+				// All attachments of a pass need to be of the same size
+				assert((pass.width == image.desc.width) && (pass.height == image.desc.height));
+
+				VkImageLayout layout;
+				VkPipelineStageFlags stageMask;
+				VkAccessFlags accessMask;
+				getAccessInfo(access.type, layout, stageMask, accessMask);
+
+				VkAttachmentDescription attachmentDescription{};
+				attachmentDescription.format = image.desc.format;
+				attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+				attachmentDescription.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : ((image.firstUse < order) ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+				attachmentDescription.storeOp = (image.lastUse > order) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				const bool hasStencil = (image.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+				attachmentDescription.stencilLoadOp = hasStencil ? attachmentDescription.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachmentDescription.stencilStoreOp = hasStencil ? attachmentDescription.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				// Layout transitions are done by the barriers in front of the render pass
+				attachmentDescription.initialLayout = layout;
+				attachmentDescription.finalLayout = layout;
+
+				const uint32_t attachmentIndex = static_cast<uint32_t>(attachmentDescriptions.size());
+				if (access.type == ACCESS_DEPTH_STENCIL_ATTACHMENT) {
+					depthReference = { attachmentIndex, layout };
+					hasDepth = true;
+				} else {
+					colorReferences.push_back({ attachmentIndex, layout });
+				}
+				attachmentDescriptions.push_back(attachmentDescription);
+				attachmentViews.push_back(image.view);
+				pass.clearValues.push_back(access.clearValue);
+			}
+			assert(!attachmentViews.empty());
+
+			VkSubpassDescription subpassDescription{};
+			subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpassDescription.pColorAttachments = colorReferences.data();
+			subpassDescription.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+			renderPassCI.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+			renderPassCI.pAttachments = attachmentDescriptions.data();
+			renderPassCI.subpassCount = 1;
+			renderPassCI.pSubpasses = &subpassDescription;
+			VK_CHECK_RESULT(vks::createRenderPass(device->logicalDevice, &renderPassCI, nullptr, &pass.renderPass));
+
+			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+			framebufferCI.renderPass = pass.renderPass;
+			framebufferCI.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
+			framebufferCI.pAttachments = attachmentViews.data();
+			framebufferCI.width = pass.width;
+			framebufferCI.height = pass.height;
+			framebufferCI.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &pass.framebuffer));
+		}
+	}
+
+	/**
+	* Derive the barriers between the passes by tracking the layout and last access of each image in execution order
+	* Reads of an image in the layout it's already in don't need a barrier. The first use of an image in a frame discards its contents,
+	* but still needs to wait for the last use of the memory it's placed in, either by an aliased image earlier in the frame or by the previous frame
+	* Accesses on the other queue have been waited on with a semaphore (at all stages), which also makes their writes available, so barriers after them only
+	* need to chain with the semaphore wait and transition the layout
+	*/
+	void RenderGraph::createBarriers()
+	{
+		struct State {
+			bool accessed = false;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags stageMask = 0;
+			VkAccessFlags accessMask = 0;
+			bool computeQueue = false;
+		};
+		const VkAccessFlags writeAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		// Last access of each image in a frame, outputs are last read by the fragment shaders after the graph
+		std::vector<State> lastAccesses(images.size());
+		for (auto handle : executionOrder) {
+			for (auto& access : passes[handle].accesses) {
+				State& state = lastAccesses[access.image];
+				getAccessInfo(access.type, state.layout, state.stageMask, state.accessMask);
+				state.computeQueue = (passes[handle].segment == SEGMENT_ASYNC_COMPUTE);
+			}
+		}
+		for (size_t i = 0; i < images.size(); i++) {
+			if (images[i].output) {
+				getAccessInfo(ACCESS_SAMPLED, lastAccesses[i].layout, lastAccesses[i].stageMask, lastAccesses[i].accessMask);
+				lastAccesses[i].computeQueue = false;
+			}
+		}
+
+		std::vector<State> states(images.size());
+		for (uint32_t order = 0; order < static_cast<uint32_t>(executionOrder.size()); order++) {
+			Pass& pass = passes[executionOrder[order]];
+			const bool computeQueue = (pass.segment == SEGMENT_ASYNC_COMPUTE);
+			pass.barriers.clear();
+			pass.srcStageMask = 0;
+			pass.dstStageMask = 0;
+			for (auto& access : pass.accesses) {
+				const Image& image = images[access.image];
+				State& state = states[access.image];
+				VkImageLayout layout;
+				VkPipelineStageFlags stageMask;
+				VkAccessFlags accessMask;
+				getAccessInfo(access.type, layout, stageMask, accessMask);
+
+				State previous = state;
+				if (!state.accessed) {
+					// Find the previous user of the image's memory: the latest aliased image used before this one, or the last one used in the previous frame
+					const std::vector<ImageHandle>& aliases = memoryBlocks[image.memoryBlock].images;
+					ImageHandle previousImage = UINT32_MAX;
+					for (auto alias : aliases) {
+						if ((images[alias].lastUse < image.firstUse) && ((previousImage == UINT32_MAX) || (images[alias].lastUse > images[previousImage].lastUse))) {
+							previousImage = alias;
+						}
+					}
+					if (previousImage == UINT32_MAX) {
+						previousImage = *std::max_element(aliases.begin(), aliases.end(), [this](ImageHandle a, ImageHandle b) { return images[a].lastUse < images[b].lastUse; });
+					}
+					previous = lastAccesses[previousImage];
+					previous.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+				if (previous.computeQueue != computeQueue) {
+					previous.stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+					previous.accessMask = 0;
+				}
+				const bool required = !state.accessed || (previous.layout != layout) || (previous.accessMask & writeAccessMask) || isWrite(access.type);
+				if (required) {
+					VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+					barrier.srcAccessMask = previous.accessMask & writeAccessMask;
+					barrier.dstAccessMask = accessMask;
+					barrier.oldLayout = previous.layout;
+					barrier.newLayout = layout;
+					barrier.image = image.image;
+					barrier.subresourceRange = { image.aspectMask, 0, 1, 0, 1 };
+					pass.barriers.push_back(barrier);
+					pass.srcStageMask |= previous.stageMask;
+					pass.dstStageMask |= stageMask;
+				}
+				state.accessed = true;
+				state.layout = layout;
+				state.stageMask = stageMask;
+				state.accessMask = accessMask;
+				state.computeQueue = computeQueue;
+			}
+		}
+
+		outputBarriers.clear();
+		outputSrcStageMask = 0;
+		for (size_t i = 0; i < images.size(); i++) {
+			State state = states[i];
+			if (state.computeQueue) {
+				state.stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				state.accessMask = 0;
+			}
+			if (!images[i].output || ((state.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) && !(state.accessMask & writeAccessMask))) {
+				continue;
+			}
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.srcAccessMask = state.accessMask & writeAccessMask;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.image = images[i].image;
+			barrier.subresourceRange = { images[i].aspectMask, 0, 1, 0, 1 };
+			outputBarriers.push_back(barrier);
+			outputSrcStageMask |= state.stageMask;
+		}
+	}
+
+	/** @brief Create the command buffers and semaphores of the submissions done by submitAsyncCompute for each frame in flight */
+	void RenderGraph::createAsyncFrames()
+	{
+		if (!asyncComputeActive) {
+			return;
+		}
+		vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.compute, 0, &computeQueue);
+		asyncFrames.resize(framesInFlight);
+		for (auto& frame : asyncFrames) {
+			// The command buffers are recorded anew each frame, after resetting their pool
+			VkCommandPoolCreateInfo cmdPoolInfo = {};
+			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			cmdPoolInfo.queueFamilyIndex = device->queueFamilyIndices.graphics;
+			VK_CHECK_RESULT(vkCreateCommandPool(device->logicalDevice, &cmdPoolInfo, nullptr, &frame.graphicsCommandPool));
+			cmdPoolInfo.queueFamilyIndex = device->queueFamilyIndices.compute;
+			VK_CHECK_RESULT(vkCreateCommandPool(device->logicalDevice, &cmdPoolInfo, nullptr, &frame.computeCommandPool));
+			VkCommandBuffer graphicsCommandBuffers[2];
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(frame.graphicsCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 2);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, graphicsCommandBuffers));
+			frame.before = graphicsCommandBuffers[0];
+			frame.overlapping = graphicsCommandBuffers[1];
+			cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(frame.computeCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &frame.compute));
+			VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &frame.beforeComplete));
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &frame.computeComplete));
+		}
+	}
+
+	/**
+	* Cull unused passes, schedule async compute passes, create the images, render passes and framebuffers of the remaining passes and derive the barriers between them
+	* Needs to be called after all passes have been added and before getting the render passes for pipeline creation
+	*/
+	void RenderGraph::compile(vks::VulkanDevice* device)
+	{
+		destroy();
+		this->device = device;
+		for (auto& image : images) {
+			image.firstUse = UINT32_MAX;
+			image.lastUse = 0;
+			image.memoryBlock = UINT32_MAX;
+			image.shared = false;
+		}
+		cullPasses();
+		scheduleAsyncCompute();
+		computeLifetimes();
+		createImages();
+		createRenderPasses();
+		createBarriers();
+		createAsyncFrames();
+	}
+
+	void RenderGraph::recordPass(VkCommandBuffer commandBuffer, Pass& pass)
+	{
+		if (!pass.barriers.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, pass.srcStageMask, pass.dstStageMask, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(pass.barriers.size()), pass.barriers.data());
+		}
+
+		if (pass.compute) {
+			if (pass.record) {
+				pass.record(commandBuffer);
+			}
+			return;
+		}
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = pass.renderPass;
+		renderPassBeginInfo.framebuffer = pass.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = pass.width;
+		renderPassBeginInfo.renderArea.extent.height = pass.height;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+		renderPassBeginInfo.pClearValues = pass.clearValues.data();
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)pass.width, (float)pass.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(pass.width, pass.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		if (pass.record) {
+			pass.record(commandBuffer);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	/**
+	* Record all passes that haven't been culled into the command buffer, outside of any render pass
+	* With async compute active only the passes depending on the async compute passes are recorded, the others are submitted by submitAsyncCompute
+	*/
+	void RenderGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		for (auto handle : executionOrder) {
+			if (passes[handle].segment == SEGMENT_GRAPHICS) {
+				recordPass(commandBuffer, passes[handle]);
+			}
+		}
+		if (!outputBarriers.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, outputSrcStageMask, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(outputBarriers.size()), outputBarriers.data());
+		}
+	}
+
+	/** @brief Record the passes of a submission done by submitAsyncCompute into one of the graph's command buffers, each pass is timed as a scope nested into the segment's scope */
+	void RenderGraph::recordSegment(VkCommandBuffer commandBuffer, Segment segment, const std::string& name)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		if (profiler) {
+			profiler->beginFrame(commandBuffer);
+			profiler->beginScope(commandBuffer, name);
+		}
+		for (auto handle : executionOrder) {
+			Pass& pass = passes[handle];
+			if (pass.segment != segment) {
+				continue;
+			}
+			if (profiler) {
+				profiler->beginScope(commandBuffer, pass.name);
+			}
+			recordPass(commandBuffer, pass);
+			if (profiler) {
+				profiler->endScope(commandBuffer);
+			}
+		}
+		if (profiler) {
+			profiler->endScope(commandBuffer);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	/**
+	* Record and submit the passes the async compute passes depend on and those running concurrently with them to the graphics queue, and the async compute passes to the compute queue
+	* Needs to be called each frame before the command buffer the graph has been executed into is submitted, if async compute is active
+	*
+	* @param queue Graphics queue the command buffer the graph has been executed into is submitted to
+	* @param frameIndex Index of the frame in flight (0..framesInFlight-1), the GPU must have finished the last submission of that frame
+	*
+	* @return Semaphore the submission of the command buffer the graph has been executed into has to wait on (at VK_PIPELINE_STAGE_ALL_COMMANDS_BIT), VK_NULL_HANDLE if async compute isn't active
+	*/
+	VkSemaphore RenderGraph::submitAsyncCompute(VkQueue queue, uint32_t frameIndex)
+	{
+		if (!asyncComputeActive) {
+			return VK_NULL_HANDLE;
+		}
+		assert(frameIndex < asyncFrames.size());
+		AsyncFrame& frame = asyncFrames[frameIndex];
+
+		// The frame's last submission has finished, so its timings can be read before the command buffers are recorded again
+		if (profiler) {
+			profiler->collect(frame.before);
+			const bool overlappingCollected = profiler->collect(frame.overlapping);
+			if (profiler->collect(frame.compute) && overlappingCollected) {
+				profiler->measureOverlap("Async compute overlap", "Async compute", "Graphics overlapping async compute");
+			}
+		}
+
+		VK_CHECK_RESULT(vkResetCommandPool(device->logicalDevice, frame.graphicsCommandPool, 0));
+		VK_CHECK_RESULT(vkResetCommandPool(device->logicalDevice, frame.computeCommandPool, 0));
+		recordSegment(frame.before, SEGMENT_BEFORE_ASYNC_COMPUTE, "Graphics before async compute");
+		recordSegment(frame.overlapping, SEGMENT_OVERLAPPING_ASYNC_COMPUTE, "Graphics overlapping async compute");
+		recordSegment(frame.compute, SEGMENT_ASYNC_COMPUTE, "Async compute");
+
+		// The compute work always waits for the graphics work submitted before it, which also orders it after the previous frame's use of the shared images
+		VkSubmitInfo graphicsSubmitInfos[2] = { vks::initializers::submitInfo(), vks::initializers::submitInfo() };
+		graphicsSubmitInfos[0].commandBufferCount = 1;
+		graphicsSubmitInfos[0].pCommandBuffers = &frame.before;
+		graphicsSubmitInfos[0].signalSemaphoreCount = 1;
+		graphicsSubmitInfos[0].pSignalSemaphores = &frame.beforeComplete;
+		graphicsSubmitInfos[1].commandBufferCount = 1;
+		graphicsSubmitInfos[1].pCommandBuffers = &frame.overlapping;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 2, graphicsSubmitInfos, VK_NULL_HANDLE));
+
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &frame.beforeComplete;
+		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &frame.compute;
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &frame.computeComplete;
+		VK_CHECK_RESULT(vkQueueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+
+		if (profiler) {
+			profiler->frameSubmitted(frame.before);
+			profiler->frameSubmitted(frame.overlapping);
+			profiler->frameSubmitted(frame.compute);
+		}
+		return frame.computeComplete;
+	}
+
+	/** @brief Destroy all Vulkan resources created by compile, the declared images and passes are kept so the graph can be compiled again */
+	void RenderGraph::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto& frame : asyncFrames) {
+			if (profiler) {
+				profiler->release(frame.before);
+				profiler->release(frame.overlapping);
+				profiler->release(frame.compute);
+			}
+			// Destroying the pools frees their command buffers
+			vkDestroyCommandPool(device->logicalDevice, frame.graphicsCommandPool, nullptr);
+			vkDestroyCommandPool(device->logicalDevice, frame.computeCommandPool, nullptr);
+			vkDestroySemaphore(device->logicalDevice, frame.beforeComplete, nullptr);
+			vkDestroySemaphore(device->logicalDevice, frame.computeComplete, nullptr);
+		}
+		asyncFrames.clear();
+		asyncComputeActive = false;
+		for (auto& pass : passes) {
+			if (pass.framebuffer != VK_NULL_HANDLE) {
+				vkDestroyFramebuffer(device->logicalDevice, pass.framebuffer, nullptr);
+				pass.framebuffer = VK_NULL_HANDLE;
+			}
+			if (pass.renderPass != VK_NULL_HANDLE) {
+				vkDestroyRenderPass(device->logicalDevice, pass.renderPass, nullptr);
+				pass.renderPass = VK_NULL_HANDLE;
+			}
+		}
+		for (auto& image : images) {
+			if (image.view != VK_NULL_HANDLE) {
+				vkDestroyImageView(device->logicalDevice, image.view, nullptr);
+				image.view = VK_NULL_HANDLE;
+			}
+			if (image.image != VK_NULL_HANDLE) {
+				vkDestroyImage(device->logicalDevice, image.image, nullptr);
+				image.image = VK_NULL_HANDLE;
+			}
+		}
+		for (auto& block : memoryBlocks) {
+			device->memoryAllocator.report.untrack(block.memory);
+			vkFreeMemory(device->logicalDevice, block.memory, nullptr);
+		}
+		memoryBlocks.clear();
+		executionOrder.clear();
+		outputBarriers.clear();
+	}
+
+	VkRenderPass RenderGraph::getRenderPass(PassHandle pass) const
+	{
+		return passes[pass].renderPass;
+	}
+
+	VkImageView RenderGraph::getImageView(ImageHandle image) const
+	{
+		return images[image].view;
+	}
+
+	bool RenderGraph::isCulled(PassHandle pass) const
+	{
+		return passes[pass].culled;
+	}
+
+	bool RenderGraph::isAsyncComputeActive() const
+	{
+		return asyncComputeActive;
+	}
+
+	VkDeviceSize RenderGraph::getMemorySize() const
+	{
+		VkDeviceSize size = 0;
+		for (auto& block : memoryBlocks) {
+			size += block.size;
+		}
+		return size;
+	}
+
+	VkDeviceSize RenderGraph::getUnaliasedMemorySize() const
+	{
+		VkDeviceSize size = 0;
+		for (auto& image : images) {
+			if (image.image != VK_NULL_HANDLE) {
+				size += image.memoryRequirements.size;
+			}
+		}
+		return size;
+	}
+}
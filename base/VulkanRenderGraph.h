@@ -0,0 +1,194 @@
+/*
+* Vulkan render graph
+*
+* Offscreen render passes declared by the images they write and sample, with derived barriers, pass culling and aliasing of transient attachments
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanProfiler.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Graph of offscreen render passes that replaces hand written render passes, subpass dependencies and layout transitions
+	*
+	* Passes declare the images they render to (color and depth stencil attachments) and the images they sample in their fragment shaders.
+	* Images that are read after the graph has been executed (e.g. by the scene render pass) are marked as outputs. On compile the graph:
+	*	- Culls all passes that don't contribute to an output
+	*	- Derives the load and store ops of the attachments from their previous and next use, so e.g. depth buffers only used by a single pass are never stored
+	*	- Places images with non-overlapping lifetimes in the same device memory (aliasing), only outputs need to keep their contents until the end of the graph
+	*	- Derives the image barriers between the passes (layout transitions, write after read and read after write hazards, memory reuse by aliased images),
+	*	  these are merged into one pipeline barrier per pass and only recorded where required
+	* Barriers are recorded between the render passes, so the render passes created by the graph don't contain subpass dependencies
+	*
+	* Compute passes declare the images their compute shaders sample and the storage images they read and write instead of attachments.
+	* With asyncCompute set (and a compute queue family separate from the graphics one), compute passes added as asynchronous are scheduled on the compute queue:
+	*	- Passes the async compute passes depend on are submitted first and signal a semaphore the compute submission waits on
+	*	- Passes that don't share any image with the async compute passes are submitted next and run concurrently with them
+	*	- Passes depending on the async compute passes are recorded by execute, the submission they're recorded into waits for the compute work
+	* Images used by async compute passes are shared by both queue families (concurrent sharing mode) and are never aliased, as their lifetimes overlap the concurrent passes
+	*
+	* @note Outputs are transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for being sampled in a fragment shader after the graph has been executed
+	*/
+	class RenderGraph
+	{
+	public:
+		typedef uint32_t ImageHandle;
+		typedef uint32_t PassHandle;
+
+		struct ImageDesc {
+			uint32_t width;
+			uint32_t height;
+			VkFormat format;
+		};
+
+		/** @brief Alias images with non-overlapping lifetimes, needs to be set before calling compile */
+		bool aliasing = true;
+		/** @brief Run async compute passes on the compute queue (if the device has a separate compute queue family), needs to be set before calling compile */
+		bool asyncCompute = false;
+		/** @brief Number of frames in flight, each one gets its own command buffers and semaphores for the work submitted by submitAsyncCompute */
+		uint32_t framesInFlight = 2;
+		/** @brief (Optional) Profiler the passes submitted by submitAsyncCompute are timed with, the overlap of graphics and compute work is reported as "Async compute overlap" */
+		vks::GpuProfiler* profiler = nullptr;
+
+	private:
+		enum AccessType { ACCESS_COLOR_ATTACHMENT = 0, ACCESS_DEPTH_STENCIL_ATTACHMENT = 1, ACCESS_SAMPLED = 2, ACCESS_COMPUTE_SAMPLED = 3, ACCESS_STORAGE = 4 };
+		// Submission the passes are recorded into, in order of submission
+		enum Segment { SEGMENT_BEFORE_ASYNC_COMPUTE = 0, SEGMENT_ASYNC_COMPUTE = 1, SEGMENT_OVERLAPPING_ASYNC_COMPUTE = 2, SEGMENT_GRAPHICS = 3 };
+
+		struct Access {
+			ImageHandle image;
+			AccessType type;
+			// Attachments only: Cleared at the start of the pass, otherwise the previous contents are loaded (if there are any)
+			bool clear = false;
+			VkClearValue clearValue{};
+		};
+
+		struct Image {
+			std::string name;
+			ImageDesc desc;
+			bool output = false;
+			VkImageUsageFlags usage = 0;
+			VkImageAspectFlags aspectMask = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkMemoryRequirements memoryRequirements{};
+			// First and last pass (in execution order) using the image, outputs are used until the end of the graph
+			uint32_t firstUse = UINT32_MAX;
+			uint32_t lastUse = 0;
+			uint32_t memoryBlock = UINT32_MAX;
+			// Used by an async compute pass, so it's accessed from both queues
+			bool shared = false;
+		};
+
+		struct Pass {
+			std::string name;
+			std::vector<Access> accesses;
+			std::function<void(VkCommandBuffer)> record;
+			bool compute = false;
+			bool async = false;
+			Segment segment = SEGMENT_GRAPHICS;
+			bool culled = false;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			std::vector<VkClearValue> clearValues;
+			// Barriers recorded before the pass begins
+			std::vector<VkImageMemoryBarrier> barriers;
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+		};
+
+		struct MemoryBlock {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = 0;
+			std::vector<ImageHandle> images;
+		};
+
+		struct AsyncFrame {
+			VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+			VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+			VkCommandBuffer before = VK_NULL_HANDLE;
+			VkCommandBuffer overlapping = VK_NULL_HANDLE;
+			VkCommandBuffer compute = VK_NULL_HANDLE;
+			// Signaled once the passes the compute work depends on have finished
+			VkSemaphore beforeComplete = VK_NULL_HANDLE;
+			VkSemaphore computeComplete = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		std::vector<Image> images;
+		std::vector<Pass> passes;
+		// Indices of the passes that weren't culled, in execution order
+		std::vector<PassHandle> executionOrder;
+		std::vector<MemoryBlock> memoryBlocks;
+		// Transitions the outputs for being sampled after the graph
+		std::vector<VkImageMemoryBarrier> outputBarriers;
+		VkPipelineStageFlags outputSrcStageMask = 0;
+		bool asyncComputeActive = false;
+		VkQueue computeQueue = VK_NULL_HANDLE;
+		std::vector<AsyncFrame> asyncFrames;
+
+		static void getAccessInfo(AccessType type, VkImageLayout& layout, VkPipelineStageFlags& stageMask, VkAccessFlags& accessMask);
+		static bool isWrite(AccessType type);
+		void cullPasses();
+		bool sharesImage(const Pass& a, const Pass& b) const;
+		void scheduleAsyncCompute();
+		void computeLifetimes();
+		void createImages();
+		void createRenderPasses();
+		void createBarriers();
+		void createAsyncFrames();
+		void recordPass(VkCommandBuffer commandBuffer, Pass& pass);
+		void recordSegment(VkCommandBuffer commandBuffer, Segment segment, const std::string& name);
+
+	public:
+		~RenderGraph();
+
+		/** @brief Declare an image that's created by the graph when it's used by a pass that isn't culled */
+		ImageHandle addImage(const std::string& name, const ImageDesc& desc);
+		/** @brief Mark an image as read after the graph has been executed, passes only contribute to the result if they (indirectly) write an output */
+		void setOutput(ImageHandle image);
+		/** @brief Add a pass, record is called with the pass' render pass active and the viewport and scissor set to its attachments' size */
+		PassHandle addPass(const std::string& name, std::function<void(VkCommandBuffer)> record);
+		void addColorAttachment(PassHandle pass, ImageHandle image, const VkClearValue* clearValue = nullptr);
+		void setDepthStencilAttachment(PassHandle pass, ImageHandle image, const VkClearValue* clearValue = nullptr);
+		/** @brief Add a compute pass, record is called outside of any render pass and dispatches the pass' work, async compute passes may run on the compute queue */
+		PassHandle addComputePass(const std::string& name, std::function<void(VkCommandBuffer)> record, bool async = false);
+		/** @brief Declare an image that's sampled by the pass' fragment shaders (or compute shaders for compute passes) */
+		void addSampledImage(PassHandle pass, ImageHandle image);
+		/** @brief Declare a storage image that's read and written by a compute pass in VK_IMAGE_LAYOUT_GENERAL, its previous contents are kept */
+		void addStorageImage(PassHandle pass, ImageHandle image);
+
+		void compile(vks::VulkanDevice* device);
+		void execute(VkCommandBuffer commandBuffer);
+		VkSemaphore submitAsyncCompute(VkQueue queue, uint32_t frameIndex);
+		void destroy();
+
+		/** @brief Render pass of a pass for creating its pipelines, VK_NULL_HANDLE if the pass has been culled */
+		VkRenderPass getRenderPass(PassHandle pass) const;
+		VkImageView getImageView(ImageHandle image) const;
+		bool isCulled(PassHandle pass) const;
+		/** @brief True if async compute passes are submitted to the compute queue, i.e. submitAsyncCompute needs to be called each frame */
+		bool isAsyncComputeActive() const;
+		/** @brief Device memory allocated for the images */
+		VkDeviceSize getMemorySize() const;
+		/** @brief Device memory the images would take up without aliasing */
+		VkDeviceSize getUnaliasedMemorySize() const;
+	};
+}
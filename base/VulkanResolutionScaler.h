@@ -0,0 +1,98 @@
+/*
+* Vulkan resolution scaler
+*
+* Renders the scene at a fraction of the output resolution that's adjusted to meet a GPU time budget and upscales it with a sharpening filter
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Dynamic resolution scaling of a scene render pass
+	*
+	* The scene image is created at the output size and the scene is rendered to its top left area, so changing the scale only changes
+	* the render area, viewport and upscale parameters and doesn't recreate any resources.
+	* The scale is driven by a feedback controller on the measured GPU time of the scene: As the GPU time is roughly proportional to the
+	* number of pixels, the scale that meets the budget is the current scale times the square root of budget / time. The controller moves
+	* towards that scale in damped, quantized steps, so noisy timings don't change the render size every frame.
+	* The upscale pass samples the scene bilinearly and applies contrast adaptive sharpening, it's drawn with the output render pass
+	* (e.g. the swap chain), so anything drawn after it (like the UI overlay) is at native resolution.
+	*
+	* @note The scene render pass has the same attachment formats as the output render pass, so pipelines created for the output render pass can be used with it
+	*/
+	class ResolutionScaler
+	{
+	private:
+		struct PushConstants {
+			float renderSize[2];
+			float texelSize[2];
+			float sharpness;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Output size
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// Unquantized scale the controller moves towards the budget
+		float targetScale = 1.0f;
+		// Timings still measured at the previous render size after a scale change
+		uint32_t settleFrames = 0;
+
+		void createRenderPass(VkFormat depthFormat);
+		void destroyTarget();
+		void updateRenderSize();
+
+	public:
+		/** @brief Range of the scale */
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		/** @brief Granularity of scale changes */
+		float scaleStep = 1.0f / 32.0f;
+		/** @brief Fraction of the budget the controller aims for, leaves headroom for timing spikes */
+		float headroom = 0.9f;
+		/** @brief Strength of the sharpening filter (0..1) */
+		float sharpness = 0.5f;
+		/** @brief Number of timings to skip after a scale change, should cover the frames that were already recorded or in flight */
+		uint32_t latency = 4;
+
+		/** @brief Current fraction of the output resolution the scene is rendered at */
+		float scale = 1.0f;
+		uint32_t renderWidth = 0;
+		uint32_t renderHeight = 0;
+		/** @brief Scene render pass and framebuffer, render area and viewport need to be set to renderWidth x renderHeight */
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+		~ResolutionScaler();
+		void prepare(vks::VulkanDevice* device, VkFormat colorFormat, VkFormat depthFormat, const std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages, VkRenderPass outputRenderPass, VkPipelineCache pipelineCache);
+		void resize(uint32_t width, uint32_t height, VkImageView depthStencilView, VkQueue queue);
+		void destroy();
+		bool update(double gpuTime, double targetTime);
+		void upscale(VkCommandBuffer commandBuffer);
+		/** @brief Scene image, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL outside of the scene render pass */
+		VkImageView getImageView() const;
+	};
+}
@@ -0,0 +1,209 @@
+/*
+* Vulkan resource cache
+*
+* Shares images and samplers between all users of a device, so identical resources are only created once
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanResourceCache.h"
+
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+
+namespace vks
+{
+	ResourceCache::~ResourceCache()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the cache
+	*
+	* @param device Logical device the cached resources are created on
+	* @param allocator Memory allocator the memory of the cached images has been allocated from
+	*/
+	void ResourceCache::setup(VkDevice device, vks::MemoryAllocator* allocator)
+	{
+		this->device = device;
+		this->allocator = allocator;
+	}
+
+	/**
+	* Look up an image and add a reference to it
+	*
+	* @param key Key the image has been added with
+	* @param image Set to the cached image if there is one
+	*
+	* @return True if the image was found
+	*/
+	bool ResourceCache::acquireImage(const std::string& key, Image* image)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = images.find(key);
+		if (entry == images.end()) {
+			return false;
+		}
+		entry->second.references++;
+		statistics.imageHits++;
+		*image = entry->second.image;
+		return true;
+	}
+
+	/**
+	* Hand a newly created image over to the cache, the caller holds the first reference
+	*
+	* @param key Key the image can be acquired with
+	* @param image Image, its view and its memory are owned by the cache from now on
+	*/
+	void ResourceCache::addImage(const std::string& key, const Image& image)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(images.find(key) == images.end());
+		images[key] = { image, 1 };
+		imageKeys[image.image] = key;
+	}
+
+	/**
+	* Release a reference to a cached image, the image is destroyed along with the last reference
+	*
+	* @return False if the image doesn't belong to the cache, in which case the caller has to destroy it
+	*/
+	bool ResourceCache::releaseImage(VkImage image)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto key = imageKeys.find(image);
+		if (key == imageKeys.end()) {
+			return false;
+		}
+		auto entry = images.find(key->second);
+		if (--entry->second.references == 0) {
+			vkDestroyImageView(device, entry->second.image.view, nullptr);
+			vkDestroyImage(device, entry->second.image.image, nullptr);
+			allocator->free(entry->second.image.allocation);
+			images.erase(entry);
+			imageKeys.erase(key);
+		}
+		return true;
+	}
+
+	// Compares all members following pNext, which are all 32 bit values without padding in between
+	bool ResourceCache::samplerInfoEqual(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b)
+	{
+		const size_t offset = offsetof(VkSamplerCreateInfo, flags);
+		return memcmp(reinterpret_cast<const char*>(&a) + offset, reinterpret_cast<const char*>(&b) + offset, sizeof(VkSamplerCreateInfo) - offset) == 0;
+	}
+
+	/**
+	* Get a sampler for the given create info, samplers with identical create infos are shared
+	*
+	* @param createInfo Sampler create info
+	*
+	* @return Sampler that has to be released with releaseSampler
+	*/
+	VkSampler ResourceCache::acquireSampler(const VkSamplerCreateInfo& createInfo)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (createInfo.pNext == nullptr) {
+			for (auto& entry : samplers) {
+				if (samplerInfoEqual(entry.createInfo, createInfo)) {
+					entry.references++;
+					statistics.samplerHits++;
+					return entry.sampler;
+				}
+			}
+		}
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(device, &createInfo, nullptr, &sampler));
+		if (createInfo.pNext == nullptr) {
+			samplers.push_back({ createInfo, sampler, 1 });
+		}
+		return sampler;
+	}
+
+	/** @brief Release a reference to a sampler, samplers that haven't been created by the cache are destroyed right away */
+	void ResourceCache::releaseSampler(VkSampler sampler)
+	{
+		if (sampler == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto entry = samplers.begin(); entry != samplers.end(); entry++) {
+			if (entry->sampler == sampler) {
+				if (--entry->references == 0) {
+					vkDestroySampler(device, sampler, nullptr);
+					samplers.erase(entry);
+				}
+				return;
+			}
+		}
+		vkDestroySampler(device, sampler, nullptr);
+	}
+
+	/** @brief Number of unique images currently in the cache */
+	uint32_t ResourceCache::imageCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<uint32_t>(images.size());
+	}
+
+	/** @brief Number of unique samplers currently in the cache */
+	uint32_t ResourceCache::samplerCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<uint32_t>(samplers.size());
+	}
+
+	/** @brief Destroy all resources that are still referenced */
+	void ResourceCache::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (auto& entry : images) {
+			vkDestroyImageView(device, entry.second.image.view, nullptr);
+			vkDestroyImage(device, entry.second.image.image, nullptr);
+			allocator->free(entry.second.image.allocation);
+		}
+		images.clear();
+		imageKeys.clear();
+		for (auto& entry : samplers) {
+			vkDestroySampler(device, entry.sampler, nullptr);
+		}
+		samplers.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Create a cache key from content, e.g. the pixels of images that don't have a file path
+	*
+	* @param data Pointer to the data
+	* @param size Size of the data in bytes
+	*
+	* @return Key made up of the size and a 64 bit FNV-1a based hash of the data
+	*/
+	std::string ResourceCache::hashKey(const void* data, size_t size)
+	{
+		const uint64_t prime = 0x100000001b3ULL;
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		// Hash eight bytes per step, large images would take too long byte by byte
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(uint64_t));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ bytes[i]) * prime;
+		}
+		char key[48];
+		snprintf(key, sizeof(key), "%zu:%016llx", size, static_cast<unsigned long long>(hash));
+		return key;
+	}
+}
@@ -0,0 +1,90 @@
+/*
+* Vulkan resource cache
+*
+* Shares images and samplers between all users of a device, so identical resources are only created once
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	/**
+	* @brief Reference counted cache for images and samplers
+	*
+	* Images are looked up by a key chosen by the loader (e.g. the file path or a hash of the pixel data), samplers by their create info.
+	* Each acquire adds a reference that has to be released, the resource is destroyed once the last reference has been released.
+	*
+	* @note Samplers with a pNext chain are not shared
+	*/
+	class ResourceCache
+	{
+	public:
+		/** @brief Image (along with a view of all of its levels) shared through the cache */
+		struct Image
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			vks::Allocation allocation;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+		};
+
+		/** @brief Number of acquires that were served from the cache */
+		struct Statistics
+		{
+			uint32_t imageHits = 0;
+			uint32_t samplerHits = 0;
+		} statistics;
+
+	private:
+		struct ImageEntry
+		{
+			Image image;
+			uint32_t references;
+		};
+		struct SamplerEntry
+		{
+			VkSamplerCreateInfo createInfo;
+			VkSampler sampler;
+			uint32_t references;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		vks::MemoryAllocator* allocator = nullptr;
+		std::mutex mutex;
+		std::unordered_map<std::string, ImageEntry> images;
+		std::unordered_map<VkImage, std::string> imageKeys;
+		std::vector<SamplerEntry> samplers;
+
+		static bool samplerInfoEqual(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b);
+
+	public:
+		~ResourceCache();
+		void setup(VkDevice device, vks::MemoryAllocator* allocator);
+		bool acquireImage(const std::string& key, Image* image);
+		void addImage(const std::string& key, const Image& image);
+		bool releaseImage(VkImage image);
+		VkSampler acquireSampler(const VkSamplerCreateInfo& createInfo);
+		void releaseSampler(VkSampler sampler);
+		uint32_t imageCount();
+		uint32_t samplerCount();
+		void destroy();
+
+		static std::string hashKey(const void* data, size_t size);
+	};
+}
@@ -0,0 +1,372 @@
+/*
+* Vulkan scene
+*
+* GPU resident representation of a glTF scene that's shared by the rasterization and ray tracing paths
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanScene.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vks
+{
+	Scene::~Scene()
+	{
+		destroy();
+	}
+
+	VkDeviceAddress Scene::getBufferDeviceAddress(VkBuffer buffer)
+	{
+		VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+		bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		bufferDeviceAddressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddressKHR(device->logicalDevice, &bufferDeviceAddressInfo);
+	}
+
+	/**
+	* Get the build sizes for the given geometries and create an acceleration structure large enough to hold them
+	*
+	* @param scratchSize Set to the scratch size required to build the acceleration structure
+	*/
+	void Scene::createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const uint32_t* maxPrimitiveCounts, VkDeviceSize& scratchSize)
+	{
+		VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device->logicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, maxPrimitiveCounts, &buildSizesInfo);
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&accelerationStructure.buffer,
+			buildSizesInfo.accelerationStructureSize));
+
+		VkAccelerationStructureCreateInfoKHR accelerationStructureCI{};
+		accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		accelerationStructureCI.buffer = accelerationStructure.buffer.buffer;
+		accelerationStructureCI.size = buildSizesInfo.accelerationStructureSize;
+		accelerationStructureCI.type = type;
+		VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(device->logicalDevice, &accelerationStructureCI, nullptr, &accelerationStructure.handle));
+
+		VkAccelerationStructureDeviceAddressInfoKHR accelerationStructureDeviceAddressInfo{};
+		accelerationStructureDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		accelerationStructureDeviceAddressInfo.accelerationStructure = accelerationStructure.handle;
+		accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device->logicalDevice, &accelerationStructureDeviceAddressInfo);
+
+		buildInfo.dstAccelerationStructure = accelerationStructure.handle;
+		scratchSize = buildSizesInfo.buildScratchSize;
+	}
+
+	void Scene::destroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+	{
+		if (accelerationStructure.handle != VK_NULL_HANDLE) {
+			vkDestroyAccelerationStructureKHR(device->logicalDevice, accelerationStructure.handle, nullptr);
+			accelerationStructure.handle = VK_NULL_HANDLE;
+		}
+		accelerationStructure.buffer.destroy();
+		accelerationStructure.buffer = vks::Buffer();
+		accelerationStructure.deviceAddress = 0;
+	}
+
+	/**
+	* Upload static data to a device local storage buffer (written directly if the device supports it, see VulkanDevice::createDeviceLocalBuffer)
+	*/
+	void Scene::createStorageBuffer(vks::Buffer& buffer, const void* data, VkDeviceSize size, VkQueue queue)
+	{
+		VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, &buffer, size, data, queue));
+	}
+
+	/**
+	* Create one bottom level acceleration structure per mesh with one geometry per primitive, along with the geometry table
+	* All structures are built with a single command, using one scratch buffer that's split up between them
+	*/
+	void Scene::createBottomLevelAccelerationStructures(VkQueue queue)
+	{
+		VkDeviceOrHostAddressConstKHR vertexData{};
+		VkDeviceOrHostAddressConstKHR indexData{};
+		VkFormat positionFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		VkDeviceSize positionOffset = 0;
+		if (model->vertexLayout.compact) {
+			// Quantized positions need to be in a format supported for acceleration structure builds (VK_FORMAT_FEATURE_ACCELERATION_STRUCTURE_VERTEX_BUFFER_BIT_KHR)
+			positionOffset = model->vertexLayout.offsets[static_cast<uint32_t>(vkglTF::VertexComponent::Position)];
+			positionFormat = model->vertexLayout.formats[static_cast<uint32_t>(vkglTF::VertexComponent::Position)];
+		}
+		vertexData.deviceAddress = vertexBufferAddress + positionOffset;
+		indexData.deviceAddress = indexBufferAddress;
+
+		// Geometries and build ranges per mesh, these need to stay alive until the build has been recorded
+		std::vector<Geometry> geometryTable;
+		std::vector<std::vector<VkAccelerationStructureGeometryKHR>> geometries;
+		std::vector<std::vector<VkAccelerationStructureBuildRangeInfoKHR>> buildRanges;
+		for (vkglTF::Node* node : model->hierarchy.nodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			Instance instance{};
+			instance.nodeIndex = node->hierarchyIndex;
+			instance.firstGeometry = static_cast<uint32_t>(geometryTable.size());
+			std::vector<VkAccelerationStructureGeometryKHR> meshGeometries;
+			std::vector<VkAccelerationStructureBuildRangeInfoKHR> meshBuildRanges;
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+				// Alpha masked and blended geometries invoke any hit shaders (or return candidates to ray queries), so they can be alpha tested via the geometry and material tables
+				geometry.flags = (primitive->material.alphaMode == vkglTF::Material::ALPHAMODE_OPAQUE) ? VK_GEOMETRY_OPAQUE_BIT_KHR : VK_GEOMETRY_NO_DUPLICATE_ANY_HIT_INVOCATION_BIT_KHR;
+				geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+				geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+				geometry.geometry.triangles.vertexFormat = positionFormat;
+				geometry.geometry.triangles.vertexData = vertexData;
+				geometry.geometry.triangles.vertexStride = model->vertexLayout.stride;
+				// Indices are relative to the start of the model's vertex buffer
+				geometry.geometry.triangles.maxVertex = primitive->firstVertex + primitive->vertexCount - 1;
+				geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+				geometry.geometry.triangles.indexData = indexData;
+				meshGeometries.push_back(geometry);
+
+				// Only full detail indices are used, rays should hit the same surfaces regardless of the level of detail drawn
+				VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+				buildRange.primitiveCount = primitive->indexCount / 3;
+				buildRange.primitiveOffset = primitive->firstIndex * sizeof(uint32_t);
+				meshBuildRanges.push_back(buildRange);
+
+				geometryTable.push_back({ primitive->firstIndex, static_cast<uint32_t>(&primitive->material - model->materials.data()) });
+			}
+			if (meshGeometries.empty()) {
+				continue;
+			}
+			instance.geometryCount = static_cast<uint32_t>(meshGeometries.size());
+			instances.push_back(instance);
+			geometries.push_back(meshGeometries);
+			buildRanges.push_back(meshBuildRanges);
+		}
+		geometryCount = static_cast<uint32_t>(geometryTable.size());
+		if (geometryTable.empty()) {
+			return;
+		}
+		createStorageBuffer(geometryBuffer, geometryTable.data(), geometryTable.size() * sizeof(Geometry), queue);
+
+		bottomLevelASs.resize(geometries.size());
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(geometries.size());
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos(geometries.size());
+		std::vector<VkDeviceSize> scratchOffsets(geometries.size());
+		VkDeviceSize totalScratchSize = 0;
+		for (size_t i = 0; i < geometries.size(); i++) {
+			buildInfos[i] = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			buildInfos[i].type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			buildInfos[i].flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+			buildInfos[i].mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			buildInfos[i].geometryCount = static_cast<uint32_t>(geometries[i].size());
+			buildInfos[i].pGeometries = geometries[i].data();
+			buildRangeInfos[i] = buildRanges[i].data();
+
+			std::vector<uint32_t> maxPrimitiveCounts;
+			for (auto& buildRange : buildRanges[i]) {
+				maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+			}
+			VkDeviceSize scratchSize = 0;
+			createAccelerationStructure(bottomLevelASs[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildInfos[i], maxPrimitiveCounts.data(), scratchSize);
+			scratchOffsets[i] = totalScratchSize;
+			totalScratchSize += vks::tools::alignedVkSize(scratchSize, scratchAlignment);
+		}
+
+		// The buffer's device address may not be aligned to the scratch offset alignment, so the start is moved up if required
+		vks::Buffer scratchBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scratchBuffer, totalScratchSize + scratchAlignment));
+		const VkDeviceAddress scratchAddress = vks::tools::alignedVkSize(getBufferDeviceAddress(scratchBuffer.buffer), scratchAlignment);
+		for (size_t i = 0; i < buildInfos.size(); i++) {
+			buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+		}
+
+		// All structures use separate scratch ranges, so they can be built with a single command without barriers in between
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), buildRangeInfos.data());
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		scratchBuffer.destroy();
+	}
+
+	/**
+	* Create the top level acceleration structure with one instance per mesh node, along with the instance table
+	*/
+	void Scene::createTopLevelAccelerationStructure(VkQueue queue, bool flipY)
+	{
+		instanceCount = static_cast<uint32_t>(instances.size());
+		if (instances.empty()) {
+			return;
+		}
+		createStorageBuffer(instanceBuffer, instances.data(), instances.size() * sizeof(Instance), queue);
+
+		// If the model was loaded with FileLoadingFlags::FlipY, the vertices have been flipped in the mesh's local space, so the node matrix is flipped along with them
+		const glm::mat4 flipMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, flipY ? -1.0f : 1.0f, 1.0f));
+		std::vector<VkAccelerationStructureInstanceKHR> accelerationStructureInstances(instances.size());
+		for (size_t i = 0; i < instances.size(); i++) {
+			const glm::mat4 matrix = flipMatrix * model->hierarchy.worldMatrices[instances[i].nodeIndex] * flipMatrix;
+			VkAccelerationStructureInstanceKHR& instance = accelerationStructureInstances[i];
+			// The instance transform is a row major 3x4 matrix
+			for (uint32_t row = 0; row < 3; row++) {
+				for (uint32_t column = 0; column < 4; column++) {
+					instance.transform.matrix[row][column] = matrix[column][row];
+				}
+			}
+			// The shaders get the geometry table entry of a hit via gl_InstanceCustomIndexEXT + gl_GeometryIndexEXT
+			instance.instanceCustomIndex = instances[i].firstGeometry;
+			instance.mask = 0xFF;
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = bottomLevelASs[i].deviceAddress;
+		}
+		vks::Buffer instancesBuffer;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instancesBuffer,
+			accelerationStructureInstances.size() * sizeof(VkAccelerationStructureInstanceKHR),
+			accelerationStructureInstances.data()));
+
+		VkAccelerationStructureGeometryKHR instancesGeometry = vks::initializers::accelerationStructureGeometryKHR();
+		instancesGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		instancesGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		instancesGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		instancesGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries = &instancesGeometry;
+		VkDeviceSize scratchSize = 0;
+		createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildInfo, &instanceCount, scratchSize);
+
+		vks::Buffer scratchBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scratchBuffer, scratchSize + scratchAlignment));
+		buildInfo.scratchData.deviceAddress = vks::tools::alignedVkSize(getBufferDeviceAddress(scratchBuffer.buffer), scratchAlignment);
+
+		VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+		buildRange.primitiveCount = instanceCount;
+		const VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfo = &buildRange;
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, &buildRangeInfo);
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		scratchBuffer.destroy();
+		instancesBuffer.destroy();
+	}
+
+	/**
+	* Create the scene data for a loaded model
+	*
+	* @param device Device with acceleration structures, buffer device addresses and drawIndirectFirstInstance enabled
+	* @param queue Queue used for uploads and acceleration structure builds, the function waits for them to finish
+	* @param model Model loaded with bufferUsageFlags added to vkglTF::memoryPropertyFlags, prepares its indirect draws if not done yet
+	* @param flipY Set if the model was loaded with FileLoadingFlags::FlipY, so the instance transforms match the flipped vertices
+	*
+	* @note The top level acceleration structure is built once with the current node transforms
+	*/
+	void Scene::create(vks::VulkanDevice* device, VkQueue queue, vkglTF::Model& model, bool flipY)
+	{
+		assert(vkglTF::memoryPropertyFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+		destroy();
+		this->device = device;
+		this->model = &model;
+
+		vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetBufferDeviceAddressKHR"));
+		vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCreateAccelerationStructureKHR"));
+		vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkDestroyAccelerationStructureKHR"));
+		vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureBuildSizesKHR"));
+		vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetAccelerationStructureDeviceAddressKHR"));
+		vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdBuildAccelerationStructuresKHR"));
+
+		VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
+		accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &accelerationStructureProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+		scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+		// The draw commands, node matrices and materials of the rasterization path, the material buffer is shared with ray tracing
+		if (model.indirectDraws.drawCount == 0) {
+			model.prepareIndirectDraws(queue);
+		}
+
+		vertexBufferAddress = getBufferDeviceAddress(model.vertices.buffer);
+		indexBufferAddress = getBufferDeviceAddress(model.indices.buffer);
+
+		createBottomLevelAccelerationStructures(queue);
+		createTopLevelAccelerationStructure(queue, flipY);
+	}
+
+	void Scene::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyAccelerationStructure(topLevelAS);
+		for (auto& bottomLevelAS : bottomLevelASs) {
+			destroyAccelerationStructure(bottomLevelAS);
+		}
+		bottomLevelASs.clear();
+		instances.clear();
+		geometryBuffer.destroy();
+		geometryBuffer = vks::Buffer();
+		instanceBuffer.destroy();
+		instanceBuffer = vks::Buffer();
+		geometryCount = 0;
+		instanceCount = 0;
+		device = nullptr;
+	}
+
+	/**
+	* Draw the scene with the model's indirect draws
+	*
+	* @param commandBuffer Command buffer to record the draws to
+	* @param renderFlags (Optional) Render flags selecting the alpha modes to draw (Defaults to all)
+	* @param pipelineLayout (Optional) Pipeline layout to bind the model's indirect descriptor set with, pass VK_NULL_HANDLE if the set has already been bound
+	* @param bindSet (Optional) Set index to bind the indirect descriptor set to (Defaults to 0)
+	*/
+	void Scene::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+	{
+		model->drawIndirect(commandBuffer, renderFlags, pipelineLayout, bindSet);
+	}
+
+	/**
+	* Returns a descriptor write for the top level acceleration structure
+	*
+	* @note The returned structure points to a member of this object, so the descriptor set needs to be updated before this is called again
+	*/
+	VkWriteDescriptorSet Scene::writeAccelerationStructure(VkDescriptorSet descriptorSet, uint32_t binding)
+	{
+		descriptor = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
+		descriptor.accelerationStructureCount = 1;
+		descriptor.pAccelerationStructures = &topLevelAS.handle;
+
+		VkWriteDescriptorSet writeDescriptorSet{};
+		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		// The specialized acceleration structure descriptor has to be chained
+		writeDescriptorSet.pNext = &descriptor;
+		writeDescriptorSet.dstSet = descriptorSet;
+		writeDescriptorSet.dstBinding = binding;
+		writeDescriptorSet.descriptorCount = 1;
+		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		return writeDescriptorSet;
+	}
+
+	const vks::Buffer& Scene::materialBuffer() const
+	{
+		return model->indirectDraws.materialBuffer;
+	}
+
+	VkDeviceSize Scene::accelerationStructureMemorySize() const
+	{
+		VkDeviceSize size = topLevelAS.buffer.size;
+		for (auto& bottomLevelAS : bottomLevelASs) {
+			size += bottomLevelAS.buffer.size;
+		}
+		return size;
+	}
+}
@@ -0,0 +1,111 @@
+/*
+* Vulkan scene
+*
+* GPU resident representation of a glTF scene that's shared by the rasterization and ray tracing paths
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+#include "VulkanglTFModel.h"
+
+namespace vks
+{
+	/**
+	* @brief Scene data of a glTF model for both rasterization and ray tracing
+	*
+	* Rasterization and ray tracing read the same vertex and index buffers (those of the model) and the same material buffer,
+	* so the geometry is only stored and uploaded once:
+	*	- Rasterization draws the model with multi draw indirect (see vkglTF::Model::prepareIndirectDraws and drawIndirect),
+	*	  node matrices and materials are fetched from the model's indirect draw buffers
+	*	- Ray tracing uses one bottom level acceleration structure per mesh with one geometry per primitive and a top level
+	*	  acceleration structure with one instance per mesh node. The geometry table holds the first index and material of each
+	*	  geometry, it's indexed with the instance's custom index (the instance's first geometry) plus the geometry index
+	*	- The instance table holds the node and geometries of each top level acceleration structure instance, indexed with the instance index
+	*
+	* @note Requires a device with acceleration structures, buffer device addresses and the drawIndirectFirstInstance feature enabled.
+	* The model's buffers need to be created with bufferUsageFlags (added to vkglTF::memoryPropertyFlags before loading) and its vertices
+	* must not be pre-transformed (FileLoadingFlags::PreTransformVertices), as the node transforms are applied by the draws and instances
+	*/
+	class Scene
+	{
+	public:
+		/** @brief Buffer usage flags required for the model's vertex and index buffers */
+		static const VkBufferUsageFlags bufferUsageFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		/** @brief Geometry as laid out in the geometry table (std430) */
+		struct Geometry {
+			uint32_t firstIndex;
+			uint32_t materialIndex;
+		};
+
+		/** @brief Top level acceleration structure instance as laid out in the instance table (std430) */
+		struct Instance {
+			// Index into the node matrices of the model's indirect draws (see vkglTF::Node::hierarchyIndex)
+			uint32_t nodeIndex;
+			uint32_t firstGeometry;
+			uint32_t geometryCount;
+			uint32_t padding;
+		};
+
+		vkglTF::Model* model = nullptr;
+		// Device addresses of the model's vertex and index buffers, e.g. for shaders using buffer references
+		VkDeviceAddress vertexBufferAddress = 0;
+		VkDeviceAddress indexBufferAddress = 0;
+		vks::Buffer geometryBuffer;
+		vks::Buffer instanceBuffer;
+		uint32_t geometryCount = 0;
+		uint32_t instanceCount = 0;
+
+	private:
+		struct AccelerationStructure {
+			VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+			VkDeviceAddress deviceAddress = 0;
+			vks::Buffer buffer;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+		PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR = nullptr;
+		PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
+		PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR = nullptr;
+		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+		VkDeviceSize scratchAlignment = 1;
+
+		// One bottom level acceleration structure per entry of the instance table
+		std::vector<AccelerationStructure> bottomLevelASs;
+		std::vector<Instance> instances;
+		AccelerationStructure topLevelAS;
+		/** @brief Chained into the descriptor write returned by writeAccelerationStructure, needs to stay valid until the descriptor set has been updated */
+		VkWriteDescriptorSetAccelerationStructureKHR descriptor{};
+
+		VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer);
+		void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const uint32_t* maxPrimitiveCounts, VkDeviceSize& scratchSize);
+		void destroyAccelerationStructure(AccelerationStructure& accelerationStructure);
+		void createBottomLevelAccelerationStructures(VkQueue queue);
+		void createTopLevelAccelerationStructure(VkQueue queue, bool flipY);
+		void createStorageBuffer(vks::Buffer& buffer, const void* data, VkDeviceSize size, VkQueue queue);
+
+	public:
+		~Scene();
+		void create(vks::VulkanDevice* device, VkQueue queue, vkglTF::Model& model, bool flipY = false);
+		void destroy();
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 0);
+		VkWriteDescriptorSet writeAccelerationStructure(VkDescriptorSet descriptorSet, uint32_t binding);
+		/** @brief Material buffer shared with the model's indirect draws (vkglTF::Model::IndirectDraws::MaterialData[]) */
+		const vks::Buffer& materialBuffer() const;
+		/** @brief Device memory used by the acceleration structures */
+		VkDeviceSize accelerationStructureMemorySize() const;
+	};
+}
@@ -0,0 +1,150 @@
+/*
+* Vulkan scene swapper
+*
+* Replaces the glTF scene of a running example without recreating the device, pipelines or any other scene independent resources
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSceneSwapper.h"
+
+namespace vks
+{
+	SceneSwapper::SceneSwapper() : parsed(false)
+	{
+	}
+
+	SceneSwapper::~SceneSwapper()
+	{
+		destroy();
+	}
+
+	/**
+	* Prepare the swapper
+	*
+	* @param device Device the scenes are loaded on
+	* @param queue Queue used for the uploads, which is also the queue the scenes are rendered with
+	*/
+	void SceneSwapper::setup(vks::VulkanDevice* device, VkQueue queue)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->queue = queue;
+		worker = make_unique<vks::Thread>();
+	}
+
+	/** @brief Hand the current scene to the deletion queue, command buffers of frames in flight may still reference it */
+	void SceneSwapper::retireCurrent()
+	{
+		if (!current) {
+			return;
+		}
+		vkglTF::Model* retired = current.release();
+		device->deletionQueue.push([retired]() { delete retired; });
+	}
+
+	void SceneSwapper::startParsing(const Request& request)
+	{
+		filename = request.filename;
+		scale = request.scale;
+		requestTime = std::chrono::high_resolution_clock::now();
+		pending.reset(new vkglTF::Model());
+		parsedFile.reset(new vkglTF::ParsedFile());
+		parsed = false;
+		vkglTF::Model* model = pending.get();
+		vkglTF::ParsedFile* file = parsedFile.get();
+		vks::VulkanDevice* device = this->device;
+		const std::string requestFilename = request.filename;
+		const uint32_t fileLoadingFlags = request.fileLoadingFlags;
+		worker->addJob([this, model, file, device, requestFilename, fileLoadingFlags]() {
+			model->parseFile(requestFilename, device, fileLoadingFlags, *file);
+			parsed = true;
+		});
+	}
+
+	/**
+	* Request a scene, the current scene is retired right away and the new one is swapped in by a later call to update
+	*
+	* @param filename glTF file of the scene
+	* @param fileLoadingFlags File loading flags (see vkglTF::FileLoadingFlags)
+	* @param scale (Optional) Scale applied to the scene
+	*
+	* @note If another scene is still being parsed, the request is started once it's done, and the parsed scene is discarded
+	*/
+	void SceneSwapper::request(const std::string& filename, uint32_t fileLoadingFlags, float scale)
+	{
+		assert(device != nullptr);
+		retireCurrent();
+		Request newRequest;
+		newRequest.filename = filename;
+		newRequest.fileLoadingFlags = fileLoadingFlags;
+		newRequest.scale = scale;
+		newRequest.valid = true;
+		if (pending) {
+			queuedRequest = newRequest;
+			return;
+		}
+		startParsing(newRequest);
+	}
+
+	/**
+	* Swap in a scene that has finished parsing, should be called once per frame before recording the frame's command buffer
+	*
+	* @return True if a new scene has been swapped in, resources referencing the scene (e.g. descriptor sets or cached command buffers) need to be updated
+	*/
+	bool SceneSwapper::update()
+	{
+		if (!pending || !parsed) {
+			return false;
+		}
+		if (queuedRequest.valid) {
+			// A newer scene has been requested in the meantime
+			pending.reset();
+			parsedFile.reset();
+			startParsing(queuedRequest);
+			queuedRequest = Request();
+			return false;
+		}
+		if (!parsedFile->valid) {
+			vks::tools::exitFatal("Could not load glTF file \"" + parsedFile->filename + "\": " + parsedFile->error, -1);
+			return false;
+		}
+		// Creating and uploading the resources uses the queue, so it's done on the render thread
+		auto uploadStart = std::chrono::high_resolution_clock::now();
+		pending->loadFromParsedFile(*parsedFile, device, queue, scale);
+		auto uploadEnd = std::chrono::high_resolution_clock::now();
+		lastSwap.uploadMs = std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+		lastSwap.totalMs = std::chrono::duration<double, std::milli>(uploadEnd - requestTime).count();
+		current = std::move(pending);
+		parsedFile.reset();
+		return true;
+	}
+
+	/** @brief The current scene, nullptr while the requested scene is being loaded */
+	vkglTF::Model* SceneSwapper::model() const
+	{
+		return current.get();
+	}
+
+	bool SceneSwapper::loading() const
+	{
+		return pending != nullptr;
+	}
+
+	/** @brief Release all scenes, the device must be idle */
+	void SceneSwapper::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		// Wait for the scene being parsed, as the worker writes to it
+		worker.reset();
+		pending.reset();
+		parsedFile.reset();
+		current.reset();
+		queuedRequest = Request();
+		device = nullptr;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+* Vulkan scene swapper
+*
+* Replaces the glTF scene of a running example without recreating the device, pipelines or any other scene independent resources
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Loads glTF scenes in the background and swaps them in while the example keeps rendering
+	*
+	* Reading and decoding a file (the bulk of the load time) runs on a worker thread (see vkglTF::Model::parseFile), only creating and uploading
+	* the device resources is done on the render thread once the file has been parsed. Everything not owned by the scene, like pipelines, the pipeline cache,
+	* samplers and images shared through the device's resource cache, descriptor set layouts and environment maps, stays alive across switches.
+	*
+	* Requesting a scene retires the current one right away, so its memory is available to the next scene, and the retired scene is destroyed through the
+	* device's deletion queue once the frames in flight are done with it. Until the next scene has arrived, model returns nullptr and the example draws a placeholder.
+	*
+	* @note The models have to be loaded with the same descriptor binding flags as the pipelines' layouts have been created with
+	*/
+	class SceneSwapper
+	{
+	private:
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::unique_ptr<vks::Thread> worker;
+		std::unique_ptr<vkglTF::Model> current;
+		// Scene being parsed by the worker, only accessed by the worker until parsed has been set
+		std::unique_ptr<vkglTF::Model> pending;
+		std::unique_ptr<vkglTF::ParsedFile> parsedFile;
+		std::atomic<bool> parsed;
+		float scale = 1.0f;
+		// Request that arrived while another scene was being parsed, only the latest one is kept
+		struct Request {
+			std::string filename;
+			uint32_t fileLoadingFlags = 0;
+			float scale = 1.0f;
+			bool valid = false;
+		} queuedRequest;
+		std::chrono::high_resolution_clock::time_point requestTime;
+		void retireCurrent();
+		void startParsing(const Request& request);
+
+	public:
+		/** @brief File name of the scene that is loaded or being loaded */
+		std::string filename;
+		struct Timings {
+			// Time from the request until the scene was swapped in
+			double totalMs = 0.0;
+			// Time spent on the render thread creating and uploading the scene's resources
+			double uploadMs = 0.0;
+		} lastSwap;
+
+		SceneSwapper();
+		~SceneSwapper();
+		void setup(vks::VulkanDevice* device, VkQueue queue);
+		void request(const std::string& filename, uint32_t fileLoadingFlags, float scale = 1.0f);
+		bool update();
+		vkglTF::Model* model() const;
+		bool loading() const;
+		void destroy();
+	};
+}
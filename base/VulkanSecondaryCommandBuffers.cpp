@@ -0,0 +1,184 @@
+/*
+* Vulkan secondary command buffer cache
+*
+* Static scene content recorded once into cached secondary command buffers, dynamic content recorded into fresh secondaries each frame
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSecondaryCommandBuffers.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	SecondaryCommandBuffers::~SecondaryCommandBuffers()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the command pools
+	*
+	* @param device Logical device to create the pools on
+	* @param queueFamilyIndex Queue family of the primary command buffers the secondaries are executed in
+	* @param frameCount Number of frames in flight
+	*/
+	void SecondaryCommandBuffers::setup(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount)
+	{
+		assert(this->device == VK_NULL_HANDLE);
+		this->device = device;
+		VkCommandPoolCreateInfo cmdPoolInfo = {};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &staticPool));
+		// Dynamic secondaries are reset along with their pool each frame
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &frame.pool));
+		}
+		currentFrame = 0;
+	}
+
+	/** @brief Release all command buffers and pools, command buffers executing the secondaries must have finished */
+	void SecondaryCommandBuffers::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		// Destroying the pools frees all of their command buffers
+		vkDestroyCommandPool(device, staticPool, nullptr);
+		for (auto& frame : frames) {
+			vkDestroyCommandPool(device, frame.pool, nullptr);
+		}
+		statics.clear();
+		retired.clear();
+		frames.clear();
+		staticPool = VK_NULL_HANDLE;
+		device = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Start recording the secondaries of a frame in flight, the GPU must have finished the frame that last used its dynamic secondaries
+	*
+	* @param frameIndex Index of the frame in flight (0..frameCount-1)
+	*/
+	void SecondaryCommandBuffers::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frames.size());
+		currentFrame = frameIndex;
+		Frame& frame = frames[currentFrame];
+		// Resetting the pool resets all of its command buffers, which are recorded again by this frame
+		VK_CHECK_RESULT(vkResetCommandPool(device, frame.pool, 0));
+		frame.used = 0;
+		// A frame in flight has finished, so static secondaries invalidated that many frames ago are no longer pending
+		for (auto& retiredCommandBuffer : retired) {
+			if (--retiredCommandBuffer.framesLeft == 0) {
+				vkFreeCommandBuffers(device, staticPool, 1, &retiredCommandBuffer.commandBuffer);
+			}
+		}
+		retired.erase(std::remove_if(retired.begin(), retired.end(), [](const Retired& retiredCommandBuffer) { return retiredCommandBuffer.framesLeft == 0; }), retired.end());
+		statistics = Statistics();
+	}
+
+	void SecondaryCommandBuffers::retire(Static& cached)
+	{
+		if (cached.commandBuffer != VK_NULL_HANDLE) {
+			retired.push_back({ cached.commandBuffer, static_cast<uint32_t>(frames.size()) });
+			cached.commandBuffer = VK_NULL_HANDLE;
+		}
+		cached.valid = false;
+	}
+
+	/**
+	* Get a static secondary, which is recorded if it hasn't been yet, has been invalidated or is used in a different render pass or subpass
+	*
+	* @param id Id of the static content, chosen by the caller (e.g. an index into its draw lists)
+	* @param inheritanceInfo Render pass and subpass the secondary is executed in, the framebuffer is ignored
+	* @param record Function recording the commands (including viewport and scissor) into the secondary, which has already been begun
+	*
+	* @return The secondary to execute in the render pass
+	*/
+	VkCommandBuffer SecondaryCommandBuffers::getStatic(uint32_t id, const VkCommandBufferInheritanceInfo& inheritanceInfo, const std::function<void(VkCommandBuffer)>& record)
+	{
+		assert(device != VK_NULL_HANDLE);
+		if (id >= statics.size()) {
+			statics.resize(id + 1);
+		}
+		Static& cached = statics[id];
+		if (cached.valid && (cached.renderPass == inheritanceInfo.renderPass) && (cached.subpass == inheritanceInfo.subpass)) {
+			statistics.staticReused++;
+			return cached.commandBuffer;
+		}
+		retire(cached);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(staticPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cached.commandBuffer));
+		VkCommandBufferInheritanceInfo inheritance = inheritanceInfo;
+		inheritance.framebuffer = VK_NULL_HANDLE;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritance;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cached.commandBuffer, &cmdBufInfo));
+		record(cached.commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cached.commandBuffer));
+		cached.renderPass = inheritanceInfo.renderPass;
+		cached.subpass = inheritanceInfo.subpass;
+		cached.valid = true;
+		statistics.staticRecorded++;
+		return cached.commandBuffer;
+	}
+
+	/**
+	* Record a dynamic secondary for the current frame
+	*
+	* @param inheritanceInfo Render pass, subpass and (optionally) framebuffer the secondary is executed in
+	* @param record Function recording the commands (including viewport and scissor) into the secondary, which has already been begun
+	*
+	* @return The secondary to execute in the render pass, valid for the current frame only
+	*/
+	VkCommandBuffer SecondaryCommandBuffers::recordDynamic(const VkCommandBufferInheritanceInfo& inheritanceInfo, const std::function<void(VkCommandBuffer)>& record)
+	{
+		assert(device != VK_NULL_HANDLE);
+		Frame& frame = frames[currentFrame];
+		// Command buffers of earlier frames are reused, so steady state frames don't allocate
+		if (frame.used == frame.commandBuffers.size()) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(frame.pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			frame.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = frame.commandBuffers[frame.used++];
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		record(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		statistics.dynamicRecorded++;
+		return commandBuffer;
+	}
+
+	/** @brief Re-record a static secondary the next time it's used, e.g. because its content has changed */
+	void SecondaryCommandBuffers::invalidate(uint32_t id)
+	{
+		if (id < statics.size()) {
+			retire(statics[id]);
+		}
+	}
+
+	/** @brief Re-record all static secondaries the next time they're used, e.g. because the render size or a pipeline used by all of them has changed */
+	void SecondaryCommandBuffers::invalidateAll()
+	{
+		for (auto& cached : statics) {
+			retire(cached);
+		}
+	}
+
+	bool SecondaryCommandBuffers::isReady() const
+	{
+		return device != VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+* Vulkan secondary command buffer cache
+*
+* Static scene content recorded once into cached secondary command buffers, dynamic content recorded into fresh secondaries each frame
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Secondary command buffers for a static/dynamic split of the commands recorded each frame
+	*
+	* Static secondaries are identified by an id chosen by the caller, recorded on first use and executed unchanged by every following frame until they're invalidated
+	* (e.g. because the content or a pipeline changed). They're recorded with VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, as the primaries of all frames in flight execute them.
+	* An invalidated secondary may still be pending, so it's replaced by a newly allocated one and only freed once all frames in flight have finished.
+	* Dynamic secondaries are taken from a transient pool per frame in flight and recorded anew each frame, the pool is reset by beginFrame once the frame's fence has been waited on.
+	*
+	* Secondaries are recorded without a framebuffer in their inheritance info, so a static secondary is valid for all swap chain images.
+	* The viewport, scissor and other dynamic state aren't inherited from the primary and need to be set in each secondary.
+	*/
+	class SecondaryCommandBuffers
+	{
+	private:
+		struct Static
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			uint32_t subpass = 0;
+			bool valid = false;
+		};
+		struct Retired
+		{
+			VkCommandBuffer commandBuffer;
+			uint32_t framesLeft;
+		};
+		struct Frame
+		{
+			VkCommandPool pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t used = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkCommandPool staticPool = VK_NULL_HANDLE;
+		std::vector<Static> statics;
+		std::vector<Retired> retired;
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+
+		void retire(Static& cached);
+
+	public:
+		/** @brief Number of secondaries recorded and reused during the current frame, e.g. to show what the recording cost scales with */
+		struct Statistics
+		{
+			uint32_t staticRecorded = 0;
+			uint32_t staticReused = 0;
+			uint32_t dynamicRecorded = 0;
+		} statistics;
+
+		~SecondaryCommandBuffers();
+		void setup(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount);
+		void destroy();
+		void beginFrame(uint32_t frameIndex);
+		VkCommandBuffer getStatic(uint32_t id, const VkCommandBufferInheritanceInfo& inheritanceInfo, const std::function<void(VkCommandBuffer)>& record);
+		VkCommandBuffer recordDynamic(const VkCommandBufferInheritanceInfo& inheritanceInfo, const std::function<void(VkCommandBuffer)>& record);
+		void invalidate(uint32_t id);
+		void invalidateAll();
+		bool isReady() const;
+	};
+}
@@ -0,0 +1,337 @@
+/*
+* Vulkan shading rate generator
+*
+* Derives a shading rate image from the luminance gradients of the previous frame and counts the fragment shader invocations of the scene
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShadingRateGenerator.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	ShadingRateGenerator::~ShadingRateGenerator()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the compute pipeline and the shading rate palette, the shading rate image is created by resize
+	*
+	* @param device Device with VK_NV_shading_rate_image enabled
+	* @param texelSize Size of a shading rate image texel in pixels (shadingRateTexelSize of VkPhysicalDeviceShadingRateImagePropertiesNV)
+	* @param shaderStage Compute shader stage (base/shadingrate.comp)
+	* @param pipelineCache Pipeline cache to use for creating the pipeline
+	*/
+	void ShadingRateGenerator::prepare(vks::VulkanDevice* device, VkExtent2D texelSize, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+	{
+		assert(pipeline == VK_NULL_HANDLE);
+		this->device = device;
+		this->texelSize = texelSize;
+
+		vkCmdBindShadingRateImageNV = reinterpret_cast<PFN_vkCmdBindShadingRateImageNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdBindShadingRateImageNV"));
+
+		// Indices written by the compute shader, entry 0 is also used if no image is bound
+		paletteEntries = {
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X1_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_1X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X4_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X4_PIXELS_NV,
+		};
+		palette.shadingRatePaletteEntryCount = static_cast<uint32_t>(paletteEntries.size());
+		palette.pShadingRatePaletteEntries = paletteEntries.data();
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_SHADING_RATE_IMAGE_STATE_CREATE_INFO_NV;
+		viewportState.shadingRateImageEnable = VK_TRUE;
+		viewportState.viewportCount = 1;
+		viewportState.pShadingRatePalettes = &palette;
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Scene image of the previous frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Shading rate image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage = shaderStage;
+		VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	/**
+	* (Re)create the shading rate image for a new output size
+	*
+	* @param width Width of the output
+	* @param height Height of the output
+	* @param sourceView Scene image the shading rate is derived from, needs to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL whenever generate is executed
+	*/
+	void ShadingRateGenerator::resize(uint32_t width, uint32_t height, VkImageView sourceView)
+	{
+		destroyImage();
+		extent.width = (width + texelSize.width - 1) / texelSize.width;
+		extent.height = (height + texelSize.height - 1) / texelSize.height;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = VK_FORMAT_R8_UINT;
+		imageCI.extent = { extent.width, extent.height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SHADING_RATE_IMAGE_BIT_NV;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = VK_FORMAT_R8_UINT;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+
+		VkDescriptorImageInfo sourceDescriptor = vks::initializers::descriptorImageInfo(sampler, sourceView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo imageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &imageDescriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void ShadingRateGenerator::destroyImage()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		vkDestroyImage(device->logicalDevice, image, nullptr);
+		vkFreeMemory(device->logicalDevice, memory, nullptr);
+		view = VK_NULL_HANDLE;
+		image = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+	}
+
+	/** @brief Release all Vulkan resources, command buffers using the generator must have finished executing */
+	void ShadingRateGenerator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyImage();
+		for (auto& entry : statistics) {
+			vkDestroyQueryPool(device->logicalDevice, entry.second.queryPool, nullptr);
+		}
+		statistics.clear();
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		pipeline = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/**
+	* Derive the shading rate image from the scene image, needs to be recorded outside of a render pass before the scene render pass
+	*
+	* @param commandBuffer Command buffer to record to
+	* @param renderWidth Width of the area the scene has been rendered to
+	* @param renderHeight Height of the area the scene has been rendered to
+	*/
+	void ShadingRateGenerator::generate(VkCommandBuffer commandBuffer, uint32_t renderWidth, uint32_t renderHeight)
+	{
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// The previous frame's scene pass has to be done writing the scene image, and the previous use of the shading rate image has to be finished
+		// The shading rate image is completely overwritten, so its previous contents can be discarded
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &imageBarrier);
+
+		PushConstants pushConstants;
+		pushConstants.tileSize[0] = texelSize.width;
+		pushConstants.tileSize[1] = texelSize.height;
+		pushConstants.renderSize[0] = renderWidth;
+		pushConstants.renderSize[1] = renderHeight;
+		pushConstants.threshold = threshold;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		// One workgroup per texel of the shading rate image that covers the render area
+		vkCmdDispatch(commandBuffer, std::min((renderWidth + texelSize.width - 1) / texelSize.width, extent.width), std::min((renderHeight + texelSize.height - 1) / texelSize.height, extent.height), 1);
+
+		// The scene pass reads the shading rate image and overwrites the scene image the compute shader has been reading from
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADING_RATE_IMAGE_READ_BIT_NV;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	/**
+	* Bind the shading rate image for the following draws
+	*
+	* @param commandBuffer Command buffer to record to
+	* @param adaptive Bind the generated image, otherwise no image is bound and pipelines using the generator's viewport state shade at full rate
+	*/
+	void ShadingRateGenerator::bind(VkCommandBuffer commandBuffer, bool adaptive)
+	{
+		vkCmdBindShadingRateImageNV(commandBuffer, adaptive ? view : VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV);
+	}
+
+	const VkPipelineViewportShadingRateImageStateCreateInfoNV* ShadingRateGenerator::getPipelineViewportState() const
+	{
+		return &viewportState;
+	}
+
+	VkImageView ShadingRateGenerator::getImageView() const
+	{
+		return view;
+	}
+
+	/** @brief Returns true if the pipelineStatisticsQuery feature has been enabled */
+	bool ShadingRateGenerator::statisticsSupported() const
+	{
+		return (device != nullptr) && device->enabledFeatures.pipelineStatisticsQuery;
+	}
+
+	/**
+	* Start counting the fragment shader invocations, must be recorded outside of a render pass
+	*
+	* @param commandBuffer Command buffer being recorded
+	* @param adaptive Set if the generated shading rate image is bound for the counted draws
+	*/
+	void ShadingRateGenerator::beginStatistics(VkCommandBuffer commandBuffer, bool adaptive)
+	{
+		if (!statisticsSupported()) {
+			return;
+		}
+		CommandBufferStatistics& entry = statistics[commandBuffer];
+		if (entry.queryPool == VK_NULL_HANDLE) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+			queryPoolInfo.queryCount = 1;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &entry.queryPool));
+		}
+		entry.adaptive = adaptive;
+		entry.submitted = false;
+		vkCmdResetQueryPool(commandBuffer, entry.queryPool, 0, 1);
+		vkCmdBeginQuery(commandBuffer, entry.queryPool, 0, 0);
+	}
+
+	/** @brief Stop counting, must be recorded outside of a render pass */
+	void ShadingRateGenerator::endStatistics(VkCommandBuffer commandBuffer)
+	{
+		auto entry = statistics.find(commandBuffer);
+		if (entry != statistics.end()) {
+			vkCmdEndQuery(commandBuffer, entry->second.queryPool, 0);
+		}
+	}
+
+	/** @brief Mark a command buffer as submitted, so its statistics can be collected once it has finished executing */
+	void ShadingRateGenerator::frameSubmitted(VkCommandBuffer commandBuffer)
+	{
+		auto entry = statistics.find(commandBuffer);
+		if (entry != statistics.end()) {
+			entry->second.submitted = true;
+		}
+	}
+
+	/**
+	* Read back the fragment shader invocations of a command buffer's last submission without waiting
+	*
+	* @param commandBuffer Command buffer the statistics have been recorded to
+	*
+	* @return True if the result was available and fragmentInvocations (or fullRateFragmentInvocations) has been updated
+	*/
+	bool ShadingRateGenerator::collect(VkCommandBuffer commandBuffer)
+	{
+		auto entry = statistics.find(commandBuffer);
+		if ((entry == statistics.end()) || !entry->second.submitted) {
+			return false;
+		}
+		// Invocation count followed by the availability
+		uint64_t result[2] = { 0, 0 };
+		VkResult res = vkGetQueryPoolResults(device->logicalDevice, entry->second.queryPool, 0, 1, sizeof(result), result, sizeof(result), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if ((res != VK_SUCCESS) && (res != VK_NOT_READY)) {
+			VK_CHECK_RESULT(res);
+		}
+		entry->second.submitted = false;
+		if (result[1] == 0) {
+			return false;
+		}
+		if (entry->second.adaptive) {
+			fragmentInvocations = result[0];
+		} else {
+			fullRateFragmentInvocations = result[0];
+		}
+		return true;
+	}
+
+	/** @brief Release the statistics query pool of a command buffer that is about to be freed */
+	void ShadingRateGenerator::release(VkCommandBuffer commandBuffer)
+	{
+		if (!device) {
+			return;
+		}
+		auto entry = statistics.find(commandBuffer);
+		if (entry != statistics.end()) {
+			vkDestroyQueryPool(device->logicalDevice, entry->second.queryPool, nullptr);
+			statistics.erase(entry);
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/*
+* Vulkan shading rate generator
+*
+* Derives a shading rate image from the luminance gradients of the previous frame and counts the fragment shader invocations of the scene
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Content adaptive shading rate based on VK_NV_shading_rate_image
+	*
+	* A compute pass reduces the luminance differences between neighbouring pixels of the previous frame's scene image for each shading rate image texel (tile).
+	* Tiles with small differences in one or both directions are shaded at a coarser rate in that direction, as the lower shading rate isn't noticeable there.
+	* The previous frame is a good enough estimate of the current one at interactive frame rates and doesn't require any additional passes.
+	* Palette entry 0 is full rate, so binding VK_NULL_HANDLE instead of the image shades the scene at full rate with the same pipelines.
+	*
+	* The fragment shader invocations of the scene are counted with pipeline statistics queries, with one query pool per command buffer like vks::GpuProfiler.
+	*
+	* @note Requires the shadingRateImage feature of VK_NV_shading_rate_image and shaderStorageImageExtendedFormats (r8ui storage image),
+	* the statistics additionally require the pipelineStatisticsQuery feature
+	*/
+	class ShadingRateGenerator
+	{
+	private:
+		struct PushConstants {
+			uint32_t tileSize[2];
+			uint32_t renderSize[2];
+			float threshold;
+		};
+
+		struct CommandBufferStatistics {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			// Set if the shading rate image was bound when the command buffer was recorded
+			bool adaptive = false;
+			bool submitted = false;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkExtent2D texelSize{};
+		VkExtent2D extent{};
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::vector<VkShadingRatePaletteEntryNV> paletteEntries;
+		VkShadingRatePaletteNV palette{};
+		VkPipelineViewportShadingRateImageStateCreateInfoNV viewportState{};
+		PFN_vkCmdBindShadingRateImageNV vkCmdBindShadingRateImageNV = nullptr;
+		std::unordered_map<VkCommandBuffer, CommandBufferStatistics> statistics;
+
+		void destroyImage();
+
+	public:
+		/** @brief Average luminance difference between neighbouring pixels below which a tile is shaded at half rate in that direction, at a quarter of it at quarter rate */
+		float threshold = 0.02f;
+		/** @brief Fragment shader invocations of the last collected scene pass with and without the shading rate image bound */
+		uint64_t fragmentInvocations = 0;
+		uint64_t fullRateFragmentInvocations = 0;
+
+		~ShadingRateGenerator();
+		void prepare(vks::VulkanDevice* device, VkExtent2D texelSize, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache);
+		void resize(uint32_t width, uint32_t height, VkImageView sourceView);
+		void destroy();
+		void generate(VkCommandBuffer commandBuffer, uint32_t renderWidth, uint32_t renderHeight);
+		void bind(VkCommandBuffer commandBuffer, bool adaptive);
+		/** @brief Viewport state to chain into the pNext of the viewport state of scene pipelines, stays valid until the generator is destroyed */
+		const VkPipelineViewportShadingRateImageStateCreateInfoNV* getPipelineViewportState() const;
+		VkImageView getImageView() const;
+		bool statisticsSupported() const;
+		void beginStatistics(VkCommandBuffer commandBuffer, bool adaptive);
+		void endStatistics(VkCommandBuffer commandBuffer);
+		void frameSubmitted(VkCommandBuffer commandBuffer);
+		bool collect(VkCommandBuffer commandBuffer);
+		void release(VkCommandBuffer commandBuffer);
+	};
+}
@@ -0,0 +1,338 @@
+/*
+* Vulkan sparse geometry pool
+*
+* Streams meshes in and out of a sparse bound vertex and index buffer with a fixed memory budget
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSparseGeometryPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vks
+{
+	SparseGeometryPool::~SparseGeometryPool()
+	{
+		destroy();
+	}
+
+	/**
+	* Register a mesh, all meshes have to be added before calling prepare
+	*
+	* @param vertexData Host copy of the vertices (vertexStride bytes each), must stay valid as long as the pool is used
+	* @param vertexCount Number of vertices
+	* @param indexData Host copy of the indices, relative to the mesh's first vertex
+	* @param indexCount Number of indices
+	*
+	* @return Index of the mesh, used to request it
+	*/
+	uint32_t SparseGeometryPool::addMesh(const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount)
+	{
+		assert(buffer == VK_NULL_HANDLE);
+		Mesh mesh{};
+		mesh.vertexData = vertexData;
+		mesh.vertexCount = vertexCount;
+		mesh.indexData = indexData;
+		mesh.indexCount = indexCount;
+		meshes.push_back(mesh);
+		return static_cast<uint32_t>(meshes.size() - 1);
+	}
+
+	// Assign each mesh a page aligned range, the vertices start at a multiple of the stride so they can be addressed with a vertex offset
+	void SparseGeometryPool::layoutMeshes(VkDeviceSize pageSize)
+	{
+		VkDeviceSize offset = 0;
+		for (auto& mesh : meshes) {
+			mesh.offset = offset;
+			const VkDeviceSize vertexStart = (offset + vertexStride - 1) / vertexStride * vertexStride;
+			const VkDeviceSize indexStart = vks::tools::alignedVkSize(vertexStart + (VkDeviceSize)mesh.vertexCount * vertexStride, sizeof(uint32_t));
+			mesh.vertexOffset = static_cast<int32_t>(vertexStart / vertexStride);
+			mesh.firstIndex = static_cast<uint32_t>(indexStart / sizeof(uint32_t));
+			mesh.size = vks::tools::alignedVkSize(indexStart + (VkDeviceSize)mesh.indexCount * sizeof(uint32_t) - offset, pageSize);
+			mesh.firstPage = static_cast<uint32_t>(offset / pageSize);
+			mesh.pageCount = static_cast<uint32_t>(mesh.size / pageSize);
+			offset += mesh.size;
+		}
+		size = std::max(offset, pageSize);
+	}
+
+	/**
+	* Create the sparse buffer covering all meshes added so far, no memory is bound until meshes are requested
+	*
+	* @param device Device to create the buffer on
+	* @param queue Queue that supports sparse binding, the frames drawing from the pool must be submitted to the same queue
+	* @param vertexStride Size of a vertex in bytes
+	* @param memoryBudget Max. size of all resident meshes in bytes
+	*/
+	void SparseGeometryPool::prepare(vks::VulkanDevice* device, VkQueue queue, uint32_t vertexStride, VkDeviceSize memoryBudget)
+	{
+		this->device = device;
+		this->queue = queue;
+		this->vertexStride = vertexStride;
+		VkDevice logicalDevice = device->logicalDevice;
+
+		if (!device->features.sparseBinding) {
+			vks::tools::exitFatal("Device does not support sparse binding!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+
+		// The page size is only known once the buffer exists, so the buffer is created with the unaligned size first and recreated if the page aligned ranges don't fit
+		layoutMeshes(1);
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, size);
+		bufferCreateInfo.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, buffer, &memReqs);
+		layoutMeshes(memReqs.alignment);
+		if (size > bufferCreateInfo.size) {
+			vkDestroyBuffer(logicalDevice, buffer, nullptr);
+			bufferCreateInfo.size = size;
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+			vkGetBufferMemoryRequirements(logicalDevice, buffer, &memReqs);
+			assert((size % memReqs.alignment) == 0);
+		}
+		if (size > device->properties.limits.sparseAddressSpaceSize) {
+			vks::tools::exitFatal("Sparse geometry pool exceeds the sparse address space size of the device!", VK_ERROR_OUT_OF_DEVICE_MEMORY);
+		}
+
+		pagePool.create(logicalDevice, device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), memReqs.alignment, memoryBudget);
+
+		commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		VK_CHECK_RESULT(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &framesSemaphore));
+		VK_CHECK_RESULT(vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &bindSemaphore));
+	}
+
+	/** @brief Meshes above a lowered budget are evicted by the next update */
+	void SparseGeometryPool::setBudget(VkDeviceSize memoryBudget)
+	{
+		pagePool.setBudget(memoryBudget);
+	}
+
+	// Collect the binds (or unbinds for non-resident meshes) of all pages of a mesh
+	void SparseGeometryPool::bindPages(const Mesh& mesh)
+	{
+		for (uint32_t i = 0; i < mesh.pageCount; i++) {
+			VkSparseMemoryBind bind{};
+			bind.resourceOffset = (VkDeviceSize)(mesh.firstPage + i) * pagePool.pageSize;
+			bind.size = pagePool.pageSize;
+			if (mesh.resident) {
+				const uint32_t slot = mesh.poolSlots[i];
+				bind.memory = pagePool.blocks[slot / pagePool.pagesPerBlock];
+				bind.memoryOffset = (slot % pagePool.pagesPerBlock) * pagePool.pageSize;
+			}
+			sparseMemoryBinds.push_back(bind);
+		}
+	}
+
+	// Evict the least recently requested mesh, meshes requested by the current update are never evicted
+	bool SparseGeometryPool::evictMesh()
+	{
+		if (lru.empty()) {
+			return false;
+		}
+		Mesh& mesh = meshes[lru.back()];
+		if (mesh.lastRequested == updateIndex) {
+			return false;
+		}
+		lru.pop_back();
+		for (auto slot : mesh.poolSlots) {
+			pagePool.free(slot);
+		}
+		mesh.poolSlots.clear();
+		mesh.resident = false;
+		bindPages(mesh);
+		statistics.meshesEvicted++;
+		return true;
+	}
+
+	/**
+	* Stream in the requested meshes that aren't resident yet, call once per frame before recording the frame's draws
+	*
+	* The binds and uploads are submitted to the pool's queue, so frames submitted afterwards can draw all meshes that are resident once this returns
+	*
+	* @param requestedMeshes Meshes needed by the current frame, ordered by priority (e.g. by distance to the camera)
+	*/
+	void SparseGeometryPool::update(const std::vector<uint32_t>& requestedMeshes)
+	{
+		updateIndex++;
+		statistics.meshesRequested = 0;
+		statistics.meshesMissing = 0;
+		sparseMemoryBinds.clear();
+
+		std::vector<uint32_t> missingMeshes;
+		for (auto index : requestedMeshes) {
+			Mesh& mesh = meshes[index];
+			if (mesh.lastRequested == updateIndex) {
+				continue;
+			}
+			mesh.lastRequested = updateIndex;
+			statistics.meshesRequested++;
+			if (mesh.resident) {
+				// Most recently requested meshes are at the front of the LRU list
+				lru.splice(lru.begin(), lru, mesh.lruEntry);
+			} else {
+				missingMeshes.push_back(index);
+			}
+		}
+		statistics.meshesMissing = static_cast<uint32_t>(missingMeshes.size());
+		if (missingMeshes.size() > maxMeshesPerUpdate) {
+			missingMeshes.resize(maxMeshesPerUpdate);
+		}
+
+		// Meshes above a lowered memory budget
+		while ((pagePool.usedSlots() > pagePool.capacity) && evictMesh()) {}
+		std::vector<uint32_t> uploadMeshes;
+		for (auto index : missingMeshes) {
+			Mesh& mesh = meshes[index];
+			if (mesh.pageCount > pagePool.capacity) {
+				// Never fits into the budget
+				continue;
+			}
+			// Make room for all pages of the mesh by evicting the least recently requested meshes
+			while ((pagePool.capacity - pagePool.usedSlots() < mesh.pageCount) && evictMesh()) {}
+			if (pagePool.capacity - pagePool.usedSlots() < mesh.pageCount) {
+				// All resident meshes are requested by this frame
+				break;
+			}
+			mesh.poolSlots.resize(mesh.pageCount);
+			for (uint32_t i = 0; i < mesh.pageCount; i++) {
+				VkDeviceMemory memory;
+				VkDeviceSize memoryOffset;
+				const bool allocated = pagePool.allocate(&memory, &memoryOffset, &mesh.poolSlots[i]);
+				assert(allocated);
+				(void)allocated;
+			}
+			mesh.resident = true;
+			lru.push_front(index);
+			mesh.lruEntry = lru.begin();
+			bindPages(mesh);
+			uploadMeshes.push_back(index);
+		}
+
+		if (sparseMemoryBinds.empty()) {
+			return;
+		}
+
+		VkDevice logicalDevice = device->logicalDevice;
+		// The previous update has been submitted frames ago, so this usually doesn't wait
+		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(logicalDevice, 1, &fence));
+
+		// Signaled once all frames submitted so far have finished, evicted meshes must not be unbound while frames in flight draw them
+		VkSubmitInfo framesSubmitInfo = vks::initializers::submitInfo();
+		framesSubmitInfo.signalSemaphoreCount = 1;
+		framesSubmitInfo.pSignalSemaphores = &framesSemaphore;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &framesSubmitInfo, VK_NULL_HANDLE));
+
+		// All binds and unbinds of this update in a single sparse bind operation
+		VkSparseBufferMemoryBindInfo bufferMemoryBindInfo{};
+		bufferMemoryBindInfo.buffer = buffer;
+		bufferMemoryBindInfo.bindCount = static_cast<uint32_t>(sparseMemoryBinds.size());
+		bufferMemoryBindInfo.pBinds = sparseMemoryBinds.data();
+		VkBindSparseInfo bindSparseInfo = vks::initializers::bindSparseInfo();
+		bindSparseInfo.bufferBindCount = 1;
+		bindSparseInfo.pBufferBinds = &bufferMemoryBindInfo;
+		bindSparseInfo.waitSemaphoreCount = 1;
+		bindSparseInfo.pWaitSemaphores = &framesSemaphore;
+		bindSparseInfo.signalSemaphoreCount = 1;
+		bindSparseInfo.pSignalSemaphores = &bindSemaphore;
+		VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &bindSparseInfo, VK_NULL_HANDLE));
+
+		// Upload the vertices and indices of all new meshes with one command buffer once they have been bound
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		for (auto index : uploadMeshes) {
+			const Mesh& mesh = meshes[index];
+			const VkDeviceSize vertexSize = (VkDeviceSize)mesh.vertexCount * vertexStride;
+			const VkDeviceSize indexSize = (VkDeviceSize)mesh.indexCount * sizeof(uint32_t);
+			const VkDeviceSize indexStagingOffset = vks::tools::alignedVkSize(vertexSize, 16);
+			vks::StagingRing::Allocation staging = device->stagingRing.allocate(indexStagingOffset + indexSize);
+			memcpy(staging.data, mesh.vertexData, vertexSize);
+			memcpy(static_cast<uint8_t*>(staging.data) + indexStagingOffset, mesh.indexData, indexSize);
+			VkBufferCopy copyRegions[2]{};
+			copyRegions[0].srcOffset = staging.offset;
+			copyRegions[0].dstOffset = (VkDeviceSize)mesh.vertexOffset * vertexStride;
+			copyRegions[0].size = vertexSize;
+			copyRegions[1].srcOffset = staging.offset + indexStagingOffset;
+			copyRegions[1].dstOffset = (VkDeviceSize)mesh.firstIndex * sizeof(uint32_t);
+			copyRegions[1].size = indexSize;
+			vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer, 2, copyRegions);
+			statistics.bytesUploaded += vertexSize + indexSize;
+		}
+		// Frames submitted after the upload draw the new meshes
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+		uploadSubmitInfo.waitSemaphoreCount = 1;
+		uploadSubmitInfo.pWaitSemaphores = &bindSemaphore;
+		uploadSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		uploadSubmitInfo.commandBufferCount = 1;
+		uploadSubmitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, fence));
+		// The staging memory of the uploads can be reused once the fence has been signaled
+		device->stagingRing.submit(fence);
+
+		statistics.meshesStreamedIn += static_cast<uint32_t>(uploadMeshes.size());
+	}
+
+	/** @brief Evict all resident meshes, so they are streamed in again by the next updates */
+	void SparseGeometryPool::flush()
+	{
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		sparseMemoryBinds.clear();
+		for (auto index : lru) {
+			Mesh& mesh = meshes[index];
+			for (auto slot : mesh.poolSlots) {
+				pagePool.free(slot);
+			}
+			mesh.poolSlots.clear();
+			mesh.resident = false;
+			bindPages(mesh);
+		}
+		lru.clear();
+		if (sparseMemoryBinds.empty()) {
+			return;
+		}
+		VkSparseBufferMemoryBindInfo bufferMemoryBindInfo{};
+		bufferMemoryBindInfo.buffer = buffer;
+		bufferMemoryBindInfo.bindCount = static_cast<uint32_t>(sparseMemoryBinds.size());
+		bufferMemoryBindInfo.pBinds = sparseMemoryBinds.data();
+		VkBindSparseInfo bindSparseInfo = vks::initializers::bindSparseInfo();
+		bindSparseInfo.bufferBindCount = 1;
+		bindSparseInfo.pBufferBinds = &bufferMemoryBindInfo;
+		VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &bindSparseInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	}
+
+	/** @brief Release all Vulkan resources, frames using the pool must have finished */
+	void SparseGeometryPool::destroy()
+	{
+		if (device == nullptr) {
+			return;
+		}
+		VkDevice logicalDevice = device->logicalDevice;
+		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+		vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		pagePool.destroy();
+		vkDestroySemaphore(logicalDevice, bindSemaphore, nullptr);
+		vkDestroySemaphore(logicalDevice, framesSemaphore, nullptr);
+		vkDestroyFence(logicalDevice, fence, nullptr);
+		vkFreeCommandBuffers(logicalDevice, device->commandPool, 1, &commandBuffer);
+		meshes.clear();
+		lru.clear();
+		buffer = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+}
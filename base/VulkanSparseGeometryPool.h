@@ -0,0 +1,103 @@
+/*
+* Vulkan sparse geometry pool
+*
+* Streams meshes in and out of a sparse bound vertex and index buffer with a fixed memory budget
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanSparsePagePool.h"
+
+namespace vks
+{
+	/**
+	* @brief Geometry of many meshes in a single sparse bound buffer, of which only the requested meshes are backed by memory
+	*
+	* Each mesh gets a page aligned range of the buffer's (virtual) address space, holding its vertices followed by its indices.
+	* Meshes are requested each frame (see update), missing ones are streamed in from their host copy by binding pages of a vks::SparsePagePool
+	* to their range and uploading the data, the least recently requested meshes are evicted once the memory budget is used up.
+	* As all meshes share one buffer, they are drawn with a single vertex and index buffer binding, e.g. with indirect draws using the mesh's vertexOffset and firstIndex.
+	*
+	* @note The queue passed to prepare must support sparse binding and must be the queue the frames using the pool are submitted to
+	*/
+	class SparseGeometryPool
+	{
+	public:
+		struct Mesh
+		{
+			// Host copy the mesh is streamed in from, owned by the caller
+			const void* vertexData = nullptr;
+			uint32_t vertexCount = 0;
+			const uint32_t* indexData = nullptr;
+			uint32_t indexCount = 0;
+			// Page aligned range of the buffer reserved for the mesh
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			uint32_t firstPage = 0;
+			uint32_t pageCount = 0;
+			// Vertex offset and first index for indexed draws from the pool's buffer
+			int32_t vertexOffset = 0;
+			uint32_t firstIndex = 0;
+			bool resident = false;
+			uint64_t lastRequested = 0;
+			std::vector<uint32_t> poolSlots;
+			std::list<uint32_t>::iterator lruEntry;
+		};
+
+		struct Statistics
+		{
+			uint32_t meshesRequested = 0;
+			uint32_t meshesMissing = 0;
+			uint32_t meshesStreamedIn = 0;
+			uint32_t meshesEvicted = 0;
+			VkDeviceSize bytesUploaded = 0;
+		} statistics;
+
+	private:
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		// Signaled after all previously submitted frames, so pages can be unbound once no frame in flight reads them anymore
+		VkSemaphore framesSemaphore = VK_NULL_HANDLE;
+		// Signaled by the sparse bind of an update and waited on by the uploads of the newly resident meshes
+		VkSemaphore bindSemaphore = VK_NULL_HANDLE;
+		uint64_t updateIndex = 0;
+		std::vector<VkSparseMemoryBind> sparseMemoryBinds;
+
+		void layoutMeshes(VkDeviceSize pageSize);
+		bool evictMesh();
+		void bindPages(const Mesh& mesh);
+
+	public:
+		/** @brief Buffer holding the vertices and indices of all meshes, to be bound as both the vertex and the index buffer */
+		VkBuffer buffer = VK_NULL_HANDLE;
+		/** @brief Size of the buffer's virtual address space */
+		VkDeviceSize size = 0;
+		uint32_t vertexStride = 0;
+		std::vector<Mesh> meshes;
+		/** @brief Resident meshes, from the most to the least recently requested one */
+		std::list<uint32_t> lru;
+		vks::SparsePagePool pagePool;
+		/** @brief Max. number of meshes streamed in per update, limits the time spent on a single frame */
+		uint32_t maxMeshesPerUpdate = 16;
+
+		~SparseGeometryPool();
+		uint32_t addMesh(const void* vertexData, uint32_t vertexCount, const uint32_t* indexData, uint32_t indexCount);
+		void prepare(vks::VulkanDevice* device, VkQueue queue, uint32_t vertexStride, VkDeviceSize memoryBudget);
+		void setBudget(VkDeviceSize memoryBudget);
+		void update(const std::vector<uint32_t>& requestedMeshes);
+		void flush();
+		void destroy();
+	};
+}
@@ -0,0 +1,96 @@
+/*
+* Vulkan sparse page pool
+*
+* Fixed budget of device memory slots that back the pages of sparse resources
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSparsePagePool.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* Set up the pool, no memory is allocated until the first page is requested
+	*
+	* @param device Logical device to allocate the memory blocks on
+	* @param memoryTypeIndex Memory type of the blocks, must be compatible with the sparse resources the pages are bound to
+	* @param pageSize Size of a page in bytes (the sparse block size, i.e. the alignment of the resource's memory requirements)
+	* @param memoryBudget Max. size of all resident pages in bytes
+	*/
+	void SparsePagePool::create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, VkDeviceSize memoryBudget)
+	{
+		this->device = device;
+		this->memoryTypeIndex = memoryTypeIndex;
+		this->pageSize = pageSize;
+		// Blocks of 4 MB (or a single page if pages are larger than that)
+		pagesPerBlock = static_cast<uint32_t>(std::max((VkDeviceSize)(4 * 1024 * 1024) / pageSize, (VkDeviceSize)1));
+		setBudget(memoryBudget);
+	}
+
+	/** @brief Changing the budget only limits the number of slots handed out, pages above a lowered budget have to be evicted by the caller */
+	void SparsePagePool::setBudget(VkDeviceSize memoryBudget)
+	{
+		capacity = static_cast<uint32_t>(std::max(memoryBudget / pageSize, (VkDeviceSize)1));
+	}
+
+	uint32_t SparsePagePool::usedSlots()
+	{
+		return slotCount - static_cast<uint32_t>(freeSlots.size());
+	}
+
+	/**
+	* Get a slot for a page
+	*
+	* @param memory Memory block the slot lies in
+	* @param memoryOffset Offset of the slot within the block, used as the memory offset of the sparse bind
+	* @param slot Index of the slot, to be passed to free once the page is evicted
+	*
+	* @return False if the budget is used up
+	*/
+	bool SparsePagePool::allocate(VkDeviceMemory* memory, VkDeviceSize* memoryOffset, uint32_t* slot)
+	{
+		if (usedSlots() >= capacity) {
+			return false;
+		}
+		if (freeSlots.empty()) {
+			// All slots are in use, allocate a new block
+			VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+			allocInfo.allocationSize = pageSize * pagesPerBlock;
+			allocInfo.memoryTypeIndex = memoryTypeIndex;
+			VkDeviceMemory block;
+			VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &block));
+			blocks.push_back(block);
+			// Pushed in reverse, so slots are handed out in order
+			for (uint32_t i = 0; i < pagesPerBlock; i++) {
+				freeSlots.push_back(slotCount + pagesPerBlock - 1 - i);
+			}
+			slotCount += pagesPerBlock;
+		}
+		*slot = freeSlots.back();
+		freeSlots.pop_back();
+		*memory = blocks[*slot / pagesPerBlock];
+		*memoryOffset = (*slot % pagesPerBlock) * pageSize;
+		return true;
+	}
+
+	void SparsePagePool::free(uint32_t slot)
+	{
+		freeSlots.push_back(slot);
+	}
+
+	/** @brief Free all memory blocks, the sparse resources using them must no longer be in use */
+	void SparsePagePool::destroy()
+	{
+		for (auto block : blocks) {
+			vkFreeMemory(device, block, nullptr);
+		}
+		blocks.clear();
+		freeSlots.clear();
+		slotCount = 0;
+	}
+}
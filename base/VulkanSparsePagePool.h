@@ -0,0 +1,50 @@
+/*
+* Vulkan sparse page pool
+*
+* Fixed budget of device memory slots that back the pages of sparse resources
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Pool of page sized device memory slots for sparse residency
+	*
+	* Memory is allocated in blocks of several pages instead of one allocation per page, blocks are only allocated once all existing slots are in use.
+	* The number of slots handed out is limited by a memory budget, callers evict resident pages (e.g. the least recently used ones) if allocate fails.
+	* Used for the pages of sparse images as well as for sparse bound buffers (see vks::SparseGeometryPool).
+	*/
+	class SparsePagePool
+	{
+	public:
+		VkDevice device = VK_NULL_HANDLE;
+		uint32_t memoryTypeIndex = 0;
+		VkDeviceSize pageSize = 0;
+		uint32_t pagesPerBlock = 0;
+		/** @brief Max. number of resident pages within the memory budget */
+		uint32_t capacity = 0;
+		/** @brief Number of slots backed by the allocated blocks */
+		uint32_t slotCount = 0;
+		std::vector<VkDeviceMemory> blocks;
+		std::vector<uint32_t> freeSlots;
+
+		void create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize pageSize, VkDeviceSize memoryBudget);
+		void setBudget(VkDeviceSize memoryBudget);
+		uint32_t usedSlots();
+		bool allocate(VkDeviceMemory* memory, VkDeviceSize* memoryOffset, uint32_t* slot);
+		void free(uint32_t slot);
+		void destroy();
+	};
+}
@@ -0,0 +1,241 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped host visible buffer that upload paths take their staging memory from
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStagingRing.h"
+
+namespace vks
+{
+	StagingRing::~StagingRing()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the staging ring, the ring buffer itself is created on the first allocation
+	*
+	* @param device Logical device to create the buffers on
+	* @param allocator Memory allocator to allocate the (host visible) buffer memory from
+	*/
+	void StagingRing::setup(VkDevice device, vks::MemoryAllocator* allocator)
+	{
+		this->device = device;
+		this->allocator = allocator;
+	}
+
+	bool StagingRing::empty() const
+	{
+		return regions.empty() && !pending;
+	}
+
+	bool StagingRing::allocateFromRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+	{
+		if (size > this->size) {
+			return false;
+		}
+		if (empty()) {
+			head = tail = 0;
+		}
+		const VkDeviceSize alignedHead = vks::tools::alignedVkSize(head, alignment);
+		if (empty() || (head > tail))
+		{
+			// Used range doesn't wrap around, so there is free space at the end and in front of the tail
+			if (alignedHead + size <= this->size) {
+				*offset = alignedHead;
+			} else if (size <= tail) {
+				*offset = 0;
+			} else {
+				return false;
+			}
+		}
+		else if (head < tail)
+		{
+			// Used range wraps around, free space is between head and tail
+			if (alignedHead + size <= tail) {
+				*offset = alignedHead;
+			} else {
+				return false;
+			}
+		}
+		else
+		{
+			// Head caught up with the tail, the ring is full
+			return false;
+		}
+		head = *offset + size;
+		pending = true;
+		return true;
+	}
+
+	StagingRing::Allocation StagingRing::allocateTemporary(VkDeviceSize size)
+	{
+		TemporaryBuffer temporaryBuffer{};
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &temporaryBuffer.buffer));
+		VK_CHECK_RESULT(allocator->allocateBufferMemory(temporaryBuffer.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, &temporaryBuffer.allocation));
+		allocator->tag(temporaryBuffer.allocation, MemoryCategory::Staging, "Staging (temporary)");
+		pendingTemporaryBuffers.push_back(temporaryBuffer);
+		Allocation stagingAllocation;
+		stagingAllocation.buffer = temporaryBuffer.buffer;
+		stagingAllocation.offset = 0;
+		stagingAllocation.size = size;
+		stagingAllocation.data = temporaryBuffer.allocation.mapped;
+		return stagingAllocation;
+	}
+
+	void StagingRing::releaseRegion(Region& region)
+	{
+		if (region.fence) {
+			vkDestroyFence(device, region.fence, nullptr);
+		}
+		for (auto& temporaryBuffer : region.temporaryBuffers) {
+			vkDestroyBuffer(device, temporaryBuffer.buffer, nullptr);
+			allocator->free(temporaryBuffer.allocation);
+		}
+		tail = region.end;
+		completedSerial = region.serial;
+	}
+
+	/**
+	* Allocate staging memory
+	*
+	* @param size Size of the data to be staged
+	* @param alignment (Optional) Alignment of the offset into the staging buffer (Defaults to 16, which fits all texel block sizes used by the samples)
+	*
+	* @return Staging allocation, data points to the (mapped) memory the upload data has to be written to
+	*
+	* @note Waits for the oldest submitted regions if the ring is full
+	*/
+	StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		assert(device != VK_NULL_HANDLE);
+		if (buffer == VK_NULL_HANDLE)
+		{
+			this->size = ringSize;
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, this->size);
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer));
+			VK_CHECK_RESULT(allocator->allocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, &allocation));
+			allocator->tag(allocation, MemoryCategory::Staging, "Staging ring");
+		}
+
+		reclaim();
+		VkDeviceSize offset = 0;
+		bool allocated = allocateFromRing(size, alignment, &offset);
+		// Wait for regions still in use by the device until enough space is available
+		while (!allocated && !regions.empty())
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &regions.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			reclaim();
+			allocated = allocateFromRing(size, alignment, &offset);
+		}
+		// All of the ring is used by allocations that haven't been submitted yet (e.g. by a batch of uploads), try to get them submitted
+		if (!allocated && pending && (size <= this->size) && flushPending && flushPending())
+		{
+			reclaim(true);
+			allocated = allocateFromRing(size, alignment, &offset);
+		}
+		// The ring is either too small for this request or its space can't be reclaimed yet
+		if (!allocated)
+		{
+			return allocateTemporary(size);
+		}
+
+		Allocation stagingAllocation;
+		stagingAllocation.buffer = buffer;
+		stagingAllocation.offset = offset;
+		stagingAllocation.size = size;
+		stagingAllocation.data = static_cast<uint8_t*>(allocation.mapped) + offset;
+		return stagingAllocation;
+	}
+
+	/**
+	* Close the region of all allocations made since the last submit
+	*
+	* @param fence Fence signaled once the device has finished reading the region's staging memory, pass VK_NULL_HANDLE if the copies have already completed
+	*
+	* @return Serial of the region, serials increase with each submit and can be passed to complete() and wait()
+	*
+	* @note The ring takes ownership of the fence and destroys it once the region has been reclaimed
+	*/
+	uint64_t StagingRing::submit(VkFence fence)
+	{
+		// Empty regions are only tracked if there is a fence that has to be waited on
+		if (!pending && pendingTemporaryBuffers.empty() && !fence)
+		{
+			return submittedSerial;
+		}
+		Region region{};
+		region.serial = ++submittedSerial;
+		region.end = head;
+		region.fence = fence;
+		region.temporaryBuffers = std::move(pendingTemporaryBuffers);
+		pendingTemporaryBuffers.clear();
+		regions.push_back(std::move(region));
+		pending = false;
+		return submittedSerial;
+	}
+
+	/**
+	* Reclaim the memory of all regions whose fences have been signaled
+	*
+	* @param wait (Optional) Wait for all submitted regions to complete (Defaults to false)
+	*/
+	void StagingRing::reclaim(bool wait)
+	{
+		while (!regions.empty())
+		{
+			Region& region = regions.front();
+			if (region.fence)
+			{
+				if (wait) {
+					VK_CHECK_RESULT(vkWaitForFences(device, 1, &region.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				} else if (vkGetFenceStatus(device, region.fence) != VK_SUCCESS) {
+					break;
+				}
+			}
+			releaseRegion(region);
+			regions.pop_front();
+		}
+	}
+
+	/** @brief Returns true if the region with the given serial (and all regions submitted before it) have been reclaimed */
+	bool StagingRing::complete(uint64_t serial)
+	{
+		reclaim();
+		return completedSerial >= serial;
+	}
+
+	/** @brief Wait until the region with the given serial (and all regions submitted before it) have been reclaimed */
+	void StagingRing::wait(uint64_t serial)
+	{
+		while (!complete(serial))
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &regions.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+		}
+	}
+
+	/** @brief Release the ring buffer and all temporary buffers, waits for submitted regions to complete */
+	void StagingRing::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		reclaim(true);
+		submit(VK_NULL_HANDLE);
+		reclaim();
+		if (buffer)
+		{
+			vkDestroyBuffer(device, buffer, nullptr);
+			allocator->free(allocation);
+			buffer = VK_NULL_HANDLE;
+		}
+		head = tail = 0;
+		device = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,93 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped host visible buffer that upload paths take their staging memory from
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	/**
+	* @brief Ring buffer for staging uploads
+	*
+	* Staging memory is handed out from a single persistently mapped buffer. All allocations made between two calls to submit() form a region
+	* that is owned by the fence passed to submit(), the ring only reuses a region's memory once that fence has been signaled.
+	* Requests that don't fit into the ring (e.g. while all of it is used by the current batch) get a temporary buffer that is released along with the region.
+	*
+	* @note A full ring may submit the pending allocations via flushPending, so the copies reading an allocation must be recorded before the next allocation is requested
+	*/
+	class StagingRing
+	{
+	public:
+		/** @brief Staging memory for a single upload */
+		struct Allocation
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			/** @brief Offset into buffer that should be used as the source offset of copy commands */
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			/** @brief Host pointer to write the data to be uploaded to */
+			void* data = nullptr;
+		};
+
+	private:
+		struct TemporaryBuffer
+		{
+			VkBuffer buffer;
+			vks::Allocation allocation;
+		};
+		struct Region
+		{
+			uint64_t serial;
+			VkDeviceSize end;
+			VkFence fence;
+			std::vector<TemporaryBuffer> temporaryBuffers;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		vks::MemoryAllocator* allocator = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		vks::Allocation allocation;
+		VkDeviceSize size = 0;
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		bool pending = false;
+		uint64_t submittedSerial = 0;
+		uint64_t completedSerial = 0;
+		std::vector<TemporaryBuffer> pendingTemporaryBuffers;
+		std::deque<Region> regions;
+
+		bool empty() const;
+		bool allocateFromRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+		void releaseRegion(Region& region);
+		Allocation allocateTemporary(VkDeviceSize size);
+
+	public:
+		/** @brief Size of the ring buffer, must be set before the first allocation */
+		VkDeviceSize ringSize = 32 * 1024 * 1024;
+		/** @brief Called if the ring is full with allocations that haven't been submitted yet, should submit them and return true if it did */
+		std::function<bool()> flushPending;
+
+		~StagingRing();
+		void setup(VkDevice device, vks::MemoryAllocator* allocator);
+		Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+		uint64_t submit(VkFence fence);
+		void reclaim(bool wait = false);
+		bool complete(uint64_t serial);
+		void wait(uint64_t serial);
+		void destroy();
+	};
+}
@@ -0,0 +1,151 @@
+/*
+* Vulkan startup profiler
+*
+* Measures where the time between starting an example and presenting its first frame goes: device setup, asset loading and pipeline creation
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStartupProfiler.h"
+#include "VulkanTraceRecorder.h"
+#include "VulkanHitchDetector.h"
+#include "VulkanPipelineManifest.h"
+
+namespace vks
+{
+	StartupProfiler& StartupProfiler::get()
+	{
+		static StartupProfiler profiler;
+		return profiler;
+	}
+
+	/** @brief Time between two points in ms */
+	double StartupProfiler::elapsed(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+
+	/** @brief Set the time of a named phase, phases are reported in the order they have been set first */
+	void StartupProfiler::setPhase(const std::string& name, double ms)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& phase : phases) {
+			if (phase.name == name) {
+				phase.ms = ms;
+				return;
+			}
+		}
+		phases.push_back({ name, ms });
+	}
+
+	void StartupProfiler::addAssetTime(AssetStage stage, double ms)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assetTimes[stage] += ms;
+	}
+
+	void StartupProfiler::addPipelines(uint32_t count, uint32_t cacheHits, uint32_t cacheMisses, double ms)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pipelineStatistics.calls++;
+		pipelineStatistics.pipelines += count;
+		pipelineStatistics.cacheHits += cacheHits;
+		pipelineStatistics.cacheMisses += cacheMisses;
+		pipelineStatistics.ms += ms;
+	}
+
+	std::vector<StartupProfiler::Phase> StartupProfiler::getPhases() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return phases;
+	}
+
+	double StartupProfiler::getAssetTime(AssetStage stage) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return assetTimes[stage];
+	}
+
+	StartupProfiler::PipelineStatistics StartupProfiler::getPipelineStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pipelineStatistics;
+	}
+
+	namespace
+	{
+		uint32_t getStageCount(const VkGraphicsPipelineCreateInfo& createInfo)
+		{
+			return createInfo.stageCount;
+		}
+
+		uint32_t getStageCount(const VkComputePipelineCreateInfo& createInfo)
+		{
+			return 1;
+		}
+
+		// Chains creation feedback to copies of the create infos (if supported), creates the pipelines and records the time and cache hits of the call
+		template<typename CreateInfo, typename CreateFunction>
+		VkResult createPipelines(uint32_t createInfoCount, const CreateInfo* pCreateInfos, CreateFunction create)
+		{
+			StartupProfiler& profiler = StartupProfiler::get();
+			std::vector<CreateInfo> createInfos(pCreateInfos, pCreateInfos + createInfoCount);
+			std::vector<VkPipelineCreationFeedbackEXT> feedbacks(createInfoCount);
+			std::vector<std::vector<VkPipelineCreationFeedbackEXT>> stageFeedbacks(createInfoCount);
+			std::vector<VkPipelineCreationFeedbackCreateInfoEXT> feedbackInfos(createInfoCount);
+			if (profiler.pipelineFeedbackSupported) {
+				for (uint32_t i = 0; i < createInfoCount; i++) {
+					stageFeedbacks[i].resize(getStageCount(createInfos[i]));
+					feedbackInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+					feedbackInfos[i].pNext = createInfos[i].pNext;
+					feedbackInfos[i].pPipelineCreationFeedback = &feedbacks[i];
+					feedbackInfos[i].pipelineStageCreationFeedbackCount = static_cast<uint32_t>(stageFeedbacks[i].size());
+					feedbackInfos[i].pPipelineStageCreationFeedbacks = stageFeedbacks[i].data();
+					createInfos[i].pNext = &feedbackInfos[i];
+				}
+			}
+			TraceZone zone("Create pipelines");
+			const StartupProfiler::Clock::time_point begin = StartupProfiler::Clock::now();
+			VkResult result = create(createInfos.data());
+			const double ms = StartupProfiler::elapsed(begin, StartupProfiler::Clock::now());
+			uint32_t cacheHits = 0;
+			uint32_t cacheMisses = 0;
+			if (profiler.pipelineFeedbackSupported && (result == VK_SUCCESS)) {
+				for (auto& feedback : feedbacks) {
+					if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) {
+						if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) {
+							cacheHits++;
+						} else {
+							cacheMisses++;
+						}
+					}
+				}
+			}
+			profiler.addPipelines(createInfoCount, cacheHits, cacheMisses, ms);
+			return result;
+		}
+	}
+
+	// Pipelines precompiled from the pipeline manifest are handed out without calling into the driver, only the remaining ones are created
+	VkResult createGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines)
+	{
+		return PipelineManifest::get().createGraphicsPipelines(createInfoCount, pCreateInfos, pPipelines, [&](uint32_t count, const VkGraphicsPipelineCreateInfo* pCompileInfos, VkPipeline* pCompiledPipelines) {
+			HitchDetector::recordVulkanCall("vkCreateGraphicsPipelines");
+			return createPipelines(count, pCompileInfos, [&](const VkGraphicsPipelineCreateInfo* createInfos) {
+				return vkCreateGraphicsPipelines(device, pipelineCache, count, createInfos, pAllocator, pCompiledPipelines);
+			});
+		});
+	}
+
+	VkResult createComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines)
+	{
+		return PipelineManifest::get().createComputePipelines(createInfoCount, pCreateInfos, pPipelines, [&](uint32_t count, const VkComputePipelineCreateInfo* pCompileInfos, VkPipeline* pCompiledPipelines) {
+			HitchDetector::recordVulkanCall("vkCreateComputePipelines");
+			return createPipelines(count, pCompileInfos, [&](const VkComputePipelineCreateInfo* createInfos) {
+				return vkCreateComputePipelines(device, pipelineCache, count, createInfos, pAllocator, pCompiledPipelines);
+			});
+		});
+	}
+}
@@ -0,0 +1,111 @@
+/*
+* Vulkan startup profiler
+*
+* Measures where the time between starting an example and presenting its first frame goes: device setup, asset loading and pipeline creation
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <chrono>
+#include <mutex>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* @brief Collects the times of the startup phases
+	*
+	* Named phases are set by the example base, asset loading and pipeline creation are accumulated by the loaders and the pipeline creation functions below.
+	* Asset and pipeline times are summed over all threads, so they can exceed the wall clock time if loading is done in parallel.
+	*/
+	class StartupProfiler
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+		enum AssetStage
+		{
+			/** @brief Reading (or mapping) and parsing files */
+			AssetIO = 0,
+			/** @brief Decoding, transcoding and processing data on the host */
+			AssetDecode,
+			/** @brief Creating device resources and recording or submitting their uploads */
+			AssetUpload,
+			AssetStageCount
+		};
+		struct Phase
+		{
+			std::string name;
+			double ms;
+		};
+		struct PipelineStatistics
+		{
+			uint32_t calls = 0;
+			uint32_t pipelines = 0;
+			/** @brief Pipelines reported as found in the pipeline cache (requires VK_EXT_pipeline_creation_feedback) */
+			uint32_t cacheHits = 0;
+			uint32_t cacheMisses = 0;
+			double ms = 0.0;
+		};
+
+	private:
+		mutable std::mutex mutex;
+		std::vector<Phase> phases;
+		std::array<double, AssetStageCount> assetTimes{};
+		PipelineStatistics pipelineStatistics;
+
+	public:
+		/** @brief Set if VK_EXT_pipeline_creation_feedback is enabled, so pipeline cache hits and misses can be told apart */
+		bool pipelineFeedbackSupported = false;
+
+		static StartupProfiler& get();
+		static double elapsed(Clock::time_point begin, Clock::time_point end);
+		void setPhase(const std::string& name, double ms);
+		void addAssetTime(AssetStage stage, double ms);
+		void addPipelines(uint32_t count, uint32_t cacheHits, uint32_t cacheMisses, double ms);
+		std::vector<Phase> getPhases() const;
+		double getAssetTime(AssetStage stage) const;
+		PipelineStatistics getPipelineStatistics() const;
+	};
+
+	/** @brief Adds the time of an asset loading stage covering the lifetime of the object (or until the next stage is started) */
+	class AssetTimer
+	{
+	private:
+		StartupProfiler::AssetStage stage;
+		StartupProfiler::Clock::time_point begin;
+		bool running = true;
+
+	public:
+		explicit AssetTimer(StartupProfiler::AssetStage stage) : stage(stage), begin(StartupProfiler::Clock::now()) {}
+		~AssetTimer()
+		{
+			stop();
+		}
+		void next(StartupProfiler::AssetStage stage)
+		{
+			stop();
+			this->stage = stage;
+			begin = StartupProfiler::Clock::now();
+			running = true;
+		}
+		void stop()
+		{
+			if (running) {
+				StartupProfiler::get().addAssetTime(stage, StartupProfiler::elapsed(begin, StartupProfiler::Clock::now()));
+				running = false;
+			}
+		}
+	};
+
+	// Drop-in replacements for vkCreateGraphicsPipelines and vkCreateComputePipelines that measure pipeline creation and its pipeline cache hits
+	VkResult createGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines);
+	VkResult createComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount, const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines);
+}
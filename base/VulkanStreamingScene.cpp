@@ -0,0 +1,506 @@
+/*
+* Vulkan streaming scene
+*
+* Spatially partitioned glTF scene whose cells are streamed in and out around the camera
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStreamingScene.h"
+#include "VulkanglTFModel.h"
+#include "meshsimplifier.hpp"
+
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace vks
+{
+	namespace
+	{
+		const uint32_t cellFileMagic = 0x4c4c4543; // "CELL"
+		const uint32_t cellFileVersion = 1;
+
+		struct CellFileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			float cellSize;
+			float proxyRatio;
+			uint32_t vertexSize;
+			uint32_t cellCount;
+			uint32_t proxyVertexCount;
+			uint32_t proxyIndexCount;
+		};
+
+		struct CellFileEntry {
+			int32_t coord[2];
+			float min[3];
+			float max[3];
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint64_t dataOffset;
+			uint32_t proxyVertexOffset;
+			uint32_t proxyFirstIndex;
+			uint32_t proxyIndexCount;
+			uint32_t padding;
+		};
+
+		bool getSourceFileInfo(const std::string& filename, uint64_t& size, int64_t& time)
+		{
+			struct stat fileStat;
+			if (stat(filename.c_str(), &fileStat) != 0) {
+				return false;
+			}
+			size = static_cast<uint64_t>(fileStat.st_size);
+			time = static_cast<int64_t>(fileStat.st_mtime);
+			return true;
+		}
+
+		// Reads the header of a cell file, returns false if it doesn't exist or doesn't match the source file and build settings
+		bool readCellFileHeader(std::ifstream& file, const std::string& filename, float cellSize, float proxyRatio, CellFileHeader& header)
+		{
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			if (!file.is_open() || !getSourceFileInfo(filename, sourceSize, sourceTime)) {
+				return false;
+			}
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+				return false;
+			}
+			return (header.magic == cellFileMagic) && (header.version == cellFileVersion) && (header.sourceSize == sourceSize) && (header.sourceTime == sourceTime)
+				&& (header.cellSize == cellSize) && (header.proxyRatio == proxyRatio) && (header.vertexSize == sizeof(StreamingScene::Vertex));
+		}
+	}
+
+	VkDeviceSize StreamingScene::Cell::size() const
+	{
+		return indexOffset() + (VkDeviceSize)indexCount * sizeof(uint32_t);
+	}
+
+	/** @brief Offset of the indices behind the cell's vertices */
+	VkDeviceSize StreamingScene::Cell::indexOffset() const
+	{
+		return vks::tools::alignedVkSize((VkDeviceSize)vertexCount * sizeof(Vertex), sizeof(uint32_t));
+	}
+
+	StreamingScene::~StreamingScene()
+	{
+		destroy();
+	}
+
+	/**
+	* Partition a glTF scene into grid cells and write them to a cell file
+	*
+	* @note The primitives are assigned to a single cell by the center of their bounds, so a cell's bounds may extend beyond its grid cell
+	*/
+	bool StreamingScene::build(const std::string& filename, const std::string& cellFilename, vks::VulkanDevice* device, VkQueue queue, float cellSize, float proxyRatio)
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (!getSourceFileInfo(filename, sourceSize, sourceTime)) {
+			return false;
+		}
+
+		vkglTF::Model model;
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::HostGeometryOnly | vkglTF::FileLoadingFlags::DontLoadImages;
+		model.loadFromFile(filename, device, queue, glTFLoadingFlags);
+
+		struct CellBuild {
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			std::vector<Vertex> proxyVertices;
+			std::vector<uint32_t> proxyIndices;
+		};
+		std::map<std::pair<int32_t, int32_t>, CellBuild> cellBuilds;
+
+		const auto& hostVertices = model.hostData.vertices;
+		const auto& hostIndices = model.hostData.indices;
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				// Pre-transformed vertices are in world space, so the bounds are taken from the vertices themselves
+				glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+				for (uint32_t i = 0; i < primitive->indexCount; i++) {
+					const glm::vec3& pos = hostVertices[hostIndices[primitive->firstIndex + i]].pos;
+					min = glm::min(min, pos);
+					max = glm::max(max, pos);
+				}
+				const glm::vec3 center = (min + max) * 0.5f;
+				CellBuild& cell = cellBuilds[std::make_pair(static_cast<int32_t>(floor(center.x / cellSize)), static_cast<int32_t>(floor(center.z / cellSize)))];
+				cell.min = glm::min(cell.min, min);
+				cell.max = glm::max(cell.max, max);
+				// Host indices are absolute, so they're rebased to the primitive's vertices in the cell
+				const uint32_t firstVertex = static_cast<uint32_t>(cell.vertices.size());
+				for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+					const vkglTF::Vertex& src = hostVertices[primitive->firstVertex + i];
+					cell.vertices.push_back({ src.pos, src.normal, src.color });
+				}
+				for (uint32_t i = 0; i < primitive->indexCount; i++) {
+					cell.indices.push_back(hostIndices[primitive->firstIndex + i] - primitive->firstVertex + firstVertex);
+				}
+			}
+		}
+
+		// Proxies are simplified versions of the cells, only keeping the vertices still referenced
+		uint32_t proxyVertexCount = 0;
+		uint32_t proxyIndexCount = 0;
+		for (auto& entry : cellBuilds) {
+			CellBuild& cell = entry.second;
+			const size_t targetIndexCount = std::max<size_t>(3, static_cast<size_t>(cell.indices.size() * proxyRatio) / 3 * 3);
+			std::vector<uint32_t> simplified = vks::meshsimplifier::simplify(cell.indices.data(), cell.indices.size(), cell.vertices.data(), sizeof(Vertex), static_cast<uint32_t>(cell.vertices.size()), targetIndexCount);
+			std::vector<uint32_t> remap(cell.vertices.size(), UINT32_MAX);
+			for (uint32_t index : simplified) {
+				if (remap[index] == UINT32_MAX) {
+					remap[index] = static_cast<uint32_t>(cell.proxyVertices.size());
+					cell.proxyVertices.push_back(cell.vertices[index]);
+				}
+				cell.proxyIndices.push_back(remap[index]);
+			}
+			proxyVertexCount += static_cast<uint32_t>(cell.proxyVertices.size());
+			proxyIndexCount += static_cast<uint32_t>(cell.proxyIndices.size());
+		}
+
+		std::ofstream file(cellFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		CellFileHeader header{};
+		header.magic = cellFileMagic;
+		header.version = cellFileVersion;
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		header.cellSize = cellSize;
+		header.proxyRatio = proxyRatio;
+		header.vertexSize = sizeof(Vertex);
+		header.cellCount = static_cast<uint32_t>(cellBuilds.size());
+		header.proxyVertexCount = proxyVertexCount;
+		header.proxyIndexCount = proxyIndexCount;
+
+		// Layout: Header, cell table, proxy vertices, proxy indices, full cell data
+		uint64_t dataOffset = sizeof(CellFileHeader) + cellBuilds.size() * sizeof(CellFileEntry) + (uint64_t)proxyVertexCount * sizeof(Vertex) + (uint64_t)proxyIndexCount * sizeof(uint32_t);
+		std::vector<CellFileEntry> entries;
+		uint32_t proxyVertexOffset = 0;
+		uint32_t proxyFirstIndex = 0;
+		for (auto& entry : cellBuilds) {
+			CellBuild& cell = entry.second;
+			CellFileEntry fileEntry{};
+			fileEntry.coord[0] = entry.first.first;
+			fileEntry.coord[1] = entry.first.second;
+			memcpy(fileEntry.min, &cell.min, sizeof(fileEntry.min));
+			memcpy(fileEntry.max, &cell.max, sizeof(fileEntry.max));
+			fileEntry.vertexCount = static_cast<uint32_t>(cell.vertices.size());
+			fileEntry.indexCount = static_cast<uint32_t>(cell.indices.size());
+			fileEntry.dataOffset = dataOffset;
+			fileEntry.proxyVertexOffset = proxyVertexOffset;
+			fileEntry.proxyFirstIndex = proxyFirstIndex;
+			fileEntry.proxyIndexCount = static_cast<uint32_t>(cell.proxyIndices.size());
+			entries.push_back(fileEntry);
+			// Vertices are a multiple of four bytes, so the indices directly follow them, matching the layout of the cell's buffer
+			dataOffset += cell.vertices.size() * sizeof(Vertex) + cell.indices.size() * sizeof(uint32_t);
+			proxyVertexOffset += static_cast<uint32_t>(cell.proxyVertices.size());
+			proxyFirstIndex += static_cast<uint32_t>(cell.proxyIndices.size());
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CellFileEntry));
+		for (auto& entry : cellBuilds) {
+			file.write(reinterpret_cast<const char*>(entry.second.proxyVertices.data()), entry.second.proxyVertices.size() * sizeof(Vertex));
+		}
+		for (auto& entry : cellBuilds) {
+			file.write(reinterpret_cast<const char*>(entry.second.proxyIndices.data()), entry.second.proxyIndices.size() * sizeof(uint32_t));
+		}
+		for (auto& entry : cellBuilds) {
+			file.write(reinterpret_cast<const char*>(entry.second.vertices.data()), entry.second.vertices.size() * sizeof(Vertex));
+			file.write(reinterpret_cast<const char*>(entry.second.indices.data()), entry.second.indices.size() * sizeof(uint32_t));
+		}
+		return file.good();
+	}
+
+	/**
+	* Open a glTF scene for streaming, the cell file is (re)built if it doesn't exist yet or is outdated
+	*
+	* @param filename glTF file of the scene
+	* @param device Vulkan device to stream the cells to
+	* @param queue Graphics queue the cells are used on
+	* @param cellSize (Optional) Size of the grid cells in scene units
+	* @param proxyRatio (Optional) Ratio of the triangles kept for the proxies of the cells
+	*/
+	void StreamingScene::open(const std::string& filename, vks::VulkanDevice* device, VkQueue queue, float cellSize, float proxyRatio)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->queue = queue;
+		this->cellSize = cellSize;
+		cellFilename = filename + ".vkcells";
+
+		CellFileHeader header;
+		std::ifstream file(cellFilename, std::ios::binary);
+		if (!readCellFileHeader(file, filename, cellSize, proxyRatio, header)) {
+			file.close();
+			if (!build(filename, cellFilename, device, queue, cellSize, proxyRatio)) {
+				vks::tools::exitFatal("Could not build the cell file for " + filename, -1);
+				return;
+			}
+			file.open(cellFilename, std::ios::binary);
+			if (!readCellFileHeader(file, filename, cellSize, proxyRatio, header)) {
+				vks::tools::exitFatal("Could not read the cell file " + cellFilename, -1);
+				return;
+			}
+		}
+
+		// Only the cell table and the proxies are read up front, the full cell data is read on demand
+		std::vector<CellFileEntry> entries(header.cellCount);
+		file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(CellFileEntry));
+		cells.resize(header.cellCount);
+		for (uint32_t i = 0; i < header.cellCount; i++) {
+			const CellFileEntry& entry = entries[i];
+			Cell& cell = cells[i];
+			cell.coord = glm::ivec2(entry.coord[0], entry.coord[1]);
+			cell.min = glm::vec3(entry.min[0], entry.min[1], entry.min[2]);
+			cell.max = glm::vec3(entry.max[0], entry.max[1], entry.max[2]);
+			cell.vertexCount = entry.vertexCount;
+			cell.indexCount = entry.indexCount;
+			cell.dataOffset = entry.dataOffset;
+			cell.proxyVertexOffset = entry.proxyVertexOffset;
+			cell.proxyFirstIndex = entry.proxyFirstIndex;
+			cell.proxyIndexCount = entry.proxyIndexCount;
+		}
+
+		proxyIndexOffset = (VkDeviceSize)header.proxyVertexCount * sizeof(Vertex);
+		std::vector<uint8_t> proxyData(proxyIndexOffset + (VkDeviceSize)header.proxyIndexCount * sizeof(uint32_t));
+		file.read(reinterpret_cast<char*>(proxyData.data()), proxyData.size());
+		if (!file) {
+			vks::tools::exitFatal("Could not read the cell file " + cellFilename, -1);
+			return;
+		}
+		file.close();
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &proxyBuffer, std::max<VkDeviceSize>(proxyData.size(), 4)));
+		vks::Buffer staging;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging, proxyBuffer.size, proxyData.data()));
+		device->copyBuffer(&staging, &proxyBuffer, queue);
+		staging.destroy();
+
+		readerFile.open(cellFilename, std::ios::binary);
+		reader = make_unique<vks::Thread>();
+	}
+
+	/** @brief Release the geometry of a resident cell once the frames in flight are done with it */
+	void StreamingScene::evict(Cell& cell)
+	{
+		assert(cell.state == CellState::Resident);
+		device->deletionQueue.buffer(cell.buffer);
+		residentBytes -= cell.size();
+		cell.state = CellState::Unloaded;
+		statistics.cellsEvicted++;
+	}
+
+	/** @brief Upload the cells read by the worker thread on the transfer queue */
+	void StreamingScene::uploadCompletedReads()
+	{
+		std::vector<CompletedRead> reads;
+		{
+			std::lock_guard<std::mutex> lock(readMutex);
+			reads.swap(completedReads);
+		}
+		if (reads.empty()) {
+			return;
+		}
+		device->beginAsyncUploadBatch();
+		VkCommandBuffer copyCmd = device->beginUpload();
+		std::vector<uint32_t> uploaded;
+		for (auto& read : reads) {
+			Cell& cell = cells[read.cell];
+			if (read.data.size() != cell.size()) {
+				// Failed reads are retried once the cell is requested again
+				pendingBytes -= cell.size();
+				cell.state = CellState::Unloaded;
+				continue;
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cell.buffer, cell.size()));
+			// The copy has to be recorded before the next staging allocation (see StagingRing)
+			vks::StagingRing::Allocation staging = device->stagingRing.allocate(cell.size());
+			memcpy(staging.data, read.data.data(), read.data.size());
+			VkBufferCopy copyRegion = { staging.offset, 0, cell.size() };
+			vkCmdCopyBuffer(copyCmd, staging.buffer, cell.buffer.buffer, 1, &copyRegion);
+			device->finishBufferUpload(copyCmd, cell.buffer.buffer);
+			statistics.bytesUploaded += cell.size();
+			cell.state = CellState::Uploading;
+			uploaded.push_back(read.cell);
+		}
+		device->endUpload(copyCmd, queue);
+		const uint64_t uploadId = device->endAsyncUploadBatch(queue);
+		for (uint32_t index : uploaded) {
+			cells[index].uploadId = uploadId;
+		}
+	}
+
+	/**
+	* Update the cell priorities and stream cells in and out, should be called once per frame before recording the draws
+	*
+	* @param cameraPosition World space position of the camera
+	* @param viewProjection View projection matrix used for the visibility of the cells
+	*/
+	void StreamingScene::update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection)
+	{
+		assert(device != nullptr);
+		uploadCompletedReads();
+
+		frustum.update(viewProjection);
+		for (auto& cell : cells) {
+			if ((cell.state == CellState::Uploading) && device->asyncUploadComplete(cell.uploadId)) {
+				pendingBytes -= cell.size();
+				residentBytes += cell.size();
+				cell.state = CellState::Resident;
+			}
+			const glm::vec3 closest = glm::clamp(cameraPosition, cell.min, cell.max);
+			cell.distance = glm::length(cameraPosition - closest);
+			const glm::vec3 center = (cell.min + cell.max) * 0.5f;
+			cell.visible = frustum.checkSphere(center, glm::length(cell.max - center));
+			cell.priority = cell.visible ? cell.distance : cell.distance * invisiblePenalty;
+			// Some distance is kept between streaming in and out, so cells at the border don't get streamed in and out repeatedly
+			if ((cell.state == CellState::Resident) && (cell.distance > streamingDistance * 1.5f)) {
+				evict(cell);
+			}
+		}
+
+		// Most important missing cells first
+		auto lessImportant = [this](uint32_t a, uint32_t b) { return cells[a].priority > cells[b].priority; };
+		std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(lessImportant)> requests(lessImportant);
+		uint32_t pendingCells = 0;
+		for (uint32_t i = 0; i < cells.size(); i++) {
+			if ((cells[i].state == CellState::Reading) || (cells[i].state == CellState::Uploading)) {
+				pendingCells++;
+			}
+			if ((cells[i].state == CellState::Unloaded) && (cells[i].distance <= streamingDistance)) {
+				requests.push(i);
+			}
+		}
+
+		while (!requests.empty() && (pendingCells < maxPendingCells)) {
+			const uint32_t index = requests.top();
+			requests.pop();
+			Cell& cell = cells[index];
+			if (cell.size() > memoryBudget) {
+				continue;
+			}
+			// Make room by evicting resident cells that are less important than the requested one
+			while (residentBytes + pendingBytes + cell.size() > memoryBudget) {
+				Cell* victim = nullptr;
+				for (auto& resident : cells) {
+					if ((resident.state == CellState::Resident) && (resident.priority > cell.priority) && (!victim || (resident.priority > victim->priority))) {
+						victim = &resident;
+					}
+				}
+				if (!victim) {
+					break;
+				}
+				evict(*victim);
+			}
+			if (residentBytes + pendingBytes + cell.size() > memoryBudget) {
+				// All remaining requests are less important, so they wouldn't be able to evict anything either
+				break;
+			}
+			cell.state = CellState::Reading;
+			pendingBytes += cell.size();
+			pendingCells++;
+			statistics.cellsRead++;
+			const uint64_t offset = cell.dataOffset;
+			const VkDeviceSize size = cell.size();
+			reader->addJob([this, index, offset, size]() {
+				CompletedRead read;
+				read.cell = index;
+				read.data.resize(size);
+				readerFile.clear();
+				readerFile.seekg(offset);
+				if (!readerFile.read(reinterpret_cast<char*>(read.data.data()), size)) {
+					read.data.clear();
+				}
+				std::lock_guard<std::mutex> lock(readMutex);
+				completedReads.push_back(std::move(read));
+			});
+		}
+	}
+
+	/**
+	* Draw the visible cells, using their proxy if they aren't resident
+	*
+	* @param commandBuffer Command buffer to record the draws to
+	* @param drawProxies (Optional) Draw the proxies of cells that aren't resident
+	* @param pipelineLayout (Optional) Layout to push a vec4 tint to at offset 0 (white for resident cells, reddish for proxies)
+	* @param tintStages (Optional) Shader stages of the tint push constant
+	*/
+	void StreamingScene::draw(VkCommandBuffer commandBuffer, bool drawProxies, VkPipelineLayout pipelineLayout, VkShaderStageFlags tintStages)
+	{
+		statistics.cellsDrawn = 0;
+		statistics.proxiesDrawn = 0;
+		const VkDeviceSize offsets[1] = { 0 };
+		const glm::vec4 residentTint(1.0f);
+		const glm::vec4 proxyTint(1.0f, 0.5f, 0.5f, 1.0f);
+		if (pipelineLayout != VK_NULL_HANDLE) {
+			vkCmdPushConstants(commandBuffer, pipelineLayout, tintStages, 0, sizeof(glm::vec4), &residentTint);
+		}
+		for (auto& cell : cells) {
+			if (!cell.visible || (cell.state != CellState::Resident)) {
+				continue;
+			}
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &cell.buffer.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, cell.buffer.buffer, cell.indexOffset(), VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexed(commandBuffer, cell.indexCount, 1, 0, 0, 0);
+			statistics.cellsDrawn++;
+		}
+		if (!drawProxies) {
+			return;
+		}
+		// All proxies share one buffer, so it's only bound once
+		if (pipelineLayout != VK_NULL_HANDLE) {
+			vkCmdPushConstants(commandBuffer, pipelineLayout, tintStages, 0, sizeof(glm::vec4), &proxyTint);
+		}
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &proxyBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, proxyBuffer.buffer, proxyIndexOffset, VK_INDEX_TYPE_UINT32);
+		for (auto& cell : cells) {
+			if (!cell.visible || (cell.state == CellState::Resident) || (cell.proxyIndexCount == 0)) {
+				continue;
+			}
+			vkCmdDrawIndexed(commandBuffer, cell.proxyIndexCount, 1, cell.proxyFirstIndex, static_cast<int32_t>(cell.proxyVertexOffset), 0);
+			statistics.proxiesDrawn++;
+		}
+	}
+
+	uint32_t StreamingScene::cellCount(CellState state) const
+	{
+		return static_cast<uint32_t>(std::count_if(cells.begin(), cells.end(), [state](const Cell& cell) { return cell.state == state; }));
+	}
+
+	/** @brief Release all resources, the device must be idle */
+	void StreamingScene::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		// Finish pending reads before the file and the cells go away
+		reader.reset();
+		readerFile.close();
+		completedReads.clear();
+		device->updateAsyncUploads(true);
+		for (auto& cell : cells) {
+			cell.buffer.destroy();
+		}
+		cells.clear();
+		proxyBuffer.destroy();
+		residentBytes = 0;
+		pendingBytes = 0;
+		device = nullptr;
+	}
+}
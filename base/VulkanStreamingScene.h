@@ -0,0 +1,130 @@
+/*
+* Vulkan streaming scene
+*
+* Spatially partitioned glTF scene whose cells are streamed in and out around the camera
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <fstream>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "threadpool.hpp"
+#include "frustum.hpp"
+
+namespace vks
+{
+	/**
+	* @brief glTF scene partitioned into grid cells that are streamed in around the camera
+	*
+	* The scene is partitioned once at cache-build time: The primitives of all nodes are assigned to the cells of a uniform grid in the xz plane
+	* (by the center of their bounds) and each cell's geometry is written to a cell file next to the glTF file, along with a simplified proxy of it.
+	* Opening the scene only reads the cell table and the proxies, which stay resident and are drawn for all cells that haven't arrived (yet).
+	*
+	* Each update assigns the cells a priority from their distance to the camera, with cells outside of the view frustum counting as further away.
+	* The most important missing cells within the streaming distance are read by a worker thread and uploaded on the transfer queue
+	* (see VulkanDevice::beginAsyncUploadBatch), so neither the file reads nor the uploads stall rendering. The geometry of the resident cells is limited by a
+	* memory budget, less important cells are evicted to make room for more important ones.
+	*
+	* @note Only geometry (with vertex colors pre-multiplied by the material's base color) is streamed, materials and textures are not
+	*/
+	class StreamingScene
+	{
+	public:
+		/** @brief Vertex layout of the streamed geometry */
+		struct Vertex {
+			glm::vec3 pos;
+			glm::vec3 normal;
+			glm::vec4 color;
+		};
+
+		enum class CellState { Unloaded, Reading, Uploading, Resident };
+
+		struct Cell {
+			glm::ivec2 coord;
+			glm::vec3 min;
+			glm::vec3 max;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			// Offset of the cell's vertices (followed by its indices) in the cell file
+			uint64_t dataOffset;
+			// Proxy range in the proxy buffer
+			uint32_t proxyVertexOffset;
+			uint32_t proxyFirstIndex;
+			uint32_t proxyIndexCount;
+
+			CellState state = CellState::Unloaded;
+			// Distance of the camera to the cell's bounds, priority is the distance weighted by the cell's visibility (lower is more important)
+			float distance = 0.0f;
+			float priority = 0.0f;
+			bool visible = false;
+			vks::Buffer buffer;
+			uint64_t uploadId = 0;
+			// Size of the cell's vertices and indices
+			VkDeviceSize size() const;
+			VkDeviceSize indexOffset() const;
+		};
+
+		struct Statistics {
+			uint32_t cellsRead = 0;
+			uint32_t cellsEvicted = 0;
+			uint32_t cellsDrawn = 0;
+			uint32_t proxiesDrawn = 0;
+			VkDeviceSize bytesUploaded = 0;
+		} statistics;
+
+	private:
+		vks::VulkanDevice* device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		std::string cellFilename;
+		vks::Frustum frustum;
+		// Reads the cell data from the cell file, so file accesses never block the render thread
+		std::unique_ptr<vks::Thread> reader;
+		std::mutex readMutex;
+		struct CompletedRead {
+			uint32_t cell;
+			std::vector<uint8_t> data;
+		};
+		std::vector<CompletedRead> completedReads;
+		// Only accessed by the reader thread
+		std::ifstream readerFile;
+
+		static bool build(const std::string& filename, const std::string& cellFilename, vks::VulkanDevice* device, VkQueue queue, float cellSize, float proxyRatio);
+		void evict(Cell& cell);
+		void uploadCompletedReads();
+
+	public:
+		std::vector<Cell> cells;
+		float cellSize = 0.0f;
+		/** @brief Proxies of all cells, vertices followed by indices */
+		vks::Buffer proxyBuffer;
+		VkDeviceSize proxyIndexOffset = 0;
+		/** @brief Cells within this distance of the camera are streamed in */
+		float streamingDistance = 20.0f;
+		/** @brief Cells outside of the view frustum are treated as this much further away */
+		float invisiblePenalty = 4.0f;
+		/** @brief Max. size of the geometry of all resident (and pending) cells in bytes */
+		VkDeviceSize memoryBudget = 64 * 1024 * 1024;
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize pendingBytes = 0;
+		/** @brief Max. number of cells being read or uploaded at the same time */
+		uint32_t maxPendingCells = 4;
+
+		~StreamingScene();
+		void open(const std::string& filename, vks::VulkanDevice* device, VkQueue queue, float cellSize = 8.0f, float proxyRatio = 0.05f);
+		void update(const glm::vec3& cameraPosition, const glm::mat4& viewProjection);
+		void draw(VkCommandBuffer commandBuffer, bool drawProxies = true, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, VkShaderStageFlags tintStages = 0);
+		uint32_t cellCount(CellState state) const;
+		void destroy();
+	};
+}
@@ -0,0 +1,325 @@
+/*
+* Vulkan submit context
+*
+* Recycles the command buffers and fences of one-shot submissions (uploads, layout transitions, etc.)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSubmitContext.h"
+
+namespace vks
+{
+	SubmitContext::~SubmitContext()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the submit context
+	*
+	* @param device Logical device to create the fences and command buffers on
+	*/
+	void SubmitContext::setup(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	/**
+	* Recycle the primary command buffers of a pool
+	*
+	* @param pool Command pool that's owned by the caller of setup and outlives the submit context
+	*/
+	void SubmitContext::manage(VkCommandPool pool)
+	{
+		if (!findPool(pool))
+		{
+			Pool managedPool{};
+			managedPool.handle = pool;
+			pools.push_back(managedPool);
+		}
+	}
+
+	SubmitContext::Pool* SubmitContext::findPool(VkCommandPool pool)
+	{
+		for (auto& managedPool : pools) {
+			if (managedPool.handle == pool) {
+				return &managedPool;
+			}
+		}
+		return nullptr;
+	}
+
+	VkFence SubmitContext::getFence()
+	{
+		if (!freeFences.empty())
+		{
+			VkFence fence = freeFences.back();
+			freeFences.pop_back();
+			return fence;
+		}
+		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+		VkFence fence;
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+		createdFences++;
+		return fence;
+	}
+
+	/**
+	* Get a primary command buffer
+	*
+	* @param pool Command pool to allocate the command buffer from, a recycled command buffer is returned if the pool is managed and has one
+	* @param (Optional) begin If true, recording on the command buffer will be started (vkBeginCommandBuffer) (Defaults to false)
+	*
+	* @return A command buffer in the initial (or recording) state
+	*/
+	VkCommandBuffer SubmitContext::allocate(VkCommandPool pool, bool begin)
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		Pool* managedPool = findPool(pool);
+		if (managedPool && !managedPool->freeCommandBuffers.empty())
+		{
+			commandBuffer = managedPool->freeCommandBuffers.back();
+			managedPool->freeCommandBuffers.pop_back();
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			createdCommandBuffers++;
+		}
+		if (begin)
+		{
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		}
+		return commandBuffer;
+	}
+
+	void SubmitContext::release(const CommandBuffer& commandBuffer)
+	{
+		// Command buffers the caller keeps ownership of are tracked with a null pool
+		if (commandBuffer.pool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		Pool* managedPool = findPool(commandBuffer.pool);
+		if (managedPool)
+		{
+			VK_CHECK_RESULT(vkResetCommandBuffer(commandBuffer.handle, 0));
+			managedPool->freeCommandBuffers.push_back(commandBuffer.handle);
+		}
+		else
+		{
+			vkFreeCommandBuffers(device, commandBuffer.pool, 1, &commandBuffer.handle);
+		}
+	}
+
+	/**
+	* Return a command buffer that is not (or no longer) in use by the device
+	*
+	* @param commandBuffer Command buffer obtained from allocate
+	* @param pool Command pool the command buffer has been allocated from
+	*/
+	void SubmitContext::release(VkCommandBuffer commandBuffer, VkCommandPool pool)
+	{
+		release(CommandBuffer{ commandBuffer, pool });
+	}
+
+	uint64_t SubmitContext::submit(VkQueue queue, std::vector<CommandBuffer>& commandBuffers, uint64_t ticket)
+	{
+		std::vector<VkCommandBuffer> handles(commandBuffers.size());
+		for (size_t i = 0; i < commandBuffers.size(); i++) {
+			handles[i] = commandBuffers[i].handle;
+		}
+		Submission submission{};
+		submission.ticket = ticket;
+		submission.fence = getFence();
+		submission.commandBuffers = std::move(commandBuffers);
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = static_cast<uint32_t>(handles.size());
+		submitInfo.pCommandBuffers = handles.data();
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, submission.fence));
+		submissions.push_back(std::move(submission));
+		return ticket;
+	}
+
+	/**
+	* Submit a command buffer without waiting for it
+	*
+	* @param queue Queue to submit the command buffer to
+	* @param commandBuffer Command buffer that has finished recording (vkEndCommandBuffer)
+	* @param pool Command pool the command buffer has been allocated from, it's released to the pool once the submission completes.
+	* Pass VK_NULL_HANDLE to keep ownership of the command buffer (e.g. to record it again after waiting for the ticket)
+	*
+	* @return Ticket of the submission that can be passed to complete() and wait()
+	*/
+	uint64_t SubmitContext::submit(VkQueue queue, VkCommandBuffer commandBuffer, VkCommandPool pool)
+	{
+		return submit(queue, std::vector<VkCommandBuffer>{ commandBuffer }, pool);
+	}
+
+	/**
+	* Submit several command buffers with a single vkQueueSubmit without waiting for them
+	*
+	* @param queue Queue to submit the command buffers to
+	* @param commandBuffers Command buffers that have finished recording, executed in order
+	* @param pool Command pool the command buffers have been allocated from (or VK_NULL_HANDLE to keep ownership)
+	*
+	* @return Ticket of the submission that can be passed to complete() and wait()
+	*/
+	uint64_t SubmitContext::submit(VkQueue queue, const std::vector<VkCommandBuffer>& commandBuffers, VkCommandPool pool)
+	{
+		std::vector<CommandBuffer> tracked;
+		tracked.reserve(commandBuffers.size());
+		for (auto commandBuffer : commandBuffers) {
+			tracked.push_back({ commandBuffer, pool });
+		}
+		return submit(queue, tracked, ++lastTicket);
+	}
+
+	/**
+	* Add a command buffer to the batch of a queue, the batch is submitted with a single vkQueueSubmit by flush()
+	*
+	* @param queue Queue the batch will be submitted to
+	* @param commandBuffer Command buffer that has finished recording
+	* @param pool Command pool the command buffer has been allocated from (or VK_NULL_HANDLE to keep ownership)
+	*
+	* @return Ticket of the batch, waiting on it submits the batch if that hasn't happened yet
+	*/
+	uint64_t SubmitContext::enqueue(VkQueue queue, VkCommandBuffer commandBuffer, VkCommandPool pool)
+	{
+		for (auto& batch : batches)
+		{
+			if (batch.queue == queue)
+			{
+				batch.commandBuffers.push_back({ commandBuffer, pool });
+				return batch.ticket;
+			}
+		}
+		Batch batch{};
+		batch.queue = queue;
+		batch.ticket = ++lastTicket;
+		batch.commandBuffers.push_back({ commandBuffer, pool });
+		batches.push_back(std::move(batch));
+		return lastTicket;
+	}
+
+	/**
+	* Submit the batch of command buffers enqueued for a queue
+	*
+	* @return Ticket of the batch, or 0 if nothing has been enqueued for the queue
+	*/
+	uint64_t SubmitContext::flush(VkQueue queue)
+	{
+		for (auto it = batches.begin(); it != batches.end(); ++it)
+		{
+			if (it->queue == queue)
+			{
+				Batch batch = std::move(*it);
+				batches.erase(it);
+				return submit(batch.queue, batch.commandBuffers, batch.ticket);
+			}
+		}
+		return 0;
+	}
+
+	void SubmitContext::retire(Submission& submission)
+	{
+		VK_CHECK_RESULT(vkResetFences(device, 1, &submission.fence));
+		freeFences.push_back(submission.fence);
+		for (auto& commandBuffer : submission.commandBuffers) {
+			release(commandBuffer);
+		}
+	}
+
+	/**
+	* Recycle the fences and command buffers of all completed submissions
+	*
+	* @param wait (Optional) Wait for all submissions to complete (Defaults to false)
+	*
+	* @note Submissions to different queues may complete out of order, so all of them are checked
+	*/
+	void SubmitContext::update(bool wait)
+	{
+		for (auto it = submissions.begin(); it != submissions.end();)
+		{
+			if (wait) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &it->fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			} else if (vkGetFenceStatus(device, it->fence) != VK_SUCCESS) {
+				++it;
+				continue;
+			}
+			retire(*it);
+			it = submissions.erase(it);
+		}
+	}
+
+	/** @brief Returns true if the submission with the given ticket has completed on the device */
+	bool SubmitContext::complete(uint64_t ticket)
+	{
+		for (auto& batch : batches) {
+			if (batch.ticket == ticket) {
+				return false;
+			}
+		}
+		update();
+		for (auto& submission : submissions) {
+			if (submission.ticket == ticket) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** @brief Wait until the submission with the given ticket has completed, submits the ticket's batch first if it's still pending */
+	void SubmitContext::wait(uint64_t ticket)
+	{
+		for (auto& batch : batches)
+		{
+			if (batch.ticket == ticket)
+			{
+				flush(batch.queue);
+				break;
+			}
+		}
+		for (auto it = submissions.begin(); it != submissions.end(); ++it)
+		{
+			if (it->ticket == ticket)
+			{
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &it->fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				retire(*it);
+				submissions.erase(it);
+				break;
+			}
+		}
+		// Also recycle anything else that has finished in the meantime
+		update();
+	}
+
+	/** @brief Release all fences and recycled command buffers, submits pending batches and waits for all submissions to complete */
+	void SubmitContext::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		while (!batches.empty()) {
+			flush(batches.front().queue);
+		}
+		update(true);
+		for (auto fence : freeFences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
+		freeFences.clear();
+		for (auto& pool : pools)
+		{
+			if (!pool.freeCommandBuffers.empty()) {
+				vkFreeCommandBuffers(device, pool.handle, static_cast<uint32_t>(pool.freeCommandBuffers.size()), pool.freeCommandBuffers.data());
+			}
+		}
+		pools.clear();
+		device = VK_NULL_HANDLE;
+	}
+}
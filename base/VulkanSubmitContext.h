@@ -0,0 +1,92 @@
+/*
+* Vulkan submit context
+*
+* Recycles the command buffers and fences of one-shot submissions (uploads, layout transitions, etc.)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Submission of one-shot command buffers without per call allocations
+	*
+	* Each submission gets a fence from a free list and returns a ticket, tickets increase with each submission (or batch) and can be passed
+	* to complete() and wait() instead of blocking right away. Once a submission's fence has been signaled, the fence is reset and handed out
+	* again and the primary command buffers of managed pools (see manage) are reset and returned to that pool's free list, so a loader that
+	* submits dozens of uploads only allocates a handful of command buffers and fences.
+	* Command buffers can be enqueued into a batch per queue that's submitted with a single vkQueueSubmit on flush() (or when its ticket is waited on).
+	*
+	* @note Command buffers from pools that aren't managed are freed instead of recycled, as the pool may be destroyed by its owner at any time
+	* @note Managed pools must have been created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+	*/
+	class SubmitContext
+	{
+	private:
+		struct CommandBuffer
+		{
+			VkCommandBuffer handle;
+			VkCommandPool pool;
+		};
+		struct Pool
+		{
+			VkCommandPool handle;
+			std::vector<VkCommandBuffer> freeCommandBuffers;
+		};
+		struct Batch
+		{
+			VkQueue queue;
+			uint64_t ticket;
+			std::vector<CommandBuffer> commandBuffers;
+		};
+		struct Submission
+		{
+			uint64_t ticket;
+			VkFence fence;
+			std::vector<CommandBuffer> commandBuffers;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<Pool> pools;
+		std::vector<VkFence> freeFences;
+		std::vector<Batch> batches;
+		std::deque<Submission> submissions;
+		uint64_t lastTicket = 0;
+
+		Pool* findPool(VkCommandPool pool);
+		VkFence getFence();
+		uint64_t submit(VkQueue queue, std::vector<CommandBuffer>& commandBuffers, uint64_t ticket);
+		void release(const CommandBuffer& commandBuffer);
+		void retire(Submission& submission);
+
+	public:
+		/** @brief Number of command buffers and fences that have been created, for checking how well they are recycled */
+		uint32_t createdCommandBuffers = 0;
+		uint32_t createdFences = 0;
+
+		~SubmitContext();
+		void setup(VkDevice device);
+		void manage(VkCommandPool pool);
+		VkCommandBuffer allocate(VkCommandPool pool, bool begin = false);
+		void release(VkCommandBuffer commandBuffer, VkCommandPool pool);
+		uint64_t submit(VkQueue queue, VkCommandBuffer commandBuffer, VkCommandPool pool);
+		uint64_t submit(VkQueue queue, const std::vector<VkCommandBuffer>& commandBuffers, VkCommandPool pool);
+		uint64_t enqueue(VkQueue queue, VkCommandBuffer commandBuffer, VkCommandPool pool);
+		uint64_t flush(VkQueue queue);
+		void update(bool wait = false);
+		bool complete(uint64_t ticket);
+		void wait(uint64_t ticket);
+		void destroy();
+	};
+}
@@ -10,6 +10,33 @@
 
 #include "VulkanSwapChain.h"
 
+#include <fstream>
+#include <chrono>
+
+// Writes a frame read back from a headless swap chain image (4 bytes per pixel) to a binary PPM file
+static void writeReadbackFile(const std::string& fileName, const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, bool bgra)
+{
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write " << fileName << "\n";
+		return;
+	}
+	file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+	std::vector<char> row(width * 3);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* pixel = &pixels[(y * width + x) * 4];
+			row[x * 3 + 0] = bgra ? pixel[2] : pixel[0];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = bgra ? pixel[0] : pixel[2];
+		}
+		file.write(row.data(), row.size());
+	}
+}
+
 /** @brief Creates the platform specific surface abstraction of the native platform window used for presentation */	
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 void VulkanSwapChain::initSurface(void* platformHandle, void* platformWindow)
@@ -189,6 +216,40 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 
 }
 
+/**
+* Render to offscreen images instead of presenting to a surface, e.g. on machines without a window system
+*
+* The images are cycled through by acquireNextImage and "presented" by queuePresent without a presentation engine, so frames are only limited by the GPU
+* Like swap chain images, the images are expected in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR after rendering, so the device needs VK_KHR_swapchain to be enabled (but no surface)
+*
+* @param queue Queue the semaphores passed to acquireNextImage and queuePresent are signaled and waited on, also used for the readback
+* @param queueFamilyIndex Family of the queue
+*
+* @note Must be called after connect and instead of initSurface
+*/
+void VulkanSwapChain::initHeadless(VkQueue queue, uint32_t queueFamilyIndex)
+{
+	headless = true;
+	headlessQueue = queue;
+	queueNodeIndex = queueFamilyIndex;
+
+	// Use the same format a surface would usually be created with
+	colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+	{
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	VkCommandPoolCreateInfo commandPoolCI{};
+	commandPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCI.queueFamilyIndex = queueFamilyIndex;
+	VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCI, nullptr, &headlessCommandPool));
+}
+
 /**
 * Set instance, physical and logical device to use for the swapchain and get all required function pointers
 * 
@@ -212,6 +273,9 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 	fpGetSwapchainImagesKHR = reinterpret_cast<PFN_vkGetSwapchainImagesKHR>(vkGetDeviceProcAddr(device, "vkGetSwapchainImagesKHR"));
 	fpAcquireNextImageKHR = reinterpret_cast<PFN_vkAcquireNextImageKHR>(vkGetDeviceProcAddr(device, "vkAcquireNextImageKHR"));
 	fpQueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(vkGetDeviceProcAddr(device, "vkQueuePresentKHR"));
+
+	fpGetRefreshCycleDurationGOOGLE = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(vkGetDeviceProcAddr(device, "vkGetRefreshCycleDurationGOOGLE"));
+	fpGetPastPresentationTimingGOOGLE = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE"));
 }
 
 /** 
@@ -219,10 +283,16 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 * 
 * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
-* @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+* @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode) if no supported present mode has been requested (see requestedPresentMode)
 */
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 {
+	if (headless)
+	{
+		createHeadless(*width, *height);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -262,9 +332,21 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 	// This mode waits for the vertical blank ("v-sync")
 	VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
+	// Use the explicitly requested present mode if it's supported:
+	// FIFO_RELAXED only tears if a frame misses the vertical blank, MAILBOX replaces queued images instead of blocking and IMMEDIATE doesn't wait for the vertical blank at all
+	const bool requestedPresentModeSupported = std::find(presentModes.begin(), presentModes.end(), requestedPresentMode) != presentModes.end();
+	if (requestedPresentModeSupported)
+	{
+		swapchainPresentMode = requestedPresentMode;
+	}
+	else if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+	{
+		std::cerr << "Present mode " << vks::tools::presentModeString(requestedPresentMode) << " is not supported by the surface\n";
+	}
+
 	// If v-sync is not requested, try to find a mailbox mode
 	// It's the lowest latency non-tearing present mode available
-	if (!vsync)
+	if (!vsync && !requestedPresentModeSupported)
 	{
 		for (size_t i = 0; i < presentModeCount; i++)
 		{
@@ -280,8 +362,15 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 		}
 	}
 
+	presentMode = swapchainPresentMode;
+
 	// Determine the number of images
-	uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
+	// Fewer images reduce the number of frames that can be queued for presentation (and with that the latency) with FIFO, MAILBOX needs at least three to not block
+	uint32_t desiredNumberOfSwapchainImages = (requestedImageCount > 0) ? requestedImageCount : surfCaps.minImageCount + 1;
+	if (desiredNumberOfSwapchainImages < surfCaps.minImageCount)
+	{
+		desiredNumberOfSwapchainImages = surfCaps.minImageCount;
+	}
 	if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount))
 	{
 		desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
@@ -289,7 +378,19 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 
 	// Find the transformation of the surface
 	VkSurfaceTransformFlagsKHR preTransform;
-	if (surfCaps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+	const VkSurfaceTransformFlagsKHR rotations = VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR;
+	if (preRotate && (surfCaps.currentTransform & rotations))
+	{
+		// The images match the display's native orientation and the content is rendered rotated, so the presentation engine doesn't have to rotate them
+		// The current extent is in the rotated orientation, so it's swapped for quarter rotations
+		preTransform = surfCaps.currentTransform;
+		if (surfCaps.currentTransform & (VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR))
+		{
+			std::swap(swapchainExtent.width, swapchainExtent.height);
+			std::swap(*width, *height);
+		}
+	}
+	else if (surfCaps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
 	{
 		// We prefer a non-rotated transform
 		preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
@@ -298,6 +399,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 	{
 		preTransform = surfCaps.currentTransform;
 	}
+	transform = (VkSurfaceTransformFlagBitsKHR)preTransform;
 
 	// Find a supported composite alpha format (not all devices support alpha opaque)
 	VkCompositeAlphaFlagBitsKHR compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -346,15 +448,24 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 
 	VK_CHECK_RESULT(fpCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
 
-	// If an existing swap chain is re-created, destroy the old swap chain
+	// If an existing swap chain is re-created, destroy the old swap chain (or retire it, if its images may still be in use)
 	// This also cleans up all the presentable images
 	if (oldSwapchain != VK_NULL_HANDLE) 
 	{ 
+		RetiredSwapChain retiredSwapChain;
+		retiredSwapChain.swapChain = oldSwapchain;
 		for (uint32_t i = 0; i < imageCount; i++)
 		{
-			vkDestroyImageView(device, buffers[i].view, nullptr);
+			retiredSwapChain.views.push_back(buffers[i].view);
+		}
+		if (deferRetirement)
+		{
+			retired.push_back(retiredSwapChain);
+		}
+		else
+		{
+			destroyRetired(retiredSwapChain);
 		}
-		fpDestroySwapchainKHR(device, oldSwapchain, nullptr);
 	}
 	VK_CHECK_RESULT(fpGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL));
 
@@ -404,6 +515,21 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync)
 */
 VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 {
+	if (headless)
+	{
+		// Images are used in order, there is no presentation engine to wait for, so the semaphore is signaled right away
+		*imageIndex = headlessImageIndex;
+		headlessImageIndex = (headlessImageIndex + 1) % imageCount;
+		if (presentCompleteSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		return vkQueueSubmit(headlessQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
 	return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -420,6 +546,10 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (headless)
+	{
+		return presentHeadless(imageIndex, waitSemaphore);
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -432,15 +562,118 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 		presentInfo.pWaitSemaphores = &waitSemaphore;
 		presentInfo.waitSemaphoreCount = 1;
 	}
+	// Tag the present with an id, so its timing can be matched up with the frame later on
+	// A desired present time of zero lets the presentation engine display the image as soon as possible, later times hold it back (e.g. to keep a steady frame rate)
+	VkPresentTimeGOOGLE presentTime{};
+	VkPresentTimesInfoGOOGLE presentTimesInfo{};
+	if (presentTiming)
+	{
+		presentTime.presentID = ++presentId;
+		presentTime.desiredPresentTime = desiredPresentTime;
+		presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		presentTimesInfo.swapchainCount = 1;
+		presentTimesInfo.pTimes = &presentTime;
+		presentInfo.pNext = &presentTimesInfo;
+	}
 	return fpQueuePresentKHR(queue, &presentInfo);
 }
 
+/**
+* Get the clockwise rotation the content needs to be rendered with to match the transform of the swap chain images
+*
+* @return Rotation in degrees (0, 90, 180 or 270), mirrored transforms are not handled and return 0
+*/
+uint32_t VulkanSwapChain::getPreRotation() const
+{
+	switch (transform) {
+	case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+		return 90;
+	case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+		return 180;
+	case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+		return 270;
+	default:
+		return 0;
+	}
+}
+
+/**
+* Get the duration of a refresh cycle of the display the swap chain is presented to
+*
+* @return Refresh duration in nanoseconds, 0 if presentTiming is not enabled
+*/
+uint64_t VulkanSwapChain::getRefreshCycleDuration()
+{
+	VkRefreshCycleDurationGOOGLE refreshCycleDuration{};
+	if (presentTiming)
+	{
+		VK_CHECK_RESULT(fpGetRefreshCycleDurationGOOGLE(device, swapChain, &refreshCycleDuration));
+	}
+	return refreshCycleDuration.refreshDuration;
+}
+
+/**
+* Get the timings of the presents that have been displayed since the last call
+*
+* @note Times are in the clock domain of the presentation engine (CLOCK_MONOTONIC on Linux and Android)
+*
+* @return Timings of the displayed presents, empty if presentTiming is not enabled
+*/
+std::vector<VkPastPresentationTimingGOOGLE> VulkanSwapChain::getPastPresentationTimings()
+{
+	std::vector<VkPastPresentationTimingGOOGLE> timings;
+	if (presentTiming)
+	{
+		uint32_t count = 0;
+		VK_CHECK_RESULT(fpGetPastPresentationTimingGOOGLE(device, swapChain, &count, nullptr));
+		timings.resize(count);
+		if (count > 0)
+		{
+			// May return VK_INCOMPLETE if more presents have been displayed in between, the rest is returned by the next call
+			VkResult result = fpGetPastPresentationTimingGOOGLE(device, swapChain, &count, timings.data());
+			if (result != VK_INCOMPLETE)
+			{
+				VK_CHECK_RESULT(result);
+			}
+			timings.resize(count);
+		}
+	}
+	return timings;
+}
+
+
+/**
+* Destroy a swap chain replaced by a recreation and the views of its images
+*
+* @param retiredSwapChain Swap chain taken from retired, must no longer be in use by any frame
+*/
+void VulkanSwapChain::destroyRetired(const RetiredSwapChain& retiredSwapChain)
+{
+	for (auto& view : retiredSwapChain.views)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	fpDestroySwapchainKHR(device, retiredSwapChain.swapChain, nullptr);
+}
 
 /**
 * Destroy and free Vulkan resources used for the swapchain
 */
 void VulkanSwapChain::cleanup()
 {
+	if (headless)
+	{
+		destroyHeadless();
+		vkDestroyCommandPool(device, headlessCommandPool, nullptr);
+		headlessCommandPool = VK_NULL_HANDLE;
+		headless = false;
+		return;
+	}
+	for (auto& retiredSwapChain : retired)
+	{
+		destroyRetired(retiredSwapChain);
+	}
+	retired.clear();
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
@@ -457,6 +690,254 @@ void VulkanSwapChain::cleanup()
 	swapChain = VK_NULL_HANDLE;
 }
 
+uint32_t VulkanSwapChain::getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+		{
+			return i;
+		}
+	}
+	vks::tools::exitFatal("Could not find a matching memory type for the headless swap chain", -1);
+	return 0;
+}
+
+/**
+* Create the offscreen images (and readback buffers) of a headless swap chain
+*/
+void VulkanSwapChain::createHeadless(uint32_t width, uint32_t height)
+{
+	destroyHeadless();
+	headlessExtent = { width, height };
+
+	// The images are reused in order without waiting, so there has to be at least one more than there are frames in flight
+	imageCount = std::max(requestedImageCount, 3u);
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	headlessMemory.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI{};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Same usage as swap chain images that support transfers
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		VkMemoryAllocateInfo memAllocInfo{};
+		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &headlessMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], headlessMemory[i], 0));
+
+		VkImageViewCreateInfo viewCI{};
+		viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = colorFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &buffers[i].view));
+	}
+
+	if (readbackInterval > 0)
+	{
+		// Two readbacks can be in flight, the next one only waits if the GPU hasn't finished the copy of the one before the last
+		readbacks.resize(2);
+		for (auto& readback : readbacks)
+		{
+			VkBufferCreateInfo bufferCI{};
+			bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCI.size = static_cast<VkDeviceSize>(width) * height * 4;
+			bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &readback.buffer));
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, readback.buffer, &memReqs);
+			VkMemoryAllocateInfo memAllocInfo{};
+			memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &readback.memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, readback.buffer, readback.memory, 0));
+			VK_CHECK_RESULT(vkMapMemory(device, readback.memory, 0, VK_WHOLE_SIZE, 0, &readback.mapped));
+
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
+			cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufAllocateInfo.commandPool = headlessCommandPool;
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdBufAllocateInfo.commandBufferCount = 1;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &readback.commandBuffer));
+
+			VkFenceCreateInfo fenceCI{};
+			fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &readback.fence));
+		}
+	}
+}
+
+/**
+* Destroy the images and readback buffers of a headless swap chain, waits for pending readbacks to be written
+*/
+void VulkanSwapChain::destroyHeadless()
+{
+	if (images.empty())
+	{
+		return;
+	}
+	VK_CHECK_RESULT(vkQueueWaitIdle(headlessQueue));
+	collectReadbacks(true);
+	for (auto& readbackWrite : readbackWrites)
+	{
+		readbackWrite.wait();
+	}
+	readbackWrites.clear();
+	for (auto& readback : readbacks)
+	{
+		vkDestroyBuffer(device, readback.buffer, nullptr);
+		vkFreeMemory(device, readback.memory, nullptr);
+		vkFreeCommandBuffers(device, headlessCommandPool, 1, &readback.commandBuffer);
+		vkDestroyFence(device, readback.fence, nullptr);
+	}
+	readbacks.clear();
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		vkDestroyImageView(device, buffers[i].view, nullptr);
+		vkDestroyImage(device, images[i], nullptr);
+		vkFreeMemory(device, headlessMemory[i], nullptr);
+	}
+	images.clear();
+	buffers.clear();
+	headlessMemory.clear();
+	headlessImageIndex = 0;
+}
+
+/**
+* "Present" an image of a headless swap chain, consumes the wait semaphore and starts the readback of the image if the frame is to be written to disk
+*/
+VkResult VulkanSwapChain::presentHeadless(uint32_t imageIndex, VkSemaphore waitSemaphore)
+{
+	collectReadbacks(false);
+	headlessFrame++;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// The semaphore has to be waited on before it can be signaled again, the copy of a readback is the only work that depends on it
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (waitSemaphore != VK_NULL_HANDLE)
+	{
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStageMask;
+	}
+
+	Readback* readback = nullptr;
+	if ((readbackInterval > 0) && (headlessFrame % readbackInterval == 0))
+	{
+		auto freeReadback = std::find_if(readbacks.begin(), readbacks.end(), [](const Readback& readback) { return !readback.pending; });
+		if (freeReadback == readbacks.end())
+		{
+			collectReadbacks(true);
+			freeReadback = readbacks.begin();
+		}
+		readback = &(*freeReadback);
+		readback->frame = headlessFrame;
+		readback->pending = true;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(readback->commandBuffer, &beginInfo));
+		VkImageMemoryBarrier imageBarrier{};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = images[imageIndex];
+		imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// The rendering has been made available by the semaphore wait
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		vkCmdPipelineBarrier(readback->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { headlessExtent.width, headlessExtent.height, 1 };
+		vkCmdCopyImageToBuffer(readback->commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback->buffer, 1, &region);
+		// Back to the layout the next frame rendering to this image expects
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageBarrier.dstAccessMask = 0;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		vkCmdPipelineBarrier(readback->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		// Make the copy visible to the host once the fence has been signaled
+		VkBufferMemoryBarrier bufferBarrier{};
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = readback->buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(readback->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(readback->commandBuffer));
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &readback->commandBuffer;
+	}
+
+	if ((submitInfo.waitSemaphoreCount == 0) && (readback == nullptr))
+	{
+		return VK_SUCCESS;
+	}
+	return vkQueueSubmit(headlessQueue, 1, &submitInfo, readback ? readback->fence : VK_NULL_HANDLE);
+}
+
+/**
+* Hand the readbacks the GPU has finished copying to a worker thread that writes them to disk
+*
+* @param wait Wait for pending copies to finish instead of skipping them
+*/
+void VulkanSwapChain::collectReadbacks(bool wait)
+{
+	for (auto& readback : readbacks)
+	{
+		if (!readback.pending)
+		{
+			continue;
+		}
+		if (wait)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &readback.fence, VK_TRUE, UINT64_MAX));
+		}
+		else if (vkGetFenceStatus(device, readback.fence) != VK_SUCCESS)
+		{
+			continue;
+		}
+		VK_CHECK_RESULT(vkResetFences(device, 1, &readback.fence));
+		// Copied out of the mapped buffer, so it can be reused while the file is written
+		const uint8_t* mapped = static_cast<const uint8_t*>(readback.mapped);
+		std::vector<uint8_t> pixels(mapped, mapped + static_cast<size_t>(headlessExtent.width) * headlessExtent.height * 4);
+		const std::string fileName = readbackPrefix + "_" + std::to_string(readback.frame) + ".ppm";
+		const bool bgra = (colorFormat == VK_FORMAT_B8G8R8A8_UNORM);
+		readbackWrites.push_back(std::async(std::launch::async, writeReadbackFile, fileName, std::move(pixels), headlessExtent.width, headlessExtent.height, bgra));
+		readback.pending = false;
+	}
+	// Drop the writes that have finished
+	readbackWrites.erase(std::remove_if(readbackWrites.begin(), readbackWrites.end(), [](std::future<void>& readbackWrite) { return readbackWrite.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }), readbackWrites.end());
+}
+
 #if defined(_DIRECT2DISPLAY)
 /**
 * Create direct to display surface
@@ -15,6 +15,8 @@
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
+#include <future>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
@@ -28,13 +30,19 @@ typedef struct _SwapChainBuffers {
 	VkImageView view;
 } SwapChainBuffer;
 
+/** @brief Swap chain replaced by a recreation along with the views of its images */
+struct RetiredSwapChain {
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	std::vector<VkImageView> views;
+};
+
 class VulkanSwapChain
 {
 private: 
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR; 
@@ -45,7 +53,59 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	// VK_GOOGLE_display_timing, only loaded if the device has the extension enabled
+	PFN_vkGetRefreshCycleDurationGOOGLE fpGetRefreshCycleDurationGOOGLE = nullptr;
+	PFN_vkGetPastPresentationTimingGOOGLE fpGetPastPresentationTimingGOOGLE = nullptr;
+	// Headless rendering (see initHeadless)
+	struct Readback {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		uint32_t frame = 0;
+		bool pending = false;
+	};
+	VkQueue headlessQueue = VK_NULL_HANDLE;
+	VkCommandPool headlessCommandPool = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> headlessMemory;
+	uint32_t headlessImageIndex = 0;
+	uint32_t headlessFrame = 0;
+	VkExtent2D headlessExtent = {};
+	std::vector<Readback> readbacks;
+	std::vector<std::future<void>> readbackWrites;
+	void createHeadless(uint32_t width, uint32_t height);
+	void destroyHeadless();
+	VkResult presentHeadless(uint32_t imageIndex, VkSemaphore waitSemaphore);
+	void collectReadbacks(bool wait);
+	uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
 public:
+	/** @brief Images are rendered to offscreen instead of being presented to a surface (see initHeadless) */
+	bool headless = false;
+	/** @brief Write every n-th frame of a headless swap chain to disk (0 = none), copied to the host and written as PPM without stalling the frame */
+	uint32_t readbackInterval = 0;
+	/** @brief File name prefix of the frames written by the headless readback, followed by the frame number */
+	std::string readbackPrefix = "frame";
+	/** @brief Present mode to create the swap chain with, VK_PRESENT_MODE_MAX_ENUM_KHR (or an unsupported mode) selects one based on the vsync argument of create */
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	/** @brief Number of images to create the swap chain with, 0 = one more than the minimum of the surface (clamped to the limits of the surface) */
+	uint32_t requestedImageCount = 0;
+	/** @brief Present mode the swap chain has been created with */
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	/** @brief Render in the orientation of rotated displays instead of having the presentation engine rotate the images, which saves a full-screen composition pass on mobile devices */
+	bool preRotate = false;
+	/** @brief Transform the images have been created with, with preRotate enabled the content needs to be rotated by it (see getPreRotation) */
+	VkSurfaceTransformFlagBitsKHR transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	/** @brief Tag each present with an id to read back when it was displayed (see getPastPresentationTimings), requires VK_GOOGLE_display_timing to be enabled on the device */
+	bool presentTiming = false;
+	/** @brief Id of the latest present if presentTiming is enabled */
+	uint32_t presentId = 0;
+	/** @brief Earliest time (in ns of CLOCK_MONOTONIC) the next present may be displayed at if presentTiming is enabled, zero displays it as soon as possible */
+	uint64_t desiredPresentTime = 0;
+	/** @brief Keep swap chains replaced by create in retired instead of destroying them right away, e.g. because frames in flight may still use their images */
+	bool deferRetirement = false;
+	/** @brief Swap chains replaced while deferRetirement is enabled, need to be destroyed with destroyRetired once they are no longer in use (or are destroyed by cleanup) */
+	std::vector<RetiredSwapChain> retired;
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;	
@@ -70,9 +130,14 @@ public:
 	void initSurface(uint32_t width, uint32_t height);
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height);
 #endif
+	void initHeadless(VkQueue queue, uint32_t queueFamilyIndex);
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
 	void create(uint32_t* width, uint32_t* height, bool vsync = false);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
+	uint32_t getPreRotation() const;
+	uint64_t getRefreshCycleDuration();
+	std::vector<VkPastPresentationTimingGOOGLE> getPastPresentationTimings();
+	void destroyRetired(const RetiredSwapChain& retiredSwapChain);
 	void cleanup();
 };
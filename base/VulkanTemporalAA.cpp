@@ -0,0 +1,468 @@
+/*
+* Vulkan temporal anti-aliasing
+*
+* Accumulates the jittered scene over several frames by reprojecting the previous result with a velocity buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTemporalAA.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+namespace vks
+{
+	// Low discrepancy sequence for the jitter positions, spreads the samples of any number of consecutive frames evenly over the pixel
+	static float halton(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / static_cast<float>(base);
+		while (index > 0) {
+			result += static_cast<float>(index % base) * fraction;
+			index /= base;
+			fraction /= static_cast<float>(base);
+		}
+		return result;
+	}
+
+	TemporalAA::~TemporalAA()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the render passes and the resolve and sharpen pipelines, the images are created by resize
+	*
+	* @param device Device to render on
+	* @param colorFormat Color format of the scene, same as the output so scene pipelines can be shared with the output render pass
+	* @param depthFormat Format of the depth stencil attachment shared with the output render pass
+	* @param resolveShaderStages Vertex and fragment shader stages of the resolve pass (base/upscale.vert and base/taaresolve.frag)
+	* @param sharpenShaderStages Vertex and fragment shader stages of the sharpen pass (base/upscale.vert and base/upscale.frag)
+	* @param outputRenderPass Render pass the sharpen pass is drawn with (subpass 0)
+	* @param pipelineCache Pipeline cache to use for creating the pipelines
+	*/
+	void TemporalAA::prepare(vks::VulkanDevice* device, VkFormat colorFormat, VkFormat depthFormat, const std::array<VkPipelineShaderStageCreateInfo, 2>& resolveShaderStages, const std::array<VkPipelineShaderStageCreateInfo, 2>& sharpenShaderStages, VkRenderPass outputRenderPass, VkPipelineCache pipelineCache)
+	{
+		assert(resolvePipeline == VK_NULL_HANDLE);
+		this->device = device;
+		this->colorFormat = colorFormat;
+
+		createRenderPasses(depthFormat);
+
+		// Bilinear filtering is required for sampling the history at the reprojected (sub-pixel) position
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Scene image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1: Velocity
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2: History
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &resolveDescriptorSetLayout));
+		setLayoutBindings = {
+			// Binding 0: Resolved image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &sharpenDescriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &resolveDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &resolveDescriptorSet));
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &sharpenDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &sharpenDescriptorSet));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&resolveDescriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(ResolvePushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &resolvePipelineLayout));
+		pipelineLayoutCI.pSetLayouts = &sharpenDescriptorSetLayout;
+		pushConstantRange.size = sizeof(SharpenPushConstants);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &sharpenPipelineLayout));
+
+		resolvePipeline = createPipeline(resolvePipelineLayout, resolveRenderPass, resolveShaderStages, pipelineCache);
+		sharpenPipeline = createPipeline(sharpenPipelineLayout, outputRenderPass, sharpenShaderStages, pipelineCache);
+	}
+
+	// Full screen triangle pipeline without vertex input, depth and blending
+	VkPipeline TemporalAA::createPipeline(VkPipelineLayout layout, VkRenderPass renderPass, const std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages, VkPipelineCache pipelineCache)
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(layout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VkPipeline pipeline;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		return pipeline;
+	}
+
+	void TemporalAA::createRenderPasses(VkFormat depthFormat)
+	{
+		// Scene render pass: Same color and depth attachments as the default render pass of the examples plus the velocity, color and velocity are sampled by the resolve pass afterwards
+		std::array<VkAttachmentDescription, 3> attachments = {};
+		attachments[0].format = colorFormat;
+		attachments[1].format = velocityFormat;
+		for (uint32_t i = 0; i < 2; i++) {
+			attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		// The depth attachment is shared with the output render pass and isn't needed after the scene
+		attachments[2].format = depthFormat;
+		attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		std::array<VkAttachmentReference, 2> colorReferences = { { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } } };
+		VkAttachmentReference depthReference = { 2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		// The previous frame's resolve pass has to be done sampling the images and the output render pass done using the depth attachment
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		// The resolve pass samples the images and the output render pass clears the depth attachment again
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device->logicalDevice, &renderPassCI, nullptr, &renderPass));
+
+		// Resolve render pass: Writes the full image, which is then copied to the history
+		VkAttachmentDescription resolveAttachment = {};
+		resolveAttachment.format = historyFormat;
+		resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		resolveAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolveAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		resolveAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentReference resolveReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &resolveReference;
+		subpassDescription.pDepthStencilAttachment = nullptr;
+
+		// The previous frame's copy and sharpen pass have to be done reading the image before it's overwritten
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		renderPassCI.attachmentCount = 1;
+		renderPassCI.pAttachments = &resolveAttachment;
+		VK_CHECK_RESULT(vks::createRenderPass(device->logicalDevice, &renderPassCI, nullptr, &resolveRenderPass));
+	}
+
+	void TemporalAA::createTarget(Target& target, VkFormat format, VkImageUsageFlags usage)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &target.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, target.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &target.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, target.image, target.memory, 0));
+		device->memoryAllocator.report.track(target.memory, 0, memReqs.size, vks::MemoryCategory::RenderTarget, "Temporal AA target");
+		memorySize += memReqs.size;
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = target.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &target.view));
+	}
+
+	/**
+	* (Re)create the images and framebuffers for a new output size, this discards the history
+	*
+	* @param width Width of the output
+	* @param height Height of the output
+	* @param depthStencilView Depth stencil attachment of the output, needs to be at least width x height
+	* @param queue Queue used to clear the new history
+	*/
+	void TemporalAA::resize(uint32_t width, uint32_t height, VkImageView depthStencilView, VkQueue queue)
+	{
+		destroyTargets();
+		this->width = width;
+		this->height = height;
+
+		createTarget(scene, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		createTarget(velocity, velocityFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		createTarget(resolved, historyFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		createTarget(history, historyFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+		// The history starts out cleared, the neighbourhood clipping of the resolve pass pulls it towards the scene within a few frames
+		VkCommandBuffer clearCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		const VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		vks::tools::setImageLayout(clearCmd, history.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdClearColorImage(clearCmd, history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+		vks::tools::setImageLayout(clearCmd, history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		device->flushCommandBuffer(clearCmd, queue, true);
+
+		std::array<VkImageView, 3> attachments = { scene.view, velocity.view, depthStencilView };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = renderPass;
+		framebufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferCI.pAttachments = attachments.data();
+		framebufferCI.width = width;
+		framebufferCI.height = height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &framebuffer));
+		framebufferCI.renderPass = resolveRenderPass;
+		framebufferCI.attachmentCount = 1;
+		framebufferCI.pAttachments = &resolved.view;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &resolveFramebuffer));
+
+		VkDescriptorImageInfo sceneDescriptor = vks::initializers::descriptorImageInfo(sampler, scene.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo velocityDescriptor = vks::initializers::descriptorImageInfo(sampler, velocity.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo historyDescriptor = vks::initializers::descriptorImageInfo(sampler, history.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo resolvedDescriptor = vks::initializers::descriptorImageInfo(sampler, resolved.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(resolveDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sceneDescriptor),
+			vks::initializers::writeDescriptorSet(resolveDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &velocityDescriptor),
+			vks::initializers::writeDescriptorSet(resolveDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &historyDescriptor),
+			vks::initializers::writeDescriptorSet(sharpenDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &resolvedDescriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void TemporalAA::destroyTarget(Target& target)
+	{
+		vkDestroyImageView(device->logicalDevice, target.view, nullptr);
+		vkDestroyImage(device->logicalDevice, target.image, nullptr);
+		device->memoryAllocator.report.untrack(target.memory);
+		vkFreeMemory(device->logicalDevice, target.memory, nullptr);
+		target.view = VK_NULL_HANDLE;
+		target.image = VK_NULL_HANDLE;
+		target.memory = VK_NULL_HANDLE;
+	}
+
+	void TemporalAA::destroyTargets()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyFramebuffer(device->logicalDevice, framebuffer, nullptr);
+		vkDestroyFramebuffer(device->logicalDevice, resolveFramebuffer, nullptr);
+		framebuffer = VK_NULL_HANDLE;
+		resolveFramebuffer = VK_NULL_HANDLE;
+		destroyTarget(scene);
+		destroyTarget(velocity);
+		destroyTarget(resolved);
+		destroyTarget(history);
+		memorySize = 0;
+	}
+
+	/** @brief Release all Vulkan resources, command buffers using the resolve stage must have finished executing */
+	void TemporalAA::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		destroyTargets();
+		vkDestroyPipeline(device->logicalDevice, resolvePipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, sharpenPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, resolvePipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, sharpenPipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, resolveDescriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, sharpenDescriptorSetLayout, nullptr);
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		vkDestroyRenderPass(device->logicalDevice, renderPass, nullptr);
+		vkDestroyRenderPass(device->logicalDevice, resolveRenderPass, nullptr);
+		resolvePipeline = VK_NULL_HANDLE;
+		renderPass = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	/** @brief Advance to the next jitter position, call once per frame before updating the projection */
+	void TemporalAA::nextFrame()
+	{
+		frameIndex = (frameIndex + 1) % jitterPhases;
+	}
+
+	/**
+	* Get the sub-pixel offset of the current frame
+	*
+	* @param x Horizontal offset in normalized device coordinates (one pixel is 2 / width)
+	* @param y Vertical offset in normalized device coordinates (one pixel is 2 / height)
+	*/
+	void TemporalAA::getJitter(float& x, float& y) const
+	{
+		if ((width == 0) || (height == 0)) {
+			x = y = 0.0f;
+			return;
+		}
+		// Halton(2, 3) within [-0.5, 0.5] pixels, index 0 of the sequence is skipped as it's always at the origin
+		x = (halton(frameIndex + 1, 2) - 0.5f) * 2.0f / static_cast<float>(width);
+		y = (halton(frameIndex + 1, 3) - 0.5f) * 2.0f / static_cast<float>(height);
+	}
+
+	/**
+	* Resolve the scene into the history, needs to be recorded outside of a render pass after the scene render pass has ended
+	*
+	* @param commandBuffer Command buffer to record to
+	*/
+	void TemporalAA::resolve(VkCommandBuffer commandBuffer)
+	{
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = resolveRenderPass;
+		renderPassBeginInfo.framebuffer = resolveFramebuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		ResolvePushConstants pushConstants;
+		pushConstants.texelSize[0] = 1.0f / static_cast<float>(width);
+		pushConstants.texelSize[1] = 1.0f / static_cast<float>(height);
+		pushConstants.feedback = feedback;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resolvePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resolvePipelineLayout, 0, 1, &resolveDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, resolvePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ResolvePushConstants), &pushConstants);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Copy the resolved image to the history for the next frame, the resolve pass is done reading the history
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(commandBuffer, history.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = { width, height, 1 };
+		vkCmdCopyImage(commandBuffer, resolved.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		// The resolved image is sampled by the sharpen pass, the history by the next frame's resolve pass
+		vks::tools::insertImageMemoryBarrier(commandBuffer, resolved.image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+		vks::tools::insertImageMemoryBarrier(commandBuffer, history.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+	}
+
+	/**
+	* Draw the sharpened result, needs to be recorded inside the output render pass after resolve
+	*
+	* @param commandBuffer Command buffer to record to
+	*/
+	void TemporalAA::sharpen(VkCommandBuffer commandBuffer)
+	{
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Same parameters as an upscale at native resolution
+		SharpenPushConstants pushConstants;
+		pushConstants.renderSize[0] = static_cast<float>(width);
+		pushConstants.renderSize[1] = static_cast<float>(height);
+		pushConstants.texelSize[0] = 1.0f / static_cast<float>(width);
+		pushConstants.texelSize[1] = 1.0f / static_cast<float>(height);
+		pushConstants.sharpness = (sharpness > 0.0f) ? sharpness : -1.0f;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sharpenPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sharpenPipelineLayout, 0, 1, &sharpenDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, sharpenPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SharpenPushConstants), &pushConstants);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
+	VkDeviceSize TemporalAA::getMemorySize() const
+	{
+		return memorySize;
+	}
+}
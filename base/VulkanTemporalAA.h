@@ -0,0 +1,117 @@
+/*
+* Vulkan temporal anti-aliasing
+*
+* Accumulates the jittered scene over several frames by reprojecting the previous result with a velocity buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Temporal anti-aliasing resolve as a cheaper alternative to multisampling
+	*
+	* The scene is rendered without multisampling, with a different sub-pixel offset each frame (see getJitter and Camera::setJitter) and
+	* writes the screen space motion of each pixel to a velocity attachment. The resolve pass reprojects the accumulated history with the
+	* velocity and blends the current frame into it. To avoid ghosting, the history is clipped against the color range of the current
+	* frame's 3x3 neighbourhood first, so disoccluded or changed pixels converge within a few frames.
+	* The result is drawn to the output render pass (e.g. the swap chain) with the contrast adaptive sharpening of the upscale pass
+	* (base/upscale.frag) to counter the slight blur of the accumulation.
+	*
+	* The history is copied from the resolve target instead of ping-ponging between two images, so pre-recorded command buffers
+	* don't depend on the frame index.
+	*
+	* @note The scene render pass has an additional velocity color attachment, so scene pipelines need two color blend attachment states and
+	* a fragment shader writing velocityFormat to location 1 (the motion in uv units, i.e. current minus previous position)
+	*/
+	class TemporalAA
+	{
+	private:
+		struct ResolvePushConstants {
+			float texelSize[2];
+			float feedback;
+		};
+
+		struct SharpenPushConstants {
+			float renderSize[2];
+			float texelSize[2];
+			float sharpness;
+		};
+
+		struct Target {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		// Jittered scene color and velocity written by the scene render pass
+		Target scene;
+		Target velocity;
+		// Resolved image of the current frame and the accumulated history it's copied to
+		Target resolved;
+		Target history;
+		VkRenderPass resolveRenderPass = VK_NULL_HANDLE;
+		VkFramebuffer resolveFramebuffer = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout resolveDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout sharpenDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet resolveDescriptorSet = VK_NULL_HANDLE;
+		VkDescriptorSet sharpenDescriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout resolvePipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout sharpenPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline resolvePipeline = VK_NULL_HANDLE;
+		VkPipeline sharpenPipeline = VK_NULL_HANDLE;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t frameIndex = 0;
+		VkDeviceSize memorySize = 0;
+
+		void createRenderPasses(VkFormat depthFormat);
+		void createTarget(Target& target, VkFormat format, VkImageUsageFlags usage);
+		void destroyTarget(Target& target);
+		void destroyTargets();
+		VkPipeline createPipeline(VkPipelineLayout layout, VkRenderPass renderPass, const std::array<VkPipelineShaderStageCreateInfo, 2>& shaderStages, VkPipelineCache pipelineCache);
+
+	public:
+		/** @brief Format of the velocity attachment */
+		static const VkFormat velocityFormat = VK_FORMAT_R16G16_SFLOAT;
+		/** @brief Format of the resolved image and the history, higher precision than the scene to avoid banding from the accumulation */
+		static const VkFormat historyFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		/** @brief Number of jitter positions before the sequence repeats */
+		uint32_t jitterPhases = 8;
+		/** @brief Weight of the history in the blend, higher values are smoother but take longer to converge */
+		float feedback = 0.9f;
+		/** @brief Strength of the sharpening filter (0..1) */
+		float sharpness = 0.25f;
+
+		/** @brief Scene render pass (color, velocity and depth) and framebuffer */
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+		~TemporalAA();
+		void prepare(vks::VulkanDevice* device, VkFormat colorFormat, VkFormat depthFormat, const std::array<VkPipelineShaderStageCreateInfo, 2>& resolveShaderStages, const std::array<VkPipelineShaderStageCreateInfo, 2>& sharpenShaderStages, VkRenderPass outputRenderPass, VkPipelineCache pipelineCache);
+		void resize(uint32_t width, uint32_t height, VkImageView depthStencilView, VkQueue queue);
+		void destroy();
+		void nextFrame();
+		void getJitter(float& x, float& y) const;
+		void resolve(VkCommandBuffer commandBuffer);
+		void sharpen(VkCommandBuffer commandBuffer);
+		/** @brief Approximate size of the images owned by the resolve stage in bytes (excluding the shared depth attachment) */
+		VkDeviceSize getMemorySize() const;
+	};
+}
@@ -0,0 +1,485 @@
+/*
+* Vulkan text renderer
+*
+* Signed distance field fonts and batched text rendering with one instanced quad per glyph from a persistently mapped ring buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextRenderer.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+#include "VulkanAssetFile.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace vks
+{
+	namespace
+	{
+		// Binary font metrics: header followed by one record per valid glyph, all values are little endian
+		const char metricsMagic[4] = { 'V', 'K', 'S', 'F' };
+		const uint32_t metricsVersion = 1;
+
+		struct MetricsHeader
+		{
+			char magic[4];
+			uint32_t version;
+			float size;
+			float lineHeight;
+			float distanceRange;
+			uint32_t multiChannel;
+			uint32_t glyphCount;
+		};
+
+		struct MetricsGlyph
+		{
+			uint32_t id;
+			float x, y;
+			float width, height;
+			float xoffset, yoffset;
+			float xadvance;
+		};
+	}
+
+	/**
+	* Load a font from its metrics and distance field atlas
+	*
+	* @param fontFile Font description, either an AngelCode BMFont text file (.fnt) or binary metrics written by saveMetrics
+	* @param textureFile Atlas with the distance field in the alpha channel
+	* @param device Device to create the atlas on
+	* @param copyQueue Queue used for the atlas upload
+	*
+	* @return False if the font description could not be read
+	*
+	* @note Binary metrics are copied as is, which avoids parsing the text format at startup
+	*/
+	bool Font::loadFromFile(const std::string& fontFile, const std::string& textureFile, vks::VulkanDevice* device, VkQueue copyQueue)
+	{
+		vks::AssetFile file(fontFile);
+		if (!file.valid()) {
+			std::cerr << "Could not open font file \"" << fontFile << "\"\n";
+			return false;
+		}
+		glyphs.fill(Glyph{});
+		distanceRange = 0.0f;
+		multiChannel = false;
+		if ((file.size() >= sizeof(MetricsHeader)) && (memcmp(file.data(), metricsMagic, sizeof(metricsMagic)) == 0)) {
+			MetricsHeader header;
+			memcpy(&header, file.data(), sizeof(MetricsHeader));
+			if ((header.version != metricsVersion) || (file.size() < sizeof(MetricsHeader) + header.glyphCount * sizeof(MetricsGlyph))) {
+				std::cerr << "Font file \"" << fontFile << "\" has an unsupported version or is truncated\n";
+				return false;
+			}
+			size = header.size;
+			lineHeight = header.lineHeight;
+			distanceRange = header.distanceRange;
+			multiChannel = header.multiChannel != 0;
+			for (uint32_t i = 0; i < header.glyphCount; i++) {
+				MetricsGlyph record;
+				memcpy(&record, file.data() + sizeof(MetricsHeader) + i * sizeof(MetricsGlyph), sizeof(MetricsGlyph));
+				if (record.id >= glyphs.size()) {
+					continue;
+				}
+				Glyph& glyph = glyphs[record.id];
+				glyph.valid = true;
+				glyph.x = record.x;
+				glyph.y = record.y;
+				glyph.width = record.width;
+				glyph.height = record.height;
+				glyph.xoffset = record.xoffset;
+				glyph.yoffset = record.yoffset;
+				glyph.xadvance = record.xadvance;
+			}
+			texture.loadFromFile(textureFile, VK_FORMAT_R8G8B8A8_UNORM, device, copyQueue);
+			return true;
+		}
+		std::stringstream stream(std::string(reinterpret_cast<const char*>(file.data()), file.size()));
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			std::stringstream lineStream(line);
+			std::string tag;
+			lineStream >> tag;
+			// Attributes are key=value pairs separated by spaces, only numeric ones are used, so quoted strings with spaces (e.g. the face name) can be ignored
+			auto value = [&line](const std::string& key) -> float {
+				const size_t pos = line.find(" " + key + "=");
+				return (pos != std::string::npos) ? std::stof(line.substr(pos + key.size() + 2)) : 0.0f;
+			};
+			if (tag == "info") {
+				// Negative sizes denote a character height instead of a cell height
+				size = std::fabs(value("size"));
+			}
+			else if (tag == "common") {
+				lineHeight = value("lineHeight");
+			}
+			else if (tag == "char") {
+				const uint32_t id = static_cast<uint32_t>(value("id"));
+				if (id >= glyphs.size()) {
+					continue;
+				}
+				Glyph& glyph = glyphs[id];
+				glyph.valid = true;
+				glyph.x = value("x");
+				glyph.y = value("y");
+				glyph.width = value("width");
+				glyph.height = value("height");
+				glyph.xoffset = value("xoffset");
+				glyph.yoffset = value("yoffset");
+				glyph.xadvance = value("xadvance");
+			}
+		}
+		if (size == 0.0f) {
+			size = lineHeight;
+		}
+		texture.loadFromFile(textureFile, VK_FORMAT_R8G8B8A8_UNORM, device, copyQueue);
+		return true;
+	}
+
+	/**
+	* Write the font's metrics in the binary format read by loadFromFile
+	*
+	* @param filename Metrics file to write, the atlas has to be stored separately (e.g. as a KTX file)
+	*
+	* @return False if the file could not be written
+	*/
+	bool Font::saveMetrics(const std::string& filename) const
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Could not write font metrics file \"" << filename << "\"\n";
+			return false;
+		}
+		MetricsHeader header{};
+		memcpy(header.magic, metricsMagic, sizeof(metricsMagic));
+		header.version = metricsVersion;
+		header.size = size;
+		header.lineHeight = lineHeight;
+		header.distanceRange = distanceRange;
+		header.multiChannel = multiChannel ? 1 : 0;
+		std::vector<MetricsGlyph> records;
+		for (uint32_t id = 0; id < static_cast<uint32_t>(glyphs.size()); id++) {
+			const Glyph& glyph = glyphs[id];
+			if (glyph.valid) {
+				records.push_back({ id, glyph.x, glyph.y, glyph.width, glyph.height, glyph.xoffset, glyph.yoffset, glyph.xadvance });
+			}
+		}
+		header.glyphCount = static_cast<uint32_t>(records.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(MetricsHeader));
+		file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(MetricsGlyph));
+		return file.good();
+	}
+
+	/** @brief Release the glyph atlas */
+	void Font::destroy()
+	{
+		texture.destroy();
+	}
+
+	/** @brief Returns the glyph of a character or nullptr if the font doesn't contain it */
+	const Font::Glyph* Font::getGlyph(uint8_t character) const
+	{
+		return glyphs[character].valid ? &glyphs[character] : nullptr;
+	}
+
+	/** @brief Width of a single line of text in pixels at the given size */
+	float Font::textWidth(const std::string& text, float textSize) const
+	{
+		const float scale = textSize / size;
+		float width = 0.0f;
+		for (auto character : text) {
+			const Glyph* glyph = getGlyph(static_cast<uint8_t>(character));
+			if (glyph) {
+				width += glyph->xadvance * scale;
+			}
+		}
+		return width;
+	}
+
+	TextRenderer::~TextRenderer()
+	{
+		destroy();
+	}
+
+	/**
+	* Setup the text renderer, fonts are added after this and the buffers and pipeline are created by prepare
+	*
+	* @param device Device to render the text on
+	* @param slotCount Number of regions in the glyph buffer, one for each command buffer that may be in flight
+	* @param (Optional) maxGlyphsPerFont Number of glyphs that can be drawn per font and slot (Defaults to 8192)
+	*/
+	void TextRenderer::setup(vks::VulkanDevice* device, uint32_t slotCount, uint32_t maxGlyphsPerFont)
+	{
+		assert(slotCount > 0);
+		this->device = device;
+		this->slotCount = slotCount;
+		this->maxGlyphsPerFont = maxGlyphsPerFont;
+	}
+
+	/**
+	* Add a font that text can be drawn with
+	*
+	* @param font Loaded font, must outlive the text renderer
+	*
+	* @return Index of the font to pass to addText
+	*/
+	uint32_t TextRenderer::addFont(Font* font)
+	{
+		assert(pipeline == VK_NULL_HANDLE);
+		fonts.push_back(font);
+		return static_cast<uint32_t>(fonts.size() - 1);
+	}
+
+	/**
+	* Create the glyph buffer, descriptors and pipeline
+	*
+	* @param renderPass Render pass the text is drawn in
+	* @param pipelineCache Pipeline cache used for creating the pipeline
+	* @param vertexStage Vertex shader (base/sdftext.vert)
+	* @param fragmentStage Fragment shader (base/sdftext.frag)
+	* @param (Optional) sampleCount Sample count of the render pass
+	* @param (Optional) subpass Subpass the text is drawn in
+	*/
+	void TextRenderer::prepare(VkRenderPass renderPass, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo vertexStage, VkPipelineShaderStageCreateInfo fragmentStage, VkSampleCountFlagBits sampleCount, uint32_t subpass)
+	{
+		assert(device && !fonts.empty());
+		const uint32_t fontCount = static_cast<uint32_t>(fonts.size());
+
+		// Each slot's region starts with the indirect draw commands of all fonts, followed by the glyph range of each font
+		auto alignUp = [](VkDeviceSize value) { return (value + 255) & ~VkDeviceSize(255); };
+		headerSize = alignUp(fontCount * sizeof(VkDrawIndirectCommand));
+		regionSize = alignUp(headerSize + fontCount * maxGlyphsPerFont * sizeof(GlyphInstance));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, regionSize * slotCount));
+		VK_CHECK_RESULT(buffer.map());
+		for (uint32_t slot = 0; slot < slotCount; slot++) {
+			VkDrawIndirectCommand* drawCommands = reinterpret_cast<VkDrawIndirectCommand*>(regionData(slot));
+			for (uint32_t i = 0; i < fontCount; i++) {
+				// One quad per instance
+				drawCommands[i] = { 4, 0, 0, 0 };
+			}
+		}
+		glyphCounts.assign(fontCount, 0);
+
+		// One descriptor set per font with its atlas
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, fontCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, fontCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutInfo, nullptr, &descriptorSetLayout));
+		descriptorSets.resize(fontCount);
+		for (uint32_t i = 0; i < fontCount; i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSets[i]));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &fonts[i]->texture.descriptor);
+			vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+		// The quad of each glyph is generated in the vertex shader from its instance data
+		VkVertexInputBindingDescription vertexInputBinding = vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE);
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, rect)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, uv)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, color)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		vertexInputState.vertexBindingDescriptionCount = 1;
+		vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
+		vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
+		vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
+
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		// Text is drawn on top of everything else
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(sampleCount, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = { vertexStage, fragmentStage };
+
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCreateInfo.subpass = subpass;
+		pipelineCreateInfo.pVertexInputState = &vertexInputState;
+		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+		pipelineCreateInfo.pRasterizationState = &rasterizationState;
+		pipelineCreateInfo.pColorBlendState = &colorBlendState;
+		pipelineCreateInfo.pMultisampleState = &multisampleState;
+		pipelineCreateInfo.pViewportState = &viewportState;
+		pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+		pipelineCreateInfo.pDynamicState = &dynamicState;
+		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCreateInfo.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+	}
+
+	/** @brief Release all Vulkan resources, fonts are owned by the caller */
+	void TextRenderer::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		buffer.destroy();
+		pipeline = VK_NULL_HANDLE;
+		pipelineLayout = VK_NULL_HANDLE;
+		descriptorSetLayout = VK_NULL_HANDLE;
+		descriptorPool = VK_NULL_HANDLE;
+		descriptorSets.clear();
+		fonts.clear();
+		device = nullptr;
+	}
+
+	uint8_t* TextRenderer::regionData(uint32_t slot) const
+	{
+		return static_cast<uint8_t*>(buffer.mapped) + regionSize * slot;
+	}
+
+	/**
+	* Start writing the text of a slot, replacing the text the slot has been drawn with before
+	*
+	* @param slot Slot to write, the GPU must be done with the last submission that draws the slot
+	*/
+	void TextRenderer::begin(uint32_t slot)
+	{
+		assert(isReady() && (slot < slotCount));
+		currentSlot = slot;
+		std::fill(glyphCounts.begin(), glyphCounts.end(), 0);
+		droppedGlyphs = 0;
+	}
+
+	/**
+	* Add a single line of text to the current slot
+	*
+	* @param text Latin 1 text, characters not contained in the font are skipped
+	* @param x Horizontal position of the anchor in pixels
+	* @param y Vertical position of the top of the line in pixels
+	* @param textSize Height of the font in pixels
+	* @param (Optional) color Color as RGBA8 (red in the lowest byte)
+	* @param (Optional) align Alignment of the text relative to x
+	* @param (Optional) fontIndex Font returned by addFont
+	*/
+	void TextRenderer::addText(const std::string& text, float x, float y, float textSize, uint32_t color, Align align, uint32_t fontIndex)
+	{
+		assert((currentSlot != UINT32_MAX) && (fontIndex < fonts.size()));
+		const Font* font = fonts[fontIndex];
+		const float scale = textSize / font->size;
+		const float atlasWidth = static_cast<float>(font->texture.width);
+		const float atlasHeight = static_cast<float>(font->texture.height);
+		if (align != Align::Left) {
+			const float width = font->textWidth(text, textSize);
+			x -= (align == Align::Center) ? width / 2.0f : width;
+		}
+		// The glyphs are written straight into the font's range of the slot
+		GlyphInstance* instances = reinterpret_cast<GlyphInstance*>(regionData(currentSlot) + headerSize) + fontIndex * maxGlyphsPerFont;
+		uint32_t& count = glyphCounts[fontIndex];
+		for (auto character : text)
+		{
+			const Font::Glyph* glyph = font->getGlyph(static_cast<uint8_t>(character));
+			if (!glyph) {
+				continue;
+			}
+			// Glyphs without an image (e.g. spaces) only advance the pen
+			if ((glyph->width > 0.0f) && (glyph->height > 0.0f))
+			{
+				if (count < maxGlyphsPerFont)
+				{
+					GlyphInstance instance;
+					instance.rect[0] = x + glyph->xoffset * scale;
+					instance.rect[1] = y + glyph->yoffset * scale;
+					instance.rect[2] = instance.rect[0] + glyph->width * scale;
+					instance.rect[3] = instance.rect[1] + glyph->height * scale;
+					instance.uv[0] = glyph->x / atlasWidth;
+					instance.uv[1] = glyph->y / atlasHeight;
+					instance.uv[2] = (glyph->x + glyph->width) / atlasWidth;
+					instance.uv[3] = (glyph->y + glyph->height) / atlasHeight;
+					instance.color = color;
+					// Copied as a whole, as the memory may be write combined
+					memcpy(&instances[count], &instance, sizeof(GlyphInstance));
+					count++;
+				}
+				else
+				{
+					droppedGlyphs++;
+				}
+			}
+			x += glyph->xadvance * scale;
+		}
+	}
+
+	/** @brief Finish writing the current slot by updating the instance counts of its indirect draws */
+	void TextRenderer::end()
+	{
+		assert(currentSlot != UINT32_MAX);
+		VkDrawIndirectCommand* drawCommands = reinterpret_cast<VkDrawIndirectCommand*>(regionData(currentSlot));
+		for (size_t i = 0; i < glyphCounts.size(); i++) {
+			drawCommands[i].instanceCount = glyphCounts[i];
+		}
+		currentSlot = UINT32_MAX;
+	}
+
+	/**
+	* Record the text of a slot into a command buffer, this only has to be done once as the text is read from the slot at execution time
+	*
+	* @param commandBuffer Command buffer inside a render pass compatible with the one passed to prepare
+	* @param slot Slot to draw
+	* @param extent Size of the render area the text positions refer to, viewport and scissor are set to it
+	*/
+	void TextRenderer::draw(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent)
+	{
+		assert(isReady() && (slot < slotCount));
+		VkViewport viewport = vks::initializers::viewport(static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(extent.width, extent.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		PushConstants pushConstants{};
+		pushConstants.scale[0] = 2.0f / static_cast<float>(extent.width);
+		pushConstants.scale[1] = 2.0f / static_cast<float>(extent.height);
+		pushConstants.smoothing = smoothing;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(fonts.size()); i++)
+		{
+			// Each font's range is bound separately, so the draws start at instance 0 (a non-zero first instance for indirect draws is an optional feature)
+			const VkDeviceSize offset = regionSize * slot + headerSize + static_cast<VkDeviceSize>(i) * maxGlyphsPerFont * sizeof(GlyphInstance);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer.buffer, &offset);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+			vkCmdDrawIndirect(commandBuffer, buffer.buffer, regionSize * slot + i * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		}
+	}
+
+	uint32_t TextRenderer::glyphCount() const
+	{
+		uint32_t count = 0;
+		for (auto glyphs : glyphCounts) {
+			count += glyphs;
+		}
+		return count;
+	}
+}
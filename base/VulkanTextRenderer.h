@@ -0,0 +1,138 @@
+/*
+* Vulkan text renderer
+*
+* Signed distance field fonts and batched text rendering with one instanced quad per glyph from a persistently mapped ring buffer
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTexture.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Signed distance field font with its glyph atlas
+	*
+	* Glyph metrics are read from an AngelCode BMFont text file (.fnt) or the binary metrics format written by saveMetrics (see loadFromFile).
+	* The distance field is stored in the alpha channel of the atlas texture, multi-channel fonts (see FontGenerator) additionally store a multi-channel distance field in RGB.
+	* Metrics are in pixels of the size the font has been generated with, so they can be scaled to any size without losing sharpness.
+	*/
+	class Font
+	{
+	public:
+		struct Glyph
+		{
+			bool valid = false;
+			// Rectangle of the glyph in the atlas
+			float x = 0.0f, y = 0.0f;
+			float width = 0.0f, height = 0.0f;
+			// Offset of the rectangle from the pen position and distance to the next glyph
+			float xoffset = 0.0f, yoffset = 0.0f;
+			float xadvance = 0.0f;
+		};
+
+		/** @brief Glyphs of the latin 1 range, indexed by character code */
+		std::array<Glyph, 256> glyphs;
+		/** @brief Size the font has been generated with in pixels */
+		float size = 0.0f;
+		float lineHeight = 0.0f;
+		/** @brief Width of the distance field's transition in atlas texels, zero if unknown (BMFont files don't store it) */
+		float distanceRange = 0.0f;
+		/** @brief True if RGB stores a multi-channel distance field whose median is the distance */
+		bool multiChannel = false;
+		vks::Texture2D texture;
+
+		bool loadFromFile(const std::string& fontFile, const std::string& textureFile, vks::VulkanDevice* device, VkQueue copyQueue);
+		bool saveMetrics(const std::string& filename) const;
+		void destroy();
+		const Glyph* getGlyph(uint8_t character) const;
+		float textWidth(const std::string& text, float textSize) const;
+	};
+
+	/**
+	* @brief Batched text rendering with signed distance field fonts
+	*
+	* Each glyph is a single instance (position, atlas rectangle and color) of a quad that's generated in the vertex shader.
+	* Instances are written directly into a persistently mapped, host coherent buffer that's split into one region per slot.
+	* Every font has a fixed range in a region and is drawn with a single indirect draw whose instance count is written along with the glyphs,
+	* so command buffers are recorded once (see draw) and never have to be recorded again when the text changes.
+	*
+	* A slot must not be written while the GPU may still read it, so each command buffer that can be in flight needs its own slot
+	* (the swap chain image index for pre-recorded command buffers, the frame in flight for dynamic command buffers).
+	*
+	* @note All fonts must be added before prepare
+	*/
+	class TextRenderer
+	{
+	public:
+		enum class Align { Left, Center, Right };
+
+	private:
+		struct GlyphInstance
+		{
+			// Rectangle of the quad in pixels (x0, y0, x1, y1)
+			float rect[4];
+			// Rectangle of the glyph in the atlas (s0, t0, s1, t1)
+			float uv[4];
+			// RGBA8
+			uint32_t color;
+		};
+		struct PushConstants
+		{
+			float scale[2];
+			float smoothing;
+		};
+
+		vks::VulkanDevice* device = nullptr;
+		std::vector<Font*> fonts;
+		uint32_t slotCount = 0;
+		uint32_t maxGlyphsPerFont = 0;
+		VkDeviceSize headerSize = 0;
+		VkDeviceSize regionSize = 0;
+		vks::Buffer buffer;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		// Slot that's currently written to
+		uint32_t currentSlot = UINT32_MAX;
+		std::vector<uint32_t> glyphCounts;
+
+		uint8_t* regionData(uint32_t slot) const;
+
+	public:
+		/** @brief Width of the edge transition relative to the distance field's range, larger values give softer edges */
+		float smoothing = 1.0f;
+		/** @brief Number of glyphs of the last update that didn't fit into their font's range */
+		uint32_t droppedGlyphs = 0;
+
+		~TextRenderer();
+		void setup(vks::VulkanDevice* device, uint32_t slotCount, uint32_t maxGlyphsPerFont = 8192);
+		uint32_t addFont(Font* font);
+		void prepare(VkRenderPass renderPass, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo vertexStage, VkPipelineShaderStageCreateInfo fragmentStage, VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT, uint32_t subpass = 0);
+		void destroy();
+		/** @brief Returns true if prepare has been called */
+		bool isReady() const { return pipeline != VK_NULL_HANDLE; }
+		void begin(uint32_t slot);
+		void addText(const std::string& text, float x, float y, float textSize, uint32_t color = 0xffffffff, Align align = Align::Left, uint32_t fontIndex = 0);
+		void end();
+		void draw(VkCommandBuffer commandBuffer, uint32_t slot, VkExtent2D extent);
+		/** @brief Number of glyphs written since the last begin */
+		uint32_t glyphCount() const;
+	};
+}
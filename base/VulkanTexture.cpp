@@ -7,9 +7,21 @@
 */
 
 #include <VulkanTexture.h>
+#include <VulkanStartupProfiler.h>
+
+#if defined(VKS_BASISU_TRANSCODER)
+#include <basisu_transcoder.h>
+#endif
 
 namespace vks
 {
+	TextureFile::~TextureFile()
+	{
+		if (ktx) {
+			ktxTexture_Destroy(ktx);
+		}
+	}
+
 	void Texture::updateDescriptor()
 	{
 		descriptor.sampler = sampler;
@@ -19,64 +31,373 @@ namespace vks
 
 	void Texture::destroy()
 	{
+		if (streaming.uploadId != 0)
+		{
+			// The image must not be destroyed while the transfer queue is still writing to it
+			device->waitAsyncUpload(streaming.uploadId);
+			device->updateAsyncUploads(true);
+			streaming.uploadId = 0;
+		}
+		delete streaming.file;
+		streaming.file = nullptr;
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		if (sampler)
+		// Samplers of the loaders are shared through the device's resource cache, other samplers are destroyed right away
+		device->resourceCache.releaseSampler(sampler);
+		// Textures created by the loaders below are sub-allocated, others may have been set up with their own memory allocation
+		if (allocation.valid())
+		{
+			device->memoryAllocator.free(allocation);
+		}
+		else
+		{
+			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
+	}
+
+	/** @brief Destroy the texture once the frames in flight that may still use it have finished, so it can be reloaded without waiting for the device */
+	void Texture::retire()
+	{
+		if (streaming.uploadId != 0)
 		{
-			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+			device->waitAsyncUpload(streaming.uploadId);
+			device->updateAsyncUploads(true);
+			streaming.uploadId = 0;
 		}
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		delete streaming.file;
+		streaming.file = nullptr;
+		Texture retired = *this;
+		device->deletionQueue.push([retired]() mutable { retired.destroy(); });
+		image = VK_NULL_HANDLE;
+		view = VK_NULL_HANDLE;
+		sampler = VK_NULL_HANDLE;
+		deviceMemory = VK_NULL_HANDLE;
+		allocation = vks::Allocation();
 	}
 
 	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target)
 	{
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
+		// The file is parsed from its mapped view, libktx only copies the image data into the texture
+		vks::AssetFile file(filename);
+		if (!file.valid()) {
 			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
 		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t *textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
+		ktxResult result = ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
+		return result;
+	}
+
+	namespace
+	{
+		const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		// KTX2 file header, see https://github.khronos.org/KTX-Specification/
+		struct KTX2Header
+		{
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct KTX2LevelIndex
+		{
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		const uint32_t ktx2SupercompressionNone = 0;
+		// Color models and transfer function of the basic data format descriptor block
+		const uint8_t ktx2ColorModelETC1S = 163;
+		const uint8_t ktx2ColorModelUASTC = 166;
+		const uint8_t ktx2TransferSRGB = 2;
+
+#if defined(VKS_BASISU_TRANSCODER)
+		basist::transcoder_texture_format getTranscoderFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFBC7_RGBA;
+			case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+			case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+			case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFETC2_RGBA;
+			default:
+				return basist::transcoder_texture_format::cTFRGBA32;
+			}
+		}
+#endif
+	}
+
+	/**
+	* Select the format Basis Universal (ETC1S or UASTC) image data is transcoded to
+	*
+	* Prefers BC7 (desktop), then ASTC 4x4 and ETC2 (mobile) and falls back to uncompressed RGBA
+	*
+	* @param device Vulkan device the texture is created on
+	* @param srgb True if the image data is sRGB encoded
+	*
+	* @note Compressed formats are only selected if the matching texture compression feature has been enabled for the device
+	*/
+	VkFormat Texture::selectTranscodeFormat(vks::VulkanDevice *device, bool srgb)
+	{
+		struct Candidate {
+			VkFormat unorm;
+			VkFormat srgb;
+			VkBool32 enabled;
+		};
+		const std::vector<Candidate> candidates = {
+			{ VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK, device->enabledFeatures.textureCompressionBC },
+			{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, device->enabledFeatures.textureCompressionASTC_LDR },
+			{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, device->enabledFeatures.textureCompressionETC2 },
+		};
+		for (auto& candidate : candidates) {
+			if (!candidate.enabled) {
+				continue;
+			}
+			const VkFormat format = srgb ? candidate.srgb : candidate.unorm;
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
+				return format;
+			}
+		}
+		return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	/**
+	* Select the block compressed format used for HDR image data
+	*
+	* Prefers BC6H (desktop) over ASTC 4x4 HDR (mobile), both store half float RGB at 1 byte per texel instead of 8 bytes for R16G16B16A16_SFLOAT
+	*
+	* @param device Vulkan device the texture is created on
+	* @return Compressed HDR format or VK_FORMAT_UNDEFINED if neither is supported
+	*
+	* @note Formats are only selected if their texture compression feature has been enabled for the device (see VulkanExampleBase::enableCompressedHDRTextures)
+	*/
+	VkFormat Texture::selectCompressedHDRFormat(vks::VulkanDevice *device)
+	{
+		struct Candidate {
+			VkFormat format;
+			bool enabled;
+		};
+		const std::vector<Candidate> candidates = {
+			{ VK_FORMAT_BC6H_UFLOAT_BLOCK, device->enabledFeatures.textureCompressionBC == VK_TRUE },
+			{ VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK_EXT, device->textureCompressionASTCHDRSupported },
+		};
+		for (auto& candidate : candidates) {
+			if (!candidate.enabled) {
+				continue;
+			}
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, candidate.format, &formatProperties);
+			if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
+				return candidate.format;
+			}
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	/**
+	* Get the compressed variant of an HDR texture file for the device
+	*
+	* Compressed variants are KTX2 files next to the uncompressed file with a suffix for their format, e.g. "uffizi_cube_bc6h.ktx2" and "uffizi_cube_astc_hdr.ktx2" for "uffizi_cube.ktx"
+	* These are encoded offline, as HDR data can't be transcoded from Basis Universal (see data/README.md)
+	*
+	* @param filename Uncompressed texture file
+	* @param device Vulkan device the texture is created on
+	* @return File name of the compressed variant, or filename if the device doesn't support a compressed HDR format or the variant doesn't exist
+	*/
+	std::string Texture::getCompressedHDRFile(const std::string &filename, vks::VulkanDevice *device)
+	{
+		const VkFormat format = selectCompressedHDRFormat(device);
+		if (format == VK_FORMAT_UNDEFINED) {
+			return filename;
+		}
+		const std::string suffix = (format == VK_FORMAT_BC6H_UFLOAT_BLOCK) ? "_bc6h.ktx2" : "_astc_hdr.ktx2";
+		const std::string compressedFile = filename.substr(0, filename.find_last_of('.')) + suffix;
+		vks::AssetFile file;
+		return file.open(compressedFile) ? compressedFile : filename;
+	}
+
+	/**
+	* Load the image data of a KTX or KTX2 file
+	*
+	* KTX2 files either store image data in a Vulkan format, which is used as is, or Basis Universal (ETC1S or UASTC) data,
+	* which is transcoded to the best format supported by the device (see selectTranscodeFormat)
+	*
+	* @param filename File to load (.ktx or .ktx2)
+	* @param device Vulkan device the texture is created on, used to select the transcode target
+	* @param file Receives the image data and layout
+	*
+	* @note Transcoding requires the Basis Universal transcoder (external/basisu) to be present at build time, supercompressed (zstd or zlib) KTX2 files are not supported
+	*/
+	void Texture::loadTextureFile(std::string filename, vks::VulkanDevice *device, TextureFile &file)
+	{
+		vks::AssetTimer assetTimer(vks::StartupProfiler::AssetIO);
+		if (!file.asset.open(filename)) {
 			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);			
-#endif		
-		return result;
+		assetTimer.next(vks::StartupProfiler::AssetDecode);
+		const uint8_t* bytes = file.asset.data();
+		const size_t byteCount = file.asset.size();
+
+		if ((byteCount < sizeof(KTX2Header)) || (memcmp(bytes, ktx2Identifier, sizeof(ktx2Identifier)) != 0)) {
+			// KTX file
+			ktxResult result = ktxTexture_CreateFromMemory(bytes, byteCount, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &file.ktx);
+			if (result != KTX_SUCCESS) {
+				vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file is not a valid KTX or KTX2 file.", result);
+			}
+			// libktx has copied the image data, so the file is no longer needed
+			file.asset.close();
+			file.width = file.ktx->baseWidth;
+			file.height = file.ktx->baseHeight;
+			file.mipLevels = file.ktx->numLevels;
+			file.layerCount = file.ktx->numLayers;
+			file.faceCount = file.ktx->numFaces;
+			file.data = ktxTexture_GetData(file.ktx);
+			file.size = ktxTexture_GetSize(file.ktx);
+			for (uint32_t level = 0; level < file.mipLevels; level++) {
+				for (uint32_t layer = 0; layer < file.layerCount; layer++) {
+					for (uint32_t face = 0; face < file.faceCount; face++) {
+						ktx_size_t offset;
+						KTX_error_code result = ktxTexture_GetImageOffset(file.ktx, level, layer, face, &offset);
+						assert(result == KTX_SUCCESS);
+						file.offsets.push_back(offset);
+						file.imageSizes.push_back(ktxTexture_GetImageSize(file.ktx, level));
+					}
+				}
+			}
+			return;
+		}
+
+		// KTX2 file
+		KTX2Header header;
+		memcpy(&header, bytes, sizeof(header));
+		if (header.pixelDepth > 1) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\n3D textures in KTX2 files are not supported.", -1);
+		}
+		file.width = header.pixelWidth;
+		file.height = std::max(header.pixelHeight, 1u);
+		file.mipLevels = std::max(header.levelCount, 1u);
+		file.layerCount = std::max(header.layerCount, 1u);
+		file.faceCount = header.faceCount;
+
+		uint8_t colorModel = 0;
+		uint8_t transferFunction = 0;
+		if ((header.dfdByteLength >= 16) && (header.dfdByteOffset + 16 <= byteCount)) {
+			// Total size of the data format descriptor, followed by the basic descriptor block
+			const uint8_t* dfd = bytes + header.dfdByteOffset + sizeof(uint32_t);
+			colorModel = dfd[8];
+			transferFunction = dfd[10];
+		}
+
+		if (header.vkFormat != VK_FORMAT_UNDEFINED) {
+			if (header.supercompressionScheme != ktx2SupercompressionNone) {
+				vks::tools::exitFatal("Could not load texture from " + filename + "\n\nSupercompressed KTX2 files are not supported.", -1);
+			}
+			file.format = static_cast<VkFormat>(header.vkFormat);
+			// Images of a level are stored consecutively, ordered by layer and face
+			std::vector<KTX2LevelIndex> levels(file.mipLevels);
+			memcpy(levels.data(), bytes + sizeof(KTX2Header), levels.size() * sizeof(KTX2LevelIndex));
+			for (uint32_t level = 0; level < file.mipLevels; level++) {
+				const VkDeviceSize imageSize = levels[level].byteLength / (file.layerCount * file.faceCount);
+				for (uint32_t image = 0; image < file.layerCount * file.faceCount; image++) {
+					file.offsets.push_back(levels[level].byteOffset + image * imageSize);
+					file.imageSizes.push_back(imageSize);
+				}
+			}
+			// The image data is used straight from the file's view, which stays open as long as the texture file
+			file.data = bytes;
+			file.size = byteCount;
+			return;
+		}
+
+		if ((colorModel != ktx2ColorModelETC1S) && (colorModel != ktx2ColorModelUASTC)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe KTX2 file does not specify a format.", -1);
+		}
+#if defined(VKS_BASISU_TRANSCODER)
+		static bool transcoderInitialized = false;
+		if (!transcoderInitialized) {
+			basist::basisu_transcoder_init();
+			transcoderInitialized = true;
+		}
+		basist::ktx2_transcoder transcoder;
+		if (!transcoder.init(bytes, static_cast<uint32_t>(byteCount)) || !transcoder.start_transcoding()) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe Basis Universal image data could not be decoded.", -1);
+		}
+		file.format = selectTranscodeFormat(device, transferFunction == ktx2TransferSRGB);
+		const basist::transcoder_texture_format transcoderFormat = getTranscoderFormat(file.format);
+		const bool uncompressed = basist::basis_transcoder_format_is_uncompressed(transcoderFormat);
+		const uint32_t bytesPerBlock = basist::basis_get_bytes_per_block_or_pixel(transcoderFormat);
+		for (uint32_t level = 0; level < file.mipLevels; level++) {
+			for (uint32_t layer = 0; layer < file.layerCount; layer++) {
+				for (uint32_t face = 0; face < file.faceCount; face++) {
+					basist::ktx2_image_level_info levelInfo;
+					transcoder.get_image_level_info(levelInfo, level, layer, face);
+					const uint32_t blockCount = uncompressed ? (levelInfo.m_orig_width * levelInfo.m_orig_height) : levelInfo.m_total_blocks;
+					// Buffer to image copies need to be aligned to the block size
+					const VkDeviceSize offset = (file.storage.size() + 15) & ~VkDeviceSize(15);
+					file.storage.resize(offset + blockCount * bytesPerBlock);
+					if (!transcoder.transcode_image_level(level, layer, face, file.storage.data() + offset, blockCount, transcoderFormat)) {
+						vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe Basis Universal image data could not be transcoded.", -1);
+					}
+					file.offsets.push_back(offset);
+					file.imageSizes.push_back(blockCount * bytesPerBlock);
+				}
+			}
+		}
+		file.data = file.storage.data();
+		file.size = file.storage.size();
+#else
+		vks::tools::exitFatal("Could not load texture from " + filename + "\n\nTranscoding Basis Universal KTX2 files requires the Basis Universal transcoder (external/basisu).", -1);
+#endif
 	}
 
 	/**
 	* Load a 2D texture including all mip levels
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2 files, which store their format, see Texture::format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
 	*
+	* @note The texture loaders can be used inside an asynchronous upload batch (see VulkanDevice::beginAsyncUploadBatch) to upload on the transfer queue without waiting
+	* @note If device local memory is under pressure (see VulkanDevice::memoryPressureThreshold), the largest mip level of textures with mip maps is skipped
 	*/
 	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		TextureFile file;
+		loadTextureFile(filename, device, file);
+		vks::AssetTimer assetTimer(vks::StartupProfiler::AssetUpload);
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		width = file.width;
+		height = file.height;
+		mipLevels = file.mipLevels;
+		// KTX2 files define the format of their (transcoded) image data
+		if (file.format != VK_FORMAT_UNDEFINED) {
+			format = file.format;
+		}
+		this->format = format;
 
 		// Get device properties for the requested texture format
 		VkFormatProperties formatProperties;
@@ -89,60 +410,43 @@ namespace vks
 		// limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
 		VkBool32 useStaging = !forceLinear;
 
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->beginUpload();
 
 		if (useStaging)
 		{
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = ktxTextureSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+			// Drop the largest mip level (three quarters of the memory) instead of running out of device memory
+			uint32_t baseLevel = 0;
+			if ((mipLevels > 1) && (device->getMemoryPressure() >= device->memoryPressureThreshold))
+			{
+				baseLevel = 1;
+				width = std::max(1u, file.width >> baseLevel);
+				height = std::max(1u, file.height >> baseLevel);
+				mipLevels -= baseLevel;
+			}
 
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
+			// Copy the raw image data into staging memory taken from the device's staging ring
+			vks::StagingRing::Allocation staging = device->stagingRing.allocate(file.size);
+			memcpy(staging.data, file.data, file.size);
 
 			// Setup buffer copy regions for each mip level
 			std::vector<VkBufferImageCopy> bufferCopyRegions;
 
 			for (uint32_t i = 0; i < mipLevels; i++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-				assert(result == KTX_SUCCESS);
+				VkDeviceSize offset = file.imageOffset(baseLevel + i, 0, 0);
 
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = i;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-				bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+				bufferCopyRegion.imageExtent.width = std::max(1u, file.width >> (baseLevel + i));
+				bufferCopyRegion.imageExtent.height = std::max(1u, file.height >> (baseLevel + i));
 				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
+				bufferCopyRegion.bufferOffset = staging.offset + offset;
 
 				bufferCopyRegions.push_back(bufferCopyRegion);
 			}
@@ -166,13 +470,10 @@ namespace vks
 			}
 			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+			// Sub-allocate the image memory from the device's memory allocator
+			VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+			device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, filename);
+			deviceMemory = allocation.memory;
 
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -192,7 +493,7 @@ namespace vks
 			// Copy mip levels from staging buffer
 			vkCmdCopyBufferToImage(
 				copyCmd,
-				stagingBuffer,
+				staging.buffer,
 				image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -201,18 +502,15 @@ namespace vks
 
 			// Change texture image layout to shader read after all mip levels have been copied
 			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
+			device->finishImageUpload(
 				copyCmd,
 				image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				imageLayout,
 				subresourceRange);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			device->endUpload(copyCmd, copyQueue);
 
-			// Clean up staging resources
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 		}
 		else
 		{
@@ -224,7 +522,6 @@ namespace vks
 			assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 
 			VkImage mappableImage;
-			VkDeviceMemory mappableMemory;
 
 			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
 			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -244,17 +541,11 @@ namespace vks
 			// Get memory requirements for this image 
 			// like size and alignment
 			vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
-			// Set memory allocation size to required memory size
-			memAllocInfo.allocationSize = memReqs.size;
-
-			// Get memory type that can be mapped to host memory
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-			// Allocate host memory
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
-
-			// Bind allocated image for use
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
+			// Sub-allocate memory that can be mapped to host memory and bind it
+			// Linear tiled images are placed next to buffers, as both count as linear resources for bufferImageGranularity
+			VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(mappableImage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true, &allocation));
+			device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, filename);
 
 			// Get sub resource layout
 			// Mip map count, array layer, etc.
@@ -263,34 +554,27 @@ namespace vks
 			subRes.mipLevel = 0;
 
 			VkSubresourceLayout subResLayout;
-			void *data;
 
 			// Get sub resources layout 
 			// Includes row pitch, size offsets, etc.
 			vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
 
-			// Map image memory
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
-
-			// Copy image data into memory
-			memcpy(data, ktxTextureData, memReqs.size);
-
-			vkUnmapMemory(device->logicalDevice, mappableMemory);
+			// Copy image data into the (persistently mapped) memory
+			memcpy(allocation.mapped, file.data, std::min<VkDeviceSize>(memReqs.size, file.size));
 
 			// Linear tiled images don't need to be staged
 			// and can be directly used as textures
 			image = mappableImage;
-			deviceMemory = mappableMemory;
+			deviceMemory = allocation.memory;
 			this->imageLayout = imageLayout;
 
 			// Setup image memory barrier
-			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			device->finishImageUpload(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout, subresourceRange);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			device->endUpload(copyCmd, copyQueue);
 		}
 
-		ktxTexture_Destroy(ktxTexture);
-
 		// Create a default sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -309,7 +593,7 @@ namespace vks
 		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
 
 		// Create image view
 		// Textures are not directly accessed by the shaders and
@@ -331,6 +615,210 @@ namespace vks
 		updateDescriptor();
 	}
 
+	/**
+	* Load a 2D texture whose mip levels are streamed in from the smallest to the largest
+	*
+	* The smallest mip levels (up to initialSize bytes, at least the last level) are uploaded right away, so the texture can be used as soon as this returns.
+	* The remaining levels are uploaded one at a time on the transfer queue by updateStreaming, the image view only covers the levels that have been uploaded.
+	*
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2 files, which store their format, see Texture::format)
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Queue used for the initial upload and that the streamed levels are made available to (must be the queue that uses the texture)
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @param (Optional) initialSize Size in bytes of the mip levels that are uploaded right away (defaults to 64 KiB)
+	*/
+	void Texture2D::loadFromFileStreamed(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, VkDeviceSize initialSize)
+	{
+		TextureFile* file = new TextureFile();
+		loadTextureFile(filename, device, *file);
+
+		this->device = device;
+		width = file->width;
+		height = file->height;
+		mipLevels = file->mipLevels;
+		layerCount = 1;
+		if (file->format != VK_FORMAT_UNDEFINED) {
+			format = file->format;
+		}
+		this->format = format;
+		this->imageLayout = imageLayout;
+
+		// Select the levels that are uploaded right away, the last level is always included
+		uint32_t residentLevel = mipLevels - 1;
+		VkDeviceSize residentSize = file->imageSize(residentLevel, 0, 0);
+		while ((residentLevel > 0) && (residentSize + file->imageSize(residentLevel - 1, 0, 0) <= initialSize)) {
+			residentLevel--;
+			residentSize += file->imageSize(residentLevel, 0, 0);
+		}
+
+		// The image is created with all levels, the ones that are streamed in later are never accessed before they have been uploaded
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+		VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+		device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, filename);
+		deviceMemory = allocation.memory;
+
+		VkCommandBuffer copyCmd = device->beginUpload();
+
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(residentSize);
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		VkDeviceSize stagingOffset = 0;
+		for (uint32_t level = residentLevel; level < mipLevels; level++) {
+			const VkDeviceSize size = file->imageSize(level, 0, 0);
+			memcpy(static_cast<uint8_t*>(staging.data) + stagingOffset, file->data + file->imageOffset(level, 0, 0), size);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, width >> level);
+			bufferCopyRegion.imageExtent.height = std::max(1u, height >> level);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = staging.offset + stagingOffset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+			// Buffer to image copies need to be aligned to the block size
+			stagingOffset = (stagingOffset + size + 15) & ~VkDeviceSize(15);
+		}
+
+		// All levels are transitioned to the final layout, so the view can be moved to more detailed levels without another transition on the graphics queue
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		device->finishImageUpload(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+		device->endUpload(copyCmd, copyQueue);
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = (float)mipLevels;
+		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
+		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
+
+		view = VK_NULL_HANDLE;
+		createView(residentLevel);
+
+		streaming.residentLevel = residentLevel;
+		streaming.queue = copyQueue;
+		streaming.uploadId = 0;
+		if (residentLevel > 0) {
+			streaming.file = file;
+		} else {
+			delete file;
+		}
+
+		updateDescriptor();
+	}
+
+	/** @brief Create the image view for the levels starting at baseMipLevel, a previous view is kept until the texture is destroyed as it may still be in use */
+	void Texture2D::createView(uint32_t baseMipLevel)
+	{
+		// The replaced view may still be referenced by command buffers in flight
+		if (view != VK_NULL_HANDLE) {
+			device->deletionQueue.imageView(view);
+		}
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, mipLevels - baseMipLevel, 0, 1 };
+		viewCreateInfo.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+	}
+
+	/** @brief Record and submit the upload of the next more detailed mip level to the transfer queue */
+	void Texture2D::uploadNextLevel()
+	{
+		const uint32_t level = streaming.residentLevel - 1;
+		TextureFile* file = streaming.file;
+		const VkDeviceSize size = file->imageSize(level, 0, 0);
+
+		device->beginAsyncUploadBatch();
+		VkCommandBuffer copyCmd = device->beginUpload();
+
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(size);
+		memcpy(staging.data, file->data + file->imageOffset(level, 0, 0), size);
+
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = level;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = std::max(1u, width >> level);
+		bufferCopyRegion.imageExtent.height = std::max(1u, height >> level);
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset;
+
+		// The level hasn't been accessed yet, so its contents can be discarded without transferring its ownership to the transfer queue first
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		device->finishImageUpload(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, subresourceRange);
+		device->endUpload(copyCmd, streaming.queue);
+
+		streaming.uploadId = device->endAsyncUploadBatch(streaming.queue);
+	}
+
+	/** @brief Returns true while mip levels of a texture loaded with loadFromFileStreamed are still being uploaded */
+	bool Texture2D::streamingActive() const
+	{
+		return streaming.file != nullptr;
+	}
+
+	/**
+	* Advance the streaming of a texture loaded with loadFromFileStreamed, should be called once per frame
+	*
+	* @return True if another mip level has become resident, the texture's view and descriptor have changed and descriptor sets using the texture need to be updated
+	*
+	* @note The previous view stays valid until the texture is destroyed, so command buffers in flight can still use it, but descriptor sets must only be updated while the device isn't using them
+	*/
+	bool Texture2D::updateStreaming()
+	{
+		if (!streaming.file) {
+			return false;
+		}
+		if (streaming.uploadId == 0) {
+			// Asynchronous uploads can't be started while another upload batch is being recorded
+			if (!device->asyncUploadBatch.active && (device->uploadBatch.depth == 0)) {
+				uploadNextLevel();
+			}
+			return false;
+		}
+		if (!device->asyncUploadComplete(streaming.uploadId)) {
+			return false;
+		}
+		streaming.uploadId = 0;
+		streaming.residentLevel--;
+		createView(streaming.residentLevel);
+		updateDescriptor();
+		if (streaming.residentLevel == 0) {
+			delete streaming.file;
+			streaming.file = nullptr;
+		} else {
+			uploadNextLevel();
+		}
+		return true;
+	}
+
 	/**
 	* Creates a 2D texture from a buffer
 	*
@@ -353,40 +841,14 @@ namespace vks
 		width = texWidth;
 		height = texHeight;
 		mipLevels = 1;
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
+		this->format = format;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = bufferSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		VkCommandBuffer copyCmd = device->beginUpload();
 
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the raw image data into staging memory taken from the device's staging ring
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(bufferSize);
+		memcpy(staging.data, buffer, bufferSize);
 
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -396,7 +858,7 @@ namespace vks
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = 0;
+		bufferCopyRegion.bufferOffset = staging.offset;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -417,13 +879,10 @@ namespace vks
 		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		// Sub-allocate the image memory from the device's memory allocator
+		VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+		device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture);
+		deviceMemory = allocation.memory;
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -443,7 +902,7 @@ namespace vks
 		// Copy mip levels from staging buffer
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			staging.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -452,18 +911,15 @@ namespace vks
 
 		// Change texture image layout to shader read after all mip levels have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
+		device->finishImageUpload(
 			copyCmd,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			imageLayout,
 			subresourceRange);
 
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->endUpload(copyCmd, copyQueue);
 
-		// Clean up staging resources
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
@@ -479,7 +935,7 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = 0.0f;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = {};
@@ -500,8 +956,8 @@ namespace vks
 	/**
 	* Load a 2D texture array including all mip levels
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2 files, which store their format, see Texture::format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
@@ -510,49 +966,24 @@ namespace vks
 	*/
 	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		TextureFile file;
+		loadTextureFile(filename, device, file);
+		vks::AssetTimer assetTimer(vks::StartupProfiler::AssetUpload);
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		layerCount = ktxTexture->numLayers;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+		width = file.width;
+		height = file.height;
+		layerCount = file.layerCount;
+		mipLevels = file.mipLevels;
+		// KTX2 files define the format of their (transcoded) image data
+		if (file.format != VK_FORMAT_UNDEFINED) {
+			format = file.format;
+		}
+		this->format = format;
 
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the raw image data into staging memory taken from the device's staging ring
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(file.size);
+		memcpy(staging.data, file.data, file.size);
 
 		// Setup buffer copy regions for each layer including all of its miplevels
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -561,19 +992,17 @@ namespace vks
 		{
 			for (uint32_t level = 0; level < mipLevels; level++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, layer, 0, &offset);
-				assert(result == KTX_SUCCESS);
+				VkDeviceSize offset = file.imageOffset(level, layer, 0);
 
 				VkBufferImageCopy bufferCopyRegion = {};
 				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				bufferCopyRegion.imageSubresource.mipLevel = level;
 				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
 				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
+				bufferCopyRegion.imageExtent.width = std::max(1u, file.width >> level);
+				bufferCopyRegion.imageExtent.height = std::max(1u, file.height >> level);
 				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
+				bufferCopyRegion.bufferOffset = staging.offset + offset;
 
 				bufferCopyRegions.push_back(bufferCopyRegion);
 			}
@@ -599,16 +1028,13 @@ namespace vks
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		// Sub-allocate the image memory from the device's memory allocator
+		VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+		device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, filename);
+		deviceMemory = allocation.memory;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->beginUpload();
 
 		// Image barrier for optimal image (target)
 		// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -628,7 +1054,7 @@ namespace vks
 		// Copy the layers and mip levels from the staging buffer to the optimal tiled image
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			staging.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -636,14 +1062,14 @@ namespace vks
 
 		// Change texture image layout to shader read after all faces have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
+		device->finishImageUpload(
 			copyCmd,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			imageLayout,
 			subresourceRange);
 
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->endUpload(copyCmd, copyQueue);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -660,7 +1086,7 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = (float)mipLevels;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -673,93 +1099,74 @@ namespace vks
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
 	}
 
 	/**
-	* Load a cubemap texture including all mip levels from a single file
+	* Load a cubemap or cubemap array texture including all mip levels from a single file
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
+	* @param filename File to load (supports .ktx and .ktx2)
+	* @param format Vulkan format of the image data stored in the file (ignored for .ktx2 files, which store their format, see Texture::format)
 	* @param device Vulkan device to create the texture on
 	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	*
+	* @note If format is a float format, a BC6H or ASTC HDR compressed variant of the file is loaded instead if the device supports it (see getCompressedHDRFile)
 	*/
 	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
-
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		// HDR environment maps are replaced by their BC6H or ASTC HDR compressed variant if there is one for the device
+		if ((format == VK_FORMAT_R16G16B16A16_SFLOAT) || (format == VK_FORMAT_R32G32B32A32_SFLOAT)) {
+			filename = getCompressedHDRFile(filename, device);
+		}
 
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		TextureFile file;
+		loadTextureFile(filename, device, file);
+		vks::AssetTimer assetTimer(vks::StartupProfiler::AssetUpload);
+		assert(file.faceCount == 6);
 
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+		this->device = device;
+		width = file.width;
+		height = file.height;
+		mipLevels = file.mipLevels;
+		layerCount = file.layerCount;
+		// KTX2 files define the format of their (transcoded) image data
+		if (file.format != VK_FORMAT_UNDEFINED) {
+			format = file.format;
+		}
+		this->format = format;
 
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+		// Copy the raw image data into staging memory taken from the device's staging ring
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(file.size);
+		memcpy(staging.data, file.data, file.size);
 
-		// Setup buffer copy regions for each face including all of its mip levels
+		// Setup buffer copy regions for each face of each cube including all of its mip levels
 		std::vector<VkBufferImageCopy> bufferCopyRegions;
 
-		for (uint32_t face = 0; face < 6; face++)
+		for (uint32_t layer = 0; layer < layerCount; layer++)
 		{
-			for (uint32_t level = 0; level < mipLevels; level++)
+			for (uint32_t face = 0; face < 6; face++)
 			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
-				assert(result == KTX_SUCCESS);
-
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = level;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = face;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
-
-				bufferCopyRegions.push_back(bufferCopyRegion);
+				for (uint32_t level = 0; level < mipLevels; level++)
+				{
+					VkDeviceSize offset = file.imageOffset(level, layer, face);
+
+					VkBufferImageCopy bufferCopyRegion = {};
+					bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					bufferCopyRegion.imageSubresource.mipLevel = level;
+					bufferCopyRegion.imageSubresource.baseArrayLayer = layer * 6 + face;
+					bufferCopyRegion.imageSubresource.layerCount = 1;
+					// Extents of block compressed levels smaller than a block are the level's texel size, which is valid as they reach the image's edge
+					bufferCopyRegion.imageExtent.width = std::max(1u, file.width >> level);
+					bufferCopyRegion.imageExtent.height = std::max(1u, file.height >> level);
+					bufferCopyRegion.imageExtent.depth = 1;
+					bufferCopyRegion.bufferOffset = staging.offset + offset;
+
+					bufferCopyRegions.push_back(bufferCopyRegion);
+				}
 			}
 		}
 
@@ -780,23 +1187,20 @@ namespace vks
 			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		}
 		// Cube faces count as array layers in Vulkan
-		imageCreateInfo.arrayLayers = 6;
+		imageCreateInfo.arrayLayers = 6 * layerCount;
 		// This flag is required for cube map images
 		imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		// Sub-allocate the image memory from the device's memory allocator
+		VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+		device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, filename);
+		deviceMemory = allocation.memory;
 
 		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = device->beginUpload();
 
 		// Image barrier for optimal image (target)
 		// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -804,7 +1208,7 @@ namespace vks
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		subresourceRange.baseMipLevel = 0;
 		subresourceRange.levelCount = mipLevels;
-		subresourceRange.layerCount = 6;
+		subresourceRange.layerCount = 6 * layerCount;
 
 		vks::tools::setImageLayout(
 			copyCmd,
@@ -816,7 +1220,7 @@ namespace vks
 		// Copy the cube map faces from the staging buffer to the optimal tiled image
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			staging.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -824,14 +1228,14 @@ namespace vks
 
 		// Change texture image layout to shader read after all faces have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
+		device->finishImageUpload(
 			copyCmd,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			imageLayout,
 			subresourceRange);
 
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		device->endUpload(copyCmd, copyQueue);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -848,23 +1252,20 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = (float)mipLevels;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
-		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+		// Files with more than one cube are loaded as a cube map array (requires the imageCubeArray feature)
+		viewCreateInfo.viewType = (layerCount > 1) ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
 		viewCreateInfo.format = format;
 		viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		viewCreateInfo.subresourceRange.layerCount = 6;
+		viewCreateInfo.subresourceRange.layerCount = 6 * layerCount;
 		viewCreateInfo.subresourceRange.levelCount = mipLevels;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-		// Clean up staging resources
-		ktxTexture_Destroy(ktxTexture);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
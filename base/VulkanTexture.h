@@ -18,6 +18,7 @@
 #include <ktx.h>
 #include <ktxvulkan.h>
 
+#include "VulkanAssetFile.h"
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTools.h"
@@ -28,6 +29,42 @@
 
 namespace vks
 {
+/** @brief Image data of a texture file and the offsets of its images, independent of the file's container (KTX or KTX2) */
+struct TextureFile
+{
+	uint32_t width = 0, height = 0;
+	uint32_t mipLevels = 1;
+	uint32_t layerCount = 1;
+	uint32_t faceCount = 1;
+	/** @brief Format of the image data, VK_FORMAT_UNDEFINED for KTX files, which don't store a Vulkan format */
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	/** @brief Offsets of the images into data, indexed by (level * layerCount + layer) * faceCount + face */
+	std::vector<VkDeviceSize> offsets;
+	/** @brief Sizes of the images in bytes, indexed like offsets */
+	std::vector<VkDeviceSize> imageSizes;
+	/** @brief Owns the image data of transcoded KTX2 files */
+	std::vector<uint8_t> storage;
+	/** @brief View of the file, owns the image data of KTX2 files that are used as is */
+	vks::AssetFile asset;
+	/** @brief Owns the image data of KTX files */
+	ktxTexture *ktx = nullptr;
+
+	TextureFile() = default;
+	TextureFile(const TextureFile &) = delete;
+	TextureFile &operator=(const TextureFile &) = delete;
+	~TextureFile();
+	VkDeviceSize imageOffset(uint32_t level, uint32_t layer, uint32_t face) const
+	{
+		return offsets[(level * layerCount + layer) * faceCount + face];
+	}
+	VkDeviceSize imageSize(uint32_t level, uint32_t layer, uint32_t face) const
+	{
+		return imageSizes[(level * layerCount + layer) * faceCount + face];
+	}
+};
+
 class Texture
 {
   public:
@@ -35,20 +72,43 @@ class Texture
 	VkImage               image;
 	VkImageLayout         imageLayout;
 	VkDeviceMemory        deviceMemory;
+	vks::Allocation       allocation;
 	VkImageView           view;
 	uint32_t              width, height;
 	uint32_t              mipLevels;
 	uint32_t              layerCount;
+	/** @brief Format the image has been created with, can differ from the requested format for KTX2 files */
+	VkFormat              format;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief State of a texture whose mip levels are streamed in after loading (see Texture2D::loadFromFileStreamed) */
+	struct
+	{
+		/** @brief Image data of the levels that still have to be uploaded, released once all levels are resident */
+		TextureFile *file = nullptr;
+		VkQueue      queue = VK_NULL_HANDLE;
+		/** @brief Most detailed mip level that has been uploaded, the image view starts at this level (min LOD clamp) */
+		uint32_t     residentLevel = 0;
+		/** @brief Id of the asynchronous upload of the next level (0 if none is in flight) */
+		uint64_t     uploadId = 0;
+	} streaming;
 
 	void      updateDescriptor();
 	void      destroy();
+	void      retire();
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	void      loadTextureFile(std::string filename, vks::VulkanDevice *device, TextureFile &file);
+	static VkFormat selectTranscodeFormat(vks::VulkanDevice *device, bool srgb);
+	static VkFormat selectCompressedHDRFormat(vks::VulkanDevice *device);
+	static std::string getCompressedHDRFile(const std::string &filename, vks::VulkanDevice *device);
 };
 
 class Texture2D : public Texture
 {
+  private:
+	void uploadNextLevel();
+	void createView(uint32_t baseMipLevel);
+
   public:
 	void loadFromFile(
 	    std::string        filename,
@@ -58,6 +118,16 @@ class Texture2D : public Texture
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 	    bool               forceLinear     = false);
+	void loadFromFileStreamed(
+	    std::string        filename,
+	    VkFormat           format,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	    VkDeviceSize       initialSize     = 64 * 1024);
+	bool streamingActive() const;
+	bool updateStreaming();
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
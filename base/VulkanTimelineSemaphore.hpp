@@ -0,0 +1,153 @@
+/*
+* Vulkan timeline semaphore class
+*
+* Wraps a VK_KHR_timeline_semaphore semaphore whose monotonically increasing values are used to order submissions across queues and the host
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Timeline semaphore with a monotonically increasing value
+	*
+	* Submissions signal the value returned by next() and other submissions (on any queue) or the host wait for values to be reached,
+	* so there is no need for binary semaphore pairs that have to be signaled and waited on exactly once
+	*
+	* @note Requires VK_KHR_timeline_semaphore with the timelineSemaphore feature enabled (see VulkanExampleBase::enableTimelineSemaphores)
+	*/
+	class TimelineSemaphore
+	{
+	private:
+		PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+		PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+	public:
+		VkDevice device = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		/** @brief Last value handed out by next(), i.e. the value of the latest submitted signal operation */
+		uint64_t value = 0;
+
+		/**
+		* Create the timeline semaphore
+		*
+		* @param device Logical device with the timeline semaphore feature enabled
+		* @param initialValue (Optional) Value the semaphore starts with (Defaults to 0)
+		*/
+		void create(VkDevice device, uint64_t initialValue = 0)
+		{
+			this->device = device;
+			vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+			vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+			VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo{};
+			semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			semaphoreTypeCreateInfo.initialValue = initialValue;
+			VkSemaphoreCreateInfo semaphoreCreateInfo{};
+			semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+			value = initialValue;
+		}
+
+		void destroy()
+		{
+			if (semaphore != VK_NULL_HANDLE) {
+				vkDestroySemaphore(device, semaphore, nullptr);
+				semaphore = VK_NULL_HANDLE;
+			}
+		}
+
+		/** @brief Returns true if the semaphore has been created */
+		bool valid() const
+		{
+			return semaphore != VK_NULL_HANDLE;
+		}
+
+		/** @brief Returns the value the next signal operation has to signal */
+		uint64_t next()
+		{
+			return ++value;
+		}
+
+		/** @brief Returns the value the semaphore has currently reached on the device */
+		uint64_t completedValue() const
+		{
+			uint64_t completed = 0;
+			VK_CHECK_RESULT(vkGetSemaphoreCounterValueKHR(device, semaphore, &completed));
+			return completed;
+		}
+
+		/** @brief Returns true if the given value has been reached, without waiting */
+		bool reached(uint64_t waitValue) const
+		{
+			return completedValue() >= waitValue;
+		}
+
+		/** @brief Wait on the host until the given value has been reached */
+		void wait(uint64_t waitValue) const
+		{
+			VkSemaphoreWaitInfoKHR waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &semaphore;
+			waitInfo.pValues = &waitValue;
+			VK_CHECK_RESULT(vkWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX));
+		}
+	};
+
+	/**
+	* @brief Collects the wait and signal operations of a queue submission that mixes binary and timeline semaphores
+	*
+	* Values of binary semaphores are ignored by the implementation, so they are passed as 0
+	*/
+	struct TimelineSubmit
+	{
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64_t> waitValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+
+		void wait(VkSemaphore semaphore, VkPipelineStageFlags stage, uint64_t value = 0)
+		{
+			waitSemaphores.push_back(semaphore);
+			waitValues.push_back(value);
+			waitStages.push_back(stage);
+		}
+
+		void signal(VkSemaphore semaphore, uint64_t value = 0)
+		{
+			signalSemaphores.push_back(semaphore);
+			signalValues.push_back(value);
+		}
+
+		/**
+		* Fill the semaphore members of a submit info, the submit info must not outlive this object
+		*
+		* @param submitInfo Submit info to set the wait and signal semaphores (including the timeline values in pNext) for
+		*/
+		void apply(VkSubmitInfo& submitInfo)
+		{
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+			timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+			submitInfo.pWaitSemaphores = waitSemaphores.data();
+			submitInfo.pWaitDstStageMask = waitStages.data();
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			submitInfo.pSignalSemaphores = signalSemaphores.data();
+		}
+	};
+}
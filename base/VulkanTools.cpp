@@ -7,6 +7,8 @@
 */
 
 #include "VulkanTools.h"
+#include "VulkanAssetFile.h"
+#include "VulkanPipelineManifest.h"
 
 const std::string getAssetPath()
 {
@@ -74,6 +76,20 @@ namespace vks
 			}
 		}
 
+		std::string presentModeString(VkPresentModeKHR presentMode)
+		{
+			switch (presentMode)
+			{
+#define STR(r) case VK_PRESENT_MODE_ ##r ##_KHR: return #r
+				STR(IMMEDIATE);
+				STR(MAILBOX);
+				STR(FIFO);
+				STR(FIFO_RELAXED);
+#undef STR
+			default: return "UNKNOWN_PRESENT_MODE";
+			}
+		}
+
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 		{
 			// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -310,67 +326,50 @@ namespace vks
 			exitFatal(message, (int32_t)resultCode);
 		}
 
+		namespace
+		{
+			VkShaderModule createShaderModule(const vks::AssetFile& file, const char* fileName, VkDevice device)
+			{
+				if (!file.valid()) {
+					std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+					return VK_NULL_HANDLE;
+				}
+				// SPIR-V code is passed as uint32_t, so copy if the data isn't properly aligned (mapped files are page aligned, assets may not be)
+				const void* shaderCode = file.data();
+				std::vector<uint32_t> alignedCode;
+				if (((uintptr_t)shaderCode % sizeof(uint32_t)) != 0) {
+					alignedCode.resize((file.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+					memcpy(alignedCode.data(), shaderCode, file.size());
+					shaderCode = alignedCode.data();
+				}
+
+				VkShaderModule shaderModule = VK_NULL_HANDLE;
+				VkShaderModuleCreateInfo moduleCreateInfo{};
+				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				moduleCreateInfo.codeSize = file.size();
+				moduleCreateInfo.pCode = (const uint32_t*)shaderCode;
+				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
+				// Lets the pipeline manifest recreate the module from the file for precompiling pipelines that use it
+				vks::PipelineManifest::get().addShaderModule(shaderModule, fileName);
+				return shaderModule;
+			}
+		}
+
+		// The shader file is passed to the driver straight from the asset file's view, without reading it into an intermediate buffer
 #if defined(__ANDROID__)
 		// Android shaders are stored as assets in the apk
 		// So they need to be loaded via the asset manager
 		VkShaderModule loadShader(AAssetManager* assetManager, const char *fileName, VkDevice device)
 		{
-			// Load shader from compressed asset
-			AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-
-			char *shaderCode = new char[size];
-			AAsset_read(asset, shaderCode, size);
-			AAsset_close(asset);
-
-			VkShaderModule shaderModule;
-			VkShaderModuleCreateInfo moduleCreateInfo;
-			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			moduleCreateInfo.pNext = NULL;
-			moduleCreateInfo.codeSize = size;
-			moduleCreateInfo.pCode = (uint32_t*)shaderCode;
-			moduleCreateInfo.flags = 0;
-
-			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
-
-			delete[] shaderCode;
-
-			return shaderModule;
+			vks::AssetFile file;
+			file.open(assetManager, fileName);
+			return createShaderModule(file, fileName, device);
 		}
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device)
 		{
-			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
-
-			if (is.is_open())
-			{
-				size_t size = is.tellg();
-				is.seekg(0, std::ios::beg);
-				char* shaderCode = new char[size];
-				is.read(shaderCode, size);
-				is.close();
-
-				assert(size > 0);
-
-				VkShaderModule shaderModule;
-				VkShaderModuleCreateInfo moduleCreateInfo{};
-				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-				moduleCreateInfo.codeSize = size;
-				moduleCreateInfo.pCode = (uint32_t*)shaderCode;
-
-				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
-
-				delete[] shaderCode;
-
-				return shaderModule;
-			}
-			else
-			{
-				std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
-				return VK_NULL_HANDLE;
-			}
+			vks::AssetFile file(fileName);
+			return createShaderModule(file, fileName, device);
 		}
 #endif
 
@@ -385,5 +384,10 @@ namespace vks
 	        return (value + alignment - 1) & ~(alignment - 1);
         }
 
+		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
 	}
 }
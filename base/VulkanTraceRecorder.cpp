@@ -0,0 +1,266 @@
+/*
+* Vulkan timeline trace recorder
+*
+* Records CPU zones of all threads and GPU scopes of the graphics queue on a common timeline and writes them as a Chrome trace (JSON), which can be opened in chrome://tracing or Perfetto
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTraceRecorder.h"
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Index of the calling thread in the recorder's thread list, assigned on its first zone
+		thread_local int32_t threadIndex = -1;
+
+		std::string escapeJson(const std::string& value)
+		{
+			std::string escaped;
+			for (char c : value) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+	}
+
+	TraceRecorder& TraceRecorder::get()
+	{
+		static TraceRecorder recorder;
+		return recorder;
+	}
+
+	TraceRecorder::~TraceRecorder()
+	{
+		stop();
+	}
+
+	/**
+	* Start recording, the calling thread is named as the main thread
+	*
+	* @param filename File the trace is written to once recording stops
+	* @param maxFrames (Optional) Stop recording after this many frames (0 = no limit)
+	* @param maxDuration (Optional) Stop recording after this many seconds (0 = no limit)
+	*/
+	void TraceRecorder::start(const std::string& filename, uint32_t maxFrames, double maxDuration)
+	{
+		std::lock_guard<std::mutex> lock(eventMutex);
+		this->filename = filename;
+		this->maxFrames = maxFrames;
+		this->maxDuration = maxDuration;
+		events.clear();
+		threadNames = { "Main" };
+		threadIndex = 0;
+		frameCount = 0;
+		startTime = Clock::now();
+		recording = true;
+	}
+
+	/** @brief Stop recording and write the trace file */
+	void TraceRecorder::stop()
+	{
+		if (!recording.exchange(false)) {
+			return;
+		}
+		write();
+	}
+
+	bool TraceRecorder::active() const
+	{
+		return recording;
+	}
+
+	uint32_t TraceRecorder::getThreadIndex()
+	{
+		// Called with the event mutex locked
+		if (threadIndex < 0) {
+			threadIndex = static_cast<int32_t>(threadNames.size());
+			threadNames.push_back("Worker " + std::to_string(threadIndex));
+		}
+		return static_cast<uint32_t>(threadIndex);
+	}
+
+	/**
+	* Setup the conversion of device timestamps, calibrated timestamps are used if the device supports them for a host clock matching the steady clock
+	*
+	* @param instance Instance used to load the physical device functions of VK_EXT_calibrated_timestamps
+	* @param device Device whose graphics queue timestamps are recorded
+	*/
+	void TraceRecorder::setupGpuClock(VkInstance instance, vks::VulkanDevice* device)
+	{
+		gpuClock.device = device;
+		gpuClock.timestampPeriod = device->properties.limits.timestampPeriod;
+		gpuClock.calibrated = false;
+		gpuClock.aligned = false;
+		gpuClock.vkGetCalibratedTimestampsEXT = nullptr;
+		if (!device->calibratedTimestampsSupported) {
+			std::cout << "Calibrated timestamps are not supported, GPU scopes of the trace are aligned to their submissions\n";
+			return;
+		}
+		// The steady clock is based on CLOCK_MONOTONIC on Linux and Android and on the performance counter on Windows
+#if defined(_WIN32)
+		const VkTimeDomainEXT hostDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+		const VkTimeDomainEXT hostDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+		PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+		if (!vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) {
+			return;
+		}
+		uint32_t domainCount = 0;
+		VK_CHECK_RESULT(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(device->physicalDevice, &domainCount, nullptr));
+		std::vector<VkTimeDomainEXT> domains(domainCount);
+		VK_CHECK_RESULT(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(device->physicalDevice, &domainCount, domains.data()));
+		bool deviceDomain = false;
+		bool hostDomainSupported = false;
+		for (VkTimeDomainEXT domain : domains) {
+			deviceDomain |= (domain == VK_TIME_DOMAIN_DEVICE_EXT);
+			hostDomainSupported |= (domain == hostDomain);
+		}
+		if (!deviceDomain || !hostDomainSupported) {
+			std::cout << "The device can't calibrate its timestamps against the steady clock, GPU scopes of the trace are aligned to their submissions\n";
+			return;
+		}
+		gpuClock.hostDomain = hostDomain;
+		gpuClock.vkGetCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetCalibratedTimestampsEXT"));
+		gpuClock.calibrated = calibrate();
+	}
+
+	/** @brief Sample the device and host clocks together, device timestamps are converted relative to this pair */
+	bool TraceRecorder::calibrate()
+	{
+		if (!gpuClock.vkGetCalibratedTimestampsEXT) {
+			return false;
+		}
+		VkCalibratedTimestampInfoEXT timestampInfos[2]{};
+		timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+		timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		timestampInfos[1].timeDomain = gpuClock.hostDomain;
+		uint64_t timestamps[2];
+		uint64_t maxDeviation;
+		if (gpuClock.vkGetCalibratedTimestampsEXT(gpuClock.device->logicalDevice, 2, timestampInfos, timestamps, &maxDeviation) != VK_SUCCESS) {
+			return false;
+		}
+#if defined(_WIN32)
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		const std::chrono::nanoseconds hostNanoseconds(static_cast<int64_t>(static_cast<double>(timestamps[1]) * 1e9 / static_cast<double>(frequency.QuadPart)));
+#else
+		const std::chrono::nanoseconds hostNanoseconds(static_cast<int64_t>(timestamps[1]));
+#endif
+		gpuClock.deviceTicks = timestamps[0];
+		gpuClock.hostTime = Clock::time_point(std::chrono::duration_cast<Clock::duration>(hostNanoseconds));
+		gpuClock.lastCalibration = Clock::now();
+		gpuClock.aligned = true;
+		return true;
+	}
+
+	/** @brief Add a CPU zone of the calling thread */
+	void TraceRecorder::addCpuZone(const std::string& name, Clock::time_point begin, Clock::time_point end)
+	{
+		if (!recording) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(eventMutex);
+		events.push_back({ name, getThreadIndex(), false, begin, end });
+	}
+
+	/**
+	* Add a GPU scope of the graphics queue
+	*
+	* @param name Name of the scope
+	* @param depth Nesting level of the scope
+	* @param beginTicks Device timestamp at the start of the scope
+	* @param endTicks Device timestamp at the end of the scope
+	* @param submitTime Time the command buffer containing the scope was submitted, only used if the timestamps aren't calibrated
+	*/
+	void TraceRecorder::addGpuScope(const std::string& name, uint32_t depth, uint64_t beginTicks, uint64_t endTicks, Clock::time_point submitTime)
+	{
+		if (!recording || !gpuClock.device) {
+			return;
+		}
+		if (!gpuClock.aligned) {
+			gpuClock.deviceTicks = beginTicks;
+			gpuClock.hostTime = submitTime;
+			gpuClock.aligned = true;
+		}
+		// Timestamps may have fewer valid bits than 64, so differences are taken modulo the valid range and sign extended
+		const uint32_t validBits = gpuClock.device->queueFamilyProperties[gpuClock.device->queueFamilyIndices.graphics].timestampValidBits;
+		const uint64_t mask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+		auto toHost = [&](uint64_t ticks) {
+			uint64_t delta = (ticks - gpuClock.deviceTicks) & mask;
+			int64_t signedDelta = (delta > (mask >> 1)) ? -static_cast<int64_t>((mask - delta) + 1) : static_cast<int64_t>(delta);
+			const std::chrono::nanoseconds offset(static_cast<int64_t>(static_cast<double>(signedDelta) * gpuClock.timestampPeriod));
+			return gpuClock.hostTime + std::chrono::duration_cast<Clock::duration>(offset);
+		};
+		const Clock::time_point begin = toHost(beginTicks);
+		const Clock::time_point end = toHost(endTicks);
+		std::lock_guard<std::mutex> lock(eventMutex);
+		events.push_back({ name, depth, true, begin, end });
+	}
+
+	/** @brief Count a frame, stops recording once the frame or duration limit is reached */
+	void TraceRecorder::frameCompleted()
+	{
+		if (!recording) {
+			return;
+		}
+		frameCount++;
+		const Clock::time_point now = Clock::now();
+		// Device and host clocks drift apart, so the calibration is renewed once per second
+		if (gpuClock.calibrated && (now - gpuClock.lastCalibration > std::chrono::seconds(1))) {
+			calibrate();
+		}
+		const double elapsed = std::chrono::duration<double>(now - startTime).count();
+		if (((maxFrames > 0) && (frameCount >= maxFrames)) || ((maxDuration > 0.0) && (elapsed >= maxDuration))) {
+			stop();
+		}
+	}
+
+	void TraceRecorder::write()
+	{
+		std::lock_guard<std::mutex> lock(eventMutex);
+		std::ofstream file(filename, std::ios::out | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Could not write trace to \"" << filename << "\"\n";
+			return;
+		}
+		file << std::fixed << std::setprecision(3);
+		// CPU threads are grouped in one process and the graphics queue in another, timestamps are in microseconds since the start of the recording
+		file << "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n";
+		file << "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": { \"name\": \"CPU\" } },\n";
+		file << "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 2, \"args\": { \"name\": \"GPU\" } },\n";
+		file << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 2, \"tid\": 0, \"args\": { \"name\": \"Graphics queue\" } }";
+		for (size_t i = 0; i < threadNames.size(); i++) {
+			file << ",\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i << ", \"args\": { \"name\": \"" << escapeJson(threadNames[i]) << "\" } }";
+		}
+		for (auto& event : events) {
+			const double begin = std::chrono::duration<double, std::micro>(event.begin - startTime).count();
+			const double duration = std::chrono::duration<double, std::micro>(event.end - event.begin).count();
+			file << ",\n{ \"name\": \"" << escapeJson(event.name) << "\", \"ph\": \"X\", \"ts\": " << begin << ", \"dur\": " << duration;
+			if (event.gpu) {
+				file << ", \"pid\": 2, \"tid\": 0, \"args\": { \"depth\": " << event.track << " } }";
+			} else {
+				file << ", \"pid\": 1, \"tid\": " << event.track << " }";
+			}
+		}
+		file << "\n]\n}\n";
+		std::cout << "Trace with " << events.size() << " events written to \"" << filename << "\"\n";
+		events.clear();
+	}
+}
@@ -0,0 +1,124 @@
+/*
+* Vulkan timeline trace recorder
+*
+* Records CPU zones of all threads and GPU scopes of the graphics queue on a common timeline and writes them as a Chrome trace (JSON), which can be opened in chrome://tracing or Perfetto
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief Records a timeline of CPU zones and GPU scopes
+	*
+	* CPU zones are timed with the steady clock, GPU scopes are converted from device timestamps to the same clock.
+	* With VK_EXT_calibrated_timestamps both clocks are sampled together and the conversion is recalibrated regularly, so GPU scopes line up with the CPU zones that submitted them.
+	* Without it the first GPU scope is aligned to the submission of its command buffer, so GPU scopes are only placed approximately.
+	*
+	* There is one recorder per process (see get()), so zones can be recorded from any thread without passing it around.
+	* Recording is off until start() is called, zones only cost a check of an atomic flag then.
+	*/
+	class TraceRecorder
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+	private:
+		struct Event
+		{
+			std::string name;
+			/** @brief Thread index for CPU zones, nesting level for GPU scopes */
+			uint32_t track;
+			bool gpu;
+			Clock::time_point begin;
+			Clock::time_point end;
+		};
+
+		std::atomic<bool> recording{ false };
+		std::mutex eventMutex;
+		std::vector<Event> events;
+		std::vector<std::string> threadNames;
+		std::string filename;
+		Clock::time_point startTime;
+		uint32_t frameCount = 0;
+		uint32_t maxFrames = 0;
+		double maxDuration = 0.0;
+		uint32_t maxGpuDepth = 0;
+
+		// Conversion of device timestamps to the steady clock
+		struct
+		{
+			vks::VulkanDevice* device = nullptr;
+			PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT = nullptr;
+			VkTimeDomainEXT hostDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+			double timestampPeriod = 1.0;
+			bool calibrated = false;
+			bool aligned = false;
+			uint64_t deviceTicks = 0;
+			Clock::time_point hostTime;
+			Clock::time_point lastCalibration;
+		} gpuClock;
+
+		uint32_t getThreadIndex();
+		bool calibrate();
+		void write();
+
+	public:
+		static TraceRecorder& get();
+
+		~TraceRecorder();
+		void start(const std::string& filename, uint32_t maxFrames = 0, double maxDuration = 0.0);
+		void stop();
+		bool active() const;
+		void setupGpuClock(VkInstance instance, vks::VulkanDevice* device);
+		void addCpuZone(const std::string& name, Clock::time_point begin, Clock::time_point end);
+		void addGpuScope(const std::string& name, uint32_t depth, uint64_t beginTicks, uint64_t endTicks, Clock::time_point submitTime);
+		void frameCompleted();
+	};
+
+	/** @brief Records a CPU zone covering the lifetime of the object on the calling thread */
+	class TraceZone
+	{
+	private:
+		const char* name;
+		bool recording;
+		TraceRecorder::Clock::time_point begin;
+
+	public:
+		explicit TraceZone(const char* name) : name(name), recording(TraceRecorder::get().active())
+		{
+			if (recording) {
+				begin = TraceRecorder::Clock::now();
+			}
+		}
+		~TraceZone()
+		{
+			if (recording) {
+				TraceRecorder::get().addCpuZone(name, begin, TraceRecorder::Clock::now());
+			}
+		}
+		/** @brief End the current zone and start the next one, so consecutive stages of a function can be recorded without nesting scopes */
+		void next(const char* name)
+		{
+			if (recording) {
+				const TraceRecorder::Clock::time_point now = TraceRecorder::Clock::now();
+				TraceRecorder::get().addCpuZone(this->name, begin, now);
+				begin = now;
+			}
+			this->name = name;
+		}
+	};
+}
@@ -8,6 +8,11 @@
 */
 
 #include "VulkanUIOverlay.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+
+#include <array>
+#include <cmath>
 
 namespace vks 
 {
@@ -182,7 +187,7 @@ namespace vks
 
 		// Descriptor pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -192,7 +197,7 @@ namespace vks
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Descriptor set
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
@@ -206,6 +211,56 @@ namespace vks
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &fontDescriptor)
 		};
 		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		if (!layer.enabled) {
+			return;
+		}
+
+		// The layer's descriptor is written once its image has been created (see resize)
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &layer.descriptorSet));
+
+		// Render pass for the layer, the whole layer is cleared and redrawn each time
+		VkAttachmentDescription attachment{};
+		attachment.format = layer.format;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpassDescription{};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		// The layer is rendered on the same queue as the frames compositing it, so these dependencies order it against frames submitted before and after it
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = 1;
+		renderPassCI.pAttachments = &attachment;
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device->logicalDevice, &renderPassCI, nullptr, &layer.renderPass));
+
+		layer.commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		layer.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, layer.commandPool, false);
+		VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCI, nullptr, &layer.fence));
 	}
 
 	/** Prepare a separate pipeline for the UI overlay rendering decoupled from the main application */
@@ -217,7 +272,7 @@ namespace vks
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 		// Setup graphics pipeline for UI rendering
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
@@ -268,6 +323,7 @@ namespace vks
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaders.size());
 		pipelineCreateInfo.pStages = shaders.data();
 		pipelineCreateInfo.subpass = subpass;
+		pipelineCreateInfo.pNext = pipelineRenderingInfo;
 
 		// Vertex bindings an attributes based on ImGui vertex definition
 		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
@@ -286,10 +342,46 @@ namespace vks
 
 		pipelineCreateInfo.pVertexInputState = &vertexInputState;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+
+		if (!layer.enabled) {
+			return;
+		}
+
+		// The layer stores premultiplied colors along with the UI's coverage in alpha
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		pipelineCreateInfo.renderPass = layer.renderPass;
+		pipelineCreateInfo.subpass = 0;
+		pipelineCreateInfo.pNext = nullptr;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &layer.pipeline));
+
+		// Compositing blends the premultiplied layer over the frame with a full screen triangle and leaves the frame's alpha untouched
+		assert(layerShaders.size() == 2);
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		multisampleState.rasterizationSamples = rasterizationSamples;
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		pipelineCreateInfo.pVertexInputState = &emptyInputState;
+		pipelineCreateInfo.stageCount = static_cast<uint32_t>(layerShaders.size());
+		pipelineCreateInfo.pStages = layerShaders.data();
+		pipelineCreateInfo.renderPass = renderPass;
+		pipelineCreateInfo.subpass = subpass;
+		pipelineCreateInfo.pNext = pipelineRenderingInfo;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &layer.compositePipeline));
 	}
 
 	/** Update vertex and index buffer containing the imGui elements when required */
+	/**
+	* Upload the current ImGui draw data to the geometry buffers
+	*
+	* @return True if the buffers had to be recreated or the amount of geometry changed, so command buffers drawing the UI need to be rebuilt (ignored if command buffers are recorded each frame)
+	*
+	* @note If more than one buffer region is used, each update writes to the next region, so regions used by previous frames can still be read by the GPU
+	*/
 	bool UIOverlay::update()
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
@@ -306,31 +398,46 @@ namespace vks
 			return false;
 		}
 
+		// Buffers are only grown, so UI changes usually don't require any reallocation
+		const bool growVertexBuffer = (vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount < imDrawData->TotalVtxCount);
+		const bool growIndexBuffer = (indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount);
+
+		// The old buffers may still be in use by frames in flight, so they're handed to the deletion queue instead of waiting for the queue to become idle
+
 		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
+		if (growVertexBuffer) {
+			if (vertexBuffer.buffer != VK_NULL_HANDLE) {
+				device->deletionQueue.buffer(vertexBuffer);
+			}
+			// Grow geometrically, so growing UIs don't reallocate on each update
+			vertexCount = std::max(imDrawData->TotalVtxCount, vertexCount * 2);
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexCount * sizeof(ImDrawVert) * bufferRegions));
 			vertexBuffer.map();
 			updateCmdBuffers = true;
 		}
 
 		// Index buffer
-		VkDeviceSize indexSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
+		if (growIndexBuffer) {
+			if (indexBuffer.buffer != VK_NULL_HANDLE) {
+				device->deletionQueue.buffer(indexBuffer);
+			}
+			indexCount = std::max(imDrawData->TotalIdxCount, indexCount * 2);
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexCount * sizeof(ImDrawIdx) * bufferRegions));
 			indexBuffer.map();
 			updateCmdBuffers = true;
 		}
 
+		// The draw commands depend on the amount of geometry, but not on the buffer contents
+		if ((updateVertexCount != imDrawData->TotalVtxCount) || (updateIndexCount != imDrawData->TotalIdxCount)) {
+			updateVertexCount = imDrawData->TotalVtxCount;
+			updateIndexCount = imDrawData->TotalIdxCount;
+			updateCmdBuffers = true;
+		}
+
 		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		currentRegion = (currentRegion + 1) % bufferRegions;
+		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped + currentRegion * vertexCount;
+		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped + currentRegion * indexCount;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -347,28 +454,108 @@ namespace vks
 		return updateCmdBuffers;
 	}
 
+	/**
+	* Render the current ImGui draw data into the layer if it changed since the layer has last been rendered
+	*
+	* @param interactive True while the UI is interacted with, which re-renders changes right away instead of capping the rate to minInterval
+	*
+	* @note The layer is rendered with a separate submission to the overlay's queue, which has to be the queue the frames compositing it are submitted to
+	*/
+	void UIOverlay::updateLayer(bool interactive)
+	{
+		ImDrawData* imDrawData = ImGui::GetDrawData();
+		if (!imDrawData || (layer.framebuffer == VK_NULL_HANDLE)) {
+			return;
+		}
+
+		const uint64_t hash = hashDrawData(imDrawData);
+		const auto now = std::chrono::high_resolution_clock::now();
+		if (!layer.outdated) {
+			if (hash == layer.drawDataHash) {
+				return;
+			}
+			if (!interactive && (std::chrono::duration<double>(now - layer.lastRender).count() < layer.minInterval)) {
+				return;
+			}
+		}
+
+		// The last render may still read the geometry buffers
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &layer.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &layer.fence));
+		update();
+
+		VK_CHECK_RESULT(vkResetCommandPool(device->logicalDevice, layer.commandPool, 0));
+		VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(layer.commandBuffer, &beginInfo));
+		VkClearValue clearValue{};
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = layer.renderPass;
+		renderPassBeginInfo.framebuffer = layer.framebuffer;
+		renderPassBeginInfo.renderArea.extent = framebufferSize;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearValue;
+		vkCmdBeginRenderPass(layer.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		const VkViewport viewport = vks::initializers::viewport(static_cast<float>(framebufferSize.width), static_cast<float>(framebufferSize.height), 0.0f, 1.0f);
+		vkCmdSetViewport(layer.commandBuffer, 0, 1, &viewport);
+		vkCmdBindPipeline(layer.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layer.pipeline);
+		drawDrawData(layer.commandBuffer);
+		vkCmdEndRenderPass(layer.commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(layer.commandBuffer));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &layer.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, layer.fence));
+
+		layer.drawDataHash = hash;
+		layer.lastRender = now;
+		layer.outdated = false;
+		layer.renderCount++;
+	}
+
+	/** @brief Draw the UI, or composite the cached layer if it's enabled */
 	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
+	{
+		if (layer.enabled) {
+			if (layer.view != VK_NULL_HANDLE) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layer.compositePipeline);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &layer.descriptorSet, 0, nullptr);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			}
+			return;
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		drawDrawData(commandBuffer);
+	}
+
+	/** @brief Record the draws of the last update with the currently bound pipeline */
+	void UIOverlay::drawDrawData(const VkCommandBuffer commandBuffer)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		int32_t vertexOffset = 0;
 		int32_t indexOffset = 0;
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || (vertexBuffer.buffer == VK_NULL_HANDLE) || (indexBuffer.buffer == VK_NULL_HANDLE)) {
 			return;
 		}
 
 		ImGuiIO& io = ImGui::GetIO();
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
 		pushConstBlock.scale = glm::vec2(2.0f / io.DisplaySize.x, 2.0f / io.DisplaySize.y);
 		pushConstBlock.translate = glm::vec2(-1.0f);
+		const float angle = glm::radians(static_cast<float>(preRotation));
+		const float cosAngle = std::round(std::cos(angle));
+		const float sinAngle = std::round(std::sin(angle));
+		pushConstBlock.rotation = glm::vec4(cosAngle, sinAngle, -sinAngle, cosAngle);
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
-		VkDeviceSize offsets[1] = { 0 };
+		// Bind the region written by the last update
+		VkDeviceSize offsets[1] = { currentRegion * vertexCount * sizeof(ImDrawVert) };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, currentRegion * indexCount * sizeof(ImDrawIdx), VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -376,11 +563,22 @@ namespace vks
 			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++)
 			{
 				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
+				glm::vec4 clipRect = glm::vec4(pcmd->ClipRect.x, pcmd->ClipRect.y, pcmd->ClipRect.z, pcmd->ClipRect.w);
+				if (preRotation != 0) {
+					// Rotate the corners of the clip rectangle the same way as the vertices
+					glm::vec2 corners[2] = { glm::vec2(clipRect.x, clipRect.y), glm::vec2(clipRect.z, clipRect.w) };
+					for (auto& corner : corners) {
+						const glm::vec2 ndc = corner * pushConstBlock.scale + pushConstBlock.translate;
+						const glm::vec2 rotated = ndc.x * glm::vec2(pushConstBlock.rotation.x, pushConstBlock.rotation.y) + ndc.y * glm::vec2(pushConstBlock.rotation.z, pushConstBlock.rotation.w);
+						corner = (rotated * 0.5f + 0.5f) * glm::vec2(static_cast<float>(framebufferSize.width), static_cast<float>(framebufferSize.height));
+					}
+					clipRect = glm::vec4(glm::min(corners[0], corners[1]), glm::max(corners[0], corners[1]));
+				}
 				VkRect2D scissorRect;
-				scissorRect.offset.x = std::max((int32_t)(pcmd->ClipRect.x), 0);
-				scissorRect.offset.y = std::max((int32_t)(pcmd->ClipRect.y), 0);
-				scissorRect.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
-				scissorRect.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y);
+				scissorRect.offset.x = std::max((int32_t)(clipRect.x), 0);
+				scissorRect.offset.y = std::max((int32_t)(clipRect.y), 0);
+				scissorRect.extent.width = (uint32_t)(clipRect.z - clipRect.x);
+				scissorRect.extent.height = (uint32_t)(clipRect.w - clipRect.y);
 				vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
 				vkCmdDrawIndexed(commandBuffer, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
 				indexOffset += pcmd->ElemCount;
@@ -389,16 +587,131 @@ namespace vks
 		}
 	}
 
+	/** @brief Set the size of the images the UI is drawn to, the UI is laid out with their width and height swapped if they are pre-rotated by a quarter turn */
 	void UIOverlay::resize(uint32_t width, uint32_t height)
 	{
+		const bool sizeChanged = (framebufferSize.width != width) || (framebufferSize.height != height);
+		framebufferSize = { width, height };
+		if (layer.enabled && (width > 0) && (height > 0) && (sizeChanged || (layer.image == VK_NULL_HANDLE))) {
+			createLayerImage();
+		}
 		ImGuiIO& io = ImGui::GetIO();
+		if ((preRotation == 90) || (preRotation == 270)) {
+			std::swap(width, height);
+		}
 		io.DisplaySize = ImVec2((float)(width), (float)(height));
 	}
 
+	/** @brief (Re)create the layer at the size of the framebuffer, it's cleared and rendered with the next updateLayer */
+	void UIOverlay::createLayerImage()
+	{
+		if (layer.image != VK_NULL_HANDLE) {
+			// Frames in flight may still composite the old layer, resizes are rare enough to simply wait for them
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+			destroyLayerImage();
+		}
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = layer.format;
+		imageCI.extent = { framebufferSize.width, framebufferSize.height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &layer.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, layer.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &layer.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, layer.image, layer.memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.image = layer.image;
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = layer.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &layer.view));
+
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = layer.renderPass;
+		framebufferCI.attachmentCount = 1;
+		framebufferCI.pAttachments = &layer.view;
+		framebufferCI.width = framebufferSize.width;
+		framebufferCI.height = framebufferSize.height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &layer.framebuffer));
+
+		// Frames may composite the layer before it's rendered for the first time, so it starts out transparent
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, layer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(copyCmd, layer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+		vks::tools::setImageLayout(copyCmd, layer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		device->flushCommandBuffer(copyCmd, queue, true);
+
+		VkDescriptorImageInfo layerDescriptor = vks::initializers::descriptorImageInfo(sampler, layer.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(layer.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &layerDescriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+		layer.outdated = true;
+	}
+
+	void UIOverlay::destroyLayerImage()
+	{
+		vkDestroyFramebuffer(device->logicalDevice, layer.framebuffer, nullptr);
+		vkDestroyImageView(device->logicalDevice, layer.view, nullptr);
+		vkDestroyImage(device->logicalDevice, layer.image, nullptr);
+		vkFreeMemory(device->logicalDevice, layer.memory, nullptr);
+		layer.framebuffer = VK_NULL_HANDLE;
+		layer.view = VK_NULL_HANDLE;
+		layer.image = VK_NULL_HANDLE;
+		layer.memory = VK_NULL_HANDLE;
+	}
+
+	/** @brief Hash of everything that affects the rendered UI (geometry, draw commands and display size) */
+	uint64_t UIOverlay::hashDrawData(const ImDrawData* imDrawData) const
+	{
+		// FNV-1a on 32 bit words, the geometry is hashed each frame, so this needs to be cheap rather than collision resistant
+		uint64_t hash = 14695981039346656037ull;
+		auto combine = [&hash](const void* data, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			size_t i = 0;
+			for (; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+				uint32_t word;
+				memcpy(&word, bytes + i, sizeof(uint32_t));
+				hash = (hash ^ word) * 1099511628211ull;
+			}
+			for (; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		};
+		const ImVec2 displaySize = ImGui::GetIO().DisplaySize;
+		combine(&displaySize, sizeof(ImVec2));
+		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
+			const ImDrawList* cmdList = imDrawData->CmdLists[i];
+			combine(cmdList->VtxBuffer.Data, cmdList->VtxBuffer.Size * sizeof(ImDrawVert));
+			combine(cmdList->IdxBuffer.Data, cmdList->IdxBuffer.Size * sizeof(ImDrawIdx));
+			for (int32_t j = 0; j < cmdList->CmdBuffer.Size; j++) {
+				const ImDrawCmd& cmd = cmdList->CmdBuffer[j];
+				combine(&cmd.ClipRect, sizeof(ImVec4));
+				combine(&cmd.ElemCount, sizeof(cmd.ElemCount));
+			}
+		}
+		return hash;
+	}
+
 	void UIOverlay::freeResources()
 	{
 		ImGui::DestroyContext();
+		vertexBuffer.unmap();
 		vertexBuffer.destroy();
+		indexBuffer.unmap();
 		indexBuffer.destroy();
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
@@ -408,6 +721,14 @@ namespace vks
 		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
 		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		if (layer.enabled) {
+			destroyLayerImage();
+			vkDestroyFence(device->logicalDevice, layer.fence, nullptr);
+			vkDestroyCommandPool(device->logicalDevice, layer.commandPool, nullptr);
+			vkDestroyRenderPass(device->logicalDevice, layer.renderPass, nullptr);
+			vkDestroyPipeline(device->logicalDevice, layer.pipeline, nullptr);
+			vkDestroyPipeline(device->logicalDevice, layer.compositePipeline, nullptr);
+		}
 	}
 
 	bool UIOverlay::header(const char *caption)
@@ -15,6 +15,7 @@
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
@@ -38,13 +39,26 @@ namespace vks
 
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
+		/** @brief VkPipelineRenderingCreateInfoKHR chained to the overlay pipeline if it's drawn with dynamic rendering instead of a render pass (only read by preparePipeline) */
+		const void* pipelineRenderingInfo = nullptr;
 
+		// Persistently mapped geometry buffers, only recreated (with some headroom) if the UI outgrows them
 		vks::Buffer vertexBuffer;
 		vks::Buffer indexBuffer;
+		// Capacity of each buffer region in vertices and indices
 		int32_t vertexCount = 0;
 		int32_t indexCount = 0;
+		/** @brief Number of regions the geometry buffers are split into, so an update doesn't overwrite data still read by frames in flight (must be set before the first update) */
+		uint32_t bufferRegions = 1;
+		// Region written by the last update and used by draw
+		uint32_t currentRegion = 0;
+		// Number of vertices and indices of the last update, pre-recorded draw commands need to be rebuilt if these change
+		int32_t updateVertexCount = 0;
+		int32_t updateIndexCount = 0;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
+		/** @brief Full screen vertex and layer sampling fragment shader for compositing the cached layer (only required if the layer is enabled) */
+		std::vector<VkPipelineShaderStageCreateInfo> layerShaders;
 
 		VkDescriptorPool descriptorPool;
 		VkDescriptorSetLayout descriptorSetLayout;
@@ -60,8 +74,51 @@ namespace vks
 		struct PushConstBlock {
 			glm::vec2 scale;
 			glm::vec2 translate;
+			// Columns of the rotation into pre-rotated swap chain images
+			glm::vec4 rotation;
 		} pushConstBlock;
 
+		/** @brief Clockwise rotation (in degrees) of pre-rotated swap chain images, the UI is laid out in the display's orientation and rotated when drawn */
+		uint32_t preRotation = 0;
+		/** @brief Size of the images the UI is drawn to, as passed to resize */
+		VkExtent2D framebufferSize = { 0, 0 };
+
+		/**
+		* @brief Optional offscreen layer the UI is rendered to instead of the frame, which is then composited with a single full screen draw
+		*
+		* The layer is only re-rendered if ImGui's draw data changes, and at most every minInterval seconds while the UI isn't interacted with.
+		* Compositing the layer doesn't depend on the UI's geometry, so pre-recorded command buffers only need to be rebuilt if the example's state changes.
+		*/
+		struct Layer {
+			/** @brief Must be set before prepareResources */
+			bool enabled = false;
+			/** @brief Color format of the layer, should match the images it's composited onto */
+			VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+			/** @brief Minimum time between re-renders in seconds, caps the rate of constantly changing statistics */
+			double minInterval = 0.1;
+			/** @brief Number of times the layer has been rendered */
+			uint32_t renderCount = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			// Draws the UI into the layer
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			// Blends the layer over the frame
+			VkPipeline compositePipeline = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			// Signaled once the last render of the layer has finished, so the geometry buffers can be written again
+			VkFence fence = VK_NULL_HANDLE;
+			// Hash of the draw data the layer has been rendered with
+			uint64_t drawDataHash = 0;
+			std::chrono::high_resolution_clock::time_point lastRender;
+			// Set if the layer has to be rendered with the next update regardless of the draw data (e.g. after it has been recreated)
+			bool outdated = true;
+		} layer;
+
 		bool visible = true;
 		bool updated = false;
 		float scale = 1.0f;
@@ -73,8 +130,13 @@ namespace vks
 		void prepareResources();
 
 		bool update();
+		void updateLayer(bool interactive);
 		void draw(const VkCommandBuffer commandBuffer);
+		void drawDrawData(const VkCommandBuffer commandBuffer);
 		void resize(uint32_t width, uint32_t height);
+		void createLayerImage();
+		void destroyLayerImage();
+		uint64_t hashDrawData(const ImDrawData* imDrawData) const;
 
 		void freeResources();
 
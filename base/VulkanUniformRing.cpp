@@ -0,0 +1,108 @@
+/*
+* Vulkan uniform ring buffer
+*
+* Per frame in flight linear allocator for uniform data that's bound with dynamic offsets
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformRing.h"
+
+#include <algorithm>
+
+namespace vks
+{
+	UniformRing::~UniformRing()
+	{
+		destroy();
+	}
+
+	/**
+	* Create the ring buffer
+	*
+	* @param device Device to create the buffer on
+	* @param frameSize Bytes of uniform data available to each frame (rounded up to the offset alignment)
+	* @param frameCount Number of frames in flight
+	*/
+	void UniformRing::setup(vks::VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount)
+	{
+		assert(this->device == nullptr);
+		this->device = device;
+		this->frameCount = frameCount;
+		alignment = std::max(device->properties.limits.minUniformBufferOffsetAlignment, static_cast<VkDeviceSize>(16));
+		maxBlockSize = std::min(maxBlockSize, static_cast<VkDeviceSize>(device->properties.limits.maxUniformBufferRange));
+		this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+		// The descriptor range of a dynamic uniform buffer starts at the dynamic offset, so the buffer is padded for a full range at the last slice
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			this->frameSize * frameCount + maxBlockSize));
+		VK_CHECK_RESULT(buffer.map());
+	}
+
+	/** @brief Release the buffer, command buffers using it must have finished executing */
+	void UniformRing::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		buffer.destroy();
+		device = nullptr;
+	}
+
+	/**
+	* Start allocating from the region of a frame in flight, the GPU must have finished the frame that last used it
+	*
+	* @param frameIndex Index of the frame in flight (0..frameCount-1)
+	*/
+	void UniformRing::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frameCount);
+		frameStart = frameSize * frameIndex;
+		head = 0;
+	}
+
+	/**
+	* Allocate an aligned slice of the current frame's region
+	*
+	* @param size Size of the uniform block in bytes
+	* @param data Receives the host pointer to write the block to
+	*
+	* @return Dynamic offset of the slice
+	*/
+	uint32_t UniformRing::allocate(VkDeviceSize size, void** data)
+	{
+		assert(device);
+		if ((size > maxBlockSize) || (head + size > frameSize)) {
+			vks::tools::exitFatal("Uniform ring: The uniform data of a frame exceeds the size of its region", -1);
+		}
+		const VkDeviceSize offset = frameStart + head;
+		head = (head + size + alignment - 1) & ~(alignment - 1);
+		highWatermark = std::max(highWatermark, head);
+		*data = static_cast<uint8_t*>(buffer.mapped) + offset;
+		return static_cast<uint32_t>(offset);
+	}
+
+	/**
+	* Get the descriptor for a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding
+	*
+	* @param range Size of the uniform block bound to the binding
+	*/
+	VkDescriptorBufferInfo UniformRing::getDescriptor(VkDeviceSize range) const
+	{
+		assert(range <= maxBlockSize);
+		VkDescriptorBufferInfo descriptor{};
+		descriptor.buffer = buffer.buffer;
+		descriptor.offset = 0;
+		descriptor.range = range;
+		return descriptor;
+	}
+
+	bool UniformRing::isReady() const
+	{
+		return device != nullptr;
+	}
+}
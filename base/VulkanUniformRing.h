@@ -0,0 +1,67 @@
+/*
+* Vulkan uniform ring buffer
+*
+* Per frame in flight linear allocator for uniform data that's bound with dynamic offsets
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstring>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Linear allocator for uniform data that changes every frame
+	*
+	* A single persistently mapped, host coherent uniform buffer is split into one region per frame in flight. Uniform blocks of a frame are
+	* written to consecutive minUniformBufferOffsetAlignment aligned slices of the frame's region and bound with dynamic offsets
+	* (VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC), so there is one descriptor for all of them, nothing is allocated per update and no flushes are required.
+	* The region of a frame in flight is reused once the frame's fence has been waited on (see beginFrame), so data written for a frame
+	* never overwrites data that's still read by the GPU, unlike updating a single uniform buffer in place.
+	*
+	* @note The dynamic offsets are baked into the command buffers, so this is meant for command buffers recorded each frame (see VulkanExampleBase::dynamicCommandBuffers)
+	*/
+	class UniformRing
+	{
+	private:
+		vks::VulkanDevice* device = nullptr;
+		vks::Buffer buffer;
+		VkDeviceSize alignment = 0;
+		VkDeviceSize frameSize = 0;
+		uint32_t frameCount = 0;
+		// Start of the current frame's region and the next free byte in it
+		VkDeviceSize frameStart = 0;
+		VkDeviceSize head = 0;
+
+	public:
+		/** @brief Largest uniform block (and descriptor range) that can be allocated, must be set before setup */
+		VkDeviceSize maxBlockSize = 16384;
+		/** @brief Most bytes used by a single frame so far, e.g. for sizing the ring */
+		VkDeviceSize highWatermark = 0;
+
+		~UniformRing();
+		void setup(vks::VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount);
+		void destroy();
+		void beginFrame(uint32_t frameIndex);
+		uint32_t allocate(VkDeviceSize size, void** data);
+		/** @brief Copy a uniform block to the current frame's region and return the dynamic offset to bind it with */
+		template<typename T> uint32_t push(const T& block)
+		{
+			void* data;
+			const uint32_t offset = allocate(sizeof(T), &data);
+			memcpy(data, &block, sizeof(T));
+			return offset;
+		}
+		VkDescriptorBufferInfo getDescriptor(VkDeviceSize range) const;
+		bool isReady() const;
+	};
+}
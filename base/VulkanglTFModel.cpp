@@ -12,14 +12,42 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+#include "frustum.hpp"
+#include "threadpool.hpp"
+#include "VulkanAssetFile.h"
+#include "indexoptimizer.hpp"
+#include "meshsimplifier.hpp"
+#include "meshdecoder.hpp"
+#include "jobsystem.hpp"
+
+#include <atomic>
+#include <unordered_set>
+#include <cstdio>
+#include <thread>
+#include <sys/stat.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+uint32_t vkglTF::cacheFlags = 0;
+vkglTF::IndexStatistics vkglTF::loadedIndexStatistics;
+vks::MipGenerator* vkglTF::mipGenerator = nullptr;
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
+	Images aren't decoded while the file is parsed, their encoded data is stored in the vector passed as user data and decoded in parallel afterwards (see Model::decodeImages)
 */
 bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
@@ -30,7 +58,12 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	std::vector<std::vector<unsigned char>>* encodedImages = static_cast<std::vector<std::vector<unsigned char>>*>(userData);
+	if (encodedImages->size() <= static_cast<size_t>(imageIndex)) {
+		encodedImages->resize(imageIndex + 1);
+	}
+	(*encodedImages)[imageIndex].assign(bytes, bytes + size);
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -39,6 +72,190 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 	return true;
 }
 
+/*
+	Returns a pointer to the first element of a vertex attribute along with the distance between two of its elements
+	Buffer views may interleave several attributes, so the stride of the view has to be used instead of the element size
+	Sparse accessors and accessors without a buffer view are expanded into denseData, which then holds tightly packed elements
+*/
+const uint8_t* getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t& stride, std::vector<uint8_t>& denseData)
+{
+	if (accessor.bufferView > -1 && !accessor.sparse.isSparse) {
+		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+		const int byteStride = accessor.ByteStride(view);
+		stride = byteStride > 0 ? static_cast<size_t>(byteStride) : 0;
+		return &(model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]);
+	}
+
+	const size_t elementSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type));
+	stride = elementSize;
+	// Elements not replaced by the sparse values are taken from the buffer view, or are zero if there is none
+	denseData.assign(accessor.count * elementSize, 0);
+	if (accessor.bufferView > -1) {
+		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+		const int byteStride = accessor.ByteStride(view);
+		const size_t viewStride = byteStride > 0 ? static_cast<size_t>(byteStride) : elementSize;
+		const uint8_t* src = &(model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]);
+		for (size_t i = 0; i < accessor.count; i++) {
+			memcpy(&denseData[i * elementSize], src + i * viewStride, elementSize);
+		}
+	}
+	if (accessor.sparse.isSparse) {
+		const tinygltf::BufferView& indexView = model.bufferViews[accessor.sparse.indices.bufferView];
+		const uint8_t* indices = &(model.buffers[indexView.buffer].data[accessor.sparse.indices.byteOffset + indexView.byteOffset]);
+		const tinygltf::BufferView& valueView = model.bufferViews[accessor.sparse.values.bufferView];
+		const uint8_t* values = &(model.buffers[valueView.buffer].data[accessor.sparse.values.byteOffset + valueView.byteOffset]);
+		for (int i = 0; i < accessor.sparse.count; i++) {
+			size_t index;
+			switch (accessor.sparse.indices.componentType) {
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+				index = indices[i];
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				index = reinterpret_cast<const uint16_t*>(indices)[i];
+				break;
+			default:
+				index = reinterpret_cast<const uint32_t*>(indices)[i];
+				break;
+			}
+			if (index < accessor.count) {
+				memcpy(&denseData[index * elementSize], values + i * elementSize, elementSize);
+			}
+		}
+	}
+	return denseData.data();
+}
+
+/*
+	Converts a component of an accessor to float, integer components (e.g. of KHR_mesh_quantization attributes) are used as is or normalized as set by the accessor
+*/
+float componentToFloat(double value, int componentType, bool normalized)
+{
+	if (!normalized) {
+		return static_cast<float>(value);
+	}
+	switch (componentType) {
+	case TINYGLTF_COMPONENT_TYPE_BYTE:
+		return std::max(static_cast<float>(value) / 127.0f, -1.0f);
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		return static_cast<float>(value) / 255.0f;
+	case TINYGLTF_COMPONENT_TYPE_SHORT:
+		return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		return static_cast<float>(value) / 65535.0f;
+	default:
+		return static_cast<float>(value);
+	}
+}
+
+/*
+	Vertex attribute data of a primitive, read with the accessor's component type
+*/
+struct AttributeData {
+	const uint8_t* data = nullptr;
+	size_t stride = 0;
+	int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+	int type = TINYGLTF_TYPE_VEC4;
+	bool normalized = false;
+	// Storage for sparse accessors (see getAccessorData)
+	std::vector<uint8_t> denseData;
+
+	bool get(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+	{
+		componentType = accessor.componentType;
+		type = accessor.type;
+		normalized = accessor.normalized;
+		data = getAccessorData(model, accessor, stride, denseData);
+		return data != nullptr;
+	}
+
+	bool get(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* attribute)
+	{
+		auto it = primitive.attributes.find(attribute);
+		if (it == primitive.attributes.end()) {
+			data = nullptr;
+			return false;
+		}
+		return get(model, model.accessors[it->second]);
+	}
+
+	glm::vec4 read(size_t index, uint32_t componentCount) const
+	{
+		const uint8_t* element = data + index * stride;
+		glm::vec4 value(0.0f);
+		if (componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+			memcpy(&value[0], element, componentCount * sizeof(float));
+			return value;
+		}
+		for (uint32_t i = 0; i < componentCount; i++) {
+			double component;
+			switch (componentType) {
+			case TINYGLTF_COMPONENT_TYPE_BYTE: component = reinterpret_cast<const int8_t*>(element)[i]; break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: component = element[i]; break;
+			case TINYGLTF_COMPONENT_TYPE_SHORT: component = reinterpret_cast<const int16_t*>(element)[i]; break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: component = reinterpret_cast<const uint16_t*>(element)[i]; break;
+			default: component = reinterpret_cast<const uint32_t*>(element)[i]; break;
+			}
+			value[i] = componentToFloat(component, componentType, normalized);
+		}
+		return value;
+	}
+};
+
+/*
+	Counts the vertices and indices of all meshes referenced by a node and its children, so the vertex and index buffers can be allocated once up front
+*/
+void countNodeData(const tinygltf::Model& model, const tinygltf::Node& node, size_t& vertexCount, size_t& indexCount)
+{
+	for (auto child : node.children) {
+		countNodeData(model, model.nodes[child], vertexCount, indexCount);
+	}
+	if (node.mesh > -1) {
+		for (auto& primitive : model.meshes[node.mesh].primitives) {
+			if (primitive.indices < 0) {
+				continue;
+			}
+			auto position = primitive.attributes.find("POSITION");
+			if (position != primitive.attributes.end()) {
+				vertexCount += model.accessors[position->second].count;
+			}
+			indexCount += model.accessors[primitive.indices].count;
+		}
+	}
+}
+
+/*
+	Loads a glTF file from its asset file view, so the file isn't read into an intermediate buffer before tinyglTF parses it
+*/
+bool loadFromAssetFile(tinygltf::TinyGLTF& gltfContext, tinygltf::Model* model, std::string* error, std::string* warning, const std::string& filename, const std::string& baseDir, bool binary)
+{
+	vks::AssetFile file(filename);
+	if (!file.valid()) {
+		*error = "Could not open file";
+		return false;
+	}
+	if (binary) {
+		return gltfContext.LoadBinaryFromMemory(model, error, warning, file.data(), static_cast<unsigned int>(file.size()), baseDir);
+	}
+	return gltfContext.LoadASCIIFromString(model, error, warning, reinterpret_cast<const char*>(file.data()), static_cast<unsigned int>(file.size()), baseDir);
+}
+
+/*
+	File system callback for external buffers and images referenced by glTF files
+	tinyglTF needs the contents in a vector, so this still copies once, but from the file's view instead of through a stream
+*/
+bool readWholeAssetFile(std::vector<unsigned char>* out, std::string* error, const std::string& filepath, void* userData)
+{
+	vks::AssetFile file(filepath);
+	if (!file.valid()) {
+		if (error) {
+			*error += "File open error : " + filepath + "\n";
+		}
+		return false;
+	}
+	out->assign(file.data(), file.data() + file.size());
+	return true;
+}
+
 
 /*
 	glTF texture loading class
@@ -55,11 +272,171 @@ void vkglTF::Texture::destroy()
 {
 	if (device)
 	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		// Images shared through the device's resource cache are destroyed along with their last reference
+		if (!device->resourceCache.releaseImage(image)) {
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			device->memoryAllocator.free(allocation);
+		}
+		device->resourceCache.releaseSampler(sampler);
+	}
+}
+
+/*
+	Use the image another texture (e.g. of a different model) has already loaded for the key, returns false if there is none
+*/
+bool vkglTF::Texture::fromCache(const std::string& cacheKey, vks::VulkanDevice* device)
+{
+	vks::ResourceCache::Image cached;
+	if (!device->resourceCache.acquireImage(cacheKey, &cached)) {
+		return false;
+	}
+	this->device = device;
+	image = cached.image;
+	view = cached.view;
+	allocation = cached.allocation;
+	deviceMemory = allocation.memory;
+	imageLayout = cached.layout;
+	width = cached.width;
+	height = cached.height;
+	mipLevels = cached.mipLevels;
+	layerCount = 1;
+	sampler = device->resourceCache.acquireSampler(samplerCreateInfo());
+	updateDescriptor();
+	return true;
+}
+
+/*
+	Hand the image of a newly loaded texture over to the device's resource cache, so textures with the same key can share it
+*/
+void vkglTF::Texture::addToCache(const std::string& cacheKey)
+{
+	vks::ResourceCache::Image cached;
+	cached.image = image;
+	cached.view = view;
+	cached.allocation = allocation;
+	cached.layout = imageLayout;
+	cached.width = width;
+	cached.height = height;
+	cached.mipLevels = mipLevels;
+	device->resourceCache.addImage(cacheKey, cached);
+}
+
+/*
+	RGB to RGBA expansion
+	Uses SSSE3 byte shuffles (selected at runtime on x86) or NEON interleaved loads/stores, with a scalar loop for the remaining pixels
+*/
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VKGLTF_SSSE3_EXPAND 1
+#define VKGLTF_TARGET_SSSE3 __attribute__((target("ssse3")))
+bool cpuSupportsSSSE3()
+{
+	return __builtin_cpu_supports("ssse3");
+}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define VKGLTF_SSSE3_EXPAND 1
+#define VKGLTF_TARGET_SSSE3
+bool cpuSupportsSSSE3()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	return (cpuInfo[2] & (1 << 9)) != 0;
+}
+#endif
+
+#if defined(VKGLTF_SSSE3_EXPAND)
+VKGLTF_TARGET_SSSE3 size_t expandRGBToRGBASSSE3(const unsigned char* rgb, unsigned char* rgba, size_t pixelCount)
+{
+	// Moves four RGB pixels (12 bytes) into the RGB lanes of four RGBA pixels, alpha is or'ed in afterwards
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	// Each load reads 16 bytes for 12 bytes of pixels, so stop early enough to not read past the end of the source
+	for (; i + 6 <= pixelCount; i += 4) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+	}
+	return i;
+}
+#endif
+
+/*
+	Expands tightly packed RGB8 pixels to RGBA8 with an opaque alpha channel, large images are split across up to maxThreads threads (0 = hardware threads)
+*/
+void expandRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t pixelCount, uint32_t maxThreads = 0)
+{
+	auto expandRange = [](const unsigned char* src, unsigned char* dst, size_t count) {
+		size_t i = 0;
+#if defined(VKGLTF_SSSE3_EXPAND)
+		static const bool ssse3 = cpuSupportsSSSE3();
+		if (ssse3) {
+			i = expandRGBToRGBASSSE3(src, dst, count);
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		const uint8x16_t alpha = vdupq_n_u8(255);
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16x3_t pixels = vld3q_u8(src + i * 3);
+			uint8x16x4_t expanded;
+			expanded.val[0] = pixels.val[0];
+			expanded.val[1] = pixels.val[1];
+			expanded.val[2] = pixels.val[2];
+			expanded.val[3] = alpha;
+			vst4q_u8(dst + i * 4, expanded);
+		}
+#endif
+		for (; i < count; i++) {
+			dst[i * 4 + 0] = src[i * 3 + 0];
+			dst[i * 4 + 1] = src[i * 3 + 1];
+			dst[i * 4 + 2] = src[i * 3 + 2];
+			dst[i * 4 + 3] = 255;
+		}
+	};
+
+	// The conversion is bound by memory bandwidth, so only images of a few megapixels gain from more than one thread
+	const size_t pixelsPerThread = 1 << 20;
+	const uint32_t availableThreads = (maxThreads > 0) ? maxThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	const uint32_t threadCount = static_cast<uint32_t>(std::min<size_t>(availableThreads, (pixelCount + pixelsPerThread - 1) / pixelsPerThread));
+	if (threadCount <= 1) {
+		expandRange(rgb, rgba, pixelCount);
+		return;
+	}
+	const size_t chunkSize = (pixelCount + threadCount - 1) / threadCount;
+	std::vector<std::thread> threads;
+	for (uint32_t t = 1; t < threadCount; t++) {
+		const size_t first = t * chunkSize;
+		const size_t count = std::min(chunkSize, pixelCount - std::min(first, pixelCount));
+		threads.push_back(std::thread(expandRange, rgb + first * 3, rgba + first * 4, count));
+	}
+	// The calling thread converts the first chunk
+	expandRange(rgb, rgba, std::min(chunkSize, pixelCount));
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+/*
+	Returns true if the device can sample, upload to and blit (for mip generation) RGB8 images, so three component images can be uploaded without expanding them
+*/
+bool rgbFormatSupported(vks::VulkanDevice* device)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8_UNORM, &formatProperties);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+/*
+	Returns the pixels of a glTF image as RGBA, images with three components are converted into the storage passed in
+*/
+const unsigned char* getRGBAPixels(const tinygltf::Image& gltfimage, std::vector<unsigned char>& storage, uint32_t maxThreads = 0)
+{
+	if (gltfimage.component != 3) {
+		return gltfimage.image.data();
 	}
+	const size_t pixelCount = static_cast<size_t>(gltfimage.width) * gltfimage.height;
+	storage.resize(pixelCount * 4);
+	expandRGBToRGBA(gltfimage.image.data(), storage.data(), pixelCount, maxThreads);
+	return storage.data();
 }
 
 void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
@@ -74,328 +451,313 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 		}
 	}
 
-	VkFormat format;
-
 	if (!isKtx) {
 		// Texture was loaded using STB_Image
-
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
-		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+		// External images are shared by their path, embedded ones (buffer views and data uris) by a hash of their pixels
+		const bool external = !gltfimage.uri.empty() && (gltfimage.uri.compare(0, 5, "data:") != 0);
+		const std::string cacheKey = external ? "file:" + path + "/" + gltfimage.uri : "";
+		// Three component images are uploaded as is if the device supports RGB images, and expanded to RGBA otherwise
+		if ((gltfimage.component == 3) && rgbFormatSupported(device)) {
+			fromPixels(gltfimage.image.data(), gltfimage.width, gltfimage.height, 1, device, copyQueue, cacheKey, VK_FORMAT_R8G8B8_UNORM);
+			return;
 		}
+		std::vector<unsigned char> rgba;
+		const unsigned char* buffer = getRGBAPixels(gltfimage, rgba);
+		fromPixels(buffer, gltfimage.width, gltfimage.height, 1, device, copyQueue, cacheKey);
+		return;
+	}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+	// Texture is stored in an external ktx file
+	std::string filename = path + "/" + gltfimage.uri;
+	const std::string cacheKey = "file:" + filename;
+	if (fromCache(cacheKey, device)) {
+		return;
+	}
 
-		VkFormatProperties formatProperties;
+	ktxTexture* ktxTexture;
+
+	vks::AssetFile file(filename);
+	if (!file.valid()) {
+		vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+	}
+	ktxResult result = ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+	file.close();
+	assert(result == KTX_SUCCESS);
+
+	this->device = device;
+	width = ktxTexture->baseWidth;
+	height = ktxTexture->baseHeight;
+	mipLevels = ktxTexture->numLevels;
+
+	ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
+	ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+	// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
+	const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// Get device properties for the requested texture format
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+
+	VkCommandBuffer copyCmd = device->beginUpload();
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(ktxTextureSize);
+	memcpy(staging.data, ktxTextureData, ktxTextureSize);
+
+	std::vector<VkBufferImageCopy> bufferCopyRegions;
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		ktx_size_t offset;
+		KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+		assert(result == KTX_SUCCESS);
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = i;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
+		bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = staging.offset + offset;
+		bufferCopyRegions.push_back(bufferCopyRegion);
+	}
+
+	// Create optimal tiled target image
+	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+	VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+	device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, gltfimage.uri.empty() ? gltfimage.name : gltfimage.uri);
+	deviceMemory = allocation.memory;
+
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = mipLevels;
+	subresourceRange.layerCount = 1;
+
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+	device->endUpload(copyCmd, copyQueue);
+	this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	ktxTexture_Destroy(ktxTexture);
+
+	createSamplerAndView(format);
+	addToCache(cacheKey);
+}
+
+/*
+	Upload RGBA8 (or RGB8 if the device supports it, base level only) pixel data, level count may be less than the full mip chain in which case the remaining levels are generated by blitting
+	(or with a compute shader if vkglTF::mipGenerator is set and supports the format)
+	The levels passed in are tightly packed, starting with the base level
+	Images are shared through the device's resource cache, by the cache key if passed or else by a hash of the pixel data
+*/
+void vkglTF::Texture::fromPixels(const unsigned char* data, uint32_t width, uint32_t height, uint32_t levelCount, vks::VulkanDevice* device, VkQueue copyQueue, const std::string& cacheKey, VkFormat format)
+{
+	this->device = device;
+	this->width = width;
+	this->height = height;
+	mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	levelCount = std::min(std::max(levelCount, 1u), mipLevels);
+
+	assert((format == VK_FORMAT_R8G8B8A8_UNORM) || ((format == VK_FORMAT_R8G8B8_UNORM) && (levelCount == 1)));
+	const uint32_t texelSize = (format == VK_FORMAT_R8G8B8_UNORM) ? 3 : 4;
 
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	// The compute generator creates all levels from the base level, asynchronous uploads may be recorded for a queue without compute support
+	const bool computeMipGeneration = (levelCount == 1) && (mipLevels > 1) && mipGenerator && mipGenerator->supported(format) && !device->asyncUploadBatch.active;
 
+	if ((levelCount < mipLevels) && !computeMipGeneration) {
+		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+	}
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 1;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
+	std::vector<VkBufferImageCopy> bufferCopyRegions;
+	VkDeviceSize bufferSize = 0;
+	for (uint32_t i = 0; i < levelCount; i++) {
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
+		bufferCopyRegion.imageSubresource.mipLevel = i;
 		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
+		bufferCopyRegion.imageExtent.width = std::max(1u, width >> i);
+		bufferCopyRegion.imageExtent.height = std::max(1u, height >> i);
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = bufferSize;
+		bufferCopyRegions.push_back(bufferCopyRegion);
+		bufferSize += bufferCopyRegion.imageExtent.width * bufferCopyRegion.imageExtent.height * texelSize;
+	}
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	const std::string key = cacheKey.empty() ? "pixels:" + std::to_string(width) + "x" + std::to_string(height) + ":" + std::to_string(levelCount) + ":" + vks::ResourceCache::hashKey(data, static_cast<size_t>(bufferSize)) : cacheKey;
+	if (fromCache(key, device)) {
+		return;
+	}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+	// Copy offsets need to be a multiple of the texel size and of 4, RGB data is moved to a multiple of 12 as the staging ring only aligns to powers of two
+	const VkDeviceSize copyAlignment = (texelSize == 3) ? 12 : 4;
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(bufferSize + copyAlignment);
+	const VkDeviceSize stagingPadding = (copyAlignment - staging.offset % copyAlignment) % copyAlignment;
+	memcpy(static_cast<uint8_t*>(staging.data) + stagingPadding, data, bufferSize);
+	for (auto& bufferCopyRegion : bufferCopyRegions) {
+		bufferCopyRegion.bufferOffset += staging.offset + stagingPadding;
+	}
+
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (computeMipGeneration) {
+		imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		imageCreateInfo.flags = vks::MipGenerator::imageCreateFlags(format);
+	}
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+	VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &allocation));
+	device->memoryAllocator.tag(allocation, vks::MemoryCategory::Texture, cacheKey);
+	deviceMemory = allocation.memory;
 
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
+	VkCommandBuffer copyCmd = device->beginUpload();
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.levelCount = levelCount;
+	subresourceRange.layerCount = 1;
 
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
 
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
+	if (computeMipGeneration) {
+		// Generates all remaining levels with a single dispatch and transitions the whole image for sampling
+		mipGenerator->generate(copyCmd, image, format, width, height, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+		device->endUpload(copyCmd, copyQueue);
+		// Views and descriptors of the dispatch can only be released once the upload has finished, batched uploads release them in Model::loadFromFile
+		if (device->uploadBatch.depth == 0) {
+			mipGenerator->releaseResources();
+		}
+		createSamplerAndView(format);
+		addToCache(key);
+		return;
+	}
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+	// Generate the mip levels that haven't been passed in (glTF uses jpg and png, so we need to create this manually)
+	for (uint32_t i = levelCount; i < mipLevels; i++) {
+		VkImageBlit imageBlit{};
+
+		imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBlit.srcSubresource.layerCount = 1;
+		imageBlit.srcSubresource.mipLevel = i - 1;
+		imageBlit.srcOffsets[1].x = int32_t(std::max(1u, width >> (i - 1)));
+		imageBlit.srcOffsets[1].y = int32_t(std::max(1u, height >> (i - 1)));
+		imageBlit.srcOffsets[1].z = 1;
+
+		imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBlit.dstSubresource.layerCount = 1;
+		imageBlit.dstSubresource.mipLevel = i;
+		imageBlit.dstOffsets[1].x = int32_t(std::max(1u, width >> i));
+		imageBlit.dstOffsets[1].y = int32_t(std::max(1u, height >> i));
+		imageBlit.dstOffsets[1].z = 1;
+
+		VkImageSubresourceRange mipSubRange = {};
+		mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		mipSubRange.baseMipLevel = i;
+		mipSubRange.levelCount = 1;
+		mipSubRange.layerCount = 1;
 
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = 0;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = mipSubRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
 
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdBlitImage(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
 
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			imageMemoryBarrier.subresourceRange = mipSubRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
 	}
-	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
-
-		ktxTexture* ktxTexture;
-
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t* textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif		
-		assert(result == KTX_SUCCESS);
 
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
+	subresourceRange.levelCount = mipLevels;
 
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
 
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+	device->endUpload(copyCmd, copyQueue);
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t i = 0; i < mipLevels; i++)
-		{
-			ktx_size_t offset;
-			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-			assert(result == KTX_SUCCESS);
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = i;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
-			bufferCopyRegions.push_back(bufferCopyRegion);
-		}
-
-		// Create optimal tiled target image
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = mipLevels;
-		subresourceRange.layerCount = 1;
-
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
-		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		ktxTexture_Destroy(ktxTexture);
-	}
+	createSamplerAndView(format);
+	addToCache(key);
+}
 
+/*
+	Sampler create info of all model textures, samplers are shared by all textures with the same mip level count
+*/
+VkSamplerCreateInfo vkglTF::Texture::samplerCreateInfo() const
+{
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -411,7 +773,15 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	samplerInfo.maxLod = (float)mipLevels;
 	samplerInfo.maxAnisotropy = 8.0f;
 	samplerInfo.anisotropyEnable = VK_TRUE;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
+	return samplerInfo;
+}
+
+/*
+	Creates the sampler and view of an uploaded texture
+*/
+void vkglTF::Texture::createSamplerAndView(VkFormat format)
+{
+	sampler = device->resourceCache.acquireSampler(samplerCreateInfo());
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -432,14 +802,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 /*
 	glTF material
 */
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+void vkglTF::Material::createDescriptorSet(vks::DescriptorAllocator& descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
 {
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
+	descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 	std::vector<VkDescriptorImageInfo> imageDescriptors{};
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
 	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -482,25 +847,12 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 /*
 	glTF mesh
 */
+// The mesh's uniform block is placed in the model's transform buffer once all nodes are loaded (see Model::prepareTransforms)
 vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
 	this->device = device;
 	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
 };
 
-vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
-}
-
 /*
 	glTF node
 */
@@ -519,7 +871,7 @@ glm::mat4 vkglTF::Node::getMatrix() {
 }
 
 void vkglTF::Node::update() {
-	if (mesh) {
+	if (mesh && mesh->uniformBuffer.mapped) {
 		glm::mat4 m = getMatrix();
 		if (skin) {
 			mesh->uniformBlock.matrix = m;
@@ -559,6 +911,9 @@ vkglTF::Node::~Node() {
 VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
 std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
 VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
+VkVertexInputBindingDescription vkglTF::Vertex::positionInputBindingDescription;
+VkVertexInputAttributeDescription vkglTF::Vertex::positionInputAttributeDescription;
+VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::positionPipelineVertexInputStateCreateInfo;
 
 VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
 	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
@@ -607,8 +962,264 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
-vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
-{
+/*
+	Compact vertex layout
+*/
+
+namespace
+{
+	bool vertexFormatSupported(vks::VulkanDevice* device, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		return (formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+	}
+
+	uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		if (((bits >> 23) & 0xFF) == 0xFF) {
+			// Inf and NaN
+			return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+		}
+		if (exponent >= 0x1F) {
+			return static_cast<uint16_t>(sign | 0x7C00);
+		}
+		if (exponent <= 0) {
+			// Denormals
+			if (exponent < -10) {
+				return static_cast<uint16_t>(sign);
+			}
+			mantissa |= 0x800000;
+			const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			if ((mantissa >> (shift - 1)) & 1) {
+				half++;
+			}
+			return static_cast<uint16_t>(sign | half);
+		}
+		uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		// Round to nearest, a carry into the exponent is still correct
+		if (mantissa & 0x1000) {
+			half++;
+		}
+		return static_cast<uint16_t>(half);
+	}
+
+	int32_t quantizeSnorm(float value, float scale)
+	{
+		return static_cast<int32_t>(roundf(std::max(-1.0f, std::min(1.0f, value)) * scale));
+	}
+
+	uint32_t packSnorm10x3(const glm::vec4& value)
+	{
+		return (static_cast<uint32_t>(quantizeSnorm(value.x, 511.0f)) & 0x3FF) |
+			((static_cast<uint32_t>(quantizeSnorm(value.y, 511.0f)) & 0x3FF) << 10) |
+			((static_cast<uint32_t>(quantizeSnorm(value.z, 511.0f)) & 0x3FF) << 20) |
+			((static_cast<uint32_t>(quantizeSnorm(value.w, 1.0f)) & 0x3) << 30);
+	}
+
+	uint32_t formatSize(VkFormat format)
+	{
+		switch (format) {
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 16;
+			case VK_FORMAT_R32G32B32_SFLOAT:
+				return 12;
+			case VK_FORMAT_R16G16B16A16_SNORM:
+			case VK_FORMAT_R16G16B16A16_USCALED:
+				return 8;
+			default:
+				return 4;
+		}
+	}
+
+	void packVector(uint8_t* dst, VkFormat format, const glm::vec4& value)
+	{
+		switch (format) {
+			case VK_FORMAT_R32G32B32_SFLOAT:
+				memcpy(dst, &value, 3 * sizeof(float));
+				break;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				memcpy(dst, &value, 4 * sizeof(float));
+				break;
+			case VK_FORMAT_A2B10G10R10_SNORM_PACK32: {
+				const uint32_t packed = packSnorm10x3(value);
+				memcpy(dst, &packed, sizeof(packed));
+				break;
+			}
+			case VK_FORMAT_R16G16B16A16_SNORM:
+				for (uint32_t i = 0; i < 4; i++) {
+					const int16_t packed = static_cast<int16_t>(quantizeSnorm(value[i], 32767.0f));
+					memcpy(dst + i * sizeof(int16_t), &packed, sizeof(packed));
+				}
+				break;
+			case VK_FORMAT_R16G16_SFLOAT:
+				for (uint32_t i = 0; i < 2; i++) {
+					const uint16_t packed = floatToHalf(value[i]);
+					memcpy(dst + i * sizeof(uint16_t), &packed, sizeof(packed));
+				}
+				break;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				for (uint32_t i = 0; i < 4; i++) {
+					dst[i] = static_cast<uint8_t>(roundf(std::max(0.0f, std::min(1.0f, value[i])) * 255.0f));
+				}
+				break;
+			case VK_FORMAT_R8G8B8A8_USCALED:
+				for (uint32_t i = 0; i < 4; i++) {
+					dst[i] = static_cast<uint8_t>(value[i]);
+				}
+				break;
+			case VK_FORMAT_R16G16B16A16_USCALED:
+				for (uint32_t i = 0; i < 4; i++) {
+					const uint16_t packed = static_cast<uint16_t>(value[i]);
+					memcpy(dst + i * sizeof(uint16_t), &packed, sizeof(packed));
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/** @brief Select the formats and offsets of the compact vertex layout for the components in compactVertexComponents */
+void vkglTF::Model::setupCompactVertexLayout(const std::vector<Vertex>& vertexBuffer)
+{
+	vertexLayout = {};
+	vertexLayout.compact = true;
+	// Normals and tangents use 10:10:10:2 if supported as a vertex format, its w component covers the tangent's handedness
+	const VkFormat directionFormat = vertexFormatSupported(device, VK_FORMAT_A2B10G10R10_SNORM_PACK32) ? VK_FORMAT_A2B10G10R10_SNORM_PACK32 : VK_FORMAT_R16G16B16A16_SNORM;
+	uint32_t offset = 0;
+	for (VertexComponent component : compactVertexComponents) {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		switch (component) {
+			case VertexComponent::Position:
+				format = VK_FORMAT_R32G32B32_SFLOAT;
+				break;
+			case VertexComponent::Normal:
+			case VertexComponent::Tangent:
+				format = directionFormat;
+				break;
+			case VertexComponent::UV:
+				format = VK_FORMAT_R16G16_SFLOAT;
+				break;
+			case VertexComponent::Color:
+			case VertexComponent::Weight0:
+				format = VK_FORMAT_R8G8B8A8_UNORM;
+				break;
+			case VertexComponent::Joint0: {
+				// Joint indices are read as floats by the shaders, so they need a scaled format
+				float maxJoint = 0.0f;
+				for (const Vertex& vertex : vertexBuffer) {
+					maxJoint = std::max(maxJoint, std::max(std::max(vertex.joint0.x, vertex.joint0.y), std::max(vertex.joint0.z, vertex.joint0.w)));
+				}
+				if ((maxJoint < 256.0f) && vertexFormatSupported(device, VK_FORMAT_R8G8B8A8_USCALED)) {
+					format = VK_FORMAT_R8G8B8A8_USCALED;
+				} else if ((maxJoint < 65536.0f) && vertexFormatSupported(device, VK_FORMAT_R16G16B16A16_USCALED)) {
+					format = VK_FORMAT_R16G16B16A16_USCALED;
+				} else {
+					format = VK_FORMAT_R32G32B32A32_SFLOAT;
+				}
+				break;
+			}
+		}
+		const uint32_t index = static_cast<uint32_t>(component);
+		if (vertexLayout.formats[index] != VK_FORMAT_UNDEFINED) {
+			continue;
+		}
+		vertexLayout.formats[index] = format;
+		vertexLayout.offsets[index] = offset;
+		offset += formatSize(format);
+	}
+	vertexLayout.stride = offset;
+}
+
+/** @brief Convert vertices to the compact vertex layout */
+void vkglTF::Model::packVertices(const std::vector<Vertex>& vertexBuffer, std::vector<uint8_t>& packedVertices)
+{
+	packedVertices.resize(vertexBuffer.size() * vertexLayout.stride);
+	for (size_t i = 0; i < vertexBuffer.size(); i++) {
+		const Vertex& vertex = vertexBuffer[i];
+		uint8_t* dst = &packedVertices[i * vertexLayout.stride];
+		const glm::vec4 values[7] = {
+			glm::vec4(vertex.pos, 1.0f),
+			glm::vec4(vertex.normal, 0.0f),
+			glm::vec4(vertex.uv, 0.0f, 0.0f),
+			vertex.color,
+			vertex.tangent,
+			vertex.joint0,
+			vertex.weight0
+		};
+		for (uint32_t component = 0; component < 7; component++) {
+			if (vertexLayout.formats[component] != VK_FORMAT_UNDEFINED) {
+				packVector(dst + vertexLayout.offsets[component], vertexLayout.formats[component], values[component]);
+			}
+		}
+		// Quantized weights need to add up to one again
+		const uint32_t weightIndex = static_cast<uint32_t>(VertexComponent::Weight0);
+		if (vertexLayout.formats[weightIndex] == VK_FORMAT_R8G8B8A8_UNORM) {
+			uint8_t* weights = dst + vertexLayout.offsets[weightIndex];
+			const int32_t sum = weights[0] + weights[1] + weights[2] + weights[3];
+			if (sum > 0) {
+				uint32_t largest = 0;
+				for (uint32_t j = 1; j < 4; j++) {
+					if (weights[j] > weights[largest]) {
+						largest = j;
+					}
+				}
+				weights[largest] = static_cast<uint8_t>(std::max(0, std::min(255, weights[largest] + 255 - sum)));
+			}
+		}
+	}
+}
+
+/**
+* Returns the pipeline vertex input state create info structure for the requested vertex components matching the model's vertex layout
+*
+* @note All requested components have to be part of compactVertexComponents if the model uses the compact vertex layout
+*/
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getPipelineVertexInputState(const std::vector<VertexComponent> components)
+{
+	if (!vertexLayout.compact) {
+		return Vertex::getPipelineVertexInputState(components);
+	}
+	vertexInputBindingDescription = { 0, vertexLayout.stride, VK_VERTEX_INPUT_RATE_VERTEX };
+	vertexInputAttributeDescriptions.clear();
+	uint32_t location = 0;
+	for (VertexComponent component : components) {
+		const uint32_t index = static_cast<uint32_t>(component);
+		assert(vertexLayout.formats[index] != VK_FORMAT_UNDEFINED);
+		vertexInputAttributeDescriptions.push_back({ location, 0, vertexLayout.formats[index], vertexLayout.offsets[index] });
+		location++;
+	}
+	pipelineVertexInputStateCreateInfo = {};
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexInputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
+/** @brief Returns the pipeline vertex input state create info structure for the position only vertex buffer (location 0) */
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPositionVertexInputState() {
+	positionInputBindingDescription = { 0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX };
+	positionInputAttributeDescription = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+	positionPipelineVertexInputStateCreateInfo = {};
+	positionPipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	positionPipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	positionPipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &positionInputBindingDescription;
+	positionPipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = 1;
+	positionPipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = &positionInputAttributeDescription;
+	return &positionPipelineVertexInputStateCreateInfo;
+}
+
+vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
+{
 
 	if (index < textures.size()) {
 		return &textures[index];
@@ -628,28 +1239,9 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	unsigned char* buffer = new unsigned char[bufferSize];
 	memset(buffer, 0, bufferSize);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	// Copy texture data into staging memory
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(bufferSize);
+	memcpy(staging.data, buffer, bufferSize);
 
 	VkBufferImageCopy bufferCopyRegion = {};
 	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -657,6 +1249,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	bufferCopyRegion.imageExtent.width = emptyTexture.width;
 	bufferCopyRegion.imageExtent.height = emptyTexture.height;
 	bufferCopyRegion.imageExtent.depth = 1;
+	bufferCopyRegion.bufferOffset = staging.offset;
 
 	// Create optimal tiled target image
 	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -672,11 +1265,9 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->memoryAllocator.allocateImageMemory(emptyTexture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &emptyTexture.allocation));
+	device->memoryAllocator.tag(emptyTexture.allocation, vks::MemoryCategory::Texture, "glTF empty texture");
+	emptyTexture.deviceMemory = emptyTexture.allocation.memory;
 
 	VkImageSubresourceRange subresourceRange{};
 	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -684,17 +1275,13 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	subresourceRange.levelCount = 1;
 	subresourceRange.layerCount = 1;
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	VkCommandBuffer copyCmd = device->beginUpload();
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vkCmdCopyBufferToImage(copyCmd, staging.buffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
+	device->endUpload(copyCmd, transferQueue);
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
 	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
 	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
@@ -704,7 +1291,7 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 	samplerCreateInfo.maxAnisotropy = 1.0f;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &emptyTexture.sampler));
+	emptyTexture.sampler = device->resourceCache.acquireSampler(samplerCreateInfo);
 
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -725,26 +1312,71 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 */
 vkglTF::Model::~Model()
 {
+	device->memoryAllocator.report.untrack(vertices.memory);
+	device->memoryAllocator.report.untrack(indices.memory);
+	device->memoryAllocator.report.untrack(positions.memory);
 	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	if (positions.buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device->logicalDevice, positions.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, positions.memory, nullptr);
+	}
 	for (auto texture : textures) {
 		texture.destroy();
 	}
 	for (auto node : nodes) {
 		delete node;
 	}
-	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
-		descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	// The layouts are owned by the device's layout cache, so models loaded later (with other binding flags) only pick up different ones
+	descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	descriptorSetLayoutImage = VK_NULL_HANDLE;
+	descriptorAllocator.destroy();
+	emptyTexture.destroy();
+	transforms.buffer.destroy();
+	if (gpuCulling.pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, gpuCulling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, gpuCulling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, gpuCulling.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, gpuCulling.descriptorPool, nullptr);
+		gpuCulling.uniformBuffer.destroy();
+		gpuCulling.boundsBuffer.destroy();
+		gpuCulling.lodRangeBuffer.destroy();
+		gpuCulling.lodBuffer.destroy();
 	}
-	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
-		descriptorSetLayoutImage = VK_NULL_HANDLE;
+	if (indirectDraws.drawCount > 0) {
+		indirectDraws.commandBuffer.destroy();
+		indirectDraws.drawDataBuffer.destroy();
+		indirectDraws.materialBuffer.destroy();
+		indirectDraws.nodeMatrixBuffer.destroy();
+		vkDestroyDescriptorSetLayout(device->logicalDevice, indirectDraws.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, indirectDraws.descriptorPool, nullptr);
+	}
+	if (meshlets.count > 0) {
+		meshlets.meshletBuffer.destroy();
+		meshlets.vertexIndexBuffer.destroy();
+		meshlets.triangleBuffer.destroy();
+	}
+	if (bindlessMaterials.descriptorSetLayout != VK_NULL_HANDLE) {
+		bindlessMaterials.materialBuffer.destroy();
+		vkDestroyDescriptorSetLayout(device->logicalDevice, bindlessMaterials.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, bindlessMaterials.descriptorPool, nullptr);
+	}
+	// The vertex pulling set layout is owned by the device's layout cache and the set by the descriptor allocator
+	vertexPulling.layoutBuffer.destroy();
+	if (computeSkinning.pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, computeSkinning.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, computeSkinning.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, computeSkinning.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, computeSkinning.descriptorPool, nullptr);
+		vkDestroyBuffer(device->logicalDevice, computeSkinning.vertexBuffer, nullptr);
+		device->memoryAllocator.free(computeSkinning.vertexAllocation);
+		vkDestroyBuffer(device->logicalDevice, computeSkinning.jointBuffer, nullptr);
+		device->memoryAllocator.free(computeSkinning.jointAllocation);
+		morphTargets.deltaBuffer.destroy();
+		morphTargets.weightBuffer.destroy();
 	}
-	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
-	emptyTexture.destroy();
 }
 
 void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
@@ -791,6 +1423,27 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 		const tinygltf::Mesh mesh = model.meshes[node.mesh];
 		Mesh *newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
+		// Nodes referencing a mesh that has already been loaded share its primitives instead of loading another copy of the geometry
+		// Skinned and morphed meshes deform their vertices per node, so they always get their own copy
+		bool shareable = shareMeshes && (node.skin < 0);
+		for (const tinygltf::Primitive& primitive : mesh.primitives) {
+			shareable &= primitive.targets.empty();
+		}
+		auto sharedMesh = sharedMeshes.find(node.mesh);
+		if (shareable && (sharedMesh != sharedMeshes.end())) {
+			newMesh->primitives = sharedMesh->second->primitives;
+			newNode->mesh = newMesh;
+			if (parent) {
+				parent->children.push_back(newNode);
+			} else {
+				nodes.push_back(newNode);
+			}
+			linearNodes.push_back(newNode);
+			return;
+		}
+		if (shareable) {
+			sharedMeshes[node.mesh] = newMesh;
+		}
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive &primitive = mesh.primitives[j];
 			if (primitive.indices < 0) {
@@ -805,126 +1458,90 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			bool hasSkin = false;
 			// Vertices
 			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
 				// Position attribute is required
 				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
 				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+				AttributeData positions, normals, texCoords, colors, tangents, joints, weights;
+				positions.get(model, posAccessor);
+				// Bounds of quantized positions are given in the accessor's component type
+				for (uint32_t i = 0; i < 3; i++) {
+					posMin[i] = componentToFloat(posAccessor.minValues[i], posAccessor.componentType, posAccessor.normalized);
+					posMax[i] = componentToFloat(posAccessor.maxValues[i], posAccessor.componentType, posAccessor.normalized);
 				}
 
+				normals.get(model, primitive, "NORMAL");
+				texCoords.get(model, primitive, "TEXCOORD_0");
+				// Color buffers are either of type vec3 or vec4
+				colors.get(model, primitive, "COLOR_0");
+				tangents.get(model, primitive, "TANGENT");
 				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
-
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+				joints.get(model, primitive, "JOINTS_0");
+				weights.get(model, primitive, "WEIGHTS_0");
 
-				hasSkin = (bufferJoints && bufferWeights);
+				hasSkin = (joints.data && weights.data);
 
 				vertexCount = static_cast<uint32_t>(posAccessor.count);
 
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
+				// Vertices are written in place instead of being pushed one by one, attributes are read at the stride of their buffer views
+				vertexBuffer.resize(vertexStart + posAccessor.count);
+				Vertex *vert = &vertexBuffer[vertexStart];
+				for (size_t v = 0; v < posAccessor.count; v++, vert++) {
+					vert->pos = glm::vec3(positions.read(v, 3));
+					vert->normal = normals.data ? glm::normalize(glm::vec3(normals.read(v, 3))) : glm::vec3(0.0f);
+					vert->uv = texCoords.data ? glm::vec2(texCoords.read(v, 2)) : glm::vec2(0.0f);
+					if (colors.data) {
+						vert->color = (colors.type == TINYGLTF_TYPE_VEC3) ? glm::vec4(glm::vec3(colors.read(v, 3)), 1.0f) : colors.read(v, 4);
+					} else {
+						vert->color = glm::vec4(1.0f);
 					}
-					else {
-						vert.color = glm::vec4(1.0f);
+					vert->tangent = tangents.data ? tangents.read(v, 4) : glm::vec4(0.0f);
+					if (hasSkin) {
+						vert->joint0 = joints.read(v, 4);
+						vert->weight0 = weights.read(v, 4);
+					} else {
+						vert->joint0 = glm::vec4(0.0f);
+						vert->weight0 = glm::vec4(0.0f);
 					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
 				}
 			}
 			// Indices
 			{
 				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+				size_t indexStride;
+				std::vector<uint8_t> denseData;
+				const uint8_t *indexData = getAccessorData(model, accessor, indexStride, denseData);
 
 				indexCount = static_cast<uint32_t>(accessor.count);
 
+				// Indices are copied straight from the buffer view, only rebasing them to the primitive's first vertex
+				indexBuffer.resize(indexStart + accessor.count);
+				uint32_t *dst = &indexBuffer[indexStart];
 				switch (accessor.componentType) {
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
+					memcpy(dst, indexData, accessor.count * sizeof(uint32_t));
+					if (vertexStart > 0) {
+						for (size_t index = 0; index < accessor.count; index++) {
+							dst[index] += vertexStart;
+						}
 					}
 					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
+					const uint16_t *buf = reinterpret_cast<const uint16_t*>(indexData);
 					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
+						dst[index] = buf[index] + vertexStart;
 					}
 					break;
 				}
 				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
 					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
+						dst[index] = indexData[index] + vertexStart;
 					}
 					break;
 				}
 				default:
+					indexBuffer.resize(indexStart);
 					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
 					return;
 				}
@@ -933,8 +1550,51 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			newPrimitive->firstVertex = vertexStart;
 			newPrimitive->vertexCount = vertexCount;
 			newPrimitive->setDimensions(posMin, posMax);
+			// Morph targets, position, normal and tangent deltas of all targets are stored behind each other (see MorphTargets)
+			if (!primitive.targets.empty()) {
+				newPrimitive->firstMorphDelta = static_cast<uint32_t>(morphTargets.deltas.size());
+				newPrimitive->morphTargetCount = static_cast<uint32_t>(primitive.targets.size());
+				const MorphTargets::Delta zeroDelta = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+				morphTargets.deltas.resize(morphTargets.deltas.size() + primitive.targets.size() * vertexCount, zeroDelta);
+				const char* targetAttributes[3] = { "POSITION", "NORMAL", "TANGENT" };
+				for (size_t t = 0; t < primitive.targets.size(); t++) {
+					MorphTargets::Delta *delta = &morphTargets.deltas[newPrimitive->firstMorphDelta + t * vertexCount];
+					for (uint32_t a = 0; a < 3; a++) {
+						auto it = primitive.targets[t].find(targetAttributes[a]);
+						if (it == primitive.targets[t].end()) {
+							continue;
+						}
+						const tinygltf::Accessor &accessor = model.accessors[it->second];
+						AttributeData deltas;
+						deltas.get(model, accessor);
+						const size_t count = std::min(accessor.count, static_cast<size_t>(vertexCount));
+						for (size_t v = 0; v < count; v++) {
+							const glm::vec4 value = deltas.read(v, 3);
+							switch (a) {
+							case 0: delta[v].position = value; break;
+							case 1: delta[v].normal = value; break;
+							case 2: delta[v].tangent = value; break;
+							}
+						}
+					}
+				}
+			}
 			newMesh->primitives.push_back(newPrimitive);
 		}
+		// Morph target weights default to the node's weights, then to the mesh's
+		uint32_t morphTargetCount = 0;
+		for (auto primitive : newMesh->primitives) {
+			morphTargetCount = std::max(morphTargetCount, primitive->morphTargetCount);
+		}
+		if (morphTargetCount > 0) {
+			const std::vector<double> &defaultWeights = node.weights.empty() ? mesh.weights : node.weights;
+			newMesh->morphWeights.assign(morphTargetCount, 0.0f);
+			for (size_t i = 0; i < std::min(defaultWeights.size(), newMesh->morphWeights.size()); i++) {
+				newMesh->morphWeights[i] = static_cast<float>(defaultWeights[i]);
+			}
+			newMesh->morphWeightOffset = morphTargets.weightCount;
+			morphTargets.weightCount += morphTargetCount;
+		}
 		newNode->mesh = newMesh;
 	}
 	if (parent) {
@@ -977,9 +1637,182 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 	}
 }
 
+/*
+	Decodes the images whose encoded data has been stored by the image loading function while parsing the file
+	Images are decoded (and converted to RGBA if required) on a thread pool, the GPU uploads are then recorded by loadImages into the model's upload batch
+*/
+void vkglTF::Model::decodeImages(tinygltf::Model &gltfModel, std::vector<std::vector<unsigned char>> &encodedImages)
+{
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < std::min(encodedImages.size(), gltfModel.images.size()); i++) {
+		if (!encodedImages[i].empty()) {
+			pending.push_back(i);
+		}
+	}
+	if (pending.empty()) {
+		return;
+	}
+
+	// Three component images are only expanded to RGBA if the device can't use them as is
+	const bool expandRGB = !rgbFormatSupported(device);
+	std::vector<std::string> errors(gltfModel.images.size());
+	auto decodeImage = [&](size_t index) {
+		tinygltf::Image& image = gltfModel.images[index];
+		std::string warning;
+		if (tinygltf::LoadImageData(&image, static_cast<int>(index), &errors[index], &warning, 0, 0, encodedImages[index].data(), static_cast<int>(encodedImages[index].size()), nullptr)) {
+			if ((image.component == 3) && expandRGB) {
+				// Images decoded in parallel are expanded on their decoding thread only
+				std::vector<unsigned char> rgba;
+				getRGBAPixels(image, rgba, (pending.size() > 1) ? 1 : 0);
+				image.image.swap(rgba);
+				image.component = 4;
+			}
+		} else if (errors[index].empty()) {
+			errors[index] = "Could not decode image " + std::to_string(index);
+		}
+		// Release the encoded data as soon as it's no longer needed
+		std::vector<unsigned char>().swap(encodedImages[index]);
+	};
+
+	const uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(pending.size()));
+	if (threadCount > 1) {
+		// Each worker picks the next image from a shared counter, so large images don't hold up a single thread's queue
+		std::atomic<size_t> next(0);
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (auto& thread : threadPool.threads) {
+			thread->addJob([&] {
+				size_t i;
+				while ((i = next++) < pending.size()) {
+					decodeImage(pending[i]);
+				}
+			});
+		}
+		threadPool.wait();
+	} else {
+		for (size_t index : pending) {
+			decodeImage(index);
+		}
+	}
+
+	for (size_t index : pending) {
+		if (!errors[index].empty()) {
+			vks::tools::exitFatal("Could not load image \"" + gltfModel.images[index].uri + "\": " + errors[index], -1);
+		}
+	}
+}
+
+/*
+	Decodes the buffer views compressed with EXT_meshopt_compression
+	Views are decoded on a thread pool into buffers of their own, so accessors read them like uncompressed views
+*/
+void vkglTF::Model::decodeCompressedBufferViews(tinygltf::Model &gltfModel)
+{
+	struct CompressedView {
+		size_t index;
+		const uint8_t* data;
+		size_t size;
+		size_t count;
+		size_t stride;
+		std::string mode;
+		vks::meshdecoder::Filter filter;
+		std::vector<unsigned char> decoded;
+		bool valid;
+	};
+	std::vector<CompressedView> pending;
+	auto number = [](const tinygltf::Value& value, const char* key) {
+		return value.Has(key) ? static_cast<size_t>(value.Get(key).GetNumberAsDouble()) : 0;
+	};
+	auto string = [](const tinygltf::Value& value, const char* key) {
+		return (value.Has(key) && value.Get(key).IsString()) ? value.Get(key).Get<std::string>() : std::string();
+	};
+	for (size_t i = 0; i < gltfModel.bufferViews.size(); i++) {
+		auto it = gltfModel.bufferViews[i].extensions.find("EXT_meshopt_compression");
+		if (it == gltfModel.bufferViews[i].extensions.end()) {
+			continue;
+		}
+		const tinygltf::Value& extension = it->second;
+		CompressedView view{};
+		view.index = i;
+		view.count = number(extension, "count");
+		view.stride = number(extension, "byteStride");
+		view.mode = string(extension, "mode");
+		const std::string filter = string(extension, "filter");
+		view.filter = vks::meshdecoder::Filter::None;
+		if (filter == "OCTAHEDRAL") {
+			view.filter = vks::meshdecoder::Filter::Octahedral;
+		} else if (filter == "QUATERNION") {
+			view.filter = vks::meshdecoder::Filter::Quaternion;
+		} else if (filter == "EXPONENTIAL") {
+			view.filter = vks::meshdecoder::Filter::Exponential;
+		}
+		const size_t buffer = number(extension, "buffer");
+		const size_t offset = number(extension, "byteOffset");
+		view.size = number(extension, "byteLength");
+		if ((buffer >= gltfModel.buffers.size()) || (offset + view.size > gltfModel.buffers[buffer].data.size())) {
+			vks::tools::exitFatal("Invalid compressed buffer view " + std::to_string(i), -1);
+		}
+		view.data = gltfModel.buffers[buffer].data.data() + offset;
+		pending.push_back(std::move(view));
+	}
+	if (pending.empty()) {
+		return;
+	}
+
+	auto decodeView = [&](CompressedView& view) {
+		view.decoded.resize(view.count * view.stride);
+		if (view.mode == "ATTRIBUTES") {
+			view.valid = vks::meshdecoder::decodeVertexBuffer(view.decoded.data(), view.count, view.stride, view.data, view.size) &&
+				vks::meshdecoder::applyFilter(view.decoded.data(), view.count, view.stride, view.filter);
+		} else if (view.mode == "TRIANGLES") {
+			view.valid = vks::meshdecoder::decodeIndexBuffer(view.decoded.data(), view.count, view.stride, view.data, view.size);
+		} else if (view.mode == "INDICES") {
+			view.valid = vks::meshdecoder::decodeIndexSequence(view.decoded.data(), view.count, view.stride, view.data, view.size);
+		}
+	};
+
+	const uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(pending.size()));
+	if (threadCount > 1) {
+		std::atomic<size_t> next(0);
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (auto& thread : threadPool.threads) {
+			thread->addJob([&] {
+				size_t i;
+				while ((i = next++) < pending.size()) {
+					decodeView(pending[i]);
+				}
+			});
+		}
+		threadPool.wait();
+	} else {
+		for (auto& view : pending) {
+			decodeView(view);
+		}
+	}
+
+	// The fallback buffers the views pointed to are left empty (if they were loaded at all), they aren't referenced anymore
+	for (auto& view : pending) {
+		if (!view.valid) {
+			vks::tools::exitFatal("Could not decode compressed buffer view " + std::to_string(view.index), -1);
+		}
+		tinygltf::BufferView& bufferView = gltfModel.bufferViews[view.index];
+		bufferView.buffer = static_cast<int>(gltfModel.buffers.size());
+		bufferView.byteOffset = 0;
+		bufferView.byteLength = view.decoded.size();
+		tinygltf::Buffer buffer;
+		buffer.data.swap(view.decoded);
+		gltfModel.buffers.push_back(std::move(buffer));
+	}
+}
+
 void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
 {
 	for (tinygltf::Image &image : gltfModel.images) {
+		// The alpha channel has to be taken before uploading, as it's not kept on the host afterwards (external KTX images aren't decoded here and stay unclassified)
+		if (keepAlphaMasks && !image.image.empty() && (image.bits == 8)) {
+			keepAlphaMask(textures.size(), image.image.data(), image.width, image.height, image.component);
+		}
 		vkglTF::Texture texture;
 		texture.fromglTfImage(image, path, device, transferQueue);
 		textures.push_back(texture);
@@ -1085,28 +1918,32 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 				}
 			}
 
-			// Read sampler output T/R/S values 
+			// Read sampler output T/R/S values, outputs may be quantized to normalized integers (KHR_mesh_quantization)
 			{
 				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+				AttributeData outputs;
+				outputs.get(gltfModel, accessor);
 
 				switch (accessor.type) {
 				case TINYGLTF_TYPE_VEC3: {
-					glm::vec3 *buf = new glm::vec3[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
+					sampler.outputsVec4.resize(accessor.count);
 					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
+						sampler.outputsVec4[index] = outputs.read(index, 3);
 					}
 					break;
 				}
 				case TINYGLTF_TYPE_VEC4: {
-					glm::vec4 *buf = new glm::vec4[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
+					sampler.outputsVec4.resize(accessor.count);
 					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(buf[index]);
+						sampler.outputsVec4[index] = outputs.read(index, 4);
+					}
+					break;
+				}
+				// Morph target weights
+				case TINYGLTF_TYPE_SCALAR: {
+					sampler.outputsFloat.resize(accessor.count);
+					for (size_t index = 0; index < accessor.count; index++) {
+						sampler.outputsFloat[index] = outputs.read(index, 1).x;
 					}
 					break;
 				}
@@ -1134,8 +1971,7 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 				channel.path = AnimationChannel::PathType::SCALE;
 			}
 			if (source.target_path == "weights") {
-				std::cout << "weights not yet supported, skipping channel" << std::endl;
-				continue;
+				channel.path = AnimationChannel::PathType::WEIGHTS;
 			}
 			channel.samplerIndex = source.sampler;
 			channel.node = nodeFromIndex(source.target_node);
@@ -1150,203 +1986,926 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
-{
-	tinygltf::Model gltfModel;
-	tinygltf::TinyGLTF gltfContext;
-	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
-		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
-	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
-	}
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	size_t pos = filename.find_last_of('/');
-	path = filename.substr(0, pos);
+/*
+	Scene cache
 
-	std::string error, warning;
+	Stores the processed result of loading a glTF file in a binary blob next to it, so it can be loaded back with a single read
+	Values are stored in native byte order, the cache is only meant to be read on the machine that wrote it
+*/
 
-	this->device = device;
+namespace
+{
+	const char sceneCacheMagic[8] = { 'V', 'K', 'G', 'L', 'T', 'F', 'C', '\0' };
+	// Increase whenever the layout of the cache or of any of the stored structures changes
+	const uint32_t sceneCacheVersion = 4;
+
+	enum SceneCacheContents {
+		SceneCacheImages = 0x00000001,
+		SceneCacheMipmaps = 0x00000002,
+		// Index buffers are always optimized for the vertex cache (FileLoadingFlags::OptimizeIndices), this marks the overdraw optimization
+		SceneCacheOptimizedOverdraw = 0x00000004,
+		// Primitives have generated levels of detail (FileLoadingFlags::GenerateLods), created with the settings stored in the header
+		SceneCacheLods = 0x00000008,
+		// Nodes referencing the same mesh share its primitives, which is only done if vertices aren't pre-transformed per node
+		SceneCacheSharedMeshes = 0x00000010
+	};
 
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+	enum SceneCacheTextureType {
+		SceneCacheTexturePixels = 0,
+		SceneCacheTextureKtx = 1
+	};
 
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
+	// Texture references of materials, either an index into the model's textures or one of these
+	const int32_t sceneCacheNoTexture = -1;
+	const int32_t sceneCacheEmptyTexture = -2;
+
+	struct SceneCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t contents;
+		uint32_t vertexSize;
+		// Level of detail generation settings (see Model::lodGeneration), only set if the cache contains levels of detail
+		uint32_t lodLevelCount;
+		float lodReduction;
+		uint32_t reserved;
+		// Size and modification time of the glTF file the cache was created from
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		// Size of the data following the header
+		uint64_t payloadSize;
+	};
 
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
+	bool getSourceFileInfo(const std::string& filename, uint64_t& size, int64_t& time)
+	{
+		struct stat fileStat;
+		if (stat(filename.c_str(), &fileStat) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(fileStat.st_size);
+		time = static_cast<int64_t>(fileStat.st_mtime);
+		return true;
+	}
+
+	class SceneCacheWriter {
+	public:
+		std::vector<uint8_t> data;
+		void writeBytes(const void* src, size_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(src);
+			data.insert(data.end(), bytes, bytes + size);
 		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+		template<typename T> void write(const T& value) {
+			writeBytes(&value, sizeof(T));
 		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
+		void writeString(const std::string& value) {
+			write(static_cast<uint32_t>(value.size()));
+			writeBytes(value.data(), value.size());
 		}
-		loadSkins(gltfModel);
+		template<typename T> void writeVector(const std::vector<T>& values) {
+			write(static_cast<uint64_t>(values.size()));
+			writeBytes(values.data(), values.size() * sizeof(T));
+		}
+	};
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
+	class SceneCacheReader {
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+	public:
+		SceneCacheReader(const uint8_t* data, size_t size) : data(data), size(size) {};
+		// Returns a pointer to the next bytes of the cache without copying them
+		const uint8_t* readSpan(size_t count) {
+			if (count > size - offset) {
+				vks::tools::exitFatal("glTF scene cache is corrupt, delete it to have it recreated", -1);
 			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
+			const uint8_t* span = data + offset;
+			offset += count;
+			return span;
+		}
+		template<typename T> T read() {
+			T value;
+			memcpy(&value, readSpan(sizeof(T)), sizeof(T));
+			return value;
+		}
+		std::string readString() {
+			const uint32_t length = read<uint32_t>();
+			return std::string(reinterpret_cast<const char*>(readSpan(length)), length);
+		}
+		template<typename T> void readVector(std::vector<T>& values) {
+			const uint64_t count = read<uint64_t>();
+			values.resize(static_cast<size_t>(count));
+			if (count > 0) {
+				memcpy(values.data(), readSpan(static_cast<size_t>(count) * sizeof(T)), static_cast<size_t>(count) * sizeof(T));
 			}
 		}
-	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
-	}
+	};
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
+	/*
+		Appends the full mip chain of an RGBA8 image (excluding the base level) using a 2x2 box filter
+	*/
+	void generateMipChain(const unsigned char* pixels, uint32_t width, uint32_t height, std::vector<unsigned char>& levels)
+	{
+		std::vector<unsigned char> source(pixels, pixels + static_cast<size_t>(width) * height * 4);
+		while ((width > 1) || (height > 1)) {
+			const uint32_t mipWidth = std::max(1u, width >> 1);
+			const uint32_t mipHeight = std::max(1u, height >> 1);
+			std::vector<unsigned char> mip(static_cast<size_t>(mipWidth) * mipHeight * 4);
+			for (uint32_t y = 0; y < mipHeight; y++) {
+				const uint32_t y0 = std::min(y * 2, height - 1);
+				const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t x = 0; x < mipWidth; x++) {
+					const uint32_t x0 = std::min(x * 2, width - 1);
+					const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+					for (uint32_t c = 0; c < 4; c++) {
+						const uint32_t sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] + source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+						mip[(y * mipWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
 					}
 				}
 			}
+			levels.insert(levels.end(), mip.begin(), mip.end());
+			source.swap(mip);
+			width = mipWidth;
+			height = mipHeight;
 		}
 	}
+}
 
-	for (auto extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
-		}
-	}
+std::string vkglTF::Model::getCacheFilename(const std::string& filename)
+{
+	return filename + ".vkcache";
+}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+/*
+	Tries to load the model from its scene cache, returns false if there is no cache or if it is outdated
+*/
+bool vkglTF::Model::loadFromCache(const std::string& filename, VkQueue transferQueue, uint32_t fileLoadingFlags, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer)
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (!getSourceFileInfo(filename, sourceSize, sourceTime)) {
+		return false;
+	}
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+	// The cache is parsed straight from the mapped file
+	vks::AssetFile file(getCacheFilename(filename));
+	const size_t fileSize = file.size();
+	if (fileSize < sizeof(SceneCacheHeader)) {
+		return false;
+	}
+	const uint8_t* data = file.data();
+
+	SceneCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	const bool images = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+	const bool lods = (fileLoadingFlags & FileLoadingFlags::GenerateLods) != 0;
+	if ((memcmp(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic)) != 0) ||
+		(header.version != sceneCacheVersion) ||
+		(header.vertexSize != sizeof(Vertex)) ||
+		(header.sourceSize != sourceSize) ||
+		(header.sourceTime != sourceTime) ||
+		(header.payloadSize != fileSize - sizeof(header)) ||
+		(((header.contents & SceneCacheImages) != 0) != images) ||
+		(images && (((header.contents & SceneCacheMipmaps) != 0) != ((cacheFlags & CacheFlags::CacheMipmaps) != 0))) ||
+		(((header.contents & SceneCacheOptimizedOverdraw) != 0) != ((fileLoadingFlags & FileLoadingFlags::OptimizeOverdraw) != 0)) ||
+		(((header.contents & SceneCacheLods) != 0) != lods) ||
+		(((header.contents & SceneCacheSharedMeshes) != 0) != shareMeshes) ||
+		(lods && ((header.lodLevelCount != lodGeneration.levelCount) || (header.lodReduction != lodGeneration.reduction)))) {
+		return false;
+	}
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
-
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
-
-	// Create device local buffers
-	// Vertex buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&vertices.buffer,
-		&vertices.memory));
-	// Index buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
-		&indices.buffer,
-		&indices.memory));
-
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	SceneCacheReader reader(data + sizeof(header), fileSize - sizeof(header));
+
+	// Textures
+	const uint32_t textureCount = reader.read<uint32_t>();
+	textures.resize(textureCount);
+	for (size_t i = 0; i < textures.size(); i++) {
+		vkglTF::Texture& texture = textures[i];
+		const uint32_t type = reader.read<uint32_t>();
+		if (type == SceneCacheTextureKtx) {
+			tinygltf::Image image;
+			image.uri = reader.readString();
+			texture.fromglTfImage(image, path, device, transferQueue);
+		} else {
+			const uint32_t width = reader.read<uint32_t>();
+			const uint32_t height = reader.read<uint32_t>();
+			const uint32_t levelCount = reader.read<uint32_t>();
+			const uint64_t size = reader.read<uint64_t>();
+			const unsigned char* pixels = reader.readSpan(static_cast<size_t>(size));
+			// The base level is stored first as RGBA8
+			if (keepAlphaMasks) {
+				keepAlphaMask(i, pixels, width, height, 4);
+			}
+			texture.fromPixels(pixels, width, height, levelCount, device, transferQueue);
+		}
+	}
+	if (images) {
+		createEmptyTexture(transferQueue);
+	}
 
-	VkBufferCopy copyRegion = {};
+	// Materials
+	auto textureFromIndex = [&](int32_t index) -> vkglTF::Texture* {
+		if (index == sceneCacheEmptyTexture) {
+			return &emptyTexture;
+		}
+		return (index >= 0) ? getTexture(static_cast<uint32_t>(index)) : nullptr;
+	};
+	const uint32_t materialCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < materialCount; i++) {
+		vkglTF::Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(reader.read<uint32_t>());
+		material.alphaCutoff = reader.read<float>();
+		material.metallicFactor = reader.read<float>();
+		material.roughnessFactor = reader.read<float>();
+		material.baseColorFactor = reader.read<glm::vec4>();
+		material.baseColorTexture = textureFromIndex(reader.read<int32_t>());
+		material.metallicRoughnessTexture = textureFromIndex(reader.read<int32_t>());
+		material.normalTexture = textureFromIndex(reader.read<int32_t>());
+		material.occlusionTexture = textureFromIndex(reader.read<int32_t>());
+		material.emissiveTexture = textureFromIndex(reader.read<int32_t>());
+		materials.push_back(material);
+	}
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	// Vertex and index data
+	reader.readVector(vertexBuffer);
+	reader.readVector(indexBuffer);
+
+	// Nodes are stored in the order of linearNodes, which lists children before their parents
+	const uint32_t nodeCount = reader.read<uint32_t>();
+	std::unordered_map<uint32_t, Primitive*> sharedPrimitives;
+	std::vector<int32_t> parents(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		vkglTF::Node *newNode = new Node{};
+		newNode->index = reader.read<uint32_t>();
+		parents[i] = reader.read<int32_t>();
+		newNode->name = reader.readString();
+		newNode->skinIndex = reader.read<int32_t>();
+		newNode->matrix = reader.read<glm::mat4>();
+		newNode->translation = reader.read<glm::vec3>();
+		newNode->scale = reader.read<glm::vec3>();
+		newNode->rotation = reader.read<glm::quat>();
+		if (reader.read<uint32_t>() != 0) {
+			Mesh *newMesh = new Mesh(device, newNode->matrix);
+			newMesh->name = reader.readString();
+			const uint32_t primitiveCount = reader.read<uint32_t>();
+			for (uint32_t j = 0; j < primitiveCount; j++) {
+				const uint32_t firstIndex = reader.read<uint32_t>();
+				const uint32_t indexCount = reader.read<uint32_t>();
+				const uint32_t firstVertex = reader.read<uint32_t>();
+				const uint32_t vertexCount = reader.read<uint32_t>();
+				const uint32_t materialIndex = reader.read<uint32_t>();
+				const glm::vec3 posMin = reader.read<glm::vec3>();
+				const glm::vec3 posMax = reader.read<glm::vec3>();
+				Primitive *newPrimitive = new Primitive(firstIndex, indexCount, materials[std::min(materialIndex, static_cast<uint32_t>(materials.size() - 1))]);
+				newPrimitive->firstVertex = firstVertex;
+				newPrimitive->vertexCount = vertexCount;
+				newPrimitive->setDimensions(posMin, posMax);
+				reader.readVector(newPrimitive->lods);
+				// Shared primitives are stored once per node referencing them, they are shared again by their index range
+				auto sharedPrimitive = sharedPrimitives.find(firstIndex);
+				if ((sharedPrimitive != sharedPrimitives.end()) && (sharedPrimitive->second->indexCount == indexCount)) {
+					delete newPrimitive;
+					newPrimitive = sharedPrimitive->second;
+				} else {
+					sharedPrimitives[firstIndex] = newPrimitive;
+				}
+				newMesh->primitives.push_back(newPrimitive);
+			}
+			newNode->mesh = newMesh;
+		}
+		linearNodes.push_back(newNode);
+	}
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		if (parents[i] >= 0) {
+			linearNodes[i]->parent = linearNodes[parents[i]];
+			linearNodes[parents[i]]->children.push_back(linearNodes[i]);
+		} else {
+			nodes.push_back(linearNodes[i]);
+		}
+	}
+
+	// Skins
+	const uint32_t skinCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < skinCount; i++) {
+		Skin *newSkin = new Skin{};
+		newSkin->name = reader.readString();
+		const int32_t skeletonRoot = reader.read<int32_t>();
+		if (skeletonRoot > -1) {
+			newSkin->skeletonRoot = nodeFromIndex(skeletonRoot);
+		}
+		std::vector<uint32_t> joints;
+		reader.readVector(joints);
+		for (uint32_t jointIndex : joints) {
+			newSkin->joints.push_back(nodeFromIndex(jointIndex));
+		}
+		reader.readVector(newSkin->inverseBindMatrices);
+		skins.push_back(newSkin);
+	}
+
+	// Animations
+	const uint32_t animationCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < animationCount; i++) {
+		vkglTF::Animation animation{};
+		animation.name = reader.readString();
+		animation.start = reader.read<float>();
+		animation.end = reader.read<float>();
+		animation.samplers.resize(reader.read<uint32_t>());
+		for (auto& sampler : animation.samplers) {
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.read<uint32_t>());
+			reader.readVector(sampler.inputs);
+			reader.readVector(sampler.outputsVec4);
+		}
+		const uint32_t channelCount = reader.read<uint32_t>();
+		for (uint32_t j = 0; j < channelCount; j++) {
+			vkglTF::AnimationChannel channel{};
+			channel.path = static_cast<AnimationChannel::PathType>(reader.read<uint32_t>());
+			channel.samplerIndex = reader.read<uint32_t>();
+			channel.node = nodeFromIndex(reader.read<uint32_t>());
+			if (channel.node) {
+				animation.channels.push_back(channel);
+			}
+		}
+		animations.push_back(animation);
+	}
 
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+	metallicRoughnessWorkflow = (reader.read<uint32_t>() != 0);
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	indexStatistics = reader.read<IndexStatistics>();
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	return true;
+}
 
-	getSceneDimensions();
+/*
+	Writes the loaded model to its scene cache, must be called before any of the vertices are modified by the file loading flags
+*/
+void vkglTF::Model::writeCache(const std::string& filename, const tinygltf::Model& gltfModel, uint32_t fileLoadingFlags, const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	SceneCacheHeader header{};
+	memcpy(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic));
+	header.version = sceneCacheVersion;
+	header.vertexSize = sizeof(Vertex);
+	if (!getSourceFileInfo(filename, header.sourceSize, header.sourceTime)) {
+		return;
+	}
+	const bool images = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+	const bool mipmaps = images && (cacheFlags & CacheFlags::CacheMipmaps);
+	const bool overdraw = (fileLoadingFlags & FileLoadingFlags::OptimizeOverdraw) != 0;
+	const bool lods = (fileLoadingFlags & FileLoadingFlags::GenerateLods) != 0;
+	header.contents = (images ? SceneCacheImages : 0) | (mipmaps ? SceneCacheMipmaps : 0) | (overdraw ? SceneCacheOptimizedOverdraw : 0) | (lods ? SceneCacheLods : 0) | (shareMeshes ? SceneCacheSharedMeshes : 0);
+	if (lods) {
+		header.lodLevelCount = lodGeneration.levelCount;
+		header.lodReduction = lodGeneration.reduction;
+	}
 
-	// Setup descriptors
-	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
+	SceneCacheWriter writer;
+
+	// Textures, decoded images are stored as RGBA8 so they can be copied to the GPU as is
+	writer.write(static_cast<uint32_t>(textures.size()));
+	for (size_t i = 0; i < textures.size(); i++) {
+		const tinygltf::Image& image = gltfModel.images[i];
+		const std::string extension = image.uri.substr(image.uri.find_last_of('.') + 1);
+		if ((image.uri.find_last_of('.') != std::string::npos) && (extension == "ktx")) {
+			// KTX files already store GPU ready data, so only the reference is cached
+			writer.write(static_cast<uint32_t>(SceneCacheTextureKtx));
+			writer.writeString(image.uri);
+			continue;
+		}
+		std::vector<unsigned char> rgba;
+		const unsigned char* pixels = getRGBAPixels(image, rgba);
+		const size_t baseSize = static_cast<size_t>(image.width) * image.height * 4;
+		std::vector<unsigned char> levels(pixels, pixels + baseSize);
+		if (mipmaps) {
+			generateMipChain(pixels, image.width, image.height, levels);
+		}
+		writer.write(static_cast<uint32_t>(SceneCacheTexturePixels));
+		writer.write(static_cast<uint32_t>(image.width));
+		writer.write(static_cast<uint32_t>(image.height));
+		writer.write(mipmaps ? textures[i].mipLevels : 1u);
+		writer.write(static_cast<uint64_t>(levels.size()));
+		writer.writeBytes(levels.data(), levels.size());
+	}
+
+	// Materials
+	auto textureToIndex = [&](const vkglTF::Texture* texture) -> int32_t {
+		if (texture == &emptyTexture) {
+			return sceneCacheEmptyTexture;
+		}
+		for (size_t i = 0; i < textures.size(); i++) {
+			if (texture == &textures[i]) {
+				return static_cast<int32_t>(i);
+			}
+		}
+		return sceneCacheNoTexture;
+	};
+	writer.write(static_cast<uint32_t>(materials.size()));
+	for (auto& material : materials) {
+		writer.write(static_cast<uint32_t>(material.alphaMode));
+		writer.write(material.alphaCutoff);
+		writer.write(material.metallicFactor);
+		writer.write(material.roughnessFactor);
+		writer.write(material.baseColorFactor);
+		writer.write(textureToIndex(material.baseColorTexture));
+		writer.write(textureToIndex(material.metallicRoughnessTexture));
+		writer.write(textureToIndex(material.normalTexture));
+		writer.write(textureToIndex(material.occlusionTexture));
+		writer.write(textureToIndex(material.emissiveTexture));
+	}
+
+	// Vertex and index data
+	writer.writeVector(vertexBuffer);
+	writer.writeVector(indexBuffer);
+
+	// Nodes
+	writer.write(static_cast<uint32_t>(linearNodes.size()));
 	for (auto node : linearNodes) {
+		int32_t parent = -1;
+		for (size_t i = 0; i < linearNodes.size(); i++) {
+			if (linearNodes[i] == node->parent) {
+				parent = static_cast<int32_t>(i);
+				break;
+			}
+		}
+		writer.write(node->index);
+		writer.write(parent);
+		writer.writeString(node->name);
+		writer.write(node->skinIndex);
+		writer.write(node->matrix);
+		writer.write(node->translation);
+		writer.write(node->scale);
+		writer.write(node->rotation);
+		writer.write(static_cast<uint32_t>(node->mesh ? 1 : 0));
 		if (node->mesh) {
-			uboCount++;
+			writer.writeString(node->mesh->name);
+			writer.write(static_cast<uint32_t>(node->mesh->primitives.size()));
+			for (auto primitive : node->mesh->primitives) {
+				writer.write(primitive->firstIndex);
+				writer.write(primitive->indexCount);
+				writer.write(primitive->firstVertex);
+				writer.write(primitive->vertexCount);
+				writer.write(static_cast<uint32_t>(&primitive->material - materials.data()));
+				writer.write(primitive->dimensions.min);
+				writer.write(primitive->dimensions.max);
+				writer.writeVector(primitive->lods);
+			}
 		}
 	}
-	for (auto material : materials) {
-		if (material.baseColorTexture != nullptr) {
-			imageCount++;
+
+	// Skins
+	writer.write(static_cast<uint32_t>(skins.size()));
+	for (auto skin : skins) {
+		writer.writeString(skin->name);
+		writer.write(skin->skeletonRoot ? static_cast<int32_t>(skin->skeletonRoot->index) : -1);
+		std::vector<uint32_t> joints;
+		for (auto joint : skin->joints) {
+			joints.push_back(joint->index);
 		}
+		writer.writeVector(joints);
+		writer.writeVector(skin->inverseBindMatrices);
 	}
-	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+
+	// Animations
+	writer.write(static_cast<uint32_t>(animations.size()));
+	for (auto& animation : animations) {
+		writer.writeString(animation.name);
+		writer.write(animation.start);
+		writer.write(animation.end);
+		writer.write(static_cast<uint32_t>(animation.samplers.size()));
+		for (auto& sampler : animation.samplers) {
+			writer.write(static_cast<uint32_t>(sampler.interpolation));
+			writer.writeVector(sampler.inputs);
+			writer.writeVector(sampler.outputsVec4);
+		}
+		writer.write(static_cast<uint32_t>(animation.channels.size()));
+		for (auto& channel : animation.channels) {
+			writer.write(static_cast<uint32_t>(channel.path));
+			writer.write(channel.samplerIndex);
+			writer.write(channel.node->index);
+		}
+	}
+
+	writer.write(static_cast<uint32_t>(metallicRoughnessWorkflow ? 1 : 0));
+
+	writer.write(indexStatistics);
+
+	header.payloadSize = writer.data.size();
+
+	// Write to a temporary file first, so an interrupted write never leaves a truncated cache behind
+	const std::string cacheFilename = getCacheFilename(filename);
+	const std::string tempFilename = cacheFilename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Could not write glTF scene cache \"" << cacheFilename << "\"" << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+		if (!file) {
+			file.close();
+			std::remove(tempFilename.c_str());
+			return;
+		}
+	}
+	std::remove(cacheFilename.c_str());
+	std::rename(tempFilename.c_str(), cacheFilename.c_str());
+}
+
+/*
+	Reads a glTF file and decodes its compressed buffer views and images on the host
+	Nothing is recorded or submitted to the device, so this can run on a worker thread while the device is in use, e.g. to load the next scene while the current one is still rendered
+*/
+void vkglTF::Model::parseFile(const std::string& filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, ParsedFile& parsedFile)
+{
+	parseFile(filename, device, fileLoadingFlags, parsedFile, nullptr);
+}
+
+void vkglTF::Model::parseFile(const std::string& filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, ParsedFile& parsedFile, vks::AssetTimer* assetTimer)
+{
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+	// Only used to query the supported image formats
+	this->device = device;
+
+	parsedFile.filename = filename;
+	parsedFile.fileLoadingFlags = fileLoadingFlags;
+
+	tinygltf::TinyGLTF gltfContext;
+	std::vector<std::vector<unsigned char>> encodedImages;
+	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+	} else {
+		gltfContext.SetImageLoader(loadImageDataFunc, &encodedImages);
+	}
+#if defined(__ANDROID__)
+	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
+	// tinyglTF uses it to check if external files exist, reading them goes through vks::AssetFile like all other assets
+	tinygltf::asset_manager = androidApp->activity->assetManager;
+#endif
+	tinygltf::FsCallbacks fsCallbacks = {
+		&tinygltf::FileExists,
+		&tinygltf::ExpandFilePath,
+		&readWholeAssetFile,
+		&tinygltf::WriteWholeFile,
+		nullptr
 	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+	gltfContext.SetFsCallbacks(fsCallbacks);
+	std::string warning;
+
+	// Binary glTF files (.glb) store the JSON and the buffers in a single file
+	std::string extension = filename.substr(filename.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	const bool binary = (extension == "glb");
+
+	parsedFile.valid = loadFromAssetFile(gltfContext, &parsedFile.gltfModel, &parsedFile.error, &warning, filename, path, binary);
+	if (parsedFile.valid) {
+		if (assetTimer) {
+			assetTimer->next(vks::StartupProfiler::AssetDecode);
+		}
+		decodeCompressedBufferViews(parsedFile.gltfModel);
+		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+			decodeImages(parsedFile.gltfModel, encodedImages);
+		}
+	}
+}
+
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
+	load(filename, nullptr, device, transferQueue, fileLoadingFlags, scale);
+}
+
+/*
+	Loads a file that has been parsed with parseFile (e.g. on a worker thread), this creates and uploads the device resources and must be called on the thread using the queue
+	The scene cache isn't read, as the file has already been parsed, but it's written if enabled
+*/
+void vkglTF::Model::loadFromParsedFile(ParsedFile& parsedFile, vks::VulkanDevice* device, VkQueue transferQueue, float scale)
+{
+	load(parsedFile.filename, &parsedFile, device, transferQueue, parsedFile.fileLoadingFlags, scale);
+}
+
+void vkglTF::Model::load(const std::string& filename, ParsedFile* parsedFile, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+
+	this->device = device;
+
+	// Loading from the scene cache includes its uploads, but is counted as I/O as that's what the cache replaces
+	vks::AssetTimer assetTimer(vks::StartupProfiler::AssetIO);
+
+	// Record the uploads of all images and buffers into a single command buffer instead of submitting and waiting for each of them
+	device->beginUploadBatch(transferQueue);
+
+	std::vector<uint32_t> indexBuffer;
+	std::vector<Vertex> vertexBuffer;
+
+	keepAlphaMasks = (fileLoadingFlags & FileLoadingFlags::ClassifyAlphaMaskedTriangles) != 0;
+	alphaMasks.clear();
+
+	// Vertices pre-transformed per node can't be shared by multiple nodes
+	shareMeshes = !(fileLoadingFlags & FileLoadingFlags::PreTransformVertices);
+	sharedMeshes.clear();
+
+	const bool useCache = (cacheFlags & CacheFlags::CacheScene) != 0;
+	if (parsedFile || !useCache || !loadFromCache(filename, transferQueue, fileLoadingFlags, indexBuffer, vertexBuffer)) {
+		ParsedFile localParsedFile;
+		if (!parsedFile) {
+			parseFile(filename, device, fileLoadingFlags, localParsedFile, &assetTimer);
+			parsedFile = &localParsedFile;
+		}
+		tinygltf::Model& gltfModel = parsedFile->gltfModel;
+
+		if (parsedFile->valid) {
+			assetTimer.next(vks::StartupProfiler::AssetDecode);
+			if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+				assetTimer.next(vks::StartupProfiler::AssetUpload);
+				loadImages(gltfModel, device, transferQueue);
+				assetTimer.next(vks::StartupProfiler::AssetDecode);
+			}
+			loadMaterials(gltfModel);
+			const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+			size_t vertexCount = 0;
+			size_t indexCount = 0;
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				countNodeData(gltfModel, gltfModel.nodes[scene.nodes[i]], vertexCount, indexCount);
+			}
+			vertexBuffer.reserve(vertexCount);
+			indexBuffer.reserve(indexCount);
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			}
+			if (gltfModel.animations.size() > 0) {
+				loadAnimations(gltfModel);
+			}
+			loadSkins(gltfModel);
+			// Optimized index and vertex buffers are stored in the scene cache, so the optimization is always done if the cache is used
+			const bool overdraw = (fileLoadingFlags & FileLoadingFlags::OptimizeOverdraw) != 0;
+			if (useCache || overdraw || (fileLoadingFlags & FileLoadingFlags::OptimizeIndices)) {
+				optimizeIndices(indexBuffer, vertexBuffer, overdraw);
+			}
+			if (fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+				generateLods(indexBuffer, vertexBuffer);
+			}
+		}
+		else {
+			// TODO: throw
+			vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + parsedFile->error, -1);
+			return;
+		}
+
+		for (auto extension : gltfModel.extensionsUsed) {
+			if (extension == "KHR_materials_pbrSpecularGlossiness") {
+				std::cout << "Required extension: " << extension;
+				metallicRoughnessWorkflow = false;
+			}
+		}
+
+		// The cache stores the data as loaded from the file (with optimized indices), the file loading flags below are applied after loading it back
+		// Morph targets aren't stored in the cache, so models using them are always loaded from the glTF file
+		if (useCache && morphTargets.deltas.empty()) {
+			writeCache(filename, gltfModel, fileLoadingFlags, indexBuffer, vertexBuffer);
+		}
+	}
+
+	assetTimer.next(vks::StartupProfiler::AssetDecode);
+
+	loadedIndexStatistics.triangleCount += indexStatistics.triangleCount;
+	loadedIndexStatistics.cacheMissesBefore += indexStatistics.cacheMissesBefore;
+	loadedIndexStatistics.cacheMissesAfter += indexStatistics.cacheMissesAfter;
+
+	// Assign skins
+	for (auto node : linearNodes) {
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
+		}
+	}
+
+	sharedMeshes.clear();
+
+	// Done on every load (instead of storing the sorted indices in the scene cache), as it depends on the file loading flags
+	// Vertex colors are classified before they're pre-multiplied with the material's base color, which is taken into account separately
+	if (keepAlphaMasks) {
+		classifyAlphaMaskedTriangles(indexBuffer, vertexBuffer);
+		alphaMasks.clear();
+		keepAlphaMasks = false;
+	}
+
+	// Initial pose
+	buildHierarchy();
+	prepareTransforms();
+	updateTransforms();
+
+	// Pre-Calculations for requested features
+	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
+		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+		// Primitives shared by multiple nodes must only be processed once (sharing is disabled for pre-transformed vertices)
+		std::unordered_set<Primitive*> processed;
+		for (Node* node : linearNodes) {
+			if (node->mesh) {
+				const glm::mat4 localMatrix = hierarchy.worldMatrices[node->hierarchyIndex];
+				for (Primitive* primitive : node->mesh->primitives) {
+					if (!processed.insert(primitive).second) {
+						continue;
+					}
+					// Morph target deltas are directions, so they are only rotated and scaled
+					for (uint32_t i = 0; i < primitive->vertexCount * primitive->morphTargetCount; i++) {
+						MorphTargets::Delta& delta = morphTargets.deltas[primitive->firstMorphDelta + i];
+						if (preTransform) {
+							delta.position = glm::vec4(glm::mat3(localMatrix) * glm::vec3(delta.position), 0.0f);
+							delta.normal = glm::vec4(glm::mat3(localMatrix) * glm::vec3(delta.normal), 0.0f);
+							delta.tangent = glm::vec4(glm::mat3(localMatrix) * glm::vec3(delta.tangent), 0.0f);
+						}
+						if (flipY) {
+							delta.position.y *= -1.0f;
+							delta.normal.y *= -1.0f;
+						}
+					}
+					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
+						// Pre-transform vertex positions by node-hierarchy
+						if (preTransform) {
+							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
+						}
+						// Flip Y-Axis of vertex positions
+						if (flipY) {
+							vertex.pos.y *= -1.0f;
+							vertex.normal.y *= -1.0f;
+						}
+						// Pre-Multiply vertex colors with material base color
+						if (preMultiplyColor) {
+							vertex.color = primitive->material.baseColorFactor * vertex.color;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Optionally convert vertices to the compact layout, this is done after all other processing so the scene cache always stores full vertices
+	std::vector<uint8_t> packedVertices;
+	if (fileLoadingFlags & FileLoadingFlags::CompactVertices) {
+		setupCompactVertexLayout(vertexBuffer);
+		packVertices(vertexBuffer, packedVertices);
+	}
+	const void* vertexData = vertexLayout.compact ? static_cast<const void*>(packedVertices.data()) : static_cast<const void*>(vertexBuffer.data());
+	size_t vertexBufferSize = vertexBuffer.size() * vertexLayout.stride;
+	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
+	// Generated levels of detail are stored behind the full detail indices, which is what drawing the whole index buffer uses
+	uint32_t fullDetailIndexCount = static_cast<uint32_t>(indexBuffer.size());
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->lods.size() > 1) {
+					fullDetailIndexCount = std::min(fullDetailIndexCount, primitive->lods[1].firstIndex);
+				}
+			}
+		}
+	}
+	indices.count = fullDetailIndexCount;
+	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+
+	const bool hostGeometryOnly = fileLoadingFlags & FileLoadingFlags::HostGeometryOnly;
+	if ((fileLoadingFlags & FileLoadingFlags::KeepHostData) || hostGeometryOnly) {
+		hostData.vertices = vertexBuffer;
+		hostData.indices.assign(indexBuffer.begin(), indexBuffer.begin() + fullDetailIndexCount);
+	}
+
+	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+
+	const bool positionStream = fileLoadingFlags & FileLoadingFlags::PositionStream;
+	const size_t positionBufferSize = positionStream ? vertexBuffer.size() * sizeof(glm::vec3) : 0;
+	std::vector<glm::vec3> positionData;
+	if (positionStream) {
+		positionData.resize(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++) {
+			positionData[i] = vertexBuffer[i].pos;
+		}
+	}
+
+	// Mesh shaders fetch the vertices of the meshlets from the vertex buffer
+	const bool meshletsRequested = fileLoadingFlags & FileLoadingFlags::Meshlets;
+	assert(!(meshletsRequested && vertexLayout.compact));
+	const VkBufferUsageFlags meshletUsage = meshletsRequested ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+	// Vertex pulling shaders read the vertex buffer as a storage buffer
+	const VkBufferUsageFlags vertexPullingUsage = (fileLoadingFlags & FileLoadingFlags::VertexPulling) ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+
+	assetTimer.next(vks::StartupProfiler::AssetUpload);
+
+	if (hostGeometryOnly) {
+		// The geometry is uploaded by whoever streams it from the host copy
+		assert(!positionStream && !meshletsRequested && !vertexPullingUsage);
+	} else if (device->directUploadAvailable()) {
+		// Unified memory or resizable BAR: Write the data straight into host visible device local buffers, no staging copies required
+		const VkMemoryPropertyFlags directUploadFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | memoryPropertyFlags | meshletUsage | vertexPullingUsage,
+			directUploadFlags,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory,
+			const_cast<void*>(vertexData)));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | memoryPropertyFlags,
+			directUploadFlags,
+			indexBufferSize,
+			&indices.buffer,
+			&indices.memory,
+			indexBuffer.data()));
+		if (positionStream) {
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				directUploadFlags,
+				positionBufferSize,
+				&positions.buffer,
+				&positions.memory,
+				positionData.data()));
+		}
+		device->directUpload.bytesWritten += vertexBufferSize + indexBufferSize + positionBufferSize;
+	} else {
+		// Stage vertex, index and position data with a single staging allocation
+		const VkDeviceSize indexStagingOffset = vks::tools::alignedVkSize(vertexBufferSize, 16);
+		const VkDeviceSize positionStagingOffset = vks::tools::alignedVkSize(indexStagingOffset + indexBufferSize, 16);
+		vks::StagingRing::Allocation staging = device->stagingRing.allocate(positionStagingOffset + positionBufferSize);
+		memcpy(staging.data, vertexData, vertexBufferSize);
+		memcpy(static_cast<uint8_t*>(staging.data) + indexStagingOffset, indexBuffer.data(), indexBufferSize);
+		if (positionStream) {
+			memcpy(static_cast<uint8_t*>(staging.data) + positionStagingOffset, positionData.data(), positionBufferSize);
 		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+
+		// Create device local buffers
+		// Vertex buffer
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags | meshletUsage | vertexPullingUsage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory));
+		// Index buffer
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBufferSize,
+			&indices.buffer,
+			&indices.memory));
+		// Position buffer
+		if (positionStream) {
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				positionBufferSize,
+				&positions.buffer,
+				&positions.memory));
+		}
+
+		// Copy from staging memory
+		VkCommandBuffer copyCmd = device->beginUpload();
+
+		VkBufferCopy copyRegion = {};
+
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.size = vertexBufferSize;
+		vkCmdCopyBuffer(copyCmd, staging.buffer, vertices.buffer, 1, &copyRegion);
+
+		copyRegion.srcOffset = staging.offset + indexStagingOffset;
+		copyRegion.size = indexBufferSize;
+		vkCmdCopyBuffer(copyCmd, staging.buffer, indices.buffer, 1, &copyRegion);
+
+		if (positionStream) {
+			copyRegion.srcOffset = staging.offset + positionStagingOffset;
+			copyRegion.size = positionBufferSize;
+			vkCmdCopyBuffer(copyCmd, staging.buffer, positions.buffer, 1, &copyRegion);
 		}
+
+		device->endUpload(copyCmd, transferQueue);
 	}
-	VkDescriptorPoolCreateInfo descriptorPoolCI{};
-	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+	// The geometry buffers have memory of their own, so they're added to the memory report here
+	if (!hostGeometryOnly) {
+		device->memoryAllocator.report.track(vertices.memory, 0, vertexBufferSize, vks::MemoryCategory::Geometry, filename + " (vertices)");
+		device->memoryAllocator.report.track(indices.memory, 0, indexBufferSize, vks::MemoryCategory::Geometry, filename + " (indices)");
+	}
+	if (positionStream) {
+		device->memoryAllocator.report.track(positions.memory, 0, positionBufferSize, vks::MemoryCategory::Geometry, filename + " (positions)");
+	}
+
+	if (meshletsRequested) {
+		prepareMeshlets(indexBuffer, vertexBuffer, transferQueue);
+	}
+
+	// All images and buffers of the model have been recorded, submit them at once
+	device->endUploadBatch();
+	if (mipGenerator && (device->uploadBatch.depth == 0)) {
+		mipGenerator->releaseResources();
+	}
+	assetTimer.stop();
+
+	getSceneDimensions();
+
+	// Setup descriptors
+	// The allocator chains pools as needed, so the number of nodes and materials doesn't have to be counted up front
+	descriptorAllocator.setup(device->logicalDevice);
 
 	// Descriptors for per-node uniform buffers
 	{
@@ -1355,15 +2914,21 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			};
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
+			descriptorSetLayoutUbo = device->descriptorLayoutCache.getLayout(setLayoutBindings);
 		}
 		for (auto node : nodes) {
 			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
 		}
+		// Single descriptor for all meshes, indexed with the pushed transform index
+		if (transforms.count > 0) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			};
+			transforms.descriptorSetLayout = device->descriptorLayoutCache.getLayout(setLayoutBindings);
+			transforms.descriptorSet = descriptorAllocator.allocate(transforms.descriptorSetLayout);
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(transforms.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &transforms.buffer.descriptor);
+			vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
 	}
 
 	// Descriptors for per-material images
@@ -1377,57 +2942,89 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
 				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
 			}
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
+			descriptorSetLayoutImage = device->descriptorLayoutCache.getLayout(setLayoutBindings);
 		}
 		for (auto& material : materials) {
 			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+				material.createDescriptorSet(descriptorAllocator, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
 			}
 		}
 	}
 }
 
+void vkglTF::Model::recordBufferBinds(VkCommandBuffer commandBuffer)
+{
+	const VkDeviceSize offsets[1] = {0};
+	// Use the output of compute skinning if enabled
+	const VkBuffer vertexBuffer = (computeSkinning.vertexBuffer != VK_NULL_HANDLE) ? computeSkinning.vertexBuffer : vertices.buffer;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 {
+	recordBufferBinds(commandBuffer);
+	buffersBound = true;
+}
+
+/**
+* Bind the position only vertex buffer and the index buffer, for passes that only need vertex positions (e.g. depth and shadow passes)
+*
+* @note Requires the model to be loaded with FileLoadingFlags::PositionStream and pipelines using Vertex::getPositionVertexInputState
+*/
+void vkglTF::Model::bindPositionBuffers(VkCommandBuffer commandBuffer)
+{
+	assert(positions.buffer != VK_NULL_HANDLE);
 	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positions.buffer, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	buffersBound = true;
 }
 
-void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+// Draw the primitives of a single node, without its children
+void vkglTF::Model::drawPrimitives(const Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount, uint32_t firstInstance)
 {
-	if (node->mesh) {
-		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
-			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-			}
-			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
-				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+	if (!node->mesh) {
+		return;
+	}
+	if (renderFlags & RenderFlags::PushTransformIndex) {
+		vkCmdPushConstants(commandBuffer, pipelineLayout, transforms.pushConstantStages, transforms.pushConstantOffset, sizeof(uint32_t), &node->mesh->transformIndex);
+	}
+	for (Primitive* primitive : node->mesh->primitives) {
+		bool skip = false;
+		const vkglTF::Material& material = primitive->material;
+		if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+		}
+		if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+		}
+		if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+			skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+		}
+		if (!skip) {
+			if (renderFlags & RenderFlags::PushMaterialIndex) {
+				// Primitives reference the model's materials, so the material index is the offset into that array
+				const uint32_t materialIndex = static_cast<uint32_t>(&material - materials.data());
+				vkCmdPushConstants(commandBuffer, pipelineLayout, bindlessMaterials.pushConstantStages, bindlessMaterials.pushConstantOffset, sizeof(uint32_t), &materialIndex);
+			} else if (renderFlags & RenderFlags::BindImages) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 			}
+			vkCmdDrawIndexed(commandBuffer, primitive->indexCount, instanceCount, primitive->firstIndex, 0, firstInstance);
 		}
 	}
+}
+
+void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount, uint32_t firstInstance)
+{
+	drawPrimitives(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, instanceCount, firstInstance);
 	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, renderFlags);
+		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet, instanceCount, firstInstance);
 	}
 }
 
-void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+// Instance count and first instance are passed to all draws, e.g. for instanced or layered rendering with the instance index selecting the layer
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount, uint32_t firstInstance)
 {
 	if (!buffersBound) {
 		const VkDeviceSize offsets[1] = {0};
@@ -1435,15 +3032,1326 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
 	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, instanceCount, firstInstance);
 	}
 }
 
-void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
+/**
+* Add the primitives of all nodes to a render queue, so they can be drawn sorted by pipeline, material and depth instead of in scene graph order
+*
+* @param queue Render queue to add the draws to, its pipeline layout and material set are used to bind the material descriptor sets
+* @param cameraPosition Position of the camera in the model's (world) space, used for the depth of the draws
+* @param pipelines Pipelines for opaque, alpha masked and alpha blended materials (in that order), primitives with a VK_NULL_HANDLE pipeline are skipped
+* @param firstPass (Optional) Queue pass of the opaque primitives, alpha masked and alpha blended primitives are added to the following passes
+* @param renderFlags (Optional) Bit flags of RenderFlags, only BindImages (to set the material's descriptor set for the draws) and PushTransformIndex are used
+* @param instanceCount (Optional) Same as for draw
+* @param firstInstance (Optional) Same as for draw
+*
+* @note Alpha blended primitives are sorted back to front, so the queue needs to be rebuilt if the camera moves
+* @note With PushTransformIndex the queue's push constant range needs to be set to the transform index (see Transforms::pushConstantOffset)
+*/
+void vkglTF::Model::enqueueDraws(vks::RenderQueue& queue, const glm::vec3& cameraPosition, const VkPipeline pipelines[3], uint32_t firstPass, uint32_t renderFlags, uint32_t instanceCount, uint32_t firstInstance)
 {
-	if (node->mesh) {
-		for (Primitive *primitive : node->mesh->primitives) {
-			glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * node->getMatrix();
+	for (size_t i = 0; i < hierarchy.nodes.size(); i++) {
+		const Node* node = hierarchy.nodes[i];
+		if (!node->mesh) {
+			continue;
+		}
+		const glm::mat4& m = hierarchy.worldMatrices[i];
+		for (Primitive* primitive : node->mesh->primitives) {
+			const vkglTF::Material& material = primitive->material;
+			const uint32_t alphaPass = (material.alphaMode == Material::ALPHAMODE_BLEND) ? 2 : (material.alphaMode == Material::ALPHAMODE_MASK) ? 1 : 0;
+			if (pipelines[alphaPass] == VK_NULL_HANDLE) {
+				continue;
+			}
+			vks::RenderQueue::Draw draw{};
+			draw.pipeline = pipelines[alphaPass];
+			draw.descriptorSet = (renderFlags & RenderFlags::BindImages) ? material.descriptorSet : VK_NULL_HANDLE;
+			draw.pushConstants = (renderFlags & RenderFlags::PushTransformIndex) ? &node->mesh->transformIndex : nullptr;
+			draw.indexCount = primitive->indexCount;
+			draw.firstIndex = primitive->firstIndex;
+			draw.instanceCount = instanceCount;
+			draw.firstInstance = firstInstance;
+			const float depth = glm::length(glm::vec3(m * glm::vec4(primitive->dimensions.center, 1.0f)) - cameraPosition);
+			queue.add(firstPass + alphaPass, draw, depth, (alphaPass == 2) ? vks::RenderQueue::BackToFront : vks::RenderQueue::FrontToBack);
+		}
+	}
+}
+
+/**
+* Draw all nodes with one instanced draw per primitive of each instance group, instead of one draw per node and primitive
+*
+* @param commandBuffer Command buffer to record the draws to
+* @param renderFlags (Optional) Same as for draw, PushTransformIndex is ignored as the transform index is the instance index
+* @param pipelineLayout (Optional) Same as for draw
+* @param bindImageSet (Optional) Same as for draw
+*
+* @note The vertex shader needs to read the node matrices from the transform buffer (Transforms::descriptorSet) at gl_InstanceIndex, which includes the first instance
+*/
+void vkglTF::Model::drawInstanced(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (!buffersBound) {
+		recordBufferBinds(commandBuffer);
+	}
+	for (const InstanceGroup& group : instanceGroups) {
+		for (Primitive* primitive : group.mesh->primitives) {
+			const vkglTF::Material& material = primitive->material;
+			bool skip = false;
+			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+			}
+			if (skip) {
+				continue;
+			}
+			if (renderFlags & RenderFlags::PushMaterialIndex) {
+				const uint32_t materialIndex = static_cast<uint32_t>(&material - materials.data());
+				vkCmdPushConstants(commandBuffer, pipelineLayout, bindlessMaterials.pushConstantStages, bindlessMaterials.pushConstantOffset, sizeof(uint32_t), &materialIndex);
+			} else if (renderFlags & RenderFlags::BindImages) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+			}
+			vkCmdDrawIndexed(commandBuffer, primitive->indexCount, group.instanceCount, primitive->firstIndex, 0, group.firstTransform);
+		}
+	}
+}
+
+/**
+* Draw all primitives whose bounding spheres intersect the view frustum
+*
+* @param commandBuffer Command buffer to record the draws to
+* @param viewProjection Matrix transforming the model's (world) space to clip space, including the model matrix if one is used by the shaders
+* @param renderFlags (Optional) Same as for draw
+* @param pipelineLayout (Optional) Same as for draw
+* @param bindImageSet (Optional) Same as for draw
+*
+* @note Visibility is evaluated at recording time, so command buffers using this need to be re-recorded when the view changes
+*/
+void vkglTF::Model::drawCulled(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	// Unlike bindBuffers this doesn't set buffersBound, which would skip the binds in the next command buffer recorded
+	if (!buffersBound) {
+		recordBufferBinds(commandBuffer);
+	}
+	vks::Frustum frustum;
+	frustum.update(viewProjection);
+	for (size_t i = 0; i < hierarchy.nodes.size(); i++) {
+		const Node* node = hierarchy.nodes[i];
+		if (!node->mesh) {
+			continue;
+		}
+		const glm::mat4& m = hierarchy.worldMatrices[i];
+		// Bounding sphere radii are scaled by the largest axis scale of the node
+		const float scale = sqrtf(std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2])))));
+		bool transformPushed = false;
+		for (Primitive* primitive : node->mesh->primitives) {
+			const vkglTF::Material& material = primitive->material;
+			bool skip = false;
+			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+			}
+			const glm::vec3 center = glm::vec3(m * glm::vec4(primitive->dimensions.center, 1.0f));
+			const float radius = primitive->dimensions.radius * scale;
+			if (skip || !frustum.checkSphere(center, radius)) {
+				continue;
+			}
+			if ((renderFlags & RenderFlags::PushTransformIndex) && !transformPushed) {
+				vkCmdPushConstants(commandBuffer, pipelineLayout, transforms.pushConstantStages, transforms.pushConstantOffset, sizeof(uint32_t), &node->mesh->transformIndex);
+				transformPushed = true;
+			}
+			if (renderFlags & RenderFlags::BindImages) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+			}
+			const uint32_t level = selectLod(primitive, center, radius, scale);
+			if (level > 0) {
+				vkCmdDrawIndexed(commandBuffer, primitive->lods[level].indexCount, 1, primitive->lods[level].firstIndex, 0, 0);
+			} else {
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+			}
+		}
+	}
+}
+
+/*
+	Parallel command buffer recording
+*/
+
+/**
+* Split the flattened node hierarchy into ranges with a similar number of primitives, that can be recorded independently (e.g. on multiple threads)
+*
+* @param maxRangeCount Maximum number of ranges to split the nodes into (e.g. a few per recording thread, so uneven recording costs balance out)
+*
+* @return List of ranges with at least one primitive each, covering all nodes with meshes
+*/
+std::vector<vkglTF::Model::DrawRange> vkglTF::Model::getDrawRanges(uint32_t maxRangeCount)
+{
+	std::vector<DrawRange> ranges;
+	uint32_t primitiveCount = 0;
+	for (auto node : hierarchy.nodes) {
+		if (node->mesh) {
+			primitiveCount += static_cast<uint32_t>(node->mesh->primitives.size());
+		}
+	}
+	if ((primitiveCount == 0) || (maxRangeCount == 0)) {
+		return ranges;
+	}
+	const uint32_t primitivesPerRange = (primitiveCount + maxRangeCount - 1) / maxRangeCount;
+	DrawRange range{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(hierarchy.nodes.size()); i++) {
+		const Node* node = hierarchy.nodes[i];
+		// Nodes without primitives don't start a new range
+		if (range.primitiveCount == 0) {
+			range.firstNode = i;
+		}
+		range.nodeCount = i - range.firstNode + 1;
+		if (node->mesh) {
+			range.primitiveCount += static_cast<uint32_t>(node->mesh->primitives.size());
+		}
+		if (range.primitiveCount >= primitivesPerRange) {
+			ranges.push_back(range);
+			range = DrawRange();
+		}
+	}
+	if (range.primitiveCount > 0) {
+		ranges.push_back(range);
+	}
+	return ranges;
+}
+
+/**
+* Draw the primitives of a range of nodes returned by getDrawRanges
+*
+* @param commandBuffer Command buffer to record the draws to, usually a secondary command buffer recorded for this range only
+* @param range Range of nodes to draw
+* @param renderFlags (Optional) Same as for draw
+* @param pipelineLayout (Optional) Same as for draw
+* @param bindImageSet (Optional) Same as for draw
+*
+* @note Always binds the vertex and index buffers, as secondary command buffers don't inherit any state. Does not modify the model, so ranges can be recorded concurrently
+*/
+void vkglTF::Model::drawRange(VkCommandBuffer commandBuffer, const DrawRange& range, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	const VkDeviceSize offsets[1] = {0};
+	const VkBuffer vertexBuffer = (computeSkinning.vertexBuffer != VK_NULL_HANDLE) ? computeSkinning.vertexBuffer : vertices.buffer;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	for (uint32_t i = range.firstNode; i < range.firstNode + range.nodeCount; i++) {
+		drawPrimitives(hierarchy.nodes[i], commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+	}
+}
+
+/*
+	Multi draw indirect rendering
+*/
+
+/**
+* Get the material properties and texture descriptors shared by the indirect draws and bindless materials
+*
+* @param materialData Material properties per model material (at least one entry), texture members index into textureDescriptors
+* @param textureDescriptors Descriptors of all model textures followed by the empty texture, which is used for unused material slots
+*/
+void vkglTF::Model::getMaterialData(std::vector<IndirectDraws::MaterialData>& materialData, std::vector<VkDescriptorImageInfo>& textureDescriptors)
+{
+	// The empty texture is appended to the model's textures
+	const uint32_t emptyTextureIndex = static_cast<uint32_t>(textures.size());
+	auto textureIndex = [&](const vkglTF::Texture* texture) {
+		// Materials loaded from the scene cache reference the empty texture directly
+		return (texture && (texture != &emptyTexture)) ? static_cast<uint32_t>(texture - textures.data()) : emptyTextureIndex;
+	};
+	materialData.resize(std::max(materials.size(), (size_t)1));
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		IndirectDraws::MaterialData& data = materialData[i];
+		data = {};
+		data.baseColorFactor = material.baseColorFactor;
+		data.alphaCutoff = material.alphaCutoff;
+		data.metallicFactor = material.metallicFactor;
+		data.roughnessFactor = material.roughnessFactor;
+		data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		data.baseColorTexture = textureIndex(material.baseColorTexture);
+		data.normalTexture = textureIndex(material.normalTexture);
+		data.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+		data.occlusionTexture = textureIndex(material.occlusionTexture);
+		data.emissiveTexture = textureIndex(material.emissiveTexture);
+	}
+	textureDescriptors.clear();
+	for (auto& texture : textures) {
+		textureDescriptors.push_back(texture.descriptor);
+	}
+	textureDescriptors.push_back(emptyTexture.descriptor);
+}
+
+/**
+* Prepare drawing the whole model with indirect draws, must be called after loading the model
+*
+* The descriptor set (indirectDraws.descriptorSetLayout) that has to be bound by drawIndirect contains:
+*	Binding 0: DrawData[] (storage buffer), indexed by gl_InstanceIndex
+*	Binding 1: mat4[] node matrices (storage buffer), indexed by DrawData.nodeIndex
+*	Binding 2: MaterialData[] (storage buffer), indexed by DrawData.materialIndex
+*	Binding 3: sampler2D[] textures (fragment shader), one per model texture followed by an empty texture for unused material slots
+*
+* @param transferQueue Queue used to upload the draw commands, draw data and materials
+*
+* @note Requires the drawIndirectFirstInstance feature, multiDrawIndirect is used if enabled
+* @note Skinning is not applied by the node matrices, use compute skinning (prepareComputeSkinning) for skinned models
+*/
+void vkglTF::Model::prepareIndirectDraws(VkQueue transferQueue)
+{
+	assert(device->enabledFeatures.drawIndirectFirstInstance);
+	assert(indirectDraws.drawCount == 0);
+
+	// Sort draws by alpha mode, so drawIndirect can select the draws matching the render flags by range
+	std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+	std::vector<IndirectDraws::DrawData> drawData;
+	for (uint32_t alphaMode = Material::ALPHAMODE_OPAQUE; alphaMode <= Material::ALPHAMODE_BLEND; alphaMode++) {
+		indirectDraws.ranges[alphaMode].first = static_cast<uint32_t>(drawCommands.size());
+		for (auto node : hierarchy.nodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (auto primitive : node->mesh->primitives) {
+				if ((primitive->material.alphaMode != alphaMode) || (primitive->indexCount == 0)) {
+					continue;
+				}
+				VkDrawIndexedIndirectCommand drawCommand{};
+				drawCommand.indexCount = primitive->indexCount;
+				drawCommand.instanceCount = 1;
+				drawCommand.firstIndex = primitive->firstIndex;
+				drawCommand.firstInstance = static_cast<uint32_t>(drawCommands.size());
+				drawCommands.push_back(drawCommand);
+				drawData.push_back({ node->hierarchyIndex, static_cast<uint32_t>(&primitive->material - materials.data()) });
+				indirectDraws.bounds.push_back(glm::vec4(primitive->dimensions.center, primitive->dimensions.radius));
+				indirectDraws.primitives.push_back(primitive);
+			}
+		}
+		indirectDraws.ranges[alphaMode].count = static_cast<uint32_t>(drawCommands.size()) - indirectDraws.ranges[alphaMode].first;
+	}
+	indirectDraws.drawCount = static_cast<uint32_t>(drawCommands.size());
+	if (indirectDraws.drawCount == 0) {
+		return;
+	}
+
+	std::vector<IndirectDraws::MaterialData> materialData;
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	getMaterialData(materialData, textureDescriptors);
+
+	// Static buffers are uploaded to device local memory
+	const VkDeviceSize commandsSize = drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+	const VkDeviceSize drawDataSize = drawData.size() * sizeof(IndirectDraws::DrawData);
+	const VkDeviceSize materialsSize = materialData.size() * sizeof(IndirectDraws::MaterialData);
+	// Draw commands are also written by GPU culling
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectDraws.commandBuffer, commandsSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectDraws.drawDataBuffer, drawDataSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirectDraws.materialBuffer, materialsSize));
+
+	const VkDeviceSize drawDataStagingOffset = vks::tools::alignedVkSize(commandsSize, 16);
+	const VkDeviceSize materialsStagingOffset = vks::tools::alignedVkSize(drawDataStagingOffset + drawDataSize, 16);
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(materialsStagingOffset + materialsSize);
+	memcpy(staging.data, drawCommands.data(), commandsSize);
+	memcpy(static_cast<uint8_t*>(staging.data) + drawDataStagingOffset, drawData.data(), drawDataSize);
+	memcpy(static_cast<uint8_t*>(staging.data) + materialsStagingOffset, materialData.data(), materialsSize);
+	VkCommandBuffer copyCmd = device->beginUpload();
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.size = commandsSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, indirectDraws.commandBuffer.buffer, 1, &copyRegion);
+	copyRegion.srcOffset = staging.offset + drawDataStagingOffset;
+	copyRegion.size = drawDataSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, indirectDraws.drawDataBuffer.buffer, 1, &copyRegion);
+	copyRegion.srcOffset = staging.offset + materialsStagingOffset;
+	copyRegion.size = materialsSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, indirectDraws.materialBuffer.buffer, 1, &copyRegion);
+	device->endUpload(copyCmd, transferQueue);
+
+	// Node matrices change with animations, so they're kept in host visible memory
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &indirectDraws.nodeMatrixBuffer, hierarchy.worldMatrices.size() * sizeof(glm::mat4), hierarchy.worldMatrices.data()));
+	VK_CHECK_RESULT(indirectDraws.nodeMatrixBuffer.map());
+
+	// Descriptors
+	const uint32_t textureCount = static_cast<uint32_t>(textureDescriptors.size());
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &indirectDraws.descriptorPool));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3, textureCount),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &indirectDraws.descriptorSetLayout));
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(indirectDraws.descriptorPool, &indirectDraws.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &indirectDraws.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(indirectDraws.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirectDraws.drawDataBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirectDraws.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirectDraws.nodeMatrixBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirectDraws.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirectDraws.materialBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(indirectDraws.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, textureDescriptors.data(), textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Only available if VK_KHR_draw_indirect_count has been enabled for the device
+	indirectDraws.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+}
+
+/**
+* Draw the model with the indirect draws set up by prepareIndirectDraws
+*
+* @param commandBuffer Command buffer to record the draws to
+* @param renderFlags (Optional) Render flags selecting the alpha modes to draw (Defaults to all), BindImages is ignored as materials are fetched by the shaders
+* @param pipelineLayout (Optional) Pipeline layout to bind the indirect descriptor set with, pass VK_NULL_HANDLE if the set has already been bound
+* @param bindSet (Optional) Set index to bind the indirect descriptor set to (Defaults to 0)
+* @param countBuffer (Optional) Buffer containing the number of draws to execute (e.g. written by a culling compute shader), requires VK_KHR_draw_indirect_count
+* @param countBufferOffset (Optional) Offset of the draw count in countBuffer
+*/
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet, VkBuffer countBuffer, VkDeviceSize countBufferOffset)
+{
+	if (indirectDraws.drawCount == 0) {
+		return;
+	}
+	// Unlike bindBuffers this doesn't set buffersBound, which would skip the binds in the next command buffer recorded
+	if (!buffersBound) {
+		recordBufferBinds(commandBuffer);
+	}
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &indirectDraws.descriptorSet, 0, nullptr);
+	}
+
+	// Select the range of draws matching the render flags
+	IndirectDraws::Range range;
+	range.count = indirectDraws.drawCount;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		range = indirectDraws.ranges[Material::ALPHAMODE_OPAQUE];
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		range = indirectDraws.ranges[Material::ALPHAMODE_MASK];
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		range = indirectDraws.ranges[Material::ALPHAMODE_BLEND];
+	}
+	if (range.count == 0) {
+		return;
+	}
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	const VkDeviceSize offset = range.first * stride;
+	if ((countBuffer != VK_NULL_HANDLE) && indirectDraws.vkCmdDrawIndexedIndirectCountKHR) {
+		indirectDraws.vkCmdDrawIndexedIndirectCountKHR(commandBuffer, indirectDraws.commandBuffer.buffer, offset, countBuffer, countBufferOffset, range.count, stride);
+	} else if (device->enabledFeatures.multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, indirectDraws.commandBuffer.buffer, offset, range.count, stride);
+	} else {
+		// Without multi draw indirect, each draw command has to be issued separately
+		for (uint32_t i = 0; i < range.count; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectDraws.commandBuffer.buffer, offset + i * stride, 1, stride);
+		}
+	}
+}
+
+/*
+	Index optimization
+*/
+
+/** @brief All primitives of the model in the order of linearNodes, primitives shared by multiple nodes are only listed once */
+std::vector<vkglTF::Primitive*> vkglTF::Model::getUniquePrimitives() const
+{
+	std::vector<Primitive*> primitives;
+	std::unordered_set<const Primitive*> listed;
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			for (auto primitive : node->mesh->primitives) {
+				if (listed.insert(primitive).second) {
+					primitives.push_back(primitive);
+				}
+			}
+		}
+	}
+	return primitives;
+}
+
+/**
+* Optimize the index and vertex order of all primitives, called by loadFromFile for FileLoadingFlags::OptimizeIndices and before writing the scene cache
+*
+* The triangles of each primitive are reordered for the post-transform vertex cache and its vertices in the order they are first referenced,
+* optionally followed by sorting clusters of triangles for less overdraw. Primitives are independent, so they are optimized in parallel
+*
+* @param indexBuffer Indices of the model, reordered in place
+* @param vertexBuffer Vertices of the model, reordered in place within the vertex range of each primitive
+* @param overdraw Also optimize for overdraw
+*/
+void vkglTF::Model::optimizeIndices(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, bool overdraw)
+{
+	std::vector<Primitive*> primitives;
+	for (auto primitive : getUniquePrimitives()) {
+		if (primitive->indexCount >= 3) {
+			primitives.push_back(primitive);
+		}
+	}
+
+	std::vector<IndexStatistics> statistics(primitives.size());
+	auto optimizePrimitive = [&](size_t index) {
+		const Primitive* primitive = primitives[index];
+		uint32_t* indices = &indexBuffer[primitive->firstIndex];
+		const size_t indexCount = primitive->indexCount - primitive->indexCount % 3;
+		// The optimizer works on indices relative to the primitive's vertices
+		for (size_t i = 0; i < indexCount; i++) {
+			indices[i] -= primitive->firstVertex;
+		}
+		statistics[index].triangleCount = indexCount / 3;
+		statistics[index].cacheMissesBefore = vks::indexoptimizer::cacheMisses(indices, indexCount, primitive->vertexCount);
+		vks::indexoptimizer::optimizeVertexCache(indices, indexCount, primitive->vertexCount);
+		if (overdraw) {
+			vks::indexoptimizer::optimizeOverdraw(indices, indexCount, &vertexBuffer[primitive->firstVertex].pos, sizeof(Vertex), primitive->vertexCount);
+		}
+		// Reordering the vertices would also require reordering the morph target deltas, which are stored in the file's vertex order
+		if (primitive->morphTargetCount == 0) {
+			vks::indexoptimizer::optimizeVertexFetch(indices, indexCount, &vertexBuffer[primitive->firstVertex], primitive->vertexCount);
+		}
+		statistics[index].cacheMissesAfter = vks::indexoptimizer::cacheMisses(indices, indexCount, primitive->vertexCount);
+		for (size_t i = 0; i < indexCount; i++) {
+			indices[i] += primitive->firstVertex;
+		}
+	};
+
+	const uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(primitives.size()));
+	if (threadCount > 1) {
+		std::atomic<size_t> next(0);
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (auto& thread : threadPool.threads) {
+			thread->addJob([&] {
+				size_t i;
+				while ((i = next++) < primitives.size()) {
+					optimizePrimitive(i);
+				}
+			});
+		}
+		threadPool.wait();
+	} else {
+		for (size_t i = 0; i < primitives.size(); i++) {
+			optimizePrimitive(i);
+		}
+	}
+
+	indexStatistics = IndexStatistics();
+	for (const IndexStatistics& primitiveStatistics : statistics) {
+		indexStatistics.triangleCount += primitiveStatistics.triangleCount;
+		indexStatistics.cacheMissesBefore += primitiveStatistics.cacheMissesBefore;
+		indexStatistics.cacheMissesAfter += primitiveStatistics.cacheMissesAfter;
+	}
+}
+
+/*
+	Levels of detail
+*/
+
+/**
+* Generate simplified levels of detail for all primitives, called by loadFromFile for FileLoadingFlags::GenerateLods before writing the scene cache
+*
+* Each level is simplified from the full detail indices, so its error is measured against the full detail surface. Primitives are independent,
+* so they are simplified in parallel, the resulting indices are appended to the index buffer in primitive order
+*
+* @param indexBuffer Indices of the model, the levels of detail are appended to it
+* @param vertexBuffer Vertices of the model, simplified levels only reference existing vertices
+*/
+void vkglTF::Model::generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	std::vector<Primitive*> primitives;
+	for (auto primitive : getUniquePrimitives()) {
+		primitive->lods = { { primitive->firstIndex, primitive->indexCount, 0.0f } };
+		if (primitive->indexCount >= 3) {
+			primitives.push_back(primitive);
+		}
+	}
+
+	// Indices of the simplified levels of each primitive (relative to the primitive's vertices), with their index count and error
+	std::vector<std::vector<uint32_t>> lodIndices(primitives.size());
+	std::vector<std::vector<Primitive::Lod>> lodLevels(primitives.size());
+	auto simplifyPrimitive = [&](size_t index) {
+		const Primitive* primitive = primitives[index];
+		const size_t indexCount = primitive->indexCount - primitive->indexCount % 3;
+		std::vector<uint32_t> indices(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + indexCount);
+		for (auto& vertexIndex : indices) {
+			vertexIndex -= primitive->firstVertex;
+		}
+		size_t previousCount = indexCount;
+		float previousError = 0.0f;
+		for (uint32_t level = 1; level < lodGeneration.levelCount; level++) {
+			const size_t targetCount = static_cast<size_t>(static_cast<float>(previousCount) * lodGeneration.reduction) / 3 * 3;
+			float error;
+			std::vector<uint32_t> lod = vks::meshsimplifier::simplify(indices.data(), indices.size(), &vertexBuffer[primitive->firstVertex].pos, sizeof(Vertex), primitive->vertexCount, targetCount, &error);
+			// Stop once the primitive can't be simplified any further (e.g. because all remaining vertices are on borders or seams)
+			if (lod.empty() || (lod.size() > previousCount - previousCount / 10)) {
+				break;
+			}
+			vks::indexoptimizer::optimizeVertexCache(lod.data(), lod.size(), primitive->vertexCount);
+			previousError = std::max(previousError, error);
+			lodLevels[index].push_back({ static_cast<uint32_t>(lodIndices[index].size()), static_cast<uint32_t>(lod.size()), previousError });
+			lodIndices[index].insert(lodIndices[index].end(), lod.begin(), lod.end());
+			previousCount = lod.size();
+		}
+	};
+
+	const uint32_t threadCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(primitives.size()));
+	if (threadCount > 1) {
+		std::atomic<size_t> next(0);
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(threadCount);
+		for (auto& thread : threadPool.threads) {
+			thread->addJob([&] {
+				size_t i;
+				while ((i = next++) < primitives.size()) {
+					simplifyPrimitive(i);
+				}
+			});
+		}
+		threadPool.wait();
+	} else {
+		for (size_t i = 0; i < primitives.size(); i++) {
+			simplifyPrimitive(i);
+		}
+	}
+
+	for (size_t i = 0; i < primitives.size(); i++) {
+		const uint32_t firstIndex = static_cast<uint32_t>(indexBuffer.size());
+		for (auto lod : lodLevels[i]) {
+			lod.firstIndex += firstIndex;
+			primitives[i]->lods.push_back(lod);
+		}
+		for (uint32_t vertexIndex : lodIndices[i]) {
+			indexBuffer.push_back(vertexIndex + primitives[i]->firstVertex);
+		}
+	}
+}
+
+/**
+* Set up the screen space error based level of detail selection for the current camera
+*
+* @param cameraPosition Position of the camera in model space
+* @param fovY Vertical field of view of the projection in radians
+* @param viewportHeight Height of the viewport in pixels
+* @param maxPixelError Largest on screen error in pixels that a level of detail may have
+*/
+void vkglTF::Model::updateLodSelection(const glm::vec3& cameraPosition, float fovY, float viewportHeight, float maxPixelError)
+{
+	lodSelection.cameraPosition = cameraPosition;
+	// Pixels per unit at a distance of one, divided by the allowed error so that a projected error of one is the threshold
+	lodSelection.scale = viewportHeight / (2.0f * tanf(fovY * 0.5f)) / maxPixelError;
+}
+
+/**
+* Select the coarsest level of detail of a primitive whose error is not visible at the current camera position
+*
+* @param primitive Primitive to select the level of
+* @param center Center of the primitive's bounding sphere in model space
+* @param radius Radius of the primitive's bounding sphere in model space
+* @param scale Scale of the node the primitive is drawn with, applied to the errors
+*
+* @return Index into the primitive's levels of detail, 0 if levels of detail weren't generated or selection is disabled
+*/
+uint32_t vkglTF::Model::selectLod(const Primitive* primitive, const glm::vec3& center, float radius, float scale) const
+{
+	if ((lodSelection.scale <= 0.0f) || (primitive->lods.size() < 2)) {
+		return 0;
+	}
+	// Distance to the closest point of the bounding sphere, clamped so the camera being inside the sphere selects full detail
+	const float distance = std::max(glm::length(center - lodSelection.cameraPosition) - radius, 1e-4f);
+	uint32_t level = 0;
+	for (uint32_t i = 1; i < static_cast<uint32_t>(primitive->lods.size()); i++) {
+		if (primitive->lods[i].error * scale / distance * lodSelection.scale > 1.0f) {
+			break;
+		}
+		level = i;
+	}
+	return level;
+}
+
+/*
+	Alpha masked triangle classification
+*/
+
+/**
+* Keep the minimum and maximum alpha of each tile of an image's texels for classifyAlphaMaskedTriangles
+*
+* @param textureIndex Index of the texture the image is loaded into
+* @param pixels Pixels of the image's base level with 8 bits per component
+* @param width Width of the image
+* @param height Height of the image
+* @param components Number of components per pixel, images without an alpha channel (one or three components) are fully opaque
+*/
+void vkglTF::Model::keepAlphaMask(size_t textureIndex, const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t components)
+{
+	if (textureIndex >= alphaMasks.size()) {
+		alphaMasks.resize(textureIndex + 1);
+	}
+	AlphaMask& mask = alphaMasks[textureIndex];
+	mask.width = width;
+	mask.height = height;
+	mask.tilesX = (width + AlphaMask::tileSize - 1) / AlphaMask::tileSize;
+	mask.tilesY = (height + AlphaMask::tileSize - 1) / AlphaMask::tileSize;
+	const bool hasAlpha = (components == 2) || (components == 4);
+	mask.minAlpha.assign(mask.tilesX * mask.tilesY, 255);
+	mask.maxAlpha.assign(mask.tilesX * mask.tilesY, hasAlpha ? 0 : 255);
+	if (!hasAlpha) {
+		return;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t alpha = pixels[(static_cast<size_t>(y) * width + x) * components + components - 1];
+			const size_t tile = (y / AlphaMask::tileSize) * mask.tilesX + x / AlphaMask::tileSize;
+			mask.minAlpha[tile] = std::min(mask.minAlpha[tile], alpha);
+			mask.maxAlpha[tile] = std::max(mask.maxAlpha[tile], alpha);
+		}
+	}
+}
+
+/**
+* Sort the triangles of all alpha masked primitives into fully opaque, partially covered and fully transparent ones, called by loadFromFile for FileLoadingFlags::ClassifyAlphaMaskedTriangles
+*
+* This is a load time approximation of opacity micromaps at triangle granularity: A triangle's alpha range is bounded by the alpha tiles its texture coordinate bounds touch
+* (extended by a texel for filtering), multiplied with the range of its vertex colors' and the material's base color alpha. The bounds are conservative, so triangles that
+* may need the alpha test always end up as partially covered. Primitives whose base color image wasn't classified (e.g. KTX files) are partially covered as a whole.
+* Only the full detail triangles are sorted, generated levels of detail are stored separately and keep their order.
+*
+* @param indexBuffer Indices of the model, the triangles of alpha masked primitives are reordered in place
+* @param vertexBuffer Vertices of the model
+*/
+void vkglTF::Model::classifyAlphaMaskedTriangles(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	enum Coverage { Opaque = 0, Partial = 1, Transparent = 2 };
+	std::vector<uint32_t> sorted;
+	for (Primitive* primitive : getUniquePrimitives()) {
+		const Material& material = primitive->material;
+		if ((material.alphaMode != Material::ALPHAMODE_MASK) || (primitive->indexCount == 0)) {
+			continue;
+		}
+		// Without a base color image the alpha only depends on the vertex colors and the base color factor
+		const AlphaMask* mask = nullptr;
+		bool unknown = false;
+		if ((material.baseColorTexture != nullptr) && (material.baseColorTexture >= textures.data()) && (material.baseColorTexture < textures.data() + textures.size())) {
+			const size_t textureIndex = material.baseColorTexture - textures.data();
+			if ((textureIndex < alphaMasks.size()) && !alphaMasks[textureIndex].minAlpha.empty()) {
+				mask = &alphaMasks[textureIndex];
+			} else {
+				unknown = true;
+			}
+		}
+
+		const uint32_t triangleCount = primitive->indexCount / 3;
+		std::vector<uint8_t> coverages(triangleCount, Partial);
+		std::array<uint32_t, 3> counts{};
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			const uint32_t* triangle = &indexBuffer[primitive->firstIndex + t * 3];
+			if (!unknown) {
+				float minAlpha = material.baseColorFactor.a;
+				float maxAlpha = material.baseColorFactor.a;
+				float minVertexAlpha = 1.0f;
+				float maxVertexAlpha = 0.0f;
+				glm::vec2 minUV(FLT_MAX);
+				glm::vec2 maxUV(-FLT_MAX);
+				for (uint32_t i = 0; i < 3; i++) {
+					const Vertex& vertex = vertexBuffer[triangle[i]];
+					minVertexAlpha = std::min(minVertexAlpha, vertex.color.a);
+					maxVertexAlpha = std::max(maxVertexAlpha, vertex.color.a);
+					minUV = glm::min(minUV, vertex.uv);
+					maxUV = glm::max(maxUV, vertex.uv);
+				}
+				minAlpha *= minVertexAlpha;
+				maxAlpha *= maxVertexAlpha;
+				if (mask) {
+					// Texels touched by the triangle's bounds, wrapped with repeat addressing
+					const int64_t x0 = static_cast<int64_t>(std::floor(minUV.x * mask->width - 1.0f));
+					const int64_t x1 = static_cast<int64_t>(std::floor(maxUV.x * mask->width + 1.0f));
+					const int64_t y0 = static_cast<int64_t>(std::floor(minUV.y * mask->height - 1.0f));
+					const int64_t y1 = static_cast<int64_t>(std::floor(maxUV.y * mask->height + 1.0f));
+					const int64_t tileSize = AlphaMask::tileSize;
+					auto tileRange = [tileSize](int64_t first, int64_t last, uint32_t size, uint32_t tiles, std::vector<uint32_t>& range) {
+						range.clear();
+						if (last - first + 1 >= static_cast<int64_t>(size)) {
+							for (uint32_t i = 0; i < tiles; i++) {
+								range.push_back(i);
+							}
+							return;
+						}
+						for (int64_t texel = first; texel <= last; texel++) {
+							const uint32_t tile = static_cast<uint32_t>(((texel % size) + size) % size / tileSize);
+							if (range.empty() || (range.back() != tile)) {
+								range.push_back(tile);
+							}
+						}
+					};
+					std::vector<uint32_t> tilesX, tilesY;
+					tileRange(x0, x1, mask->width, mask->tilesX, tilesX);
+					tileRange(y0, y1, mask->height, mask->tilesY, tilesY);
+					uint8_t minTexel = 255;
+					uint8_t maxTexel = 0;
+					for (uint32_t tileY : tilesY) {
+						for (uint32_t tileX : tilesX) {
+							minTexel = std::min(minTexel, mask->minAlpha[tileY * mask->tilesX + tileX]);
+							maxTexel = std::max(maxTexel, mask->maxAlpha[tileY * mask->tilesX + tileX]);
+						}
+					}
+					minAlpha *= minTexel / 255.0f;
+					maxAlpha *= maxTexel / 255.0f;
+				}
+				// Same test as the alpha masked pipelines, which discard fragments with an alpha below the cutoff
+				if (minAlpha >= material.alphaCutoff) {
+					coverages[t] = Opaque;
+				} else if (maxAlpha < material.alphaCutoff) {
+					coverages[t] = Transparent;
+				}
+			}
+			counts[coverages[t]]++;
+		}
+
+		// Stable, so the vertex cache order within each class is kept
+		sorted.clear();
+		for (uint32_t coverage = Opaque; coverage <= Transparent; coverage++) {
+			for (uint32_t t = 0; t < triangleCount; t++) {
+				if (coverages[t] == coverage) {
+					const uint32_t* triangle = &indexBuffer[primitive->firstIndex + t * 3];
+					sorted.insert(sorted.end(), triangle, triangle + 3);
+				}
+			}
+		}
+		std::copy(sorted.begin(), sorted.end(), indexBuffer.begin() + primitive->firstIndex);
+
+		primitive->alphaCoverage.classified = true;
+		primitive->alphaCoverage.opaqueIndexCount = counts[Opaque] * 3;
+		primitive->alphaCoverage.partialIndexCount = counts[Partial] * 3;
+	}
+}
+
+/*
+	Meshlets
+*/
+
+/**
+* Partition the index buffer of all primitives into meshlets and upload them, called by loadFromFile for FileLoadingFlags::Meshlets
+*
+* Triangles are added to a meshlet in index order until it runs out of vertices or triangles, which keeps the locality of the (usually vertex cache optimized) index buffer
+*
+* @param indexBuffer Indices of the model
+* @param vertexBuffer Vertices of the model, after applying the file loading flags
+* @param transferQueue Queue used to upload the meshlet buffers
+*/
+void vkglTF::Model::prepareMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, VkQueue transferQueue)
+{
+	std::vector<Meshlets::Meshlet> meshletData;
+	std::vector<uint32_t> vertexIndices;
+	std::vector<uint32_t> triangles;
+	// Meshlet local index of each vertex of the model, UINT32_MAX if the vertex isn't part of the current meshlet
+	std::vector<uint32_t> localIndices(vertexBuffer.size(), UINT32_MAX);
+
+	Meshlets::Meshlet meshlet{};
+	auto finishMeshlet = [&]() {
+		if (meshlet.triangleCount == 0) {
+			return;
+		}
+		// Bounding sphere around the center of the meshlet's bounding box
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			const glm::vec3& pos = vertexBuffer[vertexIndices[meshlet.vertexOffset + i]].pos;
+			min = glm::min(min, pos);
+			max = glm::max(max, pos);
+		}
+		const glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			radius = std::max(radius, glm::distance(center, vertexBuffer[vertexIndices[meshlet.vertexOffset + i]].pos));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		// Normal cone of the triangles, the winding order is not consistent across flags (e.g. FlipY), so face normals are oriented along the vertex normals
+		std::vector<glm::vec3> faceNormals;
+		faceNormals.reserve(meshlet.triangleCount);
+		glm::vec3 axis(0.0f);
+		for (uint32_t i = 0; i < meshlet.triangleCount; i++) {
+			const uint32_t triangle = triangles[meshlet.triangleOffset + i];
+			const Vertex& v0 = vertexBuffer[vertexIndices[meshlet.vertexOffset + (triangle & 0xFF)]];
+			const Vertex& v1 = vertexBuffer[vertexIndices[meshlet.vertexOffset + ((triangle >> 8) & 0xFF)]];
+			const Vertex& v2 = vertexBuffer[vertexIndices[meshlet.vertexOffset + ((triangle >> 16) & 0xFF)]];
+			glm::vec3 normal = glm::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+			const float length = glm::length(normal);
+			// Degenerate triangles can't be seen from either side
+			if (length <= 0.0f) {
+				continue;
+			}
+			normal /= length;
+			if (glm::dot(normal, v0.normal + v1.normal + v2.normal) < 0.0f) {
+				normal = -normal;
+			}
+			faceNormals.push_back(normal);
+			axis += normal;
+		}
+		const float axisLength = glm::length(axis);
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		if (axisLength > 0.0f) {
+			axis /= axisLength;
+			float minDot = 1.0f;
+			for (auto& normal : faceNormals) {
+				minDot = std::min(minDot, glm::dot(axis, normal));
+			}
+			// Only cone cull if all triangles face away from the camera once it is behind the cone's plane
+			if (minDot > 0.0f) {
+				meshlet.cone = glm::vec4(axis, sqrtf(1.0f - minDot * minDot));
+			}
+		}
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			localIndices[vertexIndices[meshlet.vertexOffset + i]] = UINT32_MAX;
+		}
+		meshletData.push_back(meshlet);
+		meshlets.triangleCount += meshlet.triangleCount;
+		meshlet = Meshlets::Meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(vertexIndices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+	};
+
+	for (auto primitive : getUniquePrimitives()) {
+		primitive->firstMeshlet = static_cast<uint32_t>(meshletData.size());
+		meshlet = Meshlets::Meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(vertexIndices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+		for (uint32_t i = 0; i + 2 < primitive->indexCount; i += 3) {
+			const uint32_t* triangle = &indexBuffer[primitive->firstIndex + i];
+			uint32_t newVertices = 0;
+			for (uint32_t j = 0; j < 3; j++) {
+				if ((localIndices[triangle[j]] == UINT32_MAX) && ((j == 0) || (triangle[j] != triangle[0])) && ((j < 2) || (triangle[j] != triangle[1]))) {
+					newVertices++;
+				}
+			}
+			if ((meshlet.vertexCount + newVertices > Meshlets::maxVertices) || (meshlet.triangleCount + 1 > Meshlets::maxTriangles)) {
+				finishMeshlet();
+			}
+			uint32_t packedTriangle = 0;
+			for (uint32_t j = 0; j < 3; j++) {
+				uint32_t& localIndex = localIndices[triangle[j]];
+				if (localIndex == UINT32_MAX) {
+					localIndex = meshlet.vertexCount++;
+					vertexIndices.push_back(triangle[j]);
+				}
+				packedTriangle |= localIndex << (j * 8);
+			}
+			triangles.push_back(packedTriangle);
+			meshlet.triangleCount++;
+		}
+		finishMeshlet();
+		primitive->meshletCount = static_cast<uint32_t>(meshletData.size()) - primitive->firstMeshlet;
+	}
+
+	meshlets.count = static_cast<uint32_t>(meshletData.size());
+	if (meshlets.count == 0) {
+		return;
+	}
+
+	const VkDeviceSize meshletsSize = meshletData.size() * sizeof(Meshlets::Meshlet);
+	const VkDeviceSize vertexIndicesSize = vertexIndices.size() * sizeof(uint32_t);
+	const VkDeviceSize trianglesSize = triangles.size() * sizeof(uint32_t);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.meshletBuffer, meshletsSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.vertexIndexBuffer, vertexIndicesSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.triangleBuffer, trianglesSize));
+
+	const VkDeviceSize vertexIndicesStagingOffset = vks::tools::alignedVkSize(meshletsSize, 16);
+	const VkDeviceSize trianglesStagingOffset = vks::tools::alignedVkSize(vertexIndicesStagingOffset + vertexIndicesSize, 16);
+	vks::StagingRing::Allocation staging = device->stagingRing.allocate(trianglesStagingOffset + trianglesSize);
+	memcpy(staging.data, meshletData.data(), meshletsSize);
+	memcpy(static_cast<uint8_t*>(staging.data) + vertexIndicesStagingOffset, vertexIndices.data(), vertexIndicesSize);
+	memcpy(static_cast<uint8_t*>(staging.data) + trianglesStagingOffset, triangles.data(), trianglesSize);
+	VkCommandBuffer copyCmd = device->beginUpload();
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.size = meshletsSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, meshlets.meshletBuffer.buffer, 1, &copyRegion);
+	copyRegion.srcOffset = staging.offset + vertexIndicesStagingOffset;
+	copyRegion.size = vertexIndicesSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, meshlets.vertexIndexBuffer.buffer, 1, &copyRegion);
+	copyRegion.srcOffset = staging.offset + trianglesStagingOffset;
+	copyRegion.size = trianglesSize;
+	vkCmdCopyBuffer(copyCmd, staging.buffer, meshlets.triangleBuffer.buffer, 1, &copyRegion);
+	device->endUpload(copyCmd, transferQueue);
+
+	// Only available if VK_NV_mesh_shader has been enabled for the device
+	meshlets.vkCmdDrawMeshTasksNV = reinterpret_cast<PFN_vkCmdDrawMeshTasksNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawMeshTasksNV"));
+}
+
+/**
+* Draw the meshlets of all primitives with task and mesh shaders
+*
+* The first meshlet (uint32_t) and the meshlet count (uint32_t) of each primitive are pushed at offset 0 for the task and mesh shader stages,
+* so the task shader can select the meshlets of its workgroup. One task workgroup is launched per 32 meshlets
+*
+* @param commandBuffer Command buffer to record the draws to
+* @param renderFlags (Optional) Render flags selecting the alpha modes to draw (Defaults to all) and if material images are bound
+* @param pipelineLayout (Optional) Pipeline layout used for pushing the meshlet range and binding the material images
+* @param bindImageSet (Optional) Set index the material images are bound to (Defaults to 1)
+*
+* @note Requires the model to be loaded with FileLoadingFlags::Meshlets and VK_NV_mesh_shader to be enabled
+*/
+void vkglTF::Model::drawMeshlets(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	assert(meshlets.vkCmdDrawMeshTasksNV);
+	for (auto node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (auto primitive : node->mesh->primitives) {
+			const vkglTF::Material& material = primitive->material;
+			bool skip = (primitive->meshletCount == 0);
+			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+				skip |= (material.alphaMode != Material::ALPHAMODE_OPAQUE);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+				skip |= (material.alphaMode != Material::ALPHAMODE_MASK);
+			}
+			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+				skip |= (material.alphaMode != Material::ALPHAMODE_BLEND);
+			}
+			if (skip) {
+				continue;
+			}
+			if (renderFlags & RenderFlags::BindImages) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+			}
+			const uint32_t meshletRange[2] = { primitive->firstMeshlet, primitive->meshletCount };
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV, 0, sizeof(meshletRange), meshletRange);
+			meshlets.vkCmdDrawMeshTasksNV(commandBuffer, (primitive->meshletCount + 31) / 32, 0);
+		}
+	}
+}
+
+/*
+	Bindless materials
+*/
+
+/**
+* Prepare drawing the model without per material descriptor sets, must be called after loading the model
+*
+* The descriptor set (bindlessMaterials.descriptorSetLayout) that has to be bound by bindBindlessMaterials contains:
+*	Binding 0: MaterialData[] (storage buffer), laid out like IndirectDraws::MaterialData and indexed by the pushed material index
+*	Binding 1: sampler2D textures[] (fragment shader), partially bound with a variable descriptor count, one per model texture followed by an empty texture for unused material slots
+*
+* Draws using RenderFlags::PushMaterialIndex push the primitive's material index (uint32_t) instead of binding the material's descriptor set,
+* so the pipeline layout needs a push constant range covering pushConstantOffset for the given stages. The same indices can be used with the indirect draws (DrawData.materialIndex)
+*
+* @param transferQueue Queue used to upload the material buffer
+* @param pushConstantOffset (Optional) Offset of the material index in the pipeline layout's push constant range (Defaults to 0)
+* @param pushConstantStages (Optional) Shader stages the material index is pushed to (Defaults to the fragment shader)
+* @param maxTextureCount (Optional) Size of the texture array in the descriptor set layout, e.g. to reserve slots for textures added later (Defaults to the number of textures of this model)
+*
+* @note Requires VK_EXT_descriptor_indexing with the descriptorBindingPartiallyBound, descriptorBindingVariableDescriptorCount and runtimeDescriptorArray features enabled (see examples/descriptorindexing)
+*/
+void vkglTF::Model::prepareBindlessMaterials(VkQueue transferQueue, uint32_t pushConstantOffset, VkShaderStageFlags pushConstantStages, uint32_t maxTextureCount)
+{
+	assert(bindlessMaterials.descriptorSetLayout == VK_NULL_HANDLE);
+
+	std::vector<IndirectDraws::MaterialData> materialData;
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	getMaterialData(materialData, textureDescriptors);
+	bindlessMaterials.textureCount = static_cast<uint32_t>(textureDescriptors.size());
+	bindlessMaterials.maxTextureCount = std::max(maxTextureCount, bindlessMaterials.textureCount);
+	bindlessMaterials.pushConstantOffset = pushConstantOffset;
+	bindlessMaterials.pushConstantStages = pushConstantStages;
+
+	const VkDeviceSize materialsSize = materialData.size() * sizeof(IndirectDraws::MaterialData);
+	VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &bindlessMaterials.materialBuffer, materialsSize, materialData.data(), transferQueue));
+
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindlessMaterials.maxTextureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &bindlessMaterials.descriptorPool));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, bindlessMaterials.maxTextureCount),
+	};
+	// The texture array is declared unsized in the shaders, slots above textureCount are never written
+	std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {
+		0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
+	setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	setLayoutBindingFlags.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	setLayoutBindingFlags.pBindingFlags = bindingFlags.data();
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	descriptorLayoutCI.pNext = &setLayoutBindingFlags;
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &bindlessMaterials.descriptorSetLayout));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &bindlessMaterials.maxTextureCount;
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(bindlessMaterials.descriptorPool, &bindlessMaterials.descriptorSetLayout, 1);
+	descriptorSetAllocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &bindlessMaterials.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(bindlessMaterials.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bindlessMaterials.materialBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(bindlessMaterials.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, textureDescriptors.data(), bindlessMaterials.textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+/**
+* Bind the bindless material descriptor set, once before drawing with RenderFlags::PushMaterialIndex
+*
+* @param commandBuffer Command buffer to bind the set in
+* @param pipelineLayout Pipeline layout containing bindlessMaterials.descriptorSetLayout at bindSet
+* @param bindSet (Optional) Set index to bind the material set to (Defaults to 1, the set index used for per material images)
+*/
+void vkglTF::Model::bindBindlessMaterials(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	assert(bindlessMaterials.descriptorSet != VK_NULL_HANDLE);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &bindlessMaterials.descriptorSet, 0, nullptr);
+}
+
+/**
+* Prepare programmable vertex pulling, vertex shaders then fetch the vertices of this model from a storage buffer instead of the fixed function vertex input
+*
+* Creates a descriptor set (vertexPulling.descriptorSet) with the following bindings:
+*	Binding 0: uint[] vertex data (the vertex buffer, or the skinned vertex buffer if compute skinning has been prepared)
+*	Binding 1: Vertex layout (VertexPulling::LayoutData)
+*
+* The set layout comes from the device's layout cache, so the sets of all models prepared with the same stages are compatible with one pipeline layout.
+* Shaders decode the vertices with the functions from base/vertexpulling.glsl (base/vertexpulling.hlsl) using gl_VertexIndex, which already includes the index buffer and the draw's vertex offset,
+* so the regular (indirect) draw functions are used as is. Pipelines use an empty vertex input state.
+*
+* @param stages (Optional) Shader stages that fetch vertices (Defaults to the vertex shader)
+*
+* @note The model needs to be loaded with FileLoadingFlags::VertexPulling, call after prepareComputeSkinning if the model is skinned on the GPU
+*/
+void vkglTF::Model::prepareVertexPulling(VkShaderStageFlags stages)
+{
+	assert(vertexPulling.descriptorSet == VK_NULL_HANDLE);
+
+	// Formats of the full vertex layout match the fixed function input descriptions of the Vertex structure
+	VertexPulling::LayoutData layoutData{};
+	const uint32_t componentCount = static_cast<uint32_t>(VertexComponent::Weight0) + 1;
+	for (uint32_t i = 0; i < componentCount; i++) {
+		const VertexComponent component = static_cast<VertexComponent>(i);
+		VkFormat format = vertexLayout.compact ? vertexLayout.formats[i] : Vertex::inputAttributeDescription(0, 0, component).format;
+		uint32_t offset = vertexLayout.compact ? vertexLayout.offsets[i] : Vertex::inputAttributeDescription(0, 0, component).offset;
+		VertexPulling::Format pullingFormat = VertexPulling::Undefined;
+		switch (format) {
+			case VK_FORMAT_R32G32_SFLOAT:
+				pullingFormat = VertexPulling::Float2;
+				break;
+			case VK_FORMAT_R32G32B32_SFLOAT:
+				pullingFormat = VertexPulling::Float3;
+				break;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				pullingFormat = VertexPulling::Float4;
+				break;
+			case VK_FORMAT_R16G16_SFLOAT:
+				pullingFormat = VertexPulling::Half2;
+				break;
+			case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+				pullingFormat = VertexPulling::Snorm10x3;
+				break;
+			case VK_FORMAT_R16G16B16A16_SNORM:
+				pullingFormat = VertexPulling::Snorm16x4;
+				break;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				pullingFormat = VertexPulling::Unorm8x4;
+				break;
+			case VK_FORMAT_R8G8B8A8_USCALED:
+				pullingFormat = VertexPulling::Uint8x4;
+				break;
+			case VK_FORMAT_R16G16B16A16_USCALED:
+				pullingFormat = VertexPulling::Uint16x4;
+				break;
+			default:
+				break;
+		}
+		layoutData.formats[i / 4][i % 4] = static_cast<uint32_t>(pullingFormat);
+		layoutData.offsets[i / 4][i % 4] = offset;
+	}
+	layoutData.stride = vertexLayout.stride;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &vertexPulling.layoutBuffer, sizeof(layoutData), &layoutData));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stages, 1),
+	};
+	vertexPulling.descriptorSetLayout = device->descriptorLayoutCache.getLayout(setLayoutBindings);
+	vertexPulling.descriptorSet = descriptorAllocator.allocate(vertexPulling.descriptorSetLayout);
+	VkDescriptorBufferInfo vertexDescriptor = { (computeSkinning.vertexBuffer != VK_NULL_HANDLE) ? computeSkinning.vertexBuffer : vertices.buffer, 0, VK_WHOLE_SIZE };
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(vertexPulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &vertexDescriptor),
+		vks::initializers::writeDescriptorSet(vertexPulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &vertexPulling.layoutBuffer.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+/**
+* Bind the vertex pulling descriptor set, before drawing this model with a vertex pulling pipeline
+*
+* @param commandBuffer Command buffer to bind the set in
+* @param pipelineLayout Pipeline layout containing vertexPulling.descriptorSetLayout at bindSet
+* @param bindSet (Optional) Set index to bind the vertex pulling set to (Defaults to 1)
+*/
+void vkglTF::Model::bindVertexPulling(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	assert(vertexPulling.descriptorSet != VK_NULL_HANDLE);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &vertexPulling.descriptorSet, 0, nullptr);
+}
+
+/**
+* Prepare culling the indirect draws on the GPU, must be called after prepareIndirectDraws
+*
+* @param shaderStage Compute shader stage of the culling shader (base/cull.comp)
+* @param pipelineCache (Optional) Pipeline cache to create the compute pipeline with
+*
+* @note Call updateGpuCulling before submitting command buffers that contain the culling dispatch (recordGpuCulling)
+*/
+void vkglTF::Model::prepareGpuCulling(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+{
+	assert(gpuCulling.pipeline == VK_NULL_HANDLE);
+	if (indirectDraws.drawCount == 0) {
+		return;
+	}
+
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gpuCulling.boundsBuffer, indirectDraws.bounds.size() * sizeof(glm::vec4), indirectDraws.bounds.data()));
+	// Levels of detail of all draws, draws without generated levels only have the full detail level
+	std::vector<glm::uvec2> lodRanges;
+	std::vector<GpuCulling::LodData> lodData;
+	for (const Primitive* primitive : indirectDraws.primitives) {
+		lodRanges.push_back(glm::uvec2(static_cast<uint32_t>(lodData.size()), static_cast<uint32_t>(std::max(primitive->lods.size(), size_t(1)))));
+		lodData.push_back({ primitive->firstIndex, primitive->indexCount, 0.0f, 0 });
+		for (size_t i = 1; i < primitive->lods.size(); i++) {
+			lodData.push_back({ primitive->lods[i].firstIndex, primitive->lods[i].indexCount, primitive->lods[i].error, 0 });
+		}
+	}
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gpuCulling.lodRangeBuffer, lodRanges.size() * sizeof(glm::uvec2), lodRanges.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gpuCulling.lodBuffer, lodData.size() * sizeof(GpuCulling::LodData), lodData.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gpuCulling.uniformBuffer, sizeof(GpuCulling::UniformData)));
+	VK_CHECK_RESULT(gpuCulling.uniformBuffer.map());
+	// Nothing is culled until the first update
+	for (auto& plane : gpuCulling.uniformData.frustumPlanes) {
+		plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	gpuCulling.uniformData.lodSelection = glm::vec4(lodSelection.cameraPosition, lodSelection.scale);
+	gpuCulling.uniformData.drawCount = indirectDraws.drawCount;
+	memcpy(gpuCulling.uniformBuffer.mapped, &gpuCulling.uniformData, sizeof(GpuCulling::UniformData));
+
+	// Descriptors
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &gpuCulling.descriptorPool));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		// Binding 0: Draw commands
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		// Binding 1: Draw data
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		// Binding 2: Node matrices
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		// Binding 3: Draw bounds
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		// Binding 4: Frustum planes and level of detail selection
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		// Binding 5: Level of detail ranges of the draws
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		// Binding 6: Levels of detail
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &gpuCulling.descriptorSetLayout));
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(gpuCulling.descriptorPool, &gpuCulling.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &gpuCulling.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirectDraws.commandBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirectDraws.drawDataBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirectDraws.nodeMatrixBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &gpuCulling.boundsBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &gpuCulling.uniformBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &gpuCulling.lodRangeBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(gpuCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &gpuCulling.lodBuffer.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Pipeline
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&gpuCulling.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &gpuCulling.pipelineLayout));
+	VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(gpuCulling.pipelineLayout, 0);
+	pipelineCI.stage = shaderStage;
+	VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &gpuCulling.pipeline));
+}
+
+/**
+* Update the frustum the indirect draws are culled against, along with the current level of detail selection (see updateLodSelection)
+*
+* @param viewProjection Matrix transforming the model's (world) space to clip space, including the model matrix if one is used by the shaders
+*/
+void vkglTF::Model::updateGpuCulling(const glm::mat4& viewProjection)
+{
+	if (gpuCulling.pipeline == VK_NULL_HANDLE) {
+		return;
+	}
+	vks::Frustum frustum;
+	frustum.update(viewProjection);
+	for (size_t i = 0; i < frustum.planes.size(); i++) {
+		gpuCulling.uniformData.frustumPlanes[i] = frustum.planes[i];
+	}
+	gpuCulling.uniformData.lodSelection = glm::vec4(lodSelection.cameraPosition, lodSelection.scale);
+	memcpy(gpuCulling.uniformBuffer.mapped, &gpuCulling.uniformData, sizeof(GpuCulling::UniformData));
+}
+
+/**
+* Record the culling dispatch, must be recorded outside of a render pass before drawIndirect
+*
+* @param commandBuffer Command buffer to record the dispatch to
+*/
+void vkglTF::Model::recordGpuCulling(VkCommandBuffer commandBuffer)
+{
+	if (gpuCulling.pipeline == VK_NULL_HANDLE) {
+		return;
+	}
+
+	// Previous draws must have finished reading the draw commands before they're overwritten
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuCulling.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuCulling.pipelineLayout, 0, 1, &gpuCulling.descriptorSet, 0, nullptr);
+	vkCmdDispatch(commandBuffer, (indirectDraws.drawCount + 63) / 64, 1, 1);
+
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = indirectDraws.commandBuffer.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
+{
+	if (node->mesh) {
+		for (Primitive *primitive : node->mesh->primitives) {
+			glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * node->getMatrix();
 			glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * node->getMatrix();
 			if (locMin.x < min.x) { min.x = locMin.x; }
 			if (locMin.y < min.y) { min.y = locMin.y; }
@@ -1470,6 +4378,162 @@ void vkglTF::Model::getSceneDimensions()
 	dimensions.radius = glm::distance(dimensions.min, dimensions.max) / 2.0f;
 }
 
+/*
+	glTF animation sampler
+*/
+
+/**
+* Find the keyframe interval containing a point in time
+*
+* @param time Time to look up
+* @param index Index of the keyframe at the start of the interval
+* @param u Position within the interval (0..1)
+*
+* @return False if the time is outside of the sampler's keyframes
+*/
+bool vkglTF::AnimationSampler::findInterval(float time, uint32_t& index, float& u)
+{
+	if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back())) {
+		return false;
+	}
+	const uint32_t lastInterval = static_cast<uint32_t>(inputs.size()) - 2;
+	if (cursor > lastInterval) {
+		cursor = 0;
+	}
+	// Try the cached interval and the ones right after it first, fall back to a binary search if time jumped (e.g. on looping)
+	bool found = false;
+	if (time >= inputs[cursor]) {
+		for (uint32_t i = 0; (i < 4) && (cursor <= lastInterval); i++) {
+			if (time <= inputs[cursor + 1]) {
+				found = true;
+				break;
+			}
+			cursor++;
+		}
+	}
+	if (!found) {
+		const auto upper = std::upper_bound(inputs.begin(), inputs.end(), time);
+		cursor = static_cast<uint32_t>(std::max<ptrdiff_t>(std::distance(inputs.begin(), upper) - 1, 0));
+		cursor = std::min(cursor, lastInterval);
+	}
+	index = cursor;
+	const float duration = inputs[index + 1] - inputs[index];
+	u = (duration > 0.0f) ? std::min(std::max(0.0f, time - inputs[index]) / duration, 1.0f) : 0.0f;
+	return true;
+}
+
+/**
+* Evaluate the sampler at a point in time
+*
+* @param time Time to evaluate the sampler at
+* @param rotation True if the outputs are quaternions (stored as x, y, z, w), which are interpolated spherically
+* @param value Interpolated value
+*
+* @return False if the time is outside of the sampler's keyframes
+*/
+bool vkglTF::AnimationSampler::evaluate(float time, bool rotation, glm::vec4& value)
+{
+	if ((time == evaluatedTime) && (rotation == evaluatedRotation)) {
+		value = evaluatedValue;
+		return evaluatedValid;
+	}
+	evaluatedTime = time;
+	evaluatedRotation = rotation;
+	evaluatedValid = false;
+
+	const size_t stride = (interpolation == CUBICSPLINE) ? 3 : 1;
+	if (outputsVec4.size() < inputs.size() * stride) {
+		return false;
+	}
+	uint32_t i;
+	float u;
+	if (!findInterval(time, i, u)) {
+		return false;
+	}
+
+	switch (interpolation) {
+	case STEP:
+		value = outputsVec4[i];
+		break;
+	case CUBICSPLINE: {
+		// Hermite spline, tangents are scaled by the duration of the interval
+		const float duration = inputs[i + 1] - inputs[i];
+		const glm::vec4 p0 = outputsVec4[i * 3 + 1];
+		const glm::vec4 m0 = outputsVec4[i * 3 + 2] * duration;
+		const glm::vec4 p1 = outputsVec4[(i + 1) * 3 + 1];
+		const glm::vec4 m1 = outputsVec4[(i + 1) * 3] * duration;
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		value = (2.0f * u3 - 3.0f * u2 + 1.0f) * p0 + (u3 - 2.0f * u2 + u) * m0 + (-2.0f * u3 + 3.0f * u2) * p1 + (u3 - u2) * m1;
+		if (rotation) {
+			value = glm::normalize(value);
+		}
+		break;
+	}
+	default:
+		if (rotation) {
+			const glm::vec4& a = outputsVec4[i];
+			const glm::vec4& b = outputsVec4[i + 1];
+			const glm::quat q = glm::normalize(glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), u));
+			value = glm::vec4(q.x, q.y, q.z, q.w);
+		} else {
+			value = glm::mix(outputsVec4[i], outputsVec4[i + 1], u);
+		}
+		break;
+	}
+
+	evaluatedValue = value;
+	evaluatedValid = true;
+	return true;
+}
+
+/**
+* Evaluate a morph target weight sampler at a point in time
+*
+* @param time Time to evaluate the sampler at
+* @param weights Interpolated weights, only the weights of targets stored in the sampler are written
+*
+* @return False if the time is outside of the sampler's keyframes
+*/
+bool vkglTF::AnimationSampler::evaluateWeights(float time, std::vector<float>& weights)
+{
+	const size_t stride = (interpolation == CUBICSPLINE) ? 3 : 1;
+	if (inputs.empty() || weights.empty()) {
+		return false;
+	}
+	const size_t targetCount = outputsFloat.size() / (inputs.size() * stride);
+	uint32_t i;
+	float u;
+	if ((targetCount == 0) || !findInterval(time, i, u)) {
+		return false;
+	}
+
+	const size_t count = std::min(targetCount, weights.size());
+	for (size_t t = 0; t < count; t++) {
+		switch (interpolation) {
+		case STEP:
+			weights[t] = outputsFloat[i * targetCount + t];
+			break;
+		case CUBICSPLINE: {
+			// Keyframes store the in-tangents, values and out-tangents of all targets
+			const float duration = inputs[i + 1] - inputs[i];
+			const float p0 = outputsFloat[(i * 3 + 1) * targetCount + t];
+			const float m0 = outputsFloat[(i * 3 + 2) * targetCount + t] * duration;
+			const float p1 = outputsFloat[((i + 1) * 3 + 1) * targetCount + t];
+			const float m1 = outputsFloat[((i + 1) * 3) * targetCount + t] * duration;
+			const float u2 = u * u;
+			const float u3 = u2 * u;
+			weights[t] = (2.0f * u3 - 3.0f * u2 + 1.0f) * p0 + (u3 - 2.0f * u2 + u) * m0 + (-2.0f * u3 + 3.0f * u2) * p1 + (u3 - u2) * m1;
+			break;
+		}
+		default:
+			weights[t] = glm::mix(outputsFloat[i * targetCount + t], outputsFloat[(i + 1) * targetCount + t], u);
+			break;
+		}
+	}
+	return true;
+}
+
 void vkglTF::Model::updateAnimation(uint32_t index, float time)
 {
 	if (index > static_cast<uint32_t>(animations.size()) - 1) {
@@ -1481,50 +4545,654 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 	bool updated = false;
 	for (auto& channel : animation.channels) {
 		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+		// Morph target weights don't affect the node's transform
+		if (channel.path == vkglTF::AnimationChannel::PathType::WEIGHTS) {
+			Mesh* mesh = channel.node->mesh;
+			if (mesh && sampler.evaluateWeights(time, mesh->morphWeights)) {
+				updateMorphWeights(mesh);
+			}
+			continue;
+		}
+		glm::vec4 value;
+		if (!sampler.evaluate(time, channel.path == vkglTF::AnimationChannel::PathType::ROTATION, value)) {
+			continue;
+		}
+		switch (channel.path) {
+		case vkglTF::AnimationChannel::PathType::TRANSLATION:
+			channel.node->translation = glm::vec3(value);
+			break;
+		case vkglTF::AnimationChannel::PathType::SCALE:
+			channel.node->scale = glm::vec3(value);
+			break;
+		case vkglTF::AnimationChannel::PathType::ROTATION:
+			channel.node->rotation = glm::quat(value.w, value.x, value.y, value.z);
+			break;
+		default:
+			break;
+		}
+		markDirty(channel.node);
+		updated = true;
+	}
+	if (updated) {
+		updateTransforms();
+	}
+}
+
+/*
+	Batched animation evaluation
+	Keyframes are blended four tracks at a time with SSE2 (or NEON on 64 bit ARM), with a scalar loop for platforms without either
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKGLTF_SSE_ANIMATION 1
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define VKGLTF_NEON_ANIMATION 1
+#endif
+
+/*
+	Blends the keyframes of a group of tracks in place: the first keyframe's components are replaced by the result
+	Keys are stored as components x, y, z, w of the first keyframe, x, y, z, w of the second keyframe and the interpolation factor, count floats each
+	Rotations use a normalized lerp along the shorter arc instead of slerp, which is close enough for the small angles between consecutive keyframes
+*/
+void blendAnimationKeys(float* keys, uint32_t count, bool rotations)
+{
+	float* a[4] = { keys, keys + count, keys + count * 2, keys + count * 3 };
+	const float* b[4] = { keys + count * 4, keys + count * 5, keys + count * 6, keys + count * 7 };
+	const float* u = keys + count * 8;
+	uint32_t i = 0;
+#if defined(VKGLTF_SSE_ANIMATION)
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 minLength = _mm_set1_ps(1e-12f);
+	for (; i + 4 <= count; i += 4) {
+		__m128 va[4], vb[4];
+		for (uint32_t c = 0; c < 4; c++) {
+			va[c] = _mm_loadu_ps(a[c] + i);
+			vb[c] = _mm_loadu_ps(b[c] + i);
+		}
+		const __m128 vu = _mm_loadu_ps(u + i);
+		if (rotations) {
+			// Flip the second quaternion if both are more than 90 degrees apart
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va[0], vb[0]), _mm_mul_ps(va[1], vb[1])), _mm_add_ps(_mm_mul_ps(va[2], vb[2]), _mm_mul_ps(va[3], vb[3])));
+			const __m128 flip = _mm_and_ps(dot, signBit);
+			for (uint32_t c = 0; c < 4; c++) {
+				vb[c] = _mm_xor_ps(vb[c], flip);
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			va[c] = _mm_add_ps(va[c], _mm_mul_ps(_mm_sub_ps(vb[c], va[c]), vu));
+		}
+		if (rotations) {
+			const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(va[0], va[0]), _mm_mul_ps(va[1], va[1])), _mm_add_ps(_mm_mul_ps(va[2], va[2]), _mm_mul_ps(va[3], va[3])));
+			const __m128 length = _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLength));
+			for (uint32_t c = 0; c < 4; c++) {
+				va[c] = _mm_div_ps(va[c], length);
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			_mm_storeu_ps(a[c] + i, va[c]);
+		}
+	}
+#elif defined(VKGLTF_NEON_ANIMATION)
+	const float32x4_t minLength = vdupq_n_f32(1e-12f);
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t va[4], vb[4];
+		for (uint32_t c = 0; c < 4; c++) {
+			va[c] = vld1q_f32(a[c] + i);
+			vb[c] = vld1q_f32(b[c] + i);
+		}
+		const float32x4_t vu = vld1q_f32(u + i);
+		if (rotations) {
+			// Flip the second quaternion if both are more than 90 degrees apart
+			const float32x4_t dot = vaddq_f32(vaddq_f32(vmulq_f32(va[0], vb[0]), vmulq_f32(va[1], vb[1])), vaddq_f32(vmulq_f32(va[2], vb[2]), vmulq_f32(va[3], vb[3])));
+			const uint32x4_t flip = vandq_u32(vreinterpretq_u32_f32(dot), vdupq_n_u32(0x80000000));
+			for (uint32_t c = 0; c < 4; c++) {
+				vb[c] = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vb[c]), flip));
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			va[c] = vfmaq_f32(va[c], vsubq_f32(vb[c], va[c]), vu);
+		}
+		if (rotations) {
+			const float32x4_t lengthSquared = vaddq_f32(vaddq_f32(vmulq_f32(va[0], va[0]), vmulq_f32(va[1], va[1])), vaddq_f32(vmulq_f32(va[2], va[2]), vmulq_f32(va[3], va[3])));
+			const float32x4_t length = vsqrtq_f32(vmaxq_f32(lengthSquared, minLength));
+			for (uint32_t c = 0; c < 4; c++) {
+				va[c] = vdivq_f32(va[c], length);
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			vst1q_f32(a[c] + i, va[c]);
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		float sign = 1.0f;
+		if (rotations && (a[0][i] * b[0][i] + a[1][i] * b[1][i] + a[2][i] * b[2][i] + a[3][i] * b[3][i] < 0.0f)) {
+			sign = -1.0f;
+		}
+		for (uint32_t c = 0; c < 4; c++) {
+			a[c][i] += (sign * b[c][i] - a[c][i]) * u[i];
+		}
+		if (rotations) {
+			const float length = std::sqrt(std::max(a[0][i] * a[0][i] + a[1][i] * a[1][i] + a[2][i] * a[2][i] + a[3][i] * a[3][i], 1e-12f));
+			for (uint32_t c = 0; c < 4; c++) {
+				a[c][i] /= length;
+			}
+		}
+	}
+}
+
+/**
+* Add a model to the batch
+*
+* @param model Model to animate, a model can only be added once as its nodes hold a single pose
+* @param animationIndex Index of the model's animation that is evaluated for it
+*
+* @return Index of the model in the batch, used to set its animation time
+*/
+uint32_t vkglTF::AnimationBatch::add(Model* model, uint32_t animationIndex)
+{
+	assert(animationIndex < model->animations.size());
+	assert(std::none_of(entries.begin(), entries.end(), [model](const Entry& entry) { return entry.model == model; }));
+	Entry entry;
+	entry.model = model;
+	entry.animation = &model->animations[animationIndex];
+	for (auto& channel : entry.animation->channels) {
+		AnimationSampler* sampler = &entry.animation->samplers[channel.samplerIndex];
+		const bool batched = (channel.path != AnimationChannel::PathType::WEIGHTS) && (sampler->interpolation != AnimationSampler::CUBICSPLINE) && (sampler->outputsVec4.size() >= sampler->inputs.size());
+		if (!batched) {
+			entry.scalarChannels.push_back(&channel);
 			continue;
 		}
+		Tracks& tracks = (channel.path == AnimationChannel::PathType::ROTATION) ? entry.rotations : entry.vectors;
+		tracks.tracks.push_back({ channel.node, sampler, channel.path });
+	}
+	// Pad the arrays to a multiple of the SIMD width, so the blend loop doesn't need a tail for most tracks
+	for (Tracks* tracks : { &entry.rotations, &entry.vectors }) {
+		tracks->paddedCount = (static_cast<uint32_t>(tracks->tracks.size()) + 3) & ~3u;
+		tracks->keys.assign(tracks->paddedCount * 9, 0.0f);
+		tracks->valid.assign(tracks->tracks.size(), 0);
+	}
+	entries.push_back(std::move(entry));
+	return static_cast<uint32_t>(entries.size()) - 1;
+}
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
+/** @brief Set the time the animation of a model is evaluated at with the next update */
+void vkglTF::AnimationBatch::setTime(uint32_t index, float time)
+{
+	entries[index].time = time;
+}
+
+void vkglTF::AnimationBatch::clear()
+{
+	entries.clear();
+}
+
+/** @brief Find the keyframes of all tracks in a group and store them in the group's key arrays */
+void vkglTF::AnimationBatch::gather(Tracks& tracks, float time)
+{
+	const uint32_t count = tracks.paddedCount;
+	float* keys = tracks.keys.data();
+	for (size_t t = 0; t < tracks.tracks.size(); t++) {
+		AnimationSampler* sampler = tracks.tracks[t].sampler;
+		uint32_t i;
+		float u;
+		tracks.valid[t] = sampler->findInterval(time, i, u) ? 1 : 0;
+		if (!tracks.valid[t]) {
+			continue;
+		}
+		const glm::vec4& a = sampler->outputsVec4[i];
+		const glm::vec4& b = sampler->outputsVec4[i + 1];
+		for (uint32_t c = 0; c < 4; c++) {
+			keys[c * count + t] = a[c];
+			keys[(c + 4) * count + t] = b[c];
+		}
+		keys[8 * count + t] = (sampler->interpolation == AnimationSampler::STEP) ? 0.0f : u;
+	}
+}
+
+/** @brief Evaluate all channels of a model and update its transforms */
+void vkglTF::AnimationBatch::evaluate(Entry& entry)
+{
+	Model* model = entry.model;
+	bool updated = false;
+
+	gather(entry.rotations, entry.time);
+	blendAnimationKeys(entry.rotations.keys.data(), entry.rotations.paddedCount, true);
+	gather(entry.vectors, entry.time);
+	blendAnimationKeys(entry.vectors.keys.data(), entry.vectors.paddedCount, false);
+
+	// Rotations are stored as x, y, z, w (see AnimationSampler::outputsVec4)
+	const float* rotations = entry.rotations.keys.data();
+	const uint32_t rotationCount = entry.rotations.paddedCount;
+	for (size_t t = 0; t < entry.rotations.tracks.size(); t++) {
+		if (entry.rotations.valid[t]) {
+			Node* node = entry.rotations.tracks[t].node;
+			node->rotation = glm::quat(rotations[3 * rotationCount + t], rotations[t], rotations[rotationCount + t], rotations[2 * rotationCount + t]);
+			model->markDirty(node);
+			updated = true;
+		}
+	}
+	const float* vectors = entry.vectors.keys.data();
+	const uint32_t vectorCount = entry.vectors.paddedCount;
+	for (size_t t = 0; t < entry.vectors.tracks.size(); t++) {
+		if (entry.vectors.valid[t]) {
+			const Track& track = entry.vectors.tracks[t];
+			const glm::vec3 value(vectors[t], vectors[vectorCount + t], vectors[2 * vectorCount + t]);
+			if (track.path == AnimationChannel::PathType::TRANSLATION) {
+				track.node->translation = value;
+			} else {
+				track.node->scale = value;
 			}
+			model->markDirty(track.node);
+			updated = true;
+		}
+	}
+
+	for (AnimationChannel* channel : entry.scalarChannels) {
+		AnimationSampler& sampler = entry.animation->samplers[channel->samplerIndex];
+		if (channel->path == AnimationChannel::PathType::WEIGHTS) {
+			Mesh* mesh = channel->node->mesh;
+			if (mesh && sampler.evaluateWeights(entry.time, mesh->morphWeights)) {
+				model->updateMorphWeights(mesh);
+			}
+			continue;
+		}
+		glm::vec4 value;
+		if (!sampler.evaluate(entry.time, channel->path == AnimationChannel::PathType::ROTATION, value)) {
+			continue;
+		}
+		switch (channel->path) {
+		case AnimationChannel::PathType::TRANSLATION:
+			channel->node->translation = glm::vec3(value);
+			break;
+		case AnimationChannel::PathType::SCALE:
+			channel->node->scale = glm::vec3(value);
+			break;
+		case AnimationChannel::PathType::ROTATION:
+			channel->node->rotation = glm::quat(value.w, value.x, value.y, value.z);
+			break;
+		default:
+			break;
 		}
+		model->markDirty(channel->node);
+		updated = true;
 	}
+
 	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+		model->updateTransforms();
+	}
+}
+
+/**
+* Evaluate the animations of all models at their current times and update their transforms
+*
+* @param jobSystem (Optional) Job system the models are split across, models are evaluated on the calling thread if not set
+*
+* @note Models don't share any state, so they can be evaluated in any order, but two batches must not contain the same model
+*/
+void vkglTF::AnimationBatch::update(vks::JobSystem* jobSystem)
+{
+	const uint32_t count = size();
+	if (jobSystem && (count > 1)) {
+		jobSystem->parallelFor(count, [this](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				evaluate(entries[i]);
+			}
+		});
+	} else {
+		for (auto& entry : entries) {
+			evaluate(entry);
+		}
+	}
+}
+
+/*
+	Flattened node hierarchy
+*/
+
+/** @brief (Re)builds the flattened hierarchy from the node tree, must be called whenever nodes are added or removed */
+void vkglTF::Model::buildHierarchy()
+{
+	hierarchy = Hierarchy();
+	hierarchy.nodes.reserve(linearNodes.size());
+	// Depth first traversal, so every node is preceded by its parent
+	std::vector<Node*> stack(nodes.rbegin(), nodes.rend());
+	while (!stack.empty()) {
+		Node* node = stack.back();
+		stack.pop_back();
+		node->hierarchyIndex = static_cast<uint32_t>(hierarchy.nodes.size());
+		hierarchy.nodes.push_back(node);
+		hierarchy.parents.push_back(node->parent ? static_cast<int32_t>(node->parent->hierarchyIndex) : -1);
+		stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+	}
+	const size_t nodeCount = hierarchy.nodes.size();
+	hierarchy.localMatrices.resize(nodeCount);
+	hierarchy.worldMatrices.resize(nodeCount);
+	hierarchy.dirty.assign(nodeCount, 1);
+	hierarchy.changed.assign(nodeCount, 0);
+}
+
+/** @brief Flag a node whose translation, rotation, scale or matrix has been changed, so its transform is updated with the next call to updateTransforms */
+void vkglTF::Model::markDirty(Node* node)
+{
+	if (node->hierarchyIndex < hierarchy.dirty.size()) {
+		hierarchy.dirty[node->hierarchyIndex] = 1;
+	}
+}
+
+/** @brief Update the world matrices of all dirty nodes and their children, and the transform buffer blocks of the meshes affected by them */
+void vkglTF::Model::updateTransforms()
+{
+	const size_t nodeCount = hierarchy.nodes.size();
+	bool anyChanged = false;
+	for (size_t i = 0; i < nodeCount; i++) {
+		const int32_t parent = hierarchy.parents[i];
+		const bool parentChanged = (parent >= 0) && hierarchy.changed[parent];
+		if (hierarchy.dirty[i]) {
+			hierarchy.localMatrices[i] = hierarchy.nodes[i]->localMatrix();
+		}
+		if (hierarchy.dirty[i] || parentChanged) {
+			hierarchy.worldMatrices[i] = (parent >= 0) ? hierarchy.worldMatrices[parent] * hierarchy.localMatrices[i] : hierarchy.localMatrices[i];
+			hierarchy.changed[i] = 1;
+			anyChanged = true;
+		} else {
+			hierarchy.changed[i] = 0;
+		}
+		hierarchy.dirty[i] = 0;
+	}
+	if (!anyChanged) {
+		return;
+	}
+
+	// Node matrices used by indirect draws
+	if (indirectDraws.nodeMatrixBuffer.mapped) {
+		glm::mat4* nodeMatrices = static_cast<glm::mat4*>(indirectDraws.nodeMatrixBuffer.mapped);
+		for (size_t i = 0; i < nodeCount; i++) {
+			if (hierarchy.changed[i]) {
+				nodeMatrices[i] = hierarchy.worldMatrices[i];
+			}
+		}
+	}
+
+	// Blocks are updated in the host copy first, so the changed range is written to the transform buffer at once instead of scattering writes per mesh
+	uint32_t firstChanged = UINT32_MAX;
+	uint32_t lastChanged = 0;
+	for (size_t i = 0; i < nodeCount; i++) {
+		Node* node = hierarchy.nodes[i];
+		if (!node->mesh || (transforms.count == 0)) {
+			continue;
+		}
+		const glm::mat4& m = hierarchy.worldMatrices[i];
+		Mesh* mesh = node->mesh;
+		Mesh::UniformBlock* block = transforms.block(mesh->transformIndex);
+		if (node->skin) {
+			Skin* skin = node->skin;
+			// Skinned meshes also need to be updated if only one of their joints moved
+			bool jointsChanged = hierarchy.changed[i] != 0;
+			for (size_t j = 0; (j < skin->joints.size()) && !jointsChanged; j++) {
+				jointsChanged = hierarchy.changed[skin->joints[j]->hierarchyIndex] != 0;
+			}
+			if (!jointsChanged) {
+				continue;
+			}
+			block->matrix = m;
+			// Update joint matrices, the uniform block only has room for a fixed number of joints while the compute skinning buffer stores all of them
+			const glm::mat4 inverseTransform = glm::inverse(m);
+			const size_t maxUniformJoints = sizeof(block->jointMatrix) / sizeof(glm::mat4);
+			for (size_t j = 0; j < skin->joints.size(); j++) {
+				const glm::mat4 jointMatrix = inverseTransform * hierarchy.worldMatrices[skin->joints[j]->hierarchyIndex] * skin->inverseBindMatrices[j];
+				if (j < maxUniformJoints) {
+					block->jointMatrix[j] = jointMatrix;
+				}
+				if (computeSkinning.jointMatrices) {
+					computeSkinning.jointMatrices[mesh->jointOffset + j] = jointMatrix;
+				}
+			}
+			block->jointcount = (float)std::min(skin->joints.size(), maxUniformJoints);
+		} else if (hierarchy.changed[i]) {
+			block->matrix = m;
+		} else {
+			continue;
+		}
+		firstChanged = std::min(firstChanged, mesh->transformIndex);
+		lastChanged = std::max(lastChanged, mesh->transformIndex);
+	}
+	if (firstChanged <= lastChanged) {
+		const VkDeviceSize offset = firstChanged * transforms.stride;
+		const VkDeviceSize size = (lastChanged - firstChanged) * transforms.stride + sizeof(Mesh::UniformBlock);
+		memcpy(static_cast<uint8_t*>(transforms.buffer.mapped) + offset, transforms.hostData.data() + offset, size);
+	}
+}
+
+/**
+* Place the uniform blocks of all meshes in a single buffer, must be called after the hierarchy has been built
+* Replaces a buffer, allocation and mapping per mesh, and gives the meshes consecutive transform indices in hierarchy order
+* Meshes sharing their primitives are placed next to each other, so they can be drawn as instances indexing the buffer with the instance index
+*/
+void vkglTF::Model::prepareTransforms()
+{
+	// Group the meshes by their (shared) primitives, groups are ordered by their first node in the hierarchy
+	std::vector<std::vector<Mesh*>> groups;
+	std::unordered_map<const Primitive*, size_t> groupIndices;
+	for (Node* node : hierarchy.nodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		const Primitive* key = node->mesh->primitives.empty() ? nullptr : node->mesh->primitives.front();
+		auto group = key ? groupIndices.find(key) : groupIndices.end();
+		if (group != groupIndices.end()) {
+			groups[group->second].push_back(node->mesh);
+		} else {
+			if (key) {
+				groupIndices[key] = groups.size();
+			}
+			groups.push_back({ node->mesh });
+		}
+	}
+	std::vector<Mesh*> meshes;
+	instanceGroups.clear();
+	for (auto& group : groups) {
+		instanceGroups.push_back({ group.front(), static_cast<uint32_t>(meshes.size()), static_cast<uint32_t>(group.size()) });
+		for (Mesh* mesh : group) {
+			mesh->transformIndex = static_cast<uint32_t>(meshes.size());
+			meshes.push_back(mesh);
+		}
+	}
+	transforms.count = static_cast<uint32_t>(meshes.size());
+	if (transforms.count == 0) {
+		return;
+	}
+	// Blocks are bound as ranges of the buffer, so they need to start at offsets valid for both uniform and storage buffers
+	const VkDeviceSize alignment = std::max(device->properties.limits.minUniformBufferOffsetAlignment, device->properties.limits.minStorageBufferOffsetAlignment);
+	transforms.stride = (sizeof(Mesh::UniformBlock) + alignment - 1) & ~(alignment - 1);
+	transforms.hostData.assign(transforms.stride * transforms.count, 0);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &transforms.buffer, transforms.hostData.size()));
+	VK_CHECK_RESULT(transforms.buffer.map());
+	for (Mesh* mesh : meshes) {
+		const VkDeviceSize offset = mesh->transformIndex * transforms.stride;
+		*transforms.block(mesh->transformIndex) = mesh->uniformBlock;
+		mesh->uniformBuffer.buffer = transforms.buffer.buffer;
+		mesh->uniformBuffer.descriptor = { transforms.buffer.buffer, offset, sizeof(Mesh::UniformBlock) };
+		mesh->uniformBuffer.mapped = static_cast<uint8_t*>(transforms.buffer.mapped) + offset;
+	}
+	memcpy(transforms.buffer.mapped, transforms.hostData.data(), transforms.hostData.size());
+}
+
+/*
+	Compute skinning
+*/
+
+/**
+* Prepare skinning the model's vertices in a compute shader, instead of doing so in the vertex shaders of every pass
+*
+* @param shaderStage Compute shader stage of the skinning shader (base/skinning.comp)
+* @param queue Compute capable queue used to initialize the skinned vertex buffer
+* @param pipelineCache (Optional) Pipeline cache to create the compute pipeline with
+*
+* @note The model needs to be loaded with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT set in vkglTF::memoryPropertyFlags
+* @note Skinned vertices are output in the space of their mesh's node, so they are drawn with the same (node matrix) shaders as static meshes
+* @note Morph targets are blended by the same dispatches before skinning, meshes that are only morphed get dispatches of their own
+*/
+void vkglTF::Model::prepareComputeSkinning(VkPipelineShaderStageCreateInfo shaderStage, VkQueue queue, VkPipelineCache pipelineCache)
+{
+	assert(memoryPropertyFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	assert(computeSkinning.pipeline == VK_NULL_HANDLE);
+	// The skinning shader works on the full vertex layout
+	assert(!vertexLayout.compact);
+
+	// Assign each skinned mesh a range in the joint buffer
+	uint32_t jointCount = 0;
+	for (auto node : hierarchy.nodes) {
+		if (node->mesh && (node->skin || !node->mesh->morphWeights.empty())) {
+			const uint32_t jointOffset = node->skin ? jointCount : 0xFFFFFFFE;
+			node->mesh->jointOffset = jointOffset;
+			for (auto primitive : node->mesh->primitives) {
+				if (node->skin || (primitive->morphTargetCount > 0)) {
+					computeSkinning.dispatches.push_back({ primitive->firstVertex, primitive->vertexCount, jointOffset, primitive->firstMorphDelta, primitive->morphTargetCount, node->mesh->morphWeightOffset });
+				}
+			}
+			if (node->skin) {
+				jointCount += static_cast<uint32_t>(node->skin->joints.size());
+			}
+		}
+	}
+	if (computeSkinning.dispatches.empty()) {
+		return;
+	}
+
+	// Morph target deltas are static and uploaded to device local memory, the weights are written by the host whenever they change (see updateMorphWeights)
+	// Both buffers need to exist for the descriptors, even if the model has no morph targets
+	if (morphTargets.deltas.empty()) {
+		morphTargets.deltas.push_back({ glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) });
+	}
+	const VkDeviceSize deltaBufferSize = morphTargets.deltas.size() * sizeof(MorphTargets::Delta);
+	vks::Buffer deltaStaging;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &deltaStaging, deltaBufferSize, morphTargets.deltas.data()));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &morphTargets.deltaBuffer, deltaBufferSize));
+	device->copyBuffer(&deltaStaging, &morphTargets.deltaBuffer, queue);
+	deltaStaging.destroy();
+	morphTargets.deltas.clear();
+	morphTargets.deltas.shrink_to_fit();
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &morphTargets.weightBuffer, std::max(morphTargets.weightCount, 1u) * sizeof(float)));
+	VK_CHECK_RESULT(morphTargets.weightBuffer.map());
+
+	// Joint matrices are written by the host each time the transforms are updated
+	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, std::max(jointCount, 1u) * sizeof(glm::mat4));
+	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &computeSkinning.jointBuffer));
+	VK_CHECK_RESULT(device->memoryAllocator.allocateBufferMemory(computeSkinning.jointBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, &computeSkinning.jointAllocation));
+	computeSkinning.jointMatrices = static_cast<glm::mat4*>(computeSkinning.jointAllocation.mapped);
+
+	const VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(vertices.count) * vertexLayout.stride;
+	bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | memoryPropertyFlags, vertexBufferSize);
+	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &computeSkinning.vertexBuffer));
+	VK_CHECK_RESULT(device->memoryAllocator.allocateBufferMemory(computeSkinning.vertexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &computeSkinning.vertexAllocation));
+	device->memoryAllocator.tag(computeSkinning.vertexAllocation, vks::MemoryCategory::Geometry, "glTF skinned vertices");
+
+	// Descriptors
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5)
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &computeSkinning.descriptorPool));
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		// Binding 0: Source vertices
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		// Binding 1: Skinned vertices
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		// Binding 2: Joint matrices
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		// Binding 3: Morph target deltas
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		// Binding 4: Morph target weights
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &computeSkinning.descriptorSetLayout));
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(computeSkinning.descriptorPool, &computeSkinning.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &computeSkinning.descriptorSet));
+	VkDescriptorBufferInfo sourceDescriptor = { vertices.buffer, 0, vertexBufferSize };
+	VkDescriptorBufferInfo skinnedDescriptor = { computeSkinning.vertexBuffer, 0, vertexBufferSize };
+	VkDescriptorBufferInfo jointDescriptor = { computeSkinning.jointBuffer, 0, VK_WHOLE_SIZE };
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceDescriptor),
+		vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &skinnedDescriptor),
+		vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &jointDescriptor),
+		vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &morphTargets.deltaBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(computeSkinning.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &morphTargets.weightBuffer.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Pipeline
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputeSkinning::Dispatch), 0);
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&computeSkinning.descriptorSetLayout, 1);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vks::createPipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &computeSkinning.pipelineLayout));
+	VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(computeSkinning.pipelineLayout, 0);
+	pipelineCI.stage = shaderStage;
+	VK_CHECK_RESULT(vks::createComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &computeSkinning.pipeline));
+
+	// Initialize the skinned vertex buffer with all source vertices once, so the per frame dispatches only need to write the skinned attributes
+	VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipelineLayout, 0, 1, &computeSkinning.descriptorSet, 0, nullptr);
+	const ComputeSkinning::Dispatch copyDispatch = { 0, static_cast<uint32_t>(vertices.count), UINT32_MAX, 0, 0, 0 };
+	vkCmdPushConstants(commandBuffer, computeSkinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(copyDispatch), &copyDispatch);
+	vkCmdDispatch(commandBuffer, (copyDispatch.vertexCount + 63) / 64, 1, 1);
+	device->flushCommandBuffer(commandBuffer, queue, true);
+
+	// Fill the joint and weight buffers with the current pose
+	for (auto node : hierarchy.nodes) {
+		if (node->mesh && node->skin) {
+			markDirty(node);
+		}
+		if (node->mesh) {
+			updateMorphWeights(node->mesh);
 		}
 	}
+	updateTransforms();
+}
+
+/** @brief Copy a mesh's morph target weights to the weight buffer read by the compute skinning pass, called by updateAnimation for animated weights */
+void vkglTF::Model::updateMorphWeights(Mesh* mesh)
+{
+	if (!morphTargets.weightBuffer.mapped || mesh->morphWeights.empty()) {
+		return;
+	}
+	float* weights = static_cast<float*>(morphTargets.weightBuffer.mapped) + mesh->morphWeightOffset;
+	memcpy(weights, mesh->morphWeights.data(), mesh->morphWeights.size() * sizeof(float));
+}
+
+/**
+* Record the skinning dispatches, must be recorded outside of a render pass before any draws using the model's vertices
+*
+* @param commandBuffer Command buffer to record the dispatches to
+*/
+void vkglTF::Model::recordComputeSkinning(VkCommandBuffer commandBuffer)
+{
+	if (computeSkinning.pipeline == VK_NULL_HANDLE) {
+		return;
+	}
+
+	// Previous draws must have finished reading the skinned vertices before they're overwritten
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeSkinning.pipelineLayout, 0, 1, &computeSkinning.descriptorSet, 0, nullptr);
+	for (auto& dispatch : computeSkinning.dispatches) {
+		vkCmdPushConstants(commandBuffer, computeSkinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(dispatch), &dispatch);
+		vkCmdDispatch(commandBuffer, (dispatch.vertexCount + 63) / 64, 1, 1);
+	}
+
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = computeSkinning.vertexBuffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
 }
 
 /*
@@ -1557,12 +5225,7 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 
 void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
 	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+		node->mesh->uniformBuffer.descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 
 		VkWriteDescriptorSet writeDescriptorSet{};
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
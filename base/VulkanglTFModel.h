@@ -12,9 +12,12 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <unordered_map>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanMipGenerator.h"
+#include "renderqueue.hpp"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -35,6 +38,12 @@
 #include <android/asset_manager.h>
 #endif
 
+namespace vks
+{
+	class JobSystem;
+	class AssetTimer;
+}
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
@@ -42,10 +51,38 @@ namespace vkglTF
 		ImageNormalMap = 0x00000002
 	};
 
+	/*
+		Scene cache, if enabled the processed result of loading a glTF file is stored next to it and loaded from there on the next start
+		The cache is rebuilt if the glTF file changes, changes to external buffers or images are not detected
+	*/
+	enum CacheFlags {
+		CacheScene = 0x00000001,
+		// Store the full mip chain of images in the cache, so they don't need to be generated on the GPU at load time
+		CacheMipmaps = 0x00000002
+	};
+
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	extern uint32_t cacheFlags;
+
+	/*
+		Post-transform vertex cache efficiency of loaded index buffers, as average cache miss ratio (ACMR, vertex shader invocations per triangle)
+		of a simulated FIFO cache (see vks::indexoptimizer::cacheMisses), in file order and after the optimization
+		Only gathered for models loaded with FileLoadingFlags::OptimizeIndices (or from the scene cache)
+	*/
+	struct IndexStatistics {
+		uint64_t triangleCount = 0;
+		uint64_t cacheMissesBefore = 0;
+		uint64_t cacheMissesAfter = 0;
+		float acmrBefore() const { return (triangleCount > 0) ? (float)cacheMissesBefore / (float)triangleCount : 0.0f; }
+		float acmrAfter() const { return (triangleCount > 0) ? (float)cacheMissesAfter / (float)triangleCount : 0.0f; }
+	};
+	// Accumulated over all optimized models loaded so far
+	extern IndexStatistics loadedIndexStatistics;
+	// Optional compute mip generator used instead of blits for images without a full mip chain, set by examples that prepared one
+	extern vks::MipGenerator* mipGenerator;
 
 	struct Node;
 
@@ -57,6 +94,7 @@ namespace vkglTF
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		vks::Allocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -66,6 +104,11 @@ namespace vkglTF
 		void updateDescriptor();
 		void destroy();
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void fromPixels(const unsigned char* data, uint32_t width, uint32_t height, uint32_t levelCount, vks::VulkanDevice* device, VkQueue copyQueue, const std::string& cacheKey = "", VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+		bool fromCache(const std::string& cacheKey, vks::VulkanDevice* device);
+		void addToCache(const std::string& cacheKey);
+		void createSamplerAndView(VkFormat format);
+		VkSamplerCreateInfo samplerCreateInfo() const;
 	};
 
 	/*
@@ -91,7 +134,7 @@ namespace vkglTF
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		void createDescriptorSet(vks::DescriptorAllocator& descriptorAllocator, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
 	/*
@@ -102,6 +145,33 @@ namespace vkglTF
 		uint32_t indexCount;
 		uint32_t firstVertex;
 		uint32_t vertexCount;
+		// Range of meshlets, only set if the model is loaded with FileLoadingFlags::Meshlets
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+		// Morph target deltas of the primitive in the model's morph target buffer (see Model::MorphTargets)
+		uint32_t firstMorphDelta = 0;
+		uint32_t morphTargetCount = 0;
+		/*
+			Levels of detail, only generated if the model is loaded with FileLoadingFlags::GenerateLods
+			Level 0 is the full detail range (firstIndex, indexCount), the simplified levels' indices are stored behind all full detail indices
+			Error is the geometric deviation from the full detail level in model units, increasing with each level
+		*/
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+		std::vector<Lod> lods;
+		/*
+			Coverage of the triangles of an alpha masked primitive, only set if the model is loaded with FileLoadingFlags::ClassifyAlphaMaskedTriangles
+			The primitive's triangles are sorted into fully opaque, partially covered and fully transparent ones (in that order),
+			so e.g. ray tracing only needs to run the alpha test for the partially covered ones and can skip the transparent ones altogether
+		*/
+		struct AlphaCoverage {
+			bool classified = false;
+			uint32_t opaqueIndexCount = 0;
+			uint32_t partialIndexCount = 0;
+		} alphaCoverage;
 		Material& material;
 
 		struct Dimensions {
@@ -125,12 +195,12 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		std::string name;
 
+		// Range of the mesh's uniform block in the model's transform buffer (see Model::Transforms), meshes don't own any buffers of their own
 		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDescriptorBufferInfo descriptor{};
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
+			void* mapped = nullptr;
 		} uniformBuffer;
 
 		struct UniformBlock {
@@ -139,8 +209,16 @@ namespace vkglTF
 			float jointcount{ 0 };
 		} uniformBlock;
 
+		// Offset of the mesh's joint matrices in the model's compute skinning joint buffer
+		uint32_t jointOffset = 0;
+		// Morph target weights, set from the node or mesh defaults and animated by weight channels
+		std::vector<float> morphWeights;
+		// Offset of the mesh's weights in the model's morph target weight buffer
+		uint32_t morphWeightOffset = 0;
+		// Index of the mesh's uniform block in the model's transform buffer
+		uint32_t transformIndex = 0;
+
 		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
-		~Mesh();
 	};
 
 	/*
@@ -168,6 +246,8 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		// Position of the node in the model's flattened hierarchy
+		uint32_t hierarchyIndex = 0;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
 		void update();
@@ -178,7 +258,7 @@ namespace vkglTF
 		glTF animation channel
 	*/
 	struct AnimationChannel {
-		enum PathType { TRANSLATION, ROTATION, SCALE };
+		enum PathType { TRANSLATION, ROTATION, SCALE, WEIGHTS };
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
@@ -191,7 +271,20 @@ namespace vkglTF
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
 		std::vector<float> inputs;
+		// For cubic spline interpolation each keyframe stores an in-tangent, the value and an out-tangent
 		std::vector<glm::vec4> outputsVec4;
+		// Scalar outputs of morph target weight samplers, with one value per target and keyframe (times three for cubic splines)
+		std::vector<float> outputsFloat;
+		// Keyframe interval found by the last lookup, time usually only advances a little between updates so lookups start there
+		uint32_t cursor = 0;
+		// Result of the last evaluation, so samplers shared by several channels are only evaluated once per update
+		float evaluatedTime = -std::numeric_limits<float>::max();
+		bool evaluatedRotation = false;
+		bool evaluatedValid = false;
+		glm::vec4 evaluatedValue{};
+		bool findInterval(float time, uint32_t& index, float& u);
+		bool evaluate(float time, bool rotation, glm::vec4& value);
+		bool evaluateWeights(float time, std::vector<float>& weights);
 	};
 
 	/*
@@ -226,6 +319,11 @@ namespace vkglTF
 		static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
 		/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		/** @brief Returns the pipeline vertex input state create info structure for the position only vertex buffer (location 0) */
+		static VkPipelineVertexInputStateCreateInfo* getPositionVertexInputState();
+		static VkVertexInputBindingDescription positionInputBindingDescription;
+		static VkVertexInputAttributeDescription positionInputAttributeDescription;
+		static VkPipelineVertexInputStateCreateInfo positionPipelineVertexInputStateCreateInfo;
 	};
 
 	enum FileLoadingFlags {
@@ -233,14 +331,51 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Store vertices in a compact, quantized layout with only the components listed in Model::compactVertexComponents
+		CompactVertices = 0x00000010,
+		// Also create a tightly packed position only vertex buffer for depth and shadow passes (see Model::bindPositionBuffers)
+		PositionStream = 0x00000020,
+		// Partition the primitives into meshlets for rendering with task and mesh shaders (see Model::drawMeshlets), can't be combined with CompactVertices
+		Meshlets = 0x00000040,
+		// Reorder the triangles of each primitive for the post-transform vertex cache and its vertices for fetch locality, always applied for the scene cache
+		OptimizeIndices = 0x00000080,
+		// Also sort clusters of triangles to reduce overdraw, at a small cost in vertex cache efficiency (implies OptimizeIndices)
+		OptimizeOverdraw = 0x00000100,
+		// Generate simplified levels of detail for each primitive (see Model::lodGeneration and Model::updateLodSelection)
+		GenerateLods = 0x00000200,
+		// Keep a copy of the processed vertices and full detail indices on the host (see Model::hostData), e.g. for building CPU side acceleration structures
+		KeepHostData = 0x00000400,
+		// Also allow vertex shaders to fetch the vertices from a storage buffer (see Model::prepareVertexPulling)
+		VertexPulling = 0x00000800,
+		// Sort the triangles of alpha masked primitives by their coverage of the base color texture's alpha (see Primitive::alphaCoverage)
+		ClassifyAlphaMaskedTriangles = 0x00001000,
+		// Only keep the geometry on the host (see Model::hostData) instead of creating vertex and index buffers, e.g. for models streamed into a vks::SparseGeometryPool
+		// Can't be combined with PositionStream, Meshlets or VertexPulling, which need the model's buffers
+		HostGeometryOnly = 0x00002000
 	};
 
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
-		RenderAlphaBlendedNodes = 0x00000008
+		RenderAlphaBlendedNodes = 0x00000008,
+		// Push the index of each primitive's material instead of binding its descriptor set (see prepareBindlessMaterials)
+		PushMaterialIndex = 0x00000010,
+		// Push the index of each node's mesh in the transform buffer instead of binding a descriptor set per mesh (see Model::Transforms)
+		PushTransformIndex = 0x00000020
+	};
+
+	/*
+		glTF file that has been read and decoded on the host (including its images and compressed buffer views), but not loaded into a model yet
+		Parsing doesn't use the device's queues, so it can run on a worker thread (see Model::parseFile and Model::loadFromParsedFile)
+	*/
+	struct ParsedFile {
+		std::string filename;
+		uint32_t fileLoadingFlags = 0;
+		tinygltf::Model gltfModel;
+		bool valid = false;
+		std::string error;
 	};
 
 	/*
@@ -251,9 +386,45 @@ namespace vkglTF
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		std::string getCacheFilename(const std::string& filename);
+		bool loadFromCache(const std::string& filename, VkQueue transferQueue, uint32_t fileLoadingFlags, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+		void writeCache(const std::string& filename, const tinygltf::Model& gltfModel, uint32_t fileLoadingFlags, const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+		void recordBufferBinds(VkCommandBuffer commandBuffer);
+		void setupCompactVertexLayout(const std::vector<Vertex>& vertexBuffer);
+		void optimizeIndices(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, bool overdraw);
+		void generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+		uint32_t selectLod(const Primitive* primitive, const glm::vec3& center, float radius, float scale) const;
+		void prepareTransforms();
+		std::vector<Primitive*> getUniquePrimitives() const;
+		// Meshes whose primitives are shared by later nodes referencing the same glTF mesh, only used while loading
+		bool shareMeshes = false;
+		std::unordered_map<int, Mesh*> sharedMeshes;
+		void prepareMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, VkQueue transferQueue);
+		// Minimum and maximum alpha of the images per tile of texels, only kept while loading with FileLoadingFlags::ClassifyAlphaMaskedTriangles
+		struct AlphaMask {
+			static const uint32_t tileSize = 8;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t tilesX = 0;
+			uint32_t tilesY = 0;
+			std::vector<uint8_t> minAlpha;
+			std::vector<uint8_t> maxAlpha;
+		};
+		std::vector<AlphaMask> alphaMasks;
+		bool keepAlphaMasks = false;
+		void keepAlphaMask(size_t textureIndex, const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t components);
+		void classifyAlphaMaskedTriangles(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+		void packVertices(const std::vector<Vertex>& vertexBuffer, std::vector<uint8_t>& packedVertices);
+		void parseFile(const std::string& filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, ParsedFile& parsedFile, vks::AssetTimer* assetTimer);
+		void load(const std::string& filename, ParsedFile* parsedFile, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale);
+		void drawPrimitives(const Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		VkVertexInputBindingDescription vertexInputBindingDescription;
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		/** @brief Descriptor sets of the nodes and materials, released along with the model */
+		vks::DescriptorAllocator descriptorAllocator;
 
 		struct Vertices {
 			int count;
@@ -261,14 +432,66 @@ namespace vkglTF
 			VkDeviceMemory memory;
 		} vertices;
 		struct Indices {
+			// Number of full detail indices, generated levels of detail are stored behind them (see Primitive::lods)
 			int count;
 			VkBuffer buffer;
 			VkDeviceMemory memory;
 		} indices;
+		// Position only vertex buffer, only created if the model is loaded with FileLoadingFlags::PositionStream
+		struct Positions {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+		} positions;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
 
+		/*
+			Flattened node hierarchy, nodes are sorted so that parents always come before their children
+			Transforms are updated in a single pass over these arrays, only nodes marked dirty (and their children) are recalculated
+		*/
+		struct Hierarchy {
+			std::vector<Node*> nodes;
+			std::vector<int32_t> parents;
+			std::vector<glm::mat4> localMatrices;
+			std::vector<glm::mat4> worldMatrices;
+			std::vector<uint8_t> dirty;
+			std::vector<uint8_t> changed;
+		} hierarchy;
+
+		/*
+			Uniform blocks (matrix and joint matrices) of all meshes in a single host visible buffer
+			The blocks are updated in a host side copy and written to the buffer in one contiguous range per call to updateTransforms
+			Shaders can either bind the per mesh descriptor sets (descriptorSetLayoutUbo, a range of this buffer each) or bind descriptorSet once
+			and index the storage buffer with the transform index pushed for each node (RenderFlags::PushTransformIndex)
+		*/
+		struct Transforms {
+			vks::Buffer buffer;
+			// Distance between the blocks, aligned to the device's uniform and storage buffer offset alignments
+			VkDeviceSize stride = 0;
+			uint32_t count = 0;
+			std::vector<uint8_t> hostData;
+			// Push constant range the transform index is written to by RenderFlags::PushTransformIndex
+			VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+			uint32_t pushConstantOffset = 0;
+			// Storage buffer with all blocks at binding 0
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			Mesh::UniformBlock* block(uint32_t index) { return reinterpret_cast<Mesh::UniformBlock*>(hostData.data() + index * stride); }
+		} transforms;
+
+		/*
+			Nodes referencing the same glTF mesh share one copy of its geometry (unless they are skinned, morphed or the vertices are pre-transformed)
+			The transform indices of such nodes are consecutive, so each group is drawn with a single instanced draw per primitive (see drawInstanced)
+		*/
+		struct InstanceGroup {
+			// Mesh of the first node in the group, all meshes of the group share its primitives
+			const Mesh* mesh;
+			uint32_t firstTransform;
+			uint32_t instanceCount;
+		};
+		std::vector<InstanceGroup> instanceGroups;
+
 		std::vector<Skin*> skins;
 
 		std::vector<Texture> textures;
@@ -283,6 +506,261 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		// Host copy of the vertex and index buffers, only filled if the model is loaded with FileLoadingFlags::KeepHostData
+		struct HostData {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+		} hostData;
+
+		/*
+			Morph targets of all primitives
+			Deltas are stored per primitive as deltas[firstMorphDelta + target * vertexCount + vertex] and blended by the compute skinning pass
+		*/
+		struct MorphTargets {
+			struct Delta {
+				glm::vec4 position;
+				glm::vec4 normal;
+				glm::vec4 tangent;
+			};
+			// Host copy of the deltas, released once they have been uploaded by prepareComputeSkinning
+			std::vector<Delta> deltas;
+			uint32_t weightCount = 0;
+			vks::Buffer deltaBuffer;
+			vks::Buffer weightBuffer;
+		} morphTargets;
+
+		/*
+			Optional compute skinning (see prepareComputeSkinning)
+			Skinned and morphed positions, normals and tangents are written to a separate vertex buffer, which bindBuffers binds in place of the source vertices
+		*/
+		struct ComputeSkinning {
+			VkBuffer vertexBuffer = VK_NULL_HANDLE;
+			vks::Allocation vertexAllocation;
+			// Joint matrices of all skinned meshes, updated along with the node transforms
+			VkBuffer jointBuffer = VK_NULL_HANDLE;
+			vks::Allocation jointAllocation;
+			glm::mat4* jointMatrices = nullptr;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			// Matches the shader's push constant block, jointOffset is 0xFFFFFFFE for meshes that are only morphed and 0xFFFFFFFF for the plain copy of all vertices
+			struct Dispatch {
+				uint32_t firstVertex;
+				uint32_t vertexCount;
+				uint32_t jointOffset;
+				uint32_t firstMorphDelta;
+				uint32_t morphTargetCount;
+				uint32_t morphWeightOffset;
+			};
+			std::vector<Dispatch> dispatches;
+		} computeSkinning;
+
+		/*
+			Optional multi draw indirect rendering (see prepareIndirectDraws)
+			All primitives are drawn with a single indirect draw per alpha mode, node matrices and materials are fetched by the shaders instead of being bound per draw
+		*/
+		struct IndirectDraws {
+			// Per primitive draw data, indexed by gl_InstanceIndex (firstInstance of the draw command)
+			struct DrawData {
+				uint32_t nodeIndex;
+				uint32_t materialIndex;
+			};
+			// Material properties as laid out in the material buffer (std430), texture members are indices into the texture array
+			struct MaterialData {
+				glm::vec4 baseColorFactor;
+				float alphaCutoff;
+				float metallicFactor;
+				float roughnessFactor;
+				uint32_t alphaMode;
+				uint32_t baseColorTexture;
+				uint32_t normalTexture;
+				uint32_t metallicRoughnessTexture;
+				uint32_t occlusionTexture;
+				uint32_t emissiveTexture;
+				uint32_t padding[3];
+			};
+			// Range of draw commands for each material alpha mode
+			struct Range {
+				uint32_t first = 0;
+				uint32_t count = 0;
+			} ranges[3];
+			uint32_t drawCount = 0;
+			// Bounding spheres of the draws in node space (xyz = center, w = radius)
+			std::vector<glm::vec4> bounds;
+			// Primitive of each draw
+			std::vector<const Primitive*> primitives;
+			vks::Buffer commandBuffer;
+			vks::Buffer drawDataBuffer;
+			vks::Buffer materialBuffer;
+			// World space matrices of all hierarchy nodes, updated along with the node transforms
+			vks::Buffer nodeMatrixBuffer;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+		} indirectDraws;
+
+		/*
+			Optional bindless materials (see prepareBindlessMaterials)
+			All model textures are put into one partially bound sampler array and all material parameters into a storage buffer, so draws select their material by index instead of binding a descriptor set per material
+		*/
+		struct BindlessMaterials {
+			// Material properties laid out like IndirectDraws::MaterialData, indexed by the pushed material index
+			vks::Buffer materialBuffer;
+			// Number of textures written to the texture array (model textures followed by the empty texture)
+			uint32_t textureCount = 0;
+			// Upper bound of the texture array's variable descriptor count
+			uint32_t maxTextureCount = 0;
+			// Push constant range the material index is written to by RenderFlags::PushMaterialIndex
+			VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_FRAGMENT_BIT;
+			uint32_t pushConstantOffset = 0;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		} bindlessMaterials;
+
+		/*
+			Optional programmable vertex pulling (see prepareVertexPulling), requires the model to be loaded with FileLoadingFlags::VertexPulling
+			Vertex shaders fetch the components of gl_VertexIndex from the vertex buffer bound as a storage buffer and decode them as described by the layout buffer (see base/vertexpulling.glsl),
+			so pipelines are created without vertex input state and the same pipeline draws models with the full and the compact vertex layout
+		*/
+		struct VertexPulling {
+			// Component formats as decoded by the shaders
+			enum Format {
+				Undefined = 0,
+				Float2,
+				Float3,
+				Float4,
+				Half2,
+				Snorm10x3,
+				Snorm16x4,
+				Unorm8x4,
+				Uint8x4,
+				Uint16x4
+			};
+			// Vertex layout as laid out in the layout buffer (std140), offsets are in bytes and formats are indexed by VertexComponent
+			struct LayoutData {
+				glm::uvec4 offsets[2];
+				glm::uvec4 formats[2];
+				uint32_t stride;
+				uint32_t padding[3];
+			};
+			vks::Buffer layoutBuffer;
+			// Vertex buffer at binding 0, layout buffer at binding 1
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		} vertexPulling;
+
+		/*
+			Optional GPU frustum culling of the indirect draws (see prepareGpuCulling)
+			A compute shader sets the instance count of all draw commands, so culling doesn't require the CPU to touch per primitive visibility or re-record command buffers
+		*/
+		struct GpuCulling {
+			struct UniformData {
+				glm::vec4 frustumPlanes[6];
+				// xyz = camera position, w = level of detail scale (0 disables level of detail selection)
+				glm::vec4 lodSelection;
+				uint32_t drawCount;
+			} uniformData;
+			// Levels of detail as laid out in the level buffer (std430)
+			struct LodData {
+				uint32_t firstIndex;
+				uint32_t indexCount;
+				float error;
+				uint32_t padding;
+			};
+			vks::Buffer uniformBuffer;
+			vks::Buffer boundsBuffer;
+			// Range of levels in the level buffer for each draw (first, count)
+			vks::Buffer lodRangeBuffer;
+			vks::Buffer lodBuffer;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+		} gpuCulling;
+
+		/*
+			Compact vertex layout, used if the model is loaded with FileLoadingFlags::CompactVertices
+			Normals and tangents are stored as 10:10:10:2 (or 16 bit) snorm, UVs as half floats, colors and weights as 8 bit unorm and joints as 8 bit integers
+			Pipelines need to use the vertex input state returned by Model::getPipelineVertexInputState
+		*/
+		std::vector<VertexComponent> compactVertexComponents = { VertexComponent::Position, VertexComponent::Normal, VertexComponent::UV };
+		struct VertexLayout {
+			bool compact = false;
+			uint32_t stride = sizeof(Vertex);
+			// Format and offset of each vertex component indexed by VertexComponent, components that aren't stored have VK_FORMAT_UNDEFINED
+			VkFormat formats[7] = {};
+			uint32_t offsets[7] = {};
+		} vertexLayout;
+
+		// Vertex cache efficiency of this model's index buffer, only set if it was optimized (see FileLoadingFlags::OptimizeIndices)
+		IndexStatistics indexStatistics;
+
+		/*
+			Level of detail generation, used if the model is loaded with FileLoadingFlags::GenerateLods
+			Each level targets reduction times the indices of the previous level, generation stops early for primitives that can't be simplified any further
+		*/
+		struct LodGeneration {
+			uint32_t levelCount = 4;
+			float reduction = 0.5f;
+		} lodGeneration;
+
+		/*
+			Screen space error based level of detail selection, used by drawCulled and the GPU culling (see updateLodSelection)
+			The coarsest level whose error projects to at most one unit of scale is drawn, a scale of 0 always draws full detail
+		*/
+		struct LodSelection {
+			glm::vec3 cameraPosition = glm::vec3(0.0f);
+			float scale = 0.0f;
+		} lodSelection;
+
+		/*
+			Meshlets, only created if the model is loaded with FileLoadingFlags::Meshlets
+			Each primitive is split into meshlets of up to maxVertices vertices and maxTriangles triangles, with bounds in the space of the vertex buffer
+			(i.e. world space if the model is loaded with FileLoadingFlags::PreTransformVertices) that task shaders can cull meshlets against
+		*/
+		struct Meshlets {
+			static const uint32_t maxVertices = 64;
+			// 124 instead of 126 keeps the primitive index output of a meshlet (a byte per index) a multiple of 4 bytes
+			static const uint32_t maxTriangles = 124;
+			// Meshlet as laid out in the meshlet buffer (std430)
+			struct Meshlet {
+				// Offsets into the vertex index and triangle buffers
+				uint32_t vertexOffset;
+				uint32_t triangleOffset;
+				uint32_t vertexCount;
+				uint32_t triangleCount;
+				// Bounding sphere (xyz = center, w = radius)
+				glm::vec4 sphere;
+				// Normal cone (xyz = axis, w = cutoff), the cutoff is 1.0 for meshlets whose triangles face in too different directions to be cone culled
+				glm::vec4 cone;
+			};
+			uint32_t count = 0;
+			uint32_t triangleCount = 0;
+			vks::Buffer meshletBuffer;
+			// Indices into the model's vertex buffer, vertexCount per meshlet
+			vks::Buffer vertexIndexBuffer;
+			// Meshlet local vertex indices of each triangle, packed into one uint32_t (8 bits each)
+			vks::Buffer triangleBuffer;
+			PFN_vkCmdDrawMeshTasksNV vkCmdDrawMeshTasksNV = nullptr;
+		} meshlets;
+
+	public:
+
+		/*
+			Consecutive nodes of the flattened hierarchy that are recorded into one command buffer (see getDrawRanges and drawRange)
+			Ranges are independent of each other, so they can be recorded into secondary command buffers on multiple threads
+		*/
+		struct DrawRange {
+			uint32_t firstNode = 0;
+			uint32_t nodeCount = 0;
+			uint32_t primitiveCount = 0;
+		};
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
@@ -291,18 +769,88 @@ namespace vkglTF
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
+		void decodeImages(tinygltf::Model& gltfModel, std::vector<std::vector<unsigned char>>& encodedImages);
+		void decodeCompressedBufferViews(tinygltf::Model& gltfModel);
 		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		void parseFile(const std::string& filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags, ParsedFile& parsedFile);
+		void loadFromParsedFile(ParsedFile& parsedFile, vks::VulkanDevice* device, VkQueue transferQueue, float scale = 1.0f);
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
-		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void bindPositionBuffers(VkCommandBuffer commandBuffer);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		void enqueueDraws(vks::RenderQueue& queue, const glm::vec3& cameraPosition, const VkPipeline pipelines[3], uint32_t firstPass = 0, uint32_t renderFlags = RenderFlags::BindImages, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+		void drawInstanced(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawCulled(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawMeshlets(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		std::vector<DrawRange> getDrawRanges(uint32_t maxRangeCount);
+		void drawRange(VkCommandBuffer commandBuffer, const DrawRange& range, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void getMaterialData(std::vector<IndirectDraws::MaterialData>& materialData, std::vector<VkDescriptorImageInfo>& textureDescriptors);
+		void prepareIndirectDraws(VkQueue transferQueue);
+		void drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 0, VkBuffer countBuffer = VK_NULL_HANDLE, VkDeviceSize countBufferOffset = 0);
+		void prepareBindlessMaterials(VkQueue transferQueue, uint32_t pushConstantOffset = 0, VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_FRAGMENT_BIT, uint32_t maxTextureCount = 0);
+		void bindBindlessMaterials(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet = 1);
+		void prepareVertexPulling(VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT);
+		void bindVertexPulling(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet = 1);
+		void prepareGpuCulling(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		void updateGpuCulling(const glm::mat4& viewProjection);
+		void recordGpuCulling(VkCommandBuffer commandBuffer);
+		void updateLodSelection(const glm::vec3& cameraPosition, float fovY, float viewportHeight, float maxPixelError = 1.0f);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
+		void buildHierarchy();
+		void markDirty(Node* node);
+		void updateTransforms();
+		void prepareComputeSkinning(VkPipelineShaderStageCreateInfo shaderStage, VkQueue queue, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		void recordComputeSkinning(VkCommandBuffer commandBuffer);
+		void updateMorphWeights(Mesh* mesh);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
 	};
+
+	/*
+		Batched animation evaluation for many models
+		The linear and step channels of all added models are gathered in structure of arrays form, so the keyframes of four channels are blended at once with SIMD
+		(lerp for translations and scales, nlerp for rotations), and the results are written to the nodes and marked in the models' flattened hierarchies
+		Models are split across a job system, each job evaluates the channels of its models and updates their transforms, so nothing is left for the calling thread
+		Cubic spline and morph target weight channels use the samplers' scalar evaluation
+	*/
+	class AnimationBatch {
+	private:
+		struct Track {
+			Node* node;
+			AnimationSampler* sampler;
+			AnimationChannel::PathType path;
+		};
+		// Keyframes of a group of tracks, with the first and second keyframe's components and the interpolation factor stored in separate arrays of paddedCount floats each
+		struct Tracks {
+			std::vector<Track> tracks;
+			std::vector<float> keys;
+			std::vector<uint8_t> valid;
+			uint32_t paddedCount = 0;
+		};
+		struct Entry {
+			Model* model;
+			Animation* animation;
+			float time = 0.0f;
+			Tracks rotations;
+			// Translations and scales
+			Tracks vectors;
+			std::vector<AnimationChannel*> scalarChannels;
+		};
+		std::vector<Entry> entries;
+		void gather(Tracks& tracks, float time);
+		void evaluate(Entry& entry);
+	public:
+		uint32_t add(Model* model, uint32_t animationIndex);
+		void setTime(uint32_t index, float time);
+		void update(vks::JobSystem* jobSystem = nullptr);
+		void clear();
+		uint32_t size() const { return static_cast<uint32_t>(entries.size()); }
+	};
 }
\ No newline at end of file
@@ -13,20 +13,427 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <map>
+#include <cmath>
+#include <random>
+#include <cstdio>
 
 namespace vks
 {
 	class Benchmark {
+	public:
+		/** @brief Frame time statistics (in ms) of the benchmark phase */
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stdDev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			double stutterThreshold = 0.0;
+			uint32_t stutterFrames = 0;
+		};
+
+		/** @brief Ray tracing results, only reported by examples that register the rays they trace (see addRays) */
+		struct RayTracing {
+			bool active = false;
+			/** @brief Rays traced during the benchmark phase */
+			double rays = 0.0;
+			/** @brief Memory (in bytes) of the acceleration structures the benchmark is run with */
+			double accelerationStructureMemory = 0.0;
+			/** @brief Summed up time (in ms) of the acceleration structure builds done before the benchmark is run */
+			double accelerationStructureBuildTime = 0.0;
+		};
+
+		/** @brief Device memory used by a category of resources (in bytes) during the benchmark phase */
+		struct MemoryUsage {
+			double peak = 0.0;
+			double sum = 0.0;
+			uint32_t samples = 0;
+			double average() const { return (samples > 0) ? sum / static_cast<double>(samples) : 0.0; }
+		};
+
+		/** @brief Frame of the benchmark phase that went over the hitch detector's budget (see vks::HitchDetector) */
+		struct FlaggedFrame {
+			/** @brief Index of the frame (see frameTimes) */
+			uint32_t frame;
+			std::string reason;
+			/** @brief Call stacks of the offending allocations and Vulkan calls */
+			std::vector<std::string> stacks;
+		};
+
+		/** @brief Change of the thermal status during the benchmark phase, so throttling can be matched with the frame times */
+		struct ThermalEvent {
+			/** @brief Index of the first frame (see frameTimes) rendered with the new status */
+			uint32_t frame;
+			/** @brief Time (in ms) since the start of the benchmark phase */
+			double time;
+			int32_t status;
+		};
+
+		/**
+		* @brief Interleaved A/B comparison of a setting that's toggled in blocks of frames during warmup and the benchmark phase (see compare)
+		* Both variants run in the same process and alternate quickly, so drift and thermal throttling affect them alike
+		*/
+		struct Comparison {
+			std::string setting;
+			/** @brief Number of frames rendered with one variant before switching to the other */
+			uint32_t blockFrames = 60;
+			/** @brief Frames at the start of each block that aren't counted, as they may include the cost of the switch */
+			uint32_t settleFrames = 5;
+			/** @brief Called with the variant (false = A with the setting disabled, true = B with the setting enabled) before the first frame of each block */
+			std::function<void(bool)> apply;
+			/** @brief Frame times (in ms) of variant A and B measured during the benchmark phase */
+			std::vector<double> frameTimes[2];
+		};
+
+		struct ComparisonResult {
+			double medianA = 0.0;
+			double medianB = 0.0;
+			/** @brief Difference of the median frame times (B - A) in ms and its 95% bootstrap confidence interval */
+			double delta = 0.0;
+			double deltaLow = 0.0;
+			double deltaHigh = 0.0;
+			/** @brief Two sided p-value of the Mann-Whitney U test (normal approximation), small values mean the variants' frame times differ */
+			double pValue = 1.0;
+		};
+
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		bool measuring = false;
+
+		static std::string escapeJson(const std::string& value) {
+			std::string escaped;
+			for (char c : value) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				} else if (static_cast<unsigned char>(c) < 0x20) {
+					// Control characters aren't allowed in JSON strings
+					char code[7];
+					snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+					escaped += code;
+					continue;
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		void writeCsv(std::ofstream& result, const Statistics& stats) {
+			result << "device,driverversion,present mode,swap chain images,duration (ms),frames,fps,fixed timestep (ms)" << "\n";
+			result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << presentMode << "," << swapChainImages << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "," << fixedTimestep * 1000.0f << "\n";
+
+			// Ray tracing results are added as columns of the frame statistics, so runs at different resolutions and ray counts can be compared side by side
+			result << "\n" << "min (ms),max (ms),avg (ms),stddev (ms),p50 (ms),p90 (ms),p99 (ms),p99.9 (ms),stutter threshold (ms),stutter frames";
+			if (rayTracing.active) {
+				result << ",mrays/s,as memory (kb),as build (ms)";
+			}
+			result << "\n";
+			result << stats.min << "," << stats.max << "," << stats.avg << "," << stats.stdDev << "," << stats.p50 << "," << stats.p90 << "," << stats.p99 << "," << stats.p999 << "," << stats.stutterThreshold << "," << stats.stutterFrames;
+			if (rayTracing.active) {
+				result << "," << megaRaysPerSecond() << "," << rayTracing.accelerationStructureMemory / 1024.0 << "," << rayTracing.accelerationStructureBuildTime;
+			}
+			result << "\n";
+
+			if (!scopeTimes.empty()) {
+				result << "\n" << "scope,samples,avg gpu (ms),min gpu (ms),max gpu (ms)" << "\n";
+				for (auto& scope : scopeTimes) {
+					result << scope.first << "," << scope.second.size() << "," << average(scope.second) << "," << *std::min_element(scope.second.begin(), scope.second.end()) << "," << *std::max_element(scope.second.begin(), scope.second.end()) << "\n";
+				}
+			}
+
+			if (!cpuTimes.empty()) {
+				result << "\n" << "scope,samples,avg cpu (ms),min cpu (ms),max cpu (ms)" << "\n";
+				for (auto& scope : cpuTimes) {
+					result << scope.first << "," << scope.second.size() << "," << average(scope.second) << "," << *std::min_element(scope.second.begin(), scope.second.end()) << "," << *std::max_element(scope.second.begin(), scope.second.end()) << "\n";
+				}
+			}
+
+			if (!pipelineStatistics.empty()) {
+				result << "\n" << "scope,statistic,samples,avg per frame" << "\n";
+				for (auto& scope : pipelineStatistics) {
+					for (auto& statistic : scope.second) {
+						result << scope.first << "," << statistic.first << "," << statistic.second.size() << "," << average(statistic.second) << "\n";
+					}
+				}
+			}
+
+			if (!memoryUsage.empty()) {
+				result << "\n" << "memory,avg (mb),peak (mb)" << "\n";
+				for (auto& usage : memoryUsage) {
+					result << usage.first << "," << usage.second.average() / (1024.0 * 1024.0) << "," << usage.second.peak / (1024.0 * 1024.0) << "\n";
+				}
+			}
+
+			if (!work.empty()) {
+				result << "\n" << "work,total,per second" << "\n";
+				for (auto& amount : work) {
+					result << amount.first << "," << amount.second << "," << workPerSecond(amount.second) << "\n";
+				}
+			}
+
+			if (!setupTimes.empty()) {
+				result << "\n" << "setup,ms" << "\n";
+				for (auto& setup : setupTimes) {
+					result << setup.first << "," << setup.second << "\n";
+				}
+			}
+
+			if (!metrics.empty()) {
+				result << "\n" << "metric,value" << "\n";
+				for (auto& metric : metrics) {
+					result << metric.first << "," << metric.second << "\n";
+				}
+			}
+
+			if (comparison.apply) {
+				const ComparisonResult compared = getComparisonResult();
+				result << "\n" << "comparison,frames a,frames b,median a (ms),median b (ms),delta (ms),delta 95% low (ms),delta 95% high (ms),p-value" << "\n";
+				result << comparison.setting << "," << comparison.frameTimes[0].size() << "," << comparison.frameTimes[1].size() << "," << compared.medianA << "," << compared.medianB << ","
+					<< compared.delta << "," << compared.deltaLow << "," << compared.deltaHigh << "," << compared.pValue << "\n";
+			}
+
+			if (hitchDetection) {
+				result << "\n" << "flagged frames," << flaggedFrameCount << "\n";
+				result << "frame,reason,stack" << "\n";
+				for (auto& flagged : flaggedFrames) {
+					result << flagged.frame << "," << escapeCsv(flagged.reason) << ",\n";
+					for (auto& stack : flagged.stacks) {
+						result << flagged.frame << ",," << escapeCsv(stack) << "\n";
+					}
+				}
+			}
+
+			if (!thermalEvents.empty()) {
+				result << "\n" << "thermal status,frame,time (ms)" << "\n";
+				for (auto& event : thermalEvents) {
+					result << event.status << "," << event.frame << "," << event.time << "\n";
+				}
+			}
+
+			if (outputFrameTimes) {
+				result << "\n" << "frame,ms" << "\n";
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					result << i << "," << frameTimes[i] << "\n";
+				}
+			}
+		}
+
+		static std::string escapeCsv(const std::string& value) {
+			std::string escaped = "\"";
+			for (char c : value) {
+				escaped += (c == '"') ? "\"\"" : std::string(1, c);
+			}
+			return escaped + "\"";
+		}
+
+		void writeJson(std::ofstream& result, const Statistics& stats) {
+			result << "{" << "\n";
+			result << "\t\"example\": \"" << escapeJson(name) << "\"," << "\n";
+			result << "\t\"device\": \"" << escapeJson(deviceProps.deviceName) << "\"," << "\n";
+			result << "\t\"driverversion\": " << deviceProps.driverVersion << "," << "\n";
+			result << "\t\"apiversion\": \"" << VK_VERSION_MAJOR(deviceProps.apiVersion) << "." << VK_VERSION_MINOR(deviceProps.apiVersion) << "." << VK_VERSION_PATCH(deviceProps.apiVersion) << "\"," << "\n";
+			result << "\t\"resolution\": { \"width\": " << width << ", \"height\": " << height << " }," << "\n";
+			result << "\t\"presentmode\": \"" << escapeJson(presentMode) << "\"," << "\n";
+			result << "\t\"swapchainimages\": " << swapChainImages << "," << "\n";
+			result << "\t\"warmup\": " << warmup << "," << "\n";
+			result << "\t\"fixedtimestep\": " << fixedTimestep * 1000.0f << "," << "\n";
+			result << "\t\"duration\": " << runtime << "," << "\n";
+			result << "\t\"frames\": " << frameCount << "," << "\n";
+			result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << "," << "\n";
+			result << "\t\"frametime\": {" << "\n";
+			result << "\t\t\"min\": " << stats.min << "," << "\n";
+			result << "\t\t\"max\": " << stats.max << "," << "\n";
+			result << "\t\t\"avg\": " << stats.avg << "," << "\n";
+			result << "\t\t\"stddev\": " << stats.stdDev << "," << "\n";
+			result << "\t\t\"p50\": " << stats.p50 << "," << "\n";
+			result << "\t\t\"p90\": " << stats.p90 << "," << "\n";
+			result << "\t\t\"p99\": " << stats.p99 << "," << "\n";
+			result << "\t\t\"p99.9\": " << stats.p999 << "," << "\n";
+			result << "\t\t\"stutterthreshold\": " << stats.stutterThreshold << "," << "\n";
+			result << "\t\t\"stutterframes\": " << stats.stutterFrames << "\n";
+			result << "\t}," << "\n";
+			if (rayTracing.active) {
+				result << "\t\"raytracing\": {" << "\n";
+				result << "\t\t\"rays\": " << rayTracing.rays << "," << "\n";
+				result << "\t\t\"mrayspersecond\": " << megaRaysPerSecond() << "," << "\n";
+				result << "\t\t\"asmemorykb\": " << rayTracing.accelerationStructureMemory / 1024.0 << "," << "\n";
+				result << "\t\t\"asbuildtime\": " << rayTracing.accelerationStructureBuildTime << "\n";
+				result << "\t}," << "\n";
+			}
+			result << "\t\"gpuscopes\": {";
+			for (auto scope = scopeTimes.begin(); scope != scopeTimes.end(); scope++) {
+				result << ((scope == scopeTimes.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(scope->first) << "\": { \"samples\": " << scope->second.size() << ", \"avg\": " << average(scope->second)
+					<< ", \"min\": " << *std::min_element(scope->second.begin(), scope->second.end()) << ", \"max\": " << *std::max_element(scope->second.begin(), scope->second.end()) << " }";
+			}
+			result << (scopeTimes.empty() ? "" : "\n\t") << "}," << "\n";
+			result << "\t\"cpuscopes\": {";
+			for (auto scope = cpuTimes.begin(); scope != cpuTimes.end(); scope++) {
+				result << ((scope == cpuTimes.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(scope->first) << "\": { \"samples\": " << scope->second.size() << ", \"avg\": " << average(scope->second)
+					<< ", \"min\": " << *std::min_element(scope->second.begin(), scope->second.end()) << ", \"max\": " << *std::max_element(scope->second.begin(), scope->second.end()) << " }";
+			}
+			result << (cpuTimes.empty() ? "" : "\n\t") << "}," << "\n";
+			// Work done on the GPU per frame (e.g. fragment shader invocations), lower is better
+			result << "\t\"pipelinestatistics\": {";
+			for (auto scope = pipelineStatistics.begin(); scope != pipelineStatistics.end(); scope++) {
+				result << ((scope == pipelineStatistics.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(scope->first) << "\": {";
+				for (auto statistic = scope->second.begin(); statistic != scope->second.end(); statistic++) {
+					result << ((statistic == scope->second.begin()) ? " " : ", ") << "\"" << escapeJson(statistic->first) << "\": " << average(statistic->second);
+				}
+				result << " }";
+			}
+			result << (pipelineStatistics.empty() ? "" : "\n\t") << "}," << "\n";
+			// Device memory by resource category in MB, lower is better
+			result << "\t\"memory\": {";
+			for (auto usage = memoryUsage.begin(); usage != memoryUsage.end(); usage++) {
+				result << ((usage == memoryUsage.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(usage->first) << "\": { \"avg\": " << usage->second.average() / (1024.0 * 1024.0) << ", \"peak\": " << usage->second.peak / (1024.0 * 1024.0) << " }";
+			}
+			result << (memoryUsage.empty() ? "" : "\n\t") << "}," << "\n";
+			// Work per second, higher is better
+			result << "\t\"throughput\": {";
+			for (auto amount = work.begin(); amount != work.end(); amount++) {
+				result << ((amount == work.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(amount->first) << "\": " << workPerSecond(amount->second);
+			}
+			result << (work.empty() ? "" : "\n\t") << "}," << "\n";
+			// Times (in ms) of one-off setup work done before the benchmark is run, lower is better
+			result << "\t\"setuptimes\": {";
+			for (auto setup = setupTimes.begin(); setup != setupTimes.end(); setup++) {
+				result << ((setup == setupTimes.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(setup->first) << "\": " << setup->second;
+			}
+			result << (setupTimes.empty() ? "" : "\n\t") << "}," << "\n";
+			// Example independent metrics of the loaded content (e.g. vertex cache efficiency), lower is better
+			result << "\t\"metrics\": {";
+			for (auto metric = metrics.begin(); metric != metrics.end(); metric++) {
+				result << ((metric == metrics.begin()) ? "" : ",") << "\n";
+				result << "\t\t\"" << escapeJson(metric->first) << "\": " << metric->second;
+			}
+			result << (metrics.empty() ? "" : "\n\t") << "}";
+			if (comparison.apply) {
+				const ComparisonResult compared = getComparisonResult();
+				result << "," << "\n" << "\t\"comparison\": {" << "\n";
+				result << "\t\t\"setting\": \"" << escapeJson(comparison.setting) << "\"," << "\n";
+				result << "\t\t\"blockframes\": " << comparison.blockFrames << "," << "\n";
+				result << "\t\t\"a\": { \"frames\": " << comparison.frameTimes[0].size() << ", \"median\": " << compared.medianA << " }," << "\n";
+				result << "\t\t\"b\": { \"frames\": " << comparison.frameTimes[1].size() << ", \"median\": " << compared.medianB << " }," << "\n";
+				result << "\t\t\"delta\": " << compared.delta << "," << "\n";
+				result << "\t\t\"delta95\": [" << compared.deltaLow << ", " << compared.deltaHigh << "]," << "\n";
+				result << "\t\t\"pvalue\": " << compared.pValue << "\n";
+				result << "\t}";
+			}
+			if (hitchDetection) {
+				result << "," << "\n" << "\t\"flaggedframes\": {" << "\n";
+				result << "\t\t\"count\": " << flaggedFrameCount << "," << "\n";
+				result << "\t\t\"frames\": [";
+				for (size_t i = 0; i < flaggedFrames.size(); i++) {
+					result << ((i > 0) ? "," : "") << "\n";
+					result << "\t\t\t{ \"frame\": " << flaggedFrames[i].frame << ", \"reason\": \"" << escapeJson(flaggedFrames[i].reason) << "\", \"stacks\": [";
+					for (size_t j = 0; j < flaggedFrames[i].stacks.size(); j++) {
+						result << ((j > 0) ? ", " : "") << "\"" << escapeJson(flaggedFrames[i].stacks[j]) << "\"";
+					}
+					result << "] }";
+				}
+				result << (flaggedFrames.empty() ? "" : "\n\t\t") << "]" << "\n";
+				result << "\t}";
+			}
+			if (thermalStatus) {
+				result << "," << "\n" << "\t\"thermal\": [";
+				for (size_t i = 0; i < thermalEvents.size(); i++) {
+					result << ((i > 0) ? ", " : "") << "{ \"status\": " << thermalEvents[i].status << ", \"frame\": " << thermalEvents[i].frame << ", \"time\": " << thermalEvents[i].time << " }";
+				}
+				result << "]";
+			}
+			if (outputFrameTimes) {
+				result << "," << "\n" << "\t\"frametimes\": [";
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					result << ((i > 0) ? ", " : "") << frameTimes[i];
+				}
+				result << "]";
+			}
+			result << "\n" << "}" << "\n";
+		}
+
+		static bool endsWith(const std::string& value, const std::string& suffix) {
+			return (value.size() >= suffix.size()) && (value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0);
+		}
+
+		/** @brief Variant of a comparison the frame is rendered with, blocks alternate between A and B */
+		bool comparisonVariant(uint32_t frame) const {
+			return ((frame / comparison.blockFrames) % 2) == 1;
+		}
+
+		void switchComparisonVariant(uint32_t frame) {
+			if (comparison.apply && ((frame % comparison.blockFrames) == 0)) {
+				comparison.apply(comparisonVariant(frame));
+			}
+		}
+
+		static double median(std::vector<double>& values) {
+			if (values.empty()) {
+				return 0.0;
+			}
+			auto middle = values.begin() + values.size() / 2;
+			std::nth_element(values.begin(), middle, values.end());
+			return *middle;
+		}
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
+		/**
+		* @brief Simulated time (in seconds) each frame advances the example by, set if the example runs with a fixed timestep
+		* @note Warmup and duration then count simulated instead of measured time, so every device renders the same number of identical frames
+		*/
+		float fixedTimestep = 0.0f;
+		/** @brief Frames taking longer than this (in ms) are counted as stutter, if zero twice the median frame time is used */
+		double stutterThreshold = 0.0;
 		std::vector<double> frameTimes;
+		/** @brief GPU times of the profiler scopes (in ms) measured during the benchmark phase */
+		std::map<std::string, std::vector<double>> scopeTimes;
+		/** @brief Example specific CPU times (in ms) of work done each frame (e.g. command buffer recording) measured during the benchmark phase */
+		std::map<std::string, std::vector<double>> cpuTimes;
+		/** @brief Pipeline statistics (e.g. fragment shader invocations) of the profiler scopes counted during the benchmark phase, by scope and statistic */
+		std::map<std::string, std::map<std::string, std::vector<double>>> pipelineStatistics;
+		/** @brief Device memory usage by resource category (e.g. textures, render targets) sampled each frame of the benchmark phase (see vks::MemoryReport) */
+		std::map<std::string, MemoryUsage> memoryUsage;
+		/** @brief Example specific amounts of work (e.g. interactions) done during the benchmark phase, reported per second */
+		std::map<std::string, double> work;
+		/** @brief Example specific times (in ms) of setup work (e.g. buffer uploads) done once before the benchmark is run */
+		std::map<std::string, double> setupTimes;
+		/** @brief Metrics of the loaded content (e.g. the vertex cache miss ratio of index buffers) that don't change while the benchmark is run, lower is better */
+		std::map<std::string, double> metrics;
+		RayTracing rayTracing;
+		Comparison comparison;
+		/**
+		* @brief Optional function returning the thermal status of the device (higher is hotter, negative if unknown), sampled once per second during the benchmark phase
+		* @note Frame times are only comparable between runs if the device hasn't started throttling, so changes of the status are stored with the results
+		*/
+		std::function<int32_t()> thermalStatus;
+		std::vector<ThermalEvent> thermalEvents;
+		/** @brief Set if frames are checked by the hitch detector, so flagged frames are stored with the results (see addFlaggedFrame) */
+		bool hitchDetection = false;
+		/** @brief Most flagged frames stored with their call stacks, later ones are only counted */
+		uint32_t maxFlaggedFrames = 16;
+		uint32_t flaggedFrameCount = 0;
+		std::vector<FlaggedFrame> flaggedFrames;
+		/** @brief File to save the results to, results are written as JSON if the file name ends with .json and as CSV otherwise */
 		std::string filename = "";
+		/** @brief Name of the example and resolution the benchmark is run at (stored with the results) */
+		std::string name = "";
+		uint32_t width = 0;
+		uint32_t height = 0;
+		/** @brief Present mode and number of images of the swap chain the benchmark is run with (stored with the results) */
+		std::string presentMode = "";
+		uint32_t swapChainImages = 0;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
@@ -44,30 +451,323 @@ namespace vks
 			// Warm up phase to get more stable frame rates
 			{
 				double tMeasured = 0.0;
+				uint32_t warmupFrames = 0;
 				while (tMeasured < (warmup * 1000)) {
+					// Both variants of a comparison are warmed up (e.g. so their pipelines have been used before)
+					switchComparisonVariant(warmupFrames++);
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
-					tMeasured += tDiff;
+					tMeasured += (fixedTimestep > 0.0f) ? fixedTimestep * 1000.0 : tDiff;
 				};
 			}
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				scopeTimes.clear();
+				cpuTimes.clear();
+				pipelineStatistics.clear();
+				memoryUsage.clear();
+				work.clear();
+				rayTracing.rays = 0.0;
+				comparison.frameTimes[0].clear();
+				comparison.frameTimes[1].clear();
+				thermalEvents.clear();
+				flaggedFrameCount = 0;
+				flaggedFrames.clear();
+				double nextThermalSample = 0.0;
+				double elapsed = 0.0;
+				measuring = true;
+				while (elapsed < (duration * 1000.0)) {
+					if (thermalStatus && (runtime >= nextThermalSample)) {
+						const int32_t status = thermalStatus();
+						if (thermalEvents.empty() || (thermalEvents.back().status != status)) {
+							thermalEvents.push_back({ frameCount, runtime, status });
+						}
+						nextThermalSample += 1000.0;
+					}
+					switchComparisonVariant(frameCount);
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
+					if (comparison.apply && ((frameCount % comparison.blockFrames) >= comparison.settleFrames)) {
+						comparison.frameTimes[comparisonVariant(frameCount)].push_back(tDiff);
+					}
+					elapsed += (fixedTimestep > 0.0f) ? fixedTimestep * 1000.0 : tDiff;
 					frameTimes.push_back(tDiff);
 					frameCount++;
 				};
+				measuring = false;
+				const Statistics stats = getStatistics();
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
+				std::cout << "present: " << presentMode << " (" << swapChainImages << " images)" << "\n";
+				if (fixedTimestep > 0.0f) {
+					std::cout << "step   : " << fixedTimestep * 1000.0f << " ms (fixed)" << "\n";
+				}
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "best   : " << (1000.0 / stats.min) << " fps (" << stats.min << " ms)" << "\n";
+				std::cout << "worst  : " << (1000.0 / stats.max) << " fps (" << stats.max << " ms)" << "\n";
+				std::cout << "avg    : " << (1000.0 / stats.avg) << " fps (" << stats.avg << " ms, stddev " << stats.stdDev << " ms)" << "\n";
+				std::cout << "p50    : " << stats.p50 << " ms" << "\n";
+				std::cout << "p90    : " << stats.p90 << " ms" << "\n";
+				std::cout << "p99    : " << stats.p99 << " ms" << "\n";
+				std::cout << "p99.9  : " << stats.p999 << " ms" << "\n";
+				std::cout << "stutter: " << stats.stutterFrames << " frames > " << stats.stutterThreshold << " ms" << "\n";
+				if (rayTracing.active) {
+					std::cout << "rays   : " << megaRaysPerSecond() << " Mrays/s" << "\n";
+					std::cout << "as mem : " << rayTracing.accelerationStructureMemory / 1024.0 << " kb" << "\n";
+					std::cout << "as bld : " << rayTracing.accelerationStructureBuildTime << " ms" << "\n";
+				}
+				for (auto& scope : scopeTimes) {
+					std::cout << "gpu    : " << scope.first << " " << average(scope.second) << " ms" << "\n";
+				}
+				for (auto& scope : cpuTimes) {
+					std::cout << "cpu    : " << scope.first << " " << average(scope.second) << " ms" << "\n";
+				}
+				for (auto& scope : pipelineStatistics) {
+					for (auto& statistic : scope.second) {
+						std::cout << "stats  : " << scope.first << " " << statistic.first << " " << average(statistic.second) << "\n";
+					}
+				}
+				for (auto& usage : memoryUsage) {
+					std::cout << "memory : " << usage.first << " avg " << usage.second.average() / (1024.0 * 1024.0) << " mb, peak " << usage.second.peak / (1024.0 * 1024.0) << " mb" << "\n";
+				}
+				for (auto& amount : work) {
+					std::cout << "rate   : " << amount.first << " " << std::scientific << workPerSecond(amount.second) << std::fixed << " /s" << "\n";
+				}
+				for (auto& setup : setupTimes) {
+					std::cout << "setup  : " << setup.first << " " << setup.second << " ms" << "\n";
+				}
+				for (auto& metric : metrics) {
+					std::cout << "metric : " << metric.first << " " << metric.second << "\n";
+				}
+				if (comparison.apply) {
+					const ComparisonResult compared = getComparisonResult();
+					std::cout << "compare: " << comparison.setting << " off " << compared.medianA << " ms (" << comparison.frameTimes[0].size() << " frames), on " << compared.medianB << " ms (" << comparison.frameTimes[1].size() << " frames)" << "\n";
+					std::cout << "delta  : " << compared.delta << " ms (95% [" << compared.deltaLow << ", " << compared.deltaHigh << "], p = " << std::scientific << compared.pValue << std::fixed << ")" << "\n";
+				}
+				if (hitchDetection) {
+					std::cout << "flagged: " << flaggedFrameCount << " frames over budget" << "\n";
+					for (auto& flagged : flaggedFrames) {
+						std::cout << "flagged: frame " << flagged.frame << " " << flagged.reason << "\n";
+						for (auto& stack : flagged.stacks) {
+							std::cout << "         " << stack << "\n";
+						}
+					}
+				}
+				for (auto& event : thermalEvents) {
+					std::cout << "thermal: status " << event.status << " from frame " << event.frame << " (" << event.time << " ms)" << "\n";
+				}
+				std::cout << "\n";
+			}
+		}
+
+		/** @brief Add a GPU time measured for a profiler scope */
+		void addScopeTime(const std::string& name, double ms) {
+			scopeTimes[name].push_back(ms);
+		}
+
+		/** @brief Add a CPU time measured by the example for a named part of its frame */
+		void addCpuTime(const std::string& name, double ms) {
+			cpuTimes[name].push_back(ms);
+		}
+
+		/** @brief Flag the last frame that has been measured as over the hitch detector's budget, only counted during the benchmark phase */
+		void addFlaggedFrame(const std::string& reason, const std::vector<std::string>& stacks) {
+			if (!measuring || (frameCount == 0)) {
+				return;
+			}
+			flaggedFrameCount++;
+			if (flaggedFrames.size() < maxFlaggedFrames) {
+				flaggedFrames.push_back({ frameCount - 1, reason, stacks });
+			}
+		}
+
+		/** @brief Add a sample of the device memory (in bytes) used by a category of resources */
+		void addMemoryUsage(const std::string& category, double bytes) {
+			MemoryUsage& usage = memoryUsage[category];
+			usage.peak = std::max(usage.peak, bytes);
+			usage.sum += bytes;
+			usage.samples++;
+		}
+
+		/** @brief Add a pipeline statistic (e.g. the number of fragment shader invocations) counted for a profiler scope */
+		void addPipelineStatistic(const std::string& scope, const std::string& statistic, double value) {
+			pipelineStatistics[scope][statistic].push_back(value);
+		}
+
+		/** @brief Add work done by a frame (e.g. the number of interactions of a simulation step), only counted during the benchmark phase */
+		void addWork(const std::string& name, double amount) {
+			if (measuring) {
+				work[name] += amount;
+			}
+		}
+
+		/**
+		* @brief Add the rays traced by a frame, only counted during the benchmark phase
+		* @note Calling this once (even outside of the benchmark phase) adds the ray tracing results to the output
+		*/
+		void addRays(double count) {
+			rayTracing.active = true;
+			if (measuring) {
+				rayTracing.rays += count;
+			}
+		}
+
+		/** @brief Set the memory (in bytes) taken up by the acceleration structures, can be called before the benchmark is run */
+		void setAccelerationStructureMemory(double bytes) {
+			rayTracing.accelerationStructureMemory = bytes;
+		}
+
+		/** @brief Add the time (in ms) an acceleration structure build took, can be called before the benchmark is run */
+		void addAccelerationStructureBuildTime(double ms) {
+			rayTracing.accelerationStructureBuildTime += ms;
+		}
+
+		/** @brief Add the time (in ms) a one-off setup step took, can be called before the benchmark is run */
+		void addSetupTime(const std::string& name, double ms) {
+			setupTimes[name] = ms;
+		}
+
+		/** @brief Add a metric of the loaded content, can be called before the benchmark is run */
+		void addMetric(const std::string& name, double value) {
+			metrics[name] = value;
+		}
+
+		double workPerSecond(double amount) const {
+			return (runtime > 0.0) ? amount / (runtime / 1000.0) : 0.0;
+		}
+
+		double megaRaysPerSecond() const {
+			return workPerSecond(rayTracing.rays) / 1.0e6;
+		}
+
+		static double average(const std::vector<double>& values) {
+			return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / (double)values.size();
+		}
+
+		/** @brief Returns the value below which the given percentage of the (sorted) values fall (nearest rank) */
+		static double percentile(const std::vector<double>& sortedValues, double percentage) {
+			if (sortedValues.empty()) {
+				return 0.0;
 			}
+			size_t rank = static_cast<size_t>(std::ceil(percentage / 100.0 * (double)sortedValues.size()));
+			return sortedValues[std::min(std::max(rank, (size_t)1), sortedValues.size()) - 1];
+		}
+
+		/**
+		* @brief Compare a setting by interleaving blocks of frames with it disabled (A) and enabled (B), must be called before run
+		* @param setting Name of the setting stored with the results
+		* @param apply Function called with the variant to switch to (false = A, true = B) before the first frame of each block
+		* @param blockFrames Number of frames rendered per block
+		*/
+		void compare(const std::string& setting, std::function<void(bool)> apply, uint32_t blockFrames = 60) {
+			comparison.setting = setting;
+			comparison.apply = apply;
+			comparison.blockFrames = std::max(blockFrames, 2u);
+			comparison.settleFrames = std::min(comparison.settleFrames, comparison.blockFrames / 2);
+		}
+
+		/**
+		* @brief Compare the frame time distributions of the two variants
+		* The confidence interval of the median difference is estimated by resampling both variants (bootstrap) with a fixed seed, so results are reproducible
+		*/
+		ComparisonResult getComparisonResult() const {
+			ComparisonResult result;
+			const std::vector<double>& a = comparison.frameTimes[0];
+			const std::vector<double>& b = comparison.frameTimes[1];
+			if (a.empty() || b.empty()) {
+				return result;
+			}
+			std::vector<double> sampleA(a), sampleB(b);
+			result.medianA = median(sampleA);
+			result.medianB = median(sampleB);
+			result.delta = result.medianB - result.medianA;
+
+			const uint32_t resamples = 1000;
+			std::mt19937 rng(5489u);
+			std::uniform_int_distribution<size_t> pickA(0, a.size() - 1);
+			std::uniform_int_distribution<size_t> pickB(0, b.size() - 1);
+			std::vector<double> deltas(resamples);
+			for (uint32_t i = 0; i < resamples; i++) {
+				for (auto& value : sampleA) {
+					value = a[pickA(rng)];
+				}
+				for (auto& value : sampleB) {
+					value = b[pickB(rng)];
+				}
+				deltas[i] = median(sampleB) - median(sampleA);
+			}
+			std::sort(deltas.begin(), deltas.end());
+			result.deltaLow = percentile(deltas, 2.5);
+			result.deltaHigh = percentile(deltas, 97.5);
+
+			// Mann-Whitney U test with average ranks for ties
+			std::vector<std::pair<double, bool>> ranked;
+			ranked.reserve(a.size() + b.size());
+			for (double value : a) {
+				ranked.push_back({ value, false });
+			}
+			for (double value : b) {
+				ranked.push_back({ value, true });
+			}
+			std::sort(ranked.begin(), ranked.end());
+			const double n1 = static_cast<double>(a.size());
+			const double n2 = static_cast<double>(b.size());
+			const double n = n1 + n2;
+			double rankSumA = 0.0;
+			double tieCorrection = 0.0;
+			for (size_t i = 0; i < ranked.size();) {
+				size_t j = i;
+				while ((j < ranked.size()) && (ranked[j].first == ranked[i].first)) {
+					j++;
+				}
+				const double averageRank = 0.5 * static_cast<double>(i + 1 + j);
+				for (size_t k = i; k < j; k++) {
+					if (!ranked[k].second) {
+						rankSumA += averageRank;
+					}
+				}
+				const double ties = static_cast<double>(j - i);
+				tieCorrection += ties * ties * ties - ties;
+				i = j;
+			}
+			const double u = rankSumA - n1 * (n1 + 1.0) / 2.0;
+			const double sigma = std::sqrt(n1 * n2 / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0))));
+			if (sigma > 0.0) {
+				const double z = (u - n1 * n2 / 2.0) / sigma;
+				result.pValue = std::erfc(std::abs(z) / std::sqrt(2.0));
+			}
+			return result;
+		}
+
+		/** @brief Calculate the frame time statistics of the benchmark phase */
+		Statistics getStatistics() const {
+			Statistics stats;
+			if (frameTimes.empty()) {
+				return stats;
+			}
+			std::vector<double> sortedFrameTimes(frameTimes);
+			std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+			stats.min = sortedFrameTimes.front();
+			stats.max = sortedFrameTimes.back();
+			stats.avg = average(sortedFrameTimes);
+			double variance = 0.0;
+			for (double frameTime : sortedFrameTimes) {
+				variance += (frameTime - stats.avg) * (frameTime - stats.avg);
+			}
+			stats.stdDev = std::sqrt(variance / (double)sortedFrameTimes.size());
+			stats.p50 = percentile(sortedFrameTimes, 50.0);
+			stats.p90 = percentile(sortedFrameTimes, 90.0);
+			stats.p99 = percentile(sortedFrameTimes, 99.0);
+			stats.p999 = percentile(sortedFrameTimes, 99.9);
+			stats.stutterThreshold = (stutterThreshold > 0.0) ? stutterThreshold : 2.0 * stats.p50;
+			stats.stutterFrames = static_cast<uint32_t>(std::count_if(sortedFrameTimes.begin(), sortedFrameTimes.end(), [&stats](double frameTime) { return frameTime > stats.stutterThreshold; }));
+			return stats;
 		}
 
 		void saveResults() {
@@ -75,21 +775,11 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
-
-				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
-					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
-					std::cout << "\n";
+				const Statistics stats = getStatistics();
+				if (endsWith(filename, ".json")) {
+					writeJson(result, stats);
+				} else {
+					writeCsv(result, stats);
 				}
 
 				result.flush();
@@ -99,4 +789,4 @@ namespace vks
 			}
 		}
 	};
-}
\ No newline at end of file
+}
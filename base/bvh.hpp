@@ -0,0 +1,340 @@
+/*
+* Bounding volume hierarchy
+*
+* Load time construction of a binary BVH with binned surface area heuristic (SAH) splits, built in parallel on a vks::ThreadPool
+* The result is flattened into a node array with both children of a node stored next to each other, which shaders can traverse with a small stack
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include <thread>
+#include <glm/glm.hpp>
+#include "threadpool.hpp"
+
+namespace vks
+{
+	namespace bvh
+	{
+		/** @brief Number of bins the centroid range of a node is split into when evaluating the SAH */
+		const uint32_t binCount = 16;
+		/** @brief Nodes with up to this many primitives become leaves if splitting them doesn't lower the SAH cost */
+		const uint32_t maxLeafSize = 8;
+		/** @brief Max. depth of the hierarchy, matches the traversal stack size of the shaders */
+		const uint32_t maxDepth = 32;
+		/** @brief Cost of traversing a node relative to intersecting a primitive */
+		const float traversalCost = 1.0f;
+
+		struct AABB
+		{
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+
+			void grow(const glm::vec3& point)
+			{
+				min = glm::min(min, point);
+				max = glm::max(max, point);
+			}
+
+			void grow(const AABB& aabb)
+			{
+				min = glm::min(min, aabb.min);
+				max = glm::max(max, aabb.max);
+			}
+
+			float area() const
+			{
+				const glm::vec3 extent = max - min;
+				return (extent.x < 0.0f) ? 0.0f : 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+			}
+		};
+
+		/**
+		* Flattened node, matches a std430 struct { vec3 aabbMin; uint leftFirst; vec3 aabbMax; uint count; } in the shaders
+		* Inner nodes (count == 0) store the index of their first child, the second child follows right after it
+		* Leaves store the index of their first primitive in BVH::primitiveIndices
+		*/
+		struct Node
+		{
+			glm::vec3 aabbMin;
+			uint32_t leftFirst;
+			glm::vec3 aabbMax;
+			uint32_t count;
+		};
+
+		struct BVH
+		{
+			std::vector<Node> nodes;
+			// Indices into the primitive bounds passed to build, ordered so that each leaf references a contiguous range
+			std::vector<uint32_t> primitiveIndices;
+			uint32_t depth = 0;
+		};
+
+		namespace detail
+		{
+			struct Builder
+			{
+				const std::vector<AABB>& bounds;
+				std::vector<glm::vec3> centroids;
+				std::vector<uint32_t>& primitiveIndices;
+
+				Builder(const std::vector<AABB>& bounds, std::vector<uint32_t>& primitiveIndices) : bounds(bounds), primitiveIndices(primitiveIndices)
+				{
+					centroids.resize(bounds.size());
+					for (size_t i = 0; i < bounds.size(); i++) {
+						centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+					}
+				}
+
+				void setBounds(Node& node) const
+				{
+					AABB aabb;
+					for (uint32_t i = 0; i < node.count; i++) {
+						aabb.grow(bounds[primitiveIndices[node.leftFirst + i]]);
+					}
+					node.aabbMin = aabb.min;
+					node.aabbMax = aabb.max;
+				}
+
+				/**
+				* Partition the primitives of a node along the split with the lowest SAH cost
+				*
+				* @return Number of primitives in the first half, 0 if the node should stay a leaf
+				*/
+				uint32_t split(const Node& node, uint32_t depth) const
+				{
+					const uint32_t first = node.leftFirst;
+					const uint32_t count = node.count;
+					if ((count <= 1) || (depth >= maxDepth)) {
+						return 0;
+					}
+
+					AABB centroidBounds;
+					for (uint32_t i = 0; i < count; i++) {
+						centroidBounds.grow(centroids[primitiveIndices[first + i]]);
+					}
+
+					float bestCost = FLT_MAX;
+					int32_t bestAxis = -1;
+					uint32_t bestBin = 0;
+					for (int32_t axis = 0; axis < 3; axis++) {
+						const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+						if (extent <= 0.0f) {
+							continue;
+						}
+						const float scale = (float)binCount / extent;
+						AABB binBounds[binCount];
+						uint32_t binCounts[binCount] = {};
+						for (uint32_t i = 0; i < count; i++) {
+							const uint32_t index = primitiveIndices[first + i];
+							const uint32_t bin = std::min(binCount - 1, (uint32_t)((centroids[index][axis] - centroidBounds.min[axis]) * scale));
+							binBounds[bin].grow(bounds[index]);
+							binCounts[bin]++;
+						}
+						// Sweep from both sides to get the cost of splitting after each bin
+						float leftAreas[binCount - 1];
+						uint32_t leftCounts[binCount - 1];
+						AABB left;
+						uint32_t leftCount = 0;
+						for (uint32_t i = 0; i < binCount - 1; i++) {
+							left.grow(binBounds[i]);
+							leftCount += binCounts[i];
+							leftAreas[i] = left.area();
+							leftCounts[i] = leftCount;
+						}
+						AABB right;
+						uint32_t rightCount = 0;
+						for (uint32_t i = binCount - 1; i > 0; i--) {
+							right.grow(binBounds[i]);
+							rightCount += binCounts[i];
+							const float cost = leftAreas[i - 1] * (float)leftCounts[i - 1] + right.area() * (float)rightCount;
+							if ((leftCounts[i - 1] > 0) && (rightCount > 0) && (cost < bestCost)) {
+								bestCost = cost;
+								bestAxis = axis;
+								bestBin = i - 1;
+							}
+						}
+					}
+
+					// All centroids are in the same spot, splitting can't separate them
+					if (bestAxis < 0) {
+						return 0;
+					}
+
+					AABB nodeBounds;
+					nodeBounds.min = node.aabbMin;
+					nodeBounds.max = node.aabbMax;
+					const float splitCost = traversalCost + bestCost / nodeBounds.area();
+					if ((splitCost >= (float)count) && (count <= maxLeafSize)) {
+						return 0;
+					}
+
+					const float scale = (float)binCount / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+					const float minCentroid = centroidBounds.min[bestAxis];
+					const glm::vec3* centroidData = centroids.data();
+					auto middle = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count, [&](uint32_t index) {
+						return std::min(binCount - 1, (uint32_t)((centroidData[index][bestAxis] - minCentroid) * scale)) <= bestBin;
+					});
+					return static_cast<uint32_t>(middle - (primitiveIndices.begin() + first));
+				}
+
+				/** @brief Split a node into two children that are appended to nodes, returns false if the node stays a leaf */
+				bool subdivide(std::vector<Node>& nodes, uint32_t nodeIndex, uint32_t depth) const
+				{
+					const uint32_t leftCount = split(nodes[nodeIndex], depth);
+					if (leftCount == 0) {
+						return false;
+					}
+					Node leftChild{};
+					leftChild.leftFirst = nodes[nodeIndex].leftFirst;
+					leftChild.count = leftCount;
+					setBounds(leftChild);
+					Node rightChild{};
+					rightChild.leftFirst = nodes[nodeIndex].leftFirst + leftCount;
+					rightChild.count = nodes[nodeIndex].count - leftCount;
+					setBounds(rightChild);
+					nodes[nodeIndex].leftFirst = static_cast<uint32_t>(nodes.size());
+					nodes[nodeIndex].count = 0;
+					nodes.push_back(leftChild);
+					nodes.push_back(rightChild);
+					return true;
+				}
+
+				/**
+				* Recursively split a node (stored at nodes[0]) and its children, appending the children to nodes
+				*
+				* @return Depth of the resulting subtree
+				*/
+				uint32_t buildSubtree(std::vector<Node>& nodes, uint32_t depth) const
+				{
+					uint32_t maxSubtreeDepth = depth;
+					std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, depth } };
+					while (!stack.empty()) {
+						const uint32_t nodeIndex = stack.back().first;
+						const uint32_t nodeDepth = stack.back().second;
+						stack.pop_back();
+						maxSubtreeDepth = std::max(maxSubtreeDepth, nodeDepth);
+						if (!subdivide(nodes, nodeIndex, nodeDepth)) {
+							continue;
+						}
+						const uint32_t childIndex = nodes[nodeIndex].leftFirst;
+						stack.push_back({ childIndex, nodeDepth + 1 });
+						stack.push_back({ childIndex + 1, nodeDepth + 1 });
+					}
+					return maxSubtreeDepth;
+				}
+			};
+		}
+
+		/**
+		* Build a bounding volume hierarchy over a set of primitives
+		*
+		* The upper levels are split on the calling thread until there are enough independent subtrees, which are then built in parallel
+		* Subtrees work on disjoint ranges of the primitive indices, so they don't need any synchronization and the result doesn't depend on the thread count
+		*
+		* @param bounds Bounding box of each primitive
+		* @param threadCount (Optional) Number of threads to build the subtrees with (Defaults to the number of hardware threads)
+		*
+		* @return Flattened hierarchy, the root is the first node (empty if there are no primitives)
+		*/
+		inline BVH build(const std::vector<AABB>& bounds, uint32_t threadCount = 0)
+		{
+			BVH bvh;
+			if (bounds.empty()) {
+				return bvh;
+			}
+			bvh.primitiveIndices.resize(bounds.size());
+			for (uint32_t i = 0; i < bounds.size(); i++) {
+				bvh.primitiveIndices[i] = i;
+			}
+			detail::Builder builder(bounds, bvh.primitiveIndices);
+
+			if (threadCount == 0) {
+				threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+
+			Node root{};
+			root.leftFirst = 0;
+			root.count = static_cast<uint32_t>(bounds.size());
+			builder.setBounds(root);
+			bvh.nodes.push_back(root);
+
+			// Split breadth first until there are a few subtrees per thread, so uneven subtree sizes balance out
+			struct Subtree {
+				uint32_t nodeIndex;
+				uint32_t depth;
+				std::vector<Node> nodes;
+				uint32_t maxDepth;
+			};
+			std::vector<Subtree> subtrees;
+			std::deque<std::pair<uint32_t, uint32_t>> pending = { { 0, 0 } };
+			const size_t subtreeTarget = (threadCount > 1) ? threadCount * 4 : 1;
+			while (!pending.empty() && (pending.size() < subtreeTarget)) {
+				const uint32_t nodeIndex = pending.front().first;
+				const uint32_t depth = pending.front().second;
+				pending.pop_front();
+				bvh.depth = std::max(bvh.depth, depth);
+				if (!builder.subdivide(bvh.nodes, nodeIndex, depth)) {
+					continue;
+				}
+				const uint32_t childIndex = bvh.nodes[nodeIndex].leftFirst;
+				pending.push_back({ childIndex, depth + 1 });
+				pending.push_back({ childIndex + 1, depth + 1 });
+			}
+			for (auto& node : pending) {
+				subtrees.push_back({ node.first, node.second, { bvh.nodes[node.first] }, node.second });
+			}
+
+			auto buildSubtree = [&builder](Subtree& subtree) {
+				subtree.maxDepth = builder.buildSubtree(subtree.nodes, subtree.depth);
+			};
+			if ((threadCount > 1) && (subtrees.size() > 1)) {
+				// Each thread picks the next subtree from a shared counter
+				std::atomic<size_t> next(0);
+				vks::ThreadPool threadPool;
+				threadPool.setThreadCount(std::min(threadCount, static_cast<uint32_t>(subtrees.size())));
+				for (auto& thread : threadPool.threads) {
+					thread->addJob([&] {
+						size_t i;
+						while ((i = next++) < subtrees.size()) {
+							buildSubtree(subtrees[i]);
+						}
+					});
+				}
+				threadPool.wait();
+			} else {
+				for (auto& subtree : subtrees) {
+					buildSubtree(subtree);
+				}
+			}
+
+			// Append the subtrees, their roots replace the pending nodes and child indices are offset to the subtree's position
+			for (auto& subtree : subtrees) {
+				const uint32_t offset = static_cast<uint32_t>(bvh.nodes.size()) - 1;
+				for (size_t i = 0; i < subtree.nodes.size(); i++) {
+					Node node = subtree.nodes[i];
+					if (node.count == 0) {
+						node.leftFirst += offset;
+					}
+					if (i == 0) {
+						bvh.nodes[subtree.nodeIndex] = node;
+					} else {
+						bvh.nodes.push_back(node);
+					}
+				}
+				bvh.depth = std::max(bvh.depth, subtree.maxDepth);
+			}
+
+			return bvh;
+		}
+	}
+}
@@ -15,8 +15,32 @@
 class Camera
 {
 private:
-	float fov;
+	float fov = 0.0f;
 	float znear, zfar;
+	float aspect = 1.0f;
+	uint32_t preRotation = 0;
+	glm::vec2 jitter = glm::vec2(0.0f);
+
+	void updatePerspective()
+	{
+		// The aspect ratio is that of the swap chain images, which are in the display's native orientation if they are pre-rotated
+		const bool quarterRotation = (preRotation == 90) || (preRotation == 270);
+		matrices.perspective = glm::perspective(glm::radians(fov), quarterRotation ? 1.0f / aspect : aspect, znear, zfar);
+		if (flipY) {
+			matrices.perspective[1][1] *= -1.0f;
+		}
+		if (preRotation != 0) {
+			matrices.perspective = glm::rotate(glm::mat4(1.0f), glm::radians(static_cast<float>(preRotation)), glm::vec3(0.0f, 0.0f, 1.0f)) * matrices.perspective;
+		}
+		applyJitter();
+	}
+
+	// Offset the projection by the sub-pixel jitter, with a right handed projection the normalized device coordinates are shifted by -matrix[2].xy
+	void applyJitter()
+	{
+		matrices.perspective[2][0] -= jitter.x;
+		matrices.perspective[2][1] -= jitter.y;
+	}
 
 	void updateViewMatrix()
 	{
@@ -92,20 +116,42 @@ public:
 		this->fov = fov;
 		this->znear = znear;
 		this->zfar = zfar;
-		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
-		if (flipY) {
-			matrices.perspective[1][1] *= -1.0f;
-		}
+		this->aspect = aspect;
+		updatePerspective();
 	};
 
 	void updateAspectRatio(float aspect)
 	{
-		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
-		if (flipY) {
-			matrices.perspective[1][1] *= -1.0f;
+		this->aspect = aspect;
+		updatePerspective();
+	}
+
+	// Rotate the projection clockwise by the given degrees (multiple of 90) to render into pre-rotated swap chain images, set by the example base
+	void setPreRotation(uint32_t degrees)
+	{
+		if (degrees == preRotation) {
+			return;
+		}
+		preRotation = degrees;
+		if (fov > 0.0f) {
+			updatePerspective();
 		}
 	}
 
+	// Sub-pixel offset of the projection in normalized device coordinates (e.g. for temporal anti-aliasing), kept when the perspective changes
+	void setJitter(glm::vec2 jitter)
+	{
+		matrices.perspective[2][0] += this->jitter.x;
+		matrices.perspective[2][1] += this->jitter.y;
+		this->jitter = jitter;
+		applyJitter();
+	}
+
+	glm::vec2 getJitter()
+	{
+		return jitter;
+	}
+
 	void setPosition(glm::vec3 position)
 	{
 		this->position = position;
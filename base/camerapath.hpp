@@ -0,0 +1,118 @@
+/*
+* Camera path recording and replay
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "VulkanAssetFile.h"
+
+namespace vks
+{
+	/**
+	* @brief Camera positions and rotations over (simulated) time, so benchmark runs can move the camera the same way on every device
+	* @note Stored as a text file with one keyframe per line (time in seconds, position, rotation in degrees), lines starting with # are comments
+	*/
+	class CameraPath
+	{
+	public:
+		struct Keyframe
+		{
+			float time;
+			glm::vec3 position;
+			glm::vec3 rotation;
+		};
+		std::vector<Keyframe> keyframes;
+
+		/** @brief Time of the last keyframe, replay loops after that */
+		float duration() const
+		{
+			return keyframes.empty() ? 0.0f : keyframes.back().time;
+		}
+
+		/** @brief Add a keyframe, times must increase, keyframes with unchanged camera are only stored at the start and end of a still phase */
+		void addKeyframe(float time, const glm::vec3& position, const glm::vec3& rotation)
+		{
+			const size_t count = keyframes.size();
+			if ((count >= 2) && (keyframes[count - 1].position == position) && (keyframes[count - 1].rotation == rotation) && (keyframes[count - 2].position == position) && (keyframes[count - 2].rotation == rotation)) {
+				keyframes[count - 1].time = time;
+				return;
+			}
+			keyframes.push_back({ time, position, rotation });
+		}
+
+		/** @brief Interpolate the camera at the given time, wrapped around the duration of the path */
+		void sample(float time, glm::vec3& position, glm::vec3& rotation) const
+		{
+			if (keyframes.empty()) {
+				return;
+			}
+			const float length = duration();
+			if (length > 0.0f) {
+				time = std::fmod(time, length);
+			}
+			auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& keyframe) { return t < keyframe.time; });
+			if (next == keyframes.begin()) {
+				position = next->position;
+				rotation = next->rotation;
+				return;
+			}
+			if (next == keyframes.end()) {
+				position = keyframes.back().position;
+				rotation = keyframes.back().rotation;
+				return;
+			}
+			auto prev = next - 1;
+			const float span = next->time - prev->time;
+			const float t = (span > 0.0f) ? (time - prev->time) / span : 0.0f;
+			position = glm::mix(prev->position, next->position, t);
+			rotation = glm::mix(prev->rotation, next->rotation, t);
+		}
+
+		bool load(const std::string& filename)
+		{
+			vks::AssetFile file;
+			if (!file.open(filename)) {
+				return false;
+			}
+			keyframes.clear();
+			std::istringstream stream(std::string(reinterpret_cast<const char*>(file.data()), file.size()));
+			std::string line;
+			while (std::getline(stream, line)) {
+				if (line.empty() || (line[0] == '#')) {
+					continue;
+				}
+				std::istringstream values(line);
+				Keyframe keyframe;
+				if (values >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z) {
+					keyframes.push_back(keyframe);
+				}
+			}
+			return !keyframes.empty();
+		}
+
+		bool save(const std::string& filename) const
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			file << "# time position.x position.y position.z rotation.x rotation.y rotation.z" << "\n";
+			file.precision(9);
+			for (auto& keyframe : keyframes) {
+				file << keyframe.time << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " " << keyframe.rotation.x << " " << keyframe.rotation.y << " " << keyframe.rotation.z << "\n";
+			}
+			return true;
+		}
+	};
+}
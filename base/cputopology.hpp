@@ -0,0 +1,147 @@
+/*
+* CPU core topology
+*
+* Orders the cores of the CPU by their performance, so threads can be placed on the fast cores of heterogeneous (big.LITTLE) CPUs
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace vks
+{
+	/**
+	* @brief Cores of the CPU, fastest first
+	*
+	* Mobile SoCs combine clusters of fast (big) and power efficient (little) cores, which std::thread::hardware_concurrency counts the same.
+	* On Linux and Android the relative performance of the cores is read from their capacity (or their maximum frequency if the kernel doesn't report a capacity),
+	* other platforms are treated as having cores of equal performance.
+	*
+	* If pinThreads is set, the first (fastest) core is reserved for the main thread and the workers of thread pools and job systems are pinned to the remaining cores in order.
+	*/
+	class CpuTopology
+	{
+	public:
+		struct Core
+		{
+			/** @brief Index of the core as used by the OS */
+			uint32_t id;
+			/** @brief Performance relative to the fastest core (1.0) */
+			float performance;
+		};
+
+	private:
+		std::vector<Core> cores;
+
+		static uint32_t readValue(const std::string& fileName)
+		{
+			std::ifstream file(fileName);
+			uint32_t value = 0;
+			if (file.is_open()) {
+				file >> value;
+			}
+			return value;
+		}
+
+		CpuTopology()
+		{
+			const uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+			std::vector<uint32_t> capacities(coreCount, 0);
+#if defined(__linux__)
+			for (uint32_t i = 0; i < coreCount; i++) {
+				const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/";
+				capacities[i] = readValue(path + "cpu_capacity");
+				if (capacities[i] == 0) {
+					capacities[i] = readValue(path + "cpufreq/cpuinfo_max_freq");
+				}
+			}
+#endif
+			const uint32_t maxCapacity = *std::max_element(capacities.begin(), capacities.end());
+			for (uint32_t i = 0; i < coreCount; i++) {
+				// Cores that don't report anything are counted as fast, so the order only changes if there's something to go by
+				const float performance = ((maxCapacity > 0) && (capacities[i] > 0)) ? static_cast<float>(capacities[i]) / static_cast<float>(maxCapacity) : 1.0f;
+				cores.push_back({ i, performance });
+			}
+			std::stable_sort(cores.begin(), cores.end(), [](const Core& a, const Core& b) { return a.performance > b.performance; });
+		}
+
+	public:
+		/** @brief Performance (relative to the fastest core) below which a core is counted as a little core */
+		static constexpr float bigCoreThreshold = 0.9f;
+
+		/** @brief Pin the main thread and the workers of thread pools and job systems to cores, set with the --pinthreads command line argument */
+		bool pinThreads = false;
+
+		static CpuTopology& get()
+		{
+			static CpuTopology topology;
+			return topology;
+		}
+
+		uint32_t coreCount() const
+		{
+			return static_cast<uint32_t>(cores.size());
+		}
+
+		/** @brief Number of cores in the fastest cluster */
+		uint32_t bigCoreCount() const
+		{
+			return static_cast<uint32_t>(std::count_if(cores.begin(), cores.end(), [](const Core& core) { return core.performance >= bigCoreThreshold; }));
+		}
+
+		/** @brief Returns true if the CPU has cores of different performance */
+		bool heterogeneous() const
+		{
+			return bigCoreCount() < coreCount();
+		}
+
+		/** @brief The fastest core, reserved for the main (render) thread */
+		const Core& mainCore() const
+		{
+			return cores.front();
+		}
+
+		/** @brief Core of the n-th worker thread, workers are placed on the fastest cores first and skip the main thread's core (unless it's the only one) */
+		const Core& workerCore(uint32_t index) const
+		{
+			if (cores.size() == 1) {
+				return cores.front();
+			}
+			return cores[1 + index % (cores.size() - 1)];
+		}
+
+		/**
+		* Pin the calling thread to a single core
+		*
+		* @param coreId Index of the core as used by the OS (see Core::id)
+		* @return True if the thread has been pinned, pinning is not supported on all platforms
+		*/
+		static bool pinCurrentThread(uint32_t coreId)
+		{
+#if defined(_WIN32)
+			return (coreId < sizeof(DWORD_PTR) * 8) && (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << coreId) != 0);
+#elif defined(__linux__)
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(coreId, &cpuSet);
+			return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+			return false;
+#endif
+		}
+	};
+}
@@ -0,0 +1,128 @@
+/*
+* Per frame in flight linear allocator for transient CPU side data (e.g. descriptor writes, barriers or clear values built while recording)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+	/**
+	* @brief Bump allocator with one region per frame in flight
+	*
+	* Allocations are taken from the current frame's region by advancing an offset and are never freed individually. The region of a frame in flight
+	* is reset in one go by beginFrame, once the frame's fence has been waited on, so data recorded for a frame may be referenced until the GPU is done with it.
+	* Allocations that don't fit into a region are served from the heap, the region is then grown at its next reset to hold the whole frame,
+	* so once the largest frame has been seen no heap allocations are made.
+	*/
+	class FrameArena
+	{
+	private:
+		struct Region
+		{
+			std::unique_ptr<uint8_t[]> memory;
+			size_t size = 0;
+			size_t head = 0;
+			// Allocations that didn't fit into the region during the last frame
+			std::vector<std::unique_ptr<uint8_t[]>> overflow;
+			size_t overflowSize = 0;
+		};
+		std::vector<Region> regions;
+		Region* current = nullptr;
+
+	public:
+		/** @brief Most bytes allocated by a single frame so far */
+		size_t highWatermark = 0;
+
+		/** @brief Create one region of (initially) regionSize bytes per frame in flight */
+		void setup(size_t regionSize, uint32_t frameCount)
+		{
+			regions.clear();
+			regions.resize(frameCount);
+			for (auto& region : regions) {
+				region.memory.reset(new uint8_t[regionSize]);
+				region.size = regionSize;
+			}
+			current = &regions[0];
+		}
+
+		/** @brief Release everything the given frame in flight allocated the last time it was recorded, the frame's fence must have been waited on */
+		void beginFrame(uint32_t frameIndex)
+		{
+			assert(frameIndex < regions.size());
+			current = &regions[frameIndex];
+			if (current->overflowSize > 0) {
+				// Grow the region so the next frame of the same size fits into it
+				current->size = current->head + current->overflowSize;
+				current->memory.reset(new uint8_t[current->size]);
+				current->overflow.clear();
+				current->overflowSize = 0;
+			}
+			current->head = 0;
+		}
+
+		/** @brief Allocate size bytes from the current frame's region */
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			assert(current != nullptr);
+			const uintptr_t base = reinterpret_cast<uintptr_t>(current->memory.get());
+			const uintptr_t address = (base + current->head + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+			const size_t end = static_cast<size_t>(address - base) + size;
+			if (end <= current->size) {
+				current->head = end;
+				highWatermark = std::max(highWatermark, current->head + current->overflowSize);
+				return reinterpret_cast<void*>(address);
+			}
+			// Doesn't fit, padded so the result can be aligned
+			current->overflow.emplace_back(new uint8_t[size + alignment]);
+			current->overflowSize += size + alignment;
+			highWatermark = std::max(highWatermark, current->head + current->overflowSize);
+			const uintptr_t overflowBase = reinterpret_cast<uintptr_t>(current->overflow.back().get());
+			return reinterpret_cast<void*>((overflowBase + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+		}
+
+		bool isReady() const
+		{
+			return current != nullptr;
+		}
+	};
+
+	/**
+	* @brief STL allocator that takes its memory from a FrameArena, deallocation is a no-op as the memory is released with the frame
+	* @note Containers using this must not outlive the frame in flight they were created for
+	*/
+	template<typename T>
+	class FrameArenaAllocator
+	{
+	public:
+		typedef T value_type;
+		FrameArena* arena;
+
+		FrameArenaAllocator(FrameArena& arena) : arena(&arena) {}
+		template<typename U> FrameArenaAllocator(const FrameArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, size_t) {}
+
+		template<typename U> bool operator==(const FrameArenaAllocator<U>& other) const { return arena == other.arena; }
+		template<typename U> bool operator!=(const FrameArenaAllocator<U>& other) const { return arena != other.arena; }
+	};
+
+	/** @brief Vector for data that only lives for the frame it's recorded in, e.g. vks::FrameVector<VkWriteDescriptorSet> writes(frameArena) */
+	template<typename T>
+	using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
+}
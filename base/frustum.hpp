@@ -7,11 +7,57 @@
 */
 
 #include <array>
+#include <algorithm>
 #include <math.h>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
+// The batched tests process four objects at once with SSE (part of all x86-64 targets) or NEON, other targets use the scalar path
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define VKS_FRUSTUM_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_FRUSTUM_NEON
+#include <arm_neon.h>
+#endif
+
 namespace vks
 {
+	namespace simd
+	{
+#if defined(VKS_FRUSTUM_SSE)
+		typedef __m128 float4;
+		typedef __m128 mask4;
+		inline float4 load4(const float* p) { return _mm_loadu_ps(p); }
+		inline float4 splat4(float v) { return _mm_set1_ps(v); }
+		inline float4 mulAdd4(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		inline float4 negate4(float4 a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+		inline mask4 allTrue4() { const __m128 zero = _mm_setzero_ps(); return _mm_cmpeq_ps(zero, zero); }
+		inline mask4 greater4(float4 a, float4 b) { return _mm_cmpgt_ps(a, b); }
+		inline mask4 greaterEqual4(float4 a, float4 b) { return _mm_cmpge_ps(a, b); }
+		inline mask4 and4(mask4 a, mask4 b) { return _mm_and_ps(a, b); }
+		inline uint32_t bits4(mask4 m) { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+#elif defined(VKS_FRUSTUM_NEON)
+		typedef float32x4_t float4;
+		typedef uint32x4_t mask4;
+		inline float4 load4(const float* p) { return vld1q_f32(p); }
+		inline float4 splat4(float v) { return vdupq_n_f32(v); }
+		inline float4 mulAdd4(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+		inline float4 negate4(float4 a) { return vnegq_f32(a); }
+		inline mask4 allTrue4() { return vdupq_n_u32(0xFFFFFFFF); }
+		inline mask4 greater4(float4 a, float4 b) { return vcgtq_f32(a, b); }
+		inline mask4 greaterEqual4(float4 a, float4 b) { return vcgeq_f32(a, b); }
+		inline mask4 and4(mask4 a, mask4 b) { return vandq_u32(a, b); }
+		inline uint32_t bits4(mask4 m)
+		{
+			const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+			const uint32x4_t bits = vandq_u32(m, vld1q_u32(laneBits));
+			const uint32x2_t sum = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+			return vget_lane_u32(sum, 0) | vget_lane_u32(sum, 1);
+		}
+#endif
+	}
+
 	class Frustum
 	{
 	public:
@@ -68,5 +114,107 @@ namespace vks
 			}
 			return true;
 		}
+
+		/**
+		* Test a batch of spheres against the frustum
+		*
+		* @param x, y, z Centers of the spheres (structure of arrays)
+		* @param radius Radii of the spheres
+		* @param count Number of spheres
+		* @param visibility Bit mask with one bit per sphere ((count + 31) / 32 words), a bit is set if its sphere is at least partially inside
+		*
+		* @note Batches can be split between threads (e.g. with JobSystem::parallelFor) by offsetting the arrays, as long as ranges start at a multiple of 32 so each thread writes its own words
+		*/
+		void checkSpheres(const float* x, const float* y, const float* z, const float* radius, uint32_t count, uint32_t* visibility) const
+		{
+			std::fill(visibility, visibility + (count + 31) / 32, 0u);
+			uint32_t i = 0;
+#if defined(VKS_FRUSTUM_SSE) || defined(VKS_FRUSTUM_NEON)
+			for (; i + 4 <= count; i += 4)
+			{
+				const simd::float4 px = simd::load4(x + i);
+				const simd::float4 py = simd::load4(y + i);
+				const simd::float4 pz = simd::load4(z + i);
+				const simd::float4 negRadius = simd::negate4(simd::load4(radius + i));
+				simd::mask4 inside = simd::allTrue4();
+				for (auto& plane : planes)
+				{
+					const simd::float4 distance = simd::mulAdd4(px, simd::splat4(plane.x), simd::mulAdd4(py, simd::splat4(plane.y), simd::mulAdd4(pz, simd::splat4(plane.z), simd::splat4(plane.w))));
+					inside = simd::and4(inside, simd::greater4(distance, negRadius));
+				}
+				visibility[i >> 5] |= simd::bits4(inside) << (i & 31);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				bool inside = true;
+				for (auto& plane : planes)
+				{
+					if ((plane.x * x[i]) + (plane.y * y[i]) + (plane.z * z[i]) + plane.w <= -radius[i])
+					{
+						inside = false;
+						break;
+					}
+				}
+				if (inside)
+				{
+					visibility[i >> 5] |= 1u << (i & 31);
+				}
+			}
+		}
+
+		/**
+		* Test a batch of axis aligned bounding boxes against the frustum
+		*
+		* @param minX, minY, minZ Minimum corners of the boxes (structure of arrays)
+		* @param maxX, maxY, maxZ Maximum corners of the boxes
+		* @param count Number of boxes
+		* @param visibility Bit mask with one bit per box ((count + 31) / 32 words), a bit is set if its box is at least partially inside
+		*
+		* @note Boxes are only culled if they are completely behind one of the planes, so boxes close to the corners of the frustum may be reported as visible
+		*/
+		void checkBoxes(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ, uint32_t count, uint32_t* visibility) const
+		{
+			std::fill(visibility, visibility + (count + 31) / 32, 0u);
+			// The corner furthest along a plane's normal only depends on the plane, so it's picked per plane instead of per box
+			std::array<const float*, 6> cornerX, cornerY, cornerZ;
+			for (size_t p = 0; p < planes.size(); p++)
+			{
+				cornerX[p] = (planes[p].x >= 0.0f) ? maxX : minX;
+				cornerY[p] = (planes[p].y >= 0.0f) ? maxY : minY;
+				cornerZ[p] = (planes[p].z >= 0.0f) ? maxZ : minZ;
+			}
+			uint32_t i = 0;
+#if defined(VKS_FRUSTUM_SSE) || defined(VKS_FRUSTUM_NEON)
+			const simd::float4 zero = simd::splat4(0.0f);
+			for (; i + 4 <= count; i += 4)
+			{
+				simd::mask4 inside = simd::allTrue4();
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					const glm::vec4& plane = planes[p];
+					const simd::float4 distance = simd::mulAdd4(simd::load4(cornerX[p] + i), simd::splat4(plane.x), simd::mulAdd4(simd::load4(cornerY[p] + i), simd::splat4(plane.y), simd::mulAdd4(simd::load4(cornerZ[p] + i), simd::splat4(plane.z), simd::splat4(plane.w))));
+					inside = simd::and4(inside, simd::greaterEqual4(distance, zero));
+				}
+				visibility[i >> 5] |= simd::bits4(inside) << (i & 31);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				bool inside = true;
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					if ((planes[p].x * cornerX[p][i]) + (planes[p].y * cornerY[p][i]) + (planes[p].z * cornerZ[p][i]) + planes[p].w < 0.0f)
+					{
+						inside = false;
+						break;
+					}
+				}
+				if (inside)
+				{
+					visibility[i >> 5] |= 1u << (i & 31);
+				}
+			}
+		}
 	};
 }
@@ -0,0 +1,357 @@
+/*
+* Index buffer optimization
+*
+* Load time reordering of indexed triangle lists for the post-transform vertex cache (Tom Forsyth's linear-speed vertex cache optimization),
+* for less overdraw (sorting clusters of triangles by their facing, as done by Tipsify) and of vertices for vertex fetch locality
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace indexoptimizer
+	{
+		/** @brief Size of the FIFO cache that is simulated for the average cache miss ratio (ACMR) */
+		const uint32_t fifoCacheSize = 16;
+		/** @brief Size of the LRU cache the vertex cache optimization scores vertices with */
+		const uint32_t lruCacheSize = 32;
+
+		/**
+		* Count the vertex shader invocations of a triangle list with a simulated FIFO post-transform cache
+		*
+		* @param indices Triangle list indices, in the range [0, vertexCount)
+		* @param indexCount Number of indices
+		* @param vertexCount Number of vertices referenced by the indices
+		* @param cacheSize (Optional) Number of entries of the simulated cache
+		*
+		* @return Number of cache misses, divide by the triangle count for the ACMR
+		*/
+		inline uint32_t cacheMisses(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = fifoCacheSize)
+		{
+			// Each vertex stores when it was last put into the cache, it is still cached if less than cacheSize vertices have been put in since
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			uint32_t misses = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				if (time - timestamps[index] > cacheSize) {
+					timestamps[index] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		namespace detail
+		{
+			inline float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+			{
+				if (remainingTriangles == 0) {
+					return -1.0f;
+				}
+				float score = 0.0f;
+				if (cachePosition >= 0) {
+					// Vertices of the last triangle get a fixed score, so the next triangle doesn't depend on the order they were put in
+					if (cachePosition < 3) {
+						score = 0.75f;
+					} else {
+						score = powf(1.0f - (float)(cachePosition - 3) / (float)(lruCacheSize - 3), 1.5f);
+					}
+				}
+				// Prefer vertices with few remaining triangles, so these get finished instead of leaving isolated triangles behind
+				score += 2.0f * powf((float)remainingTriangles, -0.5f);
+				return score;
+			}
+		}
+
+		/**
+		* Reorder the triangles of a triangle list for the post-transform vertex cache
+		*
+		* Greedily emits the triangle with the highest score, where triangles score higher the more of their vertices are in a simulated LRU cache
+		* and the fewer triangles remain at their vertices. Only triangles adjacent to cached vertices are considered, so this runs in linear time
+		*
+		* @param indices Triangle list indices, in the range [0, vertexCount), reordered in place
+		* @param indexCount Number of indices
+		* @param vertexCount Number of vertices referenced by the indices
+		*/
+		inline void optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount < 2) {
+				return;
+			}
+
+			// Triangles adjacent to each vertex, the first remainingTriangles[v] entries of a vertex are the ones not emitted yet
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				adjacencyOffsets[indices[i] + 1]++;
+			}
+			std::vector<uint32_t> remainingTriangles(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				remainingTriangles[v] = adjacencyOffsets[v + 1];
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < triangleCount * 3; i++) {
+					adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<int32_t> cachePositions(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				vertexScores[v] = detail::vertexScore(-1, remainingTriangles[v]);
+			}
+			std::vector<float> triangleScores(triangleCount);
+			for (size_t t = 0; t < triangleCount; t++) {
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+			}
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> output(triangleCount * 3);
+
+			uint32_t cache[lruCacheSize + 3];
+			uint32_t cacheCount = 0;
+			size_t nextUnemitted = 0;
+			int64_t bestTriangle = -1;
+
+			for (size_t outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++) {
+				if (bestTriangle < 0) {
+					// No triangle adjacent to the cache is left, continue with the next one in input order
+					while (emitted[nextUnemitted]) {
+						nextUnemitted++;
+					}
+					bestTriangle = static_cast<int64_t>(nextUnemitted);
+				}
+				const size_t triangle = static_cast<size_t>(bestTriangle);
+				const uint32_t* vertices = &indices[triangle * 3];
+				output[outputTriangle * 3] = vertices[0];
+				output[outputTriangle * 3 + 1] = vertices[1];
+				output[outputTriangle * 3 + 2] = vertices[2];
+				emitted[triangle] = true;
+
+				// Remove the triangle from the remaining triangles of its vertices
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t v = vertices[k];
+					uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+					uint32_t* end = begin + remainingTriangles[v];
+					uint32_t* entry = std::find(begin, end, static_cast<uint32_t>(triangle));
+					if (entry != end) {
+						std::swap(*entry, *(end - 1));
+						remainingTriangles[v]--;
+					}
+				}
+
+				// Move the triangle's vertices to the front of the cache, vertices pushed past its size are evicted
+				uint32_t newCache[lruCacheSize + 3];
+				uint32_t newCacheCount = 0;
+				for (uint32_t k = 0; k < 3; k++) {
+					if (std::find(newCache, newCache + newCacheCount, vertices[k]) == newCache + newCacheCount) {
+						newCache[newCacheCount++] = vertices[k];
+					}
+				}
+				const uint32_t triangleVertexCount = newCacheCount;
+				for (uint32_t i = 0; i < cacheCount; i++) {
+					if (std::find(newCache, newCache + triangleVertexCount, cache[i]) == newCache + triangleVertexCount) {
+						newCache[newCacheCount++] = cache[i];
+					}
+				}
+
+				// Update the scores of all vertices whose cache position changed and of their remaining triangles
+				for (uint32_t i = 0; i < newCacheCount; i++) {
+					const uint32_t v = newCache[i];
+					cachePositions[v] = (i < lruCacheSize) ? static_cast<int32_t>(i) : -1;
+					const float score = detail::vertexScore(cachePositions[v], remainingTriangles[v]);
+					const float delta = score - vertexScores[v];
+					vertexScores[v] = score;
+					for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+						triangleScores[adjacency[adjacencyOffsets[v] + j]] += delta;
+					}
+				}
+				cacheCount = std::min(newCacheCount, lruCacheSize);
+				std::copy(newCache, newCache + cacheCount, cache);
+
+				// The next triangle is the best scoring one adjacent to the cache
+				bestTriangle = -1;
+				float bestScore = -std::numeric_limits<float>::max();
+				for (uint32_t i = 0; i < cacheCount; i++) {
+					const uint32_t v = cache[i];
+					for (uint32_t j = 0; j < remainingTriangles[v]; j++) {
+						const uint32_t candidate = adjacency[adjacencyOffsets[v] + j];
+						if (triangleScores[candidate] > bestScore) {
+							bestScore = triangleScores[candidate];
+							bestTriangle = candidate;
+						}
+					}
+				}
+			}
+
+			std::copy(output.begin(), output.end(), indices);
+		}
+
+		/**
+		* Reorder clusters of triangles so that triangles likely to occlude others are drawn first, keeping the vertex cache efficiency
+		*
+		* The (vertex cache optimized) triangle list is split into clusters wherever splitting keeps the cache miss ratio within the threshold.
+		* Clusters are then sorted by how much they face outwards from the center of the mesh, as outward facing clusters tend to occlude the rest
+		*
+		* @param indices Triangle list indices, in the range [0, vertexCount), reordered in place
+		* @param indexCount Number of indices
+		* @param positions Pointer to the position (three floats) of the first vertex
+		* @param positionStride Distance in bytes between the positions of consecutive vertices
+		* @param vertexCount Number of vertices referenced by the indices
+		* @param threshold (Optional) Factor the cache miss ratio is allowed to increase by
+		*/
+		inline void optimizeOverdraw(uint32_t* indices, size_t indexCount, const void* positions, size_t positionStride, uint32_t vertexCount, float threshold = 1.05f)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount < 2) {
+				return;
+			}
+			auto position = [&](uint32_t index) -> const glm::vec3& {
+				return *reinterpret_cast<const glm::vec3*>(static_cast<const uint8_t*>(positions) + static_cast<size_t>(index) * positionStride);
+			};
+
+			const uint32_t missesBefore = cacheMisses(indices, triangleCount * 3, vertexCount);
+
+			// Split into clusters, a cluster ends where the cache had to be refilled anyway (all three vertices of a triangle missed)
+			// or where drawing the cluster on its own, i.e. starting with an empty cache, costs at most threshold times the misses it has in the current order
+			const uint32_t minClusterTriangles = 16;
+			std::vector<uint32_t> clusterStarts;
+			{
+				// Misses in the current order, and of the current cluster if drawn on its own (its cache is flushed by advancing its time)
+				std::vector<uint32_t> timestamps(vertexCount, 0);
+				std::vector<uint32_t> clusterTimestamps(vertexCount, 0);
+				uint32_t time = fifoCacheSize + 1;
+				uint32_t clusterTime = fifoCacheSize + 1;
+				uint32_t misses = 0;
+				uint32_t clusterMisses = 0;
+				uint32_t clusterTriangles = 0;
+				for (size_t t = 0; t < triangleCount; t++) {
+					uint32_t triangleMisses = 0;
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t index = indices[t * 3 + k];
+						if (time - timestamps[index] > fifoCacheSize) {
+							timestamps[index] = time++;
+							triangleMisses++;
+						}
+					}
+					const bool hardBoundary = (clusterTriangles == 0) || (triangleMisses == 3);
+					const bool softBoundary = (clusterTriangles >= minClusterTriangles) && ((float)clusterMisses <= threshold * (float)misses);
+					if (hardBoundary || softBoundary) {
+						clusterStarts.push_back(static_cast<uint32_t>(t));
+						clusterTime += fifoCacheSize + 1;
+						misses = 0;
+						clusterMisses = 0;
+						clusterTriangles = 0;
+					}
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t index = indices[t * 3 + k];
+						if (clusterTime - clusterTimestamps[index] > fifoCacheSize) {
+							clusterTimestamps[index] = clusterTime++;
+							clusterMisses++;
+						}
+					}
+					misses += triangleMisses;
+					clusterTriangles++;
+				}
+			}
+			if (clusterStarts.size() < 2) {
+				return;
+			}
+
+			glm::vec3 meshCenter(0.0f);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				meshCenter += position(v);
+			}
+			meshCenter /= (float)vertexCount;
+
+			// Sort key of each cluster, the area weighted centroid projected onto the area weighted cluster normal
+			struct Cluster {
+				uint32_t start;
+				uint32_t end;
+				float key;
+			};
+			std::vector<Cluster> clusters(clusterStarts.size());
+			for (size_t c = 0; c < clusterStarts.size(); c++) {
+				Cluster& cluster = clusters[c];
+				cluster.start = clusterStarts[c];
+				cluster.end = (c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+				glm::vec3 centroid(0.0f);
+				glm::vec3 normal(0.0f);
+				float area = 0.0f;
+				for (uint32_t t = cluster.start; t < cluster.end; t++) {
+					const glm::vec3& p0 = position(indices[t * 3]);
+					const glm::vec3& p1 = position(indices[t * 3 + 1]);
+					const glm::vec3& p2 = position(indices[t * 3 + 2]);
+					const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+					const float faceArea = glm::length(faceNormal);
+					centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+					normal += faceNormal;
+					area += faceArea;
+				}
+				const float normalLength = glm::length(normal);
+				cluster.key = ((area > 0.0f) && (normalLength > 0.0f)) ? glm::dot(centroid / area - meshCenter, normal / normalLength) : 0.0f;
+			}
+			std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+			std::vector<uint32_t> output;
+			output.reserve(triangleCount * 3);
+			for (const Cluster& cluster : clusters) {
+				output.insert(output.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+			}
+
+			// Keep the original order if sorting the clusters costs more cache efficiency than allowed
+			const uint32_t missesAfter = cacheMisses(output.data(), output.size(), vertexCount);
+			if ((float)missesAfter <= threshold * (float)missesBefore) {
+				std::copy(output.begin(), output.end(), indices);
+			}
+		}
+
+		/**
+		* Reorder vertices in the order they are first referenced by the indices, so vertex fetches access memory mostly sequentially
+		*
+		* @param indices Triangle list indices, in the range [0, vertexCount), remapped in place
+		* @param indexCount Number of indices
+		* @param vertices Vertices, reordered in place (unreferenced vertices are moved to the end)
+		* @param vertexCount Number of vertices
+		*/
+		template<typename T>
+		inline void optimizeVertexFetch(uint32_t* indices, size_t indexCount, T* vertices, uint32_t vertexCount)
+		{
+			const uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+			std::vector<uint32_t> remap(vertexCount, unassigned);
+			uint32_t next = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				uint32_t& target = remap[indices[i]];
+				if (target == unassigned) {
+					target = next++;
+				}
+				indices[i] = target;
+			}
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (remap[v] == unassigned) {
+					remap[v] = next++;
+				}
+			}
+			std::vector<T> reordered(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				reordered[remap[v]] = vertices[v];
+			}
+			std::copy(reordered.begin(), reordered.end(), vertices);
+		}
+	}
+}
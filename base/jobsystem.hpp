@@ -0,0 +1,389 @@
+/*
+* C++11 based work stealing job system
+*
+* Each worker owns a lock-free deque of jobs (Chase-Lev), idle workers steal jobs from the other workers' deques
+* Jobs are stored inline in per-worker job rings, so scheduling a job doesn't allocate
+* If pinning is enabled (see CpuTopology), workers on little cores leave the last queued jobs to the big cores, so a parallel loop doesn't finish at the pace of its slowest core
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+
+#include "cputopology.hpp"
+
+namespace vks
+{
+	class JobSystem;
+
+	/** @brief Counts the unfinished jobs scheduled with it, can be waited on and used as a dependency of other jobs */
+	class JobCounter
+	{
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> value;
+	public:
+		JobCounter() : value(0) {}
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+		/** @brief Returns true if all jobs scheduled with this counter have finished */
+		bool done() const
+		{
+			return value.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	class JobSystem
+	{
+	public:
+		/** @brief Size of the inline storage for the job's function object, larger captures should be passed by pointer */
+		static const size_t jobStorageSize = 64;
+
+	private:
+		static const uint32_t jobCapacity = 4096;
+
+		struct Job
+		{
+			void (*execute)(Job* job) = nullptr;
+			JobCounter* counter = nullptr;
+			const JobCounter* dependency = nullptr;
+			std::atomic<bool> pending;
+			typename std::aligned_storage<jobStorageSize, alignof(std::max_align_t)>::type storage;
+			Job() : pending(false) {}
+		};
+
+		// Chase-Lev work stealing deque, push and pop are only called by the owning worker, steal by any other thread
+		class JobDeque
+		{
+		private:
+			std::atomic<int64_t> top;
+			std::atomic<int64_t> bottom;
+			std::unique_ptr<std::atomic<Job*>[]> jobs;
+		public:
+			JobDeque() : top(0), bottom(0), jobs(new std::atomic<Job*>[jobCapacity]) {}
+
+			bool push(Job* job)
+			{
+				const int64_t b = bottom.load(std::memory_order_relaxed);
+				const int64_t t = top.load(std::memory_order_acquire);
+				if (b - t >= static_cast<int64_t>(jobCapacity)) {
+					return false;
+				}
+				jobs[b & (jobCapacity - 1)].store(job, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			Job* pop()
+			{
+				const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+				if (t > b) {
+					// Empty
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				Job* job = jobs[b & (jobCapacity - 1)].load(std::memory_order_relaxed);
+				if (t == b) {
+					// Last job, race against thieves
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						job = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			/** @brief Number of queued jobs, only approximate if called by a thread other than the owner */
+			int64_t size() const
+			{
+				return std::max(bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed), static_cast<int64_t>(0));
+			}
+
+			Job* steal()
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b) {
+					return nullptr;
+				}
+				Job* job = jobs[t & (jobCapacity - 1)].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				return job;
+			}
+		};
+
+		struct Worker
+		{
+			JobDeque deque;
+			// Ring of job slots, only allocated from by the owning worker
+			std::unique_ptr<Job[]> jobs;
+			uint32_t nextJob = 0;
+			std::thread thread;
+			/** @brief Set if the worker is pinned to a core slower than the fastest cluster */
+			bool littleCore = false;
+			Worker() : jobs(new Job[jobCapacity]) {}
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		/** @brief Number of workers that aren't on little cores, including the creating thread */
+		uint32_t bigWorkerCount = 0;
+		std::atomic<bool> running;
+		std::atomic<uint32_t> queuedJobs;
+		std::atomic<uint32_t> sleepingWorkers;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		struct ThreadContext
+		{
+			JobSystem* jobSystem = nullptr;
+			uint32_t workerIndex = 0;
+		};
+		static ThreadContext& threadContext()
+		{
+			static thread_local ThreadContext context;
+			return context;
+		}
+
+		Worker& currentWorker()
+		{
+			// Jobs can only be scheduled from the thread that created the job system or from within jobs
+			assert(threadContext().jobSystem == this);
+			return *workers[threadContext().workerIndex];
+		}
+
+		Job* allocateJob()
+		{
+			Worker& worker = currentWorker();
+			Job* job = &worker.jobs[worker.nextJob];
+			// All slots of the ring are in use, help out until the oldest one has finished
+			while (job->pending.load(std::memory_order_acquire)) {
+				if (!executeNext()) {
+					std::this_thread::yield();
+				}
+			}
+			worker.nextJob = (worker.nextJob + 1) % jobCapacity;
+			return job;
+		}
+
+		Job* getJob()
+		{
+			const uint32_t workerIndex = threadContext().workerIndex;
+			Job* job = workers[workerIndex]->deque.pop();
+			// Own deque is empty, try to steal from the other workers
+			// Workers on little cores only steal while there are more jobs queued than there are big workers to pick them up
+			const bool littleCore = workers[workerIndex]->littleCore;
+			for (uint32_t i = 1; !job && (i < workers.size()); i++) {
+				JobDeque& victim = workers[(workerIndex + i) % workers.size()]->deque;
+				if (!littleCore || (victim.size() > static_cast<int64_t>(bigWorkerCount))) {
+					job = victim.steal();
+				}
+			}
+			if (job) {
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		void execute(Job* job)
+		{
+			if (job->dependency) {
+				wait(*job->dependency);
+			}
+			JobCounter* counter = job->counter;
+			job->execute(job);
+			job->pending.store(false, std::memory_order_release);
+			counter->value.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		bool executeNext()
+		{
+			Job* job = getJob();
+			if (job) {
+				execute(job);
+				return true;
+			}
+			return false;
+		}
+
+		void workerLoop(uint32_t workerIndex, int32_t coreId)
+		{
+			if (coreId >= 0) {
+				CpuTopology::pinCurrentThread(static_cast<uint32_t>(coreId));
+			}
+			threadContext().jobSystem = this;
+			threadContext().workerIndex = workerIndex;
+			uint32_t idleCount = 0;
+			while (running.load(std::memory_order_acquire)) {
+				if (executeNext()) {
+					idleCount = 0;
+					continue;
+				}
+				// Spin for a short while before going to sleep, as new jobs usually arrive in bursts
+				if (++idleCount < 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1);
+				sleepCondition.wait(lock, [this] { return (queuedJobs.load() > 0) || !running.load(); });
+				sleepingWorkers.fetch_sub(1);
+				idleCount = 0;
+			}
+		}
+
+		template<typename Function>
+		static void executeFunction(Job* job)
+		{
+			Function* function = reinterpret_cast<Function*>(&job->storage);
+			(*function)();
+			function->~Function();
+		}
+
+	public:
+		/**
+		* Create the job system, the creating thread becomes worker 0 and helps executing jobs while waiting
+		* If pinning is enabled (see CpuTopology), the other workers are pinned to the cores besides the one reserved for the main thread, fastest first
+		*
+		* @param workerCount (Optional) Total number of workers including the creating thread (Defaults to the number of hardware threads)
+		*/
+		explicit JobSystem(uint32_t workerCount = 0) : running(true), queuedJobs(0), sleepingWorkers(0)
+		{
+			if (workerCount == 0) {
+				workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+			}
+			const CpuTopology& topology = CpuTopology::get();
+			for (uint32_t i = 0; i < workerCount; i++) {
+				workers.push_back(std::unique_ptr<Worker>(new Worker()));
+				workers[i]->littleCore = topology.pinThreads && (i > 0) && (topology.workerCore(i - 1).performance < CpuTopology::bigCoreThreshold);
+				bigWorkerCount += workers[i]->littleCore ? 0 : 1;
+			}
+			threadContext().jobSystem = this;
+			threadContext().workerIndex = 0;
+			for (uint32_t i = 1; i < workerCount; i++) {
+				const int32_t coreId = topology.pinThreads ? static_cast<int32_t>(topology.workerCore(i - 1).id) : -1;
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i, coreId);
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				running.store(false);
+			}
+			sleepCondition.notify_all();
+			for (auto& worker : workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
+				}
+			}
+			if (threadContext().jobSystem == this) {
+				threadContext().jobSystem = nullptr;
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/** @brief Total number of workers, including the thread that created the job system */
+		uint32_t workerCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		/** @brief Index of the worker executing the calling job, can be used to select per worker resources (e.g. command pools) */
+		uint32_t workerIndex() const
+		{
+			return threadContext().workerIndex;
+		}
+
+		/**
+		* Schedule a job
+		*
+		* @param counter Counter that is incremented now and decremented once the job has finished
+		* @param function Function object to execute, stored in the job without allocating (must fit into jobStorageSize)
+		* @param dependency (Optional) Counter whose jobs have to finish before this job starts, these need to be scheduled before this job
+		*/
+		template<typename F>
+		void run(JobCounter& counter, F&& function, const JobCounter* dependency = nullptr)
+		{
+			typedef typename std::decay<F>::type Function;
+			static_assert(sizeof(Function) <= jobStorageSize, "Job function exceeds the inline job storage, capture large state by pointer");
+			static_assert(alignof(Function) <= alignof(std::max_align_t), "Job function alignment not supported");
+			Job* job = allocateJob();
+			new (&job->storage) Function(std::forward<F>(function));
+			job->execute = &JobSystem::executeFunction<Function>;
+			job->counter = &counter;
+			job->dependency = dependency;
+			job->pending.store(true, std::memory_order_relaxed);
+			counter.value.fetch_add(1, std::memory_order_relaxed);
+			if (!currentWorker().deque.push(job)) {
+				// Deque is full, run the job right away
+				execute(job);
+				return;
+			}
+			queuedJobs.fetch_add(1);
+			if (sleepingWorkers.load() > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		/** @brief Wait for all jobs scheduled with the counter to finish, the calling thread executes jobs while waiting */
+		void wait(const JobCounter& counter)
+		{
+			while (!counter.done()) {
+				if (!executeNext()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/**
+		* Call a function for all indices in [0, count) in parallel and wait for completion
+		*
+		* @param count Number of indices
+		* @param function Function called with a range of indices (begin, end) per chunk
+		* @param chunkSize (Optional) Number of indices per job (Defaults to splitting the range into a few chunks per worker, so uneven costs balance out)
+		*/
+		template<typename F>
+		void parallelFor(uint32_t count, const F& function, uint32_t chunkSize = 0)
+		{
+			if (count == 0) {
+				return;
+			}
+			if (chunkSize == 0) {
+				chunkSize = std::max(count / (workerCount() * 4), 1u);
+			}
+			JobCounter counter;
+			const F* functionPtr = &function;
+			for (uint32_t begin = 0; begin < count; begin += chunkSize) {
+				const uint32_t end = std::min(begin + chunkSize, count);
+				run(counter, [functionPtr, begin, end] { (*functionPtr)(begin, end); });
+			}
+			wait(counter);
+		}
+	};
+}
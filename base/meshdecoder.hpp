@@ -0,0 +1,485 @@
+/*
+* Compressed mesh data decoding
+*
+* Decoders for the vertex and index codecs and filters of the EXT_meshopt_compression glTF extension (bitstream version 0 and 1 of meshoptimizer)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+namespace vks
+{
+	namespace meshdecoder
+	{
+		enum class Filter { None, Octahedral, Quaternion, Exponential };
+
+		namespace detail
+		{
+			const uint8_t vertexHeader = 0xA0;
+			const uint8_t indexHeader = 0xE0;
+			const uint8_t sequenceHeader = 0xD0;
+			// Vertex data is encoded in blocks of up to 8 KB, with each byte of the vertices stored in groups of 16 deltas
+			const size_t vertexBlockSizeBytes = 8192;
+			const size_t vertexBlockMaxSize = 256;
+			const size_t byteGroupSize = 16;
+			// Largest size of an encoded byte group, the tail of the vertex data guarantees that this can always be read
+			const size_t byteGroupDecodeLimit = 24;
+			const size_t tailMinSize = 32;
+
+			inline size_t vertexBlockSize(size_t vertexSize)
+			{
+				const size_t size = (vertexBlockSizeBytes / vertexSize) & ~(byteGroupSize - 1);
+				return size < vertexBlockMaxSize ? size : vertexBlockMaxSize;
+			}
+
+			inline uint8_t unzigzag8(uint8_t v)
+			{
+				return static_cast<uint8_t>(-(v & 1) ^ (v >> 1));
+			}
+
+			// Bytes that don't fit into the group's bit count are stored in full behind its packed values
+			inline const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* buffer, int bitsLog2)
+			{
+				switch (bitsLog2) {
+				case 0:
+					memset(buffer, 0, byteGroupSize);
+					return data;
+				case 1:
+				case 2: {
+					const uint32_t bits = 1u << bitsLog2;
+					const uint32_t escape = (1u << bits) - 1;
+					const uint32_t valuesPerByte = 8 / bits;
+					const uint8_t* extra = data + byteGroupSize / valuesPerByte;
+					for (size_t i = 0; i < byteGroupSize; i += valuesPerByte) {
+						uint8_t byte = *data++;
+						for (uint32_t j = 0; j < valuesPerByte; j++) {
+							const uint32_t enc = byte >> (8 - bits);
+							byte = static_cast<uint8_t>(byte << bits);
+							if (enc == escape) {
+								*buffer++ = *extra++;
+							} else {
+								*buffer++ = static_cast<uint8_t>(enc);
+							}
+						}
+					}
+					return extra;
+				}
+				default:
+					memcpy(buffer, data, byteGroupSize);
+					return data + byteGroupSize;
+				}
+			}
+
+			inline const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* dataEnd, uint8_t* buffer, size_t bufferSize)
+			{
+				// Two bits per group select its bit count
+				const uint8_t* header = data;
+				const size_t headerSize = (bufferSize / byteGroupSize + 3) / 4;
+				if (static_cast<size_t>(dataEnd - data) < headerSize) {
+					return nullptr;
+				}
+				data += headerSize;
+				for (size_t i = 0; i < bufferSize; i += byteGroupSize) {
+					if (static_cast<size_t>(dataEnd - data) < byteGroupDecodeLimit) {
+						return nullptr;
+					}
+					const size_t group = i / byteGroupSize;
+					const int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+					data = decodeBytesGroup(data, buffer + i, bitsLog2);
+				}
+				return data;
+			}
+
+			inline const uint8_t* decodeVertexBlock(const uint8_t* data, const uint8_t* dataEnd, uint8_t* vertexData, size_t vertexCount, size_t vertexSize, uint8_t lastVertex[256])
+			{
+				uint8_t buffer[vertexBlockMaxSize];
+				uint8_t transposed[vertexBlockSizeBytes];
+				const size_t vertexCountAligned = (vertexCount + byteGroupSize - 1) & ~(byteGroupSize - 1);
+				// Each byte of the vertex is stored as deltas to the same byte of the previous vertex
+				for (size_t k = 0; k < vertexSize; k++) {
+					data = decodeBytes(data, dataEnd, buffer, vertexCountAligned);
+					if (!data) {
+						return nullptr;
+					}
+					uint8_t p = lastVertex[k];
+					for (size_t i = 0; i < vertexCount; i++) {
+						const uint8_t v = static_cast<uint8_t>(unzigzag8(buffer[i]) + p);
+						transposed[i * vertexSize + k] = v;
+						p = v;
+					}
+				}
+				memcpy(vertexData, transposed, vertexCount * vertexSize);
+				memcpy(lastVertex, &transposed[vertexSize * (vertexCount - 1)], vertexSize);
+				return data;
+			}
+
+			inline uint32_t decodeVByte(const uint8_t*& data)
+			{
+				const uint8_t lead = *data++;
+				if (lead < 128) {
+					return lead;
+				}
+				uint32_t result = lead & 127;
+				uint32_t shift = 7;
+				for (int i = 0; i < 4; i++) {
+					const uint8_t group = *data++;
+					result |= static_cast<uint32_t>(group & 127) << shift;
+					shift += 7;
+					if (group < 128) {
+						break;
+					}
+				}
+				return result;
+			}
+
+			inline uint32_t decodeIndex(const uint8_t*& data, uint32_t last)
+			{
+				const uint32_t v = decodeVByte(data);
+				const uint32_t d = (v >> 1) ^ (0u - (v & 1));
+				return last + d;
+			}
+
+			inline void writeIndex(void* destination, size_t offset, size_t indexSize, uint32_t index)
+			{
+				if (indexSize == 2) {
+					static_cast<uint16_t*>(destination)[offset] = static_cast<uint16_t>(index);
+				} else {
+					static_cast<uint32_t*>(destination)[offset] = index;
+				}
+			}
+
+			inline void writeTriangle(void* destination, size_t offset, size_t indexSize, uint32_t a, uint32_t b, uint32_t c)
+			{
+				writeIndex(destination, offset, indexSize, a);
+				writeIndex(destination, offset + 1, indexSize, b);
+				writeIndex(destination, offset + 2, indexSize, c);
+			}
+
+			inline void pushEdge(uint32_t edges[16][2], size_t& offset, uint32_t a, uint32_t b)
+			{
+				edges[offset][0] = a;
+				edges[offset][1] = b;
+				offset = (offset + 1) & 15;
+			}
+
+			inline void pushVertex(uint32_t vertices[16], size_t& offset, uint32_t v, bool advance = true)
+			{
+				vertices[offset] = v;
+				offset = (offset + (advance ? 1 : 0)) & 15;
+			}
+
+			template <typename T>
+			void filterOctahedral(T* data, size_t count)
+			{
+				const float maxValue = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+				for (size_t i = 0; i < count; i++) {
+					// The third component stores the value 1.0 at the encoded precision, z is reconstructed from it
+					float x = static_cast<float>(data[i * 4 + 0]);
+					float y = static_cast<float>(data[i * 4 + 1]);
+					const float z = static_cast<float>(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+					// Unfold the lower hemisphere
+					const float t = (z < 0.0f) ? z : 0.0f;
+					x += (x >= 0.0f) ? t : -t;
+					y += (y >= 0.0f) ? t : -t;
+					const float s = maxValue / sqrtf(x * x + y * y + z * z);
+					data[i * 4 + 0] = static_cast<T>(static_cast<int>(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+					data[i * 4 + 1] = static_cast<T>(static_cast<int>(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+					data[i * 4 + 2] = static_cast<T>(static_cast<int>(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+				}
+			}
+
+			inline void filterQuaternion(int16_t* data, size_t count)
+			{
+				const float scale = 1.0f / sqrtf(2.0f);
+				for (size_t i = 0; i < count; i++) {
+					// The fourth component stores the scale of the three smallest components and the index of the largest one in its two lowest bits
+					const int sf = data[i * 4 + 3] | 3;
+					const float ss = scale / static_cast<float>(sf);
+					const float x = static_cast<float>(data[i * 4 + 0]) * ss;
+					const float y = static_cast<float>(data[i * 4 + 1]) * ss;
+					const float z = static_cast<float>(data[i * 4 + 2]) * ss;
+					const float ww = 1.0f - x * x - y * y - z * z;
+					const float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+					const int qc = data[i * 4 + 3] & 3;
+					data[i * 4 + ((qc + 1) & 3)] = static_cast<int16_t>(static_cast<int>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)));
+					data[i * 4 + ((qc + 2) & 3)] = static_cast<int16_t>(static_cast<int>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)));
+					data[i * 4 + ((qc + 3) & 3)] = static_cast<int16_t>(static_cast<int>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)));
+					data[i * 4 + ((qc + 0) & 3)] = static_cast<int16_t>(static_cast<int>(w * 32767.0f + 0.5f));
+				}
+			}
+
+			inline void filterExponential(uint32_t* data, size_t count)
+			{
+				for (size_t i = 0; i < count; i++) {
+					// 24 bit signed mantissa and 8 bit signed exponent
+					const uint32_t v = data[i];
+					const int32_t m = static_cast<int32_t>(v << 8) >> 8;
+					const int32_t e = static_cast<int32_t>(v) >> 24;
+					const float f = ldexpf(static_cast<float>(m), e);
+					memcpy(&data[i], &f, sizeof(float));
+				}
+			}
+		}
+
+		/**
+		* Decode vertex data encoded with the attribute codec (EXT_meshopt_compression mode ATTRIBUTES)
+		*
+		* @param destination Decoded vertices, vertexCount * vertexSize bytes
+		* @param vertexCount Number of vertices
+		* @param vertexSize Size of a vertex in bytes, a multiple of 4 up to 256
+		* @param data Encoded data
+		* @param size Size of the encoded data
+		*
+		* @return False if the encoded data is invalid
+		*/
+		inline bool decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const uint8_t* data, size_t size)
+		{
+			if ((vertexSize == 0) || (vertexSize > 256) || (vertexSize % 4 != 0)) {
+				return false;
+			}
+			const uint8_t* dataEnd = data + size;
+			if (size < 1 + vertexSize) {
+				return false;
+			}
+			const uint8_t header = *data++;
+			if (((header & 0xF0) != detail::vertexHeader) || ((header & 0x0F) > 0)) {
+				return false;
+			}
+			// The first vertex is stored in the tail, all vertices are encoded as deltas
+			uint8_t lastVertex[256];
+			memcpy(lastVertex, dataEnd - vertexSize, vertexSize);
+			const size_t blockSize = detail::vertexBlockSize(vertexSize);
+			uint8_t* vertexData = static_cast<uint8_t*>(destination);
+			for (size_t offset = 0; offset < vertexCount; offset += blockSize) {
+				const size_t count = (offset + blockSize < vertexCount) ? blockSize : vertexCount - offset;
+				data = detail::decodeVertexBlock(data, dataEnd, vertexData + offset * vertexSize, count, vertexSize, lastVertex);
+				if (!data) {
+					return false;
+				}
+			}
+			const size_t tailSize = vertexSize < detail::tailMinSize ? detail::tailMinSize : vertexSize;
+			return static_cast<size_t>(dataEnd - data) == tailSize;
+		}
+
+		/**
+		* Decode a triangle list encoded with the index codec (EXT_meshopt_compression mode TRIANGLES)
+		*
+		* @param destination Decoded indices
+		* @param indexCount Number of indices, a multiple of 3
+		* @param indexSize Size of an index in bytes (2 or 4)
+		* @param data Encoded data
+		* @param size Size of the encoded data
+		*
+		* @return False if the encoded data is invalid
+		*/
+		inline bool decodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, const uint8_t* data, size_t size)
+		{
+			if ((indexCount % 3 != 0) || ((indexSize != 2) && (indexSize != 4))) {
+				return false;
+			}
+			// Header, one code per triangle and the 16 byte table of codes for triangles with new vertices
+			if (size < 1 + indexCount / 3 + 16) {
+				return false;
+			}
+			if ((data[0] & 0xF0) != detail::indexHeader) {
+				return false;
+			}
+			const int version = data[0] & 0x0F;
+			if (version > 1) {
+				return false;
+			}
+
+			// Triangles are encoded relative to the recently used edges and vertices
+			uint32_t edgeFifo[16][2];
+			uint32_t vertexFifo[16];
+			memset(edgeFifo, -1, sizeof(edgeFifo));
+			memset(vertexFifo, -1, sizeof(vertexFifo));
+			size_t edgeOffset = 0;
+			size_t vertexOffset = 0;
+			uint32_t next = 0;
+			uint32_t last = 0;
+			const int fecMax = (version >= 1) ? 13 : 15;
+
+			const uint8_t* code = data + 1;
+			const uint8_t* extra = code + indexCount / 3;
+			const uint8_t* extraSafeEnd = data + size - 16;
+			const uint8_t* codeAuxTable = extraSafeEnd;
+
+			for (size_t i = 0; i < indexCount; i += 3) {
+				// A triangle reads at most 16 bytes of extra data
+				if (extra > extraSafeEnd) {
+					return false;
+				}
+				const uint8_t codeTri = *code++;
+				if (codeTri < 0xF0) {
+					// Triangle sharing an edge from the FIFO
+					const int fe = codeTri >> 4;
+					const uint32_t a = edgeFifo[(edgeOffset - 1 - fe) & 15][0];
+					const uint32_t b = edgeFifo[(edgeOffset - 1 - fe) & 15][1];
+					const int fec = codeTri & 15;
+					if (fec < fecMax) {
+						const uint32_t c = (fec == 0) ? next : vertexFifo[(vertexOffset - 1 - fec) & 15];
+						if (fec == 0) {
+							next++;
+						}
+						detail::writeTriangle(destination, i, indexSize, a, b, c);
+						detail::pushVertex(vertexFifo, vertexOffset, c, fec == 0);
+						detail::pushEdge(edgeFifo, edgeOffset, c, b);
+						detail::pushEdge(edgeFifo, edgeOffset, a, c);
+					} else {
+						// 13 and 14 encode the last free index -1 and +1, 15 a new delta encoded index
+						const uint32_t c = (fec != 15) ? last + static_cast<uint32_t>(fec - (fec ^ 3)) : detail::decodeIndex(extra, last);
+						last = c;
+						detail::writeTriangle(destination, i, indexSize, a, b, c);
+						detail::pushVertex(vertexFifo, vertexOffset, c);
+						detail::pushEdge(edgeFifo, edgeOffset, c, b);
+						detail::pushEdge(edgeFifo, edgeOffset, a, c);
+					}
+				} else if (codeTri < 0xFE) {
+					// Triangle with a new vertex, the other two vertices are looked up through the table
+					const uint8_t codeAux = codeAuxTable[codeTri & 15];
+					const int feb = codeAux >> 4;
+					const int fec = codeAux & 15;
+					const uint32_t a = next++;
+					const uint32_t b = (feb == 0) ? next : vertexFifo[(vertexOffset - feb) & 15];
+					if (feb == 0) {
+						next++;
+					}
+					const uint32_t c = (fec == 0) ? next : vertexFifo[(vertexOffset - fec) & 15];
+					if (fec == 0) {
+						next++;
+					}
+					detail::writeTriangle(destination, i, indexSize, a, b, c);
+					detail::pushVertex(vertexFifo, vertexOffset, a);
+					detail::pushVertex(vertexFifo, vertexOffset, b, feb == 0);
+					detail::pushVertex(vertexFifo, vertexOffset, c, fec == 0);
+					detail::pushEdge(edgeFifo, edgeOffset, b, a);
+					detail::pushEdge(edgeFifo, edgeOffset, c, b);
+					detail::pushEdge(edgeFifo, edgeOffset, a, c);
+				} else {
+					// Triangle with its codes stored in full, optionally with free indices or restarting the new vertex counter
+					const uint8_t codeAux = *extra++;
+					const int fea = (codeTri == 0xFE) ? 0 : 15;
+					const int feb = codeAux >> 4;
+					const int fec = codeAux & 15;
+					if (codeAux == 0) {
+						next = 0;
+					}
+					uint32_t a = (fea == 0) ? next++ : 0;
+					uint32_t b = (feb == 0) ? next++ : vertexFifo[(vertexOffset - feb) & 15];
+					uint32_t c = (fec == 0) ? next++ : vertexFifo[(vertexOffset - fec) & 15];
+					if (fea == 15) {
+						last = a = detail::decodeIndex(extra, last);
+					}
+					if (feb == 15) {
+						last = b = detail::decodeIndex(extra, last);
+					}
+					if (fec == 15) {
+						last = c = detail::decodeIndex(extra, last);
+					}
+					detail::writeTriangle(destination, i, indexSize, a, b, c);
+					detail::pushVertex(vertexFifo, vertexOffset, a);
+					detail::pushVertex(vertexFifo, vertexOffset, b, (feb == 0) || (feb == 15));
+					detail::pushVertex(vertexFifo, vertexOffset, c, (fec == 0) || (fec == 15));
+					detail::pushEdge(edgeFifo, edgeOffset, b, a);
+					detail::pushEdge(edgeFifo, edgeOffset, c, b);
+					detail::pushEdge(edgeFifo, edgeOffset, a, c);
+				}
+			}
+			// All extra data must have been consumed up to the table
+			return extra == extraSafeEnd;
+		}
+
+		/**
+		* Decode an index sequence encoded with the index sequence codec (EXT_meshopt_compression mode INDICES)
+		*
+		* @param destination Decoded indices
+		* @param indexCount Number of indices
+		* @param indexSize Size of an index in bytes (2 or 4)
+		* @param data Encoded data
+		* @param size Size of the encoded data
+		*
+		* @return False if the encoded data is invalid
+		*/
+		inline bool decodeIndexSequence(void* destination, size_t indexCount, size_t indexSize, const uint8_t* data, size_t size)
+		{
+			if ((indexSize != 2) && (indexSize != 4)) {
+				return false;
+			}
+			// Header, at least one byte per index and a 4 byte tail
+			if (size < 1 + indexCount + 4) {
+				return false;
+			}
+			if (((data[0] & 0xF0) != detail::sequenceHeader) || ((data[0] & 0x0F) > 1)) {
+				return false;
+			}
+			const uint8_t* current = data + 1;
+			const uint8_t* safeEnd = data + size - 4;
+			// Indices are delta encoded against one of two baselines, selected by the lowest bit
+			uint32_t last[2] = { 0, 0 };
+			for (size_t i = 0; i < indexCount; i++) {
+				if (current >= safeEnd) {
+					return false;
+				}
+				uint32_t v = detail::decodeVByte(current);
+				const uint32_t baseline = v & 1;
+				v >>= 1;
+				const uint32_t d = (v >> 1) ^ (0u - (v & 1));
+				const uint32_t index = last[baseline] + d;
+				last[baseline] = index;
+				detail::writeIndex(destination, i, indexSize, index);
+			}
+			return current == safeEnd;
+		}
+
+		/**
+		* Reverse the filter applied to decoded vertex data
+		*
+		* @param data Decoded vertex data, filtered in place
+		* @param count Number of elements
+		* @param stride Size of an element in bytes
+		* @param filter Filter the data was encoded with
+		*
+		* @return False if the filter doesn't support the element size
+		*/
+		inline bool applyFilter(void* data, size_t count, size_t stride, Filter filter)
+		{
+			switch (filter) {
+			case Filter::None:
+				return true;
+			case Filter::Octahedral:
+				// Four signed 8 or 16 bit components
+				if (stride == 4) {
+					detail::filterOctahedral(static_cast<int8_t*>(data), count);
+					return true;
+				}
+				if (stride == 8) {
+					detail::filterOctahedral(static_cast<int16_t*>(data), count);
+					return true;
+				}
+				return false;
+			case Filter::Quaternion:
+				if (stride != 8) {
+					return false;
+				}
+				detail::filterQuaternion(static_cast<int16_t*>(data), count);
+				return true;
+			case Filter::Exponential:
+				if (stride % 4 != 0) {
+					return false;
+				}
+				detail::filterExponential(static_cast<uint32_t*>(data), count * (stride / 4));
+				return true;
+			}
+			return false;
+		}
+	}
+}
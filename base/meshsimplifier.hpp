@@ -0,0 +1,320 @@
+/*
+* Mesh simplification
+*
+* Edge collapse simplification of indexed triangle lists using quadric error metrics (Garland and Heckbert), used to generate levels of detail at load time
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace meshsimplifier
+	{
+		namespace detail
+		{
+			// Symmetric 4x4 matrix of the area weighted plane equations accumulated for a vertex, evaluates to the mean squared distance to these planes
+			struct Quadric {
+				double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+				double b2 = 0.0, bc = 0.0, bd = 0.0;
+				double c2 = 0.0, cd = 0.0;
+				double d2 = 0.0;
+				double weight = 0.0;
+
+				void addPlane(const glm::vec3& n, float d, float w)
+				{
+					a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+					b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+					c2 += w * n.z * n.z; cd += w * n.z * d;
+					d2 += w * d * d;
+					weight += w;
+				}
+
+				void add(const Quadric& q)
+				{
+					a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+					b2 += q.b2; bc += q.bc; bd += q.bd;
+					c2 += q.c2; cd += q.cd;
+					d2 += q.d2;
+					weight += q.weight;
+				}
+
+				double evaluate(const glm::vec3& p) const
+				{
+					const double x = p.x, y = p.y, z = p.z;
+					const double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+						+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+						+ c2 * z * z + 2.0 * cd * z
+						+ d2;
+					return (weight > 0.0) ? std::max(error / weight, 0.0) : 0.0;
+				}
+			};
+
+			struct Collapse {
+				uint32_t from;
+				uint32_t to;
+				double cost;
+			};
+		}
+
+		/**
+		* Simplify a triangle list by collapsing edges into one of their vertices, cheapest collapses (by quadric error) first
+		*
+		* No vertices are created or modified, the simplified indices reference a subset of the input vertices. Vertices are welded by position to find
+		* the mesh's topology. Vertices on open or non-manifold edges and on attribute seams (a position shared by multiple vertices) are never removed,
+		* so borders and UV/normal discontinuities keep their shape. Collapses that would flip a triangle are rejected
+		*
+		* @param indices Triangle list indices, in the range [0, vertexCount)
+		* @param indexCount Number of indices
+		* @param positions Pointer to the position (three floats) of the first vertex
+		* @param positionStride Distance in bytes between the positions of consecutive vertices
+		* @param vertexCount Number of vertices referenced by the indices
+		* @param targetIndexCount Number of indices to simplify to, the result has more if the mesh can't be simplified that far
+		* @param resultError (Optional) Receives the geometric error of the result in model units (root of the largest mean squared plane distance of the applied collapses)
+		*
+		* @return Indices of the simplified triangle list
+		*/
+		inline std::vector<uint32_t> simplify(const uint32_t* indices, size_t indexCount, const void* positions, size_t positionStride, uint32_t vertexCount, size_t targetIndexCount, float* resultError = nullptr)
+		{
+			auto position = [&](uint32_t index) -> const glm::vec3& {
+				return *reinterpret_cast<const glm::vec3*>(static_cast<const uint8_t*>(positions) + static_cast<size_t>(index) * positionStride);
+			};
+
+			std::vector<uint32_t> result(indices, indices + (indexCount - indexCount % 3));
+			double maxError = 0.0;
+			if (resultError) {
+				*resultError = 0.0f;
+			}
+			if (result.size() <= targetIndexCount) {
+				return result;
+			}
+
+			// Weld vertices by position, all vertices with the same position share the first one's canonical index
+			std::vector<uint32_t> canonical(vertexCount);
+			std::vector<uint32_t> copyCount(vertexCount, 0);
+			{
+				std::vector<uint32_t> sorted(vertexCount);
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					sorted[v] = v;
+				}
+				auto less = [&](uint32_t a, uint32_t b) {
+					const glm::vec3& pa = position(a);
+					const glm::vec3& pb = position(b);
+					if (pa.x != pb.x) return pa.x < pb.x;
+					if (pa.y != pb.y) return pa.y < pb.y;
+					if (pa.z != pb.z) return pa.z < pb.z;
+					return a < b;
+				};
+				std::sort(sorted.begin(), sorted.end(), less);
+				for (uint32_t i = 0; i < vertexCount; i++) {
+					const uint32_t v = sorted[i];
+					const bool samePosition = (i > 0) && (position(sorted[i - 1]).x == position(v).x) && (position(sorted[i - 1]).y == position(v).y) && (position(sorted[i - 1]).z == position(v).z);
+					canonical[v] = samePosition ? canonical[sorted[i - 1]] : v;
+				}
+			}
+			// Only vertices that are referenced count as copies, unreferenced duplicates don't form seams
+			{
+				std::vector<bool> referenced(vertexCount, false);
+				for (uint32_t index : result) {
+					if (!referenced[index]) {
+						referenced[index] = true;
+						copyCount[canonical[index]]++;
+					}
+				}
+			}
+
+			// Vertices on edges that don't have exactly two adjacent triangles are locked, as are vertices on seams
+			std::vector<bool> locked(vertexCount, false);
+			{
+				std::vector<uint64_t> edges;
+				edges.reserve(result.size());
+				for (size_t i = 0; i < result.size(); i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t a = canonical[result[i + k]];
+						const uint32_t b = canonical[result[i + (k + 1) % 3]];
+						if (a != b) {
+							edges.push_back((static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b));
+						}
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				for (size_t i = 0; i < edges.size();) {
+					size_t j = i + 1;
+					while ((j < edges.size()) && (edges[j] == edges[i])) {
+						j++;
+					}
+					if (j - i != 2) {
+						locked[static_cast<uint32_t>(edges[i] >> 32)] = true;
+						locked[static_cast<uint32_t>(edges[i] & 0xFFFFFFFF)] = true;
+					}
+					i = j;
+				}
+			}
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				if (copyCount[canonical[v]] > 1) {
+					locked[canonical[v]] = true;
+				}
+			}
+			auto removable = [&](uint32_t v) {
+				return !locked[canonical[v]];
+			};
+
+			// Quadrics of the planes of all triangles adjacent to a (welded) vertex
+			std::vector<detail::Quadric> quadrics(vertexCount);
+			for (size_t i = 0; i < result.size(); i += 3) {
+				const glm::vec3& p0 = position(result[i]);
+				const glm::vec3& p1 = position(result[i + 1]);
+				const glm::vec3& p2 = position(result[i + 2]);
+				const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				const float length = glm::length(normal);
+				if (length == 0.0f) {
+					continue;
+				}
+				const glm::vec3 n = normal / length;
+				const float d = -glm::dot(n, p0);
+				for (uint32_t k = 0; k < 3; k++) {
+					quadrics[canonical[result[i + k]]].addPlane(n, d, 0.5f * length);
+				}
+			}
+
+			std::vector<uint32_t> adjacencyOffsets;
+			std::vector<uint32_t> adjacency;
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			std::vector<detail::Collapse> collapses;
+
+			// Collapses are done in passes, each pass collapses the cheapest independent edges (no vertex is part of more than one collapse's neighborhood)
+			while (result.size() > targetIndexCount) {
+				const size_t triangleCount = result.size() / 3;
+
+				// Triangles adjacent to each vertex
+				adjacencyOffsets.assign(vertexCount + 1, 0);
+				for (uint32_t index : result) {
+					adjacencyOffsets[index + 1]++;
+				}
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				adjacency.resize(result.size());
+				{
+					std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+					for (size_t i = 0; i < result.size(); i++) {
+						adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+
+				collapses.clear();
+				for (size_t i = 0; i < result.size(); i += 3) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t a = result[i + k];
+						const uint32_t b = result[i + (k + 1) % 3];
+						if (canonical[a] == canonical[b]) {
+							continue;
+						}
+						detail::Quadric q = quadrics[canonical[a]];
+						q.add(quadrics[canonical[b]]);
+						if (removable(a)) {
+							collapses.push_back({ a, b, q.evaluate(position(b)) });
+						}
+						if (removable(b)) {
+							collapses.push_back({ b, a, q.evaluate(position(a)) });
+						}
+					}
+				}
+				if (collapses.empty()) {
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const detail::Collapse& a, const detail::Collapse& b) { return a.cost < b.cost; });
+
+				for (uint32_t v = 0; v < vertexCount; v++) {
+					remap[v] = v;
+				}
+				std::fill(touched.begin(), touched.end(), false);
+
+				// Only the cheapest part of the candidates is considered per pass, so expensive collapses don't get in before cheaper ones of the next pass
+				const size_t candidateCount = collapses.size() / 3 + 1;
+				const size_t targetTriangleCount = targetIndexCount / 3;
+				size_t removedTriangles = 0;
+				size_t collapseCount = 0;
+				for (size_t c = 0; (c < std::min(candidateCount, collapses.size())) && (triangleCount - removedTriangles > targetTriangleCount); c++) {
+					const detail::Collapse& collapse = collapses[c];
+					if (touched[collapse.from] || touched[collapse.to]) {
+						continue;
+					}
+					const glm::vec3& target = position(collapse.to);
+					bool valid = true;
+					uint32_t collapsedTriangles = 0;
+					for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+						const uint32_t* triangle = &result[adjacency[j] * 3];
+						if ((triangle[0] == collapse.to) || (triangle[1] == collapse.to) || (triangle[2] == collapse.to)) {
+							collapsedTriangles++;
+							continue;
+						}
+						// Reject collapses that flip or degenerate the remaining triangles
+						glm::vec3 p[3];
+						glm::vec3 q[3];
+						for (uint32_t k = 0; k < 3; k++) {
+							p[k] = position(triangle[k]);
+							q[k] = (triangle[k] == collapse.from) ? target : p[k];
+						}
+						const glm::vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+						const glm::vec3 newNormal = glm::cross(q[1] - q[0], q[2] - q[0]);
+						if (glm::dot(oldNormal, newNormal) <= 0.25f * glm::length(oldNormal) * glm::length(newNormal)) {
+							valid = false;
+							break;
+						}
+					}
+					if (!valid || (collapsedTriangles == 0)) {
+						continue;
+					}
+
+					remap[collapse.from] = collapse.to;
+					quadrics[canonical[collapse.to]].add(quadrics[canonical[collapse.from]]);
+					maxError = std::max(maxError, collapse.cost);
+					removedTriangles += collapsedTriangles;
+					collapseCount++;
+					touched[collapse.from] = true;
+					touched[collapse.to] = true;
+					for (uint32_t j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; j++) {
+						const uint32_t* triangle = &result[adjacency[j] * 3];
+						touched[triangle[0]] = true;
+						touched[triangle[1]] = true;
+						touched[triangle[2]] = true;
+					}
+				}
+				if (collapseCount == 0) {
+					break;
+				}
+
+				// Apply the collapses and remove the triangles that became degenerate
+				size_t writeIndex = 0;
+				for (size_t i = 0; i < result.size(); i += 3) {
+					const uint32_t a = remap[result[i]];
+					const uint32_t b = remap[result[i + 1]];
+					const uint32_t c = remap[result[i + 2]];
+					if ((a != b) && (b != c) && (a != c)) {
+						result[writeIndex++] = a;
+						result[writeIndex++] = b;
+						result[writeIndex++] = c;
+					}
+				}
+				result.resize(writeIndex);
+			}
+
+			if (resultError) {
+				*resultError = static_cast<float>(sqrt(maxError));
+			}
+			return result;
+		}
+	}
+}
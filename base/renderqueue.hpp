@@ -0,0 +1,250 @@
+/*
+* Sort keyed render queue
+*
+* Collects draws once, sorts them by pass, pipeline, material and depth and records them without redundant state changes
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* @brief Sorts draws by a 64 bit key and records them with as few pipeline, descriptor set and push constant changes as possible
+	*
+	* Draws are added in any order (e.g. while traversing a scene graph once) and sorted with a radix sort, which is linear in the number of draws.
+	* The key is laid out as pass (4 bits) | pipeline (14 bits) | material (14 bits) | depth (32 bits), so draws of a pass are grouped by pipeline, then by material and drawn front to back within them.
+	* Passes drawn back to front (e.g. alpha blended geometry) put the depth in front of pipeline and material instead, as the blending order has to win over state changes.
+	*
+	* Pipelines and materials (descriptor sets) are mapped to small ids in the order they are first added, the ids are kept when the queue is cleared so the order is stable across frames.
+	*/
+	class RenderQueue
+	{
+	public:
+		enum DepthOrder
+		{
+			FrontToBack = 0,
+			BackToFront
+		};
+
+		struct Draw
+		{
+			VkPipeline pipeline;
+			/** @brief Descriptor set bound to materialSet, VK_NULL_HANDLE if the draw doesn't use one */
+			VkDescriptorSet descriptorSet;
+			/** @brief Push constant data of pushConstantSize bytes, nullptr if the draw doesn't use push constants. Needs to stay valid until the queue has been recorded */
+			const void* pushConstants;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			uint32_t instanceCount;
+			uint32_t firstInstance;
+		};
+
+		/** @brief State changes of recording the whole sorted queue at once, ranges recorded separately start with all state unbound */
+		struct Statistics
+		{
+			uint32_t draws = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t descriptorSetBinds = 0;
+			uint32_t pushConstantUpdates = 0;
+		};
+
+		static constexpr uint32_t maxPasses = 16;
+
+		/** @brief Layout used to bind the material descriptor sets and push the constants of the draws */
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		/** @brief Set index the descriptor sets of the draws are bound to */
+		uint32_t materialSet = 1;
+		VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0;
+
+	private:
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t draw;
+		};
+
+		std::vector<Draw> draws;
+		std::vector<Entry> entries;
+		std::vector<Entry> sortBuffer;
+		std::unordered_map<uint64_t, uint32_t> pipelineIds;
+		std::unordered_map<uint64_t, uint32_t> materialIds;
+		Statistics statistics;
+
+		static uint32_t getId(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle)
+		{
+			auto it = ids.find(handle);
+			if (it != ids.end()) {
+				return it->second;
+			}
+			// Ids wrap around, which only costs some state changes if there are more than fit into the key
+			const uint32_t id = static_cast<uint32_t>(ids.size()) & 0x3FFF;
+			ids[handle] = id;
+			return id;
+		}
+
+		// Non-negative floats sort the same way as their bit patterns, so the depth doesn't need to be quantized
+		static uint32_t depthBits(float depth)
+		{
+			if (!(depth > 0.0f)) {
+				return 0;
+			}
+			uint32_t bits;
+			memcpy(&bits, &depth, sizeof(bits));
+			return bits;
+		}
+
+	public:
+		void clear()
+		{
+			draws.clear();
+			entries.clear();
+			statistics = Statistics();
+		}
+
+		/**
+		* Add a draw to the queue
+		*
+		* @param pass Pass the draw belongs to (less than maxPasses), passes are sorted in ascending order and can be recorded separately (see getPassRange)
+		* @param draw Pipeline, material descriptor set, push constants and index range of the draw
+		* @param depth Distance of the draw to the camera (e.g. of its bounding sphere's center)
+		* @param order (Optional) Order of the draws in this pass by depth, other sort criteria are ignored for back to front passes
+		*/
+		void add(uint32_t pass, const Draw& draw, float depth, DepthOrder order = FrontToBack)
+		{
+			const uint64_t pipelineId = getId(pipelineIds, (uint64_t)draw.pipeline);
+			const uint64_t materialId = getId(materialIds, (uint64_t)draw.descriptorSet);
+			uint64_t key = static_cast<uint64_t>(pass & (maxPasses - 1)) << 60;
+			if (order == BackToFront) {
+				key |= static_cast<uint64_t>(~depthBits(depth)) << 28;
+				key |= (pipelineId << 14) | materialId;
+			} else {
+				key |= (pipelineId << 46) | (materialId << 32);
+				key |= depthBits(depth);
+			}
+			entries.push_back({ key, static_cast<uint32_t>(draws.size()) });
+			draws.push_back(draw);
+		}
+
+		/** @brief Sort the draws by their keys, needs to be called after adding all draws and before recording them */
+		void sort()
+		{
+			// Least significant digit radix sort over the eight bytes of the key, bytes that are the same for all keys are skipped
+			const size_t count = entries.size();
+			sortBuffer.resize(count);
+			for (uint32_t shift = 0; shift < 64; shift += 8) {
+				size_t histogram[256] = {};
+				for (const Entry& entry : entries) {
+					histogram[(entry.key >> shift) & 0xFF]++;
+				}
+				if ((count == 0) || (histogram[(entries[0].key >> shift) & 0xFF] == count)) {
+					continue;
+				}
+				size_t offset = 0;
+				for (size_t& bucket : histogram) {
+					const size_t bucketCount = bucket;
+					bucket = offset;
+					offset += bucketCount;
+				}
+				for (const Entry& entry : entries) {
+					sortBuffer[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+				}
+				entries.swap(sortBuffer);
+			}
+			// Count the state changes of recording the queue in one go
+			statistics = Statistics();
+			const Draw* previous = nullptr;
+			for (const Entry& entry : entries) {
+				const Draw& draw = draws[entry.draw];
+				statistics.draws++;
+				statistics.pipelineBinds += (!previous || (draw.pipeline != previous->pipeline)) ? 1 : 0;
+				statistics.descriptorSetBinds += ((draw.descriptorSet != VK_NULL_HANDLE) && (!previous || (draw.descriptorSet != previous->descriptorSet))) ? 1 : 0;
+				statistics.pushConstantUpdates += (draw.pushConstants && (!previous || (draw.pushConstants != previous->pushConstants))) ? 1 : 0;
+				previous = &draw;
+			}
+		}
+
+		/**
+		* Get the range of the sorted draws belonging to a pass
+		*
+		* @param pass Pass to look up
+		* @param first Index of the pass's first draw in the sorted queue
+		* @return Number of draws in the pass
+		*/
+		uint32_t getPassRange(uint32_t pass, uint32_t& first) const
+		{
+			uint32_t count = 0;
+			first = 0;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(entries.size()); i++) {
+				const uint32_t entryPass = static_cast<uint32_t>(entries[i].key >> 60);
+				if (entryPass < pass) {
+					first = i + 1;
+				} else if (entryPass == pass) {
+					count++;
+				} else {
+					break;
+				}
+			}
+			return count;
+		}
+
+		/**
+		* Record a range of the sorted draws, pipelines, descriptor sets and push constants are only set if they differ from the previous draw
+		*
+		* @param commandBuffer Command buffer to record to, the vertex and index buffers need to be bound
+		* @param first Index of the first sorted draw to record
+		* @param count Number of draws to record
+		*
+		* @note Doesn't modify the queue, so ranges can be recorded into separate (secondary) command buffers at the same time
+		*/
+		void record(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) const
+		{
+			VkPipeline boundPipeline = VK_NULL_HANDLE;
+			VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+			const void* pushedConstants = nullptr;
+			for (uint32_t i = first; i < first + count; i++) {
+				const Draw& draw = draws[entries[i].draw];
+				if (draw.pipeline != boundPipeline) {
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+					boundPipeline = draw.pipeline;
+				}
+				if ((draw.descriptorSet != VK_NULL_HANDLE) && (draw.descriptorSet != boundDescriptorSet)) {
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, materialSet, 1, &draw.descriptorSet, 0, nullptr);
+					boundDescriptorSet = draw.descriptorSet;
+				}
+				if (draw.pushConstants && (draw.pushConstants != pushedConstants)) {
+					vkCmdPushConstants(commandBuffer, pipelineLayout, pushConstantStages, pushConstantOffset, pushConstantSize, draw.pushConstants);
+					pushedConstants = draw.pushConstants;
+				}
+				vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, 0, draw.firstInstance);
+			}
+		}
+
+		/** @brief Record all sorted draws */
+		void record(VkCommandBuffer commandBuffer) const
+		{
+			record(commandBuffer, 0, size());
+		}
+
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(entries.size());
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+	};
+}
@@ -0,0 +1,229 @@
+/*
+* Shadow atlas
+*
+* Packs the shadow maps of many lights into tiles of a single depth texture and keeps track of which tiles need to be rendered again
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief Allocates square, power of two sized tiles of a shadow atlas to lights and caches their contents across frames
+	*
+	* Lights request a tile size (e.g. from their screen coverage, see getTileSize), tiles are packed largest first along a Z-order curve,
+	* which places power of two squares sorted by size without gaps. If the requests don't fit, all of them are halved until they do.
+	*
+	* A tile keeps its contents until the light's matrix changes or the caller reports a change of the dynamic casters inside the light's frustum
+	* (by passing a different signature, e.g. a hash of the visible dynamic objects and their positions). Tiles are also invalidated if the packing moves them.
+	* The number of tiles rendered per frame can be limited, tiles that are left for a later frame keep the matrix they were rendered with, so shadows lag behind but stay consistent.
+	*/
+	class ShadowAtlas
+	{
+	public:
+		struct Tile
+		{
+			/** @brief Offset of the tile in texels */
+			uint32_t x = 0;
+			uint32_t y = 0;
+			/** @brief Size of the tile in texels, 0 if the light didn't get a tile */
+			uint32_t size = 0;
+			/** @brief Light matrix the tile has been rendered with */
+			glm::mat4 matrix = glm::mat4(1.0f);
+			uint64_t signature = 0;
+			bool valid = false;
+			/** @brief Frame the tile has last been rendered in */
+			uint64_t renderedFrame = 0;
+		};
+
+		/** @brief Size of the (square) atlas in texels */
+		uint32_t size = 4096;
+		uint32_t minTileSize = 128;
+		uint32_t maxTileSize = 2048;
+		/** @brief Maximum number of tiles rendered per frame, 0 = no limit */
+		uint32_t maxUpdatesPerFrame = 0;
+
+	private:
+		std::vector<Tile> tiles;
+		std::vector<uint32_t> order;
+		uint64_t frame = 0;
+
+		static uint32_t floorPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while ((result << 1) <= value) {
+				result <<= 1;
+			}
+			return result;
+		}
+
+		// Every other bit of a Z-order index
+		static uint32_t compactBits(uint32_t value)
+		{
+			value &= 0x55555555;
+			value = (value | (value >> 1)) & 0x33333333;
+			value = (value | (value >> 2)) & 0x0F0F0F0F;
+			value = (value | (value >> 4)) & 0x00FF00FF;
+			value = (value | (value >> 8)) & 0x0000FFFF;
+			return value;
+		}
+
+	public:
+		ShadowAtlas() = default;
+		ShadowAtlas(uint32_t size, uint32_t minTileSize, uint32_t maxTileSize) : size(size), minTileSize(minTileSize), maxTileSize(maxTileSize) {}
+
+		/**
+		* Get the tile size for a light from its screen coverage
+		*
+		* @param coverage Diameter of the light's area of influence on screen relative to the viewport height (may exceed 1.0 if the light fills the screen)
+		* @param viewportHeight Height of the viewport in pixels
+		* @return Tile size with about one texel per pixel covered, clamped to the minimum and maximum tile size
+		*/
+		uint32_t getTileSize(float coverage, float viewportHeight) const
+		{
+			const float texels = std::max(coverage, 0.0f) * viewportHeight;
+			return floorPowerOfTwo(std::min(std::max(static_cast<uint32_t>(texels), minTileSize), std::min(maxTileSize, size)));
+		}
+
+		/**
+		* Pack the tiles of all lights into the atlas
+		*
+		* @param requestedSizes Tile size requested by each light (rounded down to a power of two and clamped to the tile size limits), 0 if the light doesn't need a tile
+		* @return Number of tiles that moved or changed their size (and have been invalidated)
+		*/
+		uint32_t allocate(const std::vector<uint32_t>& requestedSizes)
+		{
+			const uint32_t count = static_cast<uint32_t>(requestedSizes.size());
+			tiles.resize(count);
+			std::vector<uint32_t> sizes(count, 0);
+			for (uint32_t i = 0; i < count; i++) {
+				if (requestedSizes[i] > 0) {
+					sizes[i] = floorPowerOfTwo(std::min(std::max(requestedSizes[i], minTileSize), std::min(maxTileSize, size)));
+				}
+			}
+			order.resize(count);
+			for (uint32_t i = 0; i < count; i++) {
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+
+			// Area in units of the smallest tile, halve the requests until they fit
+			const uint64_t cellsPerSide = size / minTileSize;
+			const uint64_t cellCount = cellsPerSide * cellsPerSide;
+			while (true) {
+				uint64_t area = 0;
+				bool canShrink = false;
+				for (uint32_t tileSize : sizes) {
+					const uint64_t cells = tileSize / minTileSize;
+					area += cells * cells;
+					canShrink |= tileSize > minTileSize;
+				}
+				if ((area <= cellCount) || !canShrink) {
+					break;
+				}
+				for (uint32_t& tileSize : sizes) {
+					if (tileSize > minTileSize) {
+						tileSize >>= 1;
+					}
+				}
+			}
+
+			// Sizes are powers of two sorted in descending order, so the position along the Z-order curve is always a multiple of the current tile's area
+			uint32_t changed = 0;
+			uint64_t cursor = 0;
+			for (uint32_t index : order) {
+				Tile& tile = tiles[index];
+				Tile placed = tile;
+				placed.x = placed.y = placed.size = 0;
+				const uint64_t cells = sizes[index] / minTileSize;
+				if ((sizes[index] > 0) && (cursor + cells * cells <= cellCount)) {
+					placed.x = compactBits(static_cast<uint32_t>(cursor)) * minTileSize;
+					placed.y = compactBits(static_cast<uint32_t>(cursor >> 1)) * minTileSize;
+					placed.size = sizes[index];
+					cursor += cells * cells;
+				}
+				if ((placed.x != tile.x) || (placed.y != tile.y) || (placed.size != tile.size)) {
+					placed.valid = false;
+					changed++;
+				}
+				tile = placed;
+			}
+			return changed;
+		}
+
+		/**
+		* Select the tiles that need to be rendered this frame and mark them as rendered
+		*
+		* @param matrices Current view projection matrix of each light
+		* @param signatures Signature of the dynamic shadow casters inside each light's frustum, a tile is rendered again if its signature changes
+		* @return Indices of the tiles (lights) to render, tiles without a valid shadow map first, then the ones that have waited longest
+		*/
+		std::vector<uint32_t> update(const std::vector<glm::mat4>& matrices, const std::vector<uint64_t>& signatures)
+		{
+			frame++;
+			std::vector<uint32_t> updates;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(tiles.size()); i++) {
+				const Tile& tile = tiles[i];
+				if ((tile.size > 0) && (!tile.valid || (tile.matrix != matrices[i]) || (tile.signature != signatures[i]))) {
+					updates.push_back(i);
+				}
+			}
+			std::stable_sort(updates.begin(), updates.end(), [this](uint32_t a, uint32_t b) {
+				if (tiles[a].valid != tiles[b].valid) {
+					return !tiles[a].valid;
+				}
+				return tiles[a].renderedFrame < tiles[b].renderedFrame;
+			});
+			if ((maxUpdatesPerFrame > 0) && (updates.size() > maxUpdatesPerFrame)) {
+				updates.resize(maxUpdatesPerFrame);
+			}
+			for (uint32_t index : updates) {
+				Tile& tile = tiles[index];
+				tile.matrix = matrices[index];
+				tile.signature = signatures[index];
+				tile.valid = true;
+				tile.renderedFrame = frame;
+			}
+			return updates;
+		}
+
+		/** @brief Force all tiles to be rendered again, e.g. after static geometry changed */
+		void invalidate()
+		{
+			for (auto& tile : tiles) {
+				tile.valid = false;
+			}
+		}
+
+		const Tile& getTile(uint32_t index) const
+		{
+			return tiles[index];
+		}
+
+		/** @brief Offset (xy) and scale (zw) of a tile in normalized atlas coordinates, all zero if the light has no valid shadow map */
+		glm::vec4 getRect(uint32_t index) const
+		{
+			const Tile& tile = tiles[index];
+			if ((tile.size == 0) || !tile.valid) {
+				return glm::vec4(0.0f);
+			}
+			const float scale = 1.0f / static_cast<float>(size);
+			return glm::vec4(tile.x * scale, tile.y * scale, tile.size * scale, tile.size * scale);
+		}
+
+		uint32_t getTileCount() const
+		{
+			return static_cast<uint32_t>(tiles.size());
+		}
+	};
+}
@@ -6,13 +6,19 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
+#include <memory>
 #include <thread>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 
+#include "VulkanTraceRecorder.h"
+#include "cputopology.hpp"
+
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
 template<typename T, typename ...Args>
@@ -27,6 +33,8 @@ namespace vks
 	{
 	private:
 		bool destroying = false;
+		// Core the thread is pinned to, -1 if it's left to the OS
+		int32_t coreId = -1;
 		std::thread worker;
 		std::queue<std::function<void()>> jobQueue;
 		std::mutex queueMutex;
@@ -35,6 +43,10 @@ namespace vks
 		// Loop through all remaining jobs
 		void queueLoop()
 		{
+			if (coreId >= 0)
+			{
+				CpuTopology::pinCurrentThread(static_cast<uint32_t>(coreId));
+			}
 			while (true)
 			{
 				std::function<void()> job;
@@ -48,7 +60,10 @@ namespace vks
 					job = jobQueue.front();
 				}
 
-				job();
+				{
+					vks::TraceZone zone("Job");
+					job();
+				}
 
 				{
 					std::lock_guard<std::mutex> lock(queueMutex);
@@ -59,7 +74,7 @@ namespace vks
 		}
 
 	public:
-		Thread()
+		explicit Thread(int32_t coreId = -1) : coreId(coreId)
 		{
 			worker = std::thread(&Thread::queueLoop, this);
 		}
@@ -99,12 +114,14 @@ namespace vks
 		std::vector<std::unique_ptr<Thread>> threads;
 
 		// Sets the number of threads to be allocated in this pool
+		// If pinning is enabled (see CpuTopology), threads are pinned to the fastest cores other than the main thread's first
 		void setThreadCount(uint32_t count)
 		{
 			threads.clear();
-			for (auto i = 0; i < count; i++)
+			const CpuTopology& topology = CpuTopology::get();
+			for (uint32_t i = 0; i < count; i++)
 			{
-				threads.push_back(make_unique<Thread>());
+				threads.push_back(make_unique<Thread>(topology.pinThreads ? static_cast<int32_t>(topology.workerCore(i).id) : -1));
 			}
 		}
 
@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
 
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
 #include <Cocoa/Cocoa.h>
@@ -26,32 +27,42 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	this->settings.validation = true;
 #endif
 
+	// The ray tracing extensions require Vulkan 1.1, the shading rate image, extended dynamic state, ASTC HDR and dynamic rendering features are queried with vkGetPhysicalDeviceFeatures2
+	const bool adaptiveShadingRateRequested = adaptiveShadingRate.supported && adaptiveShadingRate.requested;
+	const bool dynamicRenderingRequested = dynamicRendering.supported && dynamicRendering.requested;
+	if ((enableRayQueries || adaptiveShadingRateRequested || enableExtendedDynamicState || enableCompressedHDRTextures || dynamicRenderingRequested) && (apiVersion < VK_API_VERSION_1_1)) {
+		apiVersion = VK_API_VERSION_1_1;
+	}
+
 	VkApplicationInfo appInfo = {};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	appInfo.pApplicationName = name.c_str();
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, headless rendering doesn't create a surface
+	if (!settings.headless) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
-	instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_EXT_DIRECTFB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-	instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-	instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #endif
+	}
 
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -68,6 +79,21 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 		}
 	}
 
+	// Timeline semaphores on Vulkan 1.0 require the extension for querying extended device properties and features, it's also used to query the memory budget
+	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+		instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+#if VKS_DEBUG_LABELS
+	// Labels of the GPU profiler scopes and frames, shown by capture tools (also provides the validation message callback)
+	const bool debugUtils = std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != supportedInstanceExtensions.end();
+	if (debugUtils) {
+		instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
+#else
+	const bool debugUtils = false;
+#endif
+
 	// Enabled requested instance extensions
 	if (enabledInstanceExtensions.size() > 0) 
 	{
@@ -78,6 +104,11 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 			{
 				std::cerr << "Enabled instance extension \"" << enabledExtension << "\" is not present at instance level\n";
 			}
+			// Skip extensions the base class has already enabled
+			if (std::find_if(instanceExtensions.begin(), instanceExtensions.end(), [enabledExtension](const char* extension) { return strcmp(extension, enabledExtension) == 0; }) != instanceExtensions.end())
+			{
+				continue;
+			}
 			instanceExtensions.push_back(enabledExtension);
 		}
 	}
@@ -88,7 +119,7 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	instanceCreateInfo.pApplicationInfo = &appInfo;
 	if (instanceExtensions.size() > 0)
 	{
-		if (settings.validation)
+		if (settings.validation && !debugUtils)
 		{
 			instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		}
@@ -120,15 +151,45 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 			std::cerr << "Validation layer VK_LAYER_KHRONOS_validation not present, validation is disabled";
 		}
 	}
-	return vkCreateInstance(&instanceCreateInfo, nullptr, &instance);
+	VkResult result = vkCreateInstance(&instanceCreateInfo, nullptr, &instance);
+	if ((result == VK_SUCCESS) && debugUtils) {
+		vks::debugutils::setup(instance);
+	}
+	return result;
 }
 
 void VulkanExampleBase::renderFrame()
 {
 	VulkanExampleBase::prepareFrame();
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VkCommandBuffer commandBuffer = drawCmdBuffers[currentBuffer];
+	if (dynamicCommandBuffers) {
+		// The fence of this frame in flight has been waited on by prepareFrame, so its command buffer can be recorded again
+		// Resetting the transient pool is cheaper than resetting the command buffer itself
+		VK_CHECK_RESULT(vkResetCommandPool(device, frameCmdPools[currentFrame], 0));
+		commandBuffer = frameCmdBuffers[currentFrame];
+		recordCommandBuffer(commandBuffer, currentBuffer);
+	}
+	cpuProfiler.lap(vks::CpuFrameProfiler::Record);
+	if (lateLatch.enabled) {
+		updateLateLatch();
+	}
+	if (lateLatch.supported) {
+		const double inputAge = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lateLatch.inputTime).count();
+		lateLatch.inputAge = (lateLatch.inputAge > 0.0) ? lateLatch.inputAge * 0.9 + inputAge * 0.1 : inputAge;
+		if (benchmark.active) {
+			lateLatch.inputAgeSum += inputAge;
+			lateLatch.inputAgeSamples++;
+		}
+	}
+	if (submitThread.enabled) {
+		// Submitted along with the frame's fence and the present by the submission thread
+		submitThread.commandBuffer = commandBuffer;
+	} else {
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
+	cpuProfiler.lap(vks::CpuFrameProfiler::Submit);
 	VulkanExampleBase::submitFrame();
 }
 
@@ -159,6 +220,10 @@ void VulkanExampleBase::createCommandBuffers()
 
 void VulkanExampleBase::destroyCommandBuffers()
 {
+	for (auto& drawCmdBuffer : drawCmdBuffers) {
+		gpuProfiler.release(drawCmdBuffer);
+		adaptiveShadingRate.generator.release(drawCmdBuffer);
+	}
 	vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(drawCmdBuffers.size()), drawCmdBuffers.data());
 }
 
@@ -167,38 +232,261 @@ std::string VulkanExampleBase::getShadersPath() const
 	return getAssetPath() + "shaders/" + shaderDir + "/";
 }
 
+// Header written in front of the pipeline cache data stored on disk
+// The Vulkan pipeline cache header doesn't contain the driver version, so we store our own key to discard caches from other devices or drivers
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t dataSize;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+static const uint32_t pipelineCacheFileMagic = 0x43504b56; // "VKPC"
+// Layout of the header at the start of the data returned by vkGetPipelineCacheData (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+struct PipelineCacheDataHeader {
+	uint32_t headerSize;
+	uint32_t headerVersion;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+std::string VulkanExampleBase::getPipelineCacheFileName()
+{
+	std::stringstream fileName;
+	fileName << pipelineCacheDir << "/" << name << "_" << std::hex << deviceProperties.vendorID << "_" << deviceProperties.deviceID << ".pipelinecache";
+	return fileName.str();
+}
+
+// The recorded pipeline state contains device specific formats (e.g. of the swap chain), so the manifest is stored per device like the pipeline cache
+std::string VulkanExampleBase::getPipelineManifestFileName()
+{
+	std::stringstream fileName;
+	fileName << pipelineCacheDir << "/" << name << "_" << std::hex << deviceProperties.vendorID << "_" << deviceProperties.deviceID << ".pipelinemanifest";
+	return fileName.str();
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	// There are no command line arguments on Android, so the pipeline cache is always persisted to the app's internal storage
+	pipelineCacheDir = androidApp->activity->internalDataPath;
+#endif
+	std::vector<char> cacheData;
+	if (!pipelineCacheDir.empty()) {
+		// Try to load a pipeline cache from a previous run
+		const std::string fileName = getPipelineCacheFileName();
+		std::ifstream is(fileName, std::ios::binary | std::ios::in);
+		if (is.is_open()) {
+			PipelineCacheFileHeader fileHeader{};
+			is.read((char*)&fileHeader, sizeof(fileHeader));
+			// Only use the cache if it was created on this device with the same driver
+			bool valid = is.good() &&
+				(fileHeader.magic == pipelineCacheFileMagic) &&
+				(fileHeader.vendorID == deviceProperties.vendorID) &&
+				(fileHeader.deviceID == deviceProperties.deviceID) &&
+				(fileHeader.driverVersion == deviceProperties.driverVersion) &&
+				(memcmp(fileHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0) &&
+				(fileHeader.dataSize >= sizeof(PipelineCacheDataHeader));
+			if (valid) {
+				cacheData.resize(fileHeader.dataSize);
+				is.read(cacheData.data(), cacheData.size());
+				valid = is.good();
+			}
+			if (valid) {
+				// Also validate the header of the cache data itself
+				PipelineCacheDataHeader cacheHeader;
+				memcpy(&cacheHeader, cacheData.data(), sizeof(cacheHeader));
+				valid = (cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+					(cacheHeader.headerSize >= sizeof(PipelineCacheDataHeader)) &&
+					(cacheHeader.vendorID == deviceProperties.vendorID) &&
+					(cacheHeader.deviceID == deviceProperties.deviceID) &&
+					(memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+			}
+			if (!valid) {
+				std::cout << "Discarding stale or invalid pipeline cache \"" << fileName << "\"\n";
+				cacheData.clear();
+			}
+			is.close();
+		}
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
 	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 }
 
+void VulkanExampleBase::savePipelineCache()
+{
+	if (pipelineCacheDir.empty() || (pipelineCache == VK_NULL_HANDLE)) {
+		return;
+	}
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0) {
+		return;
+	}
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()));
+
+	PipelineCacheFileHeader fileHeader{};
+	fileHeader.magic = pipelineCacheFileMagic;
+	fileHeader.dataSize = static_cast<uint32_t>(dataSize);
+	fileHeader.vendorID = deviceProperties.vendorID;
+	fileHeader.deviceID = deviceProperties.deviceID;
+	fileHeader.driverVersion = deviceProperties.driverVersion;
+	memcpy(fileHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	const std::string fileName = getPipelineCacheFileName();
+	std::ofstream os(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!os.is_open()) {
+		std::cerr << "Could not write pipeline cache to \"" << fileName << "\"\n";
+		return;
+	}
+	os.write((const char*)&fileHeader, sizeof(fileHeader));
+	os.write(cacheData.data(), dataSize);
+	os.close();
+}
+
 void VulkanExampleBase::prepare()
 {
+	startup.prepare = vks::StartupProfiler::Clock::now();
+	vks::TraceZone stage("Swap chain");
 	if (vulkanDevice->enableDebugMarkers) {
 		vks::debugmarker::setup(device);
 	}
-	initSwapchain();
+	if (settings.headless) {
+		// Keep one image more than frames in flight so the readback of an image never overlaps rendering to it
+		swapChain.requestedImageCount = std::max(swapChain.requestedImageCount, maxFramesInFlight + 1);
+		swapChain.readbackPrefix = name;
+		swapChain.initHeadless(queue, vulkanDevice->queueFamilyIndices.graphics);
+	} else {
+		initSwapchain();
+	}
 	createCommandPool();
 	setupSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
 	setupDepthStencil();
+	vks::StartupProfiler::get().setPhase("swapchain", vks::StartupProfiler::elapsed(startup.prepare, vks::StartupProfiler::Clock::now()));
+	stage.next("Render pass");
+	// The depth prepass changes the layout of the default render pass, so it's only used by examples that support it
+	depthPrepass.enabled = depthPrepass.supported && depthPrepass.requested;
+	depthPrepass.mainSubpass = depthPrepass.enabled ? 1 : 0;
+	if (depthPrepass.enabled) {
+		UIOverlay.subpass = depthPrepass.mainSubpass;
+	}
+	// The offscreen scene image and the cached UI layer are rendered with render pass objects of their own, which the default render pass needs to be compatible with
+	dynamicRendering.enabled = dynamicRendering.enabled && !depthPrepass.enabled && !(dynamicResolution.supported && dynamicResolution.requested) && !adaptiveShadingRate.enabled && !settings.overlayLayer;
+	if (dynamicRendering.enabled) {
+		vks::dynamicrendering::setup(device);
+		dynamicRendering.colorFormat = swapChain.colorFormat;
+		dynamicRendering.inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		dynamicRendering.inheritanceInfo.colorAttachmentCount = 1;
+		dynamicRendering.inheritanceInfo.pColorAttachmentFormats = &dynamicRendering.colorFormat;
+		dynamicRendering.inheritanceInfo.depthAttachmentFormat = depthFormat;
+		dynamicRendering.inheritanceInfo.stencilAttachmentFormat = (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) ? depthFormat : VK_FORMAT_UNDEFINED;
+		dynamicRendering.inheritanceInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	}
 	setupRenderPass();
+	stage.next("Pipeline cache");
 	createPipelineCache();
+	pipelineCompiler.setup(device, pipelineCache);
+	if (pipelineManifest && vks::PipelineManifest::get().load(getPipelineManifestFileName())) {
+		// Compiled while the example loads its assets, the example's own pipeline creation then picks up the precompiled pipelines
+		vks::PipelineManifest::get().precompile(device, pipelineCompiler, pipelineCache, [this](const std::string& fileName) {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+			return vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+#else
+			return vks::tools::loadShader(fileName.c_str(), device);
+#endif
+		});
+	}
+	stage.next("Frame resources");
+	gpuProfiler.setup(vulkanDevice);
+	if (pipelineStatistics.enabled) {
+		gpuProfiler.enablePipelineStatistics();
+	}
+	if (vks::TraceRecorder::get().active()) {
+		vks::TraceRecorder::get().setupGpuClock(instance, vulkanDevice);
+	}
+	if ((metricsExport.port > 0) && !metricsExport.exporter.start(metricsExport.port, name, deviceProperties.deviceName)) {
+		std::cerr << "Could not start the metrics exporter on port " << metricsExport.port << "\n";
+	}
+	if (uniformRingSize > 0) {
+		uniformRing.setup(vulkanDevice, uniformRingSize, maxFramesInFlight);
+	}
+	if (frameCaptureSlots > 0) {
+		frameCapture.setup(vulkanDevice, frameCaptureSlots, maxFramesInFlight);
+	}
+	frameArena.setup(frameArenaSize, maxFramesInFlight);
+	// Pools are only created once sets are allocated
+	frameDescriptors.setup(device, maxFramesInFlight);
 	setupFrameBuffer();
+	// The scene render pass of dynamic resolution mirrors the default render pass, which has a different layout with the depth prepass
+	dynamicResolution.enabled = dynamicResolution.supported && dynamicResolution.requested && !depthPrepass.enabled;
+	// Adaptive shading rate uses the same scene render pass, the device features have already been enabled in initVulkan
+	adaptiveShadingRate.enabled = adaptiveShadingRate.enabled && !depthPrepass.enabled;
+	// Frame pacing tags the presents on the main thread, and the cached UI layer is rendered with submissions of its own between frames
+	submitThread.enabled = submitThread.supported && submitThread.requested && dynamicCommandBuffers && !framePacing.enabled && !settings.overlayLayer;
+	// Camera blocks are reserved in the uniform ring by command buffers recorded each frame
+	lateLatch.enabled = lateLatch.supported && lateLatch.requested && dynamicCommandBuffers && (uniformRingSize > 0);
+	lateLatch.cameraTime = std::chrono::steady_clock::now();
+	if (submitThread.enabled) {
+		// The thread only uses the queue once frames are handed over, so the example can still use it while preparing
+		submitThread.submitter.start(queue, &swapChain);
+	}
+	stage.next("Scene image");
+	if (sceneImageEnabled()) {
+		dynamicResolution.scaler.prepare(vulkanDevice, swapChain.colorFormat, depthFormat, {
+			loadShader(getShadersPath() + "base/upscale.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "base/upscale.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+		}, renderPass, pipelineCache);
+		dynamicResolution.scaler.resize(width, height, depthStencil.view, queue);
+	}
+	if (adaptiveShadingRate.enabled) {
+		VkPhysicalDeviceShadingRateImagePropertiesNV shadingRateImageProperties{};
+		shadingRateImageProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_PROPERTIES_NV;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &shadingRateImageProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+		adaptiveShadingRate.generator.prepare(vulkanDevice, shadingRateImageProperties.shadingRateTexelSize, loadShader(getShadersPath() + "base/shadingrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		adaptiveShadingRate.generator.resize(width, height, dynamicResolution.scaler.getImageView());
+	}
+	stage.next("UI overlay");
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
+		// Command buffers recorded each frame draw the region of the latest update, pre-recorded command buffers always draw the same region
+		// One more region than frames in flight is required, as the overlay is updated after submitting a frame and before waiting for the next one
+		// The cached layer is the only reader of the geometry buffers and waits for its last render before they are written again
+		UIOverlay.bufferRegions = (dynamicCommandBuffers && !settings.overlayLayer) ? (maxFramesInFlight + 1) : 1;
 		UIOverlay.shaders = {
 			loadShader(getShadersPath() + "base/uioverlay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
+		UIOverlay.layer.enabled = settings.overlayLayer;
+		if (settings.overlayLayer) {
+			UIOverlay.layer.format = swapChain.colorFormat;
+			UIOverlay.layerShaders = {
+				loadShader(getShadersPath() + "base/upscale.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+				loadShader(getShadersPath() + "base/uioverlaylayer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+			};
+		}
 		UIOverlay.prepareResources();
+		const VkPipelineRenderingCreateInfoKHR pipelineRenderingCI = getScenePipelineRenderingInfo();
+		UIOverlay.pipelineRenderingInfo = dynamicRendering.enabled ? &pipelineRenderingCI : nullptr;
 		UIOverlay.preparePipeline(pipelineCache, renderPass);
+		UIOverlay.pipelineRenderingInfo = nullptr;
+		// Creates the layer, so pre-recorded command buffers can reference it before the first update
+		UIOverlay.resize(width, height);
 	}
+	vks::StartupProfiler::get().setPhase("baseprepare", vks::StartupProfiler::elapsed(startup.prepare, vks::StartupProfiler::Clock::now()));
 }
 
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
@@ -206,17 +494,80 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
+	shaderStage.pName = "main";
+	// Reuse the module if this shader has already been loaded
+	auto cachedModule = shaderModuleCache.find(fileName);
+	if (cachedModule != shaderModuleCache.end()) {
+		shaderStage.module = cachedModule->second;
+		return shaderStage;
+	}
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
 #else
 	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
 #endif
-	shaderStage.pName = "main";
 	assert(shaderStage.module != VK_NULL_HANDLE);
 	shaderModules.push_back(shaderStage.module);
+	shaderModuleCache[fileName] = shaderStage.module;
 	return shaderStage;
 }
 
+/**
+* Create the depth only pipeline for the depth prepass from a fully set up pipeline create info, does nothing if the depth prepass isn't enabled
+*
+* The prepass pipeline only has the vertex stage of the given pipeline and writes depth, the create info is then changed to the main subpass with
+* depth writes disabled and an equal depth test, so only the fragments that passed the prepass are shaded
+* Both pipelines use the same vertex shader and vertex input, so they produce the same depth values
+*
+* @param pipelineCI Create info of the main pass pipeline, its subpass is changed to the main subpass
+* @param depthStencilState Depth stencil state referenced by the create info, changed to an equal depth test without writes
+* @param prepassPipeline Receives the prepass pipeline, left unchanged if the depth prepass isn't enabled
+*/
+void VulkanExampleBase::prepareDepthPrepassPipeline(VkGraphicsPipelineCreateInfo& pipelineCI, VkPipelineDepthStencilStateCreateInfo& depthStencilState, VkPipeline* prepassPipeline)
+{
+	if (!depthPrepass.enabled) {
+		return;
+	}
+	std::vector<VkPipelineShaderStageCreateInfo> stages;
+	for (uint32_t i = 0; i < pipelineCI.stageCount; i++) {
+		if (pipelineCI.pStages[i].stage == VK_SHADER_STAGE_VERTEX_BIT) {
+			stages.push_back(pipelineCI.pStages[i]);
+		}
+	}
+	assert(!stages.empty());
+	VkPipelineDepthStencilStateCreateInfo prepassDepthStencilState = depthStencilState;
+	prepassDepthStencilState.depthTestEnable = VK_TRUE;
+	prepassDepthStencilState.depthWriteEnable = VK_TRUE;
+	prepassDepthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	// The prepass subpass has no color attachments
+	VkPipelineColorBlendStateCreateInfo prepassColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(0, nullptr);
+	VkGraphicsPipelineCreateInfo prepassPipelineCI = pipelineCI;
+	prepassPipelineCI.stageCount = static_cast<uint32_t>(stages.size());
+	prepassPipelineCI.pStages = stages.data();
+	prepassPipelineCI.pDepthStencilState = &prepassDepthStencilState;
+	prepassPipelineCI.pColorBlendState = &prepassColorBlendState;
+	prepassPipelineCI.subpass = 0;
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &prepassPipelineCI, nullptr, prepassPipeline));
+
+	depthStencilState.depthTestEnable = VK_TRUE;
+	depthStencilState.depthWriteEnable = VK_FALSE;
+	depthStencilState.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	pipelineCI.subpass = depthPrepass.mainSubpass;
+}
+
+/**
+* Enable the shading rate image of adaptive shading rate for a scene pipeline
+* Pipelines created with it shade at full rate unless the generated shading rate image is bound (see AdaptiveShadingRate::active)
+*
+* @param viewportState Viewport state of the pipeline, left unchanged if adaptive shading rate isn't enabled
+*/
+void VulkanExampleBase::enableAdaptiveShadingRate(VkPipelineViewportStateCreateInfo& viewportState)
+{
+	if (adaptiveShadingRate.enabled) {
+		viewportState.pNext = adaptiveShadingRate.generator.getPipelineViewportState();
+	}
+}
+
 void VulkanExampleBase::nextFrame()
 {
 	auto tStart = std::chrono::high_resolution_clock::now();
@@ -230,8 +581,7 @@ void VulkanExampleBase::nextFrame()
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 	auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-	frameTimer = (float)tDiff / 1000.0f;
-	camera.update(frameTimer);
+	updateFrameTime((float)tDiff / 1000.0f);
 	if (camera.moving())
 	{
 		viewUpdated = true;
@@ -262,11 +612,157 @@ void VulkanExampleBase::nextFrame()
 	updateOverlay();
 }
 
+/**
+* Render a benchmark frame, the benchmark loop has no input and only advances the frame time if a fixed timestep is set
+*/
+void VulkanExampleBase::benchmarkFrame()
+{
+	if (viewUpdated)
+	{
+		viewUpdated = false;
+		viewChanged();
+	}
+	render();
+	if (replay.fixedTimestep > 0.0f)
+	{
+		updateFrameTime(replay.fixedTimestep);
+		if (!paused)
+		{
+			timer += timerSpeed * frameTimer;
+			if (timer > 1.0)
+			{
+				timer -= 1.0f;
+			}
+		}
+	}
+}
+
+/**
+* Advance the frame timer by the measured frame time (or the fixed timestep if set) and update the camera
+* The camera then follows the replayed camera path or is added to the recorded one
+*/
+void VulkanExampleBase::updateFrameTime(float measuredTime)
+{
+	if (replay.recording && replay.cameraPath.keyframes.empty())
+	{
+		replay.cameraPath.addKeyframe(0.0f, camera.position, camera.rotation);
+	}
+	frameTimer = (replay.fixedTimestep > 0.0f) ? replay.fixedTimestep : measuredTime;
+	if (lateLatch.enabled && (replay.fixedTimestep <= 0.0f)) {
+		// The camera may have been advanced by the latch of the last frame, so it's moved by the time passed since instead of the frame time
+		advanceCamera();
+	} else {
+		camera.update(frameTimer);
+	}
+	if (!replay.replaying && !replay.recording)
+	{
+		return;
+	}
+	replay.time += frameTimer;
+	if (replay.replaying)
+	{
+		glm::vec3 position = camera.position;
+		glm::vec3 rotation = camera.rotation;
+		replay.cameraPath.sample(static_cast<float>(replay.time), position, rotation);
+		camera.setPosition(position);
+		camera.setRotation(rotation);
+		viewUpdated = true;
+	}
+	else
+	{
+		replay.cameraPath.addKeyframe(static_cast<float>(replay.time), camera.position, camera.rotation);
+	}
+}
+
 void VulkanExampleBase::renderLoop()
 {
+	if (replay.replaying) {
+		glm::vec3 position = camera.position;
+		glm::vec3 rotation = camera.rotation;
+		replay.cameraPath.sample(0.0f, position, rotation);
+		camera.setPosition(position);
+		camera.setRotation(rotation);
+		viewUpdated = true;
+	}
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.name = name;
+		benchmark.width = width;
+		benchmark.height = height;
+		benchmark.presentMode = settings.headless ? "HEADLESS" : vks::tools::presentModeString(swapChain.presentMode);
+		benchmark.swapChainImages = swapChain.imageCount;
+		// Vertex cache efficiency of the optimized glTF index buffers, in file order and after optimization
+		if (vkglTF::loadedIndexStatistics.triangleCount > 0) {
+			benchmark.addMetric("acmrbefore", vkglTF::loadedIndexStatistics.acmrBefore());
+			benchmark.addMetric("acmrafter", vkglTF::loadedIndexStatistics.acmrAfter());
+		}
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		// Throttling changes the frame times, so changes of the thermal status are stored with them (requires Android 11)
+		if (vks::android::getThermalStatus() >= 0) {
+			benchmark.thermalStatus = [] { return vks::android::getThermalStatus(); };
+		}
+#endif
+		benchmark.fixedTimestep = replay.fixedTimestep;
+		if (commandLineParser.isSet("benchcompare")) {
+			const std::string setting = commandLineParser.getValueAsString("benchcompare", "");
+			if (setComparisonSetting(setting, false)) {
+				benchmark.compare(setting, [=](bool enabled) {
+					waitForFramesInFlight();
+					setComparisonSetting(setting, enabled);
+					if (!dynamicCommandBuffers) {
+						buildCommandBuffers();
+					}
+				}, static_cast<uint32_t>(commandLineParser.getValueAsInt("benchcompareblock", 60)));
+			} else {
+				std::cerr << "Setting \"" << setting << "\" can't be compared by this example\n";
+			}
+		}
+		benchmark.run([=] { benchmarkFrame(); }, vulkanDevice->properties);
+		submitThread.submitter.wait();
 		vkDeviceWaitIdle(device);
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		const float thermalHeadroom = vks::android::getThermalHeadroom(0);
+		if (!std::isnan(thermalHeadroom)) {
+			benchmark.addMetric("thermalheadroom", thermalHeadroom);
+		}
+#endif
+		if (dynamicResolution.enabled) {
+			benchmark.addMetric("renderscale", dynamicResolution.scaler.scale);
+		}
+		if (lateLatch.inputAgeSamples > 0) {
+			benchmark.addMetric("inputage", lateLatch.inputAgeSum / static_cast<double>(lateLatch.inputAgeSamples));
+		}
+		if (framePacing.latencySamples > 0) {
+			benchmark.addMetric("presentlatency", framePacing.latencySum / static_cast<double>(framePacing.latencySamples));
+			benchmark.addMetric("swapinterval", framePacing.swapInterval);
+		}
+		if (adaptiveShadingRate.enabled && adaptiveShadingRate.generator.statisticsSupported()) {
+			benchmark.addMetric("fragmentinvocations", static_cast<double>(adaptiveShadingRate.active ? adaptiveShadingRate.generator.fragmentInvocations : adaptiveShadingRate.generator.fullRateFragmentInvocations));
+		}
+		if (frameCapture.isReady()) {
+			benchmark.addMetric("capturedframes", frameCapture.capturedFrames);
+			benchmark.addMetric("droppedcaptures", frameCapture.droppedFrames);
+		}
+		// Startup phases, with asset loading and pipeline creation summed over all threads
+		const vks::StartupProfiler& startupProfiler = vks::StartupProfiler::get();
+		for (auto& phase : startupProfiler.getPhases()) {
+			benchmark.addSetupTime(phase.name, phase.ms);
+		}
+		benchmark.addSetupTime("assetio", startupProfiler.getAssetTime(vks::StartupProfiler::AssetIO));
+		benchmark.addSetupTime("assetdecode", startupProfiler.getAssetTime(vks::StartupProfiler::AssetDecode));
+		benchmark.addSetupTime("assetupload", startupProfiler.getAssetTime(vks::StartupProfiler::AssetUpload));
+		const vks::StartupProfiler::PipelineStatistics pipelineStatistics = startupProfiler.getPipelineStatistics();
+		benchmark.addSetupTime("pipelines", pipelineStatistics.ms);
+		benchmark.addMetric("pipelinecount", pipelineStatistics.pipelines);
+		if (startupProfiler.pipelineFeedbackSupported) {
+			benchmark.addMetric("pipelinecachehits", pipelineStatistics.cacheHits);
+			benchmark.addMetric("pipelinecachemisses", pipelineStatistics.cacheMisses);
+		}
+		if (pipelineManifest) {
+			const vks::PipelineManifest::Statistics manifestStatistics = vks::PipelineManifest::get().getStatistics();
+			benchmark.addMetric("precompiledpipelines", manifestStatistics.precompiled);
+			benchmark.addMetric("precompiledpipelinesused", manifestStatistics.used);
+			benchmark.addMetric("pipelinescompiledoncreation", manifestStatistics.compiled);
+		}
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -332,8 +828,7 @@ void VulkanExampleBase::renderLoop()
 			frameCounter++;
 			auto tEnd = std::chrono::high_resolution_clock::now();
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-			frameTimer = tDiff / 1000.0f;
-			camera.update(frameTimer);
+			updateFrameTime(tDiff / 1000.0f);
 			// Convert to clamped timer value
 			if (!paused)
 			{
@@ -416,8 +911,7 @@ void VulkanExampleBase::renderLoop()
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		updateFrameTime(tDiff / 1000.0f);
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -458,8 +952,7 @@ void VulkanExampleBase::renderLoop()
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		updateFrameTime(tDiff / 1000.0f);
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -504,8 +997,7 @@ void VulkanExampleBase::renderLoop()
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		updateFrameTime(tDiff / 1000.0f);
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -543,6 +1035,12 @@ void VulkanExampleBase::renderLoop()
 			viewUpdated = false;
 			viewChanged();
 		}
+		for (auto deferredEvent : lateLatch.deferredEvents)
+		{
+			handleEvent(deferredEvent);
+			free(deferredEvent);
+		}
+		lateLatch.deferredEvents.clear();
 		xcb_generic_event_t *event;
 		while ((event = xcb_poll_for_event(connection)))
 		{
@@ -553,8 +1051,7 @@ void VulkanExampleBase::renderLoop()
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		updateFrameTime(tDiff / 1000.0f);
 		if (camera.moving())
 		{
 			viewUpdated = true;
@@ -588,6 +1085,7 @@ void VulkanExampleBase::renderLoop()
 	[NSApp run];
 #endif
 	// Flush device to make sure all resources can be freed
+	submitThread.submitter.wait();
 	if (device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(device);
 	}
@@ -598,9 +1096,17 @@ void VulkanExampleBase::updateOverlay()
 	if (!settings.overlay)
 		return;
 
+	cpuProfiler.lap(vks::CpuFrameProfiler::Update);
+
 	ImGuiIO& io = ImGui::GetIO();
 
-	io.DisplaySize = ImVec2((float)width, (float)height);
+	// Interacting with the UI may cause the example to change resources or re-record command buffers that are still in use by frames in flight
+	// Examples recording their command buffers each frame only change state that is picked up by the next recording, so they don't have to wait
+	if (io.WantCaptureMouse && !dynamicCommandBuffers) {
+		waitForFramesInFlight();
+	}
+
+	UIOverlay.resize(width, height);
 	io.DeltaTime = frameTimer;
 
 	io.MousePos = ImVec2(mousePos.x, mousePos.y);
@@ -616,6 +1122,128 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::TextUnformatted(deviceProperties.deviceName);
 	ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+	if (depthPrepass.enabled) {
+		ImGui::TextUnformatted("Depth prepass");
+	}
+	if (replay.replaying) {
+		const double duration = static_cast<double>(replay.cameraPath.duration());
+		ImGui::Text("Camera path: %.1f / %.1f s", (duration > 0.0) ? std::fmod(replay.time, duration) : 0.0, duration);
+	} else if (replay.recording) {
+		ImGui::Text("Recording camera path: %.1f s", replay.time);
+	}
+	if (lateLatch.supported) {
+		ImGui::Text("Input age at submit: %.2f ms%s", lateLatch.inputAge, lateLatch.enabled ? " (late latched)" : "");
+	}
+	if (framePacing.enabled) {
+		ImGui::Text("%s, %d images", vks::tools::presentModeString(swapChain.presentMode).c_str(), swapChain.imageCount);
+		ImGui::Text("%s: %.2f ms", lateLatch.enabled ? "Input to present latency" : "Present latency", framePacing.latency);
+		if (ImGui::Checkbox("Frame pacing", &framePacing.active)) {
+			framePacing.latency = 0.0;
+		}
+		if (framePacing.active) {
+			ImGui::Text("Frame start delay: %.2f ms", static_cast<double>(framePacing.delay) / 1.0e6);
+			ImGui::Text("Swap interval: %u", framePacing.swapInterval);
+		}
+	}
+	vulkanDevice->updateMemoryBudget();
+	for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryHeapCount; i++) {
+		if (vulkanDevice->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			const vks::VulkanDevice::HeapBudget& heapBudget = vulkanDevice->heapBudgets[i];
+			ImGui::Text("Heap %u: %.0f / %.0f MB", i, static_cast<double>(heapBudget.usage) / (1024.0 * 1024.0), static_cast<double>(heapBudget.budget) / (1024.0 * 1024.0));
+		}
+	}
+	if (hitchDetector.enabled) {
+		const vks::HitchDetector::FrameStats& stats = hitchDetector.last;
+		if (ImGui::TreeNode("hitchdetector", "Allocations: %u (%.1f KB), Vulkan calls: %u", static_cast<uint32_t>(stats.allocations), static_cast<double>(stats.bytes) / 1024.0, stats.vulkanCalls)) {
+			if (!vks::HitchDetector::hooksAvailable()) {
+				ImGui::Text("Heap allocations not counted (built without allocation hooks)");
+			}
+			for (uint32_t i = 0; i < stats.threadCount; i++) {
+				if (stats.threads[i].allocations > 0) {
+					ImGui::Text("Thread %u: %u (%.1f KB)", i, static_cast<uint32_t>(stats.threads[i].allocations), static_cast<double>(stats.threads[i].bytes) / 1024.0);
+				}
+			}
+			ImGui::Text("Frames over budget (%u allocations): %u", static_cast<uint32_t>(hitchDetector.allocationBudget), hitchDetector.flaggedFrames);
+			ImGui::TreePop();
+		}
+	}
+	vks::MemoryReport& memoryReport = vulkanDevice->memoryAllocator.report;
+	if (ImGui::TreeNode("memoryreport", "Tracked memory: %.1f MB", static_cast<double>(memoryReport.getTotalUsage()) / (1024.0 * 1024.0))) {
+		for (uint32_t i = 0; i < static_cast<uint32_t>(vks::MemoryCategory::Count); i++) {
+			const vks::MemoryCategory category = static_cast<vks::MemoryCategory>(i);
+			if (memoryReport.getPeakUsage(category) > 0) {
+				ImGui::Text("%s: %.1f MB (peak %.1f MB)", vks::MemoryReport::categoryName(category), static_cast<double>(memoryReport.getUsage(category)) / (1024.0 * 1024.0), static_cast<double>(memoryReport.getPeakUsage(category)) / (1024.0 * 1024.0));
+			}
+		}
+		for (auto& entry : memoryReport.getLargestEntries(5)) {
+			ImGui::Text("%.1f MB %s (%s)", static_cast<double>(entry.size) / (1024.0 * 1024.0), entry.name.empty() ? "unnamed" : entry.name.c_str(), vks::MemoryReport::categoryName(entry.category));
+		}
+		const vks::FragmentationStats fragmentationStats = vulkanDevice->memoryAllocator.getFragmentationStats();
+		ImGui::Text("Blocks: %u, %.1f of %.1f MB used, fragmentation: %.0f%%", fragmentationStats.blockCount, static_cast<double>(fragmentationStats.usedBytes) / (1024.0 * 1024.0), static_cast<double>(fragmentationStats.sharedBlockBytes) / (1024.0 * 1024.0), fragmentationStats.fragmentation() * 100.0f);
+		if (fragmentationStats.movableCount > 0) {
+			ImGui::Text("Movable: %u, moved: %u (%.1f MB)", fragmentationStats.movableCount, fragmentationStats.allocationsMoved, static_cast<double>(fragmentationStats.bytesMoved) / (1024.0 * 1024.0));
+		}
+		ImGui::TreePop();
+	}
+	const vks::SecondaryCommandBuffers::Statistics& secondaryStatistics = secondaryCommandBuffers.statistics;
+	if (secondaryStatistics.staticRecorded + secondaryStatistics.staticReused > 0) {
+		ImGui::Text("Secondaries: %u static (%u recorded), %u dynamic", secondaryStatistics.staticRecorded + secondaryStatistics.staticReused, secondaryStatistics.staticRecorded, secondaryStatistics.dynamicRecorded);
+	}
+	if (vulkanDevice->directUpload.bytesWritten > 0) {
+		ImGui::Text("Direct uploads (%s): %.1f MB", vulkanDevice->directUpload.unifiedMemory ? "unified memory" : "resizable BAR", static_cast<double>(vulkanDevice->directUpload.bytesWritten) / (1024.0 * 1024.0));
+	}
+	if (dynamicResolution.enabled) {
+		ImGui::Text("Render resolution: %dx%d (%.0f%%)", dynamicResolution.scaler.renderWidth, dynamicResolution.scaler.renderHeight, dynamicResolution.scaler.scale * 100.0f);
+	}
+	if (adaptiveShadingRate.enabled && adaptiveShadingRate.generator.statisticsSupported()) {
+		const vks::ShadingRateGenerator& generator = adaptiveShadingRate.generator;
+		if (adaptiveShadingRate.active && (generator.fullRateFragmentInvocations > 0)) {
+			// Compared to the latest full rate measurement, so it's only meaningful while the view doesn't change much
+			const double saved = 100.0 * (1.0 - static_cast<double>(generator.fragmentInvocations) / static_cast<double>(generator.fullRateFragmentInvocations));
+			ImGui::Text("Fragment invocations: %llu (%.1f%% saved)", static_cast<unsigned long long>(generator.fragmentInvocations), saved);
+		} else {
+			ImGui::Text("Fragment invocations: %llu", static_cast<unsigned long long>(adaptiveShadingRate.active ? generator.fragmentInvocations : generator.fullRateFragmentInvocations));
+		}
+	}
+	if (UIOverlay.layer.enabled) {
+		ImGui::Text("UI layer renders: %u", UIOverlay.layer.renderCount);
+	}
+	if (extendedDynamicState.pipelinesAvoided > 0) {
+		ImGui::Text("Pipelines avoided by dynamic state: %u", extendedDynamicState.pipelinesAvoided);
+	}
+	for (auto& timing : gpuProfiler.timings) {
+		ImGui::Text("%*s%s: %.3f ms (GPU)", timing.depth * 2, "", timing.name.c_str(), timing.ms);
+	}
+	// Stacked bar of the CPU frame phases averaged over the last frames, shows at a glance if the CPU is waiting on the GPU (fence wait) or the presentation engine (acquire, present)
+	{
+		static const ImU32 phaseColors[vks::CpuFrameProfiler::PhaseCount] = {
+			IM_COL32(90, 160, 230, 255), IM_COL32(200, 70, 70, 255), IM_COL32(230, 160, 60, 255), IM_COL32(90, 200, 110, 255),
+			IM_COL32(160, 110, 220, 255), IM_COL32(230, 220, 80, 255), IM_COL32(150, 150, 150, 255)
+		};
+		const double total = cpuProfiler.averageTotal();
+		ImGui::Text("CPU frame: %.2f ms", total);
+		const ImVec2 barPos = ImGui::GetCursorScreenPos();
+		const ImVec2 barSize(200.0f * UIOverlay.scale, 8.0f * UIOverlay.scale);
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		float x = barPos.x;
+		for (uint32_t i = 0; i < vks::CpuFrameProfiler::PhaseCount; i++) {
+			const float w = (total > 0.0) ? barSize.x * static_cast<float>(cpuProfiler.average(static_cast<vks::CpuFrameProfiler::Phase>(i)) / total) : 0.0f;
+			drawList->AddRectFilled(ImVec2(x, barPos.y), ImVec2(x + w, barPos.y + barSize.y), phaseColors[i]);
+			x += w;
+		}
+		ImGui::Dummy(barSize);
+		for (uint32_t i = 0; i < vks::CpuFrameProfiler::PhaseCount; i++) {
+			const vks::CpuFrameProfiler::Phase phase = static_cast<vks::CpuFrameProfiler::Phase>(i);
+			if (i % 2 != 0) {
+				ImGui::SameLine(barSize.x / 2.0f);
+			}
+			ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(phaseColors[i]), "%s %.2f", vks::CpuFrameProfiler::phaseName(phase), cpuProfiler.average(phase));
+		}
+		// Submit and present of the main thread only cover the hand over, the actual calls are timed on the submission thread
+		if (submitThread.enabled) {
+			ImGui::Text("Submit thread: submit %.2f, present %.2f", submitThread.submitter.submitTime.load(), submitThread.submitter.presentTime.load());
+		}
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
@@ -630,9 +1258,21 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::End();
 	ImGui::PopStyleVar();
 	ImGui::Render();
+	cpuProfiler.lap(vks::CpuFrameProfiler::UI);
 
-	if (UIOverlay.update() || UIOverlay.updated) {
-		buildCommandBuffers();
+	bool rebuildCmdBuffers = UIOverlay.updated;
+	if (UIOverlay.layer.enabled) {
+		// Frames composite the layer with the same commands regardless of the UI's geometry
+		UIOverlay.updateLayer(io.WantCaptureMouse);
+	} else {
+		rebuildCmdBuffers |= UIOverlay.update();
+	}
+	if (rebuildCmdBuffers) {
+		// With dynamic command buffers the UI is recorded along with the next frame, so no rebuild is required
+		if (!dynamicCommandBuffers) {
+			waitForFramesInFlight();
+			buildCommandBuffers();
+		}
 		UIOverlay.updated = false;
 	}
 
@@ -655,10 +1295,406 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 	}
 }
 
+bool VulkanExampleBase::sceneImageEnabled() const
+{
+	return dynamicResolution.enabled || adaptiveShadingRate.enabled;
+}
+
+void VulkanExampleBase::beginSceneRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearValue* clearValues, uint32_t clearValueCount, VkSubpassContents contents)
+{
+	const bool sceneImage = sceneImageEnabled();
+	const uint32_t renderWidth = sceneImage ? dynamicResolution.scaler.renderWidth : width;
+	const uint32_t renderHeight = sceneImage ? dynamicResolution.scaler.renderHeight : height;
+
+	if (dynamicRendering.enabled) {
+		// The layout transitions of the default render pass' attachments are done with barriers, the previous contents are cleared
+		const VkImageSubresourceRange colorRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkImageSubresourceRange depthRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		const bool stencil = (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT);
+		if (stencil) {
+			depthRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		vks::tools::insertImageMemoryBarrier(commandBuffer, swapChain.buffers[imageIndex].image,
+			0, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, colorRange);
+		vks::tools::insertImageMemoryBarrier(commandBuffer, depthStencil.image,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, depthRange);
+
+		// Clear values are passed in the same order as for the default render pass (color, depth stencil)
+		const VkRenderingAttachmentInfoKHR colorAttachment = vks::dynamicrendering::attachmentInfo(swapChain.buffers[imageIndex].view, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, (clearValueCount > 0) ? clearValues[0] : VkClearValue{});
+		const VkRenderingAttachmentInfoKHR depthAttachment = vks::dynamicrendering::attachmentInfo(depthStencil.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, (clearValueCount > 1) ? clearValues[1] : VkClearValue{});
+		VkRenderingAttachmentInfoKHR stencilAttachment = depthAttachment;
+		stencilAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.flags = (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+		renderingInfo.renderArea.extent.width = width;
+		renderingInfo.renderArea.extent.height = height;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+		renderingInfo.pStencilAttachment = stencil ? &stencilAttachment : nullptr;
+		vks::dynamicrendering::beginRendering(commandBuffer, renderingInfo);
+		sceneSubpassContents = contents;
+		if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+			setSceneRenderState(commandBuffer);
+		}
+		return;
+	}
+
+	// The shading rate is derived from the scene image before it's overwritten by this frame's scene
+	if (adaptiveShadingRate.enabled) {
+		if (adaptiveShadingRate.active) {
+			gpuProfiler.beginScope(commandBuffer, "Shading rate image");
+			adaptiveShadingRate.generator.generate(commandBuffer, renderWidth, renderHeight);
+			gpuProfiler.endScope(commandBuffer);
+		}
+		adaptiveShadingRate.generator.beginStatistics(commandBuffer, adaptiveShadingRate.active);
+	}
+
+	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	renderPassBeginInfo.renderPass = sceneImage ? dynamicResolution.scaler.renderPass : renderPass;
+	renderPassBeginInfo.framebuffer = sceneImage ? dynamicResolution.scaler.framebuffer : frameBuffers[imageIndex];
+	renderPassBeginInfo.renderArea.extent.width = renderWidth;
+	renderPassBeginInfo.renderArea.extent.height = renderHeight;
+	renderPassBeginInfo.clearValueCount = clearValueCount;
+	renderPassBeginInfo.pClearValues = clearValues;
+
+	// The controller is fed with the GPU time of the scene render pass (see updateDynamicResolution)
+	if (dynamicResolution.enabled) {
+		gpuProfiler.beginScope(commandBuffer, "Dynamic resolution scene");
+	}
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, contents);
+	sceneSubpassContents = contents;
+
+	// State isn't inherited by secondaries, so they set it themselves
+	if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+		setSceneRenderState(commandBuffer);
+	}
+}
+
+void VulkanExampleBase::setSceneRenderState(VkCommandBuffer commandBuffer)
+{
+	const bool sceneImage = sceneImageEnabled();
+	const uint32_t renderWidth = sceneImage ? dynamicResolution.scaler.renderWidth : width;
+	const uint32_t renderHeight = sceneImage ? dynamicResolution.scaler.renderHeight : height;
+	const VkViewport viewport = vks::initializers::viewport((float)renderWidth, (float)renderHeight, 0.0f, 1.0f);
+	const VkRect2D scissor = vks::initializers::rect2D(renderWidth, renderHeight, 0, 0);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	if (adaptiveShadingRate.enabled) {
+		adaptiveShadingRate.generator.bind(commandBuffer, adaptiveShadingRate.active);
+	}
+}
+
+VkCommandBufferInheritanceInfo VulkanExampleBase::getSceneInheritanceInfo()
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = sceneImageEnabled() ? dynamicResolution.scaler.renderPass : renderPass;
+	inheritanceInfo.subpass = 0;
+	if (dynamicRendering.enabled) {
+		// Secondaries inherit the attachment formats instead of a render pass
+		inheritanceInfo.pNext = &dynamicRendering.inheritanceInfo;
+	}
+	return inheritanceInfo;
+}
+
+VkPipelineRenderingCreateInfoKHR VulkanExampleBase::getScenePipelineRenderingInfo() const
+{
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingCI{};
+	pipelineRenderingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	pipelineRenderingCI.colorAttachmentCount = 1;
+	pipelineRenderingCI.pColorAttachmentFormats = &dynamicRendering.colorFormat;
+	pipelineRenderingCI.depthAttachmentFormat = dynamicRendering.inheritanceInfo.depthAttachmentFormat;
+	pipelineRenderingCI.stencilAttachmentFormat = dynamicRendering.inheritanceInfo.stencilAttachmentFormat;
+	return pipelineRenderingCI;
+}
+
+void VulkanExampleBase::endSceneRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (sceneImageEnabled()) {
+		vkCmdEndRenderPass(commandBuffer);
+		if (dynamicResolution.enabled) {
+			gpuProfiler.endScope(commandBuffer);
+		}
+		if (adaptiveShadingRate.enabled) {
+			adaptiveShadingRate.generator.endStatistics(commandBuffer);
+		}
+
+		// The upscale covers the whole swap chain image, the clear values are only required by the default render pass' load ops
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		dynamicResolution.scaler.upscale(commandBuffer);
+	} else if ((sceneSubpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) && settings.overlay) {
+		// The scene render pass only allows secondaries, so the UI is recorded into one of this frame
+		VkCommandBufferInheritanceInfo inheritanceInfo = getSceneInheritanceInfo();
+		inheritanceInfo.framebuffer = dynamicRendering.enabled ? VK_NULL_HANDLE : frameBuffers[imageIndex];
+		const VkCommandBuffer uiCommandBuffer = secondaryCommandBuffers.recordDynamic(inheritanceInfo, [this](VkCommandBuffer secondary) { drawUI(secondary); });
+		vkCmdExecuteCommands(commandBuffer, 1, &uiCommandBuffer);
+	} else {
+		drawUI(commandBuffer);
+	}
+	if (dynamicRendering.enabled) {
+		vks::dynamicrendering::endRendering(commandBuffer);
+		// Done by the final layout of the default render pass otherwise
+		vks::tools::insertImageMemoryBarrier(commandBuffer, swapChain.buffers[imageIndex].image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+		return;
+	}
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+void VulkanExampleBase::updateDynamicResolution()
+{
+	if (!dynamicResolution.enabled || (dynamicResolution.gpuTime <= 0.0)) {
+		return;
+	}
+	const bool changed = dynamicResolution.scaler.update(dynamicResolution.gpuTime, dynamicResolution.targetTime);
+	dynamicResolution.gpuTime = 0.0;
+	// Static secondaries set the viewport to the render size they were recorded with
+	if (changed && secondaryCommandBuffers.isReady()) {
+		secondaryCommandBuffers.invalidateAll();
+	}
+	// Command buffers recorded each frame pick up the new render size with the next recording
+	if (changed && !dynamicCommandBuffers) {
+		waitForFramesInFlight();
+		buildCommandBuffers();
+	}
+}
+
+// Count the frame for the metrics exporter and, if a consumer is attached, publish a snapshot of the profilers' latest results
+void VulkanExampleBase::updateMetricsExport()
+{
+	// The CPU phases of a frame cover everything from its start to the start of the next one
+	double frameTime = 0.0;
+	for (uint32_t i = 0; i < vks::CpuFrameProfiler::PhaseCount; i++) {
+		frameTime += cpuProfiler.last(static_cast<vks::CpuFrameProfiler::Phase>(i));
+	}
+	vks::MetricsExporter& exporter = metricsExport.exporter;
+	exporter.addFrame(frameTime);
+	if (!exporter.consumerAttached()) {
+		return;
+	}
+	vks::MetricsExporter::Snapshot& snapshot = exporter.beginSnapshot();
+	for (uint32_t i = 0; i < vks::CpuFrameProfiler::PhaseCount; i++) {
+		const vks::CpuFrameProfiler::Phase phase = static_cast<vks::CpuFrameProfiler::Phase>(i);
+		snapshot.cpuLast[i] = cpuProfiler.last(phase);
+		snapshot.cpuAverage[i] = cpuProfiler.average(phase);
+	}
+	snapshot.scopeCount = std::min(static_cast<uint32_t>(gpuProfiler.timings.size()), vks::MetricsExporter::MaxScopes);
+	for (uint32_t i = 0; i < snapshot.scopeCount; i++) {
+		const vks::GpuProfiler::Timing& timing = gpuProfiler.timings[i];
+		vks::MetricsExporter::Scope& scope = snapshot.scopes[i];
+		strncpy(scope.name, timing.name.c_str(), vks::MetricsExporter::MaxNameLength - 1);
+		scope.name[vks::MetricsExporter::MaxNameLength - 1] = '\0';
+		scope.depth = timing.depth;
+		scope.ms = timing.ms;
+		scope.hasStatistics = timing.hasStatistics;
+		scope.statistics = timing.statistics;
+	}
+	vulkanDevice->updateMemoryBudget();
+	snapshot.heapCount = vulkanDevice->memoryProperties.memoryHeapCount;
+	for (uint32_t i = 0; i < snapshot.heapCount; i++) {
+		snapshot.heaps[i].budget = vulkanDevice->heapBudgets[i].budget;
+		snapshot.heaps[i].usage = vulkanDevice->heapBudgets[i].usage;
+		snapshot.heaps[i].deviceLocal = (vulkanDevice->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+	snapshot.presentMode = swapChain.presentMode;
+	snapshot.swapChainImages = swapChain.imageCount;
+	snapshot.width = width;
+	snapshot.height = height;
+	exporter.publish();
+}
+
+void VulkanExampleBase::updateFramePacing()
+{
+	// Match the presents displayed since the last frame with the start times of their frames
+	// The presentation engine uses CLOCK_MONOTONIC on Linux and Android, which is also what the steady clock is based on
+	if (framePacing.refreshDuration == 0) {
+		framePacing.refreshDuration = swapChain.getRefreshCycleDuration();
+	}
+	uint64_t minPresentMargin = UINT64_MAX;
+	for (auto& timing : swapChain.getPastPresentationTimings()) {
+		const uint64_t frameStart = framePacing.presentFrameStarts[timing.presentID % framePacing.presentFrameStarts.size()];
+		if ((frameStart > 0) && (timing.actualPresentTime > frameStart)) {
+			const double latency = static_cast<double>(timing.actualPresentTime - frameStart) / 1.0e6;
+			framePacing.latency = (framePacing.latency > 0.0) ? framePacing.latency * 0.9 + latency * 0.1 : latency;
+			if (benchmark.active) {
+				framePacing.latencySum += latency;
+				framePacing.latencySamples++;
+			}
+		}
+		minPresentMargin = std::min(minPresentMargin, timing.presentMargin);
+		if (timing.presentID > framePacing.lastPresentId) {
+			framePacing.lastPresentId = timing.presentID;
+			framePacing.lastPresentTime = timing.actualPresentTime;
+		}
+	}
+	// Move the delay halfway towards the point where frames are ready just the safety margin ahead of when they are needed, and back off quickly if they are late
+	// Never delay by more than a refresh cycle, as that would only lower the frame rate
+	if (!framePacing.active) {
+		framePacing.delay = 0;
+	} else if (minPresentMargin != UINT64_MAX) {
+		if (minPresentMargin > framePacing.safetyMargin) {
+			framePacing.delay += (minPresentMargin - framePacing.safetyMargin) / 2;
+		} else {
+			framePacing.delay /= 2;
+		}
+		if (framePacing.refreshDuration > 0) {
+			framePacing.delay = std::min(framePacing.delay, framePacing.refreshDuration);
+		}
+	}
+	// The work of a frame is its CPU time without the waits (which grow with the swap interval) or the GPU time of its top level scopes if that's longer
+	// Pick the smallest number of refresh cycles it fits into with the safety margin, and only go back to a shorter interval once it fits with room to spare so the interval doesn't flip between two values
+	if (framePacing.active && (framePacing.refreshDuration > 0)) {
+		double gpuTime = 0.0;
+		for (auto& timing : gpuProfiler.timings) {
+			if (timing.depth == 0) {
+				gpuTime += timing.ms;
+			}
+		}
+		const double cpuTime = cpuProfiler.averageTotal() - cpuProfiler.average(vks::CpuFrameProfiler::FenceWait) - cpuProfiler.average(vks::CpuFrameProfiler::Acquire) - cpuProfiler.average(vks::CpuFrameProfiler::Present);
+		const double workTime = std::max(cpuTime, gpuTime) * 1.0e6 + static_cast<double>(framePacing.safetyMargin);
+		const double refreshDuration = static_cast<double>(framePacing.refreshDuration);
+		uint32_t swapInterval = std::min(std::max(static_cast<uint32_t>(std::ceil(workTime / refreshDuration)), 1u), framePacing.maxSwapInterval);
+		if ((swapInterval < framePacing.swapInterval) && (workTime > static_cast<double>(swapInterval) * refreshDuration * 0.8)) {
+			swapInterval = framePacing.swapInterval;
+		}
+		framePacing.swapInterval = swapInterval;
+	} else {
+		framePacing.swapInterval = 0;
+	}
+	// Hold the present back until its slot counted from the latest displayed present, so frames aren't shown early when they happen to be fast
+	// Half a refresh cycle is subtracted, as presents are displayed at the first refresh at or after their desired time
+	swapChain.desiredPresentTime = 0;
+	if ((framePacing.swapInterval > 1) && (framePacing.lastPresentTime > 0)) {
+		const uint64_t presentsSinceLast = static_cast<uint64_t>(swapChain.presentId + 1 - framePacing.lastPresentId);
+		swapChain.desiredPresentTime = framePacing.lastPresentTime + presentsSinceLast * framePacing.swapInterval * framePacing.refreshDuration - framePacing.refreshDuration / 2;
+	}
+	if (framePacing.delay > 0) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(framePacing.delay));
+	}
+	// Input is sampled from here on
+	framePacing.frameStart = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 void VulkanExampleBase::prepareFrame()
 {
+	// CPU phases are measured from one frame's prepareFrame to the next, so the updates done by examples before calling it are part of the previous frame
+	cpuProfiler.beginFrame();
+	vks::TraceRecorder::get().frameCompleted();
+	// Input has been polled right before the frame is rendered
+	lateLatch.inputTime = std::chrono::steady_clock::now();
+	if (!startup.prepared) {
+		// Includes everything done by the example's prepare, like loading assets and creating pipelines
+		vks::StartupProfiler::get().setPhase("prepare", vks::StartupProfiler::elapsed(startup.prepare, vks::StartupProfiler::Clock::now()));
+		startup.prepared = true;
+	}
+	// A frame ends where the next one starts, so the work done between two frames (e.g. updating the overlay) is counted as well
+	if (hitchDetector.enabled) {
+		if (!vks::HitchDetector::active()) {
+			vks::HitchDetector::start(hitchDetector.allocationBudget);
+		} else {
+			vks::HitchDetector::Ignore ignore;
+			hitchDetector.last = vks::HitchDetector::endFrame();
+			if (hitchDetector.last.overBudget) {
+				hitchDetector.flaggedFrames++;
+				std::stringstream reason;
+				reason << hitchDetector.last.allocations << " allocations (" << hitchDetector.last.bytes << " bytes), " << hitchDetector.last.vulkanCalls << " vulkan calls";
+				benchmark.addFlaggedFrame(reason.str(), hitchDetector.last.stacks);
+			}
+		}
+	}
+	if (benchmark.active) {
+		// Bookkeeping of the results isn't counted as allocations of the frame
+		vks::HitchDetector::Ignore ignore;
+		for (uint32_t i = 0; i < vks::CpuFrameProfiler::PhaseCount; i++) {
+			const vks::CpuFrameProfiler::Phase phase = static_cast<vks::CpuFrameProfiler::Phase>(i);
+			benchmark.addCpuTime(std::string("Frame ") + vks::CpuFrameProfiler::phaseName(phase), cpuProfiler.last(phase));
+		}
+		for (uint32_t i = 0; i < static_cast<uint32_t>(vks::MemoryCategory::Count); i++) {
+			const vks::MemoryCategory category = static_cast<vks::MemoryCategory>(i);
+			benchmark.addMemoryUsage(vks::MemoryReport::categoryName(category), static_cast<double>(vulkanDevice->memoryAllocator.report.getUsage(category)));
+		}
+	}
+	// Done first, so the fence waits of this frame are part of the measured latency
+	if (framePacing.enabled) {
+		updateFramePacing();
+	}
+	// A present of the submission thread found the swap chain to be out of date
+	if (submitThread.enabled && submitThread.submitter.presentOutOfDate()) {
+		windowResize();
+	}
+	// Done before any fence of this frame is reset, as a scale change may need to wait for all frames in flight
+	updateDynamicResolution();
+	// Wait until the GPU has finished the work that was last submitted for this frame in flight, so its semaphores can be reused
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+	cpuProfiler.lap(vks::CpuFrameProfiler::FenceWait);
+	semaphores = frameSemaphores[currentFrame];
+	// All frames up to the one last submitted for this frame in flight have finished, so resources retired before it was submitted can be destroyed
+	vulkanDevice->deletionQueue.collect(frameSerials[currentFrame]);
+	// The submission thread may still be submitting or presenting earlier frames
+	std::unique_lock<std::mutex> queueLock = lockQueue();
+	// Copies are submitted ahead of this frame's command buffers, which already use the moved resources
+	if (defragmentation.enabled) {
+		vulkanDevice->defragment(queue, defragmentation.budget);
+	}
+	// The GPU is done reading this frame's uniform data
+	if (uniformRing.isReady()) {
+		uniformRing.beginFrame(currentFrame);
+	}
+	// Transient data of this frame's last recording is no longer referenced
+	if (frameArena.isReady()) {
+		frameArena.beginFrame(currentFrame);
+	}
+	// Dynamic secondaries recorded for this frame's last submission are no longer in use
+	if (secondaryCommandBuffers.isReady()) {
+		secondaryCommandBuffers.beginFrame(currentFrame);
+	}
+	// Descriptor sets allocated while recording this frame's last submission are no longer in use
+	if (frameDescriptors.isReady()) {
+		frameDescriptors.beginFrame(currentFrame);
+	}
+	// The copies recorded by this frame's last submission have finished, so they can be written to disk
+	if (frameCapture.isReady()) {
+		frameCapture.beginFrame(currentFrame);
+	}
+	// Hand asynchronous uploads that have finished on the transfer queue over to the graphics queue before this frame is submitted
+	vulkanDevice->updateAsyncUploads();
+	cpuProfiler.lap(vks::CpuFrameProfiler::Update);
+	if (!submitThread.enabled) {
+		// Everything the example submits for this frame up to the present is labeled as one region of the queue
+		vks::debugutils::queueBeginLabel(queue, "Frame");
+	}
+	// The acquire of a swap chain doesn't use the queue and may wait for a present of the submission thread, so the lock is only kept for the submission of a headless one
+	if (!settings.headless) {
+		queueLock = std::unique_lock<std::mutex>();
+	}
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	queueLock = std::unique_lock<std::mutex>();
+	cpuProfiler.lap(vks::CpuFrameProfiler::Acquire);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -666,11 +1702,115 @@ void VulkanExampleBase::prepareFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	// The command buffers are pre-recorded per swap chain image, so if a previous frame in flight is still using this image (and its command buffer) we need to wait for it
+	// Dynamic command buffers belong to the frame in flight instead, which has already been waited on
+	if (!dynamicCommandBuffers && (currentBuffer < imagesInFlight.size())) {
+		if ((imagesInFlight[currentBuffer] != VK_NULL_HANDLE) && (imagesInFlight[currentBuffer] != waitFences[currentFrame])) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imagesInFlight[currentBuffer], VK_TRUE, UINT64_MAX));
+			cpuProfiler.lap(vks::CpuFrameProfiler::FenceWait);
+		}
+		imagesInFlight[currentBuffer] = waitFences[currentFrame];
+	}
+	VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentFrame]));
+	frameInProgress = true;
+	// The last submission of this image's (or frame's) command buffer has finished, so its timestamps can be read without waiting
+	const VkCommandBuffer frameCommandBuffer = dynamicCommandBuffers ? frameCmdBuffers[currentFrame] : drawCmdBuffers[currentBuffer];
+	if (adaptiveShadingRate.enabled) {
+		adaptiveShadingRate.generator.collect(frameCommandBuffer);
+	}
+	if (gpuProfiler.collect(frameCommandBuffer)) {
+		vks::HitchDetector::Ignore ignore;
+		std::array<uint64_t, vks::GpuProfiler::PipelineStatisticCount> frameStatistics{};
+		bool hasStatistics = false;
+		for (auto& timing : gpuProfiler.timings) {
+			if (benchmark.active) {
+				benchmark.addScopeTime(timing.name, timing.ms);
+			}
+			if (benchmark.active && timing.hasStatistics) {
+				for (uint32_t i = 0; i < vks::GpuProfiler::PipelineStatisticCount; i++) {
+					const vks::GpuProfiler::PipelineStatistic statistic = static_cast<vks::GpuProfiler::PipelineStatistic>(i);
+					benchmark.addPipelineStatistic(timing.name, vks::GpuProfiler::pipelineStatisticName(statistic), static_cast<double>(timing.statistics[i]));
+					frameStatistics[i] += timing.statistics[i];
+				}
+				hasStatistics = true;
+			}
+			if (dynamicResolution.enabled && (timing.name == "Dynamic resolution scene")) {
+				dynamicResolution.gpuTime = timing.ms;
+			}
+		}
+		// Top level scopes don't overlap, so their sum is the work of the profiled part of the frame
+		if (hasStatistics) {
+			for (uint32_t i = 0; i < vks::GpuProfiler::PipelineStatisticCount; i++) {
+				benchmark.addPipelineStatistic("Frame", vks::GpuProfiler::pipelineStatisticName(static_cast<vks::GpuProfiler::PipelineStatistic>(i)), static_cast<double>(frameStatistics[i]));
+			}
+		}
+	}
+	if (metricsExport.exporter.running()) {
+		updateMetricsExport();
+	}
+	cpuProfiler.lap(vks::CpuFrameProfiler::Update);
 }
 
 void VulkanExampleBase::submitFrame()
 {
+	// Everything between prepareFrame and submitFrame is counted as recording (and submission) of the example's command buffers
+	cpuProfiler.lap(vks::CpuFrameProfiler::Record);
+	frameInProgress = false;
+	if (submitThread.enabled) {
+		// Hand the frame over, the submission thread signals the fence (and the frame clock) and presents the image while the next frame is being recorded
+		vks::FrameSubmitter::Frame frame;
+		frame.commandBuffer = submitThread.commandBuffer;
+		frame.waitSemaphore = semaphores.presentComplete;
+		frame.waitStageMask = submitPipelineStages;
+		frame.signalSemaphore = semaphores.renderComplete;
+		frame.fence = waitFences[currentFrame];
+		if (frameTimeline.valid()) {
+			frame.timelineSemaphore = frameTimeline.semaphore;
+			frame.timelineValue = frameTimeline.next();
+		}
+		frame.imageIndex = currentBuffer;
+		submitThread.submitter.push(frame);
+		submitThread.commandBuffer = VK_NULL_HANDLE;
+		frameSerials[currentFrame] = vulkanDevice->deletionQueue.frameSubmitted();
+		gpuProfiler.frameSubmitted(frameCmdBuffers[currentFrame]);
+		adaptiveShadingRate.generator.frameSubmitted(frameCmdBuffers[currentFrame]);
+		currentFrame = (currentFrame + 1) % maxFramesInFlight;
+		cpuProfiler.lap(vks::CpuFrameProfiler::Submit);
+		cpuProfiler.lap(vks::CpuFrameProfiler::Present);
+		if (!startup.firstFramePresented) {
+			vks::StartupProfiler::get().setPhase("firstframe", vks::StartupProfiler::elapsed(startup.start, vks::StartupProfiler::Clock::now()));
+			startup.firstFramePresented = true;
+		}
+		return;
+	}
+	// Signal the fence of the current frame in flight once all work submitted to the queue up to this point has finished
+	// This is done with an empty submission so examples can keep submitting their command buffers without having to pass a fence
+	if (frameTimeline.valid()) {
+		// Advance the frame clock with the same submission
+		vks::TimelineSubmit timelineSubmit;
+		timelineSubmit.signal(frameTimeline.semaphore, frameTimeline.next());
+		VkSubmitInfo frameSubmitInfo = vks::initializers::submitInfo();
+		timelineSubmit.apply(frameSubmitInfo);
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &frameSubmitInfo, waitFences[currentFrame]));
+	} else {
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, waitFences[currentFrame]));
+	}
+	frameSerials[currentFrame] = vulkanDevice->deletionQueue.frameSubmitted();
+	gpuProfiler.frameSubmitted(dynamicCommandBuffers ? frameCmdBuffers[currentFrame] : drawCmdBuffers[currentBuffer]);
+	adaptiveShadingRate.generator.frameSubmitted(dynamicCommandBuffers ? frameCmdBuffers[currentFrame] : drawCmdBuffers[currentBuffer]);
+	currentFrame = (currentFrame + 1) % maxFramesInFlight;
+	cpuProfiler.lap(vks::CpuFrameProfiler::Submit);
+
 	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	vks::debugutils::queueEndLabel(queue);
+	cpuProfiler.lap(vks::CpuFrameProfiler::Present);
+	if (!startup.firstFramePresented) {
+		vks::StartupProfiler::get().setPhase("firstframe", vks::StartupProfiler::elapsed(startup.start, vks::StartupProfiler::Clock::now()));
+		startup.firstFramePresented = true;
+	}
+	if (framePacing.enabled) {
+		framePacing.presentFrameStarts[swapChain.presentId % framePacing.presentFrameStarts.size()] = framePacing.frameStart;
+	}
 	if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			// Swap chain is no longer compatible with the surface and needs to be recreated
@@ -680,11 +1820,122 @@ void VulkanExampleBase::submitFrame()
 			VK_CHECK_RESULT(result);
 		}
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+}
+
+uint32_t VulkanExampleBase::latchCamera()
+{
+	LateLatch::CameraBlock* block;
+	const uint32_t offset = uniformRing.allocate(sizeof(LateLatch::CameraBlock), reinterpret_cast<void**>(&block));
+	block->projection = camera.matrices.perspective;
+	block->view = camera.matrices.view;
+	block->viewPos = camera.viewPos;
+	if (lateLatch.enabled) {
+		lateLatch.blocks.push_back(block);
+	}
+	return offset;
+}
+
+void VulkanExampleBase::advanceCamera()
+{
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	camera.update(std::chrono::duration<float>(now - lateLatch.cameraTime).count());
+	lateLatch.cameraTime = now;
+}
+
+// Handle the input events that arrived since the frame's events were polled, other window events (like resizes) are left for the next frame as they may recreate resources used by the frame
+void VulkanExampleBase::pollLateInput()
+{
+#if defined(_WIN32)
+	MSG msg;
+	while (PeekMessage(&msg, window, WM_KEYFIRST, WM_KEYLAST, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+	while (PeekMessage(&msg, window, WM_MOUSEFIRST, WM_MOUSELAST, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+	if (settings.headless) {
+		return;
+	}
+	xcb_generic_event_t* event;
+	while ((event = xcb_poll_for_event(connection))) {
+		switch (event->response_type & 0x7f) {
+		case XCB_MOTION_NOTIFY:
+		case XCB_BUTTON_PRESS:
+		case XCB_BUTTON_RELEASE:
+		case XCB_KEY_PRESS:
+		case XCB_KEY_RELEASE:
+			handleEvent(event);
+			free(event);
+			break;
+		default:
+			lateLatch.deferredEvents.push_back(event);
+		}
+	}
+#endif
+}
+
+// Rewrite the camera blocks of the frame with the latest input, called right before the frame is submitted
+void VulkanExampleBase::updateLateLatch()
+{
+	pollLateInput();
+	// A replayed camera path is sampled with the frame time
+	if (!replay.replaying && (replay.fixedTimestep <= 0.0f)) {
+		advanceCamera();
+	}
+	for (auto block : lateLatch.blocks) {
+		block->projection = camera.matrices.perspective;
+		block->view = camera.matrices.view;
+		block->viewPos = camera.viewPos;
+	}
+	lateLatch.blocks.clear();
+	lateLatch.inputTime = std::chrono::steady_clock::now();
+	// Present latencies are measured from the latched input
+	if (framePacing.enabled) {
+		framePacing.frameStart = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(lateLatch.inputTime.time_since_epoch()).count());
+	}
+}
+
+void VulkanExampleBase::retireResource(std::function<void()> destroy)
+{
+	// Any frame using the resource has been submitted before or is being recorded, so it's done once that frame's serial has been reached
+	vulkanDevice->deletionQueue.push(destroy);
+}
+
+std::unique_lock<std::mutex> VulkanExampleBase::lockQueue()
+{
+	if (!submitThread.enabled) {
+		return std::unique_lock<std::mutex>();
+	}
+	return std::unique_lock<std::mutex>(submitThread.submitter.queueMutex);
+}
+
+void VulkanExampleBase::waitForFramesInFlight()
+{
+	if (waitFences.empty()) {
+		return;
+	}
+	// The fence of the frame being recorded has been reset but not yet submitted, prepareFrame has already waited for the frame last submitted with it
+	if (frameInProgress) {
+		if (currentFrame > 0) {
+			VK_CHECK_RESULT(vkWaitForFences(device, currentFrame, waitFences.data(), VK_TRUE, UINT64_MAX));
+		}
+		if (currentFrame + 1 < waitFences.size()) {
+			VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(waitFences.size()) - currentFrame - 1, &waitFences[currentFrame + 1], VK_TRUE, UINT64_MAX));
+		}
+	} else {
+		VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(waitFences.size()), waitFences.data(), VK_TRUE, UINT64_MAX));
+	}
+	if (!frameSerials.empty()) {
+		vulkanDevice->deletionQueue.collect(*std::max_element(frameSerials.begin(), frameSerials.end()));
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 {
+	startup.start = vks::StartupProfiler::Clock::now();
 #if !defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Check for a valid asset path
 	struct stat info;
@@ -718,6 +1969,42 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("vsync")) {
 		settings.vsync = true;
 	}
+	if (commandLineParser.isSet("presentmode")) {
+		std::string value = commandLineParser.getValueAsString("presentmode", "fifo");
+		const std::unordered_map<std::string, VkPresentModeKHR> presentModes = {
+			{ "fifo", VK_PRESENT_MODE_FIFO_KHR },
+			{ "fiforelaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+			{ "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+			{ "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR }
+		};
+		if (presentModes.find(value) == presentModes.end()) {
+			std::cerr << "Present mode must be one of 'fifo', 'fiforelaxed', 'mailbox' or 'immediate'\n";
+		}
+		else {
+			swapChain.requestedPresentMode = presentModes.at(value);
+		}
+	}
+	if (commandLineParser.isSet("swapchainimages")) {
+		swapChain.requestedImageCount = commandLineParser.getValueAsInt("swapchainimages", 0);
+	}
+	if (commandLineParser.isSet("framepacing")) {
+		framePacing.requested = true;
+	}
+	if (commandLineParser.isSet("sustainedperformance")) {
+		settings.sustainedPerformance = true;
+	}
+	if (commandLineParser.isSet("overlaylayer")) {
+		settings.overlayLayer = true;
+	}
+	if (commandLineParser.isSet("headless")) {
+		// Without a window there's no input, so headless rendering always runs the benchmark loop
+		settings.headless = true;
+		benchmark.active = true;
+		vks::tools::errorModeSilent = true;
+	}
+	if (commandLineParser.isSet("readback")) {
+		swapChain.readbackInterval = commandLineParser.getValueAsInt("readback", 0);
+	}
 	if (commandLineParser.isSet("height")) {
 		height = commandLineParser.getValueAsInt("height", width);
 	}
@@ -752,17 +2039,115 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkresultframes")) {
 		benchmark.outputFrameTimes = true;
 	}
+	if (commandLineParser.isSet("benchmarkstutter")) {
+		benchmark.stutterThreshold = commandLineParser.getValueAsFloat("benchmarkstutter", 0.0f);
+	}
+	// Benchmark runs advance animations by a fixed timestep, so all devices render the same frames
+	if (benchmark.active || commandLineParser.isSet("fixedtimestep")) {
+		const int32_t fixedRate = commandLineParser.getValueAsInt("fixedtimestep", 60);
+		if (fixedRate > 0) {
+			replay.fixedTimestep = 1.0f / static_cast<float>(fixedRate);
+		}
+	}
+	if (commandLineParser.isSet("hitchdetector")) {
+		hitchDetector.enabled = true;
+		hitchDetector.allocationBudget = static_cast<uint64_t>(std::max(commandLineParser.getValueAsInt("hitchdetector", 0), 0));
+		benchmark.hitchDetection = true;
+	}
+	if (commandLineParser.isSet("metricsexporter")) {
+		const int32_t port = commandLineParser.getValueAsInt("metricsexporter", 9464);
+		if ((port > 0) && (port <= 65535)) {
+			metricsExport.port = static_cast<uint16_t>(port);
+		}
+	}
+	if (commandLineParser.isSet("defragment")) {
+		defragmentation.enabled = true;
+		const int32_t budget = commandLineParser.getValueAsInt("defragment", 4);
+		if (budget > 0) {
+			defragmentation.budget = static_cast<VkDeviceSize>(budget) * 1024 * 1024;
+		}
+	}
+	if (commandLineParser.isSet("camerapath")) {
+		const std::string cameraPathFile = commandLineParser.getValueAsString("camerapath", "");
+		replay.replaying = replay.cameraPath.load(cameraPathFile);
+		if (!replay.replaying) {
+			std::cerr << "Could not load camera path \"" << cameraPathFile << "\"\n";
+		}
+	}
+	if (commandLineParser.isSet("recordcamerapath") && !replay.replaying) {
+		replay.recordFile = commandLineParser.getValueAsString("recordcamerapath", "camerapath.txt");
+		replay.recording = true;
+	}
+	if (commandLineParser.isSet("pipelinecache")) {
+		pipelineCacheDir = commandLineParser.getValueAsString("pipelinecache", "");
+	}
+	if (commandLineParser.isSet("pipelinemanifest")) {
+		if (pipelineCacheDir.empty()) {
+			std::cerr << "The pipeline manifest requires a pipeline cache directory (--pipelinecache)\n";
+		} else {
+			// Needs to be active before the first shader modules, layouts and render passes are created, so it can describe them
+			pipelineManifest = true;
+			vks::PipelineManifest::get().setActive(true);
+		}
+	}
+	if (commandLineParser.isSet("pinthreads")) {
+		// The main thread records and submits the frames, so it gets the fastest core to itself and worker threads are pinned to the others
+		vks::CpuTopology& cpuTopology = vks::CpuTopology::get();
+		cpuTopology.pinThreads = true;
+		if (!vks::CpuTopology::pinCurrentThread(cpuTopology.mainCore().id)) {
+			std::cerr << "Could not pin the main thread to core " << cpuTopology.mainCore().id << "\n";
+		}
+	}
+	if (commandLineParser.isSet("trace")) {
+		const uint32_t maxFrames = static_cast<uint32_t>(commandLineParser.getValueAsInt("traceframes", 0));
+		const double maxDuration = static_cast<double>(commandLineParser.getValueAsInt("traceduration", 0));
+		vks::TraceRecorder::get().start(commandLineParser.getValueAsString("trace", "trace.json"), maxFrames, maxDuration);
+	}
+	if (commandLineParser.isSet("gltfcache")) {
+		vkglTF::cacheFlags |= vkglTF::CacheFlags::CacheScene;
+	}
+	if (commandLineParser.isSet("gltfcachemips")) {
+		vkglTF::cacheFlags |= vkglTF::CacheFlags::CacheScene | vkglTF::CacheFlags::CacheMipmaps;
+	}
+	if (commandLineParser.isSet("depthprepass")) {
+		depthPrepass.requested = true;
+	}
+	if (commandLineParser.isSet("dynamicrendering")) {
+		dynamicRendering.requested = true;
+	}
+	if (commandLineParser.isSet("adaptiveshadingrate")) {
+		adaptiveShadingRate.requested = true;
+	}
+	if (commandLineParser.isSet("pipelinestatistics")) {
+		pipelineStatistics.requested = true;
+	}
+	if (commandLineParser.isSet("submitthread")) {
+		submitThread.requested = true;
+	}
+	if (commandLineParser.isSet("latelatch")) {
+		lateLatch.requested = true;
+	}
+	if (commandLineParser.isSet("dynamicresolution")) {
+		dynamicResolution.requested = true;
+		dynamicResolution.targetTime = static_cast<float>(commandLineParser.getValueAsInt("dynamicresolution", 16));
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
 	bool libLoaded = vks::android::loadVulkanLibrary();
 	assert(libLoaded);
+	// Avoids the compositor rotating every frame when the device isn't held in its native orientation
+	swapChain.preRotate = true;
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.headless) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.headless) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -777,13 +2162,24 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (replay.recording) {
+		if (!replay.cameraPath.save(replay.recordFile)) {
+			std::cerr << "Could not save camera path to \"" << replay.recordFile << "\"\n";
+		}
+	}
+	// The submission thread must not use the queue or the swap chain anymore
+	submitThread.submitter.stop();
+	metricsExport.exporter.stop();
 	// Clean up Vulkan resources
+	vulkanDevice->deletionQueue.flush();
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 	destroyCommandBuffers();
+	adaptiveShadingRate.generator.destroy();
+	dynamicResolution.scaler.destroy();
 	vkDestroyRenderPass(device, renderPass, nullptr);
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
 	{
@@ -796,14 +2192,35 @@ VulkanExampleBase::~VulkanExampleBase()
 	}
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
+	vulkanDevice->memoryAllocator.report.untrack(depthStencil.mem);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	pipelineCompiler.wait();
+	savePipelineCache();
+	if (pipelineManifest) {
+		vks::PipelineManifest::get().save(getPipelineManifestFileName());
+	}
+	vks::PipelineManifest::get().destroy();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
+	// Write the trace if it hasn't reached its limit
+	vks::TraceRecorder::get().stop();
+	gpuProfiler.destroy();
+	uniformRing.destroy();
+	frameCapture.destroy();
+	frameDescriptors.destroy();
+
+	secondaryCommandBuffers.destroy();
+	for (auto& frameCmdPool : frameCmdPools) {
+		vkDestroyCommandPool(device, frameCmdPool, nullptr);
+	}
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
+	frameTimeline.destroy();
+	for (auto& frameSemaphore : frameSemaphores) {
+		vkDestroySemaphore(device, frameSemaphore.presentComplete, nullptr);
+		vkDestroySemaphore(device, frameSemaphore.renderComplete, nullptr);
+	}
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
@@ -835,24 +2252,31 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.headless) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	for (auto deferredEvent : lateLatch.deferredEvents) {
+		free(deferredEvent);
+	}
+	if (!settings.headless) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
@@ -860,12 +2284,17 @@ bool VulkanExampleBase::initVulkan()
 {
 	VkResult err;
 
+	vks::StartupProfiler& startupProfiler = vks::StartupProfiler::get();
+	vks::StartupProfiler::Clock::time_point stageStart = vks::StartupProfiler::Clock::now();
+
 	// Vulkan instance
 	err = createInstance(settings.validation);
 	if (err) {
 		vks::tools::exitFatal("Could not create Vulkan instance : \n" + vks::tools::errorString(err), err);
 		return false;
 	}
+	startupProfiler.setPhase("instance", vks::StartupProfiler::elapsed(stageStart, vks::StartupProfiler::Clock::now()));
+	stageStart = vks::StartupProfiler::Clock::now();
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	vks::android::loadVulkanFunctions(instance);
@@ -939,33 +2368,280 @@ bool VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	vulkanDevice->directUpload.enabled = !commandLineParser.isSet("nodirectupload");
+	void* pNextChain = deviceCreatepNextChain;
+	bool timelineSemaphoresSupported = false;
+	if (enableTimelineSemaphores) {
+		// The timelineSemaphore feature is required to be supported by all devices exposing the extension
+		timelineSemaphoresSupported = vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) &&
+			(std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end());
+		if (timelineSemaphoresSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			timelineSemaphoreFeatures.pNext = deviceCreatepNextChain;
+			pNextChain = &timelineSemaphoreFeatures;
+		}
+	}
+	if (enableRayQueries) {
+		const std::vector<const char*> rayQueryExtensions = {
+			VK_KHR_RAY_QUERY_EXTENSION_NAME,
+			VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+			// Required by VK_KHR_acceleration_structure
+			VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+			VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+			VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+			// Required by VK_KHR_ray_query
+			VK_KHR_SPIRV_1_4_EXTENSION_NAME,
+			// Required by VK_KHR_spirv_1_4
+			VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME
+		};
+		rayQueriesSupported = (deviceProperties.apiVersion >= VK_API_VERSION_1_1);
+		for (const char* extension : rayQueryExtensions) {
+			rayQueriesSupported &= vulkanDevice->extensionSupported(extension);
+		}
+		if (rayQueriesSupported) {
+			// Unlike the timeline semaphore feature, the extensions don't guarantee support for the features, so these need to be checked
+			rayQueryBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
+			rayQueryAccelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+			rayQueryAccelerationStructureFeatures.pNext = &rayQueryBufferDeviceAddressFeatures;
+			rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+			rayQueryFeatures.pNext = &rayQueryAccelerationStructureFeatures;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &rayQueryFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			rayQueriesSupported = rayQueryFeatures.rayQuery && rayQueryAccelerationStructureFeatures.accelerationStructure && rayQueryBufferDeviceAddressFeatures.bufferDeviceAddress;
+		}
+		if (rayQueriesSupported) {
+			enabledDeviceExtensions.insert(enabledDeviceExtensions.end(), rayQueryExtensions.begin(), rayQueryExtensions.end());
+			// Only enable what's required instead of everything reported as supported
+			rayQueryBufferDeviceAddressFeatures = {};
+			rayQueryBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
+			rayQueryBufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+			rayQueryBufferDeviceAddressFeatures.pNext = pNextChain;
+			rayQueryAccelerationStructureFeatures = {};
+			rayQueryAccelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+			rayQueryAccelerationStructureFeatures.accelerationStructure = VK_TRUE;
+			rayQueryAccelerationStructureFeatures.pNext = &rayQueryBufferDeviceAddressFeatures;
+			rayQueryFeatures = {};
+			rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+			rayQueryFeatures.rayQuery = VK_TRUE;
+			rayQueryFeatures.pNext = &rayQueryAccelerationStructureFeatures;
+			pNextChain = &rayQueryFeatures;
+		} else {
+			std::cout << "Ray queries are not supported by the selected device\n";
+		}
+	}
+	if (adaptiveShadingRate.supported && adaptiveShadingRate.requested) {
+		// The shading rate image is written by a compute shader as an r8ui storage image
+		bool shadingRateImageSupported = (deviceProperties.apiVersion >= VK_API_VERSION_1_1) && vulkanDevice->extensionSupported(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME) && deviceFeatures.shaderStorageImageExtendedFormats;
+		if (shadingRateImageSupported) {
+			shadingRateImageFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &shadingRateImageFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			shadingRateImageSupported = shadingRateImageFeatures.shadingRateImage;
+		}
+		if (shadingRateImageSupported) {
+			enabledDeviceExtensions.push_back(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME);
+			enabledFeatures.shaderStorageImageExtendedFormats = VK_TRUE;
+			// Optional, only used for counting the fragment shader invocations
+			enabledFeatures.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
+			shadingRateImageFeatures = {};
+			shadingRateImageFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
+			shadingRateImageFeatures.shadingRateImage = VK_TRUE;
+			shadingRateImageFeatures.pNext = pNextChain;
+			pNextChain = &shadingRateImageFeatures;
+			adaptiveShadingRate.enabled = true;
+		} else {
+			std::cout << "Adaptive shading rate is not supported by the selected device\n";
+		}
+	}
+	if (pipelineStatistics.requested) {
+		// Pipeline statistics queries can't be nested, and the adaptive shading rate counts the fragment shader invocations of the scene itself
+		if (adaptiveShadingRate.enabled) {
+			std::cout << "Pipeline statistics of the profiler scopes can't be counted with the adaptive shading rate enabled\n";
+		} else if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+			pipelineStatistics.enabled = true;
+		} else {
+			std::cout << "Pipeline statistics queries are not supported by the selected device\n";
+		}
+	}
+	if (enableExtendedDynamicState) {
+		if ((deviceProperties.apiVersion >= VK_API_VERSION_1_1) && vulkanDevice->extensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+			const bool extension2Supported = vulkanDevice->extensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+			extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+			extendedDynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+			extendedDynamicStateFeatures.pNext = extension2Supported ? &extendedDynamicState2Features : nullptr;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &extendedDynamicStateFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			extendedDynamicState.supported = extendedDynamicStateFeatures.extendedDynamicState;
+			extendedDynamicState.supported2 = extendedDynamicState.supported && extension2Supported && extendedDynamicState2Features.extendedDynamicState2;
+		}
+		if (extendedDynamicState.supported) {
+			enabledDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+			extendedDynamicStateFeatures = {};
+			extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+			extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+			extendedDynamicStateFeatures.pNext = pNextChain;
+			pNextChain = &extendedDynamicStateFeatures;
+			// Only the base feature of the second extension is used, logic op and patch control points are left disabled
+			if (extendedDynamicState.supported2) {
+				enabledDeviceExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+				extendedDynamicState2Features = {};
+				extendedDynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+				extendedDynamicState2Features.extendedDynamicState2 = VK_TRUE;
+				extendedDynamicState2Features.pNext = pNextChain;
+				pNextChain = &extendedDynamicState2Features;
+			}
+		} else {
+			std::cout << "Extended dynamic state is not supported by the selected device\n";
+		}
+	}
+	if (dynamicRendering.supported && dynamicRendering.requested) {
+		bool dynamicRenderingSupported = (deviceProperties.apiVersion >= VK_API_VERSION_1_1) && vulkanDevice->extensionSupported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		if (dynamicRenderingSupported) {
+			dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &dynamicRenderingFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			dynamicRenderingSupported = dynamicRenderingFeatures.dynamicRendering;
+		}
+		if (dynamicRenderingSupported) {
+			// The extension depends on VK_KHR_depth_stencil_resolve, which has been promoted to Vulkan 1.2 along with VK_KHR_create_renderpass2
+			if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+				enabledDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+				enabledDeviceExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+			}
+			enabledDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+			dynamicRenderingFeatures = {};
+			dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+			dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+			dynamicRenderingFeatures.pNext = pNextChain;
+			pNextChain = &dynamicRenderingFeatures;
+			dynamicRendering.enabled = true;
+		} else {
+			std::cout << "Dynamic rendering is not supported by the selected device\n";
+		}
+	}
+	if (enableCompressedHDRTextures) {
+		// BC6H is part of the BC feature (desktop), ASTC HDR needs an extension on top of the LDR formats (mobile)
+		enabledFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC;
+		bool astcHDRSupported = (deviceProperties.apiVersion >= VK_API_VERSION_1_1) && vulkanDevice->extensionSupported(VK_EXT_TEXTURE_COMPRESSION_ASTC_HDR_EXTENSION_NAME);
+		if (astcHDRSupported) {
+			textureCompressionASTCHDRFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TEXTURE_COMPRESSION_ASTC_HDR_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &textureCompressionASTCHDRFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			astcHDRSupported = textureCompressionASTCHDRFeatures.textureCompressionASTC_HDR;
+		}
+		if (astcHDRSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_TEXTURE_COMPRESSION_ASTC_HDR_EXTENSION_NAME);
+			textureCompressionASTCHDRFeatures = {};
+			textureCompressionASTCHDRFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TEXTURE_COMPRESSION_ASTC_HDR_FEATURES_EXT;
+			textureCompressionASTCHDRFeatures.textureCompressionASTC_HDR = VK_TRUE;
+			textureCompressionASTCHDRFeatures.pNext = pNextChain;
+			pNextChain = &textureCompressionASTCHDRFeatures;
+			vulkanDevice->textureCompressionASTCHDRSupported = true;
+		}
+	}
+	if (settings.headless && !vulkanDevice->extensionSupported(VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+		// The offscreen images are handed to the examples in the present layout, which is part of VK_KHR_swapchain
+		vks::tools::exitFatal("Headless rendering requires a device supporting VK_KHR_swapchain", -1);
+		return false;
+	}
+	if (framePacing.requested && !settings.headless) {
+		if (vulkanDevice->extensionSupported(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+			framePacing.enabled = true;
+		} else {
+			std::cout << "Present timing (VK_GOOGLE_display_timing) is not supported by the selected device\n";
+		}
+	}
+	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+		vulkanDevice->getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		// Render targets are allocated with a high priority (see vks::VulkanDevice::allocateRenderTargetMemory), so the driver moves other resources (e.g. streamed textures) out of device local memory first when it's oversubscribed
+		PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		if (getPhysicalDeviceFeatures2 && vulkanDevice->extensionSupported(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME)) {
+			memoryPriorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &memoryPriorityFeatures;
+			getPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			if (memoryPriorityFeatures.memoryPriority) {
+				enabledDeviceExtensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+				memoryPriorityFeatures = {};
+				memoryPriorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+				memoryPriorityFeatures.memoryPriority = VK_TRUE;
+				memoryPriorityFeatures.pNext = pNextChain;
+				pNextChain = &memoryPriorityFeatures;
+				vulkanDevice->memoryPrioritySupported = true;
+			}
+		}
+	}
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, pNextChain);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+	startupProfiler.pipelineFeedbackSupported = vulkanDevice->pipelineCreationFeedbackSupported;
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
 
+	if (extendedDynamicState.supported) {
+		extendedDynamicState.vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
+		extendedDynamicState.vkCmdSetFrontFaceEXT = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
+		extendedDynamicState.vkCmdSetPrimitiveTopologyEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
+		extendedDynamicState.vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
+		extendedDynamicState.vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
+		extendedDynamicState.vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
+		extendedDynamicState.vkCmdSetStencilTestEnableEXT = reinterpret_cast<PFN_vkCmdSetStencilTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetStencilTestEnableEXT"));
+		extendedDynamicState.vkCmdSetStencilOpEXT = reinterpret_cast<PFN_vkCmdSetStencilOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetStencilOpEXT"));
+	}
+	if (extendedDynamicState.supported2) {
+		extendedDynamicState.vkCmdSetDepthBiasEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthBiasEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthBiasEnableEXT"));
+		extendedDynamicState.vkCmdSetRasterizerDiscardEnableEXT = reinterpret_cast<PFN_vkCmdSetRasterizerDiscardEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetRasterizerDiscardEnableEXT"));
+		extendedDynamicState.vkCmdSetPrimitiveRestartEnableEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT"));
+	}
+
 	// Find a suitable depth format
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
 	assert(validDepthFormat);
 
 	swapChain.connect(instance, physicalDevice, device);
+	swapChain.presentTiming = framePacing.enabled;
+	// Window resizes retire the old swap chain instead of waiting for the device to become idle
+	swapChain.deferRetirement = true;
 
 	// Create synchronization objects
+	// Each frame in flight gets its own set of semaphores, so the CPU can start on the next frame while the GPU is still working on previous ones
+	assert(maxFramesInFlight > 0);
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
+	frameSemaphores.resize(maxFramesInFlight);
+	for (auto& frameSemaphore : frameSemaphores) {
+		// Create a semaphore used to synchronize image presentation
+		// Ensures that the image is displayed before we start submitting new commands to the queue
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphore.presentComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands have been submitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphore.renderComplete));
+	}
+	semaphores = frameSemaphores[currentFrame];
+	if (timelineSemaphoresSupported) {
+		frameTimeline.create(device);
+	}
 
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// The semaphore pointers stay the same during application lifetime, the handles they point to are switched per frame in flight by prepareFrame
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
@@ -974,6 +2650,7 @@ bool VulkanExampleBase::initVulkan()
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 
+	startupProfiler.setPhase("device", vks::StartupProfiler::elapsed(stageStart, vks::StartupProfiler::Clock::now()));
 	return true;
 }
 
@@ -1412,6 +3089,9 @@ void VulkanExampleBase::handleAppCommand(android_app * app, int32_t cmd)
 			if (vulkanExample->initVulkan()) {
 				vulkanExample->prepare();
 				assert(vulkanExample->prepared);
+				if (vulkanExample->settings.sustainedPerformance && !vks::android::setSustainedPerformanceMode(true)) {
+					LOGW("Sustained performance mode is not supported by this device");
+				}
 			}
 			else {
 				LOGE("Could not initialize Vulkan, exiting!");
@@ -2441,14 +4121,41 @@ void VulkanExampleBase::mouseMoved(double x, double y, bool & handled) {}
 
 void VulkanExampleBase::buildCommandBuffers() {}
 
+bool VulkanExampleBase::setComparisonSetting(const std::string& name, bool enabled)
+{
+	if ((name == "adaptiveshadingrate") && adaptiveShadingRate.enabled) {
+		adaptiveShadingRate.active = enabled;
+		// Static secondaries bind the shading rate image themselves
+		if (secondaryCommandBuffers.isReady()) {
+			secondaryCommandBuffers.invalidateAll();
+		}
+		return true;
+	}
+	if ((name == "framepacing") && framePacing.enabled) {
+		framePacing.active = enabled;
+		return true;
+	}
+	if ((name == "latelatch") && lateLatch.supported && lateLatch.requested && dynamicCommandBuffers && (uniformRingSize > 0)) {
+		lateLatch.enabled = enabled;
+		lateLatch.cameraTime = std::chrono::steady_clock::now();
+		return true;
+	}
+	return false;
+}
+
+void VulkanExampleBase::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {}
+
 void VulkanExampleBase::createSynchronizationPrimitives()
 {
-	// Wait fences to sync command buffer access
+	// Wait fences to sync access to the per-frame resources, one per frame in flight
+	// Created in signaled state so we don't wait on the first use of each frame
 	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	waitFences.resize(drawCmdBuffers.size());
+	waitFences.resize(maxFramesInFlight);
+	frameSerials.assign(maxFramesInFlight, 0);
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+	imagesInFlight.assign(swapChain.imageCount, VK_NULL_HANDLE);
 }
 
 void VulkanExampleBase::createCommandPool()
@@ -2458,6 +4165,18 @@ void VulkanExampleBase::createCommandPool()
 	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+	if (dynamicCommandBuffers) {
+		// Command buffers recorded each frame are allocated from a transient pool per frame in flight, that is reset as a whole
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		frameCmdPools.resize(maxFramesInFlight);
+		frameCmdBuffers.resize(maxFramesInFlight);
+		for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &frameCmdPools[i]));
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(frameCmdPools[i], VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frameCmdBuffers[i]));
+		}
+		secondaryCommandBuffers.setup(device, swapChain.queueNodeIndex, maxFramesInFlight);
+	}
 }
 
 void VulkanExampleBase::setupDepthStencil()
@@ -2471,18 +4190,12 @@ void VulkanExampleBase::setupDepthStencil()
 	imageCI.arrayLayers = 1;
 	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	imageCI.usage = depthStencilUsage;
 
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
-	VkMemoryRequirements memReqs{};
-	vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
-
-	VkMemoryAllocateInfo memAllloc{};
-	memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAllloc.allocationSize = memReqs.size;
-	memAllloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAllloc, nullptr, &depthStencil.mem));
-	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
+	VkDeviceSize memorySize = 0;
+	VK_CHECK_RESULT(vulkanDevice->allocateRenderTargetMemory(depthStencil.image, &depthStencil.mem, false, &memorySize));
+	vulkanDevice->memoryAllocator.report.track(depthStencil.mem, 0, memorySize, vks::MemoryCategory::RenderTarget, "Depth stencil");
 
 	VkImageViewCreateInfo imageViewCI{};
 	imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -2503,6 +4216,12 @@ void VulkanExampleBase::setupDepthStencil()
 
 void VulkanExampleBase::setupFrameBuffer()
 {
+	// The image views are passed to each render pass instance with dynamic rendering
+	if (dynamicRendering.enabled) {
+		frameBuffers.clear();
+		return;
+	}
+
 	VkImageView attachments[2];
 
 	// Depth/Stencil attachment is the same for all frame buffers
@@ -2529,6 +4248,12 @@ void VulkanExampleBase::setupFrameBuffer()
 
 void VulkanExampleBase::setupRenderPass()
 {
+	// Pipelines are created for the attachment formats with dynamic rendering (see getScenePipelineRenderingInfo)
+	if (dynamicRendering.enabled) {
+		renderPass = VK_NULL_HANDLE;
+		return;
+	}
+
 	std::array<VkAttachmentDescription, 2> attachments = {};
 	// Color attachment
 	attachments[0].format = swapChain.colorFormat;
@@ -2568,18 +4293,29 @@ void VulkanExampleBase::setupRenderPass()
 	subpassDescription.pPreserveAttachments = nullptr;
 	subpassDescription.pResolveAttachments = nullptr;
 
+	// With the depth prepass, a depth only subpass comes before the main subpass
+	VkSubpassDescription prepassSubpassDescription = {};
+	prepassSubpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	prepassSubpassDescription.pDepthStencilAttachment = &depthReference;
+	std::vector<VkSubpassDescription> subpassDescriptions;
+	if (depthPrepass.enabled) {
+		subpassDescriptions.push_back(prepassSubpassDescription);
+	}
+	subpassDescriptions.push_back(subpassDescription);
+	const uint32_t mainSubpass = depthPrepass.mainSubpass;
+
 	// Subpass dependencies for layout transitions
-	std::array<VkSubpassDependency, 2> dependencies;
+	std::vector<VkSubpassDependency> dependencies(2);
 
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[0].dstSubpass = 0;
+	dependencies[0].dstSubpass = mainSubpass;
 	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-	dependencies[1].srcSubpass = 0;
+	dependencies[1].srcSubpass = mainSubpass;
 	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
@@ -2587,16 +4323,29 @@ void VulkanExampleBase::setupRenderPass()
 	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+	if (depthPrepass.enabled) {
+		// The main subpass depth tests against the depth written by the prepass
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = 0;
+		dependency.dstSubpass = mainSubpass;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies.push_back(dependency);
+	}
+
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 	renderPassInfo.pAttachments = attachments.data();
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+	renderPassInfo.pSubpasses = subpassDescriptions.data();
 	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 	renderPassInfo.pDependencies = dependencies.data();
 
-	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+	VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 }
 
 void VulkanExampleBase::getEnabledFeatures() {}
@@ -2610,23 +4359,48 @@ void VulkanExampleBase::windowResize()
 	prepared = false;
 	resized = true;
 
-	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(device);
+	// Presents of the submission thread must not use the old swap chain while it's replaced
+	submitThread.submitter.wait();
 
-	// Recreate swap chain
+	// Instead of waiting for the device to become idle, the resources of the base class are replaced while frames in flight may still use the old ones, which are retired
+	// Examples that recreate their own resources in use by frames in flight need to wait for these, as does the offscreen scene image, which is resized in place
+	if (resizeWaitsForFrames || sceneImageEnabled()) {
+		waitForFramesInFlight();
+	}
+
+	// Recreate swap chain, the old one is passed to the new one and retired along with its image views
 	width = destWidth;
 	height = destHeight;
 	setupSwapChain();
+	for (auto& retiredSwapChain : swapChain.retired) {
+		retireResource([this, retiredSwapChain]() { swapChain.destroyRetired(retiredSwapChain); });
+	}
+	swapChain.retired.clear();
+	// None of the new swap chain images is in use by a frame in flight yet
+	imagesInFlight.assign(swapChain.imageCount, VK_NULL_HANDLE);
 
 	// Recreate the frame buffers
-	vkDestroyImageView(device, depthStencil.view, nullptr);
-	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	const auto oldDepthStencil = depthStencil;
+	retireResource([this, oldDepthStencil]() {
+		vkDestroyImageView(device, oldDepthStencil.view, nullptr);
+		vkDestroyImage(device, oldDepthStencil.image, nullptr);
+		vulkanDevice->memoryAllocator.report.untrack(oldDepthStencil.mem);
+		vkFreeMemory(device, oldDepthStencil.mem, nullptr);
+	});
 	setupDepthStencil();
-	for (uint32_t i = 0; i < frameBuffers.size(); i++) {
-		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
-	}
+	const std::vector<VkFramebuffer> oldFrameBuffers = frameBuffers;
+	retireResource([this, oldFrameBuffers]() {
+		for (auto& frameBuffer : oldFrameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+	});
 	setupFrameBuffer();
+	if (sceneImageEnabled()) {
+		dynamicResolution.scaler.resize(width, height, depthStencil.view, queue);
+	}
+	if (adaptiveShadingRate.enabled) {
+		adaptiveShadingRate.generator.resize(width, height, dynamicResolution.scaler.getImageView());
+	}
 
 	if ((width > 0.0f) && (height > 0.0f)) {
 		if (settings.overlay) {
@@ -2634,18 +4408,33 @@ void VulkanExampleBase::windowResize()
 		}
 	}
 
-	// Command buffers need to be recreated as they may store
-	// references to the recreated frame buffer
-	destroyCommandBuffers();
-	createCommandBuffers();
-	buildCommandBuffers();
-
-	vkDeviceWaitIdle(device);
+	// Pre-recorded command buffers reference the old frame buffers and may still be pending execution, so they are retired and recorded anew instead of being re-recorded
+	// Command buffers recorded each frame pick up the new frame buffers with the next recording, they are only replaced if the number of swap chain images has changed
+	if (!dynamicCommandBuffers || (drawCmdBuffers.size() != swapChain.imageCount)) {
+		const std::vector<VkCommandBuffer> oldCmdBuffers = drawCmdBuffers;
+		retireResource([this, oldCmdBuffers]() {
+			for (auto& cmdBuffer : oldCmdBuffers) {
+				gpuProfiler.release(cmdBuffer);
+				adaptiveShadingRate.generator.release(cmdBuffer);
+			}
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(oldCmdBuffers.size()), oldCmdBuffers.data());
+		});
+		createCommandBuffers();
+	}
+	if (!dynamicCommandBuffers) {
+		buildCommandBuffers();
+	} else {
+		// Static secondaries set the viewport to the old size
+		secondaryCommandBuffers.invalidateAll();
+	}
 
 	if ((width > 0.0f) && (height > 0.0f)) {
 		camera.updateAspectRatio((float)width / (float)height);
 	}
 
+	// Examples may update or re-record resources used by the frames in flight when notified
+	waitForFramesInFlight();
+
 	// Notify derived class
 	windowResized();
 	viewChanged();
@@ -2710,6 +4499,10 @@ void VulkanExampleBase::initSwapchain()
 void VulkanExampleBase::setupSwapChain()
 {
 	swapChain.create(&width, &height, settings.vsync);
+	// Width and height are those of the swap chain images, the camera and the UI overlay rotate their output to match pre-rotated images
+	const uint32_t preRotation = swapChain.getPreRotation();
+	camera.setPreRotation(preRotation);
+	UIOverlay.preRotation = preRotation;
 }
 
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
@@ -2730,8 +4523,47 @@ CommandLineParser::CommandLineParser()
 	add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode");
 	add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
 	add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
-	add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
+	add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results (written as JSON if it ends with .json, CSV otherwise)");
 	add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
+	add("benchmarkstutter", { "-bs", "--benchstutter" }, 1, "Set frame time in ms above which frames are counted as stutter (defaults to twice the median)");
+	add("benchcompare", { "-bc", "--benchcompare" }, 1, "Compare frame times with a setting disabled and enabled in interleaved blocks of frames (e.g. adaptiveshadingrate, framepacing or example specific settings)");
+	add("benchcompareblock", { "-bcb", "--benchcompareblock" }, 1, "Set the number of frames per block of a benchmark comparison (defaults to 60)");
+	add("hitchdetector", { "-hd", "--hitchdetector" }, 1, "Count heap allocations and pipeline, memory and descriptor pool creation per frame and flag frames with more than the given number of allocations or any of these calls");
+	add("metricsexporter", { "-mex", "--metricsexporter" }, 1, "Serve per frame CPU and GPU timings, memory budgets, pipeline statistics and the present mode as Prometheus metrics on the given local port");
+	add("defragment", { "-df", "--defragment" }, 1, "Move up to the given number of MB of movable device memory allocations per frame to release sparsely used memory blocks");
+	add("fixedtimestep", { "-fts", "--fixedtimestep" }, 1, "Advance animations by 1/n seconds per frame instead of the measured frame time (benchmark mode defaults to 60, 0 uses measured times)");
+	add("camerapath", { "-cp", "--camerapath" }, 1, "Move the camera along a recorded camera path (e.g. for repeatable benchmark runs)");
+	add("recordcamerapath", { "-rcp", "--recordcamerapath" }, 1, "Record the camera path and save it to the given file on exit");
+	add("pipelinecache", { "-pc", "--pipelinecache" }, 1, "Load and save the pipeline cache from/to the given directory");
+	add("pipelinemanifest", { "-pmf", "--pipelinemanifest" }, 0, "Record the pipelines created in a session to the pipeline cache directory and precompile them on worker threads at the next start");
+	add("gltfcache", { "-gc", "--gltfcache" }, 0, "Cache processed glTF scenes next to their files to speed up loading");
+	add("gltfcachemips", { "-gcm", "--gltfcachemips" }, 0, "Cache processed glTF scenes including the mip chains of their images");
+	add("depthprepass", { "-dp", "--depthprepass" }, 0, "Lay down depth in a separate subpass before shading (only used by examples that support it)");
+	add("dynamicrendering", { "-dyr", "--dynamicrendering" }, 0, "Render without render pass and frame buffer objects (requires VK_KHR_dynamic_rendering, only used by examples that support it)");
+	add("hostasbuilds", { "-hab", "--hostasbuilds" }, 0, "Build bottom level acceleration structures on the host using worker threads if supported (only used by examples that support it)");
+	add("dynamicresolution", { "-dr", "--dynamicresolution" }, 1, "Scale the render resolution of the scene to meet the given GPU time budget in ms (only used by examples that support it)");
+	add("adaptiveshadingrate", { "-asr", "--adaptiveshadingrate" }, 0, "Derive the shading rate from the previous frame's image content (requires VK_NV_shading_rate_image, only used by examples that support it)");
+	add("pipelinestatistics", { "-ps", "--pipelinestatistics" }, 0, "Count vertices, primitives and shader invocations of the GPU profiler scopes and store them with the benchmark results");
+	add("oitmode", { "-oit", "--oitmode" }, 1, "Select the order independent transparency mode (0 = linked lists, 1 = weighted blended, 2 = k-buffer, only used by examples that support it)");
+	add("subpassgbuffer", { "-sgb", "--subpassgbuffer" }, 0, "Render the G-Buffer and the composition as subpasses of a single render pass (only used by examples that support it)");
+	add("temporalaa", { "-taa", "--temporalaa" }, 0, "Use temporal anti-aliasing instead of multisampling (only used by examples that support it)");
+	add("vertexpulling", { "-vp", "--vertexpulling" }, 0, "Fetch vertices from storage buffers in the vertex shaders instead of the fixed function vertex input (only used by examples that support it)");
+	add("presentmode", { "-pm", "--presentmode" }, 1, "Select the present mode (fifo, fiforelaxed, mailbox or immediate), takes precedence over --vsync");
+	add("swapchainimages", { "-si", "--swapchainimages" }, 1, "Set the number of swap chain images");
+	add("framepacing", { "-fp", "--framepacing" }, 0, "Measure the input to photon latency and pace frames to reduce it and keep the frame rate steady (requires VK_GOOGLE_display_timing)");
+	add("sustainedperformance", { "-sp", "--sustainedperformance" }, 0, "Run at a performance level the device can sustain without throttling (Android only)");
+	add("overlaylayer", { "-ol", "--overlaylayer" }, 0, "Render the UI overlay into a cached layer that's only re-rendered if the UI changes");
+	add("capture", { "-cap", "--capture" }, 1, "Capture every n-th frame to disk without stalling the frame loop (only used by examples that support it)");
+	add("headless", { "-hl", "--headless" }, 0, "Render to offscreen images without a window or surface, runs the benchmark at full speed");
+	add("readback", { "-rb", "--readback" }, 1, "Write every n-th frame to disk (asynchronously) when rendering headless");
+	add("submitthread", { "-st", "--submitthread" }, 0, "Submit and present the frames on a dedicated thread while the main thread records the next frame (only used by examples that support it)");
+	add("latelatch", { "-ll", "--latelatch" }, 0, "Poll input and update the camera right before each frame is submitted (only used by examples that support it)");
+	add("pinthreads", { "-pt", "--pinthreads" }, 0, "Pin the main thread to the fastest core and worker threads to the other cores, fastest first");
+	add("trace", { "-tr", "--trace" }, 1, "Record CPU zones and GPU scopes to the given file as a Chrome trace (JSON, can be opened in chrome://tracing or Perfetto)");
+	add("traceframes", { "-trf", "--traceframes" }, 1, "Stop recording the trace after the given number of frames");
+	add("traceduration", { "-trd", "--traceduration" }, 1, "Stop recording the trace after the given number of seconds");
+	add("nodirectupload", { "-ndu", "--nodirectupload" }, 0, "Always stage buffer uploads, even if device local memory is host visible (unified memory or resizable BAR)");
+	add("objects", { "-obj", "--objects" }, 1, "Set the number of objects (and materials) of the scene (only used by examples that support it)");
 }
 
 void CommandLineParser::add(std::string name, std::vector<std::string> commands, bool hasValue, std::string help)
@@ -2813,3 +4645,16 @@ int32_t CommandLineParser::getValueAsInt(std::string name, int32_t defaultValue)
 	}
 	return int32_t();
 }
+
+float CommandLineParser::getValueAsFloat(std::string name, float defaultValue)
+{
+	assert(options.find(name) != options.end());
+	std::string value = options[name].value;
+	if (value != "") {
+		char* numConvPtr;
+		float floatVal = strtof(value.c_str(), &numConvPtr);
+		return ((numConvPtr != value.c_str()) && (floatVal > 0.0f)) ? floatVal : defaultValue;
+	} else {
+		return defaultValue;
+	}
+}
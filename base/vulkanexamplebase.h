@@ -42,6 +42,8 @@
 #include <ctime>
 #include <iostream>
 #include <chrono>
+#include <thread>
+#include <functional>
 #include <random>
 #include <algorithm>
 #include <sys/stat.h>
@@ -67,10 +69,31 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanPipelineCompiler.hpp"
+#include "VulkanPipelinePermutations.h"
+#include "VulkanProfiler.h"
+#include "VulkanTraceRecorder.h"
+#include "VulkanStartupProfiler.h"
+#include "VulkanPipelineManifest.h"
+#include "VulkanQueryManager.h"
+#include "VulkanTextRenderer.h"
+#include "VulkanResolutionScaler.h"
+#include "VulkanShadingRateGenerator.h"
+#include "VulkanTimelineSemaphore.hpp"
+#include "VulkanUniformRing.h"
+#include "VulkanFrameCapture.h"
+#include "VulkanHitchDetector.h"
+#include "VulkanSecondaryCommandBuffers.h"
+#include "VulkanFrameSubmitter.h"
+#include "VulkanMetricsExporter.h"
+#include "VulkanDynamicRendering.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
+#include "camerapath.hpp"
+#include "framearena.hpp"
 #include "benchmark.hpp"
+#include "cputopology.hpp"
 
 class CommandLineParser
 {
@@ -90,6 +113,7 @@ public:
 	bool isSet(std::string name);
 	std::string getValueAsString(std::string name, std::string defaultValue);
 	int32_t getValueAsInt(std::string name, int32_t defaultValue);
+	float getValueAsFloat(std::string name, float defaultValue);
 };
 
 class VulkanExampleBase
@@ -103,15 +127,37 @@ private:
 	void windowResize();
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
+	void benchmarkFrame();
+	void updateFrameTime(float measuredTime);
 	void updateOverlay();
 	void createPipelineCache();
+	void savePipelineCache();
 	void createCommandPool();
 	void createSynchronizationPrimitives();
 	void initSwapchain();
 	void setupSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
+	void updateDynamicResolution();
+	void updateFramePacing();
+	void updateMetricsExport();
+	void advanceCamera();
+	void pollLateInput();
+	void updateLateLatch();
+	bool sceneImageEnabled() const;
+	// Contents of the scene render pass begun last, the UI is drawn with a secondary if it doesn't allow inline commands
+	VkSubpassContents sceneSubpassContents = VK_SUBPASS_CONTENTS_INLINE;
+	// Deletion queue serial of the frame last submitted by each frame in flight (0 if none), reached once the frame's fence has been waited on
+	std::vector<uint64_t> frameSerials;
+	// Set from prepareFrame to submitFrame, while the fence of the current frame in flight has been reset but not yet submitted
+	bool frameInProgress = false;
 	std::string shaderDir = "glsl";
+	// Directory the pipeline cache is stored in (empty if the cache isn't persisted)
+	std::string pipelineCacheDir;
+	std::string getPipelineCacheFileName();
+	// Record the pipelines created in a session next to the pipeline cache and precompile them at the next start (see vks::PipelineManifest)
+	bool pipelineManifest = false;
+	std::string getPipelineManifestFileName();
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
 	std::string getShadersPath() const;
@@ -138,6 +184,23 @@ protected:
 	std::vector<const char*> enabledInstanceExtensions;
 	/** @brief Optional pNext structure for passing extension structures to device creation */
 	void* deviceCreatepNextChain = nullptr;
+	/** @brief Timeline semaphore feature structure chained in front of deviceCreatepNextChain if enableTimelineSemaphores is set */
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	/** @brief Feature structures for ray queries, chained in front of deviceCreatepNextChain if enableRayQueries is set and the device supports them */
+	VkPhysicalDeviceBufferDeviceAddressFeaturesKHR rayQueryBufferDeviceAddressFeatures{};
+	VkPhysicalDeviceAccelerationStructureFeaturesKHR rayQueryAccelerationStructureFeatures{};
+	VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
+	/** @brief Shading rate image feature structure chained in front of deviceCreatepNextChain if adaptive shading rate has been requested and the device supports it */
+	VkPhysicalDeviceShadingRateImageFeaturesNV shadingRateImageFeatures{};
+	/** @brief Extended dynamic state feature structures chained in front of deviceCreatepNextChain if enableExtendedDynamicState is set and the device supports them */
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+	VkPhysicalDeviceExtendedDynamicState2FeaturesEXT extendedDynamicState2Features{};
+	/** @brief ASTC HDR feature structure chained in front of deviceCreatepNextChain if enableCompressedHDRTextures is set and the device supports it */
+	VkPhysicalDeviceTextureCompressionASTCHDRFeaturesEXT textureCompressionASTCHDRFeatures{};
+	/** @brief Memory priority feature structure chained in front of deviceCreatepNextChain if the device supports it, used to give render targets a high priority */
+	VkPhysicalDeviceMemoryPriorityFeaturesEXT memoryPriorityFeatures{};
+	/** @brief Dynamic rendering feature structure chained in front of deviceCreatepNextChain if dynamic rendering has been requested and the device supports it */
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
 	/** @brief Logical device, application's view of the physical device (GPU) */
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
@@ -152,9 +215,9 @@ protected:
 	VkSubmitInfo submitInfo;
 	// Command buffers used for rendering
 	std::vector<VkCommandBuffer> drawCmdBuffers;
-	// Global render pass for frame buffer writes
-	VkRenderPass renderPass;
-	// List of available frame buffers (same as number of swap chain images)
+	// Global render pass for frame buffer writes (VK_NULL_HANDLE with dynamic rendering)
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	// List of available frame buffers (same as number of swap chain images, empty with dynamic rendering)
 	std::vector<VkFramebuffer>frameBuffers;
 	// Active frame buffer index
 	uint32_t currentBuffer = 0;
@@ -162,18 +225,113 @@ protected:
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
+	// Shader modules that have already been loaded, indexed by file name, so each shader file is only loaded once
+	std::unordered_map<std::string, VkShaderModule> shaderModuleCache;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
+	// Compiles pipelines on worker threads using the pipeline cache
+	vks::PipelineCompiler pipelineCompiler;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 	// Synchronization semaphores
-	struct {
+	struct Semaphores {
 		// Swap chain image presentation
 		VkSemaphore presentComplete;
 		// Command buffer submission and execution
 		VkSemaphore renderComplete;
-	} semaphores;
+	};
+	// Semaphores of the frame currently in flight (updated by prepareFrame)
+	Semaphores semaphores;
+	// One set of semaphores per frame in flight
+	std::vector<Semaphores> frameSemaphores;
+	// One fence per frame in flight, signaled once the GPU has finished all work submitted for that frame
 	std::vector<VkFence> waitFences;
+	// Fence of the frame in flight that last used a swap chain image (one entry per swap chain image)
+	std::vector<VkFence> imagesInFlight;
+	/**
+	* @brief Maximum number of frames the CPU may queue up ahead of the GPU (must be set in the derived constructor)
+	* Buffers that exist only once (like most uniform buffers of the examples) may still be read by any of these frames, so they must only be written after waitForFramesInFlight,
+	* data kept per frame in flight (e.g. in uniformRing) can be written as soon as prepareFrame has returned
+	*/
+	uint32_t maxFramesInFlight = 2;
+	/** @brief Index of the current frame in flight (0..maxFramesInFlight-1) */
+	uint32_t currentFrame = 0;
+	/**
+	* @brief Wait for all frames in flight before recreating the size dependent resources on a window resize (must be set in the derived constructor)
+	* By default the swap chain, depth stencil, frame buffers and command buffers of the base class are replaced while frames in flight may still be using the old ones, which are destroyed once those frames have finished (see retireResource)
+	* windowResized and viewChanged are only called once the frames in flight have finished, examples that destroy or update resources in use by these frames before that (e.g. in a setupFrameBuffer override) need to set this, unless they retire those resources as well
+	*/
+	bool resizeWaitsForFrames = false;
+	/** @brief Record the command buffer of each frame right before it's submitted instead of pre-recording one per swap chain image (must be set in the derived constructor), see recordCommandBuffer */
+	bool dynamicCommandBuffers = false;
+	// Transient command pool and command buffer per frame in flight, only used with dynamicCommandBuffers
+	std::vector<VkCommandPool> frameCmdPools;
+	std::vector<VkCommandBuffer> frameCmdBuffers;
+	/**
+	* @brief Static scene content recorded once into cached secondaries and dynamic content (e.g. the UI) recorded into fresh secondaries each frame (only used with dynamicCommandBuffers)
+	* Examples begin their scene render pass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS (see beginSceneRenderPass) and execute the secondaries returned by getStatic and recordDynamic,
+	* static secondaries are invalidated by the base if the render size, scene render pass or shading rate changes and by the example if their content changes
+	*/
+	vks::SecondaryCommandBuffers secondaryCommandBuffers;
+	/** @brief Bytes of uniform data each frame in flight can allocate from uniformRing (must be set in the derived constructor, 0 = no uniform ring) */
+	VkDeviceSize uniformRingSize = 0;
+	/** @brief Uniform data of the current frame in flight that's bound with dynamic offsets, reset by prepareFrame (only used with dynamicCommandBuffers) */
+	vks::UniformRing uniformRing;
+	/** @brief Bytes of transient CPU data each frame in flight can allocate from frameArena before it's grown (may be changed in the derived constructor) */
+	size_t frameArenaSize = 64 * 1024;
+	/** @brief Transient CPU data of the current frame in flight (e.g. vks::FrameVector), reset by prepareFrame once the frame's fence has been waited on */
+	vks::FrameArena frameArena;
+	/** @brief Descriptor sets of the current frame in flight, released by prepareFrame once the frame's fence has been waited on (only used with dynamicCommandBuffers) */
+	vks::DescriptorAllocator frameDescriptors;
+	/** @brief Number of readback buffers of frameCapture (must be set in the derived constructor, 0 = no frame capture) */
+	uint32_t frameCaptureSlots = 0;
+	/** @brief Asynchronous capture of rendered images to disk, the copies are recorded into the frame's command buffer (only used with dynamicCommandBuffers) */
+	vks::FrameCapture frameCapture;
+	/** @brief Enable VK_KHR_timeline_semaphore if the device supports it (must be set in the derived constructor), see frameTimeline */
+	bool enableTimelineSemaphores = false;
+	/**
+	* @brief Frame clock, signaled with an increasing value by submitFrame once all work submitted to the graphics queue for a frame has finished
+	* Only valid if enableTimelineSemaphores is set and the device supports timeline semaphores, other queues (e.g. async compute) can wait on frame values to pipeline their work against graphics
+	*/
+	vks::TimelineSemaphore frameTimeline;
+	/**
+	* @brief Enable VK_KHR_ray_query and VK_KHR_acceleration_structure if the device supports them (must be set in the derived constructor), see rayQueriesSupported
+	* Raises the requested API version to Vulkan 1.1, which is required by the ray tracing extensions
+	*/
+	bool enableRayQueries = false;
+	/** @brief Set if enableRayQueries is set and ray queries have been enabled for the logical device, e.g. for building a vks::RayQueryShadows scene */
+	bool rayQueriesSupported = false;
+	/**
+	* @brief Enable VK_EXT_extended_dynamic_state and, if available, VK_EXT_extended_dynamic_state2 (must be set in the derived constructor), see extendedDynamicState
+	* Pipelines that only differ in cull mode, front face, topology, depth or stencil state can then be replaced by a single pipeline with that state set in the command buffer
+	* Raises the requested API version to Vulkan 1.1, which is required to query the features of the extensions
+	*/
+	bool enableExtendedDynamicState = false;
+	/**
+	* @brief Enable BC and, if available, VK_EXT_texture_compression_astc_hdr texture compression (must be set in the derived constructor)
+	* Lets the cube map loader pick BC6H or ASTC HDR compressed variants of HDR environment maps (see vks::Texture::getCompressedHDRFile)
+	* Raises the requested API version to Vulkan 1.1, which is required to query the ASTC HDR feature
+	*/
+	bool enableCompressedHDRTextures = false;
+	struct {
+		/** @brief Set if enableExtendedDynamicState is set and VK_EXT_extended_dynamic_state has been enabled for the logical device */
+		bool supported = false;
+		/** @brief Set if VK_EXT_extended_dynamic_state2 has also been enabled (depth bias, rasterizer discard and primitive restart) */
+		bool supported2 = false;
+		/** @brief Number of pipelines an example didn't have to create as their state is set dynamically, displayed in the overlay */
+		uint32_t pipelinesAvoided = 0;
+		PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+		PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT = nullptr;
+		PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+		PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+		PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+		PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+		PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT = nullptr;
+		PFN_vkCmdSetStencilOpEXT vkCmdSetStencilOpEXT = nullptr;
+		PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT = nullptr;
+		PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT = nullptr;
+		PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT = nullptr;
+	} extendedDynamicState;
 public:
 	bool prepared = false;
 	bool resized = false;
@@ -188,6 +346,32 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief Deterministic frame times and camera paths, so benchmark runs render the same content on every device */
+	struct {
+		/** @brief Simulated time (in seconds) each frame advances animations by instead of its measured time, only used if not zero (defaults to 1/60 s in benchmark mode) */
+		float fixedTimestep = 0.0f;
+		/** @brief Simulated time (in seconds) since the camera path started recording or replaying */
+		double time = 0.0;
+		vks::CameraPath cameraPath;
+		/** @brief Set if the camera is moved along cameraPath, overriding input */
+		bool replaying = false;
+		/** @brief Set if the camera is recorded to cameraPath, which is saved to recordFile on exit */
+		bool recording = false;
+		std::string recordFile;
+	} replay;
+
+	/** @brief GPU timings of named scopes, examples open the scopes in their command buffers */
+	vks::GpuProfiler gpuProfiler;
+	/** @brief CPU time of the frame loop's phases, frames start with prepareFrame and the phases are shown in the UI overlay and added to benchmark results */
+	vks::CpuFrameProfiler cpuProfiler;
+	/** @brief Start of the example and its preparation, the startup phases are added to benchmark results (see vks::StartupProfiler) */
+	struct {
+		vks::StartupProfiler::Clock::time_point start;
+		vks::StartupProfiler::Clock::time_point prepare;
+		bool prepared = false;
+		bool firstFramePresented = false;
+	} startup;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -201,6 +385,12 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = false;
+		/** @brief Render the UI overlay into a cached layer that's only re-rendered if the UI changes and composited onto each frame (see vks::UIOverlay::Layer) */
+		bool overlayLayer = false;
+		/** @brief Render to offscreen images instead of a swap chain, no window or surface is created */
+		bool headless = false;
+		/** @brief Ask the system for a performance level the device can sustain (Android 7.0 and up), so frame times don't change once the device heats up and throttles */
+		bool sustainedPerformance = false;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -226,6 +416,197 @@ public:
 		VkDeviceMemory mem;
 		VkImageView view;
 	} depthStencil;
+	/** @brief Usage flags of the depth stencil image, examples that read the depth attachment (e.g. VK_IMAGE_USAGE_SAMPLED_BIT) need to add them before calling prepare() */
+	VkImageUsageFlags depthStencilUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+	/**
+	* @brief Optional depth prepass of the default render pass, requested with the --depthprepass command line argument
+	* If enabled the default render pass has a depth only subpass (0) in front of the main subpass (1), so the main subpass only shades the visible fragments
+	* Examples that support it set supported in their constructor, create their pipelines with prepareDepthPrepassPipeline and record the depth only draws before vkCmdNextSubpass
+	*/
+	struct DepthPrepass {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		/** @brief Subpass of the default render pass all main pass pipelines (including the UI overlay) need to be created for */
+		uint32_t mainSubpass = 0;
+	} depthPrepass;
+
+	/**
+	* @brief Optional dynamic rendering of the default render pass, requested with the --dynamicrendering command line argument
+	* If VK_KHR_dynamic_rendering is supported, no default render pass and frame buffers are created (so a resize only recreates the swap chain and depth stencil),
+	* beginSceneRenderPass begins rendering to the swap chain image and depth stencil views directly and transitions their layouts with barriers
+	* Examples that support it set supported in their constructor, record their scene with beginSceneRenderPass and endSceneRenderPass and chain getScenePipelineRenderingInfo
+	* to the create info of their scene pipelines instead of passing a render pass, the depth prepass, dynamic resolution, adaptive shading rate and the cached UI layer take precedence
+	*/
+	struct DynamicRendering {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		// Formats referenced by the pipeline rendering and inheritance infos
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkCommandBufferInheritanceRenderingInfoKHR inheritanceInfo{};
+	} dynamicRendering;
+
+	/**
+	* @brief Optional dynamic resolution scaling, requested with the --dynamicresolution command line argument that sets the GPU time budget of the scene in milliseconds
+	* If enabled the scene is rendered to an offscreen image at a reduced resolution that's adjusted to the GPU time of the scene render pass and upscaled to the swap chain (see vks::ResolutionScaler)
+	* Examples that support it set supported in their constructor, record their scene render pass with beginSceneRenderPass and endSceneRenderPass and call gpuProfiler.beginFrame in their command buffers
+	* The UI overlay is drawn by endSceneRenderPass after the upscale, so it stays at native resolution
+	*/
+	struct DynamicResolution {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		/** @brief GPU time budget of the scene render pass in milliseconds */
+		float targetTime = 16.0f;
+		/** @brief Latest GPU time of the scene render pass in milliseconds, 0 if there is no new measurement */
+		double gpuTime = 0.0;
+		vks::ResolutionScaler scaler;
+	} dynamicResolution;
+
+	/**
+	* @brief Optional content adaptive shading rate, requested with the --adaptiveshadingrate command line argument
+	* If enabled and VK_NV_shading_rate_image is supported, a compute pass derives the shading rate image from the previous frame's scene before the scene render pass (see vks::ShadingRateGenerator)
+	* The scene is rendered to the offscreen image of the resolution scaler for this (at native resolution if dynamic resolution isn't enabled), which stays around for the next frame
+	* Examples that support it set supported in their constructor, record their scene render pass with beginSceneRenderPass and endSceneRenderPass and
+	* create their scene pipelines with enableAdaptiveShadingRate, the fragment shader invocations of the scene render pass are shown in the UI overlay
+	*/
+	struct AdaptiveShadingRate {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		/** @brief Bind the generated shading rate image when recording the scene render pass, otherwise the scene is shaded at full rate (e.g. for comparison) */
+		bool active = true;
+		vks::ShadingRateGenerator generator;
+	} adaptiveShadingRate;
+
+	/**
+	* @brief Optional pipeline statistics of the GPU profiler scopes, requested with the --pipelinestatistics command line argument
+	* If the pipelineStatisticsQuery feature is supported, the vertices, primitives and shader invocations of each top level profiler scope are counted
+	* and stored with the benchmark results (along with their sum as "Frame"), so changes like culling or LOD can be verified by the work they remove
+	*/
+	struct {
+		bool requested = false;
+		bool enabled = false;
+	} pipelineStatistics;
+
+	/**
+	* @brief Optional submission thread, requested with the --submitthread command line argument
+	* If enabled, renderFrame hands the recorded frame over to a dedicated thread that submits it and presents the image (see vks::FrameSubmitter),
+	* so a present (or the submission itself) blocking in the driver no longer stalls the main thread updating and recording the next frame
+	* Examples that support it set supported in their constructor, they need to use dynamicCommandBuffers and must hold lockQueue while
+	* using the graphics queue themselves once frames are running, frame pacing takes precedence as it tags the presents on the main thread
+	*/
+	struct SubmitThread {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		vks::FrameSubmitter submitter;
+		// Command buffer of the frame being recorded, handed over by submitFrame
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	} submitThread;
+
+	/**
+	* @brief Optional present timing and frame pacing, requested with the --framepacing command line argument
+	* If VK_GOOGLE_display_timing is supported, each present is tagged with an id and the time from the start of the frame (prepareFrame) to when it was actually displayed is measured
+	* While pacing is active, the start of each frame is delayed by the margin recent presents were ready ahead of when they were needed by the presentation engine, so frames
+	* no longer wait in the present queue (or on the fences of frames in flight) after their input has been sampled, which reduces the input to photon latency
+	* Like Android's frame pacing library (Swappy), pacing also picks the number of refresh cycles each frame is displayed for from the time the frames take and holds presents
+	* back until their slot, so a frame rate that can't be met for every refresh drops to a steady lower rate instead of alternating between the two
+	* The present mode and number of swap chain images are selected with the --presentmode and --swapchainimages command line arguments
+	*/
+	struct FramePacing {
+		bool requested = false;
+		bool enabled = false;
+		/** @brief Delay the start of frames, otherwise only the latency is measured (e.g. for comparison) */
+		bool active = true;
+		/** @brief Margin (in ns) kept between a frame being ready and the latest time it can be presented to absorb frame time variations */
+		uint64_t safetyMargin = 2000000;
+		/** @brief Current delay of the frame start in ns */
+		uint64_t delay = 0;
+		/** @brief Refresh duration of the display in ns */
+		uint64_t refreshDuration = 0;
+		/** @brief Smoothed time (in ms) from the start of a frame to when it was displayed */
+		double latency = 0.0;
+		/** @brief Summed up latencies (in ms) and their count for the benchmark results */
+		double latencySum = 0.0;
+		uint32_t latencySamples = 0;
+		/** @brief Start time (in ns) of the current frame and of recently presented frames, indexed by present id */
+		uint64_t frameStart = 0;
+		std::array<uint64_t, 16> presentFrameStarts{};
+		/** @brief Number of refresh cycles each frame is displayed for, 0 until the refresh duration is known */
+		uint32_t swapInterval = 0;
+		uint32_t maxSwapInterval = 4;
+		/** @brief Id and actual display time (in ns) of the latest present known to have been displayed */
+		uint32_t lastPresentId = 0;
+		uint64_t lastPresentTime = 0;
+	} framePacing;
+
+	/**
+	* @brief Optional late latching of the camera, requested with the --latelatch command line argument
+	* The camera is normally updated from input sampled before the frame's fence wait, acquire and recording, so the view a frame is rendered with is at least that much older than its submission
+	* Examples that support late latching set supported in their constructor and write their camera uniforms with latchCamera while recording, which reserves the block in the uniform ring
+	* With late latching enabled, renderFrame polls pending input, advances the camera and rewrites all blocks of the frame right before the command buffer is submitted
+	* The uniform ring is host coherent, so these writes are visible to the GPU without a flush as they happen before vkQueueSubmit
+	* Requires dynamicCommandBuffers and the uniform ring, input is only polled on Windows and XCB (other platforms latch the camera movement of keys held down)
+	*/
+	struct LateLatch {
+		bool supported = false;
+		bool requested = false;
+		bool enabled = false;
+		/** @brief Uniform block written by latchCamera (std140 layout) */
+		struct CameraBlock {
+			glm::mat4 projection;
+			glm::mat4 view;
+			glm::vec4 viewPos;
+		};
+		/** @brief Blocks of the frame being recorded, rewritten right before its submission */
+		std::vector<CameraBlock*> blocks;
+		/** @brief Time the camera was last advanced, the next update moves it by the time passed since */
+		std::chrono::steady_clock::time_point cameraTime;
+		/** @brief Time the input used by the current frame was sampled at */
+		std::chrono::steady_clock::time_point inputTime;
+		/** @brief Smoothed age (in ms) of the frame's input when it's submitted */
+		double inputAge = 0.0;
+		/** @brief Summed up input ages (in ms) and their count for the benchmark results */
+		double inputAgeSum = 0.0;
+		uint32_t inputAgeSamples = 0;
+#if defined(VK_USE_PLATFORM_XCB_KHR)
+		/** @brief Window events (other than input) polled while latching, handled with the events of the next frame */
+		std::vector<xcb_generic_event_t*> deferredEvents;
+#endif
+	} lateLatch;
+
+	/**
+	* @brief Optional per frame counting of heap allocations and of pipeline, memory and descriptor pool creation, requested with the --hitchdetector command line argument (see vks::HitchDetector)
+	* Counting starts with the first frame, frames over the allocation budget or making any of the Vulkan calls are counted in the overlay and stored with their call stacks in the benchmark results
+	*/
+	struct {
+		bool enabled = false;
+		uint64_t allocationBudget = 0;
+		/** @brief Counters of the last frame */
+		vks::HitchDetector::FrameStats last;
+		uint32_t flaggedFrames = 0;
+	} hitchDetector;
+
+	/**
+	* @brief Optional export of the frame metrics for monitoring unattended runs, requested with the --metricsexporter command line argument (see vks::MetricsExporter)
+	* Frames are counted every frame, the snapshot of the profiler timings, memory budgets and swap chain state is only filled in while a consumer is attached
+	*/
+	struct {
+		uint16_t port = 0;
+		vks::MetricsExporter exporter;
+	} metricsExport;
+
+	/**
+	* @brief Optional incremental defragmentation of device memory, requested with the --defragment command line argument (see vks::VulkanDevice::defragment)
+	* Each frame moves up to budget bytes of the allocations registered with vks::VulkanDevice::setMovable, so long running sessions that reload resources don't keep growing their memory blocks
+	*/
+	struct {
+		bool enabled = false;
+		VkDeviceSize budget = 4 * 1024 * 1024;
+	} defragmentation;
 
 	struct {
 		glm::vec2 axisLeft = glm::vec2(0.0f);
@@ -367,10 +748,34 @@ public:
 	virtual void keyPressed(uint32_t);
 	/** @brief (Virtual) Called after the mouse cursor moved and before internal events (like camera rotation) is handled */
 	virtual void mouseMoved(double x, double y, bool &handled);
+	/**
+	* @brief Destroy a resource once all frames that are currently in flight have finished, e.g. because it has been replaced while they may still use it
+	* @note Shorthand for vulkanDevice->deletionQueue.push, which also has helpers for single handles and vks::Buffer objects
+	*/
+	void retireResource(std::function<void()> destroy);
+	/**
+	* @brief Lock the graphics queue against the submission thread, the returned lock doesn't own anything if the submission thread isn't enabled
+	* Must be held while using the queue between frames (e.g. for uploads) if the example supports the submission thread
+	*/
+	std::unique_lock<std::mutex> lockQueue();
+	/**
+	* @brief Write the camera's projection, view and position to the current frame's uniform ring region and return the dynamic offset to bind them with (see lateLatch)
+	* The block is rewritten with the latest camera right before submission if late latching is enabled, so it must be called while recording the frame's command buffer
+	*/
+	uint32_t latchCamera();
+
+	/**
+	* @brief (Virtual) Enable or disable a named setting for an A/B comparison in benchmark mode (--benchcompare), returns false if the setting is unknown
+	* The base handles "adaptiveshadingrate" and "framepacing", examples override this for their own settings and call the base for the rest
+	* @note Frames in flight have finished when this is called and static command buffers are rebuilt afterwards
+	*/
+	virtual bool setComparisonSetting(const std::string& name, bool enabled);
 	/** @brief (Virtual) Called when the window has been resized, can be used by the sample application to recreate resources */
 	virtual void windowResized();
 	/** @brief (Virtual) Called when resources have been recreated that require a rebuild of the command buffers (e.g. frame buffer), to be implemented by the sample application */
 	virtual void buildCommandBuffers();
+	/** @brief (Virtual) Records the command buffer of the current frame for the given swap chain image, called each frame by renderFrame if dynamicCommandBuffers is enabled */
+	virtual void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 	/** @brief (Virtual) Setup default depth and stencil views */
 	virtual void setupDepthStencil();
 	/** @brief (Virtual) Setup default framebuffers for all requested swapchain images */
@@ -386,16 +791,37 @@ public:
 	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
 
+	/** @brief Creates the depth only variant of a pipeline for the depth prepass and changes the create info to depth equal testing in the main subpass */
+	void prepareDepthPrepassPipeline(VkGraphicsPipelineCreateInfo& pipelineCI, VkPipelineDepthStencilStateCreateInfo& depthStencilState, VkPipeline* prepassPipeline);
+	/** @brief Chains the shading rate palette of adaptive shading rate into the viewport state of a scene pipeline if enabled, the generator's state is valid until the example is destroyed */
+	void enableAdaptiveShadingRate(VkPipelineViewportStateCreateInfo& viewportState);
+
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
 	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
 	void drawUI(const VkCommandBuffer commandBuffer);
 
+	/**
+	* @brief Begins the scene render pass with the default render pass' attachments and sets the viewport and scissor to the scene's render size
+	* Renders to the offscreen scene image if dynamic resolution or adaptive shading rate is enabled, the latter also generates and binds the shading rate image
+	*/
+	void beginSceneRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, const VkClearValue* clearValues, uint32_t clearValueCount, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	/** @brief Sets the viewport and scissor to the scene's render size and binds the shading rate image if enabled, done by beginSceneRenderPass for inline contents and by each secondary otherwise */
+	void setSceneRenderState(VkCommandBuffer commandBuffer);
+	/** @brief Inheritance info for secondaries executed in the scene render pass (see secondaryCommandBuffers) */
+	VkCommandBufferInheritanceInfo getSceneInheritanceInfo();
+	/** @brief Attachment formats of the scene for pipelines used with dynamic rendering, to be chained to VkGraphicsPipelineCreateInfo::pNext (which must stay valid until the pipeline has been created) */
+	VkPipelineRenderingCreateInfoKHR getScenePipelineRenderingInfo() const;
+	/** @brief Ends the scene render pass and draws the UI overlay, copies (or upscales) the offscreen scene image to the swap chain image first if it's used */
+	void endSceneRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
 	/** @brief Presents the current image to the swap chain */
 	void submitFrame();
+	/** @brief Waits until the GPU has finished all frames that are currently in flight (e.g. before re-recording command buffers or writing uniform buffers shared by all frames), between prepareFrame and submitFrame this covers all frames but the one being recorded */
+	void waitForFramesInFlight();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
 
@@ -421,7 +847,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	for (int32_t i = 0; i < __argc; i++) { VulkanExample::args.push_back(__argv[i]); };  			\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow(hInstance, WndProc);													\
+	if (!vulkanExample->settings.headless) vulkanExample->setupWindow(hInstance, WndProc);			\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -474,7 +900,7 @@ int main(const int argc, const char *argv[])													    \
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow();					 												\
+	if (!vulkanExample->settings.headless) vulkanExample->setupWindow();							\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -488,7 +914,7 @@ int main(const int argc, const char *argv[])													    \
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow();					 												\
+	if (!vulkanExample->settings.headless) vulkanExample->setupWindow();							\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -509,7 +935,7 @@ int main(const int argc, const char *argv[])													    \
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow();					 												\
+	if (!vulkanExample->settings.headless) vulkanExample->setupWindow();							\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -526,7 +952,7 @@ int main(const int argc, const char *argv[])														\
 		for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };				\
 		vulkanExample = new VulkanExample();														\
 		vulkanExample->initVulkan();																\
-		vulkanExample->setupWindow(nullptr);														\
+		if (!vulkanExample->settings.headless) vulkanExample->setupWindow(nullptr);					\
 		vulkanExample->prepare();																	\
 		vulkanExample->renderLoop();																\
 		delete(vulkanExample);																		\
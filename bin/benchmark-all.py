@@ -1,47 +1,81 @@
 # Benchmark all examples
+#
+# Runs the examples back to back in benchmark mode, collects their (JSON) results into a single report
+# and optionally compares that report against a stored baseline to catch performance regressions
+#
+# Examples:
+#   python benchmark-all.py --duration 10 --report report.json
+#   python benchmark-all.py --examples triangle,pbrbasic --baseline baseline.json --tolerance 5
+#   python benchmark-all.py --report baseline.json --save-baseline
+
+import argparse
+import json
 import subprocess
 import sys
 import os
 import platform
 
 EXAMPLES = [
+	"bindingmodels",
 	"bloom",
 	"computecloth",
 	"computecullandlod",
 	"computenbody",
 	"computeparticles",
+	"computeraytracing",
 	"computeshader",
+	"conditionalrender",
+	"conservativeraster",
 	"debugmarker",
 	"deferred",
 	"deferredmultisampling",
 	"deferredshadows",
+	"descriptorindexing",
+	"descriptorsets",
 	"displacement",
 	"distancefieldfonts",
 	"dynamicuniformbuffer",
 	"gears",
 	"geometryshader",
+	"geometrystreaming",
+	"gltfloading",
+	"gltfscenerendering",
+	"gltfskinning",
 	"hdr",
 	"imgui",
 	"indirectdraw",
+	"inlineuniformblocks",
+	"inputattachments",
 	"instancing",
-	"mesh",
+	"meshshader",
 	"multisampling",
 	"multithreading",
+	"multiview",
+	"negativeviewportheight",
 	"occlusionquery",
 	"offscreen",
+	"oit",
 	"parallaxmapping",
 	"particlefire",
 	"pbrbasic",
 	"pbribl",
 	"pbrtexture",
 	"pipelines",
+	"pipelinestatistics",
 	"pushconstants",
+	"pushdescriptors",
 	"radialblur",
-	"raytracing",
-	"scenerendering",
+	"rayquery",
+	"raytracingbasic",
+	"raytracingcallable",
+	"raytracingreflections",
+	"raytracingshadows",
+	"scenestreaming",
+	"sceneswitching",
+	"screenshot",
 	"shadowmapping",
+	"shadowmappingcascade",
 	"shadowmappingomni",
-	"skeletalanimation",
 	"specializationconstants",
 	"sphericalenvmapping",
 	"ssao",
@@ -54,31 +88,165 @@ EXAMPLES = [
 	"texture3d",
 	"texturearray",
 	"texturecubemap",
+	"texturecubemaparray",
 	"texturemipmapgen",
 	"texturesparseresidency",
 	"triangle",
+	"variablerateshading",
 	"viewportarray",
+	"voxelization",
 	"vulkanscene"
 ]
 
-CURR_INDEX = 0
+# Metrics compared against the baseline, with True if higher values are better
+METRICS = [
+	(["fps"], True),
+	(["frametime", "p50"], False),
+	(["frametime", "p99"], False),
+	(["frametime", "stutterframes"], False)
+]
+
+# Polarity of the example metrics ("metrics" in the results) that aren't lower is better, None for informational values that aren't checked for regressions
+METRIC_POLARITY = {
+	"capturedframes": True,
+	"pipelinecachehits": True,
+	"precompiledpipelinesused": True,
+	"renderscale": True,
+	"thermalheadroom": True,
+	"acmrbefore": None,
+	"offscreenmemoryunaliasedkb": None,
+	"pipelinecount": None,
+	"precompiledpipelines": None,
+	"swapinterval": None,
+	"tcpatches": None,
+	"teinvocations": None
+}
+
+def get_metric(result, metric):
+	value = result
+	for key in metric:
+		if not isinstance(value, dict) or key not in value:
+			return None
+		value = value[key]
+	return value
+
+def run_examples(args, examples):
+	os.makedirs(args.outputdir, exist_ok=True)
+	report = { "examples": {}, "failed": [] }
+	for index, example in enumerate(examples):
+		print("---- (%d/%d) Running %s in benchmark mode ----" % (index + 1, len(examples), example))
+		resultfile = os.path.join(args.outputdir, "%s.json" % example)
+		if os.path.exists(resultfile):
+			os.remove(resultfile)
+		binary = os.path.join(args.bindir, example + (".exe" if platform.system() == 'Windows' else ""))
+		command = [binary, "-b", "-bw", str(args.warmup), "-br", str(args.duration), "-bf", resultfile]
+		if args.fullscreen:
+			command.append("-f")
+		if args.width and args.height:
+			command += ["-w", str(args.width), "-h", str(args.height)]
+		try:
+			result_code = subprocess.call(command)
+		except OSError as e:
+			print("Error, could not run %s: %s" % (binary, e))
+			result_code = -1
+		if result_code == 0 and os.path.exists(resultfile):
+			with open(resultfile) as f:
+				report["examples"][example] = json.load(f)
+			print("Results written to %s" % resultfile)
+		else:
+			print("Error, result code = %d" % result_code)
+			report["failed"].append(example)
+	return report
+
+def compare(report, baseline, tolerance):
+	regressions = []
+	print("")
+	print("%-26s %-24s %12s %12s %9s" % ("example", "metric", "baseline", "current", "change"))
+	for example, result in sorted(report["examples"].items()):
+		if example not in baseline["examples"]:
+			print("%-26s (not in baseline)" % example)
+			continue
+		base_result = baseline["examples"][example]
+		metrics = list(METRICS)
+		# GPU scope timings are compared as well, lower is better
+		for scope in sorted(result.get("gpuscopes", {}).keys()):
+			metrics.append((["gpuscopes", scope, "avg"], False))
+		# CPU times measured by the example (e.g. command buffer recording), lower is better
+		for scope in sorted(result.get("cpuscopes", {}).keys()):
+			metrics.append((["cpuscopes", scope, "avg"], False))
+		# Example specific throughput (e.g. interactions per second), higher is better
+		for work in sorted(result.get("throughput", {}).keys()):
+			metrics.append((["throughput", work], True))
+		# Example specific setup times (e.g. buffer uploads), lower is better
+		for setup in sorted(result.get("setuptimes", {}).keys()):
+			metrics.append((["setuptimes", setup], False))
+		# Example metrics (e.g. vertex cache miss ratios), lower is better unless listed in METRIC_POLARITY
+		for metric in sorted(result.get("metrics", {}).keys()):
+			metrics.append((["metrics", metric], METRIC_POLARITY.get(metric, False)))
+		for metric, higher_is_better in metrics:
+			current = get_metric(result, metric)
+			previous = get_metric(base_result, metric)
+			if current is None or previous is None:
+				continue
+			if previous == 0:
+				change = 0.0 if current == 0 else 100.0
+			else:
+				change = (current - previous) / previous * 100.0
+			if higher_is_better is None:
+				regressed = False
+			else:
+				regressed = (change < -tolerance) if higher_is_better else (change > tolerance)
+			name = ".".join(metric)
+			print("%-26s %-24s %12.3f %12.3f %8.2f%%%s" % (example, name, previous, current, change, "  <-- regression" if regressed else ""))
+			if regressed:
+				regressions.append((example, name, previous, current, change))
+	for example in sorted(baseline["examples"].keys()):
+		if example not in report["examples"]:
+			print("%-26s (missing from current run)" % example)
+	return regressions
+
+parser = argparse.ArgumentParser(description="Run the examples in benchmark mode and compare the results against a baseline")
+parser.add_argument("--examples", help="Comma separated list of examples to run (defaults to all)")
+parser.add_argument("--exclude", help="Comma separated list of examples to skip")
+parser.add_argument("--bindir", default=".", help="Directory containing the example binaries")
+parser.add_argument("--outputdir", default="./benchmark", help="Directory the per example results are written to")
+parser.add_argument("--warmup", type=int, default=1, help="Warmup time per example in seconds")
+parser.add_argument("--duration", type=int, default=10, help="Benchmark duration per example in seconds")
+parser.add_argument("--width", type=int, help="Window width")
+parser.add_argument("--height", type=int, help="Window height")
+parser.add_argument("--fullscreen", action="store_true", help="Run the examples in fullscreen")
+parser.add_argument("--report", default="./benchmark/report.json", help="File the combined report is written to")
+parser.add_argument("--baseline", help="Report of a previous run to compare the results against")
+parser.add_argument("--tolerance", type=float, default=5.0, help="Allowed change in percent before a metric counts as a regression")
+parser.add_argument("--save-baseline", dest="savebaseline", action="store_true", help="Only run and write the report (e.g. to store it as the new baseline), skips the comparison")
+args = parser.parse_args()
 
-ARGS = "-fullscreen -b"
+examples = args.examples.split(",") if args.examples else EXAMPLES
+if args.exclude:
+	excluded = args.exclude.split(",")
+	examples = [example for example in examples if example not in excluded]
 
-print("Benchmarking all examples...")
+print("Benchmarking %d examples..." % len(examples))
 
-os.makedirs("./benchmark", exist_ok=True)
+report = run_examples(args, examples)
+report["warmup"] = args.warmup
+report["duration"] = args.duration
 
-for example in EXAMPLES:
-	print("---- (%d/%d) Running %s in benchmark mode ----" % (CURR_INDEX+1, len(EXAMPLES), example))
-	if platform.system() == 'Linux':
-		RESULT_CODE = subprocess.call("./%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example), shell=True)
-	else:
-		RESULT_CODE = subprocess.call("%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example))
-	if RESULT_CODE == 0:
-		print("Results written to ./benchmark/%s.csv" % example)
-	else:
-		print("Error, result code = %d" % RESULT_CODE)
-	CURR_INDEX += 1
+report_dir = os.path.dirname(args.report)
+if report_dir:
+	os.makedirs(report_dir, exist_ok=True)
+with open(args.report, "w") as f:
+	json.dump(report, f, indent=4, sort_keys=True)
+print("Benchmark run finished, report written to %s" % args.report)
+if report["failed"]:
+	print("Failed examples: %s" % ", ".join(report["failed"]))
 
-print("Benchmark run finished")
+if args.baseline and not args.savebaseline:
+	with open(args.baseline) as f:
+		baseline = json.load(f)
+	regressions = compare(report, baseline, args.tolerance)
+	print("")
+	if regressions:
+		print("%d metric(s) regressed by more than %.1f%%" % (len(regressions), args.tolerance))
+		sys.exit(1)
+	print("No regressions above %.1f%%" % args.tolerance)
@@ -0,0 +1,22 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerFont;
+
+layout (push_constant) uniform PushConstants {
+	vec2 scale;
+	float smoothing;
+} pushConstants;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// The edge of the glyph is at a distance of 0.5, the transition is scaled by the screen space derivative so it stays sharp at any size
+	float distance = texture(samplerFont, inUV).a;
+	float smoothWidth = fwidth(distance) * pushConstants.smoothing;
+	float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	outFragColor = vec4(inColor.rgb, inColor.a * alpha);
+}
@@ -0,0 +1,29 @@
+#version 450
+
+// Per glyph instance data
+layout (location = 0) in vec4 inRect;
+layout (location = 1) in vec4 inUV;
+layout (location = 2) in vec4 inColor;
+
+layout (push_constant) uniform PushConstants {
+	vec2 scale;
+	float smoothing;
+} pushConstants;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;   
+};
+
+void main() 
+{
+	// Corners of the glyph's quad as a triangle strip
+	vec2 corner = vec2(gl_VertexIndex & 1, (gl_VertexIndex >> 1) & 1);
+	outUV = mix(inUV.xy, inUV.zw, corner);
+	outColor = inColor;
+	vec2 pos = mix(inRect.xy, inRect.zw, corner);
+	gl_Position = vec4(pos * pushConstants.scale - 1.0, 0.0, 1.0);
+}
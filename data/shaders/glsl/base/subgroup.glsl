@@ -0,0 +1,63 @@
+// Workgroup wide reduction, prefix sum and stream compaction built from subgroup operations
+// Subgroups reduce and scan in registers and only exchange their totals through shared memory, which needs a fraction of the barriers of a plain shared memory scan
+// Before including this file:
+// - Enable GL_KHR_shader_subgroup_basic, GL_KHR_shader_subgroup_arithmetic and GL_KHR_shader_subgroup_ballot
+// - Define WORKGROUP_SIZE to the (constant) workgroup size and SUBGROUP_SIZE_CONSTANT_ID to a free specialization constant id
+// The application sets that constant to the smallest subgroup size compute shaders may run with (see vks::VulkanDevice::getComputeSubgroupSize), which sizes the shared memory
+// All invocations of the workgroup have to call the functions from uniform control flow, and the workgroup size must be a multiple of the subgroup size
+
+layout (constant_id = SUBGROUP_SIZE_CONSTANT_ID) const uint SUBGROUP_SIZE = 4;
+
+// Totals of the subgroups, one per subgroup of the workgroup
+shared uint subgroupTotals[WORKGROUP_SIZE / SUBGROUP_SIZE];
+
+// Index of the invocation within the workgroup in the order the subgroup scans run in
+// Use this instead of gl_LocalInvocationIndex to pick the element an invocation works on, so prefix sums and compaction follow the element order
+uint workgroupLocalIndex()
+{
+	return gl_SubgroupID * gl_SubgroupSize + gl_SubgroupInvocationID;
+}
+
+// Exchanges the subgroup totals, returns the sum of the totals of all previous subgroups and the total of the workgroup
+uint workgroupSubgroupOffset(uint subgroupTotal, out uint total)
+{
+	if (subgroupElect())
+	{
+		subgroupTotals[gl_SubgroupID] = subgroupTotal;
+	}
+	barrier();
+	uint offset = 0;
+	total = 0;
+	for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize)
+	{
+		uint value = subgroupTotals[i];
+		offset += (i < gl_SubgroupID) ? value : 0;
+		total += value;
+	}
+	offset = subgroupAdd(offset);
+	total = subgroupAdd(total);
+	// Shared memory may be reused by the next call
+	barrier();
+	return offset;
+}
+
+// Sum of the values of all invocations of the workgroup
+uint workgroupAdd(uint value)
+{
+	uint total;
+	workgroupSubgroupOffset(subgroupAdd(value), total);
+	return total;
+}
+
+// Exclusive prefix sum over the workgroup in the order of workgroupLocalIndex, total receives the sum of all values
+uint workgroupExclusiveAdd(uint value, out uint total)
+{
+	return workgroupSubgroupOffset(subgroupAdd(value), total) + subgroupExclusiveAdd(value);
+}
+
+// Stream compaction: Returns the position of a kept element among the kept elements of the workgroup (in the order of workgroupLocalIndex), count receives the number of kept elements
+uint workgroupCompact(bool keep, out uint count)
+{
+	uvec4 ballot = subgroupBallot(keep);
+	return workgroupSubgroupOffset(subgroupBallotBitCount(ballot), count) + subgroupBallotExclusiveBitCount(ballot);
+}
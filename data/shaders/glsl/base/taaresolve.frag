@@ -0,0 +1,83 @@
+#version 450
+
+// Temporal anti-aliasing resolve: Blends the jittered scene into the reprojected history, which is clipped to the scene's local color range first
+
+layout (binding = 0) uniform sampler2D samplerScene;
+layout (binding = 1) uniform sampler2D samplerVelocity;
+layout (binding = 2) uniform sampler2D samplerHistory;
+
+layout (push_constant) uniform PushConstants {
+	// 1 / size of the images
+	vec2 texelSize;
+	// Weight of the history
+	float feedback;
+} pushConstants;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+// The color range is estimated in YCoCg, which separates luminance from chrominance and gives a tighter box than RGB
+vec3 RGBToYCoCg(vec3 c)
+{
+	return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 YCoCgToRGB(vec3 c)
+{
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Clip the history towards the center of the box instead of clamping each channel, which would shift its hue
+vec3 clipToBox(vec3 history, vec3 boxMin, vec3 boxMax)
+{
+	vec3 center = 0.5 * (boxMax + boxMin);
+	vec3 extents = 0.5 * (boxMax - boxMin) + 1.0e-4;
+	vec3 offset = history - center;
+	vec3 units = abs(offset / extents);
+	float maxUnit = max(units.x, max(units.y, units.z));
+	return (maxUnit > 1.0) ? center + offset / maxUnit : history;
+}
+
+void main()
+{
+	// Color moments of the 3x3 neighbourhood and the longest velocity of it, so edges of moving objects reproject with the object
+	vec3 current = vec3(0.0);
+	vec3 m1 = vec3(0.0);
+	vec3 m2 = vec3(0.0);
+	vec3 boxMin = vec3(1.0e10);
+	vec3 boxMax = vec3(-1.0e10);
+	vec2 velocity = vec2(0.0);
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			vec2 uv = inUV + vec2(x, y) * pushConstants.texelSize;
+			vec3 c = RGBToYCoCg(texture(samplerScene, uv).rgb);
+			if ((x == 0) && (y == 0)) {
+				current = c;
+			}
+			m1 += c;
+			m2 += c * c;
+			boxMin = min(boxMin, c);
+			boxMax = max(boxMax, c);
+			vec2 v = texture(samplerVelocity, uv).xy;
+			if (dot(v, v) > dot(velocity, velocity)) {
+				velocity = v;
+			}
+		}
+	}
+
+	// Narrow the box to the variance of the neighbourhood, which rejects more stale history in low contrast areas
+	vec3 mean = m1 / 9.0;
+	vec3 stddev = sqrt(max(m2 / 9.0 - mean * mean, 0.0));
+	boxMin = max(boxMin, mean - stddev);
+	boxMax = min(boxMax, mean + stddev);
+
+	vec2 historyUV = inUV - velocity;
+	vec3 history = RGBToYCoCg(texture(samplerHistory, historyUV).rgb);
+	history = clipToBox(history, boxMin, boxMax);
+
+	// Pixels that were outside of the view in the previous frame have no history
+	float feedback = (any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0)))) ? 0.0 : pushConstants.feedback;
+
+	outFragColor = vec4(YCoCgToRGB(mix(current, history, feedback)), 1.0);
+}
@@ -7,6 +7,8 @@ layout (location = 2) in vec4 inColor;
 layout (push_constant) uniform PushConstants {
 	vec2 scale;
 	vec2 translate;
+	// Columns of the rotation into pre-rotated swap chain images
+	vec4 rotation;
 } pushConstants;
 
 layout (location = 0) out vec2 outUV;
@@ -21,5 +23,6 @@ void main()
 {
 	outUV = inUV;
 	outColor = inColor;
-	gl_Position = vec4(inPos * pushConstants.scale + pushConstants.translate, 0.0, 1.0);
+	vec2 pos = inPos * pushConstants.scale + pushConstants.translate;
+	gl_Position = vec4(pos.x * pushConstants.rotation.xy + pos.y * pushConstants.rotation.zw, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 450
+
+// Composites the cached UI overlay layer, which has the size of the frame and stores premultiplied colors
+
+layout (binding = 0) uniform sampler2D samplerLayer;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+	outColor = texelFetch(samplerLayer, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,51 @@
+#version 450
+
+// Upscales the scene rendered at a reduced resolution to the swap chain with a contrast adaptive sharpening filter
+
+layout (binding = 0) uniform sampler2D samplerScene;
+
+layout (push_constant) uniform PushConstants {
+	// Size of the area the scene has been rendered to
+	vec2 renderSize;
+	// 1 / size of the scene image
+	vec2 texelSize;
+	// Negative to copy the scene without sharpening
+	float sharpness;
+} pushConstants;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+vec3 fetch(vec2 uv)
+{
+	// Don't filter across the edge of the render area, the rest of the image contains stale data
+	vec2 maxUV = (pushConstants.renderSize - 0.5) * pushConstants.texelSize;
+	return texture(samplerScene, clamp(uv, 0.5 * pushConstants.texelSize, maxUV)).rgb;
+}
+
+void main()
+{
+	vec2 uv = inUV * pushConstants.renderSize * pushConstants.texelSize;
+
+	// Bilinear upscale of the center and its neighbours one source texel apart
+	vec3 c = fetch(uv);
+	// A negative sharpness is passed at native resolution, where the scene is copied as is
+	if (pushConstants.sharpness < 0.0) {
+		outFragColor = vec4(c, 1.0);
+		return;
+	}
+	vec3 n = fetch(uv + vec2(0.0, -pushConstants.texelSize.y));
+	vec3 s = fetch(uv + vec2(0.0, pushConstants.texelSize.y));
+	vec3 e = fetch(uv + vec2(pushConstants.texelSize.x, 0.0));
+	vec3 w = fetch(uv + vec2(-pushConstants.texelSize.x, 0.0));
+
+	// Sharpen less where the local contrast is already high to avoid ringing
+	vec3 minRGB = min(c, min(min(n, s), min(e, w)));
+	vec3 maxRGB = max(c, max(max(n, s), max(e, w)));
+	vec3 amplitude = sqrt(clamp(min(minRGB, 1.0 - maxRGB) / max(maxRGB, vec3(1.0e-4)), 0.0, 1.0));
+	vec3 weight = amplitude * (-1.0 / mix(8.0, 5.0, pushConstants.sharpness));
+
+	vec3 color = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+	outFragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,76 @@
+// Programmable vertex pulling for vkglTF models (see vkglTF::Model::prepareVertexPulling)
+// Vertex components are fetched from the model's vertex buffer and decoded as described by its layout, so the same shader works with the full and the compact vertex layout
+// Define VERTEX_PULLING_SET to the set index of the vertex pulling descriptor set before including this file
+
+#define VERTEX_COMPONENT_POSITION 0
+#define VERTEX_COMPONENT_NORMAL 1
+#define VERTEX_COMPONENT_UV 2
+#define VERTEX_COMPONENT_COLOR 3
+#define VERTEX_COMPONENT_TANGENT 4
+#define VERTEX_COMPONENT_JOINT0 5
+#define VERTEX_COMPONENT_WEIGHT0 6
+
+// Matches vkglTF::Model::VertexPulling::Format
+#define VERTEX_FORMAT_UNDEFINED 0
+#define VERTEX_FORMAT_FLOAT2 1
+#define VERTEX_FORMAT_FLOAT3 2
+#define VERTEX_FORMAT_FLOAT4 3
+#define VERTEX_FORMAT_HALF2 4
+#define VERTEX_FORMAT_SNORM10X3 5
+#define VERTEX_FORMAT_SNORM16X4 6
+#define VERTEX_FORMAT_UNORM8X4 7
+#define VERTEX_FORMAT_UINT8X4 8
+#define VERTEX_FORMAT_UINT16X4 9
+
+layout (std430, set = VERTEX_PULLING_SET, binding = 0) readonly buffer VertexPullingData
+{
+	uint vertexData[];
+};
+
+layout (std140, set = VERTEX_PULLING_SET, binding = 1) uniform VertexPullingLayout
+{
+	// Byte offsets and formats indexed by component
+	uvec4 offsets[2];
+	uvec4 formats[2];
+	uint stride;
+} vertexLayout;
+
+float unpackSnorm10(uint bits)
+{
+	return max(float(int(bits << 22) >> 22) / 511.0, -1.0);
+}
+
+// Returns defaultValue for components the layout doesn't store, and its remaining members for components with less than four channels
+vec4 pullVertexComponent(uint vertexIndex, uint component, vec4 defaultValue)
+{
+	uint format = vertexLayout.formats[component / 4][component % 4];
+	// All components are four byte aligned
+	uint address = (vertexIndex * vertexLayout.stride + vertexLayout.offsets[component / 4][component % 4]) / 4;
+	switch (format) {
+		case VERTEX_FORMAT_FLOAT2:
+			return vec4(uintBitsToFloat(vertexData[address]), uintBitsToFloat(vertexData[address + 1]), defaultValue.zw);
+		case VERTEX_FORMAT_FLOAT3:
+			return vec4(uintBitsToFloat(vertexData[address]), uintBitsToFloat(vertexData[address + 1]), uintBitsToFloat(vertexData[address + 2]), defaultValue.w);
+		case VERTEX_FORMAT_FLOAT4:
+			return uintBitsToFloat(uvec4(vertexData[address], vertexData[address + 1], vertexData[address + 2], vertexData[address + 3]));
+		case VERTEX_FORMAT_HALF2:
+			return vec4(unpackHalf2x16(vertexData[address]), defaultValue.zw);
+		case VERTEX_FORMAT_SNORM10X3: {
+			uint bits = vertexData[address];
+			return vec4(unpackSnorm10(bits), unpackSnorm10(bits >> 10), unpackSnorm10(bits >> 20), max(float(int(bits) >> 30), -1.0));
+		}
+		case VERTEX_FORMAT_SNORM16X4:
+			return vec4(unpackSnorm2x16(vertexData[address]), unpackSnorm2x16(vertexData[address + 1]));
+		case VERTEX_FORMAT_UNORM8X4:
+			return unpackUnorm4x8(vertexData[address]);
+		case VERTEX_FORMAT_UINT8X4: {
+			uint bits = vertexData[address];
+			return vec4(uvec4(bits, bits >> 8, bits >> 16, bits >> 24) & 0xFFu);
+		}
+		case VERTEX_FORMAT_UINT16X4: {
+			uvec2 bits = uvec2(vertexData[address], vertexData[address + 1]);
+			return vec4(uvec4(bits.x, bits.x >> 16, bits.y, bits.y >> 16) & 0xFFFFu);
+		}
+	}
+	return defaultValue;
+}
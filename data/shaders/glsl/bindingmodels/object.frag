@@ -0,0 +1,13 @@
+#version 450
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	const vec3 lightDir = normalize(vec3(-0.5, -1.0, -0.3));
+	float diffuse = max(dot(normalize(inNormal), lightDir), 0.0);
+	outFragColor = vec4(inColor * (0.25 + 0.75 * diffuse), 1.0);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+} uboScene;
+
+// Per-object data pushed before each draw
+layout (push_constant) uniform PushConsts {
+	vec4 position;
+	vec4 color;
+} object;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	outNormal = inNormal;
+	outColor = object.color.rgb;
+	// The w component of the position stores the object's scale
+	gl_Position = uboScene.projection * uboScene.view * vec4(inPos * object.position.w + object.position.xyz, 1.0);
+}
@@ -0,0 +1,41 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+// Per-instance attribute, the draw's first instance selects the object
+layout (location = 2) in uint inObjectIndex;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+} uboScene;
+
+struct Object
+{
+	vec4 position;
+	vec4 color;
+};
+
+// Data of all objects
+layout (std430, set = 1, binding = 0) readonly buffer Objects
+{
+	Object objects[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	Object object = objects[inObjectIndex];
+	outNormal = inNormal;
+	outColor = object.color.rgb;
+	// The w component of the position stores the object's scale
+	gl_Position = uboScene.projection * uboScene.view * vec4(inPos * object.position.w + object.position.xyz, 1.0);
+}
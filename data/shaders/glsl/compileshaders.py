@@ -32,7 +32,7 @@ dir_path = os.path.dirname(os.path.realpath(__file__))
 dir_path = dir_path.replace('\\', '/')
 for root, dirs, files in os.walk(dir_path):
     for file in files:
-        if file.endswith(".vert") or file.endswith(".frag") or file.endswith(".comp") or file.endswith(".geom") or file.endswith(".tesc") or file.endswith(".tese") or file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rmiss"):
+        if file.endswith(".vert") or file.endswith(".frag") or file.endswith(".comp") or file.endswith(".geom") or file.endswith(".tesc") or file.endswith(".tese") or file.endswith(".mesh") or file.endswith(".task") or file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rahit") or file.endswith(".rmiss"):
             input_file = os.path.join(root, file)
             output_file = input_file + ".spv"
 
@@ -40,8 +40,13 @@ for root, dirs, files in os.walk(dir_path):
             if args.g:
                 add_params = "-g"
 
-            if file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rmiss"):
+            if file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rahit") or file.endswith(".rmiss"):
                add_params = add_params + " --target-env vulkan1.2"
+            else:
+                # Subgroup operations require SPIR-V 1.3
+                with open(input_file) as f:
+                    if "GL_KHR_shader_subgroup" in f.read():
+                        add_params = add_params + " --target-env vulkan1.1"
 
             res = subprocess.call("%s -V %s -o %s %s" % (glslang_path, input_file, output_file, add_params), shell=True)
             # res = subprocess.call([glslang_path, '-V', input_file, '-o', output_file, add_params], shell=True)
@@ -2,6 +2,8 @@
 
 layout (location = 0) in vec3 inPos;
 layout (location = 2) in vec3 inNormal;
+// Per instance collider, xyz = position, w = radius
+layout (location = 3) in vec4 inCollider;
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outViewVec;
@@ -21,9 +23,9 @@ out gl_PerVertex
 
 void main () 
 {
-	vec4 eyePos = ubo.modelview * vec4(inPos.x, inPos.y, inPos.z, 1.0); 
+	vec4 pos = vec4(inPos * inCollider.w + inCollider.xyz, 1.0);
+	vec4 eyePos = ubo.modelview * pos;
 	gl_Position = ubo.projection * eyePos;
-	vec4 pos = vec4(inPos, 1.0);
 	vec3 lPos = ubo.lightPos.xyz;
 	outLightVec = lPos - pos.xyz;
 	outViewVec = -pos.xyz;
@@ -0,0 +1,6 @@
+#version 450
+
+void main()
+{
+	// Only the depth test is of interest, color writes are disabled by the pipeline
+}
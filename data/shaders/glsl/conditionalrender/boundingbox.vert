@@ -0,0 +1,30 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform UBO {
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+} ubo;
+
+layout (set = 1, binding = 0) uniform Node {
+	mat4 matrix;
+} node;
+
+layout(push_constant) uniform PushBlock {
+	vec4 min;
+	vec4 max;
+} box;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	// Unit cube as a triangle strip of 14 vertices, the corner is selected by the bits of the vertex index
+	uint bit = 1u << gl_VertexIndex;
+	vec3 corner = vec3((0x287au & bit) != 0u ? 1.0 : 0.0, (0x02afu & bit) != 0u ? 1.0 : 0.0, (0x31e3u & bit) != 0u ? 1.0 : 0.0);
+	vec3 pos = mix(box.min.xyz, box.max.xyz, corner);
+	gl_Position = ubo.projection * ubo.view * ubo.model * node.matrix * vec4(pos, 1.0);
+}
@@ -0,0 +1,142 @@
+#version 450
+
+// Packed G-Buffer written in the previous subpass
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput inputDepth;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput inputNormal;
+layout (input_attachment_index = 2, binding = 3) uniform subpassInput inputAlbedo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+// Light clustering grid, must match the cluster compute shader
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 8
+#define CLUSTER_COUNT_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 512
+
+struct Light {
+	// xyz = position, w = range
+	vec4 position;
+	vec3 color;
+	float radius;
+};
+
+layout (binding = 4) uniform UBO 
+{
+	mat4 inverseProjection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 viewPos;
+	// x = near plane, y = far plane
+	vec4 depthRange;
+	int displayDebugTarget;
+	int lightCount;
+	int clustered;
+} ubo;
+
+layout (std430, binding = 5) readonly buffer Lights { Light lights[]; };
+layout (std430, binding = 6) readonly buffer LightGrid { uint lightGrid[]; };
+layout (std430, binding = 7) readonly buffer LightIndices { uint lightIndices[]; };
+
+vec3 decodeNormal(vec2 f)
+{
+	f = f * 2.0 - 1.0;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 shadeLight(Light light, vec3 fragPos, vec3 N, vec3 V, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+	if (dist >= light.position.w) {
+		return vec3(0.0);
+	}
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so it reaches zero at the light's range
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored with the packed normal and passed in alpha of albedo
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+void main() 
+{
+	// Get G-Buffer values
+	// The world space position is reconstructed from depth
+	float depth = subpassLoad(inputDepth).r;
+	vec4 viewPos = ubo.inverseProjection * vec4(inUV * 2.0 - 1.0, depth, 1.0);
+	vec3 fragPos = (ubo.inverseView * vec4(viewPos.xyz / viewPos.w, 1.0)).xyz;
+	vec4 packedNormal = subpassLoad(inputNormal);
+	vec3 normal = decodeNormal(packedNormal.xy);
+	vec4 albedo = vec4(subpassLoad(inputAlbedo).rgb, packedNormal.z);
+	
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				outFragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				outFragcolor.rgb = normal;
+				break;
+			case 3: 
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				outFragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	// Render-target composition
+
+	#define ambient 0.0
+	
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * ambient;
+
+	vec3 N = normalize(normal);
+	// Viewer to fragment
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered == 1) {
+		// Only evaluate the lights binned into the cluster containing this fragment
+		float viewZ = -(ubo.view * vec4(fragPos, 1.0)).z;
+		int slice = int(log(max(viewZ, ubo.depthRange.x) / ubo.depthRange.x) / log(ubo.depthRange.y / ubo.depthRange.x) * float(CLUSTER_COUNT_Z));
+		uvec3 cluster = uvec3(min(uvec2(inUV * vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y)), uvec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1)), clamp(slice, 0, CLUSTER_COUNT_Z - 1));
+		uint clusterIndex = cluster.x + cluster.y * CLUSTER_COUNT_X + cluster.z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			fragcolor += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		// Evaluate all lights for every fragment
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shadeLight(lights[i], fragPos, N, V, albedo);
+		}
+	}
+   
+	outFragcolor = vec4(fragcolor, 1.0);	
+}
@@ -3,7 +3,7 @@
 layout (binding = 1) uniform sampler2D samplerposition;
 layout (binding = 2) uniform sampler2D samplerNormal;
 layout (binding = 3) uniform sampler2D samplerAlbedo;
-layout (binding = 5) uniform sampler2DArray samplerShadowMap;
+layout (binding = 5) uniform sampler2D samplerShadowMap;
 
 layout (location = 0) in vec2 inUV;
 
@@ -20,17 +20,20 @@ struct Light
 	vec4 target;
 	vec4 color;
 	mat4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's tile in the shadow atlas
+	vec4 shadowRect;
 };
 
 layout (binding = 4) uniform UBO 
 {
 	vec4 viewPos;
+	mat4 inverseViewProjection;
 	Light lights[LIGHT_COUNT];
 	int useShadows;
 	int debugDisplayTarget;
 } ubo;
 
-float textureProj(vec4 P, float layer, vec2 offset)
+float textureProj(vec4 P, vec4 rect, vec2 offset)
 {
 	float shadow = 1.0;
 	vec4 shadowCoord = P / P.w;
@@ -38,7 +41,11 @@ float textureProj(vec4 P, float layer, vec2 offset)
 	
 	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) 
 	{
-		float dist = texture(samplerShadowMap, vec3(shadowCoord.st + offset, layer)).r;
+		// Map into the light's tile of the shadow atlas, samples are kept half a texel inside the tile so filtering doesn't pick up its neighbours
+		vec2 halfTexel = 0.5 / vec2(textureSize(samplerShadowMap, 0));
+		vec2 uv = rect.xy + clamp(shadowCoord.st + offset, 0.0, 1.0) * rect.zw;
+		uv = clamp(uv, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = texture(samplerShadowMap, uv).r;
 		if (shadowCoord.w > 0.0 && dist < shadowCoord.z) 
 		{
 			shadow = SHADOW_FACTOR;
@@ -47,12 +54,13 @@ float textureProj(vec4 P, float layer, vec2 offset)
 	return shadow;
 }
 
-float filterPCF(vec4 sc, float layer)
+float filterPCF(vec4 sc, vec4 rect)
 {
-	ivec2 texDim = textureSize(samplerShadowMap, 0).xy;
+	// Offsets are in the tile's coordinates, so they're scaled by the tile's size in texels
+	vec2 texDim = vec2(textureSize(samplerShadowMap, 0)) * rect.zw;
 	float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
 
 	float shadowFactor = 0.0;
 	int count = 0;
@@ -62,7 +70,7 @@ float filterPCF(vec4 sc, float layer)
 	{
 		for (int y = -range; y <= range; y++)
 		{
-			shadowFactor += textureProj(sc, layer, vec2(dx*x, dy*y));
+			shadowFactor += textureProj(sc, rect, vec2(dx*x, dy*y));
 			count++;
 		}
 	
@@ -73,13 +81,20 @@ float filterPCF(vec4 sc, float layer)
 vec3 shadow(vec3 fragcolor, vec3 fragpos) {
 	for(int i = 0; i < LIGHT_COUNT; ++i)
 	{
+		// Lights without a tile in the shadow atlas don't cast shadows
+		vec4 rect = ubo.lights[i].shadowRect;
+		if (rect.z == 0.0)
+		{
+			continue;
+		}
+
 		vec4 shadowClip	= ubo.lights[i].viewMatrix * vec4(fragpos, 1.0);
 
 		float shadowFactor;
 		#ifdef USE_PCF
-			shadowFactor= filterPCF(shadowClip, i);
+			shadowFactor= filterPCF(shadowClip, rect);
 		#else
-			shadowFactor = textureProj(shadowClip, i, vec2(0.0));
+			shadowFactor = textureProj(shadowClip, rect, vec2(0.0));
 		#endif
 
 		fragcolor *= shadowFactor;
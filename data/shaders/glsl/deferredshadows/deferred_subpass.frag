@@ -0,0 +1,198 @@
+#version 450
+
+// Packed G-Buffer written in the previous subpass
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput inputDepth;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput inputNormal;
+layout (input_attachment_index = 2, binding = 3) uniform subpassInput inputAlbedo;
+layout (binding = 5) uniform sampler2D samplerShadowMap;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define LIGHT_COUNT 3
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.1
+#define USE_PCF
+
+struct Light 
+{
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's tile in the shadow atlas
+	vec4 shadowRect;
+};
+
+layout (binding = 4) uniform UBO 
+{
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[LIGHT_COUNT];
+	int useShadows;
+	int debugDisplayTarget;
+} ubo;
+
+vec3 decodeNormal(vec2 f)
+{
+	f = f * 2.0 - 1.0;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+float textureProj(vec4 P, vec4 rect, vec2 offset)
+{
+	float shadow = 1.0;
+	vec4 shadowCoord = P / P.w;
+	shadowCoord.st = shadowCoord.st * 0.5 + 0.5;
+	
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) 
+	{
+		// Map into the light's tile of the shadow atlas, samples are kept half a texel inside the tile so filtering doesn't pick up its neighbours
+		vec2 halfTexel = 0.5 / vec2(textureSize(samplerShadowMap, 0));
+		vec2 uv = rect.xy + clamp(shadowCoord.st + offset, 0.0, 1.0) * rect.zw;
+		uv = clamp(uv, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = texture(samplerShadowMap, uv).r;
+		if (shadowCoord.w > 0.0 && dist < shadowCoord.z) 
+		{
+			shadow = SHADOW_FACTOR;
+		}
+	}
+	return shadow;
+}
+
+float filterPCF(vec4 sc, vec4 rect)
+{
+	// Offsets are in the tile's coordinates, so they're scaled by the tile's size in texels
+	vec2 texDim = vec2(textureSize(samplerShadowMap, 0)) * rect.zw;
+	float scale = 1.5;
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 1;
+	
+	for (int x = -range; x <= range; x++)
+	{
+		for (int y = -range; y <= range; y++)
+		{
+			shadowFactor += textureProj(sc, rect, vec2(dx*x, dy*y));
+			count++;
+		}
+	
+	}
+	return shadowFactor / count;
+}
+
+vec3 shadow(vec3 fragcolor, vec3 fragpos) {
+	for(int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		// Lights without a tile in the shadow atlas don't cast shadows
+		vec4 rect = ubo.lights[i].shadowRect;
+		if (rect.z == 0.0)
+		{
+			continue;
+		}
+
+		vec4 shadowClip	= ubo.lights[i].viewMatrix * vec4(fragpos, 1.0);
+
+		float shadowFactor;
+		#ifdef USE_PCF
+			shadowFactor= filterPCF(shadowClip, rect);
+		#else
+			shadowFactor = textureProj(shadowClip, rect, vec2(0.0));
+		#endif
+
+		fragcolor *= shadowFactor;
+	}
+	return fragcolor;
+}
+
+void main() 
+{
+	// Get G-Buffer values
+	// The world space position is reconstructed from depth
+	vec4 worldPos = ubo.inverseViewProjection * vec4(inUV * 2.0 - 1.0, subpassLoad(inputDepth).r, 1.0);
+	vec3 fragPos = worldPos.xyz / worldPos.w;
+	vec4 packedNormal = subpassLoad(inputNormal);
+	vec3 normal = decodeNormal(packedNormal.xy);
+	// Specular is stored with the packed normal
+	vec4 albedo = vec4(subpassLoad(inputAlbedo).rgb, packedNormal.z);
+
+	// Debug display
+	if (ubo.debugDisplayTarget > 0) {
+		switch (ubo.debugDisplayTarget) {
+			case 1: 
+				outFragColor.rgb = shadow(vec3(1.0), fragPos).rgb;
+				break;
+			case 2: 
+				outFragColor.rgb = fragPos;
+				break;
+			case 3: 
+				outFragColor.rgb = normal;
+				break;
+			case 4: 
+				outFragColor.rgb = albedo.rgb;
+				break;
+			case 5: 
+				outFragColor.rgb = albedo.aaa;
+				break;
+		}		
+		outFragColor.a = 1.0;
+		return;
+	}
+
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * AMBIENT_LIGHT;
+
+	vec3 N = normalize(normal);
+		
+	for(int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		// Vector to light
+		vec3 L = ubo.lights[i].position.xyz - fragPos;
+		// Distance from light to fragment position
+		float dist = length(L);
+		L = normalize(L);
+
+		// Viewer to fragment
+		vec3 V = ubo.viewPos.xyz - fragPos;
+		V = normalize(V);
+
+		float lightCosInnerAngle = cos(radians(15.0));
+		float lightCosOuterAngle = cos(radians(25.0));
+		float lightRange = 100.0;
+
+		// Direction vector from source to target
+		vec3 dir = normalize(ubo.lights[i].position.xyz - ubo.lights[i].target.xyz);
+
+		// Dual cone spot light with smooth transition between inner and outer angle
+		float cosDir = dot(L, dir);
+		float spotEffect = smoothstep(lightCosOuterAngle, lightCosInnerAngle, cosDir);
+		float heightAttenuation = smoothstep(lightRange, 0.0f, dist);
+
+		// Diffuse lighting
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = vec3(NdotL);
+
+		// Specular lighting
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = vec3(pow(NdotR, 16.0) * albedo.a * 2.5);
+
+		fragcolor += vec3((diff + spec) * spotEffect * heightAttenuation) * ubo.lights[i].color.rgb * albedo.rgb;
+	}    	
+
+	// Shadow calculations in a separate pass
+	if (ubo.useShadows > 0)
+	{
+		fragcolor = shadow(fragcolor, fragPos);
+	}
+
+	outFragColor = vec4(fragcolor, 1.0);
+}
\ No newline at end of file
@@ -1,11 +1,22 @@
 #version 450
 
+#define LIGHT_COUNT 3
+
 layout (location = 0) in vec4 inPos;
 
-layout (location = 0) out int outInstanceIndex;
+layout (binding = 0) uniform UBO 
+{
+	mat4 mvp[LIGHT_COUNT];
+	vec4 instancePos[3];
+} ubo;
+
+// Light whose tile of the shadow atlas is rendered
+layout (push_constant) uniform PushConsts 
+{
+	int light;
+} pushConsts;
 
 void main()
 {
-	outInstanceIndex = gl_InstanceIndex;
-	gl_Position = inPos;
-}
\ No newline at end of file
+	gl_Position = ubo.mvp[pushConsts.light] * (inPos + ubo.instancePos[gl_InstanceIndex]);
+}
@@ -0,0 +1,42 @@
+#version 450
+
+// Multi-channel signed distance field font, the median of the color channels is the distance to the glyph's outline
+
+layout (binding = 1) uniform sampler2D samplerColor;
+
+layout (binding = 2) uniform UBO 
+{
+	vec4 outlineColor;
+	float outlineWidth;
+	float outline;
+	// Width of the distance field's transition in atlas texels
+	float distanceRange;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+float median(vec3 value)
+{
+	return max(min(value.r, value.g), min(max(value.r, value.g), value.b));
+}
+
+void main() 
+{
+	float distance = median(texture(samplerColor, inUV).rgb);
+	// Number of screen pixels covered by the distance range, the edge transition is kept at about one pixel at any scale
+	vec2 unitRange = vec2(ubo.distanceRange) / vec2(textureSize(samplerColor, 0));
+	float screenPxRange = max(0.5 * dot(unitRange, 1.0 / fwidth(inUV)), 1.0);
+	float alpha = clamp((distance - 0.5) * screenPxRange + 0.5, 0.0, 1.0);
+	vec3 rgb = vec3(alpha);
+
+	if (ubo.outline > 0.0) 
+	{
+		float w = 1.0 - ubo.outlineWidth;
+		alpha = clamp((distance - w) * screenPxRange + 0.5, 0.0, 1.0);
+		rgb += mix(vec3(alpha), ubo.outlineColor.rgb, alpha);
+	}
+
+	outFragColor = vec4(rgb, alpha);
+}
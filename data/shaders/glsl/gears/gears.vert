@@ -1,18 +1,35 @@
 #version 450
 
-layout (location = 0) in vec4 inPos;
+layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec3 inColor;
+// Index of a visible instance, per instance attribute sourced from the culling output
+layout (location = 2) in uint inInstanceIndex;
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
-	mat4 model;
-	mat4 normal;
 	mat4 view;
-	vec3 lightpos;
+	vec4 lightPos;
+	vec4 frustumPlanes[6];
+	float time;
+	uint instanceCount;
 } ubo;
 
+struct Gear
+{
+	// xyz = position, w = rotation offset in degrees
+	vec4 position;
+	// rgb = color, w = rotation speed
+	vec4 color;
+	uint profile;
+	float radius;
+};
+
+layout (std430, binding = 1) readonly buffer Instances
+{
+	Gear instances[];
+};
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outEyePos;
@@ -20,12 +37,19 @@ layout (location = 3) out vec3 outLightVec;
 
 void main() 
 {
-	outNormal = normalize(mat3(ubo.normal) * inNormal);
-	outColor = inColor;
-	mat4 modelView = ubo.view * ubo.model;
-	vec4 pos = modelView * inPos;	
-	outEyePos = vec3(modelView * pos);
-	vec4 lightPos = vec4(ubo.lightpos, 1.0) * modelView;
-	outLightVec = normalize(lightPos.xyz - outEyePos);
+	Gear gear = instances[inInstanceIndex];
+
+	float angle = radians(gear.color.w * ubo.time + gear.position.w);
+	mat3 rotation = mat3(
+		cos(angle), sin(angle), 0.0,
+		-sin(angle), cos(angle), 0.0,
+		0.0, 0.0, 1.0);
+
+	vec4 pos = ubo.view * vec4(rotation * inPos + gear.position.xyz, 1.0);
+	outNormal = normalize(mat3(ubo.view) * rotation * inNormal);
+	outColor = gear.color.rgb;
+	outEyePos = pos.xyz;
+	vec3 lightPos = (ubo.view * ubo.lightPos).xyz;
+	outLightVec = normalize(lightPos - outEyePos);
 	gl_Position = ubo.projection * pos;
-}
\ No newline at end of file
+}
@@ -0,0 +1,40 @@
+#version 450
+
+// Draws the normal lines written by normaldebug.comp, two vertices per line without any vertex input
+
+layout (binding = 1) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+} ubo;
+
+struct Line
+{
+	vec3 pos;
+	uint normal;
+};
+
+layout (std430, binding = 2) readonly buffer Lines
+{
+	Line lines[];
+};
+
+layout (location = 0) out vec3 outColor;
+
+void main(void)
+{
+	float normalLength = 0.02;
+	Line line = lines[gl_VertexIndex / 2];
+	vec3 pos = line.pos;
+	// Odd vertices are the ends of the lines
+	if ((gl_VertexIndex & 1) == 1)
+	{
+		pos += unpackSnorm4x8(line.normal).xyz * normalLength;
+		outColor = vec3(0.0, 0.0, 1.0);
+	}
+	else
+	{
+		outColor = vec3(1.0, 0.0, 0.0);
+	}
+	gl_Position = ubo.projection * (ubo.model * vec4(pos, 1.0));
+}
@@ -0,0 +1,26 @@
+#version 450
+
+// Vertex attributes, fetched from the geometry pool
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec4 inColor;
+
+// Instanced attributes, selected by the first instance of the indirect draw
+layout (location = 3) in vec4 instancePosScale;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+
+void main() 
+{
+	outNormal = inNormal;
+	outColor = inColor.rgb;
+	vec3 pos = inPos * instancePosScale.w + instancePosScale.xyz;
+	gl_Position = ubo.projection * ubo.view * vec4(pos, 1.0);
+}
@@ -0,0 +1,89 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+layout (location = 4) in vec4 inJointIndices;
+layout (location = 5) in vec4 inJointWeights;
+// Per instance
+layout (location = 6) in vec4 instancePositionRotation;
+layout (location = 7) in vec2 instanceAnimation;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+	// x = time, y = frame rate, z = frame count, w = joint count
+	vec4 crowdAnimation;
+} uboScene;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+} primitive;
+
+// Joint matrices of all frames of the baked animation, stored frame after frame
+layout(std430, set = 1, binding = 0) readonly buffer BakedJointMatrices {
+	mat4 bakedJointMatrices[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+
+uint frame0;
+uint frame1;
+float frameBlend;
+uint jointCount;
+
+// Interpolate the joint's matrix between the two baked frames surrounding the instance's animation time
+mat4 jointMatrix(float jointIndex)
+{
+	uint joint = uint(jointIndex);
+	return bakedJointMatrices[frame0 * jointCount + joint] * (1.0 - frameBlend) + bakedJointMatrices[frame1 * jointCount + joint] * frameBlend;
+}
+
+void main() 
+{
+	outColor = inColor;
+	outUV = inUV;
+
+	// Each instance plays the animation at its own offset and speed
+	float frameCount = uboScene.crowdAnimation.z;
+	float time = (uboScene.crowdAnimation.x + instanceAnimation.x) * instanceAnimation.y;
+	float frame = fract(time * uboScene.crowdAnimation.y / frameCount) * frameCount;
+	frame0 = uint(frame) % uint(frameCount);
+	frame1 = (frame0 + 1) % uint(frameCount);
+	frameBlend = fract(frame);
+	jointCount = uint(uboScene.crowdAnimation.w);
+
+	// Calculate skinned matrix from weights and joint indices of the current vertex
+	mat4 skinMat = 
+		inJointWeights.x * jointMatrix(inJointIndices.x) +
+		inJointWeights.y * jointMatrix(inJointIndices.y) +
+		inJointWeights.z * jointMatrix(inJointIndices.z) +
+		inJointWeights.w * jointMatrix(inJointIndices.w);
+
+	// Place the instance
+	float s = sin(instancePositionRotation.w);
+	float c = cos(instancePositionRotation.w);
+	mat4 instanceMat = mat4(
+		vec4(c, 0.0, -s, 0.0),
+		vec4(0.0, 1.0, 0.0, 0.0),
+		vec4(s, 0.0, c, 0.0),
+		vec4(instancePositionRotation.xyz, 1.0));
+
+	mat4 model = instanceMat * primitive.model * skinMat;
+	vec4 worldPos = model * vec4(inPos.xyz, 1.0);
+	gl_Position = uboScene.projection * uboScene.view * worldPos;
+	
+	outNormal = normalize(transpose(inverse(mat3(uboScene.view * model))) * inNormal);
+
+	vec4 pos = uboScene.view * worldPos;
+	vec3 lPos = mat3(uboScene.view) * uboScene.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;
+}
@@ -3,11 +3,24 @@
 layout (binding = 0) uniform sampler2D samplerColor0;
 layout (binding = 1) uniform sampler2D samplerColor1;
 
+layout (binding = 2) uniform Params {
+	float exposure;
+	int autoExposure;
+} params;
+
+// Exposure adapted to the scene luminance by the compute shaders
+layout (binding = 3) readonly buffer LuminanceData {
+	float averageLuminance;
+	float exposure;
+} luminanceData;
+
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outColor;
 
 void main() 
 {
-	outColor = texture(samplerColor0, inUV);
+	vec4 color = texture(samplerColor0, inUV);
+	float exposure = (params.autoExposure == 1) ? luminanceData.exposure : params.exposure;
+	outColor = vec4(vec3(1.0) - exp(-color.rgb * exposure), color.a);
 }
\ No newline at end of file
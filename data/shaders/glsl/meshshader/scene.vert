@@ -0,0 +1,39 @@
+#version 450
+
+// Vertex pipeline used as baseline for the meshlet pipeline, outputs the same as meshlet.mesh
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+layout (location = 4) in vec4 inTangent;
+
+layout (set = 0, binding = 0) uniform UBOScene
+{
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+	vec4 viewPos;
+	vec4 frustumPlanes[6];
+	uint frustumCulling;
+	uint coneCulling;
+	uint colorMeshlets;
+} uboScene;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outTangent;
+
+void main()
+{
+	outNormal = inNormal;
+	outColor = inColor;
+	outUV = inUV;
+	outTangent = inTangent;
+	gl_Position = uboScene.projection * uboScene.view * vec4(inPos, 1.0);
+	outLightVec = uboScene.lightPos.xyz - inPos;
+	outViewVec = uboScene.viewPos.xyz - inPos;
+}
@@ -0,0 +1,44 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 lightPos;
+	mat4 prevViewProjection;
+	// xy = current, zw = previous sub-pixel jitter in normalized device coordinates
+	vec4 jitter;
+} ubo;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+layout (location = 5) out vec4 outCurrentPos;
+layout (location = 6) out vec4 outPrevPos;
+
+void main() 
+{
+	outNormal = inNormal;
+	outColor = inColor;
+	outUV = inUV;
+	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	
+	// The scene is static, so the previous position only differs by the camera's motion
+	// The jitter is removed from both positions, it would otherwise make static pixels move
+	outCurrentPos = vec4(gl_Position.xy - ubo.jitter.xy * gl_Position.w, gl_Position.zw);
+	outPrevPos = ubo.prevViewProjection * vec4(inPos.xyz, 1.0);
+	outPrevPos.xy -= ubo.jitter.zw * outPrevPos.w;
+
+	vec4 pos = ubo.model * vec4(inPos, 1.0);
+	outNormal = mat3(ubo.model) * inNormal;
+	vec3 lPos = mat3(ubo.model) * ubo.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;		
+}
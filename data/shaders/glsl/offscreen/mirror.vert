@@ -8,6 +8,7 @@ layout (binding = 0) uniform UBO
 	mat4 projection;
 	mat4 view;
 	mat4 model;
+	mat4 reflectionViewProjection;
 } ubo;
 
 layout (location = 0) out vec2 outUV;
@@ -16,6 +17,7 @@ layout (location = 1) out vec4 outPos;
 void main() 
 {
 	outUV = inUV;
-	outPos = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
-	gl_Position = outPos;		
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
+	// The reflection is sampled with the view projection it has been rendered with, which reprojects it if it's from an earlier frame
+	outPos = ubo.reflectionViewProjection * ubo.model * vec4(inPos.xyz, 1.0);
 }
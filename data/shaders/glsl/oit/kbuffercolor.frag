@@ -0,0 +1,41 @@
+#version 450
+
+// K-buffer second pass: Fragments stored in the k-buffer write their color to their layer,
+// all other (farther) fragments are accumulated with weighted blended transparency
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+layout (set = 0, binding = 1, r32ui) uniform readonly uimage2DArray depthLayers;
+layout (set = 0, binding = 2, r32ui) uniform writeonly uimage2DArray colorLayers;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+    vec4 color = pushConsts.color;
+
+    for (int i = 0; i < K_BUFFER_LAYERS; i++)
+    {
+        if (imageLoad(depthLayers, ivec3(coord, i)).r == depth)
+        {
+            imageStore(colorLayers, ivec3(coord, i), uvec4(packUnorm4x8(color)));
+            // No contribution to the tail
+            outAccumulation = vec4(0.0);
+            outRevealage = 0.0;
+            return;
+        }
+    }
+
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+    outRevealage = color.a;
+}
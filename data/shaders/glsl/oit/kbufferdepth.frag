@@ -0,0 +1,26 @@
+#version 450
+
+// K-buffer first pass: Keeps the depths of the nearest K_BUFFER_LAYERS fragments of each pixel, sorted front to back
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+layout (set = 0, binding = 1, r32ui) uniform uimage2DArray depthLayers;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    // Positive floats keep their order if compared as unsigned integers
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+
+    // Insert into the sorted layers, each layer keeps the smaller depth and passes the larger one on to the next layer
+    for (int i = 0; i < K_BUFFER_LAYERS; i++)
+    {
+        uint prevDepth = imageAtomicMin(depthLayers, ivec3(coord, i), depth);
+        if (prevDepth == 0xffffffff)
+        {
+            break;
+        }
+        depth = max(prevDepth, depth);
+    }
+}
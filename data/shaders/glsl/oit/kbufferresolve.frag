@@ -0,0 +1,35 @@
+#version 450
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 0) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 1) uniform sampler2D samplerRevealage;
+layout (set = 0, binding = 2, r32ui) uniform readonly uimage2DArray depthLayers;
+layout (set = 0, binding = 3, r32ui) uniform readonly uimage2DArray colorLayers;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+
+    // Blend the weighted blended tail (fragments behind the k-buffer) over the background
+    vec4 accumulation = texelFetch(samplerAccumulation, coord, 0);
+    float revealage = texelFetch(samplerRevealage, coord, 0).r;
+    vec3 background = vec3(0.025);
+    vec3 color = mix(accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4), background, revealage);
+
+    // Blend the sorted layers back to front
+    for (int i = K_BUFFER_LAYERS - 1; i >= 0; i--)
+    {
+        if (imageLoad(depthLayers, ivec3(coord, i)).r == 0xffffffff)
+        {
+            continue;
+        }
+        vec4 layer = unpackUnorm4x8(imageLoad(colorLayers, ivec3(coord, i)).r);
+        color = mix(color, layer.rgb, layer.a);
+    }
+
+    outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450
+
+// Weighted blended order independent transparency (McGuire and Bavoil), accumulates all fragments without sorting
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    vec4 color = pushConsts.color;
+
+    // Depth based weight (equation 10 of the paper), closer fragments contribute more to the average color
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+
+    // Additively blended
+    outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+    // Multiplicatively blended (destination * (1 - alpha))
+    outRevealage = color.a;
+}
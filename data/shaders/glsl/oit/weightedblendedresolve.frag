@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 0) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 1) uniform sampler2D samplerRevealage;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(samplerAccumulation, coord, 0);
+    float revealage = texelFetch(samplerRevealage, coord, 0).r;
+
+    // Weighted average of the fragment colors, blended over the background with the total coverage
+    vec3 background = vec3(0.025);
+    vec3 average = accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4);
+    outFragColor = vec4(mix(average, background, revealage), 1.0);
+}
@@ -2,6 +2,8 @@
 
 layout (binding = 1) uniform sampler2D sColorMap;
 layout (binding = 2) uniform sampler2D sNormalHeightMap;
+// Relaxed cone step map (square root of the cone ratio in red, height in green)
+layout (binding = 4) uniform sampler2D sConeStepMap;
 
 layout (binding = 3) uniform UBO 
 {
@@ -9,6 +11,8 @@ layout (binding = 3) uniform UBO
 	float parallaxBias;
 	float numLayers;
 	int mappingMode;
+	int coneSteps;
+	int binarySteps;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -64,6 +68,30 @@ vec2 parallaxOcclusionMapping(vec2 uv, vec3 viewDir)
 	return mix(currUV, prevUV, nextDepth / (nextDepth - prevDepth));
 }
 
+// Relaxed cone stepping (Policarpo and Oliveira, GPU Gems 3), each step advances the ray as far as the cone stored for its current position allows
+// The relaxed cones may let the ray step into the surface once, but never through it, so a short binary search finds the intersection
+vec2 relaxedConeStepMapping(vec2 uv, vec3 viewDir)
+{
+	// Ray in texture space with the depth below the top of the height map in z, scaled to reach the bottom at z = 1
+	vec3 rayDir = vec3(-viewDir.xy * ubo.heightScale / viewDir.z, 1.0);
+	float rayRatio = length(rayDir.xy);
+	vec3 rayPos = vec3(uv, 0.0);
+	for (int i = 0; i < ubo.coneSteps; i++) {
+		vec2 cone = textureLod(sConeStepMap, rayPos.xy, 0.0).rg;
+		float coneRatio = cone.r * cone.r;
+		float depth = clamp((1.0 - cone.g) - rayPos.z, 0.0, 1.0);
+		rayPos += rayDir * (coneRatio * depth / (rayRatio + coneRatio));
+	}
+	vec3 range = 0.5 * rayDir * rayPos.z;
+	vec3 searchPos = rayPos - range;
+	for (int i = 0; i < ubo.binarySteps; i++) {
+		float depth = 1.0 - textureLod(sConeStepMap, searchPos.xy, 0.0).g;
+		range *= 0.5;
+		searchPos += (searchPos.z < depth) ? range : -range;
+	}
+	return searchPos.xy;
+}
+
 void main(void) 
 {
 	vec3 V = normalize(inTangentViewPos - inTangentFragPos);
@@ -83,6 +111,9 @@ void main(void)
 			case 4:
 				uv = parallaxOcclusionMapping(inUV, V);
 				break;
+			case 5:
+				uv = relaxedConeStepMapping(inUV, V);
+				break;
 		}
 
 		// Perform sampling before (potentially) discarding.
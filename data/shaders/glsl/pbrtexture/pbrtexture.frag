@@ -16,6 +16,8 @@ layout (binding = 1) uniform UBOParams {
 	vec4 lights[4];
 	float exposure;
 	float gamma;
+	uint irradianceSH;
+	vec4 shCoefficients[9];
 } uboParams;
 
 layout (binding = 2) uniform samplerCube samplerIrradiance;
@@ -75,6 +77,21 @@ vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Diffuse irradiance (divided by PI) from L2 spherical harmonics
+vec3 irradianceSH(vec3 N)
+{
+	vec3 result = uboParams.shCoefficients[0].rgb * 0.282095;
+	result += uboParams.shCoefficients[1].rgb * 0.488603 * N.y;
+	result += uboParams.shCoefficients[2].rgb * 0.488603 * N.z;
+	result += uboParams.shCoefficients[3].rgb * 0.488603 * N.x;
+	result += uboParams.shCoefficients[4].rgb * 1.092548 * N.x * N.y;
+	result += uboParams.shCoefficients[5].rgb * 1.092548 * N.y * N.z;
+	result += uboParams.shCoefficients[6].rgb * 0.315392 * (3.0 * N.z * N.z - 1.0);
+	result += uboParams.shCoefficients[7].rgb * 1.092548 * N.x * N.z;
+	result += uboParams.shCoefficients[8].rgb * 0.546274 * (N.x * N.x - N.y * N.y);
+	return max(result, vec3(0.0));
+}
+
 vec3 prefilteredReflection(vec3 R, float roughness)
 {
 	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
@@ -146,7 +163,7 @@ void main()
 	
 	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
 	vec3 reflection = prefilteredReflection(R, roughness).rgb;	
-	vec3 irradiance = texture(samplerIrradiance, N).rgb;
+	vec3 irradiance = (uboParams.irradianceSH == 1) ? irradianceSH(N) : texture(samplerIrradiance, N).rgb;
 
 	// Diffuse based on irradiance
 	vec3 diffuse = irradiance * ALBEDO;	
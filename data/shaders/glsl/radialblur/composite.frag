@@ -0,0 +1,13 @@
+#version 450
+
+layout (binding = 1) uniform sampler2D samplerBlur;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// The radial blur has been applied by the compute shader, so upsampling the reduced resolution result is a single bilinear fetch
+	outFragColor = texture(samplerBlur, inUV);
+}
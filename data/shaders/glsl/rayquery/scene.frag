@@ -28,7 +28,12 @@ void main()
 	rayQueryInitializeEXT(rayQuery, topLevelAS, gl_RayFlagsTerminateOnFirstHitEXT, 0xFF, inWorldPos, 0.01, L, 1000.0);
 
 	// Start the ray traversal, rayQueryProceedEXT returns false if the traversal is complete
-	while (rayQueryProceedEXT(rayQuery)) { }
+	while (rayQueryProceedEXT(rayQuery)) {
+		// Alpha masked and blended geometries aren't opaque and return candidates, these also block the light
+		if (rayQueryGetIntersectionTypeEXT(rayQuery, false) == gl_RayQueryCandidateIntersectionTriangleEXT) {
+			rayQueryConfirmIntersectionEXT(rayQuery);
+		}
+	}
 
 	// If the intersection has hit a triangle, the fragment is shadowed
 	if (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionTriangleEXT ) {
@@ -13,6 +13,14 @@ layout (binding = 0) uniform UBO
 	vec3 lightPos;
 } ubo;
 
+// Indirect draw data of the scene (see vks::Scene), selected by the first instance of each draw
+struct DrawData {
+	uint nodeIndex;
+	uint materialIndex;
+};
+layout (std430, set = 1, binding = 0) readonly buffer DrawDataBuffer { DrawData drawData[]; };
+layout (std430, set = 1, binding = 1) readonly buffer NodeMatrices { mat4 nodeMatrices[]; };
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outViewVec;
@@ -21,13 +29,13 @@ layout (location = 4) out vec3 outWorldPos;
 
 void main() 
 {
+	// The vertices have been flipped in the mesh's local space (FlipY), ubo.model flips the node matrix along with them
+	mat4 modelMatrix = ubo.model * nodeMatrices[drawData[gl_InstanceIndex].nodeIndex] * ubo.model;
+	vec4 pos = modelMatrix * vec4(inPos, 1.0);
 	outColor = inColor;
-	outNormal = inNormal;
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
-    vec4 pos = ubo.model * vec4(inPos, 1.0);
-	outWorldPos = vec3(ubo.model * vec4(inPos, 1.0));
-    outNormal = mat3(ubo.model) * inNormal;
-    outLightVec = normalize(ubo.lightPos - inPos);
-    outViewVec = -pos.xyz;
+	gl_Position = ubo.projection * ubo.view * pos;
+	outWorldPos = pos.xyz;
+	outNormal = mat3(modelMatrix) * inNormal;
+	outLightVec = normalize(ubo.lightPos - pos.xyz);
+	outViewVec = -pos.xyz;
 }
-
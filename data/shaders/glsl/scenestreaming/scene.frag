@@ -0,0 +1,19 @@
+#version 450
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+
+// Highlights cells that are drawn with their proxy
+layout (push_constant) uniform PushConstants {
+	vec4 tint;
+} pushConstants;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// Directional light from above (-y is up)
+	vec3 L = normalize(vec3(0.5, -1.0, 0.3));
+	float diffuse = max(dot(normalize(inNormal), L), 0.0);
+	outFragColor = vec4(inColor * (0.25 + 0.75 * diffuse) * pushConstants.tint.rgb, 1.0);
+}
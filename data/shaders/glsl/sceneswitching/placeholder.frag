@@ -0,0 +1,89 @@
+#version 450
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec4 camPos;
+} ubo;
+
+layout (binding = 1) uniform UBOParams {
+	float exposure;
+	float gamma;
+	float roughness;
+	float metallic;
+} uboParams;
+
+layout (binding = 2) uniform samplerCube samplerIrradiance;
+layout (binding = 3) uniform sampler2D samplerBRDFLUT;
+layout (binding = 4) uniform samplerCube prefilteredMap;
+
+layout (location = 0) out vec4 outColor;
+
+#define PI 3.1415926535897932384626433832795
+
+// From http://filmicworlds.com/blog/filmic-tonemapping-operators/
+vec3 Uncharted2Tonemap(vec3 color)
+{
+	float A = 0.15;
+	float B = 0.50;
+	float C = 0.10;
+	float D = 0.20;
+	float E = 0.02;
+	float F = 0.30;
+	float W = 11.2;
+	return ((color*(A*color+C*B)+D*E)/(color*(A*color+B)+D*F))-E/F;
+}
+
+vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
+{
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 prefilteredReflection(vec3 R, float roughness)
+{
+	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
+	float lod = roughness * MAX_REFLECTION_LOD;
+	float lodf = floor(lod);
+	float lodc = ceil(lod);
+	vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
+	vec3 b = textureLod(prefilteredMap, R, lodc).rgb;
+	return mix(a, b, lod - lodf);
+}
+
+// Image based lighting only, the scenes are lit by the environment
+vec3 shade(vec3 albedo, vec3 N, vec3 V)
+{
+	float roughness = uboParams.roughness;
+	float metallic = uboParams.metallic;
+	vec3 R = reflect(-V, N);
+	vec3 F0 = mix(vec3(0.04), albedo, metallic);
+	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+	vec3 reflection = prefilteredReflection(R, roughness).rgb;
+	vec3 irradiance = texture(samplerIrradiance, N).rgb;
+	vec3 F = F_SchlickR(max(dot(N, V), 0.0), F0, roughness);
+	vec3 specular = reflection * (F * brdf.x + brdf.y);
+	vec3 kD = 1.0 - F;
+	kD *= 1.0 - metallic;
+	vec3 color = kD * irradiance * albedo + specular;
+
+	// Tone mapping
+	color = Uncharted2Tonemap(color * uboParams.exposure);
+	color = color * (1.0f / Uncharted2Tonemap(vec3(11.2f)));
+	// Gamma correction
+	return pow(color, vec3(1.0f / uboParams.gamma));
+}
+
+// Shown while the next scene is loading, doesn't use any material images
+void main()
+{
+	vec3 N = normalize(inNormal);
+	vec3 V = normalize(ubo.camPos.xyz - inWorldPos);
+	outColor = vec4(shade(inColor, N, V), 1.0);
+}
@@ -19,6 +19,8 @@ layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outViewVec;
 layout (location = 3) out vec3 outLightVec;
 layout (location = 4) out vec4 outShadowCoord;
+layout (location = 5) out vec3 outWorldPos;
+layout (location = 6) out vec3 outLightRay;
 
 out gl_PerVertex 
 {
@@ -42,6 +44,9 @@ void main()
     outNormal = mat3(ubo.model) * inNormal;
     outLightVec = normalize(ubo.lightPos - inPos);
     outViewVec = -pos.xyz;			
+	// Unnormalized vector to the light for ray traced shadows, interpolates linearly along with the position
+	outWorldPos = pos.xyz;
+	outLightRay = ubo.lightPos - pos.xyz;
 
 	outShadowCoord = ( biasMat * ubo.lightSpace * ubo.model ) * vec4(inPos, 1.0);	
 }
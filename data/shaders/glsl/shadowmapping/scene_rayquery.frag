@@ -0,0 +1,96 @@
+#version 460
+#extension GL_EXT_ray_query : enable
+
+layout (binding = 1) uniform sampler2D shadowMap;
+layout (binding = 2) uniform accelerationStructureEXT topLevelAS;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec3 inViewVec;
+layout (location = 3) in vec3 inLightVec;
+layout (location = 4) in vec4 inShadowCoord;
+layout (location = 5) in vec3 inWorldPos;
+layout (location = 6) in vec3 inLightRay;
+
+// Only trace rays for pixels in the penumbra of the (low resolution) shadow map
+layout (constant_id = 0) const int hybrid = 0;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define ambient 0.1
+
+float textureProj(vec4 shadowCoord, vec2 off)
+{
+	float shadow = 1.0;
+	if ( shadowCoord.z > -1.0 && shadowCoord.z < 1.0 ) 
+	{
+		float dist = texture( shadowMap, shadowCoord.st + off ).r;
+		if ( shadowCoord.w > 0.0 && dist < shadowCoord.z ) 
+		{
+			shadow = ambient;
+		}
+	}
+	return shadow;
+}
+
+// Wider kernel than the shadow map only path, so that all pixels close to a shadow edge of the coarse shadow map are classified as penumbra
+float filterPCF(vec4 sc)
+{
+	ivec2 texDim = textureSize(shadowMap, 0);
+	float scale = 1.5;
+	float dx = scale * 1.0 / float(texDim.x);
+	float dy = scale * 1.0 / float(texDim.y);
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 2;
+	
+	for (int x = -range; x <= range; x++)
+	{
+		for (int y = -range; y <= range; y++)
+		{
+			shadowFactor += textureProj(sc, vec2(dx*x, dy*y));
+			count++;
+		}
+	}
+	return shadowFactor / count;
+}
+
+float traceShadowRay(vec3 N)
+{
+	float lightDist = length(inLightRay);
+	vec3 L = inLightRay / lightDist;
+	// Move the origin off the surface towards the light to avoid self intersections
+	vec3 origin = inWorldPos + N * (dot(N, L) >= 0.0 ? 0.01 : -0.01);
+
+	rayQueryEXT rayQuery;
+	rayQueryInitializeEXT(rayQuery, topLevelAS, gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsOpaqueEXT, 0xFF, origin, 0.0, L, lightDist);
+
+	// Start the ray traversal, rayQueryProceedEXT returns false if the traversal is complete
+	while (rayQueryProceedEXT(rayQuery)) { }
+
+	// If anything has been hit between the fragment and the light, the fragment is shadowed
+	return (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionTriangleEXT) ? ambient : 1.0;
+}
+
+void main() 
+{	
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = normalize(-reflect(L, N));
+	vec3 diffuse = max(dot(N, L), ambient) * inColor;
+
+	float shadow;
+	if (hybrid == 1) {
+		// Fully lit and fully shadowed pixels keep the result of the shadow map, only the penumbra is traced
+		shadow = filterPCF(inShadowCoord / inShadowCoord.w);
+		if ((shadow > ambient + 0.001) && (shadow < 0.999)) {
+			shadow = traceShadowRay(N);
+		}
+	} else {
+		shadow = traceShadowRay(N);
+	}
+
+	outFragColor = vec4(diffuse * shadow, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inUV;
+
+// todo: pass via specialization constant
+#define SHADOW_MAP_CASCADE_COUNT 4
+
+layout(push_constant) uniform PushConsts {
+	vec4 position;
+	uint cascadeIndex;
+} pushConsts;
+
+layout (binding = 0) uniform UBO {
+	mat4[SHADOW_MAP_CASCADE_COUNT] cascadeViewProjMat;
+} ubo;
+
+layout (location = 0) out vec2 outUV;
+
+out gl_PerVertex {
+	vec4 gl_Position;   
+};
+
+void main()
+{
+	outUV = inUV;
+	vec3 pos = inPos + pushConsts.position.xyz;
+	// Each instance renders into the layer of one cascade
+	gl_Layer = gl_InstanceIndex;
+	gl_Position =  ubo.cascadeViewProjMat[gl_InstanceIndex] * vec4(pos, 1.0);
+}
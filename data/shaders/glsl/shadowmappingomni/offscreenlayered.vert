@@ -0,0 +1,32 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 inPos;
+
+layout (location = 0) out vec4 outPos;
+layout (location = 1) out vec3 outLightPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view; 
+	mat4 model;
+	vec4 lightPos;
+	mat4 faceViews[6];
+} ubo;
+ 
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+ 
+void main()
+{
+	// Each instance renders into the layer of one cube map face
+	gl_Layer = gl_InstanceIndex;
+	gl_Position = ubo.projection * ubo.faceViews[gl_InstanceIndex] * ubo.model * vec4(inPos, 1.0);
+
+	outPos = vec4(inPos, 1.0);	
+	outLightPos = ubo.lightPos.xyz; 
+}
@@ -17,6 +17,24 @@ layout (constant_id = 0) const int LIGHTING_MODEL = 0;
 // Parameter for the toon shading part of the shader
 layout (constant_id = 1) const float PARAM_TOON_DESATURATION = 0.0f;
 
+// Optional features, the generic pipeline reads them from the push constant while specialized
+// pipelines (see vks::PipelinePermutations) bake them in so the disabled code is removed
+layout (constant_id = 2) const bool SPECIALIZED = false;
+layout (constant_id = 3) const bool FEATURE_SPECULAR = false;
+layout (constant_id = 4) const bool FEATURE_RIM_LIGHT = false;
+
+layout (push_constant) uniform PushConsts {
+	uint features;
+} pushConsts;
+
+#define FEATURE_BIT_SPECULAR 1
+#define FEATURE_BIT_RIM_LIGHT 2
+
+bool featureEnabled(bool specializedValue, uint bit)
+{
+	return SPECIALIZED ? specializedValue : ((pushConsts.features & bit) != 0);
+}
+
 void main() 
 {
 	switch (LIGHTING_MODEL) {
@@ -28,7 +46,7 @@ void main()
 			vec3 V = normalize(inViewVec);
 			vec3 R = reflect(-L, N);
 			vec3 diffuse = max(dot(N, L), 0.0) * inColor;
-			vec3 specular = pow(max(dot(R, V), 0.0), 32.0) * vec3(0.75);
+			vec3 specular = featureEnabled(FEATURE_SPECULAR, FEATURE_BIT_SPECULAR) ? pow(max(dot(R, V), 0.0), 32.0) * vec3(0.75) : vec3(0.0);
 			outFragColor = vec4(ambient + diffuse * 1.75 + specular, 1.0);		
 			break;
 		}
@@ -63,9 +81,14 @@ void main()
 			vec3 V = normalize(inViewVec);
 			vec3 R = reflect(-L, N);
 			vec3 diffuse = max(dot(N, L), 0.0) * color.rgb;
-			float specular = pow(max(dot(R, V), 0.0), 32.0) * color.a;
+			float specular = featureEnabled(FEATURE_SPECULAR, FEATURE_BIT_SPECULAR) ? pow(max(dot(R, V), 0.0), 32.0) * color.a : 0.0;
 			outFragColor = vec4(ambient + diffuse + vec3(specular), 1.0);		
 			break;
 		}
 	}
+
+	if (featureEnabled(FEATURE_RIM_LIGHT, FEATURE_BIT_RIM_LIGHT)) {
+		float rim = pow(1.0 - max(dot(normalize(inNormal), normalize(inViewVec)), 0.0), 3.0);
+		outFragColor.rgb += vec3(rim * 0.5);
+	}
 }
\ No newline at end of file
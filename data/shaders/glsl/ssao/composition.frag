@@ -8,6 +8,7 @@ layout (binding = 4) uniform sampler2D samplerSSAOBlur;
 layout (binding = 5) uniform UBO 
 {
 	mat4 _dummy;
+	mat4 _dummy2;
 	int ssao;
 	int ssaoOnly;
 	int ssaoBlur;
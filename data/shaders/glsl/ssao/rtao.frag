@@ -0,0 +1,88 @@
+#version 460
+#extension GL_EXT_ray_query : enable
+
+// Ray traced ambient occlusion, a few short rays per pixel are traced against the scene's acceleration structure with ray queries
+// Unlike the screen space occlusion this also finds occluders that are hidden or outside of the view, the noisy result
+// is accumulated over frames by the temporal filter and smoothed by the depth aware blur like the screen space occlusion
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+layout (binding = 2) uniform accelerationStructureEXT topLevelAS;
+
+// Maximum distance of an occluder
+layout (constant_id = 0) const float RTAO_RADIUS = 1.0;
+
+layout (binding = 3) uniform UBO
+{
+	mat4 projection;
+	mat4 viewToPrevClip;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	uint kernelOffset;
+	uint kernelSamples;
+	float historyWeight;
+	// Seeds the ray directions, so consecutive frames trace different rays
+	uint frameIndex;
+	uint rayCount;
+	// The G-Buffer is in view space, the acceleration structure in world space
+	mat4 invView;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+#define PI 3.1415926535897932384626433832795
+
+// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+uint hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float random(inout uint seed)
+{
+	seed = hash(seed);
+	return float(seed) / 4294967295.0;
+}
+
+// Cosine weighted direction in the hemisphere around N
+vec3 sampleHemisphere(vec3 N, inout uint seed)
+{
+	float r = sqrt(random(seed));
+	float phi = 2.0 * PI * random(seed);
+	vec3 tangent = normalize(abs(N.x) > 0.9 ? cross(N, vec3(0.0, 1.0, 0.0)) : cross(N, vec3(1.0, 0.0, 0.0)));
+	vec3 bitangent = cross(N, tangent);
+	return normalize(tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + N * sqrt(max(1.0 - r * r, 0.0)));
+}
+
+void main()
+{
+	vec3 fragPos = texture(samplerPositionDepth, inUV).xyz;
+	vec3 worldPos = (ubo.invView * vec4(fragPos, 1.0)).xyz;
+	vec3 N = normalize(mat3(ubo.invView) * normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0));
+	// Move the origin off the surface to avoid self intersections
+	vec3 origin = worldPos + N * 0.01;
+
+	uint seed = hash(uint(gl_FragCoord.x) + hash(uint(gl_FragCoord.y) + hash(ubo.frameIndex)));
+
+	float occlusion = 0.0;
+	for (uint i = 0; i < ubo.rayCount; i++) {
+		vec3 direction = sampleHemisphere(N, seed);
+
+		rayQueryEXT rayQuery;
+		rayQueryInitializeEXT(rayQuery, topLevelAS, gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsOpaqueEXT, 0xFF, origin, 0.0, direction, RTAO_RADIUS);
+
+		// Start the ray traversal, rayQueryProceedEXT returns false if the traversal is complete
+		while (rayQueryProceedEXT(rayQuery)) { }
+
+		if (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionTriangleEXT) {
+			occlusion += 1.0;
+		}
+	}
+
+	outFragColor = 1.0 - occlusion / float(ubo.rayCount);
+}
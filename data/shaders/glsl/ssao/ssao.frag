@@ -15,6 +15,14 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	mat4 viewToPrevClip;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	// With temporal filtering only a part of the kernel is evaluated per frame
+	uint kernelOffset;
+	uint kernelSamples;
+	float historyWeight;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -27,11 +35,9 @@ void main()
 	vec3 fragPos = texture(samplerPositionDepth, inUV).rgb;
 	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
 
-	// Get a random vector using a noise lookup
-	ivec2 texDim = textureSize(samplerPositionDepth, 0); 
+	// Get a random vector using a noise lookup, tiled over the pixels of the SSAO target (which may be smaller than the G-Buffer)
 	ivec2 noiseDim = textureSize(ssaoNoise, 0);
-	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
-	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
+	vec3 randomVec = texelFetch(ssaoNoise, ivec2(gl_FragCoord.xy) % noiseDim, 0).xyz * 2.0 - 1.0;
 	
 	// Create TBN matrix
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -42,9 +48,9 @@ void main()
 	float occlusion = 0.0f;
 	// remove banding
 	const float bias = 0.025f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	for(uint i = 0; i < ubo.kernelSamples; i++)
 	{		
-		vec3 samplePos = TBN * uboSSAOKernel.samples[i].xyz; 
+		vec3 samplePos = TBN * uboSSAOKernel.samples[(ubo.kernelOffset + i) % SSAO_KERNEL_SIZE].xyz; 
 		samplePos = fragPos + samplePos * SSAO_RADIUS; 
 		
 		// project
@@ -58,7 +64,7 @@ void main()
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + bias ? 1.0f : 0.0f) * rangeCheck;           
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(ubo.kernelSamples));
 	
 	outFragColor = occlusion;
 }
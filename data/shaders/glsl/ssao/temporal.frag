@@ -0,0 +1,43 @@
+#version 450
+
+// Temporal accumulation of the SSAO result
+// The history is reprojected with the previous frame's view projection and rejected if it belongs to a different surface (disocclusion),
+// it stores the linear depth next to the accumulated occlusion for this check
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerSSAO;
+layout (binding = 2) uniform sampler2D samplerHistory;
+
+layout (binding = 3) uniform UBO 
+{
+	mat4 projection;
+	mat4 viewToPrevClip;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	uint kernelOffset;
+	uint kernelSamples;
+	float historyWeight;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec2 outFragColor;
+
+void main() 
+{
+	vec4 positionDepth = texture(samplerPositionDepth, inUV);
+	float occlusion = texture(samplerSSAO, inUV).r;
+
+	vec4 prevClip = ubo.viewToPrevClip * vec4(positionDepth.xyz, 1.0);
+	vec2 prevUV = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+	vec2 history = texture(samplerHistory, prevUV).rg;
+
+	float historyWeight = ubo.historyWeight;
+	// The clip space w is the linear depth the surface had in the previous frame
+	if (any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0))) || (abs(history.g - prevClip.w) > 0.05 * prevClip.w)) {
+		historyWeight = 0.0;
+	}
+
+	outFragColor = vec2(mix(occlusion, history.r, historyWeight), positionDepth.w);
+}
@@ -0,0 +1,37 @@
+#version 450
+
+// Depth aware (bilateral) blur and upsample of a reduced resolution SSAO result to the G-Buffer resolution
+// Blurs over the 4x4 low resolution texels around the pixel, weighting each one by how close its depth is to the pixel's depth
+// so occlusion doesn't bleed over depth discontinuities
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerSSAO;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+void main() 
+{
+	const float depthSharpness = 20.0;
+
+	float depth = texture(samplerPositionDepth, inUV).w;
+	ivec2 lowResSize = textureSize(samplerSSAO, 0);
+	ivec2 base = ivec2(floor(inUV * vec2(lowResSize) - 0.5)) - 1;
+
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int y = 0; y < 4; y++) 
+	{
+		for (int x = 0; x < 4; x++) 
+		{
+			ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), lowResSize - 1);
+			// Depth the low resolution texel has been computed for
+			float sampleDepth = texture(samplerPositionDepth, (vec2(texel) + 0.5) / vec2(lowResSize)).w;
+			float weight = exp(-abs(depth - sampleDepth) * depthSharpness / max(depth, 0.001)) + 0.0001;
+			result += texelFetch(samplerSSAO, texel, 0).r * weight;
+			weightSum += weight;
+		}
+	}
+	outFragColor = result / weightSum;
+}
@@ -6,10 +6,13 @@ layout (location = 2) in vec2 inUV;
 
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec4 outEdgeModes;
 
 void main(void)
 {
 	gl_Position = vec4(inPos.xyz, 1.0);
 	outUV = inUV;
 	outNormal = inNormal;
+	// The patches of the fixed grid all have the same size
+	outEdgeModes = vec4(0.0);
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 450
+
+// Control points of the patches of a terrain quadtree node, each instance is a node selected by terrainlod.comp
+
+layout (location = 0) in vec4 inNode;
+layout (location = 1) in vec4 inEdgeModes;
+
+layout (set = 0, binding = 1) uniform sampler2D displacementMap;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec4 outEdgeModes;
+
+// Must match PATCHES_PER_NODE of terrainlod.comp
+const uint PATCHES_PER_NODE = 8;
+// World space extent of the height map (and UVs), same as the former fixed grid of 64 x 64 vertices two units apart
+const float TERRAIN_SCALE = 128.0;
+
+void main(void)
+{
+	// Corners in the order of the quad patch indices of the fixed grid
+	const uvec2 corners[4] = uvec2[](uvec2(0, 0), uvec2(0, 1), uvec2(1, 1), uvec2(1, 0));
+	uint patchIndex = uint(gl_VertexIndex) / 4u;
+	uvec2 patchPos = uvec2(patchIndex % PATCHES_PER_NODE, patchIndex / PATCHES_PER_NODE);
+	uvec2 gridPos = patchPos + corners[gl_VertexIndex % 4];
+	float patchSize = inNode.z / float(PATCHES_PER_NODE);
+	vec2 pos = inNode.xy + vec2(gridPos) * patchSize;
+
+	gl_Position = vec4(pos.x, 0.0, pos.y, 1.0);
+	outUV = (pos + TERRAIN_SCALE / 2.0 - 1.0) / TERRAIN_SCALE;
+
+	// Sobel filtered normal with the patch size as the sample distance (but at least two units like the fixed grid)
+	float step = max(patchSize, 2.0) / TERRAIN_SCALE;
+	float heights[3][3];
+	for (int hx = -1; hx <= 1; hx++) {
+		for (int hy = -1; hy <= 1; hy++) {
+			heights[hx + 1][hy + 1] = textureLod(displacementMap, outUV + vec2(hx, hy) * step, 0.0).r;
+		}
+	}
+	vec3 normal;
+	normal.x = heights[0][0] - heights[2][0] + 2.0 * heights[0][1] - 2.0 * heights[2][1] + heights[0][2] - heights[2][2];
+	normal.z = heights[0][0] + 2.0 * heights[1][0] + heights[2][0] - heights[0][2] - 2.0 * heights[1][2] - heights[2][2];
+	normal.y = 0.25 * sqrt(max(1.0 - normal.x * normal.x - normal.z * normal.z, 0.0));
+	outNormal = normalize(normal * vec3(2.0, 1.0, 2.0));
+
+	// Only the patch edges on the node's border are matched against the neighbouring nodes
+	// A coarser neighbour's patch edge is centered on the odd end point of this edge (2 = first, 3 = second end point of the outer level's edge)
+	bool evenX = (patchPos.x % 2u) == 0u;
+	bool evenZ = (patchPos.y % 2u) == 0u;
+	vec4 coarser = vec4(evenX ? 2.0 : 3.0, evenZ ? 3.0 : 2.0, evenX ? 3.0 : 2.0, evenZ ? 2.0 : 3.0);
+	bvec4 border = bvec4(patchPos.y == 0u, patchPos.x == 0u, patchPos.y == PATCHES_PER_NODE - 1u, patchPos.x == PATCHES_PER_NODE - 1u);
+	for (int i = 0; i < 4; i++) {
+		outEdgeModes[i] = !border[i] ? 0.0 : ((inEdgeModes[i] == 2.0) ? coarser[i] : inEdgeModes[i]);
+	}
+}
@@ -3,29 +3,67 @@
 #extension GL_ARB_sparse_texture2 : enable
 #extension GL_ARB_sparse_texture_clamp : enable
 
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 viewPos;
+	float lodBias;
+	int mipTailStart;
+	ivec2 textureSize;
+	ivec2 pageSize;
+} ubo;
+
 layout (binding = 1) uniform sampler2D samplerColor;
 
+// One flag per virtual page, pages are stored per mip level row by row
+layout (binding = 2) buffer Feedback
+{
+	uint requests[];
+} feedback;
+
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in float inLodBias;
 
 layout (location = 0) out vec4 outFragColor;
 
+// Request the page containing the current texel at the given mip level
+void requestPage(int mipLevel)
+{
+	// The mip tail is always resident
+	if (mipLevel >= ubo.mipTailStart) {
+		return;
+	}
+	uint pageOffset = 0;
+	for (int i = 0; i < mipLevel; i++) {
+		ivec2 pageCount = (max(ubo.textureSize >> i, ivec2(1)) + ubo.pageSize - 1) / ubo.pageSize;
+		pageOffset += uint(pageCount.x * pageCount.y);
+	}
+	ivec2 mipSize = max(ubo.textureSize >> mipLevel, ivec2(1));
+	ivec2 pageCount = (mipSize + ubo.pageSize - 1) / ubo.pageSize;
+	ivec2 page = clamp(ivec2(inUV * vec2(mipSize)), ivec2(0), mipSize - 1) / ubo.pageSize;
+	feedback.requests[pageOffset + uint(page.y * pageCount.x + page.x)] = 1;
+}
+
 void main() 
 {
 	vec4 color = vec4(0.0);
 
+	// Mip level selected by the sampler (nearest mip mode)
+	float lod = textureQueryLod(samplerColor, inUV).y + inLodBias;
+	int mipLevel = max(int(floor(lod + 0.5)), 0);
+	requestPage(mipLevel);
+
 	// Get residency code for current texel
 	int residencyCode = sparseTextureARB(samplerColor, inUV, color, inLodBias);
 
-	// Fetch sparse until we get a valid texel
-	/*
-	float minLod = 1.0;
-	while (!sparseTexelsResidentARB(residencyCode)) 
+	// Fall back to coarser mip levels until we get a resident texel, the mip tail is always resident
+	float minLod = float(mipLevel + 1);
+	while (!sparseTexelsResidentARB(residencyCode) && (minLod <= float(ubo.mipTailStart)))
 	{
-		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color);
-		minLod += 1.0f;
+		residencyCode = sparseTextureClampARB(samplerColor, inUV, minLod, color, inLodBias);
+		minLod += 1.0;
 	}
-	*/
 
 	// Check if texel is resident
 	bool texelResident = sparseTexelsResidentARB(residencyCode);
@@ -36,4 +74,4 @@ void main()
 	}
 
 	outFragColor = color;
-}
\ No newline at end of file
+}
@@ -0,0 +1,54 @@
+#version 450
+
+layout (binding = 1, r32ui) uniform readonly uimage3D voxels;
+
+layout (push_constant) uniform PushConstants {
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	vec4 gridOrigin;
+	uint gridSize;
+} pushConstants;
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+const vec3 lightDir = normalize(vec3(0.4, 1.0, 0.3));
+
+float occupancy(vec3 pos)
+{
+	ivec3 coord = ivec3(floor(pos));
+	if (any(lessThan(coord, ivec3(0))) || any(greaterThanEqual(coord, ivec3(pushConstants.gridSize)))) {
+		return 0.0;
+	}
+	return imageLoad(voxels, coord).r != 0 ? 1.0 : 0.0;
+}
+
+void main() 
+{
+	vec3 N = normalize(inNormal);
+	// Grid space position, one unit per voxel
+	vec3 pos = (inWorldPos - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+
+	// [POI] Voxel ambient occlusion: March a few directions around the normal through the grid with growing steps and accumulate the occupancy
+	// Starts one voxel off the surface, so the voxels of the surface itself don't occlude it
+	vec3 T = normalize(abs(N.y) < 0.99 ? cross(N, vec3(0.0, 1.0, 0.0)) : cross(N, vec3(1.0, 0.0, 0.0)));
+	vec3 B = cross(N, T);
+	const vec3 directions[5] = vec3[](vec3(0.0, 0.0, 1.0), vec3(0.7, 0.0, 0.7), vec3(-0.7, 0.0, 0.7), vec3(0.0, 0.7, 0.7), vec3(0.0, -0.7, 0.7));
+	float occlusion = 0.0;
+	for (int i = 0; i < 5; i++) {
+		vec3 dir = normalize(T * directions[i].x + B * directions[i].y + N * directions[i].z);
+		float distance = 1.5;
+		float weight = 1.0;
+		for (int j = 0; j < 4; j++) {
+			occlusion += occupancy(pos + dir * distance) * weight;
+			distance *= 2.0;
+			weight *= 0.5;
+		}
+	}
+	float ao = clamp(1.0 - occlusion / 5.0, 0.0, 1.0);
+
+	float diffuse = max(dot(N, -lightDir), 0.0);
+	outFragColor = vec4(inColor * (0.35 * ao + 0.65 * diffuse), 1.0);
+}
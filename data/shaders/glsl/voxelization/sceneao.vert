@@ -0,0 +1,25 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec4 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseProjection;
+	mat4 inverseView;
+} ubo;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+
+void main() 
+{
+	outWorldPos = inPos;
+	outNormal = inNormal;
+	outColor = inColor.rgb;
+	gl_Position = ubo.projection * ubo.view * vec4(inPos, 1.0);
+}
@@ -0,0 +1,42 @@
+#version 450
+
+layout (binding = 1, r32ui) uniform uimage3D voxels;
+
+layout (push_constant) uniform PushConstants {
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	vec4 gridOrigin;
+	uint gridSize;
+} pushConstants;
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) flat in uint inAxis;
+
+/*
+	Each voxel stores the average albedo in rgb and the number of fragments that contributed to it in a (8 bits each)
+	Concurrent fragments of the same voxel are merged with a compare and swap loop, the count saturates at 255
+*/
+void imageAtomicAverageRGBA8(ivec3 coord, vec3 color)
+{
+	uint newValue = packUnorm4x8(vec4(color, 1.0 / 255.0));
+	uint previousValue = 0;
+	uint currentValue;
+	int iteration = 0;
+	while ((currentValue = imageAtomicCompSwap(voxels, coord, previousValue, newValue)) != previousValue && iteration < 255) {
+		previousValue = currentValue;
+		vec4 stored = unpackUnorm4x8(currentValue);
+		float count = stored.a * 255.0;
+		vec3 average = (stored.rgb * count + color) / (count + 1.0);
+		newValue = packUnorm4x8(vec4(average, min(count + 1.0, 255.0) / 255.0));
+		iteration++;
+	}
+}
+
+void main() 
+{
+	// Undo the swizzle of the geometry shader, depth spans the grid along the dominant axis
+	vec3 pos = vec3(gl_FragCoord.xy, gl_FragCoord.z * float(pushConstants.gridSize));
+	pos = (inAxis == 0) ? pos.zxy : ((inAxis == 1) ? pos.yzx : pos);
+	// Overestimated fragments can lie slightly outside of the grid
+	ivec3 coord = clamp(ivec3(floor(pos)), ivec3(0), ivec3(pushConstants.gridSize - 1));
+	imageAtomicAverageRGBA8(coord, inColor);
+}
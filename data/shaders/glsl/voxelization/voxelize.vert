@@ -0,0 +1,20 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec4 inColor;
+
+layout (push_constant) uniform PushConstants {
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	vec4 gridOrigin;
+	uint gridSize;
+} pushConstants;
+
+layout (location = 0) out vec3 outVoxelPos;
+layout (location = 1) out vec3 outColor;
+
+void main() 
+{
+	// Grid space position, one unit per voxel
+	outVoxelPos = (inPos - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+	outColor = inColor.rgb;
+}
@@ -0,0 +1,99 @@
+#version 450
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseProjection;
+	mat4 inverseView;
+} ubo;
+
+layout (binding = 1, r32ui) uniform readonly uimage3D voxels;
+
+layout (push_constant) uniform PushConstants {
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	vec4 gridOrigin;
+	uint gridSize;
+} pushConstants;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+const vec3 lightDir = normalize(vec3(0.4, 1.0, 0.3));
+
+bool occupied(ivec3 coord)
+{
+	if (any(lessThan(coord, ivec3(0))) || any(greaterThanEqual(coord, ivec3(pushConstants.gridSize)))) {
+		return false;
+	}
+	return imageLoad(voxels, coord).r != 0;
+}
+
+void main() 
+{
+	outFragColor = vec4(0.0, 0.0, 0.0, 1.0);
+
+	// Camera ray in grid space (one unit per voxel)
+	vec4 target = ubo.inverseProjection * vec4(inUV * 2.0 - 1.0, 1.0, 1.0);
+	vec3 origin = ((ubo.inverseView * vec4(0.0, 0.0, 0.0, 1.0)).xyz - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+	vec3 direction = (ubo.inverseView * vec4(normalize(target.xyz / target.w), 0.0)).xyz;
+	direction = mix(direction, vec3(1e-6), equal(direction, vec3(0.0)));
+	vec3 invDirection = 1.0 / direction;
+
+	// Clip the ray against the grid
+	float size = float(pushConstants.gridSize);
+	vec3 t0 = -origin * invDirection;
+	vec3 t1 = (vec3(size) - origin) * invDirection;
+	vec3 tMin = min(t0, t1);
+	vec3 tMax = max(t0, t1);
+	float tEnter = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+	float tExit = min(tMax.x, min(tMax.y, tMax.z));
+	if (tEnter >= tExit) {
+		return;
+	}
+
+	// Walk the voxels along the ray (3D DDA)
+	ivec3 coord = clamp(ivec3(floor(origin + direction * (tEnter + 1e-3))), ivec3(0), ivec3(pushConstants.gridSize - 1));
+	ivec3 stepDir = ivec3(sign(direction));
+	vec3 tDelta = abs(invDirection);
+	vec3 tNext = (vec3(coord) + max(vec3(stepDir), vec3(0.0)) - origin) * invDirection;
+	// Face through which the current voxel was entered
+	vec3 normal = -sign(direction) * vec3(equal(tMin, vec3(tEnter)));
+	for (uint i = 0; i < pushConstants.gridSize * 3; i++) {
+		uint value = imageLoad(voxels, coord).r;
+		if (value != 0) {
+			vec3 albedo = unpackUnorm4x8(value).rgb;
+			// Cheap ambient occlusion from the occupancy of the voxels in front of the face that has been hit
+			ivec3 front = coord + ivec3(normal);
+			ivec3 tangent = ivec3(abs(normal.yzx));
+			ivec3 bitangent = ivec3(abs(normal.zxy));
+			float occlusion = 0.0;
+			for (int u = -1; u <= 1; u++) {
+				for (int v = -1; v <= 1; v++) {
+					occlusion += occupied(front + tangent * u + bitangent * v) ? 1.0 : 0.0;
+				}
+			}
+			float ao = 1.0 - occlusion / 9.0 * 0.8;
+			float diffuse = max(dot(normal, -lightDir), 0.0);
+			outFragColor = vec4(albedo * (0.35 * ao + 0.65 * diffuse), 1.0);
+			return;
+		}
+		if (tNext.x < tNext.y && tNext.x < tNext.z) {
+			coord.x += stepDir.x;
+			tNext.x += tDelta.x;
+			normal = vec3(-stepDir.x, 0.0, 0.0);
+		} else if (tNext.y < tNext.z) {
+			coord.y += stepDir.y;
+			tNext.y += tDelta.y;
+			normal = vec3(0.0, -stepDir.y, 0.0);
+		} else {
+			coord.z += stepDir.z;
+			tNext.z += tDelta.z;
+			normal = vec3(0.0, 0.0, -stepDir.z);
+		}
+		if (any(lessThan(coord, ivec3(0))) || any(greaterThanEqual(coord, ivec3(pushConstants.gridSize)))) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+// Same as mesh.vert, but the vertices are fetched from the model's vertex buffer instead of the fixed function vertex input
+
+#define VERTEX_PULLING_SET 1
+#include "../base/vertexpulling.glsl"
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 normal;
+	mat4 view;
+	vec3 lightpos;
+} ubo;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+layout (location = 3) out vec3 outEyePos;
+layout (location = 4) out vec3 outLightVec;
+
+void main() 
+{
+	uint vertexIndex = uint(gl_VertexIndex);
+	vec4 inPos = pullVertexComponent(vertexIndex, VERTEX_COMPONENT_POSITION, vec4(0.0, 0.0, 0.0, 1.0));
+	vec3 inNormal = pullVertexComponent(vertexIndex, VERTEX_COMPONENT_NORMAL, vec4(0.0)).xyz;
+	vec2 inTexCoord = pullVertexComponent(vertexIndex, VERTEX_COMPONENT_UV, vec4(0.0)).xy;
+	vec3 inColor = pullVertexComponent(vertexIndex, VERTEX_COMPONENT_COLOR, vec4(1.0)).rgb;
+
+	outUV = inTexCoord.st;
+	outNormal = normalize(mat3(ubo.normal) * inNormal);
+	outColor = inColor;
+	mat4 modelView = ubo.view * ubo.model;
+	vec4 pos = modelView * inPos;	
+	gl_Position = ubo.projection * pos;
+	outEyePos = vec3(modelView * pos);
+	vec4 lightPos = vec4(ubo.lightpos, 1.0) * modelView;
+	outLightVec = normalize(lightPos.xyz - outEyePos);
+}
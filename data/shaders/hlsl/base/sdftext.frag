@@ -0,0 +1,28 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureFont : register(t0);
+SamplerState samplerFont : register(s0);
+
+struct VSOutput
+{
+[[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float4 Color : COLOR0;
+};
+
+struct PushConstants
+{
+	float2 scale;
+	float smoothing;
+};
+
+[[vk::push_constant]]
+PushConstants pushConstants;
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	// The edge of the glyph is at a distance of 0.5, the transition is scaled by the screen space derivative so it stays sharp at any size
+	float distance = textureFont.Sample(samplerFont, input.UV).a;
+	float smoothWidth = fwidth(distance) * pushConstants.smoothing;
+	float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	return float4(input.Color.rgb, input.Color.a * alpha);
+}
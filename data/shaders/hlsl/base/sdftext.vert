@@ -0,0 +1,38 @@
+// Copyright 2020 Google LLC
+
+// Per glyph instance data
+struct VSInput
+{
+[[vk::location(0)]] float4 Rect : POSITION0;
+[[vk::location(1)]] float4 UV : TEXCOORD0;
+[[vk::location(2)]] float4 Color : COLOR0;
+	uint VertexIndex : SV_VertexID;
+};
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float4 Color : COLOR0;
+};
+
+struct PushConstants
+{
+	float2 scale;
+	float smoothing;
+};
+
+[[vk::push_constant]]
+PushConstants pushConstants;
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	// Corners of the glyph's quad as a triangle strip
+	float2 corner = float2(input.VertexIndex & 1, (input.VertexIndex >> 1) & 1);
+	output.UV = lerp(input.UV.xy, input.UV.zw, corner);
+	output.Color = input.Color;
+	float2 pos = lerp(input.Rect.xy, input.Rect.zw, corner);
+	output.Pos = float4(pos * pushConstants.scale - 1.0, 0.0, 1.0);
+	return output;
+}
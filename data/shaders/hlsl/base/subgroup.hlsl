@@ -0,0 +1,53 @@
+// Workgroup wide reduction, prefix sum and stream compaction built from wave operations
+// Waves reduce and scan in registers and only exchange their totals through shared memory, which needs a fraction of the barriers of a plain shared memory scan
+// Define WORKGROUP_SIZE to the workgroup size before including this file
+// All invocations of the workgroup have to call the functions from uniform control flow, and the workgroup size must be a multiple of the wave size
+// Waves are made of consecutive invocations, so localIndex (SV_GroupIndex) gives the element order of prefix sums and compaction
+
+// Totals of the waves, groupshared arrays can't be sized by specialization constants so this is sized for the smallest possible wave size
+groupshared uint waveTotals[WORKGROUP_SIZE / 4];
+
+// Exchanges the wave totals, returns the sum of the totals of all previous waves and the total of the workgroup
+uint workgroupWaveOffset(uint localIndex, uint waveTotal, out uint total)
+{
+	uint waveIndex = localIndex / WaveGetLaneCount();
+	uint waveCount = WORKGROUP_SIZE / WaveGetLaneCount();
+	if (WaveIsFirstLane())
+	{
+		waveTotals[waveIndex] = waveTotal;
+	}
+	GroupMemoryBarrierWithGroupSync();
+	uint offset = 0;
+	total = 0;
+	for (uint i = WaveGetLaneIndex(); i < waveCount; i += WaveGetLaneCount())
+	{
+		uint value = waveTotals[i];
+		offset += (i < waveIndex) ? value : 0;
+		total += value;
+	}
+	offset = WaveActiveSum(offset);
+	total = WaveActiveSum(total);
+	// Shared memory may be reused by the next call
+	GroupMemoryBarrierWithGroupSync();
+	return offset;
+}
+
+// Sum of the values of all invocations of the workgroup
+uint workgroupAdd(uint localIndex, uint value)
+{
+	uint total;
+	workgroupWaveOffset(localIndex, WaveActiveSum(value), total);
+	return total;
+}
+
+// Exclusive prefix sum over the workgroup in the order of localIndex, total receives the sum of all values
+uint workgroupExclusiveAdd(uint localIndex, uint value, out uint total)
+{
+	return workgroupWaveOffset(localIndex, WaveActiveSum(value), total) + WavePrefixSum(value);
+}
+
+// Stream compaction: Returns the position of a kept element among the kept elements of the workgroup (in the order of localIndex), count receives the number of kept elements
+uint workgroupCompact(uint localIndex, bool keep, out uint count)
+{
+	return workgroupWaveOffset(localIndex, WaveActiveCountBits(keep), count) + WavePrefixCountBits(keep);
+}
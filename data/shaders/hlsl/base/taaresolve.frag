@@ -0,0 +1,84 @@
+// Copyright 2020 Google LLC
+
+// Temporal anti-aliasing resolve: Blends the jittered scene into the reprojected history, which is clipped to the scene's local color range first
+
+Texture2D textureScene : register(t0);
+SamplerState samplerScene : register(s0);
+Texture2D textureVelocity : register(t1);
+SamplerState samplerVelocity : register(s1);
+Texture2D textureHistory : register(t2);
+SamplerState samplerHistory : register(s2);
+
+struct PushConstants
+{
+	// 1 / size of the images
+	float2 texelSize;
+	// Weight of the history
+	float feedback;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+// The color range is estimated in YCoCg, which separates luminance from chrominance and gives a tighter box than RGB
+float3 RGBToYCoCg(float3 c)
+{
+	return float3(dot(c, float3(0.25, 0.5, 0.25)), dot(c, float3(0.5, 0.0, -0.5)), dot(c, float3(-0.25, 0.5, -0.25)));
+}
+
+float3 YCoCgToRGB(float3 c)
+{
+	return float3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Clip the history towards the center of the box instead of clamping each channel, which would shift its hue
+float3 clipToBox(float3 history, float3 boxMin, float3 boxMax)
+{
+	float3 center = 0.5 * (boxMax + boxMin);
+	float3 extents = 0.5 * (boxMax - boxMin) + 1.0e-4;
+	float3 offset = history - center;
+	float3 units = abs(offset / extents);
+	float maxUnit = max(units.x, max(units.y, units.z));
+	return (maxUnit > 1.0) ? center + offset / maxUnit : history;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Color moments of the 3x3 neighbourhood and the longest velocity of it, so edges of moving objects reproject with the object
+	float3 current = float3(0.0, 0.0, 0.0);
+	float3 m1 = float3(0.0, 0.0, 0.0);
+	float3 m2 = float3(0.0, 0.0, 0.0);
+	float3 boxMin = float3(1.0e10, 1.0e10, 1.0e10);
+	float3 boxMax = float3(-1.0e10, -1.0e10, -1.0e10);
+	float2 velocity = float2(0.0, 0.0);
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			float2 uv = inUV + float2(x, y) * pushConstants.texelSize;
+			float3 c = RGBToYCoCg(textureScene.Sample(samplerScene, uv).rgb);
+			if ((x == 0) && (y == 0)) {
+				current = c;
+			}
+			m1 += c;
+			m2 += c * c;
+			boxMin = min(boxMin, c);
+			boxMax = max(boxMax, c);
+			float2 v = textureVelocity.Sample(samplerVelocity, uv).xy;
+			if (dot(v, v) > dot(velocity, velocity)) {
+				velocity = v;
+			}
+		}
+	}
+
+	// Narrow the box to the variance of the neighbourhood, which rejects more stale history in low contrast areas
+	float3 mean = m1 / 9.0;
+	float3 stddev = sqrt(max(m2 / 9.0 - mean * mean, 0.0));
+	boxMin = max(boxMin, mean - stddev);
+	boxMax = min(boxMax, mean + stddev);
+
+	float2 historyUV = inUV - velocity;
+	float3 history = RGBToYCoCg(textureHistory.Sample(samplerHistory, historyUV).rgb);
+	history = clipToBox(history, boxMin, boxMax);
+
+	// Pixels that were outside of the view in the previous frame have no history
+	float feedback = (any(historyUV < 0.0) || any(historyUV > 1.0)) ? 0.0 : pushConstants.feedback;
+
+	return float4(YCoCgToRGB(lerp(current, history, feedback)), 1.0);
+}
@@ -18,6 +18,8 @@ struct PushConstants
 {
 	float2 scale;
 	float2 translate;
+	// Columns of the rotation into pre-rotated swap chain images
+	float4 rotation;
 };
 
 [[vk::push_constant]]
@@ -26,7 +28,8 @@ PushConstants pushConstants;
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Pos = float4(input.Pos * pushConstants.scale + pushConstants.translate, 0.0, 1.0);
+	float2 pos = input.Pos * pushConstants.scale + pushConstants.translate;
+	output.Pos = float4(pos.x * pushConstants.rotation.xy + pos.y * pushConstants.rotation.zw, 0.0, 1.0);
 	output.UV = input.UV;
 	output.Color = input.Color;
 	return output;
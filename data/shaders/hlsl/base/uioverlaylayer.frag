@@ -0,0 +1,14 @@
+// Copyright 2020 Google LLC
+
+// Composites the cached UI overlay layer, which has the size of the frame and stores premultiplied colors
+
+Texture2D textureLayer : register(t0);
+SamplerState samplerLayer : register(s0);
+
+float4 main(float4 pos : SV_POSITION, [[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Sampled at texel centers, so filtering doesn't change the layer
+	float2 size;
+	textureLayer.GetDimensions(size.x, size.y);
+	return textureLayer.Sample(samplerLayer, pos.xy / size);
+}
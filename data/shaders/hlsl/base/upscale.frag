@@ -0,0 +1,49 @@
+// Copyright 2020 Google LLC
+
+// Upscales the scene rendered at a reduced resolution to the swap chain with a contrast adaptive sharpening filter
+
+Texture2D textureScene : register(t0);
+SamplerState samplerScene : register(s0);
+
+struct PushConstants
+{
+	// Size of the area the scene has been rendered to
+	float2 renderSize;
+	// 1 / size of the scene image
+	float2 texelSize;
+	// Negative to copy the scene without sharpening
+	float sharpness;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+float3 fetch(float2 uv)
+{
+	// Don't filter across the edge of the render area, the rest of the image contains stale data
+	float2 maxUV = (pushConstants.renderSize - 0.5) * pushConstants.texelSize;
+	return textureScene.Sample(samplerScene, clamp(uv, 0.5 * pushConstants.texelSize, maxUV)).rgb;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float2 uv = inUV * pushConstants.renderSize * pushConstants.texelSize;
+
+	// Bilinear upscale of the center and its neighbours one source texel apart
+	float3 c = fetch(uv);
+	// A negative sharpness is passed at native resolution, where the scene is copied as is
+	if (pushConstants.sharpness < 0.0) {
+		return float4(c, 1.0);
+	}
+	float3 n = fetch(uv + float2(0.0, -pushConstants.texelSize.y));
+	float3 s = fetch(uv + float2(0.0, pushConstants.texelSize.y));
+	float3 e = fetch(uv + float2(pushConstants.texelSize.x, 0.0));
+	float3 w = fetch(uv + float2(-pushConstants.texelSize.x, 0.0));
+
+	// Sharpen less where the local contrast is already high to avoid ringing
+	float3 minRGB = min(c, min(min(n, s), min(e, w)));
+	float3 maxRGB = max(c, max(max(n, s), max(e, w)));
+	float3 amplitude = sqrt(saturate(min(minRGB, 1.0 - maxRGB) / max(maxRGB, 1.0e-4)));
+	float3 weight = amplitude * (-1.0 / lerp(8.0, 5.0, pushConstants.sharpness));
+
+	float3 color = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+	return float4(saturate(color), 1.0);
+}
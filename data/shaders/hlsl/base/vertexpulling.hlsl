@@ -0,0 +1,86 @@
+// Copyright 2020 Google LLC
+
+// Programmable vertex pulling for vkglTF models (see vkglTF::Model::prepareVertexPulling)
+// Vertex components are fetched from the model's vertex buffer and decoded as described by its layout, so the same shader works with the full and the compact vertex layout
+// Define VERTEX_PULLING_SET to the set index of the vertex pulling descriptor set before including this file
+
+#define VERTEX_COMPONENT_POSITION 0
+#define VERTEX_COMPONENT_NORMAL 1
+#define VERTEX_COMPONENT_UV 2
+#define VERTEX_COMPONENT_COLOR 3
+#define VERTEX_COMPONENT_TANGENT 4
+#define VERTEX_COMPONENT_JOINT0 5
+#define VERTEX_COMPONENT_WEIGHT0 6
+
+// Matches vkglTF::Model::VertexPulling::Format
+#define VERTEX_FORMAT_UNDEFINED 0
+#define VERTEX_FORMAT_FLOAT2 1
+#define VERTEX_FORMAT_FLOAT3 2
+#define VERTEX_FORMAT_FLOAT4 3
+#define VERTEX_FORMAT_HALF2 4
+#define VERTEX_FORMAT_SNORM10X3 5
+#define VERTEX_FORMAT_SNORM16X4 6
+#define VERTEX_FORMAT_UNORM8X4 7
+#define VERTEX_FORMAT_UINT8X4 8
+#define VERTEX_FORMAT_UINT16X4 9
+
+[[vk::binding(0, VERTEX_PULLING_SET)]] ByteAddressBuffer vertexData;
+
+struct VertexPullingLayout
+{
+	// Byte offsets and formats indexed by component
+	uint4 offsets[2];
+	uint4 formats[2];
+	uint stride;
+};
+[[vk::binding(1, VERTEX_PULLING_SET)]] cbuffer vertexLayout { VertexPullingLayout vertexLayout; }
+
+float unpackSnorm10(uint bits)
+{
+	return max(float(int(bits << 22) >> 22) / 511.0, -1.0);
+}
+
+float2 unpackSnorm16x2(uint bits)
+{
+	return max(float2(int(bits << 16) >> 16, int(bits) >> 16) / 32767.0, -1.0);
+}
+
+// Returns defaultValue for components the layout doesn't store, and its remaining members for components with less than four channels
+float4 pullVertexComponent(uint vertexIndex, uint component, float4 defaultValue)
+{
+	uint format = vertexLayout.formats[component / 4][component % 4];
+	uint address = vertexIndex * vertexLayout.stride + vertexLayout.offsets[component / 4][component % 4];
+	switch (format) {
+		case VERTEX_FORMAT_FLOAT2:
+			return float4(asfloat(vertexData.Load2(address)), defaultValue.zw);
+		case VERTEX_FORMAT_FLOAT3:
+			return float4(asfloat(vertexData.Load3(address)), defaultValue.w);
+		case VERTEX_FORMAT_FLOAT4:
+			return asfloat(vertexData.Load4(address));
+		case VERTEX_FORMAT_HALF2: {
+			uint bits = vertexData.Load(address);
+			return float4(f16tofloat(bits), f16tofloat(bits >> 16), defaultValue.zw);
+		}
+		case VERTEX_FORMAT_SNORM10X3: {
+			uint bits = vertexData.Load(address);
+			return float4(unpackSnorm10(bits), unpackSnorm10(bits >> 10), unpackSnorm10(bits >> 20), max(float(int(bits) >> 30), -1.0));
+		}
+		case VERTEX_FORMAT_SNORM16X4: {
+			uint2 bits = vertexData.Load2(address);
+			return float4(unpackSnorm16x2(bits.x), unpackSnorm16x2(bits.y));
+		}
+		case VERTEX_FORMAT_UNORM8X4: {
+			uint bits = vertexData.Load(address);
+			return float4(uint4(bits, bits >> 8, bits >> 16, bits >> 24) & 0xFF) / 255.0;
+		}
+		case VERTEX_FORMAT_UINT8X4: {
+			uint bits = vertexData.Load(address);
+			return float4(uint4(bits, bits >> 8, bits >> 16, bits >> 24) & 0xFF);
+		}
+		case VERTEX_FORMAT_UINT16X4: {
+			uint2 bits = vertexData.Load2(address);
+			return float4(uint4(bits.x, bits.x >> 16, bits.y, bits.y >> 16) & 0xFFFF);
+		}
+	}
+	return defaultValue;
+}
@@ -0,0 +1,43 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+// Per-instance attribute, the draw's first instance selects the object
+[[vk::location(2)]] uint ObjectIndex : TEXCOORD0;
+};
+
+struct UBOScene
+{
+	float4x4 projection;
+	float4x4 view;
+};
+cbuffer uboScene : register(b0) { UBOScene uboScene; };
+
+struct Object
+{
+	float4 position;
+	float4 color;
+};
+
+// Data of all objects
+StructuredBuffer<Object> objects : register(t0, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	Object object = objects[input.ObjectIndex];
+	output.Normal = input.Normal;
+	output.Color = object.color.rgb;
+	// The w component of the position stores the object's scale
+	output.Pos = mul(uboScene.projection, mul(uboScene.view, float4(input.Pos * object.position.w + object.position.xyz, 1.0)));
+	return output;
+}
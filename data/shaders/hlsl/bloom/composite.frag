@@ -0,0 +1,17 @@
+// Copyright 2020 Google LLC
+
+// Adds the result of the compute bloom chain to the scene
+
+Texture2D textureBloom : register(t1);
+SamplerState samplerBloom : register(s1);
+
+cbuffer UBO : register(b0)
+{
+	float blurScale;
+	float blurStrength;
+};
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	return float4(textureBloom.Sample(samplerBloom, inUV).rgb * blurStrength, 1.0);
+}
@@ -33,7 +33,7 @@ dir_path = os.path.dirname(os.path.realpath(__file__))
 dir_path = dir_path.replace('\\', '/')
 for root, dirs, files in os.walk(dir_path):
     for file in files:
-        if file.endswith(".vert") or file.endswith(".frag") or file.endswith(".comp") or file.endswith(".geom") or file.endswith(".tesc") or file.endswith(".tese") or file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rmiss"):
+        if file.endswith(".vert") or file.endswith(".frag") or file.endswith(".comp") or file.endswith(".geom") or file.endswith(".tesc") or file.endswith(".tese") or file.endswith(".mesh") or file.endswith(".task") or file.endswith(".rgen") or file.endswith(".rchit") or file.endswith(".rahit") or file.endswith(".rmiss"):
             hlsl_file = os.path.join(root, file)
             spv_out = hlsl_file + ".spv"
 
@@ -50,18 +50,35 @@ for root, dirs, files in os.walk(dir_path):
                 profile = 'hs_6_1'
             elif(hlsl_file.find('.tese') != -1):
                 profile = 'ds_6_1'
+            elif(hlsl_file.find('.mesh') != -1):
+                profile = 'ms_6_5'
+            elif(hlsl_file.find('.task') != -1):
+                profile = 'as_6_5'
             elif(hlsl_file.find('.rgen') != -1 or
 				hlsl_file.find('.rchit') != -1 or
+				hlsl_file.find('.rahit') != -1 or
 				hlsl_file.find('.rmiss') != -1):
                 profile = 'lib_6_3'
 
+            # Wave intrinsics are mapped to subgroup operations, which require SPIR-V 1.3 (base/subgroup.hlsl is made of wave intrinsics)
+            target_env = []
+            with open(hlsl_file) as f:
+                content = f.read()
+                if "Wave" in content or "subgroup.hlsl" in content:
+                    target_env = ['-fspv-target-env=vulkan1.1']
+                # Inline ray tracing (RayQuery) is only available from Vulkan 1.2 on
+                if "RayQuery" in content:
+                    target_env = ['-fspv-target-env=vulkan1.2']
+
             print('Compiling %s' % (hlsl_file))
             subprocess.check_output([
                 dxc_path,
                 '-spirv',
                 '-T', profile,
-                '-E', 'main',
+                '-E', 'main'] + target_env + [
                 '-fspv-extension=SPV_NV_ray_tracing',
+                '-fspv-extension=SPV_KHR_ray_query',
+                '-fspv-extension=SPV_NV_mesh_shader',
                 '-fspv-extension=SPV_KHR_multiview',
                 '-fspv-extension=SPV_KHR_shader_draw_parameters',
                 '-fspv-extension=SPV_EXT_descriptor_indexing',
@@ -4,6 +4,8 @@ struct VSInput
 {
 [[vk::location(0)]]float3 Pos : POSITION0;
 [[vk::location(2)]]float3 Normal : NORMAL0;
+// Per instance collider, xyz = position, w = radius
+[[vk::location(3)]]float4 Collider : TEXCOORD0;
 };
 
 struct VSOutput
@@ -30,9 +32,9 @@ cbuffer ubo : register(b0)
 VSOutput main (VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	float4 eyePos = mul(ubo.modelview, float4(input.Pos.x, input.Pos.y, input.Pos.z, 1.0));
+	float4 pos = float4(input.Pos * input.Collider.w + input.Collider.xyz, 1.0);
+	float4 eyePos = mul(ubo.modelview, pos);
 	output.Pos = mul(ubo.projection, eyePos);
-	float4 pos = float4(input.Pos, 1.0);
 	float3 lPos = ubo.lightPos.xyz;
 	output.LightVec = lPos - pos.xyz;
 	output.ViewVec = -pos.xyz;
@@ -0,0 +1,6 @@
+// Copyright 2020 Google LLC
+
+void main()
+{
+	// Only the depth test is of interest, color writes are disabled by the pipeline
+}
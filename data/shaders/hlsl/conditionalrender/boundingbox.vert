@@ -0,0 +1,34 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct Node
+{
+	float4x4 transform;
+};
+
+cbuffer NodeBuf : register(b0, space1) { Node node; }
+
+struct PushConstant
+{
+	float4 min;
+	float4 max;
+};
+
+[[vk::push_constant]] PushConstant box;
+
+float4 main(uint VertexIndex : SV_VertexID) : SV_POSITION
+{
+	// Unit cube as a triangle strip of 14 vertices, the corner is selected by the bits of the vertex index
+	uint bit = 1u << VertexIndex;
+	float3 corner = float3((0x287a & bit) != 0 ? 1.0 : 0.0, (0x02af & bit) != 0 ? 1.0 : 0.0, (0x31e3 & bit) != 0 ? 1.0 : 0.0);
+	float3 pos = lerp(box.min.xyz, box.max.xyz, corner);
+	return mul(ubo.projection, mul(ubo.view, mul(ubo.model, mul(node.transform, float4(pos, 1.0)))));
+}
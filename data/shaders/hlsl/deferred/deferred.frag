@@ -7,7 +7,14 @@ SamplerState samplerNormal : register(s2);
 Texture2D textureAlbedo : register(t3);
 SamplerState samplerAlbedo : register(s3);
 
+// Light clustering grid, must match the cluster compute shader
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 8
+#define CLUSTER_COUNT_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 512
+
 struct Light {
+	// xyz = position, w = range
 	float4 position;
 	float3 color;
 	float radius;
@@ -15,13 +22,52 @@ struct Light {
 
 struct UBO
 {
-	Light lights[6];
+	float4x4 inverseProjection;
+	float4x4 view;
+	float4x4 inverseView;
 	float4 viewPos;
+	// x = near plane, y = far plane
+	float4 depthRange;
 	int displayDebugTarget;
+	int lightCount;
+	int clustered;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
+StructuredBuffer<Light> lights : register(t5);
+StructuredBuffer<uint> lightGrid : register(t6);
+StructuredBuffer<uint> lightIndices : register(t7);
+
+float3 shadeLight(Light light, float3 fragPos, float3 N, float3 V, float4 albedo)
+{
+	// Vector to light
+	float3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+	if (dist >= light.position.w) {
+		return float3(0.0, 0.0, 0.0);
+	}
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so it reaches zero at the light's range
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
@@ -51,45 +97,31 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		return float4(fragcolor, 1.0);
 	}
 
-	#define lightCount 6
 	#define ambient 0.0
 
 	// Ambient part
 	fragcolor = albedo.rgb * ambient;
 
-	for(int i = 0; i < lightCount; ++i)
-	{
-		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - fragPos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		float3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			float3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			float3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;
+	float3 N = normalize(normal);
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered == 1) {
+		// Only evaluate the lights binned into the cluster containing this fragment
+		float viewZ = -mul(ubo.view, float4(fragPos, 1.0)).z;
+		int slice = int(log(max(viewZ, ubo.depthRange.x) / ubo.depthRange.x) / log(ubo.depthRange.y / ubo.depthRange.x) * float(CLUSTER_COUNT_Z));
+		uint3 cluster = uint3(min(uint2(inUV * float2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y)), uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1)), clamp(slice, 0, CLUSTER_COUNT_Z - 1));
+		uint clusterIndex = cluster.x + cluster.y * CLUSTER_COUNT_X + cluster.z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			fragcolor += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		// Evaluate all lights for every fragment
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shadeLight(lights[i], fragPos, N, V, albedo);
 		}
 	}
 
-  return float4(fragcolor, 1.0);
-}
\ No newline at end of file
+	return float4(fragcolor, 1.0);
+}
@@ -0,0 +1,139 @@
+// Copyright 2020 Google LLC
+
+// Packed G-Buffer written in the previous subpass
+[[vk::input_attachment_index(0)]][[vk::binding(1)]] SubpassInput inputDepth;
+[[vk::input_attachment_index(1)]][[vk::binding(2)]] SubpassInput inputNormal;
+[[vk::input_attachment_index(2)]][[vk::binding(3)]] SubpassInput inputAlbedo;
+
+// Light clustering grid, must match the cluster compute shader
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 8
+#define CLUSTER_COUNT_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 512
+
+struct Light {
+	// xyz = position, w = range
+	float4 position;
+	float3 color;
+	float radius;
+};
+
+struct UBO
+{
+	float4x4 inverseProjection;
+	float4x4 view;
+	float4x4 inverseView;
+	float4 viewPos;
+	// x = near plane, y = far plane
+	float4 depthRange;
+	int displayDebugTarget;
+	int lightCount;
+	int clustered;
+};
+
+cbuffer ubo : register(b4) { UBO ubo; }
+
+StructuredBuffer<Light> lights : register(t5);
+StructuredBuffer<uint> lightGrid : register(t6);
+StructuredBuffer<uint> lightIndices : register(t7);
+
+float3 decodeNormal(float2 f)
+{
+	f = f * 2.0 - 1.0;
+	float3 n = float3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+float3 shadeLight(Light light, float3 fragPos, float3 N, float3 V, float4 albedo)
+{
+	// Vector to light
+	float3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+	if (dist >= light.position.w) {
+		return float3(0.0, 0.0, 0.0);
+	}
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, windowed so it reaches zero at the light's range
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+	// Diffuse part
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored with the packed normal and passed in alpha of albedo
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Get G-Buffer values
+	// The world space position is reconstructed from depth
+	float depth = inputDepth.SubpassLoad().r;
+	float4 viewPos = mul(ubo.inverseProjection, float4(inUV * 2.0 - 1.0, depth, 1.0));
+	float3 fragPos = mul(ubo.inverseView, float4(viewPos.xyz / viewPos.w, 1.0)).xyz;
+	float4 packedNormal = inputNormal.SubpassLoad();
+	float3 normal = decodeNormal(packedNormal.xy);
+	float4 albedo = float4(inputAlbedo.SubpassLoad().rgb, packedNormal.z);
+
+	float3 fragcolor;
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				fragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				fragcolor.rgb = normal;
+				break;
+			case 3: 
+				fragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				fragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		return float4(fragcolor, 1.0);
+	}
+
+	#define ambient 0.0
+
+	// Ambient part
+	fragcolor = albedo.rgb * ambient;
+
+	float3 N = normalize(normal);
+	// Viewer to fragment
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	if (ubo.clustered == 1) {
+		// Only evaluate the lights binned into the cluster containing this fragment
+		float viewZ = -mul(ubo.view, float4(fragPos, 1.0)).z;
+		int slice = int(log(max(viewZ, ubo.depthRange.x) / ubo.depthRange.x) / log(ubo.depthRange.y / ubo.depthRange.x) * float(CLUSTER_COUNT_Z));
+		uint3 cluster = uint3(min(uint2(inUV * float2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y)), uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1)), clamp(slice, 0, CLUSTER_COUNT_Z - 1));
+		uint clusterIndex = cluster.x + cluster.y * CLUSTER_COUNT_X + cluster.z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+		uint count = lightGrid[clusterIndex];
+		for (uint i = 0; i < count; ++i) {
+			fragcolor += shadeLight(lights[lightIndices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]], fragPos, N, V, albedo);
+		}
+	} else {
+		// Evaluate all lights for every fragment
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shadeLight(lights[i], fragPos, N, V, albedo);
+		}
+	}
+
+	return float4(fragcolor, 1.0);
+}
@@ -7,8 +7,7 @@ SamplerState samplerNormal : register(s2);
 Texture2D textureAlbedo : register(t3);
 SamplerState samplerAlbedo : register(s3);
 // Depth from the light's point of view
-//layout (binding = 5) uniform sampler2DShadow samplerShadowMap;
-Texture2DArray textureShadowMap : register(t5);
+Texture2D textureShadowMap : register(t5);
 SamplerState samplerShadowMap : register(s5);
 
 #define LIGHT_COUNT 3
@@ -22,11 +21,14 @@ struct Light
 	float4 target;
 	float4 color;
 	float4x4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's tile in the shadow atlas
+	float4 shadowRect;
 };
 
 struct UBO
 {
 	float4 viewPos;
+	float4x4 inverseViewProjection;
 	Light lights[LIGHT_COUNT];
 	int useShadows;
 	int displayDebugTarget;
@@ -34,7 +36,7 @@ struct UBO
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
-float textureProj(float4 P, float layer, float2 offset)
+float textureProj(float4 P, float4 rect, float2 offset)
 {
 	float shadow = 1.0;
 	float4 shadowCoord = P / P.w;
@@ -42,7 +44,13 @@ float textureProj(float4 P, float layer, float2 offset)
 
 	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0)
 	{
-		float dist = textureShadowMap.Sample(samplerShadowMap, float3(shadowCoord.xy + offset, layer)).r;
+		// Map into the light's tile of the shadow atlas, samples are kept half a texel inside the tile so filtering doesn't pick up its neighbours
+		int2 texDim;
+		textureShadowMap.GetDimensions(texDim.x, texDim.y);
+		float2 halfTexel = 0.5 / float2(texDim);
+		float2 uv = rect.xy + clamp(shadowCoord.xy + offset, 0.0, 1.0) * rect.zw;
+		uv = clamp(uv, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = textureShadowMap.Sample(samplerShadowMap, uv).r;
 		if (shadowCoord.w > 0.0 && dist < shadowCoord.z)
 		{
 			shadow = SHADOW_FACTOR;
@@ -51,13 +59,15 @@ float textureProj(float4 P, float layer, float2 offset)
 	return shadow;
 }
 
-float filterPCF(float4 sc, float layer)
+float filterPCF(float4 sc, float4 rect)
 {
-	int2 texDim; int elements; int levels;
-	textureShadowMap.GetDimensions(0, texDim.x, texDim.y, elements, levels);
+	// Offsets are in the tile's coordinates, so they're scaled by the tile's size in texels
+	int2 atlasDim;
+	textureShadowMap.GetDimensions(atlasDim.x, atlasDim.y);
+	float2 texDim = float2(atlasDim) * rect.zw;
 	float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
 
 	float shadowFactor = 0.0;
 	int count = 0;
@@ -67,7 +77,7 @@ float filterPCF(float4 sc, float layer)
 	{
 		for (int y = -range; y <= range; y++)
 		{
-			shadowFactor += textureProj(sc, layer, float2(dx*x, dy*y));
+			shadowFactor += textureProj(sc, rect, float2(dx*x, dy*y));
 			count++;
 		}
 
@@ -78,13 +88,20 @@ float filterPCF(float4 sc, float layer)
 float3 shadow(float3 fragcolor, float3 fragPos) {
 	for (int i = 0; i < LIGHT_COUNT; ++i)
 	{
+		// Lights without a tile in the shadow atlas don't cast shadows
+		float4 rect = ubo.lights[i].shadowRect;
+		if (rect.z == 0.0)
+		{
+			continue;
+		}
+
 		float4 shadowClip = mul(ubo.lights[i].viewMatrix, float4(fragPos.xyz, 1.0));
 
 		float shadowFactor;
 		#ifdef USE_PCF
-			shadowFactor= filterPCF(shadowClip, i);
+			shadowFactor= filterPCF(shadowClip, rect);
 		#else
-			shadowFactor = textureProj(shadowClip, i, float2(0.0, 0.0));
+			shadowFactor = textureProj(shadowClip, rect, float2(0.0, 0.0));
 		#endif
 
 		fragcolor *= shadowFactor;
@@ -0,0 +1,203 @@
+// Copyright 2020 Google LLC
+
+// Packed G-Buffer written in the previous subpass
+[[vk::input_attachment_index(0)]][[vk::binding(1)]] SubpassInput inputDepth;
+[[vk::input_attachment_index(1)]][[vk::binding(2)]] SubpassInput inputNormal;
+[[vk::input_attachment_index(2)]][[vk::binding(3)]] SubpassInput inputAlbedo;
+// Depth from the light's point of view
+Texture2D textureShadowMap : register(t5);
+SamplerState samplerShadowMap : register(s5);
+
+#define LIGHT_COUNT 3
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.1
+#define USE_PCF
+
+struct Light
+{
+	float4 position;
+	float4 target;
+	float4 color;
+	float4x4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's tile in the shadow atlas
+	float4 shadowRect;
+};
+
+struct UBO
+{
+	float4 viewPos;
+	float4x4 inverseViewProjection;
+	Light lights[LIGHT_COUNT];
+	int useShadows;
+	int displayDebugTarget;
+};
+
+cbuffer ubo : register(b4) { UBO ubo; }
+
+float3 decodeNormal(float2 f)
+{
+	f = f * 2.0 - 1.0;
+	float3 n = float3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+float textureProj(float4 P, float4 rect, float2 offset)
+{
+	float shadow = 1.0;
+	float4 shadowCoord = P / P.w;
+	shadowCoord.xy = shadowCoord.xy * 0.5 + 0.5;
+
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0)
+	{
+		// Map into the light's tile of the shadow atlas, samples are kept half a texel inside the tile so filtering doesn't pick up its neighbours
+		int2 texDim;
+		textureShadowMap.GetDimensions(texDim.x, texDim.y);
+		float2 halfTexel = 0.5 / float2(texDim);
+		float2 uv = rect.xy + clamp(shadowCoord.xy + offset, 0.0, 1.0) * rect.zw;
+		uv = clamp(uv, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = textureShadowMap.Sample(samplerShadowMap, uv).r;
+		if (shadowCoord.w > 0.0 && dist < shadowCoord.z)
+		{
+			shadow = SHADOW_FACTOR;
+		}
+	}
+	return shadow;
+}
+
+float filterPCF(float4 sc, float4 rect)
+{
+	// Offsets are in the tile's coordinates, so they're scaled by the tile's size in texels
+	int2 atlasDim;
+	textureShadowMap.GetDimensions(atlasDim.x, atlasDim.y);
+	float2 texDim = float2(atlasDim) * rect.zw;
+	float scale = 1.5;
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 1;
+
+	for (int x = -range; x <= range; x++)
+	{
+		for (int y = -range; y <= range; y++)
+		{
+			shadowFactor += textureProj(sc, rect, float2(dx*x, dy*y));
+			count++;
+		}
+
+	}
+	return shadowFactor / count;
+}
+
+float3 shadow(float3 fragcolor, float3 fragPos) {
+	for (int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		// Lights without a tile in the shadow atlas don't cast shadows
+		float4 rect = ubo.lights[i].shadowRect;
+		if (rect.z == 0.0)
+		{
+			continue;
+		}
+
+		float4 shadowClip = mul(ubo.lights[i].viewMatrix, float4(fragPos.xyz, 1.0));
+
+		float shadowFactor;
+		#ifdef USE_PCF
+			shadowFactor= filterPCF(shadowClip, rect);
+		#else
+			shadowFactor = textureProj(shadowClip, rect, float2(0.0, 0.0));
+		#endif
+
+		fragcolor *= shadowFactor;
+	}
+	return fragcolor;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Get G-Buffer values
+	// The world space position is reconstructed from depth
+	float4 worldPos = mul(ubo.inverseViewProjection, float4(inUV * 2.0 - 1.0, inputDepth.SubpassLoad().r, 1.0));
+	float3 fragPos = worldPos.xyz / worldPos.w;
+	float4 packedNormal = inputNormal.SubpassLoad();
+	float3 normal = decodeNormal(packedNormal.xy);
+	// Specular is stored with the packed normal
+	float4 albedo = float4(inputAlbedo.SubpassLoad().rgb, packedNormal.z);
+
+	float3 fragcolor;
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				fragcolor.rgb = shadow(float3(1.0, 1.0, 1.0), fragPos);
+				break;
+			case 2: 
+				fragcolor.rgb = fragPos;
+				break;
+			case 3: 
+				fragcolor.rgb = normal;
+				break;
+			case 4: 
+				fragcolor.rgb = albedo.rgb;
+				break;
+			case 5: 
+				fragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		return float4(fragcolor, 1.0);
+	}
+
+	// Ambient part
+	fragcolor  = albedo.rgb * AMBIENT_LIGHT;
+
+	float3 N = normalize(normal);
+
+	for(int i = 0; i < LIGHT_COUNT; ++i)
+	{
+		// Vector to light
+		float3 L = ubo.lights[i].position.xyz - fragPos;
+		// Distance from light to fragment position
+		float dist = length(L);
+		L = normalize(L);
+
+		// Viewer to fragment
+		float3 V = ubo.viewPos.xyz - fragPos;
+		V = normalize(V);
+
+		float lightCosInnerAngle = cos(radians(15.0));
+		float lightCosOuterAngle = cos(radians(25.0));
+		float lightRange = 100.0;
+
+		// Direction vector from source to target
+		float3 dir = normalize(ubo.lights[i].position.xyz - ubo.lights[i].target.xyz);
+
+		// Dual cone spot light with smooth transition between inner and outer angle
+		float cosDir = dot(L, dir);
+		float spotEffect = smoothstep(lightCosOuterAngle, lightCosInnerAngle, cosDir);
+		float heightAttenuation = smoothstep(lightRange, 0.0f, dist);
+
+		// Diffuse lighting
+		float NdotL = max(0.0, dot(N, L));
+		float3 diff = NdotL.xxx;
+
+		// Specular lighting
+		float3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		float3 spec = (pow(NdotR, 16.0) * albedo.a * 2.5).xxx;
+
+		fragcolor += float3((diff + spec) * spotEffect * heightAttenuation) * ubo.lights[i].color.rgb * albedo.rgb;
+	}
+
+	// Shadow calculations in a separate pass
+	if (ubo.useShadows > 0)
+	{
+		fragcolor = shadow(fragcolor, fragPos);
+	}
+
+	return float4(fragcolor, 1);
+}
\ No newline at end of file
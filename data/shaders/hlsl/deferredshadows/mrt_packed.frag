@@ -0,0 +1,54 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+Texture2D textureNormalMap : register(t2);
+SamplerState samplerNormalMap : register(s2);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float3 Color : COLOR0;
+[[vk::location(3)]] float3 WorldPos : POSITION0;
+[[vk::location(4)]] float3 Tangent : TEXCOORD1;
+};
+
+// Packed G-Buffer, the position is reconstructed from depth
+struct FSOutput
+{
+	float4 Normal : SV_TARGET0;
+	float4 Albedo : SV_TARGET1;
+};
+
+// Octahedral normal encoding, maps the unit sphere to [0..1]^2 with an almost uniform precision
+float2 octWrap(float2 v)
+{
+	return (1.0 - abs(v.yx)) * float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+float2 encodeNormal(float3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+
+	// Calculate normal in tangent space
+	float3 N = normalize(input.Normal);
+	float3 T = normalize(input.Tangent);
+	float3 B = cross(N, T);
+	float3x3 TBN = float3x3(T, B, N);
+	float3 tnorm = mul(normalize(textureNormalMap.Sample(samplerNormalMap, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
+
+	float4 color = textureColor.Sample(samplerColor, input.UV);
+
+	// Specular is stored with the normal, as the packed albedo format has no alpha
+	output.Normal = float4(encodeNormal(normalize(tnorm)), color.a, 0.0);
+	output.Albedo = float4(color.rgb, 1.0);
+	return output;
+}
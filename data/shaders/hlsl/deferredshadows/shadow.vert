@@ -1,15 +1,23 @@
 // Copyright 2020 Google LLC
 
-struct VSOutput
+#define LIGHT_COUNT 3
+
+struct UBO
+{
+	float4x4 mvp[LIGHT_COUNT];
+	float4 instancePos[3];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Light whose tile of the shadow atlas is rendered
+struct PushConsts
 {
-	float4 Pos : SV_POSITION;
-[[vk::location(0)]] int InstanceIndex : TEXCOORD0;
+	int light;
 };
+[[vk::push_constant]] PushConsts pushConsts;
 
-VSOutput main([[vk::location(0)]] float4 Pos : POSITION0, uint InstanceIndex : SV_InstanceID)
+float4 main([[vk::location(0)]] float4 Pos : POSITION0, uint InstanceIndex : SV_InstanceID) : SV_POSITION
 {
-	VSOutput output = (VSOutput)0;
-	output.InstanceIndex = InstanceIndex;
-	output.Pos = Pos;
-	return output;
-}
\ No newline at end of file
+	return mul(ubo.mvp[pushConsts.light], Pos + ubo.instancePos[InstanceIndex]);
+}
@@ -0,0 +1,43 @@
+// Copyright 2020 Google LLC
+
+// Multi-channel signed distance field font, the median of the color channels is the distance to the glyph's outline
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+
+struct UBO
+{
+	float4 outlineColor;
+	float outlineWidth;
+	float outline;
+	// Width of the distance field's transition in atlas texels
+	float distanceRange;
+};
+
+cbuffer ubo : register(b2) { UBO ubo; }
+
+float median(float3 value)
+{
+	return max(min(value.r, value.g), min(max(value.r, value.g), value.b));
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float dist = median(textureColor.Sample(samplerColor, inUV).rgb);
+	// Number of screen pixels covered by the distance range, the edge transition is kept at about one pixel at any scale
+	float2 textureSize;
+	textureColor.GetDimensions(textureSize.x, textureSize.y);
+	float2 unitRange = ubo.distanceRange.xx / textureSize;
+	float screenPxRange = max(0.5 * dot(unitRange, 1.0 / fwidth(inUV)), 1.0);
+	float alpha = saturate((dist - 0.5) * screenPxRange + 0.5);
+	float3 rgb = alpha.xxx;
+
+	if (ubo.outline > 0.0)
+	{
+		float w = 1.0 - ubo.outlineWidth;
+		alpha = saturate((dist - w) * screenPxRange + 0.5);
+		rgb += lerp(alpha.xxx, ubo.outlineColor.rgb, alpha);
+	}
+
+	return float4(rgb, alpha);
+}
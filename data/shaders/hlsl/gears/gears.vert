@@ -2,22 +2,37 @@
 
 struct VSInput
 {
-[[vk::location(0)]] float4 Pos : POSITION0;
+[[vk::location(0)]] float3 Pos : POSITION0;
 [[vk::location(1)]] float3 Normal : NORMAL0;
-[[vk::location(2)]] float3 Color : COLOR0;
+// Index of a visible instance, per instance attribute sourced from the culling output
+[[vk::location(2)]] uint InstanceIndex : TEXCOORD0;
 };
 
 struct UBO
 {
 	float4x4 projection;
-	float4x4 model;
-	float4x4 normal;
 	float4x4 view;
-	float3 lightpos;
+	float4 lightPos;
+	float4 frustumPlanes[6];
+	float time;
+	uint instanceCount;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct Gear
+{
+	// xyz = position, w = rotation offset in degrees
+	float4 position;
+	// rgb = color, w = rotation speed
+	float4 color;
+	uint profile;
+	float radius;
+	uint2 _pad;
+};
+
+StructuredBuffer<Gear> instances : register(t1);
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -30,13 +45,20 @@ struct VSOutput
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Normal = normalize(mul((float4x3)ubo.normal, input.Normal).xyz);
-	output.Color = input.Color;
-	float4x4 modelView = mul(ubo.view, ubo.model);
-	float4 pos = mul(modelView, input.Pos);
-	output.EyePos = mul(modelView, pos).xyz;
-	float4 lightPos = mul(float4(ubo.lightpos, 1.0), modelView);
-	output.LightVec = normalize(lightPos.xyz - output.EyePos);
+	Gear gear = instances[input.InstanceIndex];
+
+	float angle = radians(gear.color.w * ubo.time + gear.position.w);
+	float3x3 rotation = float3x3(
+		cos(angle), -sin(angle), 0.0,
+		sin(angle), cos(angle), 0.0,
+		0.0, 0.0, 1.0);
+
+	float4 pos = mul(ubo.view, float4(mul(rotation, input.Pos) + gear.position.xyz, 1.0));
+	output.Normal = normalize(mul((float3x3)ubo.view, mul(rotation, input.Normal)));
+	output.Color = gear.color.rgb;
+	output.EyePos = pos.xyz;
+	float3 lightPos = mul(ubo.view, ubo.lightPos).xyz;
+	output.LightVec = normalize(lightPos - output.EyePos);
 	output.Pos = mul(ubo.projection, pos);
 	return output;
-}
\ No newline at end of file
+}
@@ -0,0 +1,51 @@
+// Copyright 2020 Google LLC
+
+// Draws the normal lines written by normaldebug.comp, two vertices per line without any vertex input
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+};
+
+cbuffer ubo : register(b1) { UBO ubo; }
+
+struct Line
+{
+	float3 pos;
+	uint normal;
+};
+
+StructuredBuffer<Line> lines : register(t2);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Color : COLOR0;
+};
+
+float4 unpackSnorm4x8(uint value)
+{
+	int4 bytes = int4(value << 24, value << 16, value << 8, value) >> 24;
+	return clamp(float4(bytes) / 127.0, -1.0, 1.0);
+}
+
+VSOutput main(uint VertexIndex : SV_VertexID)
+{
+	float normalLength = 0.02;
+	Line normalLine = lines[VertexIndex / 2];
+	float3 pos = normalLine.pos;
+	VSOutput output = (VSOutput)0;
+	// Odd vertices are the ends of the lines
+	if ((VertexIndex & 1) == 1)
+	{
+		pos += unpackSnorm4x8(normalLine.normal).xyz * normalLength;
+		output.Color = float3(0.0, 0.0, 1.0);
+	}
+	else
+	{
+		output.Color = float3(1.0, 0.0, 0.0);
+	}
+	output.Pos = mul(ubo.projection, mul(ubo.model, float4(pos, 1.0)));
+	return output;
+}
@@ -5,7 +5,19 @@ SamplerState samplerColor0 : register(s0);
 Texture2D textureColor1 : register(t1);
 SamplerState samplerColor1 : register(s1);
 
+cbuffer Params : register(b2)
+{
+	float exposure;
+	int autoExposure;
+}
+
+// Exposure adapted to the scene luminance by the compute shaders
+// Average luminance (offset 0) and exposure (offset 4)
+ByteAddressBuffer luminanceData : register(t3);
+
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
-	return textureColor0.Sample(samplerColor0, inUV);
+	float4 color = textureColor0.Sample(samplerColor0, inUV);
+	float currentExposure = (autoExposure == 1) ? asfloat(luminanceData.Load(4)) : exposure;
+	return float4(float3(1.0, 1.0, 1.0) - exp(-color.rgb * currentExposure), color.a);
 }
\ No newline at end of file
@@ -31,11 +31,16 @@ struct UBO  {
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
-cbuffer Exposure : register(b2)
+cbuffer Params : register(b2)
 {
 	float exposure;
+	int autoExposure;
 }
 
+// Exposure adapted to the scene luminance by the compute shaders (previous frame), only used with auto exposure
+// Average luminance (offset 0) and exposure (offset 4)
+ByteAddressBuffer luminanceData : register(t3);
+
 FSOutput main(VSOutput input)
 {
 	FSOutput output = (FSOutput)0;
@@ -96,13 +101,15 @@ FSOutput main(VSOutput input)
 	}
 
 
-	// Color with manual exposure into attachment 0
-	output.Color0.rgb = float3(1.0, 1.0, 1.0) - exp(-color.rgb * exposure);
+	// HDR color into attachment 0, exposure and tone mapping are applied in the composition pass
+	output.Color0 = float4(color.rgb, 1.0);
 
 	// Bright parts for bloom into attachment 1
-	float l = dot(output.Color0.rgb, float3(0.2126, 0.7152, 0.0722));
+	float currentExposure = (autoExposure == 1) ? asfloat(luminanceData.Load(4)) : exposure;
+	float3 mapped = float3(1.0, 1.0, 1.0) - exp(-color.rgb * currentExposure);
+	float l = dot(mapped, float3(0.2126, 0.7152, 0.0722));
 	float threshold = 0.75;
-	output.Color1.rgb = (l > threshold) ? output.Color0.rgb : float3(0.0, 0.0, 0.0);
+	output.Color1.rgb = (l > threshold) ? mapped : float3(0.0, 0.0, 0.0);
 	output.Color1.a = 1.0;
 	return output;
 }
\ No newline at end of file
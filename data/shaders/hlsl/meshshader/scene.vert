@@ -0,0 +1,49 @@
+// Copyright 2020 Google LLC
+
+// Vertex pipeline used as baseline for the meshlet pipeline, outputs the same as meshlet.mesh
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+[[vk::location(4)]] float4 Tangent : TEXCOORD1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+	float4 viewPos;
+	float4 frustumPlanes[6];
+	uint frustumCulling;
+	uint coneCulling;
+	uint colorMeshlets;
+};
+cbuffer ubo : register(b0) { UBO ubo; };
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	output.Normal = input.Normal;
+	output.Color = input.Color;
+	output.UV = input.UV;
+	output.Tangent = input.Tangent;
+	output.Pos = mul(ubo.projection, mul(ubo.view, float4(input.Pos, 1.0)));
+	output.LightVec = ubo.lightPos.xyz - input.Pos;
+	output.ViewVec = ubo.viewPos.xyz - input.Pos;
+	return output;
+}
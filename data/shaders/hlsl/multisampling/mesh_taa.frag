@@ -0,0 +1,39 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureColorMap : register(t0, space1);
+SamplerState samplerColorMap : register(s0, space1);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 CurrentPos : TEXCOORD3;
+[[vk::location(6)]] float4 PrevPos : TEXCOORD4;
+};
+
+struct FSOutput
+{
+	float4 Color : SV_TARGET0;
+	float2 Velocity : SV_TARGET1;
+};
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+	float4 color = textureColorMap.Sample(samplerColorMap, input.UV) * float4(input.Color, 1.0);
+
+	float3 N = normalize(input.Normal);
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = reflect(-L, N);
+	float3 diffuse = max(dot(N, L), 0.15) * input.Color;
+	float3 specular = pow(max(dot(R, V), 0.0), 16.0) * float3(0.75, 0.75, 0.75);
+	output.Color = float4(diffuse * color.rgb + specular, 1.0);
+
+	// Screen space motion in uv units
+	output.Velocity = (input.CurrentPos.xy / input.CurrentPos.w - input.PrevPos.xy / input.PrevPos.w) * 0.5;
+	return output;
+}
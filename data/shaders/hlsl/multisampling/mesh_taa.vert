@@ -0,0 +1,54 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 lightPos;
+	float4x4 prevViewProjection;
+	// xy = current, zw = previous sub-pixel jitter in normalized device coordinates
+	float4 jitter;
+};
+cbuffer ubo : register(b0) { UBO ubo; };
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 CurrentPos : TEXCOORD3;
+[[vk::location(6)]] float4 PrevPos : TEXCOORD4;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	output.Normal = input.Normal;
+	output.Color = input.Color;
+	output.UV = input.UV;
+	output.Pos = mul(ubo.projection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
+
+	// The scene is static, so the previous position only differs by the camera's motion
+	// The jitter is removed from both positions, it would otherwise make static pixels move
+	output.CurrentPos = float4(output.Pos.xy - ubo.jitter.xy * output.Pos.w, output.Pos.zw);
+	output.PrevPos = mul(ubo.prevViewProjection, float4(input.Pos.xyz, 1.0));
+	output.PrevPos.xy -= ubo.jitter.zw * output.PrevPos.w;
+
+	float4 pos = mul(ubo.model, float4(input.Pos, 1.0));
+	output.Normal = mul((float3x3)ubo.model, input.Normal);
+	float3 lPos = mul((float3x3)ubo.model, ubo.lightPos.xyz);
+	output.LightVec = lPos - pos.xyz;
+	output.ViewVec = -pos.xyz;
+	return output;
+}
@@ -11,6 +11,7 @@ struct UBO
 	float4x4 projection;
 	float4x4 view;
 	float4x4 model;
+	float4x4 reflectionViewProjection;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -26,7 +27,8 @@ VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 	output.UV = input.UV;
-	output.ProjCoord = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(input.Pos.xyz, 1.0))));
-	output.Pos = output.ProjCoord;
+	output.Pos = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(input.Pos.xyz, 1.0))));
+	// The reflection is sampled with the view projection it has been rendered with, which reprojects it if it's from an earlier frame
+	output.ProjCoord = mul(ubo.reflectionViewProjection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
 	return output;
 }
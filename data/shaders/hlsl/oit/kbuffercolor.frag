@@ -0,0 +1,56 @@
+// Copyright 2020 Sascha Willems
+
+// K-buffer second pass: Fragments stored in the k-buffer write their color to their layer,
+// all other (farther) fragments are accumulated with weighted blended transparency
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+struct FSOutput
+{
+	float4 Accumulation : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+RWTexture2DArray<uint> depthLayers : register(u1);
+RWTexture2DArray<uint> colorLayers : register(u2);
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+uint packUnorm4x8(float4 value)
+{
+    uint4 bytes = uint4(round(saturate(value) * 255.0));
+    return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+}
+
+FSOutput main(VSOutput input)
+{
+    FSOutput output = (FSOutput)0;
+    uint2 coord = uint2(input.Pos.xy);
+    uint depth = asuint(input.Pos.z);
+    float4 color = pushConsts.color;
+
+    for (uint i = 0; i < K_BUFFER_LAYERS; i++)
+    {
+        if (depthLayers[uint3(coord, i)] == depth)
+        {
+            colorLayers[uint3(coord, i)] = packUnorm4x8(color);
+            // No contribution to the tail
+            return output;
+        }
+    }
+
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - input.Pos.z * 0.9, 3.0), 1e-2, 3e3);
+    output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+    output.Revealage = color.a;
+    return output;
+}
@@ -0,0 +1,32 @@
+// Copyright 2020 Sascha Willems
+
+// K-buffer first pass: Keeps the depths of the nearest K_BUFFER_LAYERS fragments of each pixel, sorted front to back
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+RWTexture2DArray<uint> depthLayers : register(u1);
+
+void main(VSOutput input)
+{
+    uint2 coord = uint2(input.Pos.xy);
+    // Positive floats keep their order if compared as unsigned integers
+    uint depth = asuint(input.Pos.z);
+
+    // Insert into the sorted layers, each layer keeps the smaller depth and passes the larger one on to the next layer
+    for (uint i = 0; i < K_BUFFER_LAYERS; i++)
+    {
+        uint prevDepth;
+        InterlockedMin(depthLayers[uint3(coord, i)], depth, prevDepth);
+        if (prevDepth == 0xffffffff)
+        {
+            break;
+        }
+        depth = max(prevDepth, depth);
+    }
+}
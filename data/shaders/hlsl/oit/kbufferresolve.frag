@@ -0,0 +1,45 @@
+// Copyright 2020 Sascha Willems
+
+// Must match K_BUFFER_LAYERS in oit.cpp
+#define K_BUFFER_LAYERS 4
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccumulation : register(t0);
+SamplerState samplerAccumulation : register(s0);
+Texture2D textureRevealage : register(t1);
+SamplerState samplerRevealage : register(s1);
+RWTexture2DArray<uint> depthLayers : register(u2);
+RWTexture2DArray<uint> colorLayers : register(u3);
+
+float4 unpackUnorm4x8(uint value)
+{
+    return float4(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24) / 255.0;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+    uint2 coord = uint2(input.Pos.xy);
+
+    // Blend the weighted blended tail (fragments behind the k-buffer) over the background
+    float4 accumulation = textureAccumulation.Load(int3(coord, 0));
+    float revealage = textureRevealage.Load(int3(coord, 0)).r;
+    float3 background = float3(0.025, 0.025, 0.025);
+    float3 color = lerp(accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4), background, revealage);
+
+    // Blend the sorted layers back to front
+    for (int i = K_BUFFER_LAYERS - 1; i >= 0; i--)
+    {
+        if (depthLayers[uint3(coord, i)] == 0xffffffff)
+        {
+            continue;
+        }
+        float4 layer = unpackUnorm4x8(colorLayers[uint3(coord, i)]);
+        color = lerp(color, layer.rgb, layer.a);
+    }
+
+    return float4(color, 1.0);
+}
@@ -0,0 +1,23 @@
+// Copyright 2020 Sascha Willems
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccumulation : register(t0);
+SamplerState samplerAccumulation : register(s0);
+Texture2D textureRevealage : register(t1);
+SamplerState samplerRevealage : register(s1);
+
+float4 main(VSOutput input) : SV_TARGET
+{
+    int3 coord = int3(input.Pos.xy, 0);
+    float4 accumulation = textureAccumulation.Load(coord);
+    float revealage = textureRevealage.Load(coord).r;
+
+    // Weighted average of the fragment colors, blended over the background with the total coverage
+    float3 background = float3(0.025, 0.025, 0.025);
+    float3 average = accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4);
+    return float4(lerp(average, background, revealage), 1.0);
+}
@@ -4,6 +4,9 @@ Texture2D textureColorMap : register(t1);
 SamplerState samplerColorMap : register(s1);
 Texture2D textureNormalHeightMap : register(t2);
 SamplerState samplerNormalHeightMap : register(s2);
+// Relaxed cone step map (square root of the cone ratio in red, height in green)
+Texture2D textureConeStepMap : register(t4);
+SamplerState samplerConeStepMap : register(s4);
 
 struct UBO
 {
@@ -11,6 +14,8 @@ struct UBO
 	float parallaxBias;
 	float numLayers;
 	int mappingMode;
+	int coneSteps;
+	int binarySteps;
 };
 
 cbuffer ubo : register(b3) { UBO ubo; }
@@ -69,6 +74,30 @@ float2 parallaxOcclusionMapping(float2 uv, float3 viewDir)
 	return lerp(currUV, prevUV, nextDepth / (nextDepth - prevDepth));
 }
 
+// Relaxed cone stepping (Policarpo and Oliveira, GPU Gems 3), each step advances the ray as far as the cone stored for its current position allows
+// The relaxed cones may let the ray step into the surface once, but never through it, so a short binary search finds the intersection
+float2 relaxedConeStepMapping(float2 uv, float3 viewDir)
+{
+	// Ray in texture space with the depth below the top of the height map in z, scaled to reach the bottom at z = 1
+	float3 rayDir = float3(-viewDir.xy * ubo.heightScale / viewDir.z, 1.0);
+	float rayRatio = length(rayDir.xy);
+	float3 rayPos = float3(uv, 0.0);
+	for (int i = 0; i < ubo.coneSteps; i++) {
+		float2 cone = textureConeStepMap.SampleLevel(samplerConeStepMap, rayPos.xy, 0.0).rg;
+		float coneRatio = cone.r * cone.r;
+		float depth = saturate((1.0 - cone.g) - rayPos.z);
+		rayPos += rayDir * (coneRatio * depth / (rayRatio + coneRatio));
+	}
+	float3 range = 0.5 * rayDir * rayPos.z;
+	float3 searchPos = rayPos - range;
+	for (int j = 0; j < ubo.binarySteps; j++) {
+		float depth = 1.0 - textureConeStepMap.SampleLevel(samplerConeStepMap, searchPos.xy, 0.0).g;
+		range *= 0.5;
+		searchPos += (searchPos.z < depth) ? range : -range;
+	}
+	return searchPos.xy;
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
 	float3 V = normalize(input.TangentViewPos - input.TangentFragPos);
@@ -88,6 +117,9 @@ float4 main(VSOutput input) : SV_TARGET
 			case 4:
 				uv = parallaxOcclusionMapping(input.UV, V);
 				break;
+			case 5:
+				uv = relaxedConeStepMapping(input.UV, V);
+				break;
 		}
 
 		// Discard fragments at texture border
@@ -20,6 +20,8 @@ struct UBOParams {
 	float4 lights[4];
 	float exposure;
 	float gamma;
+	uint irradianceSH;
+	float4 shCoefficients[9];
 };
 cbuffer uboParams : register(b1) { UBOParams uboParams; };
 
@@ -84,6 +86,21 @@ float3 F_SchlickR(float cosTheta, float3 F0, float roughness)
 	return F0 + (max((1.0 - roughness).xxx, F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Diffuse irradiance (divided by PI) from L2 spherical harmonics
+float3 irradianceSH(float3 N)
+{
+	float3 result = uboParams.shCoefficients[0].rgb * 0.282095;
+	result += uboParams.shCoefficients[1].rgb * 0.488603 * N.y;
+	result += uboParams.shCoefficients[2].rgb * 0.488603 * N.z;
+	result += uboParams.shCoefficients[3].rgb * 0.488603 * N.x;
+	result += uboParams.shCoefficients[4].rgb * 1.092548 * N.x * N.y;
+	result += uboParams.shCoefficients[5].rgb * 1.092548 * N.y * N.z;
+	result += uboParams.shCoefficients[6].rgb * 0.315392 * (3.0 * N.z * N.z - 1.0);
+	result += uboParams.shCoefficients[7].rgb * 1.092548 * N.x * N.z;
+	result += uboParams.shCoefficients[8].rgb * 0.546274 * (N.x * N.x - N.y * N.y);
+	return max(result, float3(0.0, 0.0, 0.0));
+}
+
 float3 prefilteredReflection(float3 R, float roughness)
 {
 	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
@@ -143,7 +160,7 @@ float4 main(VSOutput input) : SV_TARGET
 
 	float2 brdf = textureBRDFLUT.Sample(samplerBRDFLUT, float2(max(dot(N, V), 0.0), roughness)).rg;
 	float3 reflection = prefilteredReflection(R, roughness).rgb;
-	float3 irradiance = textureIrradiance.Sample(samplerIrradiance, N).rgb;
+	float3 irradiance = (uboParams.irradianceSH == 1) ? irradianceSH(N) : textureIrradiance.Sample(samplerIrradiance, N).rgb;
 
 	// Diffuse based on irradiance
 	float3 diffuse = irradiance * ALBEDO;
@@ -0,0 +1,10 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureBlur : register(t1);
+SamplerState samplerBlur : register(s1);
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// The radial blur has been applied by the compute shader, so upsampling the reduced resolution result is a single bilinear fetch
+	return textureBlur.Sample(samplerBlur, inUV);
+}
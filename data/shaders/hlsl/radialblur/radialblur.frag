@@ -8,6 +8,8 @@ struct UBO
 	float radialBlurScale;
 	float radialBlurStrength;
 	float2 radialOrigin;
+	int samples;
+	float decay;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -23,13 +25,22 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	float4 color = float4(0.0, 0.0, 0.0, 0.0);
 	UV += radialSize * 0.5 - ubo.radialOrigin;
 
-	#define samples 32
-
-	for (int i = 0; i < samples; i++)
+	// Sample weights decay towards the origin, normalized by their sum so the strength doesn't depend on the sample count
+	float weight = 1.0;
+	float weightSum = (ubo.decay < 1.0) ? (1.0 - pow(ubo.decay, float(ubo.samples))) / (1.0 - ubo.decay) : float(ubo.samples);
+	float remainingWeight = weightSum;
+	for (int i = 0; i < ubo.samples; i++)
 	{
-		float scale = 1.0 - ubo.radialBlurScale * (float(i) / float(samples-1));
-		color += textureColor.Sample(samplerColor, UV * scale + ubo.radialOrigin);
+		float scale = 1.0 - ubo.radialBlurScale * (float(i) / float(max(ubo.samples - 1, 1)));
+		color += textureColor.Sample(samplerColor, UV * scale + ubo.radialOrigin) * weight;
+		remainingWeight -= weight;
+		weight *= ubo.decay;
+		// Early out once the remaining samples can't change an 8 bit result, even if they were all white
+		if (remainingWeight * ubo.radialBlurStrength < weightSum / 512.0)
+		{
+			break;
+		}
 	}
 
-	return (color / samples) * ubo.radialBlurStrength;
-}
\ No newline at end of file
+	return (color / weightSum) * ubo.radialBlurStrength;
+}
@@ -0,0 +1,22 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+};
+
+// Highlights cells that are drawn with their proxy
+struct PushConstants
+{
+	float4 tint;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	// Directional light from above (-y is up)
+	float3 L = normalize(float3(0.5, -1.0, 0.3));
+	float diffuse = max(dot(normalize(input.Normal), L), 0.0);
+	return float4(input.Color * (0.25 + 0.75 * diffuse) * pushConstants.tint.rgb, 1.0);
+}
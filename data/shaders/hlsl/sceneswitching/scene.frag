@@ -0,0 +1,111 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+[[vk::location(4)]] float4 Tangent : TEXCOORD1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4x4 view;
+	float4 camPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct UBOParams {
+	float exposure;
+	float gamma;
+	float roughness;
+	float metallic;
+};
+cbuffer uboParams : register(b1) { UBOParams uboParams; };
+
+TextureCube textureIrradiance : register(t2);
+SamplerState samplerIrradiance : register(s2);
+Texture2D textureBRDFLUT : register(t3);
+SamplerState samplerBRDFLUT : register(s3);
+TextureCube prefilteredMapTexture : register(t4);
+SamplerState prefilteredMapSampler : register(s4);
+
+// Material images of the current scene
+Texture2D colorMapTexture : register(t0, space1);
+SamplerState colorMapSampler : register(s0, space1);
+Texture2D normalMapTexture : register(t1, space1);
+SamplerState normalMapSampler : register(s1, space1);
+
+// From http://filmicworlds.com/blog/filmic-tonemapping-operators/
+float3 Uncharted2Tonemap(float3 color)
+{
+	float A = 0.15;
+	float B = 0.50;
+	float C = 0.10;
+	float D = 0.20;
+	float E = 0.02;
+	float F = 0.30;
+	float W = 11.2;
+	return ((color*(A*color+C*B)+D*E)/(color*(A*color+B)+D*F))-E/F;
+}
+
+float3 F_SchlickR(float cosTheta, float3 F0, float roughness)
+{
+	return F0 + (max((1.0 - roughness).xxx, F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+float3 prefilteredReflection(float3 R, float roughness)
+{
+	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
+	float lod = roughness * MAX_REFLECTION_LOD;
+	float lodf = floor(lod);
+	float lodc = ceil(lod);
+	float3 a = prefilteredMapTexture.SampleLevel(prefilteredMapSampler, R, lodf).rgb;
+	float3 b = prefilteredMapTexture.SampleLevel(prefilteredMapSampler, R, lodc).rgb;
+	return lerp(a, b, lod - lodf);
+}
+
+// Image based lighting only, the scenes are lit by the environment
+float3 shade(float3 albedo, float3 N, float3 V)
+{
+	float roughness = uboParams.roughness;
+	float metallic = uboParams.metallic;
+	float3 R = reflect(-V, N);
+	float3 F0 = lerp((0.04).xxx, albedo, metallic);
+	float2 brdf = textureBRDFLUT.Sample(samplerBRDFLUT, float2(max(dot(N, V), 0.0), roughness)).rg;
+	float3 reflection = prefilteredReflection(R, roughness).rgb;
+	float3 irradiance = textureIrradiance.Sample(samplerIrradiance, N).rgb;
+	float3 F = F_SchlickR(max(dot(N, V), 0.0), F0, roughness);
+	float3 specular = reflection * (F * brdf.x + brdf.y);
+	float3 kD = 1.0 - F;
+	kD *= 1.0 - metallic;
+	float3 color = kD * irradiance * albedo + specular;
+
+	// Tone mapping
+	color = Uncharted2Tonemap(color * uboParams.exposure);
+	color = color * (1.0f / Uncharted2Tonemap((11.2f).xxx));
+	// Gamma correction
+	return pow(color, (1.0f / uboParams.gamma).xxx);
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float4 color = colorMapTexture.Sample(colorMapSampler, input.UV) * float4(input.Color, 1.0);
+	// Alpha masked materials (e.g. foliage) are discarded instead of sorted
+	if (color.a < 0.5) {
+		discard;
+	}
+	float3 N = normalize(input.Normal);
+	if (dot(input.Tangent.xyz, input.Tangent.xyz) > 0.0) {
+		float3 T = normalize(input.Tangent.xyz);
+		float3 B = cross(N, T) * input.Tangent.w;
+		float3x3 TBN = transpose(float3x3(T, B, N));
+		N = normalize(mul(TBN, normalMapTexture.Sample(normalMapSampler, input.UV).xyz * 2.0 - 1.0));
+	}
+	float3 V = normalize(ubo.camPos.xyz - input.WorldPos);
+	return float4(shade(pow(color.rgb, (2.2).xxx), N, V), 1.0);
+}
@@ -5,10 +5,15 @@ struct VSInput
 [[vk::location(0)]] float3 Pos : POSITION0;
 };
 
-struct PushConsts {
-[[vk::offset(0)]] float4x4 mvp;
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4x4 view;
+	float4 camPos;
 };
-[[vk::push_constant]] PushConsts pushConsts;
+
+cbuffer ubo : register(b0) { UBO ubo; }
 
 struct VSOutput
 {
@@ -20,6 +25,6 @@ VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 	output.UVW = input.Pos;
-	output.Pos = mul(pushConsts.mvp, float4(input.Pos.xyz, 1.0));
+	output.Pos = mul(ubo.projection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
 	return output;
 }
@@ -27,6 +27,8 @@ struct VSOutput
 [[vk::location(2)]] float3 ViewVec : TEXCOORD1;
 [[vk::location(3)]] float3 LightVec : TEXCOORD2;
 [[vk::location(4)]] float4 ShadowCoord : TEXCOORD3;
+[[vk::location(5)]] float3 WorldPos : TEXCOORD4;
+[[vk::location(6)]] float3 LightRay : TEXCOORD5;
 };
 
 static const float4x4 biasMat = float4x4(
@@ -47,6 +49,9 @@ VSOutput main(VSInput input)
     output.Normal = mul((float3x3)ubo.model, input.Normal);
     output.LightVec = normalize(ubo.lightPos - input.Pos);
     output.ViewVec = -pos.xyz;
+	// Unnormalized vector to the light for ray traced shadows, interpolates linearly along with the position
+	output.WorldPos = pos.xyz;
+	output.LightRay = ubo.lightPos - pos.xyz;
 
 	output.ShadowCoord = mul(biasMat, mul(ubo.lightSpace, mul(ubo.model, float4(input.Pos, 1.0))));
 	return output;
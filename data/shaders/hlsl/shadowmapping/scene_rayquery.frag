@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+
+Texture2D shadowMapTexture : register(t1);
+SamplerState shadowMapSampler : register(s1);
+RaytracingAccelerationStructure topLevelAS : register(t2);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+[[vk::location(4)]] float4 ShadowCoord : TEXCOORD3;
+[[vk::location(5)]] float3 WorldPos : TEXCOORD4;
+[[vk::location(6)]] float3 LightRay : TEXCOORD5;
+};
+
+// Only trace rays for pixels in the penumbra of the (low resolution) shadow map
+[[vk::constant_id(0)]] const int hybrid = 0;
+
+#define ambient 0.1
+
+float textureProj(float4 shadowCoord, float2 off)
+{
+	float shadow = 1.0;
+	if ( shadowCoord.z > -1.0 && shadowCoord.z < 1.0 )
+	{
+		float dist = shadowMapTexture.Sample( shadowMapSampler, shadowCoord.xy + off ).r;
+		if ( shadowCoord.w > 0.0 && dist < shadowCoord.z )
+		{
+			shadow = ambient;
+		}
+	}
+	return shadow;
+}
+
+// Wider kernel than the shadow map only path, so that all pixels close to a shadow edge of the coarse shadow map are classified as penumbra
+float filterPCF(float4 sc)
+{
+	int2 texDim;
+	shadowMapTexture.GetDimensions(texDim.x, texDim.y);
+	float scale = 1.5;
+	float dx = scale * 1.0 / float(texDim.x);
+	float dy = scale * 1.0 / float(texDim.y);
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 2;
+
+	for (int x = -range; x <= range; x++)
+	{
+		for (int y = -range; y <= range; y++)
+		{
+			shadowFactor += textureProj(sc, float2(dx*x, dy*y));
+			count++;
+		}
+	}
+	return shadowFactor / count;
+}
+
+float traceShadowRay(VSOutput input, float3 N)
+{
+	float lightDist = length(input.LightRay);
+	float3 L = input.LightRay / lightDist;
+
+	RayDesc rayDesc;
+	// Move the origin off the surface towards the light to avoid self intersections
+	rayDesc.Origin = input.WorldPos + N * (dot(N, L) >= 0.0 ? 0.01 : -0.01);
+	rayDesc.Direction = L;
+	rayDesc.TMin = 0.0;
+	rayDesc.TMax = lightDist;
+
+	RayQuery<RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_FORCE_OPAQUE> rayQuery;
+	rayQuery.TraceRayInline(topLevelAS, 0, 0xFF, rayDesc);
+
+	// Start the ray traversal, Proceed returns false if the traversal is complete
+	while (rayQuery.Proceed()) { }
+
+	// If anything has been hit between the fragment and the light, the fragment is shadowed
+	return (rayQuery.CommittedStatus() == COMMITTED_TRIANGLE_HIT) ? ambient : 1.0;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float3 N = normalize(input.Normal);
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = normalize(-reflect(L, N));
+	float3 diffuse = max(dot(N, L), ambient) * input.Color;
+
+	float shadow;
+	if (hybrid == 1) {
+		// Fully lit and fully shadowed pixels keep the result of the shadow map, only the penumbra is traced
+		shadow = filterPCF(input.ShadowCoord / input.ShadowCoord.w);
+		if ((shadow > ambient + 0.001) && (shadow < 0.999)) {
+			shadow = traceShadowRay(input, N);
+		}
+	} else {
+		shadow = traceShadowRay(input, N);
+	}
+
+	return float4(diffuse * shadow, 1.0);
+}
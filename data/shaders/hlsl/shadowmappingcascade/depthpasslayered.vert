@@ -0,0 +1,40 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+};
+// todo: pass via specialization constant
+#define SHADOW_MAP_CASCADE_COUNT 4
+
+struct PushConsts {
+	float4 position;
+	uint cascadeIndex;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct UBO  {
+	float4x4 cascadeViewProjMat[SHADOW_MAP_CASCADE_COUNT];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float2 UV : TEXCOORD0;
+	uint Layer : SV_RenderTargetArrayIndex;
+};
+
+// Note: SV_InstanceID includes the first instance of the draw, which selects the first cascade drawn
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	output.UV = input.UV;
+	float3 pos = input.Pos + pushConsts.position.xyz;
+	// Each instance renders into the layer of one cascade
+	output.Layer = InstanceIndex;
+	output.Pos = mul(ubo.cascadeViewProjMat[InstanceIndex], float4(pos, 1.0));
+	return output;
+}
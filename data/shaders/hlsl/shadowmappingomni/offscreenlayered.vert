@@ -0,0 +1,32 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float4 WorldPos : POSITION0;
+[[vk::location(1)]] float3 LightPos : POSITION1;
+	uint Layer : SV_RenderTargetArrayIndex;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+	float4 lightPos;
+	float4x4 faceViews[6];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+VSOutput main([[vk::location(0)]] float3 Pos : POSITION0, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// Each instance renders into the layer of one cube map face
+	output.Layer = InstanceIndex;
+	output.Pos = mul(ubo.projection, mul(ubo.faceViews[InstanceIndex], mul(ubo.model, float4(Pos, 1.0))));
+
+	output.WorldPos = float4(Pos, 1.0);
+	output.LightPos = ubo.lightPos.xyz;
+	return output;
+}
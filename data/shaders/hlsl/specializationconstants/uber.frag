@@ -20,8 +20,28 @@ struct VSOutput
 // Parameter for the toon shading part of the shader
 [[vk::constant_id(1)]] const /*float*/int PARAM_TOON_DESATURATION = 0.0f;
 
+// Optional features, the generic pipeline reads them from the push constant while specialized
+// pipelines (see vks::PipelinePermutations) bake them in so the disabled code is removed
+[[vk::constant_id(2)]] const bool SPECIALIZED = false;
+[[vk::constant_id(3)]] const bool FEATURE_SPECULAR = false;
+[[vk::constant_id(4)]] const bool FEATURE_RIM_LIGHT = false;
+
+struct PushConsts {
+	uint features;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+#define FEATURE_BIT_SPECULAR 1
+#define FEATURE_BIT_RIM_LIGHT 2
+
+bool featureEnabled(bool specializedValue, uint bit)
+{
+	return SPECIALIZED ? specializedValue : ((pushConsts.features & bit) != 0);
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
+	float4 outColor = float4(0, 0, 0, 0);
 	switch (LIGHTING_MODEL) {
 		case 0: // Phong
 		{
@@ -31,8 +51,9 @@ float4 main(VSOutput input) : SV_TARGET
 			float3 V = normalize(input.ViewVec);
 			float3 R = reflect(-L, N);
 			float3 diffuse = max(dot(N, L), 0.0) * input.Color;
-			float3 specular = pow(max(dot(R, V), 0.0), 32.0) * float3(0.75, 0.75, 0.75);
-			return float4(ambient + diffuse * 1.75 + specular, 1.0);
+			float3 specular = featureEnabled(FEATURE_SPECULAR, FEATURE_BIT_SPECULAR) ? pow(max(dot(R, V), 0.0), 32.0) * float3(0.75, 0.75, 0.75) : float3(0.0, 0.0, 0.0);
+			outColor = float4(ambient + diffuse * 1.75 + specular, 1.0);
+			break;
 		}
 		case 1: // Toon
 		{
@@ -53,7 +74,8 @@ float4 main(VSOutput input) : SV_TARGET
 				color = input.Color * 0.2;
 			// Desaturate a bit
 			color = float3(lerp(color, dot(float3(0.2126,0.7152,0.0722), color).xxx, asfloat(PARAM_TOON_DESATURATION)));
-			return float4(color, 1);
+			outColor = float4(color, 1);
+			break;
 		}
 		case 2: // Textured
 		{
@@ -64,10 +86,16 @@ float4 main(VSOutput input) : SV_TARGET
 			float3 V = normalize(input.ViewVec);
 			float3 R = reflect(-L, N);
 			float3 diffuse = max(dot(N, L), 0.0) * color.rgb;
-			float specular = pow(max(dot(R, V), 0.0), 32.0) * color.a;
-			return float4(ambient + diffuse + specular.xxx, 1.0);
+			float specular = featureEnabled(FEATURE_SPECULAR, FEATURE_BIT_SPECULAR) ? pow(max(dot(R, V), 0.0), 32.0) * color.a : 0.0;
+			outColor = float4(ambient + diffuse + specular.xxx, 1.0);
+			break;
 		}
 	}
 
-	return float4(0, 0, 0, 0);
+	if (featureEnabled(FEATURE_RIM_LIGHT, FEATURE_BIT_RIM_LIGHT)) {
+		float rim = pow(1.0 - max(dot(normalize(input.Normal), normalize(input.ViewVec)), 0.0), 3.0);
+		outColor.rgb += (rim * 0.5).xxx;
+	}
+
+	return outColor;
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ SamplerState samplerSSAOBlur : register(s4);
 struct UBO
 {
 	float4x4 _dummy;
+	float4x4 _dummy2;
 	int ssao;
 	int ssaoOnly;
 	int ssaoBlur;
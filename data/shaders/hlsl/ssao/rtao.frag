@@ -0,0 +1,90 @@
+// Copyright 2020 Google LLC
+
+// Ray traced ambient occlusion, a few short rays per pixel are traced against the scene's acceleration structure with ray queries
+// Unlike the screen space occlusion this also finds occluders that are hidden or outside of the view, the noisy result
+// is accumulated over frames by the temporal filter and smoothed by the depth aware blur like the screen space occlusion
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureNormal : register(t1);
+SamplerState samplerNormal : register(s1);
+RaytracingAccelerationStructure topLevelAS : register(t2);
+
+// Maximum distance of an occluder
+[[vk::constant_id(0)]] const float RTAO_RADIUS = 1.0;
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 viewToPrevClip;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	uint kernelOffset;
+	uint kernelSamples;
+	float historyWeight;
+	// Seeds the ray directions, so consecutive frames trace different rays
+	uint frameIndex;
+	uint rayCount;
+	// The G-Buffer is in view space, the acceleration structure in world space
+	float4x4 invView;
+};
+cbuffer ubo : register(b3) { UBO ubo; };
+
+#define PI 3.1415926535897932384626433832795
+
+// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+uint hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float random(inout uint seed)
+{
+	seed = hash(seed);
+	return float(seed) / 4294967295.0;
+}
+
+// Cosine weighted direction in the hemisphere around N
+float3 sampleHemisphere(float3 N, inout uint seed)
+{
+	float r = sqrt(random(seed));
+	float phi = 2.0 * PI * random(seed);
+	float3 tangent = normalize(abs(N.x) > 0.9 ? cross(N, float3(0.0, 1.0, 0.0)) : cross(N, float3(1.0, 0.0, 0.0)));
+	float3 bitangent = cross(N, tangent);
+	return normalize(tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + N * sqrt(max(1.0 - r * r, 0.0)));
+}
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_Position) : SV_TARGET
+{
+	float3 fragPos = texturePositionDepth.Sample(samplerPositionDepth, inUV).xyz;
+	float3 worldPos = mul(ubo.invView, float4(fragPos, 1.0)).xyz;
+	float3 N = normalize(mul((float3x3)ubo.invView, normalize(textureNormal.Sample(samplerNormal, inUV).rgb * 2.0 - 1.0)));
+
+	RayDesc rayDesc;
+	// Move the origin off the surface to avoid self intersections
+	rayDesc.Origin = worldPos + N * 0.01;
+	rayDesc.TMin = 0.0;
+	rayDesc.TMax = RTAO_RADIUS;
+
+	uint seed = hash(uint(fragCoord.x) + hash(uint(fragCoord.y) + hash(ubo.frameIndex)));
+
+	float occlusion = 0.0;
+	for (uint i = 0; i < ubo.rayCount; i++) {
+		rayDesc.Direction = sampleHemisphere(N, seed);
+
+		RayQuery<RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_FORCE_OPAQUE> rayQuery;
+		rayQuery.TraceRayInline(topLevelAS, 0, 0xFF, rayDesc);
+
+		// Start the ray traversal, Proceed returns false if the traversal is complete
+		while (rayQuery.Proceed()) { }
+
+		if (rayQuery.CommittedStatus() == COMMITTED_TRIANGLE_HIT) {
+			occlusion += 1.0;
+		}
+	}
+
+	return 1.0 - occlusion / float(ubo.rayCount);
+}
@@ -0,0 +1,43 @@
+// Copyright 2020 Google LLC
+
+// Temporal accumulation of the SSAO result
+// The history is reprojected with the previous frame's view projection and rejected if it belongs to a different surface (disocclusion),
+// it stores the linear depth next to the accumulated occlusion for this check
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureSSAO : register(t1);
+SamplerState samplerSSAO : register(s1);
+Texture2D textureHistory : register(t2);
+SamplerState samplerHistory : register(s2);
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 viewToPrevClip;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	uint kernelOffset;
+	uint kernelSamples;
+	float historyWeight;
+};
+cbuffer ubo : register(b3) { UBO ubo; };
+
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float4 positionDepth = texturePositionDepth.Sample(samplerPositionDepth, inUV);
+	float occlusion = textureSSAO.Sample(samplerSSAO, inUV).r;
+
+	float4 prevClip = mul(ubo.viewToPrevClip, float4(positionDepth.xyz, 1.0));
+	float2 prevUV = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+	float2 history = textureHistory.Sample(samplerHistory, prevUV).rg;
+
+	float historyWeight = ubo.historyWeight;
+	// The clip space w is the linear depth the surface had in the previous frame
+	if (any(prevUV < float2(0.0, 0.0)) || any(prevUV > float2(1.0, 1.0)) || (abs(history.g - prevClip.w) > 0.05 * prevClip.w)) {
+		historyWeight = 0.0;
+	}
+
+	return float2(lerp(occlusion, history.r, historyWeight), positionDepth.w);
+}
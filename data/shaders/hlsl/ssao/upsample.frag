@@ -0,0 +1,36 @@
+// Copyright 2020 Google LLC
+
+// Depth aware (bilateral) blur and upsample of a reduced resolution SSAO result to the G-Buffer resolution
+// Blurs over the 4x4 low resolution texels around the pixel, weighting each one by how close its depth is to the pixel's depth
+// so occlusion doesn't bleed over depth discontinuities
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureSSAO : register(t1);
+SamplerState samplerSSAO : register(s1);
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	const float depthSharpness = 20.0;
+
+	float depth = texturePositionDepth.Sample(samplerPositionDepth, inUV).w;
+	int2 lowResSize;
+	textureSSAO.GetDimensions(lowResSize.x, lowResSize.y);
+	int2 base = int2(floor(inUV * float2(lowResSize) - 0.5)) - 1;
+
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			int2 texel = clamp(base + int2(x, y), int2(0, 0), lowResSize - 1);
+			// Depth the low resolution texel has been computed for
+			float sampleDepth = texturePositionDepth.Sample(samplerPositionDepth, (float2(texel) + 0.5) / float2(lowResSize)).w;
+			float weight = exp(-abs(depth - sampleDepth) * depthSharpness / max(depth, 0.001)) + 0.0001;
+			result += textureSSAO.Load(int3(texel, 0)).r * weight;
+			weightSum += weight;
+		}
+	}
+	return result / weightSum;
+}
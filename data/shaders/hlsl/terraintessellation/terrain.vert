@@ -12,6 +12,7 @@ struct VSOutput
 	float4 Pos : SV_POSITION;
 [[vk::location(0)]] float3 Normal : NORMAL0;
 [[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float4 EdgeModes : TEXCOORD1;
 };
 
 VSOutput main(VSInput input)
@@ -20,5 +21,7 @@ VSOutput main(VSInput input)
 	output.Pos = float4(input.Pos.xyz, 1.0);
 	output.UV = input.UV;
 	output.Normal = input.Normal;
+	// The patches of the fixed grid all have the same size
+	output.EdgeModes = float4(0.0, 0.0, 0.0, 0.0);
 	return output;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+// Copyright 2020 Google LLC
+
+// Control points of the patches of a terrain quadtree node, each instance is a node selected by terrainlod.comp
+
+struct VSInput
+{
+[[vk::location(0)]] float4 Node : POSITION0;
+[[vk::location(1)]] float4 EdgeModes : TEXCOORD0;
+};
+
+Texture2D textureHeight : register(t1);
+SamplerState samplerHeight : register(s1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(2)]] float4 EdgeModes : TEXCOORD1;
+};
+
+// Must match PATCHES_PER_NODE of terrainlod.comp
+#define PATCHES_PER_NODE 8
+// World space extent of the height map (and UVs), same as the former fixed grid of 64 x 64 vertices two units apart
+#define TERRAIN_SCALE 128.0
+
+VSOutput main(VSInput input, uint VertexIndex : SV_VertexID)
+{
+	VSOutput output = (VSOutput)0;
+
+	// Corners in the order of the quad patch indices of the fixed grid
+	const uint2 corners[4] = { uint2(0, 0), uint2(0, 1), uint2(1, 1), uint2(1, 0) };
+	uint patchIndex = VertexIndex / 4;
+	uint2 patchPos = uint2(patchIndex % PATCHES_PER_NODE, patchIndex / PATCHES_PER_NODE);
+	uint2 gridPos = patchPos + corners[VertexIndex % 4];
+	float patchSize = input.Node.z / float(PATCHES_PER_NODE);
+	float2 pos = input.Node.xy + float2(gridPos) * patchSize;
+
+	output.Pos = float4(pos.x, 0.0, pos.y, 1.0);
+	output.UV = (pos + TERRAIN_SCALE / 2.0 - 1.0) / TERRAIN_SCALE;
+
+	// Sobel filtered normal with the patch size as the sample distance (but at least two units like the fixed grid)
+	float step = max(patchSize, 2.0) / TERRAIN_SCALE;
+	float heights[3][3];
+	for (int hx = -1; hx <= 1; hx++) {
+		for (int hy = -1; hy <= 1; hy++) {
+			heights[hx + 1][hy + 1] = textureHeight.SampleLevel(samplerHeight, output.UV + float2(hx, hy) * step, 0.0).r;
+		}
+	}
+	float3 normal;
+	normal.x = heights[0][0] - heights[2][0] + 2.0 * heights[0][1] - 2.0 * heights[2][1] + heights[0][2] - heights[2][2];
+	normal.z = heights[0][0] + 2.0 * heights[1][0] + heights[2][0] - heights[0][2] - 2.0 * heights[1][2] - heights[2][2];
+	normal.y = 0.25 * sqrt(max(1.0 - normal.x * normal.x - normal.z * normal.z, 0.0));
+	output.Normal = normalize(normal * float3(2.0, 1.0, 2.0));
+
+	// Only the patch edges on the node's border are matched against the neighbouring nodes
+	// A coarser neighbour's patch edge is centered on the odd end point of this edge (2 = first, 3 = second end point of the outer level's edge)
+	bool evenX = (patchPos.x % 2) == 0;
+	bool evenZ = (patchPos.y % 2) == 0;
+	float4 coarser = float4(evenX ? 2.0 : 3.0, evenZ ? 3.0 : 2.0, evenX ? 3.0 : 2.0, evenZ ? 2.0 : 3.0);
+	bool4 border = bool4(patchPos.y == 0, patchPos.x == 0, patchPos.y == PATCHES_PER_NODE - 1, patchPos.x == PATCHES_PER_NODE - 1);
+	for (int i = 0; i < 4; i++) {
+		output.EdgeModes[i] = !border[i] ? 0.0 : ((input.EdgeModes[i] == 2.0) ? coarser[i] : input.EdgeModes[i]);
+	}
+	return output;
+}
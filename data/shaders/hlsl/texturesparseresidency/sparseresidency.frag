@@ -1,8 +1,24 @@
 // Copyright 2020 Google LLC
 
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 viewPos;
+	float lodBias;
+	int mipTailStart;
+	int2 textureSize;
+	int2 pageSize;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
 Texture2D textureColor : register(t1);
 SamplerState samplerColor : register(s1);
 
+// One flag per virtual page, pages are stored per mip level row by row
+RWStructuredBuffer<uint> feedback : register(u2);
+
 struct VSOutput
 {
 [[vk::location(0)]] float2 UV : TEXCOORD0;
@@ -12,13 +28,35 @@ struct VSOutput
 [[vk::location(4)]] float3 LightVec : TEXCOORD2;
 };
 
+// Request the page containing the current texel at the given mip level
+void requestPage(int mipLevel, float2 uv)
+{
+	// The mip tail is always resident
+	if (mipLevel >= ubo.mipTailStart) {
+		return;
+	}
+	uint pageOffset = 0;
+	for (int i = 0; i < mipLevel; i++) {
+		int2 count = (max(ubo.textureSize >> i, int2(1, 1)) + ubo.pageSize - 1) / ubo.pageSize;
+		pageOffset += uint(count.x * count.y);
+	}
+	int2 mipSize = max(ubo.textureSize >> mipLevel, int2(1, 1));
+	int2 pageCount = (mipSize + ubo.pageSize - 1) / ubo.pageSize;
+	int2 page = clamp(int2(uv * float2(mipSize)), int2(0, 0), mipSize - 1) / ubo.pageSize;
+	feedback[pageOffset + uint(page.y * pageCount.x + page.x)] = 1;
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
 	float4 color = float4(0.0, 0.0, 0.0, 0.0);
 
-	// Fetch sparse until we get a valid texel
+	// Mip level selected by the sampler (nearest mip mode)
+	float lod = textureColor.CalculateLevelOfDetailUnclamped(samplerColor, input.UV) + input.LodBias;
+	requestPage(max(int(floor(lod + 0.5)), 0), input.UV);
+
+	// Fetch sparse until we get a valid texel, the mip tail is always resident
 	uint status;
-	float minLod = input.LodBias;
+	float minLod = max(lod, 0.0);
 	do
 	{
 		color = textureColor.SampleLevel(samplerColor, input.UV, minLod, 0, status);
@@ -0,0 +1,48 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection[2];
+	float4x4 modelview[2];
+	float4 lightPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+	uint ViewportIndex : SV_ViewportArrayIndex;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOOR1;
+[[vk::location(3)]] float3 LightVec : TEXCOOR2;
+};
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// One instance per viewport, the culling shader skips the first instance for primitives only visible in the right viewport
+	// Note: SV_InstanceID includes the first instance of the draw
+	uint viewport = InstanceIndex;
+	output.Normal = mul((float3x3)ubo.modelview[viewport], input.Normal);
+	output.Color = input.Color;
+
+	float4 worldPos = mul(ubo.modelview[viewport], float4(input.Pos.xyz, 1.0));
+	float3 lPos = mul(ubo.modelview[viewport], ubo.lightPos).xyz;
+	output.LightVec = lPos - worldPos.xyz;
+	output.ViewVec = -worldPos.xyz;
+
+	output.Pos = mul(ubo.projection[viewport], worldPos);
+
+	// Set the viewport index directly from the vertex shader instead of duplicating the geometry in a geometry shader
+	output.ViewportIndex = viewport;
+	return output;
+}
@@ -0,0 +1,59 @@
+// Copyright 2020 Google LLC
+
+RWTexture3D<uint> voxels : register(u1);
+
+struct PushConstants
+{
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	float4 gridOrigin;
+	uint gridSize;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+static const float3 lightDir = normalize(float3(0.4, 1.0, 0.3));
+
+float occupancy(float3 pos)
+{
+	int3 coord = int3(floor(pos));
+	if (any(coord < int3(0, 0, 0)) || any(coord >= int3(pushConstants.gridSize, pushConstants.gridSize, pushConstants.gridSize))) {
+		return 0.0;
+	}
+	return voxels[coord] != 0 ? 1.0 : 0.0;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float3 N = normalize(input.Normal);
+	// Grid space position, one unit per voxel
+	float3 pos = (input.WorldPos - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+
+	// Voxel ambient occlusion: March a few directions around the normal through the grid with growing steps and accumulate the occupancy
+	// Starts one voxel off the surface, so the voxels of the surface itself don't occlude it
+	float3 T = normalize(abs(N.y) < 0.99 ? cross(N, float3(0.0, 1.0, 0.0)) : cross(N, float3(1.0, 0.0, 0.0)));
+	float3 B = cross(N, T);
+	const float3 directions[5] = { float3(0.0, 0.0, 1.0), float3(0.7, 0.0, 0.7), float3(-0.7, 0.0, 0.7), float3(0.0, 0.7, 0.7), float3(0.0, -0.7, 0.7) };
+	float occlusion = 0.0;
+	for (int i = 0; i < 5; i++)
+	{
+		float3 dir = normalize(T * directions[i].x + B * directions[i].y + N * directions[i].z);
+		float distance = 1.5;
+		float weight = 1.0;
+		for (int j = 0; j < 4; j++)
+		{
+			occlusion += occupancy(pos + dir * distance) * weight;
+			distance *= 2.0;
+			weight *= 0.5;
+		}
+	}
+	float ao = saturate(1.0 - occlusion / 5.0);
+
+	float diffuse = max(dot(N, -lightDir), 0.0);
+	return float4(input.Color * (0.35 * ao + 0.65 * diffuse), 1.0);
+}
@@ -0,0 +1,62 @@
+// Copyright 2020 Google LLC
+
+RWTexture3D<uint> voxels : register(u1);
+
+struct PushConstants
+{
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	float4 gridOrigin;
+	uint gridSize;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+struct GSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Color : COLOR0;
+[[vk::location(1)]] nointerpolation uint Axis : TEXCOORD0;
+};
+
+uint packUnorm4x8(float4 value)
+{
+	uint4 bytes = uint4(round(saturate(value) * 255.0));
+	return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+}
+
+float4 unpackUnorm4x8(uint value)
+{
+	return float4(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24) / 255.0;
+}
+
+/*
+	Each voxel stores the average albedo in rgb and the number of fragments that contributed to it in a (8 bits each)
+	Concurrent fragments of the same voxel are merged with a compare and swap loop, the count saturates at 255
+*/
+void imageAtomicAverageRGBA8(int3 coord, float3 color)
+{
+	uint newValue = packUnorm4x8(float4(color, 1.0 / 255.0));
+	uint previousValue = 0;
+	uint currentValue;
+	int iteration = 0;
+	InterlockedCompareExchange(voxels[coord], previousValue, newValue, currentValue);
+	while (currentValue != previousValue && iteration < 255)
+	{
+		previousValue = currentValue;
+		float4 stored = unpackUnorm4x8(currentValue);
+		float count = stored.a * 255.0;
+		float3 average = (stored.rgb * count + color) / (count + 1.0);
+		newValue = packUnorm4x8(float4(average, min(count + 1.0, 255.0) / 255.0));
+		InterlockedCompareExchange(voxels[coord], previousValue, newValue, currentValue);
+		iteration++;
+	}
+}
+
+void main(GSOutput input)
+{
+	// Undo the swizzle of the geometry shader, depth spans the grid along the dominant axis
+	float3 pos = float3(input.Pos.xy, input.Pos.z * float(pushConstants.gridSize));
+	pos = (input.Axis == 0) ? pos.zxy : ((input.Axis == 1) ? pos.yzx : pos);
+	// Overestimated fragments can lie slightly outside of the grid
+	int3 coord = clamp(int3(floor(pos)), int3(0, 0, 0), int3(pushConstants.gridSize - 1, pushConstants.gridSize - 1, pushConstants.gridSize - 1));
+	imageAtomicAverageRGBA8(coord, input.Color);
+}
@@ -0,0 +1,30 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float4 Color : COLOR0;
+};
+
+struct PushConstants
+{
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	float4 gridOrigin;
+	uint gridSize;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 VoxelPos : POSITION0;
+[[vk::location(1)]] float3 Color : COLOR0;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	// Grid space position, one unit per voxel
+	output.VoxelPos = (input.Pos - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+	output.Color = input.Color.rgb;
+	return output;
+}
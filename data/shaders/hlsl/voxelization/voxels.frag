@@ -0,0 +1,97 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 inverseProjection;
+	float4x4 inverseView;
+};
+cbuffer ubo : register(b0) { UBO ubo; }
+
+RWTexture3D<uint> voxels : register(u1);
+
+struct PushConstants
+{
+	// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+	float4 gridOrigin;
+	uint gridSize;
+};
+[[vk::push_constant]] PushConstants pushConstants;
+
+static const float3 lightDir = normalize(float3(0.4, 1.0, 0.3));
+
+bool occupied(int3 coord)
+{
+	if (any(coord < int3(0, 0, 0)) || any(coord >= int3(pushConstants.gridSize, pushConstants.gridSize, pushConstants.gridSize))) {
+		return false;
+	}
+	return voxels[coord] != 0;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Camera ray in grid space (one unit per voxel)
+	float4 target = mul(ubo.inverseProjection, float4(inUV * 2.0 - 1.0, 1.0, 1.0));
+	float3 origin = (mul(ubo.inverseView, float4(0.0, 0.0, 0.0, 1.0)).xyz - pushConstants.gridOrigin.xyz) / pushConstants.gridOrigin.w;
+	float3 direction = mul(ubo.inverseView, float4(normalize(target.xyz / target.w), 0.0)).xyz;
+	direction = (direction == float3(0.0, 0.0, 0.0)) ? float3(1e-6, 1e-6, 1e-6) : direction;
+	float3 invDirection = 1.0 / direction;
+
+	// Clip the ray against the grid
+	float size = float(pushConstants.gridSize);
+	float3 t0 = -origin * invDirection;
+	float3 t1 = (float3(size, size, size) - origin) * invDirection;
+	float3 tMin = min(t0, t1);
+	float3 tMax = max(t0, t1);
+	float tEnter = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+	float tExit = min(tMax.x, min(tMax.y, tMax.z));
+	if (tEnter >= tExit) {
+		return float4(0.0, 0.0, 0.0, 1.0);
+	}
+
+	// Walk the voxels along the ray (3D DDA)
+	int3 coord = clamp(int3(floor(origin + direction * (tEnter + 1e-3))), int3(0, 0, 0), int3(size - 1, size - 1, size - 1));
+	int3 stepDir = int3(sign(direction));
+	float3 tDelta = abs(invDirection);
+	float3 tNext = (float3(coord) + max(float3(stepDir), float3(0.0, 0.0, 0.0)) - origin) * invDirection;
+	// Face through which the current voxel was entered
+	float3 normal = -sign(direction) * float3(tMin == float3(tEnter, tEnter, tEnter));
+	for (uint i = 0; i < pushConstants.gridSize * 3; i++)
+	{
+		uint value = voxels[coord];
+		if (value != 0) {
+			float3 albedo = float3(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff) / 255.0;
+			// Cheap ambient occlusion from the occupancy of the voxels in front of the face that has been hit
+			int3 front = coord + int3(normal);
+			int3 tangent = int3(abs(normal.yzx));
+			int3 bitangent = int3(abs(normal.zxy));
+			float occlusion = 0.0;
+			for (int u = -1; u <= 1; u++) {
+				for (int v = -1; v <= 1; v++) {
+					occlusion += occupied(front + tangent * u + bitangent * v) ? 1.0 : 0.0;
+				}
+			}
+			float ao = 1.0 - occlusion / 9.0 * 0.8;
+			float diffuse = max(dot(normal, -lightDir), 0.0);
+			return float4(albedo * (0.35 * ao + 0.65 * diffuse), 1.0);
+		}
+		if (tNext.x < tNext.y && tNext.x < tNext.z) {
+			coord.x += stepDir.x;
+			tNext.x += tDelta.x;
+			normal = float3(-stepDir.x, 0.0, 0.0);
+		} else if (tNext.y < tNext.z) {
+			coord.y += stepDir.y;
+			tNext.y += tDelta.y;
+			normal = float3(0.0, -stepDir.y, 0.0);
+		} else {
+			coord.z += stepDir.z;
+			tNext.z += tDelta.z;
+			normal = float3(0.0, 0.0, -stepDir.z);
+		}
+		if (any(coord < int3(0, 0, 0)) || any(coord >= int3(size, size, size))) {
+			break;
+		}
+	}
+	return float4(0.0, 0.0, 0.0, 1.0);
+}
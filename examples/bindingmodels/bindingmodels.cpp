@@ -0,0 +1,653 @@
+/*
+* Vulkan Example - Per-object data binding models
+*
+* Draws the same grid of objects with one draw call per object and compares different ways of passing the per-object data to the shaders:
+*	- Push constants pushed before each draw
+*	- One dynamic uniform buffer, with the object's offset passed when binding its descriptor set
+*	- Inline uniform blocks (VK_EXT_inline_uniform_block), with one descriptor set per object that contains the object's data
+*	- One storage buffer with the data of all objects, indexed by the draw's first instance
+*
+* Each binding model is recorded into its own command buffer and submitted separately, so the CPU time for recording and submitting
+* and the GPU time (measured with the GPU profiler) can be compared. With all models selected, each one renders the full frame and
+* only the last one is visible. In benchmark mode all timings are added to the results.
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	enum Strategy { PushConstants = 0, DynamicUniformBuffer = 1, InlineUniformBlock = 2, StorageBuffer = 3, StrategyCount = 4 };
+	const char* strategyNames[StrategyCount] = { "Push constants", "Dynamic uniform buffer", "Inline uniform block", "Storage buffer" };
+
+	// Binding models supported by the device
+	std::vector<Strategy> strategies;
+	// Index into strategies, one past the last model records all of them
+	int32_t selectedStrategy = 0;
+	bool inlineUniformBlocksSupported = false;
+	VkPhysicalDeviceInlineUniformBlockFeaturesEXT inlineUniformBlockFeatures{};
+
+	const std::vector<uint32_t> objectCounts = { 1000, 10000, 100000, 1000000 };
+	int32_t objectCountIndex = 0;
+	uint32_t objectCount = 0;
+	bool objectCountChanged = false;
+
+	struct Vertex {
+		float pos[3];
+		float normal[3];
+	};
+	vks::Buffer vertexBuffer;
+	vks::Buffer indexBuffer;
+	uint32_t indexCount = 0;
+
+	// Same layout for all binding models (and the push constant range)
+	struct ObjectData {
+		// xyz = position, w = scale
+		glm::vec4 position;
+		glm::vec4 color;
+	};
+	std::vector<ObjectData> objects;
+
+	struct {
+		// Objects at offsets aligned to minUniformBufferOffsetAlignment
+		vks::Buffer dynamicUniformBuffer;
+		vks::Buffer storageBuffer;
+		// Object index per instance, the storage buffer model's draws select their object via firstInstance
+		vks::Buffer objectIndices;
+	} buffers;
+	VkDeviceSize dynamicAlignment = 0;
+
+	struct UBOScene {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uboScene;
+	vks::Buffer sceneUniformBuffer;
+
+	struct {
+		VkDescriptorSetLayout scene;
+		VkDescriptorSetLayout dynamicUniformBuffer;
+		VkDescriptorSetLayout inlineUniformBlock;
+		VkDescriptorSetLayout storageBuffer;
+	} descriptorSetLayouts;
+
+	struct {
+		VkDescriptorSet scene;
+		VkDescriptorSet dynamicUniformBuffer;
+		VkDescriptorSet storageBuffer;
+		// One set per object, as the data is part of the set
+		std::vector<VkDescriptorSet> inlineUniformBlocks;
+	} descriptorSets;
+	VkDescriptorPool inlineDescriptorPool = VK_NULL_HANDLE;
+
+	std::array<VkPipelineLayout, StrategyCount> pipelineLayouts{};
+	std::array<VkPipeline, StrategyCount> pipelines{};
+
+	// One command buffer per binding model for each frame in flight
+	std::vector<VkCommandPool> commandPools;
+	std::vector<std::array<VkCommandBuffer, StrategyCount>> commandBuffers;
+
+	// Timings (in ms) of the last frame that recorded the binding model
+	struct Timings {
+		double record = 0.0;
+		double submit = 0.0;
+		double gpu = 0.0;
+	};
+	std::array<Timings, StrategyCount> timings;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Per-object data binding models";
+		camera.type = Camera::CameraType::lookat;
+		camera.setRotation(glm::vec3(-25.0f, 35.0f, 0.0f));
+		settings.overlay = true;
+		// Command buffers are recorded each frame, so the recording can be measured
+		dynamicCommandBuffers = true;
+		// Required by VK_EXT_inline_uniform_block
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+		CommandLineParser exampleArgs;
+		exampleArgs.add("objectcount", { "-oc", "--objectcount" }, 1, "Number of objects to draw (rounded up to 1000, 10000, 100000 or 1000000)");
+		exampleArgs.parse(args);
+		const int32_t requestedCount = exampleArgs.getValueAsInt("objectcount", objectCounts[0]);
+		objectCountIndex = static_cast<int32_t>(objectCounts.size()) - 1;
+		for (size_t i = 0; i < objectCounts.size(); i++) {
+			if (static_cast<int32_t>(objectCounts[i]) >= requestedCount) {
+				objectCountIndex = static_cast<int32_t>(i);
+				break;
+			}
+		}
+	}
+
+	~VulkanExample()
+	{
+		for (size_t i = 0; i < commandPools.size(); i++) {
+			for (auto commandBuffer : commandBuffers[i]) {
+				gpuProfiler.release(commandBuffer);
+			}
+			vkDestroyCommandPool(device, commandPools[i], nullptr);
+		}
+		for (uint32_t i = 0; i < StrategyCount; i++) {
+			if (pipelines[i] != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, pipelines[i], nullptr);
+				vkDestroyPipelineLayout(device, pipelineLayouts[i], nullptr);
+			}
+		}
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.dynamicUniformBuffer, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.storageBuffer, nullptr);
+		if (inlineUniformBlocksSupported) {
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.inlineUniformBlock, nullptr);
+		}
+		destroyObjects();
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+		sceneUniformBuffer.destroy();
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME) == 0) {
+				inlineUniformBlocksSupported = true;
+				break;
+			}
+		}
+		if (inlineUniformBlocksSupported) {
+			// The inlineUniformBlock feature must be supported by all devices exposing the extension
+			enabledDeviceExtensions.push_back(VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME);
+			inlineUniformBlockFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INLINE_UNIFORM_BLOCK_FEATURES_EXT;
+			inlineUniformBlockFeatures.inlineUniformBlock = VK_TRUE;
+			inlineUniformBlockFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &inlineUniformBlockFeatures;
+		}
+	}
+
+	void recordStrategy(VkCommandBuffer commandBuffer, Strategy strategy, bool drawOverlay)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		gpuProfiler.beginScope(commandBuffer, strategyNames[strategy]);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		const VkPipelineLayout pipelineLayout = pipelineLayouts[strategy];
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[strategy]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.scene, 0, nullptr);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// One draw per object, only the way the object's data is passed differs
+		switch (strategy) {
+		case PushConstants:
+			for (uint32_t i = 0; i < objectCount; i++) {
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ObjectData), &objects[i]);
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			}
+			break;
+		case DynamicUniformBuffer:
+			for (uint32_t i = 0; i < objectCount; i++) {
+				const uint32_t dynamicOffset = i * static_cast<uint32_t>(dynamicAlignment);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorSets.dynamicUniformBuffer, 1, &dynamicOffset);
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			}
+			break;
+		case InlineUniformBlock:
+			for (uint32_t i = 0; i < objectCount; i++) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorSets.inlineUniformBlocks[i], 0, nullptr);
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			}
+			break;
+		case StorageBuffer:
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &descriptorSets.storageBuffer, 0, nullptr);
+			vkCmdBindVertexBuffers(commandBuffer, 1, 1, &buffers.objectIndices.buffer, offsets);
+			for (uint32_t i = 0; i < objectCount; i++) {
+				// The first instance offsets into the per-instance object indices
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, i);
+			}
+			break;
+		default:
+			break;
+		}
+
+		gpuProfiler.endScope(commandBuffer);
+		if (drawOverlay) {
+			drawUI(commandBuffer);
+		}
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void generateCube()
+	{
+		// Four vertices per face, so each face gets its own normal
+		const glm::vec3 normals[6] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+		const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		for (auto& normal : normals) {
+			const glm::vec3 u = (normal.y != 0.0f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			const glm::vec3 v = glm::cross(normal, u);
+			const uint32_t firstVertex = static_cast<uint32_t>(vertices.size());
+			for (auto& corner : corners) {
+				const glm::vec3 pos = 0.5f * (normal + corner.x * u + corner.y * v);
+				vertices.push_back({ { pos.x, pos.y, pos.z }, { normal.x, normal.y, normal.z } });
+			}
+			for (uint32_t index : { 0, 1, 2, 2, 3, 0 }) {
+				indices.push_back(firstVertex + index);
+			}
+		}
+		indexCount = static_cast<uint32_t>(indices.size());
+		uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.data(), vertices.size() * sizeof(Vertex), vertexBuffer);
+		uploadBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data(), indices.size() * sizeof(uint32_t), indexBuffer);
+	}
+
+	// Create a device local buffer and upload the data through a staging buffer
+	void uploadBuffer(VkBufferUsageFlags usage, void* data, VkDeviceSize size, vks::Buffer& buffer)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, data));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+		vulkanDevice->copyBuffer(&stagingBuffer, &buffer, queue);
+		stagingBuffer.destroy();
+	}
+
+	void destroyObjects()
+	{
+		buffers.dynamicUniformBuffer.destroy();
+		buffers.storageBuffer.destroy();
+		buffers.objectIndices.destroy();
+		if (inlineDescriptorPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(device, inlineDescriptorPool, nullptr);
+			inlineDescriptorPool = VK_NULL_HANDLE;
+		}
+		descriptorSets.inlineUniformBlocks.clear();
+	}
+
+	// (Re)create the object data for all binding models, must not be called while frames are in flight
+	void createObjects()
+	{
+		destroyObjects();
+		objectCount = objectCounts[objectCountIndex];
+
+		// Objects are placed on a cubic grid
+		const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(objectCount))));
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndDist(0.25f, 1.0f);
+		objects.resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			const glm::vec3 gridPos = glm::vec3(i % dim, (i / dim) % dim, i / (dim * dim)) - glm::vec3((float)(dim - 1) / 2.0f);
+			objects[i].position = glm::vec4(gridPos, 0.5f);
+			objects[i].color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
+		}
+
+		// Dynamic uniform buffer offsets need to be aligned
+		std::vector<uint8_t> alignedObjects(objectCount * dynamicAlignment);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			memcpy(&alignedObjects[i * dynamicAlignment], &objects[i], sizeof(ObjectData));
+		}
+		uploadBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, alignedObjects.data(), alignedObjects.size(), buffers.dynamicUniformBuffer);
+		uploadBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objects.data(), objects.size() * sizeof(ObjectData), buffers.storageBuffer);
+		std::vector<uint32_t> objectIndices(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			objectIndices[i] = i;
+		}
+		uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, objectIndices.data(), objectIndices.size() * sizeof(uint32_t), buffers.objectIndices);
+
+		// The dynamic uniform buffer is bound with a range of one object
+		VkDescriptorBufferInfo dynamicDescriptor{ buffers.dynamicUniformBuffer.buffer, 0, sizeof(ObjectData) };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.dynamicUniformBuffer, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &dynamicDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.storageBuffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &buffers.storageBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		if (inlineUniformBlocksSupported) {
+			createInlineUniformBlocks();
+		}
+
+		// Fit the grid into the view
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, (float)dim * 4.0f);
+		camera.setTranslation(glm::vec3(0.0f, 0.0f, -(float)dim * 1.75f));
+		updateUniformBuffers();
+	}
+
+	void createInlineUniformBlocks()
+	{
+		// Inline uniform blocks are sized in bytes and need their own limit on the number of bindings
+		VkDescriptorPoolSize poolSize = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT, objectCount * static_cast<uint32_t>(sizeof(ObjectData)));
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(1, &poolSize, objectCount);
+		VkDescriptorPoolInlineUniformBlockCreateInfoEXT descriptorPoolInlineUniformBlockCI{};
+		descriptorPoolInlineUniformBlockCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_INLINE_UNIFORM_BLOCK_CREATE_INFO_EXT;
+		descriptorPoolInlineUniformBlockCI.maxInlineUniformBlockBindings = objectCount;
+		descriptorPoolCI.pNext = &descriptorPoolInlineUniformBlockCI;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &inlineDescriptorPool));
+
+		// Sets are allocated and written in batches to limit the size of the temporary arrays
+		const uint32_t batchSize = 4096;
+		descriptorSets.inlineUniformBlocks.resize(objectCount);
+		std::vector<VkDescriptorSetLayout> setLayouts(batchSize, descriptorSetLayouts.inlineUniformBlock);
+		std::vector<VkWriteDescriptorSetInlineUniformBlockEXT> inlineWrites(batchSize);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets(batchSize);
+		for (uint32_t first = 0; first < objectCount; first += batchSize) {
+			const uint32_t count = std::min(batchSize, objectCount - first);
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(inlineDescriptorPool, setLayouts.data(), count);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.inlineUniformBlocks[first]));
+			for (uint32_t i = 0; i < count; i++) {
+				inlineWrites[i] = {};
+				inlineWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_INLINE_UNIFORM_BLOCK_EXT;
+				inlineWrites[i].dataSize = sizeof(ObjectData);
+				inlineWrites[i].pData = &objects[first + i];
+				writeDescriptorSets[i] = {};
+				writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writeDescriptorSets[i].pNext = &inlineWrites[i];
+				writeDescriptorSets[i].dstSet = descriptorSets.inlineUniformBlocks[first + i];
+				writeDescriptorSets[i].dstBinding = 0;
+				writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT;
+				// The descriptor count of an inline uniform block is its size in bytes
+				writeDescriptorSets[i].descriptorCount = sizeof(ObjectData);
+			}
+			vkUpdateDescriptorSets(device, count, writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.scene));
+		setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.dynamicUniformBuffer));
+		setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.storageBuffer));
+		if (inlineUniformBlocksSupported) {
+			setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT;
+			// The descriptor count of an inline uniform block is its size in bytes
+			setLayoutBinding.descriptorCount = sizeof(ObjectData);
+			VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.inlineUniformBlock));
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.scene, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.scene));
+		allocInfo.pSetLayouts = &descriptorSetLayouts.dynamicUniformBuffer;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.dynamicUniformBuffer));
+		allocInfo.pSetLayouts = &descriptorSetLayouts.storageBuffer;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.storageBuffer));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &sceneUniformBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+		// The storage buffer model adds a per-instance object index
+		const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+			vks::initializers::vertexInputBindingDescription(1, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE),
+		};
+		const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(1, 2, VK_FORMAT_R32_UINT, 0),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
+		vertexInputStateCI.pVertexBindingDescriptions = vertexInputBindings.data();
+		vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributes.data();
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		shaderStages[1] = loadShader(getShadersPath() + "bindingmodels/object.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(VK_NULL_HANDLE, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputStateCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+
+		for (Strategy strategy : strategies) {
+			// Set 0 (scene matrices) is shared, set 1 holds the per-object data
+			std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.scene };
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(ObjectData), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(nullptr, 0);
+			std::string vertexShader = "uniformblock.vert.spv";
+			vertexInputStateCI.vertexBindingDescriptionCount = 1;
+			vertexInputStateCI.vertexAttributeDescriptionCount = 2;
+			switch (strategy) {
+			case PushConstants:
+				pipelineLayoutCI.pushConstantRangeCount = 1;
+				pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+				vertexShader = "pushconstants.vert.spv";
+				break;
+			case DynamicUniformBuffer:
+				setLayouts.push_back(descriptorSetLayouts.dynamicUniformBuffer);
+				break;
+			case InlineUniformBlock:
+				setLayouts.push_back(descriptorSetLayouts.inlineUniformBlock);
+				break;
+			case StorageBuffer:
+				setLayouts.push_back(descriptorSetLayouts.storageBuffer);
+				vertexInputStateCI.vertexBindingDescriptionCount = 2;
+				vertexInputStateCI.vertexAttributeDescriptionCount = 3;
+				vertexShader = "storagebuffer.vert.spv";
+				break;
+			default:
+				break;
+			}
+			pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+			pipelineLayoutCI.pSetLayouts = setLayouts.data();
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts[strategy]));
+
+			shaderStages[0] = loadShader(getShadersPath() + "bindingmodels/" + vertexShader, VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.layout = pipelineLayouts[strategy];
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines[strategy]));
+		}
+	}
+
+	void prepareCommandBuffers()
+	{
+		VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+		cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		commandPools.resize(maxFramesInFlight);
+		commandBuffers.resize(maxFramesInFlight);
+		for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPools[i]));
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPools[i], VK_COMMAND_BUFFER_LEVEL_PRIMARY, StrategyCount);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, commandBuffers[i].data()));
+		}
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &sceneUniformBuffer, sizeof(UBOScene)));
+		VK_CHECK_RESULT(sceneUniformBuffer.map());
+	}
+
+	void updateUniformBuffers()
+	{
+		waitForFramesInFlight();
+		uboScene.projection = camera.matrices.perspective;
+		uboScene.view = camera.matrices.view;
+		memcpy(sceneUniformBuffer.mapped, &uboScene, sizeof(UBOScene));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		strategies = { PushConstants, DynamicUniformBuffer };
+		if (inlineUniformBlocksSupported) {
+			strategies.push_back(InlineUniformBlock);
+		}
+		strategies.push_back(StorageBuffer);
+		// Record all binding models by default
+		selectedStrategy = static_cast<int32_t>(strategies.size());
+		dynamicAlignment = vks::tools::alignedVkSize(sizeof(ObjectData), vulkanDevice->properties.limits.minUniformBufferOffsetAlignment);
+		generateCube();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		prepareCommandBuffers();
+		createObjects();
+		prepared = true;
+	}
+
+	// Read back the GPU times of the command buffers last submitted for the current frame in flight
+	void collectGpuTimings()
+	{
+		for (Strategy strategy : strategies) {
+			if (!gpuProfiler.collect(commandBuffers[currentFrame][strategy])) {
+				continue;
+			}
+			for (auto& timing : gpuProfiler.timings) {
+				if (timing.name == strategyNames[strategy]) {
+					timings[strategy].gpu = timing.ms;
+					if (benchmark.active) {
+						benchmark.addScopeTime(timing.name, timing.ms);
+					}
+				}
+			}
+		}
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		collectGpuTimings();
+		VK_CHECK_RESULT(vkResetCommandPool(device, commandPools[currentFrame], 0));
+
+		// Taken from the frame arena, so recording doesn't allocate from the heap
+		vks::FrameVector<Strategy> recordedStrategies(frameArena);
+		if (selectedStrategy < static_cast<int32_t>(strategies.size())) {
+			recordedStrategies.push_back(strategies[selectedStrategy]);
+		} else {
+			recordedStrategies.assign(strategies.begin(), strategies.end());
+		}
+		for (size_t i = 0; i < recordedStrategies.size(); i++) {
+			const Strategy strategy = recordedStrategies[i];
+			const bool first = (i == 0);
+			const bool last = (i == recordedStrategies.size() - 1);
+			VkCommandBuffer commandBuffer = commandBuffers[currentFrame][strategy];
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			recordStrategy(commandBuffer, strategy, last);
+			auto tRecorded = std::chrono::high_resolution_clock::now();
+
+			// Only the first submission waits for the swap chain image and only the last one signals that rendering has finished
+			VkSubmitInfo strategySubmitInfo = submitInfo;
+			strategySubmitInfo.waitSemaphoreCount = first ? submitInfo.waitSemaphoreCount : 0;
+			strategySubmitInfo.signalSemaphoreCount = last ? submitInfo.signalSemaphoreCount : 0;
+			strategySubmitInfo.commandBufferCount = 1;
+			strategySubmitInfo.pCommandBuffers = &commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &strategySubmitInfo, VK_NULL_HANDLE));
+			auto tSubmitted = std::chrono::high_resolution_clock::now();
+			gpuProfiler.frameSubmitted(commandBuffer);
+
+			timings[strategy].record = std::chrono::duration<double, std::milli>(tRecorded - tStart).count();
+			timings[strategy].submit = std::chrono::duration<double, std::milli>(tSubmitted - tRecorded).count();
+			if (benchmark.active) {
+				benchmark.addCpuTime(std::string(strategyNames[strategy]) + " record", timings[strategy].record);
+				benchmark.addCpuTime(std::string(strategyNames[strategy]) + " submit", timings[strategy].submit);
+			}
+		}
+		benchmark.addWork("draws", static_cast<double>(objectCount) * recordedStrategies.size());
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		if (objectCountChanged) {
+			// The object buffers and descriptor sets are in use by the frames in flight
+			waitForFramesInFlight();
+			createObjects();
+			objectCountChanged = false;
+		}
+		draw();
+	}
+
+	virtual void viewChanged()
+	{
+		updateUniformBuffers();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> strategyItems;
+			for (Strategy strategy : strategies) {
+				strategyItems.push_back(strategyNames[strategy]);
+			}
+			strategyItems.push_back("All");
+			overlay->comboBox("Binding model", &selectedStrategy, strategyItems);
+			if (overlay->comboBox("Objects", &objectCountIndex, { "1k", "10k", "100k", "1M" })) {
+				objectCountChanged = true;
+			}
+			if (!inlineUniformBlocksSupported) {
+				overlay->text("Inline uniform blocks not supported");
+			}
+		}
+		if (overlay->header("Timings (ms)")) {
+			for (Strategy strategy : strategies) {
+				overlay->text("%s", strategyNames[strategy]);
+				overlay->text("  record %.3f, submit %.3f, gpu %.3f", timings[strategy].record, timings[strategy].submit, timings[strategy].gpu);
+			}
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Implements a separable two-pass fullscreen blur (also known as bloom)
 *
+* If supported, the bloom is computed with a compute downsample / upsample chain instead, which scales with the output resolution
+*
 * Copyright (C) Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,17 +10,23 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRenderGraph.h"
+#include "VulkanMipGenerator.h"
 
 #define ENABLE_VALIDATION false
 
 // Offscreen frame buffer properties
 #define FB_DIM 256
 #define FB_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+// Number of levels of the compute bloom chain, the first level has half the output resolution
+#define BLOOM_LEVELS 6
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool bloom = true;
+	bool computeBloom = true;
+	bool computeBloomSupported = false;
 
 	vks::TextureCubeMap cubemap;
 
@@ -75,23 +83,59 @@ public:
 		VkDescriptorSetLayout scene;
 	} descriptorSetLayouts;
 
-	// Framebuffer for offscreen rendering
-	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-	};
-	struct FrameBuffer {
-		VkFramebuffer framebuffer;
-		FrameBufferAttachment color, depth;
-		VkDescriptorImageInfo descriptor;
-	};
-	struct OffscreenPass {
-		int32_t width, height;
-		VkRenderPass renderPass;
+	// The glow and vertical blur passes are rendered offscreen by a render graph, which derives their render passes and barriers
+	// The horizontal blur is applied on top of the scene in the example's render pass
+	vks::RenderGraph renderGraph;
+	struct {
+		vks::RenderGraph::PassHandle glow;
+		vks::RenderGraph::PassHandle blurVert;
+	} graphPasses;
+	struct {
+		vks::RenderGraph::ImageHandle glow;
+		vks::RenderGraph::ImageHandle depth;
+		vks::RenderGraph::ImageHandle blurVert;
+	} graphImages;
+	struct {
 		VkSampler sampler;
-		std::array<FrameBuffer, 2> framebuffers;
-	} offscreenPass;
+		VkDescriptorImageInfo glow;
+		VkDescriptorImageInfo blurVert;
+	} offscreenDescriptors;
+
+	/*
+		Compute bloom chain (dual filter bloom):
+			- The glow is rendered at half the output resolution
+			- The glow image's mip chain is generated by the compute downsampler that's also used for texture mip generation (see base/VulkanMipGenerator.cpp)
+			- The levels are blurred with a compute tent filter and added up from the smallest to the largest one into the upsample image
+		The blur radius is relative to the output resolution instead of a fixed offscreen size, and the upsample image is added to the scene in the example's render pass
+	*/
+	vks::MipGenerator mipGenerator;
+	struct {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		VkFormat depthFormat;
+		// Glow image with its mip chain and one view per level
+		VkImage glowImage = VK_NULL_HANDLE;
+		VkDeviceMemory glowMemory = VK_NULL_HANDLE;
+		std::vector<VkImageView> glowViews;
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+		// Level n of the upsample image contains the blurred sum of the glow levels n and up
+		VkImage upsampleImage = VK_NULL_HANDLE;
+		VkDeviceMemory upsampleMemory = VK_NULL_HANDLE;
+		std::vector<VkImageView> upsampleViews;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline upsamplePipeline = VK_NULL_HANDLE;
+		VkPipeline composite = VK_NULL_HANDLE;
+		// One descriptor set per upsampled level
+		std::vector<VkDescriptorSet> upsampleDescriptorSets;
+		VkDescriptorSet compositeDescriptorSet = VK_NULL_HANDLE;
+	} bloomChain;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -104,27 +148,31 @@ public:
 		camera.setPerspective(45.0f, (float)width / (float)height, 0.1f, 256.0f);
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Required by the compute downsampler of the compute bloom chain
+		if (deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			enabledFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		}
+	}
+
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
-		vkDestroySampler(device, offscreenPass.sampler, nullptr);
+		vkDestroySampler(device, offscreenDescriptors.sampler, nullptr);
+		renderGraph.destroy();
 
-		// Frame buffer
-		for (auto& framebuffer : offscreenPass.framebuffers)
-		{
-			// Attachments
-			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkDestroyImage(device, framebuffer.color.image, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
-			vkDestroyImage(device, framebuffer.depth.image, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
-
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
+		if (computeBloomSupported) {
+			destroyBloomChain();
+			vkDestroyRenderPass(device, bloomChain.renderPass, nullptr);
+			vkDestroyPipeline(device, bloomChain.upsamplePipeline, nullptr);
+			vkDestroyPipeline(device, bloomChain.composite, nullptr);
+			vkDestroyPipelineLayout(device, bloomChain.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, bloomChain.descriptorSetLayout, nullptr);
 		}
-		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
+		mipGenerator.destroy();
 
 		vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
 		vkDestroyPipeline(device, pipelines.blurVert, nullptr);
@@ -146,125 +194,107 @@ public:
 		cubemap.destroy();
 	}
 
-	// Setup the offscreen framebuffer for rendering the mirrored scene
-	// The color attachment of this framebuffer will then be sampled from
-	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
-	{
-		// Color attachment
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = colorFormat;
-		image.extent.width = FB_DIM;
-		image.extent.height = FB_DIM;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// We will sample directly from the color attachment
-		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = colorFormat;
-		colorImageView.flags = 0;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->color.image));
-		vkGetImageMemoryRequirements(device, frameBuf->color.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->color.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->color.image, frameBuf->color.mem, 0));
-
-		colorImageView.image = frameBuf->color.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &frameBuf->color.view));
-
-		// Depth stencil attachment
-		image.format = depthFormat;
-		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = depthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->depth.image));
-		vkGetImageMemoryRequirements(device, frameBuf->depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->depth.image, frameBuf->depth.mem, 0));
-
-		depthStencilView.image = frameBuf->depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &frameBuf->depth.view));
-
-		VkImageView attachments[2];
-		attachments[0] = frameBuf->color.view;
-		attachments[1] = frameBuf->depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 2;
-		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = FB_DIM;
-		fbufCreateInfo.height = FB_DIM;
-		fbufCreateInfo.layers = 1;
-
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuf->framebuffer));
-
-		// Fill a descriptor for later use in a descriptor set
-		frameBuf->descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		frameBuf->descriptor.imageView = frameBuf->color.view;
-		frameBuf->descriptor.sampler = offscreenPass.sampler;
-	}
-
-	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
+	/*
+		Declare the offscreen passes of the render graph:
+			- The glow parts of the model (separate mesh) are rendered to the glow image
+			- The glow image is blurred vertically into the blur image, which is sampled by the horizontal blur in the scene render pass
+		The depth image is only used by the glow pass, so it's never stored and shares its memory with the blur image if possible
+	*/
 	void prepareOffscreen()
 	{
-		offscreenPass.width = FB_DIM;
-		offscreenPass.height = FB_DIM;
-
 		// Find a suitable depth format
 		VkFormat fbDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
 		assert(validDepthFormat);
 
-		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
-
-		std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
-		// Color attachment
-		attchmentDescriptions[0].format = FB_COLOR_FORMAT;
-		attchmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attchmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attchmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attchmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attchmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		// Depth attachment
-		attchmentDescriptions[1].format = fbDepthFormat;
-		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attchmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attchmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		graphImages.glow = renderGraph.addImage("glow", { FB_DIM, FB_DIM, FB_COLOR_FORMAT });
+		graphImages.depth = renderGraph.addImage("glow depth", { FB_DIM, FB_DIM, fbDepthFormat });
+		graphImages.blurVert = renderGraph.addImage("vertical blur", { FB_DIM, FB_DIM, FB_COLOR_FORMAT });
+		renderGraph.setOutput(graphImages.blurVert);
+
+		VkClearValue clearColor;
+		clearColor.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		VkClearValue clearDepth;
+		clearDepth.depthStencil = { 1.0f, 0 };
+
+		graphPasses.glow = renderGraph.addPass("glow", [this](VkCommandBuffer commandBuffer) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
+			models.ufoGlow.draw(commandBuffer);
+		});
+		renderGraph.addColorAttachment(graphPasses.glow, graphImages.glow, &clearColor);
+		renderGraph.setDepthStencilAttachment(graphPasses.glow, graphImages.depth, &clearDepth);
+
+		graphPasses.blurVert = renderGraph.addPass("vertical blur", [this](VkCommandBuffer commandBuffer) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		});
+		renderGraph.addSampledImage(graphPasses.blurVert, graphImages.glow);
+		renderGraph.addColorAttachment(graphPasses.blurVert, graphImages.blurVert, &clearColor);
+
+		renderGraph.compile(vulkanDevice);
+		benchmark.addMetric("offscreenmemorykb", static_cast<double>(renderGraph.getMemorySize()) / 1024.0);
+		benchmark.addMetric("offscreenmemoryunaliasedkb", static_cast<double>(renderGraph.getUnaliasedMemorySize()) / 1024.0);
+
+		// Create sampler to sample from the color attachments
+		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+		sampler.magFilter = VK_FILTER_LINEAR;
+		sampler.minFilter = VK_FILTER_LINEAR;
+		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler.addressModeV = sampler.addressModeU;
+		sampler.addressModeW = sampler.addressModeU;
+		sampler.mipLodBias = 0.0f;
+		sampler.maxAnisotropy = 1.0f;
+		sampler.minLod = 0.0f;
+		sampler.maxLod = 1.0f;
+		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenDescriptors.sampler));
+
+		// Images sampled by the blur passes are in shader read layout when the passes are executed
+		offscreenDescriptors.glow = vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, renderGraph.getImageView(graphImages.glow), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		offscreenDescriptors.blurVert = vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, renderGraph.getImageView(graphImages.blurVert), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	/*
+		Compute bloom chain
+	*/
+
+	// Size independent resources of the compute bloom chain, the glow pass reuses the glow pipeline of the render graph's glow pass (same attachment formats)
+	void prepareBloomChain()
+	{
+		if (deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			mipGenerator.prepare(vulkanDevice, loadShader(getShadersPath() + "base/mipgen.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		}
+		computeBloomSupported = mipGenerator.supported(FB_COLOR_FORMAT);
+		if (!computeBloomSupported) {
+			std::cout << "Compute bloom not supported, falling back to the fragment shader blur\n";
+			computeBloom = false;
+			return;
+		}
+
+		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &bloomChain.depthFormat);
+		assert(validDepthFormat);
+
+		// Glow render pass, the glow level is left in attachment layout and transitioned by the mip generator
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = FB_COLOR_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1].format = bloomChain.depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
@@ -275,64 +305,257 @@ public:
 		subpassDescription.pColorAttachments = &colorReference;
 		subpassDescription.pDepthStencilAttachment = &depthReference;
 
-		// Use subpass dependencies for layout transitions
 		std::array<VkSubpassDependency, 2> dependencies;
-
+		// The previous frame's upsample chain reads the glow image and its glow pass writes the depth image
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
+		// The glow level is read by the compute downsampler
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].dependencyFlags = 0;
 
-		// Create the actual renderpass
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attchmentDescriptions.size());
-		renderPassInfo.pAttachments = attchmentDescriptions.data();
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpassDescription;
 		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &bloomChain.renderPass));
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
+		// Upsample
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Lower level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),	// Binding 1: Glow level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),			// Binding 2: Destination level
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &bloomChain.descriptorSetLayout));
+		// Push constant: Size of the destination level
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 2 * sizeof(int32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&bloomChain.descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &bloomChain.pipelineLayout));
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(bloomChain.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "bloom/upsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &bloomChain.upsamplePipeline));
+
+		createBloomChain();
+	}
 
-		// Create sampler to sample from the color attachments
-		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-		sampler.magFilter = VK_FILTER_LINEAR;
-		sampler.minFilter = VK_FILTER_LINEAR;
-		sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		sampler.addressModeV = sampler.addressModeU;
-		sampler.addressModeW = sampler.addressModeU;
-		sampler.mipLodBias = 0.0f;
-		sampler.maxAnisotropy = 1.0f;
-		sampler.minLod = 0.0f;
-		sampler.maxLod = 1.0f;
-		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
+	// Images, framebuffer and descriptors of the compute bloom chain, these depend on the output resolution
+	void createBloomChain()
+	{
+		bloomChain.width = std::max(width / 2, 1u);
+		bloomChain.height = std::max(height / 2, 1u);
+		bloomChain.mipLevels = std::min(static_cast<uint32_t>(floor(log2(std::max(bloomChain.width, bloomChain.height)))) + 1, (uint32_t)BLOOM_LEVELS);
+		// The smallest glow level is the start of the upsample chain, so it needs one level less
+		const uint32_t upsampleLevels = std::max(bloomChain.mipLevels - 1, 1u);
+
+		auto createImage = [this](VkFormat format, VkImageUsageFlags usage, VkImageCreateFlags flags, uint32_t mipLevels, VkImage& image, VkDeviceMemory& memory) {
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.flags = flags;
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = format;
+			imageCI.extent = { bloomChain.width, bloomChain.height, 1 };
+			imageCI.mipLevels = mipLevels;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = usage;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, image, memory, 0));
+		};
+		auto createView = [this](VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t mipLevel) {
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewCI.format = format;
+			viewCI.subresourceRange = { aspectMask, mipLevel, 1, 0, 1 };
+			viewCI.image = image;
+			VkImageView view;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+			return view;
+		};
+
+		createImage(FB_COLOR_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, vks::MipGenerator::imageCreateFlags(FB_COLOR_FORMAT), bloomChain.mipLevels, bloomChain.glowImage, bloomChain.glowMemory);
+		createImage(FB_COLOR_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, 0, upsampleLevels, bloomChain.upsampleImage, bloomChain.upsampleMemory);
+		createImage(bloomChain.depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, 1, bloomChain.depthImage, bloomChain.depthMemory);
+		for (uint32_t i = 0; i < bloomChain.mipLevels; i++) {
+			bloomChain.glowViews.push_back(createView(bloomChain.glowImage, FB_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, i));
+		}
+		for (uint32_t i = 0; i < upsampleLevels; i++) {
+			bloomChain.upsampleViews.push_back(createView(bloomChain.upsampleImage, FB_COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, i));
+		}
+		bloomChain.depthView = createView(bloomChain.depthImage, bloomChain.depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0);
+
+		VkImageView attachments[2] = { bloomChain.glowViews[0], bloomChain.depthView };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = bloomChain.renderPass;
+		framebufferCI.attachmentCount = 2;
+		framebufferCI.pAttachments = attachments;
+		framebufferCI.width = bloomChain.width;
+		framebufferCI.height = bloomChain.height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &bloomChain.framebuffer));
+
+		// Descriptors, one set per upsampled level and one for adding the result to the scene
+		const uint32_t upsampleSetCount = bloomChain.mipLevels - 1;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * upsampleSetCount + 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, upsampleSetCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, upsampleSetCount + 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &bloomChain.descriptorPool));
+
+		bloomChain.upsampleDescriptorSets.resize(upsampleSetCount);
+		for (uint32_t i = 0; i < upsampleSetCount; i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(bloomChain.descriptorPool, &bloomChain.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &bloomChain.upsampleDescriptorSets[i]));
+			// The smallest upsampled level starts from the smallest glow level
+			const bool lowestLevel = (i == upsampleSetCount - 1);
+			VkDescriptorImageInfo lowerLevel = lowestLevel ?
+				vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, bloomChain.glowViews[i + 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) :
+				vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, bloomChain.upsampleViews[i + 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo glowLevel = vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, bloomChain.glowViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo dstLevel = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, bloomChain.upsampleViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(bloomChain.upsampleDescriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &lowerLevel),
+				vks::initializers::writeDescriptorSet(bloomChain.upsampleDescriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &glowLevel),
+				vks::initializers::writeDescriptorSet(bloomChain.upsampleDescriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &dstLevel),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(bloomChain.descriptorPool, &descriptorSetLayouts.blur, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &bloomChain.compositeDescriptorSet));
+		VkDescriptorImageInfo bloomDescriptor = vks::initializers::descriptorImageInfo(offscreenDescriptors.sampler, bloomChain.upsampleViews[0], VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(bloomChain.compositeDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),
+			vks::initializers::writeDescriptorSet(bloomChain.compositeDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &bloomDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		VkDeviceSize memorySize = 0;
+		for (VkImage image : { bloomChain.glowImage, bloomChain.upsampleImage, bloomChain.depthImage }) {
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, image, &memReqs);
+			memorySize += memReqs.size;
+		}
+		benchmark.addMetric("bloomchainmemorykb", static_cast<double>(memorySize) / 1024.0);
+	}
+
+	void destroyBloomChain()
+	{
+		for (auto view : bloomChain.glowViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		for (auto view : bloomChain.upsampleViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		bloomChain.glowViews.clear();
+		bloomChain.upsampleViews.clear();
+		vkDestroyImageView(device, bloomChain.depthView, nullptr);
+		vkDestroyImage(device, bloomChain.glowImage, nullptr);
+		vkDestroyImage(device, bloomChain.upsampleImage, nullptr);
+		vkDestroyImage(device, bloomChain.depthImage, nullptr);
+		vkFreeMemory(device, bloomChain.glowMemory, nullptr);
+		vkFreeMemory(device, bloomChain.upsampleMemory, nullptr);
+		vkFreeMemory(device, bloomChain.depthMemory, nullptr);
+		vkDestroyFramebuffer(device, bloomChain.framebuffer, nullptr);
+		vkDestroyDescriptorPool(device, bloomChain.descriptorPool, nullptr);
+		bloomChain.upsampleDescriptorSets.clear();
+	}
 
-		// Create two frame buffers
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat);
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat);
+	/*
+		Record the compute bloom chain:
+			- Glow pass at half the output resolution
+			- Downsample: Mip chain of the glow image, generated by the compute downsampler in a single dispatch
+			- Upsample: Starting at the smallest level, each level of the upsample image is the tent filtered next smaller level plus the glow level of the same size
+		Each step gets its own profiler scope
+	*/
+	void recordBloomChain(VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		gpuProfiler.beginScope(commandBuffer, "Bloom glow");
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = bloomChain.renderPass;
+		renderPassBeginInfo.framebuffer = bloomChain.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = bloomChain.width;
+		renderPassBeginInfo.renderArea.extent.height = bloomChain.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)bloomChain.width, (float)bloomChain.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(bloomChain.width, bloomChain.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
+		models.ufoGlow.draw(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
+
+		// Also transitions all levels for being sampled by the upsample chain
+		gpuProfiler.beginScope(commandBuffer, "Bloom downsample", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		mipGenerator.generate(commandBuffer, bloomChain.glowImage, FB_COLOR_FORMAT, bloomChain.width, bloomChain.height, bloomChain.mipLevels, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		gpuProfiler.beginScope(commandBuffer, "Bloom upsample", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		const uint32_t upsampleLevels = static_cast<uint32_t>(bloomChain.upsampleViews.size());
+		// The previous frame's scene pass may still be sampling the upsample image
+		vks::tools::insertImageMemoryBarrier(commandBuffer, bloomChain.upsampleImage, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, { VK_IMAGE_ASPECT_COLOR_BIT, 0, upsampleLevels, 0, 1 });
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomChain.upsamplePipeline);
+		for (int32_t level = static_cast<int32_t>(bloomChain.upsampleDescriptorSets.size()) - 1; level >= 0; level--) {
+			const int32_t dstSize[2] = { static_cast<int32_t>(std::max(bloomChain.width >> level, 1u)), static_cast<int32_t>(std::max(bloomChain.height >> level, 1u)) };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomChain.pipelineLayout, 0, 1, &bloomChain.upsampleDescriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, bloomChain.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(dstSize), dstSize);
+			vkCmdDispatch(commandBuffer, (dstSize[0] + 15) / 16, (dstSize[1] + 15) / 16, 1);
+			// The level is read by the next dispatch or, for the largest level, by the scene render pass
+			const VkPipelineStageFlags dstStage = (level > 0) ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			vks::tools::insertImageMemoryBarrier(commandBuffer, bloomChain.upsampleImage, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, { VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(level), 1, 0, 1 });
+		}
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	}
 
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
+		if (computeBloomSupported) {
+			// The views and descriptors of the previously recorded downsamples are released, so the command buffers must not be in use anymore
+			vkDeviceWaitIdle(device);
+			mipGenerator.releaseResources();
+			// Command buffers are rebuilt before the example is notified about a resize, so the size dependent resources are recreated here
+			if ((bloomChain.width != std::max(width / 2, 1u)) || (bloomChain.height != std::max(height / 2, 1u))) {
+				destroyBloomChain();
+				createBloomChain();
+			}
+		}
+
 		VkClearValue clearValues[2];
-		VkViewport viewport;
-		VkRect2D scissor;
 
 		/*
 			The blur method used in this example is multi pass and renders the vertical blur first and then the horizontal one
@@ -342,59 +565,22 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			if (bloom) {
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[0].framebuffer;
-				renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-				renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				/*
-					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
-				*/
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
-
-				models.ufoGlow.draw(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Second render pass: Vertical blur
-
-					Render contents of the first pass into a second framebuffer and apply a vertical blur
-					This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
-				*/
-
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
 			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+				First and second pass: Glow and vertical blur, rendered offscreen by the render graph
+				The graph records the barriers between the passes and transitions the blurred image for being sampled by the scene render pass
+				With compute bloom these are replaced by the glow pass and the compute downsample / upsample chain
 			*/
+			if (bloom) {
+				if (computeBloom) {
+					recordBloomChain(drawCmdBuffers[i]);
+				} else {
+					gpuProfiler.beginScope(drawCmdBuffers[i], "Bloom glow and vertical blur");
+					renderGraph.execute(drawCmdBuffers[i]);
+					gpuProfiler.endScope(drawCmdBuffers[i]);
+				}
+			}
 
 			/*
 				Third render pass: Scene rendering with applied vertical blur
@@ -414,6 +600,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues;
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -435,7 +622,13 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
 				models.ufo.draw(drawCmdBuffers[i]);
 
-				if (bloom)
+				if (bloom && computeBloom)
+				{
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &bloomChain.compositeDescriptorSet, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, bloomChain.composite);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				}
+				else if (bloom)
 				{
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
@@ -445,6 +638,7 @@ public:
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			}
 
@@ -483,9 +677,9 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Binding 1: Fragment shader image sampler
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.blur));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.blur));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.blur));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.blur));
 
 		// Scene rendering
 		setLayoutBindings = {
@@ -495,9 +689,9 @@ public:
 		};
 
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.scene));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.scene));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.scene, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
 	}
 
 	void setupDescriptorSet()
@@ -511,7 +705,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurVert));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[0].descriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenDescriptors.glow),	// Binding 1: Fragment shader texture sampler
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 		// Horizontal
@@ -519,7 +713,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurHorz));
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[1].descriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenDescriptors.blurVert),	// Binding 1: Fragment shader texture sampler
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
@@ -587,12 +781,17 @@ public:
 		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &blurdirection);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		// Vertical blur pipeline
-		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
+		pipelineCI.renderPass = renderGraph.getRenderPass(graphPasses.blurVert);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
 		// Horizontal blur pipeline
 		blurdirection = 1;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		// Adds the compute bloom chain's result to the scene
+		if (computeBloomSupported) {
+			shaderStages[1] = loadShader(getShadersPath() + "bloom/composite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &bloomChain.composite));
+		}
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -603,13 +802,13 @@ public:
 		depthStencilStateCI.depthWriteEnable = VK_TRUE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
 
 		// Color only pass (offscreen blur base)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/colorpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/colorpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.glowPass));
+		pipelineCI.renderPass = renderGraph.getRenderPass(graphPasses.glow);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.glowPass));
 
 		// Skybox (cubemap)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/skybox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -617,7 +816,7 @@ public:
 		depthStencilStateCI.depthWriteEnable = VK_FALSE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_FRONT_BIT;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyBox));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyBox));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -657,6 +856,7 @@ public:
 	// Update uniform buffers for rendering the 3D scene
 	void updateUniformBuffersScene()
 	{
+		waitForFramesInFlight();
 		// UFO
 		ubos.scene.projection = camera.matrices.perspective;
 		ubos.scene.view = camera.matrices.view;
@@ -678,6 +878,7 @@ public:
 	// Update blur pass parameter uniform buffer
 	void updateUniformBuffersBlur()
 	{
+		waitForFramesInFlight();
 		memcpy(uniformBuffers.blurParams.mapped, &ubos.blurParams, sizeof(ubos.blurParams));
 	}
 
@@ -697,6 +898,7 @@ public:
 		prepareUniformBuffers();
 		prepareOffscreen();
 		setupDescriptorSetLayout();
+		prepareBloomChain();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
@@ -721,7 +923,11 @@ public:
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
+			if (computeBloomSupported && overlay->checkBox("Compute bloom chain", &computeBloom)) {
+				buildCommandBuffers();
+			}
+			// The compute bloom chain's blur radius is given by its levels
+			if (!computeBloom && overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
 				updateUniformBuffersBlur();
 			}
 		}
@@ -8,9 +8,13 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include <glm/gtc/packing.hpp>
 
 #define ENABLE_VALIDATION false
 
+// Maximum number of sphere colliders, needs to match the compute shader
+#define MAX_COLLIDERS 16
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -19,6 +23,15 @@ public:
 	uint32_t indexCount;
 	bool simulateWind = false;
 	bool specializedComputeQueue = false;
+	// Number of simulation steps per frame, kept even so the final result always ends up in the output buffer
+	int32_t iterations = 64;
+	bool selfCollision = true;
+	int32_t colliderCount = 1;
+	int32_t clothResolution = 0;
+	const std::vector<uint32_t> clothResolutions = { 60, 128, 256, 512 };
+	uint32_t computeBufferIndex = 0;
+	// Store the normals and texture coordinates of the particles as half precision floats, which shrinks a particle from 80 to 48 bytes (see cloth_packed.comp)
+	bool halfPrecision = true;
 
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
@@ -30,10 +43,13 @@ public:
 		VkPipelineLayout pipelineLayout;
 		struct Pipelines {
 			VkPipeline cloth;
+			VkPipeline clothPacked;
 			VkPipeline sphere;
 		} pipelines;
 		vks::Buffer indices;
 		vks::Buffer uniformBuffer;
+		// Per instance position and radius of the rendered colliders
+		vks::Buffer colliders;
 		struct graphicsUBO {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -47,6 +63,13 @@ public:
 			vks::Buffer input;
 			vks::Buffer output;
 		} storageBuffers;
+		// Spatial hash used for the self collision neighbor search, the particle indices are sorted by hash cell each frame (counting sort)
+		struct SpatialHash {
+			vks::Buffer cellCount;
+			vks::Buffer particleCell;
+			vks::Buffer cellStart;
+			vks::Buffer sortedIndices;
+		} spatialHash;
 		struct Semaphores {
 			VkSemaphore ready{ 0L };
 			VkSemaphore complete{ 0L };
@@ -59,6 +82,13 @@ public:
 		std::array<VkDescriptorSet,2> descriptorSets;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
+		VkPipeline pipelinePacked;
+		struct HashPipelines {
+			VkPipeline count;
+			VkPipeline countPacked;
+			VkPipeline scan;
+			VkPipeline scatter;
+		} hashPipelines;
 		struct computeUBO {
 			float deltaT = 0.0f;
 			float particleMass = 0.1f;
@@ -67,10 +97,16 @@ public:
 			float restDistH;
 			float restDistV;
 			float restDistD;
-			float sphereRadius = 1.0f;
-			glm::vec4 spherePos = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+			float collisionDistance;
 			glm::vec4 gravity = glm::vec4(0.0f, 9.8f, 0.0f, 0.0f);
 			glm::ivec2 particleCount;
+			uint32_t hashTableSize;
+			uint32_t colliderCount;
+			float cellSize;
+			uint32_t selfCollision;
+			glm::vec2 _pad0;
+			// xyz = position, w = radius
+			glm::vec4 colliders[MAX_COLLIDERS];
 		} ubo;
 	} compute;
 
@@ -84,6 +120,18 @@ public:
 		glm::vec3 _pad0;
 	};
 
+	// Packed particle declaration, positions and velocities need full precision for the integration
+	struct PackedParticle {
+		// xyz = position, w = 1.0 for pinned particles
+		glm::vec4 pos;
+		glm::vec4 vel;
+		// Half precision normal (xyz)
+		glm::uvec2 normal;
+		// Half precision texture coordinates
+		uint32_t uv;
+		uint32_t _pad0;
+	};
+
 	struct Cloth {
 		glm::uvec2 gridsize = glm::uvec2(60, 60);
 		glm::vec2 size = glm::vec2(5.0f);
@@ -97,25 +145,46 @@ public:
 		camera.setRotation(glm::vec3(-30.0f, -45.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -5.0f));
 		settings.overlay = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("clothsize", { "-cs", "--clothsize" }, 1, "Number of particles per side of the cloth");
+		exampleArgs.add("iterations", { "-it", "--iterations" }, 1, "Number of simulation steps per frame");
+		exampleArgs.add("fullprecision", { "-fpp", "--fullprecision" }, 0, "Store all particle attributes as 32 bit floats");
+		exampleArgs.parse(args);
+		if (exampleArgs.isSet("clothsize")) {
+			const uint32_t size = std::max(exampleArgs.getValueAsInt("clothsize", 60), 2);
+			cloth.gridsize = glm::uvec2(size);
+			clothResolution = -1;
+		}
+		if (exampleArgs.isSet("iterations")) {
+			iterations = std::max(exampleArgs.getValueAsInt("iterations", iterations), 2);
+		}
+		iterations = (iterations + 1) & ~1;
+		halfPrecision = !exampleArgs.isSet("fullprecision");
 	}
 
 	~VulkanExample()
 	{
 		// Graphics
 		graphics.uniformBuffer.destroy();
+		graphics.colliders.destroy();
 		vkDestroyPipeline(device, graphics.pipelines.cloth, nullptr);
+		vkDestroyPipeline(device, graphics.pipelines.clothPacked, nullptr);
 		vkDestroyPipeline(device, graphics.pipelines.sphere, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
 		textureCloth.destroy();
 
 		// Compute
-		compute.storageBuffers.input.destroy();
-		compute.storageBuffers.output.destroy();
+		destroyClothBuffers();
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelinePacked, nullptr);
+		vkDestroyPipeline(device, compute.hashPipelines.count, nullptr);
+		vkDestroyPipeline(device, compute.hashPipelines.countPacked, nullptr);
+		vkDestroyPipeline(device, compute.hashPipelines.scan, nullptr);
+		vkDestroyPipeline(device, compute.hashPipelines.scatter, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.ready, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.complete, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
@@ -184,6 +253,30 @@ public:
 			0, nullptr);
 	}
 
+	// Memory dependency between the passes reading and writing the spatial hash buffers
+	void addSpatialHashBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = srcAccessMask;
+		bufferBarrier.dstAccessMask = dstAccessMask;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		for (VkBuffer buffer : { compute.spatialHash.cellCount.buffer, compute.spatialHash.particleCell.buffer, compute.spatialHash.cellStart.buffer, compute.spatialHash.sortedIndices.buffer }) {
+			bufferBarrier.buffer = buffer;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			srcStageMask,
+			dstStageMask,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			0, nullptr);
+	}
+
 	void addComputeToGraphicsBarriers(VkCommandBuffer commandBuffer)
 	{
 		if (specializedComputeQueue) {
@@ -248,15 +341,18 @@ public:
 
 			VkDeviceSize offsets[1] = { 0 };
 
-			// Render sphere
-			if (sceneSetup == 0) {
+			// Render the sphere colliders as instances
+			if (compute.ubo.colliderCount > 0) {
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.sphere);
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-				modelSphere.draw(drawCmdBuffers[i]);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &modelSphere.vertices.buffer, offsets);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 1, 1, &graphics.colliders.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], modelSphere.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(drawCmdBuffers[i], modelSphere.indices.count, compute.ubo.colliderCount, 0, 0, 0);
 			}
 
 			// Render cloth
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.cloth);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, halfPrecision ? graphics.pipelines.clothPacked : graphics.pipelines.cloth);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], graphics.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &compute.storageBuffers.output.buffer, offsets);
@@ -284,17 +380,46 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.beginFrame(compute.commandBuffers[i]);
+
 			// Acquire the storage buffers from the graphics queue
 			addGraphicsToComputeBarriers(compute.commandBuffers[i]);
 
-			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			// Sort the particles into the spatial hash once per frame, using the positions the first iteration reads
+			// The hash only stores indices, positions are always read from the current input buffer, and the cells are somewhat larger than the collision distance
+			// so the particles' movement during a frame's iterations doesn't cause collisions to be missed
+			if (selfCollision) {
+				const uint32_t groupCount = (cloth.gridsize.x * cloth.gridsize.y + 255) / 256;
+				gpuProfiler.beginScope(compute.commandBuffers[i], "Spatial hash", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[1 - readSet], 0, 0);
+				// The previous frame's simulation has to be done reading the hash before it's cleared
+				addSpatialHashBarriers(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+				vkCmdFillBuffer(compute.commandBuffers[i], compute.spatialHash.cellCount.buffer, 0, VK_WHOLE_SIZE, 0);
+				addSpatialHashBarriers(compute.commandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				// Count the particles per cell
+				vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, halfPrecision ? compute.hashPipelines.countPacked : compute.hashPipelines.count);
+				vkCmdDispatch(compute.commandBuffers[i], groupCount, 1, 1);
+				addSpatialHashBarriers(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				// Prefix sum over the counts yields the start of each cell in the sorted index list
+				vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.hashPipelines.scan);
+				vkCmdDispatch(compute.commandBuffers[i], 1, 1, 1);
+				addSpatialHashBarriers(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				// Scatter the particle indices into their cells
+				vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.hashPipelines.scatter);
+				vkCmdDispatch(compute.commandBuffers[i], groupCount, 1, 1);
+				addSpatialHashBarriers(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+				gpuProfiler.endScope(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			}
+
+			gpuProfiler.beginScope(compute.commandBuffers[i], "Cloth simulation", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, halfPrecision ? compute.pipelinePacked : compute.pipeline);
 
 			uint32_t calculateNormals = 0;
 			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
 
 			// Dispatch the compute job
-			const uint32_t iterations = 64;
-			for (uint32_t j = 0; j < iterations; j++) {
+			for (uint32_t j = 0; j < static_cast<uint32_t>(iterations); j++) {
 				readSet = 1 - readSet;
 				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
 
@@ -303,7 +428,7 @@ public:
 					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
 				}
 
-				vkCmdDispatch(compute.commandBuffers[i], cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
+				vkCmdDispatch(compute.commandBuffers[i], (cloth.gridsize.x + 9) / 10, (cloth.gridsize.y + 9) / 10, 1);
 
 				// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
 				if (j != iterations - 1) {
@@ -312,6 +437,8 @@ public:
 
 			}
 
+			gpuProfiler.endScope(compute.commandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
 			// release the storage buffers back to the graphics queue
 			addComputeToGraphicsBarriers(compute.commandBuffers[i]);
 			vkEndCommandBuffer(compute.commandBuffers[i]);
@@ -353,8 +480,6 @@ public:
 						particleBuffer[i + j * cloth.gridsize.y].uv = glm::vec4(du * j, dv * i, 0.0f, 0.0f);
 						// Pin some particles
 						particleBuffer[i + j * cloth.gridsize.y].pinned = (i == 0) && ((j == 0) || (j ==  cloth.gridsize.x / 3) || (j ==  cloth.gridsize.x -  cloth.gridsize.x / 3) || (j ==  cloth.gridsize.x - 1));
-						// Remove sphere
-						compute.ubo.spherePos.z = -10.0f;
 					}
 				}
 				break;
@@ -362,6 +487,24 @@ public:
 		}
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
+		void* particleData = particleBuffer.data();
+
+		// Convert to the packed layout, the pinned flag goes into the w component of the position
+		std::vector<PackedParticle> packedParticleBuffer;
+		if (halfPrecision) {
+			packedParticleBuffer.resize(particleBuffer.size());
+			for (size_t i = 0; i < particleBuffer.size(); i++) {
+				const Particle& particle = particleBuffer[i];
+				PackedParticle& packedParticle = packedParticleBuffer[i];
+				packedParticle.pos = glm::vec4(glm::vec3(particle.pos), particle.pinned);
+				packedParticle.vel = particle.vel;
+				packedParticle.normal = glm::uvec2(glm::packHalf2x16(glm::vec2(particle.normal)), glm::packHalf2x16(glm::vec2(particle.normal.z, 0.0f)));
+				packedParticle.uv = glm::packHalf2x16(glm::vec2(particle.uv));
+				packedParticle._pad0 = 0;
+			}
+			storageBufferSize = packedParticleBuffer.size() * sizeof(PackedParticle);
+			particleData = packedParticleBuffer.data();
+		}
 
 		// Staging
 		// SSBO won't be changed on the host after upload so copy to device local memory
@@ -373,7 +516,7 @@ public:
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
 			storageBufferSize,
-			particleBuffer.data());
+			particleData);
 
 		vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -401,6 +544,34 @@ public:
 
 		stagingBuffer.destroy();
 
+		// Spatial hash, only accessed by the compute queue
+		// Power of two table size with about two cells per particle keeps hash collisions between occupied cells rare
+		const uint32_t particleCount = cloth.gridsize.x * cloth.gridsize.y;
+		compute.ubo.hashTableSize = 1;
+		while (compute.ubo.hashTableSize < particleCount * 2) {
+			compute.ubo.hashTableSize <<= 1;
+		}
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.spatialHash.cellCount,
+			compute.ubo.hashTableSize * sizeof(uint32_t));
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.spatialHash.particleCell,
+			particleCount * sizeof(glm::uvec2));
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.spatialHash.cellStart,
+			(compute.ubo.hashTableSize + 1) * sizeof(uint32_t));
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.spatialHash.sortedIndices,
+			particleCount * sizeof(uint32_t));
+
 		// Indices
 		std::vector<uint32_t> indices;
 		for (uint32_t y = 0; y <  cloth.gridsize.y - 1; y++) {
@@ -441,7 +612,7 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -460,11 +631,11 @@ public:
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&graphics.descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 
 		// Set
 		VkDescriptorSetAllocateInfo allocInfo =
@@ -548,17 +719,37 @@ public:
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfo.pStages = shaderStages.data();
 		pipelineCreateInfo.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.cloth));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.cloth));
+
+		// The packed layout stores the normal and texture coordinates as half precision floats, which the vertex input converts (these formats are mandatory for vertex buffers)
+		inputBindings[0].stride = sizeof(PackedParticle);
+		inputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedParticle, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedParticle, uv)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(PackedParticle, normal))
+		};
+		inputState.pVertexAttributeDescriptions = inputAttributes.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.clothPacked));
 
 		// Sphere rendering pipeline
-		pipelineCreateInfo.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Normal });
-		inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(inputAttributes.size());
+		// The colliders are rendered as instances of the sphere model, with the position and radius stored per instance
+		std::vector<VkVertexInputBindingDescription> sphereInputBindings = {
+			vkglTF::Vertex::inputBindingDescription(0),
+			vks::initializers::vertexInputBindingDescription(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		std::vector<VkVertexInputAttributeDescription> sphereInputAttributes = vkglTF::Vertex::inputAttributeDescriptions(0, { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Normal });
+		// Location 3 : Collider position and radius
+		sphereInputAttributes.push_back(vks::initializers::vertexInputAttributeDescription(1, 3, VK_FORMAT_R32G32B32A32_SFLOAT, 0));
+		inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(sphereInputBindings.size());
+		inputState.pVertexBindingDescriptions = sphereInputBindings.data();
+		inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(sphereInputAttributes.size());
+		inputState.pVertexAttributeDescriptions = sphereInputAttributes.data();
 		inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssemblyState.primitiveRestartEnable = VK_FALSE;
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
 		shaderStages[0] = loadShader(getShadersPath() + "computecloth/sphere.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "computecloth/sphere.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.sphere));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.sphere));
 	}
 
 	void prepareCompute()
@@ -571,12 +762,17 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Spatial hash
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
@@ -587,7 +783,7 @@ public:
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
@@ -596,22 +792,30 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[0]));
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[1]));
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
-
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+		updateComputeDescriptorSets();
 
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_packed.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelinePacked));
+
+		// Spatial hash pipelines
+		// The count pass only reads the positions, the particle size in vec4s is passed as a specialization constant
+		uint32_t particleStride = sizeof(Particle) / sizeof(glm::vec4);
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &particleStride);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/hash_count.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.hashPipelines.count));
+		particleStride = sizeof(PackedParticle) / sizeof(glm::vec4);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.hashPipelines.countPacked));
+		computePipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/hash_scan.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.hashPipelines.scan));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/hash_scatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.hashPipelines.scatter));
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -635,6 +839,78 @@ public:
 		buildComputeCommandBuffer();
 	}
 
+	// Two descriptor sets with input and output buffers switched, all buffers are written again if the cloth is resized
+	void updateComputeDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets;
+		for (uint32_t i = 0; i < 2; i++) {
+			vks::Buffer& input = (i == 0) ? compute.storageBuffers.input : compute.storageBuffers.output;
+			vks::Buffer& output = (i == 0) ? compute.storageBuffers.output : compute.storageBuffers.input;
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &input.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &output.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.spatialHash.cellCount.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.spatialHash.particleCell.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &compute.spatialHash.cellStart.descriptor));
+			computeWriteDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &compute.spatialHash.sortedIndices.descriptor));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+	}
+
+	// Simulation parameters that depend on the cloth resolution
+	void updateClothParameters()
+	{
+		float dx = cloth.size.x / (cloth.gridsize.x - 1);
+		float dy = cloth.size.y / (cloth.gridsize.y - 1);
+
+		compute.ubo.restDistH = dx;
+		compute.ubo.restDistV = dy;
+		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
+		compute.ubo.particleCount = cloth.gridsize;
+		// Particles that aren't connected by a spring keep a bit less than the rest distance apart
+		compute.ubo.collisionDistance = std::min(dx, dy) * 0.8f;
+		compute.ubo.cellSize = compute.ubo.collisionDistance * 1.5f;
+	}
+
+	// Place the sphere colliders, the first one is the large sphere in the center, the others are placed on a ring around it
+	void updateColliders()
+	{
+		waitForFramesInFlight();
+		// The pinned cloth doesn't collide with anything
+		compute.ubo.colliderCount = (sceneSetup == 0) ? static_cast<uint32_t>(colliderCount) : 0;
+		for (uint32_t i = 0; i < MAX_COLLIDERS; i++) {
+			if (i == 0) {
+				compute.ubo.colliders[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			} else {
+				const float angle = glm::radians(360.0f * static_cast<float>(i - 1) / static_cast<float>(MAX_COLLIDERS - 1));
+				compute.ubo.colliders[i] = glm::vec4(cos(angle) * 2.0f, 0.5f, sin(angle) * 2.0f, 0.35f);
+			}
+		}
+		memcpy(graphics.colliders.mapped, compute.ubo.colliders, sizeof(compute.ubo.colliders));
+	}
+
+	// Recreate all buffers that depend on the cloth resolution or the particle layout, this restarts the simulation
+	void resizeCloth()
+	{
+		vkDeviceWaitIdle(device);
+		destroyClothBuffers();
+		prepareStorageBuffers();
+		updateClothParameters();
+		updateComputeDescriptorSets();
+		buildComputeCommandBuffer();
+	}
+
+	void destroyClothBuffers()
+	{
+		compute.storageBuffers.input.destroy();
+		compute.storageBuffers.output.destroy();
+		compute.spatialHash.cellCount.destroy();
+		compute.spatialHash.particleCell.destroy();
+		compute.spatialHash.cellStart.destroy();
+		compute.spatialHash.sortedIndices.destroy();
+		graphics.indices.destroy();
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -646,14 +922,17 @@ public:
 			sizeof(compute.ubo));
 		VK_CHECK_RESULT(compute.uniformBuffer.map());
 
-		// Initial values
-		float dx = cloth.size.x / (cloth.gridsize.x - 1);
-		float dy = cloth.size.y / (cloth.gridsize.y - 1);
+		// Collider instances for rendering
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&graphics.colliders,
+			sizeof(compute.ubo.colliders));
+		VK_CHECK_RESULT(graphics.colliders.map());
 
-		compute.ubo.restDistH = dx;
-		compute.ubo.restDistV = dy;
-		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
-		compute.ubo.particleCount = cloth.gridsize;
+		// Initial values
+		updateClothParameters();
+		updateColliders();
 
 		updateComputeUBO();
 
@@ -670,6 +949,7 @@ public:
 
 	void updateComputeUBO()
 	{
+		waitForFramesInFlight();
 		if (!paused) {
 			compute.ubo.deltaT = 0.000005f;
 			// todo: base on frametime
@@ -689,11 +969,13 @@ public:
 		else {
 			compute.ubo.deltaT = 0.0f;
 		}
+		compute.ubo.selfCollision = selfCollision ? 1 : 0;
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
 	}
 
 	void updateGraphicsUBO()
 	{
+		waitForFramesInFlight();
 		graphics.ubo.projection = camera.matrices.perspective;
 		graphics.ubo.view = camera.matrices.view;
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
@@ -704,7 +986,8 @@ public:
 		static bool firstDraw = true;
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		// FIXME find a better way to do this (without using fences, which is much slower)
-		VkPipelineStageFlags computeWaitDstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		// The spatial hash is cleared with a transfer, so that has to wait for the graphics queue too
+		VkPipelineStageFlags computeWaitDstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 		if (!firstDraw) {
 			computeSubmitInfo.waitSemaphoreCount = 1;
 			computeSubmitInfo.pWaitSemaphores = &compute.semaphores.ready;
@@ -714,10 +997,14 @@ public:
 		}
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphores.complete;
+		// Both command buffers contain the same commands, alternating between them gives the timestamp queries of one a frame to finish before they are read back
+		computeBufferIndex = 1 - computeBufferIndex;
+		gpuProfiler.collect(compute.commandBuffers[computeBufferIndex]);
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[readSet];
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[computeBufferIndex];
 
 		VK_CHECK_RESULT( vkQueueSubmit( compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE) );
+		gpuProfiler.frameSubmitted(compute.commandBuffers[computeBufferIndex]);
 
 		// Submit graphics commands
 		VulkanExampleBase::prepareFrame();
@@ -778,10 +1065,52 @@ public:
 		updateGraphicsUBO();
 	}
 
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if (name == "halfprecision") {
+			halfPrecision = enabled;
+			// The particles are uploaded again in the selected layout
+			resizeCloth();
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Simulate wind", &simulateWind);
+			overlay->text("%d particles", cloth.gridsize.x * cloth.gridsize.y);
+			std::vector<std::string> resolutions;
+			for (auto resolution : clothResolutions) {
+				resolutions.push_back(std::to_string(resolution) + "x" + std::to_string(resolution));
+			}
+			if ((clothResolution >= 0) && overlay->comboBox("Resolution", &clothResolution, resolutions)) {
+				cloth.gridsize = glm::uvec2(clothResolutions[clothResolution]);
+				resizeCloth();
+			}
+			// Compare the cost of the simulation with both particle layouts, the GPU times are listed above
+			if (overlay->checkBox("Half precision normals and uvs", &halfPrecision)) {
+				resizeCloth();
+			}
+			// Changes to these are recorded into the pre-recorded compute command buffers
+			bool rebuildCompute = false;
+			if (overlay->sliderInt("Iterations", &iterations, 2, 256)) {
+				iterations = (iterations + 1) & ~1;
+				rebuildCompute = true;
+			}
+			if (overlay->checkBox("Self collision", &selfCollision)) {
+				rebuildCompute = true;
+			}
+			if (rebuildCompute) {
+				VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+				buildComputeCommandBuffer();
+			}
+			if ((sceneSetup == 0) && overlay->sliderInt("Colliders", &colliderCount, 0, MAX_COLLIDERS)) {
+				// The collider instances may still be read by frames in flight
+				VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+				updateColliders();
+			}
 		}
 	}
 };
@@ -45,9 +45,14 @@ public:
 	vks::Buffer indirectDrawCountBuffer;
 
 	// Indirect draw statistics (updated via compute)
-	struct {
+	struct IndirectStats {
 		uint32_t drawCount;						// Total number of indirect draw counts to be issued
 		uint32_t lodCount[MAX_LOD_LEVEL + 1];	// Statistics for number of draws per LOD level (written by compute shader)
+		// Only written with occlusion culling enabled
+		uint32_t earlyDrawCount;				// Draw count of the early pass (also sourced by vkCmdDrawIndexedIndirectCount)
+		uint32_t lateDrawCount;					// Draw count of the late pass, instances the early pass wrongly rejected as occluded
+		uint32_t frustumCulledCount;			// Instances outside of the view frustum
+		uint32_t occludedCount;					// Instances hidden behind other instances
 	} indirectStats;
 
 	// Store the indirect draw commands containing index offsets and instance count per object
@@ -84,22 +89,95 @@ public:
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipeline;						// Compute pipeline for updating particle positions
+		VkPipeline pipelineSubgroup = VK_NULL_HANDLE;	// Variant aggregating the stats per subgroup (if supported)
+		bool subgroupsRecorded = false;				// Variants recorded into the command buffer, which is re-recorded if the selection changes
 	} compute;
 
+	// Stream compaction of the culled draw commands, so only visible draws are processed
+	struct {
+		vks::Buffer drawCommandsBuffer;				// Visible draw commands packed to the front, the remaining slots hold empty draws
+		vks::Buffer blocksBuffer;					// Draw count (sourced by vkCmdDrawIndexedIndirectCount) followed by the per-block prefix sums
+		uint32_t blockCount;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkPipeline pipelineSubgroup = VK_NULL_HANDLE;	// Variant scanning with subgroup operations (if supported)
+	} compaction;
+
+	struct CompactionPushConstants {
+		uint32_t objectCount;
+		uint32_t pass;
+	};
+
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
 	uint32_t objectCount = 0;
 
+	// The cull and compaction shaders have variants that reduce and scan with subgroup operations instead of global atomics and shared memory
+	// The smallest subgroup size compute shaders may run with sizes the shared memory of the compaction variant, zero if the operations aren't supported
+	uint32_t subgroupSize = 0;
+	bool useSubgroups = true;
+
+	// Two phase occlusion culling against a hierarchical depth pyramid (Hi-Z), done on the graphics queue as it needs the depth attachment
+	// The early pass tests the instances against the pyramid of the previous frame and draws the visible ones, the pyramid is then rebuilt
+	// from that depth and the late pass re-tests the instances rejected as occluded, drawing those that turned out to be visible
+	bool occlusionCulling = false;
+	bool occlusionCullingSupported = false;
+	bool drawIndirectCountSupported = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
+	struct OcclusionCullPushConstants {
+		glm::vec2 pyramidSize;
+		float objectRadius;
+		uint32_t objectCount;
+		uint32_t pass;
+	};
+
+	struct DepthPyramidPushConstants {
+		glm::ivec2 inputSize;
+		glm::ivec2 outputSize;
+	};
+
+	struct {
+		VkRenderPass earlyRenderPass;					// Clears the attachments and leaves depth readable for building the pyramid
+		VkRenderPass lateRenderPass;					// Continues rendering on top of the early pass
+		VkImageView depthView;							// Depth only view of the depth attachment for sampling
+		VkImage pyramidImage;
+		VkDeviceMemory pyramidMemory;
+		VkImageView pyramidView;						// All levels, sampled by the cull shader
+		std::vector<VkImageView> pyramidLevelViews;		// Single levels, written by the pyramid shader
+		uint32_t pyramidWidth;
+		uint32_t pyramidHeight;
+		uint32_t pyramidLevels;
+		VkSampler sampler;
+		vks::Buffer drawCommandsBuffer;					// Compacted draw commands, early pass draws in the first and late pass draws in the second half
+		vks::Buffer visibilityBuffer;					// Per-instance culling state passed from the early to the late pass
+		VkDescriptorPool descriptorPool;				// Sets referencing the pyramid, recreated along with it
+		VkDescriptorSetLayout cullDescriptorSetLayout;
+		VkDescriptorSetLayout pyramidDescriptorSetLayout;
+		VkDescriptorSet cullDescriptorSet;
+		std::vector<VkDescriptorSet> pyramidDescriptorSets;
+		VkPipelineLayout cullPipelineLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		VkPipeline cullPipeline;
+		VkPipeline pyramidPipeline;
+	} occlusion;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Vulkan Example - Compute cull and lod";
+		// The depth pyramid is destroyed and recreated along with the depth attachment, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		camera.type = Camera::CameraType::firstperson;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setTranslation(glm::vec3(0.5f, 0.0f, 0.0f));
 		camera.movementSpeed = 5.0f;
 		settings.overlay = true;
 		memset(&indirectStats, 0, sizeof(indirectStats));
+		// Subgroup operations require Vulkan 1.1
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
@@ -115,9 +193,30 @@ public:
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelineSubgroup, nullptr);
 		vkDestroyFence(device, compute.fence, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
+		compaction.drawCommandsBuffer.destroy();
+		compaction.blocksBuffer.destroy();
+		vkDestroyPipeline(device, compaction.pipeline, nullptr);
+		vkDestroyPipeline(device, compaction.pipelineSubgroup, nullptr);
+		vkDestroyPipelineLayout(device, compaction.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, compaction.descriptorSetLayout, nullptr);
+		if (occlusionCullingSupported) {
+			destroyDepthPyramid();
+			vkDestroyPipeline(device, occlusion.cullPipeline, nullptr);
+			vkDestroyPipeline(device, occlusion.pyramidPipeline, nullptr);
+			vkDestroyPipelineLayout(device, occlusion.cullPipelineLayout, nullptr);
+			vkDestroyPipelineLayout(device, occlusion.pyramidPipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, occlusion.cullDescriptorSetLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, occlusion.pyramidDescriptorSetLayout, nullptr);
+			vkDestroySampler(device, occlusion.sampler, nullptr);
+			vkDestroyRenderPass(device, occlusion.earlyRenderPass, nullptr);
+			vkDestroyRenderPass(device, occlusion.lateRenderPass, nullptr);
+			occlusion.drawCommandsBuffer.destroy();
+			occlusion.visibilityBuffer.destroy();
+		}
 	}
 
 	virtual void getEnabledFeatures()
@@ -126,6 +225,38 @@ public:
 		if (deviceFeatures.multiDrawIndirect) {
 			enabledFeatures.multiDrawIndirect = VK_TRUE;
 		}
+		// Culled draws are compacted on the GPU, so the draw count needs to be sourced from a buffer
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+				enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+				drawIndirectCountSupported = true;
+				break;
+			}
+		}
+	}
+
+	// Binds the state shared by all draws of the instanced mesh
+	void bindScene(VkCommandBuffer commandBuffer)
+	{
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+		// Mesh containing the LODs
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &lodModel.vertices.buffer, offsets);
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+
+		vkCmdBindIndexBuffer(commandBuffer, lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
 
 	void buildCommandBuffers()
@@ -149,46 +280,136 @@ public:
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			if (occlusionCulling) {
+				buildOcclusionCullingCommandBuffer(drawCmdBuffers[i], renderPassBeginInfo);
+				VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+				continue;
+			}
 
-			// Mesh containing the LODs
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &lodModel.vertices.buffer, offsets);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Render pass");
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			bindScene(drawCmdBuffers[i]);
 
-			if (vulkanDevice->features.multiDrawIndirect)
+			// The compacted draw commands start with the visible draws, followed by empty ones
+			if (vulkanDevice->features.multiDrawIndirect && drawIndirectCountSupported)
+			{
+				// The draw count is sourced from the compaction pass, so only the visible draws are processed
+				const uint32_t maxDrawCount = std::min(objectCount, vulkanDevice->properties.limits.maxDrawIndirectCount);
+				vkCmdDrawIndexedIndirectCountKHR(drawCmdBuffers[i], compaction.drawCommandsBuffer.buffer, 0, compaction.blocksBuffer.buffer, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else if (vulkanDevice->features.multiDrawIndirect)
 			{
-				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, indirectCommands.size(), sizeof(VkDrawIndexedIndirectCommand));
+				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], compaction.drawCommandsBuffer.buffer, 0, indirectCommands.size(), sizeof(VkDrawIndexedIndirectCommand));
 			}
 			else
 			{
 				// If multi draw is not available, we must issue separate draw commands
 				for (auto j = 0; j < indirectCommands.size(); j++)
 				{
-					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], compaction.drawCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
 				}
 			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
+	void dispatchOcclusionCull(VkCommandBuffer commandBuffer, uint32_t pass)
+	{
+		OcclusionCullPushConstants pushConstants;
+		pushConstants.pyramidSize = glm::vec2((float)occlusion.pyramidWidth, (float)occlusion.pyramidHeight);
+		pushConstants.objectRadius = lodModel.dimensions.radius;
+		pushConstants.objectCount = objectCount;
+		pushConstants.pass = pass;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.cullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.cullPipelineLayout, 0, 1, &occlusion.cullDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, occlusion.cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+	}
+
+	void drawOcclusionCulled(VkCommandBuffer commandBuffer, uint32_t firstDraw, VkDeviceSize countOffset)
+	{
+		bindScene(commandBuffer);
+		const uint32_t maxDrawCount = std::min(objectCount, vulkanDevice->properties.limits.maxDrawIndirectCount);
+		vkCmdDrawIndexedIndirectCountKHR(commandBuffer, occlusion.drawCommandsBuffer.buffer, firstDraw * sizeof(VkDrawIndexedIndirectCommand), indirectDrawCountBuffer.buffer, countOffset, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	// Records the two phase occlusion culling, including the draws and the depth pyramid build in between
+	void buildOcclusionCullingCommandBuffer(VkCommandBuffer commandBuffer, VkRenderPassBeginInfo renderPassBeginInfo)
+	{
+		// The previous frame has to be done reading the draw counts before they are reset
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdFillBuffer(commandBuffer, indirectDrawCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		// Make the reset counts and the pyramid of the previous frame visible to the cull shader, which also must not overwrite draw commands still in use
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Draw commands and counts written by the cull shader are consumed by the indirect draws
+		VkMemoryBarrier indirectBarrier = vks::initializers::memoryBarrier();
+		indirectBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		indirectBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		// Early pass: Test against the pyramid built from the previous frame's depth
+		gpuProfiler.beginScope(commandBuffer, "Occlusion cull (early)", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		dispatchOcclusionCull(commandBuffer, 0);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &indirectBarrier, 0, nullptr, 0, nullptr);
+
+		gpuProfiler.beginScope(commandBuffer, "Render pass (early)");
+		renderPassBeginInfo.renderPass = occlusion.earlyRenderPass;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		drawOcclusionCulled(commandBuffer, 0, offsetof(IndirectStats, earlyDrawCount));
+		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
+
+		// Build the pyramid from the early pass depth, each level reduces the previous one
+		gpuProfiler.beginScope(commandBuffer, "Depth pyramid", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pyramidPipeline);
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		DepthPyramidPushConstants pushConstants;
+		pushConstants.inputSize = glm::ivec2(width, height);
+		for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+			pushConstants.outputSize = glm::ivec2(std::max(occlusion.pyramidWidth >> i, 1u), std::max(occlusion.pyramidHeight >> i, 1u));
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pyramidPipelineLayout, 0, 1, &occlusion.pyramidDescriptorSets[i], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, occlusion.pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.outputSize.x + 15) / 16, (pushConstants.outputSize.y + 15) / 16, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			pushConstants.inputSize = pushConstants.outputSize;
+		}
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		// Late pass: Re-test the instances rejected by the early pass against the new pyramid
+		gpuProfiler.beginScope(commandBuffer, "Occlusion cull (late)", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		dispatchOcclusionCull(commandBuffer, 1);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &indirectBarrier, 0, nullptr, 0, nullptr);
+
+		gpuProfiler.beginScope(commandBuffer, "Render pass (late)");
+		renderPassBeginInfo.renderPass = occlusion.lateRenderPass;
+		renderPassBeginInfo.clearValueCount = 0;
+		renderPassBeginInfo.pClearValues = nullptr;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		drawOcclusionCulled(commandBuffer, objectCount, offsetof(IndirectStats, lateDrawCount));
+		drawUI(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
+	}
+
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
@@ -200,15 +421,21 @@ public:
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(compute.commandBuffer);
 
 		// Add memory barrier to ensure that the indirect commands have been consumed before the compute shader updates them
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = indirectCommandsBuffer.buffer;
-		bufferBarrier.size = indirectCommandsBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
-		bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+		// The draws consume the compacted commands and the draw count, so these are transferred along with the commands written by the cull shader
+		std::array<VkBufferMemoryBarrier, 3> bufferBarriers;
+		const std::array<vks::Buffer*, 3> indirectBuffers = { &indirectCommandsBuffer, &compaction.drawCommandsBuffer, &compaction.blocksBuffer };
+		for (size_t i = 0; i < bufferBarriers.size(); i++) {
+			bufferBarriers[i] = vks::initializers::bufferMemoryBarrier();
+			bufferBarriers[i].buffer = indirectBuffers[i]->buffer;
+			bufferBarriers[i].size = indirectBuffers[i]->descriptor.range;
+			bufferBarriers[i].srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			bufferBarriers[i].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[i].srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+			bufferBarriers[i].dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+		}
 
 		vkCmdPipelineBarrier(
 			compute.commandBuffer,
@@ -216,24 +443,44 @@ public:
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_FLAGS_NONE,
 			0, nullptr,
-			1, &bufferBarrier,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 			0, nullptr);
 
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		compute.subgroupsRecorded = useSubgroups && (subgroupSize > 0);
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.subgroupsRecorded ? compute.pipelineSubgroup : compute.pipeline);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		// Dispatch the compute job
 		// The compute shader will do the frustum culling and adjust the indirect draw calls depending on object visibility.
 		// It also determines the lod to use depending on distance to the viewer.
+		gpuProfiler.beginScope(compute.commandBuffer, "Cull and lod", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 		vkCmdDispatch(compute.commandBuffer, objectCount / 16, 1, 1);
+		gpuProfiler.endScope(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		// Compact the draw commands with a parallel prefix sum over the visible draws
+		// Each pass reads the results of the previous one
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		gpuProfiler.beginScope(compute.commandBuffer, "Compaction", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.subgroupsRecorded ? compaction.pipelineSubgroup : compaction.pipeline);
+		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compaction.pipelineLayout, 0, 1, &compaction.descriptorSet, 0, 0);
+		const std::array<uint32_t, 3> passGroupCounts = { compaction.blockCount, 1, compaction.blockCount };
+		for (uint32_t pass = 0; pass < passGroupCounts.size(); pass++) {
+			vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			CompactionPushConstants pushConstants = { objectCount, pass };
+			vkCmdPushConstants(compute.commandBuffer, compaction.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(compute.commandBuffer, passGroupCounts[pass], 1, 1);
+		}
+		gpuProfiler.endScope(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
 		// Add memory barrier to ensure that the compute shader has finished writing the indirect command buffer before it's consumed
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-		bufferBarrier.buffer = indirectCommandsBuffer.buffer;
-		bufferBarrier.size = indirectCommandsBuffer.descriptor.range;
-		bufferBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
-		bufferBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+		for (size_t i = 0; i < bufferBarriers.size(); i++) {
+			bufferBarriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[i].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			bufferBarriers[i].srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+			bufferBarriers[i].dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+		}
 
 		vkCmdPipelineBarrier(
 			compute.commandBuffer,
@@ -241,7 +488,7 @@ public:
 			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
 			VK_FLAGS_NONE,
 			0, nullptr,
-			1, &bufferBarrier,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 			0, nullptr);
 
 		// todo: barrier for indirect stats buffer?
@@ -253,9 +500,9 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -266,10 +513,10 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT,0),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);		 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -343,7 +590,7 @@ public:
 		// Indirect (and instanced) pipeline for the plants
 		shaderStages[0] = loadShader(getShadersPath() + "computecullandlod/indirectdraw.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "computecullandlod/indirectdraw.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.plants));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.plants));
 	}
 
 	void prepareBuffers()
@@ -389,8 +636,22 @@ public:
 
 		stagingBuffer.destroy();
 
+		// Compacted draw commands and the draw count, both written by the compaction passes
+		compaction.blockCount = (objectCount + 255) / 256;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compaction.drawCommandsBuffer,
+			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compaction.blocksBuffer,
+			(1 + compaction.blockCount) * sizeof(uint32_t)));
+
+		// Also used as the count buffer for the occlusion culled draws
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&indirectDrawCountBuffer,
 			sizeof(indirectStats)));
@@ -519,14 +780,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&compute.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
@@ -592,7 +853,50 @@ public:
 
 		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
 
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		if (subgroupSize > 0) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull_subgroup.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineSubgroup));
+		}
+
+		// Stream compaction of the draw commands
+		setLayoutBindings = {
+			// Binding 0: Indirect draw commands written by the cull shader (input)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Compacted indirect draw commands (output)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Draw count and per-block prefix sums
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &compaction.descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CompactionPushConstants), 0);
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compaction.descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compaction.pipelineLayout));
+
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compaction.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compaction.descriptorSet));
+		computeWriteDescriptorSets = {
+			vks::initializers::writeDescriptorSet(compaction.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirectCommandsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compaction.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compaction.drawCommandsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compaction.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compaction.blocksBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compaction.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/compact.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compaction.pipeline));
+		if (subgroupSize > 0) {
+			// The subgroup size sizes the shared memory holding the subgroup totals (see base/subgroup.glsl)
+			specializationData = subgroupSize;
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/compact_subgroup.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compaction.pipelineSubgroup));
+		}
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -621,8 +925,297 @@ public:
 		buildComputeCommandBuffer();
 	}
 
+	// Render passes used by occlusion culling, these are compatible with the default render pass, so pipelines and frame buffers are shared
+	void prepareOcclusionRenderPasses()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = swapChain.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		// Early pass: Starts the frame and leaves the depth attachment in a layout that can be sampled for building the pyramid
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		// Previous frame's late pass has to be done with the attachments
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+		// Depth is read by the pyramid shader, color and depth are loaded by the late pass
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &occlusion.earlyRenderPass));
+
+		// Late pass: Renders on top of the early pass and finishes the frame for presentation
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// Pyramid shader has to be done reading depth before it's written again
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &occlusion.lateRenderPass));
+	}
+
+	// Creates the depth pyramid and the descriptor sets referencing it, these depend on the size of the depth attachment
+	void prepareDepthPyramid()
+	{
+		// Depth only view of the depth attachment, as only a single aspect can be sampled
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.image = depthStencil.image;
+		viewCI.format = depthFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &occlusion.depthView));
+
+		// The pyramid starts at the next lower power of two of the attachment size, so each following level halves the previous one
+		occlusion.pyramidWidth = 1;
+		while (occlusion.pyramidWidth * 2 <= width) {
+			occlusion.pyramidWidth *= 2;
+		}
+		occlusion.pyramidHeight = 1;
+		while (occlusion.pyramidHeight * 2 <= height) {
+			occlusion.pyramidHeight *= 2;
+		}
+		occlusion.pyramidLevels = 1;
+		while ((std::max(occlusion.pyramidWidth, occlusion.pyramidHeight) >> occlusion.pyramidLevels) > 0) {
+			occlusion.pyramidLevels++;
+		}
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = VK_FORMAT_R32_SFLOAT;
+		imageCI.extent = { occlusion.pyramidWidth, occlusion.pyramidHeight, 1 };
+		imageCI.mipLevels = occlusion.pyramidLevels;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &occlusion.pyramidImage));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, occlusion.pyramidImage, &memReqs);
+		VkMemoryAllocateInfo memAllloc = vks::initializers::memoryAllocateInfo();
+		memAllloc.allocationSize = memReqs.size;
+		memAllloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllloc, nullptr, &occlusion.pyramidMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, occlusion.pyramidImage, occlusion.pyramidMemory, 0));
+
+		viewCI.image = occlusion.pyramidImage;
+		viewCI.format = VK_FORMAT_R32_SFLOAT;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, occlusion.pyramidLevels, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &occlusion.pyramidView));
+		occlusion.pyramidLevelViews.resize(occlusion.pyramidLevels);
+		for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+			viewCI.subresourceRange.baseMipLevel = i;
+			viewCI.subresourceRange.levelCount = 1;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &occlusion.pyramidLevelViews[i]));
+		}
+
+		// The pyramid stays in the general layout, it's initialized with the far plane so nothing is occluded in the first frame
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, occlusion.pyramidLevels, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, occlusion.pyramidImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+		VkClearColorValue clearColor = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+		vkCmdClearColorImage(copyCmd, occlusion.pyramidImage, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + occlusion.pyramidLevels),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, occlusion.pyramidLevels)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1 + occlusion.pyramidLevels);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &occlusion.descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(occlusion.descriptorPool, &occlusion.cullDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &occlusion.cullDescriptorSet));
+		VkDescriptorImageInfo pyramidDescriptor = vks::initializers::descriptorImageInfo(occlusion.sampler, occlusion.pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: Instance input data buffer
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceBuffer.descriptor),
+			// Binding 1: Compacted draw commands
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &occlusion.drawCommandsBuffer.descriptor),
+			// Binding 2: Uniform buffer with global matrices
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformData.scene.descriptor),
+			// Binding 3: Draw counts and stats
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirectDrawCountBuffer.descriptor),
+			// Binding 4: LOD info
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.lodLevelsBuffers.descriptor),
+			// Binding 5: Depth pyramid
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &pyramidDescriptor),
+			// Binding 6: Per-instance culling state
+			vks::initializers::writeDescriptorSet(occlusion.cullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &occlusion.visibilityBuffer.descriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// One set per pyramid level, reading the depth attachment or the previous level
+		occlusion.pyramidDescriptorSets.resize(occlusion.pyramidLevels);
+		for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(occlusion.descriptorPool, &occlusion.pyramidDescriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &occlusion.pyramidDescriptorSets[i]));
+			VkDescriptorImageInfo inputDescriptor = (i == 0) ?
+				vks::initializers::descriptorImageInfo(occlusion.sampler, occlusion.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) :
+				vks::initializers::descriptorImageInfo(occlusion.sampler, occlusion.pyramidLevelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo outputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, occlusion.pyramidLevelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(occlusion.pyramidDescriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &inputDescriptor),
+				vks::initializers::writeDescriptorSet(occlusion.pyramidDescriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &outputDescriptor)
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void destroyDepthPyramid()
+	{
+		vkDestroyDescriptorPool(device, occlusion.descriptorPool, nullptr);
+		for (auto& view : occlusion.pyramidLevelViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		vkDestroyImageView(device, occlusion.pyramidView, nullptr);
+		vkDestroyImage(device, occlusion.pyramidImage, nullptr);
+		vkFreeMemory(device, occlusion.pyramidMemory, nullptr);
+		vkDestroyImageView(device, occlusion.depthView, nullptr);
+	}
+
+	void prepareOcclusionCulling()
+	{
+		prepareOcclusionRenderPasses();
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&occlusion.drawCommandsBuffer,
+			2 * objectCount * sizeof(VkDrawIndexedIndirectCommand)));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&occlusion.visibilityBuffer,
+			objectCount * sizeof(uint32_t)));
+
+		// Pyramid texels are fetched without filtering, all levels are used
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &occlusion.sampler));
+
+		// Cull shader
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &occlusion.cullDescriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(OcclusionCullPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&occlusion.cullDescriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &occlusion.cullPipelineLayout));
+
+		// Same specialization of the max. level of detail as the frustum cull shader
+		VkSpecializationMapEntry specializationEntry{};
+		specializationEntry.constantID = 0;
+		specializationEntry.offset = 0;
+		specializationEntry.size = sizeof(uint32_t);
+		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		VkSpecializationInfo specializationInfo;
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &specializationEntry;
+		specializationInfo.dataSize = sizeof(specializationData);
+		specializationInfo.pData = &specializationData;
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(occlusion.cullPipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/occlusioncull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &occlusion.cullPipeline));
+
+		// Depth pyramid shader
+		setLayoutBindings = {
+			// Binding 0: Input depth (attachment or previous level)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Output level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &occlusion.pyramidDescriptorSetLayout));
+
+		pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(DepthPyramidPushConstants), 0);
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&occlusion.pyramidDescriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &occlusion.pyramidPipelineLayout));
+
+		computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(occlusion.pyramidPipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/depthpyramid.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &occlusion.pyramidPipeline));
+
+		prepareDepthPyramid();
+	}
+
 	void updateUniformBuffer(bool viewChanged)
 	{
+		waitForFramesInFlight();
 		if (viewChanged)
 		{
 			uboScene.projection = camera.matrices.perspective;
@@ -648,6 +1241,30 @@ public:
 		vkWaitForFences(device, 1, &compute.fence, VK_TRUE, UINT64_MAX);
 		vkResetFences(device, 1, &compute.fence);
 
+		// Get draw count from compute, the previous frame has finished so the stats are complete
+		memcpy(&indirectStats, indirectDrawCountBuffer.mapped, sizeof(indirectStats));
+
+		// The graphics submission waited for the compute submission, so the compute command buffer is no longer in use
+		if (compute.subgroupsRecorded != (useSubgroups && (subgroupSize > 0))) {
+			buildComputeCommandBuffer();
+		}
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+
+		// With occlusion culling all work is part of the graphics command buffer
+		if (occlusionCulling) {
+			VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			submitInfo.pWaitSemaphores = &semaphores.presentComplete;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitDstStageMask = &stageFlags;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, compute.fence));
+			VulkanExampleBase::submitFrame();
+			return;
+		}
+
+		gpuProfiler.collect(compute.commandBuffer);
+
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
 		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
@@ -655,12 +1272,10 @@ public:
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(compute.commandBuffer);
 
 		// Submit graphics command buffer
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-
 		// Wait on present and compute semaphores
 		std::array<VkPipelineStageFlags,2> stageFlags = {
 			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -679,14 +1294,28 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, compute.fence));
 
 		VulkanExampleBase::submitFrame();
-
-		// Get draw count from compute
-		memcpy(&indirectStats, indirectDrawCountBuffer.mapped, sizeof(indirectStats));
 	}
 
 	void prepare()
 	{
+		// Occlusion culling issues all draws of a pass with a single multi draw and samples the depth attachment to build the depth pyramid
+		if (drawIndirectCountSupported && enabledFeatures.multiDrawIndirect) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &formatProperties);
+			occlusionCullingSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		}
+		if (occlusionCullingSupported) {
+			depthStencilUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
 		VulkanExampleBase::prepare();
+		// The compaction variant requires the workgroup to be made of full subgroups
+		subgroupSize = vulkanDevice->getComputeSubgroupSize(VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT);
+		if ((subgroupSize > 0) && ((256 % subgroupSize) != 0)) {
+			subgroupSize = 0;
+		}
+		if (drawIndirectCountSupported) {
+			vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
 		loadAssets();
 		prepareBuffers();
 		setupDescriptorSetLayout();
@@ -694,10 +1323,36 @@ public:
 		setupDescriptorPool();
 		setupDescriptorSet();
 		prepareCompute();
+		if (occlusionCullingSupported) {
+			prepareOcclusionCulling();
+		}
 		buildCommandBuffers();
 		prepared = true;
 	}
 
+	virtual void windowResized()
+	{
+		if (occlusionCullingSupported) {
+			// The depth view and the pyramid depend on the recreated depth attachment
+			destroyDepthPyramid();
+			prepareDepthPyramid();
+			buildCommandBuffers();
+		}
+	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if ((name == "occlusionculling") && occlusionCullingSupported) {
+			occlusionCulling = enabled;
+			return true;
+		}
+		if ((name == "subgroups") && (subgroupSize > 0)) {
+			useSubgroups = enabled;
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
@@ -717,9 +1372,22 @@ public:
 			if (overlay->checkBox("Freeze frustum", &fixedFrustum)) {
 				updateUniformBuffer(true);
 			}
+			if (occlusionCullingSupported) {
+				overlay->checkBox("Occlusion culling", &occlusionCulling);
+			}
+			if (subgroupSize > 0) {
+				overlay->checkBox("Subgroup operations", &useSubgroups);
+			}
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
+			if (occlusionCulling) {
+				overlay->text("Frustum culled: %d", indirectStats.frustumCulledCount);
+				overlay->text("Occluded: %d", indirectStats.occludedCount);
+				overlay->text("Early / late draws: %d / %d", indirectStats.earlyDrawCount, indirectStats.lateDrawCount);
+			} else {
+				overlay->text("Frustum culled: %d", objectCount - indirectStats.drawCount);
+			}
 			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
 			}
@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Minimal headless compute example
 *
+* Can also be run as a compute throughput benchmark (--benchmark), see runBenchmark
+*
 * Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -24,10 +26,14 @@
 #include <assert.h>
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <chrono>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
+#include "VulkanTimelineSemaphore.hpp"
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 android_app* androidapp;
@@ -57,6 +63,21 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
 	return VK_FALSE;
 }
 
+// Settings of the compute throughput benchmark, set via command line arguments
+struct BenchmarkSettings {
+	bool enabled = false;
+	// Total size of the buffers the dispatches stream through, split into chunks of chunkSize (one dispatch per chunk)
+	VkDeviceSize bufferSize = 256ull * 1024 * 1024;
+	VkDeviceSize chunkSize = 64ull * 1024 * 1024;
+	// Number of dispatches submitted before the host waits for the oldest one
+	uint32_t dispatchesInFlight = 3;
+	uint32_t dispatches = 1000;
+	// Repetitions of each transfer bandwidth test
+	uint32_t transferIterations = 10;
+	// JSON results are written to stdout if empty
+	std::string outputFile;
+};
+
 class VulkanExample
 {
 public:
@@ -78,6 +99,12 @@ public:
 
 	VkDebugReportCallbackEXT debugReportCallback{};
 
+	VkPhysicalDeviceProperties deviceProperties;
+	VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+	BenchmarkSettings benchmarkSettings;
+	// Dispatches in flight are tracked with a timeline semaphore if supported, with one fence per dispatch in flight otherwise
+	bool timelineSemaphoreSupported = false;
+
 	VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkBuffer *buffer, VkDeviceMemory *memory, VkDeviceSize size, void *data = nullptr)
 	{
 		// Create the buffer handle
@@ -118,7 +145,7 @@ public:
 		return VK_SUCCESS;
 	}
 
-	VulkanExample()
+	VulkanExample(const BenchmarkSettings& benchmarkSettings = BenchmarkSettings()) : benchmarkSettings(benchmarkSettings)
 	{
 		LOG("Running headless compute example\n");
 
@@ -207,8 +234,8 @@ public:
 		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
 		physicalDevice = physicalDevices[0];
 
-		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
 		LOG("GPU: %s\n", deviceProperties.deviceName);
 
 		// Request a single compute queue
@@ -233,6 +260,28 @@ public:
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		deviceCreateInfo.queueCreateInfoCount = 1;
 		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+		// The benchmark pipelines its dispatches with a timeline semaphore (the feature is required by the extension)
+		std::vector<const char*> deviceExtensions;
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+		if (benchmarkSettings.enabled) {
+			uint32_t extensionCount = 0;
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+			std::vector<VkExtensionProperties> extensions(extensionCount);
+			vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+			for (auto& extension : extensions) {
+				if (strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0) {
+					timelineSemaphoreSupported = true;
+				}
+			}
+			if (timelineSemaphoreSupported) {
+				deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+				timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+				timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+				deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+				deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+				deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+			}
+		}
 		VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
 
 		// Get a compute queue
@@ -510,6 +559,338 @@ public:
 		vkFreeMemory(device, hostMemory, nullptr);
 	}
 
+	/*
+		Compute throughput benchmark
+	*/
+
+	struct BenchmarkBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		bool coherent = true;
+	};
+
+	// Returns the first memory type that has all of the requested properties
+	bool getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t* index)
+	{
+		for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
+			if ((typeBits & (1 << i)) && ((deviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+				*index = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Creates a buffer in a memory type with the required and preferred properties, falls back to the required properties only (host visible buffers are mapped)
+	BenchmarkBuffer createBenchmarkBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags requiredProperties, VkMemoryPropertyFlags preferredProperties, VkDeviceSize size)
+	{
+		BenchmarkBuffer benchmarkBuffer;
+		benchmarkBuffer.size = size;
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &benchmarkBuffer.buffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, benchmarkBuffer.buffer, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		if (!getMemoryTypeIndex(memReqs.memoryTypeBits, requiredProperties | preferredProperties, &memAlloc.memoryTypeIndex)) {
+			if (!getMemoryTypeIndex(memReqs.memoryTypeBits, requiredProperties, &memAlloc.memoryTypeIndex)) {
+				vks::tools::exitFatal("Could not find a suitable memory type for a benchmark buffer", -1);
+			}
+		}
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &benchmarkBuffer.memory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device, benchmarkBuffer.buffer, benchmarkBuffer.memory, 0));
+		if (requiredProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			benchmarkBuffer.coherent = (deviceMemoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+			VK_CHECK_RESULT(vkMapMemory(device, benchmarkBuffer.memory, 0, VK_WHOLE_SIZE, 0, &benchmarkBuffer.mapped));
+		}
+		return benchmarkBuffer;
+	}
+
+	void destroyBenchmarkBuffer(BenchmarkBuffer& benchmarkBuffer)
+	{
+		vkDestroyBuffer(device, benchmarkBuffer.buffer, nullptr);
+		vkFreeMemory(device, benchmarkBuffer.memory, nullptr);
+	}
+
+	// Make device writes to a mapped buffer visible to the host
+	void invalidateBenchmarkBuffer(const BenchmarkBuffer& benchmarkBuffer)
+	{
+		if (!benchmarkBuffer.coherent) {
+			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+			mappedRange.memory = benchmarkBuffer.memory;
+			mappedRange.size = VK_WHOLE_SIZE;
+			VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+		}
+	}
+
+	void submitAndWait(VkCommandBuffer commandBuffer)
+	{
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+	}
+
+	// Returns the transfer rate in GB/s of running a function the given number of times, with each call transferring the given number of bytes
+	template<typename F> double measureBandwidth(uint32_t iterations, VkDeviceSize bytes, F&& function)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			function();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return static_cast<double>(bytes) * iterations / seconds / 1.0e9;
+	}
+
+	/*
+		Streams a (possibly multi-GB) buffer through a bandwidth bound compute shader with several dispatches in flight, then measures mapped and staged transfer bandwidth
+		The buffer is split into chunks that fit into a storage buffer range, each dispatch processes one chunk
+	*/
+	void runBenchmark()
+	{
+		const BenchmarkSettings& settings = benchmarkSettings;
+		LOG("Running compute throughput benchmark\n");
+
+		// Chunks are bound as a whole, so they have to fit into a storage buffer range
+		VkDeviceSize chunkSize = std::min(std::min(settings.chunkSize, settings.bufferSize), static_cast<VkDeviceSize>(deviceProperties.limits.maxStorageBufferRange));
+		chunkSize = std::max(chunkSize & ~static_cast<VkDeviceSize>(255), static_cast<VkDeviceSize>(256));
+		const uint32_t chunkCount = static_cast<uint32_t>((settings.bufferSize + chunkSize - 1) / chunkSize);
+		const uint32_t dispatchesInFlight = std::max(settings.dispatchesInFlight, 1u);
+
+		std::vector<BenchmarkBuffer> chunks(chunkCount);
+		for (uint32_t i = 0; i < chunkCount; i++) {
+			const VkDeviceSize size = std::min(chunkSize, settings.bufferSize - chunkSize * i) & ~static_cast<VkDeviceSize>(3);
+			chunks[i] = createBenchmarkBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, size);
+		}
+
+		// Same descriptor set layout as the example, with the chunk size passed as a push constant
+		struct PushConstants {
+			uint32_t elementCount;
+			uint32_t stride;
+		};
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VkPipelineLayout benchmarkPipelineLayout;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &benchmarkPipelineLayout));
+
+		const std::string shadersPath = getAssetPath() + "shaders/glsl/computeheadless/";
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		shaderStage.module = vks::tools::loadShader(androidapp->activity->assetManager, (shadersPath + "throughput.comp.spv").c_str(), device);
+#else
+		shaderStage.module = vks::tools::loadShader((shadersPath + "throughput.comp.spv").c_str(), device);
+#endif
+		shaderStage.pName = "main";
+		assert(shaderStage.module != VK_NULL_HANDLE);
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(benchmarkPipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VkPipeline benchmarkPipeline;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &benchmarkPipeline));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, chunkCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), chunkCount);
+		VkDescriptorPool benchmarkDescriptorPool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &benchmarkDescriptorPool));
+
+		// One pre-recorded command buffer per chunk, a dispatch may be submitted again while its previous submission is still pending
+		std::vector<VkCommandBuffer> dispatchCommandBuffers(chunkCount);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, chunkCount);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, dispatchCommandBuffers.data()));
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		VkDeviceSize bytesPerPass = 0;
+		for (uint32_t i = 0; i < chunkCount; i++) {
+			VkDescriptorSet chunkDescriptorSet;
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(benchmarkDescriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &chunkDescriptorSet));
+			VkDescriptorBufferInfo bufferDescriptor = { chunks[i].buffer, 0, VK_WHOLE_SIZE };
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(chunkDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+			PushConstants pushConstants;
+			pushConstants.elementCount = static_cast<uint32_t>(chunks[i].size / sizeof(uint32_t));
+			// Grid stride loop, so large chunks don't exceed the work group count limit
+			const uint32_t groupCount = std::min((pushConstants.elementCount + 255) / 256, std::min(deviceProperties.limits.maxComputeWorkGroupCount[0], 65535u));
+			pushConstants.stride = groupCount * 256;
+			bytesPerPass += chunks[i].size;
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(dispatchCommandBuffers[i], &cmdBufInfo));
+			// Previous dispatches (and the initial fill) of the same chunk need to have finished writing
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(dispatchCommandBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdBindPipeline(dispatchCommandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, benchmarkPipeline);
+			vkCmdBindDescriptorSets(dispatchCommandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, benchmarkPipelineLayout, 0, 1, &chunkDescriptorSet, 0, nullptr);
+			vkCmdPushConstants(dispatchCommandBuffers[i], benchmarkPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(dispatchCommandBuffers[i], groupCount, 1, 1);
+			VK_CHECK_RESULT(vkEndCommandBuffer(dispatchCommandBuffers[i]));
+		}
+
+		VkCommandBuffer transferCommandBuffer;
+		cmdBufAllocateInfo.commandBufferCount = 1;
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &transferCommandBuffer));
+
+		// Initial buffer contents
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(transferCommandBuffer, &cmdBufInfo));
+		for (auto& chunk : chunks) {
+			vkCmdFillBuffer(transferCommandBuffer, chunk.buffer, 0, VK_WHOLE_SIZE, 1);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(transferCommandBuffer));
+		submitAndWait(transferCommandBuffer);
+
+		/*
+			Sustained dispatch throughput
+		*/
+		vks::TimelineSemaphore timeline;
+		std::vector<VkFence> dispatchFences;
+		if (timelineSemaphoreSupported) {
+			timeline.create(device);
+		} else {
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			dispatchFences.resize(dispatchesInFlight);
+			for (auto& dispatchFence : dispatchFences) {
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &dispatchFence));
+			}
+		}
+		VkDeviceSize bytesProcessed = 0;
+		const auto dispatchStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < settings.dispatches; i++) {
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &dispatchCommandBuffers[i % chunkCount];
+			if (timelineSemaphoreSupported) {
+				// Dispatch i signals value i + 1, so the host only waits once dispatchesInFlight dispatches are queued
+				if (i >= dispatchesInFlight) {
+					timeline.wait(i + 1 - dispatchesInFlight);
+				}
+				vks::TimelineSubmit timelineSubmit;
+				timelineSubmit.signal(timeline.semaphore, timeline.next());
+				timelineSubmit.apply(submitInfo);
+				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			} else {
+				VkFence& dispatchFence = dispatchFences[i % dispatchesInFlight];
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &dispatchFence, VK_TRUE, UINT64_MAX));
+				VK_CHECK_RESULT(vkResetFences(device, 1, &dispatchFence));
+				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, dispatchFence));
+			}
+			bytesProcessed += chunks[i % chunkCount].size;
+		}
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		const double dispatchSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - dispatchStart).count();
+		const double dispatchesPerSecond = settings.dispatches / dispatchSeconds;
+		// Each element is read and written once
+		const double computeBandwidth = 2.0 * bytesProcessed / dispatchSeconds / 1.0e9;
+
+		/*
+			Transfer bandwidth
+		*/
+		const VkDeviceSize transferSize = chunkSize;
+		std::vector<uint8_t> hostData(static_cast<size_t>(transferSize), 0x5A);
+		BenchmarkBuffer uploadBuffer = createBenchmarkBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, transferSize);
+		// Reading uncached memory on the host is very slow, so cached memory is preferred for the readback
+		BenchmarkBuffer readbackBuffer = createBenchmarkBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, transferSize);
+
+		// Host writes to and reads from mapped memory
+		const double mappedWriteBandwidth = measureBandwidth(settings.transferIterations, transferSize, [&] {
+			memcpy(uploadBuffer.mapped, hostData.data(), static_cast<size_t>(transferSize));
+		});
+		const double mappedReadBandwidth = measureBandwidth(settings.transferIterations, transferSize, [&] {
+			invalidateBenchmarkBuffer(readbackBuffer);
+			memcpy(hostData.data(), readbackBuffer.mapped, static_cast<size_t>(transferSize));
+		});
+
+		// Copies between the staging buffers and all device local chunks
+		VK_CHECK_RESULT(vkBeginCommandBuffer(transferCommandBuffer, &cmdBufInfo));
+		for (auto& chunk : chunks) {
+			VkBufferCopy copyRegion = { 0, 0, chunk.size };
+			vkCmdCopyBuffer(transferCommandBuffer, uploadBuffer.buffer, chunk.buffer, 1, &copyRegion);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(transferCommandBuffer));
+		const double stagedUploadBandwidth = measureBandwidth(settings.transferIterations, bytesPerPass, [&] {
+			submitAndWait(transferCommandBuffer);
+		});
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(transferCommandBuffer, &cmdBufInfo));
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		for (auto& chunk : chunks) {
+			VkBufferCopy copyRegion = { 0, 0, chunk.size };
+			vkCmdCopyBuffer(transferCommandBuffer, chunk.buffer, readbackBuffer.buffer, 1, &copyRegion);
+			// All chunks are copied to the same readback buffer, so the copies must not overlap
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(transferCommandBuffer));
+		const double stagedDownloadBandwidth = measureBandwidth(settings.transferIterations, bytesPerPass, [&] {
+			submitAndWait(transferCommandBuffer);
+			invalidateBenchmarkBuffer(readbackBuffer);
+		});
+
+		/*
+			Results
+		*/
+		std::stringstream result;
+		result << std::fixed;
+		result << "{" << "\n";
+		result << "\t\"device\": \"" << deviceProperties.deviceName << "\"," << "\n";
+		result << "\t\"buffersize\": " << settings.bufferSize << "," << "\n";
+		result << "\t\"chunksize\": " << chunkSize << "," << "\n";
+		result << "\t\"chunks\": " << chunkCount << "," << "\n";
+		result << "\t\"timelinesemaphores\": " << (timelineSemaphoreSupported ? "true" : "false") << "," << "\n";
+		result << "\t\"dispatch\": {" << "\n";
+		result << "\t\t\"dispatches\": " << settings.dispatches << "," << "\n";
+		result << "\t\t\"inflight\": " << dispatchesInFlight << "," << "\n";
+		result << "\t\t\"duration\": " << dispatchSeconds * 1000.0 << "," << "\n";
+		result << "\t\t\"dispatchespersecond\": " << dispatchesPerSecond << "," << "\n";
+		result << "\t\t\"gbpersecond\": " << computeBandwidth << "\n";
+		result << "\t}," << "\n";
+		result << "\t\"transfer\": {" << "\n";
+		result << "\t\t\"iterations\": " << settings.transferIterations << "," << "\n";
+		result << "\t\t\"mappedwritegbpersecond\": " << mappedWriteBandwidth << "," << "\n";
+		result << "\t\t\"mappedreadgbpersecond\": " << mappedReadBandwidth << "," << "\n";
+		result << "\t\t\"readbackcached\": " << (readbackBuffer.coherent ? "false" : "true") << "," << "\n";
+		result << "\t\t\"stageduploadgbpersecond\": " << stagedUploadBandwidth << "," << "\n";
+		result << "\t\t\"stageddownloadgbpersecond\": " << stagedDownloadBandwidth << "\n";
+		result << "\t}" << "\n";
+		result << "}" << "\n";
+		if (settings.outputFile.empty()) {
+			std::cout << result.str();
+		} else {
+			std::ofstream file(settings.outputFile, std::ios::out);
+			file << result.str();
+			LOG("Benchmark results written to %s\n", settings.outputFile.c_str());
+		}
+
+		// Clean up
+		destroyBenchmarkBuffer(uploadBuffer);
+		destroyBenchmarkBuffer(readbackBuffer);
+		timeline.destroy();
+		for (auto& dispatchFence : dispatchFences) {
+			vkDestroyFence(device, dispatchFence, nullptr);
+		}
+		vkFreeCommandBuffers(device, commandPool, 1, &transferCommandBuffer);
+		vkFreeCommandBuffers(device, commandPool, chunkCount, dispatchCommandBuffers.data());
+		vkDestroyDescriptorPool(device, benchmarkDescriptorPool, nullptr);
+		vkDestroyPipeline(device, benchmarkPipeline, nullptr);
+		vkDestroyPipelineLayout(device, benchmarkPipelineLayout, nullptr);
+		vkDestroyShaderModule(device, shaderStage.module, nullptr);
+		for (auto& chunk : chunks) {
+			destroyBenchmarkBuffer(chunk);
+		}
+	}
+
 	~VulkanExample()
 	{
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -555,10 +936,37 @@ void android_main(android_app* state) {
 	}
 }
 #else
-int main() {
-	VulkanExample *vulkanExample = new VulkanExample();
-	std::cout << "Finished. Press enter to terminate...";
-	getchar();
+int main(int argc, char* argv[]) {
+	BenchmarkSettings benchmarkSettings;
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if ((arg == "-b") || (arg == "--benchmark")) {
+			benchmarkSettings.enabled = true;
+		} else if ((arg == "--size") && hasValue) {
+			benchmarkSettings.bufferSize = std::max(std::stoull(argv[++i]), 1ull) * 1024 * 1024;
+		} else if ((arg == "--chunksize") && hasValue) {
+			benchmarkSettings.chunkSize = std::max(std::stoull(argv[++i]), 1ull) * 1024 * 1024;
+		} else if ((arg == "--inflight") && hasValue) {
+			benchmarkSettings.dispatchesInFlight = std::stoul(argv[++i]);
+		} else if ((arg == "--dispatches") && hasValue) {
+			benchmarkSettings.dispatches = std::stoul(argv[++i]);
+		} else if ((arg == "--iterations") && hasValue) {
+			benchmarkSettings.transferIterations = std::max(static_cast<uint32_t>(std::stoul(argv[++i])), 1u);
+		} else if ((arg == "--output") && hasValue) {
+			benchmarkSettings.outputFile = argv[++i];
+		} else {
+			std::cout << "Usage: computeheadless [--benchmark [--size <MB>] [--chunksize <MB>] [--inflight <n>] [--dispatches <n>] [--iterations <n>] [--output <file.json>]]\n";
+			return 1;
+		}
+	}
+	VulkanExample *vulkanExample = new VulkanExample(benchmarkSettings);
+	if (benchmarkSettings.enabled) {
+		vulkanExample->runBenchmark();
+	} else {
+		std::cout << "Finished. Press enter to terminate...";
+		getchar();
+	}
 	delete(vulkanExample);
 	return 0;
 }
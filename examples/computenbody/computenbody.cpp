@@ -16,11 +16,27 @@
 #else
 #define PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+// Number of cells per dimension of the far field approximation grid
+#define GRID_SIZE 16
+// The grid covers [-GRID_EXTENT, GRID_EXTENT], particles outside of it are added to the border cells
+#define GRID_EXTENT 24.0f
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	uint32_t numParticles;
+	// Defaults to PARTICLES_PER_ATTRACTOR, can be changed from the command line (see --particles)
+	uint32_t particlesPerAttractor = PARTICLES_PER_ATTRACTOR;
+	// Approximate the attraction of all particles with that of the cells of a uniform grid, so very large particle counts stay interactive
+	bool gridApproximation = false;
+	// Smallest subgroup size compute shaders may run with, zero if the subgroup variant of the 1st pass isn't supported
+	uint32_t subgroupSize = 0;
+	bool useSubgroups = true;
+	// Compute workgroup size and number of particles per shared memory tile, selected for the device unless set from the command line
+	uint32_t workgroupSize = 0;
+	uint32_t sharedDataSize = 0;
+	// Let the simulation step of a frame run on the compute queue while the previous frame is still rendering (requires timeline semaphores)
+	bool overlapCompute = true;
 
 	struct {
 		vks::Texture2D particle;
@@ -41,7 +57,7 @@ public:
 		VkDescriptorSet descriptorSet;				// Particle system rendering shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkPipeline pipeline;						// Particle rendering pipeline
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		VkSemaphore semaphore = VK_NULL_HANDLE;     // Execution dependency between compute & graphic submission (if timeline semaphores aren't supported)
 		struct {
 			glm::mat4 projection;
 			glm::mat4 view;
@@ -52,17 +68,25 @@ public:
 	// Resources for the compute part of the example
 	struct {
 		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
-		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles
+		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles, only accessed by the compute queue
+		std::array<vks::Buffer, 2> vertexBuffers;	// Copies of the particles for rendering, each simulation step writes one while graphics may still read the other
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing particle system parameters
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<VkCommandBuffer, 2> commandBuffers;	// Command buffers storing the dispatch commands and barriers, one per vertex buffer written
+		uint32_t vertexBufferIndex = 0;				// Vertex buffer written by the latest simulation step
+		std::array<uint64_t, 2> frameValues = {};	// Frame clock value of the last frame that rendered each vertex buffer
+		VkSemaphore semaphore = VK_NULL_HANDLE;     // Execution dependency between compute & graphic submission (if timeline semaphores aren't supported)
+		vks::TimelineSemaphore timeline;			// Signaled with increasing values by the compute submissions (if timeline semaphores are supported)
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipelineCalculate;				// Compute pipeline for N-Body velocity calculation (1st pass)
+		VkPipeline pipelineCalculateSubgroup = VK_NULL_HANDLE;	// Variant sharing the tiles with subgroup shuffles instead of shared memory (if supported)
 		VkPipeline pipelineIntegrate;				// Compute pipeline for euler integration (2nd pass)
+		VkPipeline pipelineGridAccumulate;			// Compute pipeline for accumulating the particles into the grid cells (grid approximation)
+		VkPipeline pipelineCalculateGrid;			// Compute pipeline for velocity calculation against the grid cells (grid approximation)
+		vks::Buffer gridBuffer;						// Accumulated particle count, mass and centroid per grid cell
 		VkPipeline blur;
 		VkPipelineLayout pipelineLayoutBlur;
 		VkDescriptorSetLayout descriptorSetLayoutBlur;
@@ -74,6 +98,8 @@ public:
 	} compute;
 
 	// SSBO particle declaration
+	// Unlike the cloth and particle samples this stays in 32 bit floats: positions and velocities need the precision for the integration,
+	// and storing only mass and gradient position as half floats wouldn't shrink the vectors (the attractor mass of 90000 also exceeds the half float range)
 	struct Particle {
 		glm::vec4 pos;								// xyz = position, w = mass
 		glm::vec4 vel;								// xyz = velocity, w = gradient texture position
@@ -88,6 +114,25 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		// Synchronize compute and graphics with the frame clock of the base class if supported
+		enableTimelineSemaphores = true;
+		// The vertex buffer to render changes every frame, so the command buffer is recorded each frame (see recordCommandBuffer)
+		dynamicCommandBuffers = true;
+		// Allow scaling the simulation for comparing devices
+		CommandLineParser exampleArgs;
+		exampleArgs.add("particles", { "-np", "--particles" }, 1, "Total number of particles, split across the attractors");
+		exampleArgs.add("workgroupsize", { "-wgs", "--workgroupsize" }, 1, "Compute workgroup size (GLSL shaders only)");
+		exampleArgs.add("tilesize", { "-ts", "--tilesize" }, 1, "Number of particles per shared memory tile");
+		exampleArgs.add("grid", { "-gr", "--grid" }, 0, "Approximate the attraction with a uniform grid");
+		exampleArgs.parse(args);
+		if (exampleArgs.isSet("particles")) {
+			particlesPerAttractor = std::max(exampleArgs.getValueAsInt("particles", 0) / 6, 1);
+		}
+		workgroupSize = std::max(exampleArgs.getValueAsInt("workgroupsize", 0), 0);
+		sharedDataSize = std::max(exampleArgs.getValueAsInt("tilesize", 0), 0);
+		gridApproximation = exampleArgs.isSet("grid");
+		// Subgroup operations require Vulkan 1.1
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
@@ -101,12 +146,20 @@ public:
 
 		// Compute
 		compute.storageBuffer.destroy();
+		for (auto& vertexBuffer : compute.vertexBuffers) {
+			vertexBuffer.destroy();
+		}
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipelineCalculate, nullptr);
+		vkDestroyPipeline(device, compute.pipelineCalculateSubgroup, nullptr);
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
+		vkDestroyPipeline(device, compute.pipelineGridAccumulate, nullptr);
+		vkDestroyPipeline(device, compute.pipelineCalculateGrid, nullptr);
+		compute.gridBuffer.destroy();
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
+		compute.timeline.destroy();
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
 		textures.particle.destroy();
@@ -119,9 +172,11 @@ public:
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void buildCommandBuffers()
+	// Called each frame by draw(), renders the vertex buffer written by the latest simulation step
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
@@ -135,180 +190,257 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		vks::Buffer& vertexBuffer = compute.vertexBuffers[compute.vertexBufferIndex];
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			// Acquire barrier
-			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		// Acquire barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
 			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
-					graphics.queueFamilyIndex,
-					compute.storageBuffer.buffer,
-					0,
-					compute.storageBuffer.size
-				};
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				0,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				compute.queueFamilyIndex,
+				graphics.queueFamilyIndex,
+				vertexBuffer.buffer,
+				0,
+				vertexBuffer.size
+			};
 
-				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					0,
-					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
-			}
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
 
-			// Draw the particle system using the update vertex buffer
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// Draw the particle system using the update vertex buffer
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		gpuProfiler.beginScope(commandBuffer, "Render particles");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+		vkCmdDraw(commandBuffer, numParticles, 1, 0, 0);
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Release barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				0,
+				graphics.queueFamilyIndex,
+				compute.queueFamilyIndex,
+				vertexBuffer.buffer,
+				0,
+				vertexBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+	// The particles are updated in place in the storage buffer, which never leaves the compute queue, and then copied to one of the vertex buffers
+	// So a simulation step only has to wait for the frame that last rendered the vertex buffer it writes, not for the previous frame
+	void buildComputeCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, nullptr);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(compute.commandBuffers.size()); i++)
+		{
+			VkCommandBuffer commandBuffer = compute.commandBuffers[i];
+			vks::Buffer& vertexBuffer = compute.vertexBuffers[i];
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], numParticles, 1, 0, 0);
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+			gpuProfiler.beginFrame(commandBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+			// Add memory barrier to ensure that the previous step has finished writing and copying the particles before they are updated again
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.buffer = compute.storageBuffer.buffer;
+			bufferBarrier.size = compute.storageBuffer.size;
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
 
-			// Release barrier
+			// Acquire the vertex buffer from the graphics queue, which released it after rendering
 			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
 				VkBufferMemoryBarrier buffer_barrier =
 				{
 					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
 					0,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
 					graphics.queueFamilyIndex,
 					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
+					vertexBuffer.buffer,
 					0,
-					compute.storageBuffer.size
+					vertexBuffer.size
 				};
 
 				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
 					0,
 					0, nullptr,
 					1, &buffer_barrier,
 					0, nullptr);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+			// Particle counts don't need to be a multiple of the workgroup size, the shaders skip invocations beyond the particle count
+			const uint32_t groupCount = (numParticles + workgroupSize - 1) / workgroupSize;
 
-	}
+			gpuProfiler.beginScope(commandBuffer, "Simulate particles", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
-	void buildComputeCommandBuffer()
-	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		// Acquire barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
+			if (gridApproximation)
 			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+				// Clear the grid once the previous step has finished reading it
+				VkBufferMemoryBarrier gridBarrier = vks::initializers::bufferMemoryBarrier();
+				gridBarrier.buffer = compute.gridBuffer.buffer;
+				gridBarrier.size = compute.gridBuffer.size;
+				gridBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				gridBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				gridBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				gridBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &gridBarrier, 0, nullptr);
+				vkCmdFillBuffer(commandBuffer, compute.gridBuffer.buffer, 0, compute.gridBuffer.size, 0);
+
+				gridBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				gridBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &gridBarrier, 0, nullptr);
+
+				// Accumulate the particles into the grid cells
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineGridAccumulate);
+				vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+				gridBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				gridBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 0, nullptr, 1, &gridBarrier, 0, nullptr);
+
+				// First pass: Calculate particle movement against the grid cells
+				// -------------------------------------------------------------------------------------------------------
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculateGrid);
+				vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+			}
+			else
+			{
+				// First pass: Calculate particle movement
+				// -------------------------------------------------------------------------------------------------------
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, (useSubgroups && (subgroupSize > 0)) ? compute.pipelineCalculateSubgroup : compute.pipelineCalculate);
+				vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+			}
+
+			// Add memory barrier to ensure that the computer shader has finished writing to the buffer
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				1, &bufferBarrier,
 				0, nullptr);
-		}
 
-		// First pass: Calculate particle movement
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
-
-		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
-		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-		bufferBarrier.buffer = compute.storageBuffer.buffer;
-		bufferBarrier.size = compute.storageBuffer.descriptor.range;
-		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		// Transfer ownership if compute and graphics queue family indices differ
-		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		vkCmdPipelineBarrier(
-			compute.commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_FLAGS_NONE,
-			0, nullptr,
-			1, &bufferBarrier,
-			0, nullptr);
-
-		// Second pass: Integrate particles
-		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+			// Second pass: Integrate particles
+			// -------------------------------------------------------------------------------------------------------
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+			vkCmdDispatch(commandBuffer, groupCount, 1, 1);
 
-		// Release barrier
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
+			// Add memory barrier to ensure that the compute shader has finished writing to the buffer before it's copied
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				1, &bufferBarrier,
 				0, nullptr);
-		}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, vertexBuffer.buffer, 1, &copyRegion);
+			gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			// Release the vertex buffer to the graphics queue
+			// Without this the (rendering) vertex shader may display incomplete results (partial data from last frame)
+			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+			{
+				VkBufferMemoryBarrier buffer_barrier =
+				{
+					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+					nullptr,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					0,
+					compute.queueFamilyIndex,
+					graphics.queueFamilyIndex,
+					vertexBuffer.buffer,
+					0,
+					vertexBuffer.size
+				};
+
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					0,
+					0, nullptr,
+					1, &buffer_barrier,
+					0, nullptr);
+			}
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
@@ -330,7 +462,10 @@ public:
 		};
 #endif
 
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		// All particles have to fit into a single storage buffer binding
+		const VkDeviceSize maxParticles = vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(Particle);
+		particlesPerAttractor = std::min(particlesPerAttractor, static_cast<uint32_t>(maxParticles / attractors.size()));
+		numParticles = static_cast<uint32_t>(attractors.size()) * particlesPerAttractor;
 
 		// Initial particle positions
 		std::vector<Particle> particleBuffer(numParticles);
@@ -340,9 +475,9 @@ public:
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < particlesPerAttractor; j++)
 			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				Particle &particle = particleBuffer[i * particlesPerAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -388,25 +523,36 @@ public:
 			particleBuffer.data());
 
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			// The SSBO will be used as a storage buffer for the compute pipeline and copied to the vertex buffers at the end of each simulation step
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.storageBuffer,
 			storageBufferSize);
 
+		// The vertex buffers are written by the first simulation steps before they are rendered, so they don't need initial data
+		for (auto& vertexBuffer : compute.vertexBuffers) {
+			vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&vertexBuffer,
+				storageBufferSize);
+		}
+
 		// Copy from staging buffer to storage buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
 		// Execute a transfer barrier to the compute queue, if necessary
+		// The vertex buffers are released as well, so the first acquire of each of them in the compute command buffers is matched up properly
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 		{
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
 			VkBufferMemoryBarrier buffer_barrier =
 			{
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 				nullptr,
-				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
 				0,
 				graphics.queueFamilyIndex,
 				compute.queueFamilyIndex,
@@ -414,20 +560,34 @@ public:
 				0,
 				compute.storageBuffer.size
 			};
+			bufferBarriers.push_back(buffer_barrier);
+			for (auto& vertexBuffer : compute.vertexBuffers) {
+				buffer_barrier.srcAccessMask = 0;
+				buffer_barrier.buffer = vertexBuffer.buffer;
+				buffer_barrier.size = vertexBuffer.size;
+				bufferBarriers.push_back(buffer_barrier);
+			}
 
 			vkCmdPipelineBarrier(
 				copyCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				0,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 				0, nullptr);
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
 
+		// Grid cells for the far field approximation, cleared and filled by the compute queue each step (count, mass and quantized centroid offset per cell)
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.gridBuffer,
+			GRID_SIZE * GRID_SIZE * GRID_SIZE * 5 * sizeof(uint32_t)));
+
 		// Binding description
 		vertices.bindingDescriptions.resize(1);
 		vertices.bindingDescriptions[0] =
@@ -467,7 +627,7 @@ public:
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
@@ -494,14 +654,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&graphics.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -607,7 +767,7 @@ public:
 		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
 	}
 
 	void prepareGraphics()
@@ -618,9 +778,11 @@ public:
 		preparePipelines();
 		setupDescriptorSet();
 
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
+		// Semaphore for compute & graphics sync, with timeline semaphores the frame clock of the base class is used instead
+		if (!frameTimeline.valid()) {
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
+		}
 	}
 
 	void prepareCompute()
@@ -628,7 +790,7 @@ public:
 		// Create a compute capable device queue
 		// The VulkanDevice::createLogicalDevice functions finds a compute capable queue and prefers queue families that only support compute
 		// Depending on the implementation this may result in different queue family indices for graphics and computes,
-		// requiring proper synchronization (see the memory barriers in buildComputeCommandBuffer)
+		// requiring proper synchronization (see the memory barriers in buildComputeCommandBuffers)
 		vkGetDeviceQueue(device, compute.queueFamilyIndex, 0, &compute.queue);
 
 		// Create compute pipeline
@@ -645,6 +807,11 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
+			// Binding 2 : Grid cells storage buffer (grid approximation)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				2),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -652,14 +819,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&compute.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
@@ -682,7 +849,13 @@ public:
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				1,
-				&compute.uniformBuffer.descriptor)
+				&compute.uniformBuffer.descriptor),
+			// Binding 2 : Grid cells storage buffer
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&compute.gridBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, nullptr);
@@ -699,6 +872,9 @@ public:
 			float gravity;
 			float power;
 			float soften;
+			uint32_t workgroupSize;
+			uint32_t gridSize;
+			float gridExtent;
 		} specializationData;
 
 		std::vector<VkSpecializationMapEntry> specializationMapEntries;
@@ -706,8 +882,32 @@ public:
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, gravity), sizeof(float)));
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, power), sizeof(float)));
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, soften), sizeof(float)));
+		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(4, offsetof(SpecializationData, workgroupSize), sizeof(uint32_t)));
+		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(5, offsetof(SpecializationData, gridSize), sizeof(uint32_t)));
+		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(6, offsetof(SpecializationData, gridExtent), sizeof(float)));
+
+		const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+		if (getShadersPath().find("/hlsl/") != std::string::npos) {
+			// numthreads can't be specialized in HLSL, so the HLSL shaders use a fixed workgroup size
+			workgroupSize = 256;
+		} else {
+			// 256 invocations keep enough work in flight on most devices, unless the device limits the workgroup size further
+			if (workgroupSize == 0) {
+				workgroupSize = 256;
+			}
+			workgroupSize = std::min(std::min(workgroupSize, limits.maxComputeWorkGroupSize[0]), limits.maxComputeWorkGroupInvocations);
+		}
+		// Use the largest tile that fits into shared memory (and the array of the HLSL shaders), rounded down to a multiple of the workgroup size
+		const uint32_t maxSharedDataSize = std::min((uint32_t)1024, (uint32_t)(limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		if ((sharedDataSize == 0) || (sharedDataSize > maxSharedDataSize)) {
+			sharedDataSize = maxSharedDataSize;
+		}
+		sharedDataSize = std::max(sharedDataSize / workgroupSize, 1u) * workgroupSize;
 
-		specializationData.sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		specializationData.sharedDataSize = sharedDataSize;
+		specializationData.workgroupSize = workgroupSize;
+		specializationData.gridSize = GRID_SIZE;
+		specializationData.gridExtent = GRID_EXTENT;
 
 		specializationData.gravity = 0.002f;
 		specializationData.power = 0.75f;
@@ -717,11 +917,31 @@ public:
 			vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
 		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
 
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineCalculate));
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineCalculate));
+
+		// The subgroup variant requires the workgroup to be made of full subgroups, as all invocations of a subgroup take part in the shuffles
+		subgroupSize = vulkanDevice->getComputeSubgroupSize(VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT);
+		if ((subgroupSize > 0) && ((workgroupSize % subgroupSize) != 0)) {
+			subgroupSize = 0;
+		}
+		if (subgroupSize > 0) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_calculate_subgroup.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineCalculateSubgroup));
+		}
 
 		// 2nd pass
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
+
+		// Grid approximation, replaces the 1st pass
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/grid_accumulate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineGridAccumulate));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_calculate_grid.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineCalculateGrid));
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -730,24 +950,31 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
 
-		// Create a command buffer for compute operations
-		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
-
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+		// Create the command buffers for compute operations
+		for (auto& commandBuffer : compute.commandBuffers) {
+			commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
+		}
 
-		// Signal the semaphore
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		if (frameTimeline.valid()) {
+			// Each frame submits its simulation step before its graphics work, so no initial signal is required
+			compute.timeline.create(device);
+		} else {
+			// Semaphore for compute & graphics sync
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+
+			// Signal the graphics semaphore, as the first simulation step waits for it
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &graphics.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		}
 
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		// Build the command buffers containing the compute dispatch commands
+		buildComputeCommandBuffers();
 
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
+		// If graphics and compute queue family indices differ, acquire the storage buffer released after the initial upload, it stays on the compute queue from then on
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 		{
 			// Create a transient command buffer for setting up the initial buffer transfer state
@@ -758,7 +985,7 @@ public:
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 				nullptr,
 				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
 				graphics.queueFamilyIndex,
 				compute.queueFamilyIndex,
 				compute.storageBuffer.buffer,
@@ -767,34 +994,13 @@ public:
 			};
 			vkCmdPipelineBarrier(
 				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				0,
 				0, nullptr,
 				1, &acquire_buffer_barrier,
 				0, nullptr);
 
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
-
 			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
 		}
 	}
@@ -826,31 +1032,116 @@ public:
 		updateGraphicsUniformBuffers();
 	}
 
+	// Number of body interactions evaluated per simulation step, used as the benchmark throughput
+	double interactionsPerStep() const
+	{
+		return static_cast<double>(numParticles) * (gridApproximation ? (GRID_SIZE * GRID_SIZE * GRID_SIZE) : numParticles);
+	}
+
 	void updateComputeUniformBuffers()
 	{
+		waitForFramesInFlight();
 		compute.ubo.deltaT = paused ? 0.0f : frameTimer * 0.05f;
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
 	}
 
 	void updateGraphicsUniformBuffers()
 	{
+		waitForFramesInFlight();
 		graphics.ubo.projection = camera.matrices.perspective;
 		graphics.ubo.view = camera.matrices.view;
 		graphics.ubo.screenDim = glm::vec2((float)width, (float)height);
 		memcpy(graphics.uniformBuffer.mapped, &graphics.ubo, sizeof(graphics.ubo));
 	}
 
+	// Records the command buffer of the current frame in flight from its transient pool, like the base class' renderFrame
+	VkCommandBuffer recordFrameCommandBuffer()
+	{
+		VK_CHECK_RESULT(vkResetCommandPool(device, frameCmdPools[currentFrame], 0));
+		recordCommandBuffer(frameCmdBuffers[currentFrame], currentBuffer);
+		return frameCmdBuffers[currentFrame];
+	}
+
+	// Graphics and compute are ordered by timeline values: graphics waits for the simulation step of the current frame
+	// With overlapCompute the simulation step only waits for the frame that last rendered the vertex buffer it writes (two frames ago),
+	// so it runs on the compute queue while the previous frame is still rendering, otherwise it waits for the previous frame
+	void drawTimeline()
+	{
+		VulkanExampleBase::prepareFrame();
+
+		const uint32_t index = (compute.vertexBufferIndex + 1) % 2;
+		// The last submission of this command buffer has finished, as the frame that rendered its vertex buffer waited for it
+		gpuProfiler.collect(compute.commandBuffers[index]);
+
+		vks::TimelineSubmit computeSubmit;
+		if (overlapCompute) {
+			computeSubmit.wait(frameTimeline.semaphore, VK_PIPELINE_STAGE_TRANSFER_BIT, compute.frameValues[index]);
+		} else {
+			computeSubmit.wait(frameTimeline.semaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, frameTimeline.value);
+		}
+		computeSubmit.signal(compute.timeline.semaphore, compute.timeline.next());
+
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmit.apply(computeSubmitInfo);
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[index];
+		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(compute.commandBuffers[index]);
+		compute.vertexBufferIndex = index;
+
+		vks::TimelineSubmit graphicsSubmit;
+		graphicsSubmit.wait(compute.timeline.semaphore, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, compute.timeline.value);
+		graphicsSubmit.wait(semaphores.presentComplete, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		graphicsSubmit.signal(semaphores.renderComplete);
+
+		VkCommandBuffer commandBuffer = recordFrameCommandBuffer();
+		VkSubmitInfo graphicsSubmitInfo = vks::initializers::submitInfo();
+		graphicsSubmit.apply(graphicsSubmitInfo);
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE));
+
+		// Signals the frame clock once the graphics work of this frame has finished
+		VulkanExampleBase::submitFrame();
+		compute.frameValues[index] = frameTimeline.value;
+	}
+
 	void draw()
 	{
+		if (frameTimeline.valid()) {
+			drawTimeline();
+			return;
+		}
+
 		VulkanExampleBase::prepareFrame();
 
+		const uint32_t index = (compute.vertexBufferIndex + 1) % 2;
+		gpuProfiler.collect(compute.commandBuffers[index]);
+
+		// Wait for rendering of the previous frame finished
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		// Submit compute commands
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[index];
+		computeSubmitInfo.waitSemaphoreCount = 1;
+		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
+		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
+		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(compute.commandBuffers[index]);
+		compute.vertexBufferIndex = index;
+
 		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
 		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
 
 		// Submit graphics commands
+		VkCommandBuffer commandBuffer = recordFrameCommandBuffer();
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		submitInfo.pCommandBuffers = &commandBuffer;
 		submitInfo.waitSemaphoreCount = 2;
 		submitInfo.pWaitSemaphores = graphicsWaitSemaphores;
 		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
@@ -859,20 +1150,6 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
-
-		// Wait for rendering finished
-		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-
-		// Submit compute commands
-		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
-		computeSubmitInfo.waitSemaphoreCount = 1;
-		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
-		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-		computeSubmitInfo.signalSemaphoreCount = 1;
-		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
 	}
 
 	void prepare()
@@ -886,7 +1163,6 @@ public:
 		setupDescriptorPool();
 		prepareGraphics();
 		prepareCompute();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -895,11 +1171,50 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		benchmark.addWork("interactions", interactionsPerStep());
 		updateComputeUniformBuffers();
 		if (camera.updated) {
 			updateGraphicsUniformBuffers();
 		}
 	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if ((name == "subgroups") && (subgroupSize > 0)) {
+			useSubgroups = enabled;
+			// The compute command buffers are pre-recorded
+			VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+			buildComputeCommandBuffers();
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->text("%d particles", numParticles);
+			if (useSubgroups && (subgroupSize > 0)) {
+				overlay->text("Workgroup size %d, subgroup tiles", workgroupSize);
+			} else {
+				overlay->text("Workgroup size %d, tile size %d", workgroupSize, sharedDataSize);
+			}
+			overlay->text("%.1f M interactions per step", interactionsPerStep() / 1000000.0);
+			if (overlay->checkBox("Grid approximation", &gridApproximation)) {
+				// The compute command buffers are pre-recorded
+				VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+				buildComputeCommandBuffers();
+			}
+			if ((subgroupSize > 0) && overlay->checkBox("Subgroup operations", &useSubgroups)) {
+				VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+				buildComputeCommandBuffers();
+			}
+			// Compare the frame time with and without compute overlapping rendering, the GPU times of both are listed above
+			if (frameTimeline.valid()) {
+				overlay->checkBox("Overlap compute and graphics", &overlapCompute);
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
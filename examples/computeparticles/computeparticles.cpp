@@ -25,6 +25,8 @@ public:
 	float timer = 0.0f;
 	float animStart = 20.0f;
 	bool attachToCursor = false;
+	// Let the simulation step of a frame run on the compute queue while the previous frame is still rendering (requires timeline semaphores)
+	bool overlapCompute = true;
 
 	struct {
 		vks::Texture2D particle;
@@ -44,18 +46,22 @@ public:
 		VkDescriptorSet descriptorSet;				// Particle system rendering shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkPipeline pipeline;						// Particle rendering pipeline
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		VkSemaphore semaphore = VK_NULL_HANDLE;     // Execution dependency between compute & graphic submission (if timeline semaphores aren't supported)
 	} graphics;
 
 	// Resources for the compute part of the example
 	struct {
 		uint32_t queueFamilyIndex;					// Used to check if compute and graphics queue families differ and require additional barriers
-		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles
+		vks::Buffer storageBuffer;					// (Shader) storage buffer object containing the particles, only accessed by the compute queue
+		std::array<vks::Buffer, 2> vertexBuffers;	// Copies of the particles for rendering, each simulation step writes one while graphics may still read the other
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing particle system parameters
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
-		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
+		std::array<VkCommandBuffer, 2> commandBuffers;	// Command buffers storing the dispatch commands and barriers, one per vertex buffer written
+		uint32_t vertexBufferIndex = 0;				// Vertex buffer written by the latest simulation step
+		std::array<uint64_t, 2> frameValues = {};	// Frame clock value of the last frame that rendered each vertex buffer
+		VkSemaphore semaphore = VK_NULL_HANDLE;     // Execution dependency between compute & graphic submission (if timeline semaphores aren't supported)
+		vks::TimelineSemaphore timeline;			// Signaled with increasing values by the compute submissions (if timeline semaphores are supported)
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
@@ -69,16 +75,23 @@ public:
 	} compute;
 
 	// SSBO particle declaration
+	// The simulation is bound by memory bandwidth, so particles only store what's used (24 bytes, std430)
+	// Positions and velocities stay in 32 bit floats, as the small per step changes of the integration would be lost with half precision
 	struct Particle {
 		glm::vec2 pos;								// Particle position
 		glm::vec2 vel;								// Particle velocity
-		glm::vec4 gradientPos;						// Texture coordinates for the gradient ramp map
+		float gradientPos;							// Texture coordinate for the gradient ramp map
+		float _pad0;
 	};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader particle system";
 		settings.overlay = true;
+		// Synchronize compute and graphics with the frame clock of the base class if supported
+		enableTimelineSemaphores = true;
+		// The vertex buffer to render changes every frame, so the command buffer is recorded each frame (see recordCommandBuffer)
+		dynamicCommandBuffers = true;
 	}
 
 	~VulkanExample()
@@ -87,14 +100,19 @@ public:
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, graphics.descriptorSetLayout, nullptr);
+		vkDestroySemaphore(device, graphics.semaphore, nullptr);
 
 		// Compute
 		compute.storageBuffer.destroy();
+		for (auto& vertexBuffer : compute.vertexBuffers) {
+			vertexBuffer.destroy();
+		}
 		compute.uniformBuffer.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
+		compute.timeline.destroy();
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
 		textures.particle.destroy();
@@ -107,9 +125,11 @@ public:
 		textures.gradient.loadFromFile(getAssetPath() + "textures/particle_gradient_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void buildCommandBuffers()
+	// Called each frame by draw(), renders the vertex buffer written by the latest simulation step
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = defaultClearColor;
@@ -123,15 +143,134 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+
+		vks::Buffer& vertexBuffer = compute.vertexBuffers[compute.vertexBufferIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		// Acquire barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				0,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				compute.queueFamilyIndex,
+				graphics.queueFamilyIndex,
+				vertexBuffer.buffer,
+				0,
+				vertexBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
+
+		// Draw the particle system using the update vertex buffer
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		gpuProfiler.beginScope(commandBuffer, "Render particles");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+
+		glm::vec2 screendim = glm::vec2((float)width, (float)height);
+		vkCmdPushConstants(
+				commandBuffer,
+				graphics.pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				0,
+				sizeof(glm::vec2),
+				&screendim);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+		vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Release barrier
+		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
+		{
+			VkBufferMemoryBarrier buffer_barrier =
+			{
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				0,
+				graphics.queueFamilyIndex,
+				compute.queueFamilyIndex,
+				vertexBuffer.buffer,
+				0,
+				vertexBuffer.size
+			};
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				1, &buffer_barrier,
+				0, nullptr);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+	// The particles are updated in place in the storage buffer, which never leaves the compute queue, and then copied to one of the vertex buffers
+	// So a simulation step only has to wait for the frame that last rendered the vertex buffer it writes, not for the previous frame
+	void buildComputeCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(compute.commandBuffers.size()); i++)
 		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+			VkCommandBuffer commandBuffer = compute.commandBuffers[i];
+			vks::Buffer& vertexBuffer = compute.vertexBuffers[i];
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+			gpuProfiler.beginFrame(commandBuffer);
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			// Compute particle movement
 
-			// Acquire barrier
+			// Add memory barrier to ensure that the previous step has finished writing and copying the particles before they are updated again
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.buffer = compute.storageBuffer.buffer;
+			bufferBarrier.size = compute.storageBuffer.size;
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
+
+			// Acquire the vertex buffer from the graphics queue, which released it after rendering
 			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
 				VkBufferMemoryBarrier buffer_barrier =
@@ -139,151 +278,77 @@ public:
 					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 					nullptr,
 					0,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					compute.queueFamilyIndex,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
 					graphics.queueFamilyIndex,
-					compute.storageBuffer.buffer,
+					compute.queueFamilyIndex,
+					vertexBuffer.buffer,
 					0,
-					compute.storageBuffer.size
+					vertexBuffer.size
 				};
 
 				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
 					0,
 					0, nullptr,
 					1, &buffer_barrier,
 					0, nullptr);
 			}
 
-			// Draw the particle system using the update vertex buffer
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			// Dispatch the compute job
+			gpuProfiler.beginScope(commandBuffer, "Simulate particles", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+			vkCmdDispatch(commandBuffer, PARTICLE_COUNT / 256, 1, 1);
 
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+			// Add memory barrier to ensure that the compute shader has finished writing to the buffer before it's copied
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
-			glm::vec2 screendim = glm::vec2((float)width, (float)height);
-			vkCmdPushConstants(
-					drawCmdBuffers[i],
-					graphics.pipelineLayout,
-					VK_SHADER_STAGE_VERTEX_BIT,
-					0,
-					sizeof(glm::vec2),
-					&screendim);
-
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
-
-			drawUI(drawCmdBuffers[i]);
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, vertexBuffer.buffer, 1, &copyRegion);
+			gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-			// Release barrier
+			// Release the vertex buffer to the graphics queue
+			// Without this the (rendering) vertex shader may display incomplete results (partial data from last frame)
 			if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 			{
 				VkBufferMemoryBarrier buffer_barrier =
 				{
 					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 					nullptr,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
 					0,
-					graphics.queueFamilyIndex,
 					compute.queueFamilyIndex,
-					compute.storageBuffer.buffer,
+					graphics.queueFamilyIndex,
+					vertexBuffer.buffer,
 					0,
-					compute.storageBuffer.size
+					vertexBuffer.size
 				};
 
 				vkCmdPipelineBarrier(
-					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 					0,
 					0, nullptr,
 					1, &buffer_barrier,
 					0, nullptr);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
-
-	}
-
-	void buildComputeCommandBuffer()
-	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		// Compute particle movement
-
-		// Add memory barrier to ensure that the (graphics) vertex shader has fetched attributes before compute starts to write to the buffer
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				graphics.queueFamilyIndex,
-				compute.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 		}
-
-		// Dispatch the compute job
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, PARTICLE_COUNT / 256, 1, 1);
-
-		// Add barrier to ensure that compute shader has finished writing to the buffer
-		// Without this the (rendering) vertex shader may display incomplete results (partial data from last frame)
-		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
-		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-
-			vkCmdPipelineBarrier(
-				compute.commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
-		}
-
-		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
@@ -297,7 +362,8 @@ public:
 		for (auto& particle : particleBuffer) {
 			particle.pos = glm::vec2(rndDist(rndEngine), rndDist(rndEngine));
 			particle.vel = glm::vec2(0.0f);
-			particle.gradientPos.x = particle.pos.x / 2.0f;
+			particle.gradientPos = particle.pos.x / 2.0f;
+			particle._pad0 = 0.0f;
 		}
 
 		VkDeviceSize storageBufferSize = particleBuffer.size() * sizeof(Particle);
@@ -315,25 +381,36 @@ public:
 			particleBuffer.data());
 
 		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			// The SSBO will be used as a storage buffer for the compute pipeline and copied to the vertex buffers at the end of each simulation step
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.storageBuffer,
 			storageBufferSize);
 
+		// The vertex buffers are written by the first simulation steps before they are rendered, so they don't need initial data
+		for (auto& vertexBuffer : compute.vertexBuffers) {
+			vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&vertexBuffer,
+				storageBufferSize);
+		}
+
 		// Copy from staging buffer to storage buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffer.buffer, 1, &copyRegion);
 		// Execute a transfer barrier to the compute queue, if necessary
+		// The vertex buffers are released as well, so the first acquire of each of them in the compute command buffers is matched up properly
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 		{
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
 			VkBufferMemoryBarrier buffer_barrier =
 			{
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 				nullptr,
-				VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
 				0,
 				graphics.queueFamilyIndex,
 				compute.queueFamilyIndex,
@@ -341,14 +418,21 @@ public:
 				0,
 				compute.storageBuffer.size
 			};
+			bufferBarriers.push_back(buffer_barrier);
+			for (auto& vertexBuffer : compute.vertexBuffers) {
+				buffer_barrier.srcAccessMask = 0;
+				buffer_barrier.buffer = vertexBuffer.buffer;
+				buffer_barrier.size = vertexBuffer.size;
+				bufferBarriers.push_back(buffer_barrier);
+			}
 
 			vkCmdPipelineBarrier(
 				copyCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				0,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 				0, nullptr);
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
@@ -378,7 +462,7 @@ public:
 			vks::initializers::vertexInputAttributeDescription(
 				VERTEX_BUFFER_BIND_ID,
 				1,
-				VK_FORMAT_R32G32B32A32_SFLOAT,
+				VK_FORMAT_R32_SFLOAT,
 				offsetof(Particle, gradientPos));
 
 		// Assign to vertex buffer
@@ -426,7 +510,7 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
@@ -442,7 +526,7 @@ public:
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -556,7 +640,7 @@ public:
 		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
 	}
 
 	void prepareGraphics()
@@ -567,9 +651,11 @@ public:
 		preparePipelines();
 		setupDescriptorSet();
 
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
+		// Semaphore for compute & graphics sync, with timeline semaphores the frame clock of the base class is used instead
+		if (!frameTimeline.valid()) {
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &graphics.semaphore));
+		}
 	}
 
 	void prepareCompute()
@@ -601,14 +687,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device,	&descriptorLayout, nullptr,	&compute.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&compute.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr,	&compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
@@ -639,7 +725,7 @@ public:
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeparticles/particle.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -648,24 +734,31 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
 
-		// Create a command buffer for compute operations
-		compute.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
-
-		// Semaphore for compute & graphics sync
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+		// Create the command buffers for compute operations
+		for (auto& commandBuffer : compute.commandBuffers) {
+			commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
+		}
 
-		// Signal the semaphore
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		if (frameTimeline.valid()) {
+			// Each frame submits its simulation step before its graphics work, so no initial signal is required
+			compute.timeline.create(device);
+		} else {
+			// Semaphore for compute & graphics sync
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
+
+			// Signal the graphics semaphore, as the first simulation step waits for it
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &graphics.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		}
 
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		// Build the command buffers containing the compute dispatch commands
+		buildComputeCommandBuffers();
 
-		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
+		// If graphics and compute queue family indices differ, acquire the storage buffer released after the initial upload, it stays on the compute queue from then on
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
 		{
 			// Create a transient command buffer for setting up the initial buffer transfer state
@@ -676,7 +769,7 @@ public:
 				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
 				nullptr,
 				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
 				graphics.queueFamilyIndex,
 				compute.queueFamilyIndex,
 				compute.storageBuffer.buffer,
@@ -685,34 +778,13 @@ public:
 			};
 			vkCmdPipelineBarrier(
 				transferCmd,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				0,
 				0, nullptr,
 				1, &acquire_buffer_barrier,
 				0, nullptr);
 
-			VkBufferMemoryBarrier release_buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				compute.queueFamilyIndex,
-				graphics.queueFamilyIndex,
-				compute.storageBuffer.buffer,
-				0,
-				compute.storageBuffer.size
-			};
-			vkCmdPipelineBarrier(
-				transferCmd,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-				0,
-				0, nullptr,
-				1, &release_buffer_barrier,
-				0, nullptr);
-
 			vulkanDevice->flushCommandBuffer(transferCmd, compute.queue, compute.commandPool);
 		}
 	}
@@ -735,6 +807,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		compute.ubo.deltaT = frameTimer * 2.5f;
 		if (!attachToCursor)
 		{
@@ -752,40 +825,102 @@ public:
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
 	}
 
-	void draw()
+	// Records the command buffer of the current frame in flight from its transient pool, like the base class' renderFrame
+	VkCommandBuffer recordFrameCommandBuffer()
+	{
+		VK_CHECK_RESULT(vkResetCommandPool(device, frameCmdPools[currentFrame], 0));
+		recordCommandBuffer(frameCmdBuffers[currentFrame], currentBuffer);
+		return frameCmdBuffers[currentFrame];
+	}
+
+	// Graphics and compute are ordered by timeline values: graphics waits for the simulation step of the current frame
+	// With overlapCompute the simulation step only waits for the frame that last rendered the vertex buffer it writes (two frames ago),
+	// so it runs on the compute queue while the previous frame is still rendering, otherwise it waits for the previous frame
+	void drawTimeline()
 	{
 		VulkanExampleBase::prepareFrame();
 
-		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
-		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
+		const uint32_t index = (compute.vertexBufferIndex + 1) % 2;
+		// The last submission of this command buffer has finished, as the frame that rendered its vertex buffer waited for it
+		gpuProfiler.collect(compute.commandBuffers[index]);
 
-		// Submit graphics commands
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		submitInfo.waitSemaphoreCount = 2;
-		submitInfo.pWaitSemaphores = graphicsWaitSemaphores;
-		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
-		submitInfo.signalSemaphoreCount = 2;
-		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		vks::TimelineSubmit computeSubmit;
+		if (overlapCompute) {
+			computeSubmit.wait(frameTimeline.semaphore, VK_PIPELINE_STAGE_TRANSFER_BIT, compute.frameValues[index]);
+		} else {
+			computeSubmit.wait(frameTimeline.semaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, frameTimeline.value);
+		}
+		computeSubmit.signal(compute.timeline.semaphore, compute.timeline.next());
 
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmit.apply(computeSubmitInfo);
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[index];
+		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(compute.commandBuffers[index]);
+		compute.vertexBufferIndex = index;
+
+		vks::TimelineSubmit graphicsSubmit;
+		graphicsSubmit.wait(compute.timeline.semaphore, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, compute.timeline.value);
+		graphicsSubmit.wait(semaphores.presentComplete, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		graphicsSubmit.signal(semaphores.renderComplete);
+
+		VkCommandBuffer commandBuffer = recordFrameCommandBuffer();
+		VkSubmitInfo graphicsSubmitInfo = vks::initializers::submitInfo();
+		graphicsSubmit.apply(graphicsSubmitInfo);
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE));
+
+		// Signals the frame clock once the graphics work of this frame has finished
 		VulkanExampleBase::submitFrame();
+		compute.frameValues[index] = frameTimeline.value;
+	}
 
-		// Wait for rendering finished
-		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	void draw()
+	{
+		if (frameTimeline.valid()) {
+			drawTimeline();
+			return;
+		}
+
+		VulkanExampleBase::prepareFrame();
+
+		const uint32_t index = (compute.vertexBufferIndex + 1) % 2;
+		gpuProfiler.collect(compute.commandBuffers[index]);
+
+		// Wait for rendering of the previous frame finished
+		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
 
 		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
+		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[index];
 		computeSubmitInfo.waitSemaphoreCount = 1;
 		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(compute.commandBuffers[index]);
+		compute.vertexBufferIndex = index;
+
+		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		VkSemaphore graphicsWaitSemaphores[] = { compute.semaphore, semaphores.presentComplete };
+		VkSemaphore graphicsSignalSemaphores[] = { graphics.semaphore, semaphores.renderComplete };
 
+		// Submit graphics commands
+		VkCommandBuffer commandBuffer = recordFrameCommandBuffer();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.waitSemaphoreCount = 2;
+		submitInfo.pWaitSemaphores = graphicsWaitSemaphores;
+		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
+		submitInfo.signalSemaphoreCount = 2;
+		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
 	}
 
 	void prepare()
@@ -799,7 +934,6 @@ public:
 		setupDescriptorPool();
 		prepareGraphics();
 		prepareCompute();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -830,6 +964,10 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Attach attractor to cursor", &attachToCursor);
+			// Compare the frame time with and without compute overlapping rendering, the GPU times of both are listed above
+			if (frameTimeline.valid()) {
+				overlay->checkBox("Overlap compute and graphics", &overlapCompute);
+			}
 		}
 	}
 };
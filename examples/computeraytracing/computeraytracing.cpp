@@ -1,12 +1,19 @@
 /*
 * Vulkan Example - Compute shader ray tracing
 *
+* Spheres and the triangles of a glTF mesh are stored in a bounding volume hierarchy that's built on the CPU (see base/bvh.hpp)
+* and traversed with a stack in the compute shader, so the cost per ray grows logarithmically with the number of primitives
+* The planes of the room are still tested against every ray
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <chrono>
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "bvh.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -36,6 +43,9 @@ public:
 		struct {
 			vks::Buffer spheres;						// (Shader) storage buffer object with scene spheres
 			vks::Buffer planes;						// (Shader) storage buffer object with scene planes
+			vks::Buffer triangles;					// (Shader) storage buffer object with the mesh triangles
+			vks::Buffer bvhNodes;					// (Shader) storage buffer object with the flattened BVH nodes
+			vks::Buffer primitiveIndices;			// (Shader) storage buffer object with the primitives referenced by the BVH leaves
 		} storageBuffers;
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing scene data
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
@@ -68,6 +78,36 @@ public:
 		glm::ivec3 _pad;
 	};
 
+	// SSBO triangle declaration, the shader uses std430 so vec3s followed by a scalar are tightly packed
+	struct Triangle {
+		glm::vec3 v0;
+		float specular;
+		glm::vec3 v1;
+		uint32_t id;
+		glm::vec3 v2;
+		float _pad0;
+		glm::vec3 n0;
+		float _pad1;
+		glm::vec3 n1;
+		float _pad2;
+		glm::vec3 n2;
+		float _pad3;
+		glm::vec3 diffuse;
+		float _pad4;
+	};
+
+	// Mesh that's added to the scene, its triangles are placed in the room at meshPosition and scaled to meshRadius
+	vkglTF::Model mesh;
+	const glm::vec3 meshPosition = glm::vec3(0.0f, 2.75f, 1.5f);
+	const float meshRadius = 1.25f;
+
+	struct {
+		uint32_t nodeCount = 0;
+		uint32_t depth = 0;
+		uint32_t triangleCount = 0;
+		double buildTime = 0.0;
+	} bvhStats;
+
 	// SSBO plane declaration
 	struct Plane {
 		glm::vec3 normal;
@@ -109,6 +149,9 @@ public:
 		compute.uniformBuffer.destroy();
 		compute.storageBuffers.spheres.destroy();
 		compute.storageBuffers.planes.destroy();
+		compute.storageBuffers.triangles.destroy();
+		compute.storageBuffers.bvhNodes.destroy();
+		compute.storageBuffers.primitiveIndices.destroy();
 
 		textureComputeTarget.destroy();
 	}
@@ -296,41 +339,79 @@ public:
 		return plane;
 	}
 
-	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
-	void prepareStorageBuffers()
+	// Create a device local storage buffer and upload data to it via a staging buffer
+	void createStorageBuffer(vks::Buffer& buffer, const void* data, VkDeviceSize size)
 	{
-		// Spheres
-		std::vector<Sphere> spheres;
-		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
-		VkDeviceSize storageBufferSize = spheres.size() * sizeof(Sphere);
-
-		// Stage
 		vks::Buffer stagingBuffer;
-
-		vulkanDevice->createBuffer(
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			storageBufferSize,
-			spheres.data());
+			size,
+			const_cast<void*>(data)));
 
-		vulkanDevice->createBuffer(
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.spheres,
-			storageBufferSize);
+			&buffer,
+			size));
 
 		// Copy to staging buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.spheres.buffer, 1, &copyRegion);
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		stagingBuffer.destroy();
+	}
+
+	// Convert the mesh to a list of world space triangles, placed and scaled to fit the room
+	std::vector<Triangle> loadMeshTriangles()
+	{
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::KeepHostData;
+		mesh.loadFromFile(getAssetPath() + "models/chinesedragon.gltf", vulkanDevice, queue, glTFLoadingFlags);
+
+		// The shader's world has +y pointing down on the screen, which matches the flipped glTF vertices
+		vks::bvh::AABB meshBounds;
+		for (auto& vertex : mesh.hostData.vertices) {
+			meshBounds.grow(vertex.pos);
+		}
+		const glm::vec3 extent = meshBounds.max - meshBounds.min;
+		const float scale = meshRadius / (0.5f * std::max(extent.x, std::max(extent.y, extent.z)));
+		const glm::vec3 center = (meshBounds.min + meshBounds.max) * 0.5f;
+
+		const uint32_t meshId = currentId++;
+		std::vector<Triangle> triangles(mesh.hostData.indices.size() / 3);
+		for (size_t i = 0; i < triangles.size(); i++) {
+			const vkglTF::Vertex& vertex0 = mesh.hostData.vertices[mesh.hostData.indices[i * 3 + 0]];
+			const vkglTF::Vertex& vertex1 = mesh.hostData.vertices[mesh.hostData.indices[i * 3 + 1]];
+			const vkglTF::Vertex& vertex2 = mesh.hostData.vertices[mesh.hostData.indices[i * 3 + 2]];
+			Triangle& triangle = triangles[i];
+			triangle = {};
+			triangle.v0 = meshPosition + (vertex0.pos - center) * scale;
+			triangle.v1 = meshPosition + (vertex1.pos - center) * scale;
+			triangle.v2 = meshPosition + (vertex2.pos - center) * scale;
+			triangle.n0 = vertex0.normal;
+			triangle.n1 = vertex1.normal;
+			triangle.n2 = vertex2.normal;
+			triangle.diffuse = glm::vec3(vertex0.color);
+			triangle.specular = 32.0f;
+			triangle.id = meshId;
+		}
+		return triangles;
+	}
+
+	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
+	void prepareStorageBuffers()
+	{
+		// Spheres
+		std::vector<Sphere> spheres;
+		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
+		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
+		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
+		createStorageBuffer(compute.storageBuffers.spheres, spheres.data(), spheres.size() * sizeof(Sphere));
 
 		// Planes
 		std::vector<Plane> planes;
@@ -341,30 +422,39 @@ public:
 		planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, -1.0f), roomDim, glm::vec3(0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		storageBufferSize = planes.size() * sizeof(Plane);
-
-		// Stage
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			storageBufferSize,
-			planes.data());
-
-		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.planes,
-			storageBufferSize);
-
-		// Copy to staging buffer
-		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.planes.buffer, 1, &copyRegion);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
+		createStorageBuffer(compute.storageBuffers.planes, planes.data(), planes.size() * sizeof(Plane));
+
+		// Triangles
+		std::vector<Triangle> triangles = loadMeshTriangles();
+		createStorageBuffer(compute.storageBuffers.triangles, triangles.data(), triangles.size() * sizeof(Triangle));
+
+		/*
+			Bounding volume hierarchy
+			Primitive indices below the sphere count reference spheres, the ones above reference triangles
+			Planes are infinite and are not part of the hierarchy
+		*/
+		auto tStart = std::chrono::high_resolution_clock::now();
+		std::vector<vks::bvh::AABB> primitiveBounds(spheres.size() + triangles.size());
+		for (size_t i = 0; i < spheres.size(); i++) {
+			primitiveBounds[i].grow(spheres[i].pos - glm::vec3(spheres[i].radius));
+			primitiveBounds[i].grow(spheres[i].pos + glm::vec3(spheres[i].radius));
+		}
+		for (size_t i = 0; i < triangles.size(); i++) {
+			vks::bvh::AABB& aabb = primitiveBounds[spheres.size() + i];
+			aabb.grow(triangles[i].v0);
+			aabb.grow(triangles[i].v1);
+			aabb.grow(triangles[i].v2);
+		}
+		vks::bvh::BVH bvh = vks::bvh::build(primitiveBounds);
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		bvhStats.buildTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		bvhStats.nodeCount = static_cast<uint32_t>(bvh.nodes.size());
+		bvhStats.depth = bvh.depth;
+		bvhStats.triangleCount = static_cast<uint32_t>(triangles.size());
+		benchmark.addSetupTime("bvhbuild", bvhStats.buildTime);
+
+		createStorageBuffer(compute.storageBuffers.bvhNodes, bvh.nodes.data(), bvh.nodes.size() * sizeof(vks::bvh::Node));
+		createStorageBuffer(compute.storageBuffers.primitiveIndices, bvh.primitiveIndices.data(), bvh.primitiveIndices.size() * sizeof(uint32_t));
 	}
 
 	void setupDescriptorPool()
@@ -374,7 +464,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),			// Compute UBO
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),	// Graphics image samplers
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),				// Storage image for ray traced image output
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),			// Storage buffer for the scene primitives
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),			// Storage buffers for the scene primitives and the BVH
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -402,14 +492,14 @@ public:
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&graphics.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -515,7 +605,7 @@ public:
 		pipelineCreateInfo.pStages = shaderStages.data();
 		pipelineCreateInfo.renderPass = renderPass;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
 	}
 
 	// Prepare the compute pipeline that generates the ray traced image
@@ -552,7 +642,22 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				3)
+				3),
+			// Binding 4: Shader storage buffer for the mesh triangles
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4),
+			// Binding 5: Shader storage buffer for the BVH nodes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6: Shader storage buffer for the primitive indices of the BVH leaves
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				6)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -560,14 +665,14 @@ public:
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr,	&compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr,	&compute.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&compute.descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
@@ -602,7 +707,25 @@ public:
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&compute.storageBuffers.planes.descriptor)
+				&compute.storageBuffers.planes.descriptor),
+			// Binding 4: Shader storage buffer for the mesh triangles
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&compute.storageBuffers.triangles.descriptor),
+			// Binding 5: Shader storage buffer for the BVH nodes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				5,
+				&compute.storageBuffers.bvhNodes.descriptor),
+			// Binding 6: Shader storage buffer for the primitive indices of the BVH leaves
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				6,
+				&compute.storageBuffers.primitiveIndices.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
@@ -614,7 +737,7 @@ public:
 				0);
 
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeraytracing/raytracing.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -655,6 +778,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		compute.ubo.lightPos.x = 0.0f + sin(glm::radians(timer * 360.0f)) * cos(glm::radians(timer * 360.0f)) * 2.0f;
 		compute.ubo.lightPos.y = 0.0f + sin(glm::radians(timer * 360.0f)) * 2.0f;
 		compute.ubo.lightPos.z = 0.0f + cos(glm::radians(timer * 360.0f)) * 2.0f;
@@ -718,6 +842,15 @@ public:
 		compute.ubo.aspectRatio = (float)width / (float)height;
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("BVH")) {
+			overlay->text("Triangles: %d", bvhStats.triangleCount);
+			overlay->text("Nodes: %d (depth %d)", bvhStats.nodeCount, bvhStats.depth);
+			overlay->text("Build time: %.2f ms", bvhStats.buildTime);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
@@ -11,6 +11,11 @@
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Texels of a workgroup's shared memory tile including the apron, must match the shaders
+#define MAX_TILE_TEXELS 1024
+// Kernel weights are passed as push constants, which limits the number of taps per pass
+#define MAX_KERNEL_TAPS 28
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
@@ -21,7 +26,8 @@ class VulkanExample : public VulkanExampleBase
 {
 private:
 	vks::Texture2D textureColorMap;
-	vks::Texture2D textureComputeTarget;
+	// The filter passes ping-pong between these, the first pass reads from the color map
+	std::array<vks::Texture2D, 2> filterTargets;
 public:
 	struct {
 		VkPipelineVertexInputStateCreateInfo inputState;
@@ -33,7 +39,7 @@ public:
 	struct {
 		VkDescriptorSetLayout descriptorSetLayout;	// Image display shader binding layout
 		VkDescriptorSet descriptorSetPreCompute;	// Image display shader bindings before compute shader image manipulation
-		VkDescriptorSet descriptorSetPostCompute;	// Image display shader bindings after compute shader image manipulation
+		std::array<VkDescriptorSet, 2> descriptorSetsPostCompute;	// Image display shader bindings after compute shader image manipulation, one per filter target
 		VkPipeline pipeline;						// Image display pipeline
 		VkPipelineLayout pipelineLayout;			// Layout of the graphics pipeline
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
@@ -43,15 +49,53 @@ public:
 	struct Compute {
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
 		VkCommandPool commandPool;					// Use a separate command pool (queue family may differ from the one used for graphics)
-		VkCommandBuffer commandBuffer;				// Command buffer storing the dispatch commands and barriers
+		std::vector<VkCommandBuffer> commandBuffers;	// Command buffers storing the dispatch commands and barriers, used round-robin
+		uint32_t commandBufferIndex = 0;
 		VkSemaphore semaphore;                      // Execution dependency between compute & graphic submission
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
-		VkDescriptorSet descriptorSet;				// Compute shader bindings
-		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
-		std::vector<VkPipeline> pipelines;			// Compute pipelines for image filters
-		int32_t pipelineIndex = 0;					// Current image filtering compute pipeline index
+		// Compute shader bindings: color map -> target 0, target 0 -> target 1, target 1 -> target 0
+		std::array<VkDescriptorSet, 3> descriptorSets;
+		VkPipelineLayout pipelineLayout;			// Layout of the compute pipelines
 	} compute;
 
+	// A convolution pass, specialized for the kernel radius, its direction and the workgroup size
+	enum PassDirection { Full = 0, Horizontal = 1, Vertical = 2 };
+	struct FilterPass {
+		PassDirection direction;
+		VkExtent2D workGroupSize;
+		VkPipeline pipeline;
+	};
+
+	// Image filters are applied in the order they have been added, each one reads the output of the previous one
+	struct Filter {
+		std::string name;
+		uint32_t radius;
+		// Full kernels store (2 * radius + 1)^2 row-major weights, separable kernels the 2 * radius + 1 weights applied horizontally and vertically
+		std::vector<float> weights;
+		bool separable;
+		float scale;
+		float bias;
+		// Average the filtered color channels
+		bool grayscale;
+		bool enabled;
+		std::vector<FilterPass> passes;
+	};
+	std::vector<Filter> filters;
+
+	// The shaders declare the weights as an array of vec4, which has the same layout
+	struct PushConstants {
+		float weights[MAX_KERNEL_TAPS];
+		float scale;
+		float bias;
+		uint32_t grayscale;
+	};
+
+	// Size of the processed frames, the color map is scaled to it by the first pass
+	int32_t frameSizeIndex = 0;
+	std::vector<std::string> frameSizeNames = { "Color map", "1280x720", "1920x1080", "3840x2160" };
+	// Edge length of the workgroups, limited per device and kernel (GLSL shaders only)
+	uint32_t workGroupSize = 16;
+
 	vks::Buffer vertexBuffer;
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
@@ -65,8 +109,6 @@ public:
 
 	int vertexBufferSize;
 
-	std::vector<std::string> shaderNames;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader image load/store";
@@ -75,6 +117,14 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setPerspective(60.0f, (float)width * 0.5f / (float)height, 1.0f, 256.0f);
 		settings.overlay = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("framesize", { "-fs", "--framesize" }, 1, "Processed frame size (0 = color map, 1 = 720p, 2 = 1080p, 3 = 2160p)");
+		exampleArgs.add("workgroupsize", { "-wgs", "--workgroupsize" }, 1, "Compute workgroup edge length (GLSL shaders only)");
+		exampleArgs.parse(args);
+		frameSizeIndex = std::min(std::max(exampleArgs.getValueAsInt("framesize", 0), 0), (int32_t)frameSizeNames.size() - 1);
+		if (exampleArgs.isSet("workgroupsize")) {
+			workGroupSize = std::max(exampleArgs.getValueAsInt("workgroupsize", 0), 1);
+		}
 	}
 
 	~VulkanExample()
@@ -86,9 +136,10 @@ public:
 		vkDestroySemaphore(device, graphics.semaphore, nullptr);
 
 		// Compute
-		for (auto& pipeline : compute.pipelines)
-		{
-			vkDestroyPipeline(device, pipeline, nullptr);
+		for (auto& filter : filters) {
+			for (auto& pass : filter.passes) {
+				vkDestroyPipeline(device, pass.pipeline, nullptr);
+			}
 		}
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
@@ -100,7 +151,9 @@ public:
 		uniformBufferVS.destroy();
 
 		textureColorMap.destroy();
-		textureComputeTarget.destroy();
+		for (auto& filterTarget : filterTargets) {
+			filterTarget.destroy();
+		}
 	}
 
 	// Prepare a texture target that is used to store compute shader calculations
@@ -201,6 +254,112 @@ public:
 		textureColorMap.loadFromFile(getAssetPath() + "textures/vulkan_11_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_GENERAL);
 	}
 
+	VkExtent2D getFrameSize()
+	{
+		switch (frameSizeIndex) {
+		case 1:
+			return { 1280, 720 };
+		case 2:
+			return { 1920, 1080 };
+		case 3:
+			return { 3840, 2160 };
+		default:
+			return { textureColorMap.width, textureColorMap.height };
+		}
+	}
+
+	// Half float targets keep the unclamped intermediate results of separable kernels
+	void prepareFilterTargets()
+	{
+		const VkExtent2D frameSize = getFrameSize();
+		for (auto& filterTarget : filterTargets) {
+			prepareTextureTarget(&filterTarget, frameSize.width, frameSize.height, VK_FORMAT_R16G16B16A16_SFLOAT);
+		}
+	}
+
+	void addFilter(const std::string& name, uint32_t radius, const std::vector<float>& weights, bool separable, float scale, float bias, bool grayscale)
+	{
+		const uint32_t taps = 2 * radius + 1;
+		assert(weights.size() == (separable ? taps : taps * taps));
+		assert(weights.size() <= MAX_KERNEL_TAPS);
+		Filter filter{};
+		filter.name = name;
+		filter.radius = radius;
+		filter.weights = weights;
+		filter.separable = separable;
+		filter.scale = scale;
+		filter.bias = bias;
+		filter.grayscale = grayscale;
+		filters.push_back(filter);
+	}
+
+	void setupFilters()
+	{
+		addFilter("Emboss", 1, {
+			-1.0f, 0.0f, 0.0f,
+			 0.0f, -1.0f, 0.0f,
+			 0.0f, 0.0f, 2.0f }, false, 1.0f, 0.5f, true);
+		addFilter("Edge detect", 1, {
+			-1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f,
+			-1.0f / 8.0f, 1.0f, -1.0f / 8.0f,
+			-1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f }, false, 10.0f, 0.0f, true);
+		addFilter("Sharpen", 1, {
+			-1.0f, -1.0f, -1.0f,
+			-1.0f, 9.0f, -1.0f,
+			-1.0f, -1.0f, -1.0f }, false, 1.0f, 0.0f, false);
+		// Separable kernels are applied as a horizontal and a vertical pass, which needs 2 * (2 * radius + 1) instead of (2 * radius + 1)^2 taps
+		const int32_t gaussRadius = 6;
+		const float sigma = 3.0f;
+		std::vector<float> gaussWeights;
+		float weightSum = 0.0f;
+		for (int32_t i = -gaussRadius; i <= gaussRadius; i++) {
+			gaussWeights.push_back(exp(-(float)(i * i) / (2.0f * sigma * sigma)));
+			weightSum += gaussWeights.back();
+		}
+		for (auto& weight : gaussWeights) {
+			weight /= weightSum;
+		}
+		addFilter("Gaussian blur", gaussRadius, gaussWeights, true, 1.0f, 0.0f, false);
+		addFilter("Box blur", 3, std::vector<float>(7, 1.0f / 7.0f), true, 1.0f, 0.0f, false);
+		filters[0].enabled = true;
+	}
+
+	// Select the workgroup size of a pass, so the workgroup and its apron tile stay within the device limits and the shaders' tile array
+	VkExtent2D getWorkGroupSize(uint32_t radius, PassDirection direction)
+	{
+		if (getShadersPath().find("/hlsl/") != std::string::npos) {
+			// numthreads can't be specialized in HLSL, so the HLSL shader uses a fixed workgroup size that fits all kernels of this example
+			return { 16, 16 };
+		}
+		const VkPhysicalDeviceLimits& limits = vulkanDevice->properties.limits;
+		const uint32_t maxTileTexels = std::min((uint32_t)MAX_TILE_TEXELS, (uint32_t)(limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		const uint32_t apronX = (direction == Vertical) ? 0 : radius;
+		const uint32_t apronY = (direction == Horizontal) ? 0 : radius;
+		VkExtent2D size = { std::min(workGroupSize, limits.maxComputeWorkGroupSize[0]), std::min(workGroupSize, limits.maxComputeWorkGroupSize[1]) };
+		// Halve the larger side until the workgroup fits
+		while ((size.width * size.height > limits.maxComputeWorkGroupInvocations) || ((size.width + 2 * apronX) * (size.height + 2 * apronY) > maxTileTexels)) {
+			assert((size.width > 1) || (size.height > 1));
+			if (size.width >= size.height) {
+				size.width /= 2;
+			} else {
+				size.height /= 2;
+			}
+		}
+		return size;
+	}
+
+	// Pass i writes to filter target i % 2, so the output of the chain is in the target of its last pass
+	uint32_t getPassCount()
+	{
+		uint32_t passCount = 0;
+		for (auto& filter : filters) {
+			if (filter.enabled) {
+				passCount += static_cast<uint32_t>(filter.passes.size());
+			}
+		}
+		return passCount;
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -218,6 +377,11 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// Without enabled filters the unfiltered color map is displayed on both sides
+		const uint32_t passCount = getPassCount();
+		const uint32_t outputIndex = (passCount + 1) % 2;
+		VkDescriptorSet descriptorSetPostCompute = (passCount > 0) ? graphics.descriptorSetsPostCompute[outputIndex] : graphics.descriptorSetPreCompute;
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			// Set target frame buffer
@@ -225,26 +389,28 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Image memory barrier to make sure that compute shader writes are finished before sampling from the texture
-			VkImageMemoryBarrier imageMemoryBarrier = {};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			// We won't be changing the layout of the image
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-			imageMemoryBarrier.image = textureComputeTarget.image;
-			imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			vkCmdPipelineBarrier(
-				drawCmdBuffers[i],
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				0, nullptr,
-				1, &imageMemoryBarrier);
+			if (passCount > 0) {
+				// Image memory barrier to make sure that compute shader writes are finished before sampling from the texture
+				VkImageMemoryBarrier imageMemoryBarrier = {};
+				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				// We won't be changing the layout of the image
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageMemoryBarrier.image = filterTargets[outputIndex].image;
+				imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkCmdPipelineBarrier(
+					drawCmdBuffers[i],
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					VK_FLAGS_NONE,
+					0, nullptr,
+					0, nullptr,
+					1, &imageMemoryBarrier);
+			}
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width * 0.5f, (float)height, 0.0f, 1.0f);
@@ -264,7 +430,7 @@ public:
 			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 
 			// Right (post compute)
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSetPostCompute, 0, NULL);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &descriptorSetPostCompute, 0, NULL);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
 
 			viewport.x = (float)width / 2.0f;
@@ -280,21 +446,57 @@ public:
 
 	}
 
-	void buildComputeCommandBuffer()
+	void buildComputeCommandBuffers()
 	{
-		// Flush the queue if we're rebuilding the command buffer after a pipeline change to ensure it's not currently in use
+		// Flush the queue if we're rebuilding the command buffers after a change of the filter chain to ensure they're not currently in use
 		vkQueueWaitIdle(compute.queue);
+		// Drop the timings of filters that have been removed from the chain
+		gpuProfiler.timings.clear();
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		const VkExtent2D frameSize = getFrameSize();
+
+		for (auto& commandBuffer : compute.commandBuffers) {
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+			gpuProfiler.beginFrame(commandBuffer);
+
+			uint32_t passIndex = 0;
+			for (auto& filter : filters) {
+				if (!filter.enabled) {
+					continue;
+				}
+				gpuProfiler.beginScope(commandBuffer, filter.name, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				for (auto& pass : filter.passes) {
+					if (passIndex > 0) {
+						// Make the previous pass' results visible to this pass, this also keeps this pass from overwriting the image the previous pass read from
+						VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+						memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+						memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+					}
+					// The first pass reads from the color map, all others from the target written by the previous pass
+					VkDescriptorSet descriptorSet = (passIndex == 0) ? compute.descriptorSets[0] : compute.descriptorSets[1 + (passIndex - 1) % 2];
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pass.pipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+
+					PushConstants pushConstants{};
+					memcpy(pushConstants.weights, filter.weights.data(), filter.weights.size() * sizeof(float));
+					pushConstants.scale = filter.scale;
+					pushConstants.bias = filter.bias;
+					pushConstants.grayscale = filter.grayscale ? 1 : 0;
+					vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+					// Frame sizes don't need to be a multiple of the workgroup size, the shader skips invocations outside of the image
+					const uint32_t groupCountX = (frameSize.width + pass.workGroupSize.width - 1) / pass.workGroupSize.width;
+					const uint32_t groupCountY = (frameSize.height + pass.workGroupSize.height - 1) / pass.workGroupSize.height;
+					vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+					passIndex++;
+				}
+				gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			}
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
-
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines[compute.pipelineIndex]);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-
-		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
-
-		vkEndCommandBuffer(compute.commandBuffer);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}
 	}
 
 	// Setup vertices for a single uv-mapped quad
@@ -359,13 +561,13 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			// Graphics pipelines uniform buffers
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			// Graphics pipelines image samplers for displaying compute output image
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
-			// Compute pipelines uses a storage image for image reads and writes
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			// Graphics pipelines image samplers for displaying the input and compute output images, compute pipelines image samplers for reading the filter input
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6),
+			// Compute pipelines use a storage image for writing the filter output
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3),
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 6);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -379,10 +581,10 @@ public:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &graphics.descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&graphics.descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &graphics.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -398,14 +600,28 @@ public:
 		};
 		vkUpdateDescriptorSets(device, baseImageWriteDescriptorSets.size(), baseImageWriteDescriptorSets.data(), 0, nullptr);
 
-		// Final image (after compute shader processing)
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &graphics.descriptorSetPostCompute));
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(graphics.descriptorSetPostCompute, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBufferVS.descriptor),
-			vks::initializers::writeDescriptorSet(graphics.descriptorSetPostCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textureComputeTarget.descriptor)
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+		// Final image (after compute shader processing), written in updateFilterDescriptorSets
+		for (auto& descriptorSet : graphics.descriptorSetsPostCompute) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		}
+	}
 
+	// Point the descriptors at the (re)created filter targets
+	void updateFilterDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (size_t i = 0; i < filterTargets.size(); i++) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(graphics.descriptorSetsPostCompute[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBufferVS.descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(graphics.descriptorSetsPostCompute[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &filterTargets[i].descriptor));
+		}
+		// Color map -> target 0, target 0 -> target 1, target 1 -> target 0
+		const std::array<VkDescriptorImageInfo*, 3> inputs = { &textureColorMap.descriptor, &filterTargets[0].descriptor, &filterTargets[1].descriptor };
+		const std::array<VkDescriptorImageInfo*, 3> outputs = { &filterTargets[0].descriptor, &filterTargets[1].descriptor, &filterTargets[0].descriptor };
+		for (size_t i = 0; i < compute.descriptorSets.size(); i++) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, inputs[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, outputs[i]));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void preparePipelines()
@@ -482,7 +698,7 @@ public:
 		pipelineCreateInfo.pStages = shaderStages.data();
 		pipelineCreateInfo.renderPass = renderPass;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipeline));
 	}
 
 	void prepareGraphics()
@@ -501,42 +717,67 @@ public:
 		// Compute pipelines are created separate from graphics pipelines even if they use the same queue
 
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			// Binding 0: Input image (read-only)
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 0: Input image (sampled, so the first pass can scale the color map to the frame size)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			// Binding 1: Output image (write)
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device,	&descriptorLayout, nullptr, &compute.descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device,	&descriptorLayout, nullptr, &compute.descriptorSetLayout));
 
+		// The kernel weights are passed as push constants
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
-
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &textureColorMap.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &textureComputeTarget.descriptor)
-		};
-		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
+		for (auto& descriptorSet : compute.descriptorSets) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		}
+		updateFilterDescriptorSets();
 
 		// Create compute shader pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo =
 			vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
-
-		// One pipeline for each effect
-		shaderNames = { "emboss", "edgedetect", "sharpen" };
-		for (auto& shaderName : shaderNames) {
-			std::string fileName = getShadersPath() + "computeshader/" + shaderName + ".comp.spv";
-			computePipelineCreateInfo.stage = loadShader(fileName, VK_SHADER_STAGE_COMPUTE_BIT);
-			VkPipeline pipeline;
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
-			compute.pipelines.push_back(pipeline);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeshader/convolve.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+
+		// The kernel radius, the pass direction and the workgroup size are set via specialization constants
+		struct SpecializationData {
+			uint32_t workGroupSizeX;
+			uint32_t workGroupSizeY;
+			int32_t radius;
+			int32_t direction;
+		} specializationData;
+		std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, workGroupSizeX), sizeof(uint32_t)),
+			vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, workGroupSizeY), sizeof(uint32_t)),
+			vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, radius), sizeof(int32_t)),
+			vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, direction), sizeof(int32_t)),
+		};
+		VkSpecializationInfo specializationInfo =
+			vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+
+		// One pipeline per filter pass, separable kernels get a horizontal and a vertical pass
+		for (auto& filter : filters) {
+			std::vector<PassDirection> directions = filter.separable ? std::vector<PassDirection>{ Horizontal, Vertical } : std::vector<PassDirection>{ Full };
+			for (auto direction : directions) {
+				FilterPass pass{};
+				pass.direction = direction;
+				pass.workGroupSize = getWorkGroupSize(filter.radius, direction);
+				specializationData.workGroupSizeX = pass.workGroupSize.width;
+				specializationData.workGroupSizeY = pass.workGroupSize.height;
+				specializationData.radius = static_cast<int32_t>(filter.radius);
+				specializationData.direction = direction;
+				VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pass.pipeline));
+				filter.passes.push_back(pass);
+			}
 		}
 
 		// Separate command pool as queue family for compute may be different than graphics
@@ -546,14 +787,17 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &compute.commandPool));
 
-		// Create a command buffer for compute operations
+		// Create the command buffers for compute operations
+		// Using one more than there are frames in flight makes sure a command buffer has finished executing before it's reused:
+		// The frame fence waited on in prepareFrame is signaled after the graphics submission that waits for the compute work of the frame before
+		compute.commandBuffers.resize(maxFramesInFlight + 1);
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 			vks::initializers::commandBufferAllocateInfo(
 				compute.commandPool,
 				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				1);
+				static_cast<uint32_t>(compute.commandBuffers.size()));
 
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &compute.commandBuffer));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, compute.commandBuffers.data()));
 
 		// Semaphore for compute & graphics sync
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
@@ -566,8 +810,8 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 
-		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		// Build the command buffers containing the compute dispatch commands
+		buildComputeCommandBuffers();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -588,6 +832,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
 		memcpy(uniformBufferVS.mapped, &uboVS, sizeof(uboVS));
@@ -616,16 +861,26 @@ public:
 		// Wait for rendering finished
 		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+		// All compute command buffers contain the same commands, the one used now has finished executing (see prepareCompute)
+		compute.commandBufferIndex = (compute.commandBufferIndex + 1) % static_cast<uint32_t>(compute.commandBuffers.size());
+		VkCommandBuffer computeCommandBuffer = compute.commandBuffers[compute.commandBufferIndex];
+		if (gpuProfiler.collect(computeCommandBuffer) && benchmark.active) {
+			for (auto& timing : gpuProfiler.timings) {
+				benchmark.addScopeTime(timing.name, timing.ms);
+			}
+		}
+
 		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
+		computeSubmitInfo.pCommandBuffers = &computeCommandBuffer;
 		computeSubmitInfo.waitSemaphoreCount = 1;
 		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.frameSubmitted(computeCommandBuffer);
 	}
 
 	void prepare()
@@ -635,7 +890,8 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareTextureTarget(&textureComputeTarget, textureColorMap.width, textureColorMap.height, VK_FORMAT_R8G8B8A8_UNORM);
+		prepareFilterTargets();
+		setupFilters();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -659,8 +915,25 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Shader", &compute.pipelineIndex, shaderNames)) {
-				buildComputeCommandBuffer();
+			if (overlay->comboBox("Frame size", &frameSizeIndex, frameSizeNames)) {
+				// The base class waits for the graphics queue while the UI is used, the compute queue may still be using the targets
+				vkQueueWaitIdle(compute.queue);
+				for (auto& filterTarget : filterTargets) {
+					filterTarget.destroy();
+				}
+				prepareFilterTargets();
+				updateFilterDescriptorSets();
+				buildComputeCommandBuffers();
+			}
+		}
+		if (overlay->header("Filter chain")) {
+			bool changed = false;
+			for (auto& filter : filters) {
+				const std::string caption = filter.name + (filter.separable ? " (separable)" : "");
+				changed |= overlay->checkBox(caption.c_str(), &filter.enabled);
+			}
+			if (changed) {
+				buildComputeCommandBuffers();
 			}
 		}
 	}
@@ -5,6 +5,7 @@
 *
 * With conditional rendering it's possible to execute certain rendering commands based on a buffer value instead of having to rebuild the command buffers.
 * This example sets up a conditional buffer with one value per glTF part, that is used to toggle visibility of single model parts.
+* Alternatively the conditional buffer is written by the GPU from occlusion queries on the bounding boxes of the glTF nodes, so occluded parts are culled without any CPU round trip.
 *
 * Copyright (C) 2018 by Sascha Willems - www.saschawillems.de
 *
@@ -35,8 +36,22 @@ public:
 	std::vector<int32_t> conditionalVisibility;
 	vks::Buffer conditionalBuffer;
 
+	/*
+		GPU occlusion culling
+
+		The bounding box of each mesh node is tested against the depth buffer with an occlusion query after the scene has been drawn.
+		The passed sample counts are copied to the occlusion buffer on the GPU, which is then used as the conditional rendering predicate by the next frame.
+	*/
+	bool occlusionCulling = false;
+	vks::QueryManager occlusionQueries;
+	vks::Buffer occlusionBuffer;
+	// Index of the occlusion query (and predicate) for each mesh node, indexed by node index
+	std::vector<uint32_t> occlusionIndices;
+	std::vector<vkglTF::Node*> occlusionNodes;
+
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
+	VkPipeline boundingBoxPipeline;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 
@@ -59,10 +74,13 @@ public:
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, boundingBoxPipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBuffer.destroy();
 		conditionalBuffer.destroy();
+		occlusionQueries.destroy();
+		occlusionBuffer.destroy();
 	}
 
 	void renderNode(vkglTF::Node *node, VkCommandBuffer commandBuffer) {
@@ -86,8 +104,14 @@ public:
 				*/
 				VkConditionalRenderingBeginInfoEXT conditionalRenderingBeginInfo{};
 				conditionalRenderingBeginInfo.sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT;
-				conditionalRenderingBeginInfo.buffer = conditionalBuffer.buffer;
-				conditionalRenderingBeginInfo.offset = sizeof(int32_t) * node->index;
+				if (occlusionCulling) {
+					// The predicate is the number of samples of the node's bounding box that passed the depth test in the previous frame
+					conditionalRenderingBeginInfo.buffer = occlusionBuffer.buffer;
+					conditionalRenderingBeginInfo.offset = sizeof(uint32_t) * occlusionIndices[node->index];
+				} else {
+					conditionalRenderingBeginInfo.buffer = conditionalBuffer.buffer;
+					conditionalRenderingBeginInfo.offset = sizeof(int32_t) * node->index;
+				}
 
 				/*
 					[POI] Begin conditionally rendered section
@@ -107,6 +131,42 @@ public:
 		}
 	}
 
+	/*
+		Test the bounding boxes of all mesh nodes against the depth buffer of the scene drawn so far
+		Each box is drawn with depth test but without any writes, inside an occlusion query of its own
+	*/
+	void testBoundingBoxes(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundingBoxPipeline);
+		for (size_t i = 0; i < occlusionNodes.size(); i++) {
+			vkglTF::Node* node = occlusionNodes[i];
+			const std::vector<VkDescriptorSet> descriptorsets = {
+				descriptorSet,
+				node->mesh->uniformBuffer.descriptorSet
+			};
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorsets.size()), descriptorsets.data(), 0, NULL);
+
+			// Bounding box of all primitives in mesh space, the node's matrix is applied in the vertex shader like for the mesh itself
+			struct PushBlock {
+				glm::vec4 min;
+				glm::vec4 max;
+			} pushBlock;
+			pushBlock.min = glm::vec4(glm::vec3(FLT_MAX), 0.0f);
+			pushBlock.max = glm::vec4(glm::vec3(-FLT_MAX), 0.0f);
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				pushBlock.min = glm::min(pushBlock.min, glm::vec4(primitive->dimensions.min, 0.0f));
+				pushBlock.max = glm::max(pushBlock.max, glm::vec4(primitive->dimensions.max, 0.0f));
+			}
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushBlock), &pushBlock);
+
+			// Any passed sample makes the node visible, so a non-precise query is sufficient
+			occlusionQueries.beginQuery(commandBuffer, slot, static_cast<uint32_t>(i));
+			// The box is generated in the vertex shader as a triangle strip of 14 vertices
+			vkCmdDraw(commandBuffer, 14, 1, 0, 0);
+			occlusionQueries.endQuery(commandBuffer, slot, static_cast<uint32_t>(i));
+		}
+	}
+
 
 	void buildCommandBuffers()
 	{
@@ -130,6 +190,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (occlusionCulling) {
+				occlusionQueries.reset(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -148,10 +212,21 @@ public:
 				renderNode(node, drawCmdBuffers[i]);
 			}
 
+			if (occlusionCulling) {
+				testBoundingBoxes(drawCmdBuffers[i], i);
+			}
+
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (occlusionCulling) {
+				// The conditional rendering in this command buffer has to be done reading the predicates before they are overwritten
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+				// Write the passed sample counts as 32 bit predicates, the barrier makes them visible to the conditional rendering of the next frame submitted to the queue
+				occlusionQueries.copyResults(drawCmdBuffers[i], i, occlusionBuffer.buffer, 0, sizeof(uint32_t), 0, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -176,7 +251,7 @@ public:
 		descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 		descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
 		descriptorLayoutCI.pBindings = setLayoutBindings.data();
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
 
 		std::array<VkDescriptorSetLayout, 2> setLayouts = {
 			descriptorSetLayout, vkglTF::descriptorSetLayoutUbo
@@ -185,7 +260,7 @@ public:
 		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec4) * 2,	0);
 		pipelineLayoutCI.pushConstantRangeCount = 1;
 		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 
 		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
@@ -226,7 +301,22 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+
+		// Bounding boxes for the occlusion test are generated in the vertex shader, they are depth tested but don't write any depth or color
+		VkPipelineVertexInputStateCreateInfo emptyInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo();
+		inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		// Back faces are also tested, so nodes whose box contains the camera aren't culled
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		blendAttachmentState.colorWriteMask = 0;
+		depthStencilStateCI.depthWriteEnable = VK_FALSE;
+		pipelineCI.pVertexInputState = &emptyInputStateCI;
+		const std::array<VkPipelineShaderStageCreateInfo, 2> boundingBoxShaderStages = {
+			loadShader(getShadersPath() + "conditionalrender/boundingbox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "conditionalrender/boundingbox.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		pipelineCI.pStages = boundingBoxShaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &boundingBoxPipeline));
 	}
 
 	void prepareUniformBuffers()
@@ -242,6 +332,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.view = glm::scale(camera.matrices.view, glm::vec3(0.1f , -0.1f, 0.1f));
 		uboVS.model = glm::translate(glm::mat4(1.0f), scene.dimensions.min);
@@ -250,6 +341,7 @@ public:
 
 	void updateConditionalBuffer()
 	{
+		waitForFramesInFlight();
 		memcpy(conditionalBuffer.mapped, conditionalVisibility.data(), sizeof(int32_t) * conditionalVisibility.size());
 	}
 
@@ -298,6 +390,28 @@ public:
 			Copy visibility data
 		*/
 		updateConditionalBuffer();
+
+		/*
+			Setup the GPU written predicates, one occlusion query per mesh node
+		*/
+		occlusionIndices.resize(scene.linearNodes.size(), 0);
+		for (auto node : scene.linearNodes) {
+			if (node->mesh) {
+				occlusionIndices[node->index] = static_cast<uint32_t>(occlusionNodes.size());
+				occlusionNodes.push_back(node);
+			}
+		}
+		if (!occlusionNodes.empty()) {
+			occlusionQueries.setup(vulkanDevice, VK_QUERY_TYPE_OCCLUSION, static_cast<uint32_t>(occlusionNodes.size()));
+			// All nodes are considered visible until the first occlusion results have been copied
+			std::vector<uint32_t> passedSamples(occlusionNodes.size(), 1);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&occlusionBuffer,
+				sizeof(uint32_t) * passedSamples.size(),
+				passedSamples.data()));
+		}
 	}
 
 	void draw()
@@ -333,7 +447,11 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		if (overlay->header("Visibility")) {
+		if (overlay->header("Occlusion culling") && !occlusionNodes.empty()) {
+			// The predicate buffer is baked into the command buffers, which are rebuilt by the base class on UI changes
+			overlay->checkBox("GPU occlusion culling", &occlusionCulling);
+		}
+		if (!occlusionCulling && overlay->header("Visibility")) {
 
 			if (overlay->button("All")) {
 				for (auto i = 0; i < conditionalVisibility.size(); i++) {
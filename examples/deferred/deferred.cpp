@@ -11,17 +11,26 @@
 
 #define ENABLE_VALIDATION false
 
-// Texture properties
-#define TEX_DIM 2048
-#define TEX_FILTER VK_FILTER_LINEAR
+// Light clustering grid, must match the cluster and composition shaders
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 8
+#define CLUSTER_COUNT_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 512
 
-// Offscreen frame buffer properties
-#define FB_DIM TEX_DIM
+// Upper limit for the number of lights that can be selected in the UI
+#define MAX_LIGHT_COUNT 8192
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	int32_t debugDisplayTarget = 0;
+	// The first six lights are the animated lights of the original scene, all others are generated
+	int32_t lightCount = 6;
+	// Bin the lights into view frustum clusters with a compute shader, so the composition only evaluates the lights that affect a fragment
+	bool clusteredLighting = true;
+	// Render the G-Buffer and the composition as two subpasses of the default render pass (selected with --subpassgbuffer)
+	// The G-Buffer is then only read at the current fragment's location, so it can stay in tile memory on tile based GPUs and uses packed transient attachments
+	bool subpassGBuffer = false;
 
 	struct {
 		struct {
@@ -47,15 +56,33 @@ public:
 	} uboOffscreenVS;
 
 	struct Light {
+		// xyz = position, w = range
 		glm::vec4 position;
 		glm::vec3 color;
 		float radius;
 	};
+	std::vector<Light> lights;
+
+	// Generated lights orbit around their origin
+	struct LightAnimation {
+		glm::vec3 origin;
+		float orbitRadius;
+		float speed;
+		float phase;
+	};
+	std::vector<LightAnimation> lightAnimations;
 
 	struct {
-		Light lights[6];
+		glm::mat4 inverseProjection;
+		glm::mat4 view;
+		// Used to reconstruct the world space position from depth with the subpass G-Buffer
+		glm::mat4 inverseView;
 		glm::vec4 viewPos;
+		// x = near plane, y = far plane
+		glm::vec4 depthRange;
 		int debugDisplayTarget = 0;
+		int lightCount = 6;
+		int clustered = 1;
 	} uboComposition;
 
 	struct {
@@ -63,6 +90,30 @@ public:
 		vks::Buffer composition;
 	} uniformBuffers;
 
+	struct {
+		// Lights, written by the host
+		vks::Buffer lights;
+		// Number of lights binned into each cluster
+		vks::Buffer lightGrid;
+		// Indices of the lights binned into each cluster, with MAX_LIGHTS_PER_CLUSTER slots per cluster
+		vks::Buffer lightIndices;
+	} storageBuffers;
+
+	// Compute pipeline used for binning the lights into the clusters
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} lightCulling;
+
+	// Composition reading the G-Buffer as input attachments in the second subpass
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	} subpassComposition;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
@@ -78,22 +129,23 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	// Framebuffer for offscreen rendering
+	// With the subpass G-Buffer, the attachments are part of the default render pass and there's no position attachment
 	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
 		VkFormat format;
 	};
 	struct FrameBuffer {
 		int32_t width, height;
-		VkFramebuffer frameBuffer;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
 		FrameBufferAttachment position, normal, albedo;
 		FrameBufferAttachment depth;
-		VkRenderPass renderPass;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
 	} offScreenFrameBuf;
 
 	// One sampler for the frame buffer color attachments
-	VkSampler colorSampler;
+	VkSampler colorSampler = VK_NULL_HANDLE;
 
 	VkCommandBuffer offScreenCmdBuffer = VK_NULL_HANDLE;
 
@@ -103,6 +155,8 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Deferred shading";
+		// windowResized destroys the G-Buffer the frames in flight render to, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		camera.type = Camera::CameraType::firstperson;
 		camera.movementSpeed = 5.0f;
 #ifndef __ANDROID__
@@ -112,6 +166,12 @@ public:
 		camera.setRotation(glm::vec3(-0.75f, 12.5f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		subpassGBuffer = commandLineParser.isSet("subpassgbuffer");
+		if (subpassGBuffer) {
+			title += " (subpass G-Buffer)";
+			// The UI is drawn in the composition subpass
+			UIOverlay.subpass = 1;
+		}
 	}
 
 	~VulkanExample()
@@ -122,26 +182,7 @@ public:
 		vkDestroySampler(device, colorSampler, nullptr);
 
 		// Frame buffer
-
-		// Color attachments
-		vkDestroyImageView(device, offScreenFrameBuf.position.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.position.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.position.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.normal.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.normal.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.normal.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.albedo.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.albedo.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.albedo.mem, nullptr);
-
-		// Depth attachment
-		vkDestroyImageView(device, offScreenFrameBuf.depth.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.depth.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.depth.mem, nullptr);
-
-		vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+		destroyGBuffer();
 
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
@@ -153,6 +194,16 @@ public:
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.composition.destroy();
+		storageBuffers.lights.destroy();
+		storageBuffers.lightGrid.destroy();
+		storageBuffers.lightIndices.destroy();
+
+		vkDestroyPipeline(device, lightCulling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, lightCulling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, lightCulling.descriptorSetLayout, nullptr);
+
+		vkDestroyPipelineLayout(device, subpassComposition.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, subpassComposition.descriptorSetLayout, nullptr);
 
 		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
 
@@ -174,9 +225,10 @@ public:
 	};
 
 	// Create a frame buffer attachment
+	// Attachments used as input attachments are only read within the render pass, so they're created transient
 	void createAttachment(
 		VkFormat format,
-		VkImageUsageFlagBits usage,
+		VkImageUsageFlags usage,
 		FrameBufferAttachment *attachment)
 	{
 		VkImageAspectFlags aspectMask = 0;
@@ -191,12 +243,15 @@ public:
 		}
 		if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
 		{
-			aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			// Input attachments can only access a single aspect
+			aspectMask = (usage & VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
 			imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		}
 
 		assert(aspectMask > 0);
 
+		const bool transient = (usage & VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT) != 0;
+
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
 		image.format = format;
@@ -207,17 +262,12 @@ public:
 		image.arrayLayers = 1;
 		image.samples = VK_SAMPLE_COUNT_1_BIT;
 		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
+		image.usage = transient ? usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : usage | VK_IMAGE_USAGE_SAMPLED_BIT;
 
 		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+		// Prefer lazily allocated memory for transient attachments, fall back to device local memory if not available
+		// G-Buffer attachments get a high memory priority, so they stay in device local memory if it's oversubscribed
+		VK_CHECK_RESULT(vulkanDevice->allocateRenderTargetMemory(attachment->image, &attachment->mem, transient));
 
 		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
 		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -232,11 +282,40 @@ public:
 		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
 	}
 
-	// Prepare a new framebuffer and attachments for offscreen rendering (G-Buffer)
-	void prepareOffscreenFramebuffer()
+	// Create the G-Buffer attachments at the size of the window
+	void createGBuffer()
 	{
-		offScreenFrameBuf.width = FB_DIM;
-		offScreenFrameBuf.height = FB_DIM;
+		offScreenFrameBuf.width = width;
+		offScreenFrameBuf.height = height;
+
+		if (subpassGBuffer) {
+			// Packed attachments, the position is reconstructed from depth in the composition
+
+			// Octahedral encoded normals (rg) and specular (b)
+			createAttachment(
+				VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+				&offScreenFrameBuf.normal);
+
+			// Albedo (color), packed float format if it can be rendered to
+			VkFormat albedoFormat = VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, albedoFormat, &formatProperties);
+			if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)) {
+				albedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+			}
+			createAttachment(
+				albedoFormat,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+				&offScreenFrameBuf.albedo);
+
+			// Depth attachment
+			createAttachment(
+				depthFormat,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+				&offScreenFrameBuf.depth);
+			return;
+		}
 
 		// Color attachments
 
@@ -269,6 +348,45 @@ public:
 			attDepthFormat,
 			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 			&offScreenFrameBuf.depth);
+	}
+
+	void destroyGBuffer()
+	{
+		std::array<FrameBufferAttachment*, 4> attachments = { &offScreenFrameBuf.position, &offScreenFrameBuf.normal, &offScreenFrameBuf.albedo, &offScreenFrameBuf.depth };
+		for (FrameBufferAttachment* attachment : attachments) {
+			vkDestroyImageView(device, attachment->view, nullptr);
+			vkDestroyImage(device, attachment->image, nullptr);
+			vkFreeMemory(device, attachment->mem, nullptr);
+			*attachment = FrameBufferAttachment();
+		}
+		vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+		offScreenFrameBuf.frameBuffer = VK_NULL_HANDLE;
+	}
+
+	void createOffscreenFramebuffer()
+	{
+		std::array<VkImageView,4> attachments;
+		attachments[0] = offScreenFrameBuf.position.view;
+		attachments[1] = offScreenFrameBuf.normal.view;
+		attachments[2] = offScreenFrameBuf.albedo.view;
+		attachments[3] = offScreenFrameBuf.depth.view;
+
+		VkFramebufferCreateInfo fbufCreateInfo = {};
+		fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		fbufCreateInfo.pNext = NULL;
+		fbufCreateInfo.renderPass = offScreenFrameBuf.renderPass;
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.width = offScreenFrameBuf.width;
+		fbufCreateInfo.height = offScreenFrameBuf.height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offScreenFrameBuf.frameBuffer));
+	}
+
+	// Prepare a new framebuffer and attachments for offscreen rendering (G-Buffer)
+	void prepareOffscreenFramebuffer()
+	{
+		createGBuffer();
 
 		// Set up separate renderpass with references to the color and depth attachments
 		std::array<VkAttachmentDescription, 4> attachmentDescs = {};
@@ -342,24 +460,9 @@ public:
 		renderPassInfo.dependencyCount = 2;
 		renderPassInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offScreenFrameBuf.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &offScreenFrameBuf.renderPass));
 
-		std::array<VkImageView,4> attachments;
-		attachments[0] = offScreenFrameBuf.position.view;
-		attachments[1] = offScreenFrameBuf.normal.view;
-		attachments[2] = offScreenFrameBuf.albedo.view;
-		attachments[3] = offScreenFrameBuf.depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = {};
-		fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbufCreateInfo.pNext = NULL;
-		fbufCreateInfo.renderPass = offScreenFrameBuf.renderPass;
-		fbufCreateInfo.pAttachments = attachments.data();
-		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbufCreateInfo.width = offScreenFrameBuf.width;
-		fbufCreateInfo.height = offScreenFrameBuf.height;
-		fbufCreateInfo.layers = 1;
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offScreenFrameBuf.frameBuffer));
+		createOffscreenFramebuffer();
 
 		// Create sampler to sample from the color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -377,17 +480,169 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
+	// Override render pass setup from base class for the subpass G-Buffer
+	void setupRenderPass()
+	{
+		if (!subpassGBuffer) {
+			VulkanExampleBase::setupRenderPass();
+			return;
+		}
+
+		createGBuffer();
+
+		std::array<VkAttachmentDescription, 4> attachments{};
+		// Swap chain color attachment, written by the composition
+		attachments[0].format = swapChain.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// G-Buffer attachments, written in the first subpass and read in the second subpass
+		// They're never stored, so on tile based GPUs they don't leave tile memory
+		const std::array<FrameBufferAttachment*, 3> gBufferAttachments = { &offScreenFrameBuf.normal, &offScreenFrameBuf.albedo, &offScreenFrameBuf.depth };
+		for (uint32_t i = 1; i < 4; i++) {
+			attachments[i].format = gBufferAttachments[i - 1]->format;
+			attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachments[i].finalLayout = (i == 3) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		std::array<VkSubpassDescription, 2> subpassDescriptions{};
+
+		// First subpass: Fill the G-Buffer
+		VkAttachmentReference colorReferences[2];
+		colorReferences[0] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		colorReferences[1] = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[0].colorAttachmentCount = 2;
+		subpassDescriptions[0].pColorAttachments = colorReferences;
+		subpassDescriptions[0].pDepthStencilAttachment = &depthReference;
+
+		// Second subpass: Composition (and UI) reading the G-Buffer as input attachments
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference inputReferences[3];
+		inputReferences[0] = { 3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		inputReferences[1] = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		inputReferences[2] = { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[1].colorAttachmentCount = 1;
+		subpassDescriptions[1].pColorAttachments = &colorReference;
+		subpassDescriptions[1].inputAttachmentCount = 3;
+		subpassDescriptions[1].pInputAttachments = inputReferences;
+
+		// Subpass dependencies for layout transitions
+		std::array<VkSubpassDependency, 3> dependencies;
+
+		// The G-Buffer attachments are shared by all frame buffers, so the previous frame needs to be done with them before they are cleared
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		// This dependency transitions the G-Buffer attachments to input attachments
+		// Each fragment only reads the G-Buffer at its own location, so the dependency is by region
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = 1;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[2].srcSubpass = 1;
+		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+		renderPassInfo.pSubpasses = subpassDescriptions.data();
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+	}
+
+	// Override frame buffer setup from base class for the subpass G-Buffer
+	void setupFrameBuffer()
+	{
+		if (!subpassGBuffer) {
+			VulkanExampleBase::setupFrameBuffer();
+			return;
+		}
+
+		// The G-Buffer follows the window size
+		if ((offScreenFrameBuf.width != width) || (offScreenFrameBuf.height != height)) {
+			destroyGBuffer();
+			createGBuffer();
+		}
+
+		VkImageView views[4];
+		// The G-Buffer attachments are the same for all frame buffers
+		views[1] = offScreenFrameBuf.normal.view;
+		views[2] = offScreenFrameBuf.albedo.view;
+		views[3] = offScreenFrameBuf.depth.view;
+
+		VkFramebufferCreateInfo frameBufferCI{};
+		frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferCI.renderPass = renderPass;
+		frameBufferCI.attachmentCount = 4;
+		frameBufferCI.pAttachments = views;
+		frameBufferCI.width = width;
+		frameBufferCI.height = height;
+		frameBufferCI.layers = 1;
+
+		frameBuffers.resize(swapChain.imageCount);
+		for (uint32_t i = 0; i < frameBuffers.size(); i++) {
+			views[0] = swapChain.buffers[i].view;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCI, nullptr, &frameBuffers[i]));
+		}
+	}
+
+	// Draw the scene into the G-Buffer
+	void drawScene(VkCommandBuffer cmdBuffer)
+	{
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+
+		// Background
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
+		models.floor.draw(cmdBuffer);
+
+		// Instanced object
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
+		models.model.bindBuffers(cmdBuffer);
+		vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+	}
+
 	// Build command buffer for rendering the scene to the offscreen frame buffer attachments
 	void buildDeferredCommandBuffer()
 	{
 		if (offScreenCmdBuffer == VK_NULL_HANDLE)
 		{
 			offScreenCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
-		}
 
-		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+			// Create a semaphore used to synchronize offscreen rendering and usage
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		}
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -416,16 +671,7 @@ public:
 		VkRect2D scissor = vks::initializers::rect2D(offScreenFrameBuf.width, offScreenFrameBuf.height, 0, 0);
 		vkCmdSetScissor(offScreenCmdBuffer, 0, 1, &scissor);
 
-		vkCmdBindPipeline(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-
-		// Background
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
-		models.floor.draw(offScreenCmdBuffer);
-
-		// Instanced object
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
-		models.model.bindBuffers(offScreenCmdBuffer);
-		vkCmdDrawIndexed(offScreenCmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+		drawScene(offScreenCmdBuffer);
 
 		vkCmdEndRenderPass(offScreenCmdBuffer);
 
@@ -447,9 +693,15 @@ public:
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VkClearValue clearValues[2];
+		VkClearValue clearValues[4];
 		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
 		clearValues[1].depthStencil = { 1.0f, 0 };
+		if (subpassGBuffer) {
+			// The default render pass also contains the G-Buffer attachments
+			clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[3].depthStencil = { 1.0f, 0 };
+		}
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = renderPass;
@@ -457,7 +709,7 @@ public:
 		renderPassBeginInfo.renderArea.offset.y = 0;
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.clearValueCount = subpassGBuffer ? 4 : 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
@@ -465,6 +717,27 @@ public:
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
+			if (clusteredLighting) {
+				// Bin the lights into the clusters before the composition pass reads them
+				// The first barrier makes sure that the previous frame's composition has finished reading the cluster lists
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Light culling", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipeline);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipelineLayout, 0, 1, &lightCulling.descriptorSet, 0, nullptr);
+				// One work group per depth slice
+				vkCmdDispatch(drawCmdBuffers[i], 1, 1, CLUSTER_COUNT_Z);
+				gpuProfiler.endScope(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -474,12 +747,25 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			if (subpassGBuffer) {
+				// First subpass: Fill the G-Buffer
+				gpuProfiler.beginScope(drawCmdBuffers[i], "G-Buffer");
+				drawScene(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+
+				// Second subpass: Composition reading the G-Buffer as input attachments
+				vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, subpassComposition.pipelineLayout, 0, 1, &subpassComposition.descriptorSet, 0, nullptr);
+			} else {
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			}
 
    			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 			// Final composition as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Composition");
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -492,11 +778,13 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -514,20 +802,80 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// Binding 5 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			// Binding 6 : Light counts per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+			// Binding 7 : Light indices per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Light culling compute layout
+		setLayoutBindings = {
+			// Binding 0 : Uniform buffer (shared with the composition)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Light counts per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Light indices per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &lightCulling.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &lightCulling.pipelineLayout));
+
+		if (subpassGBuffer) {
+			// Subpass composition layout, same bindings as the deferred shading layout with input attachments for the G-Buffer
+			setLayoutBindings = {
+				// Binding 1 : Depth input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+				// Binding 2 : Normals (and specular) input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+				// Binding 3 : Albedo input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+				// Binding 4 : Fragment shader uniform buffer
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+				// Binding 5 : Lights
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+				// Binding 6 : Light counts per cluster
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+				// Binding 7 : Light indices per cluster
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+			};
+			descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &subpassComposition.descriptorSetLayout));
+			pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&subpassComposition.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &subpassComposition.pipelineLayout));
+		}
 	}
 
-	void setupDescriptorSet()
+	// Update the composition's G-Buffer descriptors, the attachments are recreated when the window is resized
+	void updateGBufferDescriptors()
 	{
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		if (subpassGBuffer) {
+			VkDescriptorImageInfo depthDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, offScreenFrameBuf.depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo normalDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, offScreenFrameBuf.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo albedoDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, offScreenFrameBuf.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 1 : Depth input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, &depthDescriptor),
+				// Binding 2 : Normals (and specular) input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2, &normalDescriptor),
+				// Binding 3 : Albedo input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3, &albedoDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			return;
+		}
 
 		// Image descriptors for the offscreen color attachments
 		VkDescriptorImageInfo texDescriptorPosition =
@@ -548,17 +896,57 @@ public:
 				offScreenFrameBuf.albedo.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-		// Deferred composition
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-		writeDescriptorSets = {
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 1 : Position texture target
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
 			// Binding 2 : Normals texture target
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
 			// Binding 3 : Albedo texture target
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void setupDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+
+		// Deferred composition
+		VkDescriptorSet compositionSet;
+		if (subpassGBuffer) {
+			VkDescriptorSetAllocateInfo subpassAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &subpassComposition.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &subpassAllocInfo, &subpassComposition.descriptorSet));
+			compositionSet = subpassComposition.descriptorSet;
+		} else {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			compositionSet = descriptorSet;
+		}
+		writeDescriptorSets = {
 			// Binding 4 : Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 5 : Lights
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.lights.descriptor),
+			// Binding 6 : Light counts per cluster
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &storageBuffers.lightGrid.descriptor),
+			// Binding 7 : Light indices per cluster
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &storageBuffers.lightIndices.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		updateGBufferDescriptors();
+
+		// Light culling
+		VkDescriptorSetAllocateInfo computeAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &computeAllocInfo, &lightCulling.descriptorSet));
+		writeDescriptorSets = {
+			// Binding 0 : Uniform buffer
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.composition.descriptor),
+			// Binding 1 : Lights
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.lights.descriptor),
+			// Binding 2 : Light counts per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.lightGrid.descriptor),
+			// Binding 3 : Light indices per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.lightIndices.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
@@ -616,11 +1004,21 @@ public:
 		// Final fullscreen composition pass pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferred/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (subpassGBuffer ? "deferred/deferred_subpass.frag.spv" : "deferred/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
+		if (subpassGBuffer) {
+			// The composition is the second subpass of the default render pass and doesn't use depth
+			pipelineCI.layout = subpassComposition.pipelineLayout;
+			pipelineCI.subpass = 1;
+			depthStencilState.depthTestEnable = VK_FALSE;
+			depthStencilState.depthWriteEnable = VK_FALSE;
+		}
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
+		pipelineCI.layout = pipelineLayout;
+		depthStencilState.depthTestEnable = VK_TRUE;
+		depthStencilState.depthWriteEnable = VK_TRUE;
 
 		// Vertex input state from glTF model for pipeline rendering models
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent});
@@ -628,10 +1026,11 @@ public:
 
 		// Offscreen pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferred/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + (subpassGBuffer ? "deferred/mrt_packed.frag.spv" : "deferred/mrt.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		// Separate render pass
-		pipelineCI.renderPass = offScreenFrameBuf.renderPass;
+		// Separate render pass, or the first subpass of the default render pass with the subpass G-Buffer
+		pipelineCI.renderPass = subpassGBuffer ? renderPass : offScreenFrameBuf.renderPass;
+		pipelineCI.subpass = 0;
 
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
@@ -642,10 +1041,46 @@ public:
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
 
-		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+		// The packed G-Buffer has no position attachment
+		colorBlendState.attachmentCount = subpassGBuffer ? 2 : static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		// Light culling compute pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(lightCulling.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/cluster.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &lightCulling.pipeline));
+	}
+
+	// Distance at which a light's attenuation falls below a visible threshold
+	// Used for binning the lights into the clusters and for windowing the attenuation, so both composition paths give the same result
+	float lightRange(const Light &light)
+	{
+		const float threshold = 0.02f;
+		const float intensity = light.radius * std::max(light.color.r, std::max(light.color.g, light.color.b));
+		return sqrt(std::max(intensity / threshold - 1.0f, 0.0f));
+	}
+
+	// Generate the lights that are added on top of the original scene's six lights
+	void generateLights()
+	{
+		lights.resize(MAX_LIGHT_COUNT);
+		lightAnimations.resize(MAX_LIGHT_COUNT);
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		for (uint32_t i = 6; i < MAX_LIGHT_COUNT; i++) {
+			LightAnimation &animation = lightAnimations[i];
+			animation.origin = glm::vec3(rndDist(rndEngine) * 24.0f - 12.0f, -0.1f - rndDist(rndEngine) * 2.4f, rndDist(rndEngine) * 24.0f - 12.0f);
+			animation.orbitRadius = 0.25f + rndDist(rndEngine);
+			animation.speed = rndDist(rndEngine) * 2.0f - 1.0f;
+			animation.phase = rndDist(rndEngine) * 360.0f;
+			Light &light = lights[i];
+			light.color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+			light.color /= std::max(light.color.r, std::max(light.color.g, std::max(light.color.b, 0.01f)));
+			light.radius = 0.04f + rndDist(rndEngine) * 0.08f;
+			light.position.w = lightRange(light);
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -665,9 +1100,30 @@ public:
 		    &uniformBuffers.composition,
 			sizeof(uboComposition)));
 
+		// Lights, sized for the maximum light count and updated by the host
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.lights,
+			MAX_LIGHT_COUNT * sizeof(Light)));
+
+		// Cluster light lists, only accessed by the GPU
+		const uint32_t clusterCount = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.lightGrid,
+			clusterCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.lightIndices,
+			clusterCount * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
+		VK_CHECK_RESULT(storageBuffers.lights.map());
 
 		// Setup instanced model positions
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -675,6 +1131,8 @@ public:
 		uboOffscreenVS.instancePos[2] = glm::vec4(4.0f, 0.0, -4.0f, 0.0f);
 
 		// Update
+		generateLights();
+		updateLights();
 		updateUniformBufferOffscreen();
 		updateUniformBufferComposition();
 	}
@@ -682,59 +1140,87 @@ public:
 	// Update matrices used for the offscreen rendering of the scene
 	void updateUniformBufferOffscreen()
 	{
+		waitForFramesInFlight();
 		uboOffscreenVS.projection = camera.matrices.perspective;
 		uboOffscreenVS.view = camera.matrices.view;
 		uboOffscreenVS.model = glm::mat4(1.0f);
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
-	// Update lights and parameters passed to the composition shaders
-	void updateUniformBufferComposition()
+	// Animate the lights and copy the ones in use to the light storage buffer
+	void updateLights()
 	{
+		waitForFramesInFlight();
 		// White
-		uboComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uboComposition.lights[0].color = glm::vec3(1.5f);
-		uboComposition.lights[0].radius = 15.0f * 0.25f;
+		lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		lights[0].color = glm::vec3(1.5f);
+		lights[0].radius = 15.0f * 0.25f;
 		// Red
-		uboComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].radius = 15.0f;
+		lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
+		lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
+		lights[1].radius = 15.0f;
 		// Blue
-		uboComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uboComposition.lights[2].radius = 5.0f;
+		lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
+		lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
+		lights[2].radius = 5.0f;
 		// Yellow
-		uboComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uboComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uboComposition.lights[3].radius = 2.0f;
+		lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
+		lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
+		lights[3].radius = 2.0f;
 		// Green
-		uboComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uboComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uboComposition.lights[4].radius = 5.0f;
+		lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
+		lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
+		lights[4].radius = 5.0f;
 		// Yellow
-		uboComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uboComposition.lights[5].radius = 25.0f;
+		lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+		lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
+		lights[5].radius = 25.0f;
+
+		lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
+		lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+
+		lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+
+		lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
+		lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+
+		lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
+		lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
 
-		uboComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-		uboComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+		lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
+		lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
 
-		uboComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-		uboComposition.lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		for (uint32_t i = 0; i < 6; i++) {
+			lights[i].position.w = lightRange(lights[i]);
+		}
 
-		uboComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-		uboComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+		for (uint32_t i = 6; i < static_cast<uint32_t>(lightCount); i++) {
+			const LightAnimation &animation = lightAnimations[i];
+			const float angle = glm::radians(360.0f * timer * animation.speed + animation.phase);
+			lights[i].position.x = animation.origin.x + sin(angle) * animation.orbitRadius;
+			lights[i].position.y = animation.origin.y;
+			lights[i].position.z = animation.origin.z + cos(angle) * animation.orbitRadius;
+		}
 
-		uboComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-		uboComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
+		memcpy(storageBuffers.lights.mapped, lights.data(), lightCount * sizeof(Light));
+	}
 
-		uboComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-		uboComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+	// Update the camera and parameters passed to the composition and light culling shaders
+	void updateUniformBufferComposition()
+	{
+		waitForFramesInFlight();
+		uboComposition.inverseProjection = glm::inverse(camera.matrices.perspective);
+		uboComposition.view = camera.matrices.view;
+		uboComposition.inverseView = glm::inverse(camera.matrices.view);
+		uboComposition.depthRange = glm::vec4(camera.getNearClip(), camera.getFarClip(), 0.0f, 0.0f);
 
 		// Current view position
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
+		uboComposition.lightCount = lightCount;
+		uboComposition.clustered = clusteredLighting ? 1 : 0;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
@@ -743,6 +1229,15 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (subpassGBuffer) {
+			// The G-Buffer is filled in the same command buffer and render pass as the composition
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			VulkanExampleBase::submitFrame();
+			return;
+		}
+
 		// The scene render command buffer has to wait for the offscreen
 		// rendering to be finished before we can use the framebuffer
 		// color image for sampling during final rendering
@@ -784,17 +1279,36 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		prepareOffscreenFramebuffer();
+		if (!subpassGBuffer) {
+			prepareOffscreenFramebuffer();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
-		buildDeferredCommandBuffer();
+		if (!subpassGBuffer) {
+			buildDeferredCommandBuffer();
+		}
 		prepared = true;
 	}
 
+	// The G-Buffer follows the window size
+	virtual void windowResized()
+	{
+		if (!subpassGBuffer) {
+			// With the subpass G-Buffer, the attachments have already been recreated along with the frame buffers
+			destroyGBuffer();
+			createGBuffer();
+			createOffscreenFramebuffer();
+			buildDeferredCommandBuffer();
+		}
+		updateGBufferDescriptors();
+		// The descriptor update invalidated the command buffers
+		buildCommandBuffers();
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
@@ -802,11 +1316,12 @@ public:
 		draw();
 		if (!paused)
 		{
-			updateUniformBufferComposition();
+			updateLights();
 		}
 		if (camera.updated)
 		{
 			updateUniformBufferOffscreen();	
+			updateUniformBufferComposition();
 		}
 	}
 
@@ -817,6 +1332,17 @@ public:
 			{
 				updateUniformBufferComposition();
 			}
+			if (overlay->sliderInt("Light count", &lightCount, 6, MAX_LIGHT_COUNT))
+			{
+				updateLights();
+				updateUniformBufferComposition();
+			}
+			if (overlay->checkBox("Clustered light culling", &clusteredLighting))
+			{
+				updateUniformBufferComposition();
+				buildCommandBuffers();
+			}
+			overlay->text("G-Buffer: %s (%dx%d)", subpassGBuffer ? "subpass, packed" : "separate pass", offScreenFrameBuf.width, offScreenFrameBuf.height);
 		}
 	}
 };
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Deferred shading with shadows from multiple light sources using geometry shader instancing
+* Vulkan Example - Deferred shading with shadows from multiple light sources using a cached shadow atlas
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -9,26 +9,21 @@
 #include "vulkanexamplebase.h"
 #include "VulkanFrameBuffer.hpp"
 #include "VulkanglTFModel.h"
+#include "shadowatlas.hpp"
+#include "frustum.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
-// Shadowmap properties
+// Shadow atlas properties, the shadow maps of all lights are tiles of one depth texture
 #if defined(__ANDROID__)
-#define SHADOWMAP_DIM 1024
+#define SHADOW_ATLAS_DIM 2048
 #else
-#define SHADOWMAP_DIM 2048
+#define SHADOW_ATLAS_DIM 4096
 #endif
 // 16 bits of depth is enough for such a small scene
 #define SHADOWMAP_FORMAT VK_FORMAT_D32_SFLOAT_S8_UINT
 
-#if defined(__ANDROID__)
-// Use max. screen dimension as deferred framebuffer size
-#define FB_DIM std::max(width,height)
-#else
-#define FB_DIM 2048
-#endif
-
 // Must match the LIGHT_COUNT define in the shadow and deferred shaders
 #define LIGHT_COUNT 3
 
@@ -37,6 +32,9 @@ class VulkanExample : public VulkanExampleBase
 public:
 	int32_t debugDisplayTarget = 0;
 	bool enableShadows = true;
+	// Render the G-Buffer and the composition as two subpasses of the default render pass (selected with --subpassgbuffer)
+	// The G-Buffer is then only read at the current fragment's location, so it can stay in tile memory on tile based GPUs and uses packed transient attachments
+	bool subpassGBuffer = false;
 
 	// Keep depth range as small as possible
 	// for better shadow map precision
@@ -48,6 +46,27 @@ public:
 	float depthBiasConstant = 1.25f;
 	float depthBiasSlope = 1.75f;
 
+	// Outer cone angle of the spot lights, must match the composition shaders
+	float lightConeAngle = 25.0f;
+
+	// Each light gets a tile of the shadow atlas sized by the screen coverage of the area it lights
+	// Tiles are only rendered again if their light moved or a dynamic shadow caster inside the light's frustum changed
+	vks::ShadowAtlas shadowAtlas;
+	bool cacheShadows = true;
+	// Lights whose tiles are rendered in the current frame
+	std::vector<uint32_t> shadowTileUpdates;
+	// Shadow casters inside each light's frustum
+	// The background is a static caster, the model instances are dynamic casters
+	struct ShadowCasters {
+		bool background = false;
+		std::vector<uint32_t> instances;
+	};
+	std::array<ShadowCasters, LIGHT_COUNT> shadowCasters;
+
+	// Move one of the model instances around, so the shadow tiles of the lights it passes need to be updated
+	bool animateModel = false;
+	glm::vec4 animatedModelCenter = glm::vec4(4.0f, 0.0f, -6.0f, 0.0f);
+
 	struct {
 		struct {
 			vks::Texture2D colorMap;
@@ -73,22 +92,26 @@ public:
 	} uboOffscreenVS;
 
 	// This UBO stores the shadow matrices for all of the light sources
-	// The matrices are indexed using geometry shader instancing
+	// The matrix is selected by the light index passed as a push constant
 	// The instancePos is used to place the models using instanced draws
 	struct {
 		glm::mat4 mvp[LIGHT_COUNT];
 		glm::vec4 instancePos[3];
-	} uboShadowGeometryShader;
+	} uboShadow;
 
 	struct Light {
 		glm::vec4 position;
 		glm::vec4 target;
 		glm::vec4 color;
 		glm::mat4 viewMatrix;
+		// Offset (xy) and scale (zw) of the light's tile in the shadow atlas, zero if the light has no shadow map
+		glm::vec4 shadowRect;
 	};
 
 	struct {
 		glm::vec4 viewPos;
+		// Used to reconstruct the world space position from depth with the subpass G-Buffer
+		glm::mat4 inverseViewProjection;
 		Light lights[LIGHT_COUNT];
 		uint32_t useShadows = 1;
 		int32_t debugDisplayTarget = 0;
@@ -97,7 +120,7 @@ public:
 	struct {
 		vks::Buffer offscreen;
 		vks::Buffer composition;
-		vks::Buffer shadowGeometryShader;
+		vks::Buffer shadow;
 	} uniformBuffers;
 
 	struct {
@@ -116,24 +139,27 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Composition reading the G-Buffer as input attachments in the second subpass
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	} subpassComposition;
+
 	struct
 	{
 		// Framebuffer resources for the deferred pass
+		// With the subpass G-Buffer, this only holds the attachments of the default render pass
 		vks::Framebuffer *deferred;
-		// Framebuffer resources for the shadow pass
+		// Framebuffer resources for the shadow atlas
 		vks::Framebuffer *shadow;
 	} frameBuffers;
 
-	struct {
-		VkCommandBuffer deferred = VK_NULL_HANDLE;
-	} commandBuffers;
-
-	// Semaphore used to synchronize between offscreen and final scene rendering
-	VkSemaphore offscreenSemaphore = VK_NULL_HANDLE;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Deferred shading with shadows";
+		// The G-Buffer attachments and the descriptors reading them are replaced in windowResized, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		camera.type = Camera::CameraType::firstperson;
 #if defined(__ANDROID__)
 		camera.movementSpeed = 2.5f;
@@ -147,6 +173,14 @@ public:
 		timerSpeed *= 0.25f;
 		paused = true;
 		settings.overlay = true;
+		// The command buffer is recorded each frame (see recordCommandBuffer), as the shadow atlas tiles to render change with the lights and the model
+		dynamicCommandBuffers = true;
+		subpassGBuffer = commandLineParser.isSet("subpassgbuffer");
+		if (subpassGBuffer) {
+			title += " (subpass G-Buffer)";
+			// The UI is drawn in the composition subpass
+			UIOverlay.subpass = 1;
+		}
 	}
 
 	~VulkanExample()
@@ -169,30 +203,24 @@ public:
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		vkDestroyPipelineLayout(device, subpassComposition.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, subpassComposition.descriptorSetLayout, nullptr);
+
 		// Uniform buffers
 		uniformBuffers.composition.destroy();
 		uniformBuffers.offscreen.destroy();
-		uniformBuffers.shadowGeometryShader.destroy();
+		uniformBuffers.shadow.destroy();
 
 		// Textures
 		textures.model.colorMap.destroy();
 		textures.model.normalMap.destroy();
 		textures.background.colorMap.destroy();
 		textures.background.normalMap.destroy();
-
-		vkDestroySemaphore(device, offscreenSemaphore, nullptr);
 	}
 
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
-		// Geometry shader support is required for writing to multiple shadow map layers in one single pass
-		if (deviceFeatures.geometryShader) {
-			enabledFeatures.geometryShader = VK_TRUE;
-		}
-		else {
-			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
-		}
 		// Enable anisotropic filtering if supported
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
@@ -209,49 +237,85 @@ public:
 		}
 	}
 
-	// Prepare a layered shadow map with each layer containing depth from a light's point of view
-	// The shadow mapping pass uses geometry shader instancing to output the scene from the different
-	// light sources' point of view to the layers of the depth attachment in one single pass
+	// Prepare the shadow atlas holding the depth maps of all lights in separate tiles
+	// Tiles that haven't changed are kept across frames, so the atlas is loaded instead of cleared and only the rendered tiles are cleared (see renderShadowPass)
 	void shadowSetup()
 	{
 		frameBuffers.shadow = new vks::Framebuffer(vulkanDevice);
 
-		frameBuffers.shadow->width = SHADOWMAP_DIM;
-		frameBuffers.shadow->height = SHADOWMAP_DIM;
+		frameBuffers.shadow->width = SHADOW_ATLAS_DIM;
+		frameBuffers.shadow->height = SHADOW_ATLAS_DIM;
 
-		// Create a layered depth attachment for rendering the depth maps from the lights' point of view
-		// Each layer corresponds to one of the lights
-		// The actual output to the separate layers is done in the geometry shader using shader instancing
-		// We will pass the matrices of the lights to the GS that selects the layer by the current invocation
 		vks::AttachmentCreateInfo attachmentInfo = {};
 		attachmentInfo.format = SHADOWMAP_FORMAT;
-		attachmentInfo.width = SHADOWMAP_DIM;
-		attachmentInfo.height = SHADOWMAP_DIM;
-		attachmentInfo.layerCount = LIGHT_COUNT;
+		attachmentInfo.width = SHADOW_ATLAS_DIM;
+		attachmentInfo.height = SHADOW_ATLAS_DIM;
+		attachmentInfo.layerCount = 1;
 		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		attachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 		frameBuffers.shadow->addAttachment(attachmentInfo);
 
+		// A loaded attachment starts in its final layout, so the atlas needs to be transitioned once before its first use
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(
+			layoutCmd,
+			frameBuffers.shadow->attachments[0].image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			frameBuffers.shadow->attachments[0].subresourceRange);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
 		// Create sampler to sample from to depth attachment
 		// Used to sample in the fragment shader for shadowed rendering
 		VK_CHECK_RESULT(frameBuffers.shadow->createSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
 
 		// Create default renderpass for the framebuffer
 		VK_CHECK_RESULT(frameBuffers.shadow->createRenderPass());
+
+		shadowAtlas = vks::ShadowAtlas(SHADOW_ATLAS_DIM, 128, SHADOW_ATLAS_DIM / 2);
 	}
 
 	// Prepare the framebuffer for offscreen rendering with multiple attachments used as render targets inside the fragment shaders
+	// The G-Buffer has the size of the window
 	void deferredSetup()
 	{
 		frameBuffers.deferred = new vks::Framebuffer(vulkanDevice);
 
-		frameBuffers.deferred->width = FB_DIM;
-		frameBuffers.deferred->height = FB_DIM;
+		frameBuffers.deferred->width = width;
+		frameBuffers.deferred->height = height;
 
-		// Four attachments (3 color, 1 depth)
 		vks::AttachmentCreateInfo attachmentInfo = {};
-		attachmentInfo.width = FB_DIM;
-		attachmentInfo.height = FB_DIM;
+		attachmentInfo.width = width;
+		attachmentInfo.height = height;
 		attachmentInfo.layerCount = 1;
+
+		if (subpassGBuffer) {
+			// Three packed attachments (2 color, 1 depth) that are only read as input attachments within the default render pass
+			// The position is reconstructed from depth in the composition
+			attachmentInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+			attachmentInfo.transient = true;
+
+			// Attachment 0: Octahedral encoded normals (rg) and specular (b)
+			attachmentInfo.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Attachment 1: Albedo (color), packed float format if it can be rendered to
+			attachmentInfo.format = VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, attachmentInfo.format, &formatProperties);
+			if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)) {
+				attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			}
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+
+			// Attachment 2: Depth
+			attachmentInfo.format = depthFormat;
+			attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+			return;
+		}
+
+		// Four attachments (3 color, 1 depth)
 		attachmentInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
 		// Color attachments
@@ -275,6 +339,8 @@ public:
 
 		attachmentInfo.format = attDepthFormat;
 		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		// Depth is only used while filling the G-Buffer, so it can stay in tile memory on tile based GPUs
+		attachmentInfo.transient = true;
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
 		// Create sampler to sample from the color attachments
@@ -284,106 +350,225 @@ public:
 		VK_CHECK_RESULT(frameBuffers.deferred->createRenderPass());
 	}
 
-	// Put render commands for the scene into the given command buffer
-	void renderScene(VkCommandBuffer cmdBuffer, bool shadow)
+	// Override render pass setup from base class for the subpass G-Buffer
+	void setupRenderPass()
 	{
-		VkDeviceSize offsets[1] = { 0 };
+		if (!subpassGBuffer) {
+			VulkanExampleBase::setupRenderPass();
+			return;
+		}
+
+		deferredSetup();
+
+		std::array<VkAttachmentDescription, 4> attachments{};
+		// Swap chain color attachment, written by the composition
+		attachments[0].format = swapChain.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// G-Buffer attachments (cleared and never stored), written in the first subpass and read in the second subpass
+		for (uint32_t i = 0; i < 3; i++) {
+			attachments[i + 1] = frameBuffers.deferred->attachments[i].description;
+		}
 
+		std::array<VkSubpassDescription, 2> subpassDescriptions{};
+
+		// First subpass: Fill the G-Buffer
+		VkAttachmentReference colorReferences[2];
+		colorReferences[0] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		colorReferences[1] = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[0].colorAttachmentCount = 2;
+		subpassDescriptions[0].pColorAttachments = colorReferences;
+		subpassDescriptions[0].pDepthStencilAttachment = &depthReference;
+
+		// Second subpass: Composition (and UI) reading the G-Buffer as input attachments
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference inputReferences[3];
+		inputReferences[0] = { 3, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		inputReferences[1] = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		inputReferences[2] = { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[1].colorAttachmentCount = 1;
+		subpassDescriptions[1].pColorAttachments = &colorReference;
+		subpassDescriptions[1].inputAttachmentCount = 3;
+		subpassDescriptions[1].pInputAttachments = inputReferences;
+
+		// Subpass dependencies for layout transitions
+		std::array<VkSubpassDependency, 3> dependencies;
+
+		// The G-Buffer attachments are shared by all frame buffers, so the previous frame needs to be done with them before they are cleared
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		// This dependency transitions the G-Buffer attachments to input attachments
+		// Each fragment only reads the G-Buffer at its own location, so the dependency is by region
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = 1;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[2].srcSubpass = 1;
+		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+		renderPassInfo.pSubpasses = subpassDescriptions.data();
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+	}
+
+	// Override frame buffer setup from base class for the subpass G-Buffer
+	void setupFrameBuffer()
+	{
+		if (!subpassGBuffer) {
+			VulkanExampleBase::setupFrameBuffer();
+			return;
+		}
+
+		// The G-Buffer follows the window size
+		if ((frameBuffers.deferred->width != width) || (frameBuffers.deferred->height != height)) {
+			delete frameBuffers.deferred;
+			deferredSetup();
+		}
+
+		VkImageView views[4];
+		// The G-Buffer attachments are the same for all frame buffers
+		for (uint32_t i = 0; i < 3; i++) {
+			views[i + 1] = frameBuffers.deferred->attachments[i].view;
+		}
+
+		VkFramebufferCreateInfo frameBufferCI{};
+		frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferCI.renderPass = renderPass;
+		frameBufferCI.attachmentCount = 4;
+		frameBufferCI.pAttachments = views;
+		frameBufferCI.width = width;
+		frameBufferCI.height = height;
+		frameBufferCI.layers = 1;
+
+		VulkanExampleBase::frameBuffers.resize(swapChain.imageCount);
+		for (uint32_t i = 0; i < VulkanExampleBase::frameBuffers.size(); i++) {
+			views[0] = swapChain.buffers[i].view;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCI, nullptr, &VulkanExampleBase::frameBuffers[i]));
+		}
+	}
+
+	// Put render commands for the scene into the given command buffer
+	void renderScene(VkCommandBuffer cmdBuffer)
+	{
 		// Background
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, shadow ? &descriptorSets.shadow : &descriptorSets.background, 0, NULL);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.background, 0, NULL);
+		models.background.bindBuffers(cmdBuffer);
 		models.background.draw(cmdBuffer);
 
 		// Objects
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, shadow ? &descriptorSets.shadow : &descriptorSets.model, 0, NULL);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, NULL);
 		models.model.bindBuffers(cmdBuffer);
 		vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
 	}
 
-	// Build a secondary command buffer for rendering the scene values to the offscreen frame buffer attachments
-	void buildDeferredCommandBuffer()
+	// Render the tiles of the shadow atlas that need to be updated from their lights' point of view
+	void renderShadowPass(VkCommandBuffer cmdBuffer)
 	{
-		if (commandBuffers.deferred == VK_NULL_HANDLE)
-		{
-			commandBuffers.deferred = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		if (shadowTileUpdates.empty()) {
+			return;
 		}
 
-		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
-
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		// The previous frame's composition has to be done reading the atlas before tiles are overwritten
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		std::array<VkClearValue, 4> clearValues = {};
-		VkViewport viewport;
-		VkRect2D scissor;
-
-		// First pass: Shadow map generation
-		// -------------------------------------------------------------------------------------------------------
-
-		clearValues[0].depthStencil = { 1.0f, 0 };
-
 		renderPassBeginInfo.renderPass = frameBuffers.shadow->renderPass;
 		renderPassBeginInfo.framebuffer = frameBuffers.shadow->framebuffer;
 		renderPassBeginInfo.renderArea.extent.width = frameBuffers.shadow->width;
 		renderPassBeginInfo.renderArea.extent.height = frameBuffers.shadow->height;
-		renderPassBeginInfo.clearValueCount = 1;
-		renderPassBeginInfo.pClearValues = clearValues.data();
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffers.deferred, &cmdBufInfo));
-
-		viewport = vks::initializers::viewport((float)frameBuffers.shadow->width, (float)frameBuffers.shadow->height, 0.0f, 1.0f);
-		vkCmdSetViewport(commandBuffers.deferred, 0, 1, &viewport);
 
-		scissor = vks::initializers::rect2D(frameBuffers.shadow->width, frameBuffers.shadow->height, 0, 0);
-		vkCmdSetScissor(commandBuffers.deferred, 0, 1, &scissor);
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.shadow, 0, NULL);
 
 		// Set depth bias (aka "Polygon offset")
 		vkCmdSetDepthBias(
-			commandBuffers.deferred,
+			cmdBuffer,
 			depthBiasConstant,
 			0.0f,
 			depthBiasSlope);
 
-		vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(commandBuffers.deferred, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
-		renderScene(commandBuffers.deferred, true);
-		vkCmdEndRenderPass(commandBuffers.deferred);
-
-		// Second pass: Deferred calculations
-		// -------------------------------------------------------------------------------------------------------
-
-		// Clear values for all attachments written in the fragment shader
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
-
-		renderPassBeginInfo.renderPass = frameBuffers.deferred->renderPass;
-		renderPassBeginInfo.framebuffer = frameBuffers.deferred->framebuffer;
-		renderPassBeginInfo.renderArea.extent.width = frameBuffers.deferred->width;
-		renderPassBeginInfo.renderArea.extent.height = frameBuffers.deferred->height;
-		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassBeginInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		viewport = vks::initializers::viewport((float)frameBuffers.deferred->width, (float)frameBuffers.deferred->height, 0.0f, 1.0f);
-		vkCmdSetViewport(commandBuffers.deferred, 0, 1, &viewport);
-
-		scissor = vks::initializers::rect2D(frameBuffers.deferred->width, frameBuffers.deferred->height, 0, 0);
-		vkCmdSetScissor(commandBuffers.deferred, 0, 1, &scissor);
+		for (uint32_t light : shadowTileUpdates) {
+			const vks::ShadowAtlas::Tile& tile = shadowAtlas.getTile(light);
+
+			VkViewport viewport = vks::initializers::viewport((float)tile.size, (float)tile.size, 0.0f, 1.0f);
+			viewport.x = (float)tile.x;
+			viewport.y = (float)tile.y;
+			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(tile.size, tile.size, tile.x, tile.y);
+			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+			// Only the light's tile is cleared, the other tiles keep their cached contents
+			VkClearAttachment clearAttachment{};
+			clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+			VkClearRect clearRect{};
+			clearRect.rect = scissor;
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+			vkCmdClearAttachments(cmdBuffer, 1, &clearAttachment, 1, &clearRect);
+
+			int32_t lightIndex = static_cast<int32_t>(light);
+			vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(int32_t), &lightIndex);
+
+			// Only the casters inside the light's frustum are drawn
+			const ShadowCasters& casters = shadowCasters[light];
+			if (casters.background) {
+				models.background.bindPositionBuffers(cmdBuffer);
+				models.background.draw(cmdBuffer);
+			}
+			if (!casters.instances.empty()) {
+				models.model.bindPositionBuffers(cmdBuffer);
+				for (uint32_t instance : casters.instances) {
+					vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 1, 0, 0, instance);
+				}
+			}
+		}
 
-		vkCmdBindPipeline(commandBuffers.deferred, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
-		renderScene(commandBuffers.deferred, false);
-		vkCmdEndRenderPass(commandBuffers.deferred);
+		vkCmdEndRenderPass(cmdBuffer);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffers.deferred));
+		// Make the rendered tiles visible to the composition
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PositionStream;
 		models.model.loadFromFile(getAssetPath() + "models/armor/armor.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		models.background.loadFromFile(getAssetPath() + "models/deferred_box.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		textures.model.colorMap.loadFromFile(getAssetPath() + "models/armor/colormap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
@@ -392,52 +577,101 @@ public:
 		textures.background.normalMap.loadFromFile(getAssetPath() + "textures/stonefloor02_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void buildCommandBuffers()
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		// First pass: Shadow atlas tiles that changed
+		gpuProfiler.beginScope(commandBuffer, "Shadow atlas");
+		renderShadowPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
+
+		// Second pass: Fill the G-Buffer (unless it's the first subpass of the default render pass)
+		if (!subpassGBuffer) {
+			std::array<VkClearValue, 4> clearValues = {};
+			clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[3].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = frameBuffers.deferred->renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers.deferred->framebuffer;
+			renderPassBeginInfo.renderArea.extent.width = frameBuffers.deferred->width;
+			renderPassBeginInfo.renderArea.extent.height = frameBuffers.deferred->height;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassBeginInfo.pClearValues = clearValues.data();
+
+			gpuProfiler.beginScope(commandBuffer, "G-Buffer");
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)frameBuffers.deferred->width, (float)frameBuffers.deferred->height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(frameBuffers.deferred->width, frameBuffers.deferred->height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			renderScene(commandBuffer);
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.endScope(commandBuffer);
+		}
 
-		VkClearValue clearValues[2];
+		// Composition
+		VkClearValue clearValues[4];
 		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
 		clearValues[1].depthStencil = { 1.0f, 0 };
+		if (subpassGBuffer) {
+			// The default render pass also contains the G-Buffer attachments
+			clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[3].depthStencil = { 1.0f, 0 };
+		}
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = renderPass;
-		renderPassBeginInfo.renderArea.offset.x = 0;
-		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[imageIndex];
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.clearValueCount = subpassGBuffer ? 4 : 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		gpuProfiler.beginScope(commandBuffer, "Composition");
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		if (subpassGBuffer) {
+			// First subpass: Fill the G-Buffer
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			renderScene(commandBuffer);
 
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			// Second subpass: Composition reading the G-Buffer as input attachments
+			vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, subpassComposition.pipelineLayout, 0, 1, &subpassComposition.descriptorSet, 0, nullptr);
+		} else {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		}
 
-			// Final composition as full screen quad
-			// Note: Also used for debug display if debugDisplayTarget > 0
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
-			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+		// Final composition as full screen quad
+		// Note: Also used for debug display if debugDisplayTarget > 0
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void setupDescriptorPool()
@@ -445,7 +679,8 @@ public:
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 12), //todo: separate set layouts
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -462,7 +697,7 @@ public:
 		// // Deferred shading layout
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			// Binding 1: Position texture
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			// Binding 2: Normals texture
@@ -475,17 +710,57 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Shared pipeline layout used by all pipelines
+		// The shadow pass selects the light whose atlas tile is rendered with a push constant
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(int32_t), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		if (subpassGBuffer) {
+			// Subpass composition layout, same bindings as the deferred shading layout with input attachments for the G-Buffer
+			setLayoutBindings = {
+				// Binding 1: Depth input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+				// Binding 2: Normals (and specular) input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+				// Binding 3: Albedo input attachment
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+				// Binding 4: Fragment shader uniform buffer
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+				// Binding 5: Shadow map
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			};
+			descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &subpassComposition.descriptorSetLayout));
+			pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&subpassComposition.descriptorSetLayout, 1);
+			pPipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+			pPipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &subpassComposition.pipelineLayout));
+		}
 	}
 
-	void setupDescriptorSet()
+	// Update the composition's G-Buffer descriptors, the attachments are recreated when the window is resized
+	void updateGBufferDescriptors()
 	{
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		if (subpassGBuffer) {
+			VkDescriptorImageInfo depthDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, frameBuffers.deferred->attachments[2].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo normalDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, frameBuffers.deferred->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo albedoDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, frameBuffers.deferred->attachments[1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 1: Depth input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, &depthDescriptor),
+				// Binding 2: Normals (and specular) input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2, &normalDescriptor),
+				// Binding 3: Albedo input attachment
+				vks::initializers::writeDescriptorSet(subpassComposition.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3, &albedoDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			return;
+		}
 
 		// Image descriptors for the offscreen color attachments
 		VkDescriptorImageInfo texDescriptorPosition =
@@ -506,6 +781,22 @@ public:
 				frameBuffers.deferred->attachments[2].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 1: World space position texture
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
+			// Binding 2: World space normals texture
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
+			// Binding 3: Albedo texture
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void setupDescriptorSet()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+
 		VkDescriptorImageInfo texDescriptorShadowMap =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.shadow->sampler,
@@ -513,20 +804,23 @@ public:
 				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
 		// Deferred composition
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorSet compositionSet;
+		if (subpassGBuffer) {
+			VkDescriptorSetAllocateInfo subpassAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &subpassComposition.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &subpassAllocInfo, &subpassComposition.descriptorSet));
+			compositionSet = subpassComposition.descriptorSet;
+		} else {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			compositionSet = descriptorSet;
+		}
 		writeDescriptorSets = {
-			// Binding 1: World space position texture
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
-			// Binding 2: World space normals texture
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
-			// Binding 3: Albedo texture
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
 			// Binding 4: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
 			// Binding 5: Shadow map
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &texDescriptorShadowMap),
+			vks::initializers::writeDescriptorSet(compositionSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &texDescriptorShadowMap),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		updateGBufferDescriptors();
 
 		// Offscreen (scene)
 
@@ -558,7 +852,7 @@ public:
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.shadow));
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.shadow, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.shadowGeometryShader.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.shadow, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.shadow.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
@@ -566,44 +860,45 @@ public:
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
-		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
-		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
 		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
 		std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
-		pipelineCI.pRasterizationState = &rasterizationState;
-		pipelineCI.pColorBlendState = &colorBlendState;
 		pipelineCI.pMultisampleState = &multisampleState;
 		pipelineCI.pViewportState = &viewportState;
-		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
-		pipelineCI.pStages = shaderStages.data();
+
+		// The three pipelines are compiled in parallel, so each of them gets its own copy of the state that differs
 
 		// Final fullscreen composition pass pipeline
-		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
-		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VkPipelineRasterizationStateCreateInfo deferredRasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		// The composition is the second subpass of the default render pass and doesn't use depth with the subpass G-Buffer
+		VkPipelineDepthStencilStateCreateInfo deferredDepthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(subpassGBuffer ? VK_FALSE : VK_TRUE, subpassGBuffer ? VK_FALSE : VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo deferredColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		std::array<VkPipelineShaderStageCreateInfo, 2> deferredShaderStages;
+		deferredShaderStages[0] = loadShader(getShadersPath() + "deferredshadows/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		deferredShaderStages[1] = loadShader(getShadersPath() + (subpassGBuffer ? "deferredshadows/deferred_subpass.frag.spv" : "deferredshadows/deferred.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
-		pipelineCI.pVertexInputState = &emptyInputState;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.deferred));
-
-		// Vertex input state from glTF model for pipeline rendering models
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
-		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+		VkGraphicsPipelineCreateInfo deferredCI = pipelineCI;
+		deferredCI.pRasterizationState = &deferredRasterizationState;
+		deferredCI.pDepthStencilState = &deferredDepthStencilState;
+		deferredCI.pColorBlendState = &deferredColorBlendState;
+		deferredCI.pVertexInputState = &emptyInputState;
+		deferredCI.stageCount = static_cast<uint32_t>(deferredShaderStages.size());
+		deferredCI.pStages = deferredShaderStages.data();
+		if (subpassGBuffer) {
+			deferredCI.layout = subpassComposition.pipelineLayout;
+			deferredCI.subpass = 1;
+		}
 
 		// Offscreen pipeline
-		// Separate render pass
-		pipelineCI.renderPass = frameBuffers.deferred->renderPass;
-
+		VkPipelineRasterizationStateCreateInfo offscreenRasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineDepthStencilStateCreateInfo offscreenDepthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
@@ -613,37 +908,47 @@ public:
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
-		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
-		colorBlendState.pAttachments = blendAttachmentStates.data();
-
-		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+		// The packed G-Buffer has no position attachment
+		VkPipelineColorBlendStateCreateInfo offscreenColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(subpassGBuffer ? 2 : static_cast<uint32_t>(blendAttachmentStates.size()), blendAttachmentStates.data());
+		std::array<VkPipelineShaderStageCreateInfo, 2> offscreenShaderStages;
+		offscreenShaderStages[0] = loadShader(getShadersPath() + "deferredshadows/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		offscreenShaderStages[1] = loadShader(getShadersPath() + (subpassGBuffer ? "deferredshadows/mrt_packed.frag.spv" : "deferredshadows/mrt.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
+		VkGraphicsPipelineCreateInfo offscreenCI = pipelineCI;
+		// Separate render pass, or the first subpass of the default render pass with the subpass G-Buffer
+		offscreenCI.renderPass = subpassGBuffer ? renderPass : frameBuffers.deferred->renderPass;
+		offscreenCI.pRasterizationState = &offscreenRasterizationState;
+		offscreenCI.pDepthStencilState = &offscreenDepthStencilState;
+		offscreenCI.pColorBlendState = &offscreenColorBlendState;
+		// Vertex input state from glTF model for pipeline rendering models
+		offscreenCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
+		offscreenCI.stageCount = static_cast<uint32_t>(offscreenShaderStages.size());
+		offscreenCI.pStages = offscreenShaderStages.data();
 
 		// Shadow mapping pipeline
-		// The shadow mapping pipeline uses geometry shader instancing (invocations layout modifier) to output
-		// shadow maps for multiple lights sources into the different shadow map layers in one single render pass
-		std::array<VkPipelineShaderStageCreateInfo, 2> shadowStages;
-		shadowStages[0] = loadShader(getShadersPath() + "deferredshadows/shadow.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shadowStages[1] = loadShader(getShadersPath() + "deferredshadows/shadow.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
-
-		pipelineCI.pStages = shadowStages.data();
-		pipelineCI.stageCount = static_cast<uint32_t>(shadowStages.size());
-
-		// Shadow pass doesn't use any color attachments
-		colorBlendState.attachmentCount = 0;
-		colorBlendState.pAttachments = nullptr;
+		// Each light's tile of the shadow atlas is rendered separately with its own viewport, the light's matrix is selected with a push constant
 		// Cull front faces
-		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
-		depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		VkPipelineRasterizationStateCreateInfo shadowRasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		// Enable depth bias
-		rasterizationState.depthBiasEnable = VK_TRUE;
+		shadowRasterizationState.depthBiasEnable = VK_TRUE;
+		VkPipelineDepthStencilStateCreateInfo shadowDepthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		// Shadow pass doesn't use any color attachments
+		VkPipelineColorBlendStateCreateInfo shadowColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(0, nullptr);
 		// Add depth bias to dynamic state, so we can change it at runtime
-		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
-		dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		// Reset blend attachment state
-		pipelineCI.renderPass = frameBuffers.shadow->renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.shadowpass));
+		std::vector<VkDynamicState> shadowDynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS};
+		VkPipelineDynamicStateCreateInfo shadowDynamicState = vks::initializers::pipelineDynamicStateCreateInfo(shadowDynamicStateEnables);
+		VkPipelineShaderStageCreateInfo shadowShaderStage = loadShader(getShadersPath() + "deferredshadows/shadow.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		VkGraphicsPipelineCreateInfo shadowCI = pipelineCI;
+		shadowCI.renderPass = frameBuffers.shadow->renderPass;
+		shadowCI.pRasterizationState = &shadowRasterizationState;
+		shadowCI.pDepthStencilState = &shadowDepthStencilState;
+		shadowCI.pColorBlendState = &shadowColorBlendState;
+		shadowCI.pDynamicState = &shadowDynamicState;
+		// Only positions are fetched from a separate, tightly packed vertex buffer
+		shadowCI.pVertexInputState = vkglTF::Vertex::getPositionVertexInputState();
+		shadowCI.stageCount = 1;
+		shadowCI.pStages = &shadowShaderStage;
+
+		pipelineCompiler.createGraphicsPipelines({ deferredCI, offscreenCI, shadowCI }, { &pipelines.deferred, &pipelines.offscreen, &pipelines.shadowpass });
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -667,13 +972,13 @@ public:
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.shadowGeometryShader,
-			sizeof(uboShadowGeometryShader)));
+			&uniformBuffers.shadow,
+			sizeof(uboShadow)));
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
-		VK_CHECK_RESULT(uniformBuffers.shadowGeometryShader.map());
+		VK_CHECK_RESULT(uniformBuffers.shadow.map());
 
 		// Init some values
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -681,18 +986,23 @@ public:
 		uboOffscreenVS.instancePos[2] = glm::vec4(4.0f, 0.0, -4.0f, 0.0f);
 
 		uboOffscreenVS.instancePos[1] = glm::vec4(-7.0f, 0.0, -4.0f, 0.0f);
-		uboOffscreenVS.instancePos[2] = glm::vec4(4.0f, 0.0, -6.0f, 0.0f);
+		uboOffscreenVS.instancePos[2] = animatedModelCenter;
 
 		// Update
 		updateUniformBufferOffscreen();
+		updateShadowAtlas();
 		updateUniformBufferDeferredLights();
 	}
 
 	void updateUniformBufferOffscreen()
 	{
+		waitForFramesInFlight();
 		uboOffscreenVS.projection = camera.matrices.perspective;
 		uboOffscreenVS.view = camera.matrices.view;
 		uboOffscreenVS.model = glm::mat4(1.0f);
+		if (animateModel) {
+			uboOffscreenVS.instancePos[2] = animatedModelCenter + glm::vec4(sin(glm::radians(timer * 360.0f)) * 2.0f, 0.0f, cos(glm::radians(timer * 360.0f)) * 2.0f, 0.0f);
+		}
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
@@ -712,10 +1022,33 @@ public:
 		uboComposition.lights[2] = initLight(glm::vec3(0.0f, -10.0f, 4.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
 	}
 
-	// Update fragment shader light position uniform block
-	void updateUniformBufferDeferredLights()
+	// Size of a light's tile in the shadow atlas from the screen coverage of the area it lights
+	uint32_t getShadowTileSize(const Light& light)
 	{
-		// Animate
+		// Bounding sphere of the light's cone at its target
+		const glm::vec3 target = glm::vec3(light.target);
+		const float radius = glm::length(glm::vec3(light.position) - target) * tan(glm::radians(lightConeAngle));
+		const glm::mat4 viewProjection = camera.matrices.perspective * camera.matrices.view;
+		vks::Frustum frustum;
+		frustum.update(viewProjection);
+		if (!frustum.checkSphere(target, radius)) {
+			// Lights outside of the view still get a small tile, as their cone may reach into it
+			return shadowAtlas.minTileSize;
+		}
+		const float w = (viewProjection * glm::vec4(target, 1.0f)).w;
+		if (w <= radius) {
+			// The camera is inside (or close to) the lit area
+			return shadowAtlas.maxTileSize;
+		}
+		// Projected diameter relative to the viewport height
+		const float coverage = radius * std::abs(camera.matrices.perspective[1][1]) / w;
+		return shadowAtlas.getTileSize(coverage, (float)height);
+	}
+
+	// Animate the lights, (re)allocate their atlas tiles, cull the shadow casters and select the tiles that need to be rendered this frame
+	void updateShadowAtlas()
+	{
+		waitForFramesInFlight();
 		uboComposition.lights[0].position.x = -14.0f + std::abs(sin(glm::radians(timer * 360.0f)) * 20.0f);
 		uboComposition.lights[0].position.z = 15.0f + cos(glm::radians(timer *360.0f)) * 1.0f;
 
@@ -725,63 +1058,78 @@ public:
 		uboComposition.lights[2].position.x = 0.0f + sin(glm::radians(timer *360.0f)) * 4.0f;
 		uboComposition.lights[2].position.z = 4.0f + cos(glm::radians(timer *360.0f)) * 2.0f;
 
+		std::vector<uint32_t> tileSizes(LIGHT_COUNT);
+		std::vector<glm::mat4> matrices(LIGHT_COUNT);
+		std::vector<uint64_t> signatures(LIGHT_COUNT);
 		for (uint32_t i = 0; i < LIGHT_COUNT; i++)
 		{
+			const Light& light = uboComposition.lights[i];
+			tileSizes[i] = getShadowTileSize(light);
+
 			// mvp from light's pov (for shadows)
 			glm::mat4 shadowProj = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, zFar);
-			glm::mat4 shadowView = glm::lookAt(glm::vec3(uboComposition.lights[i].position), glm::vec3(uboComposition.lights[i].target), glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::mat4 shadowModel = glm::mat4(1.0f);
-
-			uboShadowGeometryShader.mvp[i] = shadowProj * shadowView * shadowModel;
-			uboComposition.lights[i].viewMatrix = uboShadowGeometryShader.mvp[i];
+			glm::mat4 shadowView = glm::lookAt(glm::vec3(light.position), glm::vec3(light.target), glm::vec3(0.0f, 1.0f, 0.0f));
+			matrices[i] = shadowProj * shadowView;
+
+			// Cull the shadow casters against the light's frustum
+			vks::Frustum frustum;
+			frustum.update(matrices[i]);
+			ShadowCasters& casters = shadowCasters[i];
+			casters.background = frustum.checkSphere(models.background.dimensions.center, models.background.dimensions.radius);
+			casters.instances.clear();
+			// The signature changes if a dynamic caster enters, leaves or moves inside the light's frustum (FNV-1a over the visible instances)
+			uint64_t signature = 14695981039346656037ull;
+			for (uint32_t instance = 0; instance < 3; instance++) {
+				const glm::vec4 instancePos = uboOffscreenVS.instancePos[instance];
+				if (!frustum.checkSphere(models.model.dimensions.center + glm::vec3(instancePos), models.model.dimensions.radius)) {
+					continue;
+				}
+				casters.instances.push_back(instance);
+				const float values[4] = { (float)instance, instancePos.x, instancePos.y, instancePos.z };
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+				for (size_t j = 0; j < sizeof(values); j++) {
+					signature = (signature ^ bytes[j]) * 1099511628211ull;
+				}
+			}
+			signatures[i] = signature;
 		}
 
-		memcpy(uboShadowGeometryShader.instancePos, uboOffscreenVS.instancePos, sizeof(uboOffscreenVS.instancePos));
-		memcpy(uniformBuffers.shadowGeometryShader.mapped, &uboShadowGeometryShader, sizeof(uboShadowGeometryShader));
+		if (!cacheShadows) {
+			shadowAtlas.invalidate();
+		}
+		shadowAtlas.allocate(tileSizes);
+		shadowTileUpdates = shadowAtlas.update(matrices, signatures);
 
-		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
-		uboComposition.debugDisplayTarget = debugDisplayTarget;
+		// The matrices the tiles have been rendered with are used for both the shadow pass and the composition
+		for (uint32_t i = 0; i < LIGHT_COUNT; i++)
+		{
+			uboShadow.mvp[i] = shadowAtlas.getTile(i).matrix;
+			uboComposition.lights[i].viewMatrix = uboShadow.mvp[i];
+			uboComposition.lights[i].shadowRect = shadowAtlas.getRect(i);
+		}
 
-		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
+		memcpy(uboShadow.instancePos, uboOffscreenVS.instancePos, sizeof(uboOffscreenVS.instancePos));
+		memcpy(uniformBuffers.shadow.mapped, &uboShadow, sizeof(uboShadow));
 	}
 
-	void draw()
+	// Update fragment shader light position uniform block
+	void updateUniformBufferDeferredLights()
 	{
-		VulkanExampleBase::prepareFrame();
-
-		// Offscreen rendering
-
-		// Wait for swap chain presentation to finish
-		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-		// Signal ready with offscreen semaphore
-		submitInfo.pSignalSemaphores = &offscreenSemaphore;
-
-		// Submit work
-
-		// Shadow map pass
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers.deferred;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		// Scene rendering
-
-		// Wait for offscreen semaphore
-		submitInfo.pWaitSemaphores = &offscreenSemaphore;
-		// Signal ready with render complete semaphore
-		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
-
-		// Submit work
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		waitForFramesInFlight();
+		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
+		uboComposition.inverseViewProjection = glm::inverse(camera.matrices.perspective * camera.matrices.view);
+		uboComposition.debugDisplayTarget = debugDisplayTarget;
 
-		VulkanExampleBase::submitFrame();
+		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		deferredSetup();
+		if (!subpassGBuffer) {
+			deferredSetup();
+		}
 		shadowSetup();
 		initLights();
 		prepareUniformBuffers();
@@ -789,21 +1137,32 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
-		buildCommandBuffers();
-		buildDeferredCommandBuffer();
 		prepared = true;
 	}
 
+	// The G-Buffer follows the window size
+	virtual void windowResized()
+	{
+		if (!subpassGBuffer) {
+			// With the subpass G-Buffer, the attachments have already been recreated along with the frame buffers
+			delete frameBuffers.deferred;
+			deferredSetup();
+		}
+		updateGBufferDescriptors();
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
 			return;
-		draw();
-		updateUniformBufferDeferredLights();
-		if (camera.updated) 
+		// The lights and the model are updated before the frame is recorded, as they decide which shadow atlas tiles need to be rendered
+		if (camera.updated || (animateModel && !paused))
 		{
 			updateUniformBufferOffscreen();
 		}
+		updateShadowAtlas();
+		updateUniformBufferDeferredLights();
+		renderFrame();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -818,6 +1177,18 @@ public:
 				uboComposition.useShadows = shadows;
 				updateUniformBufferDeferredLights();
 			}
+			overlay->text("G-Buffer: %s (%dx%d)", subpassGBuffer ? "subpass, packed" : "separate pass", frameBuffers.deferred->width, frameBuffers.deferred->height);
+		}
+		if (overlay->header("Shadow atlas")) {
+			overlay->checkBox("Cache shadows", &cacheShadows);
+			if (overlay->checkBox("Animate model", &animateModel) && !animateModel) {
+				uboOffscreenVS.instancePos[2] = animatedModelCenter;
+				updateUniformBufferOffscreen();
+			}
+			for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+				overlay->text("Light %d: %dx%d tile", i, shadowAtlas.getTile(i).size, shadowAtlas.getTile(i).size);
+			}
+			overlay->text("Tiles rendered: %d / %d", (int32_t)shadowTileUpdates.size(), LIGHT_COUNT);
 		}
 	}
 };
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Displacement mapping with tessellation shaders
 *
+* The tessellation control shader can derive the tessellation factors from the projected length of the patch edges and cull patches
+* that are outside of the view frustum or face away, the saved work shows up in the tessellation pipeline statistics
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +11,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanQueryManager.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +25,7 @@ private:
 public:
 	bool splitScreen = true;
 	bool displacement = true;
+	bool adaptiveTessellation = true;
 
 	vkglTF::Model plane;
 
@@ -28,7 +34,17 @@ public:
 	} uniformBuffers;
 
 	struct UBOTessControl {
+		glm::mat4 projection;
+		glm::mat4 modelView;
+		glm::vec4 frustumPlanes[6];
+		glm::vec2 viewportDim;
+		// Uniform level, or maximum level of the screen space adaptive factors
 		float tessLevel = 64.0f;
+		// Target length of a tessellated edge in pixels
+		float tessellatedEdgeSize = 8.0f;
+		// Maximum displacement along the normal, extends the bounds used for culling
+		float displacementFactor;
+		uint32_t adaptive;
 	} uboTessControl;
 
 	struct UBOTessEval {
@@ -48,6 +64,11 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Pipeline statistics of the solid draw, with one query slot per command buffer
+	vks::QueryManager queries;
+	// Tessellation control shader patches and tessellation evaluation shader invocations
+	uint64_t pipelineStats[2] = { 0 };
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Tessellation shader displacement";
@@ -56,6 +77,10 @@ public:
 		camera.setRotation(glm::vec3(-20.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("adaptivetessellation", { "-at", "--adaptivetessellation" }, 1, "Screen space adaptive tessellation factors with patch culling (0 = off, 1 = on)");
+		exampleArgs.parse(args);
+		adaptiveTessellation = exampleArgs.getValueAsInt("adaptivetessellation", 1) != 0;
 	}
 
 	~VulkanExample()
@@ -73,6 +98,7 @@ public:
 		uniformBuffers.tessControl.destroy();
 		uniformBuffers.tessEval.destroy();
 		textures.colorHeightMap.destroy();
+		queries.destroy();
 	}
 
 	// Enable physical device features required for this example
@@ -92,6 +118,16 @@ public:
 		else {
 			splitScreen = false;
 		}
+		// Pipeline statistics
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
+	// Setup the pipeline statistics query, its results are copied to host visible buffers by the command buffers
+	void setupQueryResultBuffer()
+	{
+		queries.setup(vulkanDevice, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT | VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT);
 	}
 
 	void loadAssets()
@@ -125,6 +161,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.reset(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -148,12 +188,22 @@ public:
 			}
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.beginQuery(drawCmdBuffers[i], i, 0);
+			}
 			plane.draw(drawCmdBuffers[i]);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.endQuery(drawCmdBuffers[i], i, 0);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.copyResults(drawCmdBuffers[i], i);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -194,14 +244,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -295,12 +345,12 @@ public:
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 
 		// Solid pipeline
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
 		if (deviceFeatures.fillModeNonSolid) {
 			// Wireframe pipeline
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
 			rasterizationState.cullMode = VK_CULL_MODE_NONE;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 		}
 	}
 
@@ -330,12 +380,22 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboTessEval.projection = camera.matrices.perspective;
 		uboTessEval.modelView = camera.matrices.view;
 		uboTessEval.lightPos.y = -0.5f - uboTessEval.tessStrength;
 		memcpy(uniformBuffers.tessEval.mapped, &uboTessEval, sizeof(uboTessEval));
 
 		// Tessellation control
+		uboTessControl.projection = camera.matrices.perspective;
+		uboTessControl.modelView = camera.matrices.view;
+		vks::Frustum frustum;
+		frustum.update(uboTessControl.projection * uboTessControl.modelView);
+		memcpy(uboTessControl.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		// Split screen only changes the scissor, both halves use the full viewport
+		uboTessControl.viewportDim = glm::vec2((float)width, (float)height);
+		uboTessControl.displacementFactor = uboTessEval.tessStrength;
+		uboTessControl.adaptive = adaptiveTessellation ? 1 : 0;
 		float savedLevel = uboTessControl.tessLevel;
 		if (!displacement)
 		{
@@ -354,6 +414,15 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Read the query results of this command buffer's last submission before it's submitted again
+			queries.collect(currentBuffer, pipelineStats);
+			if (benchmark.active) {
+				benchmark.addMetric("tcpatches", static_cast<double>(pipelineStats[0]));
+				benchmark.addMetric("teinvocations", static_cast<double>(pipelineStats[1]));
+			}
+		}
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -368,6 +437,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			setupQueryResultBuffer();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -395,9 +467,18 @@ public:
 			if (overlay->inputFloat("Strength", &uboTessEval.tessStrength, 0.025f, 3)) {
 				updateUniformBuffers();
 			}
-			if (overlay->inputFloat("Level", &uboTessControl.tessLevel, 0.5f, 2)) {
+			if (overlay->inputFloat(adaptiveTessellation ? "Max. level" : "Level", &uboTessControl.tessLevel, 0.5f, 2)) {
 				updateUniformBuffers();
 			}
+			if (overlay->checkBox("Adaptive tessellation", &adaptiveTessellation)) {
+				updateUniformBuffers();
+			}
+			if (adaptiveTessellation) {
+				if (overlay->inputFloat("Edge size (px)", &uboTessControl.tessellatedEdgeSize, 1.0f, 1)) {
+					uboTessControl.tessellatedEdgeSize = std::max(uboTessControl.tessellatedEdgeSize, 1.0f);
+					updateUniformBuffers();
+				}
+			}
 			if (deviceFeatures.fillModeNonSolid) {
 				if (overlay->checkBox("Splitscreen", &splitScreen)) {
 					buildCommandBuffers();
@@ -406,6 +487,17 @@ public:
 			}
 
 		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			if (overlay->header("Pipeline statistics")) {
+				overlay->text("TC patches: %d", static_cast<int>(pipelineStats[0]));
+				overlay->text("TE invocations: %d", static_cast<int>(pipelineStats[1]));
+			}
+		}
+	}
+
+	virtual void windowResized()
+	{
+		updateUniformBuffers();
 	}
 };
 
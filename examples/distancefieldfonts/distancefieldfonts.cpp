@@ -2,6 +2,7 @@
 * Vulkan Example - Font rendering using signed distance fields
 *
 * Font generated using https://github.com/libgdx/libgdx/wiki/Hiero
+* The multi-channel distance field font is generated at startup from a TrueType font with a compute shader (see vks::FontGenerator)
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -9,6 +10,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanFontGenerator.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -19,38 +21,19 @@ struct Vertex {
 	float uv[2];
 };
 
-// AngelCode .fnt format structs and classes
-struct bmchar {
-	uint32_t x, y;
-	uint32_t width;
-	uint32_t height;
-	int32_t xoffset;
-	int32_t yoffset;
-	int32_t xadvance;
-	uint32_t page;
-};
-
-// Quick and dirty : complete ASCII table
-// Only chars present in the .fnt are filled with data!
-std::array<bmchar, 255> fontChars;
-
-int32_t nextValuePair(std::stringstream *stream)
-{
-	std::string pair;
-	*stream >> pair;
-	uint32_t spos = pair.find("=");
-	std::string value = pair.substr(spos + 1);
-	int32_t val = std::stoi(value);
-	return val;
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool splitScreen = true;
+	bool multiChannel = true;
+
+	// Glyph metrics and the signed distance field atlas
+	vks::Font font;
+	// Multi-channel signed distance field font generated from glyph outlines
+	vks::Font msdfFont;
+	vks::FontGenerator fontGenerator;
 
 	struct {
-		vks::Texture2D fontSDF;
 		vks::Texture2D fontBitmap;
 	} textures;
 
@@ -60,9 +43,16 @@ public:
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 	} vertices;
 
-	vks::Buffer vertexBuffer;
-	vks::Buffer indexBuffer;
-	uint32_t indexCount;
+	// The fonts have different atlas layouts, so each one has its own text mesh
+	struct TextMesh {
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		uint32_t indexCount;
+	};
+	struct {
+		TextMesh sdf;
+		TextMesh msdf;
+	} textMeshes;
 
 	struct {
 		vks::Buffer vs;
@@ -78,15 +68,18 @@ public:
 		glm::vec4 outlineColor = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
 		float outlineWidth = 0.6f;
 		float outline = true;
+		float distanceRange;
 	} uboFS;
 
 	struct {
 		VkPipeline sdf;
+		VkPipeline msdf;
 		VkPipeline bitmap;
 	} pipelines;
 
 	struct {
 		VkDescriptorSet sdf;
+		VkDescriptorSet msdf;
 		VkDescriptorSet bitmap;
 	} descriptorSets;
 
@@ -109,83 +102,41 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 
 		// Clean up texture resources
-		textures.fontSDF.destroy();
+		font.destroy();
+		msdfFont.destroy();
 		textures.fontBitmap.destroy();
+		fontGenerator.destroy();
 
 		vkDestroyPipeline(device, pipelines.sdf, nullptr);
+		vkDestroyPipeline(device, pipelines.msdf, nullptr);
 		vkDestroyPipeline(device, pipelines.bitmap, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (TextMesh* textMesh : { &textMeshes.sdf, &textMeshes.msdf }) {
+			textMesh->vertexBuffer.destroy();
+			textMesh->indexBuffer.destroy();
+		}
 
 		uniformBuffers.vs.destroy();
 		uniformBuffers.fs.destroy();
 	}
 
-	// Basic parser for AngelCode bitmap font format files
-	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
-	void parsebmFont()
+	void loadAssets()
 	{
-		std::string fileName = getAssetPath() + "font.fnt";
-
-#if defined(__ANDROID__)
-		// Font description file is stored inside the apk
-		// So we need to load it using the asset manager
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-
-		assert(size > 0);
-
-		void *fileData = malloc(size);
-		AAsset_read(asset, fileData, size);
-		AAsset_close(asset);
-
-		std::stringbuf sbuf((const char*)fileData);
-		std::istream istream(&sbuf);
-#else
-		std::filebuf fileBuffer;
-		fileBuffer.open(fileName, std::ios::in);
-		std::istream istream(&fileBuffer);
-#endif
-
-		assert(istream.good());
-
-		while (!istream.eof())
-		{
-			std::string line;
-			std::stringstream lineStream;
-			std::getline(istream, line);
-			lineStream << line;
-
-			std::string info;
-			lineStream >> info;
-
-			if (info == "char")
-			{
-				// char id
-				uint32_t charid = nextValuePair(&lineStream);
-				// Char properties
-				fontChars[charid].x = nextValuePair(&lineStream);
-				fontChars[charid].y = nextValuePair(&lineStream);
-				fontChars[charid].width = nextValuePair(&lineStream);
-				fontChars[charid].height = nextValuePair(&lineStream);
-				fontChars[charid].xoffset = nextValuePair(&lineStream);
-				fontChars[charid].yoffset = nextValuePair(&lineStream);
-				fontChars[charid].xadvance = nextValuePair(&lineStream);
-				fontChars[charid].page = nextValuePair(&lineStream);
-			}
-		}
-
+		font.loadFromFile(getAssetPath() + "font.fnt", getAssetPath() + "textures/font_sdf_rgba.ktx", vulkanDevice, queue);
+		textures.fontBitmap.loadFromFile(getAssetPath() + "textures/font_bitmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
-	void loadAssets()
+	// Generates the multi-channel distance field atlas and glyph metrics from the outlines of a TrueType font
+	void generateFont()
 	{
-		textures.fontSDF.loadFromFile(getAssetPath() + "textures/font_sdf_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-		textures.fontBitmap.loadFromFile(getAssetPath() + "textures/font_bitmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		fontGenerator.prepare(vulkanDevice, loadShader(getShadersPath() + "base/msdfgen.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache);
+		if (!fontGenerator.generate(msdfFont, getAssetPath() + "Roboto-Medium.ttf", 32.0f, 4.0f, queue)) {
+			vks::tools::exitFatal("Could not generate the multi-channel distance field font", -1);
+		}
+		uboFS.distanceRange = msdfFont.distanceRange;
 	}
 
 	void buildCommandBuffers()
@@ -221,21 +172,24 @@ public:
 
 			VkDeviceSize offsets[1] = { 0 };
 
-			// Signed distance field font
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdf, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sdf);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+			// Signed distance field font, either the generated multi-channel one or the prebaked single channel one
+			const TextMesh& textMesh = multiChannel ? textMeshes.msdf : textMeshes.sdf;
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, multiChannel ? &descriptorSets.msdf : &descriptorSets.sdf, 0, NULL);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, multiChannel ? pipelines.msdf : pipelines.sdf);
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &textMesh.vertexBuffer.buffer, offsets);
+			vkCmdBindIndexBuffer(drawCmdBuffers[i], textMesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexed(drawCmdBuffers[i], textMesh.indexCount, 1, 0, 0, 0);
 
-			// Linear filtered bitmap font
+			// Linear filtered bitmap font, shares the atlas layout with the single channel font
 			if (splitScreen)
 			{
 				viewport.y = (float)height / 2.0f;
 				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.bitmap, 0, NULL);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bitmap);
-				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &textMeshes.sdf.vertexBuffer.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], textMeshes.sdf.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(drawCmdBuffers[i], textMeshes.sdf.indexCount, 1, 0, 0, 0);
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -247,36 +201,36 @@ public:
 	}
 
 	// Creates a vertex buffer containing quads for the passed text
-	void generateText(std:: string text)
+	void generateText(std:: string text, const vks::Font& font, TextMesh& textMesh)
 	{
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
 		uint32_t indexOffset = 0;
 
-		float w = textures.fontSDF.width;
+		const float w = static_cast<float>(font.texture.width);
+		const float h = static_cast<float>(font.texture.height);
 
 		float posx = 0.0f;
 		float posy = 0.0f;
 
 		for (uint32_t i = 0; i < text.size(); i++)
 		{
-			bmchar *charInfo = &fontChars[(int)text[i]];
-
-			if (charInfo->width == 0)
-				charInfo->width = 36;
+			const vks::Font::Glyph* glyph = font.getGlyph(static_cast<uint8_t>(text[i]));
+			if (!glyph) {
+				continue;
+			}
 
-			float charw = ((float)(charInfo->width) / 36.0f);
-			float dimx = 1.0f * charw;
-			float charh = ((float)(charInfo->height) / 36.0f);
-			float dimy = 1.0f * charh;
+			// Glyph metrics are in pixels of the size the font has been generated with
+			float dimx = glyph->width / font.size;
+			float dimy = glyph->height / font.size;
 
-			float us = charInfo->x / w;
-			float ue = (charInfo->x + charInfo->width) / w;
-			float ts = charInfo->y / w;
-			float te = (charInfo->y + charInfo->height) / w;
+			float us = glyph->x / w;
+			float ue = (glyph->x + glyph->width) / w;
+			float ts = glyph->y / h;
+			float te = (glyph->y + glyph->height) / h;
 
-			float xo = charInfo->xoffset / 36.0f;
-			float yo = charInfo->yoffset / 36.0f;
+			float xo = glyph->xoffset / font.size;
+			float yo = glyph->yoffset / font.size;
 
 			posy = yo;
 
@@ -292,10 +246,10 @@ public:
 			}
 			indexOffset += 4;
 
-			float advance = ((float)(charInfo->xadvance) / 36.0f);
+			float advance = glyph->xadvance / font.size;
 			posx += advance;
 		}
-		indexCount = indices.size();
+		textMesh.indexCount = indices.size();
 
 		// Center
 		for (auto& v : vertices)
@@ -309,14 +263,14 @@ public:
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vertexBuffer,
+			&textMesh.vertexBuffer,
 			vertices.size() * sizeof(Vertex),
 			vertices.data()));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&indexBuffer,
+			&textMesh.indexBuffer,
 			indices.size() * sizeof(uint32_t),
 			indices.data()));
 	}
@@ -360,15 +314,15 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				3);
 
 		VkResult vkRes = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
 		assert(!vkRes);
@@ -400,14 +354,14 @@ public:
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -424,8 +378,8 @@ public:
 		// Image descriptor for the color map texture
 		VkDescriptorImageInfo texDescriptor =
 			vks::initializers::descriptorImageInfo(
-				textures.fontSDF.sampler,
-				textures.fontSDF.view,
+				font.texture.sampler,
+				font.texture.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
@@ -452,6 +406,33 @@ public:
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
+		// Multi-channel signed distance field font descriptor set
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.msdf));
+
+		writeDescriptorSets =
+		{
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.msdf,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				0,
+				&uniformBuffers.vs.descriptor),
+			// Binding 1 : Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.msdf,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				1,
+				&msdfFont.texture.descriptor),
+			// Binding 2 : Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.msdf,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				2,
+				&uniformBuffers.fs.descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
 		// Default font rendering descriptor set
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.bitmap));
 
@@ -559,12 +540,16 @@ public:
 		pipelineCreateInfo.stageCount = shaderStages.size();
 		pipelineCreateInfo.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.sdf));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.sdf));
+
+		// Multi-channel signed distance field font rendering pipeline
+		shaderStages[1] = loadShader(getShadersPath() + "distancefieldfonts/msdf.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.msdf));
 
 		// Default bitmap font rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "distancefieldfonts/bitmap.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "distancefieldfonts/bitmap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.bitmap));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.bitmap));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -594,6 +579,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
 		memcpy(uniformBuffers.vs.mapped, &uboVS, sizeof(uboVS));
@@ -601,6 +587,7 @@ public:
 
 	void updateFontSettings()
 	{
+		waitForFramesInFlight();
 		// Fragment shader
 		memcpy(uniformBuffers.fs.mapped, &uboFS, sizeof(uboFS));
 	}
@@ -622,9 +609,10 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		parsebmFont();
 		loadAssets();
-		generateText("Vulkan");
+		generateFont();
+		generateText("Vulkan", font, textMeshes.sdf);
+		generateText("Vulkan", msdfFont, textMeshes.msdf);
 		setupVertexDescriptions();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -655,12 +643,20 @@ public:
 				uboFS.outline = outline ? 1.0f : 0.0f;
 				updateFontSettings();
 			}
+			if (overlay->checkBox("Generated multi-channel font", &multiChannel)) {
+				buildCommandBuffers();
+			}
 			if (overlay->checkBox("Splitscreen", &splitScreen)) {
 				camera.setPerspective(splitScreen ? 30.0f : 45.0f, (float)width / (float)(height * ((splitScreen) ? 0.5f : 1.0f)), 1.0f, 256.0f);
 				buildCommandBuffers();
 				updateUniformBuffers();
 			}
 		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Prebaked atlas: %dx%d", font.texture.width, font.texture.height);
+			overlay->text("Generated atlas: %dx%d", msdfFont.texture.width, msdfFont.texture.height);
+			overlay->text("Generation time: %.2f ms", fontGenerator.generationTime);
+		}
 	}
 };
 
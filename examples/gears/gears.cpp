@@ -1,5 +1,10 @@
 /*
-* Vulkan Example - Animated gears using multiple uniform buffers
+* Vulkan Example - Animated gears drawn with GPU culled instanced indirect draws
+*
+* The geometry of each gear profile is generated once into a shared vertex and index buffer, the gears themselves are instances
+* stored in a storage buffer. A compute shader culls the instances against the view frustum and writes the indices of the visible
+* ones along with the instance counts of one indirect draw command per profile, so all gears are drawn with a single indirect draw
+* and the CPU only updates one uniform block per frame, regardless of the number of gears.
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -7,9 +12,11 @@
 */
 
 #include "vulkangear.h"
+#include "frustum.hpp"
 #include "vulkanexamplebase.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
 #define ENABLE_VALIDATION false
 
 class VulkanExample : public VulkanExampleBase
@@ -23,9 +30,38 @@ public:
 
 	struct {
 		VkPipeline solid;
+		VkPipeline cull;
 	} pipelines;
 
-	std::vector<VulkanGear*> gears;
+	// Gear profiles, all instances of a profile share its geometry
+	std::vector<VulkanGear> gears;
+	vks::Buffer vertexBuffer;
+	vks::Buffer indexBuffer;
+
+	// Copies of the classic three gear arrangement in a grid of gridSize * gridSize
+	int32_t gridSize = 1;
+	bool frustumCulling = true;
+	uint32_t instanceCount = 0;
+	// Instances, written once
+	vks::Buffer instanceBuffer;
+	// Indices of the visible instances, written by the culling shader (the range of each profile starts at its draw command's first instance)
+	// Bound as a per-instance vertex buffer, so the draw command's first instance is applied by the vertex input stage
+	vks::Buffer visibleInstanceBuffer;
+	// One indexed draw command per profile, the instance counts are written by the culling shader
+	vks::Buffer indirectCommandsBuffer;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec4 lightPos;
+		glm::vec4 frustumPlanes[6];
+		// Animation time in degrees
+		float time;
+		uint32_t instanceCount;
+	} uniformData;
+	// One uniform buffer per command buffer, so it can be updated once that command buffer has finished execution
+	std::vector<vks::Buffer> uniformBuffers;
+	std::vector<VkDescriptorSet> descriptorSets;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -46,13 +82,30 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
+		vkDestroyPipeline(device, pipelines.cull, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		for (auto& gear : gears)
-		{
-			delete(gear);
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+		instanceBuffer.destroy();
+		visibleInstanceBuffer.destroy();
+		indirectCommandsBuffer.destroy();
+		for (auto& uniformBuffer : uniformBuffers) {
+			uniformBuffer.destroy();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// The visible instances of each profile start at the draw command's first instance
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		// All profiles are drawn with a single indirect draw if multi draw indirect is available
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
 		}
 	}
 
@@ -73,12 +126,46 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		const uint32_t drawCount = static_cast<uint32_t>(gears.size());
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// Reset the instance counts, previous frames must be done reading the draw commands and visible instances
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			for (uint32_t j = 0; j < drawCount; j++) {
+				vkCmdFillBuffer(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * stride + offsetof(VkDrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), 0);
+			}
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.buffer = indirectCommandsBuffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+			// Cull the instances, previous frames must also be done reading the visible instances
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cull);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+			vkCmdDispatch(drawCmdBuffers[i], (instanceCount + 63) / 64, 1, 1);
+
+			std::array<VkBufferMemoryBarrier, 2> cullBarriers;
+			cullBarriers[0] = vks::initializers::bufferMemoryBarrier();
+			cullBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			cullBarriers[0].buffer = indirectCommandsBuffer.buffer;
+			cullBarriers[0].size = VK_WHOLE_SIZE;
+			cullBarriers[1] = vks::initializers::bufferMemoryBarrier();
+			cullBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			cullBarriers[1].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			cullBarriers[1].buffer = visibleInstanceBuffer.buffer;
+			cullBarriers[1].size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(), 0, nullptr);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -88,10 +175,19 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
-
-			for (auto& gear : gears)
-			{
-				gear->draw(drawCmdBuffers[i], pipelineLayout);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &visibleInstanceBuffer.buffer, offsets);
+			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+			if (vulkanDevice->enabledFeatures.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, drawCount, stride);
+			} else {
+				// Without multi draw indirect, each profile's draw command has to be issued separately
+				for (uint32_t j = 0; j < drawCount; j++) {
+					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * stride, 1, stride);
+				}
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -102,6 +198,20 @@ public:
 		}
 	}
 
+	// Upload data to a new device local buffer
+	void createDeviceBuffer(VkBufferUsageFlags usage, vks::Buffer* buffer, VkDeviceSize size, const void* data)
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, size));
+		vks::StagingRing::Allocation staging = vulkanDevice->stagingRing.allocate(size);
+		memcpy(staging.data, data, size);
+		VkCommandBuffer copyCmd = vulkanDevice->beginUpload();
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, staging.buffer, buffer->buffer, 1, &copyRegion);
+		vulkanDevice->endUpload(copyCmd, queue);
+	}
+
 	void prepareVertices()
 	{
 		// Gear definitions
@@ -110,20 +220,10 @@ public:
 		std::vector<float> widths = { 1.0f, 2.0f, 0.5f };
 		std::vector<int32_t> toothCount = { 20, 10, 10 };
 		std::vector<float> toothDepth = { 0.7f, 0.7f, 0.7f };
-		std::vector<glm::vec3> colors = {
-			glm::vec3(1.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 1.0f, 0.2f),
-			glm::vec3(0.0f, 0.0f, 1.0f)
-		};
-		std::vector<glm::vec3> positions = {
-			glm::vec3(-3.0, 0.0, 0.0),
-			glm::vec3(3.1, 0.0, 0.0),
-			glm::vec3(-3.1, -6.2, 0.0)
-		};
-		std::vector<float> rotationSpeeds = { 1.0f, -2.0f, -2.0f };
-		std::vector<float> rotationOffsets = { 0.0f, -9.0f, -30.0f };
 
-		gears.resize(positions.size());
+		std::vector<Vertex> vBuffer;
+		std::vector<uint32_t> iBuffer;
+		gears.resize(innerRadiuses.size());
 		for (int32_t i = 0; i < gears.size(); ++i)
 		{
 			GearInfo gearInfo = {};
@@ -132,22 +232,23 @@ public:
 			gearInfo.width = widths[i];
 			gearInfo.numTeeth = toothCount[i];
 			gearInfo.toothDepth = toothDepth[i];
-			gearInfo.color = colors[i];
-			gearInfo.pos = positions[i];
-			gearInfo.rotSpeed = rotationSpeeds[i];
-			gearInfo.rotOffset = rotationOffsets[i];
-
-			gears[i] = new VulkanGear(vulkanDevice);
-			gears[i]->generate(&gearInfo, queue);
+			gears[i].generate(gearInfo, vBuffer, iBuffer);
 		}
+		createDeviceBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer, vBuffer.size() * sizeof(Vertex), vBuffer.data());
+		createDeviceBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer, iBuffer.size() * sizeof(uint32_t), iBuffer.data());
 
 		// Binding and attribute descriptions are shared across all gears
-		vertices.bindingDescriptions.resize(1);
+		vertices.bindingDescriptions.resize(2);
 		vertices.bindingDescriptions[0] =
 			vks::initializers::vertexInputBindingDescription(
 				VERTEX_BUFFER_BIND_ID,
 				sizeof(Vertex),
 				VK_VERTEX_INPUT_RATE_VERTEX);
+		vertices.bindingDescriptions[1] =
+			vks::initializers::vertexInputBindingDescription(
+				INSTANCE_BUFFER_BIND_ID,
+				sizeof(uint32_t),
+				VK_VERTEX_INPUT_RATE_INSTANCE);
 
 		// Attribute descriptions
 		// Describes memory layout and shader positions
@@ -166,13 +267,13 @@ public:
 				1,
 				VK_FORMAT_R32G32B32_SFLOAT,
 				sizeof(float) * 3);
-		// Location 2 : Color
+		// Location 2 : Index of the visible instance
 		vertices.attributeDescriptions[2] =
 			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
+				INSTANCE_BUFFER_BIND_ID,
 				2,
-				VK_FORMAT_R32G32B32_SFLOAT,
-				sizeof(float) * 6);
+				VK_FORMAT_R32_UINT,
+				0);
 
 		vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		vertices.inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertices.bindingDescriptions.size());
@@ -181,33 +282,89 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	// (Re)create the instances for the current grid size along with the culling output
+	void prepareInstances()
+	{
+		std::vector<glm::vec3> colors = {
+			glm::vec3(1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.2f),
+			glm::vec3(0.0f, 0.0f, 1.0f)
+		};
+		std::vector<glm::vec3> positions = {
+			glm::vec3(-3.0, 0.0, 0.0),
+			glm::vec3(3.1, 0.0, 0.0),
+			glm::vec3(-3.1, -6.2, 0.0)
+		};
+		std::vector<float> rotationSpeeds = { 1.0f, -2.0f, -2.0f };
+		std::vector<float> rotationOffsets = { 0.0f, -9.0f, -30.0f };
+
+		instanceBuffer.destroy();
+		visibleInstanceBuffer.destroy();
+		indirectCommandsBuffer.destroy();
+
+		// Instances are sorted by profile, so the visible instances of a profile can be written to the same range
+		std::vector<GearInstance> instances;
+		std::vector<VkDrawIndexedIndirectCommand> drawCommands(gears.size());
+		const float spacing = 16.0f;
+		const float gridOffset = (gridSize - 1) * spacing * 0.5f;
+		for (uint32_t i = 0; i < gears.size(); i++)
+		{
+			drawCommands[i].indexCount = gears[i].indexCount;
+			drawCommands[i].instanceCount = 0;
+			drawCommands[i].firstIndex = gears[i].firstIndex;
+			drawCommands[i].vertexOffset = gears[i].vertexOffset;
+			drawCommands[i].firstInstance = static_cast<uint32_t>(instances.size());
+			for (int32_t x = 0; x < gridSize; x++)
+			{
+				for (int32_t z = 0; z < gridSize; z++)
+				{
+					GearInstance instance{};
+					instance.position = glm::vec4(positions[i] + glm::vec3(x * spacing - gridOffset, 0.0f, z * spacing - gridOffset), rotationOffsets[i]);
+					instance.color = glm::vec4(colors[i], rotationSpeeds[i]);
+					instance.profile = i;
+					instance.radius = gears[i].radius;
+					instances.push_back(instance);
+				}
+			}
+		}
+		instanceCount = static_cast<uint32_t>(instances.size());
+
+		createDeviceBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &instanceBuffer, instances.size() * sizeof(GearInstance), instances.data());
+		createDeviceBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &indirectCommandsBuffer, drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand), drawCommands.data());
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibleInstanceBuffer, instanceCount * sizeof(uint32_t)));
+	}
+
 	void setupDescriptorPool()
 	{
-		// One UBO for each gear
+		const uint32_t setCount = static_cast<uint32_t>(drawCmdBuffers.size());
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount * 3),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				// Three descriptor sets (for each gear)
-				3);
+				setCount);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
 	void setupDescriptorSetLayout()
 	{
+		// The set is shared by the culling and the rendering pipeline
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
 		{
-			// Binding 0 : Vertex shader uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_VERTEX_BIT,
-				0)
+			// Binding 0 : Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Visible instance indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Indirect draw commands
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -215,21 +372,38 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSets()
 	{
-		for (auto& gear : gears)
+		descriptorSets.resize(drawCmdBuffers.size());
+		for (size_t i = 0; i < descriptorSets.size(); i++)
+		{
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+		}
+		updateDescriptorSets();
+	}
+
+	void updateDescriptorSets()
+	{
+		for (size_t i = 0; i < descriptorSets.size(); i++)
 		{
-			gear->setupDescriptorSet(descriptorPool, descriptorSetLayout);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &visibleInstanceBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirectCommandsBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
 	}
 
@@ -306,21 +480,61 @@ public:
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfo.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
+
+		// Instance culling pipeline
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "gears/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.cull));
 	}
 
-	void updateUniformBuffers()
+	void prepareUniformBuffers()
 	{
-		for (auto& gear : gears)
-		{
-			gear->updateUniformBuffer(camera.matrices.perspective, camera.matrices.view, timer * 360.0f);
+		uniformBuffers.resize(drawCmdBuffers.size());
+		for (auto& uniformBuffer : uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&uniformBuffer,
+				sizeof(UniformData)));
+			// Map persistent
+			VK_CHECK_RESULT(uniformBuffer.map());
+		}
+		for (uint32_t i = 0; i < static_cast<uint32_t>(uniformBuffers.size()); i++) {
+			updateUniformBuffer(i);
+		}
+	}
+
+	// Only the uniform buffer of the command buffer that's about to be submitted is updated, the GPU has finished its last submission
+	void updateUniformBuffer(uint32_t index)
+	{
+		const float time = timer * 360.0f;
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.lightPos = glm::vec4(sin(glm::radians(time)) * 8.0f, 0.0f, cos(glm::radians(time)) * 8.0f, 1.0f);
+		if (frustumCulling) {
+			vks::Frustum frustum;
+			frustum.update(uniformData.projection * uniformData.view);
+			for (size_t i = 0; i < frustum.planes.size(); i++) {
+				uniformData.frustumPlanes[i] = frustum.planes[i];
+			}
+		} else {
+			// Nothing is outside of these planes
+			for (auto& plane : uniformData.frustumPlanes) {
+				plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
 		}
+		uniformData.time = time;
+		uniformData.instanceCount = instanceCount;
+		memcpy(uniformBuffers[index].mapped, &uniformData, sizeof(UniformData));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
 
+		updateUniformBuffer(currentBuffer);
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -334,12 +548,15 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		// The visible instances of each profile start at the draw command's first instance
+		assert(vulkanDevice->enabledFeatures.drawIndirectFirstInstance);
 		prepareVertices();
+		prepareInstances();
+		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
-		updateUniformBuffers();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -348,19 +565,22 @@ public:
 	{
 		if (!prepared)
 			return;
-		vkDeviceWaitIdle(device);
 		draw();
-		vkDeviceWaitIdle(device);
-		if (!paused)
-		{
-			updateUniformBuffers();
-		}
 	}
 
-	virtual void viewChanged()
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		updateUniformBuffers();
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Frustum culling", &frustumCulling);
+			if (overlay->sliderInt("Grid size", &gridSize, 1, 100)) {
+				// The instance buffers are replaced, so all frames using them need to be finished
+				waitForFramesInFlight();
+				prepareInstances();
+				updateDescriptorSets();
+			}
+			overlay->text("%d gears", instanceCount);
+		}
 	}
 };
 
-VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
+VULKAN_EXAMPLE_MAIN()
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Animated gears using multiple uniform buffers
+* Vulkan Example - Animated gears drawn with GPU culled instanced indirect draws
 *
 * See readme.md for details
 *
@@ -28,22 +28,19 @@ struct Vertex
 {
 	float pos[3];
 	float normal[3];
-	float color[3];
 
-	Vertex(const glm::vec3& p, const glm::vec3& n, const glm::vec3& c)
+	Vertex(const glm::vec3& p, const glm::vec3& n)
 	{
 		pos[0] = p.x;
 		pos[1] = p.y;
 		pos[2] = p.z;
-		color[0] = c.x;
-		color[1] = c.y;
-		color[2] = c.z;
 		normal[0] = n.x;
 		normal[1] = n.y;
 		normal[2] = n.z;
 	}
 };
 
+// Shape of a gear, all gears with the same profile share its geometry
 struct GearInfo
 {
 	float innerRadius;
@@ -51,54 +48,41 @@ struct GearInfo
 	float width;
 	int numTeeth;
 	float toothDepth;
-	glm::vec3 color;
-	glm::vec3 pos;
-	float rotSpeed;
-	float rotOffset;
 };
 
+// Per gear instance as laid out in the instance storage buffer (std430)
+struct GearInstance
+{
+	// xyz = position, w = rotation offset in degrees
+	glm::vec4 position;
+	// rgb = color, w = rotation speed
+	glm::vec4 color;
+	// Index of the gear profile (and indirect draw command)
+	uint32_t profile;
+	// Radius of the bounding sphere used for culling
+	float radius;
+	uint32_t padding[2];
+};
+
+/*
+	Geometry of a gear profile
+	The vertices and indices of all profiles are generated into shared buffers, the ranges are used for the profile's indirect draw command
+*/
 class VulkanGear
 {
 private:
-	struct UBO
-	{
-		glm::mat4 projection;
-		glm::mat4 model;
-		glm::mat4 normal;
-		glm::mat4 view;
-		glm::vec3 lightPos;
-	};
-
-	vks::VulkanDevice *vulkanDevice;
-
-	glm::vec3 color;
-	glm::vec3 pos;
-	float rotSpeed;
-	float rotOffset;
+	std::vector<Vertex> *vBuffer = nullptr;
+	std::vector<uint32_t> *iBuffer = nullptr;
 
-	vks::Buffer vertexBuffer;
-	vks::Buffer indexBuffer;
-	uint32_t indexCount;
+	int32_t newVertex(float x, float y, float z, const glm::vec3& normal);
+	void newFace(int a, int b, int c);
 
-	UBO ubo;
-	vks::Buffer uniformBuffer;
-
-	int32_t newVertex(std::vector<Vertex> *vBuffer, float x, float y, float z, const glm::vec3& normal);
-	void newFace(std::vector<uint32_t> *iBuffer, int a, int b, int c);
-
-	void prepareUniformBuffer();
 public:
-	VkDescriptorSet descriptorSet;
-
-	void draw(VkCommandBuffer cmdbuffer, VkPipelineLayout pipelineLayout);
-	void updateUniformBuffer(glm::mat4 perspective, glm::mat4 view, float timer);
-
-	void setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout);
-
-	VulkanGear(vks::VulkanDevice *vulkanDevice) : vulkanDevice(vulkanDevice) {};
-	~VulkanGear();
-
-	void generate(GearInfo *gearinfo, VkQueue queue);
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	int32_t vertexOffset = 0;
+	// Radius of a sphere around the gear's center that contains all of its vertices
+	float radius = 0.0f;
 
+	void generate(const GearInfo& gearinfo, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
 };
-
@@ -1,6 +1,11 @@
 /*
 * Vulkan Example - Geometry shader (vertex normal debugging)
 *
+* The normal lines can also be generated without a geometry shader, which scales badly with mesh density on most GPUs:
+* - A compute pass writes the lines of all triangles within the view frustum to a buffer and accumulates the vertex count of an indirect draw
+* - A task shader culls meshlets against the view frustum and a mesh shader outputs one line per meshlet vertex (requires VK_NV_mesh_shader)
+* The paths can be switched in the UI, or compared with the benchmark (-bc normalscompute or -bc normalsmesh)
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +13,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -17,16 +23,29 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool displayNormals = true;
 
+	// Ways of generating the normal lines
+	enum NormalPath { GeometryShader = 0, ComputeShader = 1, MeshShader = 2 };
+	NormalPath normalPath = GeometryShader;
+	bool geometryShaderSupported = false;
+	bool meshShaderSupported = false;
+	// Paths supported by the device, selectable in the UI
+	std::vector<NormalPath> availablePaths;
+	int32_t selectedPath = 0;
+
 	vkglTF::Model scene;
+	uint32_t triangleCount = 0;
+	vks::Frustum frustum;
 
 	struct {
 		glm::mat4 projection;
 		glm::mat4 modelView;
 	} uboVS;
 
+	// Shared by all normal paths, the frustum planes are only used for culling meshlets
 	struct {
 		glm::mat4 projection;
 		glm::mat4 modelView;
+		glm::vec4 frustumPlanes[6];
 		glm::vec2 viewportDim;
 	} uboGS;
 
@@ -36,14 +55,32 @@ public:
 	} uniformBuffers;
 
 	struct {
-		VkPipeline solid;
-		VkPipeline normals;
+		VkPipeline solid = VK_NULL_HANDLE;
+		VkPipeline normals = VK_NULL_HANDLE;
+		// Draws the lines written by the compute pass
+		VkPipeline lines = VK_NULL_HANDLE;
+		VkPipeline meshNormals = VK_NULL_HANDLE;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Compute pass generating the normal lines of the visible triangles
+	struct {
+		// Line start and packed normal (16 bytes) for each triangle corner
+		vks::Buffer lines;
+		// VkDrawIndirectCommand whose vertex count is accumulated by the compute shader
+		vks::Buffer drawCommand;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} compute;
+
+	VkPhysicalDeviceMeshShaderFeaturesNV enabledMeshShaderFeatures{};
+	std::string modelFile;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Geometry shader normal debugging";
@@ -52,6 +89,20 @@ public:
 		camera.setRotation(glm::vec3(0.0f, -25.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 128.0f);
 		settings.overlay = true;
+		// Required for querying the mesh shader limits
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+		CommandLineParser exampleArgs;
+		exampleArgs.add("normals", { "-nl", "--normals" }, 1, "Generate the normal lines with the geometry shader (gs), a compute pass (compute) or mesh shaders (mesh)");
+		exampleArgs.add("model", { "-mdl", "--model" }, 1, "Load the given glTF file instead of the default model (e.g. a dense mesh for comparing the paths)");
+		exampleArgs.parse(args);
+		const std::string path = exampleArgs.getValueAsString("normals", "gs");
+		if (path == "compute") {
+			normalPath = ComputeShader;
+		} else if (path == "mesh") {
+			normalPath = MeshShader;
+		}
+		modelFile = exampleArgs.getValueAsString("model", getAssetPath() + "models/suzanne.gltf");
 	}
 
 	~VulkanExample()
@@ -60,10 +111,18 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
 		vkDestroyPipeline(device, pipelines.normals, nullptr);
+		vkDestroyPipeline(device, pipelines.lines, nullptr);
+		vkDestroyPipeline(device, pipelines.meshNormals, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
+		compute.lines.destroy();
+		compute.drawCommand.destroy();
+
 		uniformBuffers.GS.destroy();
 		uniformBuffers.VS.destroy();
 	}
@@ -71,15 +130,69 @@ public:
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
-		// Geometry shader support is required for this example
+		// Geometry and mesh shaders are optional, the compute path works on all devices
 		if (deviceFeatures.geometryShader) {
 			enabledFeatures.geometryShader = VK_TRUE;
+			geometryShaderSupported = true;
 		}
-		else {
-			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_NV_MESH_SHADER_EXTENSION_NAME) == 0) {
+				enabledDeviceExtensions.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
+				enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+				enabledMeshShaderFeatures.taskShader = VK_TRUE;
+				enabledMeshShaderFeatures.meshShader = VK_TRUE;
+				deviceCreatepNextChain = &enabledMeshShaderFeatures;
+				meshShaderSupported = true;
+				break;
+			}
 		}
 	}
 
+	bool pathSupported(NormalPath path)
+	{
+		return (path == ComputeShader) || ((path == GeometryShader) && geometryShaderSupported) || ((path == MeshShader) && meshShaderSupported);
+	}
+
+	// Generate the normal lines of the visible triangles, recorded outside of the render pass
+	void recordNormalsCompute(VkCommandBuffer commandBuffer)
+	{
+		// The lines and the draw command of the previous frame must have been consumed before they're overwritten
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		const VkDrawIndirectCommand drawCommand = { 0, 1, 0, 0 };
+		vkCmdUpdateBuffer(commandBuffer, compute.drawCommand.buffer, 0, sizeof(drawCommand), &drawCommand);
+
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = compute.drawCommand.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		gpuProfiler.beginScope(commandBuffer, "Normals (compute)", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &triangleCount);
+		vkCmdDispatch(commandBuffer, (triangleCount + 63) / 64, 1, 1);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		// Make the lines visible to the vertex shader and the vertex count to the indirect draw
+		std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+		bufferBarriers[0] = bufferBarrier;
+		bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		bufferBarriers[1] = bufferBarriers[0];
+		bufferBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		bufferBarriers[1].buffer = compute.lines.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -104,6 +217,12 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
+			if (displayNormals && (normalPath == ComputeShader)) {
+				recordNormalsCompute(drawCmdBuffers[i]);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f
@@ -117,17 +236,33 @@ public:
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			VkDeviceSize offsets[1] = { 0 };
-
 			// Solid shading
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Solid");
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
 			scene.draw(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			// Normal debugging
 			if (displayNormals)
 			{
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.normals);
-				scene.draw(drawCmdBuffers[i]);
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Normals");
+				switch (normalPath) {
+				case GeometryShader:
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.normals);
+					scene.draw(drawCmdBuffers[i]);
+					break;
+				case ComputeShader:
+					// The vertex count has been written by the compute pass, the lines are fetched from the line buffer
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lines);
+					vkCmdDrawIndirect(drawCmdBuffers[i], compute.drawCommand.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+					break;
+				case MeshShader:
+					// Meshlets are fetched by the task and mesh shaders, so no vertex or index buffers are bound
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.meshNormals);
+					scene.drawMeshlets(drawCmdBuffers[i], 0, pipelineLayout);
+					break;
+				}
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -140,15 +275,42 @@ public:
 
 	void loadAssets()
 	{
-		scene.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY);
+		// The compute pass reads the vertex and index buffers as storage buffers
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		// Meshlet bounds are calculated from the vertex buffer, so vertices need to be pre-transformed for culling them in world space
+		if (meshShaderSupported) {
+			fileLoadingFlags |= vkglTF::FileLoadingFlags::Meshlets;
+		}
+		scene.loadFromFile(modelFile, vulkanDevice, queue, fileLoadingFlags);
+		triangleCount = static_cast<uint32_t>(scene.indices.count) / 3;
+	}
+
+	// Buffers written by the compute pass
+	void prepareComputeBuffers()
+	{
+		// One line per triangle corner, like the geometry shader
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.lines,
+			std::max(triangleCount, 1u) * 3 * 4 * sizeof(float)));
+		// Reset at the start of each frame with vkCmdUpdateBuffer
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&compute.drawCommand,
+			sizeof(VkDrawIndirectCommand)));
 	}
 
 	void setupDescriptorPool()
 	{
-		// Example uses two ubos
+		// Graphics: Two ubos, the line buffer and (with mesh shaders) the vertex and meshlet buffers
+		// Compute: One ubo and four storage buffers
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -162,6 +324,14 @@ public:
 
 	void setupDescriptorSetLayout()
 	{
+		VkShaderStageFlags normalStages = VK_SHADER_STAGE_VERTEX_BIT;
+		if (geometryShaderSupported) {
+			normalStages |= VK_SHADER_STAGE_GEOMETRY_BIT;
+		}
+		if (meshShaderSupported) {
+			normalStages |= VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV;
+		}
+
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
 		{
 			// Binding 0 : Vertex shader ubo
@@ -169,26 +339,69 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_VERTEX_BIT,
 				0),
-			// Binding 1 : Geometry shader ubo
+			// Binding 1 : Normal debugging ubo (geometry shader, line vertex shader or task and mesh shaders)
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-				VK_SHADER_STAGE_GEOMETRY_BIT,
-				1)
+				normalStages,
+				1),
+			// Binding 2 : Lines written by the compute pass
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				2)
 		};
+		if (meshShaderSupported) {
+			// Binding 3 : Vertices
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_NV, 3));
+			// Binding 4 : Meshlets (bounds and ranges)
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV, 4));
+			// Binding 5 : Meshlet vertex indices
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_NV, 5));
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
+		// The meshlet range of the primitive is passed to the task and mesh shaders via push constants (see vkglTF::Model::drawMeshlets)
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV, 2 * sizeof(uint32_t), 0);
+		if (meshShaderSupported) {
+			pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		}
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Compute pass
+		setLayoutBindings =
+		{
+			// Binding 0 : Normal debugging ubo
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Lines
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Indirect draw command
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4)
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+
+		// The triangle count is passed via push constants
+		VkPushConstantRange computePushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &computePushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -209,15 +422,41 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				0,
 				&uniformBuffers.VS.descriptor),
-			// Binding 1 : Geometry shader ubo
+			// Binding 1 : Normal debugging ubo
 			vks::initializers::writeDescriptorSet(
 				descriptorSet,
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				1,
-				&uniformBuffers.GS.descriptor)
+				&uniformBuffers.GS.descriptor),
+			// Binding 2 : Lines
+			vks::initializers::writeDescriptorSet(
+				descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&compute.lines.descriptor)
 		};
+		VkDescriptorBufferInfo vertexBufferDescriptor = { scene.vertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo indexBufferDescriptor = { scene.indices.buffer, 0, VK_WHOLE_SIZE };
+		if (meshShaderSupported) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexBufferDescriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &scene.meshlets.meshletBuffer.descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &scene.meshlets.vertexIndexBuffer.descriptor));
+		}
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Compute pass
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+		writeDescriptorSets =
+		{
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.GS.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &vertexBufferDescriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indexBufferDescriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.lines.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.drawCommand.descriptor)
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -232,11 +471,7 @@ public:
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables, 0);
 
-		// Tessellation pipeline
 		std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages;
-		shaderStages[0] = loadShader(getShadersPath() + "geometryshader/base.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "geometryshader/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		shaderStages[2] = loadShader(getShadersPath() + "geometryshader/normaldebug.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
 
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
@@ -246,19 +481,49 @@ public:
 		pipelineCI.pViewportState = &viewportState;
 		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = shaderStages.size();
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.renderPass = renderPass;
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
 
-		// Normal debugging pipeline
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.normals));
-
 		// Solid rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "geometryshader/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "geometryshader/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		pipelineCI.stageCount = 2;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+
+		// Normal debugging pipeline using a geometry shader
+		if (geometryShaderSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "geometryshader/base.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "geometryshader/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[2] = loadShader(getShadersPath() + "geometryshader/normaldebug.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
+			pipelineCI.stageCount = 3;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.normals));
+		}
+
+		// Line pipeline drawing the output of the compute pass, the vertices are fetched from the line buffer
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		shaderStages[0] = loadShader(getShadersPath() + "geometryshader/normaldebuglines.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "geometryshader/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		pipelineCI.stageCount = 2;
+		pipelineCI.pVertexInputState = &emptyInputState;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.lines));
+
+		// Normal debugging pipeline using task and mesh shaders, which don't use the vertex input and input assembly states
+		if (meshShaderSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "geometryshader/normaldebug.task.spv", VK_SHADER_STAGE_TASK_BIT_NV);
+			shaderStages[1] = loadShader(getShadersPath() + "geometryshader/normaldebug.mesh.spv", VK_SHADER_STAGE_MESH_BIT_NV);
+			shaderStages[2] = loadShader(getShadersPath() + "geometryshader/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			pipelineCI.stageCount = 3;
+			pipelineCI.pVertexInputState = nullptr;
+			pipelineCI.pInputAssemblyState = nullptr;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.meshNormals));
+		}
+
+		// Compute pipeline generating the normal lines
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "geometryshader/normaldebug.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -287,6 +552,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Vertex shader
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
@@ -294,6 +560,8 @@ public:
 		// Geometry shader
 		uboGS.projection = camera.matrices.perspective;
 		uboGS.modelView = camera.matrices.view;
+		frustum.update(camera.matrices.perspective * camera.matrices.view);
+		memcpy(uboGS.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
 		uboGS.viewportDim = glm::vec2(width, height);
 		memcpy(uniformBuffers.GS.mapped, &uboGS, sizeof(uboGS));
 	}
@@ -315,7 +583,31 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		if (meshShaderSupported) {
+			VkPhysicalDeviceMeshShaderPropertiesNV meshShaderProperties{};
+			meshShaderProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_NV;
+			VkPhysicalDeviceProperties2 deviceProperties2{};
+			deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			deviceProperties2.pNext = &meshShaderProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+			// The mesh shader outputs two vertices and one line per meshlet vertex
+			meshShaderSupported = (meshShaderProperties.maxMeshOutputVertices >= vkglTF::Model::Meshlets::maxVertices * 2) && (meshShaderProperties.maxMeshOutputPrimitives >= vkglTF::Model::Meshlets::maxVertices);
+		}
+		for (auto path : { GeometryShader, ComputeShader, MeshShader }) {
+			if (pathSupported(path)) {
+				if (path == normalPath) {
+					selectedPath = static_cast<int32_t>(availablePaths.size());
+				}
+				availablePaths.push_back(path);
+			}
+		}
+		if (!pathSupported(normalPath)) {
+			std::cout << "Selected normal path is not supported by the device, using a compute pass instead\n";
+			normalPath = ComputeShader;
+			selectedPath = geometryShaderSupported ? 1 : 0;
+		}
 		loadAssets();
+		prepareComputeBuffers();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -337,12 +629,36 @@ public:
 		updateUniformBuffers();
 	}
 
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		// Compares the geometry shader with one of the replacements
+		if ((name == "normalscompute") && geometryShaderSupported) {
+			normalPath = enabled ? ComputeShader : GeometryShader;
+			return true;
+		}
+		if ((name == "normalsmesh") && geometryShaderSupported && meshShaderSupported) {
+			normalPath = enabled ? MeshShader : GeometryShader;
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->checkBox("Display normals", &displayNormals)) {
 				buildCommandBuffers();
 			}
+			std::vector<std::string> pathNames;
+			const std::string names[] = { "Geometry shader", "Compute shader", "Mesh shader" };
+			for (auto path : availablePaths) {
+				pathNames.push_back(names[path]);
+			}
+			if (overlay->comboBox("Normals", &selectedPath, pathNames)) {
+				normalPath = availablePaths[selectedPath];
+				buildCommandBuffers();
+			}
+			overlay->text("Triangles: %d", triangleCount);
 		}
 	}
 
@@ -0,0 +1,435 @@
+/*
+* Vulkan Example - Streaming geometry through a sparse bound geometry pool
+*
+* A large grid of meshes that share a single sparse bound vertex and index buffer (see vks::SparseGeometryPool)
+* Only the meshes near the camera are backed by memory: They're streamed in from their host copy on demand, bound page by page from a
+* fixed memory budget, and the least recently requested ones are evicted once the budget is used up, so geometry memory stays bounded no matter how large the scene is
+* All resident meshes are drawn with indirect draws that reference their offsets in the pool
+*
+* Each grid cell has a mesh of its own, standing in for the unique assets of a large world (the meshes are copies of a few glTF models)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanSparseGeometryPool.h"
+
+#define ENABLE_VALIDATION false
+
+#define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	// Vertex layout of the streamed meshes, only the components used for drawing are stored in the pool
+	struct Vertex {
+		glm::vec3 pos;
+		glm::vec3 normal;
+		glm::vec4 color;
+	};
+
+	// Host copy of a source model the meshes of the grid cells are streamed in from
+	struct SourceMesh {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		glm::vec3 center;
+		float radius;
+	};
+	std::vector<SourceMesh> sourceMeshes;
+
+	// Per-instance data, selected with the first instance of a cell's indirect draw
+	struct InstanceData {
+		// xyz = position, w = scale
+		glm::vec4 posScale;
+	};
+	struct Cell {
+		uint32_t mesh;
+		glm::vec3 position;
+	};
+	std::vector<Cell> cells;
+	uint32_t gridSize = 32;
+	float cellSpacing = 4.0f;
+	vks::Buffer instanceBuffer;
+
+	vks::SparseGeometryPool geometryPool;
+	int32_t memoryBudgetMB = 64;
+	float streamingDistance = 40.0f;
+	bool autoMove = false;
+
+	// Indirect draws of the resident meshes, written by the host each frame, one buffer per frame in flight
+	std::vector<vks::Buffer> indirectBuffers;
+	uint32_t drawCount = 0;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Geometry streaming with a sparse buffer";
+		camera.type = Camera::CameraType::firstperson;
+		camera.setRotation(glm::vec3(-20.0f, 0.0f, 0.0f));
+		camera.setPosition(glm::vec3(0.0f, 4.0f, 0.0f));
+		camera.setMovementSpeed(10.0f);
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		settings.overlay = true;
+		// Recorded each frame, as the draws depend on the meshes that are resident
+		dynamicCommandBuffers = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("budget", { "-budget", "--budget" }, 1, "Memory budget for the resident geometry in MB (defaults to 64)");
+		exampleArgs.add("grid", { "-grid", "--grid" }, 1, "Number of cells along each side of the grid, each cell has a mesh of its own (defaults to 32)");
+		exampleArgs.parse(args);
+		memoryBudgetMB = std::max(exampleArgs.getValueAsInt("budget", 64), 1);
+		gridSize = static_cast<uint32_t>(std::max(exampleArgs.getValueAsInt("grid", 32), 1));
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			for (auto& buffer : indirectBuffers) {
+				buffer.destroy();
+			}
+			instanceBuffer.destroy();
+			uniformBuffer.destroy();
+			geometryPool.destroy();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// The pool's buffer is sparse bound
+		if (deviceFeatures.sparseBinding) {
+			enabledFeatures.sparseBinding = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support sparse binding!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		// The indirect draws select the instance data of their cell with the first instance
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support indirect draws with a first instance!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		// Example uses multi draw indirect if available
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+	}
+
+	/*
+		Load the source models and register one mesh per grid cell with the geometry pool
+		The models only keep their geometry on the host, no vertex or index buffers are created for them
+	*/
+	void loadAssets()
+	{
+		const std::vector<std::string> fileNames = { "chinesedragon.gltf", "teapot.gltf", "venus.gltf", "suzanne.gltf", "rock01.gltf", "retroufo.gltf" };
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::HostGeometryOnly;
+		for (auto& fileName : fileNames) {
+			vkglTF::Model model;
+			model.loadFromFile(getAssetPath() + "models/" + fileName, vulkanDevice, queue, glTFLoadingFlags);
+			SourceMesh sourceMesh;
+			sourceMesh.vertices.reserve(model.hostData.vertices.size());
+			for (auto& vertex : model.hostData.vertices) {
+				sourceMesh.vertices.push_back({ vertex.pos, vertex.normal, vertex.color });
+			}
+			sourceMesh.indices = model.hostData.indices;
+			sourceMesh.center = model.dimensions.center;
+			sourceMesh.radius = model.dimensions.radius;
+			sourceMeshes.push_back(sourceMesh);
+		}
+
+		// Cells are placed on a grid centered at the origin
+		const float offset = (gridSize - 1) * cellSpacing * 0.5f;
+		for (uint32_t z = 0; z < gridSize; z++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				const SourceMesh& sourceMesh = sourceMeshes[(z * gridSize + x) % sourceMeshes.size()];
+				Cell cell;
+				cell.mesh = geometryPool.addMesh(sourceMesh.vertices.data(), static_cast<uint32_t>(sourceMesh.vertices.size()), sourceMesh.indices.data(), static_cast<uint32_t>(sourceMesh.indices.size()));
+				cell.position = glm::vec3(x * cellSpacing - offset, 0.0f, z * cellSpacing - offset);
+				cells.push_back(cell);
+			}
+		}
+		geometryPool.prepare(vulkanDevice, queue, sizeof(Vertex), (VkDeviceSize)memoryBudgetMB * 1024 * 1024);
+	}
+
+	void prepareBuffers()
+	{
+		// Instance data of all cells, the models are scaled to fit into a cell
+		std::vector<InstanceData> instanceData(cells.size());
+		for (size_t i = 0; i < cells.size(); i++) {
+			const SourceMesh& sourceMesh = sourceMeshes[i % sourceMeshes.size()];
+			const float scale = cellSpacing * 0.35f / sourceMesh.radius;
+			instanceData[i].posScale = glm::vec4(cells[i].position - sourceMesh.center * scale, scale);
+		}
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instanceBuffer,
+			instanceData.size() * sizeof(InstanceData),
+			instanceData.data()));
+
+		indirectBuffers.resize(maxFramesInFlight);
+		for (auto& buffer : indirectBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&buffer,
+				cells.size() * sizeof(VkDrawIndexedIndirectCommand)));
+			VK_CHECK_RESULT(buffer.map());
+		}
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	void updateUniformBuffers()
+	{
+		waitForFramesInFlight();
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Vertex shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+		// Binding 0 : Vertices of all meshes in the geometry pool
+		// Binding 1 : Instance data of the cells
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(VERTEX_BUFFER_BIND_ID, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+			vks::initializers::vertexInputBindingDescription(INSTANCE_BUFFER_BIND_ID, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE)
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			// Location 0: Position
+			vks::initializers::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)),
+			// Location 1: Normal
+			vks::initializers::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)),
+			// Location 2: Color
+			vks::initializers::vertexInputAttributeDescription(VERTEX_BUFFER_BIND_ID, 2, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, color)),
+			// Location 3: Instance position and scale
+			vks::initializers::vertexInputAttributeDescription(INSTANCE_BUFFER_BIND_ID, 3, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, posScale)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+			loadShader(getShadersPath() + "geometrystreaming/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "geometrystreaming/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputStateCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	/*
+		Request the meshes of all cells within the streaming distance (closest first), which streams in the missing ones,
+		and write the indirect draws for the cells whose mesh is resident
+	*/
+	void updateStreaming(uint32_t frameIndex)
+	{
+		// World space position of the first person camera
+		const glm::vec3 cameraPos = -camera.position;
+		std::vector<std::pair<float, uint32_t>> nearbyCells;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(cells.size()); i++) {
+			const float distance = glm::length(glm::vec2(cells[i].position.x - cameraPos.x, cells[i].position.z - cameraPos.z));
+			if (distance <= streamingDistance) {
+				nearbyCells.push_back(std::make_pair(distance, i));
+			}
+		}
+		std::sort(nearbyCells.begin(), nearbyCells.end());
+		std::vector<uint32_t> requestedMeshes;
+		requestedMeshes.reserve(nearbyCells.size());
+		for (auto& nearbyCell : nearbyCells) {
+			requestedMeshes.push_back(cells[nearbyCell.second].mesh);
+		}
+		geometryPool.update(requestedMeshes);
+
+		// The pool's binds and uploads have been submitted before this frame, so all resident meshes can be drawn
+		VkDrawIndexedIndirectCommand* drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffers[frameIndex].mapped);
+		drawCount = 0;
+		for (auto& nearbyCell : nearbyCells) {
+			const vks::SparseGeometryPool::Mesh& mesh = geometryPool.meshes[cells[nearbyCell.second].mesh];
+			if (!mesh.resident) {
+				continue;
+			}
+			VkDrawIndexedIndirectCommand& drawCommand = drawCommands[drawCount++];
+			drawCommand.indexCount = mesh.indexCount;
+			drawCommand.instanceCount = 1;
+			drawCommand.firstIndex = mesh.firstIndex;
+			drawCommand.vertexOffset = mesh.vertexOffset;
+			drawCommand.firstInstance = nearbyCell.second;
+		}
+	}
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// The fence of this frame in flight has been waited on, so its indirect buffer can be rewritten
+		updateStreaming(currentFrame);
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		gpuProfiler.beginScope(commandBuffer, "Streamed geometry");
+		if (drawCount > 0) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			// [POI] All meshes are drawn from the pool's buffer, the draws address them with their vertex offset and first index
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &geometryPool.buffer, offsets);
+			vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, geometryPool.buffer, 0, VK_INDEX_TYPE_UINT32);
+			const VkBuffer indirectBuffer = indirectBuffers[currentFrame].buffer;
+			if (vulkanDevice->features.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+			} else {
+				// If multi draw is not available, we must issue separate draw commands
+				for (uint32_t i = 0; i < drawCount; i++) {
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
+		}
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareBuffers();
+		setupDescriptors();
+		preparePipelines();
+		// The benchmark flies over the grid, so meshes are constantly streamed in and evicted
+		autoMove = autoMove || benchmark.active;
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		if (autoMove && !paused) {
+			// Circle over the grid
+			const float radius = gridSize * cellSpacing * 0.35f;
+			const float angle = timer * 2.0f * glm::pi<float>();
+			camera.setPosition(glm::vec3(-cos(angle) * radius, camera.position.y, -sin(angle) * radius));
+		}
+		renderFrame();
+	}
+
+	virtual void viewChanged()
+	{
+		updateUniformBuffers();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Fly over the grid", &autoMove);
+			overlay->sliderFloat("Streaming distance", &streamingDistance, cellSpacing, gridSize * cellSpacing);
+			if (overlay->sliderInt("Memory budget (MB)", &memoryBudgetMB, 1, 1024)) {
+				geometryPool.setBudget((VkDeviceSize)memoryBudgetMB * 1024 * 1024);
+			}
+			if (overlay->button("Flush geometry")) {
+				geometryPool.flush();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const float toMB = 1.0f / (1024.0f * 1024.0f);
+			overlay->text("Resident meshes: %d of %d", static_cast<uint32_t>(geometryPool.lru.size()), static_cast<uint32_t>(geometryPool.meshes.size()));
+			overlay->text("Requested meshes: %d (%d missing)", geometryPool.statistics.meshesRequested, geometryPool.statistics.meshesMissing);
+			overlay->text("Draws: %d", drawCount);
+			overlay->text("Resident pages: %d of %d", geometryPool.pagePool.usedSlots(), geometryPool.pagePool.capacity);
+			overlay->text("Page pool: %.1f MB allocated", (float)(geometryPool.pagePool.slotCount * geometryPool.pagePool.pageSize) * toMB);
+			overlay->text("All meshes: %.1f MB", (float)geometryPool.size * toMB);
+			overlay->text("Streamed in: %d (%.1f MB), evicted: %d", geometryPool.statistics.meshesStreamedIn, (float)geometryPool.statistics.bytesUploaded * toMB, geometryPool.statistics.meshesEvicted);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
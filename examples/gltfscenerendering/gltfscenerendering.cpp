@@ -26,13 +26,13 @@ VulkanglTFScene::~VulkanglTFScene()
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
+		if (material.depthPrepassPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(vulkanDevice->logicalDevice, material.depthPrepassPipeline, nullptr);
+		}
 	}
 }
 
@@ -234,48 +234,60 @@ VkDescriptorImageInfo VulkanglTFScene::getTextureDescriptor(const size_t index)
 	glTF rendering functions
 */
 
-// Draw a single node including child nodes (if present)
-void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node node)
+// Recursively add the visible nodes with primitives to the draw list
+void VulkanglTFScene::appendDrawNode(const VulkanglTFScene::Node& node, const glm::mat4& parentMatrix)
 {
 	if (!node.visible) {
 		return;
 	}
+	const glm::mat4 nodeMatrix = parentMatrix * node.matrix;
 	if (node.mesh.primitives.size() > 0) {
-		// Pass the node's matrix via push constants
-		// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
-		glm::mat4 nodeMatrix = node.matrix;
-		VulkanglTFScene::Node* currentParent = node.parent;
-		while (currentParent) {
-			nodeMatrix = currentParent->matrix * nodeMatrix;
-			currentParent = currentParent->parent;
-		}
-		// Pass the final matrix to the vertex shader using push constants
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
-		for (VulkanglTFScene::Primitive& primitive : node.mesh.primitives) {
-			if (primitive.indexCount > 0) {
-				VulkanglTFScene::Material& material = materials[primitive.materialIndex];
-				// POI: Bind the pipeline for the node's material
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
-				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
-			}
-		}
+		drawList.push_back({ &node, nodeMatrix });
 	}
 	for (auto& child : node.children) {
-		drawNode(commandBuffer, pipelineLayout, child);
+		appendDrawNode(child, nodeMatrix);
 	}
 }
 
-// Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+// Flatten the node hierarchy, needs to be called if node visibility changes
+void VulkanglTFScene::updateDrawList()
 {
-	// All vertices and indices are stored in single buffers, so we only need to bind once
-	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	// Render all nodes at top-level
+	drawList.clear();
 	for (auto& node : nodes) {
-		drawNode(commandBuffer, pipelineLayout, node);
+		appendDrawNode(node, glm::mat4(1.0f));
+	}
+}
+
+// Add the primitives of all nodes in the draw list to the render queue, sorted by pass, pipeline, material and distance to the camera
+// The depth prepass draws the primitives of materials with a depth prepass pipeline, all others are depth tested as usual in the main subpass
+void VulkanglTFScene::enqueueDraws(vks::RenderQueue& queue, const glm::vec3& cameraPosition, bool depthPrepass)
+{
+	for (const DrawNode& drawNode : drawList) {
+		const glm::vec3 nodePosition = glm::vec3(drawNode.matrix[3]);
+		const float depth = glm::length(nodePosition - cameraPosition);
+		for (const VulkanglTFScene::Primitive& primitive : drawNode.node->mesh.primitives) {
+			if (primitive.indexCount == 0) {
+				continue;
+			}
+			const VulkanglTFScene::Material& material = materials[primitive.materialIndex];
+			vks::RenderQueue::Draw draw{};
+			draw.pushConstants = &drawNode.matrix;
+			draw.indexCount = primitive.indexCount;
+			draw.firstIndex = primitive.firstIndex;
+			draw.instanceCount = 1;
+			if (depthPrepass && (material.depthPrepassPipeline != VK_NULL_HANDLE)) {
+				// The depth only pipeline doesn't read the material's textures
+				draw.pipeline = material.depthPrepassPipeline;
+				queue.add(PassDepthPrepass, draw, depth);
+			}
+			draw.pipeline = material.pipeline;
+			draw.descriptorSet = material.descriptorSet;
+			if (material.alphaMode == "BLEND") {
+				queue.add(PassAlphaBlend, draw, depth, vks::RenderQueue::BackToFront);
+			} else {
+				queue.add((material.alphaMode == "MASK") ? PassAlphaMask : PassOpaque, draw, depth);
+			}
+		}
 	}
 }
 
@@ -292,10 +304,15 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 	settings.overlay = true;
+	depthPrepass.supported = true;
 }
 
 VulkanExample::~VulkanExample()
 {
+	// Destroying the pools also frees their command buffers
+	for (auto& thread : recordingThreads) {
+		vkDestroyCommandPool(device, thread.commandPool, nullptr);
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
@@ -307,6 +324,30 @@ void VulkanExample::getEnabledFeatures()
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
 }
 
+// Create a command pool for each worker of the job system
+void VulkanExample::prepareRecordingThreads()
+{
+	recordingThreads.resize(jobSystem.workerCount());
+	for (auto& thread : recordingThreads) {
+		VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+		cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
+	}
+}
+
+// Returns an unused secondary command buffer from the pool of the given worker, must only be called from that worker
+VkCommandBuffer VulkanExample::getSecondaryCommandBuffer(uint32_t workerIndex)
+{
+	RecordingThread& thread = recordingThreads[workerIndex];
+	if (thread.usedCommandBuffers == thread.commandBuffers.size()) {
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+		VkCommandBuffer commandBuffer;
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+		thread.commandBuffers.push_back(commandBuffer);
+	}
+	return thread.commandBuffers[thread.usedCommandBuffers++];
+}
+
 void VulkanExample::buildCommandBuffers()
 {
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -328,21 +369,118 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	// POI: Collect and sort the draws of the scene once, all command buffers are recorded from the sorted queue
+	glTFScene.updateDrawList();
+	renderQueue.clear();
+	glTFScene.enqueueDraws(renderQueue, glm::vec3(camera.viewPos), depthPrepass.enabled);
+	renderQueue.sort();
+	// The main subpass draws all passes following the depth prepass
+	uint32_t prepassFirst;
+	const uint32_t prepassCount = renderQueue.getPassRange(VulkanglTFScene::PassDepthPrepass, prepassFirst);
+	const uint32_t sceneFirst = prepassFirst + prepassCount;
+	const uint32_t sceneCount = renderQueue.size() - sceneFirst;
+
+	const bool parallel = multiThreadedRecording && !recordingThreads.empty();
+	if (parallel) {
+		// Command buffers are only rebuilt once all frames in flight have finished, so all secondary command buffers can be recycled
+		for (auto& thread : recordingThreads) {
+			VK_CHECK_RESULT(vkResetCommandPool(device, thread.commandPool, 0));
+			thread.usedCommandBuffers = 0;
+		}
+	}
+	// Split the sorted draws into a few ranges per worker, so idle workers can steal ranges from busy ones
+	const uint32_t drawsPerRange = std::max(renderQueue.size() / (jobSystem.workerCount() * 4), 1u);
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		gpuProfiler.beginFrame(drawCmdBuffers[i]);
+		gpuProfiler.beginScope(drawCmdBuffers[i], "Render pass");
+
+		if (parallel) {
+			// POI: The scene is recorded into secondary command buffers in parallel, the primary command buffer only executes them
+			// Timestamps can't be written inside a render pass with secondary command buffer contents, so there are no scene and UI scopes in this mode
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+			VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+			inheritanceInfo.renderPass = renderPass;
+			inheritanceInfo.framebuffer = frameBuffers[i];
+			VkCommandBufferBeginInfo secondaryBeginInfo = vks::initializers::commandBufferBeginInfo();
+			secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			// Secondary command buffers are recorded for a single subpass, so the depth prepass and the main subpass are recorded separately
+			auto executeSubpass = [&](uint32_t subpass, bool depthOnly, uint32_t firstDraw, uint32_t drawCount) {
+				inheritanceInfo.subpass = subpass;
+				std::vector<VkCommandBuffer> secondaryCommandBuffers((drawCount + drawsPerRange - 1) / drawsPerRange);
+				jobSystem.parallelFor(drawCount, [&](uint32_t begin, uint32_t end) {
+					VkCommandBuffer commandBuffer = getSecondaryCommandBuffer(jobSystem.workerIndex());
+					VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &secondaryBeginInfo));
+					// Dynamic state and descriptor bindings aren't inherited from the primary command buffer
+					vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+					vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+					// Secondary command buffers don't inherit any state, so each range binds the buffers
+					VkDeviceSize offsets[1] = { 0 };
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &glTFScene.vertices.buffer, offsets);
+					vkCmdBindIndexBuffer(commandBuffer, glTFScene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+					renderQueue.record(commandBuffer, firstDraw + begin, end - begin);
+					VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+					secondaryCommandBuffers[begin / drawsPerRange] = commandBuffer;
+				}, drawsPerRange);
+
+				// The UI has to be drawn from a secondary command buffer too
+				if (settings.overlay && !depthOnly) {
+					VkCommandBuffer commandBuffer = getSecondaryCommandBuffer(jobSystem.workerIndex());
+					VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &secondaryBeginInfo));
+					drawUI(commandBuffer);
+					VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+					secondaryCommandBuffers.push_back(commandBuffer);
+				}
 
-		// POI: Draw the glTF scene
-		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+				if (!secondaryCommandBuffers.empty()) {
+					vkCmdExecuteCommands(drawCmdBuffers[i], static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+				}
+			};
+
+			if (depthPrepass.enabled) {
+				executeSubpass(0, true, prepassFirst, prepassCount);
+				vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			}
+			executeSubpass(depthPrepass.mainSubpass, false, sceneFirst, sceneCount);
+		}
+		else {
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			// Bind scene matrices descriptor to set 0
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			// All vertices and indices are stored in single buffers, so we only need to bind once
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &glTFScene.vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(drawCmdBuffers[i], glTFScene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+			// Lay down the depth of the opaque materials, so the main subpass only shades visible fragments
+			if (depthPrepass.enabled) {
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Depth prepass");
+				renderQueue.record(drawCmdBuffers[i], prepassFirst, prepassCount);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+				vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+			}
+
+			// POI: Draw the glTF scene
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
+			renderQueue.record(drawCmdBuffers[i], sceneFirst, sceneCount);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
+
+			gpuProfiler.beginScope(drawCmdBuffers[i], "UI");
+			drawUI(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
+		}
 
-		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		gpuProfiler.endScope(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
@@ -488,7 +626,7 @@ void VulkanExample::setupDescriptors()
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.matrices));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.matrices));
 
 	// Descriptor set layout for passing material textures
 	setLayoutBindings = {
@@ -499,7 +637,7 @@ void VulkanExample::setupDescriptors()
 	};
 	descriptorSetLayoutCI.pBindings = setLayoutBindings.data();
 	descriptorSetLayoutCI.bindingCount = 2;
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
 
 	// Pipeline layout using both descriptor sets (set 0 = matrices, set 1 = material)
 	std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayouts.matrices, descriptorSetLayouts.textures };
@@ -509,7 +647,12 @@ void VulkanExample::setupDescriptors()
 	// Push constant ranges are part of the pipeline layout
 	pipelineLayoutCI.pushConstantRangeCount = 1;
 	pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
-	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+	VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+	// The render queue binds the material descriptor sets and pushes the node matrices of its draws
+	renderQueue.pipelineLayout = pipelineLayout;
+	renderQueue.materialSet = 1;
+	renderQueue.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+	renderQueue.pushConstantSize = sizeof(glm::mat4);
 
 	// Descriptor set for scene matrices
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.matrices, 1);
@@ -593,7 +736,16 @@ void VulkanExample::preparePipelines()
 		// For double sided materials, culling will be disabled
 		rasterizationStateCI.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
+		// With the depth prepass, opaque materials only shade the fragments that passed the prepass
+		// Alpha masked materials discard fragments in the fragment shader, so they are depth tested and written in the main subpass instead
+		depthStencilStateCI.depthWriteEnable = VK_TRUE;
+		depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		pipelineCI.subpass = depthPrepass.mainSubpass;
+		if (!materialSpecializationData.alphaMask) {
+			prepareDepthPrepassPipeline(pipelineCI, depthStencilStateCI, &material.depthPrepassPipeline);
+		}
+
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
 	}
 }
 
@@ -610,6 +762,7 @@ void VulkanExample::prepareUniformBuffers()
 
 void VulkanExample::updateUniformBuffers()
 {
+	waitForFramesInFlight();
 	shaderData.values.projection = camera.matrices.perspective;
 	shaderData.values.view = camera.matrices.view;
 	shaderData.values.viewPos = camera.viewPos;
@@ -623,6 +776,7 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	prepareRecordingThreads();
 	buildCommandBuffers();
 	prepared = true;
 }
@@ -637,6 +791,18 @@ void VulkanExample::render()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
+	if (overlay->header("Settings")) {
+		if (overlay->checkBox("Multi threaded recording", &multiThreadedRecording)) {
+			buildCommandBuffers();
+		}
+		if (multiThreadedRecording) {
+			overlay->text("Recording threads: %d", jobSystem.workerCount());
+		}
+		const vks::RenderQueue::Statistics& statistics = renderQueue.getStatistics();
+		overlay->text("Draws: %d", statistics.draws);
+		overlay->text("Pipeline binds: %d", statistics.pipelineBinds);
+		overlay->text("Material binds: %d", statistics.descriptorSetBinds);
+	}
 	if (overlay->header("Visibility")) {
 
 		if (overlay->button("All")) {
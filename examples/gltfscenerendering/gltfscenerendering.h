@@ -23,6 +23,8 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "jobsystem.hpp"
+#include "renderqueue.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -93,6 +95,8 @@ public:
 		bool doubleSided = false;
 		VkDescriptorSet descriptorSet;
 		VkPipeline pipeline;
+		// Depth only pipeline for the depth prepass, only created for opaque materials if the depth prepass is enabled (--depthprepass)
+		VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
 	};
 
 	// Contains the texture for a single glTF image
@@ -115,6 +119,22 @@ public:
 	std::vector<Material> materials;
 	std::vector<Node> nodes;
 
+	// Flattened list of all visible nodes with primitives and their final matrices
+	// The render queue's draws point to these matrices for their push constants
+	struct DrawNode {
+		const Node* node;
+		glm::mat4 matrix;
+	};
+	std::vector<DrawNode> drawList;
+
+	// Passes of the render queue, the depth prepass is recorded in its own subpass and all other passes in the main subpass
+	enum Pass {
+		PassDepthPrepass = 0,
+		PassOpaque,
+		PassAlphaMask,
+		PassAlphaBlend
+	};
+
 	std::string path;
 
 	~VulkanglTFScene();
@@ -123,8 +143,9 @@ public:
 	void loadTextures(tinygltf::Model& input);
 	void loadMaterials(tinygltf::Model& input);
 	void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
-	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node node);
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void appendDrawNode(const VulkanglTFScene::Node& node, const glm::mat4& parentMatrix);
+	void updateDrawList();
+	void enqueueDraws(vks::RenderQueue& queue, const glm::vec3& cameraPosition, bool depthPrepass = false);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -150,9 +171,26 @@ public:
 		VkDescriptorSetLayout textures;
 	} descriptorSetLayouts;
 
+	// POI: All draws of the scene are collected into a render queue once per recording and sorted by pass, pipeline, material and depth
+	// This way pipelines and material descriptor sets are only bound when they change, instead of for every primitive
+	vks::RenderQueue renderQueue;
+
+	// The scene can be recorded into secondary command buffers on all cores using the job system
+	bool multiThreadedRecording = true;
+	vks::JobSystem jobSystem;
+	// Each worker of the job system allocates its secondary command buffers from its own pool
+	struct RecordingThread {
+		VkCommandPool commandPool;
+		std::vector<VkCommandBuffer> commandBuffers;
+		uint32_t usedCommandBuffers = 0;
+	};
+	std::vector<RecordingThread> recordingThreads;
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
+	void prepareRecordingThreads();
+	VkCommandBuffer getSecondaryCommandBuffer(uint32_t workerIndex);
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
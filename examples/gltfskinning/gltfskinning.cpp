@@ -46,15 +46,13 @@ VulkanglTFModel::~VulkanglTFModel()
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images)
 	{
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Skin skin : skins)
 	{
 		skin.ssbo.destroy();
 	}
+	bakedAnimation.buffer.destroy();
 }
 
 /*
@@ -492,23 +490,30 @@ glm::mat4 VulkanglTFModel::getNodeMatrix(VulkanglTFModel::Node *node)
 	return nodeMatrix;
 }
 
+// POI: Calculate the joint matrices of a skinned node from the current pose
+void VulkanglTFModel::getJointMatrices(VulkanglTFModel::Node *node, std::vector<glm::mat4> &jointMatrices)
+{
+	glm::mat4   inverseTransform = glm::inverse(getNodeMatrix(node));
+	const Skin &skin             = skins[node->skin];
+	size_t      numJoints        = (uint32_t) skin.joints.size();
+	jointMatrices.resize(numJoints);
+	for (size_t i = 0; i < numJoints; i++)
+	{
+		jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
+		jointMatrices[i] = inverseTransform * jointMatrices[i];
+	}
+}
+
 // POI: Update the joint matrices from the current animation frame and pass them to the GPU
 void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
 {
 	if (node->skin > -1)
 	{
 		// Update the joint matrices
-		glm::mat4              inverseTransform = glm::inverse(getNodeMatrix(node));
-		Skin                   skin             = skins[node->skin];
-		size_t                 numJoints        = (uint32_t) skin.joints.size();
-		std::vector<glm::mat4> jointMatrices(numJoints);
-		for (size_t i = 0; i < numJoints; i++)
-		{
-			jointMatrices[i] = getNodeMatrix(skin.joints[i]) * skin.inverseBindMatrices[i];
-			jointMatrices[i] = inverseTransform * jointMatrices[i];
-		}
+		std::vector<glm::mat4> jointMatrices;
+		getJointMatrices(node, jointMatrices);
 		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		skins[node->skin].ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 	}
 
 	for (auto &child : node->children)
@@ -531,7 +536,16 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 	{
 		animation.currentTime -= animation.end;
 	}
+	applyAnimation(animation, animation.currentTime);
+	for (auto &node : nodes)
+	{
+		updateJoints(node);
+	}
+}
 
+// POI: Set the translation, rotation and scale of the animated nodes from the animation's keyframes at the given time
+void VulkanglTFModel::applyAnimation(Animation &animation, float time)
+{
 	for (auto &channel : animation.channels)
 	{
 		AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
@@ -544,9 +558,9 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 			}
 
 			// Get the input keyframe values for the current time stamp
-			if ((animation.currentTime >= sampler.inputs[i]) && (animation.currentTime <= sampler.inputs[i + 1]))
+			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1]))
 			{
-				float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
+				float a = (time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
 				if (channel.path == "translation")
 				{
 					channel.node->translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
@@ -574,10 +588,68 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 			}
 		}
 	}
+}
+
+// Returns the first node with a skin in the hierarchy below (and including) the given node
+VulkanglTFModel::Node *VulkanglTFModel::findSkinnedNode(Node *node)
+{
+	if (node->skin > -1)
+	{
+		return node;
+	}
+	for (auto &child : node->children)
+	{
+		if (Node *skinnedNode = findSkinnedNode(child))
+		{
+			return skinnedNode;
+		}
+	}
+	return nullptr;
+}
+
+/*
+	POI: Bake an animation into a buffer of joint matrices for crowd rendering
+	The animation is sampled at a fixed frame rate over its whole duration, and the joint matrices of all frames are stored one after another
+	The vertex shader interpolates between the two frames surrounding an instance's animation time, so the CPU no longer evaluates the animation per instance
+*/
+void VulkanglTFModel::bakeAnimation(uint32_t animationIndex, float frameRate)
+{
+	Node *skinnedNode = nullptr;
 	for (auto &node : nodes)
 	{
-		updateJoints(node);
+		if ((skinnedNode = findSkinnedNode(node)) != nullptr)
+		{
+			break;
+		}
+	}
+	if (!skinnedNode || (animationIndex >= animations.size()))
+	{
+		return;
 	}
+	Animation &animation = animations[animationIndex];
+	const float duration = animation.end - animation.start;
+	bakedAnimation.frameRate  = frameRate;
+	bakedAnimation.frameCount = std::max(static_cast<uint32_t>(std::ceil(duration * frameRate)), 1u);
+	bakedAnimation.jointCount = static_cast<uint32_t>(skins[skinnedNode->skin].joints.size());
+
+	std::vector<glm::mat4> frames;
+	frames.reserve(bakedAnimation.frameCount * bakedAnimation.jointCount);
+	std::vector<glm::mat4> jointMatrices;
+	for (uint32_t frame = 0; frame < bakedAnimation.frameCount; frame++)
+	{
+		applyAnimation(animation, animation.start + static_cast<float>(frame) / frameRate);
+		getJointMatrices(skinnedNode, jointMatrices);
+		frames.insert(frames.end(), jointMatrices.begin(), jointMatrices.end());
+	}
+	// Restore the pose of the single animated character
+	applyAnimation(animations[activeAnimation], animations[activeAnimation].currentTime);
+
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &bakedAnimation.buffer,
+	    frames.size() * sizeof(glm::mat4),
+	    frames.data()));
 }
 
 /*
@@ -585,7 +657,8 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 */
 
 // Draw a single node including child nodes (if present)
-void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node)
+// For crowd rendering all instances are drawn at once, with the joint matrices taken from the baked animation instead of the node's skin
+void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node, uint32_t instanceCount, VkDescriptorSet jointDescriptorSet)
 {
 	if (node.mesh.primitives.size() > 0)
 	{
@@ -601,7 +674,8 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 		// Pass the final matrix to the vertex shader using push constants
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
 		// Bind SSBO with skin data for this node to set 1
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skins[node.skin].descriptorSet, 0, nullptr);
+		const VkDescriptorSet jointSet = (jointDescriptorSet != VK_NULL_HANDLE) ? jointDescriptorSet : skins[node.skin].descriptorSet;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &jointSet, 0, nullptr);
 		for (VulkanglTFModel::Primitive &primitive : node.mesh.primitives)
 		{
 			if (primitive.indexCount > 0)
@@ -610,18 +684,18 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 				VulkanglTFModel::Texture texture = textures[materials[primitive.materialIndex].baseColorTextureIndex];
 				// Bind the descriptor for the current primitive's texture to set 2
 				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &images[texture.imageIndex].descriptorSet, 0, nullptr);
-				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, instanceCount, primitive.firstIndex, 0, 0);
 			}
 		}
 	}
 	for (auto &child : node.children)
 	{
-		drawNode(commandBuffer, pipelineLayout, *child);
+		drawNode(commandBuffer, pipelineLayout, *child, instanceCount, jointDescriptorSet);
 	}
 }
 
 // Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t instanceCount, VkDescriptorSet jointDescriptorSet)
 {
 	// All vertices and indices are stored in single buffers, so we only need to bind once
 	VkDeviceSize offsets[1] = {0};
@@ -630,7 +704,7 @@ void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 	// Render all nodes at top-level
 	for (auto &node : nodes)
 	{
-		drawNode(commandBuffer, pipelineLayout, *node);
+		drawNode(commandBuffer, pipelineLayout, *node, instanceCount, jointDescriptorSet);
 	}
 }
 
@@ -659,6 +733,7 @@ VulkanExample::~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 	}
+	vkDestroyPipeline(device, pipelines.crowd, nullptr);
 
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
@@ -666,6 +741,7 @@ VulkanExample::~VulkanExample()
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.jointMatrices, nullptr);
 
 	shaderData.buffer.destroy();
+	crowd.instanceBuffer.destroy();
 }
 
 void VulkanExample::getEnabledFeatures()
@@ -707,8 +783,19 @@ void VulkanExample::buildCommandBuffers()
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 		// Bind scene matrices descriptor to set 0
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
-		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		if (crowd.enabled && (glTFModel.bakedAnimation.descriptorSet != VK_NULL_HANDLE))
+		{
+			// POI: All instances are drawn with one instanced draw per primitive, their joint matrices are sampled from the baked animation
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.crowd);
+			VkDeviceSize offsets[1] = {0};
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], 1, 1, &crowd.instanceBuffer.buffer, offsets);
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout, static_cast<uint32_t>(crowd.instanceCount), glTFModel.bakedAnimation.descriptorSet);
+		}
+		else
+		{
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		}
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -830,11 +917,11 @@ void VulkanExample::setupDescriptors()
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 	    // One combined image sampler per material image/texture
 	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.images.size())),
-	    // One ssbo per skin
-	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size())),
+	    // One ssbo per skin + one for the baked crowd animation
+	    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(glTFModel.skins.size()) + 1),
 	};
-	// Number of descriptor sets = One for the scene ubo + one per image + one per skin
-	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 1;
+	// Number of descriptor sets = One for the scene ubo + one per image + one per skin + one for the baked crowd animation
+	const uint32_t             maxSetCount        = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.skins.size()) + 2;
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -844,15 +931,15 @@ void VulkanExample::setupDescriptors()
 
 	// Descriptor set layout for passing matrices
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.matrices));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.matrices));
 
 	// Descriptor set layout for passing material textures
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.textures));
 
 	// Descriptor set layout for passing skin joint matrices
 	setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.jointMatrices));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.jointMatrices));
 
 	// The pipeline layout uses three sets:
 	// Set 0 = Scene matrices (VS)
@@ -869,7 +956,7 @@ void VulkanExample::setupDescriptors()
 	// Push constant ranges are part of the pipeline layout
 	pipelineLayoutCI.pushConstantRangeCount = 1;
 	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
-	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+	VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 
 	// Descriptor set for scene matrices
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.matrices, 1);
@@ -886,6 +973,15 @@ void VulkanExample::setupDescriptors()
 		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 	}
 
+	// Descriptor set for the baked crowd animation, uses the same layout as the joint matrices of a skin
+	if (glTFModel.bakedAnimation.buffer.buffer != VK_NULL_HANDLE)
+	{
+		const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.jointMatrices, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &glTFModel.bakedAnimation.descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(glTFModel.bakedAnimation.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &glTFModel.bakedAnimation.buffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
 	// Descriptor sets for glTF model materials
 	for (auto &image : glTFModel.images)
 	{
@@ -927,7 +1023,7 @@ void VulkanExample::preparePipelines()
 	vertexInputStateCI.vertexAttributeDescriptionCount      = static_cast<uint32_t>(vertexInputAttributes.size());
 	vertexInputStateCI.pVertexAttributeDescriptions         = vertexInputAttributes.data();
 
-	const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
 	    loadShader(getShadersPath() + "gltfskinning/skinnedmodel.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
 	    loadShader(getShadersPath() + "gltfskinning/skinnedmodel.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)};
 
@@ -944,15 +1040,61 @@ void VulkanExample::preparePipelines()
 	pipelineCI.pStages                      = shaderStages.data();
 
 	// Solid rendering pipeline
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
 
 	// Wire frame rendering pipeline
 	if (deviceFeatures.fillModeNonSolid)
 	{
 		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
 		rasterizationStateCI.lineWidth   = 1.0f;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 	}
+
+	// Crowd rendering pipeline
+	// POI: Instance positions and animation offsets are passed in a second vertex binding with instance input rate
+	const std::vector<VkVertexInputBindingDescription> crowdInputBindings = {
+	    vks::initializers::vertexInputBindingDescription(0, sizeof(VulkanglTFModel::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+	    vks::initializers::vertexInputBindingDescription(1, sizeof(Crowd::InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE),
+	};
+	std::vector<VkVertexInputAttributeDescription> crowdInputAttributes = vertexInputAttributes;
+	crowdInputAttributes.push_back({6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Crowd::InstanceData, positionRotation)});
+	crowdInputAttributes.push_back({7, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(Crowd::InstanceData, animation)});
+	vertexInputStateCI.vertexBindingDescriptionCount   = static_cast<uint32_t>(crowdInputBindings.size());
+	vertexInputStateCI.pVertexBindingDescriptions      = crowdInputBindings.data();
+	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(crowdInputAttributes.size());
+	vertexInputStateCI.pVertexAttributeDescriptions    = crowdInputAttributes.data();
+	rasterizationStateCI.polygonMode                   = VK_POLYGON_MODE_FILL;
+	shaderStages[0]                                    = loadShader(getShadersPath() + "gltfskinning/crowd.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.crowd));
+}
+
+// Place the crowd instances on a grid around the origin with random orientations and animation offsets, and bake the animation they sample
+void VulkanExample::prepareCrowd()
+{
+	std::default_random_engine            rndEngine(benchmark.active ? 0 : (unsigned) time(nullptr));
+	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+
+	const float spacing = 1.0f;
+	std::vector<Crowd::InstanceData> instanceData(Crowd::maxInstances);
+	for (uint32_t i = 0; i < Crowd::maxInstances; i++)
+	{
+		// Instances fill the grid in growing squares starting at the origin, so lower instance counts still form a square block
+		const uint32_t ring   = static_cast<uint32_t>(std::sqrt(static_cast<float>(i)));
+		const uint32_t offset = i - ring * ring;
+		const float    x      = static_cast<float>(offset <= ring ? offset : ring);
+		const float    z      = static_cast<float>(offset <= ring ? ring : 2 * ring - offset);
+		instanceData[i].positionRotation = glm::vec4(x * spacing, 0.0f, z * spacing, glm::radians(rndDist(rndEngine) * 360.0f));
+		instanceData[i].animation        = glm::vec2(rndDist(rndEngine) * 10.0f, 0.8f + rndDist(rndEngine) * 0.4f);
+	}
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	    &crowd.instanceBuffer,
+	    instanceData.size() * sizeof(Crowd::InstanceData),
+	    instanceData.data()));
+
+	glTFModel.bakeAnimation(glTFModel.activeAnimation, 30.0f);
+	shaderData.values.crowdAnimation = glm::vec4(0.0f, glTFModel.bakedAnimation.frameRate, static_cast<float>(glTFModel.bakedAnimation.frameCount), static_cast<float>(glTFModel.bakedAnimation.jointCount));
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -964,6 +1106,7 @@ void VulkanExample::prepareUniformBuffers()
 
 void VulkanExample::updateUniformBuffers()
 {
+	waitForFramesInFlight();
 	shaderData.values.projection = camera.matrices.perspective;
 	shaderData.values.model      = camera.matrices.view;
 	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
@@ -978,6 +1121,7 @@ void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
 	loadAssets();
+	prepareCrowd();
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
@@ -988,14 +1132,25 @@ void VulkanExample::prepare()
 void VulkanExample::render()
 {
 	renderFrame();
-	if (camera.updated)
-	{
-		updateUniformBuffers();
-	}
 	// POI: Advance animation
 	if (!paused)
 	{
-		glTFModel.updateAnimation(frameTimer);
+		if (crowd.enabled)
+		{
+			// The instances are animated on the GPU, so only the crowd's time needs to be advanced
+			crowd.time += frameTimer;
+		}
+		else
+		{
+			// The joint matrices are stored in a single buffer per skin
+			waitForFramesInFlight();
+			glTFModel.updateAnimation(frameTimer);
+		}
+	}
+	shaderData.values.crowdAnimation.x = crowd.time;
+	if (camera.updated || crowd.enabled)
+	{
+		updateUniformBuffers();
 	}
 }
 
@@ -1007,6 +1162,17 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 		{
 			buildCommandBuffers();
 		}
+		if (overlay->checkBox("Crowd", &crowd.enabled))
+		{
+			buildCommandBuffers();
+		}
+		if (crowd.enabled)
+		{
+			if (overlay->sliderInt("Instances", &crowd.instanceCount, 1, static_cast<int32_t>(Crowd::maxInstances)))
+			{
+				buildCommandBuffers();
+			}
+		}
 	}
 }
 
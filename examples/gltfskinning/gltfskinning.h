@@ -171,6 +171,20 @@ class VulkanglTFModel
 
 	uint32_t activeAnimation = 0;
 
+	/*
+		Baked animation for crowd rendering
+		The joint matrices of one animation are sampled at a fixed rate at load time and stored frame after frame in a single storage buffer,
+		so any number of instances can be animated on the GPU by looking up (and interpolating) the frames at their own animation time
+	*/
+	struct BakedAnimation
+	{
+		vks::Buffer     buffer;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t        frameCount    = 0;
+		uint32_t        jointCount    = 0;
+		float           frameRate     = 30.0f;
+	} bakedAnimation;
+
 	~VulkanglTFModel();
 	void      loadImages(tinygltf::Model &input);
 	void      loadTextures(tinygltf::Model &input);
@@ -181,10 +195,14 @@ class VulkanglTFModel
 	void      loadAnimations(tinygltf::Model &input);
 	void      loadNode(const tinygltf::Node &inputNode, const tinygltf::Model &input, VulkanglTFModel::Node *parent, uint32_t nodeIndex, std::vector<uint32_t> &indexBuffer, std::vector<VulkanglTFModel::Vertex> &vertexBuffer);
 	glm::mat4 getNodeMatrix(VulkanglTFModel::Node *node);
+	void      getJointMatrices(VulkanglTFModel::Node *node, std::vector<glm::mat4> &jointMatrices);
 	void      updateJoints(VulkanglTFModel::Node *node);
+	void      applyAnimation(Animation &animation, float time);
 	void      updateAnimation(float deltaTime);
-	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
-	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	Node *    findSkinnedNode(Node *node);
+	void      bakeAnimation(uint32_t animationIndex, float frameRate);
+	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node, uint32_t instanceCount = 1, VkDescriptorSet jointDescriptorSet = VK_NULL_HANDLE);
+	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t instanceCount = 1, VkDescriptorSet jointDescriptorSet = VK_NULL_HANDLE);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -200,6 +218,8 @@ class VulkanExample : public VulkanExampleBase
 			glm::mat4 projection;
 			glm::mat4 model;
 			glm::vec4 lightPos = glm::vec4(5.0f, 5.0f, 5.0f, 1.0f);
+			// Crowd animation: x = time, y = frame rate, z = frame count, w = joint count of the baked animation
+			glm::vec4 crowdAnimation = glm::vec4(0.0f);
 		} values;
 	} shaderData;
 
@@ -208,8 +228,32 @@ class VulkanExample : public VulkanExampleBase
 	{
 		VkPipeline solid;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline crowd;
 	} pipelines;
 
+	/*
+		Crowd mode
+		Draws many instances of the character with a single instanced draw per primitive, each instance samples the baked animation on the GPU at its own time offset
+		The CPU only advances a single time value per frame, independent of the number of instances
+	*/
+	struct Crowd
+	{
+		bool enabled = false;
+		// Instances are placed on a square grid, the instance buffer is created for the maximum number of instances
+		static constexpr uint32_t maxInstances = 64 * 64;
+		int32_t instanceCount = 1024;
+		float time = 0.0f;
+		// Per instance data read from a vertex buffer with instance input rate
+		struct InstanceData
+		{
+			// xyz = position, w = rotation around the y axis
+			glm::vec4 positionRotation;
+			// x = animation time offset in seconds, y = playback speed
+			glm::vec2 animation;
+		};
+		vks::Buffer instanceBuffer;
+	} crowd;
+
 	struct DescriptorSetLayouts
 	{
 		VkDescriptorSetLayout matrices;
@@ -228,6 +272,7 @@ class VulkanExample : public VulkanExampleBase
 	void         loadAssets();
 	void         setupDescriptors();
 	void         preparePipelines();
+	void         prepareCrowd();
 	void         prepareUniformBuffers();
 	void         updateUniformBuffers();
 	void         prepare();
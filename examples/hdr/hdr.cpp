@@ -3,6 +3,9 @@
 *
 * Note: Requires the separate asset pack (see data/README.md)
 *
+* Auto exposure: Compute shaders build a histogram of the scene's log luminance and reduce it to an exposure that adapts over time,
+* the exposure stays in a GPU buffer that's read by the shaders, so there is no read back to the CPU
+*
 * Copyright by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -13,6 +16,8 @@
 
 #define ENABLE_VALIDATION false
 
+#define HISTOGRAM_BINS 256
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -41,9 +46,37 @@ public:
 	} uboVS;
 
 	struct UBOParams {
+		// Manual exposure, used if auto exposure is disabled
 		float exposure = 1.0f;
+		int32_t autoExposure = true;
+		// Range of the log2 luminance histogram
+		float minLogLuminance = -10.0f;
+		float logLuminanceRange = 20.0f;
+		float timeDelta = 0.0f;
+		// Speed at which the exposure adapts to luminance changes
+		float adaptationRate = 1.5f;
+		// Average scene luminance is exposed to this value
+		float exposureKey = 0.5f;
+		uint32_t pixelCount = 0;
 	} uboParams;
 
+	// Luminance data as laid out in the storage buffer (std430), written by the auto exposure compute shaders
+	struct LuminanceData {
+		float averageLuminance;
+		float exposure;
+		uint32_t histogram[HISTOGRAM_BINS];
+	};
+
+	// Auto exposure compute resources
+	struct {
+		vks::Buffer luminanceData;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipeline histogram;
+		VkPipeline exposure;
+	} autoExposure;
+
 	struct {
 		VkPipeline skybox;
 		VkPipeline reflect;
@@ -110,6 +143,8 @@ public:
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		// Environment cubes are loaded as BC6H or ASTC HDR if the device supports it and the asset pack contains the compressed variant
+		enableCompressedHDRTextures = true;
 	}
 
 	~VulkanExample()
@@ -128,6 +163,12 @@ public:
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bloomFilter, nullptr);
 
+		vkDestroyPipeline(device, autoExposure.histogram, nullptr);
+		vkDestroyPipeline(device, autoExposure.exposure, nullptr);
+		vkDestroyPipelineLayout(device, autoExposure.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, autoExposure.descriptorSetLayout, nullptr);
+		autoExposure.luminanceData.destroy();
+
 		vkDestroyRenderPass(device, offscreen.renderPass, nullptr);
 		vkDestroyRenderPass(device, filterPass.renderPass, nullptr);
 
@@ -218,6 +259,34 @@ public:
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			/*
+				Auto exposure: Luminance histogram of the HDR scene color and exposure adaptation
+			*/
+			if (uboParams.autoExposure) {
+				// Scene color written by the offscreen pass, luminance data written by the previous frame's exposure pass and read by its fragment shaders
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, autoExposure.pipelineLayout, 0, 1, &autoExposure.descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, autoExposure.histogram);
+				vkCmdDispatch(drawCmdBuffers[i], (offscreen.width + 15) / 16, (offscreen.height + 15) / 16, 1);
+
+				// The exposure pass reduces the complete histogram
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, autoExposure.exposure);
+				vkCmdDispatch(drawCmdBuffers[i], 1, 1, 1);
+
+				// The adapted exposure is read by the fragment shaders of the composition and of the next frame's offscreen pass
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+
 			/*
 				Second render pass: First bloom pass
 			*/
@@ -333,15 +402,8 @@ public:
 		image.tiling = VK_IMAGE_TILING_OPTIMAL;
 		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
 		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+		VK_CHECK_RESULT(vulkanDevice->allocateRenderTargetMemory(attachment->image, &attachment->mem));
 
 		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
 		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -441,7 +503,7 @@ public:
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
 
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreen.renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &offscreen.renderPass));
 
 			std::array<VkImageView, 3> attachments;
 			attachments[0] = offscreen.color[0].view;
@@ -534,7 +596,7 @@ public:
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
 
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &filterPass.renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &filterPass.renderPass));
 
 			std::array<VkImageView, 1> attachments;
 			attachments[0] = filterPass.color[0].view;
@@ -585,10 +647,11 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
 		};
-		uint32_t numDescriptorSets = 4;
+		uint32_t numDescriptorSets = 5;
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), numDescriptorSets);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -600,19 +663,20 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.models));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.models));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayouts.models,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.models));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.models));
 
 		// Bloom filter
 		setLayoutBindings = {
@@ -621,22 +685,37 @@ public:
 		};
 
 		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.bloomFilter));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.bloomFilter));
 
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.bloomFilter, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.bloomFilter));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.bloomFilter));
 
 		// G-Buffer composition
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 		};
 
 		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.composition));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.composition));
 
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.composition, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+
+		// Auto exposure (shared by the histogram and exposure compute pipelines)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+
+		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &autoExposure.descriptorSetLayout));
+
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&autoExposure.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &autoExposure.pipelineLayout));
 	}
 
 	void setupDescriptorSets()
@@ -654,6 +733,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposure.luminanceData.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -664,6 +744,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,&uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposure.luminanceData.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -694,6 +775,23 @@ public:
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposure.luminanceData.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Auto exposure descriptor set
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &autoExposure.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &autoExposure.descriptorSet));
+
+		colorDescriptors = {
+			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(autoExposure.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
+			vks::initializers::writeDescriptorSet(autoExposure.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(autoExposure.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &autoExposure.luminanceData.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -743,7 +841,7 @@ public:
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 		shaderStages[0] = loadShader(getShadersPath() + "hdr/composition.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "hdr/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
 
 		// Bloom pass
 		shaderStages[0] = loadShader(getShadersPath() + "hdr/bloom.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -763,12 +861,12 @@ public:
 		uint32_t dir = 1;
 		specializationInfo = vks::initializers::specializationInfo(1, specializationMapEntries.data(), sizeof(dir), &dir);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[0]));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[0]));
 
 		// Second blur pass (into separate framebuffer)
 		pipelineCI.renderPass = filterPass.renderPass;
 		dir = 0;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[1]));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[1]));
 
 		// Object rendering pipelines
 		// Use vertex input state from glTF model setup
@@ -789,7 +887,7 @@ public:
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		// Skybox pipeline (background cube)
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
 
 		// Object rendering pipeline
 		shadertype = 1;
@@ -798,7 +896,14 @@ public:
 		depthStencilState.depthTestEnable = VK_TRUE;
 		// Flip cull mode
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.reflect));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.reflect));
+
+		// Auto exposure compute pipelines
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(autoExposure.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "hdr/histogram.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &autoExposure.histogram));
+		computePipelineCI.stage = loadShader(getShadersPath() + "hdr/exposure.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &autoExposure.exposure));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -818,6 +923,25 @@ public:
 			&uniformBuffers.params,
 			sizeof(uboParams)));
 
+		// Luminance histogram and adapted exposure, only accessed by the GPU
+		LuminanceData luminanceData{};
+		luminanceData.averageLuminance = 1.0f;
+		luminanceData.exposure = uboParams.exposure;
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			sizeof(LuminanceData),
+			&luminanceData));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&autoExposure.luminanceData,
+			sizeof(LuminanceData)));
+		vulkanDevice->copyBuffer(&stagingBuffer, &autoExposure.luminanceData, queue);
+		stagingBuffer.destroy();
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.matrices.map());
 		VK_CHECK_RESULT(uniformBuffers.params.map());
@@ -828,6 +952,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelview = camera.matrices.view;
 		uboVS.inverseModelview = glm::inverse(camera.matrices.view);
@@ -836,6 +961,9 @@ public:
 
 	void updateParams()
 	{
+		waitForFramesInFlight();
+		uboParams.timeDelta = frameTimer;
+		uboParams.pixelCount = static_cast<uint32_t>(width * height);
 		memcpy(uniformBuffers.params.mapped, &uboParams, sizeof(uboParams));
 	}
 
@@ -869,6 +997,9 @@ public:
 		draw();
 		if (camera.updated)
 			updateUniformBuffers();
+		// Exposure adaptation depends on the frame time
+		if (uboParams.autoExposure)
+			updateParams();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -878,8 +1009,21 @@ public:
 				updateUniformBuffers();
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3)) {
+			if (overlay->checkBox("Auto exposure", &uboParams.autoExposure)) {
 				updateParams();
+				buildCommandBuffers();
+			}
+			if (uboParams.autoExposure) {
+				if (overlay->sliderFloat("Exposure key", &uboParams.exposureKey, 0.05f, 2.0f)) {
+					updateParams();
+				}
+				if (overlay->sliderFloat("Adaptation rate", &uboParams.adaptationRate, 0.1f, 10.0f)) {
+					updateParams();
+				}
+			} else {
+				if (overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3)) {
+					updateParams();
+				}
 			}
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
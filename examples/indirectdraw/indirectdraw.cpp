@@ -26,7 +26,7 @@
 #define INSTANCE_BUFFER_BIND_ID 1
 #define ENABLE_VALIDATION false
 
-// Number of instances per object
+// Default number of instances per object, can be changed with the -instancecount command line argument
 #if defined(__ANDROID__)
 #define OBJECT_INSTANCE_COUNT 1024
 // Circular range of plant distribution
@@ -87,6 +87,19 @@ public:
 	VkSampler samplerRepeat;
 
 	uint32_t objectCount = 0;
+	// Number of instances drawn per plant mesh
+	uint32_t instanceCount = OBJECT_INSTANCE_COUNT;
+	// Plants are distributed over a larger area for higher instance counts to keep the density (and overdraw) of the default count
+	float plantRadius = PLANT_RADIUS;
+	// Generate the instance data with a compute shader instead of on the CPU
+	bool gpuInstanceGeneration = true;
+
+	// Setup times (in ms), also reported with the benchmark results
+	struct {
+		double instanceGeneration = 0.0;
+		double instanceUpload = 0.0;
+		double indirectBuild = 0.0;
+	} setupTimes;
 
 	// Store the indirect draw commands containing index offsets and instance count per object
 	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
@@ -100,6 +113,13 @@ public:
 		camera.setTranslation(glm::vec3(0.4f, 1.25f, 0.0f));
 		camera.movementSpeed = 5.0f;
 		settings.overlay = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("instancecount", { "-ic", "--instancecount" }, 1, "Number of instances per plant mesh (defaults to " + std::to_string(OBJECT_INSTANCE_COUNT) + ")");
+		exampleArgs.add("instancegen", { "-ig", "--instancegen" }, 1, "Generate the instance data on the \"cpu\" or the \"gpu\" (default)");
+		exampleArgs.parse(args);
+		instanceCount = static_cast<uint32_t>(std::max(exampleArgs.getValueAsInt("instancecount", OBJECT_INSTANCE_COUNT), 1));
+		gpuInstanceGeneration = (exampleArgs.getValueAsString("instancegen", "gpu") != "cpu");
+		plantRadius = PLANT_RADIUS * std::max(sqrtf((float)instanceCount / (float)OBJECT_INSTANCE_COUNT), 1.0f);
 	}
 
 	~VulkanExample()
@@ -235,10 +255,10 @@ public:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -325,7 +345,7 @@ public:
 		// Indirect (and instanced) pipeline for the plants
 		shaderStages[0] = loadShader(getShadersPath() + "indirectdraw/indirectdraw.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "indirectdraw/indirectdraw.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.plants));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.plants));
 
 		// Only use non-instanced vertex attributes for models rendered without instancing
 		inputState.vertexBindingDescriptionCount = 1;
@@ -335,21 +355,34 @@ public:
 		shaderStages[0] = loadShader(getShadersPath() + "indirectdraw/ground.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "indirectdraw/ground.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ground));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ground));
 
 		// Skysphere
 		shaderStages[0] = loadShader(getShadersPath() + "indirectdraw/skysphere.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "indirectdraw/skysphere.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		depthStencilState.depthWriteEnable = VK_FALSE;
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.skysphere));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.skysphere));
 	}
 
 	// Prepare (and stage) a buffer containing the indirect draw commands
 	void prepareIndirectData()
 	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
 		indirectCommands.clear();
 
+		// The instance index of all draws has to fit into 32 bits
+		uint32_t meshCount = 0;
+		for (auto &node : models.plants.nodes)
+		{
+			if (node->mesh)
+			{
+				meshCount++;
+			}
+		}
+		instanceCount = std::min(instanceCount, UINT32_MAX / std::max(meshCount, 1u));
+
 		// Create on indirect command for node in the scene with a mesh attached to it
 		uint32_t m = 0;
 		for (auto &node : models.plants.nodes)
@@ -357,8 +390,8 @@ public:
 			if (node->mesh)
 			{
 				VkDrawIndexedIndirectCommand indirectCmd{};
-				indirectCmd.instanceCount = OBJECT_INSTANCE_COUNT;
-				indirectCmd.firstInstance = m * OBJECT_INSTANCE_COUNT;
+				indirectCmd.instanceCount = instanceCount;
+				indirectCmd.firstInstance = m * instanceCount;
 				// @todo: Multiple primitives
 				// A glTF node may consist of multiple primitives, so we may have to do multiple commands per mesh
 				indirectCmd.firstIndex = node->mesh->primitives[0]->firstIndex;
@@ -395,33 +428,161 @@ public:
 		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
 
 		stagingBuffer.destroy();
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		setupTimes.indirectBuild = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		benchmark.addSetupTime("indirectbuild", setupTimes.indirectBuild);
+	}
+
+	// Generate the instance data directly into the device local instance buffer using a compute shader
+	void generateInstanceData()
+	{
+		const VkDeviceSize instanceBufferSize = (VkDeviceSize)objectCount * sizeof(InstanceData);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&instanceBuffer,
+			instanceBufferSize));
+
+		// Large instance buffers may exceed the storage buffer range, so instances are generated in batches that each bind a part of the buffer
+		// Batches are a multiple of 256 instances (8 KB), which satisfies any storage buffer offset alignment
+		const VkDeviceSize maxBatchSize = std::min<VkDeviceSize>(vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(InstanceData), UINT32_MAX) & ~VkDeviceSize(255);
+		const uint32_t batchSize = static_cast<uint32_t>(std::max<VkDeviceSize>(maxBatchSize, 256));
+		const uint32_t batchCount = (objectCount + batchSize - 1) / batchSize;
+
+		// The generation pipeline is only used once, so its objects are released right after the dispatch
+		VkDescriptorPool descriptorPool;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, batchCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, batchCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		struct PushConstants {
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			uint32_t instancesPerObject;
+			uint32_t seed;
+			float radius;
+			uint32_t rowSize;
+		};
+
+		VkPipelineLayout pipelineLayout;
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkPipeline pipeline;
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "indirectdraw/instancegen.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		const uint32_t maxGroupCountX = vulkanDevice->properties.limits.maxComputeWorkGroupCount[0];
+		const uint32_t seed = benchmark.active ? 0 : (uint32_t)time(nullptr);
+		for (uint32_t batch = 0; batch < batchCount; batch++) {
+			PushConstants pushConstants;
+			pushConstants.firstInstance = batch * batchSize;
+			pushConstants.instanceCount = std::min(batchSize, objectCount - pushConstants.firstInstance);
+			pushConstants.instancesPerObject = instanceCount;
+			pushConstants.seed = seed;
+			pushConstants.radius = plantRadius;
+
+			VkDescriptorSet descriptorSet;
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			VkDescriptorBufferInfo instanceDescriptor = { instanceBuffer.buffer, (VkDeviceSize)pushConstants.firstInstance * sizeof(InstanceData), (VkDeviceSize)pushConstants.instanceCount * sizeof(InstanceData) };
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+			// Instance counts in the millions exceed the work group count limit of a single dimension, so the dispatch is split into rows
+			const uint32_t groupCount = (pushConstants.instanceCount + 255) / 256;
+			const uint32_t groupCountX = std::min(groupCount, maxGroupCountX);
+			const uint32_t groupCountY = (groupCount + groupCountX - 1) / groupCountX;
+			pushConstants.rowSize = groupCountX * 256;
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+		}
+
+		// Make the generated instances visible to vertex input
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		// The data is written in place, so there is no separate upload
+		setupTimes.instanceGeneration = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		setupTimes.instanceUpload = 0.0;
+
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 
 	// Prepare (and stage) a buffer containing instanced data for the mesh draws
 	void prepareInstanceData()
 	{
-		std::vector<InstanceData> instanceData;
-		instanceData.resize(objectCount);
-
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
-		std::uniform_real_distribution<float> uniformDist(0.0f, 1.0f);
-
-		for (uint32_t i = 0; i < objectCount; i++) {
-			float theta = 2 * float(M_PI) * uniformDist(rndEngine);
-			float phi = acos(1 - 2 * uniformDist(rndEngine));
-			instanceData[i].rot = glm::vec3(0.0f, float(M_PI) * uniformDist(rndEngine), 0.0f);
-			instanceData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * PLANT_RADIUS;
-			instanceData[i].scale = 1.0f + uniformDist(rndEngine) * 2.0f;
-			instanceData[i].texIndex = i / OBJECT_INSTANCE_COUNT;
+		if (gpuInstanceGeneration) {
+			generateInstanceData();
+		} else {
+			auto tStart = std::chrono::high_resolution_clock::now();
+
+			std::vector<InstanceData> instanceData;
+			instanceData.resize(objectCount);
+
+			std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+			std::uniform_real_distribution<float> uniformDist(0.0f, 1.0f);
+
+			for (uint32_t i = 0; i < objectCount; i++) {
+				float theta = 2 * float(M_PI) * uniformDist(rndEngine);
+				float phi = acos(1 - 2 * uniformDist(rndEngine));
+				instanceData[i].rot = glm::vec3(0.0f, float(M_PI) * uniformDist(rndEngine), 0.0f);
+				instanceData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * plantRadius;
+				instanceData[i].scale = 1.0f + uniformDist(rndEngine) * 2.0f;
+				instanceData[i].texIndex = i / instanceCount;
+			}
+
+			auto tGenerated = std::chrono::high_resolution_clock::now();
+			setupTimes.instanceGeneration = std::chrono::duration<double, std::milli>(tGenerated - tStart).count();
+
+			uploadInstanceData(instanceData);
+
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			setupTimes.instanceUpload = std::chrono::duration<double, std::milli>(tEnd - tGenerated).count();
 		}
+		benchmark.addSetupTime("instancegeneration", setupTimes.instanceGeneration);
+		benchmark.addSetupTime("instanceupload", setupTimes.instanceUpload);
+	}
 
+	// Stage instance data generated on the CPU to the device local instance buffer
+	void uploadInstanceData(const std::vector<InstanceData>& instanceData)
+	{
 		vks::Buffer stagingBuffer;
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
 			instanceData.size() * sizeof(InstanceData),
-			instanceData.data()));
+			(void*)instanceData.data()));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -449,6 +610,7 @@ public:
 
 	void updateUniformBuffer(bool viewChanged)
 	{
+		waitForFramesInFlight();
 		if (viewChanged)
 		{
 			uboVS.projection = camera.matrices.perspective;
@@ -509,6 +671,13 @@ public:
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Objects: %d", objectCount);
+			overlay->text("Instances per mesh: %d", instanceCount);
+			overlay->text("Instances generated on the %s", gpuInstanceGeneration ? "GPU" : "CPU");
+			overlay->text("Instance generation: %.2f ms", setupTimes.instanceGeneration);
+			if (!gpuInstanceGeneration) {
+				overlay->text("Instance upload: %.2f ms", setupTimes.instanceUpload);
+			}
+			overlay->text("Indirect buffer build: %.2f ms", setupTimes.indirectBuild);
 		}
 	}
 };
@@ -0,0 +1,320 @@
+/*
+* Vulkan Example - Mesh shaders with meshlet culling
+*
+* The scene's primitives are split into meshlets (small clusters of up to 64 vertices and 124 triangles) at load time
+* A task shader culls the meshlets of each primitive against the view frustum and their normal cones (i.e. meshlets that face away from the camera)
+* and only launches mesh shader workgroups for the visible ones. The regular vertex pipeline can be selected as a baseline for comparison
+*
+* Copyright (C) 2020 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "meshshader.h"
+
+VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+{
+	title = "Mesh shaders with meshlet culling";
+	apiVersion = VK_VERSION_1_1;
+	camera.type = Camera::CameraType::firstperson;
+	camera.flipY = true;
+	camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
+	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	camera.setRotationSpeed(0.25f);
+	settings.overlay = true;
+	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	enabledDeviceExtensions.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
+
+	CommandLineParser exampleArgs;
+	exampleArgs.add("vertexpipeline", { "-vp", "--vertexpipeline" }, 0, "Start with the vertex pipeline instead of the mesh shader pipeline");
+	exampleArgs.parse(args);
+	meshShading = !exampleArgs.isSet("vertexpipeline");
+}
+
+VulkanExample::~VulkanExample()
+{
+	vkDestroyPipeline(device, vertexPipelines.masked, nullptr);
+	vkDestroyPipeline(device, vertexPipelines.opaque, nullptr);
+	vkDestroyPipeline(device, meshPipelines.masked, nullptr);
+	vkDestroyPipeline(device, meshPipelines.opaque, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	shaderData.buffer.destroy();
+}
+
+void VulkanExample::getEnabledFeatures()
+{
+	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// POI
+	enabledMeshShaderFeatures = {};
+	enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+	enabledMeshShaderFeatures.taskShader = VK_TRUE;
+	enabledMeshShaderFeatures.meshShader = VK_TRUE;
+	deviceCreatepNextChain = &enabledMeshShaderFeatures;
+}
+
+void VulkanExample::buildCommandBuffers()
+{
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+	VkClearValue clearValues[2];
+	clearValues[0].color = { { 0.25f, 0.25f, 0.25f, 1.0f } };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+	renderPassBeginInfo.renderPass = renderPass;
+	renderPassBeginInfo.renderArea.offset.x = 0;
+	renderPassBeginInfo.renderArea.offset.y = 0;
+	renderPassBeginInfo.renderArea.extent.width = width;
+	renderPassBeginInfo.renderArea.extent.height = height;
+	renderPassBeginInfo.clearValueCount = 2;
+	renderPassBeginInfo.pClearValues = clearValues;
+
+	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+
+	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+	{
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		gpuProfiler.beginFrame(drawCmdBuffers[i]);
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
+		if (meshShading) {
+			// POI: Meshlets are fetched by the task and mesh shaders, so no vertex or index buffers are bound
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelines.opaque);
+			scene.drawMeshlets(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelines.masked);
+			scene.drawMeshlets(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+		} else {
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vertexPipelines.opaque);
+			scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vertexPipelines.masked);
+			scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+		}
+		gpuProfiler.endScope(drawCmdBuffers[i]);
+
+		gpuProfiler.beginScope(drawCmdBuffers[i], "UI");
+		drawUI(drawCmdBuffers[i]);
+		gpuProfiler.endScope(drawCmdBuffers[i]);
+
+		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+	}
+}
+
+void VulkanExample::loadAssets()
+{
+	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
+	// Meshlet bounds are calculated from the vertex buffer, so vertices need to be pre-transformed for culling them in world space
+	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::Meshlets);
+}
+
+void VulkanExample::setupDescriptors()
+{
+	// Pool
+	const std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+	// Descriptor set layout
+	const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		// Binding 0 : Scene uniform buffer
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		// Binding 1 : Meshlets (bounds and ranges)
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV, 1),
+		// Binding 2 : Meshlet vertex indices
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_NV, 2),
+		// Binding 3 : Meshlet triangles
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_NV, 3),
+		// Binding 4 : Model vertex buffer
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_MESH_BIT_NV, 4),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+	// Pipeline layout
+	const std::vector<VkDescriptorSetLayout> setLayouts = {
+		descriptorSetLayout,
+		vkglTF::descriptorSetLayoutImage,
+	};
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), 2);
+	// The meshlet range of the primitive is passed to the task and mesh shaders via push constants (see vkglTF::Model::drawMeshlets)
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_TASK_BIT_NV | VK_SHADER_STAGE_MESH_BIT_NV, 2 * sizeof(uint32_t), 0);
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+	// Descriptor set
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+	VkDescriptorBufferInfo vertexBufferDescriptor{ scene.vertices.buffer, 0, VK_WHOLE_SIZE };
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &shaderData.buffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &scene.meshlets.meshletBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &scene.meshlets.vertexIndexBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &scene.meshlets.triangleBuffer.descriptor),
+		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &vertexBufferDescriptor),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+}
+
+void VulkanExample::preparePipelines()
+{
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+	VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentStateCI);
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+	VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+	const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), static_cast<uint32_t>(dynamicStateEnables.size()), 0);
+	std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages;
+
+	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+	pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	pipelineCI.pRasterizationState = &rasterizationStateCI;
+	pipelineCI.pColorBlendState = &colorBlendStateCI;
+	pipelineCI.pMultisampleState = &multisampleStateCI;
+	pipelineCI.pViewportState = &viewportStateCI;
+	pipelineCI.pDepthStencilState = &depthStencilStateCI;
+	pipelineCI.pDynamicState = &dynamicStateCI;
+	pipelineCI.pStages = shaderStages.data();
+
+	// Properties for alpha masked materials will be passed via specialization constants
+	struct SpecializationData {
+		bool alphaMask;
+		float alphaMaskCutoff;
+	} specializationData;
+	specializationData.alphaMask = false;
+	specializationData.alphaMaskCutoff = 0.5f;
+	const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+		vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, alphaMask), sizeof(SpecializationData::alphaMask)),
+		vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, alphaMaskCutoff), sizeof(SpecializationData::alphaMaskCutoff)),
+	};
+	VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(specializationData), &specializationData);
+
+	// Vertex pipelines as baseline
+	pipelineCI.stageCount = 2;
+	pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent });
+	shaderStages[0] = loadShader(getShadersPath() + "meshshader/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+	shaderStages[1] = loadShader(getShadersPath() + "meshshader/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	shaderStages[1].pSpecializationInfo = &specializationInfo;
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &vertexPipelines.opaque));
+	specializationData.alphaMask = true;
+	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &vertexPipelines.masked));
+	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
+	specializationData.alphaMask = false;
+
+	// [POI] Mesh shader pipelines, vertex input and input assembly state are ignored as the mesh shader outputs the primitives
+	// Double sided (alpha masked) materials have their back faces visible, so cone culling is disabled in the task shader for these
+	VkBool32 taskConeCulling = VK_TRUE;
+	VkSpecializationMapEntry taskSpecializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(VkBool32));
+	VkSpecializationInfo taskSpecializationInfo = vks::initializers::specializationInfo(1, &taskSpecializationMapEntry, sizeof(VkBool32), &taskConeCulling);
+	pipelineCI.stageCount = 3;
+	pipelineCI.pVertexInputState = nullptr;
+	pipelineCI.pInputAssemblyState = nullptr;
+	shaderStages[0] = loadShader(getShadersPath() + "meshshader/meshlet.task.spv", VK_SHADER_STAGE_TASK_BIT_NV);
+	shaderStages[0].pSpecializationInfo = &taskSpecializationInfo;
+	shaderStages[1] = loadShader(getShadersPath() + "meshshader/meshlet.mesh.spv", VK_SHADER_STAGE_MESH_BIT_NV);
+	shaderStages[2] = loadShader(getShadersPath() + "meshshader/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	shaderStages[2].pSpecializationInfo = &specializationInfo;
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &meshPipelines.opaque));
+	specializationData.alphaMask = true;
+	taskConeCulling = VK_FALSE;
+	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &meshPipelines.masked));
+}
+
+void VulkanExample::prepareUniformBuffers()
+{
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&shaderData.buffer,
+		sizeof(shaderData.values)));
+	VK_CHECK_RESULT(shaderData.buffer.map());
+	updateUniformBuffers();
+}
+
+void VulkanExample::updateUniformBuffers()
+{
+	waitForFramesInFlight();
+	shaderData.values.projection = camera.matrices.perspective;
+	shaderData.values.view = camera.matrices.view;
+	// World space camera position, used for lighting and for culling meshlets against their normal cones
+	shaderData.values.viewPos = glm::inverse(camera.matrices.view)[3];
+	frustum.update(camera.matrices.perspective * camera.matrices.view);
+	memcpy(shaderData.values.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+	shaderData.values.frustumCulling = frustumCulling;
+	shaderData.values.coneCulling = coneCulling;
+	shaderData.values.colorMeshlets = colorMeshlets;
+	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
+}
+
+void VulkanExample::prepare()
+{
+	VulkanExampleBase::prepare();
+
+	// [POI]
+	meshShaderProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_NV;
+	VkPhysicalDeviceProperties2 deviceProperties2{};
+	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties2.pNext = &meshShaderProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+	// The meshlet sizes used by the glTF loader need to fit into the device's mesh shader output limits
+	if ((meshShaderProperties.maxMeshOutputVertices < vkglTF::Model::Meshlets::maxVertices) || (meshShaderProperties.maxMeshOutputPrimitives < vkglTF::Model::Meshlets::maxTriangles)) {
+		vks::tools::exitFatal("Selected GPU does not support the meshlet size of " + std::to_string(vkglTF::Model::Meshlets::maxVertices) + " vertices and " + std::to_string(vkglTF::Model::Meshlets::maxTriangles) + " triangles", -1);
+		return;
+	}
+
+	loadAssets();
+	prepareUniformBuffers();
+	setupDescriptors();
+	preparePipelines();
+	buildCommandBuffers();
+	prepared = true;
+}
+
+void VulkanExample::render()
+{
+	renderFrame();
+	if (camera.updated) {
+		updateUniformBuffers();
+	}
+}
+
+void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
+{
+	if (overlay->header("Settings")) {
+		if (overlay->checkBox("Mesh shaders", &meshShading)) {
+			buildCommandBuffers();
+		}
+		if (overlay->checkBox("Frustum culling", &frustumCulling)) {
+			updateUniformBuffers();
+		}
+		if (overlay->checkBox("Cone culling", &coneCulling)) {
+			updateUniformBuffers();
+		}
+		if (overlay->checkBox("Color meshlets", &colorMeshlets)) {
+			updateUniformBuffers();
+		}
+	}
+	if (overlay->header("Statistics")) {
+		overlay->text("Meshlets: %d", scene.meshlets.count);
+		overlay->text("Triangles: %d", scene.meshlets.triangleCount);
+		overlay->text("Triangles per meshlet: %.1f", (scene.meshlets.count > 0) ? (float)scene.meshlets.triangleCount / (float)scene.meshlets.count : 0.0f);
+	}
+}
+
+VULKAN_EXAMPLE_MAIN()
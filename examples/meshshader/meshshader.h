@@ -0,0 +1,68 @@
+/*
+* Vulkan Example - Mesh shaders with meshlet culling
+*
+* Copyright (C) 2020 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+	vks::Frustum frustum;
+
+	// Render the scene with task and mesh shaders, or with the regular vertex pipeline for comparison
+	bool meshShading = true;
+	bool frustumCulling = true;
+	bool coneCulling = true;
+	bool colorMeshlets = false;
+
+	struct ShaderData {
+		vks::Buffer buffer;
+		struct Values {
+			glm::mat4 projection;
+			glm::mat4 view;
+			glm::vec4 lightPos = glm::vec4(0.0f, 2.5f, 0.0f, 1.0f);
+			glm::vec4 viewPos;
+			glm::vec4 frustumPlanes[6];
+			uint32_t frustumCulling;
+			uint32_t coneCulling;
+			uint32_t colorMeshlets;
+		} values;
+	} shaderData;
+
+	struct Pipelines {
+		VkPipeline opaque;
+		VkPipeline masked;
+	};
+
+	Pipelines vertexPipelines;
+	Pipelines meshPipelines;
+
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VkPhysicalDeviceMeshShaderPropertiesNV meshShaderProperties{};
+	VkPhysicalDeviceMeshShaderFeaturesNV enabledMeshShaderFeatures{};
+
+	VulkanExample();
+	~VulkanExample();
+	virtual void getEnabledFeatures();
+	void buildCommandBuffers();
+	void loadAssets();
+	void setupDescriptors();
+	void preparePipelines();
+	void prepareUniformBuffers();
+	void updateUniformBuffers();
+	void prepare();
+	virtual void render();
+	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
+};
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanTemporalAA.h"
 
 #define ENABLE_VALIDATION false
 
@@ -29,6 +30,11 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool useSampleShading = false;
 	VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	// Render without multisampling and resolve the jittered frames temporally instead (selected with --temporalaa)
+	bool temporalAA = false;
+	vks::TemporalAA taa;
+	// Memory used by the anti-aliasing, for comparing both methods
+	VkDeviceSize multisampleMemorySize = 0;
 
 	vkglTF::Model model;
 
@@ -38,11 +44,15 @@ public:
 		glm::mat4 projection;
 		glm::mat4 model;
 		glm::vec4 lightPos = glm::vec4(5.0f, -5.0f, 5.0f, 1.0f);
+		// Temporal anti-aliasing: Previous frame's view projection and jitter (zw) for the velocity
+		glm::mat4 prevViewProjection;
+		glm::vec4 jitter = glm::vec4(0.0f);
 	} uboVS;
 
 	struct {
-		VkPipeline MSAA;
-		VkPipeline MSAASampleShading;
+		VkPipeline MSAA = VK_NULL_HANDLE;
+		VkPipeline MSAASampleShading = VK_NULL_HANDLE;
+		VkPipeline TAA = VK_NULL_HANDLE;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
@@ -52,11 +62,17 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Multisampling";
+		// The multisample targets (or the temporal anti-aliasing images) are recreated in place when the window is resized, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 		camera.setTranslation(glm::vec3(2.5f, 2.5f, -7.5f));
 		settings.overlay = true;
+		temporalAA = commandLineParser.isSet("temporalaa");
+		if (temporalAA) {
+			title += " (temporal anti-aliasing)";
+		}
 	}
 
 	~VulkanExample()
@@ -65,6 +81,8 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.MSAA, nullptr);
 		vkDestroyPipeline(device, pipelines.MSAASampleShading, nullptr);
+		vkDestroyPipeline(device, pipelines.TAA, nullptr);
+		taa.destroy();
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -132,6 +150,7 @@ public:
 			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		}
 		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &multisampleTarget.color.memory));
+		multisampleMemorySize = memReqs.size;
 		vkBindImageMemory(device, multisampleTarget.color.image, multisampleTarget.color.memory, 0);
 
 		// Create image view for the MSAA target
@@ -177,6 +196,7 @@ public:
 		}
 
 		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &multisampleTarget.depth.memory));
+		multisampleMemorySize += memReqs.size;
 		vkBindImageMemory(device, multisampleTarget.depth.image, multisampleTarget.depth.memory, 0);
 
 		// Create image view for the MSAA target
@@ -201,6 +221,12 @@ public:
 	{
 		// Overrides the virtual function of the base class
 
+		// Temporal anti-aliasing uses the default render pass for its output
+		if (temporalAA) {
+			VulkanExampleBase::setupRenderPass();
+			return;
+		}
+
 		std::array<VkAttachmentDescription, 3> attachments = {};
 
 		// Multisampled attachment that we render to
@@ -281,7 +307,7 @@ public:
 		renderPassInfo.dependencyCount = 2;
 		renderPassInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 	}
 
 	// Frame buffer attachments must match with render pass setup,
@@ -291,6 +317,11 @@ public:
 	{
 		// Overrides the virtual function of the base class
 
+		if (temporalAA) {
+			VulkanExampleBase::setupFrameBuffer();
+			return;
+		}
+
 		std::array<VkImageView, 3> attachments;
 
 		setupMultisampleTarget();
@@ -327,12 +358,16 @@ public:
 		clearValues[0].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
 		clearValues[1].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
 		clearValues[2].depthStencil = { 1.0f, 0 };
+		if (temporalAA) {
+			// The default render pass has no resolve attachment
+			clearValues[1].depthStencil = { 1.0f, 0 };
+		}
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = renderPass;
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 3;
+		renderPassBeginInfo.clearValueCount = temporalAA ? 2 : 3;
 		renderPassBeginInfo.pClearValues = clearValues;
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
@@ -342,17 +377,52 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, useSampleShading ? pipelines.MSAASampleShading : pipelines.MSAA);
-			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
+			if (temporalAA) {
+				// Render the jittered scene and its velocity to the images of the resolve stage
+				VkClearValue sceneClearValues[3];
+				sceneClearValues[0].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+				sceneClearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+				sceneClearValues[2].depthStencil = { 1.0f, 0 };
+				VkRenderPassBeginInfo sceneRenderPassBeginInfo = renderPassBeginInfo;
+				sceneRenderPassBeginInfo.renderPass = taa.renderPass;
+				sceneRenderPassBeginInfo.framebuffer = taa.framebuffer;
+				sceneRenderPassBeginInfo.clearValueCount = 3;
+				sceneRenderPassBeginInfo.pClearValues = sceneClearValues;
+
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &sceneRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.TAA);
+				model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Temporal resolve");
+				taa.resolve(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Sharpen");
+				taa.sharpen(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+			} else {
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				// Includes the resolve at the end of the render pass
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Scene");
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, useSampleShading ? pipelines.MSAASampleShading : pipelines.MSAA);
+				model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -392,7 +462,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Layout uses set 0 for passing vertex shader ubo and set 1 for fragment shader images (taken from glTF model)
 		const std::vector<VkDescriptorSetLayout> setLayouts = {
@@ -400,7 +470,7 @@ public:
 			vkglTF::descriptorSetLayoutImage,
 		};
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), 2);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -444,10 +514,22 @@ public:
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color });
 
+		if (temporalAA) {
+			// Temporal anti-aliasing pipeline, renders to the color and velocity attachments of the resolve stage's scene render pass
+			std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = { blendAttachmentState, blendAttachmentState };
+			colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+			colorBlendState.pAttachments = blendAttachmentStates.data();
+			pipelineCI.renderPass = taa.renderPass;
+			shaderStages[0] = loadShader(getShadersPath() + "multisampling/mesh_taa.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "multisampling/mesh_taa.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.TAA));
+			return;
+		}
+
 		// MSAA rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "multisampling/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "multisampling/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.MSAA));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.MSAA));
 
 		if (vulkanDevice->features.sampleRateShading)
 		{
@@ -459,7 +541,7 @@ public:
 			multisampleState.sampleShadingEnable = VK_TRUE;
 			// Minimum fraction for sample shading
 			multisampleState.minSampleShading = 0.25f;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.MSAASampleShading));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.MSAASampleShading));
 		}
 	}
 
@@ -476,11 +558,24 @@ public:
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffer.map());
 
+		// No motion in the first frame
+		uboVS.projection = camera.matrices.perspective;
+		uboVS.model = camera.matrices.view;
 		updateUniformBuffers();
 	}
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
+		if (temporalAA) {
+			// Keep the previous (jittered) view projection and jitter for the velocity and move on to the next sub-pixel offset
+			uboVS.prevViewProjection = uboVS.projection * uboVS.model;
+			uboVS.jitter.z = uboVS.jitter.x;
+			uboVS.jitter.w = uboVS.jitter.y;
+			taa.nextFrame();
+			taa.getJitter(uboVS.jitter.x, uboVS.jitter.y);
+			camera.setJitter(glm::vec2(uboVS.jitter.x, uboVS.jitter.y));
+		}
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.model = camera.matrices.view;
 		memcpy(uniformBuffer.mapped, &uboVS, sizeof(uboVS));
@@ -502,9 +597,19 @@ public:
 
 	void prepare()
 	{
-		sampleCount = getMaxUsableSampleCount();
+		sampleCount = temporalAA ? VK_SAMPLE_COUNT_1_BIT : getMaxUsableSampleCount();
 		UIOverlay.rasterizationSamples = sampleCount;
 		VulkanExampleBase::prepare();
+		if (temporalAA) {
+			taa.prepare(vulkanDevice, swapChain.colorFormat, depthFormat, {
+				loadShader(getShadersPath() + "base/upscale.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+				loadShader(getShadersPath() + "base/taaresolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+			}, {
+				loadShader(getShadersPath() + "base/upscale.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+				loadShader(getShadersPath() + "base/upscale.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+			}, renderPass, pipelineCache);
+			taa.resize(width, height, depthStencil.view, queue);
+		}
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -520,11 +625,20 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (camera.updated) {
+		// The jitter changes every frame
+		if (camera.updated || temporalAA) {
 			updateUniformBuffers();
 		}
 	}
 
+	virtual void windowResized()
+	{
+		if (temporalAA) {
+			taa.resize(width, height, depthStencil.view, queue);
+			buildCommandBuffers();
+		}
+	}
+
 	// Returns the maximum sample count usable by the platform
 	VkSampleCountFlagBits getMaxUsableSampleCount()
 	{
@@ -540,7 +654,20 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		if (vulkanDevice->features.sampleRateShading) {
+		if (overlay->header("Anti-aliasing")) {
+			if (temporalAA) {
+				overlay->text("Temporal, %.1f MB", static_cast<float>(taa.getMemorySize()) / (1024.0f * 1024.0f));
+				if (overlay->sliderFloat("Feedback", &taa.feedback, 0.5f, 0.97f)) {
+					buildCommandBuffers();
+				}
+				if (overlay->sliderFloat("Sharpness", &taa.sharpness, 0.0f, 1.0f)) {
+					buildCommandBuffers();
+				}
+			} else {
+				overlay->text("%dx MSAA, %.1f MB", sampleCount, static_cast<float>(multisampleMemorySize) / (1024.0f * 1024.0f));
+			}
+		}
+		if (vulkanDevice->features.sampleRateShading && !temporalAA) {
 			if (overlay->header("Settings")) {
 				if (overlay->checkBox("Sample rate shading", &useSampleShading)) {
 					buildCommandBuffers();
@@ -8,7 +8,7 @@
 
 #include "vulkanexamplebase.h"
 
-#include "threadpool.hpp"
+#include "jobsystem.hpp"
 #include "frustum.hpp"
 
 #include "VulkanglTFModel.h"
@@ -38,17 +38,11 @@ public:
 
 	VkPipelineLayout pipelineLayout;
 
-	VkCommandBuffer primaryCommandBuffer;
-
-	// Secondary scene command buffers used to store backdrop and user interface
-	struct SecondaryCommandBuffers {
-		VkCommandBuffer background;
-		VkCommandBuffer ui;
-	} secondaryCommandBuffers;
-
-	// Number of animated objects to be renderer
-	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	// Number of animated objects to be rendered
+	// by using threads and secondary command buffers (can be changed with -o / --objects)
+	int32_t numObjects = 512;
+	// Number of objects recorded into a single secondary command buffer by one job, scales with the object count
+	uint32_t numObjectsPerChunk = 16;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
@@ -73,25 +67,47 @@ public:
 		bool visible = true;
 	};
 
+	// Objects are distributed dynamically by the job system, so jobs record their secondary command buffers
+	// from the command pool of the worker thread they're executed on
 	struct ThreadData {
 		VkCommandPool commandPool;
-		// One command buffer per render object
+		// Secondary command buffers allocated from this thread's pool, reset as a whole once the frame is reused
 		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+		uint32_t usedCommandBuffers = 0;
+	};
+
+	// Command buffers of a frame in flight, recorded each frame
+	struct FrameData {
+		VkCommandBuffer primaryCommandBuffer;
+		// Secondary scene command buffers used to store backdrop and user interface
+		VkCommandBuffer background;
+		VkCommandBuffer ui;
+		// One command pool per thread
+		std::vector<ThreadData> threadData;
 	};
-	std::vector<ThreadData> threadData;
+	std::vector<FrameData> frames;
+	// Frame whose command buffers are currently recorded
+	FrameData* recordingFrame = nullptr;
 
-	vks::ThreadPool threadPool;
+	// One push constant block per render object
+	std::vector<ThreadPushConstantBlock> pushConstBlock;
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objectData;
+	// Secondary command buffer of each chunk of objects for the current frame, VK_NULL_HANDLE if no object of the chunk is visible
+	std::vector<VkCommandBuffer> chunkCommandBuffers;
 
-	// Fence to wait for all command buffers to finish before
-	// presenting to the swap chain
-	VkFence renderFence = {};
+	vks::JobSystem jobSystem;
 
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
+	// Bounding spheres of the objects in structure of arrays layout for the batched frustum test, y is updated by the animation
+	struct {
+		std::vector<float> x, y, z, radius;
+		// One bit per object, set if the object is inside the view frustum
+		std::vector<uint32_t> visibility;
+	} culling;
+	// Number of objects tested by a single culling job, needs to be a multiple of 32 so jobs write separate words of the visibility mask
+	const uint32_t numObjectsPerCullingJob = 4096;
 
 	std::default_random_engine rndEngine;
 
@@ -104,17 +120,21 @@ public:
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
-		// Get number of max. concurrent threads
-		numThreads = std::thread::hardware_concurrency();
-		assert(numThreads > 0);
+		// The job system uses all hardware threads, including the main thread
+		numThreads = jobSystem.workerCount();
 #if defined(__ANDROID__)
 		LOGD("numThreads = %d", numThreads);
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		// Allow measuring how recording scales with the number of objects
+		CommandLineParser exampleArgs;
+		exampleArgs.add("objects", { "-o", "--objects" }, 1, "Number of objects to render");
+		exampleArgs.parse(args);
+		if (exampleArgs.isSet("objects")) {
+			numObjects = std::max(exampleArgs.getValueAsInt("objects", numObjects), 1);
+		}
 	}
 
 	~VulkanExample()
@@ -126,12 +146,12 @@ public:
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
-			vkDestroyCommandPool(device, thread.commandPool, nullptr);
+		// Destroying the pools also frees their command buffers
+		for (auto& frame : frames) {
+			for (auto& thread : frame.threadData) {
+				vkDestroyCommandPool(device, thread.commandPool, nullptr);
+			}
 		}
-
-		vkDestroyFence(device, renderFence, nullptr);
 	}
 
 	float rnd(float range)
@@ -140,135 +160,169 @@ public:
 		return rndDist(rndEngine);
 	}
 
-	// Create all threads and initialize shader push constants
+	// Create the per frame command buffers and command pools
 	void prepareMultiThreadedRenderer()
 	{
 		// Since this demo updates the command buffers on each frame
 		// we don't use the per-framebuffer command buffers from the
-		// base class, and create a single primary command buffer instead
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(
-				cmdPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				1);
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &primaryCommandBuffer));
-
-		// Create additional secondary CBs for background and ui
-		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
-
-		threadData.resize(numThreads);
-
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
-
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
-
-			// Create one command pool for each thread
-			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
-			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
-
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
-			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
+		// base class, and create primary command buffers for each frame in flight instead
+		frames.resize(maxFramesInFlight);
+		for (auto& frame : frames) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 				vks::initializers::commandBufferAllocateInfo(
-					thread->commandPool,
-					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
-
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+					cmdPool,
+					VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.primaryCommandBuffer));
+
+			// Create additional secondary CBs for background and ui
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.background));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.ui));
+
+			frame.threadData.resize(numThreads);
+			for (auto& thread : frame.threadData) {
+				// Create one command pool for each thread, its command buffers are only reset as a whole
+				VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+				cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+				cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
 			}
 		}
 
+		prepareObjects();
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Initialize the per object data and shader push constants
+	void prepareObjects()
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		pushConstBlock.resize(numObjects);
+		objectData.resize(numObjects);
+		// Use a few chunks per thread, but at least 16 objects per chunk to keep the number of executed secondary command buffers low
+		numObjectsPerChunk = std::max(16u, static_cast<uint32_t>(numObjects) / (numThreads * 4));
+		chunkCommandBuffers.resize((numObjects + numObjectsPerChunk - 1) / numObjectsPerChunk);
+		culling.x.resize(numObjects);
+		culling.y.resize(numObjects);
+		culling.z.resize(numObjects);
+		culling.radius.assign(numObjects, models.ufo.dimensions.radius * 0.5f);
+		culling.visibility.resize((numObjects + 31) / 32);
+
+		for (int32_t j = 0; j < numObjects; j++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
+			culling.x[j] = objectData[j].pos.x;
+			culling.y[j] = objectData[j].pos.y;
+			culling.z[j] = objectData[j].pos.z;
+
+			objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			objectData[j].deltaT = rnd(1.0f);
+			objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * objectData[j].rotationDir;
+			objectData[j].scale = 0.75f + rnd(0.5f);
+
+			pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+		}
+	}
 
-		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+	// Tests the bounding spheres of all objects against the view frustum, four at a time, split into jobs for large object counts
+	void cullObjects()
+	{
+		jobSystem.parallelFor(numObjects, [&](uint32_t begin, uint32_t end) {
+			frustum.checkSpheres(&culling.x[begin], &culling.y[begin], &culling.z[begin], &culling.radius[begin], end - begin, &culling.visibility[begin / 32]);
+		}, numObjectsPerCullingJob);
+	}
 
-		if (!objectData->visible)
-		{
-			return;
+	// Returns an unused secondary command buffer from the given thread's pool of the frame that is being recorded
+	VkCommandBuffer getThreadCommandBuffer(uint32_t threadIndex)
+	{
+		ThreadData *thread = &recordingFrame->threadData[threadIndex];
+		if (thread->usedCommandBuffers == thread->commandBuffer.size()) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread->commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VkCommandBuffer cmdBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cmdBuffer));
+			thread->commandBuffer.push_back(cmdBuffer);
 		}
+		return thread->commandBuffer[thread->usedCommandBuffers++];
+	}
 
-		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+	// Builds the secondary command buffer for a chunk of objects, called by the job system on any of its threads
+	void threadRenderCode(uint32_t chunkIndex, uint32_t firstObject, uint32_t lastObject, VkCommandBufferInheritanceInfo inheritanceInfo)
+	{
+		VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
+		for (uint32_t objectIndex = firstObject; objectIndex < lastObject; objectIndex++) {
+			ObjectData *object = &objectData[objectIndex];
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
+			// Visibility against the view frustum has been determined for all objects before recording (see cullObjects)
+			object->visible = (culling.visibility[objectIndex >> 5] >> (objectIndex & 31)) & 1;
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+			if (!object->visible)
+			{
+				continue;
+			}
 
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+			// The command buffer is only started once the first visible object of the chunk is found
+			if (cmdBuffer == VK_NULL_HANDLE) {
+				VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+				commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+				cmdBuffer = getThreadCommandBuffer(jobSystem.workerIndex());
+
+				VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
+
+				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+				vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+				vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		// Update
-		if (!paused) {
-			objectData->rotation.y += 2.5f * objectData->rotationSpeed * frameTimer;
-			if (objectData->rotation.y > 360.0f) {
-				objectData->rotation.y -= 360.0f;
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+
+				VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 			}
-			objectData->deltaT += 0.15f * frameTimer;
-			if (objectData->deltaT > 1.0f)
-				objectData->deltaT -= 1.0f;
-			objectData->pos.y = sin(glm::radians(objectData->deltaT * 360.0f)) * 2.5f;
-		}
 
-		objectData->model = glm::translate(glm::mat4(1.0f), objectData->pos);
-		objectData->model = glm::rotate(objectData->model, -sinf(glm::radians(objectData->deltaT * 360.0f)) * 0.25f, glm::vec3(objectData->rotationDir, 0.0f, 0.0f));
-		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->rotation.y), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
-		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
-		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
+			// Update
+			if (!paused) {
+				object->rotation.y += 2.5f * object->rotationSpeed * frameTimer;
+				if (object->rotation.y > 360.0f) {
+					object->rotation.y -= 360.0f;
+				}
+				object->deltaT += 0.15f * frameTimer;
+				if (object->deltaT > 1.0f)
+					object->deltaT -= 1.0f;
+				object->pos.y = sin(glm::radians(object->deltaT * 360.0f)) * 2.5f;
+				culling.y[objectIndex] = object->pos.y;
+			}
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+			object->model = glm::translate(glm::mat4(1.0f), object->pos);
+			object->model = glm::rotate(object->model, -sinf(glm::radians(object->deltaT * 360.0f)) * 0.25f, glm::vec3(object->rotationDir, 0.0f, 0.0f));
+			object->model = glm::rotate(object->model, glm::radians(object->rotation.y), glm::vec3(0.0f, object->rotationDir, 0.0f));
+			object->model = glm::rotate(object->model, glm::radians(object->deltaT * 360.0f), glm::vec3(0.0f, object->rotationDir, 0.0f));
+			object->model = glm::scale(object->model, glm::vec3(object->scale));
 
-		// Update shader push constant block
-		// Contains model view matrix
-		vkCmdPushConstants(
-			cmdBuffer,
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			pushConstBlock[objectIndex].mvp = matrices.projection * matrices.view * object->model;
+
+			// Update shader push constant block
+			// Contains model view matrix
+			vkCmdPushConstants(
+				cmdBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				0,
+				sizeof(ThreadPushConstantBlock),
+				&pushConstBlock[objectIndex]);
 
-		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
+			vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
+		}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		if (cmdBuffer != VK_NULL_HANDLE) {
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		}
+		chunkCommandBuffers[chunkIndex] = cmdBuffer;
 	}
 
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
@@ -285,28 +339,28 @@ public:
 			Background
 		*/
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.background, &commandBufferBeginInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(recordingFrame->background, &commandBufferBeginInfo));
 
-		vkCmdSetViewport(secondaryCommandBuffers.background, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.background, 0, 1, &scissor);
+		vkCmdSetViewport(recordingFrame->background, 0, 1, &viewport);
+		vkCmdSetScissor(recordingFrame->background, 0, 1, &scissor);
 
-		vkCmdBindPipeline(secondaryCommandBuffers.background, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
+		vkCmdBindPipeline(recordingFrame->background, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
 
 		glm::mat4 mvp = matrices.projection * matrices.view;
 		mvp[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 		mvp = glm::scale(mvp, glm::vec3(2.0f));
 
 		vkCmdPushConstants(
-			secondaryCommandBuffers.background,
+			recordingFrame->background,
 			pipelineLayout,
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(mvp),
 			&mvp);
 
-		models.starSphere.draw(secondaryCommandBuffers.background);
+		models.starSphere.draw(recordingFrame->background);
 		
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.background));
+		VK_CHECK_RESULT(vkEndCommandBuffer(recordingFrame->background));
 
 		/*
 			User interface
@@ -315,25 +369,28 @@ public:
 			by secondary command buffers, which also applies to the UI overlay command buffer
 		*/
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.ui, &commandBufferBeginInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(recordingFrame->ui, &commandBufferBeginInfo));
 
-		vkCmdSetViewport(secondaryCommandBuffers.ui, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.ui, 0, 1, &scissor);
+		vkCmdSetViewport(recordingFrame->ui, 0, 1, &viewport);
+		vkCmdSetScissor(recordingFrame->ui, 0, 1, &scissor);
 
-		vkCmdBindPipeline(secondaryCommandBuffers.ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
+		vkCmdBindPipeline(recordingFrame->ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
 
 		if (settings.overlay) {
-			drawUI(secondaryCommandBuffers.ui);
+			drawUI(recordingFrame->ui);
 		}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.ui));
+		VK_CHECK_RESULT(vkEndCommandBuffer(recordingFrame->ui));
 	}
 
 	// Updates the secondary command buffers using a thread pool
 	// and puts them into the primary command buffer that's
 	// lat submitted to the queue for rendering
-	void updateCommandBuffers(VkFramebuffer frameBuffer)
+	void updateCommandBuffers(FrameData& frame, VkFramebuffer frameBuffer)
 	{
+		recordingFrame = &frame;
+		VkCommandBuffer primaryCommandBuffer = frame.primaryCommandBuffer;
+
 		// Contains the list of secondary command buffers to be submitted
 		std::vector<VkCommandBuffer> commandBuffers;
 
@@ -371,35 +428,35 @@ public:
 		updateSecondaryCommandBuffers(inheritanceInfo);
 
 		if (displayStarSphere) {
-			commandBuffers.push_back(secondaryCommandBuffers.background);
+			commandBuffers.push_back(recordingFrame->background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
-			}
+		// The fence of this frame in flight has been waited on by prepareFrame, so all of its secondary command buffers can be recycled at once
+		// Resetting the whole pool is cheaper than resetting (or freeing) each command buffer and keeps its memory for reuse
+		for (auto& thread : frame.threadData) {
+			VK_CHECK_RESULT(vkResetCommandPool(device, thread.commandPool, 0));
+			thread.usedCommandBuffers = 0;
 		}
 
-		threadPool.wait();
+		cullObjects();
+
+		// Record the objects in chunks, idle threads steal chunks from busy ones so uneven costs (e.g. culled objects) balance out
+		jobSystem.parallelFor(numObjects, [&](uint32_t begin, uint32_t end) {
+			threadRenderCode(begin / numObjectsPerChunk, begin, end, inheritanceInfo);
+		}, numObjectsPerChunk);
 
-		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
+		// Only submit chunks with objects within the current view frustum
+		for (auto cmdBuffer : chunkCommandBuffers)
 		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
+			if (cmdBuffer != VK_NULL_HANDLE)
 			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
-				}
+				commandBuffers.push_back(cmdBuffer);
 			}
 		}
 
 		// Render ui last
 		if (UIOverlay.visible) {
-			commandBuffers.push_back(secondaryCommandBuffers.ui);
+			commandBuffers.push_back(recordingFrame->ui);
 		}
 
 		// Execute render commands from the secondary command buffer
@@ -433,7 +490,7 @@ public:
 		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void preparePipelines()
@@ -464,14 +521,14 @@ public:
 		// Object rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "multithreading/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "multithreading/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
 
 		// Star sphere rendering pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		depthStencilState.depthWriteEnable = VK_FALSE;
 		shaderStages[0] = loadShader(getShadersPath() + "multithreading/starsphere.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "multithreading/starsphere.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.starsphere));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.starsphere));
 	}
 
 	void updateMatrices()
@@ -483,22 +540,16 @@ public:
 
 	void draw()
 	{
-		// Wait for fence to signal that all command buffers are ready
-		VkResult fenceRes;
-		do {
-			fenceRes = vkWaitForFences(device, 1, &renderFence, VK_TRUE, 100000000);
-		} while (fenceRes == VK_TIMEOUT);
-		VK_CHECK_RESULT(fenceRes);
-		vkResetFences(device, 1, &renderFence);
-
+		// Waits for the fence of the current frame in flight, so its command buffers are no longer in use
 		VulkanExampleBase::prepareFrame();
 
-		updateCommandBuffers(frameBuffers[currentBuffer]);
+		FrameData& frame = frames[currentFrame];
+		updateCommandBuffers(frame, frameBuffers[currentBuffer]);
 
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &primaryCommandBuffer;
+		submitInfo.pCommandBuffers = &frame.primaryCommandBuffer;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -506,9 +557,6 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		// Create a fence for synchronization
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-		vkCreateFence(device, &fenceCreateInfo, nullptr, &renderFence);
 		loadAssets();
 		setupPipelineLayout();
 		preparePipelines();
@@ -532,9 +580,18 @@ public:
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			if (vks::CpuTopology::get().heterogeneous()) {
+				overlay->text("Big cores: %d of %d", vks::CpuTopology::get().bigCoreCount(), vks::CpuTopology::get().coreCount());
+			}
+			overlay->text("Objects per chunk: %d", numObjectsPerChunk);
+			overlay->text("Chunks: %d", static_cast<int32_t>(chunkCommandBuffers.size()));
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			// Command buffers are recorded every frame, so changing the object count doesn't require any waiting
+			if (overlay->sliderInt("Objects", &numObjects, 64, 16384)) {
+				prepareObjects();
+			}
 		}
 
 	}
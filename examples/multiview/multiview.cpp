@@ -2,6 +2,7 @@
 * Vulkan Example - Multiview (VK_KHR_multiview)
 *
 * Uses VK_KHR_multiview for simultaneously rendering to multiple views and displays these with barrel distortion using a fragment shader
+* Optionally uses a per view fragment density map (VK_EXT_fragment_density_map) for fixed foveated rendering and culls the scene against a single frustum enclosing both eyes
 *
 * Copyright (C) 2018 by Sascha Willems - www.saschawillems.de
 *
@@ -29,8 +30,33 @@ public:
 		VkSemaphore semaphore;
 		std::vector<VkCommandBuffer> commandBuffers;
 		std::vector<VkFence> waitFences;
+		// Size of the layered attachments, these are not recreated when the window is resized
+		VkExtent2D extent;
 	} multiviewPass;
 
+	/*
+		Fixed foveated rendering
+		The density map has one layer per view, so each eye gets full density around its lens center and a lower density towards the periphery
+	*/
+	struct DensityMap {
+		bool supported = false;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkExtent2D extent{};
+	} densityMap;
+	VkPhysicalDeviceFragmentDensityMapFeaturesEXT fragmentDensityMapFeatures{};
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures{};
+	bool foveation = true;
+	// Radius of the full density region, relative to the view's half extent
+	float fovealRadius = 0.4f;
+	// Density used outside of the transition band around the full density region
+	float peripheralDensity = 0.25f;
+
+	// Both views are culled against a single frustum enclosing the frusta of the two eyes
+	bool stereoCulling = true;
+	glm::mat4 cullingViewProjection;
+
 	vkglTF::Model scene;
 
 	struct UBO {
@@ -72,6 +98,43 @@ public:
 		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+		multiviewFeatures.multiview = VK_TRUE;
+		deviceCreatepNextChain = &multiviewFeatures;
+
+		// Foveation is optional and only used if the density map can be applied to attachments that are not subsampled
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		bool extensionSupported = false;
+		for (auto& extension : extensions) {
+			extensionSupported |= (strcmp(extension.extensionName, VK_EXT_FRAGMENT_DENSITY_MAP_EXTENSION_NAME) == 0);
+		}
+		if (extensionSupported) {
+			fragmentDensityMapFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_DENSITY_MAP_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			deviceFeatures2.pNext = &fragmentDensityMapFeatures;
+			PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+			vkGetPhysicalDeviceFeatures2KHR(physicalDevice, &deviceFeatures2);
+			densityMap.supported = fragmentDensityMapFeatures.fragmentDensityMap && fragmentDensityMapFeatures.fragmentDensityMapNonSubsampledImages;
+		}
+		if (densityMap.supported) {
+			enabledDeviceExtensions.push_back(VK_EXT_FRAGMENT_DENSITY_MAP_EXTENSION_NAME);
+			fragmentDensityMapFeatures = {};
+			fragmentDensityMapFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_DENSITY_MAP_FEATURES_EXT;
+			fragmentDensityMapFeatures.fragmentDensityMap = VK_TRUE;
+			fragmentDensityMapFeatures.fragmentDensityMapNonSubsampledImages = VK_TRUE;
+			fragmentDensityMapFeatures.pNext = &multiviewFeatures;
+			deviceCreatepNextChain = &fragmentDensityMapFeatures;
+		} else {
+			std::cout << "Fragment density maps are not supported by the selected device, foveation is disabled\n";
+		}
+	}
+
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -92,6 +155,12 @@ public:
 		vkDestroySampler(device, multiviewPass.sampler, nullptr);
 		vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
 
+		if (densityMap.supported) {
+			vkDestroyImageView(device, densityMap.view, nullptr);
+			vkDestroyImage(device, densityMap.image, nullptr);
+			vkFreeMemory(device, densityMap.memory, nullptr);
+		}
+
 		vkDestroySemaphore(device, multiviewPass.semaphore, nullptr);
 		for (auto& fence : multiviewPass.waitFences) {
 			vkDestroyFence(device, fence, nullptr);
@@ -112,6 +181,7 @@ public:
 	{
 		// Example renders to two views (left/right)
 		const uint32_t multiviewLayerCount = 2;
+		multiviewPass.extent = { width, height };
 
 		/*
 			Layered depth/stencil framebuffer
@@ -216,11 +286,61 @@ public:
 			multiviewPass.descriptor.sampler = multiviewPass.sampler;
 		}
 
+		/*
+			Layered fragment density map
+		*/
+		if (densityMap.supported) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8_UNORM, &formatProperties);
+			densityMap.supported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_FRAGMENT_DENSITY_MAP_BIT_EXT) != 0;
+		}
+		if (densityMap.supported) {
+			VkPhysicalDeviceProperties2KHR deviceProps2{};
+			VkPhysicalDeviceFragmentDensityMapPropertiesEXT densityMapProperties{};
+			densityMapProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_DENSITY_MAP_PROPERTIES_EXT;
+			deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			deviceProps2.pNext = &densityMapProperties;
+			PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+			vkGetPhysicalDeviceProperties2KHR(physicalDevice, &deviceProps2);
+
+			// The map needs to cover the framebuffer at the largest texel size the implementation may pick
+			densityMap.extent.width = (width + densityMapProperties.maxFragmentDensityTexelSize.width - 1) / densityMapProperties.maxFragmentDensityTexelSize.width;
+			densityMap.extent.height = (height + densityMapProperties.maxFragmentDensityTexelSize.height - 1) / densityMapProperties.maxFragmentDensityTexelSize.height;
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = VK_FORMAT_R8G8_UNORM;
+			imageCI.extent = { densityMap.extent.width, densityMap.extent.height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = multiviewLayerCount;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_FRAGMENT_DENSITY_MAP_BIT_EXT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &densityMap.image));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, densityMap.image, &memReqs);
+			VkMemoryAllocateInfo memoryAllocInfo = vks::initializers::memoryAllocateInfo();
+			memoryAllocInfo.allocationSize = memReqs.size;
+			memoryAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocInfo, nullptr, &densityMap.memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, densityMap.image, densityMap.memory, 0));
+
+			VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			imageViewCI.format = VK_FORMAT_R8G8_UNORM;
+			imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, multiviewLayerCount };
+			imageViewCI.image = densityMap.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &densityMap.view));
+
+			updateDensityMap();
+		}
+
 		/*
 			Renderpass
 		*/
 		{
-			std::array<VkAttachmentDescription, 2> attachments = {};
+			std::vector<VkAttachmentDescription> attachments(densityMap.supported ? 3 : 2);
 			// Color attachment
 			attachments[0].format = swapChain.colorFormat;
 			attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -239,6 +359,17 @@ public:
 			attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 			attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 			attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			// Fragment density map attachment, only read by the implementation and not referenced by the subpass
+			if (densityMap.supported) {
+				attachments[2].format = VK_FORMAT_R8G8_UNORM;
+				attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+				attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[2].initialLayout = VK_IMAGE_LAYOUT_FRAGMENT_DENSITY_MAP_OPTIMAL_EXT;
+				attachments[2].finalLayout = VK_IMAGE_LAYOUT_FRAGMENT_DENSITY_MAP_OPTIMAL_EXT;
+			}
 
 			VkAttachmentReference colorReference = {};
 			colorReference.attachment = 0;
@@ -307,20 +438,31 @@ public:
 
 			renderPassCI.pNext = &renderPassMultiviewCI;
 
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &multiviewPass.renderPass));
+			/*
+				With multiview each view reads the layer of the density map matching its view index
+			*/
+			VkRenderPassFragmentDensityMapCreateInfoEXT renderPassDensityMapCI{};
+			renderPassDensityMapCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_FRAGMENT_DENSITY_MAP_CREATE_INFO_EXT;
+			renderPassDensityMapCI.fragmentDensityMapAttachment = { 2, VK_IMAGE_LAYOUT_FRAGMENT_DENSITY_MAP_OPTIMAL_EXT };
+			if (densityMap.supported) {
+				renderPassMultiviewCI.pNext = &renderPassDensityMapCI;
+			}
+
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCI, nullptr, &multiviewPass.renderPass));
 		}
 
 		/*
 			Framebuffer
 		*/
 		{
-			VkImageView attachments[2];
+			VkImageView attachments[3];
 			attachments[0] = multiviewPass.color.view;
 			attachments[1] = multiviewPass.depth.view;
+			attachments[2] = densityMap.view;
 
 			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
 			framebufferCI.renderPass = multiviewPass.renderPass;
-			framebufferCI.attachmentCount = 2;
+			framebufferCI.attachmentCount = densityMap.supported ? 3 : 2;
 			framebufferCI.pAttachments = attachments;
 			framebufferCI.width = width;
 			framebufferCI.height = height;
@@ -329,6 +471,55 @@ public:
 		}
 	}
 
+	/*
+		Fills the layers of the density map for fixed foveation
+		Red and green store the horizontal and vertical fragment density, 1.0 shades every pixel, 0.5 every second pixel along that axis, etc.
+	*/
+	void updateDensityMap()
+	{
+		const uint32_t layerCount = 2;
+		const size_t layerSize = densityMap.extent.width * densityMap.extent.height * 2;
+		std::vector<uint8_t> texels(layerSize * layerCount);
+		// Width of the band in which the density falls off to the peripheral density
+		const float transition = 0.3f;
+		for (uint32_t layer = 0; layer < layerCount; layer++) {
+			// Both views are distorted around their centers, which is where the lens of the eye is centered
+			const glm::vec2 lensCenter(0.5f, 0.5f);
+			for (uint32_t y = 0; y < densityMap.extent.height; y++) {
+				for (uint32_t x = 0; x < densityMap.extent.width; x++) {
+					const glm::vec2 uv((x + 0.5f) / densityMap.extent.width, (y + 0.5f) / densityMap.extent.height);
+					const float distance = glm::length((uv - lensCenter) * 2.0f);
+					const float density = foveation ? glm::mix(1.0f, peripheralDensity, glm::smoothstep(fovealRadius, fovealRadius + transition, distance)) : 1.0f;
+					const uint8_t value = static_cast<uint8_t>(density * 255.0f + 0.5f);
+					const size_t offset = layer * layerSize + (y * densityMap.extent.width + x) * 2;
+					texels[offset] = value;
+					texels[offset + 1] = value;
+				}
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			texels.size(),
+			texels.data()));
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+		// The previous contents are discarded, the map is only updated while the multiview pass isn't executing
+		vks::tools::insertImageMemoryBarrier(copyCmd, densityMap.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layerCount };
+		copyRegion.imageExtent = { densityMap.extent.width, densityMap.extent.height, 1 };
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, densityMap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		vks::tools::insertImageMemoryBarrier(copyCmd, densityMap.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_FRAGMENT_DENSITY_MAP_READ_BIT_EXT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_FRAGMENT_DENSITY_MAP_OPTIMAL_EXT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_DENSITY_PROCESS_BIT_EXT, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		stagingBuffer.destroy();
+	}
+
 	void buildCommandBuffers()
 	{
 		/*
@@ -381,50 +572,49 @@ public:
 				VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 			}
 		}
+	}
 
-		/*
-			Multiview layered attachment scene rendering
-		*/
-
-		multiviewPass.commandBuffers.resize(drawCmdBuffers.size());
-
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(drawCmdBuffers.size()));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, multiviewPass.commandBuffers.data()));
-
-		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VkClearValue clearValues[2];
-			clearValues[0].color = defaultClearColor;
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-			renderPassBeginInfo.renderPass = multiviewPass.renderPass;
-			renderPassBeginInfo.renderArea.offset.x = 0;
-			renderPassBeginInfo.renderArea.offset.y = 0;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-
-			for (int32_t i = 0; i < multiviewPass.commandBuffers.size(); ++i) {
-				renderPassBeginInfo.framebuffer = multiviewPass.frameBuffer;
-
-				VK_CHECK_RESULT(vkBeginCommandBuffer(multiviewPass.commandBuffers[i], &cmdBufInfo));
-				vkCmdBeginRenderPass(multiviewPass.commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(multiviewPass.commandBuffers[i], 0, 1, &viewport);
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(multiviewPass.commandBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(multiviewPass.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-				vkCmdBindPipeline(multiviewPass.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-				scene.draw(multiviewPass.commandBuffers[i]);
-
-				vkCmdEndRenderPass(multiviewPass.commandBuffers[i]);
-				VK_CHECK_RESULT(vkEndCommandBuffer(multiviewPass.commandBuffers[i]));
-			}
+	/*
+		Multiview layered attachment scene rendering
+		Recorded every frame, as the primitives drawn depend on the camera if culling is enabled
+	*/
+	void recordMultiviewCommandBuffer(VkCommandBuffer commandBuffer)
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = multiviewPass.renderPass;
+		renderPassBeginInfo.framebuffer = multiviewPass.frameBuffer;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent = multiviewPass.extent;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+		gpuProfiler.beginScope(commandBuffer, "Multiview scene");
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)multiviewPass.extent.width, (float)multiviewPass.extent.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(multiviewPass.extent.width, multiviewPass.extent.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		if (stereoCulling) {
+			scene.drawCulled(commandBuffer, cullingViewProjection);
+		} else {
+			scene.draw(commandBuffer);
 		}
+
+		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler.endScope(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
@@ -452,9 +642,9 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 		/*
 			Descriptors
@@ -535,7 +725,7 @@ public:
 		shaderStages[1] = loadShader(getShadersPath() + "multiview/multiview.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		pipelineCI.stageCount = 2;
 		pipelineCI.pStages = shaderStages.data();
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 
 		/*
 			Full screen pass
@@ -565,7 +755,7 @@ public:
 			pipelineCI.pVertexInputState = &emptyInputState;
 			pipelineCI.layout = pipelineLayout;
 			pipelineCI.renderPass = renderPass;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &viewDisplayPipelines[i]));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &viewDisplayPipelines[i]));
 		}
 
 	}
@@ -582,8 +772,38 @@ public:
 		updateUniformBuffers();
 	}
 
+	/*
+		Calculates a single frustum enclosing the frusta of both eyes, so the scene is only culled once for both views
+		The apex is moved behind the point between the eyes to roughly where the outer planes of the eye frusta intersect, the planes are then fitted to the corners of both eye frusta
+	*/
+	glm::mat4 fusedViewProjection(const glm::mat4& centerView, float nearHalfWidth)
+	{
+		const float apexOffset = fabs(eyeSeparation) * zNear / (2.0f * nearHalfWidth);
+		const glm::mat4 fusedView = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -apexOffset)) * centerView;
+		glm::vec2 minSlope(FLT_MAX);
+		glm::vec2 maxSlope(-FLT_MAX);
+		float nearDepth = FLT_MAX;
+		float farDepth = 0.0f;
+		for (uint32_t i = 0; i < 2; i++) {
+			const glm::mat4 toFusedView = fusedView * glm::inverse(ubo.projection[i] * ubo.modelview[i]);
+			for (uint32_t corner = 0; corner < 8; corner++) {
+				// Clip space depth ranges from 0 to 1
+				glm::vec4 p = toFusedView * glm::vec4((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : 0.0f, 1.0f);
+				p /= p.w;
+				// The views look along the negative z axis
+				const float depth = -p.z;
+				minSlope = glm::min(minSlope, glm::vec2(p) / depth);
+				maxSlope = glm::max(maxSlope, glm::vec2(p) / depth);
+				nearDepth = std::min(nearDepth, depth);
+				farDepth = std::max(farDepth, depth);
+			}
+		}
+		return glm::frustum(minSlope.x * nearDepth, maxSlope.x * nearDepth, minSlope.y * nearDepth, maxSlope.y * nearDepth, nearDepth, farDepth) * fusedView;
+	}
+
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Matrices for the two viewports
 		// See http://paulbourke.net/stereographics/stereorender/
 
@@ -627,6 +847,10 @@ public:
 		ubo.projection[1] = glm::frustum(left, right, bottom, top, zNear, zFar);
 		ubo.modelview[1] = rotM * transM;
 
+		// The primitive bounds used for culling don't include the y flip applied to the vertices at load time
+		const glm::mat4 flipY = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+		cullingViewProjection = fusedViewProjection(rotM * glm::translate(glm::mat4(1.0f), camera.position), aspectRatio * wd2) * flipY;
+
 		memcpy(uniformBuffer.mapped, &ubo, sizeof(ubo));
 	}
 
@@ -637,20 +861,23 @@ public:
 		// Multiview offscreen render
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &multiviewPass.waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		VK_CHECK_RESULT(vkResetFences(device, 1, &multiviewPass.waitFences[currentBuffer]));
+		VkCommandBuffer multiviewCommandBuffer = multiviewPass.commandBuffers[currentBuffer];
+		gpuProfiler.collect(multiviewCommandBuffer);
+		recordMultiviewCommandBuffer(multiviewCommandBuffer);
 		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 		submitInfo.pSignalSemaphores = &multiviewPass.semaphore;
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &multiviewPass.commandBuffers[currentBuffer];
+		submitInfo.pCommandBuffers = &multiviewCommandBuffer;
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, multiviewPass.waitFences[currentBuffer]));
+		gpuProfiler.frameSubmitted(multiviewCommandBuffer);
 
 		// View display
-		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
-		VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
+		// Access to the display command buffers is synchronized by the frame in flight fences of the base class
 		submitInfo.pWaitSemaphores = &multiviewPass.semaphore;
 		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -665,6 +892,10 @@ public:
 		preparePipelines();
 		buildCommandBuffers();
 
+		multiviewPass.commandBuffers.resize(drawCmdBuffers.size());
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(multiviewPass.commandBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, multiviewPass.commandBuffers.data()));
+
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		multiviewPass.waitFences.resize(multiviewPass.commandBuffers.size());
 		for (auto& fence : multiviewPass.waitFences) {
@@ -693,6 +924,18 @@ public:
 			if (overlay->sliderFloat("Barrel distortion", &ubo.distortionAlpha, -0.6f, 0.6f)) {
 				updateUniformBuffers();
 			}
+			overlay->checkBox("Stereo frustum culling", &stereoCulling);
+		}
+		if (densityMap.supported && overlay->header("Fixed foveation")) {
+			bool densityMapChanged = overlay->checkBox("Enabled", &foveation);
+			densityMapChanged |= overlay->sliderFloat("Foveal radius", &fovealRadius, 0.0f, 1.0f);
+			densityMapChanged |= overlay->sliderFloat("Peripheral density", &peripheralDensity, 0.125f, 1.0f);
+			if (densityMapChanged) {
+				// The map is read by multiview passes that may still be in flight
+				vkQueueWaitIdle(queue);
+				updateDensityMap();
+			}
+			overlay->text("Density map: %dx%d", densityMap.extent.width, densityMap.extent.height);
 		}
 	}
 
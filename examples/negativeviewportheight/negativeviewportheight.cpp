@@ -56,6 +56,8 @@ public:
 		// [POI] VK_KHR_MAINTENANCE1 is required for using negative viewport heights
 		// Note: This is core as of Vulkan 1.1. So if you target 1.1 you don't have to explicitly enable this
 		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
+		// Cull mode and winding order are set in the command buffer if supported, so changing them doesn't require a new pipeline
+		enableExtendedDynamicState = true;
 	}
 
 	~VulkanExample()
@@ -68,6 +70,16 @@ public:
 		quad.destroy();
 	}
 
+	VkCullModeFlags getCullMode()
+	{
+		return VK_CULL_MODE_NONE + cullMode;
+	}
+
+	VkFrontFace getFrontFace()
+	{
+		return windingOrder == 0 ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -93,6 +105,10 @@ public:
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			if (extendedDynamicState.supported) {
+				extendedDynamicState.vkCmdSetCullModeEXT(drawCmdBuffers[i], getCullMode());
+				extendedDynamicState.vkCmdSetFrontFaceEXT(drawCmdBuffers[i], getFrontFace());
+			}
 
 			// [POI] Viewport setup
 			VkViewport viewport{};
@@ -186,9 +202,9 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 
 		VkDescriptorPoolSize poolSize = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2);
 		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(1, &poolSize, 2);
@@ -212,7 +228,11 @@ public:
 			vkDestroyPipeline(device, pipeline, nullptr);
 		}
 
-		const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		if (extendedDynamicState.supported) {
+			dynamicStateEnables.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+			dynamicStateEnables.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+		}
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -226,8 +246,9 @@ public:
 		rasterizationStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
 		rasterizationStateCI.lineWidth = 1.0f;
-		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE + cullMode;
-		rasterizationStateCI.frontFace = windingOrder == 0 ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		// Ignored if set dynamically
+		rasterizationStateCI.cullMode = getCullMode();
+		rasterizationStateCI.frontFace = getFrontFace();
 
 		// Vertex bindings and attributes
 		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
@@ -262,7 +283,7 @@ public:
 		pipelineCreateInfoCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfoCI.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfoCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfoCI, nullptr, &pipeline));
 	}
 
 	void draw()
@@ -291,6 +312,16 @@ public:
 		draw();
 	}
 
+	// Only needs a new pipeline if the rasterization state can't be set dynamically, the command buffers are rebuilt after any UI change
+	void rasterizationStateChanged()
+	{
+		if (extendedDynamicState.supported) {
+			extendedDynamicState.pipelinesAvoided++;
+		} else {
+			preparePipelines();
+		}
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Scene")) {
@@ -314,11 +345,11 @@ public:
 		if (overlay->header("Pipeline")) {
 			overlay->text("Winding order");
 			if (overlay->comboBox("##windingorder", &windingOrder, { "clock wise", "counter clock wise" })) {
-				preparePipelines();
+				rasterizationStateChanged();
 			}
 			overlay->text("Cull mode");
 			if (overlay->comboBox("##cullmode", &cullMode, { "none", "front face", "back face" })) {
-				preparePipelines();
+				rasterizationStateChanged();
 			}
 		}
 	}
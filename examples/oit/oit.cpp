@@ -3,6 +3,11 @@
 *
 * Note: Requires the separate asset pack (see data/README.md)
 *
+* Supports three techniques that can be switched at runtime (or selected with --oitmode):
+*	- Per-pixel linked lists: Exact, but memory scales with the number of fragments per pixel (NODE_COUNT) and fragments that don't fit are dropped
+*	- Weighted blended: Approximate, fixed memory (two render targets) and no sorting
+*	- K-buffer: Sorts the nearest K_BUFFER_LAYERS fragments of each pixel exactly, farther fragments are merged with weighted blending, bounded memory
+*
 * Copyright by Sascha Willems - www.saschawillems.de
 * Copyright by Daemyung Jang  - dm86.jang@gmail.com
 *
@@ -14,10 +19,16 @@
 
 #define ENABLE_VALIDATION false
 #define NODE_COUNT 20
+// Number of fragments per pixel that are sorted exactly by the k-buffer mode, must match the shaders
+#define K_BUFFER_LAYERS 4
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum OITMode { OIT_LINKED_LIST = 0, OIT_WEIGHTED_BLENDED = 1, OIT_K_BUFFER = 2 };
+	int32_t oitMode = OIT_LINKED_LIST;
+	const std::vector<std::string> oitModeNames = { "Linked lists", "Weighted blended", "K-buffer" };
+
 	struct {
 		vkglTF::Model sphere;
 		vkglTF::Model cube;
@@ -44,8 +55,42 @@ public:
 		vks::Buffer geometry;
 		vks::Texture headIndex;
 		vks::Buffer linkedList;
+		// Mode the per-pixel resources have been created for
+		int32_t mode;
+		// Device memory used by the per-pixel resources of the mode
+		VkDeviceSize memorySize = 0;
 	} geometryPass;
 
+	struct OITImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		void destroy(VkDevice device)
+		{
+			vkDestroyImageView(device, view, nullptr);
+			vkDestroyImage(device, image, nullptr);
+			vkFreeMemory(device, memory, nullptr);
+			view = VK_NULL_HANDLE;
+			image = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+		}
+	};
+
+	// Weighted blended transparency targets, also used for the fragments behind the k-buffer
+	struct AccumulationPass {
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		OITImage accumulation;
+		OITImage revealage;
+		VkSampler sampler;
+	} accumulationPass;
+
+	// Depths (sorted front to back) and colors of the nearest fragments of each pixel, one array layer per fragment
+	struct KBuffer {
+		OITImage depth;
+		OITImage color;
+	} kBuffer;
+
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -56,48 +101,74 @@ public:
 		glm::vec4 color;
 	};
 
+	// The bounded memory modes (weighted blended and k-buffer) share their layouts
 	struct {
 		VkDescriptorSetLayout geometry;
 		VkDescriptorSetLayout color;
+		VkDescriptorSetLayout boundedGeometry;
+		VkDescriptorSetLayout boundedResolve;
 	} descriptorSetLayouts;
 
 	struct {
 		VkPipelineLayout geometry;
 		VkPipelineLayout color;
+		VkPipelineLayout boundedGeometry;
+		VkPipelineLayout boundedResolve;
 	} pipelineLayouts;
 
 	struct {
 		VkPipeline geometry;
 		VkPipeline color;
+		VkPipeline weightedBlended;
+		VkPipeline weightedBlendedResolve;
+		VkPipeline kBufferDepth;
+		VkPipeline kBufferColor;
+		VkPipeline kBufferResolve;
 	} pipelines;
 
 	struct {
 		VkDescriptorSet geometry;
 		VkDescriptorSet color;
+		VkDescriptorSet boundedGeometry;
+		VkDescriptorSet boundedResolve;
 	} descriptorSets;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Order independent transparency rendering";
+		// The geometry pass images are recreated in place by windowResized, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -6.0f));
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
 		camera.setPerspective(60.0f, (float) width / (float) height, 0.1f, 256.0f);
 		settings.overlay = true;
+		oitMode = std::min(std::max(commandLineParser.getValueAsInt("oitmode", OIT_LINKED_LIST), 0), 2);
 	}
 
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipelines.geometry, nullptr);
 		vkDestroyPipeline(device, pipelines.color, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedBlended, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedBlendedResolve, nullptr);
+		vkDestroyPipeline(device, pipelines.kBufferDepth, nullptr);
+		vkDestroyPipeline(device, pipelines.kBufferColor, nullptr);
+		vkDestroyPipeline(device, pipelines.kBufferResolve, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.geometry, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.color, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.boundedGeometry, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.boundedResolve, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.geometry, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.color, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.boundedGeometry, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.boundedResolve, nullptr);
 
 		destroyGeometryPass();
+		vkDestroyRenderPass(device, accumulationPass.renderPass, nullptr);
+		vkDestroySampler(device, accumulationPass.sampler, nullptr);
 
 		uniformBuffers.renderPass.destroy();
 	}
@@ -116,6 +187,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
+		prepareAccumulationPass();
 		prepareGeometryPass();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -123,6 +195,7 @@ public:
 		setupDescriptorSets();
 		buildCommandBuffers();
 		updateUniformBuffers();
+		benchmark.addMetric("oitmemorykb", static_cast<double>(geometryPass.memorySize) / 1024.0);
 		prepared = true;
 	}
 
@@ -135,10 +208,7 @@ public:
 
 	void windowResized() override
 	{
-		destroyGeometryPass();
-		prepareGeometryPass();
-		vkResetDescriptorPool(device, descriptorPool, 0);
-		setupDescriptorSets();
+		recreateGeometryPass();
 
 		resized = false;
 		buildCommandBuffers();
@@ -149,6 +219,18 @@ public:
 		updateUniformBuffers();
 	}
 
+	void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Mode", &oitMode, oitModeNames)) {
+				vkDeviceWaitIdle(device);
+				recreateGeometryPass();
+				buildCommandBuffers();
+			}
+			overlay->text("Per-pixel memory: %.2f MB", static_cast<float>(geometryPass.memorySize) / (1024.0f * 1024.0f));
+		}
+	}
+
 private:
 	void loadAssets()
 	{
@@ -180,7 +262,7 @@ private:
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpassDescription;
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &geometryPass.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &geometryPass.renderPass));
 
 		// Geometry frame buffer doesn't need any output attachment.
 		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
@@ -192,6 +274,25 @@ private:
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.framebuffer));
 
+		// Only the resources of the selected mode are created
+		geometryPass.mode = oitMode;
+		geometryPass.memorySize = 0;
+		switch (oitMode) {
+		case OIT_LINKED_LIST:
+			prepareLinkedLists();
+			break;
+		case OIT_WEIGHTED_BLENDED:
+			prepareAccumulationTargets();
+			break;
+		case OIT_K_BUFFER:
+			prepareAccumulationTargets();
+			prepareKBuffer();
+			break;
+		}
+	}
+
+	void prepareLinkedLists()
+	{
 		// Create a buffer for GeometrySBO
 		// Using the device memory will be best but I will use the host visible buffer to make this example simple.
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -267,6 +368,8 @@ private:
 
 		VK_CHECK_RESULT(geometryPass.linkedList.map());
 
+		geometryPass.memorySize = memReqs.size + geometryPass.linkedList.size + geometryPass.geometry.size;
+
 		// Change HeadIndex image's layout from UNDEFINED to GENERAL
 		VkCommandBufferAllocateInfo cmdBufAllocInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
 
@@ -297,6 +400,139 @@ private:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
+	// Creates a screen sized image for one of the bounded memory modes
+	void createOITImage(OITImage& oitImage, VkFormat format, VkImageUsageFlags usage, uint32_t layerCount, VkImageViewType viewType)
+	{
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = layerCount;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &oitImage.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, oitImage.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &oitImage.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, oitImage.image, oitImage.memory, 0));
+		geometryPass.memorySize += memReqs.size;
+
+		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
+		imageViewInfo.viewType = viewType;
+		imageViewInfo.format = format;
+		imageViewInfo.image = oitImage.image;
+		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewInfo, nullptr, &oitImage.view));
+	}
+
+	// Render pass for the weighted blended transparency targets, accumulated color (additive) and revealage (multiplicative)
+	void prepareAccumulationPass()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		attachments[1].format = VK_FORMAT_R16_SFLOAT;
+		for (auto& attachment : attachments) {
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		std::array<VkAttachmentReference, 2> colorReferences = {};
+		colorReferences[0] = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		colorReferences[1] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+
+		std::array<VkSubpassDependency, 2> dependencies;
+		// The previous frame's resolve reads the targets
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+		// The resolve reads the targets
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &accumulationPass.renderPass));
+
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &accumulationPass.sampler));
+	}
+
+	void prepareAccumulationTargets()
+	{
+		createOITImage(accumulationPass.accumulation, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, VK_IMAGE_VIEW_TYPE_2D);
+		createOITImage(accumulationPass.revealage, VK_FORMAT_R16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, VK_IMAGE_VIEW_TYPE_2D);
+
+		std::array<VkImageView, 2> attachments = { accumulationPass.accumulation.view, accumulationPass.revealage.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = accumulationPass.renderPass;
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.width = width;
+		fbufCreateInfo.height = height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &accumulationPass.framebuffer));
+	}
+
+	void prepareKBuffer()
+	{
+		createOITImage(kBuffer.depth, VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, K_BUFFER_LAYERS, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+		createOITImage(kBuffer.color, VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_STORAGE_BIT, K_BUFFER_LAYERS, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+
+		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, K_BUFFER_LAYERS };
+		vks::tools::setImageLayout(cmdBuf, kBuffer.depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+		vks::tools::setImageLayout(cmdBuf, kBuffer.color.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(cmdBuf, queue, true);
+	}
+
+	void recreateGeometryPass()
+	{
+		destroyGeometryPass();
+		prepareGeometryPass();
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSets();
+	}
+
 	void setupDescriptorSetLayout()
 	{
 		// Create a geometry descriptor set layout.
@@ -324,7 +560,7 @@ private:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.geometry));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.geometry));
 
 		// Create a geometry pipeline layout.
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.geometry, 1);
@@ -332,7 +568,7 @@ private:
 		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(ObjectData), 0);
 		pipelineLayoutCI.pushConstantRangeCount = 1;
 		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.geometry));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.geometry));
 
 		// Create a color descriptor set layout.
 		setLayoutBindings = {
@@ -349,11 +585,68 @@ private:
 		};
 
 		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.color));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.color));
 
 		// Create a color pipeline layout.
 		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.color, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.color));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.color));
+
+		// Create a geometry descriptor set layout for the bounded memory modes.
+		setLayoutBindings = {
+			// RenderPassUBO
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0),
+			// K-buffer depth layers
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				1),
+			// K-buffer color layers
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
+		};
+
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.boundedGeometry));
+
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.boundedGeometry, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.boundedGeometry));
+
+		// Create a resolve descriptor set layout for the bounded memory modes.
+		setLayoutBindings = {
+			// Accumulated color
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				0),
+			// Revealage
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				1),
+			// K-buffer depth layers
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
+			// K-buffer color layers
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				3),
+		};
+
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.boundedResolve));
+
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.boundedResolve, 1);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.boundedResolve));
 	}
 
 	void preparePipelines()
@@ -384,7 +677,40 @@ private:
 		shaderStages[0] = loadShader(getShadersPath() + "oit/geometry.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "oit/geometry.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
+
+		// Create a k-buffer depth pipeline, uses the geometry render pass without attachments.
+		pipelineCI.layout = pipelineLayouts.boundedGeometry;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbufferdepth.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kBufferDepth));
+
+		// Create the weighted blended accumulation pipelines.
+		// Color is accumulated additively, revealage is multiplied with (1 - alpha)
+		std::array<VkPipelineColorBlendAttachmentState, 2> accumulationBlendStates = {
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE),
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE),
+		};
+		accumulationBlendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		accumulationBlendStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		accumulationBlendStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(accumulationBlendStates.size()), accumulationBlendStates.data());
+
+		pipelineCI.renderPass = accumulationPass.renderPass;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/weightedblended.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedBlended));
+
+		// Create a k-buffer color pipeline, fragments that aren't stored in the k-buffer are accumulated like with weighted blending.
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffercolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kBufferColor));
 
 		// Create a color pipeline.
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -410,7 +736,14 @@ private:
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+
+		// Create the resolve pipelines of the bounded memory modes.
+		pipelineCI.layout = pipelineLayouts.boundedResolve;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/weightedblendedresolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedBlendedResolve));
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbufferresolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kBufferResolve));
 	}
 
 	void setupDescriptorPool()
@@ -419,9 +752,11 @@ private:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
 		};
 
+		// Only the descriptor sets of the selected mode are allocated
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
@@ -433,6 +768,11 @@ private:
 
 	void setupDescriptorSets()
 	{
+		if (geometryPass.mode != OIT_LINKED_LIST) {
+			setupBoundedDescriptorSets();
+			return;
+		}
+
 		// Update a geometry descriptor set
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
@@ -498,6 +838,73 @@ private:
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
+	void setupBoundedDescriptorSets()
+	{
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.boundedGeometry, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.boundedGeometry));
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.boundedResolve, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.boundedResolve));
+
+		std::vector<VkDescriptorImageInfo> imageDescriptors = {
+			vks::initializers::descriptorImageInfo(accumulationPass.sampler, accumulationPass.accumulation.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(accumulationPass.sampler, accumulationPass.revealage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, kBuffer.depth.view, VK_IMAGE_LAYOUT_GENERAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, kBuffer.color.view, VK_IMAGE_LAYOUT_GENERAL),
+		};
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: RenderPassUBO
+			vks::initializers::writeDescriptorSet(descriptorSets.boundedGeometry, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.renderPass.descriptor),
+			// Binding 0: Accumulated color
+			vks::initializers::writeDescriptorSet(descriptorSets.boundedResolve, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+			// Binding 1: Revealage
+			vks::initializers::writeDescriptorSet(descriptorSets.boundedResolve, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),
+		};
+		if (geometryPass.mode == OIT_K_BUFFER) {
+			// Binding 1 and 2: K-buffer depth and color layers
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.boundedGeometry, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &imageDescriptors[2]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.boundedGeometry, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &imageDescriptors[3]));
+			// Binding 2 and 3: K-buffer depth and color layers
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.boundedResolve, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &imageDescriptors[2]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.boundedResolve, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &imageDescriptors[3]));
+		}
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	void drawScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+	{
+		models.sphere.bindBuffers(commandBuffer);
+
+		ObjectData objectData;
+
+		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
+		for (int32_t x = 0; x < 5; x++)
+		{
+			for (int32_t y = 0; y < 5; y++)
+			{
+				for (int32_t z = 0; z < 5; z++)
+				{
+					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
+					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
+					objectData.model = T * S;
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+					models.sphere.draw(commandBuffer);
+				}
+			}
+		}
+
+		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
+			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+			objectData.model = T * S;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+			models.cube.draw(commandBuffer);
+		}
+	}
+
 	void buildCommandBuffers()
 	{
 		if (resized)
@@ -528,6 +935,8 @@ private:
 			// Update dynamic scissor state
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
 			VkClearColorValue clearColor;
 			clearColor.uint32[0] = 0xffffffff;
 
@@ -537,53 +946,83 @@ private:
 			subresRange.levelCount = 1;
 			subresRange.layerCount = 1;
 
-			vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
-
-			// Begin the geometry render pass
-			renderPassBeginInfo.renderPass = geometryPass.renderPass;
-			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
-			renderPassBeginInfo.clearValueCount = 0;
-			renderPassBeginInfo.pClearValues = nullptr;
-
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-			uint32_t dynamicOffset = 0;
-			models.sphere.bindBuffers(drawCmdBuffers[i]);
-
-			// Render the scene
-			ObjectData objectData;
-
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
-			objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
-			for (int32_t x = 0; x < 5; x++)
-			{
-				for (int32_t y = 0; y < 5; y++)
-				{
-					for (int32_t z = 0; z < 5; z++)
-					{
-						glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
-						glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-						objectData.model = T * S;
-						vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-						models.sphere.draw(drawCmdBuffers[i]);
-					}
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Geometry");
+
+			if (geometryPass.mode == OIT_LINKED_LIST) {
+				vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+
+				// Begin the geometry render pass
+				renderPassBeginInfo.renderPass = geometryPass.renderPass;
+				renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 0;
+				renderPassBeginInfo.pClearValues = nullptr;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
+				drawScene(drawCmdBuffers[i], pipelineLayouts.geometry);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				// Make a pipeline barrier to guarantee the geometry pass is done
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			} else {
+				if (geometryPass.mode == OIT_K_BUFFER) {
+					// Reset the depth layers of the k-buffer, the previous frame's resolve needs to be done reading them
+					VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+					memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+					subresRange.layerCount = K_BUFFER_LAYERS;
+					vkCmdClearColorImage(drawCmdBuffers[i], kBuffer.depth.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+
+					memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+					// First pass: Insert the depths of the nearest fragments into the k-buffer
+					renderPassBeginInfo.renderPass = geometryPass.renderPass;
+					renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+					renderPassBeginInfo.clearValueCount = 0;
+					renderPassBeginInfo.pClearValues = nullptr;
+
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.kBufferDepth);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.boundedGeometry, 0, 1, &descriptorSets.boundedGeometry, 0, nullptr);
+					drawScene(drawCmdBuffers[i], pipelineLayouts.boundedGeometry);
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+					memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 				}
-			}
 
-			objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-			for (uint32_t x = 0; x < 2; x++)
-			{
-				glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
-				glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-				objectData.model = T * S;
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-				models.cube.draw(drawCmdBuffers[i]);
+				// Accumulate the fragments (weighted blended) or store their colors in the k-buffer and accumulate the rest (k-buffer)
+				VkClearValue accumulationClearValues[2];
+				accumulationClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+				accumulationClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+				renderPassBeginInfo.renderPass = accumulationPass.renderPass;
+				renderPassBeginInfo.framebuffer = accumulationPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 2;
+				renderPassBeginInfo.pClearValues = accumulationClearValues;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPass.mode == OIT_K_BUFFER ? pipelines.kBufferColor : pipelines.weightedBlended);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.boundedGeometry, 0, 1, &descriptorSets.boundedGeometry, 0, nullptr);
+				drawScene(drawCmdBuffers[i], pipelineLayouts.boundedGeometry);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				if (geometryPass.mode == OIT_K_BUFFER) {
+					// Make the k-buffer's color layers visible to the resolve
+					VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+					memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				}
 			}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-			// Make a pipeline barrier to guarantee the geometry pass is done
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			// Begin the color render pass
 			renderPassBeginInfo.renderPass = renderPass;
@@ -591,10 +1030,24 @@ private:
 			renderPassBeginInfo.clearValueCount = 2;
 			renderPassBeginInfo.pClearValues = clearValues;
 
+			gpuProfiler.beginScope(drawCmdBuffers[i], "Resolve");
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+			switch (geometryPass.mode) {
+			case OIT_LINKED_LIST:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+				break;
+			case OIT_WEIGHTED_BLENDED:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.weightedBlendedResolve);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.boundedResolve, 0, 1, &descriptorSets.boundedResolve, 0, nullptr);
+				break;
+			case OIT_K_BUFFER:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.kBufferResolve);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.boundedResolve, 0, 1, &descriptorSets.boundedResolve, 0, nullptr);
+				break;
+			}
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 			drawUI(drawCmdBuffers[i]);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -604,6 +1057,7 @@ private:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		renderPassUBO.projection = camera.matrices.perspective;
 		renderPassUBO.view = camera.matrices.view;
 		memcpy(uniformBuffers.renderPass.mapped, &renderPassUBO, sizeof(renderPassUBO));
@@ -614,7 +1068,9 @@ private:
 		VulkanExampleBase::prepareFrame();
 
 		// Clear previous geometry pass data
-		memset(geometryPass.geometry.mapped, 0, sizeof(uint32_t));
+		if (geometryPass.mode == OIT_LINKED_LIST) {
+			memset(geometryPass.geometry.mapped, 0, sizeof(uint32_t));
+		}
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
@@ -630,9 +1086,18 @@ private:
 	{
 		vkDestroyRenderPass(device, geometryPass.renderPass, nullptr);
 		vkDestroyFramebuffer(device, geometryPass.framebuffer, nullptr);
-		geometryPass.geometry.destroy();
-		geometryPass.headIndex.destroy();
-		geometryPass.linkedList.destroy();
+		if (geometryPass.mode == OIT_LINKED_LIST) {
+			geometryPass.geometry.destroy();
+			geometryPass.headIndex.destroy();
+			geometryPass.linkedList.destroy();
+		} else {
+			vkDestroyFramebuffer(device, accumulationPass.framebuffer, nullptr);
+			accumulationPass.framebuffer = VK_NULL_HANDLE;
+			accumulationPass.accumulation.destroy(device);
+			accumulationPass.revealage.destroy(device);
+			kBuffer.depth.destroy(device);
+			kBuffer.color.destroy(device);
+		}
 	}
 
 private:
@@ -6,11 +6,27 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <fstream>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
 #define ENABLE_VALIDATION false
 
+// Relaxed cone step map cache, stored next to the height map and rebuilt if the height map or the generation parameters change
+struct ConeStepMapCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t width;
+	uint32_t height;
+	uint32_t searchRadius;
+	uint32_t searchSteps;
+};
+static const char coneStepMapCacheMagic[4] = { 'V', 'K', 'C', 'S' };
+static const uint32_t coneStepMapCacheVersion = 1;
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -18,8 +34,22 @@ public:
 		vks::Texture2D colorMap;
 		// Normals and height are combined into one texture (height = alpha channel)
 		vks::Texture2D normalHeightMap;
+		// Relaxed cone step map generated from the height map (square root of the cone ratio in red, height in green)
+		vks::Texture2D coneStepMap;
 	} textures;
 
+	const std::string heightMapFile = "textures/rocks_normal_height_rgba.ktx";
+
+	// Generation parameters of the cone step map
+	struct {
+		// Neighbours up to this many texels away are tested, cones are capped to this radius
+		uint32_t searchRadius = 16;
+		// Steps a ray is followed inside the surface to find its exit point
+		uint32_t searchSteps = 16;
+		bool cached = false;
+		double generationTime = 0.0;
+	} coneStepMapGeneration;
+
 	vkglTF::Model plane;
 
 	struct {
@@ -45,6 +75,9 @@ public:
 			float numLayers = 48.0f;
 			// (Parallax) mapping mode to use
 			int32_t mappingMode = 4;
+			// Relaxed cone step mapping gets close to the intersection in a few steps and refines it with a short binary search
+			int32_t coneSteps = 12;
+			int32_t binarySteps = 6;
 		} fragmentShader;
 
 	} ubos;
@@ -60,6 +93,7 @@ public:
 		"Parallax mapping",
 		"Steep parallax mapping",
 		"Parallax occlusion mapping",
+		"Relaxed cone step mapping",
 	};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -85,16 +119,247 @@ public:
 
 		textures.colorMap.destroy();
 		textures.normalHeightMap.destroy();
+		textures.coneStepMap.destroy();
 	}
 
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		plane.loadFromFile(getAssetPath() + "models/plane.gltf", vulkanDevice, queue, glTFLoadingFlags);
-		textures.normalHeightMap.loadFromFile(getAssetPath() + "textures/rocks_normal_height_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		textures.normalHeightMap.loadFromFile(getAssetPath() + heightMapFile, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.colorMap.loadFromFile(getAssetPath() + "textures/rocks_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
+	bool getHeightMapFileInfo(uint64_t& size, int64_t& time)
+	{
+		struct stat fileStat;
+		if (stat((getAssetPath() + heightMapFile).c_str(), &fileStat) != 0) {
+			return false;
+		}
+		size = static_cast<uint64_t>(fileStat.st_size);
+		time = static_cast<int64_t>(fileStat.st_mtime);
+		return true;
+	}
+
+	bool loadConeStepMapCache(std::vector<uint8_t>& pixels)
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (!getHeightMapFileInfo(sourceSize, sourceTime)) {
+			return false;
+		}
+		vks::AssetFile file(getAssetPath() + heightMapFile + ".conestep.vkcache");
+		const size_t pixelsSize = static_cast<size_t>(textures.normalHeightMap.width) * textures.normalHeightMap.height * 4;
+		if (file.size() != sizeof(ConeStepMapCacheHeader) + pixelsSize) {
+			return false;
+		}
+		ConeStepMapCacheHeader header;
+		memcpy(&header, file.data(), sizeof(header));
+		if ((memcmp(header.magic, coneStepMapCacheMagic, sizeof(coneStepMapCacheMagic)) != 0) ||
+			(header.version != coneStepMapCacheVersion) ||
+			(header.sourceSize != sourceSize) ||
+			(header.sourceTime != sourceTime) ||
+			(header.width != textures.normalHeightMap.width) ||
+			(header.height != textures.normalHeightMap.height) ||
+			(header.searchRadius != coneStepMapGeneration.searchRadius) ||
+			(header.searchSteps != coneStepMapGeneration.searchSteps)) {
+			return false;
+		}
+		pixels.assign(file.data() + sizeof(header), file.data() + file.size());
+		return true;
+	}
+
+	void saveConeStepMapCache(const std::vector<uint8_t>& pixels)
+	{
+		ConeStepMapCacheHeader header{};
+		memcpy(header.magic, coneStepMapCacheMagic, sizeof(coneStepMapCacheMagic));
+		header.version = coneStepMapCacheVersion;
+		// Without file information (e.g. for packaged assets) the cache could never be validated
+		if (!getHeightMapFileInfo(header.sourceSize, header.sourceTime)) {
+			return;
+		}
+		header.width = textures.normalHeightMap.width;
+		header.height = textures.normalHeightMap.height;
+		header.searchRadius = coneStepMapGeneration.searchRadius;
+		header.searchSteps = coneStepMapGeneration.searchSteps;
+
+		// Write to a temporary file first, so an interrupted write never leaves a truncated cache behind
+		const std::string cacheFilename = getAssetPath() + heightMapFile + ".conestep.vkcache";
+		const std::string tempFilename = cacheFilename + ".tmp";
+		{
+			std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::cerr << "Could not write cone step map cache \"" << cacheFilename << "\"" << std::endl;
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+			if (!file) {
+				file.close();
+				std::remove(tempFilename.c_str());
+				return;
+			}
+		}
+		std::remove(cacheFilename.c_str());
+		std::rename(tempFilename.c_str(), cacheFilename.c_str());
+	}
+
+	/*
+		Generates the relaxed cone step map from the height map with a compute shader and reads it back for the cache
+		Each row of neighbour offsets is tested by a separate submission, so no single submission runs long enough to trigger a device timeout
+	*/
+	void computeConeStepMap(std::vector<uint8_t>& pixels)
+	{
+		const uint32_t width = textures.normalHeightMap.width;
+		const uint32_t height = textures.normalHeightMap.height;
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		// Target image, RGBA8 is used as it's a mandatory storage image format
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, image, memory, 0));
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+
+		// Descriptors and pipeline are only needed once, so they use their own pool
+		VkDescriptorPool pool;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &pool));
+
+		VkDescriptorSetLayout setLayout;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),	// Binding 0: Combined normal and height map
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),			// Binding 1: Cone step map
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &setLayout));
+
+		VkDescriptorSet set;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(pool, &setLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &set));
+		VkDescriptorImageInfo storageImageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &textures.normalHeightMap.descriptor),
+			vks::initializers::writeDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		struct PushConstants {
+			int32_t offsetY;
+			int32_t searchRadius;
+			int32_t searchSteps;
+			int32_t first;
+		} pushConstants;
+		VkPipelineLayout layout;
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&setLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &layout));
+
+		VkPipeline pipeline;
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(layout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "parallaxmapping/conestep.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		const int32_t radius = static_cast<int32_t>(coneStepMapGeneration.searchRadius);
+		pushConstants.searchRadius = radius;
+		pushConstants.searchSteps = static_cast<int32_t>(coneStepMapGeneration.searchSteps);
+		for (int32_t offsetY = -radius; offsetY <= radius; offsetY++) {
+			VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			if (offsetY == -radius) {
+				vks::tools::setImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			} else {
+				// Each pass reads the cone ratios written by the previous one
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+			pushConstants.offsetY = offsetY;
+			pushConstants.first = (offsetY == -radius) ? 1 : 0;
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+			vkCmdPushConstants(cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(cmdBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue);
+		}
+
+		// Read back the result
+		vks::Buffer readbackBuffer;
+		const VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readbackBuffer, size));
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.imageExtent = { width, height, 1 };
+		vkCmdCopyImageToBuffer(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1, &copyRegion);
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = readbackBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue);
+
+		VK_CHECK_RESULT(readbackBuffer.map());
+		pixels.resize(static_cast<size_t>(size));
+		memcpy(pixels.data(), readbackBuffer.mapped, pixels.size());
+		readbackBuffer.destroy();
+
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, layout, nullptr);
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		vkDestroyDescriptorPool(device, pool, nullptr);
+		vkDestroyImageView(device, view, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	// The cone step map only depends on the height map, so it's generated once and then loaded from the cache
+	void prepareConeStepMap()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		std::vector<uint8_t> pixels;
+		coneStepMapGeneration.cached = loadConeStepMapCache(pixels);
+		if (!coneStepMapGeneration.cached) {
+			computeConeStepMap(pixels);
+			saveConeStepMapCache(pixels);
+		}
+		textures.coneStepMap.fromBuffer(pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, textures.normalHeightMap.width, textures.normalHeightMap.height, vulkanDevice, queue);
+		coneStepMapGeneration.generationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -119,6 +384,8 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -129,7 +396,10 @@ public:
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			// Timed per mode, the command buffers are rebuilt when the mode changes
+			gpuProfiler.beginScope(drawCmdBuffers[i], mappingModes[ubos.fragmentShader.mappingMode]);
 			plane.draw(drawCmdBuffers[i]);
+			gpuProfiler.endScope(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -141,11 +411,11 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses two ubos and two image sampler
+		// Example uses two ubos and three image samplers
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -161,12 +431,13 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),	// Binding 1: Fragment shader color map image sampler
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),	// Binding 2: Fragment combined normal and heightmap
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),			// Binding 3: Fragment shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),	// Binding 4: Fragment relaxed cone step map
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -179,6 +450,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.colorMap.descriptor),			// Binding 1: Fragment shader image sampler
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.normalHeightMap.descriptor),	// Binding 2: Combined normal and heightmap
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.fragmentShader.descriptor),		// Binding 3: Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &textures.coneStepMap.descriptor),		// Binding 4: Relaxed cone step map
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -211,7 +483,7 @@ public:
 		// Parallax mapping modes pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "parallaxmapping/parallax.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "parallaxmapping/parallax.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 	}
 
 	void prepareUniformBuffers()
@@ -239,6 +511,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Vertex shader
 		ubos.vertexShader.projection = camera.matrices.perspective;
 		ubos.vertexShader.view = camera.matrices.view;
@@ -269,6 +542,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareConeStepMap();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -295,6 +569,26 @@ public:
 			if (overlay->comboBox("Mode", &ubos.fragmentShader.mappingMode, mappingModes)) {
 				updateUniformBuffers();
 			}
+			if (ubos.fragmentShader.mappingMode == 5) {
+				if (overlay->sliderInt("Cone steps", &ubos.fragmentShader.coneSteps, 1, 32)) {
+					updateUniformBuffers();
+				}
+				if (overlay->sliderInt("Binary search steps", &ubos.fragmentShader.binarySteps, 0, 16)) {
+					updateUniformBuffers();
+				}
+			}
+		}
+		if (overlay->header("GPU time per mode")) {
+			// Modes keep their last measured time, switch through them to compare
+			for (auto& mode : mappingModes) {
+				auto timing = std::find_if(gpuProfiler.timings.begin(), gpuProfiler.timings.end(), [&mode](const vks::GpuProfiler::Timing& t) { return t.name == mode; });
+				if (timing != gpuProfiler.timings.end()) {
+					overlay->text("%s: %.3f ms", mode.c_str(), timing->ms);
+				} else {
+					overlay->text("%s: -", mode.c_str());
+				}
+			}
+			overlay->text("Cone step map %s in %.1f ms", coneStepMapGeneration.cached ? "loaded from cache" : "generated", coneStepMapGeneration.generationTime);
 		}
 	}
 
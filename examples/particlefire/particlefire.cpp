@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - CPU based fire particle system
+* Vulkan Example - Fire particle system, simulated on the CPU or with compute shaders
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -8,8 +8,10 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRadixSort.h"
 
 #define ENABLE_VALIDATION false
+// Default number of particles, can be changed from the command line (see --particles)
 #define PARTICLE_COUNT 512
 #define PARTICLE_SIZE 10.0f
 
@@ -18,6 +20,7 @@
 #define PARTICLE_TYPE_FLAME 0
 #define PARTICLE_TYPE_SMOKE 1
 
+// Also used as the storage buffer layout of the compute shaders, so the size needs to be a multiple of 16 bytes (std430)
 struct Particle {
 	glm::vec4 pos;
 	glm::vec4 color;
@@ -28,6 +31,28 @@ struct Particle {
 	// Attributes not used in shader
 	glm::vec4 vel;
 	float rotationSpeed;
+	float _pad0[3];
+};
+
+// Structure of arrays layout of the particles for the CPU simulation, so the update loops can be vectorized by the compiler
+struct ParticleArrays {
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	// Particles are gray, so a single color channel is enough
+	std::vector<float> color;
+	std::vector<float> alpha;
+	std::vector<float> size;
+	std::vector<float> rotation;
+	std::vector<float> rotationSpeed;
+	// 0.0 for flame, 1.0 for smoke particles, used to select the per type rates without branching
+	std::vector<float> smoke;
+
+	void resize(size_t count)
+	{
+		for (auto array : { &posX, &posY, &posZ, &velX, &velY, &velZ, &color, &alpha, &size, &rotation, &rotationSpeed, &smoke }) {
+			array->resize(count);
+		}
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -52,15 +77,80 @@ public:
 	glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
 	glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
 
+	uint32_t particleCount = PARTICLE_COUNT;
+
+	enum SimulationMode { SIMULATION_CPU = 0, SIMULATION_GPU = 1 };
+	int32_t simulationMode = SIMULATION_GPU;
+
+	// Vertex buffer for the CPU simulation, contains a copy of the particles per frame in flight so a frame's particles can be written while the previous frame is still rendered
 	struct {
 		VkBuffer buffer;
 		VkDeviceMemory memory;
 		// Store the mapped address of the particle data for reuse
 		void *mappedMemory;
-		// Size of the particle buffer in bytes
+		// Size of the particles of a single frame in bytes
 		size_t size;
 	} particles;
 
+	// Resources for the GPU simulation
+	// Particles are recycled through a dead list and the particles alive after a simulation step are appended to an alive list, which ping-pongs between frames
+	// The vertex count of the alive list's indirect draw command doubles as the list's counter, so the number of particles drawn never has to be read back
+	struct {
+		// Persistent particle state
+		vks::Buffer particles;
+		// Alive particles compacted for rendering
+		vks::Buffer vertices;
+		// Number of dead particles followed by their indices
+		vks::Buffer deadList;
+		std::array<vks::Buffer, 2> aliveLists;
+		// One VkDrawIndirectCommand per alive list
+		vks::Buffer drawCommands;
+		VkDescriptorSetLayout descriptorSetLayout;
+		// Descriptor set i reads alive list i and writes the other one
+		std::array<VkDescriptorSet, 2> descriptorSets;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline emit;
+		VkPipeline simulate;
+		// Alive list containing the particles of the last simulation step
+		uint32_t current = 0;
+	} compute;
+
+	// Depth sorting of the GPU simulated particles, the blending isn't order independent so particles need to be drawn back to front
+	// The alive particles are sorted by view space depth with a radix sort every frame, and drawn with an index buffer containing their sorted indices
+	struct {
+		// Requires subgroup support (see vks::RadixSort::supported)
+		bool supported = false;
+		bool enabled = true;
+		// Sort key per alive particle
+		vks::Buffer keys;
+		// Indices of the alive particles, sorted back to front after the sort
+		vks::Buffer indices;
+		// VkDrawIndexedIndirectCommand for drawing the sorted particles
+		vks::Buffer drawCommand;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline keysPipeline;
+		vks::RadixSort radixSort;
+	} sort;
+
+	struct SortPushConstants {
+		glm::mat4 modelView;
+		float nearPlane;
+		float farPlane;
+		uint32_t current;
+	};
+
+	struct ComputePushConstants {
+		glm::vec4 emitterPos;
+		glm::vec2 velocityRange;
+		float particleTimer;
+		float frameTimer;
+		uint32_t seed;
+		uint32_t particleCount;
+		uint32_t current;
+	};
+
 	struct {
 		vks::Buffer fire;
 		vks::Buffer environment;
@@ -93,13 +183,13 @@ public:
 		VkDescriptorSet environment;
 	} descriptorSets;
 
-	std::vector<Particle> particleBuffer;
+	ParticleArrays particleArrays;
 
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
-		title = "CPU based particle system";
+		title = "Fire particle system";
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -75.0f));
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
@@ -107,6 +197,18 @@ public:
 		settings.overlay = true;
 		timerSpeed *= 8.0f;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		// The GPU simulation needs to be recorded every frame
+		dynamicCommandBuffers = true;
+		// The particle sort uses subgroup operations
+		apiVersion = VK_API_VERSION_1_1;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("particles", { "-np", "--particles" }, 1, "Number of particles");
+		exampleArgs.add("simulation", { "-sim", "--simulation" }, 1, "Simulate the particles on the \"cpu\" or the \"gpu\" (default)");
+		exampleArgs.parse(args);
+		particleCount = std::max(exampleArgs.getValueAsInt("particles", PARTICLE_COUNT), 1);
+		if (exampleArgs.getValueAsString("simulation", "gpu") == "cpu") {
+			simulationMode = SIMULATION_CPU;
+		}
 	}
 
 	~VulkanExample()
@@ -129,6 +231,27 @@ public:
 		vkDestroyBuffer(device, particles.buffer, nullptr);
 		vkFreeMemory(device, particles.memory, nullptr);
 
+		compute.particles.destroy();
+		compute.vertices.destroy();
+		compute.deadList.destroy();
+		compute.aliveLists[0].destroy();
+		compute.aliveLists[1].destroy();
+		compute.drawCommands.destroy();
+		vkDestroyPipeline(device, compute.emit, nullptr);
+		vkDestroyPipeline(device, compute.simulate, nullptr);
+		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
+
+		if (sort.supported) {
+			sort.radixSort.destroy();
+			sort.keys.destroy();
+			sort.indices.destroy();
+			sort.drawCommand.destroy();
+			vkDestroyPipeline(device, sort.keysPipeline, nullptr);
+			vkDestroyPipelineLayout(device, sort.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, sort.descriptorSetLayout, nullptr);
+		}
+
 		uniformBuffers.environment.destroy();
 		uniformBuffers.fire.destroy();
 
@@ -143,9 +266,96 @@ public:
 		};
 	}
 
-	void buildCommandBuffers()
+	// Simulate the particles on the GPU, the alive particles are appended to the other alive list and drawn from there
+	void recordComputeCommands(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t next = 1 - compute.current;
+
+		// The previous frame's simulation and draw have to be finished with the buffers
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Clear the counter of the alive list written by this step
+		vkCmdFillBuffer(commandBuffer, compute.drawCommands.buffer, next * sizeof(VkDrawIndirectCommand) + offsetof(VkDrawIndirectCommand, vertexCount), sizeof(uint32_t), 0);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		ComputePushConstants pushConstants;
+		pushConstants.emitterPos = glm::vec4(emitterPos, 0.0f);
+		pushConstants.velocityRange = glm::vec2(minVel.y, maxVel.y);
+		pushConstants.particleTimer = frameTimer * 0.45f;
+		pushConstants.frameTimer = frameTimer;
+		pushConstants.seed = static_cast<uint32_t>(rndEngine());
+		pushConstants.particleCount = particleCount;
+		pushConstants.current = compute.current;
+
+		// The number of dead and alive particles isn't known on the host, so both passes are dispatched for all particles and skip the invocations that have nothing to do
+		const uint32_t groupCount = (particleCount + 255) / 256;
+
+		gpuProfiler.beginScope(commandBuffer, "Simulate particles", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[compute.current], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+
+		// Respawn dead particles at the emitter and add them to the current alive list
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.emit);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Update the alive particles, particles that die are added to the dead list
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.simulate);
+		vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		compute.current = next;
+	}
+
+	// Sort the alive particles of the current alive list back to front, runs every frame (even when paused) as the order depends on the camera
+	void recordSortCommands(VkCommandBuffer commandBuffer)
+	{
+		// The simulation has to be finished with the particles, and the previous frame's draw with the indices and the draw command
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		SortPushConstants pushConstants;
+		pushConstants.modelView = camera.matrices.view;
+		pushConstants.nearPlane = camera.getNearClip();
+		pushConstants.farPlane = camera.getFarClip();
+		pushConstants.current = compute.current;
+
+		gpuProfiler.beginScope(commandBuffer, "Sort particles", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sort.pipelineLayout, 0, 1, &sort.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, sort.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPushConstants), &pushConstants);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sort.keysPipeline);
+		vkCmdDispatch(commandBuffer, (particleCount + 255) / 256, 1, 1);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// The keys are 16 bit depth values, so two passes are enough
+		// The number of alive particles is read from the vertex count of the current alive list's draw command
+		sort.radixSort.record(commandBuffer, compute.current * sizeof(VkDrawIndirectCommand) / sizeof(uint32_t), 16);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Called by the base class right before the current frame's command buffer is submitted
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = defaultClearColor;
@@ -159,41 +369,64 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
+		// The fence of this frame in flight has been waited on, so its copy of the CPU simulated particles can be written
+		const VkDeviceSize particleOffset = currentFrame * particles.size;
+		if ((simulationMode == SIMULATION_CPU) && !paused) {
+			updateParticles();
+			packParticles(reinterpret_cast<Particle*>(static_cast<char*>(particles.mappedMemory) + particleOffset));
+		}
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		gpuProfiler.beginFrame(commandBuffer);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		if ((simulationMode == SIMULATION_GPU) && !paused) {
+			recordComputeCommands(commandBuffer);
+		}
+		const bool sortParticles = (simulationMode == SIMULATION_GPU) && sort.supported && sort.enabled;
+		if (sortParticles) {
+			recordSortCommands(commandBuffer);
+		}
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0,0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkDeviceSize offsets[1] = { 0 };
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			// Environment
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.environment, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.environment);
-			environment.draw(drawCmdBuffers[i]);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0,0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			// Particle system (no index buffer)
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+		// Environment
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.environment, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.environment);
+		environment.draw(commandBuffer);
+
+		// Particle system (no index buffer)
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
+		if (sortParticles) {
+			// The sorted indices are used as the index buffer, the number of particles is taken from the draw command written by the sort
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &compute.vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, sort.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexedIndirect(commandBuffer, sort.drawCommand.buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+		} else if (simulationMode == SIMULATION_GPU) {
+			// The number of alive particles is taken from the draw command written by the simulation
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &compute.vertices.buffer, offsets);
+			vkCmdDrawIndirect(commandBuffer, compute.drawCommands.buffer, compute.current * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		} else {
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &particles.buffer, &particleOffset);
+			vkCmdDraw(commandBuffer, particleCount, 1, 0, 0);
+		}
 
-			drawUI(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	float rnd(float range)
@@ -202,108 +435,271 @@ public:
 		return rndDist(rndEngine);
 	}
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
+	void initParticle(uint32_t index, glm::vec3 emitterPos)
 	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		ParticleArrays& p = particleArrays;
+		p.velX[index] = 0.0f;
+		p.velY[index] = minVel.y + rnd(maxVel.y - minVel.y);
+		p.velZ[index] = 0.0f;
+		p.alpha[index] = rnd(0.75f);
+		p.size[index] = 1.0f + rnd(0.5f);
+		p.color[index] = 1.0f;
+		p.smoke[index] = 0.0f;
+		p.rotation[index] = rnd(2.0f * float(M_PI));
+		p.rotationSpeed[index] = rnd(2.0f) - rnd(2.0f);
 
 		// Get random sphere point
 		float theta = rnd(2.0f * float(M_PI));
 		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
 		float r = rnd(FLAME_RADIUS);
 
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		p.posX[index] = r * cos(theta) * cos(phi) + emitterPos.x;
+		p.posY[index] = r * sin(phi) + emitterPos.y;
+		p.posZ[index] = r * sin(theta) * cos(phi) + emitterPos.z;
 	}
 
-	void transitionParticle(Particle *particle)
+	void transitionParticle(uint32_t index)
 	{
-		switch (particle->type)
+		ParticleArrays& p = particleArrays;
+		// Flame particles have a chance of turning into smoke, smoke particles respawn at the end of their life
+		if ((p.smoke[index] == 0.0f) && (rnd(1.0f) < 0.05f))
 		{
-		case PARTICLE_TYPE_FLAME:
-			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
-			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
-			}
-			else
-			{
-				initParticle(particle, emitterPos);
-			}
-			break;
-		case PARTICLE_TYPE_SMOKE:
-			// Respawn at end of life
-			initParticle(particle, emitterPos);
-			break;
+			p.alpha[index] = 0.0f;
+			p.color[index] = 0.25f + rnd(0.25f);
+			p.posX[index] *= 0.5f;
+			p.posZ[index] *= 0.5f;
+			p.velX[index] = rnd(1.0f) - rnd(1.0f);
+			p.velY[index] = (minVel.y * 2) + rnd(maxVel.y - minVel.y);
+			p.velZ[index] = rnd(1.0f) - rnd(1.0f);
+			p.size[index] = 1.0f + rnd(0.5f);
+			p.rotationSpeed[index] = rnd(1.0f) - rnd(1.0f);
+			p.smoke[index] = 1.0f;
+		}
+		else
+		{
+			initParticle(index, emitterPos);
+		}
+	}
+
+	// Convert the particles to the vertex layout
+	void packParticles(Particle* target)
+	{
+		const ParticleArrays& p = particleArrays;
+		for (uint32_t i = 0; i < particleCount; i++) {
+			Particle& particle = target[i];
+			particle.pos = glm::vec4(p.posX[i], p.posY[i], p.posZ[i], 0.0f);
+			particle.color = glm::vec4(p.color[i]);
+			particle.alpha = p.alpha[i];
+			particle.size = p.size[i];
+			particle.rotation = p.rotation[i];
+			particle.type = (p.smoke[i] == 0.0f) ? PARTICLE_TYPE_FLAME : PARTICLE_TYPE_SMOKE;
+			particle.vel = glm::vec4(p.velX[i], p.velY[i], p.velZ[i], 0.0f);
+			particle.rotationSpeed = p.rotationSpeed[i];
 		}
 	}
 
 	void prepareParticles()
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
+		particleArrays.resize(particleCount);
+		for (uint32_t i = 0; i < particleCount; i++)
 		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+			initParticle(i, emitterPos);
+			particleArrays.alpha[i] = 1.0f - (abs(particleArrays.posY[i]) / (FLAME_RADIUS * 2.0f));
 		}
 
-		particles.size = particleBuffer.size() * sizeof(Particle);
+		particles.size = particleCount * sizeof(Particle);
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			particles.size,
+			particles.size * maxFramesInFlight,
 			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
+			&particles.memory));
 
 		// Map the memory and store the pointer for reuse
-		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size * maxFramesInFlight, 0, &particles.mappedMemory));
+		for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+			packParticles(reinterpret_cast<Particle*>(static_cast<char*>(particles.mappedMemory) + i * particles.size));
+		}
 	}
 
+	// Update the particles on the CPU, the per type rates are blended with the smoke mask instead of branching so the loop vectorizes
 	void updateParticles()
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
+		ParticleArrays& p = particleArrays;
+		const float particleTimer = frameTimer * 0.45f;
+		const float* smoke = p.smoke.data();
+		float* posX = p.posX.data();
+		float* posY = p.posY.data();
+		float* posZ = p.posZ.data();
+		float* alpha = p.alpha.data();
+		float* size = p.size.data();
+		float* color = p.color.data();
+		float* rotation = p.rotation.data();
+		const float* velX = p.velX.data();
+		const float* velY = p.velY.data();
+		const float* velZ = p.velZ.data();
+		const float* rotationSpeed = p.rotationSpeed.data();
+		for (uint32_t i = 0; i < particleCount; i++)
 		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
+			// Flame particles only rise, smoke particles move along their velocity
+			posX[i] -= velX[i] * frameTimer * smoke[i];
+			posY[i] -= velY[i] * (particleTimer * 3.5f + (frameTimer - particleTimer * 3.5f) * smoke[i]);
+			posZ[i] -= velZ[i] * frameTimer * smoke[i];
+			alpha[i] += particleTimer * (2.5f - 1.25f * smoke[i]);
+			size[i] += particleTimer * (-0.5f + 0.625f * smoke[i]);
+			color[i] -= particleTimer * 0.05f * smoke[i];
+			rotation[i] += particleTimer * rotationSpeed[i];
+		}
+		// Transitions need random numbers and only affect a few particles per frame, so they're done in a separate scalar loop
+		for (uint32_t i = 0; i < particleCount; i++)
+		{
+			if (alpha[i] > 2.0f)
 			{
-				transitionParticle(&particle);
+				transitionParticle(i);
 			}
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+	}
+
+	// Create a device local buffer and fill it from the host
+	void createDeviceBuffer(vks::Buffer& buffer, VkBufferUsageFlags usage, VkDeviceSize size, const void* data)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, const_cast<void*>(data)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, size));
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = { 0, 0, size };
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+	}
+
+	// The GPU simulation starts with the same particles as the CPU simulation, all of them alive
+	void prepareCompute()
+	{
+		std::vector<Particle> initialParticles(particleCount);
+		packParticles(initialParticles.data());
+		createDeviceBuffer(compute.particles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, particleCount * sizeof(Particle), initialParticles.data());
+		createDeviceBuffer(compute.vertices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, particleCount * sizeof(Particle), initialParticles.data());
+
+		std::vector<uint32_t> deadList(particleCount + 1, 0);
+		createDeviceBuffer(compute.deadList, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, deadList.size() * sizeof(uint32_t), deadList.data());
+
+		std::vector<uint32_t> aliveList(particleCount);
+		for (uint32_t i = 0; i < particleCount; i++) {
+			aliveList[i] = i;
+		}
+		createDeviceBuffer(compute.aliveLists[0], VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, aliveList.size() * sizeof(uint32_t), aliveList.data());
+		createDeviceBuffer(compute.aliveLists[1], VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, aliveList.size() * sizeof(uint32_t), aliveList.data());
+
+		std::array<VkDrawIndirectCommand, 2> drawCommands = { { { particleCount, 1, 0, 0 }, { 0, 1, 0, 0 } } };
+		createDeviceBuffer(compute.drawCommands, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(drawCommands), drawCommands.data());
+		compute.current = 0;
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Particles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Compacted alive particles for rendering
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Dead list
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Alive list read by this step
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Alive list written by this step
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5 : Indirect draw commands
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputePushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &compute.pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (uint32_t i = 0; i < 2; i++) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.particles.descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.vertices.descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.deadList.descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.aliveLists[i].descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.aliveLists[1 - i].descriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compute.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &compute.drawCommands.descriptor));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// The simulation is recorded into the graphics command buffer, so it runs on the graphics queue
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "particlefire/particle_emit.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.emit));
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "particlefire/particle_simulate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.simulate));
+	}
+
+	void prepareSort()
+	{
+		sort.supported = vks::RadixSort::supported(vulkanDevice);
+		if (!sort.supported) {
+			std::cout << "Device does not support the subgroup operations required for sorting particles, particles are drawn unsorted\n";
+			return;
+		}
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &sort.keys, particleCount * sizeof(uint32_t)));
+		std::vector<uint32_t> indices(particleCount);
+		for (uint32_t i = 0; i < particleCount; i++) {
+			indices[i] = i;
+		}
+		createDeviceBuffer(sort.indices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.size() * sizeof(uint32_t), indices.data());
+		VkDrawIndexedIndirectCommand drawCommand = { particleCount, 1, 0, 0, 0 };
+		createDeviceBuffer(sort.drawCommand, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(drawCommand), &drawCommand);
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Compacted alive particles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Indirect draw commands of the alive lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Sort keys
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Particle indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Indexed indirect draw command
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &sort.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&sort.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SortPushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &sort.pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &sort.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &sort.descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(sort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.vertices.descriptor),
+			vks::initializers::writeDescriptorSet(sort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.drawCommands.descriptor),
+			vks::initializers::writeDescriptorSet(sort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &sort.keys.descriptor),
+			vks::initializers::writeDescriptorSet(sort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &sort.indices.descriptor),
+			vks::initializers::writeDescriptorSet(sort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &sort.drawCommand.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(sort.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "particlefire/particle_sortkeys.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &sort.keysPipeline));
+
+		// The particle indices are the values sorted along with the keys, the number of keys is the vertex count of the current alive list
+		std::array<VkPipelineShaderStageCreateInfo, 3> sortStages = {
+			loadShader(getShadersPath() + "base/radixsort_count.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getShadersPath() + "base/radixsort_scan.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getShadersPath() + "base/radixsort_scatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+		};
+		sort.radixSort.prepare(vulkanDevice, particleCount, sort.keys, sort.indices, compute.drawCommands, sortStages, pipelineCache);
 	}
 
 	void loadAssets()
@@ -351,9 +747,10 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 17)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -369,10 +766,10 @@ public:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSets()
@@ -481,7 +878,7 @@ public:
 
 			shaderStages[0] = loadShader(getShadersPath() + "particlefire/particle.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "particlefire/particle.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.particles));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.particles));
 		}
 
 		// Environment rendering pipeline (normal mapped)
@@ -495,7 +892,7 @@ public:
 
 			shaderStages[0] = loadShader(getShadersPath() + "particlefire/normalmap.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "particlefire/normalmap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.environment));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.environment));
 		}
 	}
 
@@ -525,6 +922,7 @@ public:
 
 	void updateUniformBufferLight()
 	{
+		waitForFramesInFlight();
 		// Environment
 		uboEnv.lightPos.x = sin(timer * 2.0f * float(M_PI)) * 1.5f;
 		uboEnv.lightPos.y = 0.0f;
@@ -534,6 +932,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Particle system fire
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
@@ -547,20 +946,6 @@ public:
 		memcpy(uniformBuffers.environment.mapped, &uboEnv, sizeof(uboEnv));
 	}
 
-	void draw()
-	{
-		VulkanExampleBase::prepareFrame();
-
-		// Command buffer to be submitted to the queue
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-
-		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		VulkanExampleBase::submitFrame();
-	}
-
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -571,7 +956,8 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
-		buildCommandBuffers();
+		prepareCompute();
+		prepareSort();
 		prepared = true;
 	}
 
@@ -579,17 +965,38 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		renderFrame();
 		if (!paused)
 		{
 			updateUniformBufferLight();
-			updateParticles();
 		}
 		if (camera.updated)
 		{
 			updateUniformBuffers();
 		}
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->text("%d particles", particleCount);
+			// Both simulations keep their own state, so switching continues where the other left off
+			overlay->comboBox("Simulation", &simulationMode, { "CPU", "GPU" });
+			// Only the GPU simulation is sorted
+			if (sort.supported && (simulationMode == SIMULATION_GPU)) {
+				overlay->checkBox("Depth sort", &sort.enabled);
+			}
+		}
+	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if ((name == "particlesort") && sort.supported) {
+			sort.enabled = enabled;
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
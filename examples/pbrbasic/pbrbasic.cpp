@@ -60,6 +60,8 @@ public:
 
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
+	// Only created if the depth prepass is enabled (--depthprepass)
+	VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 
@@ -82,6 +84,7 @@ public:
 		paused = true;
 		timerSpeed *= 0.25f;
 		settings.overlay = true;
+		depthPrepass.supported = true;
 
 		// Setup some default materials (source: https://seblagarde.wordpress.com/2011/08/17/feeding-a-physical-based-lighting-mode/)
 		materials.push_back(Material("Gold", glm::vec3(1.0f, 0.765557f, 0.336057f), 0.1f, 1.0f));
@@ -108,6 +111,9 @@ public:
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipeline, nullptr);
+		if (depthPrepassPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, depthPrepassPipeline, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -116,6 +122,36 @@ public:
 		uniformBuffers.params.destroy();
 	}
 
+	void drawObjects(VkCommandBuffer commandBuffer)
+	{
+		Material mat = materials[materialIndex];
+
+//#define SINGLE_ROW 1
+#ifdef SINGLE_ROW
+		mat.params.metallic = 1.0;
+
+		uint32_t objcount = 10;
+		for (uint32_t x = 0; x < objcount; x++) {
+			glm::vec3 pos = glm::vec3(float(x - (objcount / 2.0f)) * 2.5f, 0.0f, 0.0f);
+			mat.params.roughness = glm::clamp((float)x / (float)objcount, 0.005f, 1.0f);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
+			models.objects[models.objectIndex].draw(commandBuffer);
+		}
+#else
+		for (uint32_t y = 0; y < GRID_DIM; y++) {
+			for (uint32_t x = 0; x < GRID_DIM; x++) {
+				glm::vec3 pos = glm::vec3(float(x - (GRID_DIM / 2.0f)) * 2.5f, 0.0f, float(y - (GRID_DIM / 2.0f)) * 2.5f);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
+				mat.params.metallic = glm::clamp((float)x / (float)(GRID_DIM - 1), 0.1f, 1.0f);
+				mat.params.roughness = glm::clamp((float)y / (float)(GRID_DIM - 1), 0.05f, 1.0f);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
+				models.objects[models.objectIndex].draw(commandBuffer);
+			}
+		}
+#endif
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -150,36 +186,19 @@ public:
 
 			VkDeviceSize offsets[1] = { 0 };
 
-			// Objects
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			Material mat = materials[materialIndex];
-
-//#define SINGLE_ROW 1
-#ifdef SINGLE_ROW
-			mat.params.metallic = 1.0;
-
-			uint32_t objcount = 10;
-			for (uint32_t x = 0; x < objcount; x++) {
-				glm::vec3 pos = glm::vec3(float(x - (objcount / 2.0f)) * 2.5f, 0.0f, 0.0f);
-				mat.params.roughness = glm::clamp((float)x / (float)objcount, 0.005f, 1.0f);
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
-				models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
-			}
-#else
-			for (uint32_t y = 0; y < GRID_DIM; y++) {
-				for (uint32_t x = 0; x < GRID_DIM; x++) {
-					glm::vec3 pos = glm::vec3(float(x - (GRID_DIM / 2.0f)) * 2.5f, 0.0f, float(y - (GRID_DIM / 2.0f)) * 2.5f);
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
-					mat.params.metallic = glm::clamp((float)x / (float)(GRID_DIM - 1), 0.1f, 1.0f);
-					mat.params.roughness = glm::clamp((float)y / (float)(GRID_DIM - 1), 0.05f, 1.0f);
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
-					models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
-				}
+			// Depth prepass, the main subpass then only shades the visible fragments of the objects
+			if (depthPrepass.enabled) {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+				drawObjects(drawCmdBuffers[i]);
+				vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
 			}
-#endif
+
+			// Objects
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			drawObjects(drawCmdBuffers[i]);
+
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -207,7 +226,7 @@ public:
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
@@ -220,7 +239,7 @@ public:
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 2;
 		pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSets()
@@ -281,7 +300,8 @@ public:
 		// Enable depth test and write
 		depthStencilState.depthWriteEnable = VK_TRUE;
 		depthStencilState.depthTestEnable = VK_TRUE;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		prepareDepthPrepassPipeline(pipelineCI, depthStencilState, &depthPrepassPipeline);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -311,6 +331,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// 3D object
 		uboMatrices.projection = camera.matrices.perspective;
 		uboMatrices.view = camera.matrices.view;
@@ -321,6 +342,7 @@ public:
 
 	void updateLights()
 	{
+		waitForFramesInFlight();
 		const float p = 15.0f;
 		uboParams.lights[0] = glm::vec4(-p, -p*0.5f, -p, 1.0f);
 		uboParams.lights[1] = glm::vec4(-p, -p*0.5f,  p, 1.0f);
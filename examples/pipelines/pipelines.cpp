@@ -1,6 +1,10 @@
 /*
 * Vulkan Example - Using different pipelines in one single renderpass
 *
+* The pipelines can be created as independent pipelines, as derivatives of a base pipeline or by linking parts that are
+* compiled once with VK_EXT_graphics_pipeline_library (if supported), creation times of the different paths are displayed for comparison
+* All paths compile the pipelines (or pipeline parts) that don't depend on each other in parallel on the base's pipeline compiler
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -29,11 +33,30 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Phong, toon and wireframe (only if non solid fill modes are supported)
+	enum Variant { Phong = 0, Toon = 1, Wireframe = 2, VariantCount = 3 };
+	std::array<VkPipeline, VariantCount> pipelines{};
+	// Shaders of the variants, loaded once as they're used by every creation path
+	std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, VariantCount> shaderStages;
+
+	enum CreationMode { CreationModeFull = 0, CreationModeDerivatives = 1, CreationModeLibrary = 2, CreationModeCount = 3 };
+	int32_t creationMode = CreationModeDerivatives;
+	bool graphicsPipelineLibrarySupported = false;
+	// Milliseconds it took to create all variants with each creation mode, negative if not measured
+	std::array<double, CreationModeCount> creationTimes = { -1.0, -1.0, -1.0 };
+	// Milliseconds it took to compile the parts of the pipeline library (only done once)
+	double libraryCreationTime = -1.0;
+
+#if defined(VK_EXT_graphics_pipeline_library)
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+	// Parts of the pipelines that are compiled once and linked into the final pipelines
 	struct {
-		VkPipeline phong;
-		VkPipeline wireframe;
-		VkPipeline toon;
-	} pipelines;
+		VkPipeline vertexInputInterface = VK_NULL_HANDLE;
+		std::array<VkPipeline, VariantCount> preRasterization{};
+		std::array<VkPipeline, VariantCount> fragmentShader{};
+		VkPipeline fragmentOutputInterface = VK_NULL_HANDLE;
+	} pipelineLibrary;
+#endif
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -44,18 +67,23 @@ public:
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)(width / 3.0f) / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		// Graphics pipeline library support is queried with vkGetPhysicalDeviceFeatures2
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
-		vkDestroyPipeline(device, pipelines.phong, nullptr);
-		if (deviceFeatures.fillModeNonSolid)
-		{
-			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
+		destroyPipelines();
+#if defined(VK_EXT_graphics_pipeline_library)
+		vkDestroyPipeline(device, pipelineLibrary.vertexInputInterface, nullptr);
+		vkDestroyPipeline(device, pipelineLibrary.fragmentOutputInterface, nullptr);
+		for (uint32_t i = 0; i < VariantCount; i++) {
+			vkDestroyPipeline(device, pipelineLibrary.preRasterization[i], nullptr);
+			vkDestroyPipeline(device, pipelineLibrary.fragmentShader[i], nullptr);
 		}
-		vkDestroyPipeline(device, pipelines.toon, nullptr);
+#endif
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -74,6 +102,32 @@ public:
 				enabledFeatures.wideLines = VK_TRUE;
 			}
 		};
+#if defined(VK_EXT_graphics_pipeline_library)
+		// Pipeline libraries are optional, the other creation modes are always available
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		bool extensionsSupported[2] = { false, false };
+		for (auto& extension : extensions) {
+			extensionsSupported[0] |= (strcmp(extension.extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0);
+			extensionsSupported[1] |= (strcmp(extension.extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0);
+		}
+		if (extensionsSupported[0] && extensionsSupported[1] && (deviceProperties.apiVersion >= VK_API_VERSION_1_1)) {
+			graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &graphicsPipelineLibraryFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			graphicsPipelineLibrarySupported = (graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE);
+		}
+		if (graphicsPipelineLibrarySupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+			graphicsPipelineLibraryFeatures.pNext = nullptr;
+			deviceCreatepNextChain = &graphicsPipelineLibraryFeatures;
+		}
+#endif
 	}
 
 	void buildCommandBuffers()
@@ -114,13 +168,13 @@ public:
 			// Left : Solid colored
 			viewport.width = (float)width / 3.0;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[Phong]);
 			scene.draw(drawCmdBuffers[i]);
 
 			// Center : Toon
 			viewport.x = (float)width / 3.0;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.toon);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[Toon]);
 			// Line width > 1.0f only if wide lines feature is supported
 			if (deviceFeatures.wideLines) {
 				vkCmdSetLineWidth(drawCmdBuffers[i], 2.0f);
@@ -132,7 +186,7 @@ public:
 				// Right : Wireframe
 				viewport.x = (float)width / 3.0 + (float)width / 3.0;
 				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.wireframe);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[Wireframe]);
 				scene.draw(drawCmdBuffers[i]);
 			}
 
@@ -182,14 +236,14 @@ public:
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -215,10 +269,53 @@ public:
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
-	void preparePipelines()
+	uint32_t getVariantCount()
+	{
+		// Non solid rendering is not a mandatory Vulkan feature
+		return deviceFeatures.fillModeNonSolid ? VariantCount : Wireframe;
+	}
+
+	void loadShaders()
+	{
+		const std::array<std::string, VariantCount> shaderNames = { "phong", "toon", "wireframe" };
+		for (uint32_t i = 0; i < getVariantCount(); i++) {
+			shaderStages[i][0] = loadShader(getShadersPath() + "pipelines/" + shaderNames[i] + ".vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[i][1] = loadShader(getShadersPath() + "pipelines/" + shaderNames[i] + ".frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
+	}
+
+	void destroyPipelines()
+	{
+		for (auto& pipeline : pipelines) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			pipeline = VK_NULL_HANDLE;
+		}
+	}
+
+	// Compile a batch of pipelines in parallel on the worker threads of the base's pipeline compiler and wait for all of them
+	// The jobs create the pipelines with the given cache instead of the compiler's one (see preparePipelines)
+	void compilePipelines(VkPipelineCache cache, const std::vector<VkGraphicsPipelineCreateInfo>& createInfos, const std::vector<VkPipeline*>& handles)
+	{
+		assert(createInfos.size() == handles.size());
+		std::vector<std::shared_future<VkPipeline>> futures;
+		for (size_t i = 0; i < createInfos.size(); i++) {
+			const VkDevice device = this->device;
+			const VkGraphicsPipelineCreateInfo createInfo = createInfos[i];
+			VkPipeline* handle = handles[i];
+			futures.push_back(pipelineCompiler.addJob([=] {
+				VK_CHECK_RESULT(vks::createGraphicsPipelines(device, cache, 1, &createInfo, nullptr, handle));
+				return *handle;
+			}));
+		}
+		for (auto& future : futures) {
+			future.wait();
+		}
+	}
+
+	// Create the variants with full state, either as independent pipelines or as derivatives of the first one
+	void createPipelines(VkPipelineCache cache, bool derivatives)
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
@@ -226,56 +323,208 @@ public:
 		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH, };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		// The variants are compiled at the same time, so each of them needs its own copy of the state that differs
+		std::array<VkPipelineRasterizationStateCreateInfo, VariantCount> rasterizationStates;
 
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
-		pipelineCI.pRasterizationState = &rasterizationState;
 		pipelineCI.pColorBlendState = &colorBlendState;
 		pipelineCI.pMultisampleState = &multisampleState;
 		pipelineCI.pViewportState = &viewportState;
 		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = shaderStages.size();
-		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState  = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color});
 
-		// Create the graphics pipeline state objects
-
-		// We are using this pipeline as the base for the other pipelines (derivatives)
-		// Pipeline derivatives can be used for pipelines that share most of their state
-		// Depending on the implementation this may result in better performance for pipeline
-		// switching and faster creation time
-		pipelineCI.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
-
-		// Textured pipeline
-		// Phong shading pipeline
-		shaderStages[0] = loadShader(getShadersPath() + "pipelines/phong.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "pipelines/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
-
-		// All pipelines created after the base pipeline will be derivatives
-		pipelineCI.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
-		// Base pipeline will be our first created pipeline
-		pipelineCI.basePipelineHandle = pipelines.phong;
-		// It's only allowed to either use a handle or index for the base pipeline
-		// As we use the handle, we must set the index to -1 (see section 9.5 of the specification)
-		pipelineCI.basePipelineIndex = -1;
-
-		// Toon shading pipeline
-		shaderStages[0] = loadShader(getShadersPath() + "pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
-
-		// Pipeline for wire frame rendering
-		// Non solid rendering is not a mandatory Vulkan feature
-		if (deviceFeatures.fillModeNonSolid)
+		std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+		std::vector<VkPipeline*> handles;
+		for (uint32_t i = 0; i < getVariantCount(); i++) {
+			rasterizationStates[i] = vks::initializers::pipelineRasterizationStateCreateInfo((i == Wireframe) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+			VkGraphicsPipelineCreateInfo variantCI = pipelineCI;
+			variantCI.pRasterizationState = &rasterizationStates[i];
+			variantCI.stageCount = static_cast<uint32_t>(shaderStages[i].size());
+			variantCI.pStages = shaderStages[i].data();
+			if (derivatives) {
+				if (i == 0) {
+					// We are using this pipeline as the base for the other pipelines (derivatives)
+					// Pipeline derivatives can be used for pipelines that share most of their state
+					// Depending on the implementation this may result in better performance for pipeline
+					// switching and faster creation time
+					variantCI.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+				} else {
+					// All pipelines created after the base pipeline will be derivatives
+					variantCI.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+					// It's only allowed to either use a handle or index for the base pipeline
+					// As we use the handle (set once the base pipeline has been created), we must set the index to -1 (see section 9.5 of the specification)
+					variantCI.basePipelineIndex = -1;
+				}
+			}
+			createInfos.push_back(variantCI);
+			handles.push_back(&pipelines[i]);
+		}
+
+		if (derivatives) {
+			// The derivatives refer to the handle of the base pipeline, so it has to be created before they can be compiled in parallel
+			compilePipelines(cache, { createInfos[0] }, { handles[0] });
+			createInfos.erase(createInfos.begin());
+			handles.erase(handles.begin());
+			for (auto& createInfo : createInfos) {
+				createInfo.basePipelineHandle = pipelines[Phong];
+			}
+		}
+		compilePipelines(cache, createInfos, handles);
+	}
+
+#if defined(VK_EXT_graphics_pipeline_library)
+	/*
+		Compile the parts of the pipelines separately, the variants only differ in shaders and rasterization state, so
+		the vertex input and fragment output interfaces are shared by all of them
+		All parts are independent of each other and compiled in parallel
+	*/
+	void createPipelineLibrary(VkPipelineCache cache)
+	{
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		// The link time optimization info is kept, so the linked pipelines could also be created with link time optimizations
+		pipelineCI.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+		// One library info per part type, as the parts are compiled at the same time
+		std::array<VkGraphicsPipelineLibraryCreateInfoEXT, 4> libraryInfos{};
+		const std::array<VkGraphicsPipelineLibraryFlagsEXT, 4> libraryFlags = {
+			VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+			VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+		};
+		for (size_t i = 0; i < libraryInfos.size(); i++) {
+			libraryInfos[i].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+			libraryInfos[i].flags = libraryFlags[i];
+		}
+
+		std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+		std::vector<VkPipeline*> handles;
+
+		// Vertex input interface
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		{
-			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-			shaderStages[0] = loadShader(getShadersPath() + "pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-			shaderStages[1] = loadShader(getShadersPath() + "pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			VkGraphicsPipelineCreateInfo libraryCI = pipelineCI;
+			libraryCI.pNext = &libraryInfos[0];
+			libraryCI.pInputAssemblyState = &inputAssemblyState;
+			libraryCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
+			createInfos.push_back(libraryCI);
+			handles.push_back(&pipelineLibrary.vertexInputInterface);
+		}
+
+		// Fragment output interface
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		{
+			VkGraphicsPipelineCreateInfo libraryCI = pipelineCI;
+			libraryCI.pNext = &libraryInfos[1];
+			libraryCI.renderPass = renderPass;
+			libraryCI.pColorBlendState = &colorBlendState;
+			libraryCI.pMultisampleState = &multisampleState;
+			createInfos.push_back(libraryCI);
+			handles.push_back(&pipelineLibrary.fragmentOutputInterface);
+		}
+
+		// State of the shader parts, the rasterization state is part of the pre-rasterization shaders and differs for the wireframe variant
+		std::array<VkPipelineRasterizationStateCreateInfo, VariantCount> rasterizationStates;
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH, };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+		for (uint32_t i = 0; i < getVariantCount(); i++) {
+			// Pre-rasterization shaders
+			{
+				rasterizationStates[i] = vks::initializers::pipelineRasterizationStateCreateInfo((i == Wireframe) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+				VkGraphicsPipelineCreateInfo libraryCI = pipelineCI;
+				libraryCI.pNext = &libraryInfos[2];
+				libraryCI.layout = pipelineLayout;
+				libraryCI.renderPass = renderPass;
+				libraryCI.stageCount = 1;
+				libraryCI.pStages = &shaderStages[i][0];
+				libraryCI.pRasterizationState = &rasterizationStates[i];
+				libraryCI.pViewportState = &viewportState;
+				libraryCI.pDynamicState = &dynamicState;
+				createInfos.push_back(libraryCI);
+				handles.push_back(&pipelineLibrary.preRasterization[i]);
+			}
+			// Fragment shader
+			{
+				VkGraphicsPipelineCreateInfo libraryCI = pipelineCI;
+				libraryCI.pNext = &libraryInfos[3];
+				libraryCI.layout = pipelineLayout;
+				libraryCI.renderPass = renderPass;
+				libraryCI.stageCount = 1;
+				libraryCI.pStages = &shaderStages[i][1];
+				libraryCI.pDepthStencilState = &depthStencilState;
+				libraryCI.pMultisampleState = &multisampleState;
+				createInfos.push_back(libraryCI);
+				handles.push_back(&pipelineLibrary.fragmentShader[i]);
+			}
 		}
+
+		compilePipelines(cache, createInfos, handles);
+	}
+
+	// Link the precompiled parts into the final pipelines, which doesn't involve any shader compilation
+	void linkPipelines(VkPipelineCache cache)
+	{
+		std::array<std::array<VkPipeline, 4>, VariantCount> libraries;
+		std::array<VkPipelineLibraryCreateInfoKHR, VariantCount> linkingInfos{};
+		std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+		std::vector<VkPipeline*> handles;
+		for (uint32_t i = 0; i < getVariantCount(); i++) {
+			libraries[i] = {
+				pipelineLibrary.vertexInputInterface,
+				pipelineLibrary.preRasterization[i],
+				pipelineLibrary.fragmentShader[i],
+				pipelineLibrary.fragmentOutputInterface
+			};
+			linkingInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+			linkingInfos[i].libraryCount = static_cast<uint32_t>(libraries[i].size());
+			linkingInfos[i].pLibraries = libraries[i].data();
+			VkGraphicsPipelineCreateInfo pipelineCI{};
+			pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineCI.pNext = &linkingInfos[i];
+			pipelineCI.layout = pipelineLayout;
+			createInfos.push_back(pipelineCI);
+			handles.push_back(&pipelines[i]);
+		}
+		compilePipelines(cache, createInfos, handles);
+	}
+#endif
+
+	// Create the pipelines with the selected creation mode and measure how long it took
+	void preparePipelines()
+	{
+		destroyPipelines();
+		// The pipeline cache is not used, as it would turn all but the first creation into a cache lookup and the times wouldn't be comparable
+		const VkPipelineCache cache = VK_NULL_HANDLE;
+#if defined(VK_EXT_graphics_pipeline_library)
+		if ((creationMode == CreationModeLibrary) && (pipelineLibrary.vertexInputInterface == VK_NULL_HANDLE)) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			createPipelineLibrary(cache);
+			libraryCreationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		}
+#endif
+		auto tStart = std::chrono::high_resolution_clock::now();
+		switch (creationMode) {
+		case CreationModeFull:
+			createPipelines(cache, false);
+			break;
+		case CreationModeDerivatives:
+			createPipelines(cache, true);
+			break;
+		case CreationModeLibrary:
+#if defined(VK_EXT_graphics_pipeline_library)
+			linkPipelines(cache);
+#endif
+			break;
+		}
+		creationTimes[creationMode] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -296,6 +545,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.modelView = camera.matrices.view;
 		memcpy(uniformBuffer.mapped, &uboVS, sizeof(uboVS));
@@ -318,6 +568,13 @@ public:
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
+		loadShaders();
+		// Create the pipelines with every available creation mode once, so the times can be compared right away
+		const int32_t selectedMode = creationMode;
+		for (creationMode = 0; creationMode < (graphicsPipelineLibrarySupported ? CreationModeCount : CreationModeLibrary); creationMode++) {
+			preparePipelines();
+		}
+		creationMode = selectedMode;
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
@@ -342,7 +599,27 @@ public:
 				overlay->text("Non solid fill modes not supported!");
 			}
 		}
+		if (overlay->header("Pipeline creation")) {
+			std::vector<std::string> modes = { "Full", "Derivatives" };
+			if (graphicsPipelineLibrarySupported) {
+				modes.push_back("Pipeline library");
+			}
+			if (overlay->comboBox("Mode", &creationMode, modes)) {
+				preparePipelines();
+			}
+			for (uint32_t i = 0; i < static_cast<uint32_t>(modes.size()); i++) {
+				if (creationTimes[i] >= 0.0) {
+					overlay->text("%s: %.2f ms", modes[i].c_str(), creationTimes[i]);
+				}
+			}
+			if (libraryCreationTime >= 0.0) {
+				overlay->text("Library parts (once): %.2f ms", libraryCreationTime);
+			}
+			if (!graphicsPipelineLibrarySupported) {
+				overlay->text("Pipeline libraries not supported");
+			}
+		}
 	}
 };
 
-VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
+VULKAN_EXAMPLE_MAIN()
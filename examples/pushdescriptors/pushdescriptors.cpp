@@ -1,7 +1,7 @@
 /*
 * Vulkan Example - Push descriptors
 *
-* Note: Requires a device that supports the VK_KHR_push_descriptor extension
+* Note: Requires a device that supports the VK_KHR_push_descriptor and VK_KHR_descriptor_update_template extensions
 *
 * Push descriptors apply the push constants concept to descriptor sets. So instead of creating
 * per-model descriptor sets (along with a pool for each descriptor type) for rendering multiple objects,
@@ -15,6 +15,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanDescriptorUpdateTemplate.h"
 
 #define ENABLE_VALIDATION false
 
@@ -23,14 +24,21 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool animate = true;
 
-	PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR;
 	VkPhysicalDevicePushDescriptorPropertiesKHR pushDescriptorProps{};
 
+	// Descriptor infos for all bindings of the pushed set, in the layout the update template reads them
+	struct CubeDescriptors {
+		VkDescriptorBufferInfo scene;
+		VkDescriptorBufferInfo model;
+		VkDescriptorImageInfo texture;
+	};
+
 	struct Cube {
 		vks::Texture2D texture;
 		vks::Buffer uniformBuffer;
 		glm::vec3 rotation;
 		glm::mat4 modelMat;
+		CubeDescriptors descriptors;
 	};
 	std::array<Cube, 2> cubes;
 
@@ -48,6 +56,7 @@ public:
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSetLayout descriptorSetLayout;
+	vks::DescriptorUpdateTemplate descriptorUpdateTemplate;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -60,11 +69,13 @@ public:
 		// Enable extension required for push descriptors
 		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 		enabledDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
 	}
 
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipeline, nullptr);
+		descriptorUpdateTemplate.destroy();
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		for (auto cube : cubes) {
@@ -116,39 +127,12 @@ public:
 			model.bindBuffers(drawCmdBuffers[i]);
 
 			// Render two cubes using different descriptor sets using push descriptors
-			for (auto cube : cubes) {
+			for (auto& cube : cubes) {
 
 				// Instead of preparing the descriptor sets up-front, using push descriptors we can set (push) them inside of a command buffer
 				// This allows a more dynamic approach without the need to create descriptor sets for each model
-				// Note: dstSet for each descriptor set write is left at zero as this is ignored when using push descriptors
-
-				std::array<VkWriteDescriptorSet, 3> writeDescriptorSets{};
-
-				// Scene matrices
-				writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptorSets[0].dstSet = 0;
-				writeDescriptorSets[0].dstBinding = 0;
-				writeDescriptorSets[0].descriptorCount = 1;
-				writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				writeDescriptorSets[0].pBufferInfo = &uniformBuffers.scene.descriptor;
-
-				// Model matrices
-				writeDescriptorSets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptorSets[1].dstSet = 0;
-				writeDescriptorSets[1].dstBinding = 1;
-				writeDescriptorSets[1].descriptorCount = 1;
-				writeDescriptorSets[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				writeDescriptorSets[1].pBufferInfo = &cube.uniformBuffer.descriptor;
-
-				// Texture
-				writeDescriptorSets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				writeDescriptorSets[2].dstSet = 0;
-				writeDescriptorSets[2].dstBinding = 2;
-				writeDescriptorSets[2].descriptorCount = 1;
-				writeDescriptorSets[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				writeDescriptorSets[2].pImageInfo = &cube.texture.descriptor;
-
-				vkCmdPushDescriptorSetKHR(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 3, writeDescriptorSets.data());
+				// The update template reads all bindings from the cube's packed descriptor infos, so no descriptor writes need to be built per draw
+				descriptorUpdateTemplate.push(drawCmdBuffers[i], pipelineLayout, 0, &cube.descriptors);
 
 				model.draw(drawCmdBuffers[i]);
 			}
@@ -183,10 +167,23 @@ public:
 		descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
 		descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
 		descriptorLayoutCI.pBindings = setLayoutBindings.data();
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// The update template maps each binding to its descriptor info in CubeDescriptors
+		descriptorUpdateTemplate.setup(device);
+		descriptorUpdateTemplate.addEntry(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(CubeDescriptors, scene));
+		descriptorUpdateTemplate.addEntry(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, offsetof(CubeDescriptors, model));
+		descriptorUpdateTemplate.addEntry(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof(CubeDescriptors, texture));
+		descriptorUpdateTemplate.createForPushDescriptors(descriptorSetLayout, pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS, 0);
+
+		for (auto& cube : cubes) {
+			cube.descriptors.scene = uniformBuffers.scene.descriptor;
+			cube.descriptors.model = cube.uniformBuffer.descriptor;
+			cube.descriptors.texture = cube.texture.descriptor;
+		}
 	}
 
 	void preparePipelines()
@@ -216,7 +213,7 @@ public:
 
 		shaderStages[0] = loadShader(getShadersPath() + "pushdescriptors/cube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "pushdescriptors/cube.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 	}
 
 	void prepareUniformBuffers()
@@ -245,6 +242,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboScene.projection = camera.matrices.perspective;
 		uboScene.view = camera.matrices.view;
 		memcpy(uniformBuffers.scene.mapped, &uboScene, sizeof(UboScene));
@@ -252,6 +250,7 @@ public:
 
 	void updateCubeUniformBuffers()
 	{
+		waitForFramesInFlight();
 		cubes[0].modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.0f, 0.0f));
 		cubes[1].modelMat = glm::translate(glm::mat4(1.0f), glm::vec3( 1.5f, 0.5f, 0.0f));
 
@@ -290,12 +289,6 @@ public:
 			Extension specific functions
 		*/
 
-		// The push descriptor update function is part of an extension so it has to be manually loaded
-		vkCmdPushDescriptorSetKHR = (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR");
-		if (!vkCmdPushDescriptorSetKHR) {
-			vks::tools::exitFatal("Could not get a valid function pointer for vkCmdPushDescriptorSetKHR", -1);
-		}
-
 		// Get device push descriptor properties (to display them)
 		PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
 		if (!vkGetPhysicalDeviceProperties2KHR) {
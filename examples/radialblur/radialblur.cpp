@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Fullscreen radial blur (Single pass offscreen effect)
 *
+* The blur is either applied by a fragment shader at full resolution, or by a compute shader at the reduced resolution of the glow pass
+*
 * Copyright (C) Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -12,7 +14,6 @@
 #define ENABLE_VALIDATION false
 
 // Offscreen frame buffer properties
-#define FB_DIM 512
 #define FB_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
 
 class VulkanExample : public VulkanExampleBase
@@ -20,6 +21,12 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool blur = true;
 	bool displayTexture = false;
+	// Blur the glow at its own resolution in a compute shader, so the main pass only upsamples the result with a single fetch per pixel
+	bool computeBlur = true;
+	// The glow pass is rendered at the window size divided by this
+	int32_t glowDivisorIndex = 1;
+	const std::vector<uint32_t> glowDivisors = { 1, 2, 4 };
+	const std::vector<std::string> glowDivisorNames = { "Full", "Half", "Quarter" };
 
 	struct {
 		vks::Texture2D gradient;
@@ -42,6 +49,9 @@ public:
 		float radialBlurScale = 0.35f;
 		float radialBlurStrength = 0.75f;
 		glm::vec2 radialOrigin = glm::vec2(0.5f, 0.5f);
+		int32_t samples = 32;
+		// Weight of each sample relative to the previous one, values below one let the shaders stop early
+		float decay = 1.0f;
 	} uboBlurParams;
 
 	struct {
@@ -49,21 +59,28 @@ public:
 		VkPipeline colorPass;
 		VkPipeline phongPass;
 		VkPipeline offscreenDisplay;
+		VkPipeline radialBlurCompute;
+		VkPipeline composite;
+		VkPipeline compositeDisplay;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout radialBlur;
+		VkPipelineLayout radialBlurCompute;
 		VkPipelineLayout scene;
 	} pipelineLayouts;
 
 	struct {
 		VkDescriptorSet scene;
 		VkDescriptorSet radialBlur;
+		VkDescriptorSet radialBlurCompute;
+		VkDescriptorSet composite;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout scene;
 		VkDescriptorSetLayout radialBlur;
+		VkDescriptorSetLayout radialBlurCompute;
 	} descriptorSetLayouts;
 
 	// Framebuffer for offscreen rendering
@@ -73,12 +90,16 @@ public:
 		VkImageView view;
 	};
 	struct OffscreenPass {
-		int32_t width, height;
+		uint32_t width, height;
+		VkFormat depthFormat;
 		VkFramebuffer frameBuffer;
 		FrameBufferAttachment color, depth;
+		// Radially blurred glow written by the compute shader, same size as the glow
+		FrameBufferAttachment blurred;
 		VkRenderPass renderPass;
 		VkSampler sampler;
 		VkDescriptorImageInfo descriptor;
+		VkDescriptorImageInfo blurredDescriptor;
 	} offscreenPass;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -90,6 +111,8 @@ public:
 		camera.setPerspective(45.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 0.5f;
 		settings.overlay = true;
+		// The glow pass is sized relative to the window and recreated on resize
+		resizeWaitsForFrames = true;
 	}
 
 	~VulkanExample()
@@ -98,31 +121,26 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 
 		// Frame buffer
-
-		// Color attachment
-		vkDestroyImageView(device, offscreenPass.color.view, nullptr);
-		vkDestroyImage(device, offscreenPass.color.image, nullptr);
-		vkFreeMemory(device, offscreenPass.color.mem, nullptr);
-
-		// Depth attachment
-		vkDestroyImageView(device, offscreenPass.depth.view, nullptr);
-		vkDestroyImage(device, offscreenPass.depth.image, nullptr);
-		vkFreeMemory(device, offscreenPass.depth.mem, nullptr);
+		destroyOffscreenTargets();
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 		vkDestroySampler(device, offscreenPass.sampler, nullptr);
-		vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
 
 		vkDestroyPipeline(device, pipelines.radialBlur, nullptr);
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
 		vkDestroyPipeline(device, pipelines.colorPass, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreenDisplay, nullptr);
+		vkDestroyPipeline(device, pipelines.radialBlurCompute, nullptr);
+		vkDestroyPipeline(device, pipelines.composite, nullptr);
+		vkDestroyPipeline(device, pipelines.compositeDisplay, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.radialBlur, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.radialBlurCompute, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.radialBlur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.radialBlurCompute, nullptr);
 
 		uniformBuffers.scene.destroy();
 		uniformBuffers.blurParams.destroy();
@@ -130,55 +148,15 @@ public:
 		textures.gradient.destroy();
 	}
 
-	// Setup the offscreen framebuffer for rendering the blurred scene
-	// The color attachment of this framebuffer will then be used to sample frame in the fragment shader of the final pass
+	// Setup the render pass for rendering the glow offscreen, the size dependent targets are created by createOffscreenTargets
+	// The color attachment of the offscreen framebuffer will then be sampled by the fragment or compute shader applying the blur
 	void prepareOffscreen()
 	{
-		offscreenPass.width = FB_DIM;
-		offscreenPass.height = FB_DIM;
-
 		// Find a suitable depth format
-		VkFormat fbDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
+		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &offscreenPass.depthFormat);
 		assert(validDepthFormat);
 
-		// Color attachment
-		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-		image.imageType = VK_IMAGE_TYPE_2D;
-		image.format = FB_COLOR_FORMAT;
-		image.extent.width = offscreenPass.width;
-		image.extent.height = offscreenPass.height;
-		image.extent.depth = 1;
-		image.mipLevels = 1;
-		image.arrayLayers = 1;
-		image.samples = VK_SAMPLE_COUNT_1_BIT;
-		image.tiling = VK_IMAGE_TILING_OPTIMAL;
-		// We will sample directly from the color attachment
-		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &offscreenPass.color.image));
-		vkGetImageMemoryRequirements(device, offscreenPass.color.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.color.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.color.image, offscreenPass.color.mem, 0));
-
-		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		colorImageView.format = FB_COLOR_FORMAT;
-		colorImageView.subresourceRange = {};
-		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		colorImageView.subresourceRange.baseMipLevel = 0;
-		colorImageView.subresourceRange.levelCount = 1;
-		colorImageView.subresourceRange.baseArrayLayer = 0;
-		colorImageView.subresourceRange.layerCount = 1;
-		colorImageView.image = offscreenPass.color.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreenPass.color.view));
-
-		// Create sampler to sample from the attachment in the fragment shader
+		// Create sampler to sample from the attachment in the fragment and compute shaders
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
@@ -193,30 +171,6 @@ public:
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &offscreenPass.sampler));
 
-		// Depth stencil attachment
-		image.format = fbDepthFormat;
-		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &offscreenPass.depth.image));
-		vkGetImageMemoryRequirements(device, offscreenPass.depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.depth.image, offscreenPass.depth.mem, 0));
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = fbDepthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-		depthStencilView.image = offscreenPass.depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depth.view));
-
 		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
 
 		std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
@@ -230,7 +184,7 @@ public:
 		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		// Depth attachment
-		attchmentDescriptions[1].format = fbDepthFormat;
+		attchmentDescriptions[1].format = offscreenPass.depthFormat;
 		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
 		attchmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -253,7 +207,7 @@ public:
 
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -262,7 +216,8 @@ public:
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		// The glow is read by the radial blur fragment or compute shader
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
@@ -277,7 +232,76 @@ public:
 		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
+
+		createOffscreenTargets();
+	}
+
+	// Create the glow framebuffer and the blur target at the selected fraction of the window size
+	void createOffscreenTargets()
+	{
+		offscreenPass.width = std::max(width / glowDivisors[glowDivisorIndex], 1u);
+		offscreenPass.height = std::max(height / glowDivisors[glowDivisorIndex], 1u);
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		// Color attachment
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = FB_COLOR_FORMAT;
+		image.extent.width = offscreenPass.width;
+		image.extent.height = offscreenPass.height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// We will sample directly from the color attachment
+		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &offscreenPass.color.image));
+		vkGetImageMemoryRequirements(device, offscreenPass.color.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.color.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.color.image, offscreenPass.color.mem, 0));
+
+		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
+		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorImageView.format = FB_COLOR_FORMAT;
+		colorImageView.subresourceRange = {};
+		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorImageView.subresourceRange.baseMipLevel = 0;
+		colorImageView.subresourceRange.levelCount = 1;
+		colorImageView.subresourceRange.baseArrayLayer = 0;
+		colorImageView.subresourceRange.layerCount = 1;
+		colorImageView.image = offscreenPass.color.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreenPass.color.view));
+
+		// Depth stencil attachment
+		image.format = offscreenPass.depthFormat;
+		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &offscreenPass.depth.image));
+		vkGetImageMemoryRequirements(device, offscreenPass.depth.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.depth.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.depth.image, offscreenPass.depth.mem, 0));
+
+		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
+		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		depthStencilView.format = offscreenPass.depthFormat;
+		depthStencilView.flags = 0;
+		depthStencilView.subresourceRange = {};
+		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		depthStencilView.subresourceRange.baseMipLevel = 0;
+		depthStencilView.subresourceRange.levelCount = 1;
+		depthStencilView.subresourceRange.baseArrayLayer = 0;
+		depthStencilView.subresourceRange.layerCount = 1;
+		depthStencilView.image = offscreenPass.depth.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depth.view));
 
 		VkImageView attachments[2];
 		attachments[0] = offscreenPass.color.view;
@@ -293,10 +317,40 @@ public:
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffer));
 
+		// Blur target, written by the compute shader and sampled when compositing
+		image.format = FB_COLOR_FORMAT;
+		image.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &offscreenPass.blurred.image));
+		vkGetImageMemoryRequirements(device, offscreenPass.blurred.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.blurred.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.blurred.image, offscreenPass.blurred.mem, 0));
+		colorImageView.image = offscreenPass.blurred.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreenPass.blurred.view));
+
+		// The blur target stays in the general layout, as it's both written as a storage image and sampled
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, offscreenPass.blurred.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
 		// Fill a descriptor for later use in a descriptor set
 		offscreenPass.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		offscreenPass.descriptor.imageView = offscreenPass.color.view;
 		offscreenPass.descriptor.sampler = offscreenPass.sampler;
+		offscreenPass.blurredDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		offscreenPass.blurredDescriptor.imageView = offscreenPass.blurred.view;
+		offscreenPass.blurredDescriptor.sampler = offscreenPass.sampler;
+	}
+
+	void destroyOffscreenTargets()
+	{
+		for (auto attachment : { offscreenPass.color, offscreenPass.depth, offscreenPass.blurred }) {
+			vkDestroyImageView(device, attachment.view, nullptr);
+			vkDestroyImage(device, attachment.image, nullptr);
+			vkFreeMemory(device, attachment.mem, nullptr);
+		}
+		vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
 	}
 
 	void buildCommandBuffers()
@@ -311,11 +365,13 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
 			/*
 				First render pass: Offscreen rendering
 			*/
 			{
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Glow pass");
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
@@ -336,12 +392,40 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.colorPass);
 				scene.draw(drawCmdBuffers[i]);
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			/*
 				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
 			*/
 
+			/*
+				Compute radial blur at the resolution of the glow pass
+			*/
+			if (blur && computeBlur)
+			{
+				// The previous frame's composite must have finished reading the blur target before it's overwritten
+				VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageMemoryBarrier.image = offscreenPass.blurred.image;
+				imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				imageMemoryBarrier.srcAccessMask = 0;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Radial blur", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.radialBlurCompute);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.radialBlurCompute, 0, 1, &descriptorSets.radialBlurCompute, 0, nullptr);
+				vkCmdDispatch(drawCmdBuffers[i], (offscreenPass.width + 15) / 16, (offscreenPass.height + 15) / 16, 1);
+				gpuProfiler.endScope(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+				// Make the blurred glow visible to the composite
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+
 			/*
 				Second render pass: Scene rendering with applied radial blur
 			*/
@@ -371,11 +455,20 @@ public:
 				scene.draw(drawCmdBuffers[i]);
 
 				// Fullscreen triangle (clipped to a quad) with radial blur
-				if (blur)
+				if (blur && computeBlur)
 				{
+					// Composite the blur applied by the compute shader
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.radialBlur, 0, 1, &descriptorSets.composite, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (displayTexture) ? pipelines.compositeDisplay : pipelines.composite);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				}
+				else if (blur)
+				{
+					gpuProfiler.beginScope(drawCmdBuffers[i], "Radial blur");
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.radialBlur, 0, 1, &descriptorSets.radialBlur, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (displayTexture) ? pipelines.offscreenDisplay : pipelines.radialBlur);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					gpuProfiler.endScope(drawCmdBuffers[i]);
 				}
 
 				drawUI(drawCmdBuffers[i]);
@@ -395,18 +488,19 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses three ubos and one image sampler
+		// Example uses four ubos, four image samplers and one storage image for the compute blur target
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				4);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -427,9 +521,9 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2)
 		};
 		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.scene));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.scene));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.scene, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
 
 		// Fullscreen radial blur
 		setLayoutBindings = {
@@ -439,9 +533,23 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
 		};
 		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.radialBlur));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.radialBlur));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.radialBlur, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.radialBlur));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.radialBlur));
+
+		// Compute radial blur
+		setLayoutBindings = {
+			// Binding 0: Compute shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Compute shader glow image sampler
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Compute shader blur target
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2)
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.radialBlurCompute));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.radialBlurCompute, 1);
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.radialBlurCompute));
 	}
 
 	void setupDescriptorSet()
@@ -464,11 +572,31 @@ public:
 		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.radialBlur, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.radialBlur));
 
+		// Composite of the compute radial blur, uses the same layout as the fragment shader radial blur
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.composite));
+
+		// Compute radial blur
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.radialBlurCompute, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.radialBlurCompute));
+
+		updateOffscreenDescriptorSets();
+	}
+
+	// Point the descriptors at the (re)created offscreen targets
+	void updateOffscreenDescriptorSets()
+	{
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSets.radialBlur, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),
 			// Binding 0: Fragment shader texture sampler
 			vks::initializers::writeDescriptorSet(descriptorSets.radialBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	1, &offscreenPass.descriptor),
+			// Composite: The uniform buffer is unused, but part of the shared layout
+			vks::initializers::writeDescriptorSet(descriptorSets.composite, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.composite, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.blurredDescriptor),
+			// Compute radial blur: Parameters, glow and blur target
+			vks::initializers::writeDescriptorSet(descriptorSets.radialBlurCompute, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.radialBlurCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.radialBlurCompute, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &offscreenPass.blurredDescriptor),
 		};
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
@@ -515,11 +643,18 @@ public:
 		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
 		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.radialBlur));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.radialBlur));
 
 		// No blending (for debug display)
 		blendAttachmentState.blendEnable = VK_FALSE;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenDisplay));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenDisplay));
+
+		// Composite of the compute radial blur, with the same additive blending
+		shaderStages[1] = loadShader(getShadersPath() + "radialblur/composite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		blendAttachmentState.blendEnable = VK_TRUE;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composite));
+		blendAttachmentState.blendEnable = VK_FALSE;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.compositeDisplay));
 
 		// Phong pass
 		pipelineCI.layout = pipelineLayouts.scene;
@@ -528,13 +663,18 @@ public:
 		blendAttachmentState.blendEnable = VK_FALSE;
 		depthStencilStateCI.depthWriteEnable = VK_TRUE;
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal });;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
 
 		// Color only pass (offscreen blur base)
 		shaderStages[0] = loadShader(getShadersPath() + "radialblur/colorpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "radialblur/colorpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.colorPass));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.colorPass));
+
+		// Compute radial blur
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.radialBlurCompute, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "radialblur/radialblur.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.radialBlurCompute));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -565,6 +705,7 @@ public:
 	// Update uniform buffers for rendering the 3D scene
 	void updateUniformBuffersScene()
 	{
+		waitForFramesInFlight();
 		uboScene.projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 1.0f, 256.0f);
 		camera.setRotation(camera.rotation + glm::vec3(0.0f, frameTimer * 10.0f, 0.0f));
 		uboScene.projection = camera.matrices.perspective;
@@ -615,15 +756,39 @@ public:
 			updateUniformBuffersScene();
 	}
 
+	virtual void windowResized()
+	{
+		destroyOffscreenTargets();
+		createOffscreenTargets();
+		updateOffscreenDescriptorSets();
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->checkBox("Radial blur", &blur)) {
 				buildCommandBuffers();
 			}
+			if (overlay->checkBox("Compute shader blur", &computeBlur)) {
+				buildCommandBuffers();
+			}
 			if (overlay->checkBox("Display render target", &displayTexture)) {
 				buildCommandBuffers();
 			}
+			if (overlay->comboBox("Glow resolution", &glowDivisorIndex, glowDivisorNames)) {
+				// The base class waits for the frames in flight while the UI is used
+				destroyOffscreenTargets();
+				createOffscreenTargets();
+				updateOffscreenDescriptorSets();
+				buildCommandBuffers();
+			}
+			bool paramsChanged = overlay->sliderInt("Samples", &uboBlurParams.samples, 1, 128);
+			paramsChanged |= overlay->sliderFloat("Decay", &uboBlurParams.decay, 0.8f, 1.0f);
+			if (paramsChanged) {
+				memcpy(uniformBuffers.blurParams.mapped, &uboBlurParams, sizeof(uboBlurParams));
+			}
+			overlay->text("Glow pass: %ux%u", offscreenPass.width, offscreenPass.height);
 		}
 	}
 };
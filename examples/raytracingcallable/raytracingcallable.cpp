@@ -3,6 +3,9 @@
 *
 * Dynamically calls different shaders based on the geoemtry id in the closest hit shader
 *
+* Alternatively (F2 or --benchcompare wavefront) the hits are written to a buffer, sorted by material in compute passes and each material is shaded
+* by a compute dispatch of its own, which avoids the divergent execution of different callable shaders within a wave
+*
 * Relevant code parts are marked with [POI]
 *
 * Copyright (C) 2021 by Sascha Willems - www.saschawillems.de
@@ -17,14 +20,11 @@ class VulkanExample : public VulkanRaytracingSample
 public:
 	AccelerationStructure bottomLevelAS;
 	AccelerationStructure topLevelAS;
+	// Only primary rays are traced, the closest hit shader invokes callable shaders instead of tracing further rays
+	RayCounts rayCounts;
 
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
-	struct ShaderBindingTables {
-		ShaderBindingTable raygen;
-		ShaderBindingTable miss;
-		ShaderBindingTable hit;
-		ShaderBindingTable callable;
-	} shaderBindingTables;
+	PackedShaderBindingTable shaderBindingTable;
 
 	struct UniformData {
 		glm::mat4 viewInverse;
@@ -41,12 +41,54 @@ public:
 	vks::Buffer indexBuffer;
 	vks::Buffer transformBuffer;
 
+	// Number of ray traced objects (--objects), each object uses a material of its own, the materials cycle through the shading programs
 	uint32_t objectCount = 3;
+	static const uint32_t shadingProgramCount = 3;
+
+	// [POI] Wavefront shading path
+	// The hit pass writes the material id and barycentrics of each pixel's hit to a buffer and counts the hits per material (bin)
+	// A scan computes the start of each bin and its indirect dispatch arguments, a scatter pass writes the pixel indices sorted by bin
+	// Each bin is then shaded by an indirect compute dispatch with a pipeline specialized for the bin's shading program
+	bool wavefrontShading = false;
+	// Matches the Bin struct of the wavefront shaders (std430), the dispatch arguments come first so the bin can be used for vkCmdDispatchIndirect
+	struct WavefrontBin {
+		VkDispatchIndirectCommand dispatch;
+		uint32_t count;
+		uint32_t offset;
+		uint32_t cursor;
+		uint32_t pad[2];
+	};
+	struct WavefrontPushConstants {
+		// Bin of the rays that missed, i.e. the number of materials
+		uint32_t missBin;
+		// Bin shaded by the current dispatch
+		uint32_t bin;
+	};
+	struct Wavefront {
+		VkPipeline hitPipeline = VK_NULL_HANDLE;
+		VkPipeline scanPipeline = VK_NULL_HANDLE;
+		VkPipeline scatterPipeline = VK_NULL_HANDLE;
+		// One pipeline per shading program, the last one shades the rays that missed
+		std::array<VkPipeline, shadingProgramCount + 1> shadePipelines{};
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups;
+		PackedShaderBindingTable shaderBindingTable;
+		// Per pixel hit data (barycentrics, material id)
+		vks::Buffer hits;
+		// One bin per material plus one for the rays that missed
+		vks::Buffer bins;
+		// Pixel indices sorted by bin
+		vks::Buffer sortedPixels;
+	} wavefront;
 
 	// This sample is derived from an extended base class that saves most of the ray tracing setup boiler plate
 	VulkanExample() : VulkanRaytracingSample()
 	{
 		title = "Ray tracing callable shaders";
+		// handleResize replaces the storage image that frames in flight may still write to, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		settings.overlay = false;
 		timerSpeed *= 0.25f;
 		camera.type = Camera::CameraType::lookat;
@@ -54,6 +96,7 @@ public:
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -10.0f));
 		enableExtensions();
+		objectCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("objects", 3), 1));
 	}
 
 	~VulkanExample()
@@ -62,13 +105,20 @@ public:
 			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			vkDestroyPipeline(device, wavefront.hitPipeline, nullptr);
+			vkDestroyPipeline(device, wavefront.scanPipeline, nullptr);
+			vkDestroyPipeline(device, wavefront.scatterPipeline, nullptr);
+			for (auto& shadePipeline : wavefront.shadePipelines) {
+				vkDestroyPipeline(device, shadePipeline, nullptr);
+			}
+			vkDestroyPipelineLayout(device, wavefront.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, wavefront.descriptorSetLayout, nullptr);
+			wavefront.shaderBindingTable.destroy();
+			destroyWavefrontBuffers();
 			deleteStorageImage();
 			deleteAccelerationStructure(bottomLevelAS);
 			deleteAccelerationStructure(topLevelAS);
-			shaderBindingTables.raygen.destroy();
-			shaderBindingTables.miss.destroy();
-			shaderBindingTables.hit.destroy();
-			shaderBindingTables.callable.destroy();
+			shaderBindingTable.destroy();
 			vertexBuffer.destroy();
 			indexBuffer.destroy();
 			transformBuffer.destroy();
@@ -96,12 +146,18 @@ public:
 		uint32_t indexCount = static_cast<uint32_t>(indices.size());
 
 		// Setup transform matrices for the geometries in the bottom level AS
+		// The objects are laid out in a grid that's scaled to fit the view, three objects are placed in a single row
+		const uint32_t columns = std::max(3u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(objectCount)))));
+		const uint32_t rows = (objectCount + columns - 1) / columns;
+		const float scale = 3.0f / static_cast<float>(columns);
 		std::vector<VkTransformMatrixKHR> transformMatrices(objectCount);
 		for (uint32_t i = 0; i < objectCount; i++) {
+			const float x = ((float)(i % columns) * 3.0f - (float)(columns - 1) * 1.5f) * scale;
+			const float y = ((float)(i / columns) * 3.0f - (float)(rows - 1) * 1.5f) * scale;
 			transformMatrices[i] = {
-				1.0f, 0.0f, 0.0f, (float)i * 3.0f - 3.0f,
-				0.0f, 1.0f, 0.0f, 0.0f,
-				0.0f, 0.0f, 1.0f, 0.0f
+				scale, 0.0f, 0.0f, x,
+				0.0f, scale, 0.0f, y,
+				0.0f, 0.0f, scale, 0.0f
 			};
 		}
 		// Transform buffer
@@ -161,7 +217,7 @@ public:
 		// Get size info
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
 		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
 		accelerationStructureBuildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometries.size());
 		accelerationStructureBuildGeometryInfo.pGeometries = accelerationStructureGeometries.data();
 
@@ -180,7 +236,7 @@ public:
 
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
 		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
 		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
 		accelerationBuildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructureGeometries.size());
@@ -197,7 +253,8 @@ public:
 			accelerationStructureBuildRangeInfo.transformOffset = i * sizeof(VkTransformMatrixKHR);
 			accelerationStructureBuildRangeInfos.push_back(accelerationStructureBuildRangeInfo);
 		}
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfos[0], &accelerationStructureBuildRangeInfos[1], &accelerationStructureBuildRangeInfos[2] };
+		// The range infos of all geometries of a build are passed as a single array
+		const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfos = accelerationStructureBuildRangeInfos.data();
 
 		// Build the acceleration structure on the device via a one-time command buffer submission
 		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
@@ -206,10 +263,13 @@ public:
 			commandBuffer,
 			1,
 			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+			&accelerationBuildStructureRangeInfos);
+		flushAccelerationStructureBuild(commandBuffer);
 
 		deleteScratchBuffer(scratchBuffer);
+
+		// The bottom level acceleration structure is static, so it can be compacted to free the unused part of the build size
+		compactAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR);
 	}
 
 	/*
@@ -295,15 +355,16 @@ public:
 			1,
 			&accelerationBuildGeometryInfo,
 			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		flushAccelerationStructureBuild(commandBuffer);
 
 		deleteScratchBuffer(scratchBuffer);
 		instancesBuffer.destroy();
 	}
 
 	/*
-		Create the Shader Binding Tables that binds the programs and top-level acceleration structure
-			
+		Create the Shader Binding Table that binds the programs and top-level acceleration structure
+		All regions are packed into a single buffer (see VulkanRaytracingSample::createShaderBindingTable)
+
 		SBT Layout used in this sample:
 
 			/-----------\
@@ -315,30 +376,26 @@ public:
 			|-----------|
 			| callable0 |
 			| callable1 |
-			| callabel2 |
+			| callable2 |
+			| ...       |
 			\-----------/
 
 	*/
 	void createShaderBindingTables() {
-		const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
-		const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
-		const uint32_t groupCount = static_cast<uint32_t>(shaderGroups.size());
-		const uint32_t sbtSize = groupCount * handleSizeAligned;
-
-		std::vector<uint8_t> shaderHandleStorage(sbtSize);
-		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, sbtSize, shaderHandleStorage.data()));
-
-		createShaderBindingTable(shaderBindingTables.raygen, 1);
-		createShaderBindingTable(shaderBindingTables.miss, 1);
-		createShaderBindingTable(shaderBindingTables.hit, 1);
-		// [POI] The callable shader binding table contains one shader handle per ray traced object
-		createShaderBindingTable(shaderBindingTables.callable, objectCount);
-
-		// Copy handles
-		memcpy(shaderBindingTables.raygen.mapped, shaderHandleStorage.data(), handleSize);
-		memcpy(shaderBindingTables.miss.mapped, shaderHandleStorage.data() + handleSizeAligned, handleSize);
-		memcpy(shaderBindingTables.hit.mapped, shaderHandleStorage.data() + handleSizeAligned * 2, handleSize);
-		memcpy(shaderBindingTables.callable.mapped, shaderHandleStorage.data() + handleSizeAligned * 3, handleSize * 3);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Raygen, 0);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Miss, 1);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Hit, 2);
+		// [POI] The callable region contains one shader record per ray traced object, pointing to the callable group of the object's shading program
+		for (uint32_t i = 0; i < objectCount; i++) {
+			shaderBindingTable.addRecord(PackedShaderBindingTable::Callable, 3 + i % shadingProgramCount);
+		}
+		createShaderBindingTable(shaderBindingTable, pipeline, static_cast<uint32_t>(shaderGroups.size()));
+
+		// The hit pass of the wavefront path doesn't call any callables
+		wavefront.shaderBindingTable.addRecord(PackedShaderBindingTable::Raygen, 0);
+		wavefront.shaderBindingTable.addRecord(PackedShaderBindingTable::Miss, 1);
+		wavefront.shaderBindingTable.addRecord(PackedShaderBindingTable::Hit, 2);
+		createShaderBindingTable(wavefront.shaderBindingTable, wavefront.hitPipeline, static_cast<uint32_t>(wavefront.shaderGroups.size()));
 	}
 
 	/*
@@ -347,12 +404,13 @@ public:
 	void createDescriptorSets()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 2 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 }
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		// One set for the callable path and one for the wavefront path
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
 
 		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
@@ -388,6 +446,153 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indexBufferDescriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+
+		descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &wavefront.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &wavefront.descriptorSet));
+		updateWavefrontDescriptorSet();
+	}
+
+	/*
+		Write the descriptors of the wavefront path, the storage image and the per pixel buffers are replaced on resize
+	*/
+	void updateWavefrontDescriptorSet()
+	{
+		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
+		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+		descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.handle;
+
+		VkWriteDescriptorSet accelerationStructureWrite{};
+		accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+		accelerationStructureWrite.dstSet = wavefront.descriptorSet;
+		accelerationStructureWrite.dstBinding = 0;
+		accelerationStructureWrite.descriptorCount = 1;
+		accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: Top level acceleration structure
+			accelerationStructureWrite,
+			// Binding 1: Ray tracing result image
+			vks::initializers::writeDescriptorSet(wavefront.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor),
+			// Binding 2: Uniform data
+			vks::initializers::writeDescriptorSet(wavefront.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &ubo.descriptor),
+			// Binding 3: Per pixel hits
+			vks::initializers::writeDescriptorSet(wavefront.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &wavefront.hits.descriptor),
+			// Binding 4: Material bins
+			vks::initializers::writeDescriptorSet(wavefront.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &wavefront.bins.descriptor),
+			// Binding 5: Pixel indices sorted by bin
+			vks::initializers::writeDescriptorSet(wavefront.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &wavefront.sortedPixels.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+	}
+
+	/*
+		Create the buffers of the wavefront path, the hit and sorted pixel buffers hold one entry per pixel
+	*/
+	void createWavefrontBuffers()
+	{
+		const VkDeviceSize pixelCount = static_cast<VkDeviceSize>(width) * height;
+		// Barycentrics and material id, padded to 16 bytes (std430)
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&wavefront.hits,
+			pixelCount * 4 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&wavefront.sortedPixels,
+			pixelCount * sizeof(uint32_t)));
+		// The bins are cleared at the start of each frame and passed to vkCmdDispatchIndirect
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&wavefront.bins,
+			(objectCount + 1) * sizeof(WavefrontBin)));
+	}
+
+	void destroyWavefrontBuffers()
+	{
+		wavefront.hits.destroy();
+		wavefront.bins.destroy();
+		wavefront.sortedPixels.destroy();
+	}
+
+	/*
+		Create the pipelines of the wavefront path: A ray tracing pipeline for the hit pass and compute pipelines for sorting and shading
+	*/
+	void createWavefrontPipelines()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Acceleration structure
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0),
+			// Binding 1: Storage image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 2),
+			// Binding 3: Hits
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Bins
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Sorted pixels
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &wavefront.descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT, sizeof(WavefrontPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&wavefront.descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &wavefront.pipelineLayout));
+
+		// Hit pass, the closest hit and miss shaders only return the hit data instead of shading it
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = {
+			loadShader(getShadersPath() + "raytracingcallable/raygenhits.rgen.spv", VK_SHADER_STAGE_RAYGEN_BIT_KHR),
+			loadShader(getShadersPath() + "raytracingcallable/misshits.rmiss.spv", VK_SHADER_STAGE_MISS_BIT_KHR),
+			loadShader(getShadersPath() + "raytracingcallable/closesthithits.rchit.spv", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR),
+		};
+		VkRayTracingShaderGroupCreateInfoKHR shaderGroup = vks::initializers::rayTracingShaderGroupCreateInfoKHR();
+		shaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+		shaderGroup.closestHitShader = VK_SHADER_UNUSED_KHR;
+		shaderGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
+		shaderGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+		shaderGroup.generalShader = 0;
+		wavefront.shaderGroups.push_back(shaderGroup);
+		shaderGroup.generalShader = 1;
+		wavefront.shaderGroups.push_back(shaderGroup);
+		shaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+		shaderGroup.generalShader = VK_SHADER_UNUSED_KHR;
+		shaderGroup.closestHitShader = 2;
+		wavefront.shaderGroups.push_back(shaderGroup);
+
+		VkRayTracingPipelineCreateInfoKHR rayTracingPipelineCI = vks::initializers::rayTracingPipelineCreateInfoKHR();
+		rayTracingPipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		rayTracingPipelineCI.pStages = shaderStages.data();
+		rayTracingPipelineCI.groupCount = static_cast<uint32_t>(wavefront.shaderGroups.size());
+		rayTracingPipelineCI.pGroups = wavefront.shaderGroups.data();
+		rayTracingPipelineCI.maxPipelineRayRecursionDepth = 1;
+		rayTracingPipelineCI.layout = wavefront.pipelineLayout;
+		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCI, nullptr, &wavefront.hitPipeline));
+
+		// Sorting
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(wavefront.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "raytracingcallable/wavefrontscan.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &wavefront.scanPipeline));
+		computePipelineCI.stage = loadShader(getShadersPath() + "raytracingcallable/wavefrontscatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &wavefront.scatterPipeline));
+
+		// [POI] Shading, the shading program is a specialization constant, so each pipeline only contains the code of a single program
+		VkPipelineShaderStageCreateInfo shadeStage = loadShader(getShadersPath() + "raytracingcallable/wavefrontshade.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(wavefront.shadePipelines.size()); i++) {
+			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &i);
+			computePipelineCI.stage = shadeStage;
+			computePipelineCI.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &wavefront.shadePipelines[i]));
+		}
 	}
 
 	/*
@@ -409,10 +614,10 @@ public:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
 	
 		/*
 			Setup ray tracing shader groups
@@ -451,8 +656,9 @@ public:
 		shaderGroups.push_back(shaderGroup);
 
 		// [POI] Callable shader group
-		// This sample's hit shader will call different callable shaders depending on the geometry index using executeCallableEXT, so as we render three geometries, we'll also use three callable shaders
-		for (uint32_t i = 0; i < objectCount; i++) 
+		// This sample's hit shader will call different callable shaders depending on the geometry index using executeCallableEXT, one callable shader per shading program
+		// The callable shader records select the group for each geometry, so more objects don't add shader groups (see createShaderBindingTables)
+		for (uint32_t i = 0; i < shadingProgramCount; i++)
 		{
 			shaderStages.push_back(loadShader(getShadersPath() + "raytracingcallable/callable" + std::to_string(i+1) + ".rcall.spv", VK_SHADER_STAGE_CALLABLE_BIT_KHR));
 			shaderGroup = vks::initializers::rayTracingShaderGroupCreateInfoKHR();
@@ -501,6 +707,70 @@ public:
 		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
 		VkWriteDescriptorSet resultImageWrite = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor);
 		vkUpdateDescriptorSets(device, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+		// The per pixel buffers of the wavefront path depend on the size
+		destroyWavefrontBuffers();
+		createWavefrontBuffers();
+		updateWavefrontDescriptorSet();
+	}
+
+	/*
+		Record the wavefront path: Trace the hits, sort them by material and shade each material with a dispatch of its own
+	*/
+	void recordWavefrontShading(VkCommandBuffer commandBuffer)
+	{
+		WavefrontPushConstants pushConstants{ objectCount, 0 };
+		const uint32_t binCount = objectCount + 1;
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+
+		// Clear the hit counts of the previous frame
+		vkCmdFillBuffer(commandBuffer, wavefront.bins.buffer, 0, VK_WHOLE_SIZE, 0);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, wavefront.pipelineLayout, 0, 1, &wavefront.descriptorSet, 0, 0);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, wavefront.pipelineLayout, 0, 1, &wavefront.descriptorSet, 0, 0);
+		vkCmdPushConstants(commandBuffer, wavefront.pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(WavefrontPushConstants), &pushConstants);
+
+		// Hit pass, also counts the hits per bin
+		gpuProfiler.beginScope(commandBuffer, "Wavefront trace");
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, wavefront.hitPipeline);
+		vkCmdTraceRaysKHR(
+			commandBuffer,
+			wavefront.shaderBindingTable.getRegion(PackedShaderBindingTable::Raygen),
+			wavefront.shaderBindingTable.getRegion(PackedShaderBindingTable::Miss),
+			wavefront.shaderBindingTable.getRegion(PackedShaderBindingTable::Hit),
+			wavefront.shaderBindingTable.getRegion(PackedShaderBindingTable::Callable),
+			width,
+			height,
+			1);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+
+		// Counting sort of the pixels by bin
+		gpuProfiler.beginScope(commandBuffer, "Wavefront sort", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, wavefront.scanPipeline);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, wavefront.scatterPipeline);
+		vkCmdDispatch(commandBuffer, (width * height + 255) / 256, 1, 1);
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		// [POI] Shade each bin with the pipeline of its shading program, the group counts have been written by the scan pass
+		gpuProfiler.beginScope(commandBuffer, "Wavefront shade", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		for (uint32_t bin = 0; bin < binCount; bin++) {
+			const uint32_t shadingProgram = (bin == objectCount) ? shadingProgramCount : bin % shadingProgramCount;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, wavefront.shadePipelines[shadingProgram]);
+			pushConstants.bin = bin;
+			vkCmdPushConstants(commandBuffer, wavefront.pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(WavefrontPushConstants), &pushConstants);
+			vkCmdDispatchIndirect(commandBuffer, wavefront.bins.buffer, bin * sizeof(WavefrontBin));
+		}
+		gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	}
 
 	/*
@@ -520,22 +790,29 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
 			/*
 				Dispatch the ray tracing commands
 			*/
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-
-			vkCmdTraceRaysKHR(
-				drawCmdBuffers[i],
-				&shaderBindingTables.raygen.stridedDeviceAddressRegion,
-				&shaderBindingTables.miss.stridedDeviceAddressRegion,
-				&shaderBindingTables.hit.stridedDeviceAddressRegion,
-				&shaderBindingTables.callable.stridedDeviceAddressRegion,
-				width,
-				height,
-				1);
+			if (wavefrontShading) {
+				recordWavefrontShading(drawCmdBuffers[i]);
+			} else {
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Callable shading");
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+
+				vkCmdTraceRaysKHR(
+					drawCmdBuffers[i],
+					shaderBindingTable.getRegion(PackedShaderBindingTable::Raygen),
+					shaderBindingTable.getRegion(PackedShaderBindingTable::Miss),
+					shaderBindingTable.getRegion(PackedShaderBindingTable::Hit),
+					shaderBindingTable.getRegion(PackedShaderBindingTable::Callable),
+					width,
+					height,
+					1);
+				gpuProfiler.endScope(drawCmdBuffers[i], VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR);
+			}
 
 			/*
 				Copy ray tracing output to swap chain image
@@ -587,6 +864,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uniformData.projInverse = glm::inverse(camera.matrices.perspective);
 		uniformData.viewInverse = glm::inverse(camera.matrices.view);
 		memcpy(ubo.mapped, &uniformData, sizeof(uniformData));
@@ -620,6 +898,8 @@ public:
 		createStorageImage(swapChain.colorFormat, { width, height, 1 });
 		createUniformBuffer();
 		createRayTracingPipeline();
+		createWavefrontPipelines();
+		createWavefrontBuffers();
 		createShaderBindingTables();
 		createDescriptorSets();
 		buildCommandBuffers();
@@ -640,9 +920,33 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		addTracedRays(width, height, rayCounts);
 		if (!paused || camera.updated)
 			updateUniformBuffers();
 	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if (name == "wavefront") {
+			wavefrontShading = enabled;
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
+#if !defined(__ANDROID__)
+	virtual void keyPressed(uint32_t keyCode)
+	{
+		switch (keyCode) {
+		case KEY_F2:
+			wavefrontShading = !wavefrontShading;
+			vkDeviceWaitIdle(device);
+			buildCommandBuffers();
+			std::cout << (wavefrontShading ? "Wavefront (material sorted) shading" : "Callable shading") << " with " << objectCount << " materials" << std::endl;
+			break;
+		}
+	}
+#endif
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -3,6 +3,12 @@
 *
 * Renders a complex scene doing recursion inside the shaders for creating reflections
 *
+* While the camera and scene are static, jittered samples are progressively accumulated over frames (anti-aliasing the image)
+* While the camera moves, the accumulated result of the previous frame is reprojected using the primary hit positions
+* Optionally only every other pixel is traced per frame (checkerboard), with the remaining pixels reusing the reprojected result
+* Reflections are traced at half resolution by a separate dispatch and upsampled with depth and normal aware weights by the full resolution pass
+* Alpha masked materials are alpha tested by an any-hit shader, which only runs for the partially covered triangles (see VulkanRaytracingSample::createMeshAccelerationStructures)
+*
 * Copyright (C) 2019-2020 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -14,22 +20,75 @@
 class VulkanExample : public VulkanRaytracingSample
 {
 public:
-	AccelerationStructure bottomLevelAS{};
-	AccelerationStructure topLevelAS{};
+	// One bottom level acceleration structure per mesh of the scene
+	std::vector<MeshAccelerationStructure> bottomLevelASs;
+	DynamicTopLevelAccelerationStructure topLevelAS{};
+	// How the top level acceleration structure is updated each frame for moving instances (cycled with the T key)
+	enum TopLevelASUpdateMode { TopLevelASStatic = 0, TopLevelASRebuild = 1, TopLevelASRefit = 2 };
+	const std::vector<std::string> topLevelASUpdateModes = { "static", "rebuild", "refit" };
+	int32_t topLevelASUpdateMode = TopLevelASRefit;
+	float animationTimer = 0.0f;
+	// First index and material of each geometry, passed to the hit shaders inline with the geometry's hit record
+	std::vector<MeshGeometry> meshGeometries;
+	// Set if the scene contains alpha masked geometry, which needs the any-hit hit group and the scene's textures
+	bool alphaTestedGeometry = false;
+	std::vector<vkglTF::Model::IndirectDraws::MaterialData> materialData;
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	// Hit record data of alpha tested geometries
+	struct AlphaTestHitRecord {
+		uint32_t firstIndex;
+		uint32_t baseColorTexture;
+		float alphaCutoff;
+	};
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures{};
+	// The primary ray is reflected at each hit until the max. recursion depth (passed to the ray generation shader) is reached
+	RayCounts rayCounts;
 
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
-	struct ShaderBindingTables {
-		ShaderBindingTable raygen;
-		ShaderBindingTable miss;
-		ShaderBindingTable hit;
-	} shaderBindingTables;
+	PackedShaderBindingTable shaderBindingTable;
 
 	struct UniformData {
 		glm::mat4 viewInverse;
 		glm::mat4 projInverse;
 		glm::vec4 lightPos;
+		// Camera of the previous frame, used to reproject the accumulated samples
+		glm::mat4 previousViewProjection;
+		glm::vec4 previousOrigin;
 		int32_t vertexSize;
 	} uniformData;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+
+	// Accumulated samples of the current and previous frame, rgb stores the color and alpha the distance to the primary hit
+	struct AccumulationImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+	};
+	std::array<AccumulationImage, 2> accumulationImages;
+	// Half resolution reflections (rgb: reflected color, a: primary hit distance) and the normals of the surfaces they were traced from
+	AccumulationImage reflectionImage;
+	AccumulationImage reflectionNormalImage;
+	VkExtent3D reflectionExtent{};
+
+	struct PushConstants {
+		// Sub pixel offset of the primary rays
+		glm::vec2 jitter = glm::vec2(0.0f);
+		// Selects the accumulation image to write to and the pixels traced in checkerboard mode
+		uint32_t frame = 0;
+		// Number of frames accumulated since the camera or scene changed, 0 restarts the accumulation
+		uint32_t sampleCount = 0;
+		uint32_t checkerboard = 0;
+		uint32_t reprojection = 1;
+		// Trace reflections for one pixel of each 2x2 block, with fewer bounces for distant surfaces
+		uint32_t halfResReflections = 1;
+		// Reflections of surfaces at least this rough are taken from the environment instead of being traced
+		float roughnessCutoff = 0.5f;
+	} pushConstants;
+
+	// Accumulation (F2), reprojection (F3), checkerboard tracing (F4) and half resolution reflections (L) can be toggled at runtime
+	// The roughness cutoff is changed with the keypad +/- keys
+	bool accumulate = true;
+	bool resetAccumulation = true;
 	vks::Buffer ubo;
 
 	VkPipeline pipeline;
@@ -43,8 +102,14 @@ public:
 	VulkanExample() : VulkanRaytracingSample()
 	{
 		title = "Ray tracing reflections";
+		// The storage and accumulation images are recreated in place by handleResize, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		settings.overlay = false;
+		// The command buffer is recorded each frame (see recordCommandBuffer), as it may contain a build of the top level acceleration structure
+		dynamicCommandBuffers = true;
 		timerSpeed *= 0.5f;
+		rayCounts.reflection = 1;
+		rayCounts.recursionDepth = 4;
 		camera.rotationSpeed *= 0.25f;
 		camera.type = Camera::CameraType::firstperson;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
@@ -59,217 +124,98 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		deleteStorageImage();
-		deleteAccelerationStructure(bottomLevelAS);
-		deleteAccelerationStructure(topLevelAS);
-		shaderBindingTables.raygen.destroy();
-		shaderBindingTables.miss.destroy();
-		shaderBindingTables.hit.destroy();
+		deleteAccumulationImages();
+		deleteReflectionImages();
+		for (auto& bottomLevelAS : bottomLevelASs) {
+			deleteAccelerationStructure(bottomLevelAS.accelerationStructure);
+		}
+		deleteDynamicTopLevelAccelerationStructure(topLevelAS);
+		shaderBindingTable.destroy();
 		ubo.destroy();
 	}
 
 	/*
-		Create the bottom level acceleration structure contains the scene's actual geometry (vertices, triangles)
+		Create the bottom level acceleration structures containing the scene's actual geometry (vertices, triangles)
+		Each mesh of the scene gets its own structure with one geometry per primitive, see VulkanRaytracingSample::createMeshAccelerationStructures
 	*/
-	void createBottomLevelAccelerationStructure()
+	void createBottomLevelAccelerationStructures()
 	{
 		// Instead of a simple triangle, we'll be loading a more complex scene for this example
 		// The shaders are accessing the vertex and index buffers of the scene, so the proper usage flag has to be set on the vertex and index buffers for the scene
+		// Vertices are not pre-transformed, the node transforms are applied by the top level acceleration structure instances instead
 		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		// Alpha masked triangles are classified at load time, so only partially covered ones need to be alpha tested by the any-hit shader
+		uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::ClassifyAlphaMaskedTriangles;
+		// Host builds read the geometry from the model's host copy, as the vertex and index buffers are only accessible by the device
+		if (hostAccelerationStructureBuilds.supported) {
+			glTFLoadingFlags |= vkglTF::FileLoadingFlags::KeepHostData;
+		}
 		scene.loadFromFile(getAssetPath() + "models/reflection_scene.gltf", vulkanDevice, queue, glTFLoadingFlags);
 
-		VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
-		VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
-
-		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(scene.vertices.buffer);
-		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(scene.indices.buffer);
-
-		uint32_t numTriangles = static_cast<uint32_t>(scene.indices.count) / 3;
-		uint32_t maxVertex = scene.vertices.count;
-
-		// Build
-		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
-		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-		accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-		accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-		accelerationStructureGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
-		accelerationStructureGeometry.geometry.triangles.maxVertex = maxVertex;
-		accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(vkglTF::Vertex);
-		accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-		accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
-		accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = 0;
-		accelerationStructureGeometry.geometry.triangles.transformData.hostAddress = nullptr;
-
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = 1;
-		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
-		vkGetAccelerationStructureBuildSizesKHR(
-			device,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			&numTriangles,
-			&accelerationStructureBuildSizesInfo);
-
-		createAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo);
-
-		// Create a small scratch buffer used during build of the bottom level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = numTriangles;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
-
-		// Build the acceleration structure on the device via a one-time command buffer submission
-		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vkCmdBuildAccelerationStructuresKHR(
-			commandBuffer,
-			1,
-			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
-
-		deleteScratchBuffer(scratchBuffer);
+		createMeshAccelerationStructures(scene, bottomLevelASs, meshGeometries, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+		for (const MeshGeometry& meshGeometry : meshGeometries) {
+			alphaTestedGeometry |= meshGeometry.alphaTested;
+		}
+		// Material properties and texture indices for the alpha tested hit records
+		scene.getMaterialData(materialData, textureDescriptors);
 	}
 
 	/*
 		The top level acceleration structure contains the scene's object instances
+		There is one instance per mesh, placed with the mesh's node transform
+		It's built with ALLOW_UPDATE, so it can be refit when the node transforms change (see recordCommandBuffer)
 	*/
 	void createTopLevelAccelerationStructure()
 	{
-		VkTransformMatrixKHR transformMatrix = {
-			1.0f, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f };
-
-		VkAccelerationStructureInstanceKHR instance{};
-		instance.transform = transformMatrix;
-		instance.instanceCustomIndex = 0;
-		instance.mask = 0xFF;
-		instance.instanceShaderBindingTableRecordOffset = 0;
-		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-		instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
-
-		// Buffer for instance data
-		vks::Buffer instancesBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&instancesBuffer,
-			sizeof(VkAccelerationStructureInstanceKHR),
-			&instance));
-
-		VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
-		instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
-
-		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
-		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-		accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-		accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
-		accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
-
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = 1;
-		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-
-		uint32_t primitive_count = 1;
-
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
-		vkGetAccelerationStructureBuildSizesKHR(
-			device,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			&primitive_count,
-			&accelerationStructureBuildSizesInfo);
-
-		createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, accelerationStructureBuildSizesInfo);
-
-		// Create a small scratch buffer used during build of the top level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = topLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = 1;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
-
-		// Build the acceleration structure on the device via a one-time command buffer submission
-		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
-		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vkCmdBuildAccelerationStructuresKHR(
-			commandBuffer,
-			1,
-			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		// The scene is loaded with FlipY, which is applied to the node transforms too
+		// Each instance selects the hit records of its mesh's geometries
+		std::vector<VkAccelerationStructureInstanceKHR> instances = getMeshInstances(bottomLevelASs, true, true);
+		createDynamicTopLevelAccelerationStructure(topLevelAS, static_cast<uint32_t>(instances.size()), VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
 
-		deleteScratchBuffer(scratchBuffer);
-		instancesBuffer.destroy();
+		// Initial build of the acceleration structure on the device via a one-time command buffer submission
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		buildDynamicTopLevelAccelerationStructure(commandBuffer, topLevelAS, instances, false);
+		flushAccelerationStructureBuild(commandBuffer);
 	}
 
 	/*
-		Create the Shader Binding Tables that binds the programs and top-level acceleration structure
+		Create the Shader Binding Table that binds the programs and top-level acceleration structure
+		All regions are packed into a single buffer (see VulkanRaytracingSample::createShaderBindingTable)
 
 		SBT Layout used in this sample:
 
-			/-----------\
-			| raygen    |
-			|-----------|
-			| miss      |
-			|-----------|
-			| hit       |
-			\-----------/
-
+			/-----------------------------\
+			| raygen                      |
+			| raygen (reflections)        |
+			|-----------------------------|
+			| miss                        |
+			|-----------------------------|
+			| hit (geometry 0) | firstIdx |
+			| hit (geometry 1) | firstIdx |
+			| hit (alpha tested geometry) |
+			|   | firstIdx | tex | cutoff |
+			| ...                         |
+			\-----------------------------/
+
+		There is one hit record per geometry, carrying the geometry's first index inline
+		This saves the closest hit shader from looking it up in a separate buffer
+		Alpha tested geometries use the hit group with the any-hit shader, their records also carry the material's base color texture and alpha cutoff
+		The two raygen records are dispatched separately, selected with getRaygenRegion
 	*/
 	void createShaderBindingTables() {
-		const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
-		const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
-		const uint32_t groupCount = static_cast<uint32_t>(shaderGroups.size());
-		const uint32_t sbtSize = groupCount * handleSizeAligned;
-
-		std::vector<uint8_t> shaderHandleStorage(sbtSize);
-		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, sbtSize, shaderHandleStorage.data()));
-
-		createShaderBindingTable(shaderBindingTables.raygen, 1);
-		createShaderBindingTable(shaderBindingTables.miss, 1);
-		createShaderBindingTable(shaderBindingTables.hit, 1);
-
-		// Copy handles
-		memcpy(shaderBindingTables.raygen.mapped, shaderHandleStorage.data(), handleSize);
-		memcpy(shaderBindingTables.miss.mapped, shaderHandleStorage.data() + handleSizeAligned, handleSize);
-		memcpy(shaderBindingTables.hit.mapped, shaderHandleStorage.data() + handleSizeAligned * 2, handleSize);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Raygen, 0);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Raygen, 3);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Miss, 1);
+		for (const MeshGeometry& meshGeometry : meshGeometries) {
+			if (meshGeometry.alphaTested) {
+				const vkglTF::Model::IndirectDraws::MaterialData& material = materialData[meshGeometry.material - scene.materials.data()];
+				AlphaTestHitRecord hitRecord = { meshGeometry.firstIndex, material.baseColorTexture, material.alphaCutoff };
+				shaderBindingTable.addRecord(PackedShaderBindingTable::Hit, 4, hitRecord);
+			} else {
+				shaderBindingTable.addRecord(PackedShaderBindingTable::Hit, 2, meshGeometry.firstIndex);
+			}
+		}
+		createShaderBindingTable(shaderBindingTable, pipeline, static_cast<uint32_t>(shaderGroups.size()));
 	}
 
 	/*
@@ -279,10 +225,13 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5 },
 			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
 			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
 		};
+		if (alphaTestedGeometry) {
+			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(textureDescriptors.size()) });
+		}
 		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
 
@@ -291,7 +240,7 @@ public:
 
 		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
 		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
-		descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.handle;
+		descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.accelerationStructure.handle;
 
 		VkWriteDescriptorSet accelerationStructureWrite{};
 		accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -305,6 +254,12 @@ public:
 		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
 		VkDescriptorBufferInfo vertexBufferDescriptor{ scene.vertices.buffer, 0, VK_WHOLE_SIZE };
 		VkDescriptorBufferInfo indexBufferDescriptor{ scene.indices.buffer, 0, VK_WHOLE_SIZE };
+		std::array<VkDescriptorImageInfo, 2> accumulationImageDescriptors = {
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, accumulationImages[0].view, VK_IMAGE_LAYOUT_GENERAL },
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, accumulationImages[1].view, VK_IMAGE_LAYOUT_GENERAL }
+		};
+		VkDescriptorImageInfo reflectionImageDescriptor{ VK_NULL_HANDLE, reflectionImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo reflectionNormalImageDescriptor{ VK_NULL_HANDLE, reflectionNormalImage.view, VK_IMAGE_LAYOUT_GENERAL };
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0: Top level acceleration structure
@@ -317,7 +272,17 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexBufferDescriptor),
 			// Binding 4: Scene index buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indexBufferDescriptor),
+			// Binding 6: Accumulation images
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, accumulationImageDescriptors.data(), static_cast<uint32_t>(accumulationImageDescriptors.size())),
+			// Binding 7: Half resolution reflections
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 7, &reflectionImageDescriptor),
+			// Binding 8: Normals of the half resolution reflections
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8, &reflectionNormalImageDescriptor),
 		};
+		if (alphaTestedGeometry) {
+			// Binding 9: Scene textures for the alpha test
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9, textureDescriptors.data(), static_cast<uint32_t>(textureDescriptors.size())));
+		}
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
 	}
 
@@ -332,18 +297,33 @@ public:
 			// Binding 1: Storage image
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 1),
 			// Binding 2: Uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, 2),
 			// Binding 3: Vertex buffer 
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, 3),
 			// Binding 4: Index buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, 4),
+			// Binding 6: Accumulation images (current and previous frame)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 6, 2),
+			// Binding 7: Half resolution reflections
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 7),
+			// Binding 8: Normals of the half resolution reflections
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 8),
 		};
+		// The textures are only read by the any-hit shader, which is only part of the pipeline if the scene has alpha masked geometry
+		if (alphaTestedGeometry) {
+			// Binding 9: Scene textures (followed by an empty texture), indexed by the alpha tested hit records
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ANY_HIT_BIT_KHR, 9, static_cast<uint32_t>(textureDescriptors.size())));
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
 
+		// Jitter, frame index and accumulation settings are passed to the ray generation shader via push constants
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_RAYGEN_BIT_KHR, sizeof(PushConstants), 0);
 		VkPipelineLayoutCreateInfo pPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
+		pPipelineLayoutCI.pushConstantRangeCount = 1;
+		pPipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
 
 		/*
 			Setup ray tracing shader groups
@@ -351,8 +331,19 @@ public:
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
 		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		uint32_t maxRecursion = 4;
-		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(maxRecursion), &maxRecursion);
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(rayCounts.recursionDepth), &rayCounts.recursionDepth);
+
+		// The half resolution reflections are traced by the same ray generation shader, with a specialization constant selecting the reflection pass
+		struct ReflectionPassSpecializationData {
+			uint32_t maxRecursion;
+			VkBool32 reflectionPass = VK_TRUE;
+		} reflectionPassSpecializationData;
+		reflectionPassSpecializationData.maxRecursion = rayCounts.recursionDepth;
+		std::array<VkSpecializationMapEntry, 2> reflectionPassSpecializationMapEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(ReflectionPassSpecializationData, maxRecursion), sizeof(uint32_t)),
+			vks::initializers::specializationMapEntry(1, offsetof(ReflectionPassSpecializationData, reflectionPass), sizeof(VkBool32))
+		};
+		VkSpecializationInfo reflectionPassSpecializationInfo = vks::initializers::specializationInfo(static_cast<uint32_t>(reflectionPassSpecializationMapEntries.size()), reflectionPassSpecializationMapEntries.data(), sizeof(reflectionPassSpecializationData), &reflectionPassSpecializationData);
 
 		// Ray generation group
 		{
@@ -383,6 +374,7 @@ public:
 		}
 
 		// Closest hit group
+		const uint32_t closestHitStage = static_cast<uint32_t>(shaderStages.size());
 		{
 			shaderStages.push_back(loadShader(getShadersPath() + "raytracingreflections/closesthit.rchit.spv", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR));
 			VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
@@ -395,6 +387,34 @@ public:
 			shaderGroups.push_back(shaderGroup);
 		}
 
+		// Half resolution reflection ray generation group
+		{
+			shaderStages.push_back(loadShader(getShadersPath() + "raytracingreflections/raygen.rgen.spv", VK_SHADER_STAGE_RAYGEN_BIT_KHR));
+			shaderStages.back().pSpecializationInfo = &reflectionPassSpecializationInfo;
+			VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
+			shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+			shaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+			shaderGroup.generalShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+			shaderGroup.closestHitShader = VK_SHADER_UNUSED_KHR;
+			shaderGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
+			shaderGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+			shaderGroups.push_back(shaderGroup);
+		}
+
+		// Alpha tested hit group, the any-hit shader discards intersections with transparent texels of partially covered triangles
+		if (alphaTestedGeometry) {
+			shaderStages.push_back(loadShader(getShadersPath() + "raytracingreflections/anyhit.rahit.spv", VK_SHADER_STAGE_ANY_HIT_BIT_KHR));
+			VkRayTracingShaderGroupCreateInfoKHR shaderGroup{};
+			shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+			shaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+			shaderGroup.generalShader = VK_SHADER_UNUSED_KHR;
+			// Shares the closest hit shader with the opaque hit group
+			shaderGroup.closestHitShader = closestHitStage;
+			shaderGroup.anyHitShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+			shaderGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+			shaderGroups.push_back(shaderGroup);
+		}
+
 		VkRayTracingPipelineCreateInfoKHR rayTracingPipelineCI = vks::initializers::rayTracingPipelineCreateInfoKHR();
 		rayTracingPipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		rayTracingPipelineCI.pStages = shaderStages.data();
@@ -422,114 +442,255 @@ public:
 	}
 
 	/*
-		If the window has been resized, we need to recreate the storage image and it's descriptor
+		Create the full precision images the samples are accumulated in
+		They are cleared to a primary hit distance of zero, so the first frame finds no valid history to reproject
+	*/
+	void createImage(AccumulationImage& target, VkFormat format, VkExtent3D extent, VkCommandBuffer commandBuffer)
+	{
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = extent;
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &target.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, target.image, &memReqs);
+		VkMemoryAllocateInfo memoryAllocateInfo = vks::initializers::memoryAllocateInfo();
+		memoryAllocateInfo.allocationSize = memReqs.size;
+		memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &target.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, target.image, target.memory, 0));
+
+		VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.format = format;
+		imageViewCI.subresourceRange = subresourceRange;
+		imageViewCI.image = target.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &target.view));
+
+		vks::tools::setImageLayout(commandBuffer, target.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(commandBuffer, target.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+	}
+
+	void deleteImage(AccumulationImage& target)
+	{
+		vkDestroyImageView(device, target.view, nullptr);
+		vkDestroyImage(device, target.image, nullptr);
+		vkFreeMemory(device, target.memory, nullptr);
+		target = {};
+	}
+
+	void createAccumulationImages()
+	{
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (auto& accumulationImage : accumulationImages) {
+			createImage(accumulationImage, VK_FORMAT_R32G32B32A32_SFLOAT, { width, height, 1 }, commandBuffer);
+		}
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		resetAccumulation = true;
+	}
+
+	void deleteAccumulationImages()
+	{
+		for (auto& accumulationImage : accumulationImages) {
+			deleteImage(accumulationImage);
+		}
+	}
+
+	/*
+		Create the images the half resolution reflections are traced into, with one texel per 2x2 pixel block
+		Half precision is enough for the primary hit distance, as it's only compared against the full resolution pixels with a relative threshold
+	*/
+	void createReflectionImages()
+	{
+		reflectionExtent = { (width + 1) / 2, (height + 1) / 2, 1 };
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		createImage(reflectionImage, VK_FORMAT_R16G16B16A16_SFLOAT, reflectionExtent, commandBuffer);
+		createImage(reflectionNormalImage, VK_FORMAT_R16G16B16A16_SFLOAT, reflectionExtent, commandBuffer);
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	}
+
+	void deleteReflectionImages()
+	{
+		deleteImage(reflectionImage);
+		deleteImage(reflectionNormalImage);
+	}
+
+	/*
+		If the window has been resized, we need to recreate the storage and accumulation images and their descriptors
 	*/
 	void handleResize()
 	{
-		// Recreate image
+		// Recreate images
 		createStorageImage(swapChain.colorFormat, { width, height, 1 });
-		// Update descriptor
+		deleteAccumulationImages();
+		createAccumulationImages();
+		deleteReflectionImages();
+		createReflectionImages();
+		// Update descriptors
 		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
-		VkWriteDescriptorSet resultImageWrite = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor);
-		vkUpdateDescriptorSets(device, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+		std::array<VkDescriptorImageInfo, 2> accumulationImageDescriptors = {
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, accumulationImages[0].view, VK_IMAGE_LAYOUT_GENERAL },
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, accumulationImages[1].view, VK_IMAGE_LAYOUT_GENERAL }
+		};
+		VkDescriptorImageInfo reflectionImageDescriptor{ VK_NULL_HANDLE, reflectionImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo reflectionNormalImageDescriptor{ VK_NULL_HANDLE, reflectionNormalImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, accumulationImageDescriptors.data(), static_cast<uint32_t>(accumulationImageDescriptors.size())),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 7, &reflectionImageDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8, &reflectionNormalImageDescriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+	}
+
+	virtual void windowResized()
+	{
+		handleResize();
 	}
 
 	/*
 		Command buffer generation
+		Called by the base class right before the current frame's command buffer is submitted
 	*/
-	void buildCommandBuffers()
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
-		if (resized)
-		{
-			handleResize();
-		}
-
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			/*
-				Dispatch the ray tracing commands
-			*/
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		/*
+			Update the top level acceleration structure with the current node transforms
+			A rebuild creates a new structure from scratch, a refit only updates the bounds of the existing one
+		*/
+		if (topLevelASUpdateMode != TopLevelASStatic) {
+			const bool refit = (topLevelASUpdateMode == TopLevelASRefit);
+			gpuProfiler.beginScope(commandBuffer, refit ? "TLAS refit" : "TLAS rebuild");
+			buildDynamicTopLevelAccelerationStructure(commandBuffer, topLevelAS, getMeshInstances(bottomLevelASs, true, true), refit);
+			gpuProfiler.endScope(commandBuffer);
+		}
 
-			/*
-				Dispatch the ray tracing commands
-			*/
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		/*
+			Dispatch the ray tracing commands
+		*/
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0, sizeof(PushConstants), &pushConstants);
 
-			VkStridedDeviceAddressRegionKHR emptySbtEntry = {};
+		// The accumulation image written by the previous frame is read by this frame (and the one read by the previous frame is written)
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		/*
+			Trace the reflections of one pixel per 2x2 block first, the full resolution pass then only traces primary rays
+			and upsamples the reflections (tracing them itself only for pixels without a matching sample nearby)
+		*/
+		if (pushConstants.halfResReflections) {
+			gpuProfiler.beginScope(commandBuffer, "Trace reflections");
 			vkCmdTraceRaysKHR(
-				drawCmdBuffers[i],
-				&shaderBindingTables.raygen.stridedDeviceAddressRegion,
-				&shaderBindingTables.miss.stridedDeviceAddressRegion,
-				&shaderBindingTables.hit.stridedDeviceAddressRegion,
-				&emptySbtEntry,
-				width,
-				height,
+				commandBuffer,
+				shaderBindingTable.getRaygenRegion(1),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Miss),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Hit),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Callable),
+				reflectionExtent.width,
+				reflectionExtent.height,
 				1);
-
-			/*
-				Copy ray tracing output to swap chain image
-			*/
-
-			// Prepare current swap chain image as transfer destination
-			vks::tools::setImageLayout(
-				drawCmdBuffers[i],
-				swapChain.images[i],
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Prepare ray tracing output image as transfer source
-			vks::tools::setImageLayout(
-				drawCmdBuffers[i],
-				storageImage.image,
-				VK_IMAGE_LAYOUT_GENERAL,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				subresourceRange);
-
-			VkImageCopy copyRegion{};
-			copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-			copyRegion.srcOffset = { 0, 0, 0 };
-			copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-			copyRegion.dstOffset = { 0, 0, 0 };
-			copyRegion.extent = { width, height, 1 };
-			vkCmdCopyImage(drawCmdBuffers[i], storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChain.images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-			// Transition swap chain image back for presentation
-			vks::tools::setImageLayout(
-				drawCmdBuffers[i],
-				swapChain.images[i],
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-				subresourceRange);
-
-			// Transition ray tracing output image back to general layout
-			vks::tools::setImageLayout(
-				drawCmdBuffers[i],
-				storageImage.image,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_IMAGE_LAYOUT_GENERAL,
-				subresourceRange);
-
-			//@todo: Default render pass setup will overwrite contents
-			//vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			//drawUI(drawCmdBuffers[i]);
-			//vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			gpuProfiler.endScope(commandBuffer);
+			addTracedRays(reflectionExtent.width, reflectionExtent.height, rayCounts);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 		}
+
+		// With checkerboard tracing, each invocation traces one of two horizontally adjacent pixels
+		const uint32_t launchWidth = pushConstants.checkerboard ? (width + 1) / 2 : width;
+
+		gpuProfiler.beginScope(commandBuffer, "Trace rays");
+		vkCmdTraceRaysKHR(
+			commandBuffer,
+			shaderBindingTable.getRaygenRegion(0),
+			shaderBindingTable.getRegion(PackedShaderBindingTable::Miss),
+			shaderBindingTable.getRegion(PackedShaderBindingTable::Hit),
+			shaderBindingTable.getRegion(PackedShaderBindingTable::Callable),
+			launchWidth,
+			height,
+			1);
+		gpuProfiler.endScope(commandBuffer);
+		// With half resolution reflections, this pass only traces the primary rays (not counting reflections traced for pixels without a matching sample)
+		addTracedRays(launchWidth, height, pushConstants.halfResReflections ? RayCounts() : rayCounts);
+
+		/*
+			Copy ray tracing output to swap chain image
+		*/
+
+		// Prepare current swap chain image as transfer destination
+		vks::tools::setImageLayout(
+			commandBuffer,
+			swapChain.images[imageIndex],
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
+
+		// Prepare ray tracing output image as transfer source
+		vks::tools::setImageLayout(
+			commandBuffer,
+			storageImage.image,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			subresourceRange);
+
+		VkImageCopy copyRegion{};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.srcOffset = { 0, 0, 0 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstOffset = { 0, 0, 0 };
+		copyRegion.extent = { width, height, 1 };
+		vkCmdCopyImage(commandBuffer, storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChain.images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		// Transition swap chain image back for presentation
+		vks::tools::setImageLayout(
+			commandBuffer,
+			swapChain.images[imageIndex],
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			subresourceRange);
+
+		// Transition ray tracing output image back to general layout
+		vks::tools::setImageLayout(
+			commandBuffer,
+			storageImage.image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_GENERAL,
+			subresourceRange);
+
+		//@todo: Default render pass setup will overwrite contents
+		//vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		//drawUI(commandBuffer);
+		//vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
+		// Keep the camera of the last frame for reprojection
+		uniformData.previousViewProjection = viewProjection;
+		uniformData.previousOrigin = uniformData.viewInverse[3];
+		viewProjection = camera.matrices.perspective * camera.matrices.view;
 		uniformData.projInverse = glm::inverse(camera.matrices.perspective);
 		uniformData.viewInverse = glm::inverse(camera.matrices.view);
 		uniformData.lightPos = glm::vec4(cos(glm::radians(timer * 360.0f)) * 40.0f, -20.0f + sin(glm::radians(timer * 360.0f)) * 20.0f, 25.0f + sin(glm::radians(timer * 360.0f)) * 5.0f, 0.0f);
@@ -552,6 +713,15 @@ public:
 		enabledAccelerationStructureFeatures.accelerationStructure = VK_TRUE;
 		enabledAccelerationStructureFeatures.pNext = &enabledRayTracingPipelineFeatures;
 
+		// The any-hit shader selects the texture of the hit geometry's material from an array
+		enabledDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		enabledDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		enabledDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		enabledDescriptorIndexingFeatures.pNext = &enabledBufferDeviceAddresFeatures;
+		enabledRayTracingPipelineFeatures.pNext = &enabledDescriptorIndexingFeatures;
+		// The bottom level acceleration structures can optionally be built on the host (--hostasbuilds)
+		enableHostAccelerationStructureBuilds();
+
 		deviceCreatepNextChain = &enabledAccelerationStructureFeatures;
 	}
 
@@ -560,35 +730,102 @@ public:
 		VulkanRaytracingSample::prepare();
 
 		// Create the acceleration structures used to render the ray traced scene
-		createBottomLevelAccelerationStructure();
+		createBottomLevelAccelerationStructures();
 		createTopLevelAccelerationStructure();
 
 		createStorageImage(swapChain.colorFormat, { width, height, 1 });
+		createAccumulationImages();
+		createReflectionImages();
 		createUniformBuffer();
 		createRayTracingPipeline();
 		createShaderBindingTables();
 		createDescriptorSets();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
-	void draw()
-	{
-		VulkanExampleBase::prepareFrame();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VulkanExampleBase::submitFrame();
-	}
-
 	virtual void render()
 	{
 		if (!prepared)
 			return;
-		draw();
-		if (!paused || camera.updated)
+		// Animated nodes move their instances in the top level acceleration structure
+		if (!paused && !scene.animations.empty()) {
+			animationTimer += frameTimer;
+			if (animationTimer > scene.animations[0].end) {
+				animationTimer -= scene.animations[0].end;
+			}
+			scene.updateAnimation(0, animationTimer);
+		}
+		// Restart the accumulation if the uniform data (camera, light) changed since the last frame
+		if (resetAccumulation || !accumulate) {
+			pushConstants.sampleCount = 0;
+			resetAccumulation = false;
+		} else {
+			pushConstants.sampleCount++;
+		}
+		// Jitter the primary rays within the pixel using a Halton (2,3) sequence
+		if (accumulate) {
+			const uint32_t index = (pushConstants.frame % 16) + 1;
+			pushConstants.jitter = glm::vec2(halton(index, 2), halton(index, 3)) - glm::vec2(0.5f);
+		} else {
+			pushConstants.jitter = glm::vec2(0.0f);
+		}
+		renderFrame();
+		pushConstants.frame++;
+		if (!paused || camera.updated) {
 			updateUniformBuffers();
+			resetAccumulation = true;
+		}
+	}
+
+	float halton(uint32_t index, uint32_t base)
+	{
+		float f = 1.0f;
+		float result = 0.0f;
+		while (index > 0) {
+			f /= static_cast<float>(base);
+			result += f * static_cast<float>(index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+#if !defined(__ANDROID__)
+	virtual void keyPressed(uint32_t keyCode)
+	{
+		switch (keyCode) {
+		case KEY_T:
+			topLevelASUpdateMode = (topLevelASUpdateMode + 1) % static_cast<int32_t>(topLevelASUpdateModes.size());
+			std::cout << "Top level acceleration structure update mode: " << topLevelASUpdateModes[topLevelASUpdateMode] << std::endl;
+			break;
+		case KEY_F2:
+			accumulate = !accumulate;
+			resetAccumulation = true;
+			std::cout << "Accumulation " << (accumulate ? "enabled" : "disabled") << std::endl;
+			break;
+		case KEY_F3:
+			pushConstants.reprojection = !pushConstants.reprojection;
+			std::cout << "Reprojection " << (pushConstants.reprojection ? "enabled" : "disabled") << std::endl;
+			break;
+		case KEY_F4:
+			pushConstants.checkerboard = !pushConstants.checkerboard;
+			resetAccumulation = true;
+			std::cout << "Checkerboard tracing " << (pushConstants.checkerboard ? "enabled" : "disabled") << std::endl;
+			break;
+		case KEY_L:
+			pushConstants.halfResReflections = !pushConstants.halfResReflections;
+			resetAccumulation = true;
+			std::cout << "Half resolution reflections " << (pushConstants.halfResReflections ? "enabled" : "disabled") << std::endl;
+			break;
+		case KEY_KPADD:
+		case KEY_KPSUB:
+			// A cutoff of 0 takes all reflections from the environment, a cutoff of 1 traces them for all reflective surfaces
+			pushConstants.roughnessCutoff = glm::clamp(pushConstants.roughnessCutoff + ((keyCode == KEY_KPADD) ? 0.1f : -0.1f), 0.0f, 1.0f);
+			resetAccumulation = true;
+			std::cout << "Reflection roughness cutoff: " << pushConstants.roughnessCutoff << std::endl;
+			break;
+		}
 	}
+#endif
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -3,6 +3,9 @@
 *
 * Renders a complex scene using multiple hit and miss shaders for implementing shadows
 *
+* Optionally renders soft shadows of an area light (a disc of the light's angular radius) with a single noisy shadow ray per pixel,
+* denoised in compute by a temporal accumulation with reprojection followed by an edge-avoiding a-trous wavelet filter (a simplified SVGF)
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -16,22 +19,65 @@ class VulkanExample : public VulkanRaytracingSample
 public:
 	AccelerationStructure bottomLevelAS;
 	AccelerationStructure topLevelAS;
+	// Each primary hit traces a shadow ray towards the light
+	RayCounts rayCounts;
 
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
-	struct ShaderBindingTables {
-		ShaderBindingTable raygen;
-		ShaderBindingTable miss;
-		ShaderBindingTable hit;
-	} shaderBindingTables;
+	PackedShaderBindingTable shaderBindingTable;
 
 	struct UniformData {
 		glm::mat4 viewInverse;
 		glm::mat4 projInverse;
 		glm::vec4 lightPos;
 		int32_t vertexSize;
+		int32_t softShadows = 0;
+		// Angular radius of the light's disc in radians
+		float lightRadius = 0.05f;
+		// Selects the noise of the shadow rays and the history image written by the denoiser
+		uint32_t frame = 0;
+		// Camera of the previous frame, used to reproject the denoiser's history
+		glm::mat4 previousViewProjection;
+		glm::vec4 previousOrigin;
 	} uniformData;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
 	vks::Buffer ubo;
 
+	// Soft shadows (F2) and the radius of the light (keypad +/-) can be changed at runtime
+	bool softShadows = false;
+
+	struct DenoiserImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+	};
+	/*
+		Images of the shadow denoiser
+		shading: shaded color without shadows (rgb) and the visibility of the light from the single shadow ray (a), written by the ray generation shader
+		normalDepth: normal (rgb) and distance (a) of the primary hit, written by the ray generation shader
+		history: temporally accumulated visibility, its second moment, the history length and the primary hit distance, written by alternating frames
+		filter: visibility and variance, ping-ponged between the a-trous iterations
+	*/
+	struct DenoiserImages {
+		DenoiserImage shading;
+		DenoiserImage normalDepth;
+		std::array<DenoiserImage, 2> history;
+		std::array<DenoiserImage, 2> filter;
+	} denoiserImages;
+	// Each a-trous iteration doubles the step size, three iterations cover a 29x29 pixel footprint
+	const uint32_t filterIterations = 3;
+	struct Denoiser {
+		VkPipeline temporalPipeline;
+		VkPipeline filterPipeline;
+		VkPipelineLayout pipelineLayout;
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetLayout descriptorSetLayout;
+	} denoiser;
+	struct FilterPushConstants {
+		int32_t stepSize;
+		uint32_t iteration;
+		uint32_t lastIteration;
+	};
+
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
@@ -43,8 +89,11 @@ public:
 	VulkanExample() : VulkanRaytracingSample()
 	{
 		title = "Ray traced shadows";
+		// handleResize replaces the storage image that frames in flight may still write to, so resizing has to wait for the frames in flight
+		resizeWaitsForFrames = true;
 		settings.overlay = false;
 		timerSpeed *= 0.25f;
+		rayCounts.shadow = 1;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
@@ -57,12 +106,15 @@ public:
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyPipeline(device, denoiser.temporalPipeline, nullptr);
+		vkDestroyPipeline(device, denoiser.filterPipeline, nullptr);
+		vkDestroyPipelineLayout(device, denoiser.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, denoiser.descriptorSetLayout, nullptr);
+		deleteDenoiserImages();
 		deleteStorageImage();
 		deleteAccelerationStructure(bottomLevelAS);
 		deleteAccelerationStructure(topLevelAS);
-		shaderBindingTables.raygen.destroy();
-		shaderBindingTables.miss.destroy();
-		shaderBindingTables.hit.destroy();
+		shaderBindingTable.destroy();
 		ubo.destroy();
 	}
 
@@ -103,7 +155,7 @@ public:
 		// Get size info
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
 		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
 		accelerationStructureBuildGeometryInfo.geometryCount = 1;
 		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
 
@@ -122,7 +174,7 @@ public:
 
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
 		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
 		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
 		accelerationBuildGeometryInfo.geometryCount = 1;
@@ -144,9 +196,12 @@ public:
 			1,
 			&accelerationBuildGeometryInfo,
 			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		flushAccelerationStructureBuild(commandBuffer);
 
 		deleteScratchBuffer(scratchBuffer);
+
+		// The bottom level acceleration structure is static, so it can be compacted to free the unused part of the build size
+		compactAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR);
 	}
 
 	/*
@@ -233,7 +288,7 @@ public:
 			1,
 			&accelerationBuildGeometryInfo,
 			accelerationBuildStructureRangeInfos.data());
-		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		flushAccelerationStructureBuild(commandBuffer);
 
 		deleteScratchBuffer(scratchBuffer);
 		instancesBuffer.destroy();
@@ -241,7 +296,8 @@ public:
 
 
 	/*
-		Create the Shader Binding Tables that binds the programs and top-level acceleration structure
+		Create the Shader Binding Table that binds the programs and top-level acceleration structure
+		All regions are packed into a single buffer (see VulkanRaytracingSample::createShaderBindingTable)
 
 		SBT Layout used in this sample:
 
@@ -249,30 +305,19 @@ public:
 			| raygen    |
 			|-----------|
 			| miss      |
+			| miss      |
 			|-----------|
 			| hit       |
 			\-----------/
 
 	*/
 	void createShaderBindingTables() {
-		const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
-		const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
-		const uint32_t groupCount = static_cast<uint32_t>(shaderGroups.size());
-		const uint32_t sbtSize = groupCount * handleSizeAligned;
-
-		std::vector<uint8_t> shaderHandleStorage(sbtSize);
-		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, sbtSize, shaderHandleStorage.data()));
-
-		createShaderBindingTable(shaderBindingTables.raygen, 1);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Raygen, 0);
 		// We are using two miss shaders
-		createShaderBindingTable(shaderBindingTables.miss, 2);
-		createShaderBindingTable(shaderBindingTables.hit, 1);
-
-		// Copy handles
-		memcpy(shaderBindingTables.raygen.mapped, shaderHandleStorage.data(), handleSize);
-		// We are using two miss shaders, so we need to get two handles for the miss shader binding table
-		memcpy(shaderBindingTables.miss.mapped, shaderHandleStorage.data() + handleSizeAligned, handleSize * 2);
-		memcpy(shaderBindingTables.hit.mapped, shaderHandleStorage.data() + handleSizeAligned * 3, handleSize);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Miss, 1);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Miss, 2);
+		shaderBindingTable.addRecord(PackedShaderBindingTable::Hit, 3);
+		createShaderBindingTable(shaderBindingTable, pipeline, static_cast<uint32_t>(shaderGroups.size()));
 	}
 
 	/*
@@ -280,13 +325,14 @@ public:
 	*/
 	void createDescriptorSets()
 	{
+		// The second set is used by the denoiser's compute passes
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 + 7 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 + 1 },
 			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
 
 		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
@@ -308,6 +354,8 @@ public:
 		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
 		VkDescriptorBufferInfo vertexBufferDescriptor{ scene.vertices.buffer, 0, VK_WHOLE_SIZE };
 		VkDescriptorBufferInfo indexBufferDescriptor{ scene.indices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo shadingImageDescriptor{ VK_NULL_HANDLE, denoiserImages.shading.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo normalDepthImageDescriptor{ VK_NULL_HANDLE, denoiserImages.normalDepth.view, VK_IMAGE_LAYOUT_GENERAL };
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0: Top level acceleration structure
@@ -320,6 +368,47 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexBufferDescriptor),
 			// Binding 4: Scene index buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indexBufferDescriptor),
+			// Binding 5: Shaded color and visibility for the denoiser
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5, &shadingImageDescriptor),
+			// Binding 6: Normal and distance of the primary hit for the denoiser
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, &normalDepthImageDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+
+		VkDescriptorSetAllocateInfo denoiserDescriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &denoiser.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &denoiserDescriptorSetAllocateInfo, &denoiser.descriptorSet));
+		updateDenoiserDescriptorSet();
+	}
+
+	/*
+		The images of the denoiser are replaced on resize, so its descriptors are written by a separate function
+	*/
+	void updateDenoiserDescriptorSet()
+	{
+		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo shadingImageDescriptor{ VK_NULL_HANDLE, denoiserImages.shading.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo normalDepthImageDescriptor{ VK_NULL_HANDLE, denoiserImages.normalDepth.view, VK_IMAGE_LAYOUT_GENERAL };
+		std::array<VkDescriptorImageInfo, 2> historyImageDescriptors = {
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, denoiserImages.history[0].view, VK_IMAGE_LAYOUT_GENERAL },
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, denoiserImages.history[1].view, VK_IMAGE_LAYOUT_GENERAL }
+		};
+		std::array<VkDescriptorImageInfo, 2> filterImageDescriptors = {
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, denoiserImages.filter[0].view, VK_IMAGE_LAYOUT_GENERAL },
+			VkDescriptorImageInfo{ VK_NULL_HANDLE, denoiserImages.filter[1].view, VK_IMAGE_LAYOUT_GENERAL }
+		};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: Uniform data
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &ubo.descriptor),
+			// Binding 1: Shaded color and noisy visibility
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &shadingImageDescriptor),
+			// Binding 2: Normal and distance of the primary hit
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &normalDepthImageDescriptor),
+			// Binding 3: History images (current and previous frame)
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, historyImageDescriptors.data(), static_cast<uint32_t>(historyImageDescriptors.size())),
+			// Binding 4: Filter images
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4, filterImageDescriptors.data(), static_cast<uint32_t>(filterImageDescriptors.size())),
+			// Binding 5: Ray tracing result image
+			vks::initializers::writeDescriptorSet(denoiser.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5, &storageImageDescriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
 	}
@@ -340,13 +429,17 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 3),
 			// Binding 4: Index buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 4),
+			// Binding 5: Shaded color and visibility for the denoiser
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 5),
+			// Binding 6: Normal and distance of the primary hit for the denoiser
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 6),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
 	
 		/*
 			Setup ray tracing shader groups
@@ -406,6 +499,42 @@ public:
 		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCI, nullptr, &pipeline));
 	}
 
+	/*
+		Create the compute pipelines of the shadow denoiser, which share a single descriptor set
+	*/
+	void createDenoiserPipelines()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Shaded color and noisy visibility
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Normal and distance of the primary hit
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: History images (current and previous frame)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3, 2),
+			// Binding 4: Filter images
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4, 2),
+			// Binding 5: Ray tracing result image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &denoiser.descriptorSetLayout));
+
+		// The step size and iteration of the a-trous filter are passed via push constants
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FilterPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&denoiser.descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &denoiser.pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(denoiser.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "raytracingshadows/denoisetemporal.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &denoiser.temporalPipeline));
+		computePipelineCI.stage = loadShader(getShadersPath() + "raytracingshadows/denoisefilter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &denoiser.filterPipeline));
+	}
+
 	/*
 		Create the uniform buffer used to pass matrices to the ray tracing ray generation shader
 	*/
@@ -423,16 +552,111 @@ public:
 	}
 
 	/*
-		If the window has been resized, we need to recreate the storage image and it's descriptor
+		Create the full resolution images of the shadow denoiser
+		They are cleared to a primary hit distance of zero, so the first frame finds no valid history to reproject
+	*/
+	void createDenoiserImages()
+	{
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		std::vector<DenoiserImage*> images = { &denoiserImages.shading, &denoiserImages.normalDepth, &denoiserImages.history[0], &denoiserImages.history[1], &denoiserImages.filter[0], &denoiserImages.filter[1] };
+		for (DenoiserImage* denoiserImage : images) {
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			imageCI.extent = { width, height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &denoiserImage->image));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, denoiserImage->image, &memReqs);
+			VkMemoryAllocateInfo memoryAllocateInfo = vks::initializers::memoryAllocateInfo();
+			memoryAllocateInfo.allocationSize = memReqs.size;
+			memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &denoiserImage->memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, denoiserImage->image, denoiserImage->memory, 0));
+
+			VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCI.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			imageViewCI.subresourceRange = subresourceRange;
+			imageViewCI.image = denoiserImage->image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &denoiserImage->view));
+
+			vks::tools::setImageLayout(commandBuffer, denoiserImage->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+			VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			vkCmdClearColorImage(commandBuffer, denoiserImage->image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		}
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	}
+
+	void deleteDenoiserImages()
+	{
+		std::vector<DenoiserImage*> images = { &denoiserImages.shading, &denoiserImages.normalDepth, &denoiserImages.history[0], &denoiserImages.history[1], &denoiserImages.filter[0], &denoiserImages.filter[1] };
+		for (DenoiserImage* denoiserImage : images) {
+			vkDestroyImageView(device, denoiserImage->view, nullptr);
+			vkDestroyImage(device, denoiserImage->image, nullptr);
+			vkFreeMemory(device, denoiserImage->memory, nullptr);
+			*denoiserImage = {};
+		}
+	}
+
+	/*
+		If the window has been resized, we need to recreate the storage and denoiser images and their descriptors
 	*/
 	void handleResize()
 	{
-		// Recreate image
+		// Recreate images
 		createStorageImage(swapChain.colorFormat, { width, height, 1 });
-		// Update descriptor
+		deleteDenoiserImages();
+		createDenoiserImages();
+		// Update descriptors
 		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
-		VkWriteDescriptorSet resultImageWrite = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor);
-		vkUpdateDescriptorSets(device, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+		VkDescriptorImageInfo shadingImageDescriptor{ VK_NULL_HANDLE, denoiserImages.shading.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo normalDepthImageDescriptor{ VK_NULL_HANDLE, denoiserImages.normalDepth.view, VK_IMAGE_LAYOUT_GENERAL };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5, &shadingImageDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, &normalDepthImageDescriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+		updateDenoiserDescriptorSet();
+	}
+
+	/*
+		Denoise the soft shadows: the temporal pass accumulates the visibility of the current frame into the reprojected history,
+		the a-trous iterations then filter it spatially, with the last one writing the shaded result into the storage image
+	*/
+	void recordDenoiser(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t groupCountX = (width + 15) / 16;
+		const uint32_t groupCountY = (height + 15) / 16;
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoiser.pipelineLayout, 0, 1, &denoiser.descriptorSet, 0, 0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoiser.temporalPipeline);
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoiser.filterPipeline);
+		for (uint32_t i = 0; i < filterIterations; i++) {
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			FilterPushConstants pushConstants{ 1 << i, i, (i == filterIterations - 1) ? 1u : 0u };
+			vkCmdPushConstants(commandBuffer, denoiser.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FilterPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+		}
+
+		// The result is copied to the swap chain image
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
 	/*
@@ -453,23 +677,34 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (softShadows) {
+				// The denoiser's history written by the previous frame is read by this frame (and the one read by the previous frame is written)
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+
 			/*
 				Dispatch the ray tracing commands
 			*/
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
 
-			VkStridedDeviceAddressRegionKHR emptySbtEntry = {};
 			vkCmdTraceRaysKHR(
 				drawCmdBuffers[i],
-				&shaderBindingTables.raygen.stridedDeviceAddressRegion,
-				&shaderBindingTables.miss.stridedDeviceAddressRegion,
-				&shaderBindingTables.hit.stridedDeviceAddressRegion,
-				&emptySbtEntry,
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Raygen),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Miss),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Hit),
+				shaderBindingTable.getRegion(PackedShaderBindingTable::Callable),
 				width,
 				height,
 				1);
 
+			if (softShadows) {
+				recordDenoiser(drawCmdBuffers[i]);
+			}
+
 			/*
 				Copy ray tracing output to swap chain image
 			*/
@@ -520,6 +755,11 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
+		// Keep the camera of the last frame for reprojection
+		uniformData.previousViewProjection = viewProjection;
+		uniformData.previousOrigin = uniformData.viewInverse[3];
+		viewProjection = camera.matrices.perspective * camera.matrices.view;
 		uniformData.projInverse = glm::inverse(camera.matrices.perspective);
 		uniformData.viewInverse = glm::inverse(camera.matrices.view);
 		uniformData.lightPos = glm::vec4(cos(glm::radians(timer * 360.0f)) * 40.0f, -50.0f + sin(glm::radians(timer * 360.0f)) * 20.0f, 25.0f + sin(glm::radians(timer * 360.0f)) * 5.0f, 0.0f);
@@ -554,8 +794,10 @@ public:
 		createTopLevelAccelerationStructure();
 
 		createStorageImage(swapChain.colorFormat, { width, height, 1 });
+		createDenoiserImages();
 		createUniformBuffer();
 		createRayTracingPipeline();
+		createDenoiserPipelines();
 		createShaderBindingTables();
 		createDescriptorSets();
 		buildCommandBuffers();
@@ -576,9 +818,37 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused || camera.updated)
+		addTracedRays(width, height, rayCounts);
+		// Soft shadows need new noise every frame, even if nothing moves
+		if (softShadows) {
+			uniformData.frame++;
+		}
+		if (!paused || camera.updated || softShadows)
+			updateUniformBuffers();
+	}
+
+#if !defined(__ANDROID__)
+	virtual void keyPressed(uint32_t keyCode)
+	{
+		switch (keyCode) {
+		case KEY_F2:
+			softShadows = !softShadows;
+			uniformData.softShadows = softShadows ? 1 : 0;
 			updateUniformBuffers();
+			// The denoiser passes are part of the pre-recorded command buffers
+			vkDeviceWaitIdle(device);
+			buildCommandBuffers();
+			std::cout << "Soft shadows " << (softShadows ? "enabled" : "disabled") << std::endl;
+			break;
+		case KEY_KPADD:
+		case KEY_KPSUB:
+			uniformData.lightRadius = glm::clamp(uniformData.lightRadius * ((keyCode == KEY_KPADD) ? 1.25f : 0.8f), 0.005f, 0.5f);
+			updateUniformBuffers();
+			std::cout << "Light radius: " << glm::degrees(uniformData.lightRadius) << " degrees" << std::endl;
+			break;
+		}
 	}
+#endif
 };
 
 VULKAN_EXAMPLE_MAIN()
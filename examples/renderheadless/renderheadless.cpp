@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Minimal headless rendering example
 *
+* Renders a sequence of frames with several frames in flight, reads them back on the transfer queue and writes them to disk on worker threads
+*
 * Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -23,7 +25,14 @@
 #include <vector>
 #include <array>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -32,6 +41,8 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
+#include "VulkanFrameCapture.h"
+#include "threadpool.hpp"
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 android_app* androidapp;
@@ -61,9 +72,23 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
 	return VK_FALSE;
 }
 
+// Options of an image sequence render job, the defaults render a single image like a plain headless renderer
+struct Settings {
+	uint32_t frameCount = 1;
+	uint32_t framesInFlight = 3;
+	uint32_t workerCount = 2;
+	vks::FrameCapture::Encoding encoding = vks::FrameCapture::Encoding::PPM;
+	// Text file with one "x y z" triangle position per line, the built-in scene is used if empty
+	std::string sceneFile;
+	// The sequence is distributed over gpuCount independent devices (alternate frames), this instance renders the frames of physical device gpuIndex
+	uint32_t gpuCount = 1;
+	uint32_t gpuIndex = 0;
+};
+
 class VulkanExample
 {
 public:
+	Settings settings;
 	VkInstance instance;
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
@@ -71,7 +96,10 @@ public:
 	VkPipelineCache pipelineCache;
 	VkQueue queue;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
+	// Readbacks are copied on a dedicated transfer queue if the device has one, otherwise on the graphics queue
+	uint32_t transferQueueFamilyIndex;
+	VkQueue transferQueue;
+	VkCommandPool transferCommandPool;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
@@ -85,10 +113,37 @@ public:
 		VkImageView view;
 	};
 	int32_t width, height;
-	VkFramebuffer framebuffer;
-	FrameBufferAttachment colorAttachment, depthAttachment;
+	VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	VkFormat depthFormat;
 	VkRenderPass renderPass;
 
+	// Each frame in flight renders into its own targets and reads them back into its own buffer
+	struct Frame {
+		FrameBufferAttachment colorAttachment, depthAttachment;
+		VkFramebuffer framebuffer;
+		VkCommandBuffer renderCommandBuffer;
+		VkCommandBuffer copyCommandBuffer;
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackMemory;
+		void* readbackData;
+		// Signaled by the render submission, waited on by the readback copy
+		VkSemaphore renderComplete;
+		VkFence copyComplete;
+		// Index of the frame in the sequence that's being rendered with these targets, -1 if none
+		int32_t sequenceIndex = -1;
+	};
+	std::vector<Frame> frames;
+	std::vector<glm::vec3> scenePositions;
+
+	// Timestamps at the start and end of each frame in flight's render commands, for the GPU utilization
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+	float timestampPeriod = 0.0f;
+	double gpuBusyMs = 0.0;
+
+	// Images are encoded and written on worker threads, the number of images waiting for them is limited so a slow disk doesn't pile up frames in memory
+	vks::ThreadPool encoders;
+	std::atomic<uint32_t> pendingEncodes{ 0 };
+
 	VkDebugReportCallbackEXT debugReportCallback{};
 
 	uint32_t getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties) {
@@ -148,7 +203,7 @@ public:
 		vkDestroyFence(device, fence, nullptr);
 	}
 
-	VulkanExample()
+	VulkanExample(const Settings& settings) : settings(settings)
 	{
 		LOG("Running headless rendering example\n");
 
@@ -234,15 +289,16 @@ public:
 		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
 		std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
 		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
-		physicalDevice = physicalDevices[0];
+		assert(settings.gpuIndex < deviceCount);
+		physicalDevice = physicalDevices[settings.gpuIndex];
 
 		VkPhysicalDeviceProperties deviceProperties;
 		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 		LOG("GPU: %s\n", deviceProperties.deviceName);
 
-		// Request a single graphics queue
+		// Request a graphics queue and a queue from a dedicated transfer family (if there is one) for the readbacks
 		const float defaultQueuePriority(0.0f);
-		VkDeviceQueueCreateInfo queueCreateInfo = {};
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		uint32_t queueFamilyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
 		std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
@@ -250,22 +306,47 @@ public:
 		for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++) {
 			if (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 				queueFamilyIndex = i;
-				queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-				queueCreateInfo.queueFamilyIndex = i;
-				queueCreateInfo.queueCount = 1;
-				queueCreateInfo.pQueuePriorities = &defaultQueuePriority;
 				break;
 			}
 		}
+		transferQueueFamilyIndex = queueFamilyIndex;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++) {
+			if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				transferQueueFamilyIndex = i;
+				break;
+			}
+		}
+		VkDeviceQueueCreateInfo queueCreateInfo = {};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &defaultQueuePriority;
+		queueCreateInfos.push_back(queueCreateInfo);
+		if (transferQueueFamilyIndex != queueFamilyIndex) {
+			queueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+			queueCreateInfos.push_back(queueCreateInfo);
+		}
 		// Create logical device
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.queueCreateInfoCount = 1;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 		VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
 
-		// Get a graphics queue
+		// Get a graphics queue and the queue the readbacks are copied on
 		vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+		vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
+		LOG("Readback copies on the %s queue\n", (transferQueueFamilyIndex != queueFamilyIndex) ? "transfer" : "graphics");
+
+		// Timestamps are only taken if the graphics queue supports them
+		if (queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = settings.framesInFlight * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool));
+			timestampPeriod = deviceProperties.limits.timestampPeriod;
+		}
 
 		// Command pool
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -273,6 +354,8 @@ public:
 		cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+		cmdPoolInfo.queueFamilyIndex = transferQueueFamilyIndex;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &transferCommandPool));
 
 		/*
 			Prepare vertex and index buffers
@@ -359,73 +442,35 @@ public:
 		}
 
 		/*
-			Create framebuffer attachments
+			Load the scene, a list of triangle positions
 		*/
+		scenePositions = {
+			glm::vec3(-1.5f, 0.0f, -4.0f),
+			glm::vec3( 0.0f, 0.0f, -2.5f),
+			glm::vec3( 1.5f, 0.0f, -4.0f),
+		};
+		if (!settings.sceneFile.empty()) {
+			std::ifstream sceneFile(settings.sceneFile);
+			if (sceneFile.is_open()) {
+				scenePositions.clear();
+				std::string line;
+				while (std::getline(sceneFile, line)) {
+					std::istringstream stream(line);
+					glm::vec3 position;
+					if ((line.empty()) || (line[0] == '#') || !(stream >> position.x >> position.y >> position.z)) {
+						continue;
+					}
+					scenePositions.push_back(position);
+				}
+				LOG("Loaded %d triangles from %s\n", static_cast<int32_t>(scenePositions.size()), settings.sceneFile.c_str());
+			} else {
+				LOG("Could not open scene file %s, using the built-in scene\n", settings.sceneFile.c_str());
+			}
+		}
+
 		width = 1024;
 		height = 1024;
-		VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		VkFormat depthFormat;
 		vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
-		{
-			// Color attachment
-			VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-			image.imageType = VK_IMAGE_TYPE_2D;
-			image.format = colorFormat;
-			image.extent.width = width;
-			image.extent.height = height;
-			image.extent.depth = 1;
-			image.mipLevels = 1;
-			image.arrayLayers = 1;
-			image.samples = VK_SAMPLE_COUNT_1_BIT;
-			image.tiling = VK_IMAGE_TILING_OPTIMAL;
-			image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &colorAttachment.image));
-			vkGetImageMemoryRequirements(device, colorAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &colorAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, colorAttachment.image, colorAttachment.memory, 0));
-
-			VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			colorImageView.format = colorFormat;
-			colorImageView.subresourceRange = {};
-			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			colorImageView.subresourceRange.baseMipLevel = 0;
-			colorImageView.subresourceRange.levelCount = 1;
-			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
-			colorImageView.image = colorAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &colorAttachment.view));
-
-			// Depth stencil attachment
-			image.format = depthFormat;
-			image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &depthAttachment.image));
-			vkGetImageMemoryRequirements(device, depthAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, depthAttachment.image, depthAttachment.memory, 0));
-
-			VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-			depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			depthStencilView.format = depthFormat;
-			depthStencilView.flags = 0;
-			depthStencilView.subresourceRange = {};
-			depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-			depthStencilView.subresourceRange.baseMipLevel = 0;
-			depthStencilView.subresourceRange.levelCount = 1;
-			depthStencilView.subresourceRange.baseArrayLayer = 0;
-			depthStencilView.subresourceRange.layerCount = 1;
-			depthStencilView.image = depthAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &depthAttachment.view));
-		}
 
 		/*
 			Create renderpass
@@ -489,19 +534,14 @@ public:
 			renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 			renderPassInfo.pDependencies = dependencies.data();
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+		}
 
-			VkImageView attachments[2];
-			attachments[0] = colorAttachment.view;
-			attachments[1] = depthAttachment.view;
-
-			VkFramebufferCreateInfo framebufferCreateInfo = vks::initializers::framebufferCreateInfo();
-			framebufferCreateInfo.renderPass = renderPass;
-			framebufferCreateInfo.attachmentCount = 2;
-			framebufferCreateInfo.pAttachments = attachments;
-			framebufferCreateInfo.width = width;
-			framebufferCreateInfo.height = height;
-			framebufferCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer));
+		/*
+			Create the targets, command buffers and readback buffers of the frames in flight
+		*/
+		frames.resize(settings.framesInFlight);
+		for (auto& frame : frames) {
+			createFrame(frame);
 		}
 
 		/*
@@ -613,218 +653,331 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 		}
 
-		/*
-			Command buffer creation
-		*/
-		{
-			VkCommandBuffer commandBuffer;
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
-
-			VkCommandBufferBeginInfo cmdBufInfo =
-				vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			VkClearValue clearValues[2];
-			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = framebuffer;
-
-			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {};
-			viewport.height = (float)height;
-			viewport.width = (float)width;
-			viewport.minDepth = (float)0.0f;
-			viewport.maxDepth = (float)1.0f;
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-			// Update dynamic scissor state
-			VkRect2D scissor = {};
-			scissor.extent.width = width;
-			scissor.extent.height = height;
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-			// Render scene
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-			std::vector<glm::vec3> pos = {
-				glm::vec3(-1.5f, 0.0f, -4.0f),
-				glm::vec3( 0.0f, 0.0f, -2.5f),
-				glm::vec3( 1.5f, 0.0f, -4.0f),
-			};
+		renderSequence();
 
-			for (auto v : pos) {
-				glm::mat4 mvpMatrix = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f) * glm::translate(glm::mat4(1.0f), v);
-				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
-				vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
-			}
+		vkQueueWaitIdle(queue);
+		vkQueueWaitIdle(transferQueue);
+	}
 
-			vkCmdEndRenderPass(commandBuffer);
+	/*
+		Create the framebuffer attachments, command buffers, readback buffer and synchronization primitives of a frame in flight
+	*/
+	void createFrame(Frame& frame)
+	{
+		// Color attachment
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = colorFormat;
+		image.extent.width = width;
+		image.extent.height = height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		// The color attachment is copied on the transfer queue, sharing it between both families avoids ownership transfers
+		const uint32_t queueFamilyIndices[2] = { queueFamilyIndex, transferQueueFamilyIndex };
+		if (transferQueueFamilyIndex != queueFamilyIndex) {
+			image.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			image.queueFamilyIndexCount = 2;
+			image.pQueueFamilyIndices = queueFamilyIndices;
+		}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frame.colorAttachment.image));
+		vkGetImageMemoryRequirements(device, frame.colorAttachment.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frame.colorAttachment.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, frame.colorAttachment.image, frame.colorAttachment.memory, 0));
+
+		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
+		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorImageView.format = colorFormat;
+		colorImageView.subresourceRange = {};
+		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorImageView.subresourceRange.baseMipLevel = 0;
+		colorImageView.subresourceRange.levelCount = 1;
+		colorImageView.subresourceRange.baseArrayLayer = 0;
+		colorImageView.subresourceRange.layerCount = 1;
+		colorImageView.image = frame.colorAttachment.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &frame.colorAttachment.view));
+
+		// Depth stencil attachment
+		image.format = depthFormat;
+		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		image.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image.queueFamilyIndexCount = 0;
+		image.pQueueFamilyIndices = nullptr;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frame.depthAttachment.image));
+		vkGetImageMemoryRequirements(device, frame.depthAttachment.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frame.depthAttachment.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, frame.depthAttachment.image, frame.depthAttachment.memory, 0));
+
+		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
+		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		depthStencilView.format = depthFormat;
+		depthStencilView.flags = 0;
+		depthStencilView.subresourceRange = {};
+		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		depthStencilView.subresourceRange.baseMipLevel = 0;
+		depthStencilView.subresourceRange.levelCount = 1;
+		depthStencilView.subresourceRange.baseArrayLayer = 0;
+		depthStencilView.subresourceRange.layerCount = 1;
+		depthStencilView.image = frame.depthAttachment.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &frame.depthAttachment.view));
+
+		VkImageView attachments[2];
+		attachments[0] = frame.colorAttachment.view;
+		attachments[1] = frame.depthAttachment.view;
+
+		VkFramebufferCreateInfo framebufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		framebufferCreateInfo.renderPass = renderPass;
+		framebufferCreateInfo.attachmentCount = 2;
+		framebufferCreateInfo.pAttachments = attachments;
+		framebufferCreateInfo.width = width;
+		framebufferCreateInfo.height = height;
+		framebufferCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &frame.framebuffer));
+
+		// Tightly packed host visible buffer the color attachment is copied to, it stays mapped
+		createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.readbackBuffer,
+			&frame.readbackMemory,
+			static_cast<VkDeviceSize>(width) * height * 4);
+		VK_CHECK_RESULT(vkMapMemory(device, frame.readbackMemory, 0, VK_WHOLE_SIZE, 0, &frame.readbackData));
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.renderCommandBuffer));
+		cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(transferCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.copyCommandBuffer));
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		// Signaled, so the first use of the frame doesn't have to wait
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.copyComplete));
+		frame.sequenceIndex = -1;
+	}
 
-			submitWork(commandBuffer, queue);
+	void destroyFrame(Frame& frame)
+	{
+		vkDestroyFence(device, frame.copyComplete, nullptr);
+		vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		vkUnmapMemory(device, frame.readbackMemory);
+		vkDestroyBuffer(device, frame.readbackBuffer, nullptr);
+		vkFreeMemory(device, frame.readbackMemory, nullptr);
+		vkDestroyFramebuffer(device, frame.framebuffer, nullptr);
+		vkDestroyImageView(device, frame.colorAttachment.view, nullptr);
+		vkDestroyImage(device, frame.colorAttachment.image, nullptr);
+		vkFreeMemory(device, frame.colorAttachment.memory, nullptr);
+		vkDestroyImageView(device, frame.depthAttachment.view, nullptr);
+		vkDestroyImage(device, frame.depthAttachment.image, nullptr);
+		vkFreeMemory(device, frame.depthAttachment.memory, nullptr);
+	}
 
-			vkDeviceWaitIdle(device);
+	/*
+		Record and submit a frame of the sequence into a frame in flight, whose previous frame has been finished
+		The scene is rotated around the camera over the course of the sequence
+	*/
+	void renderFrame(Frame& frame, uint32_t frameInFlight, uint32_t sequenceIndex)
+	{
+		VkCommandBuffer commandBuffer = frame.renderCommandBuffer;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, timestampQueryPool, frameInFlight * 2, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, frameInFlight * 2);
 		}
 
-		/*
-			Copy framebuffer image to host visible image
-		*/
-		const char* imagedata;
-		{
-			// Create the linear tiled destination image to copy to and to read the memory from
-			VkImageCreateInfo imgCreateInfo(vks::initializers::imageCreateInfo());
-			imgCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imgCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-			imgCreateInfo.extent.width = width;
-			imgCreateInfo.extent.height = height;
-			imgCreateInfo.extent.depth = 1;
-			imgCreateInfo.arrayLayers = 1;
-			imgCreateInfo.mipLevels = 1;
-			imgCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imgCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imgCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imgCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-			// Create the image
-			VkImage dstImage;
-			VK_CHECK_RESULT(vkCreateImage(device, &imgCreateInfo, nullptr, &dstImage));
-			// Create memory to back up the image
-			VkMemoryRequirements memRequirements;
-			VkMemoryAllocateInfo memAllocInfo(vks::initializers::memoryAllocateInfo());
-			VkDeviceMemory dstImageMemory;
-			vkGetImageMemoryRequirements(device, dstImage, &memRequirements);
-			memAllocInfo.allocationSize = memRequirements.size;
-			// Memory must be host visible to copy from
-			memAllocInfo.memoryTypeIndex = getMemoryTypeIndex(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dstImageMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, dstImage, dstImageMemory, 0));
-
-			// Do the actual blit from the offscreen image to our host visible destination image
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			// Transition destination image to transfer destination layout
-			vks::tools::insertImageMemoryBarrier(
-				copyCmd,
-				dstImage,
-				0,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-			// colorAttachment.image is already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and does not need to be transitioned
-
-			VkImageCopy imageCopyRegion{};
-			imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.srcSubresource.layerCount = 1;
-			imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.dstSubresource.layerCount = 1;
-			imageCopyRegion.extent.width = width;
-			imageCopyRegion.extent.height = height;
-			imageCopyRegion.extent.depth = 1;
-
-			vkCmdCopyImage(
-				copyCmd,
-				colorAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageCopyRegion);
-
-			// Transition destination image to general layout, which is the required layout for mapping the image memory later on
-			vks::tools::insertImageMemoryBarrier(
-				copyCmd,
-				dstImage,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_MEMORY_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_GENERAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			submitWork(copyCmd, queue);
-
-			// Get layout of the image (including row pitch)
-			VkImageSubresource subResource{};
-			subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			VkSubresourceLayout subResourceLayout;
-
-			vkGetImageSubresourceLayout(device, dstImage, &subResource, &subResourceLayout);
-
-			// Map image memory so we can start copying from it
-			vkMapMemory(device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&imagedata);
-			imagedata += subResourceLayout.offset;
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frame.framebuffer;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = {};
+		viewport.height = (float)height;
+		viewport.width = (float)width;
+		viewport.minDepth = (float)0.0f;
+		viewport.maxDepth = (float)1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		// Update dynamic scissor state
+		VkRect2D scissor = {};
+		scissor.extent.width = width;
+		scissor.extent.height = height;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		// Render scene
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		const float angle = (settings.frameCount > 1) ? glm::radians(360.0f) * static_cast<float>(sequenceIndex) / static_cast<float>(settings.frameCount) : 0.0f;
+		const glm::mat4 viewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.5f)) * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.5f));
+		for (auto v : scenePositions) {
+			glm::mat4 mvpMatrix = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f) * viewMatrix * glm::translate(glm::mat4(1.0f), v);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
+			vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, frameInFlight * 2 + 1);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
 		/*
-			Save host visible framebuffer image to disk (ppm format)
+			Copy the color attachment (already in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) to the frame's readback buffer
+			The copy waits for the render submission with a semaphore, so the graphics queue can go on with the next frame in the meantime
 		*/
+		VK_CHECK_RESULT(vkBeginCommandBuffer(frame.copyCommandBuffer, &cmdBufInfo));
+
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent.width = width;
+		copyRegion.imageExtent.height = height;
+		copyRegion.imageExtent.depth = 1;
+		vkCmdCopyImageToBuffer(frame.copyCommandBuffer, frame.colorAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer, 1, &copyRegion);
+
+		// Make the copied data visible to the host
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = frame.readbackBuffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(frame.copyCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(frame.copyCommandBuffer));
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.renderCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &frame.renderComplete;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo copySubmitInfo = vks::initializers::submitInfo();
+		copySubmitInfo.waitSemaphoreCount = 1;
+		copySubmitInfo.pWaitSemaphores = &frame.renderComplete;
+		copySubmitInfo.pWaitDstStageMask = &waitStageMask;
+		copySubmitInfo.commandBufferCount = 1;
+		copySubmitInfo.pCommandBuffers = &frame.copyCommandBuffer;
+		VK_CHECK_RESULT(vkResetFences(device, 1, &frame.copyComplete));
+		VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &copySubmitInfo, frame.copyComplete));
+
+		frame.sequenceIndex = static_cast<int32_t>(sequenceIndex);
+	}
+
+	/*
+		Wait for the readback of the frame in flight's last frame (if any) and hand its pixels to an encoder thread
+	*/
+	void finishFrame(Frame& frame, uint32_t frameInFlight)
+	{
+		if (frame.sequenceIndex < 0) {
+			return;
+		}
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.copyComplete, VK_TRUE, UINT64_MAX));
+
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			uint64_t timestamps[2];
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, timestampQueryPool, frameInFlight * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+			gpuBusyMs += static_cast<double>(timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+		}
+
+		// Only a copy of the pixels is handed to the encoders, so the readback buffer can be reused by the next frame right away
+		while (pendingEncodes >= settings.workerCount * 2) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(width) * height * 4);
+		memcpy(pixels->data(), frame.readbackData, pixels->size());
 
 #if defined (VK_USE_PLATFORM_ANDROID_KHR)
-			const char* filename = strcat(getenv("EXTERNAL_STORAGE"), "/headless.ppm");
+		std::string fileName = std::string(getenv("EXTERNAL_STORAGE")) + "/headless";
 #else
-			const char* filename = "headless.ppm";
+		std::string fileName = "headless";
 #endif
-			std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-			// ppm header
-			file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-			// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-			// Check if source is BGR and needs swizzle
-			std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-			const bool colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
-
-			// ppm binary pixel data
-			for (int32_t y = 0; y < height; y++) {
-				unsigned int *row = (unsigned int*)imagedata;
-				for (int32_t x = 0; x < width; x++) {
-					if (colorSwizzle) {
-						file.write((char*)row + 2, 1);
-						file.write((char*)row + 1, 1);
-						file.write((char*)row, 1);
-					}
-					else {
-						file.write((char*)row, 3);
-					}
-					row++;
-				}
-				imagedata += subResourceLayout.rowPitch;
+		if (settings.frameCount > 1) {
+			char index[16];
+			snprintf(index, sizeof(index), "_%05d", frame.sequenceIndex);
+			fileName += index;
+		}
+		fileName += (settings.encoding == vks::FrameCapture::Encoding::PNG) ? ".png" : ".ppm";
+
+		const uint32_t imageWidth = static_cast<uint32_t>(width);
+		const uint32_t imageHeight = static_cast<uint32_t>(height);
+		const vks::FrameCapture::Encoding encoding = settings.encoding;
+		std::atomic<uint32_t>* pending = &pendingEncodes;
+		pendingEncodes++;
+		encoders.threads[frame.sequenceIndex % encoders.threads.size()]->addJob([pixels, fileName, imageWidth, imageHeight, encoding, pending]() {
+			// The color attachment is RGBA, the files are written as RGB
+			const size_t pixelCount = static_cast<size_t>(imageWidth) * imageHeight;
+			std::vector<uint8_t> rgb(pixelCount * 3);
+			for (size_t i = 0; i < pixelCount; i++) {
+				rgb[i * 3 + 0] = (*pixels)[i * 4 + 0];
+				rgb[i * 3 + 1] = (*pixels)[i * 4 + 1];
+				rgb[i * 3 + 2] = (*pixels)[i * 4 + 2];
 			}
-			file.close();
-
-			LOG("Framebuffer image saved to %s\n", filename);
+			vks::FrameCapture::writeImage(fileName, rgb, imageWidth, imageHeight, encoding);
+			(*pending)--;
+		});
+		frame.sequenceIndex = -1;
+	}
 
-			// Clean up resources
-			vkUnmapMemory(device, dstImageMemory);
-			vkFreeMemory(device, dstImageMemory, nullptr);
-			vkDestroyImage(device, dstImage, nullptr);
+	/*
+		Render the whole sequence, keeping all frames in flight busy, and report the throughput
+	*/
+	void renderSequence()
+	{
+		encoders.setThreadCount(std::max(settings.workerCount, 1u));
+		// With multiple GPUs each one renders every gpuCount-th frame of the sequence
+		const uint32_t frameCount = (settings.frameCount > settings.gpuIndex) ? (settings.frameCount - settings.gpuIndex + settings.gpuCount - 1) / settings.gpuCount : 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < frameCount; i++) {
+			const uint32_t frameInFlight = i % settings.framesInFlight;
+			finishFrame(frames[frameInFlight], frameInFlight);
+			renderFrame(frames[frameInFlight], frameInFlight, settings.gpuIndex + i * settings.gpuCount);
+		}
+		// Finish the remaining frames in the order they've been submitted
+		for (uint32_t i = frameCount; i < frameCount + settings.framesInFlight; i++) {
+			const uint32_t frameInFlight = i % settings.framesInFlight;
+			finishFrame(frames[frameInFlight], frameInFlight);
+		}
+		const double renderSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		encoders.wait();
+		const double totalSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		LOG("GPU %u: Rendered %u frames with %u frames in flight in %.3f s (%.1f frames per second)\n", settings.gpuIndex, frameCount, settings.framesInFlight, renderSeconds, frameCount / renderSeconds);
+		LOG("GPU %u: Written %u images with %u encoder threads in %.3f s (%.1f frames per second)\n", settings.gpuIndex, frameCount, static_cast<uint32_t>(encoders.threads.size()), totalSeconds, frameCount / totalSeconds);
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			LOG("GPU %u: Busy for %.3f ms (%.1f%% utilization of the graphics queue)\n", settings.gpuIndex, gpuBusyMs, 100.0 * gpuBusyMs / (renderSeconds * 1000.0));
 		}
-
-		vkQueueWaitIdle(queue);
 	}
 
 	~VulkanExample()
@@ -833,19 +986,19 @@ public:
 		vkFreeMemory(device, vertexMemory, nullptr);
 		vkDestroyBuffer(device, indexBuffer, nullptr);
 		vkFreeMemory(device, indexMemory, nullptr);
-		vkDestroyImageView(device, colorAttachment.view, nullptr);
-		vkDestroyImage(device, colorAttachment.image, nullptr);
-		vkFreeMemory(device, colorAttachment.memory, nullptr);
-		vkDestroyImageView(device, depthAttachment.view, nullptr);
-		vkDestroyImage(device, depthAttachment.image, nullptr);
-		vkFreeMemory(device, depthAttachment.memory, nullptr);
+		for (auto& frame : frames) {
+			destroyFrame(frame);
+		}
+		if (timestampQueryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+		}
 		vkDestroyRenderPass(device, renderPass, nullptr);
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineCache(device, pipelineCache, nullptr);
 		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
 		for (auto shadermodule : shaderModules) {
 			vkDestroyShaderModule(device, shadermodule, nullptr);
 		}
@@ -867,7 +1020,7 @@ public:
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 void handleAppCommand(android_app * app, int32_t cmd) {
 	if (cmd == APP_CMD_INIT_WINDOW) {
-		VulkanExample *vulkanExample = new VulkanExample();
+		VulkanExample *vulkanExample = new VulkanExample(Settings());
 		delete(vulkanExample);
 		ANativeActivity_finish(app->activity);
 	}
@@ -887,11 +1040,67 @@ void android_main(android_app* state) {
 	}
 }
 #else
-int main() {
-	VulkanExample *vulkanExample = new VulkanExample();
+// Number of physical devices the sequence can be distributed over
+uint32_t getPhysicalDeviceCount()
+{
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+	VkInstanceCreateInfo instanceCreateInfo = {};
+	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceCreateInfo.pApplicationInfo = &appInfo;
+	VkInstance instance;
+	VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+	uint32_t deviceCount = 0;
+	VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
+	vkDestroyInstance(instance, nullptr);
+	return deviceCount;
+}
+
+int main(int argc, char* argv[]) {
+	// Image sequence options: --frames <count> --framesinflight <count> --workers <count> --png --scene <file> --gpus <count, 0 for all>
+	Settings settings;
+	for (int32_t i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if ((arg == "--frames") && hasValue) {
+			settings.frameCount = std::max(atoi(argv[++i]), 1);
+		} else if ((arg == "--framesinflight") && hasValue) {
+			settings.framesInFlight = std::max(atoi(argv[++i]), 1);
+		} else if ((arg == "--workers") && hasValue) {
+			settings.workerCount = std::max(atoi(argv[++i]), 1);
+		} else if (arg == "--png") {
+			settings.encoding = vks::FrameCapture::Encoding::PNG;
+		} else if ((arg == "--scene") && hasValue) {
+			settings.sceneFile = argv[++i];
+		} else if ((arg == "--gpus") && hasValue) {
+			settings.gpuCount = std::max(atoi(argv[++i]), 0);
+		}
+	}
+	const uint32_t physicalDeviceCount = getPhysicalDeviceCount();
+	settings.gpuCount = (settings.gpuCount == 0) ? physicalDeviceCount : std::min(settings.gpuCount, physicalDeviceCount);
+
+	// Each GPU gets its own instance and device, driven by its own thread
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::vector<VulkanExample*> vulkanExamples(settings.gpuCount);
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < settings.gpuCount; i++) {
+		Settings gpuSettings = settings;
+		gpuSettings.gpuIndex = i;
+		threads.push_back(std::thread([&vulkanExamples, gpuSettings, i]() { vulkanExamples[i] = new VulkanExample(gpuSettings); }));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	if (settings.gpuCount > 1) {
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		LOG("%u GPUs: Written %u images in %.3f s (%.1f frames per second, including device creation)\n", settings.gpuCount, settings.frameCount, seconds, settings.frameCount / seconds);
+	}
 	std::cout << "Finished. Press enter to terminate...";
 	getchar();
-	delete(vulkanExample);
+	for (auto vulkanExample : vulkanExamples) {
+		delete(vulkanExample);
+	}
 	return 0;
 }
 #endif
\ No newline at end of file
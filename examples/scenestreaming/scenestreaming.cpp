@@ -0,0 +1,280 @@
+/*
+* Vulkan Example - Streaming a spatially partitioned glTF scene
+*
+* The scene is partitioned into the cells of a uniform grid when it's first loaded, and each cell is written to a cell file next to the glTF file (see vks::StreamingScene)
+* At runtime only the cells around the camera are streamed in: A worker thread reads them from the cell file and they're uploaded on the transfer queue, so neither stalls rendering
+* Cells are prioritized by their distance to the camera, with cells outside of the view frustum counting as further away, and a memory budget limits their total size
+* Until a cell has arrived, it's drawn with a simplified proxy that's always resident (tinted red if highlighting is enabled)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanStreamingScene.h"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vks::StreamingScene scene;
+	float cellSize = 4.0f;
+	int32_t memoryBudgetMB = 8;
+	bool drawProxies = true;
+	bool highlightProxies = true;
+	bool autoMove = false;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Streaming a spatially partitioned scene";
+		camera.type = Camera::CameraType::firstperson;
+		camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+		camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		settings.overlay = true;
+		// Recorded each frame, as the draws depend on the cells that are resident
+		dynamicCommandBuffers = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("cellsize", { "-cellsize", "--cellsize" }, 1, "Size of the grid cells the scene is partitioned into in scene units (defaults to 4)");
+		exampleArgs.add("budget", { "-budget", "--budget" }, 1, "Memory budget for the resident cells in MB (defaults to 8)");
+		exampleArgs.parse(args);
+		cellSize = static_cast<float>(std::max(exampleArgs.getValueAsInt("cellsize", 4), 1));
+		memoryBudgetMB = std::max(exampleArgs.getValueAsInt("budget", 8), 1);
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			uniformBuffer.destroy();
+			scene.destroy();
+		}
+	}
+
+	void loadAssets()
+	{
+		// Builds the cell file on the first run, which takes a while for large scenes
+		scene.open(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, cellSize);
+		scene.memoryBudget = (VkDeviceSize)memoryBudgetMB * 1024 * 1024;
+		scene.streamingDistance = cellSize * 2.0f;
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	void updateUniformBuffers()
+	{
+		waitForFramesInFlight();
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Vertex shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		// Tint to highlight the proxies
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec4), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		// Sponza has double sided geometry
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+		// Resident cells and proxies share the same vertex layout
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(vks::StreamingScene::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			// Location 0: Position
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::StreamingScene::Vertex, pos)),
+			// Location 1: Normal
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::StreamingScene::Vertex, normal)),
+			// Location 2: Color
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vks::StreamingScene::Vertex, color)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputStateCI = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+			loadShader(getShadersPath() + "scenestreaming/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "scenestreaming/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputStateCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// [POI] Cells that have finished streaming in become resident, and the most important missing cells are requested (world space position of the first person camera)
+		scene.update(-camera.position, camera.matrices.perspective * camera.matrices.view);
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		gpuProfiler.beginScope(commandBuffer, "Streamed scene");
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		if (highlightProxies) {
+			scene.draw(commandBuffer, drawProxies, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT);
+		} else {
+			const glm::vec4 tint(1.0f);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::vec4), &tint);
+			scene.draw(commandBuffer, drawProxies);
+		}
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		// The benchmark walks through the scene, so cells are constantly streamed in and evicted
+		autoMove = autoMove || benchmark.active;
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		if (autoMove && !paused) {
+			// Walk back and forth along the longest side of the scene
+			glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+			for (auto& cell : scene.cells) {
+				min = glm::min(min, cell.min);
+				max = glm::max(max, cell.max);
+			}
+			const float t = 0.5f - 0.5f * cos(timer * 2.0f * glm::pi<float>());
+			const glm::vec3 center = (min + max) * 0.5f;
+			glm::vec3 position = center;
+			if (max.x - min.x > max.z - min.z) {
+				position.x = glm::mix(min.x, max.x, t);
+			} else {
+				position.z = glm::mix(min.z, max.z, t);
+			}
+			camera.setPosition(glm::vec3(-position.x, camera.position.y, -position.z));
+		}
+		renderFrame();
+	}
+
+	virtual void viewChanged()
+	{
+		updateUniformBuffers();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Walk through the scene", &autoMove);
+			overlay->sliderFloat("Streaming distance", &scene.streamingDistance, cellSize * 0.5f, cellSize * 8.0f);
+			if (overlay->sliderInt("Memory budget (MB)", &memoryBudgetMB, 1, 256)) {
+				scene.memoryBudget = (VkDeviceSize)memoryBudgetMB * 1024 * 1024;
+			}
+			overlay->checkBox("Draw proxies", &drawProxies);
+			overlay->checkBox("Highlight proxies", &highlightProxies);
+		}
+		if (overlay->header("Statistics")) {
+			const float toMB = 1.0f / (1024.0f * 1024.0f);
+			overlay->text("Cells: %d", static_cast<uint32_t>(scene.cells.size()));
+			overlay->text("Resident: %d (%.1f MB)", scene.cellCount(vks::StreamingScene::CellState::Resident), (float)scene.residentBytes * toMB);
+			overlay->text("Pending: %d (%.1f MB)", scene.cellCount(vks::StreamingScene::CellState::Reading) + scene.cellCount(vks::StreamingScene::CellState::Uploading), (float)scene.pendingBytes * toMB);
+			overlay->text("Drawn: %d cells, %d proxies", scene.statistics.cellsDrawn, scene.statistics.proxiesDrawn);
+			overlay->text("Streamed in: %d (%.1f MB), evicted: %d", scene.statistics.cellsRead, (float)scene.statistics.bytesUploaded * toMB, scene.statistics.cellsEvicted);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
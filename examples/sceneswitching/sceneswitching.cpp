@@ -0,0 +1,408 @@
+/*
+* Vulkan Example - Switching glTF scenes at runtime
+*
+* Loads glTF scenes into the running example instead of restarting it (see vks::SceneSwapper)
+* The device, swapchain, pipelines, pipeline cache, descriptor set layouts and the image based lighting maps are created once and kept across switches,
+* only the scene itself is replaced. Reading and decoding the next scene runs on a worker thread while a placeholder is rendered,
+* and only its resource creation and upload are done on the render thread, so a switch takes a fraction of a cold start
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanIBLGenerator.h"
+#include "VulkanSceneSwapper.h"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	struct Scene {
+		std::string name;
+		std::string filename;
+	};
+	std::vector<Scene> scenes;
+	int32_t sceneIndex = 0;
+	vks::SceneSwapper sceneSwapper;
+	const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+	// Cycle through the scenes, enabled by the benchmark
+	bool autoSwitch = false;
+	float autoSwitchInterval = 2.0f;
+	float timeSinceSwap = 0.0f;
+
+	std::string environmentFile;
+	struct Textures {
+		vks::TextureCubeMap environmentCube;
+		vks::Texture2D lutBrdf;
+		vks::TextureCubeMap irradianceCube;
+		vks::TextureCubeMap prefilteredCube;
+	} textures;
+
+	struct Models {
+		vkglTF::Model skybox;
+		// Drawn while a scene is being loaded
+		vkglTF::Model placeholder;
+	} models;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 model;
+		glm::mat4 view;
+		glm::vec4 camPos;
+	} uniformData;
+
+	struct ParamsData {
+		float exposure = 4.5f;
+		float gamma = 2.2f;
+		float roughness = 0.6f;
+		float metallic = 0.0f;
+	} paramsData;
+
+	struct {
+		vks::Buffer scene;
+		vks::Buffer skybox;
+		vks::Buffer params;
+	} uniformBuffers;
+
+	struct {
+		VkPipeline skybox;
+		VkPipeline scene;
+		VkPipeline placeholder;
+	} pipelines;
+
+	struct {
+		VkDescriptorSet scene;
+		VkDescriptorSet skybox;
+	} descriptorSets;
+
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Switching glTF scenes at runtime";
+		enableCompressedHDRTextures = true;
+		camera.type = Camera::CameraType::lookat;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		camera.setRotation(glm::vec3(-15.0f, 30.0f, 0.0f));
+		camera.setPosition(glm::vec3(0.0f, 0.0f, -5.0f));
+		camera.rotationSpeed = 0.25f;
+		settings.overlay = true;
+		// Recorded each frame, so a new scene is picked up without rebuilding anything
+		dynamicCommandBuffers = true;
+		scenes = {
+			{ "Sponza", "models/sponza/sponza.gltf" },
+			{ "Armor", "models/armor/armor.gltf" },
+			{ "Flight helmet", "models/FlightHelmet/glTF/FlightHelmet.gltf" },
+			{ "Voyager", "models/voyager.gltf" },
+		};
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipelines.skybox, nullptr);
+			vkDestroyPipeline(device, pipelines.scene, nullptr);
+			vkDestroyPipeline(device, pipelines.placeholder, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			uniformBuffers.scene.destroy();
+			uniformBuffers.skybox.destroy();
+			uniformBuffers.params.destroy();
+			textures.environmentCube.destroy();
+			textures.irradianceCube.destroy();
+			textures.prefilteredCube.destroy();
+			textures.lutBrdf.destroy();
+			sceneSwapper.destroy();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		if (deviceFeatures.samplerAnisotropy) {
+			enabledFeatures.samplerAnisotropy = VK_TRUE;
+		}
+	}
+
+	void loadAssets()
+	{
+		// The scenes' materials are bound as set 1 with their base color and normal maps, the layout is created by the first model load and shared by all models
+		vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
+		models.skybox.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		models.placeholder.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		environmentFile = getAssetPath() + "textures/hdr/gcanyon_cube.ktx";
+		textures.environmentCube.loadFromFile(environmentFile, VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+		// The first scene is loaded in the background like all later ones
+		sceneSwapper.setup(vulkanDevice, queue);
+		requestScene(sceneIndex);
+	}
+
+	void requestScene(int32_t index)
+	{
+		sceneSwapper.request(getAssetPath() + scenes[index].filename, glTFLoadingFlags);
+		timeSinceSwap = 0.0f;
+	}
+
+	// The image based lighting maps don't depend on the scene, so they're only generated once
+	void generateIBLMaps()
+	{
+		vks::IBLGenerator iblGenerator;
+		iblGenerator.prepare(vulkanDevice, queue,
+			loadShader(getShadersPath() + "base/iblbrdflut.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getShadersPath() + "base/iblirradiance.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getShadersPath() + "base/iblprefilter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			loadShader(getShadersPath() + "base/iblsh.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			pipelineCache);
+		iblGenerator.generate(textures.environmentCube, environmentFile, textures.lutBrdf, textures.irradianceCube, textures.prefilteredCube);
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffers.scene, sizeof(UniformData)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffers.skybox, sizeof(UniformData)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffers.params, sizeof(ParamsData)));
+		VK_CHECK_RESULT(uniformBuffers.scene.map());
+		VK_CHECK_RESULT(uniformBuffers.skybox.map());
+		VK_CHECK_RESULT(uniformBuffers.params.map());
+		updateUniformBuffers();
+		updateParams();
+	}
+
+	void updateUniformBuffers()
+	{
+		waitForFramesInFlight();
+		// Scenes come in very different sizes, so they are centered and scaled to a common size
+		vkglTF::Model* model = sceneSwapper.model() ? sceneSwapper.model() : &models.placeholder;
+		const float scale = 2.0f / std::max(model->dimensions.radius, 0.001f);
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.model = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -model->dimensions.center);
+		uniformData.camPos = glm::vec4(glm::vec3(glm::inverse(camera.matrices.view)[3]), 1.0f);
+		memcpy(uniformBuffers.scene.mapped, &uniformData, sizeof(UniformData));
+		// Skybox
+		uniformData.model = glm::mat4(glm::mat3(camera.matrices.view));
+		memcpy(uniformBuffers.skybox.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void updateParams()
+	{
+		waitForFramesInFlight();
+		memcpy(uniformBuffers.params.mapped, &paramsData, sizeof(ParamsData));
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+
+		// Scene (and placeholder)
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.scene));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.irradianceCube.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &textures.lutBrdf.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &textures.prefilteredCube.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Skybox
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.skybox));
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.skybox.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.environmentCube.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		// Set 1 is the material layout of the glTF models, which stays the same for all scenes
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, vkglTF::descriptorSetLayoutImage };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent });
+
+		// Skybox
+		shaderStages[0] = loadShader(getShadersPath() + "sceneswitching/skybox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "sceneswitching/skybox.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
+
+		// Scenes, glTF materials may be double sided
+		rasterizationState.cullMode = VK_CULL_MODE_NONE;
+		depthStencilState.depthWriteEnable = VK_TRUE;
+		depthStencilState.depthTestEnable = VK_TRUE;
+		shaderStages[0] = loadShader(getShadersPath() + "sceneswitching/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "sceneswitching/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
+
+		// Placeholder, which doesn't use the material images
+		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+		shaderStages[1] = loadShader(getShadersPath() + "sceneswitching/placeholder.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.placeholder));
+	}
+
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// [POI] Swap in a scene that has finished loading in the background, the command buffer is recorded each frame so it picks up the new scene right away
+		if (sceneSwapper.update()) {
+			updateUniformBuffers();
+		}
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.skybox, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skybox);
+		models.skybox.draw(commandBuffer);
+
+		gpuProfiler.beginScope(commandBuffer, "Scene");
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.scene, 0, nullptr);
+		vkglTF::Model* scene = sceneSwapper.model();
+		if (scene) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+			scene->draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
+		} else {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.placeholder);
+			models.placeholder.draw(commandBuffer);
+		}
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		generateIBLMaps();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		// The benchmark cycles through the scenes, which measures the switches
+		autoSwitch = autoSwitch || benchmark.active;
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		if (autoSwitch && !paused && !sceneSwapper.loading()) {
+			timeSinceSwap += frameTimer;
+			if (timeSinceSwap >= autoSwitchInterval) {
+				sceneIndex = (sceneIndex + 1) % static_cast<int32_t>(scenes.size());
+				requestScene(sceneIndex);
+			}
+		}
+		renderFrame();
+	}
+
+	virtual void viewChanged()
+	{
+		updateUniformBuffers();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> sceneNames;
+			for (auto& scene : scenes) {
+				sceneNames.push_back(scene.name);
+			}
+			if (overlay->comboBox("Scene", &sceneIndex, sceneNames)) {
+				requestScene(sceneIndex);
+			}
+			if (overlay->button("Reload")) {
+				requestScene(sceneIndex);
+			}
+			overlay->checkBox("Cycle scenes", &autoSwitch);
+			if (overlay->sliderFloat("Roughness", &paramsData.roughness, 0.05f, 1.0f)) {
+				updateParams();
+			}
+			if (overlay->sliderFloat("Metallic", &paramsData.metallic, 0.0f, 1.0f)) {
+				updateParams();
+			}
+			if (overlay->inputFloat("Exposure", &paramsData.exposure, 0.1f, 2)) {
+				updateParams();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			if (sceneSwapper.loading()) {
+				overlay->text("Loading %s...", scenes[sceneIndex].name.c_str());
+			}
+			overlay->text("Last switch: %.1f ms", sceneSwapper.lastSwap.totalMs);
+			overlay->text("On the render thread: %.1f ms", sceneSwapper.lastSwap.uploadMs);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRayQueryShadows.h"
 
 #define ENABLE_VALIDATION false
 
@@ -21,6 +22,8 @@
 #define SHADOWMAP_DIM 2048
 #endif
 #define DEFAULT_SHADOWMAP_FILTER VK_FILTER_LINEAR
+// The hybrid mode only uses the shadow map to find the penumbra, so it can be much smaller
+#define HYBRID_SHADOWMAP_DIM (SHADOWMAP_DIM / 4)
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -28,6 +31,12 @@ public:
 	bool displayShadowMap = false;
 	bool filterPCF = true;
 
+	// Shadows can optionally be ray traced with ray queries, for all pixels or only the penumbra of a low resolution shadow map (see vks::RayQueryShadows::Mode)
+	int32_t shadowMode = vks::RayQueryShadows::MODE_SHADOW_MAP;
+	std::vector<std::string> shadowModeNames;
+	// Acceleration structures for each scene, only created if the device supports ray queries
+	std::vector<vks::RayQueryShadows> rayQueryScenes;
+
 	// Keep depth range as small as possible
 	// for better shadow map precision
 	float zNear = 1.0f;
@@ -68,6 +77,8 @@ public:
 		VkPipeline sceneShadow;
 		VkPipeline sceneShadowPCF;
 		VkPipeline debug;
+		VkPipeline sceneRayQuery = VK_NULL_HANDLE;
+		VkPipeline sceneHybrid = VK_NULL_HANDLE;
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
@@ -75,6 +86,8 @@ public:
 		VkDescriptorSet offscreen;
 		VkDescriptorSet scene;
 		VkDescriptorSet debug;
+		// Scene rendering with ray traced shadows, one per scene as each references the scene's acceleration structure
+		std::vector<VkDescriptorSet> rayQueryScenes;
 	} descriptorSets;
 
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -103,6 +116,8 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 0.5f;
 		settings.overlay = true;
+		// Ray traced shadows are optional
+		enableRayQueries = true;
 	}
 
 	~VulkanExample()
@@ -113,12 +128,7 @@ public:
 		// Frame buffer
 		vkDestroySampler(device, offscreenPass.depthSampler, nullptr);
 
-		// Depth attachment
-		vkDestroyImageView(device, offscreenPass.depth.view, nullptr);
-		vkDestroyImage(device, offscreenPass.depth.image, nullptr);
-		vkFreeMemory(device, offscreenPass.depth.mem, nullptr);
-
-		vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
+		destroyOffscreenFramebuffer();
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
@@ -126,6 +136,10 @@ public:
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.sceneShadow, nullptr);
 		vkDestroyPipeline(device, pipelines.sceneShadowPCF, nullptr);
+		if (rayQueriesSupported) {
+			vkDestroyPipeline(device, pipelines.sceneRayQuery, nullptr);
+			vkDestroyPipeline(device, pipelines.sceneHybrid, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
@@ -134,6 +148,10 @@ public:
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.scene.destroy();
+
+		for (auto& rayQueryScene : rayQueryScenes) {
+			rayQueryScene.destroy();
+		}
 	}
 
 	// Set up a separate render pass for the offscreen frame buffer
@@ -186,15 +204,15 @@ public:
 		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassCreateInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.renderPass));
 	}
 
 	// Setup the offscreen framebuffer for rendering the scene from light's point-of-view to
 	// The depth attachment of this framebuffer will then be used to sample from in the fragment shader of the shadowing pass
-	void prepareOffscreenFramebuffer()
+	void prepareOffscreenFramebuffer(uint32_t size)
 	{
-		offscreenPass.width = SHADOWMAP_DIM;
-		offscreenPass.height = SHADOWMAP_DIM;
+		offscreenPass.width = size;
+		offscreenPass.height = size;
 
 		// For shadow mapping we only need a depth attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
@@ -230,8 +248,36 @@ public:
 		depthStencilView.image = offscreenPass.depth.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depth.view));
 
-		// Create sampler to sample from to depth attachment
-		// Used to sample in the fragment shader for shadowed rendering
+		// Create frame buffer
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = offscreenPass.renderPass;
+		fbufCreateInfo.attachmentCount = 1;
+		fbufCreateInfo.pAttachments = &offscreenPass.depth.view;
+		fbufCreateInfo.width = offscreenPass.width;
+		fbufCreateInfo.height = offscreenPass.height;
+		fbufCreateInfo.layers = 1;
+
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffer));
+
+		// The shadow map isn't rendered in ray query mode, so it's put into the layout the descriptors expect once
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(layoutCmd, offscreenPass.depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+	}
+
+	void destroyOffscreenFramebuffer()
+	{
+		vkDestroyImageView(device, offscreenPass.depth.view, nullptr);
+		vkDestroyImage(device, offscreenPass.depth.image, nullptr);
+		vkFreeMemory(device, offscreenPass.depth.mem, nullptr);
+		vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
+	}
+
+	// Create sampler to sample from to depth attachment
+	// Used to sample in the fragment shader for shadowed rendering
+	void prepareShadowMapSampler()
+	{
 		VkFilter shadowmap_filter = vks::tools::formatIsFilterable(physicalDevice, DEPTH_FORMAT, VK_IMAGE_TILING_OPTIMAL) ?
 		   DEFAULT_SHADOWMAP_FILTER :
 		   VK_FILTER_NEAREST;
@@ -248,19 +294,6 @@ public:
 		sampler.maxLod = 1.0f;
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.depthSampler));
-
-		prepareOffscreenRenderpass();
-
-		// Create frame buffer
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 1;
-		fbufCreateInfo.pAttachments = &offscreenPass.depth.view;
-		fbufCreateInfo.width = offscreenPass.width;
-		fbufCreateInfo.height = offscreenPass.height;
-		fbufCreateInfo.layers = 1;
-
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffer));
 	}
 
 	void buildCommandBuffers()
@@ -277,8 +310,9 @@ public:
 
 			/*
 				First render pass: Generate shadow map by rendering the scene from light's POV
+				Not required if all shadows are ray traced
 			*/
-			{
+			if (shadowMode != vks::RayQueryShadows::MODE_RAY_QUERY) {
 				clearValues[0].depthStencil = { 1.0f, 0 };
 
 				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
@@ -307,6 +341,8 @@ public:
 
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.offscreen, 0, nullptr);
+				// The shadow pass only needs vertex positions
+				scenes[sceneIndex].bindPositionBuffers(drawCmdBuffers[i]);
 				scenes[sceneIndex].draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -348,8 +384,14 @@ public:
 				}
 
 				// 3D scene
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.scene, 0, nullptr);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+				if (shadowMode == vks::RayQueryShadows::MODE_SHADOW_MAP) {
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.scene, 0, nullptr);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+				} else {
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.rayQueryScenes[sceneIndex], 0, nullptr);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (shadowMode == vks::RayQueryShadows::MODE_HYBRID) ? pipelines.sceneHybrid : pipelines.sceneRayQuery);
+				}
+				scenes[sceneIndex].bindBuffers(drawCmdBuffers[i]);
 				scenes[sceneIndex].draw(drawCmdBuffers[i]);
 
 				drawUI(drawCmdBuffers[i]);
@@ -363,20 +405,38 @@ public:
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		if (rayQueriesSupported) {
+			// The scene's vertex and index buffers are also used as inputs for the acceleration structure builds
+			vkglTF::memoryPropertyFlags |= vks::RayQueryShadows::bufferUsageFlags;
+		}
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PositionStream;
 		scenes.resize(2);
 		scenes[0].loadFromFile(getAssetPath() + "models/vulkanscene_shadow.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		scenes[1].loadFromFile(getAssetPath() + "models/samplescene.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		sceneNames = {"Vulkan scene", "Teapots and pillars" };
+		shadowModeNames = { "Shadow map" };
+		if (rayQueriesSupported) {
+			// Both scenes are rendered with pre-transformed vertices, so a single instance with an identity transform is used
+			rayQueryScenes.resize(scenes.size());
+			for (size_t i = 0; i < scenes.size(); i++) {
+				rayQueryScenes[i].create(vulkanDevice, queue, scenes[i]);
+			}
+			shadowModeNames.push_back("Ray query");
+			shadowModeNames.push_back("Hybrid");
+		}
 	}
 
 	void setupDescriptorPool()
 	{
+		const uint32_t rayQuerySetCount = static_cast<uint32_t>(rayQueryScenes.size());
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3 + rayQuerySetCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 + rayQuerySetCount)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		if (rayQueriesSupported) {
+			poolSizes.push_back(vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, rayQuerySetCount));
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3 + rayQuerySetCount);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -389,13 +449,35 @@ public:
 			// Binding 1 : Fragment shader image sampler (shadow map)
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
 		};
+		if (rayQueriesSupported) {
+			// Binding 2 : Fragment shader acceleration structure (ray traced shadows)
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_FRAGMENT_BIT, 2));
+		}
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSets()
+	{
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		// Debug display
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.debug));
+		// Offscreen shadow map generation
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.offscreen));
+		// Scene rendering with shadow map applied
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.scene));
+		// Scene rendering with ray traced shadows
+		descriptorSets.rayQueryScenes.resize(rayQueryScenes.size());
+		for (auto& descriptorSet : descriptorSets.rayQueryScenes) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		}
+		updateDescriptorSets();
+	}
+
+	// Also called when the shadow map is recreated with a different size
+	void updateDescriptorSets()
 	{
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
@@ -407,8 +489,6 @@ public:
 		        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
 		// Debug display
-		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.debug));
 		writeDescriptorSets = {
 			// Binding 1 : Fragment shader texture sampler
 		    vks::initializers::writeDescriptorSet(descriptorSets.debug, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &shadowMapDescriptor)
@@ -416,7 +496,6 @@ public:
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 
 		// Offscreen shadow map generation
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.offscreen));
 		writeDescriptorSets = {
 			// Binding 0 : Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSets.offscreen, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.offscreen.descriptor),
@@ -424,7 +503,6 @@ public:
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 
 		// Scene rendering with shadow map applied
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.scene));
 		writeDescriptorSets = {
 			// Binding 0 : Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),
@@ -432,6 +510,19 @@ public:
 		    vks::initializers::writeDescriptorSet(descriptorSets.scene, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &shadowMapDescriptor)
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+
+		// Scene rendering with ray traced shadows, the hybrid mode also samples the shadow map
+		for (size_t i = 0; i < descriptorSets.rayQueryScenes.size(); i++) {
+			writeDescriptorSets = {
+				// Binding 0 : Vertex shader uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets.rayQueryScenes[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),
+				// Binding 1 : Fragment shader shadow sampler
+				vks::initializers::writeDescriptorSet(descriptorSets.rayQueryScenes[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &shadowMapDescriptor),
+				// Binding 2 : Fragment shader acceleration structure
+				rayQueryScenes[i].writeDescriptorSet(descriptorSets.rayQueryScenes[i], 2)
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+		}
 	}
 
 	void preparePipelines()
@@ -465,7 +556,7 @@ public:
 		// Empty vertex input state
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.debug));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.debug));
 
 		// Scene rendering with shadows applied
 		pipelineCI.pVertexInputState  = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -478,14 +569,26 @@ public:
 		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &enablePCF);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		// No filtering
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadow));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadow));
 		// PCF filtering
 		enablePCF = 1;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadowPCF));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadowPCF));
+
+		// Ray traced shadows, the same specialization constant selects between tracing all pixels and only the penumbra of the shadow map
+		if (rayQueriesSupported) {
+			shaderStages[1] = loadShader(getShadersPath() + "shadowmapping/scene_rayquery.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			enablePCF = 0;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneRayQuery));
+			enablePCF = 1;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneHybrid));
+		}
 
 		// Offscreen pipeline (vertex shader only)
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmapping/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		pipelineCI.stageCount = 1;
+		// Only positions are fetched from a separate, tightly packed vertex buffer
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPositionVertexInputState();
 		// No blend attachment states (no color attachments used)
 		colorBlendStateCI.attachmentCount = 0;
 		// Cull front faces
@@ -501,7 +604,7 @@ public:
 				0);
 
 		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -540,6 +643,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVSscene.projection = camera.matrices.perspective;
 		uboVSscene.view = camera.matrices.view;
 		uboVSscene.model = glm::mat4(1.0f);
@@ -550,6 +654,7 @@ public:
 
 	void updateUniformBufferOffscreen()
 	{
+		waitForFramesInFlight();
 		// Matrix from light's point of view
 		glm::mat4 depthProjectionMatrix = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, zFar);
 		glm::mat4 depthViewMatrix = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0, 1, 0));
@@ -578,7 +683,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		prepareOffscreenFramebuffer();
+		prepareShadowMapSampler();
+		prepareOffscreenRenderpass();
+		prepareOffscreenFramebuffer(SHADOWMAP_DIM);
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -601,6 +708,20 @@ public:
 		}
 	}
 
+	// The hybrid mode only needs a low resolution shadow map to find the penumbra, so the shadow map is resized when switching to or from it
+	void setShadowMode(int32_t mode)
+	{
+		shadowMode = mode;
+		const uint32_t shadowMapSize = (shadowMode == vks::RayQueryShadows::MODE_HYBRID) ? HYBRID_SHADOWMAP_DIM : SHADOWMAP_DIM;
+		if (shadowMapSize != static_cast<uint32_t>(offscreenPass.width)) {
+			vkDeviceWaitIdle(device);
+			destroyOffscreenFramebuffer();
+			prepareOffscreenFramebuffer(shadowMapSize);
+			updateDescriptorSets();
+		}
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
@@ -613,6 +734,15 @@ public:
 			if (overlay->checkBox("PCF filtering", &filterPCF)) {
 				buildCommandBuffers();
 			}
+			if (rayQueriesSupported) {
+				if (overlay->comboBox("Shadows", &shadowMode, shadowModeNames)) {
+					setShadowMode(shadowMode);
+				}
+			}
+		}
+		if (rayQueriesSupported && overlay->header("Ray traced shadows")) {
+			overlay->text("Shadow map: %dx%d", offscreenPass.width, offscreenPass.height);
+			overlay->text("Acceleration structures: %.2f MB", rayQueryScenes[sceneIndex].memorySize() / (1024.0f * 1024.0f));
 		}
 	}
 };
@@ -13,12 +13,18 @@
 	This results in a better shadow map resolution distribution that can be tweaked even further by increasing
 	the number of frustum splits.
 
-	A further optimization could be done using a geometry shader to do a single-pass render for the depth map
-	cascades instead of multiple passes (geometry shaders are not supported on all target devices).
+	The cascades are texel snapped, so they only move in whole shadow map texels. This removes shimmering edges when
+	the camera moves and keeps a cascade's matrix unchanged as long as the camera stays within a texel, in which case the
+	(static) shadow casters don't need to be rendered into that cascade again.
+
+	Shadow casters are culled against each cascade's light frustum. If VK_EXT_shader_viewport_index_layer is supported,
+	all cascades are rendered in a single pass with the vertex shader selecting the layer per instance, instead of one
+	pass per cascade.
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -37,6 +43,13 @@ public:
 	int32_t displayDepthMapCascadeIndex = 0;
 	bool colorCascades = false;
 	bool filterPCF = false;
+	// Keep the layers of cascades that haven't moved since they were rendered
+	bool cacheCascades = true;
+	// Render all cascades in a single pass with VK_EXT_shader_viewport_index_layer
+	bool layeredRendering = true;
+	bool layeredRenderingSupported = false;
+	// Number of cascades rendered with the last recorded frame
+	uint32_t renderedCascadeCount = 0;
 
 	float cascadeSplitLambda = 0.95f;
 
@@ -50,6 +63,14 @@ public:
 		vkglTF::Model tree;
 	} models;
 
+	const std::vector<glm::vec3> treePositions = {
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(1.25f, 0.25f, 1.25f),
+		glm::vec3(-1.25f, -0.2f, 1.25f),
+		glm::vec3(1.25f, 0.1f, -1.25f),
+		glm::vec3(-1.25f, -0.25f, -1.25f),
+	};
+
 	struct uniformBuffers {
 		vks::Buffer VS;
 		vks::Buffer FS;
@@ -94,6 +115,9 @@ public:
 		VkRenderPass renderPass;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
+		// Single pass rendering of all cascades into a layered framebuffer
+		VkPipeline layeredPipeline = VK_NULL_HANDLE;
+		VkFramebuffer layeredFrameBuffer = VK_NULL_HANDLE;
 		vks::Buffer uniformBuffer;
 
 		struct UniformBlock {
@@ -124,6 +148,11 @@ public:
 
 		float splitDepth;
 		glm::mat4 viewProjMatrix;
+		vks::Frustum frustum;
+
+		// Matrix the cascade's layer was last rendered with, the layer can be reused as long as this doesn't change
+		glm::mat4 renderedViewProjMatrix;
+		bool rendered = false;
 
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
@@ -143,6 +172,12 @@ public:
 		camera.setRotation(glm::vec3(-17.0f, 7.0f, 0.0f));
 		settings.overlay = true;
 		timer = 0.2f;
+		// The command buffer is recorded each frame (see recordCommandBuffer), as the cascades to render and the shadow casters drawn into them change with the camera
+		dynamicCommandBuffers = true;
+		// Culling and recording the cascades is the CPU heavy part of a frame, which can overlap the previous frame's present with the submission thread (--submitthread)
+		submitThread.supported = true;
+		// The scene pass is recorded with beginSceneRenderPass and endSceneRenderPass, so it can be rendered at a dynamic resolution (--dynamicresolution)
+		dynamicResolution.supported = true;
 	}
 
 	~VulkanExample()
@@ -156,6 +191,10 @@ public:
 
 		vkDestroyPipeline(device, pipelines.debugShadowMap, nullptr);
 		vkDestroyPipeline(device, depthPass.pipeline, nullptr);
+		if (depthPass.layeredPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, depthPass.layeredPipeline, nullptr);
+			vkDestroyFramebuffer(device, depthPass.layeredFrameBuffer, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.sceneShadow, nullptr);
 		vkDestroyPipeline(device, pipelines.sceneShadowPCF, nullptr);
 
@@ -174,6 +213,19 @@ public:
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
 		// Depth clamp to avoid near plane clipping
 		enabledFeatures.depthClamp = deviceFeatures.depthClamp;
+		// Writing the layer from the vertex shader allows rendering all cascades in a single pass
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME) == 0) {
+				enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+				layeredRenderingSupported = true;
+				break;
+			}
+		}
+		layeredRendering = layeredRenderingSupported;
 	}
 
 	/*
@@ -192,15 +244,7 @@ public:
 		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
 
 		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
-
-		for (auto position : positions) {
+		for (auto position : treePositions) {
 			pushConstBlock.position = glm::vec4(position, 0.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
@@ -208,6 +252,71 @@ public:
 		}
 	}
 
+	/*
+		Get a bit mask of the cascades whose light frustum intersects the given bounding sphere
+		The near planes are not tested, as casters between the light and a cascade still cast shadows into it (their depth is clamped)
+	*/
+	uint32_t getCascadeMask(const glm::vec3 &center, float radius)
+	{
+		uint32_t mask = 0;
+		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
+			bool visible = true;
+			for (uint32_t j = 0; j < cascades[i].frustum.planes.size(); j++) {
+				const glm::vec4 &plane = cascades[i].frustum.planes[j];
+				if ((j != vks::Frustum::BACK) && (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)) {
+					visible = false;
+					break;
+				}
+			}
+			if (visible) {
+				mask |= (1 << i);
+			}
+		}
+		return mask;
+	}
+
+	/*
+		Render the shadow casters into the depth map
+		Objects are culled against the cascade's light frustum, for layered rendering they're drawn with one instance per cascade
+		from the first to the last cascade they are visible in, with the instance index selecting the cascade's layer
+	*/
+	void renderShadowCasters(VkCommandBuffer commandBuffer, uint32_t cascadeIndex, bool layered)
+	{
+		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipelineLayout, 0, 1, &cascades[cascadeIndex].descriptorSet, 0, nullptr);
+
+		std::vector<std::pair<vkglTF::Model*, glm::vec3>> objects = { { &models.terrain, glm::vec3(0.0f) } };
+		for (auto position : treePositions) {
+			objects.push_back({ &models.tree, position });
+		}
+
+		for (auto &object : objects) {
+			vkglTF::Model *model = object.first;
+			const uint32_t mask = getCascadeMask(model->dimensions.center + object.second, model->dimensions.radius);
+			uint32_t instanceCount = 1;
+			uint32_t firstInstance = 0;
+			if (layered) {
+				if (mask == 0) {
+					continue;
+				}
+				while (!(mask & (1 << firstInstance))) {
+					firstInstance++;
+				}
+				uint32_t lastInstance = SHADOW_MAP_CASCADE_COUNT - 1;
+				while (!(mask & (1 << lastInstance))) {
+					lastInstance--;
+				}
+				instanceCount = lastInstance - firstInstance + 1;
+			} else if (!(mask & (1 << cascadeIndex))) {
+				continue;
+			}
+			pushConstBlock.position = glm::vec4(object.second, 0.0f);
+			vkCmdPushConstants(commandBuffer, depthPass.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+			model->draw(commandBuffer, vkglTF::RenderFlags::BindImages, depthPass.pipelineLayout, 1, instanceCount, firstInstance);
+		}
+	}
+
 	/*
 		Setup resources used by the depth pass
 		The depth image is layered with each layer storing one shadow map cascade
@@ -266,7 +375,7 @@ public:
 		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassCreateInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
 
 		/*
 			Layered depth image and views
@@ -330,6 +439,18 @@ public:
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
 		}
 
+		// Layered framebuffer covering all cascades for single pass rendering
+		if (layeredRenderingSupported) {
+			VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
+			framebufferInfo.renderPass = depthPass.renderPass;
+			framebufferInfo.attachmentCount = 1;
+			framebufferInfo.pAttachments = &depth.view;
+			framebufferInfo.width = SHADOWMAP_DIM;
+			framebufferInfo.height = SHADOWMAP_DIM;
+			framebufferInfo.layers = SHADOW_MAP_CASCADE_COUNT;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &depthPass.layeredFrameBuffer));
+		}
+
 		// Shared sampler for cascade depth reads
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_LINEAR;
@@ -345,104 +466,123 @@ public:
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
 	}
-	void buildCommandBuffers()
+	// Called by the base class right before the current frame's command buffer is submitted
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		VkDeviceSize offsets[1] = { 0 };
-
-		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			/*
-				Generate depth map cascades
-
-				Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
-			*/
-			{
-				VkClearValue clearValues[1];
-				clearValues[0].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = depthPass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-				renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		/*
+			Generate depth map cascades
 
-				VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			Cascades whose matrix hasn't changed since their layer was last rendered are skipped (if caching is enabled)
+			The shadow casters of this example are static, so the layer's content would be the same
+		*/
+		{
+			std::array<bool, SHADOW_MAP_CASCADE_COUNT> renderCascade;
+			renderedCascadeCount = 0;
+			for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+				renderCascade[j] = !cacheCascades || !cascades[j].rendered || (cascades[j].renderedViewProjMatrix != cascades[j].viewProjMatrix);
+				if (renderCascade[j]) {
+					renderedCascadeCount++;
+				}
+			}
+			// The layered pass clears all layers, so if any of the cascades changed, all of them need to be rendered
+			if (layeredRendering && (renderedCascadeCount > 0)) {
+				renderCascade.fill(true);
+				renderedCascadeCount = SHADOW_MAP_CASCADE_COUNT;
+			}
+			for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+				if (renderCascade[j]) {
+					cascades[j].renderedViewProjMatrix = cascades[j].viewProjMatrix;
+					cascades[j].rendered = true;
+				}
+			}
 
+			VkClearValue clearValues[1];
+			clearValues[0].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = depthPass.renderPass;
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
+			renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			gpuProfiler.beginScope(commandBuffer, "Shadow cascades");
+			if (layeredRendering) {
+				// Single pass, the layer is selected by the vertex shader
+				if (renderedCascadeCount > 0) {
+					renderPassBeginInfo.framebuffer = depthPass.layeredFrameBuffer;
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.layeredPipeline);
+					renderShadowCasters(commandBuffer, 0, true);
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			} else {
 				// One pass per cascade
-				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
+				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's framebuffer)
 				for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+					if (!renderCascade[j]) {
+						continue;
+					}
 					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
-					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j);
-					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+					renderShadowCasters(commandBuffer, j, false);
+					vkCmdEndRenderPass(commandBuffer);
 				}
 			}
+			gpuProfiler.endScope(commandBuffer);
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
-
-			/*
-				Scene rendering using depth cascades for shadow mapping
-			*/
-
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Visualize shadow map cascade
-				if (displayDepthMap) {
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
-					PushConstBlock pushConstBlock = {};
-					pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-				}
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-				// Render shadowed scene
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
-				renderScene(drawCmdBuffers[i], pipelineLayout, descriptorSet);
+		/*
+			Scene rendering using depth cascades for shadow mapping
+		*/
 
-				drawUI(drawCmdBuffers[i]);
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			// Renders at a reduced resolution that's upscaled afterwards if dynamic resolution is enabled
+			gpuProfiler.beginScope(commandBuffer, "Scene");
+			beginSceneRenderPass(commandBuffer, imageIndex, clearValues, 2);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			// Visualize shadow map cascade
+			if (displayDepthMap) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
+				PushConstBlock pushConstBlock = {};
+				pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			// Render shadowed scene
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+			renderScene(commandBuffer, pipelineLayout, descriptorSet);
+
+			endSceneRenderPass(commandBuffer, imageIndex);
+			gpuProfiler.endScope(commandBuffer);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
@@ -477,7 +617,7 @@ public:
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.base));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.base));
 
 		/*
 			Descriptor sets
@@ -523,7 +663,7 @@ public:
 			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 			pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 		}
 
 		// Depth pass pipeline layout
@@ -533,7 +673,7 @@ public:
 			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
 			pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 			pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &depthPass.pipelineLayout));
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &depthPass.pipelineLayout));
 		}
 	}
 
@@ -568,7 +708,7 @@ public:
 		// Empty vertex input state
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.debugShadowMap));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.debugShadowMap));
 
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal });
 		/*
@@ -582,9 +722,9 @@ public:
 		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
 		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &enablePCF);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadow));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadow));
 		enablePCF = 1;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadowPCF));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneShadowPCF));
 
 		/*
 			Depth map generation
@@ -598,7 +738,13 @@ public:
 		rasterizationState.depthClampEnable = deviceFeatures.depthClamp;
 		pipelineCI.layout = depthPass.pipelineLayout;
 		pipelineCI.renderPass = depthPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &depthPass.pipeline));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &depthPass.pipeline));
+
+		// Single pass variant writing the cascade's layer from the vertex shader
+		if (layeredRenderingSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingcascade/depthpasslayered.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &depthPass.layeredPipeline));
+		}
 	}
 
 	void prepareUniformBuffers()
@@ -706,12 +852,22 @@ public:
 			glm::vec3 minExtents = -maxExtents;
 
 			glm::vec3 lightDir = normalize(-lightPos);
+
+			// Snap the center to whole shadow map texels in light space
+			// The bounding sphere's radius doesn't change with the camera's orientation, so the cascade only moves in texel increments
+			// This removes shimmering and keeps the matrix unchanged while the camera moves within a texel
+			const float texelSize = 2.0f * radius / static_cast<float>(SHADOWMAP_DIM);
+			glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::vec3 lightSpaceCenter = glm::vec3(lightRotation * glm::vec4(frustumCenter, 1.0f));
+			lightSpaceCenter = glm::floor(lightSpaceCenter / texelSize) * texelSize;
+			frustumCenter = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightSpaceCenter, 1.0f));
 			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
 
 			// Store split distance and matrix in cascade
 			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
 			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			cascades[i].frustum.update(cascades[i].viewProjMatrix);
 
 			lastSplitDist = cascadeSplits[i];
 		}
@@ -726,6 +882,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		/*
 			Depth rendering
 		*/
@@ -755,15 +912,6 @@ public:
 		memcpy(uniformBuffers.FS.mapped, &uboFS, sizeof(uboFS));
 	}
 
-	void draw()
-	{
-		VulkanExampleBase::prepareFrame();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VulkanExampleBase::submitFrame();
-	}
-
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -774,7 +922,6 @@ public:
 		prepareUniformBuffers();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -782,12 +929,13 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		// Cascades are updated before the frame is recorded, as they decide which cascades need to be rendered
 		if (!paused || camera.updated) {
 			updateLight();
 			updateCascades();
 			updateUniformBuffers();
 		}
+		renderFrame();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -800,17 +948,16 @@ public:
 			if (overlay->checkBox("Color cascades", &colorCascades)) {
 				updateUniformBuffers();
 			}
-			if (overlay->checkBox("Display depth map", &displayDepthMap)) {
-				buildCommandBuffers();
-			}
+			overlay->checkBox("Display depth map", &displayDepthMap);
 			if (displayDepthMap) {
-				if (overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, SHADOW_MAP_CASCADE_COUNT - 1)) {
-					buildCommandBuffers();
-				}
+				overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, SHADOW_MAP_CASCADE_COUNT - 1);
 			}
-			if (overlay->checkBox("PCF filtering", &filterPCF)) {
-				buildCommandBuffers();
+			overlay->checkBox("PCF filtering", &filterPCF);
+			overlay->checkBox("Cache cascades", &cacheCascades);
+			if (layeredRenderingSupported) {
+				overlay->checkBox("Single pass cascades", &layeredRendering);
 			}
+			overlay->text("Cascades rendered: %d", renderedCascadeCount);
 		}
 	}
 };
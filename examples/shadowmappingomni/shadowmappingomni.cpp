@@ -6,6 +6,15 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+/*
+* The cube map faces store the distance to the light and only depend on the light's position, as all geometry of the scene is static.
+* Each face remembers the light position it was last rendered with and is skipped as long as that doesn't change (e.g. while paused),
+* so the cube map acts as a cache that's only updated when the light moves.
+*
+* If VK_EXT_shader_viewport_index_layer is supported, all faces are rendered in a single pass directly into the cube map, with the vertex
+* shader selecting the face's layer per instance, instead of one render pass and copy per face.
+*/
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
@@ -23,6 +32,13 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayCubeMap = false;
+	// Keep the faces that haven't changed since they were rendered
+	bool cacheFaces = true;
+	// Render all faces in a single pass into the layered cube map (requires VK_EXT_shader_viewport_index_layer)
+	bool layeredRendering = true;
+	bool layeredRenderingSupported = false;
+	// Number of cube map faces rendered with the last recorded frame
+	uint32_t renderedFaceCount = 0;
 
 	float zNear = 0.1f;
 	float zFar = 1024.0f;
@@ -51,12 +67,25 @@ public:
 		glm::vec4 lightPos;
 	};
 
-	UBO uboVSscene, uboOffscreenVS;
+	UBO uboVSscene;
+
+	// The offscreen uniform block extends the shared one with the view matrices of all faces for single pass rendering
+	struct UBOOffscreen : UBO {
+		glm::mat4 faceViews[6];
+	} uboOffscreenVS;
+
+	// Light position each cube map face was last rendered with, the face can be reused as long as this doesn't change
+	struct CubeFace {
+		glm::vec4 renderedLightPos;
+		bool rendered = false;
+	};
+	std::array<CubeFace, 6> cubeFaces;
 
 	struct {
 		VkPipeline scene;
 		VkPipeline offscreen;
 		VkPipeline cubemapDisplay;
+		VkPipeline offscreenLayered = VK_NULL_HANDLE;
 	} pipelines;
 
 	struct {
@@ -72,6 +101,8 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	vks::Texture shadowCubeMap;
+	// Array view of all cube map faces used as the attachment for single pass rendering
+	VkImageView shadowCubeMapLayeredView = VK_NULL_HANDLE;
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
@@ -86,6 +117,10 @@ public:
 		VkRenderPass renderPass;
 		VkSampler sampler;
 		VkDescriptorImageInfo descriptor;
+		// Single pass rendering of all faces into the cube map with a layered depth attachment
+		VkRenderPass layeredRenderPass = VK_NULL_HANDLE;
+		VkFramebuffer layeredFrameBuffer = VK_NULL_HANDLE;
+		FrameBufferAttachment layeredDepth;
 	} offscreenPass;
 
 	VkFormat fbDepthFormat;
@@ -99,6 +134,8 @@ public:
 		camera.setRotation(glm::vec3(-20.5f, -673.0f, 0.0f));
 		camera.setPosition(glm::vec3(0.0f, 0.5f, -15.0f));
 		timerSpeed *= 0.5f;
+		// The command buffer is recorded each frame (see recordCommandBuffer), as the cube map faces to render change with the light
+		dynamicCommandBuffers = true;
 	}
 
 	~VulkanExample()
@@ -128,6 +165,17 @@ public:
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
+		// Single pass cube map rendering
+		if (layeredRenderingSupported) {
+			vkDestroyImageView(device, shadowCubeMapLayeredView, nullptr);
+			vkDestroyImageView(device, offscreenPass.layeredDepth.view, nullptr);
+			vkDestroyImage(device, offscreenPass.layeredDepth.image, nullptr);
+			vkFreeMemory(device, offscreenPass.layeredDepth.mem, nullptr);
+			vkDestroyFramebuffer(device, offscreenPass.layeredFrameBuffer, nullptr);
+			vkDestroyRenderPass(device, offscreenPass.layeredRenderPass, nullptr);
+			vkDestroyPipeline(device, pipelines.offscreenLayered, nullptr);
+		}
+
 		// Pipelines
 		vkDestroyPipeline(device, pipelines.scene, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
@@ -143,6 +191,23 @@ public:
 		uniformBuffers.scene.destroy();
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Writing the layer from the vertex shader allows rendering all cube map faces in a single pass
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			if (strcmp(extension.extensionName, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME) == 0) {
+				enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+				layeredRenderingSupported = true;
+				break;
+			}
+		}
+		layeredRendering = layeredRenderingSupported;
+	}
+
 	void prepareCubeMap()
 	{
 		shadowCubeMap.width = TEX_DIM;
@@ -161,6 +226,10 @@ public:
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// For single pass rendering the faces are rendered to directly
+		if (layeredRenderingSupported) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		}
 		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
@@ -221,6 +290,12 @@ public:
 		view.subresourceRange.layerCount = 6;
 		view.image = shadowCubeMap.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMap.view));
+
+		if (layeredRenderingSupported) {
+			view.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			view.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+			VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMapLayeredView));
+		}
 	}
 
 	// Prepare a new framebuffer for offscreen rendering
@@ -330,28 +405,34 @@ public:
 		fbufCreateInfo.layers = 1;
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffer));
+
+		// Layered framebuffer covering all cube map faces for single pass rendering
+		if (layeredRenderingSupported) {
+			imageCreateInfo.arrayLayers = 6;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreenPass.layeredDepth.image));
+			vkGetImageMemoryRequirements(device, offscreenPass.layeredDepth.image, &memReqs);
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.layeredDepth.mem));
+			VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.layeredDepth.image, offscreenPass.layeredDepth.mem, 0));
+
+			depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			depthStencilView.subresourceRange.layerCount = 6;
+			depthStencilView.image = offscreenPass.layeredDepth.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.layeredDepth.view));
+
+			attachments[0] = shadowCubeMapLayeredView;
+			attachments[1] = offscreenPass.layeredDepth.view;
+			fbufCreateInfo.renderPass = offscreenPass.layeredRenderPass;
+			fbufCreateInfo.layers = 6;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.layeredFrameBuffer));
+		}
 	}
 
-	// Updates a single cube map face
-	// Renders the scene with face's view and does a copy from framebuffer to cube face
-	// Uses push constants for quick update of view matrix for the current cube map face
-	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	// View matrix for rendering the given cube map face from the light's position
+	glm::mat4 getCubeFaceViewMatrix(uint32_t faceIndex)
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
-		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		// Update view matrix via push constant
-
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
 		switch (faceIndex)
 		{
@@ -376,6 +457,29 @@ public:
 			viewMatrix = glm::rotate(viewMatrix, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 			break;
 		}
+		return viewMatrix;
+	}
+
+	// Updates a single cube map face
+	// Renders the scene with face's view and does a copy from framebuffer to cube face
+	// Uses push constants for quick update of view matrix for the current cube map face
+	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		// Reuse render pass from example pass
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		// Update view matrix via push constant
+		glm::mat4 viewMatrix = uboOffscreenVS.faceViews[faceIndex];
 
 		// Render scene from cube face's point of view
 		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -392,6 +496,8 @@ public:
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
+		// The shadow pass only needs vertex positions
+		models.scene.bindPositionBuffers(commandBuffer);
 		models.scene.draw(commandBuffer);
 
 		vkCmdEndRenderPass(commandBuffer);
@@ -464,88 +570,142 @@ public:
 			cubeFaceSubresourceRange);
 	}
 
-	void buildCommandBuffers()
+	// Called by the base class right before the current frame's command buffer is submitted
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			/*
-				Generate shadow cube maps using one render pass per face
-			*/
-			{
-				VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		/*
+			Generate shadow cube map faces
 
-				VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			Faces that have been rendered with the current light position are skipped (if caching is enabled)
+		*/
+		{
+			std::array<bool, 6> renderFace;
+			renderedFaceCount = 0;
+			for (uint32_t face = 0; face < 6; face++) {
+				renderFace[face] = !cacheFaces || !cubeFaces[face].rendered || (cubeFaces[face].renderedLightPos != lightPos);
+				if (renderFace[face]) {
+					renderedFaceCount++;
+				}
+			}
+			// The layered pass clears all faces, so if any of the faces changed, all of them need to be rendered
+			if (layeredRendering && (renderedFaceCount > 0)) {
+				renderFace.fill(true);
+				renderedFaceCount = 6;
+			}
+			for (uint32_t face = 0; face < 6; face++) {
+				if (renderFace[face]) {
+					cubeFaces[face].renderedLightPos = lightPos;
+					cubeFaces[face].rendered = true;
+				}
+			}
 
+			VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			gpuProfiler.beginScope(commandBuffer, "Shadow cube map");
+			if (layeredRendering) {
+				// Single pass directly into the cube map, the face is selected by the vertex shader
+				// The render pass transitions the cube map back to shader read, see prepareOffscreenRenderpass
+				if (renderedFaceCount > 0) {
+					VkClearValue clearValues[2];
+					clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+					clearValues[1].depthStencil = { 1.0f, 0 };
+
+					VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+					renderPassBeginInfo.renderPass = offscreenPass.layeredRenderPass;
+					renderPassBeginInfo.framebuffer = offscreenPass.layeredFrameBuffer;
+					renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+					renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+					renderPassBeginInfo.clearValueCount = 2;
+					renderPassBeginInfo.pClearValues = clearValues;
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenLayered);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
+					models.scene.bindPositionBuffers(commandBuffer);
+					// One instance per cube map face
+					models.scene.draw(commandBuffer, 0, VK_NULL_HANDLE, 1, 6, 0);
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			} else {
+				// One render pass and copy per face
 				for (uint32_t face = 0; face < 6; face++) {
-					updateCubeFace(face, drawCmdBuffers[i]);
+					if (renderFace[face]) {
+						updateCubeFace(face, commandBuffer);
+					}
 				}
 			}
+			gpuProfiler.endScope(commandBuffer);
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
-
-			/*
-				Scene rendering with applied shadow map
-			*/
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		/*
+			Scene rendering with applied shadow map
+		*/
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = defaultClearColor;
+			clearValues[1].depthStencil = { 1.0f, 0 };
 
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
 
-				VkDeviceSize offsets[1] = { 0 };
+			gpuProfiler.beginScope(commandBuffer, "Scene");
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-				if (displayCubeMap)
-				{
-					// Display all six sides of the shadow cube map
-					// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
-					models.debugcube.draw(drawCmdBuffers[i]);
-				}
-				else
-				{
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
-					models.scene.draw(drawCmdBuffers[i]);
-				}
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-				drawUI(drawCmdBuffers[i]);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			if (displayCubeMap)
+			{
+				// Display all six sides of the shadow cube map
+				// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
+				models.debugcube.draw(commandBuffer);
 			}
+			else
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+				models.scene.bindBuffers(commandBuffer);
+				models.scene.draw(commandBuffer);
+			}
+
+			drawUI(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.endScope(commandBuffer);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 		models.debugcube.loadFromFile(getAssetPath() + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
-		models.scene.loadFromFile(getAssetPath() + "models/shadowscene_fire.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		models.scene.loadFromFile(getAssetPath() + "models/shadowscene_fire.gltf", vulkanDevice, queue, glTFLoadingFlags | vkglTF::FileLoadingFlags::PositionStream);
 	}
 
 	void setupDescriptorPool()
@@ -570,11 +730,11 @@ public:
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// 3D scene pipeline layout
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
 
 		// Offscreen pipeline layout
 		// Push constants for cube map face view matrices
@@ -582,7 +742,7 @@ public:
 		// Push constant ranges are part of the pipeline layout
 		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.offscreen));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayouts.offscreen));
 	}
 
 	void setupDescriptorSets()
@@ -666,7 +826,41 @@ public:
 		renderPassCreateInfo.subpassCount = 1;
 		renderPassCreateInfo.pSubpasses = &subpass;
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.renderPass));
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.renderPass));
+
+		// Render pass for single pass rendering directly into the cube map
+		// All faces are cleared, so the previous contents don't need to be preserved and the cube map ends up ready for sampling
+		if (layeredRenderingSupported) {
+			osAttachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			osAttachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			osAttachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			osAttachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+			std::array<VkSubpassDependency, 2> dependencies;
+
+			// Previous frame's scene pass reading the cube map
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = 0;
+
+			// Cube map written before it's sampled by the scene pass
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
+
+			renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderPassCreateInfo.pDependencies = dependencies.data();
+
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCreateInfo, nullptr, &offscreenPass.layeredRenderPass));
+		}
 	}
 
 	void preparePipelines()
@@ -699,14 +893,23 @@ public:
 		pipelineCI.stageCount = shaderStages.size();
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
 
 		// Offscreen pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/offscreen.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		pipelineCI.layout = pipelineLayouts.offscreen;
 		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+		// Only positions are fetched from a separate, tightly packed vertex buffer
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPositionVertexInputState();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		// Single pass pipeline, the vertex shader selects the cube map face per instance
+		if (layeredRenderingSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreenlayered.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.renderPass = offscreenPass.layeredRenderPass;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenLayered));
+		}
 
 		// Cube map display pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -716,7 +919,7 @@ public:
 		pipelineCI.layout = pipelineLayouts.scene;
 		pipelineCI.renderPass = renderPass;
 		rasterizationState.cullMode = VK_CULL_MODE_NONE;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.cubemapDisplay));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.cubemapDisplay));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -740,12 +943,18 @@ public:
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
 
+		// The face view matrices are static, the light position is applied via the model matrix
+		for (uint32_t face = 0; face < 6; face++) {
+			uboOffscreenVS.faceViews[face] = getCubeFaceViewMatrix(face);
+		}
+
 		updateUniformBufferOffscreen();
 		updateUniformBuffers();
 	}
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVSscene.projection = camera.matrices.perspective;
 		uboVSscene.view = camera.matrices.view;
 		uboVSscene.model = glm::mat4(1.0f);
@@ -755,6 +964,7 @@ public:
 
 	void updateUniformBufferOffscreen()
 	{
+		waitForFramesInFlight();
 		lightPos.x = sin(glm::radians(timer * 360.0f)) * 0.15f;
 		lightPos.z = cos(glm::radians(timer * 360.0f)) * 0.15f;
 		uboOffscreenVS.projection = glm::perspective((float)(M_PI / 2.0), 1.0f, zNear, zFar);
@@ -764,15 +974,6 @@ public:
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
-	void draw()
-	{
-		VulkanExampleBase::prepareFrame();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VulkanExampleBase::submitFrame();
-	}
-
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -785,7 +986,6 @@ public:
 		setupDescriptorPool();
 		setupDescriptorSets();
 		prepareOffscreenFramebuffer();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -793,20 +993,24 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		// The light is updated before the frame is recorded, as it decides which cube map faces need to be rendered
 		if (!paused || camera.updated)
 		{
 			updateUniformBufferOffscreen();
 			updateUniformBuffers();
 		}
+		renderFrame();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->checkBox("Display shadow cube render target", &displayCubeMap)) {
-				buildCommandBuffers();
+			overlay->checkBox("Display shadow cube render target", &displayCubeMap);
+			overlay->checkBox("Cache faces", &cacheFaces);
+			if (layeredRenderingSupported) {
+				overlay->checkBox("Single pass cube map", &layeredRendering);
 			}
+			overlay->text("Faces rendered: %d", renderedFaceCount);
 		}
 	}
 };
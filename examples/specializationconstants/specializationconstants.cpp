@@ -3,6 +3,8 @@
 *
 * For details see https://www.khronos.org/registry/vulkan/specs/misc/GL_KHR_vulkan_glsl.txt
 *
+* Optional shader features are toggled at runtime, with feature permutations of the pipelines compiled lazily in the background (see vks::PipelinePermutations)
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -31,11 +33,19 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	struct {
-		VkPipeline phong;
-		VkPipeline toon;
-		VkPipeline textured;
-	} pipelines;
+	// Optional features of the uber shader, toggled at runtime
+	enum Features : uint32_t {
+		FeatureSpecular = 1 << 0,
+		FeatureRimLight = 1 << 1,
+		FeatureCount = 2
+	};
+	bool specular = true;
+	bool rimLight = false;
+	// If disabled, the generic pipelines branching on the features at runtime are always used
+	bool specializedPipelines = true;
+
+	// One set of feature permutations per lighting model (0 = Phong, 1 = Toon, 2 = Textured)
+	std::array<vks::PipelinePermutations, 3> pipelines;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -49,9 +59,9 @@ public:
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipelines.phong, nullptr);
-		vkDestroyPipeline(device, pipelines.textured, nullptr);
-		vkDestroyPipeline(device, pipelines.toon, nullptr);
+		for (auto& permutations : pipelines) {
+			permutations.destroy();
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -60,6 +70,17 @@ public:
 		uniformBuffer.destroy();
 	}
 
+	uint32_t getFeatures()
+	{
+		return (specular ? FeatureSpecular : 0) | (rimLight ? FeatureRimLight : 0);
+	}
+
+	// The specialized pipeline for the current features if it's been compiled, the generic one otherwise
+	VkPipeline getPipeline(uint32_t lightingModel)
+	{
+		return specializedPipelines ? pipelines[lightingModel].get(getFeatures()) : pipelines[lightingModel].generic();
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -90,25 +111,28 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			// Only read by the generic pipelines
+			const uint32_t features = getFeatures();
+			vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &features);
 
 			VkDeviceSize offsets[1] = { 0 };
 
 			// Left
 			VkViewport viewport = vks::initializers::viewport((float) width / 3.0f, (float) height, 0.0f, 1.0f);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(0));
 			scene.draw(drawCmdBuffers[i]);
 			
 			// Center
 			viewport.x = (float)width / 3.0f;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.toon);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(1));
 			scene.draw(drawCmdBuffers[i]);
 
 			// Right
 			viewport.x = (float)width / 3.0f + (float)width / 3.0f;
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.textured);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(2));
 			scene.draw(drawCmdBuffers[i]);
 
 			drawUI(drawCmdBuffers[i]);
@@ -154,14 +178,18 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
+		// Feature bits for the generic pipelines
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -193,7 +221,6 @@ public:
 		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
@@ -203,8 +230,6 @@ public:
 		pipelineCI.pViewportState = &viewportState;
 		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
-		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color });
 
 		// Prepare specialization data
@@ -215,49 +240,51 @@ public:
 			uint32_t lightingModel;
 			// Parameter for the toon shading part of the fragment shader
 			float toonDesaturationFactor = 0.5f;
-		} specializationData;
+		};
 
 		// Each shader constant of a shader stage corresponds to one map entry
 		std::array<VkSpecializationMapEntry, 2> specializationMapEntries;
 		// Shader bindings based on specialization constants are marked by the new "constant_id" layout qualifier:
 		//	layout (constant_id = 0) const int LIGHTING_MODEL = 0;
 		//	layout (constant_id = 1) const float PARAM_TOON_DESATURATION = 0.0f;
+		// Constants 2 to 4 select the optional features and are set by the pipeline permutations
 
 		// Map entry for the lighting model to be used by the fragment shader
 		specializationMapEntries[0].constantID = 0;
-		specializationMapEntries[0].size = sizeof(specializationData.lightingModel);
+		specializationMapEntries[0].size = sizeof(SpecializationData::lightingModel);
 		specializationMapEntries[0].offset = 0;
 
 		// Map entry for the toon shader parameter
 		specializationMapEntries[1].constantID = 1;
-		specializationMapEntries[1].size = sizeof(specializationData.toonDesaturationFactor);
+		specializationMapEntries[1].size = sizeof(SpecializationData::toonDesaturationFactor);
 		specializationMapEntries[1].offset = offsetof(SpecializationData, toonDesaturationFactor);
 
-		// Prepare specialization info block for the shader stage
-		VkSpecializationInfo specializationInfo{};
-		specializationInfo.dataSize = sizeof(specializationData);
-		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size());
-		specializationInfo.pMapEntries = specializationMapEntries.data();
-		specializationInfo.pData = &specializationData;
-
 		// Create pipelines
 		// All pipelines will use the same "uber" shader and specialization constants to change branching and parameters of that shader
-		shaderStages[0] = loadShader(getShadersPath() + "specializationconstants/uber.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "specializationconstants/uber.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		// Specialization info is assigned is part of the shader stage (modul) and must be set after creating the module and before creating the pipeline
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
-
-		// Solid phong shading
-		specializationData.lightingModel = 0;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
-
-		// Phong and textured
-		specializationData.lightingModel = 1;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
-
-		// Textured discard
-		specializationData.lightingModel = 2;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.textured));
+		const VkPipelineShaderStageCreateInfo vertexShader = loadShader(getShadersPath() + "specializationconstants/uber.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		const VkPipelineShaderStageCreateInfo fragmentShader = loadShader(getShadersPath() + "specializationconstants/uber.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		// Each lighting model gets a generic pipeline that branches on the features at runtime, the permutations specialized for
+		// the selected features are compiled on the worker threads of the pipeline compiler once they are requested
+		// 0 = Solid phong shading, 1 = Phong and textured, 2 = Textured discard
+		for (uint32_t i = 0; i < static_cast<uint32_t>(pipelines.size()); i++) {
+			SpecializationData specializationData;
+			specializationData.lightingModel = i;
+			// Prepare specialization info block for the shader stage
+			VkSpecializationInfo specializationInfo{};
+			specializationInfo.dataSize = sizeof(SpecializationData);
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size());
+			specializationInfo.pMapEntries = specializationMapEntries.data();
+			specializationInfo.pData = &specializationData;
+			std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = { vertexShader, fragmentShader };
+			// Specialization info is assigned is part of the shader stage (modul) and must be set after creating the module and before creating the pipeline
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+			pipelineCI.pStages = shaderStages.data();
+			// The permutations keep a copy of the pipeline state, including the lighting model constants
+			pipelines[i].setup(device, &pipelineCompiler, pipelineCache, 2, 3, FeatureCount);
+			pipelines[i].prepare(pipelineCI, VK_SHADER_STAGE_FRAGMENT_BIT);
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -278,6 +305,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		camera.setPerspective(60.0f, ((float)width / 3.0f) / (float)height, 0.1f, 512.0f);
 
 		uboVS.projection = camera.matrices.perspective;
@@ -315,6 +343,15 @@ public:
 		if (!prepared) {
 			return;
 		}
+		// Switch to specialized pipelines as soon as they have been compiled
+		bool pipelinesChanged = false;
+		for (auto& permutations : pipelines) {
+			pipelinesChanged |= permutations.update();
+		}
+		if (pipelinesChanged) {
+			waitForFramesInFlight();
+			buildCommandBuffers();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -325,6 +362,25 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Features")) {
+			overlay->checkBox("Specular", &specular);
+			overlay->checkBox("Rim light", &rimLight);
+		}
+		if (overlay->header("Pipelines")) {
+			overlay->checkBox("Specialized", &specializedPipelines);
+			uint32_t specialized = 0;
+			uint32_t pending = 0;
+			for (auto& permutations : pipelines) {
+				specialized += permutations.specializedCount();
+				pending += permutations.pendingCount();
+			}
+			overlay->text("%d compiled, %d compiling", specialized, pending);
+			overlay->text((specializedPipelines && pipelines[0].isSpecialized(getFeatures())) ? "Using specialized pipelines" : "Using generic pipelines");
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
@@ -1,6 +1,10 @@
 /*
 * Vulkan Example - Screen space ambient occlusion example
 *
+* The ambient occlusion can be computed at a reduced resolution and accumulated over several frames (with fewer kernel samples per frame),
+* the result is then blurred and upsampled to the G-Buffer resolution with a depth aware (bilateral) filter
+* If ray queries are supported, the occlusion can also be ray traced against the scene's acceleration structure instead (RTAO), which uses the same filters as denoiser
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,11 +12,23 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRayQueryShadows.h"
 
 #define ENABLE_VALIDATION false
 
 #define SSAO_KERNEL_SIZE 32
 #define SSAO_RADIUS 0.3f
+// Kernel samples evaluated per frame with temporal filtering, consecutive frames use different parts of the kernel
+#define SSAO_TEMPORAL_KERNEL_SIZE 8
+
+// Length of the ambient occlusion rays and rays traced per pixel, with temporal filtering the rays of several frames are accumulated
+#define RTAO_RADIUS 1.0f
+#define RTAO_RAYS 2
+#define RTAO_TEMPORAL_RAYS 1
+
+#define SSAO_FORMAT VK_FORMAT_R8_UNORM
+// Temporal filtering stores the linear depth next to the occlusion for rejecting the history of disoccluded pixels
+#define SSAO_HISTORY_FORMAT VK_FORMAT_R16G16_SFLOAT
 
 #if defined(__ANDROID__)
 #define SSAO_NOISE_DIM 8
@@ -29,6 +45,19 @@ public:
 
 	vkglTF::Model scene;
 
+	// Resolution of the SSAO passes relative to the G-Buffer, as a power of two divisor (full, half, quarter)
+	int32_t ssaoResolution = 1;
+	const std::vector<std::string> ssaoResolutionNames = { "Full", "Half", "Quarter" };
+	bool temporalFiltering = true;
+	// Compute shader SSAO with shared memory depth caching, requires the shaderStorageImageWriteWithoutFormat feature
+	bool computeSSAO = false;
+	bool computeSSAOSupported = false;
+	// Ray traced ambient occlusion with ray queries (instead of the screen space occlusion), requires ray query support
+	bool rayTracedAO = false;
+	vks::RayQueryShadows rayQueryScene;
+	uint32_t frameIndex = 0;
+	glm::mat4 prevViewProjection = glm::mat4(1.0f);
+
 	struct UBOSceneParams {
 		glm::mat4 projection;
 		glm::mat4 model;
@@ -39,38 +68,66 @@ public:
 
 	struct UBOSSAOParams {
 		glm::mat4 projection;
+		// Transforms view space positions of the current frame into the previous frame's clip space
+		glm::mat4 viewToPrevClip;
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Part of the kernel evaluated in the current frame
+		uint32_t kernelOffset = 0;
+		uint32_t kernelSamples = SSAO_KERNEL_SIZE;
+		// Weight of the reprojected history in the temporal filter, 0 disables accumulation
+		float historyWeight = 0.0f;
+		// Seeds the directions of the ambient occlusion rays and number of rays per pixel (ray traced occlusion only)
+		uint32_t frameIndex = 0;
+		uint32_t rayCount = RTAO_RAYS;
+		// Transforms the view space G-Buffer into the world space of the acceleration structure (ray traced occlusion only)
+		glm::mat4 invView;
 	} uboSSAOParams;
 
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
 		VkPipeline ssao;
+		VkPipeline ssaoCompute = VK_NULL_HANDLE;
+		VkPipeline rtao = VK_NULL_HANDLE;
+		VkPipeline ssaoTemporal;
 		VkPipeline ssaoBlur;
+		VkPipeline ssaoUpsample;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout gBuffer;
 		VkPipelineLayout ssao;
+		VkPipelineLayout ssaoCompute;
+		VkPipelineLayout rtao = VK_NULL_HANDLE;
+		VkPipelineLayout ssaoTemporal;
 		VkPipelineLayout ssaoBlur;
+		VkPipelineLayout ssaoUpsample;
 		VkPipelineLayout composition;
 	} pipelineLayouts;
 
 	struct {
-		const uint32_t count = 5;
+		const uint32_t count = 9;
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
 		VkDescriptorSet ssao;
+		VkDescriptorSet ssaoCompute;
+		VkDescriptorSet rtao;
+		VkDescriptorSet ssaoTemporal;
 		VkDescriptorSet ssaoBlur;
+		VkDescriptorSet ssaoUpsample;
 		VkDescriptorSet composition;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout gBuffer;
 		VkDescriptorSetLayout ssao;
+		VkDescriptorSetLayout ssaoCompute;
+		VkDescriptorSetLayout rtao = VK_NULL_HANDLE;
+		VkDescriptorSetLayout ssaoTemporal;
 		VkDescriptorSetLayout ssaoBlur;
+		VkDescriptorSetLayout ssaoUpsample;
 		VkDescriptorSetLayout composition;
 	} descriptorSetLayouts;
 
@@ -115,7 +172,9 @@ public:
 		} offscreen;
 		struct SSAO : public FrameBuffer {
 			FrameBufferAttachment color;
-		} ssao, ssaoBlur;
+		} ssao, ssaoTemporal, ssaoBlur;
+		// Accumulated occlusion and linear depth of the previous frame, copied from the temporal filter's result
+		FrameBufferAttachment ssaoHistory;
 	} frameBuffers;
 
 	// One sampler for the frame buffer color attachments
@@ -132,6 +191,13 @@ public:
 		camera.position = { 1.0f, 0.75f, 0.0f };
 		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, uboSceneParams.nearPlane, uboSceneParams.farPlane);
+		// Only used for the ray traced ambient occlusion
+		enableRayQueries = true;
+
+		CommandLineParser exampleArgs;
+		exampleArgs.add("raytracedao", { "-rtao", "--raytracedao" }, 0, "Ray trace the ambient occlusion with ray queries instead of computing it in screen space (if supported)");
+		exampleArgs.parse(args);
+		rayTracedAO = exampleArgs.isSet("raytracedao");
 	}
 
 	~VulkanExample()
@@ -143,27 +209,48 @@ public:
 		frameBuffers.offscreen.normal.destroy(device);
 		frameBuffers.offscreen.albedo.destroy(device);
 		frameBuffers.offscreen.depth.destroy(device);
-		frameBuffers.ssao.color.destroy(device);
 		frameBuffers.ssaoBlur.color.destroy(device);
+		destroySSAOFramebuffers();
 
 		// Framebuffers
 		frameBuffers.offscreen.destroy(device);
-		frameBuffers.ssao.destroy(device);
 		frameBuffers.ssaoBlur.destroy(device);
+		vkDestroyRenderPass(device, frameBuffers.ssao.renderPass, nullptr);
+		vkDestroyRenderPass(device, frameBuffers.ssaoTemporal.renderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
+		if (pipelines.ssaoCompute != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.ssaoCompute, nullptr);
+		}
+		if (pipelines.rtao != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.rtao, nullptr);
+		}
+		vkDestroyPipeline(device, pipelines.ssaoTemporal, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoUpsample, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoCompute, nullptr);
+		if (pipelineLayouts.rtao != VK_NULL_HANDLE) {
+			vkDestroyPipelineLayout(device, pipelineLayouts.rtao, nullptr);
+		}
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoTemporal, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoUpsample, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoCompute, nullptr);
+		if (descriptorSetLayouts.rtao != VK_NULL_HANDLE) {
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.rtao, nullptr);
+		}
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoTemporal, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoUpsample, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 
 		// Uniform buffers
@@ -172,17 +259,20 @@ public:
 		uniformBuffers.ssaoParams.destroy();
 
 		textures.ssaoNoise.destroy();
+		rayQueryScene.destroy();
 	}
 
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// Required for the compute shader SSAO
+		enabledFeatures.shaderStorageImageWriteWithoutFormat = deviceFeatures.shaderStorageImageWriteWithoutFormat;
 	}
 
 	// Create a frame buffer attachment
 	void createAttachment(
 		VkFormat format,
-		VkImageUsageFlagBits usage,
+		VkImageUsageFlags usage,
 		FrameBufferAttachment *attachment,
 		uint32_t width,
 		uint32_t height)
@@ -217,15 +307,8 @@ public:
 		image.tiling = VK_IMAGE_TILING_OPTIMAL;
 		image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
 		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+		VK_CHECK_RESULT(vulkanDevice->allocateRenderTargetMemory(attachment->image, &attachment->mem));
 
 		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
 		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -243,18 +326,14 @@ public:
 	void prepareOffscreenFramebuffers()
 	{
 		// Attachments
-#if defined(__ANDROID__)
-		const uint32_t ssaoWidth = width / 2;
-		const uint32_t ssaoHeight = height / 2;
-#else
-		const uint32_t ssaoWidth = width;
-		const uint32_t ssaoHeight = height;
-#endif
-
 		frameBuffers.offscreen.setSize(width, height);
-		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
 		frameBuffers.ssaoBlur.setSize(width, height);
 
+		// The compute shader SSAO writes the SSAO attachment as a storage image
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, SSAO_FORMAT, &formatProperties);
+		computeSSAOSupported = enabledFeatures.shaderStorageImageWriteWithoutFormat && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
@@ -266,11 +345,8 @@ public:
 		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);			// Albedo (color)
 		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);			// Depth
 
-		// SSAO
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);				// Color
-
-		// SSAO blur
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
+		// SSAO blur (the SSAO attachments depend on the SSAO resolution and are created in prepareSSAOFramebuffers)
+		createAttachment(SSAO_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);						// Color
 
 		// Render passes
 
@@ -337,7 +413,7 @@ public:
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.offscreen.renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.offscreen.renderPass));
 
 			std::array<VkImageView, 4> attachments;
 			attachments[0] = frameBuffers.offscreen.position.view;
@@ -358,7 +434,7 @@ public:
 		// SSAO
 		{
 			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssao.color.format;
+			attachmentDescription.format = SSAO_FORMAT;
 			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
 			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -400,22 +476,63 @@ public:
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssao.renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssao.renderPass));
+		}
 
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssao.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssao.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssao.width;
-			fbufCreateInfo.height = frameBuffers.ssao.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssao.frameBuffer));
+		// SSAO temporal filter
+		{
+			// The result is copied to the history after the pass, so it's fully overwritten and left in transfer layout
+			VkAttachmentDescription attachmentDescription{};
+			attachmentDescription.format = SSAO_HISTORY_FORMAT;
+			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.pColorAttachments = &colorReference;
+			subpass.colorAttachmentCount = 1;
+
+			std::array<VkSubpassDependency, 2> dependencies;
+
+			// The SSAO pass' result is read, the previous frame's history copy reads the attachment
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
+
+			VkRenderPassCreateInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.pAttachments = &attachmentDescription;
+			renderPassInfo.attachmentCount = 1;
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 2;
+			renderPassInfo.pDependencies = dependencies.data();
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoTemporal.renderPass));
 		}
 
 		// SSAO Blur
 		{
 			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssaoBlur.color.format;
+			attachmentDescription.format = SSAO_FORMAT;
 			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
 			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -457,7 +574,7 @@ public:
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoBlur.renderPass));
+			VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoBlur.renderPass));
 
 			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
 			fbufCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
@@ -483,13 +600,73 @@ public:
 		sampler.maxLod = 1.0f;
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
+
+		prepareSSAOFramebuffers();
+	}
+
+	// Attachments and frame buffers at the SSAO resolution, these are recreated if the resolution is changed
+	void prepareSSAOFramebuffers()
+	{
+		const uint32_t ssaoWidth = std::max(width >> ssaoResolution, 1u);
+		const uint32_t ssaoHeight = std::max(height >> ssaoResolution, 1u);
+		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
+		frameBuffers.ssaoTemporal.setSize(ssaoWidth, ssaoHeight);
+
+		const VkImageUsageFlags ssaoUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (computeSSAOSupported ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
+		createAttachment(SSAO_FORMAT, ssaoUsage, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);
+		createAttachment(SSAO_HISTORY_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &frameBuffers.ssaoTemporal.color, ssaoWidth, ssaoHeight);
+		createAttachment(SSAO_HISTORY_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &frameBuffers.ssaoHistory, ssaoWidth, ssaoHeight);
+
+		for (auto frameBuffer : { &frameBuffers.ssao, &frameBuffers.ssaoTemporal }) {
+			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+			fbufCreateInfo.renderPass = frameBuffer->renderPass;
+			fbufCreateInfo.pAttachments = &frameBuffer->color.view;
+			fbufCreateInfo.attachmentCount = 1;
+			fbufCreateInfo.width = frameBuffer->width;
+			fbufCreateInfo.height = frameBuffer->height;
+			fbufCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffer->frameBuffer));
+		}
+
+		// Start with an empty history, a linear depth of zero never matches a surface so it's rejected by the temporal filter
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		VkClearColorValue clearColor = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+		vkCmdClearColorImage(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+		vks::tools::setImageLayout(copyCmd, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+	}
+
+	void destroySSAOFramebuffers()
+	{
+		frameBuffers.ssao.color.destroy(device);
+		frameBuffers.ssaoTemporal.color.destroy(device);
+		frameBuffers.ssaoHistory.destroy(device);
+		vkDestroyFramebuffer(device, frameBuffers.ssao.frameBuffer, nullptr);
+		vkDestroyFramebuffer(device, frameBuffers.ssaoTemporal.frameBuffer, nullptr);
 	}
 
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+		if (rayQueriesSupported) {
+			// The scene's vertex and index buffers are also used as inputs for the acceleration structure builds
+			vkglTF::memoryPropertyFlags |= vks::RayQueryShadows::bufferUsageFlags;
+		}
 		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
+		if (rayQueriesSupported) {
+			// The vertices are pre-transformed and the G-Buffer's model matrix is the identity, so a single instance with an identity transform is used
+			rayQueryScene.create(vulkanDevice, queue, scene);
+		}
+		rayTracedAO = rayTracedAO && rayQueriesSupported;
+	}
+
+	// Reduced resolution and temporally filtered results are blurred and upsampled with the depth aware filter, full resolution results with the original blur
+	bool bilateralUpsample() const
+	{
+		return (ssaoResolution > 0) || temporalFiltering;
 	}
 
 	void buildCommandBuffers()
@@ -501,6 +678,7 @@ public:
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i]);
 
 			/*
 				Offscreen SSAO generation
@@ -525,6 +703,7 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "G-Buffer");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -539,42 +718,115 @@ public:
 				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
 				/*
-					Second pass: SSAO generation
+					Second pass: SSAO generation (at the SSAO resolution)
 				*/
 
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				gpuProfiler.beginScope(drawCmdBuffers[i], rayTracedAO ? "RTAO" : "SSAO");
+				if (computeSSAO && !rayTracedAO)
+				{
+					// The G-Buffer render pass only makes its attachments visible to fragment shaders
+					VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+					memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+					// The previous frame's passes may still be reading the SSAO image
+					VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssao.color.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.ssaoCompute, 0, 1, &descriptorSets.ssaoCompute, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.ssaoCompute);
+					vkCmdDispatch(drawCmdBuffers[i], (frameBuffers.ssao.width + 7) / 8, (frameBuffers.ssao.height + 7) / 8, 1);
+
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssao.color.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+				}
+				else
+				{
+					clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+					clearValues[1].depthStencil = { 1.0f, 0 };
+
+					renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
+					renderPassBeginInfo.clearValueCount = 2;
+					renderPassBeginInfo.pClearValues = clearValues.data();
+
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+					viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+					if (rayTracedAO) {
+						// Ray traced occlusion writes to the same target, so the temporal filter and blur passes are shared with SSAO
+						vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.rtao, 0, 1, &descriptorSets.rtao, 0, NULL);
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.rtao);
+					} else {
+						vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+					}
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+				}
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				/*
+					Optional: Temporal filter, blends the SSAO result with the reprojected history and copies the result to the history for the next frame
+				*/
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				if (temporalFiltering)
+				{
+					gpuProfiler.beginScope(drawCmdBuffers[i], "SSAO temporal filter");
+					renderPassBeginInfo.framebuffer = frameBuffers.ssaoTemporal.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoTemporal.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoTemporal.height;
+					renderPassBeginInfo.clearValueCount = 0;
+
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+					viewport = vks::initializers::viewport((float)frameBuffers.ssaoTemporal.width, (float)frameBuffers.ssaoTemporal.height, 0.0f, 1.0f);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					scissor = vks::initializers::rect2D(frameBuffers.ssaoTemporal.width, frameBuffers.ssaoTemporal.height, 0, 0);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoTemporal, 0, 1, &descriptorSets.ssaoTemporal, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoTemporal);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+					VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoHistory.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+					VkImageCopy copyRegion = {};
+					copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+					copyRegion.extent = { static_cast<uint32_t>(frameBuffers.ssaoTemporal.width), static_cast<uint32_t>(frameBuffers.ssaoTemporal.height), 1 };
+					vkCmdCopyImage(drawCmdBuffers[i], frameBuffers.ssaoTemporal.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameBuffers.ssaoHistory.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+					vks::tools::insertImageMemoryBarrier(drawCmdBuffers[i], frameBuffers.ssaoHistory.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+					gpuProfiler.endScope(drawCmdBuffers[i]);
+				}
 
 				/*
 					Third pass: SSAO blur
+					A reduced resolution or temporally filtered result is blurred and upsampled with a depth aware filter instead
 				*/
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "SSAO blur");
 				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
 				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
 				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
 				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
+				renderPassBeginInfo.clearValueCount = 2;
 
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -583,11 +835,17 @@ public:
 				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
+				if (bilateralUpsample()) {
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoUpsample, 0, 1, &descriptorSets.ssaoUpsample, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoUpsample);
+				} else {
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
+				}
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			/*
@@ -610,6 +868,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues.data();
 
+				gpuProfiler.beginScope(drawCmdBuffers[i], "Composition");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -627,6 +886,7 @@ public:
 				drawUI(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.endScope(drawCmdBuffers[i]);
 			}
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -637,8 +897,12 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 20),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
 		};
+		if (rayQueriesSupported) {
+			poolSizes.push_back(vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1));
+		}
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -658,12 +922,12 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Color
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.gBuffer));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.gBuffer));
 
 		const std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayouts.gBuffer, vkglTF::descriptorSetLayoutImage };
 		pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
 		pipelineLayoutCreateInfo.setLayoutCount = 2;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBuffer));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.gBuffer));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.gBuffer;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.floor));
 		writeDescriptorSets = {
@@ -681,9 +945,9 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),								// FS Params UBO
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssao));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssao));
 		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssao;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssao));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssao));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssao;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssao));
 		imageDescriptors = {
@@ -699,23 +963,81 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// SSAO Generation (compute shader), same inputs as the fragment shader plus the SSAO image as the output
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),						// CS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),						// CS Normals
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),						// CS SSAO Noise
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),								// CS SSAO Kernel UBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),								// CS Params UBO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 5),								// CS SSAO output
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoCompute));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoCompute;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoCompute));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoCompute;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoCompute));
+
+		// Ray traced ambient occlusion, traces against the scene's top level acceleration structure instead of using the noise and kernel
+		if (rayQueriesSupported) {
+			setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),					// FS Position+Depth
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),					// FS Normals
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_FRAGMENT_BIT, 2),				// FS Top level acceleration structure
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),							// FS Params UBO
+			};
+			setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.rtao));
+			pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.rtao;
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.rtao));
+			descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.rtao;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.rtao));
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets.rtao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),				// FS Position+Depth
+				vks::initializers::writeDescriptorSet(descriptorSets.rtao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),				// FS Normals
+				rayQueryScene.writeDescriptorSet(descriptorSets.rtao, 2),																					// FS Top level acceleration structure
+				vks::initializers::writeDescriptorSet(descriptorSets.rtao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoParams.descriptor),	// FS Params UBO
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
+
+		// SSAO temporal filter
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS SSAO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS SSAO history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Params UBO
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoTemporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoTemporal));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoTemporal));
+
 		// SSAO Blur
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Sampler SSAO
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoBlur));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoBlur));
 		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoBlur));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoBlur));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoBlur));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+
+		// SSAO depth aware blur and upsample
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS SSAO (or its temporally filtered history)
 		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoUpsample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoUpsample));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoUpsample));
 
 		// Composition
 		setLayoutBindings = {
@@ -727,11 +1049,75 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),								// FS Lights UBO
 		};
 		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.composition));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.composition));
 		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.composition;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.composition;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.composition));
+
+		updateSSAODescriptorSets();
+	}
+
+	// Descriptors referencing the attachments at the SSAO resolution
+	void updateSSAODescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		std::vector<VkDescriptorImageInfo> imageDescriptors;
+
+		// SSAO Generation (compute shader)
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_GENERAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),				// CS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),				// CS Normals
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),	// CS SSAO Noise
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// CS SSAO Kernel UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// CS SSAO Params UBO
+		};
+		// The storage image binding is only valid if the SSAO image has been created with storage usage
+		if (computeSSAOSupported) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets.ssaoCompute, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5, &imageDescriptors[2]));	// CS SSAO output
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO temporal filter
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoHistory.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS SSAO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),			// FS SSAO history
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO Blur
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO depth aware blur and upsample, reads the history (which holds the temporal filter's result) if temporal filtering is enabled
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, temporalFiltering ? frameBuffers.ssaoHistory.view : frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Composition
 		imageDescriptors = {
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
@@ -782,7 +1168,7 @@ public:
 		// Final composition pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "ssao/fullscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "ssao/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.composition));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.composition));
 
 		// SSAO generation pipeline
 		{
@@ -800,7 +1186,37 @@ public:
 			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(2, specializationMapEntries.data(), sizeof(specializationData), &specializationData);
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			shaderStages[1].pSpecializationInfo = &specializationInfo;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
+
+			// Compute shader variant, caches the depth of a tile and its surroundings in shared memory
+			if (computeSSAOSupported) {
+				VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayouts.ssaoCompute, 0);
+				computePipelineCreateInfo.stage = loadShader(getShadersPath() + "ssao/ssao.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+				computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+				VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipelines.ssaoCompute));
+			}
+		}
+
+		// Ray traced ambient occlusion pipeline, renders to the SSAO target
+		if (rayQueriesSupported) {
+			pipelineCreateInfo.renderPass = frameBuffers.ssao.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.rtao;
+			// The occluder distance is constant for this pipeline
+			const float radius = RTAO_RADIUS;
+			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(float));
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(float), &radius);
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/rtao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.rtao));
+			shaderStages[1].pSpecializationInfo = nullptr;
+		}
+
+		// SSAO temporal filter pipeline
+		{
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoTemporal;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoTemporal));
 		}
 
 		// SSAO blur pipeline
@@ -808,7 +1224,12 @@ public:
 			pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
 			pipelineCreateInfo.layout = pipelineLayouts.ssaoBlur;
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/blur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
+
+			// Depth aware blur that also upsamples the reduced resolution SSAO
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoUpsample;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/upsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoUpsample));
 		}
 
 		// Fill G-Buffer pipeline
@@ -830,7 +1251,7 @@ public:
 			rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 			shaderStages[0] = loadShader(getShadersPath() + "ssao/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
 		}
 	}
 
@@ -896,6 +1317,7 @@ public:
 
 	void updateUniformBufferMatrices()
 	{
+		waitForFramesInFlight();
 		uboSceneParams.projection = camera.matrices.perspective;
 		uboSceneParams.view = camera.matrices.view;
 		uboSceneParams.model = glm::mat4(1.0f);
@@ -907,6 +1329,7 @@ public:
 
 	void updateUniformBufferSSAOParams()
 	{
+		waitForFramesInFlight();
 		uboSSAOParams.projection = camera.matrices.perspective;
 
 		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
@@ -914,6 +1337,30 @@ public:
 		uniformBuffers.ssaoParams.unmap();
 	}
 
+	// Distributes the SSAO kernel over several frames if temporal filtering is enabled and passes the reprojection to the previous frame
+	void updateTemporalParams()
+	{
+		if (temporalFiltering) {
+			const uint32_t kernelSlices = SSAO_KERNEL_SIZE / SSAO_TEMPORAL_KERNEL_SIZE;
+			uboSSAOParams.kernelOffset = (frameIndex % kernelSlices) * SSAO_TEMPORAL_KERNEL_SIZE;
+			uboSSAOParams.kernelSamples = SSAO_TEMPORAL_KERNEL_SIZE;
+			uboSSAOParams.historyWeight = 1.0f - 1.0f / static_cast<float>(kernelSlices);
+		} else {
+			uboSSAOParams.kernelOffset = 0;
+			uboSSAOParams.kernelSamples = SSAO_KERNEL_SIZE;
+			uboSSAOParams.historyWeight = 0.0f;
+		}
+		// Ray traced occlusion only traces a single ray per pixel if the results of several frames are accumulated
+		uboSSAOParams.frameIndex = frameIndex;
+		uboSSAOParams.rayCount = temporalFiltering ? RTAO_TEMPORAL_RAYS : RTAO_RAYS;
+		uboSSAOParams.invView = glm::inverse(camera.matrices.view);
+		// The G-Buffer stores view space positions, so the reprojection goes from the current view space to the previous frame's clip space
+		uboSSAOParams.viewToPrevClip = prevViewProjection * glm::inverse(camera.matrices.view);
+		prevViewProjection = camera.matrices.perspective * camera.matrices.view;
+		frameIndex++;
+		updateUniformBufferSSAOParams();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -944,8 +1391,8 @@ public:
 		draw();
 		if (camera.updated) {
 			updateUniformBufferMatrices();
-			updateUniformBufferSSAOParams();
 		}
+		updateTemporalParams();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -960,7 +1407,39 @@ public:
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
 			}
+			if (overlay->comboBox("SSAO resolution", &ssaoResolution, ssaoResolutionNames)) {
+				vkDeviceWaitIdle(device);
+				destroySSAOFramebuffers();
+				prepareSSAOFramebuffers();
+				updateSSAODescriptorSets();
+				buildCommandBuffers();
+			}
+			if (overlay->checkBox("Temporal filtering", &temporalFiltering)) {
+				vkDeviceWaitIdle(device);
+				updateSSAODescriptorSets();
+				buildCommandBuffers();
+			}
+			if (computeSSAOSupported && overlay->checkBox("Compute shader", &computeSSAO)) {
+				buildCommandBuffers();
+			}
+			if (rayQueriesSupported && overlay->checkBox("Ray traced (ray queries)", &rayTracedAO)) {
+				buildCommandBuffers();
+			}
+		}
+		if (rayTracedAO && overlay->header("Ray traced ambient occlusion")) {
+			overlay->text("Rays per pixel: %d", uboSSAOParams.rayCount);
+			overlay->text("Acceleration structures: %.2f MB", rayQueryScene.memorySize() / (1024.0f * 1024.0f));
+		}
+	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		// Compares the screen space occlusion with the ray traced occlusion
+		if ((name == "rtao") && rayQueriesSupported) {
+			rayTracedAO = enabled;
+			return true;
 		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
 	}
 };
 
@@ -19,6 +19,8 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool wireframe = false;
 	bool tessellation = true;
+	// Select the patches with the GPU quadtree instead of drawing the fixed grid
+	bool quadTreeLOD = true;
 
 	// Holds the buffers for rendering the tessellated terrain
 	struct {
@@ -33,6 +35,25 @@ public:
 		} indices;
 	} terrain;
 
+	// GPU driven quadtree level of detail
+	// A compute shader walks the tree one level per (indirect) dispatch, splits nodes with a too large screen space error and appends the
+	// visible leaves as instances of an indirect draw, each instance is a node drawn with a fixed number of tessellated quad patches
+	struct {
+		// Nodes of the tree are powers of two, so node coordinates and the edges shared between levels are exact
+		float rootSize = 1024.0f;
+		uint32_t maxLevel = 7;
+		uint32_t maxNodes = 4096;
+		uint32_t patchesPerNode = 8;
+		vks::Buffer levels;
+		vks::Buffer nodes;
+		vks::Buffer instances;
+		vks::Buffer drawCommand;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	} quadTree;
+
 	struct {
 		vks::Texture2D heightMap;
 		vks::Texture2D skySphere;
@@ -45,6 +66,7 @@ public:
 
 	struct {
 		vks::Buffer terrainTessellation;
+		vks::Buffer terrainLOD;
 		vks::Buffer skysphereVertex;
 	} uniformBuffers;
 
@@ -61,6 +83,21 @@ public:
 		float tessellatedEdgeSize = 20.0f;
 	} uboTess;
 
+	// Quadtree node selection compute shader
+	struct {
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPos;
+		glm::vec2 rootOrigin;
+		float rootSize;
+		float displacementFactor;
+		// Converts a world space size at distance one to pixels
+		float pixelScale;
+		// Nodes are split while the edges of their (untessellated) patches cover more pixels than this
+		float errorThreshold = 32.0f;
+		uint32_t maxLevel;
+		uint32_t maxNodes;
+	} uboLOD;
+
 	// Skysphere vertex shader stage
 	struct {
 		glm::mat4 mvp;
@@ -69,6 +106,8 @@ public:
 	struct Pipelines {
 		VkPipeline terrain;
 		VkPipeline wireframe = VK_NULL_HANDLE;
+		VkPipeline terrainQuadTree;
+		VkPipeline wireframeQuadTree = VK_NULL_HANDLE;
 		VkPipeline skysphere;
 	} pipelines;
 
@@ -87,12 +126,8 @@ public:
 		VkDescriptorSet skysphere;
 	} descriptorSets;
 
-	// Pipeline statistics
-	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} queryResult;
-	VkQueryPool queryPool = VK_NULL_HANDLE;
+	// Pipeline statistics, with one query slot per command buffer so results can be read without waiting for the frame that's currently in flight
+	vks::QueryManager queries;
 	uint64_t pipelineStats[2] = { 0 };
 
 	// View frustum passed to tessellation control shader for culling
@@ -117,6 +152,10 @@ public:
 		if (pipelines.wireframe != VK_NULL_HANDLE) {
 			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 		}
+		vkDestroyPipeline(device, pipelines.terrainQuadTree, nullptr);
+		if (pipelines.wireframeQuadTree != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.wireframeQuadTree, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.skysphere, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.skysphere, nullptr);
@@ -127,6 +166,15 @@ public:
 
 		uniformBuffers.skysphereVertex.destroy();
 		uniformBuffers.terrainTessellation.destroy();
+		uniformBuffers.terrainLOD.destroy();
+
+		vkDestroyPipeline(device, quadTree.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, quadTree.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, quadTree.descriptorSetLayout, nullptr);
+		quadTree.levels.destroy();
+		quadTree.nodes.destroy();
+		quadTree.instances.destroy();
+		quadTree.drawCommand.destroy();
 
 		textures.heightMap.destroy();
 		textures.skySphere.destroy();
@@ -137,11 +185,7 @@ public:
 		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
 		vkFreeMemory(device, terrain.indices.memory, nullptr);
 
-		if (queryPool != VK_NULL_HANDLE) {
-			vkDestroyQueryPool(device, queryPool, nullptr);
-			vkDestroyBuffer(device, queryResult.buffer, nullptr);
-			vkFreeMemory(device, queryResult.memory, nullptr);
-		}
+		queries.destroy();
 	}
 
 	// Enable physical device features required for this example
@@ -178,52 +222,17 @@ public:
 		}
 	}
 
-	// Setup pool and buffer for storing pipeline statistics results
+	// Setup the pipeline statistics query, its results are copied to host visible buffers by the command buffers
 	void setupQueryResultBuffer()
 	{
-		uint32_t bufSize = 2 * sizeof(uint64_t);
-
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkBufferCreateInfo bufferCreateInfo =
-			vks::initializers::bufferCreateInfo(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				bufSize);
-
-		// Results are saved in a host visible buffer for easy access by the application
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &queryResult.buffer));
-		vkGetBufferMemoryRequirements(device, queryResult.buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &queryResult.memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, queryResult.buffer, queryResult.memory, 0));
-
-		// Create query pool
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			VkQueryPoolCreateInfo queryPoolInfo = {};
-			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
-			queryPoolInfo.pipelineStatistics =
-				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
-				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
-			queryPoolInfo.queryCount = 2;
-			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
-		}
+		queries.setup(vulkanDevice, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT);
 	}
 
-	// Retrieves the results of the pipeline statistics query submitted to the command buffer
+	// Retrieves the results of the pipeline statistics query of the last submission of the current command buffer
 	void getQueryResults()
 	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			1,
-			sizeof(pipelineStats),
-			pipelineStats,
-			sizeof(uint64_t),
-			VK_QUERY_RESULT_64_BIT);
+		// prepareFrame has waited for the command buffer's last submission, so reading its copied results doesn't stall
+		queries.collect(currentBuffer, pipelineStats);
 	}
 
 	void loadAssets()
@@ -241,7 +250,7 @@ public:
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
 
 		// Setup a mirroring sampler for the height map
-		vkDestroySampler(device, textures.heightMap.sampler, nullptr);
+		vulkanDevice->resourceCache.releaseSampler(textures.heightMap.sampler);
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
@@ -256,7 +265,7 @@ public:
 		textures.heightMap.descriptor.sampler = textures.heightMap.sampler;
 
 		// Setup a repeating sampler for the terrain texture layers
-		vkDestroySampler(device, textures.terrainArray.sampler, nullptr);
+		vulkanDevice->resourceCache.releaseSampler(textures.terrainArray.sampler);
 		samplerInfo = vks::initializers::samplerCreateInfo();
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
@@ -301,7 +310,11 @@ public:
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+				queries.reset(drawCmdBuffers[i], i);
+			}
+
+			if (quadTreeLOD) {
+				selectQuadTreeNodes(drawCmdBuffers[i]);
 			}
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -324,243 +337,243 @@ public:
 			// Tessellated terrain
 			if (deviceFeatures.pipelineStatisticsQuery) {
 				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+				queries.beginQuery(drawCmdBuffers[i], i, 0);
 			}
 			// Render
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
+			if (quadTreeLOD) {
+				// The instance count has been written by the node selection
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframeQuadTree : pipelines.terrainQuadTree);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &quadTree.instances.buffer, offsets);
+				vkCmdDrawIndirect(drawCmdBuffers[i], quadTree.drawCommand.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+			} else {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
+			}
 			if (deviceFeatures.pipelineStatisticsQuery) {
 				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+				queries.endQuery(drawCmdBuffers[i], i, 0);
 			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.copyResults(drawCmdBuffers[i], i);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
-	// Encapsulate height map data for easy sampling
-	struct HeightMap
+	// Records the quadtree node selection, one indirect dispatch per level whose size is written by the dispatch of the level above
+	void selectQuadTreeNodes(VkCommandBuffer commandBuffer)
 	{
-	private:
-		uint16_t *heightdata;
-		uint32_t dim;
-		uint32_t scale;
-	public:
-#if defined(__ANDROID__)
-		HeightMap(std::string filename, uint32_t patchsize, AAssetManager* assetManager)
-#else
-		HeightMap(std::string filename, uint32_t patchsize)
-#endif
-		{
-			ktxResult result;
-			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			ktx_uint8_t* textureData = new ktx_uint8_t[size];
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-			delete[] textureData;
-
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
-			assert(result == KTX_SUCCESS);
-			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
-			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
-			dim = ktxTexture->baseWidth;
-			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, ktxImage, ktxSize);
-			this->scale = dim / patchsize;
-			ktxTexture_Destroy(ktxTexture);
-		};
-
-		~HeightMap()
-		{
-			delete[] heightdata;
+		// The previous frame may still read the selection of the last submission
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Level 0 holds the root node only, the dispatch sizes of all other levels start at zero
+		std::vector<glm::uvec4> levels(quadTree.maxLevel + 1, glm::uvec4(0, 1, 1, 0));
+		levels[0] = glm::uvec4(1);
+		vkCmdUpdateBuffer(commandBuffer, quadTree.levels.buffer, 0, levels.size() * sizeof(glm::uvec4), levels.data());
+		const glm::vec4 root(uboLOD.rootOrigin, quadTree.rootSize, 0.0f);
+		vkCmdUpdateBuffer(commandBuffer, quadTree.nodes.buffer, 0, sizeof(root), &root);
+		VkDrawIndirectCommand drawCommand = { quadTree.patchesPerNode * quadTree.patchesPerNode * 4, 0, 0, 0 };
+		vkCmdUpdateBuffer(commandBuffer, quadTree.drawCommand.buffer, 0, sizeof(drawCommand), &drawCommand);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, quadTree.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, quadTree.pipelineLayout, 0, 1, &quadTree.descriptorSet, 0, nullptr);
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		for (uint32_t level = 0; level <= quadTree.maxLevel; level++) {
+			vkCmdPushConstants(commandBuffer, quadTree.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &level);
+			vkCmdDispatchIndirect(commandBuffer, quadTree.levels.buffer, level * sizeof(glm::uvec4));
+			if (level < quadTree.maxLevel) {
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
 		}
 
-		float getHeight(uint32_t x, uint32_t y)
-		{
-			glm::ivec2 rpos = glm::ivec2(x, y) * glm::ivec2(scale);
-			rpos.x = std::max(0, std::min(rpos.x, (int)dim-1));
-			rpos.y = std::max(0, std::min(rpos.y, (int)dim-1));
-			rpos /= glm::ivec2(scale);
-			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f;
-		}
-	};
+		// Make the instances and the instance count visible to the draw
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Create the buffers and the compute pipeline of the quadtree node selection
+	void prepareQuadTree()
+	{
+		// Indirect dispatch arguments and node count per level
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&quadTree.levels,
+			(quadTree.maxLevel + 1) * sizeof(glm::uvec4)));
+		// Node lists of two consecutive levels
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&quadTree.nodes,
+			2 * quadTree.maxNodes * sizeof(glm::vec4)));
+		// Selected nodes, read as per instance vertex attributes
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&quadTree.instances,
+			quadTree.maxNodes * 2 * sizeof(glm::vec4)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&quadTree.drawCommand,
+			sizeof(VkDrawIndirectCommand)));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Selection parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Levels
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Node lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Indirect draw command
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &quadTree.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&quadTree.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &quadTree.pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(quadTree.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "terraintessellation/terrainlod.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &quadTree.pipeline));
+	}
 
 	// Generate a terrain quad patch for feeding to the tessellation control shader
+	// Vertices, normals (sobel filtered from the height map) and indices are computed on the GPU straight into the terrain buffers, so the height map doesn't need to be read on the host
 	void generateTerrain()
 	{
-		#define PATCH_SIZE 64
-		#define UV_SCALE 1.0f
-
-		const uint32_t vertexCount = PATCH_SIZE * PATCH_SIZE;
-		// We use the Vertex definition from the glTF model loader, so we can re-use the vertex input state
-		vkglTF::Vertex *vertices = new vkglTF::Vertex[vertexCount];
-
-		const float wx = 2.0f;
-		const float wy = 2.0f;
-
-		for (auto x = 0; x < PATCH_SIZE; x++)
-		{
-			for (auto y = 0; y < PATCH_SIZE; y++)
-			{
-				uint32_t index = (x + y * PATCH_SIZE);
-				vertices[index].pos[0] = x * wx + wx / 2.0f - (float)PATCH_SIZE * wx / 2.0f;
-				vertices[index].pos[1] = 0.0f;
-				vertices[index].pos[2] = y * wy + wy / 2.0f - (float)PATCH_SIZE * wy / 2.0f;
-				vertices[index].uv = glm::vec2((float)x / PATCH_SIZE, (float)y / PATCH_SIZE) * UV_SCALE;
-			}
-		}
-
-		// Calculate normals from height map using a sobel filter
-#if defined(__ANDROID__)
-		HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", PATCH_SIZE, androidApp->activity->assetManager);
-#else
-		HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", PATCH_SIZE);
-#endif
-		for (auto x = 0; x < PATCH_SIZE; x++)
-		{
-			for (auto y = 0; y < PATCH_SIZE; y++)
-			{
-				// Get height samples centered around current position
-				float heights[3][3];
-				for (auto hx = -1; hx <= 1; hx++)
-				{
-					for (auto hy = -1; hy <= 1; hy++)
-					{
-						heights[hx+1][hy+1] = heightMap.getHeight(x + hx, y + hy);
-					}
-				}
-
-				// Calculate the normal
-				glm::vec3 normal;
-				// Gx sobel filter
-				normal.x = heights[0][0] - heights[2][0] + 2.0f * heights[0][1] - 2.0f * heights[2][1] + heights[0][2] - heights[2][2];
-				// Gy sobel filter
-				normal.z = heights[0][0] + 2.0f * heights[1][0] + heights[2][0] - heights[0][2] - 2.0f * heights[1][2] - heights[2][2];
-				// Calculate missing up component of the normal using the filtered x and y axis
-				// The first value controls the bump strength
-				normal.y = 0.25f * sqrt( 1.0f - normal.x * normal.x - normal.z * normal.z);
-
-				vertices[x + y * PATCH_SIZE].normal = glm::normalize(normal * glm::vec3(2.0f, 1.0f, 2.0f));
-			}
-		}
+		const uint32_t patchSize = 64;
+		const float uvScale = 1.0f;
 
-		// Indices
-		const uint32_t w = (PATCH_SIZE - 1);
+		const uint32_t vertexCount = patchSize * patchSize;
+		const uint32_t w = (patchSize - 1);
 		const uint32_t indexCount = w * w * 4;
-		uint32_t *indices = new uint32_t[indexCount];
-		for (auto x = 0; x < w; x++)
-		{
-			for (auto y = 0; y < w; y++)
-			{
-				uint32_t index = (x + y * w) * 4;
-				indices[index] = (x + y * PATCH_SIZE);
-				indices[index + 1] = indices[index] + PATCH_SIZE;
-				indices[index + 2] = indices[index + 1] + 1;
-				indices[index + 3] = indices[index] + 1;
-			}
-		}
 		terrain.indices.count = indexCount;
 
-		uint32_t vertexBufferSize = vertexCount * sizeof(vkglTF::Vertex);
-		uint32_t indexBufferSize = indexCount * sizeof(uint32_t);
-
-		struct {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} vertexStaging, indexStaging;
-
-		// Create staging buffers
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBufferSize,
-			&vertexStaging.buffer,
-			&vertexStaging.memory,
-			vertices));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			indexBufferSize,
-			&indexStaging.buffer,
-			&indexStaging.memory,
-			indices));
-
+		// We use the Vertex definition from the glTF model loader, so we can re-use the vertex input state
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			vertexBufferSize,
+			vertexCount * sizeof(vkglTF::Vertex),
 			&terrain.vertices.buffer,
 			&terrain.vertices.memory));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			indexBufferSize,
+			indexCount * sizeof(uint32_t),
 			&terrain.indices.buffer,
 			&terrain.indices.memory));
 
-		// Copy from staging buffers
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkBufferCopy copyRegion = {};
-
-		copyRegion.size = vertexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			vertexStaging.buffer,
-			terrain.vertices.buffer,
-			1,
-			&copyRegion);
-
-		copyRegion.size = indexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			indexStaging.buffer,
-			terrain.indices.buffer,
-			1,
-			&copyRegion);
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-		vkFreeMemory(device, vertexStaging.memory, nullptr);
-		vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-		vkFreeMemory(device, indexStaging.memory, nullptr);
+		// The generation pipeline is only used once, so its objects are released right after the dispatch
+		VkDescriptorPool descriptorPool;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
-		delete[] vertices;
-		delete[] indices;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Height map
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorBufferInfo vertexDescriptor = { terrain.vertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo indexDescriptor = { terrain.indices.buffer, 0, VK_WHOLE_SIZE };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &textures.heightMap.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &vertexDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indexDescriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		struct PushConstants {
+			uint32_t patchSize;
+			float uvScale;
+		} pushConstants;
+		pushConstants.patchSize = patchSize;
+		pushConstants.uvScale = uvScale;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkPipeline pipeline;
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "terraintessellation/terraingenerate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (patchSize + 15) / 16, (patchSize + 15) / 16, 1);
+
+		// Make the generated geometry visible to vertex input
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -579,10 +592,10 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
 				0),
-			// Binding 1 : Height map
+			// Binding 1 : Height map (the quadtree vertex shader derives the normals from it)
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				1),
 			// Binding 3 : Terrain texture array layers
 			vks::initializers::descriptorSetLayoutBinding(
@@ -592,9 +605,9 @@ public:
 		};
 
 		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.terrain));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.terrain));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.terrain, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.terrain));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.terrain));
 
 		// Skysphere
 		setLayoutBindings =
@@ -612,9 +625,9 @@ public:
 		};
 
 		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.skysphere));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.skysphere));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.skysphere, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.skysphere));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.skysphere));
 	}
 
 	void setupDescriptorSets()
@@ -649,6 +662,18 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// Quadtree node selection
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &quadTree.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &quadTree.descriptorSet));
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(quadTree.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.terrainLOD.descriptor),
+			vks::initializers::writeDescriptorSet(quadTree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &quadTree.levels.descriptor),
+			vks::initializers::writeDescriptorSet(quadTree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &quadTree.nodes.descriptor),
+			vks::initializers::writeDescriptorSet(quadTree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &quadTree.instances.descriptor),
+			vks::initializers::writeDescriptorSet(quadTree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &quadTree.drawCommand.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
 		// Skysphere
 		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.skysphere, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.skysphere));
@@ -704,14 +729,37 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.terrain));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.terrain));
 
 		// Terrain wireframe pipeline
 		if (deviceFeatures.fillModeNonSolid) {
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 		};
 
+		// Quadtree terrain pipelines, the patch control points are generated from the per instance node data
+		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+		VkVertexInputBindingDescription instanceBinding = vks::initializers::vertexInputBindingDescription(0, 2 * sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_INSTANCE);
+		std::vector<VkVertexInputAttributeDescription> instanceAttributes = {
+			// Location 0 : Node origin, size and level
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0),
+			// Location 1 : Edge modes
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(glm::vec4)),
+		};
+		VkPipelineVertexInputStateCreateInfo instanceInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		instanceInputState.vertexBindingDescriptionCount = 1;
+		instanceInputState.pVertexBindingDescriptions = &instanceBinding;
+		instanceInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(instanceAttributes.size());
+		instanceInputState.pVertexAttributeDescriptions = instanceAttributes.data();
+		pipelineCI.pVertexInputState = &instanceInputState;
+		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/terrainquadtree.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.terrainQuadTree));
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframeQuadTree));
+		}
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
+
 		// Skysphere pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
@@ -725,7 +773,7 @@ public:
 		pipelineCI.layout = pipelineLayouts.skysphere;
 		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/skysphere.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "terraintessellation/skysphere.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skysphere));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skysphere));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -738,6 +786,13 @@ public:
 			&uniformBuffers.terrainTessellation,
 			sizeof(uboTess)));
 
+		// Quadtree node selection uniform buffer
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.terrainLOD,
+			sizeof(uboLOD)));
+
 		// Skysphere vertex shader uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -747,6 +802,7 @@ public:
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.terrainTessellation.map());
+		VK_CHECK_RESULT(uniformBuffers.terrainLOD.map());
 		VK_CHECK_RESULT(uniformBuffers.skysphereVertex.map());
 
 		updateUniformBuffers();
@@ -754,6 +810,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Tessellation
 
 		uboTess.projection = camera.matrices.perspective;
@@ -778,6 +835,17 @@ public:
 			uboTess.tessellationFactor = savedFactor;
 		}
 
+		// Quadtree node selection, the root is centered on the origin
+		memcpy(uboLOD.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		uboLOD.cameraPos = glm::inverse(uboTess.modelview)[3];
+		uboLOD.rootOrigin = glm::vec2(-quadTree.rootSize / 2.0f);
+		uboLOD.rootSize = quadTree.rootSize;
+		uboLOD.displacementFactor = uboTess.displacementFactor;
+		uboLOD.pixelScale = (float)height * 0.5f * fabsf(uboTess.projection[1][1]);
+		uboLOD.maxLevel = quadTree.maxLevel;
+		uboLOD.maxNodes = quadTree.maxNodes;
+		memcpy(uniformBuffers.terrainLOD.mapped, &uboLOD, sizeof(uboLOD));
+
 		// Skysphere vertex shader
 		uboVS.mvp = camera.matrices.perspective * glm::mat4(glm::mat3(camera.matrices.view));
 		memcpy(uniformBuffers.skysphereVertex.mapped, &uboVS, sizeof(uboVS));
@@ -787,6 +855,11 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Read the query results of this command buffer's last submission before it's submitted again
+			getQueryResults();
+		}
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -794,11 +867,6 @@ public:
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			// Read query results for displaying in next frame
-			getQueryResults();
-		}
-
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -807,6 +875,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		generateTerrain();
+		prepareQuadTree();
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			setupQueryResultBuffer();
 		}
@@ -839,6 +908,15 @@ public:
 			if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
 				updateUniformBuffers();
 			}
+			if (overlay->checkBox("Quadtree LOD", &quadTreeLOD)) {
+				buildCommandBuffers();
+			}
+			if (quadTreeLOD) {
+				if (overlay->inputFloat("LOD error (px)", &uboLOD.errorThreshold, 4.0f, 1)) {
+					uboLOD.errorThreshold = std::max(uboLOD.errorThreshold, 1.0f);
+					updateUniformBuffers();
+				}
+			}
 			if (deviceFeatures.fillModeNonSolid) {
 				if (overlay->checkBox("Wireframe", &wireframe)) {
 					buildCommandBuffers();
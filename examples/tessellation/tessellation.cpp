@@ -4,6 +4,9 @@
 * Based on http://alex.vlachos.com/graphics/CurvedPNTriangles.pdf
 * Shaders based on http://onrendering.blogspot.de/2011/12/tessellation-on-gpu-curved-pn-triangles.html
 *
+* The tessellation control shader can derive the tessellation factors from the projected length of the patch edges and cull patches
+* that are outside of the view frustum or face away, the saved work shows up in the tessellation pipeline statistics
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -11,6 +14,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanQueryManager.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -19,6 +24,7 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool splitScreen = true;
 	bool wireframe = true;
+	bool adaptiveTessellation = true;
 
 	vkglTF::Model model;
 
@@ -27,7 +33,15 @@ public:
 	} uniformBuffers;
 
 	struct UBOTessControl {
+		glm::mat4 projection;
+		glm::mat4 modelView;
+		glm::vec4 frustumPlanes[6];
+		glm::vec2 viewportDim;
+		// Uniform level, or maximum level of the screen space adaptive factors
 		float tessLevel = 3.0f;
+		// Target length of a tessellated edge in pixels
+		float tessellatedEdgeSize = 20.0f;
+		uint32_t adaptive;
 	} uboTessControl;
 
 	struct UBOTessEval {
@@ -47,6 +61,11 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Pipeline statistics of the PN triangles draw, with one query slot per command buffer
+	vks::QueryManager queries;
+	// Tessellation control shader patches and tessellation evaluation shader invocations
+	uint64_t pipelineStats[2] = { 0 };
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Tessellation shader (PN Triangles)";
@@ -55,6 +74,10 @@ public:
 		camera.setRotation(glm::vec3(-350.0f, 60.0f, 0.0f));
 		camera.setPerspective(45.0f, (float)(width * ((splitScreen) ? 0.5f : 1.0f)) / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("adaptivetessellation", { "-at", "--adaptivetessellation" }, 1, "Screen space adaptive tessellation factors with patch culling (0 = off, 1 = on)");
+		exampleArgs.parse(args);
+		adaptiveTessellation = exampleArgs.getValueAsInt("adaptivetessellation", 1) != 0;
 	}
 
 	~VulkanExample()
@@ -75,6 +98,7 @@ public:
 
 		uniformBuffers.tessControl.destroy();
 		uniformBuffers.tessEval.destroy();
+		queries.destroy();
 	}
 
 	// Enable physical device features required for this example
@@ -94,6 +118,16 @@ public:
 		else {
 			wireframe = false;
 		}
+		// Pipeline statistics
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
+	// Setup the pipeline statistics query, its results are copied to host visible buffers by the command buffers
+	void setupQueryResultBuffer()
+	{
+		queries.setup(vulkanDevice, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT | VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT);
 	}
 
 	void buildCommandBuffers()
@@ -120,6 +154,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.reset(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport(splitScreen ? (float)width / 2.0f : (float)width, (float)height, 0.0f, 1.0f);
@@ -141,12 +179,22 @@ public:
 
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wire : pipelines.solid);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.beginQuery(drawCmdBuffers[i], i, 0);
+			}
 			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.endQuery(drawCmdBuffers[i], i, 0);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				queries.copyResults(drawCmdBuffers[i], i);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -174,7 +222,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, 1),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Layout uses set 0 for passing tessellation shader ubos and set 1 for fragment shader images (taken from glTF model)
 		const std::vector<VkDescriptorSetLayout> setLayouts = {
@@ -182,7 +230,7 @@ public:
 			vkglTF::descriptorSetLayoutImage,
 		};
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), 2);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -234,11 +282,11 @@ public:
 
 		// Tessellation pipelines
 		// Solid
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
 		// Wireframe
 		if (deviceFeatures.fillModeNonSolid) {
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wire));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wire));
 		}
 
 		// Pass through pipelines
@@ -248,11 +296,11 @@ public:
 
 		// Solid
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solidPassThrough));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solidPassThrough));
 		// Wireframe
 		if (deviceFeatures.fillModeNonSolid) {
 			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wirePassThrough));
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wirePassThrough));
 		}
 	}
 
@@ -282,11 +330,19 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboTessEval.projection = camera.matrices.perspective;
 		uboTessEval.modelView = camera.matrices.view;
 		// Tessellation evaluation uniform block
 		memcpy(uniformBuffers.tessEval.mapped, &uboTessEval, sizeof(uboTessEval));
 		// Tessellation control uniform block
+		uboTessControl.projection = camera.matrices.perspective;
+		uboTessControl.modelView = camera.matrices.view;
+		vks::Frustum frustum;
+		frustum.update(uboTessControl.projection * uboTessControl.modelView);
+		memcpy(uboTessControl.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		uboTessControl.viewportDim = glm::vec2(splitScreen ? (float)width / 2.0f : (float)width, (float)height);
+		uboTessControl.adaptive = adaptiveTessellation ? 1 : 0;
 		memcpy(uniformBuffers.tessControl.mapped, &uboTessControl, sizeof(uboTessControl));
 	}
 
@@ -294,6 +350,15 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Read the query results of this command buffer's last submission before it's submitted again
+			queries.collect(currentBuffer, pipelineStats);
+			if (benchmark.active) {
+				benchmark.addMetric("tcpatches", static_cast<double>(pipelineStats[0]));
+				benchmark.addMetric("teinvocations", static_cast<double>(pipelineStats[1]));
+			}
+		}
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -305,6 +370,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			setupQueryResultBuffer();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -327,9 +395,18 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->inputFloat("Tessellation level", &uboTessControl.tessLevel, 0.25f, 2)) {
+			if (overlay->inputFloat(adaptiveTessellation ? "Max. tessellation level" : "Tessellation level", &uboTessControl.tessLevel, 0.25f, 2)) {
 				updateUniformBuffers();
 			}
+			if (overlay->checkBox("Adaptive tessellation", &adaptiveTessellation)) {
+				updateUniformBuffers();
+			}
+			if (adaptiveTessellation) {
+				if (overlay->inputFloat("Edge size (px)", &uboTessControl.tessellatedEdgeSize, 1.0f, 1)) {
+					uboTessControl.tessellatedEdgeSize = std::max(uboTessControl.tessellatedEdgeSize, 1.0f);
+					updateUniformBuffers();
+				}
+			}
 			if (deviceFeatures.fillModeNonSolid) {
 				if (overlay->checkBox("Wireframe", &wireframe)) {
 					updateUniformBuffers();
@@ -342,6 +419,17 @@ public:
 				}
 			}
 		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			if (overlay->header("Pipeline statistics")) {
+				overlay->text("TC patches: %d", static_cast<int>(pipelineStats[0]));
+				overlay->text("TE invocations: %d", static_cast<int>(pipelineStats[1]));
+			}
+		}
+	}
+
+	virtual void windowResized()
+	{
+		updateUniformBuffers();
 	}
 };
 
@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "jobsystem.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -24,15 +25,15 @@ class PerlinNoise
 {
 private:
 	uint32_t permutations[512];
-	T fade(T t)
+	T fade(T t) const
 	{
 		return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
 	}
-	T lerp(T t, T a, T b)
+	T lerp(T t, T a, T b) const
 	{
 		return a + t * (b - a);
 	}
-	T grad(int hash, T x, T y, T z)
+	T grad(int hash, T x, T y, T z) const
 	{
 		// Convert LO 4 bits of hash code into 12 gradient directions
 		int h = hash & 15;
@@ -55,7 +56,12 @@ public:
 			permutations[i] = permutations[256 + i] = plookup[i];
 		}
 	}
-	T noise(T x, T y, T z)
+	/** @brief Lookup table with the shuffled 256 permutations repeated once (512 entries), also used by the compute shader */
+	const uint32_t* getPermutations() const
+	{
+		return permutations;
+	}
+	T noise(T x, T y, T z) const
 	{
 		// Find unit cube that contains point
 		int32_t X = (int32_t)floor(x) & 255;
@@ -85,6 +91,66 @@ public:
 			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
 		return res;
 	}
+	/*
+		Add amplitude * noise(i * xStep, y, z) to result[i] for a row of count points
+		The corner hashes and the y and z dependent terms are only computed once per lattice cell. As the gradient of a corner is linear in x
+		the evaluation of the points inside a cell is reduced to branch free arithmetic, which the compiler can vectorize.
+	*/
+	void accumulateRow(T xStep, T y, T z, T amplitude, uint32_t count, T* result) const
+	{
+		const T yCell = floor(y);
+		const T zCell = floor(z);
+		const int32_t Y = (int32_t)yCell & 255;
+		const int32_t Z = (int32_t)zCell & 255;
+		y -= yCell;
+		z -= zCell;
+		const T v = fade(y);
+		const T w = fade(z);
+
+		uint32_t begin = 0;
+		while (begin < count)
+		{
+			const T xCell = floor(begin * xStep);
+			const int32_t X = (int32_t)xCell & 255;
+			uint32_t end = begin + 1;
+			while ((end < count) && (floor(end * xStep) == xCell))
+			{
+				end++;
+			}
+
+			// Hash coordinates of the 8 cube corners
+			const uint32_t A = permutations[X] + Y;
+			const uint32_t AA = permutations[A] + Z;
+			const uint32_t AB = permutations[A + 1] + Z;
+			const uint32_t B = permutations[X + 1] + Y;
+			const uint32_t BA = permutations[B] + Z;
+			const uint32_t BB = permutations[B + 1] + Z;
+			const uint32_t hashes[8] = { permutations[AA], permutations[BA], permutations[AB], permutations[BB], permutations[AA + 1], permutations[BA + 1], permutations[AB + 1], permutations[BB + 1] };
+
+			// grad(hash, x - dx, y - dy, z - dz) = slope * x + offset, with (dx, dy, dz) being the corner's offset inside the cube
+			T slopes[8];
+			T offsets[8];
+			for (uint32_t c = 0; c < 8; c++)
+			{
+				const T dx = (T)(c & 1);
+				const T dy = (T)((c >> 1) & 1);
+				const T dz = (T)((c >> 2) & 1);
+				slopes[c] = grad(hashes[c], (T)1, (T)0, (T)0);
+				offsets[c] = grad(hashes[c], -dx, y - dy, z - dz);
+			}
+
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const T x = i * xStep - xCell;
+				const T u = fade(x);
+				T res = lerp(w, lerp(v,
+					lerp(u, slopes[0] * x + offsets[0], slopes[1] * x + offsets[1]), lerp(u, slopes[2] * x + offsets[2], slopes[3] * x + offsets[3])),
+					lerp(v, lerp(u, slopes[4] * x + offsets[4], slopes[5] * x + offsets[5]), lerp(u, slopes[6] * x + offsets[6], slopes[7] * x + offsets[7])));
+				result[i] += amplitude * res;
+			}
+			begin = end;
+		}
+	}
 };
 
 // Fractal noise generator based on perlin noise above
@@ -106,7 +172,7 @@ public:
 		persistence = (T)0.5;
 	}
 
-	T noise(T x, T y, T z)
+	T noise(T x, T y, T z) const
 	{
 		T sum = 0;
 		T frequency = (T)1;
@@ -123,6 +189,26 @@ public:
 		sum = sum / max;
 		return (sum + (T)1.0) / (T)2.0;
 	}
+
+	// Same as noise(i * xStep, y, z) for a row of count points, see PerlinNoise::accumulateRow
+	void noiseRow(T xStep, T y, T z, uint32_t count, T* result) const
+	{
+		std::fill(result, result + count, (T)0);
+		T frequency = (T)1;
+		T amplitude = (T)1;
+		T max = (T)0;
+		for (uint32_t i = 0; i < octaves; i++)
+		{
+			perlinNoise.accumulateRow(xStep * frequency, y * frequency, z * frequency, amplitude, count, result);
+			max += amplitude;
+			amplitude *= persistence;
+			frequency *= (T)2;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			result[i] = (result[i] / max + (T)1.0) / (T)2.0;
+		}
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -168,6 +254,29 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// If the texture format supports storage, the noise is generated by a compute shader writing directly to the 3D texture
+	struct {
+		bool supported = false;
+		vks::Buffer permutations;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} compute;
+
+	struct ComputePushConstants {
+		int32_t size[3];
+		float noiseScale;
+	};
+
+	// Otherwise (or with --noise cpu) the noise is generated on all CPU cores
+	vks::JobSystem jobSystem;
+
+	bool gpuNoise = true;
+	uint32_t noiseTextureSize = 128;
+	double noiseGenerationTime = 0.0;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "3D textures";
@@ -177,6 +286,12 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
 		srand((unsigned int)time(NULL));
+		CommandLineParser exampleArgs;
+		exampleArgs.add("texturesize", { "-ts", "--texturesize" }, 1, "Width, height and depth of the noise texture (defaults to 128)");
+		exampleArgs.add("noise", { "-noise", "--noise" }, 1, "Generate the noise on the \"cpu\" or the \"gpu\" (default)");
+		exampleArgs.parse(args);
+		noiseTextureSize = static_cast<uint32_t>(std::max(exampleArgs.getValueAsInt("texturesize", 128), 1));
+		gpuNoise = (exampleArgs.getValueAsString("noise", "gpu") != "cpu");
 	}
 
 	~VulkanExample()
@@ -186,6 +301,14 @@ public:
 
 		destroyTextureImage(texture);
 
+		if (compute.supported) {
+			vkDestroyPipeline(device, compute.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(device, compute.descriptorPool, nullptr);
+			compute.permutations.destroy();
+		}
+
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -196,6 +319,14 @@ public:
 		uniformBufferVS.destroy();
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Required for the r8 format qualifier of the noise compute shader's storage image
+		if (deviceFeatures.shaderStorageImageExtendedFormats) {
+			enabledFeatures.shaderStorageImageExtendedFormats = VK_TRUE;
+		}
+	}
+
 	// Prepare all Vulkan resources for the 3D texture (including descriptors)
 	// Does not fill the texture with data
 	void prepareNoiseTexture(uint32_t width, uint32_t height, uint32_t depth)
@@ -224,6 +355,7 @@ public:
 			std::cout << "Error: Requested texture dimensions is greater than supported 3D texture dimension!" << std::endl;
 			return;
 		}
+		compute.supported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && enabledFeatures.shaderStorageImageExtendedFormats;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -240,6 +372,9 @@ public:
 		// Set initial layout of the image to undefined
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (compute.supported) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 
 		// Device local memory to back up image
@@ -286,82 +421,116 @@ public:
 		texture.descriptor.imageView = texture.view;
 		texture.descriptor.sampler = texture.sampler;
 
+		if (compute.supported) {
+			prepareCompute();
+		}
+
 		updateNoiseTexture();
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
-	void updateNoiseTexture()
+	// Compute pipeline that generates the noise directly into the 3D texture
+	void prepareCompute()
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
+		// The permutations are updated every time a new texture is generated
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &compute.permutations, 512 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(compute.permutations.map());
 
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &compute.descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : 3D texture written by the compute shader
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Permutation lookup table
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(compute.descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+		VkDescriptorImageInfo storageImageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &storageImageDescriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.permutations.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
-		// Generate perlin based noise
-		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ComputePushConstants), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
-		auto tStart = std::chrono::high_resolution_clock::now();
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "texture3d/noise.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
+	}
 
-		PerlinNoise<float> perlinNoise;
-		FractalNoise<float> fractalNoise(perlinNoise);
+	// Generate the noise with a compute shader that writes to the texture, no staging or host side noise evaluation required
+	void generateNoiseGPU(const PerlinNoise<float>& perlinNoise, float noiseScale)
+	{
+		memcpy(compute.permutations.mapped, perlinNoise.getPermutations(), 512 * sizeof(uint32_t));
 
-		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-#pragma omp parallel for
-		for (int32_t z = 0; z < texture.depth; z++)
-		{
-			for (int32_t y = 0; y < texture.height; y++)
-			{
-				for (int32_t x = 0; x < texture.width; x++)
-				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-					n = n - floor(n);
-
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
-				}
-			}
-		}
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
 
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		ComputePushConstants pushConstants;
+		pushConstants.size[0] = static_cast<int32_t>(texture.width);
+		pushConstants.size[1] = static_cast<int32_t>(texture.height);
+		pushConstants.size[2] = static_cast<int32_t>(texture.depth);
+		pushConstants.noiseScale = noiseScale;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &pushConstants);
+		// The compute shader uses a local workgroup size of 4x4x4
+		vkCmdDispatch(commandBuffer, (texture.width + 3) / 4, (texture.height + 3) / 4, (texture.depth + 3) / 4);
 
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, texture.imageLayout,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
 
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+	}
 
-		// Buffer object
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = texMemSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
+	// Generate the noise on all CPU cores directly into staging memory and upload it to the texture
+	void generateNoiseCPU(const PerlinNoise<float>& perlinNoise, float noiseScale)
+	{
+		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
 
-		// Allocate host visible memory for data upload
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
+		FractalNoise<float> fractalNoise(perlinNoise);
+
+		vks::StagingRing::Allocation staging = vulkanDevice->stagingRing.allocate(texMemSize);
+		uint8_t* data = static_cast<uint8_t*>(staging.data);
 
-		// Copy texture data into staging buffer
-		uint8_t *mapped;
-		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
-		vkUnmapMemory(device, stagingMemory);
+		// Each job evaluates a range of rows along the x axis
+		jobSystem.parallelFor(texture.height * texture.depth, [&](uint32_t begin, uint32_t end) {
+			std::vector<float> row(texture.width);
+			const float xStep = noiseScale / (float)texture.width;
+			for (uint32_t r = begin; r < end; r++)
+			{
+				const uint32_t y = r % texture.height;
+				const uint32_t z = r / texture.height;
+				const float ny = (float)y / (float)texture.height;
+				const float nz = (float)z / (float)texture.depth;
+				fractalNoise.noiseRow(xStep, ny * noiseScale, nz * noiseScale, texture.width, row.data());
+				uint8_t* dst = &data[y * texture.width + z * texture.width * texture.height];
+				for (uint32_t x = 0; x < texture.width; x++)
+				{
+					const float n = row[x] - floor(row[x]);
+					dst[x] = static_cast<uint8_t>(floor(n * 255));
+				}
+			}
+		});
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = vulkanDevice->beginUpload();
 
 		// The sub resource range describes the regions of the image we will be transitioned
 		VkImageSubresourceRange subresourceRange = {};
@@ -383,6 +552,7 @@ public:
 
 		// Setup buffer copy regions
 		VkBufferImageCopy bufferCopyRegion{};
+		bufferCopyRegion.bufferOffset = staging.offset;
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		bufferCopyRegion.imageSubresource.mipLevel = 0;
 		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
@@ -393,7 +563,7 @@ public:
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			staging.buffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -408,12 +578,36 @@ public:
 			texture.imageLayout,
 			subresourceRange);
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		vulkanDevice->endUpload(copyCmd, queue);
+	}
+
+	// Generate randomized noise for the 3D texture, on the GPU if supported
+	void updateNoiseTexture()
+	{
+		// Previous frames may still be sampling the texture
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+
+		const bool useGPU = gpuNoise && compute.supported;
+
+		// Generate perlin based noise
+		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture on the " << (useGPU ? "GPU" : "CPU") << "..." << std::endl;
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		PerlinNoise<float> perlinNoise;
+
+		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
 
-		// Clean up staging resources
-		delete[] data;
-		vkFreeMemory(device, stagingMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		if (useGPU) {
+			generateNoiseGPU(perlinNoise, noiseScale);
+		} else {
+			generateNoiseCPU(perlinNoise, noiseScale);
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		noiseGenerationTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+		std::cout << "Done in " << noiseGenerationTime << "ms" << std::endl;
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -605,14 +799,14 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -716,7 +910,7 @@ public:
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfo.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -735,6 +929,7 @@ public:
 
 	void updateUniformBuffers(bool viewchanged = true)
 	{
+		waitForFramesInFlight();
 		if (viewchanged)
 		{
 			uboVS.projection = camera.matrices.perspective;
@@ -756,7 +951,7 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareNoiseTexture(128, 128, 128);
+		prepareNoiseTexture(noiseTextureSize, noiseTextureSize, noiseTextureSize);
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -777,9 +972,13 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			if (compute.supported) {
+				overlay->checkBox("Generate on GPU", &gpuNoise);
+			}
 			if (overlay->button("Generate new texture")) {
 				updateNoiseTexture();
 			}
+			overlay->text("Generated in %.2f ms", noiseGenerationTime);
 		}
 	}
 };
@@ -7,7 +7,9 @@
 */
 
 /*
-* Note : This sample is work-in-progress and works basically, but it's not yet finished
+* Pages of the virtual texture are streamed in on demand: The fragment shader writes the pages it needs to a feedback buffer,
+* which is read back once the frame has finished. Requested pages are backed by a page pool with a fixed memory budget,
+* evicting the least recently requested pages, and bound and uploaded in a single batch per update.
 */
 
 #include "texturesparseresidency.h"
@@ -21,6 +23,7 @@ VirtualTexturePage::VirtualTexturePage()
 {
 	// Pages are initially not backed up by memory (non-resident)
 	imageMemoryBind.memory = VK_NULL_HANDLE;
+	lastRequested = 0;
 }
 
 bool VirtualTexturePage::resident()
@@ -28,40 +31,29 @@ bool VirtualTexturePage::resident()
 	return (imageMemoryBind.memory != VK_NULL_HANDLE);
 }
 
-// Allocate Vulkan memory for the virtual page
-void VirtualTexturePage::allocate(VkDevice device, uint32_t memoryTypeIndex)
+// Back the virtual page with a slot of the page pool
+void VirtualTexturePage::allocate(VkDeviceMemory memory, VkDeviceSize memoryOffset, uint32_t slot)
 {
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		return;
-	};
-
-	imageMemoryBind = {};
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = size;
-	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemoryBind.memory));
-
 	VkImageSubresource subResource{};
 	subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	subResource.mipLevel = mipLevel;
 	subResource.arrayLayer = layer;
 
 	// Sparse image memory binding
+	imageMemoryBind = {};
 	imageMemoryBind.subresource = subResource;
 	imageMemoryBind.extent = extent;
 	imageMemoryBind.offset = offset;
+	imageMemoryBind.memory = memory;
+	imageMemoryBind.memoryOffset = memoryOffset;
+	poolSlot = slot;
 }
 
-// Release Vulkan memory allocated for this page
-void VirtualTexturePage::release(VkDevice device)
+// Make the page non-resident, the bind with a null memory handle unbinds it on the next sparse bind
+void VirtualTexturePage::release()
 {
-	if (imageMemoryBind.memory != VK_NULL_HANDLE)
-	{
-		vkFreeMemory(device, imageMemoryBind.memory, nullptr);
-		imageMemoryBind.memory = VK_NULL_HANDLE;
-	}
+	imageMemoryBind.memory = VK_NULL_HANDLE;
+	imageMemoryBind.memoryOffset = 0;
 }
 
 /*
@@ -85,21 +77,24 @@ VirtualTexturePage* VirtualTexture::addPage(VkOffset3D offset, VkExtent3D extent
 	return &pages.back();
 }
 
+// Index of a page within the pages of layer 0
+uint32_t VirtualTexture::pageIndex(uint32_t mipLevel, uint32_t x, uint32_t y)
+{
+	return mipPageOffsets[mipLevel] + y * mipPageCounts[mipLevel].x + x;
+}
+
 // Call before sparse binding to update memory bind list etc.
-void VirtualTexture::updateSparseBindInfo()
+// Only the binds of the updated pages are passed to the sparse bind, so unchanged pages aren't rebound
+void VirtualTexture::updateSparseBindInfo(const std::vector<VirtualTexturePage*>& updatedPages, bool bindMipTail)
 {
-	// Update list of memory-backed sparse image memory binds
-	//sparseImageMemoryBinds.resize(pages.size());
+	// Update list of changed sparse image memory binds, non-resident pages are unbound
 	sparseImageMemoryBinds.clear();
-	for (auto page : pages)
+	for (auto page : updatedPages)
 	{
-		sparseImageMemoryBinds.push_back(page.imageMemoryBind);
+		sparseImageMemoryBinds.push_back(page->imageMemoryBind);
 	}
 	// Update sparse bind info
 	bindSparseInfo = vks::initializers::bindSparseInfo();
-	// todo: Semaphore for queue submission
-	// bindSparseInfo.signalSemaphoreCount = 1;
-	// bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
 
 	// Image memory binds
 	imageMemoryBindInfo = {};
@@ -111,7 +106,7 @@ void VirtualTexture::updateSparseBindInfo()
 
 	// Opaque image memory binds for the mip tail
 	opaqueMemoryBindInfo.image = image;
-	opaqueMemoryBindInfo.bindCount = static_cast<uint32_t>(opaqueMemoryBinds.size());
+	opaqueMemoryBindInfo.bindCount = bindMipTail ? static_cast<uint32_t>(opaqueMemoryBinds.size()) : 0;
 	opaqueMemoryBindInfo.pBinds = opaqueMemoryBinds.data();
 	bindSparseInfo.imageOpaqueBindCount = (opaqueMemoryBindInfo.bindCount > 0) ? 1 : 0;
 	bindSparseInfo.pImageOpaqueBinds = &opaqueMemoryBindInfo;
@@ -120,10 +115,7 @@ void VirtualTexture::updateSparseBindInfo()
 // Release all Vulkan resources
 void VirtualTexture::destroy()
 {
-	for (auto page : pages)
-	{
-		page.release(device);
-	}
+	pagePool.destroy();
 	for (auto bind : opaqueMemoryBinds)
 	{
 		vkFreeMemory(device, bind.memory, nullptr);
@@ -142,6 +134,12 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setRotation(glm::vec3(-90.0f, 0.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 	settings.overlay = true;
+	// Command buffers are recorded per frame, so the feedback of a frame in flight can be read back before its command buffer is reused
+	dynamicCommandBuffers = true;
+	CommandLineParser exampleArgs;
+	exampleArgs.add("budget", { "-budget", "--budget" }, 1, "Memory budget for the resident pages in MB (defaults to 32)");
+	exampleArgs.parse(args);
+	streaming.memoryBudgetMB = std::max(exampleArgs.getValueAsInt("budget", 32), 1);
 }
 
 VulkanExample::~VulkanExample()
@@ -150,6 +148,12 @@ VulkanExample::~VulkanExample()
 	// Note : Inherited destructor cleans up resources stored in base class
 	destroyTextureImage(texture);
 	vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
+	vkDestroySemaphore(device, streaming.framesSemaphore, nullptr);
+	vkDestroyFence(device, streaming.fence, nullptr);
+	vkFreeCommandBuffers(device, vulkanDevice->commandPool, 1, &streaming.commandBuffer);
+	for (auto& buffer : feedback.buffers) {
+		buffer.destroy();
+	}
 	vkDestroyPipeline(device, pipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -164,6 +168,10 @@ void VulkanExample::getEnabledFeatures()
 		enabledFeatures.sparseBinding = VK_TRUE;
 		enabledFeatures.sparseResidencyImage2D = VK_TRUE;
 	}
+	// The fragment shader writes the page requests to the feedback buffer
+	if (deviceFeatures.fragmentStoresAndAtomics) {
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
 	else {
 		std::cout << "Sparse binding not supported" << std::endl;
 	}
@@ -236,7 +244,8 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VK_CHECK_RESULT(vkCreateImage(device, &sparseImageCreateInfo, nullptr, &texture.image));
 
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// The image stays in the general layout, so pages can be uploaded while frames in flight sample other pages of it
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 	vulkanDevice->flushCommandBuffer(copyCmd, queue);
 
 	// Get memory requirements
@@ -335,6 +344,10 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 			// Aligned sizes by image granularity
 			VkExtent3D imageGranularity = sparseMemoryReq.formatProperties.imageGranularity;
 			glm::uvec3 sparseBindCounts = alignedDivision(extent, imageGranularity);
+			if (layer == 0) {
+				texture.mipPageOffsets.push_back(static_cast<uint32_t>(texture.pages.size()));
+				texture.mipPageCounts.push_back(glm::uvec2(sparseBindCounts.x, sparseBindCounts.y));
+			}
 			glm::uvec3 lastBlockExtent;
 			lastBlockExtent.x = (extent.width % imageGranularity.width) ? extent.width % imageGranularity.width : imageGranularity.width;
 			lastBlockExtent.y = (extent.height % imageGranularity.height) ? extent.height % imageGranularity.height : imageGranularity.height;
@@ -420,14 +433,11 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &bindSparseSemaphore));
 
-	// Prepare bind sparse info for reuse in queue submission
-	texture.updateSparseBindInfo();
-
-	// Bind to queue
-	// todo: in draw?
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
-	//todo: use sparse bind semaphore
-	vkQueueWaitIdle(queue);
+	// Pages are backed by the page pool once they are requested, only the mip tail is bound up front
+	texture.pagePool.create(device, texture.memoryTypeIndex, sparseImageMemoryReqs.alignment, (VkDeviceSize)streaming.memoryBudgetMB * 1024 * 1024);
+	texture.updateSparseBindInfo({}, true);
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 
 	// Create sampler
 	VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -461,7 +471,7 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 
 	// Fill image descriptor image info that can be used during the descriptor set setup
-	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 	texture.descriptor.imageView = texture.view;
 	texture.descriptor.sampler = texture.sampler;
 }
@@ -475,9 +485,15 @@ void VulkanExample::destroyTextureImage(SparseTexture texture)
 	texture.destroy();
 }
 
-void VulkanExample::buildCommandBuffers()
+void VulkanExample::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
+	// The fence of this frame in flight has been waited on, so the page requests written by its previous submission can be read
+	if (feedback.enabled) {
+		updateResidency(currentFrame);
+	}
+
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	VkClearValue clearValues[2];
 	clearValues[0].color = defaultClearColor;
@@ -491,40 +507,44 @@ void VulkanExample::buildCommandBuffers()
 	renderPassBeginInfo.renderArea.extent.height = height;
 	renderPassBeginInfo.clearValueCount = 2;
 	renderPassBeginInfo.pClearValues = clearValues;
+	renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
 
-	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+	// Clear the requests of this frame's feedback buffer before the fragment shader writes to it
+	vks::Buffer& feedbackBuffer = feedback.buffers[currentFrame];
+	vkCmdFillBuffer(commandBuffer, feedbackBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = feedbackBuffer.buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
 
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-		plane.draw(drawCmdBuffers[i]);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, NULL);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	plane.draw(commandBuffer);
 
-		drawUI(drawCmdBuffers[i]);
+	drawUI(commandBuffer);
 
-		vkCmdEndRenderPass(drawCmdBuffers[i]);
+	vkCmdEndRenderPass(commandBuffer);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-	}
-}
+	// Make the requests visible to the host once the frame's fence has been signaled
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
 
-void VulkanExample::draw()
-{
-	VulkanExampleBase::prepareFrame();
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	VulkanExampleBase::submitFrame();
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 }
 
 void VulkanExample::loadAssets()
@@ -535,18 +555,19 @@ void VulkanExample::loadAssets()
 
 void VulkanExample::setupDescriptorPool()
 {
-	// Example uses one ubo and one image sampler
+	// Example uses one ubo, one image sampler and one feedback buffer per frame in flight
 	std::vector<VkDescriptorPoolSize> poolSizes =
 	{
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxFramesInFlight),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxFramesInFlight),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxFramesInFlight)
 	};
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo =
 		vks::initializers::descriptorPoolCreateInfo(
 			static_cast<uint32_t>(poolSizes.size()),
 			poolSizes.data(),
-			2);
+			maxFramesInFlight);
 
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 }
@@ -555,16 +576,21 @@ void VulkanExample::setupDescriptorSetLayout()
 {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
 	{
-		// Binding 0 : Vertex shader uniform buffer
+		// Binding 0 : Vertex and fragment shader uniform buffer
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			VK_SHADER_STAGE_VERTEX_BIT,
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0),
 		// Binding 1 : Fragment shader image sampler
 		vks::initializers::descriptorSetLayoutBinding(
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 			VK_SHADER_STAGE_FRAGMENT_BIT,
-			1)
+			1),
+		// Binding 2 : Fragment shader page request feedback buffer
+		vks::initializers::descriptorSetLayoutBinding(
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			2)
 	};
 
 	VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -572,43 +598,76 @@ void VulkanExample::setupDescriptorSetLayout()
 			setLayoutBindings.data(),
 			static_cast<uint32_t>(setLayoutBindings.size()));
 
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 	VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 		vks::initializers::pipelineLayoutCreateInfo(
 			&descriptorSetLayout,
 			1);
 
-	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+	VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 }
 
 void VulkanExample::setupDescriptorSet()
 {
-	VkDescriptorSetAllocateInfo allocInfo =
-		vks::initializers::descriptorSetAllocateInfo(
-			descriptorPool,
-			&descriptorSetLayout,
-			1);
+	descriptorSets.resize(maxFramesInFlight);
+	for (uint32_t i = 0; i < maxFramesInFlight; i++)
+	{
+		VkDescriptorSetAllocateInfo allocInfo =
+			vks::initializers::descriptorSetAllocateInfo(
+				descriptorPool,
+				&descriptorSetLayout,
+				1);
 
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
 
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets =
-	{
-		// Binding 0 : Vertex shader uniform buffer
-		vks::initializers::writeDescriptorSet(
-			descriptorSet,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			0,
-			&uniformBufferVS.descriptor),
-		// Binding 1 : Fragment shader texture sampler
-		vks::initializers::writeDescriptorSet(
-			descriptorSet,
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			1,
-			&texture.descriptor)
-	};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		{
+			// Binding 0 : Vertex and fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				0,
+				&uniformBufferVS.descriptor),
+			// Binding 1 : Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(
+				descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				1,
+				&texture.descriptor),
+			// Binding 2 : Fragment shader feedback buffer of this frame in flight
+			vks::initializers::writeDescriptorSet(
+				descriptorSets[i],
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				2,
+				&feedback.buffers[i].descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	}
+}
+
+// Create the feedback buffers and the objects used to stream in the requested pages
+void VulkanExample::prepareFeedback()
+{
+	// One request flag per virtual page
+	const VkDeviceSize bufferSize = std::max(texture.pages.size(), (size_t)1) * sizeof(uint32_t);
+	feedback.buffers.resize(maxFramesInFlight);
+	for (auto& buffer : feedback.buffers) {
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			bufferSize));
+		VK_CHECK_RESULT(buffer.map());
+		memset(buffer.mapped, 0, bufferSize);
+	}
 
-	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+	streaming.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &streaming.fence));
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &streaming.framesSemaphore));
 }
 
 void VulkanExample::preparePipelines()
@@ -638,7 +697,7 @@ void VulkanExample::preparePipelines()
 
 	shaderStages[0] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 }
 
 // Prepare and initialize uniform buffer containing shader uniforms
@@ -657,9 +716,14 @@ void VulkanExample::prepareUniformBuffers()
 
 void VulkanExample::updateUniformBuffers()
 {
+	waitForFramesInFlight();
 	uboVS.projection = camera.matrices.perspective;
 	uboVS.model = camera.matrices.view;
 	uboVS.viewPos = camera.viewPos;
+	uboVS.mipTailStart = static_cast<int32_t>(texture.mipTailStart);
+	uboVS.textureSize = glm::ivec2(texture.width, texture.height);
+	const VkExtent3D& granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	uboVS.pageSize = glm::ivec2(granularity.width, granularity.height);
 
 	VK_CHECK_RESULT(uniformBufferVS.map());
 	memcpy(uniformBufferVS.mapped, &uboVS, sizeof(uboVS));
@@ -673,15 +737,20 @@ void VulkanExample::prepare()
 	if (!vulkanDevice->features.sparseResidencyImage2D) {
 		vks::tools::exitFatal("Device does not support sparse residency for 2D images!", VK_ERROR_FEATURE_NOT_PRESENT);
 	}
+	// The page requests are written from the fragment shader
+	if (!vulkanDevice->features.fragmentStoresAndAtomics) {
+		vks::tools::exitFatal("Device does not support stores from fragment shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+	}
 	loadAssets();
-	prepareUniformBuffers();
 	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
 	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	prepareUniformBuffers();
+	fillMipTail();
+	prepareFeedback();
 	setupDescriptorSetLayout();
 	preparePipelines();
 	setupDescriptorPool();
 	setupDescriptorSet();
-	buildCommandBuffers();
 	prepared = true;
 }
 
@@ -689,205 +758,241 @@ void VulkanExample::render()
 {
 	if (!prepared)
 		return;
-	draw();
+	renderFrame();
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
 }
 
-void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
+// Random color that only depends on the seed, so a page has the same content each time it's streamed in
+static void pageColor(uint32_t seed, uint8_t color[4])
 {
-	// Generate some random image data and upload as a buffer
-	const size_t bufferSize = 4 * page.extent.width * page.extent.height;
-
-	vks::Buffer imageBuffer;
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageBuffer,
-		bufferSize));
-	imageBuffer.map();
-
-	// Fill buffer with random colors
-	std::random_device rd;
-	std::mt19937 rndEngine(rd());
+	std::mt19937 rndEngine(seed);
 	std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-	uint8_t* data = (uint8_t*)imageBuffer.mapped;
-	uint8_t rndVal[4] = { 0, 0, 0, 0 };
-	while (rndVal[0] + rndVal[1] + rndVal[2] < 10) {
-		rndVal[0] = (uint8_t)rndDist(rndEngine);
-		rndVal[1] = (uint8_t)rndDist(rndEngine);
-		rndVal[2] = (uint8_t)rndDist(rndEngine);
+	color[0] = color[1] = color[2] = 0;
+	while (color[0] + color[1] + color[2] < 10) {
+		color[0] = (uint8_t)rndDist(rndEngine);
+		color[1] = (uint8_t)rndDist(rndEngine);
+		color[2] = (uint8_t)rndDist(rndEngine);
 	}
-	rndVal[3] = 255;
+	color[3] = 255;
+}
+
+// Generate some image data for the page and record its upload from the staging ring
+void VulkanExample::uploadContent(VkCommandBuffer commandBuffer, const VirtualTexturePage& page, VkImage image)
+{
+	const VkDeviceSize bufferSize = 4 * page.extent.width * page.extent.height;
+	vks::StagingRing::Allocation staging = vulkanDevice->stagingRing.allocate(bufferSize);
 
-	for (uint32_t y = 0; y < page.extent.height; y++)
+	uint8_t color[4];
+	pageColor(page.index, color);
+	uint8_t* data = static_cast<uint8_t*>(staging.data);
+	for (uint32_t i = 0; i < page.extent.width * page.extent.height; i++, data += 4)
 	{
-		for (uint32_t x = 0; x < page.extent.width; x++)
-		{
-			for (uint32_t c = 0; c < 4; c++, ++data)
-			{
-				*data = rndVal[c];
-			}
-		}
+		memcpy(data, color, 4);
 	}
 
-	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 	VkBufferImageCopy region{};
+	region.bufferOffset = staging.offset;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	region.imageSubresource.layerCount = 1;
 	region.imageSubresource.mipLevel = page.mipLevel;
+	region.imageSubresource.baseArrayLayer = page.layer;
 	region.imageOffset = page.offset;
 	region.imageExtent = page.extent;
-	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-	imageBuffer.destroy();
-}
-	
-void VulkanExample::fillRandomPages()
-{
-	vkDeviceWaitIdle(device);
-
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-	std::vector<VirtualTexturePage> updatedPages;
-	for (auto& page : texture.pages) {
-		if (rndDist(rndEngine) < 0.5f) {
-			continue;
-		}
-		page.allocate(device, texture.memoryTypeIndex);
-		updatedPages.push_back(page);
-	}
-
-	// Update sparse queue binding
-	texture.updateSparseBindInfo();
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-
-	for (auto &page: updatedPages) {
-		uploadContent(page, texture.image);
-	}
+	vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
 }
 
+// The mip tail is always resident and is the fallback for all pages that haven't been streamed in yet
 void VulkanExample::fillMipTail()
 {
-	//@todo: WIP
-	VkDeviceSize imageMipTailSize = texture.sparseImageMemoryRequirements.imageMipTailSize;
-	VkDeviceSize imageMipTailOffset = texture.sparseImageMemoryRequirements.imageMipTailOffset;
-	// Stride between memory bindings for each mip level if not single mip tail (VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT not set)
-	VkDeviceSize imageMipTailStride = texture.sparseImageMemoryRequirements.imageMipTailStride;
-
-	VkSparseImageMemoryBind mipTailimageMemoryBind{};
-
-	VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-	allocInfo.allocationSize = imageMipTailSize;
-	allocInfo.memoryTypeIndex = texture.memoryTypeIndex;
-	VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &mipTailimageMemoryBind.memory));
-
-	uint32_t mipLevel = texture.sparseImageMemoryRequirements.imageMipTailFirstLod;
-	uint32_t width = std::max(texture.width >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t height = std::max(texture.height >> texture.sparseImageMemoryRequirements.imageMipTailFirstLod, 1u);
-	uint32_t depth = 1;
+	if (texture.mipTailStart >= texture.mipLevels) {
+		return;
+	}
 
+	VkCommandBuffer copyCmd = vulkanDevice->beginUpload();
 	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
-
 		const uint32_t width = std::max(texture.width >> i, 1u);
 		const uint32_t height = std::max(texture.height >> i, 1u);
-		const uint32_t depth = 1;
 
-		// Generate some random image data and upload as a buffer
-		const size_t bufferSize = 4 * width * height;
-
-		vks::Buffer imageBuffer;
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&imageBuffer,
-			bufferSize));
-		imageBuffer.map();
-
-		// Fill buffer with random colors
-		std::random_device rd;
-		std::mt19937 rndEngine(rd());
-		std::uniform_int_distribution<uint32_t> rndDist(0, 255);
-		uint8_t* data = (uint8_t*)imageBuffer.mapped;
-		uint8_t rndVal[4] = { 0, 0, 0, 0 };
-		while (rndVal[0] + rndVal[1] + rndVal[2] < 10) {
-			rndVal[0] = (uint8_t)rndDist(rndEngine);
-			rndVal[1] = (uint8_t)rndDist(rndEngine);
-			rndVal[2] = (uint8_t)rndDist(rndEngine);
-		}
-		rndVal[3] = 255;
-
-		switch (mipLevel) {
-		case 0:
-			rndVal[0] = rndVal[1] = rndVal[2] = 255;
-			break;
-		case 1:
-			rndVal[0] = rndVal[1] = rndVal[2] = 200;
-			break;
-		case 2:
-			rndVal[0] = rndVal[1] = rndVal[2] = 150;
-			break;
-		}
-
-		for (uint32_t y = 0; y < height; y++)
+		vks::StagingRing::Allocation staging = vulkanDevice->stagingRing.allocate(4 * width * height);
+		uint8_t color[4];
+		pageColor(static_cast<uint32_t>(texture.pages.size()) + i, color);
+		uint8_t* data = static_cast<uint8_t*>(staging.data);
+		for (uint32_t j = 0; j < width * height; j++, data += 4)
 		{
-			for (uint32_t x = 0; x < width; x++)
-			{
-				for (uint32_t c = 0; c < 4; c++, ++data)
-				{
-					*data = rndVal[c];
-				}
-			}
+			memcpy(data, color, 4);
 		}
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 		VkBufferImageCopy region{};
+		region.bufferOffset = staging.offset;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		region.imageSubresource.layerCount = 1;
 		region.imageSubresource.mipLevel = i;
 		region.imageOffset = {};
-		region.imageExtent = { width, height, depth };
-		vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue);
+		region.imageExtent = { width, height, 1 };
+		vkCmdCopyBufferToImage(copyCmd, staging.buffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+	}
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	vulkanDevice->endUpload(copyCmd, queue);
+}
 
-		imageBuffer.destroy();
+// Mark a page and its coarser parents as requested, the non-resident ones are collected for streaming
+void VulkanExample::requestPage(uint32_t pageIndex, std::vector<VirtualTexturePage*>& missingPages)
+{
+	const VkExtent3D& granularity = texture.sparseImageMemoryRequirements.formatProperties.imageGranularity;
+	VirtualTexturePage* page = &texture.pages[pageIndex];
+	while (page->lastRequested != streaming.updateIndex) {
+		page->lastRequested = streaming.updateIndex;
+		streaming.pagesRequested++;
+		if (page->resident()) {
+			// Most recently requested pages are at the front of the LRU list
+			texture.lru.splice(texture.lru.begin(), texture.lru, page->lruEntry);
+		} else {
+			missingPages.push_back(page);
+		}
+		// The parent page covers this page in the next coarser mip level and is sampled while this page isn't resident
+		const uint32_t parentMipLevel = page->mipLevel + 1;
+		if (parentMipLevel >= texture.mipTailStart) {
+			break;
+		}
+		const uint32_t x = page->offset.x / granularity.width / 2;
+		const uint32_t y = page->offset.y / granularity.height / 2;
+		page = &texture.pages[texture.pageIndex(parentMipLevel, x, y)];
 	}
 }
 
-void VulkanExample::flushRandomPages()
+// Evict the least recently requested page, pages requested by the current update are never evicted
+bool VulkanExample::evictPage(std::vector<VirtualTexturePage*>& updatedPages)
 {
-	vkDeviceWaitIdle(device);
+	if (texture.lru.empty()) {
+		return false;
+	}
+	VirtualTexturePage* page = &texture.pages[texture.lru.back()];
+	if (page->lastRequested == streaming.updateIndex) {
+		return false;
+	}
+	texture.lru.pop_back();
+	texture.pagePool.free(page->poolSlot);
+	page->release();
+	updatedPages.push_back(page);
+	streaming.pagesEvicted++;
+	return true;
+}
 
-	std::default_random_engine rndEngine(std::random_device{}());
-	std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+// Read the page requests of a finished frame and stream in the missing pages
+void VulkanExample::updateResidency(uint32_t frameIndex)
+{
+	streaming.updateIndex++;
+	streaming.pagesRequested = 0;
+
+	const uint32_t* requests = static_cast<const uint32_t*>(feedback.buffers[frameIndex].mapped);
+	std::vector<VirtualTexturePage*> missingPages;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(texture.pages.size()); i++) {
+		if (requests[i] != 0) {
+			requestPage(i, missingPages);
+		}
+	}
 
-	std::vector<VirtualTexturePage> updatedPages;
-	for (auto& page : texture.pages)
-	{
-		if (rndDist(rndEngine) < 0.5f) {
-			continue;
+	// Coarse pages first, they cover the largest areas and are the fallback for the finer ones
+	std::stable_sort(missingPages.begin(), missingPages.end(), [](const VirtualTexturePage* a, const VirtualTexturePage* b) { return a->mipLevel > b->mipLevel; });
+	if (missingPages.size() > streaming.maxPagesPerUpdate) {
+		missingPages.resize(streaming.maxPagesPerUpdate);
+	}
+
+	std::vector<VirtualTexturePage*> updatedPages;
+	std::vector<VirtualTexturePage*> uploadPages;
+	// Pages above a lowered memory budget
+	while ((texture.pagePool.usedSlots() > texture.pagePool.capacity) && evictPage(updatedPages)) {}
+	for (auto page : missingPages) {
+		VkDeviceMemory memory;
+		VkDeviceSize memoryOffset;
+		uint32_t slot;
+		if (!texture.pagePool.allocate(&memory, &memoryOffset, &slot)) {
+			// The budget is used up, reuse the slot of the least recently requested page
+			if (!evictPage(updatedPages) || !texture.pagePool.allocate(&memory, &memoryOffset, &slot)) {
+				// All resident pages are requested by this frame
+				break;
+			}
 		}
-		page.release(device);
+		page->allocate(memory, memoryOffset, slot);
+		texture.lru.push_front(page->index);
+		page->lruEntry = texture.lru.begin();
+		updatedPages.push_back(page);
+		uploadPages.push_back(page);
+	}
+
+	if (updatedPages.empty()) {
+		return;
 	}
 
-	// Update sparse queue binding
-	texture.updateSparseBindInfo();
-	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-	VkFence fence;
-	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
-	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	// The previous update has been submitted frames ago, so this usually doesn't wait
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &streaming.fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &streaming.fence));
+
+	// Signaled once all frames submitted so far have finished, evicted pages must not be unbound while frames in flight sample them
+	VkSubmitInfo framesSubmitInfo = vks::initializers::submitInfo();
+	framesSubmitInfo.signalSemaphoreCount = 1;
+	framesSubmitInfo.pSignalSemaphores = &streaming.framesSemaphore;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &framesSubmitInfo, VK_NULL_HANDLE));
+
+	// All binds and unbinds of this update in a single sparse bind operation
+	texture.updateSparseBindInfo(updatedPages, false);
+	texture.bindSparseInfo.waitSemaphoreCount = 1;
+	texture.bindSparseInfo.pWaitSemaphores = &streaming.framesSemaphore;
+	texture.bindSparseInfo.signalSemaphoreCount = 1;
+	texture.bindSparseInfo.pSignalSemaphores = &bindSparseSemaphore;
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+
+	// Upload the content of all new pages with one command buffer once they have been bound
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(streaming.commandBuffer, &cmdBufInfo));
+	for (auto page : uploadPages) {
+		uploadContent(streaming.commandBuffer, *page, texture.image);
+	}
+	// Frames submitted after the upload sample the new pages
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(streaming.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	VK_CHECK_RESULT(vkEndCommandBuffer(streaming.commandBuffer));
+
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+	uploadSubmitInfo.waitSemaphoreCount = 1;
+	uploadSubmitInfo.pWaitSemaphores = &bindSparseSemaphore;
+	uploadSubmitInfo.pWaitDstStageMask = &waitStageMask;
+	uploadSubmitInfo.commandBufferCount = 1;
+	uploadSubmitInfo.pCommandBuffers = &streaming.commandBuffer;
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, streaming.fence));
+	// The staging memory of the uploads can be reused once the fence has been signaled
+	vulkanDevice->stagingRing.submit(streaming.fence);
+
+	streaming.pagesUploaded += static_cast<uint32_t>(uploadPages.size());
+}
+
+// Evict all resident pages, so they are streamed in again by the next updates
+void VulkanExample::flushPages()
+{
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	std::vector<VirtualTexturePage*> updatedPages;
+	for (auto index : texture.lru) {
+		VirtualTexturePage* page = &texture.pages[index];
+		texture.pagePool.free(page->poolSlot);
+		page->release();
+		updatedPages.push_back(page);
+	}
+	texture.lru.clear();
+	if (updatedPages.empty()) {
+		return;
+	}
+	texture.updateSparseBindInfo(updatedPages, false);
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 }
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
@@ -896,20 +1001,19 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		if (overlay->sliderFloat("LOD bias", &uboVS.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
-		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
+		overlay->checkBox("Page feedback", &feedback.enabled);
+		if (overlay->sliderInt("Memory budget (MB)", &streaming.memoryBudgetMB, 1, 256)) {
+			texture.pagePool.setBudget((VkDeviceSize)streaming.memoryBudgetMB * 1024 * 1024);
 		}
-		if (overlay->button("Fill mip tail")) {
-			fillMipTail();
+		if (overlay->button("Flush pages")) {
+			flushPages();
 		}
 	}
 	if (overlay->header("Statistics")) {
-		uint32_t respages = 0;
-		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
-		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Resident pages: %d of %d", static_cast<uint32_t>(texture.lru.size()), static_cast<uint32_t>(texture.pages.size()));
+		overlay->text("Requested pages: %d", streaming.pagesRequested);
+		overlay->text("Page pool: %.1f MB allocated", (float)(texture.pagePool.slotCount * texture.pagePool.pageSize) / (1024.0f * 1024.0f));
+		overlay->text("Streamed in: %d, evicted: %d", streaming.pagesUploaded, streaming.pagesEvicted);
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
 	}
 
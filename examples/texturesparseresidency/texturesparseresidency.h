@@ -12,6 +12,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanSparsePagePool.h"
+#include <list>
 
 #define ENABLE_VALIDATION false
 
@@ -26,11 +28,14 @@ struct VirtualTexturePage
 	uint32_t mipLevel;													// Mip level that this page belongs to
 	uint32_t layer;														// Array layer that this page belongs to
 	uint32_t index;
+	uint32_t poolSlot;													// Slot of the page pool that backs this page while it's resident
+	uint64_t lastRequested;												// Last feedback update that requested this page
+	std::list<uint32_t>::iterator lruEntry;								// Position of the page in the LRU list of resident pages
 
 	VirtualTexturePage();
 	bool resident();
-	void allocate(VkDevice device, uint32_t memoryTypeIndex);
-	void release(VkDevice device);
+	void allocate(VkDeviceMemory memory, VkDeviceSize memoryOffset, uint32_t slot);
+	void release();
 };
 
 // Virtual texture object containing all pages
@@ -47,6 +52,10 @@ struct VirtualTexture
 	uint32_t mipTailStart;												// First mip level in mip tail
 	VkSparseImageMemoryRequirements sparseImageMemoryRequirements;		// @todo: Comment
 	uint32_t memoryTypeIndex;											// @todo: Comment
+	std::vector<uint32_t> mipPageOffsets;								// Index of the first page of each mip level outside of the mip tail
+	std::vector<glm::uvec2> mipPageCounts;								// Number of pages in x and y of each mip level outside of the mip tail
+	std::list<uint32_t> lru;											// Resident pages, from the most to the least recently requested one
+	vks::SparsePagePool pagePool;										// Device memory slots backing the resident pages, limited by a memory budget
 
 	// @todo: comment
 	struct MipTailInfo {
@@ -55,7 +64,8 @@ struct VirtualTexture
 	} mipTailInfo;
 
 	VirtualTexturePage *addPage(VkOffset3D offset, VkExtent3D extent, const VkDeviceSize size, const uint32_t mipLevel, uint32_t layer);
-	void updateSparseBindInfo();
+	uint32_t pageIndex(uint32_t mipLevel, uint32_t x, uint32_t y);
+	void updateSparseBindInfo(const std::vector<VirtualTexturePage*>& updatedPages, bool bindMipTail);
 	// @todo: replace with dtor?
 	void destroy();
 };
@@ -82,15 +92,42 @@ public:
 		glm::mat4 model;
 		glm::vec4 viewPos;
 		float lodBias = 0.0f;
+		// Layout of the virtual pages, used by the fragment shader to write the page requests
+		int32_t mipTailStart;
+		glm::ivec2 textureSize;
+		glm::ivec2 pageSize;
 	} uboVS;
 	vks::Buffer uniformBufferVS;
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
-	VkDescriptorSet descriptorSet;
+	// One descriptor set per frame in flight, as each one writes to its own feedback buffer
+	std::vector<VkDescriptorSet> descriptorSets;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	//todo: comment
+	// Page requests written by the fragment shader, one flag per virtual page and buffer per frame in flight
+	// A buffer is read back once the fence of its frame has been waited on, so the readback never stalls
+	struct Feedback {
+		std::vector<vks::Buffer> buffers;
+		bool enabled = true;
+	} feedback;
+
+	// Streams in the requested pages, binds and uploads of an update are batched into a single sparse bind and submit
+	struct Streaming {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		// Signaled after all previously submitted frames, so pages can be unbound once no frame in flight samples them anymore
+		VkSemaphore framesSemaphore = VK_NULL_HANDLE;
+		uint64_t updateIndex = 0;
+		// Max. number of pages uploaded per update, limits the time spent on a single frame
+		uint32_t maxPagesPerUpdate = 64;
+		int32_t memoryBudgetMB = 32;
+		uint32_t pagesUploaded = 0;
+		uint32_t pagesEvicted = 0;
+		uint32_t pagesRequested = 0;
+	} streaming;
+
+	// Signaled by the sparse bind of a streaming update and waited on by the uploads of the newly resident pages
 	VkSemaphore bindSparseSemaphore = VK_NULL_HANDLE;
 
 	VulkanExample();
@@ -100,20 +137,22 @@ public:
 	void prepareSparseTexture(uint32_t width, uint32_t height, uint32_t layerCount, VkFormat format);
 	// @todo: move to dtor of texture
 	void destroyTextureImage(SparseTexture texture);
-	void buildCommandBuffers();
-	void draw();
+	virtual void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 	void loadAssets();
 	void setupDescriptorPool();
 	void setupDescriptorSetLayout();
 	void setupDescriptorSet();
+	void prepareFeedback();
 	void preparePipelines();
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
 	void prepare();
 	virtual void render();
-	void uploadContent(VirtualTexturePage page, VkImage image);
-	void fillRandomPages();
+	void uploadContent(VkCommandBuffer commandBuffer, const VirtualTexturePage& page, VkImage image);
 	void fillMipTail();
-	void flushRandomPages();
+	void requestPage(uint32_t pageIndex, std::vector<VirtualTexturePage*>& missingPages);
+	bool evictPage(std::vector<VirtualTexturePage*>& updatedPages);
+	void updateResidency(uint32_t frameIndex);
+	void flushPages();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };
@@ -11,6 +11,8 @@
 VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 {
 	title = "Variable rate shading";
+	// The shading rate image is destroyed and recreated by handleResize, so resizing has to wait for the frames in flight
+	resizeWaitsForFrames = true;
 	apiVersion = VK_VERSION_1_1;
 	camera.type = Camera::CameraType::firstperson;
 	camera.flipY = true;
@@ -20,7 +22,9 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setRotationSpeed(0.25f);
 	settings.overlay = true;
 	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-	enabledDeviceExtensions.push_back(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME);
+	// POI: VK_NV_shading_rate_image and its feature are enabled by the base class along with adaptive shading rate, which derives the shading rate image from the image content
+	adaptiveShadingRate.supported = true;
+	adaptiveShadingRate.requested = true;
 }
 
 VulkanExample::~VulkanExample()
@@ -29,6 +33,10 @@ VulkanExample::~VulkanExample()
 	vkDestroyPipeline(device, basePipelines.opaque, nullptr);
 	vkDestroyPipeline(device, shadingRatePipelines.masked, nullptr);
 	vkDestroyPipeline(device, shadingRatePipelines.opaque, nullptr);
+	if (adaptiveShadingRate.enabled) {
+		vkDestroyPipeline(device, adaptiveShadingRatePipelines.masked, nullptr);
+		vkDestroyPipeline(device, adaptiveShadingRatePipelines.opaque, nullptr);
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 	vkDestroyImageView(device, shadingRateImage.view, nullptr);
@@ -40,11 +48,6 @@ VulkanExample::~VulkanExample()
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
-	// POI
-	enabledPhysicalDeviceShadingRateImageFeaturesNV = {};
-	enabledPhysicalDeviceShadingRateImageFeaturesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
-	enabledPhysicalDeviceShadingRateImageFeaturesNV.shadingRateImage = VK_TRUE;
-	deviceCreatepNextChain = &enabledPhysicalDeviceShadingRateImageFeaturesNV;
 }
 
 /*
@@ -74,41 +77,29 @@ void VulkanExample::buildCommandBuffers()
 	clearValues[0].color = { { 0.25f, 0.25f, 0.25f, 1.0f } };;
 	clearValues[1].depthStencil = { 1.0f, 0 };
 
-	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-	renderPassBeginInfo.renderPass = renderPass;
-	renderPassBeginInfo.renderArea.offset.x = 0;
-	renderPassBeginInfo.renderArea.offset.y = 0;
-	renderPassBeginInfo.renderArea.extent.width = width;
-	renderPassBeginInfo.renderArea.extent.height = height;
-	renderPassBeginInfo.clearValueCount = 2;
-	renderPassBeginInfo.pClearValues = clearValues;
-
-	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	// POI: In adaptive mode the base class generates the shading rate image from the previous frame and binds it in beginSceneRenderPass
+	adaptiveShadingRate.active = (shadingRateMode == SHADING_RATE_ADAPTIVE);
 
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		gpuProfiler.beginFrame(drawCmdBuffers[i]);
+		beginSceneRenderPass(drawCmdBuffers[i], i, clearValues, 2);
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-		// POI: Bind the image that contains the shading rate patterns
-		if (enableShadingRate) {
+		// POI: Bind the image that contains the static shading rate pattern
+		if (shadingRateMode == SHADING_RATE_STATIC) {
 			vkCmdBindShadingRateImageNV(drawCmdBuffers[i], shadingRateImage.view, VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV);
 		};
 
 		// Render the scene
-		Pipelines& pipelines = enableShadingRate ? shadingRatePipelines : basePipelines;
+		Pipelines& pipelines = (shadingRateMode == SHADING_RATE_STATIC) ? shadingRatePipelines : ((shadingRateMode == SHADING_RATE_ADAPTIVE) ? adaptiveShadingRatePipelines : basePipelines);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
 		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
 		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
 
-		drawUI(drawCmdBuffers[i]);
-		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		endSceneRenderPass(drawCmdBuffers[i], i);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
@@ -133,7 +124,7 @@ void VulkanExample::setupDescriptors()
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+	VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 	// Pipeline layout
 	const std::vector<VkDescriptorSetLayout> setLayouts = {
@@ -141,7 +132,7 @@ void VulkanExample::setupDescriptors()
 		vkglTF::descriptorSetLayoutImage,
 	};
 	VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), 2);
-	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+	VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 	// Descriptor set
 	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
@@ -339,10 +330,10 @@ void VulkanExample::preparePipelines()
 	shaderStages[1].pSpecializationInfo = &specializationInfo;
 
 	// Create pipeline without shading rate 
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.opaque));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.opaque));
 	specializationData.alphaMask = true;
 	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.masked));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.masked));
 	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
 	specializationData.alphaMask = false;
 
@@ -371,10 +362,22 @@ void VulkanExample::preparePipelines()
 	pipelineViewportShadingRateImageStateCI.viewportCount = 1;
 	pipelineViewportShadingRateImageStateCI.pShadingRatePalettes = &shadingRatePalette;
 	viewportStateCI.pNext = &pipelineViewportShadingRateImageStateCI;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.opaque));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.opaque));
 	specializationData.alphaMask = true;
 	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.masked));
+	VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.masked));
+
+	// Create pipeline with the palette of the adaptive shading rate image generated by the base class
+	if (adaptiveShadingRate.enabled) {
+		viewportStateCI.pNext = nullptr;
+		enableAdaptiveShadingRate(viewportStateCI);
+		specializationData.alphaMask = false;
+		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &adaptiveShadingRatePipelines.opaque));
+		specializationData.alphaMask = true;
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &adaptiveShadingRatePipelines.masked));
+	}
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -390,6 +393,7 @@ void VulkanExample::prepareUniformBuffers()
 
 void VulkanExample::updateUniformBuffers()
 {
+	waitForFramesInFlight();
 	shaderData.values.projection = camera.matrices.perspective;
 	shaderData.values.view = camera.matrices.view;
 	shaderData.values.viewPos = camera.viewPos;
@@ -428,7 +432,14 @@ void VulkanExample::render()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	if (overlay->checkBox("Enable shading rate", &enableShadingRate)) {
+	std::vector<std::string> shadingRateModes = { "Off", "Static pattern" };
+	if (adaptiveShadingRate.enabled) {
+		shadingRateModes.push_back("Adaptive (image content)");
+	}
+	if (overlay->comboBox("Shading rate", &shadingRateMode, shadingRateModes)) {
+		buildCommandBuffers();
+	}
+	if ((shadingRateMode == SHADING_RATE_ADAPTIVE) && overlay->sliderFloat("Rate threshold", &adaptiveShadingRate.generator.threshold, 0.0f, 0.1f)) {
 		buildCommandBuffers();
 	}
 	if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
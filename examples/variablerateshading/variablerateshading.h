@@ -22,7 +22,8 @@ public:
 		VkImageView view;
 	} shadingRateImage;
 
-	bool enableShadingRate = true;
+	enum ShadingRateMode { SHADING_RATE_OFF = 0, SHADING_RATE_STATIC = 1, SHADING_RATE_ADAPTIVE = 2 };
+	int32_t shadingRateMode = SHADING_RATE_STATIC;
 	bool colorShadingRate = false;
 
 	struct ShaderData {
@@ -44,13 +45,13 @@ public:
 
 	Pipelines basePipelines;
 	Pipelines shadingRatePipelines;
+	Pipelines adaptiveShadingRatePipelines;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	VkPhysicalDeviceShadingRateImagePropertiesNV physicalDeviceShadingRateImagePropertiesNV{};
-	VkPhysicalDeviceShadingRateImageFeaturesNV enabledPhysicalDeviceShadingRateImageFeaturesNV{};
 	PFN_vkCmdBindShadingRateImageNV vkCmdBindShadingRateImageNV;
 
 	VulkanExample();
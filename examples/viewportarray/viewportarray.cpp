@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Viewport array with single pass rendering using geometry shaders
 *
+* Alternatively writes the viewport index from the vertex shader (VK_EXT_shader_viewport_index_layer) with one instance per viewport,
+* with the primitives culled against the frustum of each viewport in a compute pass
+*
 * Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +11,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -24,11 +28,43 @@ public:
 
 	vks::Buffer uniformBufferGS;
 
-	VkPipeline pipeline;
+	// Paths for getting the geometry into both viewports
+	enum ViewportPath { GEOMETRY_SHADER = 0, VERTEX_SHADER = 1 };
+	int32_t viewportPath = GEOMETRY_SHADER;
+	const std::vector<std::string> viewportPathNames = { "Geometry shader", "Vertex shader instancing" };
+	bool geometryShaderSupported = false;
+	// Writing gl_ViewportIndex from the vertex shader requires VK_EXT_shader_viewport_index_layer, the culled draws also need a non-zero first instance
+	bool vertexShaderViewportIndexSupported = false;
+
+	struct Pipelines {
+		VkPipeline geometryShader = VK_NULL_HANDLE;
+		VkPipeline vertexShader = VK_NULL_HANDLE;
+	} pipelines;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	/*
+		Per viewport culling for the vertex shader path
+		Each primitive has one indirect draw, the compute shader sets its instance count to the number of viewports the primitive is visible in
+		The instance index selects the viewport, so a primitive only visible in the right viewport starts at instance 1
+	*/
+	struct Culling {
+		struct UniformData {
+			glm::vec4 frustumPlanes[2][6];
+			uint32_t drawCount;
+		} uniformData;
+		vks::Buffer uniformBuffer;
+		// Bounding spheres of the primitives in the space the vertices are rendered in (xyz = center, w = radius)
+		vks::Buffer boundsBuffer;
+		vks::Buffer drawCommandBuffer;
+		uint32_t drawCount = 0;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} culling;
+
 	// Camera and view properties
 	float eyeSeparation = 0.08f;
 	const float focalLength = 0.5f;
@@ -44,11 +80,30 @@ public:
 		camera.setTranslation(glm::vec3(7.0f, 3.2f, 0.0f));
 		camera.setMovementSpeed(5.0f);
 		settings.overlay = true;
+		// Recorded each frame, so the benchmark can alternate between the two paths
+		dynamicCommandBuffers = true;
+		// The queue is only used while preparing, so frames can be submitted on the submission thread (--submitthread)
+		submitThread.supported = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("viewportpath", { "-vp", "--viewportpath" }, 1, "Path used to render to both viewports (0 = geometry shader, 1 = vertex shader instancing)");
+		exampleArgs.parse(args);
+		viewportPath = exampleArgs.getValueAsInt("viewportpath", VERTEX_SHADER) == GEOMETRY_SHADER ? GEOMETRY_SHADER : VERTEX_SHADER;
 	}
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipeline, nullptr);
+		if (pipelines.geometryShader != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.geometryShader, nullptr);
+		}
+		if (pipelines.vertexShader != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.vertexShader, nullptr);
+			vkDestroyPipeline(device, culling.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, culling.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, culling.descriptorSetLayout, nullptr);
+			culling.uniformBuffer.destroy();
+			culling.boundsBuffer.destroy();
+			culling.drawCommandBuffer.destroy();
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -59,13 +114,6 @@ public:
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
-		// Geometry shader support is required for this example
-		if (deviceFeatures.geometryShader) {
-			enabledFeatures.geometryShader = VK_TRUE;
-		}
-		else {
-			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
-		}
 		// Multiple viewports must be supported
 		if (deviceFeatures.multiViewport) {
 			enabledFeatures.multiViewport = VK_TRUE;
@@ -73,11 +121,47 @@ public:
 		else {
 			vks::tools::exitFatal("Selected GPU does not support multi viewports!", VK_ERROR_FEATURE_NOT_PRESENT);
 		}
+		// Geometry shader support is required for the geometry shader path
+		geometryShaderSupported = deviceFeatures.geometryShader;
+		if (geometryShaderSupported) {
+			enabledFeatures.geometryShader = VK_TRUE;
+		}
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			vertexShaderViewportIndexSupported |= (strcmp(extension.extensionName, VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME) == 0);
+		}
+		vertexShaderViewportIndexSupported &= (deviceFeatures.drawIndirectFirstInstance == VK_TRUE);
+		if (vertexShaderViewportIndexSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+			// Optional, the draws are issued one by one otherwise
+			enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		}
+		if (!geometryShaderSupported && !vertexShaderViewportIndexSupported) {
+			vks::tools::exitFatal("Selected GPU supports neither geometry shaders nor writing the viewport index from the vertex shader!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		if (!geometryShaderSupported) {
+			viewportPath = VERTEX_SHADER;
+		}
+		if (!vertexShaderViewportIndexSupported) {
+			viewportPath = GEOMETRY_SHADER;
+		}
 	}
 
-	void buildCommandBuffers()
+	// Called by the base class right before the current frame's command buffer is submitted
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 	{
+		// The benchmark alternates between the supported paths every frame, so both show up in its scope timings
+		int32_t path = viewportPath;
+		if (benchmark.active && geometryShaderSupported && vertexShaderViewportIndexSupported) {
+			path = (frameCounter % 2 == 0) ? GEOMETRY_SHADER : VERTEX_SHADER;
+		}
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = defaultClearColor;
@@ -91,42 +175,82 @@ public:
 		renderPassBeginInfo.renderArea.extent.height = height;
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			// Set target frame buffer
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (path == VERTEX_SHADER) {
+			gpuProfiler.beginScope(commandBuffer, "Viewport culling", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			recordCulling(commandBuffer);
+			gpuProfiler.endScope(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
 
-			VkViewport viewports[2];
-			// Left
-			viewports[0] = { 0, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
-			// Right
-			viewports[1] = { (float)width / 2.0f, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 2, viewports);
+		VkViewport viewports[2];
+		// Left
+		viewports[0] = { 0, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
+		// Right
+		viewports[1] = { (float)width / 2.0f, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
 
-			VkRect2D scissorRects[2] = {
-				vks::initializers::rect2D(width/2, height, 0, 0),
-				vks::initializers::rect2D(width/2, height, width / 2, 0),
-			};
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 2, scissorRects);
+		vkCmdSetViewport(commandBuffer, 0, 2, viewports);
 
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
+		VkRect2D scissorRects[2] = {
+			vks::initializers::rect2D(width/2, height, 0, 0),
+			vks::initializers::rect2D(width/2, height, width / 2, 0),
+		};
+		vkCmdSetScissor(commandBuffer, 0, 2, scissorRects);
+
+		vkCmdSetLineWidth(commandBuffer, 1.0f);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		if (path == GEOMETRY_SHADER) {
+			gpuProfiler.beginScope(commandBuffer, "Scene (geometry shader)");
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryShader);
+			scene.draw(commandBuffer);
+			gpuProfiler.endScope(commandBuffer);
+		} else {
+			gpuProfiler.beginScope(commandBuffer, "Scene (vertex shader)");
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.vertexShader);
+			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &scene.vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (enabledFeatures.multiDrawIndirect) {
+				vkCmdDrawIndexedIndirect(commandBuffer, culling.drawCommandBuffer.buffer, 0, culling.drawCount, stride);
+			} else {
+				for (uint32_t i = 0; i < culling.drawCount; i++) {
+					vkCmdDrawIndexedIndirect(commandBuffer, culling.drawCommandBuffer.buffer, i * stride, 1, stride);
+				}
+			}
+			gpuProfiler.endScope(commandBuffer);
+		}
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			scene.draw(drawCmdBuffers[i]);
+		drawUI(commandBuffer);
 
-			drawUI(drawCmdBuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
-		}
+	void recordCulling(VkCommandBuffer commandBuffer)
+	{
+		// Draws of the previous frame must have finished reading the draw commands before they're overwritten
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipelineLayout, 0, 1, &culling.descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (culling.drawCount + 63) / 64, 1, 1);
+
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = culling.drawCommandBuffer.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
 	}
 
 	void loadAssets()
@@ -134,15 +258,59 @@ public:
 		scene.loadFromFile(getAssetPath() + "models/sampleroom.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY);
 	}
 
+	/*
+		Creates one indirect draw and bounding sphere per primitive of the scene for the culled vertex shader path
+	*/
+	void prepareCulling()
+	{
+		std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+		std::vector<glm::vec4> bounds;
+		// The vertices have been transformed by the node matrices and flipped at load time, the bounds of the primitives have not
+		const glm::mat4 flipY = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+		for (auto node : scene.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const glm::mat4 m = flipY * scene.hierarchy.worldMatrices[node->hierarchyIndex];
+			const float scale = sqrtf(std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])), std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2])))));
+			for (auto primitive : node->mesh->primitives) {
+				if (primitive->indexCount == 0) {
+					continue;
+				}
+				VkDrawIndexedIndirectCommand drawCommand{};
+				drawCommand.indexCount = primitive->indexCount;
+				drawCommand.instanceCount = 2;
+				drawCommand.firstIndex = primitive->firstIndex;
+				drawCommands.push_back(drawCommand);
+				bounds.push_back(glm::vec4(glm::vec3(m * glm::vec4(primitive->dimensions.center, 1.0f)), primitive->dimensions.radius * scale));
+			}
+		}
+		culling.drawCount = static_cast<uint32_t>(drawCommands.size());
+
+		// Draw commands are only written by the culling shader after the initial upload, so they're kept in device local memory
+		vks::Buffer stagingBuffer;
+		const VkDeviceSize drawCommandsSize = drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, drawCommandsSize, drawCommands.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culling.drawCommandBuffer, drawCommandsSize));
+		vulkanDevice->copyBuffer(&stagingBuffer, &culling.drawCommandBuffer, queue);
+		stagingBuffer.destroy();
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &culling.boundsBuffer, bounds.size() * sizeof(glm::vec4), bounds.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &culling.uniformBuffer, sizeof(Culling::UniformData)));
+		VK_CHECK_RESULT(culling.uniformBuffer.map());
+		culling.uniformData.drawCount = culling.drawCount;
+	}
+
 	void setupDescriptorPool()
 	{
 		// Example uses two ubos
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
-			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 2);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -150,18 +318,37 @@ public:
 	void setupDescriptorSetLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_GEOMETRY_BIT, 0)	// Binding 1: Geometry shader ubo
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0)	// Binding 0: Geometry or vertex shader ubo
 		};
+		// The geometry shader stage can't be used in layouts if the feature isn't enabled
+		if (!geometryShaderSupported) {
+			setLayoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		if (vertexShaderViewportIndexSupported) {
+			setLayoutBindings = {
+				// Binding 0: Draw commands
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				// Binding 1: Primitive bounds
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				// Binding 2: Frustum planes of the viewports
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			};
+			descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &culling.descriptorSetLayout));
+			pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&culling.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &culling.pipelineLayout));
+		}
 	}
 
 	void setupDescriptorSet()
@@ -179,6 +366,17 @@ public:
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		if (vertexShaderViewportIndexSupported) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &culling.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &culling.descriptorSet));
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &culling.drawCommandBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &culling.boundsBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &culling.uniformBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
 	}
 
 	void preparePipelines()
@@ -203,17 +401,31 @@ public:
 		pipelineCI.pViewportState = &viewportState;
 		pipelineCI.pDepthStencilState = &depthStencilState;
 		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.renderPass = renderPass;
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color});
 
-		shaderStages[0] = loadShader(getShadersPath() + "viewportarray/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "viewportarray/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		// A geometry shader is used to output geometry to multiple viewports in one single pass
-		// See the "invocations" decorator of the layout input in the shader
-		shaderStages[2] = loadShader(getShadersPath() + "viewportarray/multiview.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		if (geometryShaderSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "viewportarray/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "viewportarray/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			// A geometry shader is used to output geometry to multiple viewports in one single pass
+			// See the "invocations" decorator of the layout input in the shader
+			shaderStages[2] = loadShader(getShadersPath() + "viewportarray/multiview.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
+			pipelineCI.stageCount = 3;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometryShader));
+		}
+
+		if (vertexShaderViewportIndexSupported) {
+			// The vertex shader writes the viewport index itself, with the instance index selecting the viewport
+			shaderStages[0] = loadShader(getShadersPath() + "viewportarray/sceneinstanced.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "viewportarray/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			pipelineCI.stageCount = 2;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.vertexShader));
+
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(culling.pipelineLayout, 0);
+			computePipelineCI.stage = loadShader(getShadersPath() + "viewportarray/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vks::createComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &culling.pipeline));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -234,6 +446,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		// Geometry shader matrices for the two viewports
 		// See http://paulbourke.net/stereographics/stereorender/
 
@@ -278,27 +491,31 @@ public:
 		uboGS.modelview[1] = rotM * transM;
 
 		memcpy(uniformBufferGS.mapped, &uboGS, sizeof(uboGS));
-	}
 
-	void draw()
-	{
-		VulkanExampleBase::prepareFrame();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VulkanExampleBase::submitFrame();
+		if (vertexShaderViewportIndexSupported) {
+			for (uint32_t i = 0; i < 2; i++) {
+				vks::Frustum frustum;
+				frustum.update(uboGS.projection[i] * uboGS.modelview[i]);
+				for (size_t j = 0; j < frustum.planes.size(); j++) {
+					culling.uniformData.frustumPlanes[i][j] = frustum.planes[j];
+				}
+			}
+			memcpy(culling.uniformBuffer.mapped, &culling.uniformData, sizeof(Culling::UniformData));
+		}
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (vertexShaderViewportIndexSupported) {
+			prepareCulling();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -306,7 +523,7 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		renderFrame();
 	}
 
 	virtual void viewChanged()
@@ -320,9 +537,14 @@ public:
 			if (overlay->sliderFloat("Eye separation", &eyeSeparation, -1.0f, 1.0f)) {
 				updateUniformBuffers();
 			}
+			if (geometryShaderSupported && vertexShaderViewportIndexSupported) {
+				overlay->comboBox("Viewport path", &viewportPath, viewportPathNames);
+			} else {
+				overlay->text("Viewport path: %s", viewportPathNames[viewportPath].c_str());
+			}
 		}
 	}
 
 };
 
-VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
+VULKAN_EXAMPLE_MAIN()
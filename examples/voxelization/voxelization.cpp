@@ -0,0 +1,520 @@
+/*
+* Vulkan Example - Scene voxelization using conservative rasterization
+*
+* Rasterizes a glTF scene into a 3D voxel grid in a single pass: A geometry shader projects each triangle along the axis it faces the most,
+* with the dominant axis becoming the depth of a render pass without attachments that's as large as one side of the grid
+* The fragment shader writes the occupancy and the averaged albedo of each voxel with image atomics
+* Conservative rasterization (VK_EXT_conservative_rasterization) makes sure that triangles smaller or thinner than a voxel still cover all voxels they touch
+*
+* The grid is displayed by ray marching it or used for ambient occlusion of the rasterized scene
+* The grid is voxelized each frame and the voxelization is timed for 64^3, 128^3 and 256^3 grids (benchmark mode cycles through them)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+
+	// Conservative rasterization is optional, without it thin triangles leave holes in the grid
+	bool conservativeRasterSupported = false;
+	bool conservativeRasterEnabled = true;
+	VkPhysicalDeviceConservativeRasterizationPropertiesEXT conservativeRasterProps{};
+
+	const std::vector<uint32_t> gridSizes = { 64, 128, 256 };
+	const std::vector<std::string> gridSizeNames = { "64^3", "128^3", "256^3" };
+	int32_t gridIndex = 1;
+
+	enum DisplayMode { DISPLAY_VOXELS = 0, DISPLAY_SCENE_AO = 1 };
+	int32_t displayMode = DISPLAY_VOXELS;
+	const std::vector<std::string> displayModeNames = { "Voxels (ray marched)", "Scene with voxel AO" };
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 inverseProjection;
+		glm::mat4 inverseView;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	// Passed to all stages, the grid is a cube enclosing the scene
+	struct PushConstants {
+		// xyz = World space position of the grid's minimum corner, w = world space size of a voxel
+		glm::vec4 gridOrigin;
+		uint32_t gridSize;
+	};
+	// World space bounds of the grid, independent of its resolution
+	glm::vec3 gridMin;
+	float gridExtent;
+
+	/*
+		One voxel grid per grid size, each voxel stores the average albedo in rgb (8 bit unorm) and the number of fragments written to it in a (0 = empty)
+		The images stay in the general layout, as they're cleared, written with image atomics and read with image loads
+	*/
+	struct VoxelGrid {
+		uint32_t size;
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkFramebuffer frameBuffer;
+		VkDescriptorSet descriptorSet;
+	};
+	std::vector<VoxelGrid> voxelGrids;
+	// Render pass without attachments, the fragments are only written to the voxel grid
+	VkRenderPass voxelizationRenderPass;
+
+	struct Pipelines {
+		VkPipeline voxelize = VK_NULL_HANDLE;
+		VkPipeline voxelizeConservative = VK_NULL_HANDLE;
+		VkPipeline voxels;
+		VkPipeline sceneAO;
+	} pipelines;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Voxelization with conservative rasterization";
+		camera.type = Camera::CameraType::firstperson;
+		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
+		camera.setTranslation(glm::vec3(7.0f, 3.2f, 0.0f));
+		camera.setMovementSpeed(5.0f);
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		settings.overlay = true;
+		// Recorded each frame, so the benchmark can cycle through the grid sizes
+		dynamicCommandBuffers = true;
+		CommandLineParser exampleArgs;
+		exampleArgs.add("gridsize", { "-gs", "--gridsize" }, 1, "Size of the voxel grid (64, 128 or 256)");
+		exampleArgs.parse(args);
+		const uint32_t gridSize = static_cast<uint32_t>(exampleArgs.getValueAsInt("gridsize", 128));
+		for (size_t i = 0; i < gridSizes.size(); i++) {
+			if (gridSizes[i] == gridSize) {
+				gridIndex = static_cast<int32_t>(i);
+			}
+		}
+		// Reading device properties of conservative rasterization requires VK_KHR_get_physical_device_properties2 to be enabled
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			for (auto& voxelGrid : voxelGrids) {
+				vkDestroyFramebuffer(device, voxelGrid.frameBuffer, nullptr);
+				vkDestroyImageView(device, voxelGrid.view, nullptr);
+				vkDestroyImage(device, voxelGrid.image, nullptr);
+				vkFreeMemory(device, voxelGrid.memory, nullptr);
+			}
+			vkDestroyRenderPass(device, voxelizationRenderPass, nullptr);
+			vkDestroyPipeline(device, pipelines.voxelize, nullptr);
+			if (pipelines.voxelizeConservative != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, pipelines.voxelizeConservative, nullptr);
+			}
+			vkDestroyPipeline(device, pipelines.voxels, nullptr);
+			vkDestroyPipeline(device, pipelines.sceneAO, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			uniformBuffer.destroy();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// The triangles are projected along their dominant axis in a geometry shader
+		if (deviceFeatures.geometryShader) {
+			enabledFeatures.geometryShader = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		// The voxels are written with image atomics from the fragment shader
+		if (deviceFeatures.fragmentStoresAndAtomics) {
+			enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support stores and atomic operations in the fragment stage", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		for (auto& extension : extensions) {
+			conservativeRasterSupported |= (strcmp(extension.extensionName, VK_EXT_CONSERVATIVE_RASTERIZATION_EXTENSION_NAME) == 0);
+		}
+		if (conservativeRasterSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_CONSERVATIVE_RASTERIZATION_EXTENSION_NAME);
+		}
+		conservativeRasterEnabled = conservativeRasterSupported;
+	}
+
+	void loadAssets()
+	{
+		scene.loadFromFile(getAssetPath() + "models/sampleroom.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY);
+		// The grid is a cube around the scene with a small border, so voxels at the scene's bounds aren't clipped
+		gridExtent = glm::max(scene.dimensions.size.x, glm::max(scene.dimensions.size.y, scene.dimensions.size.z)) * 1.02f;
+		gridMin = scene.dimensions.center - glm::vec3(gridExtent * 0.5f);
+	}
+
+	/*
+		Create the voxel grids and the render pass used to voxelize the scene into them
+	*/
+	void prepareVoxelGrids()
+	{
+		// No attachments, the grid is written from the fragment shader
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		VK_CHECK_RESULT(vks::createRenderPass(device, &renderPassCI, nullptr, &voxelizationRenderPass));
+
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t size : gridSizes) {
+			VoxelGrid voxelGrid{};
+			voxelGrid.size = size;
+
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_3D;
+			imageCI.format = VK_FORMAT_R32_UINT;
+			imageCI.extent = { size, size, size };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &voxelGrid.image));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, voxelGrid.image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &voxelGrid.memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, voxelGrid.image, voxelGrid.memory, 0));
+
+			VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+			viewCI.viewType = VK_IMAGE_VIEW_TYPE_3D;
+			viewCI.format = VK_FORMAT_R32_UINT;
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			viewCI.image = voxelGrid.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &voxelGrid.view));
+
+			vks::tools::setImageLayout(layoutCmd, voxelGrid.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+			// The render area of the voxelization covers one side of the grid
+			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+			framebufferCI.renderPass = voxelizationRenderPass;
+			framebufferCI.attachmentCount = 0;
+			framebufferCI.width = size;
+			framebufferCI.height = size;
+			framebufferCI.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &voxelGrid.frameBuffer));
+
+			voxelGrids.push_back(voxelGrid);
+		}
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+	}
+
+	void setupDescriptors()
+	{
+		const uint32_t gridCount = static_cast<uint32_t>(voxelGrids.size());
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, gridCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, gridCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, gridCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1: Voxel grid
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// One descriptor set per grid size
+		for (auto& voxelGrid : voxelGrids) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &voxelGrid.descriptorSet));
+			VkDescriptorImageInfo voxelGridDescriptor{ VK_NULL_HANDLE, voxelGrid.view, VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(voxelGrid.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(voxelGrid.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &voxelGridDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+
+		// Scene with voxel ambient occlusion
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
+		shaderStages = {
+			loadShader(getShadersPath() + "voxelization/sceneao.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "voxelization/sceneao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneAO));
+
+		// Ray marched voxels, full screen triangle generated in the vertex shader
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		pipelineCI.pVertexInputState = &emptyInputState;
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		shaderStages = {
+			loadShader(getShadersPath() + "voxelization/voxels.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "voxelization/voxels.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.voxels));
+
+		/*
+			Voxelization
+			Both sides of the triangles are voxelized and there are no attachments to write or test against
+		*/
+		pipelineCI.renderPass = voxelizationRenderPass;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Color });
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		VkPipelineDepthStencilStateCreateInfo noDepthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		pipelineCI.pDepthStencilState = &noDepthStencilStateCI;
+		VkPipelineColorBlendStateCreateInfo noColorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(0, nullptr);
+		pipelineCI.pColorBlendState = &noColorBlendStateCI;
+		shaderStages = {
+			loadShader(getShadersPath() + "voxelization/voxelize.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "voxelization/voxelize.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT),
+			loadShader(getShadersPath() + "voxelization/voxelize.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.voxelize));
+
+		if (conservativeRasterSupported) {
+			// Get device properties for conservative rasterization
+			PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+			assert(vkGetPhysicalDeviceProperties2KHR);
+			VkPhysicalDeviceProperties2KHR deviceProps2{};
+			conservativeRasterProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONSERVATIVE_RASTERIZATION_PROPERTIES_EXT;
+			deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			deviceProps2.pNext = &conservativeRasterProps;
+			vkGetPhysicalDeviceProperties2KHR(physicalDevice, &deviceProps2);
+
+			// [POI] Overestimation generates a fragment for every pixel (voxel column) a triangle touches, not only for those whose center it covers
+			VkPipelineRasterizationConservativeStateCreateInfoEXT conservativeRasterStateCI{};
+			conservativeRasterStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_CONSERVATIVE_STATE_CREATE_INFO_EXT;
+			conservativeRasterStateCI.conservativeRasterizationMode = VK_CONSERVATIVE_RASTERIZATION_MODE_OVERESTIMATE_EXT;
+			conservativeRasterStateCI.extraPrimitiveOverestimationSize = 0.0f;
+			rasterizationStateCI.pNext = &conservativeRasterStateCI;
+			VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.voxelizeConservative));
+		}
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	void updateUniformBuffers()
+	{
+		waitForFramesInFlight();
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.inverseProjection = glm::inverse(camera.matrices.perspective);
+		uniformData.inverseView = glm::inverse(camera.matrices.view);
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	/*
+		Voxelize the scene into the given grid, the grid is cleared first
+	*/
+	void recordVoxelization(VkCommandBuffer commandBuffer, const VoxelGrid& voxelGrid, const PushConstants& pushConstants)
+	{
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// The previous frame may still read the grid
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.image = voxelGrid.image;
+		imageBarrier.subresourceRange = subresourceRange;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		VkClearColorValue clearColor{};
+		vkCmdClearColorImage(commandBuffer, voxelGrid.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = voxelizationRenderPass;
+		renderPassBeginInfo.framebuffer = voxelGrid.frameBuffer;
+		renderPassBeginInfo.renderArea.extent = { voxelGrid.size, voxelGrid.size };
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)voxelGrid.size, (float)voxelGrid.size, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(voxelGrid.size, voxelGrid.size, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, conservativeRasterEnabled ? pipelines.voxelizeConservative : pipelines.voxelize);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voxelGrid.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+		scene.draw(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Make the voxel writes visible to the display
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	// Called by the base class right before the current frame's command buffer is submitted
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		// The benchmark cycles through the grid sizes every frame, so all of them show up in its scope timings
+		const uint32_t index = benchmark.active ? (frameCounter % static_cast<uint32_t>(voxelGrids.size())) : static_cast<uint32_t>(gridIndex);
+		const VoxelGrid& voxelGrid = voxelGrids[index];
+
+		PushConstants pushConstants{};
+		pushConstants.gridOrigin = glm::vec4(gridMin, gridExtent / static_cast<float>(voxelGrid.size));
+		pushConstants.gridSize = voxelGrid.size;
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		gpuProfiler.beginFrame(commandBuffer);
+
+		// The scene is static, but it's voxelized every frame to measure the cost of (re)voxelizing a dynamic scene
+		gpuProfiler.beginScope(commandBuffer, "Voxelize " + gridSizeNames[index]);
+		recordVoxelization(commandBuffer, voxelGrid, pushConstants);
+		gpuProfiler.endScope(commandBuffer);
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &voxelGrid.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+		gpuProfiler.beginScope(commandBuffer, "Display");
+		if (displayMode == DISPLAY_VOXELS) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.voxels);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		} else {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sceneAO);
+			scene.draw(commandBuffer);
+		}
+		gpuProfiler.endScope(commandBuffer);
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareVoxelGrids();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		renderFrame();
+	}
+
+	virtual void viewChanged()
+	{
+		updateUniformBuffers();
+	}
+
+	virtual bool setComparisonSetting(const std::string& name, bool enabled)
+	{
+		if ((name == "conservativeraster") && conservativeRasterSupported) {
+			conservativeRasterEnabled = enabled;
+			return true;
+		}
+		return VulkanExampleBase::setComparisonSetting(name, enabled);
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->comboBox("Grid size", &gridIndex, gridSizeNames);
+			overlay->comboBox("Display", &displayMode, displayModeNames);
+			if (conservativeRasterSupported) {
+				overlay->checkBox("Conservative rasterization", &conservativeRasterEnabled);
+			} else {
+				overlay->text("Conservative rasterization not supported");
+			}
+		}
+		if (conservativeRasterSupported && overlay->header("Device properties")) {
+			overlay->text("maxExtraPrimitiveOverestimationSize: %f", conservativeRasterProps.maxExtraPrimitiveOverestimationSize);
+			overlay->text("primitiveOverestimationSize: %f", conservativeRasterProps.primitiveOverestimationSize);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -22,6 +22,8 @@ public:
 	{
 		vkglTF::Model* glTF;
 		VkPipeline *pipeline;
+		// Not drawn in the depth prepass if null
+		VkPipeline *depthPrepassPipeline;
 	};
 	std::vector<DemoModel> demoModels;
 
@@ -48,12 +50,22 @@ public:
 		VkPipeline skybox;
 	} pipelines;
 
+	// Only created if the depth prepass is enabled (--depthprepass)
+	struct {
+		VkPipeline logos = VK_NULL_HANDLE;
+		VkPipeline models = VK_NULL_HANDLE;
+	} depthPrepassPipelines;
+
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	glm::vec4 lightPos = glm::vec4(1.0f, 4.0f, 0.0f, 0.0f);
 
+	// Logos and models fetch their vertices in the vertex shader (--vertexpulling), their pipelines then don't depend on the vertex layout
+	// The models are stored with the compact vertex layout in that case, but are still drawn with the same pipeline as the background
+	bool vertexPulling = false;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Vulkan Demo Scene - (c) by Sascha Willems";
@@ -64,6 +76,8 @@ public:
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		settings.overlay = true;
+		depthPrepass.supported = true;
+		vertexPulling = commandLineParser.isSet("vertexpulling");
 	}
 
 	~VulkanExample()
@@ -73,6 +87,10 @@ public:
 		vkDestroyPipeline(device, pipelines.logos, nullptr);
 		vkDestroyPipeline(device, pipelines.models, nullptr);
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
+		if (depthPrepass.enabled) {
+			vkDestroyPipeline(device, depthPrepassPipelines.logos, nullptr);
+			vkDestroyPipeline(device, depthPrepassPipelines.models, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -85,17 +103,46 @@ public:
 		textures.skybox.destroy();
 	}
 
+	virtual void getEnabledFeatures()
+	{
+		// Required for the indirect draws of the models
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		// Draws all primitives of a model with a single indirect draw if available
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+	}
+
 	void loadAssets()
 	{
 		// Models
 		std::vector<std::string> modelFiles = { "vulkanscenelogos.gltf", "vulkanscenebackground.gltf", "vulkanscenemodels.gltf", "cube.gltf" };
 		std::vector<VkPipeline*> modelPipelines = { &pipelines.logos, &pipelines.models, &pipelines.models, &pipelines.skybox };
+		// The sky sphere doesn't write depth, so there's nothing to lay down in the depth prepass
+		std::vector<VkPipeline*> depthPrepassModelPipelines = { &depthPrepassPipelines.logos, &depthPrepassPipelines.models, &depthPrepassPipelines.models, nullptr };
 		for (auto i = 0; i < modelFiles.size(); i++) {
 			DemoModel model;
-			const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+			uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
 			model.pipeline = modelPipelines[i];
+			model.depthPrepassPipeline = depthPrepassModelPipelines[i];
 			model.glTF = new vkglTF::Model();
+			// The sky sphere keeps using the fixed function vertex input
+			const bool pullVertices = vertexPulling && (modelPipelines[i] != &pipelines.skybox);
+			if (pullVertices) {
+				glTFLoadingFlags |= vkglTF::FileLoadingFlags::VertexPulling;
+				if (modelFiles[i] == "vulkanscenemodels.gltf") {
+					glTFLoadingFlags |= vkglTF::FileLoadingFlags::CompactVertices;
+					model.glTF->compactVertexComponents = { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color };
+				}
+			}
 			model.glTF->loadFromFile(getAssetPath() + "models/" + modelFiles[i], vulkanDevice, queue, glTFLoadingFlags);
+			// The node list is turned into indirect draw commands once, so recording a model costs a single draw instead of one per primitive
+			model.glTF->prepareIndirectDraws(queue);
+			if (pullVertices) {
+				model.glTF->prepareVertexPulling();
+			}
 			demoModels.push_back(model);
 		}
 		// Textures
@@ -135,9 +182,26 @@ public:
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
+			// Depth prepass, the main subpass then only shades the visible fragments of the models
+			if (depthPrepass.enabled) {
+				for (auto model : demoModels) {
+					if (model.depthPrepassPipeline) {
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *model.depthPrepassPipeline);
+						if (model.glTF->vertexPulling.descriptorSet != VK_NULL_HANDLE) {
+							model.glTF->bindVertexPulling(drawCmdBuffers[i], pipelineLayout);
+						}
+						model.glTF->drawIndirect(drawCmdBuffers[i]);
+					}
+				}
+				vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+			}
+
 			for (auto model : demoModels) {
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *model.pipeline);
-				model.glTF->draw(drawCmdBuffers[i]);
+				if (model.glTF->vertexPulling.descriptorSet != VK_NULL_HANDLE) {
+					model.glTF->bindVertexPulling(drawCmdBuffers[i], pipelineLayout);
+				}
+				model.glTF->drawIndirect(drawCmdBuffers[i]);
 			}
 
 			drawUI(drawCmdBuffers[i]);
@@ -187,14 +251,19 @@ public:
 				setLayoutBindings.data(),
 				setLayoutBindings.size());
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vks::createDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
+		// Set 1: Vertex pulling set of the model being drawn, the layout is shared by all models
+		std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayout };
+		if (vertexPulling) {
+			setLayouts.push_back(demoModels[0].glTF->vertexPulling.descriptorSetLayout);
+		}
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
-				&descriptorSetLayout,
-				1);
+				setLayouts.data(),
+				static_cast<uint32_t>(setLayouts.size()));
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vks::createPipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -257,22 +326,32 @@ public:
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color });;
 
+		// Vertex pulling pipelines have no vertex input state, the vertex shaders fetch the vertices themselves
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		if (vertexPulling) {
+			pipelineCI.pVertexInputState = &emptyInputState;
+		}
+
 		// Default mesh rendering pipeline
-		shaderStages[0] = loadShader(getShadersPath() + "vulkanscene/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[0] = loadShader(getShadersPath() + (vertexPulling ? "vulkanscene/meshpulling.vert.spv" : "vulkanscene/mesh.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "vulkanscene/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.models));
+		prepareDepthPrepassPipeline(pipelineCI, depthStencilState, &depthPrepassPipelines.models);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.models));
 
 		// Pipeline for the logos
-		shaderStages[0] = loadShader(getShadersPath() + "vulkanscene/logo.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[0] = loadShader(getShadersPath() + (vertexPulling ? "vulkanscene/logopulling.vert.spv" : "vulkanscene/logo.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "vulkanscene/logo.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.logos));
+		prepareDepthPrepassPipeline(pipelineCI, depthStencilState, &depthPrepassPipelines.logos);
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.logos));
 
-		// Pipeline for the sky sphere
+		// Pipeline for the sky sphere, only drawn in the main subpass
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color });
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		depthStencilState.depthWriteEnable = VK_FALSE;
+		depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 		shaderStages[0] = loadShader(getShadersPath() + "vulkanscene/skybox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "vulkanscene/skybox.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
+		VK_CHECK_RESULT(vks::createGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -289,6 +368,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		waitForFramesInFlight();
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.view = camera.matrices.view;
 		uboVS.model = glm::mat4(1.0f);
@@ -3946,6 +3946,24 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
   buffer->uri.clear();
   ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
 
+  // EXT_meshopt_compression fallback buffers may come without data, the
+  // application decodes the compressed buffer views referencing them instead
+  {
+    json_const_iterator extensionsIt, meshoptIt;
+    bool fallback = false;
+    if (buffer->uri.empty() && FindMember(o, "extensions", extensionsIt) &&
+        FindMember(GetValue(extensionsIt), "EXT_meshopt_compression",
+                   meshoptIt) &&
+        ParseBooleanProperty(&fallback, err, GetValue(meshoptIt), "fallback",
+                             false) &&
+        fallback) {
+      ParseStringProperty(&buffer->name, err, o, "name", false);
+      ParseExtensionsProperty(&buffer->extensions, err, o);
+      ParseExtrasProperty(&buffer->extras, o);
+      return true;
+    }
+  }
+
   // having an empty uri for a non embedded image should not be valid
   if (!is_binary && buffer->uri.empty()) {
     if (err) {